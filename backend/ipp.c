@@ -18,6 +18,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#ifdef HAVE_LIBZ
+#  include <zlib.h>
+#endif /* HAVE_LIBZ */
 #if defined(HAVE_GSSAPI) && defined(HAVE_XPC)
 #  include <xpc/xpc.h>
 #  define kPMPrintUIToolAgent	"com.apple.printuitool.agent"
@@ -42,6 +45,25 @@ extern void	xpc_connection_set_target_uid(xpc_connection_t connection,
 #define _CUPS_JSR_DOCUMENT_UNPRINTABLE		0x80
 
 
+/*
+ * Size of document copy and HTTP buffers...
+ */
+
+#define _CUPS_DOC_BUFFER			65536
+
+
+/*
+ * Printer monitoring limits...
+ */
+
+#define _CUPS_MONITOR_DELAY			30
+					/* Longest delay between polls */
+#define _CUPS_MONITOR_LEASE			300
+					/* Lease for event subscriptions */
+#define _CUPS_MONITOR_SUBSCRIBE			10
+					/* Poll for this long before subscribing */
+
+
 /*
  * Types...
  */
@@ -57,7 +79,9 @@ typedef struct _cups_monitor_s		/**** Monitoring data ****/
 			job_id,		/* Job ID for submitted job */
 			job_reasons,	/* Job state reasons bits */
 			create_job,	/* Support Create-Job? */
-			get_job_attrs;	/* Support Get-Job-Attributes? */
+			get_job_attrs,	/* Support Get-Job-Attributes? */
+			get_notifications;
+					/* Support ippget notifications? */
   const char		*job_name;	/* Job name for submitted job */
   http_encryption_t	encryption;	/* Use encryption? */
   ipp_jstate_t		job_state;	/* Current job state */
@@ -65,6 +89,18 @@ typedef struct _cups_monitor_s		/**** Monitoring data ****/
   int			retryable;	/* Is this a job that should be retried? */
 } _cups_monitor_t;
 
+#ifdef HAVE_LIBZ
+typedef struct _cups_deflate_s		/**** Document compression data ****/
+{
+  int			infd,		/* Uncompressed document */
+			pipefd[2];	/* Pipe for compressed document */
+  const char		*compression;	/* "deflate" or "gzip" */
+  char			*data;		/* Data already read from document */
+  size_t		datalen;	/* Length of data */
+  _cups_thread_t	thread;		/* Compression thread */
+} _cups_deflate_t;
+#endif /* HAVE_LIBZ */
+
 
 /*
  * Globals...
@@ -111,6 +147,7 @@ static const char * const pattrs[] =	/* Printer attributes we want */
   "marker-types",
   "media-col-supported",
   "multiple-document-handling-supported",
+  "notify-pull-method-supported",
   "operations-supported",
   "print-color-mode-supported",
   "printer-alert",
@@ -151,10 +188,18 @@ static char		mandatory_attrs[1024] = "";
 static void		cancel_job(http_t *http, const char *uri, int id,
 			           const char *resource, const char *user,
 				   int version);
+static void		cancel_subscription(http_t *http,
+			                    _cups_monitor_t *monitor, int id);
 static ipp_pstate_t	check_printer_state(http_t *http, const char *uri,
 		                            const char *resource,
 					    const char *user, int version);
+static int		create_subscription(http_t *http,
+			                    _cups_monitor_t *monitor);
 static void		debug_attributes(ipp_t *ipp);
+#ifdef HAVE_LIBZ
+static void		*deflate_document(_cups_deflate_t *d);
+static void		finish_deflate(_cups_deflate_t *d);
+#endif /* HAVE_LIBZ */
 static void		*monitor_printer(_cups_monitor_t *monitor);
 static ipp_t		*new_request(ipp_op_t op, int version, const char *uri,
 			             const char *user, const char *title,
@@ -176,8 +221,15 @@ static int		run_as_user(char *argv[], uid_t uid,
 			            const char *device_uri, int fd);
 #endif /* HAVE_GSSAPI && HAVE_XPC */
 static void		sigterm_handler(int sig);
+#ifdef HAVE_LIBZ
+static _cups_deflate_t	*start_deflate(int infd, const char *compression,
+			               const char *data, size_t datalen);
+#endif /* HAVE_LIBZ */
 static int		timeout_cb(http_t *http, void *user_data);
 static void		update_reasons(ipp_attribute_t *attr, const char *s);
+static int		wait_notifications(http_t *http,
+			                   _cups_monitor_t *monitor, int id,
+					   int *sequence);
 
 
 /*
@@ -254,6 +306,8 @@ main(int  argc,				/* I - Number of command-line args */
   ipp_attribute_t *print_color_mode_sup;/* Does printer support print-color-mode? */
   int		create_job = 0,		/* Does printer support Create-Job? */
 		get_job_attrs = 0,	/* Does printer support Get-Job-Attributes? */
+		get_notifications = 0,	/* Does printer support Get-Notifications? */
+		create_printer_subs = 0,/* Does printer support subscriptions? */
 		send_document = 0,	/* Does printer support Send-Document? */
 		validate_job = 0,	/* Does printer support Validate-Job? */
 		copies,			/* Number of copies for job */
@@ -263,7 +317,12 @@ main(int  argc,				/* I - Number of command-line args */
 		*document_format;	/* document-format value */
   int		fd;			/* File descriptor */
   off_t		bytes = 0;		/* Bytes copied */
-  char		buffer[16384];		/* Copy buffer */
+  char		buffer[_CUPS_DOC_BUFFER];
+					/* Copy buffer */
+#ifdef HAVE_LIBZ
+  _cups_deflate_t *deflater = NULL,	/* Compression thread for document */
+		*next_deflater = NULL;	/* Compression thread for next file */
+#endif /* HAVE_LIBZ */
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* Actions for POSIX signals */
 #endif /* HAVE_SIGACTION && !HAVE_SIGSET */
@@ -660,6 +719,7 @@ main(int  argc,				/* I - Number of command-line args */
   http = httpConnect2(hostname, port, addrlist, AF_UNSPEC, cupsEncryption(), 1,
                       0, NULL);
   httpSetTimeout(http, 30.0, timeout_cb, NULL);
+  httpSetBufferSize(http, _CUPS_DOC_BUFFER);
 
  /*
   * See if the printer supports SNMP...
@@ -1214,8 +1274,20 @@ main(int  argc,				/* I - Number of command-line args */
 	  send_document = 1;
         else if (operations_sup->values[i].integer == IPP_OP_GET_JOB_ATTRIBUTES)
 	  get_job_attrs = 1;
+        else if (operations_sup->values[i].integer == IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS)
+	  create_printer_subs = 1;
+        else if (operations_sup->values[i].integer == IPP_OP_GET_NOTIFICATIONS)
+	  get_notifications = 1;
       }
 
+     /*
+      * Event monitoring needs printer subscriptions that are pulled with
+      * Get-Notifications ("ippget")...
+      */
+
+      if (get_notifications && (!create_printer_subs || !ippContainsString(ippFindAttribute(supported, "notify-pull-method-supported", IPP_TAG_KEYWORD), "ippget")))
+        get_notifications = 0;
+
       if (create_job && !send_document)
       {
         fputs("DEBUG: Printer supports Create-Job but not Send-Document.\n",
@@ -1319,8 +1391,7 @@ main(int  argc,				/* I - Number of command-line args */
       ppd = ppdOpenFile(getenv("PPD"));
       pc  = _ppdCacheCreateWithPPD(ppd);
 
-      ppdMarkDefaults(ppd);
-      cupsMarkOptions(ppd, num_options, options);
+      _ppdMarkDefaultsAndOptions(ppd, num_options, options);
 
       if ((mandatory = ppdFindAttr(ppd, "cupsMandatory", NULL)) != NULL)
         strlcpy(mandatory_attrs, mandatory->value, sizeof(mandatory_attrs));
@@ -1444,6 +1515,7 @@ main(int  argc,				/* I - Number of command-line args */
   monitor.job_id        = 0;
   monitor.create_job    = create_job;
   monitor.get_job_attrs = get_job_attrs;
+  monitor.get_notifications = get_notifications;
   monitor.encryption    = cupsEncryption();
   monitor.job_state     = IPP_JSTATE_PENDING;
   monitor.printer_state = IPP_PSTATE_IDLE;
@@ -1611,9 +1683,6 @@ main(int  argc,				/* I - Number of command-line args */
       http_status = cupsSendRequest(http, request, resource, length);
       if (http_status == HTTP_STATUS_CONTINUE && request->state == IPP_STATE_DATA)
       {
-	if (compression && strcmp(compression, "none"))
-	  httpSetField(http, HTTP_FIELD_CONTENT_ENCODING, compression);
-
         if (num_files == 1)
         {
 	  if ((fd = open(files[0], O_RDONLY)) < 0)
@@ -1623,10 +1692,26 @@ main(int  argc,				/* I - Number of command-line args */
 	  }
 	}
 	else
+	  fd = 0;
+
+#ifdef HAVE_LIBZ
+       /*
+        * Compress the document in a separate thread so that compression and
+	* sending overlap...
+	*/
+
+	if (compression && strcmp(compression, "none") && compatsize == 0 &&
+	    (deflater = start_deflate(fd, compression, num_files == 1 ? NULL : buffer, num_files == 1 ? 0 : (size_t)bytes)) != NULL)
+	  fd = deflater->pipefd[0];
+	else
+#endif /* HAVE_LIBZ */
 	{
-	  fd          = 0;
-	  http_status = cupsWriteRequestData(http, buffer, (size_t)bytes);
-        }
+	  if (compression && strcmp(compression, "none"))
+	    httpSetField(http, HTTP_FIELD_CONTENT_ENCODING, compression);
+
+	  if (num_files != 1)
+	    http_status = cupsWriteRequestData(http, buffer, (size_t)bytes);
+	}
 
         while (http_status == HTTP_STATUS_CONTINUE &&
                (!job_canceled || compatsize > 0))
@@ -1665,6 +1750,14 @@ main(int  argc,				/* I - Number of command-line args */
 	  fprintf(stderr, "DEBUG: Error writing document data for "
 			  "Print-Job: %s\n", strerror(httpError(http)));
 
+#ifdef HAVE_LIBZ
+        if (deflater)
+	{
+	  finish_deflate(deflater);
+	  deflater = NULL;
+	}
+	else
+#endif /* HAVE_LIBZ */
         if (num_files == 1)
 	  close(fd);
       }
@@ -1819,21 +1912,40 @@ main(int  argc,				/* I - Number of command-line args */
 	http_status = cupsSendRequest(http, request, resource, 0);
 	if (http_status == HTTP_STATUS_CONTINUE && request->state == IPP_STATE_DATA)
 	{
-	  if (compression && strcmp(compression, "none"))
-	    httpSetField(http, HTTP_FIELD_CONTENT_ENCODING, compression);
-
-	  if (num_files == 0)
+#ifdef HAVE_LIBZ
+	  if ((deflater = next_deflater) != NULL)
 	  {
-	    fd          = 0;
-	    http_status = cupsWriteRequestData(http, buffer, (size_t)bytes);
+	   /*
+	    * This file has been compressing since the last one was sent...
+	    */
+
+	    next_deflater = NULL;
+	    fd            = deflater->pipefd[0];
 	  }
 	  else
+#endif /* HAVE_LIBZ */
 	  {
-	    if ((fd = open(files[i], O_RDONLY)) < 0)
+	    if (num_files == 0)
+	      fd = 0;
+	    else if ((fd = open(files[i], O_RDONLY)) < 0)
 	    {
 	      _cupsLangPrintError("ERROR", _("Unable to open print file"));
 	      return (CUPS_BACKEND_FAILED);
 	    }
+
+#ifdef HAVE_LIBZ
+	    if (compression && strcmp(compression, "none") &&
+	        (deflater = start_deflate(fd, compression, num_files == 0 ? buffer : NULL, num_files == 0 ? (size_t)bytes : 0)) != NULL)
+	      fd = deflater->pipefd[0];
+	    else
+#endif /* HAVE_LIBZ */
+	    {
+	      if (compression && strcmp(compression, "none"))
+		httpSetField(http, HTTP_FIELD_CONTENT_ENCODING, compression);
+
+	      if (num_files == 0)
+		http_status = cupsWriteRequestData(http, buffer, (size_t)bytes);
+	    }
 	  }
 	}
 	else
@@ -1857,6 +1969,25 @@ main(int  argc,				/* I - Number of command-line args */
 	    }
 	  }
 
+#ifdef HAVE_LIBZ
+	  if (deflater)
+	  {
+	    int	nextfd;			/* Next file */
+
+	    finish_deflate(deflater);
+	    deflater = NULL;
+
+	   /*
+	    * Start compressing the next file while we wait for the response...
+	    */
+
+	    if (!job_canceled && http_status == HTTP_STATUS_CONTINUE &&
+	        (i + 1) < num_files && (nextfd = open(files[i + 1], O_RDONLY)) >= 0 &&
+	        (next_deflater = start_deflate(nextfd, compression, NULL, 0)) == NULL)
+	      close(nextfd);
+	  }
+	  else
+#endif /* HAVE_LIBZ */
           if (fd > 0)
 	    close(fd);
 	}
@@ -1897,6 +2028,14 @@ main(int  argc,				/* I - Number of command-line args */
 	    break;
 	}
       }
+
+#ifdef HAVE_LIBZ
+      if (next_deflater)
+      {
+        finish_deflate(next_deflater);
+	next_deflater = NULL;
+      }
+#endif /* HAVE_LIBZ */
     }
 
     if (job_canceled)
@@ -2313,6 +2452,38 @@ cancel_job(http_t     *http,		/* I - HTTP connection */
 }
 
 
+/*
+ * 'cancel_subscription()' - Cancel an event subscription.
+ */
+
+static void
+cancel_subscription(
+    http_t          *http,		/* I - HTTP connection */
+    _cups_monitor_t *monitor,		/* I - Monitoring data */
+    int             id)			/* I - notify-subscription-id */
+{
+  ipp_t	*request;			/* Cancel-Subscription request */
+
+
+  request = ippNewRequest(IPP_OP_CANCEL_SUBSCRIPTION);
+  ippSetVersion(request, monitor->version / 10, monitor->version % 10);
+
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+               NULL, monitor->uri);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
+                "notify-subscription-id", id);
+
+  if (monitor->user && monitor->user[0])
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                 "requesting-user-name", NULL, monitor->user);
+
+  ippDelete(cupsDoRequest(http, request, monitor->resource));
+
+  fprintf(stderr, "DEBUG: (monitor) Cancel-Subscription: %s (%s)\n",
+	  ippErrorString(cupsLastError()), cupsLastErrorString());
+}
+
+
 /*
  * 'check_printer_state()' - Check the printer state.
  */
@@ -2375,6 +2546,62 @@ check_printer_state(
 }
 
 
+/*
+ * 'create_subscription()' - Subscribe to printer and job events.
+ *
+ * The subscription is leased for a few minutes so that it goes away on its
+ * own if the backend exits early; the monitor simply subscribes again when
+ * the lease runs out.
+ */
+
+static int				/* O - notify-subscription-id or 0 */
+create_subscription(
+    http_t          *http,		/* I - HTTP connection */
+    _cups_monitor_t *monitor)		/* I - Monitoring data */
+{
+  ipp_t		*request,		/* IPP request */
+		*response;		/* IPP response */
+  int		id;			/* notify-subscription-id */
+  static const char * const events[] =	/* Events we want */
+  {
+    "job-completed",
+    "job-created",
+    "job-state-changed",
+    "printer-state-changed"
+  };
+
+
+  request = ippNewRequest(IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS);
+  ippSetVersion(request, monitor->version / 10, monitor->version % 10);
+
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+               NULL, monitor->uri);
+
+  if (monitor->user && monitor->user[0])
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                 "requesting-user-name", NULL, monitor->user);
+
+  ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
+               "notify-pull-method", NULL, "ippget");
+  ippAddStrings(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
+                "notify-events", (int)(sizeof(events) / sizeof(events[0])),
+		NULL, events);
+  ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
+                "notify-lease-duration", _CUPS_MONITOR_LEASE);
+
+  response = cupsDoRequest(http, request, monitor->resource);
+  id       = ippGetInteger(ippFindAttribute(response, "notify-subscription-id",
+                                            IPP_TAG_INTEGER), 0);
+
+  fprintf(stderr, "DEBUG: (monitor) Create-Printer-Subscriptions: %s (%s), notify-subscription-id=%d\n",
+	  ippErrorString(cupsLastError()), cupsLastErrorString(), id);
+
+  ippDelete(response);
+
+  return (id);
+}
+
+
 /*
  * 'debug_attributes()' - Print out the request or response attributes as DEBUG
  * messages...
@@ -2420,6 +2647,121 @@ debug_attributes(ipp_t *ipp)		/* I - Request or response message */
 }
 
 
+#ifdef HAVE_LIBZ
+/*
+ * 'deflate_document()' - Compress a document into the pipe.
+ */
+
+static void *				/* O - Thread exit status */
+deflate_document(_cups_deflate_t *d)	/* I - Compression data */
+{
+  z_stream	stream;			/* Compression stream */
+  int		flush = Z_NO_FLUSH,	/* Flush mode */
+		zerr;			/* Compression status */
+  ssize_t	bytes;			/* Bytes read/written */
+  const char	*ptr;			/* Pointer into output */
+  size_t	length;			/* Bytes left to write */
+  char		inbuf[_CUPS_DOC_BUFFER],/* Input buffer */
+		outbuf[_CUPS_DOC_BUFFER];
+					/* Output buffer */
+
+
+ /*
+  * Use the same parameters as the HTTP content coding...
+  */
+
+  memset(&stream, 0, sizeof(stream));
+
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, !strcmp(d->compression, "deflate") ? -11 : 27, 7, Z_DEFAULT_STRATEGY) < Z_OK)
+  {
+    fputs("DEBUG: Unable to initialize document compression.\n", stderr);
+    close(d->pipefd[1]);
+    return (NULL);
+  }
+
+  stream.next_in  = (Bytef *)d->data;
+  stream.avail_in = (uInt)d->datalen;
+
+  do
+  {
+    if (stream.avail_in == 0 && flush == Z_NO_FLUSH)
+    {
+      if ((bytes = read(d->infd, inbuf, sizeof(inbuf))) > 0)
+      {
+        stream.next_in  = (Bytef *)inbuf;
+	stream.avail_in = (uInt)bytes;
+      }
+      else if (bytes < 0 && (errno == EINTR || errno == EAGAIN))
+        continue;
+      else
+      {
+        if (bytes < 0)
+	  fprintf(stderr, "DEBUG: Unable to read print data: %s\n", strerror(errno));
+
+        flush = Z_FINISH;
+      }
+    }
+
+    stream.next_out  = (Bytef *)outbuf;
+    stream.avail_out = sizeof(outbuf);
+
+    if ((zerr = deflate(&stream, flush)) < Z_OK && zerr != Z_BUF_ERROR)
+    {
+      fprintf(stderr, "DEBUG: Unable to compress print data: %d\n", zerr);
+      break;
+    }
+
+    for (ptr = outbuf, length = sizeof(outbuf) - stream.avail_out; length > 0; ptr += bytes, length -= (size_t)bytes)
+    {
+      if ((bytes = write(d->pipefd[1], ptr, length)) < 0)
+      {
+        if (errno == EINTR || errno == EAGAIN)
+	{
+	  bytes = 0;
+	  continue;
+	}
+
+        zerr = Z_STREAM_END;
+	break;
+      }
+    }
+  }
+  while (zerr != Z_STREAM_END);
+
+  deflateEnd(&stream);
+
+  close(d->pipefd[1]);
+
+  return (NULL);
+}
+#endif /* HAVE_LIBZ */
+
+
+#ifdef HAVE_LIBZ
+/*
+ * 'finish_deflate()' - Stop compressing a document and free memory.
+ */
+
+static void
+finish_deflate(_cups_deflate_t *d)	/* I - Compression data */
+{
+ /*
+  * Closing the pipe makes the thread stop if it is still writing...
+  */
+
+  close(d->pipefd[0]);
+
+  _cupsThreadWait(d->thread);
+
+  if (d->infd > 0)
+    close(d->infd);
+
+  free(d->data);
+  free(d);
+}
+#endif /* HAVE_LIBZ */
+
+
 /*
  * 'monitor_printer()' - Monitor the printer state.
  */
@@ -2433,13 +2775,23 @@ monitor_printer(
 		*response;		/* IPP response */
   ipp_attribute_t *attr;		/* Attribute in response */
   int		delay,			/* Current delay */
-		prev_delay;		/* Previous delay */
+		prev_delay,		/* Previous delay */
+		next_delay;		/* Next delay */
   ipp_op_t	job_op;			/* Operation to use */
   int		job_id;			/* Job ID */
   const char	*job_name;		/* Job name */
   ipp_jstate_t	job_state;		/* Job state */
   const char	*job_user;		/* Job originating user name */
   int		password_tries = 0;	/* Password tries */
+  int		sub_id = 0,		/* notify-subscription-id */
+		sequence = 1,		/* Next notify-sequence-number */
+		notify_ok = 0,		/* Has Get-Notifications worked? */
+		check = 1,		/* Check the printer and job? */
+		changed;		/* Did the state change? */
+  ipp_pstate_t	prev_printer_state;	/* Previous printer state */
+  ipp_jstate_t	prev_job_state;		/* Previous job state */
+  int		prev_job_reasons;	/* Previous job-state-reasons bits */
+  time_t	start_time;		/* Start of monitoring */
 
 
  /*
@@ -2455,15 +2807,21 @@ monitor_printer(
   cupsSetPasswordCB2((cups_password_cb2_t)password_cb, &password_tries);
 
  /*
-  * Loop until the job is canceled, aborted, or completed.
+  * Loop until the job is canceled, aborted, or completed.  Short jobs are
+  * cheapest to poll, so once a job has run for a while and the printer
+  * supports ippget notifications we only check on the printer and job after
+  * an event; otherwise we poll, backing off while nothing changes...
   */
 
-  delay = _cupsNextDelay(0, &prev_delay);
+  delay      = _cupsNextDelay(0, &prev_delay);
+  start_time = time(NULL);
 
   monitor->job_reasons = 0;
 
   while (monitor->job_state < IPP_JSTATE_CANCELED && !job_canceled)
   {
+    changed = 0;
+
    /*
     * Reconnect to the printer as needed...
     */
@@ -2473,10 +2831,37 @@ monitor_printer(
 
     if (httpGetFd(http) >= 0)
     {
+      if (monitor->get_notifications && !sub_id &&
+          (time(NULL) - start_time) >= _CUPS_MONITOR_SUBSCRIBE)
+      {
+       /*
+        * Subscribe to events, falling back to polling if we can't...
+	*/
+
+        if ((sub_id = create_subscription(http, monitor)) > 0)
+	{
+	  sequence  = 1;
+	  notify_ok = 0;
+	  check     = 1;
+	}
+	else
+	{
+	  fputs("DEBUG: (monitor) Unable to subscribe to events, polling printer.\n", stderr);
+	  monitor->get_notifications = 0;
+	}
+      }
+
+      if (!check)
+        goto monitor_sleep;
+
      /*
       * Connected, so check on the printer state...
       */
 
+      prev_printer_state = monitor->printer_state;
+      prev_job_state     = monitor->job_state;
+      prev_job_reasons   = monitor->job_reasons;
+
       monitor->printer_state = check_printer_state(http, monitor->uri,
                                                    monitor->resource,
 						   monitor->user,
@@ -2490,6 +2875,7 @@ monitor_printer(
         * No job-id yet, so continue...
 	*/
 
+        changed = 1;
         goto monitor_sleep;
       }
 
@@ -2671,17 +3057,64 @@ monitor_printer(
           (monitor->job_state == IPP_JSTATE_CANCELED ||
 	   monitor->job_state == IPP_JSTATE_ABORTED))
 	job_canceled = -1;
-    }
 
-   /*
-    * Sleep for N seconds...
-    */
+      changed = monitor->printer_state != prev_printer_state ||
+                monitor->job_state != prev_job_state ||
+		monitor->job_reasons != prev_job_reasons;
+    }
 
     monitor_sleep:
 
-    sleep((unsigned)delay);
+    if (sub_id > 0 && httpGetFd(http) >= 0 &&
+        monitor->job_state < IPP_JSTATE_CANCELED && !job_canceled)
+    {
+     /*
+      * Wait for the next event...
+      */
+
+      if ((check = wait_notifications(http, monitor, sub_id, &sequence)) >= 0)
+        notify_ok = 1;
+      else
+      {
+       /*
+        * Subscription expired or failed, subscribe again after a delay or
+	* poll if Get-Notifications never worked...
+	*/
+
+        if (!notify_ok)
+	{
+	  fputs("DEBUG: (monitor) Unable to get events, polling printer.\n", stderr);
+	  cancel_subscription(http, monitor, sub_id);
+	  monitor->get_notifications = 0;
+	}
+
+        sub_id = 0;
+	check  = 1;
+
+	sleep((unsigned)delay);
+
+	delay = _cupsNextDelay(delay, &prev_delay);
+      }
+    }
+    else
+    {
+     /*
+      * Sleep for N seconds, starting over with short delays when the state
+      * changes and backing off to _CUPS_MONITOR_DELAY while it does not...
+      */
+
+      if (changed)
+        delay = _cupsNextDelay(0, &prev_delay);
+
+      sleep((unsigned)delay);
 
-    delay = _cupsNextDelay(delay, &prev_delay);
+      if ((next_delay = delay + prev_delay) > _CUPS_MONITOR_DELAY)
+        next_delay = _CUPS_MONITOR_DELAY;
+
+      prev_delay = delay;
+      delay      = next_delay;
+      check      = 1;
+    }
   }
 
  /*
@@ -2706,6 +3139,9 @@ monitor_printer(
     }
   }
 
+  if (sub_id > 0 && httpGetFd(http) >= 0)
+    cancel_subscription(http, monitor, sub_id);
+
  /*
   * Cleanup and return...
   */
@@ -3422,6 +3858,78 @@ sigterm_handler(int sig)		/* I - Signal */
 }
 
 
+#ifdef HAVE_LIBZ
+/*
+ * 'start_deflate()' - Start compressing a document in a separate thread.
+ *
+ * The compressed document is read from "pipefd[0]" and sent as-is.  The
+ * document file is closed by finish_deflate().
+ */
+
+static _cups_deflate_t *		/* O - Compression data or NULL */
+start_deflate(int        infd,		/* I - Uncompressed document */
+              const char *compression,	/* I - "deflate" or "gzip" */
+	      const char *data,		/* I - Data already read or NULL */
+	      size_t     datalen)	/* I - Length of data */
+{
+  _cups_deflate_t	*d;		/* Compression data */
+
+
+  if (strcmp(compression, "deflate") && strcmp(compression, "gzip"))
+    return (NULL);
+
+  if ((d = calloc(1, sizeof(_cups_deflate_t))) == NULL)
+    return (NULL);
+
+  d->infd        = infd;
+  d->compression = compression;
+
+  if (datalen > 0)
+  {
+    if ((d->data = malloc(datalen)) == NULL)
+    {
+      free(d);
+      return (NULL);
+    }
+
+    memcpy(d->data, data, datalen);
+    d->datalen = datalen;
+  }
+
+  if (pipe(d->pipefd))
+  {
+    free(d->data);
+    free(d);
+    return (NULL);
+  }
+
+  fcntl(d->pipefd[0], F_SETFD, FD_CLOEXEC);
+  fcntl(d->pipefd[1], F_SETFD, FD_CLOEXEC);
+
+#ifdef F_SETPIPE_SZ
+ /*
+  * Let the thread get well ahead of the network...
+  */
+
+  fcntl(d->pipefd[1], F_SETPIPE_SZ, 16 * _CUPS_DOC_BUFFER);
+#endif /* F_SETPIPE_SZ */
+
+  if ((d->thread = _cupsThreadCreate((_cups_thread_func_t)deflate_document, d)) == 0)
+  {
+    close(d->pipefd[0]);
+    close(d->pipefd[1]);
+    free(d->data);
+    free(d);
+    return (NULL);
+  }
+
+  fprintf(stderr, "DEBUG: Compressing document with %s in a separate thread.\n", compression);
+
+  return (d);
+}
+#endif /* HAVE_LIBZ */
+
+
 /*
  * 'timeout_cb()' - Handle HTTP timeouts.
  */
@@ -3630,3 +4138,127 @@ update_reasons(ipp_attribute_t *attr,	/* I - printer-state-reasons or NULL */
   else if (rem[0])
     fprintf(stderr, "%s\n", rem);
 }
+
+
+/*
+ * 'wait_notifications()' - Wait for printer and job events.
+ *
+ * The printer is asked to hold the request until an event arrives
+ * ("notify-wait"); printers that answer right away are polled again after
+ * the returned "notify-get-interval".
+ */
+
+static int				/* O - 1 on events, 0 on none, -1 on error */
+wait_notifications(
+    http_t          *http,		/* I  - HTTP connection */
+    _cups_monitor_t *monitor,		/* I  - Monitoring data */
+    int             id,			/* I  - notify-subscription-id */
+    int             *sequence)		/* IO - Next notify-sequence-number */
+{
+  ipp_t		*request,		/* IPP request */
+		*response;		/* IPP response */
+  ipp_attribute_t *attr;		/* Attribute in response */
+  ipp_status_t	status;			/* Status of request */
+  const char	*name,			/* Attribute name */
+		*event;			/* notify-subscribed-event value */
+  int		events = 0,		/* Did we get any events we want? */
+		interval,		/* notify-get-interval value */
+		job_id,			/* notify-job-id value */
+		number;			/* notify-sequence-number value */
+  time_t	start;			/* Start of request */
+
+
+  request = ippNewRequest(IPP_OP_GET_NOTIFICATIONS);
+  ippSetVersion(request, monitor->version / 10, monitor->version % 10);
+
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+               NULL, monitor->uri);
+
+  if (monitor->user && monitor->user[0])
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                 "requesting-user-name", NULL, monitor->user);
+
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
+                "notify-subscription-ids", id);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
+                "notify-sequence-numbers", *sequence);
+  ippAddBoolean(request, IPP_TAG_OPERATION, "notify-wait", 1);
+
+  start    = time(NULL);
+  response = cupsDoRequest(http, request, monitor->resource);
+  status   = cupsLastError();
+
+  fprintf(stderr, "DEBUG: (monitor) Get-Notifications: %s (%s)\n",
+	  ippErrorString(status), cupsLastErrorString());
+
+  if (status > IPP_STATUS_OK_EVENTS_COMPLETE)
+  {
+    ippDelete(response);
+    return (-1);
+  }
+
+  interval = ippGetInteger(ippFindAttribute(response, "notify-get-interval",
+                                            IPP_TAG_INTEGER), 0);
+
+ /*
+  * Look through the events, ignoring those for other jobs...
+  */
+
+  for (attr = ippFirstAttribute(response); attr; attr = ippNextAttribute(response))
+  {
+    if (ippGetGroupTag(attr) != IPP_TAG_EVENT_NOTIFICATION)
+      continue;
+
+    event  = NULL;
+    job_id = 0;
+    number = 0;
+
+    for (; attr && ippGetGroupTag(attr) == IPP_TAG_EVENT_NOTIFICATION; attr = ippNextAttribute(response))
+    {
+      if ((name = ippGetName(attr)) == NULL)
+        break;
+      else if (!strcmp(name, "notify-job-id"))
+        job_id = ippGetInteger(attr, 0);
+      else if (!strcmp(name, "notify-sequence-number"))
+        number = ippGetInteger(attr, 0);
+      else if (!strcmp(name, "notify-subscribed-event"))
+        event = ippGetString(attr, 0, NULL);
+    }
+
+    if (number >= *sequence)
+      *sequence = number + 1;
+
+    if (event)
+    {
+      fprintf(stderr, "DEBUG: (monitor) Event #%d: %s (job %d)\n", number, event, job_id);
+
+      if (job_id == 0 || monitor->job_id == 0 || job_id == monitor->job_id)
+        events = 1;
+    }
+
+    if (!attr)
+      break;
+  }
+
+  ippDelete(response);
+
+  if (status == IPP_STATUS_OK_EVENTS_COMPLETE)
+    return (-1);
+
+ /*
+  * Sleep until the next poll if the printer did not wait for events...
+  */
+
+  if (!events)
+  {
+    if (interval < 1)
+      interval = 1;
+    else if (interval > _CUPS_MONITOR_DELAY)
+      interval = _CUPS_MONITOR_DELAY;
+
+    if ((interval -= (int)(time(NULL) - start)) > 0)
+      sleep((unsigned)interval);
+  }
+
+  return (events);
+}
@@ -18,6 +18,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#ifdef __linux
+#  include <sys/sendfile.h>
+#  define _CUPS_LPD_SENDFILE	1	/* Send print files with sendfile() */
+#endif /* __linux */
 
 #ifdef _WIN32
 #  include <winsock.h>
@@ -109,6 +113,7 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
   int		snmp_enabled = 1;	/* Is SNMP enabled? */
   int		snmp_fd;		/* SNMP socket */
   int		fd;			/* Print file */
+  struct stat	fileinfo;		/* Print file information */
   int		status;			/* Status of LPD job */
   int		mode;			/* Print mode */
   int		banner;			/* Print banner page? */
@@ -430,11 +435,24 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 
  /*
   * If we have 7 arguments, print the file named on the command-line.
-  * Otherwise, copy stdin to a temporary file and print the temporary
-  * file.
+  * Otherwise, print stdin directly if it is a file or copy stdin to a
+  * temporary file and print the temporary file.
   */
 
-  if (argc == 6 && mode == MODE_STANDARD)
+  if (argc == 6 && mode == MODE_STANDARD && !fstat(0, &fileinfo) &&
+      S_ISREG(fileinfo.st_mode) && !lseek(0, 0, SEEK_SET))
+  {
+   /*
+    * Stdin is already a file, so we know its size and can send it without
+    * making a copy...
+    */
+
+    fputs("DEBUG: Sending print data directly from stdin.\n", stderr);
+
+    filename = NULL;
+    fd       = 0;
+  }
+  else if (argc == 6 && mode == MODE_STANDARD)
   {
    /*
     * Copy stdin to a temporary file...
@@ -956,7 +974,7 @@ lpd_queue(const char      *hostname,	/* I - Host to connect to */
     * Next, open the print file and figure out its size...
     */
 
-    if (print_fd)
+    if (print_fd || mode == MODE_STANDARD)
     {
      /*
       * Use the size from the print file...
@@ -1113,6 +1131,33 @@ lpd_queue(const char      *hostname,	/* I - Host to connect to */
       {
 	lseek(print_fd, 0, SEEK_SET);
 
+#ifdef _CUPS_LPD_SENDFILE
+       /*
+        * Have the kernel copy the print file to the socket when we can,
+	* falling back to the buffer below for pipes...
+	*/
+
+	while (!abort_job &&
+	       (nbytes = sendfile(fd, print_fd, NULL, sizeof(buffer) * 32)) > 0)
+	{
+	  _cupsLangPrintFilter(stderr, "INFO",
+			       _("Spooling job, %.0f%% complete."),
+			       100.0 * tbytes / filestats.st_size);
+
+	  tbytes += nbytes;
+	}
+
+	if (abort_job)
+	  break;
+	else if (nbytes < 0 && errno != EINVAL && errno != ENOSYS)
+	{
+	  perror("DEBUG: Unable to send print file to printer");
+	  break;
+	}
+	else if (nbytes == 0)
+	  continue;
+#endif /* _CUPS_LPD_SENDFILE */
+
 	while ((nbytes = read(print_fd, buffer, sizeof(buffer))) > 0)
 	{
 	  _cupsLangPrintFilter(stderr, "INFO",
@@ -14,7 +14,30 @@
 
 #include "backend-private.h"
 #include <limits.h>
+#include <fcntl.h>
 #include <sys/select.h>
+#include <sys/stat.h>
+#if defined(__linux) && defined(SPLICE_F_MOVE)
+#  include <sys/sendfile.h>
+#  define _CUPS_RUNLOOP_SPLICE	1	/* Copy pipes with splice() */
+#  define _CUPS_RUNLOOP_SENDFILE 2	/* Copy files with sendfile() */
+#endif /* __linux && SPLICE_F_MOVE */
+
+
+/*
+ * Local constants...
+ */
+
+#define _CUPS_RUNLOOP_BUFFER	65536	/* Default size of print buffer */
+#define _CUPS_RUNLOOP_MAXBUF	(16 * 1024 * 1024)
+					/* Largest print buffer */
+
+
+/*
+ * Local globals...
+ */
+
+static off_t	runloop_bytes = 0;	/* Print bytes sent by previous runs */
 
 
 /*
@@ -143,12 +166,24 @@ backendRunLoop(
 		bytes;			/* Bytes written */
   int		paperout;		/* "Paper out" status */
   int		offline;		/* "Off-line" status */
-  char		print_buffer[8192],	/* Print data buffer */
+  char		*print_buffer,		/* Print data buffer */
 		*print_ptr,		/* Pointer into print data buffer */
 		bc_buffer[1024];	/* Back-channel data buffer */
-  struct timeval timeout;		/* Timeout for select() */
+  size_t	print_size = _CUPS_RUNLOOP_BUFFER;
+					/* Size of print data buffer */
+  const char	*value;			/* CUPS_BACKEND_BUFFER value */
+  struct stat	fileinfo;		/* Print or device file information */
+  int		report;			/* Report bytes sent? */
+#ifdef _CUPS_RUNLOOP_SPLICE
+  int		fast_copy = 0;		/* Copy in the kernel? */
+#endif /* _CUPS_RUNLOOP_SPLICE */
+  struct timeval timeout,		/* Timeout for select() */
+		start_time,		/* Start of copy */
+		end_time;		/* End of copy */
+  double	secs;			/* Seconds spent copying */
   time_t	curtime,		/* Current time */
-		snmp_update = 0;
+		snmp_update = 0,
+		report_update = 0;	/* Next time to report bytes sent */
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* Actions for POSIX signals */
 #endif /* HAVE_SIGACTION && !HAVE_SIGSET */
@@ -195,6 +230,55 @@ backendRunLoop(
 
   nfds = (print_fd > device_fd ? print_fd : device_fd) + 1;
 
+ /*
+  * Allocate the print buffer, which can be made larger for fast printers
+  * with the CUPS_BACKEND_BUFFER environment variable...
+  */
+
+  if ((value = getenv("CUPS_BACKEND_BUFFER")) != NULL && atoi(value) > 0)
+  {
+    if ((print_size = (size_t)atoi(value)) < 4096)
+      print_size = 4096;
+    else if (print_size > _CUPS_RUNLOOP_MAXBUF)
+      print_size = _CUPS_RUNLOOP_MAXBUF;
+  }
+
+  if ((print_buffer = malloc(print_size)) == NULL)
+  {
+    fprintf(stderr, "DEBUG: Unable to allocate %u byte print buffer: %s\n", (unsigned)print_size, strerror(errno));
+    _cupsLangPrintFilter(stderr, "ERROR", _("Unable to read print data."));
+    return (-1);
+  }
+
+ /*
+  * Only report progress when sending to a device and not when copying to a
+  * temporary file...
+  */
+
+  report = fstat(device_fd, &fileinfo) || !S_ISREG(fileinfo.st_mode);
+
+#ifdef _CUPS_RUNLOOP_SPLICE
+ /*
+  * Print data going to a socket or file is copied by the kernel, a pipe
+  * with splice() and a file with sendfile().  Back-channel and side-channel
+  * data is still handled between copies...
+  */
+
+  if (!fstat(device_fd, &fileinfo) &&
+      (S_ISSOCK(fileinfo.st_mode) || S_ISREG(fileinfo.st_mode)) &&
+      !fstat(print_fd, &fileinfo))
+  {
+    if (S_ISFIFO(fileinfo.st_mode))
+      fast_copy = _CUPS_RUNLOOP_SPLICE;
+    else if (S_ISREG(fileinfo.st_mode))
+      fast_copy = _CUPS_RUNLOOP_SENDFILE;
+  }
+#endif /* _CUPS_RUNLOOP_SPLICE */
+
+  fprintf(stderr, "DEBUG: Copying print data with a %u byte buffer.\n", (unsigned)print_size);
+
+  gettimeofday(&start_time, NULL);
+
  /*
   * Now loop until we are out of data from print_fd...
   */
@@ -240,7 +324,7 @@ backendRunLoop(
 	{
 	  fputs("DEBUG: Received an interrupt before any bytes were "
 	        "written, aborting.\n", stderr);
-          return (0);
+          break;
 	}
 
 	sleep(1);
@@ -291,10 +375,50 @@ backendRunLoop(
     * Check if we have print data ready...
     */
 
+#ifdef _CUPS_RUNLOOP_SPLICE
+    if (fast_copy && FD_ISSET(print_fd, &input))
+    {
+      if (fast_copy == _CUPS_RUNLOOP_SPLICE)
+        bytes = splice(print_fd, NULL, device_fd, NULL, print_size, SPLICE_F_MOVE | SPLICE_F_MORE);
+      else
+        bytes = sendfile(device_fd, print_fd, NULL, print_size);
+
+      if (bytes > 0)
+      {
+        fprintf(stderr, "DEBUG: Wrote %d bytes of print data...\n", (int)bytes);
+
+	total_bytes += bytes;
+      }
+      else if (bytes == 0)
+      {
+       /*
+        * End of file, break out of the loop...
+	*/
+
+        break;
+      }
+      else if (errno == EINVAL || errno == ENOSYS)
+      {
+       /*
+        * Not supported for these files, copy through the print buffer...
+	*/
+
+        fputs("DEBUG: Unable to copy print data in the kernel, using print buffer.\n", stderr);
+	fast_copy = 0;
+	continue;
+      }
+      else if (errno != EAGAIN && errno != EINTR)
+      {
+	_cupsLangPrintError("ERROR", _("Unable to write print data"));
+	total_bytes = -1;
+	break;
+      }
+    }
+    else
+#endif /* _CUPS_RUNLOOP_SPLICE */
     if (FD_ISSET(print_fd, &input))
     {
-      if ((print_bytes = read(print_fd, print_buffer,
-                              sizeof(print_buffer))) < 0)
+      if ((print_bytes = read(print_fd, print_buffer, print_size)) < 0)
       {
        /*
         * Read error - bail if we don't see EAGAIN or EINTR...
@@ -305,7 +429,8 @@ backendRunLoop(
 	  fprintf(stderr, "DEBUG: Read failed: %s\n", strerror(errno));
 	  _cupsLangPrintFilter(stderr, "ERROR",
 	                       _("Unable to read print data."));
-	  return (-1);
+	  total_bytes = -1;
+	  break;
 	}
 
         print_bytes = 0;
@@ -360,7 +485,8 @@ backendRunLoop(
 	else if (errno != EAGAIN && errno != EINTR && errno != ENOTTY)
 	{
 	  _cupsLangPrintError("ERROR", _("Unable to write print data"));
-	  return (-1);
+	  total_bytes = -1;
+	  break;
 	}
       }
       else
@@ -391,19 +517,50 @@ backendRunLoop(
     * Do SNMP updates periodically...
     */
 
-    if (snmp_fd >= 0 && time(&curtime) >= snmp_update)
+    curtime = time(NULL);
+
+    if (snmp_fd >= 0 && curtime >= snmp_update)
     {
       if (backendSNMPSupplies(snmp_fd, addr, NULL, NULL))
         snmp_update = INT_MAX;
       else
         snmp_update = curtime + 5;
     }
+
+   /*
+    * Report the bytes sent so far periodically...
+    */
+
+    if (report && total_bytes > 0 && curtime >= report_update)
+    {
+      fprintf(stderr, "ATTR: job-k-octets-processed=%d\n", (int)((runloop_bytes + total_bytes + 1023) / 1024));
+      report_update = curtime + 5;
+    }
   }
 
+  free(print_buffer);
+
+  if (total_bytes <= 0)
+    return (total_bytes);
+
  /*
-  * Return with success...
+  * Report the final count and throughput, then return with success...
   */
 
+  gettimeofday(&end_time, NULL);
+
+  if ((secs = (end_time.tv_sec - start_time.tv_sec) + 0.000001 * (end_time.tv_usec - start_time.tv_usec)) < 0.001)
+    secs = 0.001;
+
+  fprintf(stderr, "DEBUG: Sent " CUPS_LLFMT " bytes of print data in %.3f seconds (%.1f kB/s).\n", CUPS_LLCAST total_bytes, secs, total_bytes / secs / 1024.0);
+
+  if (report)
+  {
+    runloop_bytes += total_bytes;
+
+    fprintf(stderr, "ATTR: job-k-octets-processed=%d\n", (int)((runloop_bytes + 1023) / 1024));
+  }
+
   return (total_bytes);
 }
 
@@ -22,6 +22,7 @@
 
 #define CUPS_MAX_SUPPLIES	32	/* Maximum number of supplies for a printer */
 #define CUPS_SUPPLY_TIMEOUT	2.0	/* Timeout for SNMP lookups */
+#define CUPS_SUPPLY_BULK	32	/* Max OIDs per SNMP GetBulk request */
 
 #define CUPS_DEVELOPER_LOW	0x0001
 #define CUPS_DEVELOPER_EMPTY	0x0002
@@ -66,6 +67,7 @@ typedef struct				/**** Printer state table ****/
  * Local globals...
  */
 
+static int		bulk_walk = -1;	/* Use GetBulk requests (-1 = unknown)? */
 static http_addr_t	current_addr;	/* Current address */
 static int		current_state = -1;
 					/* Current device state bits */
@@ -197,6 +199,8 @@ static const backend_state_t supply_states[] =
  */
 
 static void	backend_init_supplies(int snmp_fd, http_addr_t *addr);
+static int	backend_walk(int snmp_fd, const char *community,
+		             const int *prefix);
 static void	backend_walk_cb(cups_snmp_t *packet, void *data);
 static void	utf16_to_utf8(cups_utf8_t *dst, const unsigned char *src,
 			      size_t srcsize, size_t dstsize, int le);
@@ -216,9 +220,7 @@ backendSNMPSupplies(
   if (!httpAddrEqual(addr, &current_addr))
     backend_init_supplies(snmp_fd, addr);
   else if (num_supplies > 0)
-    _cupsSNMPWalk(snmp_fd, &current_addr, CUPS_SNMP_VERSION_1,
-		  _cupsSNMPDefaultCommunity(), prtMarkerSuppliesLevel,
-		  CUPS_SUPPLY_TIMEOUT, backend_walk_cb, NULL);
+    backend_walk(snmp_fd, _cupsSNMPDefaultCommunity(), prtMarkerSuppliesLevel);
 
   if (page_count)
     *page_count = -1;
@@ -501,6 +503,7 @@ backend_init_supplies(
   current_state = -1;
   num_supplies  = -1;
   charset       = -1;
+  bulk_walk     = -1;
 
   memset(supplies, 0, sizeof(supplies));
 
@@ -566,14 +569,14 @@ backend_init_supplies(
    /*
     * Yes, read the cache file:
     *
-    *     3 num_supplies charset
+    *     4 num_supplies charset bulk_walk
     *     device description
     *     supply structures...
     */
 
     if (cupsFileGets(cachefile, value, sizeof(value)))
     {
-      if (sscanf(value, "3 %d%d", &num_supplies, &charset) == 2 &&
+      if (sscanf(value, "4 %d%d%d", &num_supplies, &charset, &bulk_walk) == 3 &&
           num_supplies <= CUPS_MAX_SUPPLIES &&
           cupsFileGets(cachefile, value, sizeof(value)))
       {
@@ -584,12 +587,14 @@ backend_init_supplies(
 	{
 	  num_supplies = -1;
 	  charset      = -1;
+	  bulk_walk    = -1;
 	}
       }
       else
       {
         num_supplies = -1;
 	charset      = -1;
+	bulk_walk    = -1;
       }
     }
 
@@ -655,9 +660,7 @@ backend_init_supplies(
     * Walk the printer configuration information...
     */
 
-    _cupsSNMPWalk(snmp_fd, &current_addr, CUPS_SNMP_VERSION_1,
-		  community, prtMarkerSuppliesEntry,
-		  CUPS_SUPPLY_TIMEOUT, backend_walk_cb, NULL);
+    backend_walk(snmp_fd, community, prtMarkerSuppliesEntry);
   }
 
  /*
@@ -669,7 +672,8 @@ backend_init_supplies(
 
   if ((cachefile = cupsFileOpen(cachefilename, "w")) != NULL)
   {
-    cupsFilePrintf(cachefile, "3 %d %d\n", num_supplies, charset);
+    cupsFilePrintf(cachefile, "4 %d %d %d\n", num_supplies, charset,
+                   bulk_walk);
     cupsFilePrintf(cachefile, "%s\n", description);
 
     if (num_supplies > 0)
@@ -689,9 +693,7 @@ backend_init_supplies(
   for (i = 0; i < num_supplies; i ++)
     strlcpy(supplies[i].color, "none", sizeof(supplies[i].color));
 
-  _cupsSNMPWalk(snmp_fd, &current_addr, CUPS_SNMP_VERSION_1,
-                community, prtMarkerColorantValue,
-	        CUPS_SUPPLY_TIMEOUT, backend_walk_cb, NULL);
+  backend_walk(snmp_fd, community, prtMarkerColorantValue);
 
  /*
   * Output the marker-colors attribute...
@@ -759,6 +761,45 @@ backend_init_supplies(
 }
 
 
+/*
+ * 'backend_walk()' - Walk the OIDs under a prefix.
+ *
+ * GetBulk requests are tried first so that the supply tables come back in a
+ * few packets instead of one round trip per OID.  Printers that only support
+ * SNMPv1 do not respond to them, in which case we fall back to GetNext
+ * requests and remember that for later walks.
+ */
+
+static int				/* O - Number of OIDs found or -1 on error */
+backend_walk(int        snmp_fd,	/* I - SNMP socket */
+             const char *community,	/* I - Community name */
+             const int  *prefix)	/* I - OID prefix */
+{
+  int	count;				/* Number of OIDs found */
+
+
+  if (bulk_walk)
+  {
+    if ((count = _cupsSNMPBulkWalk(snmp_fd, &current_addr, community, prefix,
+                                   CUPS_SUPPLY_BULK, CUPS_SUPPLY_TIMEOUT,
+				   backend_walk_cb, NULL)) >= 0)
+    {
+      bulk_walk = 1;
+      return (count);
+    }
+    else if (bulk_walk > 0)
+      return (count);
+
+    fputs("DEBUG: SNMP GetBulk not supported, using GetNext.\n", stderr);
+    bulk_walk = 0;
+  }
+
+  return (_cupsSNMPWalk(snmp_fd, &current_addr, CUPS_SNMP_VERSION_1,
+                        community, prefix, CUPS_SUPPLY_TIMEOUT,
+			backend_walk_cb, NULL));
+}
+
+
 /*
  * 'backend_walk_cb()' - Interpret the supply value responses.
  */
@@ -17,6 +17,8 @@
 #include <cups/file.h>
 #include <cups/http-private.h>
 #include <regex.h>
+#include <fcntl.h>
+#include <poll.h>
 
 
 /*
@@ -26,6 +28,13 @@
  * lookup based on the device description string, and finally a probe of
  * port 9100 (AppSocket) and 515 (LPD).
  *
+ * Port probes are done in parallel using non-blocking connects, with up to
+ * MaxProbes connections in flight at any time.  The connect timeout for
+ * each host is derived from the round-trip time of its SNMP responses and
+ * capped by ProbeTimeout.  Discovered devices are remembered in the
+ * "snmp.cache" file in the CUPS_CACHEDIR directory so that later scans only
+ * need to verify known devices rather than querying them again.
+ *
  * The current focus is on printers with internal network cards, although
  * the code also works with many external print servers as well.
  *
@@ -39,17 +48,24 @@
  *     Community name
  *     DebugLevel N
  *     DeviceURI "regex pattern" uri
+ *     DiscoveryCache on
+ *     DiscoveryCache off
  *     HostNameLookups on
  *     HostNameLookups off
+ *     MaxProbes N
  *     MaxRunTime N
+ *     ProbeTimeout N
  *
  * The default is to use:
  *
  *     Address @LOCAL
  *     Community public
  *     DebugLevel 0
+ *     DiscoveryCache on
  *     HostNameLookups off
+ *     MaxProbes 32
  *     MaxRunTime 120
+ *     ProbeTimeout 1
  *
  * This backend is known to work with the following network printers and
  * print servers:
@@ -104,6 +120,15 @@ typedef struct snmp_cache_s		/**** SNMP scan cache ****/
 		*location,		/* device-location */
 		*make_and_model;	/* device-make-and-model */
   int		sent;			/* Has this device been listed? */
+  int		cached,			/* Loaded from the discovery cache? */
+		probed;			/* URI found by a port probe? */
+  time_t	seen;			/* Last time device was seen */
+  double	query_time,		/* Time device queries were sent */
+		rtt;			/* Measured round-trip time */
+  int		probe_fd,		/* Port probe socket or -1 */
+		probe_port;		/* Index into ProbePorts */
+  double	probe_start,		/* Start time for current port probe */
+		probe_end;		/* End time for current port probe */
 } snmp_cache_t;
 
 
@@ -112,30 +137,34 @@ typedef struct snmp_cache_s		/**** SNMP scan cache ****/
  */
 
 static char		*add_array(cups_array_t *a, const char *s);
-static void		add_cache(http_addr_t *addr, const char *addrname,
+static snmp_cache_t	*add_cache(http_addr_t *addr, const char *addrname,
 			          const char *uri, const char *id,
 				  const char *make_and_model);
 static device_uri_t	*add_device_uri(char *value);
-static void		alarm_handler(int sig);
 static int		compare_cache(snmp_cache_t *a, snmp_cache_t *b);
 static void		debug_printf(const char *format, ...);
+static int		finish_probe(snmp_cache_t *device, int status);
 static void		fix_make_model(char *make_model,
 			               const char *old_make_model,
 				       int make_model_size);
 static void		free_array(cups_array_t *a);
-static void		free_cache(void);
+static void		free_cache(cups_array_t *devices);
+static void		free_device(snmp_cache_t *cache);
 static http_addrlist_t	*get_interface_addresses(const char *ifname);
 static void		list_device(snmp_cache_t *cache);
+static int		match_device_uri(snmp_cache_t *device);
 static const char	*password_cb(const char *prompt);
 static void		probe_device(snmp_cache_t *device);
+static void		probe_devices(time_t endtime);
+static void		read_device_cache(void);
 static void		read_snmp_conf(const char *address);
 static void		read_snmp_response(int fd);
 static double		run_time(void);
 static void		scan_devices(int ipv4, int ipv6);
-static int		try_connect(http_addr_t *addr, const char *addrname,
-			            int port);
+static int		start_probe(snmp_cache_t *device);
 static void		update_cache(snmp_cache_t *device, const char *uri,
 			             const char *id, const char *make_model);
+static void		write_device_cache(void);
 
 
 /*
@@ -146,6 +175,7 @@ static cups_array_t	*Addresses = NULL;
 static cups_array_t	*Communities = NULL;
 static cups_array_t	*Devices = NULL;
 static int		DebugLevel = 0;
+static int		DiscoveryCache = 1;
 static const int	DescriptionOID[] = { CUPS_OID_hrDeviceDescr, 1, -1 };
 static const int	LocationOID[] = { CUPS_OID_sysLocation, 0, -1 };
 static const int	DeviceTypeOID[] = { CUPS_OID_hrDeviceType, 1, -1 };
@@ -157,7 +187,20 @@ static const int	LexmarkDeviceIdOID[] = { 1,3,6,1,4,1,641,2,1,2,1,3,1,-1 };
 static const int	XeroxProductOID[] = { 1,3,6,1,4,1,128,2,1,3,1,2,0,-1 };
 static cups_array_t	*DeviceURIs = NULL;
 static int		HostNameLookups = 0;
+static cups_array_t	*KnownDevices = NULL;
+static int		MaxProbes = 32;
 static int		MaxRunTime = 120;
+static const int	ProbePorts[] =	/* Ports to probe, in order */
+{
+#ifdef __APPLE__
+  5353,					/* mDNS - don't report if present */
+#endif /* __APPLE__ */
+  9100,					/* AppSocket */
+  515					/* LPD */
+};
+static cups_array_t	*Probes = NULL;
+static double		ProbeTimeout = 1.0;
+static double		QueryTime = 0.0;
 static struct timeval	StartTime;
 
 
@@ -171,9 +214,6 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 {
   int		ipv4,			/* SNMP IPv4 socket */
 		ipv6;			/* SNMP IPv6 socket */
-#if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
-  struct sigaction action;		/* Actions for POSIX signals */
-#endif /* HAVE_SIGACTION && !HAVE_SIGSET */
 
 
  /*
@@ -192,23 +232,6 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 
   cupsSetPasswordCB(password_cb);
 
- /*
-  * Catch SIGALRM signals...
-  */
-
-#ifdef HAVE_SIGSET
-  sigset(SIGALRM, alarm_handler);
-#elif defined(HAVE_SIGACTION)
-  memset(&action, 0, sizeof(action));
-
-  sigemptyset(&action.sa_mask);
-  sigaddset(&action.sa_mask, SIGALRM);
-  action.sa_handler = alarm_handler;
-  sigaction(SIGALRM, &action, NULL);
-#else
-  signal(SIGALRM, alarm_handler);
-#endif /* HAVE_SIGSET */
-
  /*
   * Open the SNMP socket...
   */
@@ -231,7 +254,12 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 
   _cupsSNMPSetDebug(DebugLevel);
 
-  Devices = cupsArrayNew((cups_array_func_t)compare_cache, NULL);
+  Devices      = cupsArrayNew((cups_array_func_t)compare_cache, NULL);
+  KnownDevices = cupsArrayNew((cups_array_func_t)compare_cache, NULL);
+  Probes       = cupsArrayNew(NULL, NULL);
+
+  if (DiscoveryCache)
+    read_device_cache();
 
  /*
   * Scan for devices...
@@ -239,6 +267,9 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 
   scan_devices(ipv4, ipv6);
 
+  if (DiscoveryCache)
+    write_device_cache();
+
  /*
   * Close, free, and return with no errors...
   */
@@ -249,7 +280,9 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 
   free_array(Addresses);
   free_array(Communities);
-  free_cache();
+  free_cache(Devices);
+  free_cache(KnownDevices);
+  cupsArrayDelete(Probes);
 
   return (0);
 }
@@ -278,7 +311,7 @@ add_array(cups_array_t *a,		/* I - Array */
  * 'add_cache()' - Add a cached device...
  */
 
-static void
+static snmp_cache_t *			/* O - New device entry */
 add_cache(http_addr_t *addr,		/* I - Device IP address */
           const char  *addrname,	/* I - IP address or name string */
           const char  *uri,		/* I - Device URI */
@@ -293,10 +326,14 @@ add_cache(http_addr_t *addr,		/* I - Device IP address */
                addr, addrname, uri ? uri : "(null)", id ? id : "(null)",
 	       make_and_model ? make_and_model : "(null)");
 
-  temp = calloc(1, sizeof(snmp_cache_t));
+  if ((temp = calloc(1, sizeof(snmp_cache_t))) == NULL)
+    return (NULL);
+
   memcpy(&(temp->address), addr, sizeof(temp->address));
 
   temp->addrname = strdup(addrname);
+  temp->seen     = time(NULL);
+  temp->probe_fd = -1;
 
   if (uri)
     temp->uri = strdup(uri);
@@ -311,6 +348,8 @@ add_cache(http_addr_t *addr,		/* I - Device IP address */
 
   if (uri)
     list_device(temp);
+
+  return (temp);
 }
 
 
@@ -404,28 +443,6 @@ add_device_uri(char *value)		/* I - Value from snmp.conf */
 }
 
 
-/*
- * 'alarm_handler()' - Handle alarm signals...
- */
-
-static void
-alarm_handler(int sig)			/* I - Signal number */
-{
- /*
-  * Do nothing...
-  */
-
-  (void)sig;
-
-#if !defined(HAVE_SIGSET) && !defined(HAVE_SIGACTION)
-  signal(SIGALRM, alarm_handler);
-#endif /* !HAVE_SIGSET && !HAVE_SIGACTION */
-
-  if (DebugLevel)
-    write(2, "DEBUG: ALARM!\n", 14);
-}
-
-
 /*
  * 'compare_cache()' - Compare two cache entries.
  */
@@ -458,6 +475,71 @@ debug_printf(const char *format,	/* I - Printf-style format string */
 }
 
 
+/*
+ * 'finish_probe()' - Finish probing a port on a device.
+ */
+
+static int				/* O - 1 to probe the next port, 0 if done */
+finish_probe(snmp_cache_t *device,	/* I - Device */
+             int          status)	/* I - 0 on success or errno value */
+{
+  int	port = ProbePorts[device->probe_port];
+					/* Port that was probed */
+  char	uri[1024];			/* Device URI */
+
+
+  debug_printf("DEBUG: %.3f Probe of %s:%d %s.\n", run_time(),
+               device->addrname, port, status ? strerror(status) : "succeeded");
+
+  if (!status)
+  {
+#ifdef __APPLE__
+    if (port == 5353)
+    {
+     /*
+      * If the printer supports Bonjour/mDNS, don't report it from the SNMP
+      * backend.
+      */
+
+      debug_printf("DEBUG: %s supports mDNS, not reporting!\n",
+                   device->addrname);
+      return (0);
+    }
+#endif /* __APPLE__ */
+
+    if (port == 9100)
+    {
+      debug_printf("DEBUG: %s supports AppSocket!\n", device->addrname);
+
+      snprintf(uri, sizeof(uri), "socket://%s", device->addrname);
+    }
+    else
+    {
+      debug_printf("DEBUG: %s supports LPD!\n", device->addrname);
+
+      snprintf(uri, sizeof(uri), "lpd://%s/", device->addrname);
+    }
+
+    device->probed = 1;
+    update_cache(device, uri, NULL, NULL);
+    return (0);
+  }
+
+#ifdef __APPLE__
+  if (port == 5353 && match_device_uri(device))
+    return (0);
+#endif /* __APPLE__ */
+
+ /*
+  * Try the next port, if any...
+  */
+
+  device->probe_port ++;
+
+  return (device->probe_port < (int)(sizeof(ProbePorts) / sizeof(ProbePorts[0])));
+}
+
+
 /*
  * 'fix_make_model()' - Fix common problems in the make-and-model string.
  */
@@ -559,35 +641,49 @@ free_array(cups_array_t *a)		/* I - Array */
 
 
 /*
- * 'free_cache()' - Free the array of cached devices.
+ * 'free_cache()' - Free an array of cached devices.
  */
 
 static void
-free_cache(void)
+free_cache(cups_array_t *devices)	/* I - Array of devices */
 {
   snmp_cache_t	*cache;			/* Cached device */
 
 
-  for (cache = (snmp_cache_t *)cupsArrayFirst(Devices);
+  for (cache = (snmp_cache_t *)cupsArrayFirst(devices);
        cache;
-       cache = (snmp_cache_t *)cupsArrayNext(Devices))
-  {
-    free(cache->addrname);
+       cache = (snmp_cache_t *)cupsArrayNext(devices))
+    free_device(cache);
 
-    if (cache->uri)
-      free(cache->uri);
+  cupsArrayDelete(devices);
+}
 
-    if (cache->id)
-      free(cache->id);
 
-    if (cache->make_and_model)
-      free(cache->make_and_model);
+/*
+ * 'free_device()' - Free a cached device.
+ */
 
-    free(cache);
-  }
+static void
+free_device(snmp_cache_t *cache)	/* I - Cached device */
+{
+  free(cache->addrname);
+
+  if (cache->uri)
+    free(cache->uri);
 
-  cupsArrayDelete(Devices);
-  Devices = NULL;
+  if (cache->id)
+    free(cache->id);
+
+  if (cache->info)
+    free(cache->info);
+
+  if (cache->location)
+    free(cache->location);
+
+  if (cache->make_and_model)
+    free(cache->make_and_model);
+
+  free(cache);
 }
 
 
@@ -647,6 +743,59 @@ list_device(snmp_cache_t *cache)	/* I - Cached device */
 }
 
 
+/*
+ * 'match_device_uri()' - Look up a device in the DeviceURI match table.
+ */
+
+static int				/* O - 1 if matched, 0 otherwise */
+match_device_uri(snmp_cache_t *device)	/* I - Device */
+{
+  char		uri[1024],		/* Full device URI */
+		*uriptr,		/* Pointer into URI */
+		*format;		/* Format string for device */
+  device_uri_t	*device_uri;		/* Current DeviceURI match */
+
+
+  for (device_uri = (device_uri_t *)cupsArrayFirst(DeviceURIs);
+       device_uri;
+       device_uri = (device_uri_t *)cupsArrayNext(DeviceURIs))
+    if (device->make_and_model &&
+        !regexec(&(device_uri->re), device->make_and_model, 0, NULL, 0))
+    {
+     /*
+      * Found a match, add the URIs...
+      */
+
+      for (format = (char *)cupsArrayFirst(device_uri->uris);
+           format;
+	   format = (char *)cupsArrayNext(device_uri->uris))
+      {
+        for (uriptr = uri; *format && uriptr < (uri + sizeof(uri) - 1);)
+	  if (*format == '%' && format[1] == 's')
+	  {
+	   /*
+	    * Insert hostname/address...
+	    */
+
+	    strlcpy(uriptr, device->addrname, sizeof(uri) - (size_t)(uriptr - uri));
+	    uriptr += strlen(uriptr);
+	    format += 2;
+	  }
+	  else
+	    *uriptr++ = *format++;
+
+        *uriptr = '\0';
+
+        update_cache(device, uri, NULL, NULL);
+      }
+
+      return (1);
+    }
+
+  return (0);
+}
+
+
 /*
  * 'password_cb()' - Handle authentication requests.
  *
@@ -666,6 +815,9 @@ password_cb(const char *prompt)		/* I - Prompt message */
 /*
  * 'probe_device()' - Probe a device to discover whether it is a printer.
  *
+ * Devices that do not match a DeviceURI rule are queued for a port probe
+ * by probe_devices().
+ *
  * TODO: Try using the Port Monitor MIB to discover the correct protocol
  *       to use - first need a commercially-available printer that supports
  *       it, though...
@@ -674,22 +826,18 @@ password_cb(const char *prompt)		/* I - Prompt message */
 static void
 probe_device(snmp_cache_t *device)	/* I - Device */
 {
-  char		uri[1024],		/* Full device URI */
-		*uriptr,		/* Pointer into URI */
-		*format;		/* Format string for device */
-  device_uri_t	*device_uri;		/* Current DeviceURI match */
-
-
   debug_printf("DEBUG: %.3f Probing %s...\n", run_time(), device->addrname);
 
 #ifdef __APPLE__
  /*
-  * If the printer supports Bonjour/mDNS, don't report it from the SNMP backend.
+  * Check for Bonjour/mDNS support before anything else, unless the device
+  * was already checked in a previous scan...
   */
 
-  if (!try_connect(&(device->address), device->addrname, 5353))
+  if (!device->cached)
   {
-    debug_printf("DEBUG: %s supports mDNS, not reporting!\n", device->addrname);
+    device->probe_port = 0;
+    cupsArrayAdd(Probes, device);
     return;
   }
 #endif /* __APPLE__ */
@@ -698,60 +846,251 @@ probe_device(snmp_cache_t *device)	/* I - Device */
   * Lookup the device in the match table...
   */
 
-  for (device_uri = (device_uri_t *)cupsArrayFirst(DeviceURIs);
-       device_uri;
-       device_uri = (device_uri_t *)cupsArrayNext(DeviceURIs))
-    if (device->make_and_model &&
-        !regexec(&(device_uri->re), device->make_and_model, 0, NULL, 0))
+  if (match_device_uri(device))
+    return;
+
+ /*
+  * Then queue a probe of the standard ports...
+  */
+
+  cupsArrayAdd(Probes, device);
+}
+
+
+/*
+ * 'probe_devices()' - Probe the ports of all queued devices in parallel.
+ */
+
+static void
+probe_devices(time_t endtime)		/* I - End time for scan */
+{
+  int		i,			/* Looping var */
+		nactive,		/* Number of active probes */
+		status;			/* Probe status */
+  socklen_t	statuslen;		/* Length of status value */
+  snmp_cache_t	*device,		/* Current device */
+		**active;		/* Active probes */
+  struct pollfd	*pfds;			/* Poll file descriptors */
+  double	curtime,		/* Current run time */
+		timeout;		/* Timeout for poll() */
+
+
+  if (cupsArrayCount(Probes) == 0)
+    return;
+
+  active = calloc((size_t)MaxProbes, sizeof(snmp_cache_t *));
+  pfds   = calloc((size_t)MaxProbes, sizeof(struct pollfd));
+
+  if (!active || !pfds)
+  {
+    fputs("ERROR: Unable to allocate memory for port probes.\n", stderr);
+    free(active);
+    free(pfds);
+    return;
+  }
+
+  debug_printf("DEBUG: %.3f Probing %d devices, %d at a time...\n", run_time(),
+               cupsArrayCount(Probes), MaxProbes);
+
+  nactive = 0;
+
+  for (;;)
+  {
+   /*
+    * Fill the window with new probes...
+    */
+
+    while (nactive < MaxProbes &&
+           (device = (snmp_cache_t *)cupsArrayFirst(Probes)) != NULL)
     {
-     /*
-      * Found a match, add the URIs...
-      */
+      cupsArrayRemove(Probes, device);
 
-      for (format = (char *)cupsArrayFirst(device_uri->uris);
-           format;
-	   format = (char *)cupsArrayNext(device_uri->uris))
+      if (start_probe(device))
       {
-        for (uriptr = uri; *format && uriptr < (uri + sizeof(uri) - 1);)
-	  if (*format == '%' && format[1] == 's')
-	  {
-	   /*
-	    * Insert hostname/address...
-	    */
+        active[nactive]       = device;
+        pfds[nactive].fd      = device->probe_fd;
+        pfds[nactive].events  = POLLOUT;
+        pfds[nactive].revents = 0;
+        nactive ++;
+      }
+    }
 
-	    strlcpy(uriptr, device->addrname, sizeof(uri) - (size_t)(uriptr - uri));
-	    uriptr += strlen(uriptr);
-	    format += 2;
-	  }
-	  else
-	    *uriptr++ = *format++;
+    if (nactive == 0)
+      break;
 
-        *uriptr = '\0';
+    if (time(NULL) >= endtime)
+    {
+      debug_printf("DEBUG: %.3f Run time exceeded, abandoning %d probes.\n",
+                   run_time(), nactive + cupsArrayCount(Probes));
+      break;
+    }
 
-        update_cache(device, uri, NULL, NULL);
-      }
+   /*
+    * Wait for the next connection to complete or time out...
+    */
+
+    curtime = run_time();
+    timeout = active[0]->probe_end;
+
+    for (i = 1; i < nactive; i ++)
+      if (active[i]->probe_end < timeout)
+        timeout = active[i]->probe_end;
+
+    timeout -= curtime;
+    if (timeout < 0.0)
+      timeout = 0.0;
 
-      return;
+    if (poll(pfds, (nfds_t)nactive, (int)(1000.0 * timeout) + 1) < 0 &&
+        errno != EINTR && errno != EAGAIN)
+    {
+      fprintf(stderr, "ERROR: %.3f poll() for port probes failed: %s\n",
+              run_time(), strerror(errno));
+      break;
     }
 
- /*
-  * Then try the standard ports...
-  */
+    curtime = run_time();
+
+    for (i = 0; i < nactive;)
+    {
+      device = active[i];
+
+      if (pfds[i].revents)
+      {
+        status    = 0;
+        statuslen = sizeof(status);
+
+        if (getsockopt(device->probe_fd, SOL_SOCKET, SO_ERROR, &status,
+                       &statuslen))
+          status = errno;
+
+       /*
+        * Refused connections give a round-trip time, too...
+        */
+
+        device->rtt = curtime - device->probe_start;
+      }
+      else if (curtime >= device->probe_end)
+        status = ETIMEDOUT;
+      else
+      {
+        i ++;
+        continue;
+      }
+
+      close(device->probe_fd);
+      device->probe_fd = -1;
+
+     /*
+      * Remove from the active list, re-queuing at the front to try the next
+      * port...
+      */
+
+      nactive --;
+      active[i] = active[nactive];
+      pfds[i]   = pfds[nactive];
 
-  if (!try_connect(&(device->address), device->addrname, 9100))
+      if (finish_probe(device, status))
+        cupsArrayInsert(Probes, device);
+    }
+  }
+
+  for (i = 0; i < nactive; i ++)
   {
-    debug_printf("DEBUG: %s supports AppSocket!\n", device->addrname);
+    close(active[i]->probe_fd);
+    active[i]->probe_fd = -1;
+  }
 
-    snprintf(uri, sizeof(uri), "socket://%s", device->addrname);
-    update_cache(device, uri, NULL, NULL);
+  while ((device = (snmp_cache_t *)cupsArrayFirst(Probes)) != NULL)
+    cupsArrayRemove(Probes, device);
+
+  free(active);
+  free(pfds);
+}
+
+
+/*
+ * 'read_device_cache()' - Read the discovery cache file.
+ */
+
+static void
+read_device_cache(void)
+{
+  cups_file_t	*fp;			/* Cache file */
+  char		filename[1024],		/* Cache filename */
+		line[1024],		/* Line from file */
+		*value;			/* Value on line */
+  int		linenum;		/* Line number */
+  const char	*cachedir;		/* CUPS_CACHEDIR env var */
+  snmp_cache_t	*known = NULL;		/* Current known device */
+
+
+  if ((cachedir = getenv("CUPS_CACHEDIR")) == NULL)
+    cachedir = CUPS_CACHEDIR;
+
+  snprintf(filename, sizeof(filename), "%s/snmp.cache", cachedir);
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  {
+    if (errno != ENOENT)
+      fprintf(stderr, "DEBUG: Unable to open \"%s\": %s\n", filename,
+              strerror(errno));
+    return;
   }
-  else if (!try_connect(&(device->address), device->addrname, 515))
+
+  linenum = 0;
+
+  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
   {
-    debug_printf("DEBUG: %s supports LPD!\n", device->addrname);
+    if (!_cups_strcasecmp(line, "<Device") && value)
+    {
+      if (known)
+        break;
 
-    snprintf(uri, sizeof(uri), "lpd://%s/", device->addrname);
-    update_cache(device, uri, NULL, NULL);
+      if ((known = calloc(1, sizeof(snmp_cache_t))) == NULL)
+        break;
+
+      known->addrname = strdup(value);
+      known->probe_fd = -1;
+    }
+    else if (!_cups_strcasecmp(line, "</Device>") && known)
+    {
+     /*
+      * Only remember complete entries that have been seen in the last week...
+      */
+
+      if (known->seen >= (time(NULL) - 7 * 86400) && known->info &&
+          known->make_and_model && known->uri)
+        cupsArrayAdd(KnownDevices, known);
+      else
+        free_device(known);
+
+      known = NULL;
+    }
+    else if (!known || !value)
+      fprintf(stderr, "DEBUG: Bad line %d of %s.\n", linenum, filename);
+    else if (!_cups_strcasecmp(line, "ID") && !known->id)
+      known->id = strdup(value);
+    else if (!_cups_strcasecmp(line, "Info") && !known->info)
+      known->info = strdup(value);
+    else if (!_cups_strcasecmp(line, "Location") && !known->location)
+      known->location = strdup(value);
+    else if (!_cups_strcasecmp(line, "MakeModel") && !known->make_and_model)
+      known->make_and_model = strdup(value);
+    else if (!_cups_strcasecmp(line, "Probed"))
+      known->probed = !_cups_strcasecmp(value, "yes");
+    else if (!_cups_strcasecmp(line, "Seen"))
+      known->seen = (time_t)strtol(value, NULL, 10);
+    else if (!_cups_strcasecmp(line, "URI") && !known->uri)
+      known->uri = strdup(value);
   }
+
+  cupsFileClose(fp);
+
+  if (known)
+    free_device(known);
+
+  debug_printf("DEBUG: Loaded %d known devices from \"%s\".\n",
+               cupsArrayCount(KnownDevices), filename);
 }
 
 
@@ -828,13 +1167,21 @@ read_snmp_conf(const char *address)	/* I - Single address to probe */
         else
 	  add_device_uri(value);
       }
+      else if (!_cups_strcasecmp(line, "DiscoveryCache"))
+        DiscoveryCache = !_cups_strcasecmp(value, "on") ||
+	                 !_cups_strcasecmp(value, "yes") ||
+	                 !_cups_strcasecmp(value, "true");
       else if (!_cups_strcasecmp(line, "HostNameLookups"))
         HostNameLookups = !_cups_strcasecmp(value, "on") ||
 	                  !_cups_strcasecmp(value, "yes") ||
 	                  !_cups_strcasecmp(value, "true") ||
 	                  !_cups_strcasecmp(value, "double");
+      else if (!_cups_strcasecmp(line, "MaxProbes"))
+        MaxProbes = atoi(value);
       else if (!_cups_strcasecmp(line, "MaxRunTime"))
         MaxRunTime = atoi(value);
+      else if (!_cups_strcasecmp(line, "ProbeTimeout"))
+        ProbeTimeout = _cupsStrScand(value, NULL, localeconv());
       else
         fprintf(stderr, "ERROR: Unknown directive %s on line %d of %s!\n",
 	        line, linenum, filename);
@@ -864,6 +1211,14 @@ read_snmp_conf(const char *address)	/* I - Single address to probe */
     fputs("INFO: Using default SNMP Community public\n", stderr);
     add_array(Communities, "public");
   }
+
+  if (MaxProbes < 1)
+    MaxProbes = 1;
+  else if (MaxProbes > 1024)
+    MaxProbes = 1024;
+
+  if (ProbeTimeout < 0.1)
+    ProbeTimeout = 0.1;
 }
 
 
@@ -877,7 +1232,8 @@ read_snmp_response(int fd)		/* I - SNMP socket file descriptor */
   char		addrname[256];		/* Source address name */
   cups_snmp_t	packet;			/* Decoded packet */
   snmp_cache_t	key,			/* Search key */
-		*device;		/* Matching device */
+		*device,		/* Matching device */
+		*known;			/* Device from discovery cache */
 
 
  /*
@@ -924,6 +1280,19 @@ read_snmp_response(int fd)		/* I - SNMP socket file descriptor */
   key.addrname = addrname;
   device       = (snmp_cache_t *)cupsArrayFind(Devices, &key);
 
+ /*
+  * The first reply to our queries gives the round-trip time for the device...
+  */
+
+  if (device && device->query_time > 0.0 && packet.request_id != DEVICE_TYPE)
+  {
+    device->rtt        = run_time() - device->query_time;
+    device->query_time = 0.0;
+
+    debug_printf("DEBUG: %s round-trip time is %.3f seconds.\n", addrname,
+                 device->rtt);
+  }
+
  /*
   * Process the message...
   */
@@ -946,7 +1315,47 @@ read_snmp_response(int fd)		/* I - SNMP socket file descriptor */
 	* Add the device and request the device data...
 	*/
 
-	add_cache(&(packet.address), addrname, NULL, NULL, NULL);
+	if ((device = add_cache(&(packet.address), addrname, NULL, NULL,
+	                        NULL)) == NULL)
+	  return;
+
+	device->rtt = run_time() - QueryTime;
+
+	if ((known = (snmp_cache_t *)cupsArrayFind(KnownDevices,
+	                                           &key)) != NULL)
+	{
+	 /*
+	  * Reuse the information from the last scan - probed URIs still get
+	  * verified by connecting to the same port...
+	  */
+
+	  debug_printf("DEBUG: Using cached information for %s...\n",
+	               addrname);
+
+	  device->cached         = 1;
+	  device->info           = strdup(known->info);
+	  device->make_and_model = strdup(known->make_and_model);
+
+	  if (known->id)
+	    device->id = strdup(known->id);
+
+	  if (known->location)
+	    device->location = strdup(known->location);
+
+	  if (!known->probed)
+	    device->uri = strdup(known->uri);
+	  else
+	  {
+	    int port = strncmp(known->uri, "lpd:", 4) ? 9100 : 515;
+					/* Port to verify */
+
+	    while (ProbePorts[device->probe_port] != port)
+	      device->probe_port ++;
+	  }
+	  break;
+	}
+
+	device->query_time = run_time();
 
 	_cupsSNMPWrite(fd, &(packet.address), CUPS_SNMP_VERSION_1,
 	               packet.community, CUPS_ASN1_GET_REQUEST,
@@ -1216,6 +1625,8 @@ scan_devices(int ipv4,			/* I - SNMP IPv4 socket */
     httpAddrFreeList(addrs);
   }
 
+  QueryTime = run_time();
+
  /*
   * Then read any responses that come in over the next 3 seconds...
   */
@@ -1276,6 +1687,8 @@ scan_devices(int ipv4,			/* I - SNMP IPv4 socket */
 	  device->sent = sent_something = 1;
 	}
 
+      probe_devices(endtime);
+
       if (!sent_something)
         break;
     }
@@ -1286,38 +1699,74 @@ scan_devices(int ipv4,			/* I - SNMP IPv4 socket */
 
 
 /*
- * 'try_connect()' - Try connecting on a port...
+ * 'start_probe()' - Start probing the next port on a device.
  */
 
-static int				/* O - 0 on success or -1 on error */
-try_connect(http_addr_t *addr,		/* I - Socket address */
-            const char  *addrname,	/* I - Hostname or IP address */
-            int         port)		/* I - Port number */
+static int				/* O - 1 if connecting, 0 if done */
+start_probe(snmp_cache_t *device)	/* I - Device */
 {
-  int	fd;				/* Socket */
-  int	status;				/* Connection status */
-
+  int		fd;			/* Socket */
+  http_addr_t	addr;			/* Address and port */
+  double	timeout;		/* Connect timeout */
 
-  debug_printf("DEBUG: %.3f Trying %s://%s:%d...\n", run_time(),
-               port == 515 ? "lpd" : "socket", addrname, port);
 
-  if ((fd = socket(httpAddrFamily(addr), SOCK_STREAM, 0)) < 0)
+  do
   {
-    fprintf(stderr, "ERROR: Unable to create socket: %s\n",
-            strerror(errno));
-    return (-1);
-  }
+    debug_printf("DEBUG: %.3f Trying %s:%d...\n", run_time(), device->addrname,
+                 ProbePorts[device->probe_port]);
+
+    if ((fd = socket(httpAddrFamily(&(device->address)), SOCK_STREAM, 0)) < 0)
+    {
+      fprintf(stderr, "ERROR: Unable to create socket: %s\n",
+              strerror(errno));
+      return (0);
+    }
 
-  _httpAddrSetPort(addr, port);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
-  alarm(1);
+    addr = device->address;
+    _httpAddrSetPort(&addr, ProbePorts[device->probe_port]);
 
-  status = connect(fd, (void *)addr, (socklen_t)httpAddrLength(addr));
+   /*
+    * Allow up to 4 round trips for the connection, bounded by ProbeTimeout...
+    */
+
+    timeout = device->rtt > 0.0 ? 4.0 * device->rtt + 0.1 : ProbeTimeout;
 
-  close(fd);
-  alarm(0);
+    if (timeout > ProbeTimeout)
+      timeout = ProbeTimeout;
+    else if (timeout < 0.25 && ProbeTimeout >= 0.25)
+      timeout = 0.25;
 
-  return (status);
+    device->probe_start = run_time();
+    device->probe_end   = device->probe_start + timeout;
+
+    if (!connect(fd, (void *)&addr, (socklen_t)httpAddrLength(&addr)))
+    {
+      close(fd);
+
+      if (!finish_probe(device, 0))
+        return (0);
+    }
+    else if (errno == EINPROGRESS)
+    {
+      device->probe_fd = fd;
+      return (1);
+    }
+    else
+    {
+      int status = errno;		/* Connection error */
+
+      close(fd);
+
+      if (!finish_probe(device, status))
+        return (0);
+    }
+  }
+  while (device->probe_port < (int)(sizeof(ProbePorts) / sizeof(ProbePorts[0])));
+
+  return (0);
 }
 
 
@@ -1354,3 +1803,79 @@ update_cache(snmp_cache_t *device,	/* I - Device */
 
   list_device(device);
 }
+
+
+/*
+ * 'write_device_cache()' - Write the discovery cache file.
+ */
+
+static void
+write_device_cache(void)
+{
+  int		i;			/* Looping var */
+  cups_file_t	*fp;			/* Cache file */
+  char		filename[1024],		/* Cache filename */
+		tempfile[1024],		/* Temporary filename */
+		value[64];		/* Seen value */
+  const char	*cachedir;		/* CUPS_CACHEDIR env var */
+  cups_array_t	*devices;		/* Current array of devices */
+  snmp_cache_t	*device;		/* Current device */
+
+
+  if ((cachedir = getenv("CUPS_CACHEDIR")) == NULL)
+    cachedir = CUPS_CACHEDIR;
+
+  snprintf(filename, sizeof(filename), "%s/snmp.cache", cachedir);
+  snprintf(tempfile, sizeof(tempfile), "%s/snmp.cache.N", cachedir);
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+  {
+    fprintf(stderr, "DEBUG: Unable to create \"%s\": %s\n", tempfile,
+            strerror(errno));
+    return;
+  }
+
+  cupsFilePuts(fp, "# SNMP discovery cache file for " CUPS_SVERSION "\n");
+  cupsFilePuts(fp, "# DO NOT EDIT THIS FILE.  Remove it to rescan all devices.\n");
+
+ /*
+  * Write devices found in this scan followed by known devices that did not
+  * respond this time...
+  */
+
+  for (i = 0; i < 2; i ++)
+  {
+    devices = i ? KnownDevices : Devices;
+
+    for (device = (snmp_cache_t *)cupsArrayFirst(devices);
+	 device;
+	 device = (snmp_cache_t *)cupsArrayNext(devices))
+    {
+      if (!device->uri || !device->info || !device->make_and_model)
+	continue;
+
+      if (i && cupsArrayFind(Devices, device))
+	continue;
+
+      cupsFilePrintf(fp, "<Device %s>\n", device->addrname);
+      cupsFilePutConf(fp, "URI", device->uri);
+      cupsFilePutConf(fp, "Probed", device->probed ? "yes" : "no");
+      if (device->id)
+	cupsFilePutConf(fp, "ID", device->id);
+      cupsFilePutConf(fp, "Info", device->info);
+      if (device->location)
+	cupsFilePutConf(fp, "Location", device->location);
+      cupsFilePutConf(fp, "MakeModel", device->make_and_model);
+      snprintf(value, sizeof(value), "%ld", (long)device->seen);
+      cupsFilePutConf(fp, "Seen", value);
+      cupsFilePuts(fp, "</Device>\n");
+    }
+  }
+
+  if (cupsFileClose(fp) || rename(tempfile, filename))
+  {
+    fprintf(stderr, "DEBUG: Unable to write \"%s\": %s\n", filename,
+            strerror(errno));
+    unlink(tempfile);
+  }
+}
@@ -34,6 +34,20 @@
 #define DEFAULT_TIMEOUT			5000L
 
 
+/*
+ * WRITE_TRANSFERS and WRITE_SIZE are the default number and size of the
+ * asynchronous bulk OUT transfers that are kept in flight while printing;
+ * they can be changed with the "usb-transfers" and "usb-transfer-size"
+ * options, and "usb-transfers=0" selects the old synchronous writes...
+ */
+
+#define WRITE_TRANSFERS			4
+#define WRITE_TRANSFERS_MAX		32
+#define WRITE_SIZE			65536
+#define WRITE_SIZE_MIN			512
+#define WRITE_SIZE_MAX			1048576
+
+
 /*
  * Local types...
  */
@@ -57,6 +71,14 @@ typedef struct usb_printer_s		/**** USB Printer Data ****/
 typedef int (*usb_cb_t)(usb_printer_t *, const char *, const char *,
                         const void *);
 
+typedef struct usb_write_s		/**** Asynchronous write transfer ****/
+{
+  struct libusb_transfer *transfer;	/* Bulk OUT transfer */
+  unsigned char		*buffer;	/* Data buffer */
+  int			active,		/* Submitted and not yet reaped? */
+			done;		/* Completed? */
+} usb_write_t;
+
 typedef struct usb_globals_s		/* Global USB printer information */
 {
   usb_printer_t		*printer;	/* Printer */
@@ -73,6 +95,12 @@ typedef struct usb_globals_s		/* Global USB printer information */
   int			print_fd;	/* File descriptor to print */
   ssize_t		print_bytes;	/* Print bytes read */
 
+  usb_write_t		*writes;	/* Ring of asynchronous writes */
+  int			num_writes,	/* Number of asynchronous writes */
+			write_size,	/* Size of each asynchronous write */
+			write_next,	/* Next write to submit */
+			write_pending;	/* Number of writes in flight */
+
   int			wait_eof;
   int			drain_output;	/* Drain all pending output */
   int			bidi_flag;	/* 0=unidirectional, 1=bidirectional */
@@ -130,6 +158,7 @@ static int		close_device(usb_printer_t *printer);
 static int		compare_quirks(usb_quirk_t *a, usb_quirk_t *b);
 static usb_printer_t	*find_device(usb_cb_t cb, const void *data);
 static unsigned		find_quirks(int vendor_id, int product_id);
+static void		free_writes(void);
 static int		get_device_id(usb_printer_t *printer, char *buffer,
 			              size_t bufsize);
 static int		list_cb(usb_printer_t *printer, const char *device_uri,
@@ -142,9 +171,12 @@ static int		open_device(usb_printer_t *printer, int verbose);
 static int		print_cb(usb_printer_t *printer, const char *device_uri,
 			         const char *device_id, const void *data);
 static void		*read_thread(void *reference);
+static int		reap_writes(int wait, ssize_t *total_bytes);
 static void		*sidechannel_thread(void *reference);
 static void		soft_reset(void);
 static int		soft_reset_printer(usb_printer_t *printer);
+static int		start_writes(void);
+static void LIBUSB_CALL	write_cb(struct libusb_transfer *transfer);
 
 
 /*
@@ -301,6 +333,45 @@ print_device(const char *uri,		/* I - Device URI */
 	    "after the job via \"usb-no-reattach\" option.\n");
   }
 
+ /*
+  * Set up the ring of asynchronous writes, "usb-transfers=0" uses
+  * synchronous writes instead...
+  */
+
+  g.num_writes = WRITE_TRANSFERS;
+  g.write_size = WRITE_SIZE;
+
+  if ((val = cupsGetOption("usb-transfers", num_opts, opts)) != NULL)
+  {
+    g.num_writes = atoi(val);
+
+    if (g.num_writes < 0)
+      g.num_writes = 0;
+    else if (g.num_writes > WRITE_TRANSFERS_MAX)
+      g.num_writes = WRITE_TRANSFERS_MAX;
+  }
+
+  if ((val = cupsGetOption("usb-transfer-size", num_opts, opts)) != NULL)
+  {
+    g.write_size = atoi(val);
+
+    if (g.write_size < WRITE_SIZE_MIN)
+      g.write_size = WRITE_SIZE_MIN;
+    else if (g.write_size > WRITE_SIZE_MAX)
+      g.write_size = WRITE_SIZE_MAX;
+  }
+
+  if (g.num_writes > 0 && start_writes())
+  {
+    fputs("DEBUG: Unable to allocate asynchronous USB transfers, using "
+          "synchronous writes.\n", stderr);
+    g.num_writes = 0;
+  }
+
+  if (g.num_writes > 0)
+    fprintf(stderr, "DEBUG: Using %d asynchronous USB transfers of %d "
+	    "bytes.\n", g.num_writes, g.write_size);
+
  /*
   * Get the read thread going...
   */
@@ -350,6 +421,19 @@ print_device(const char *uri,		/* I - Device URI */
 
     while (status == CUPS_BACKEND_OK)
     {
+     /*
+      * Reap any finished asynchronous writes, waiting for one to finish
+      * if all of them are in flight...
+      */
+
+      if (g.num_writes > 0 && reap_writes(1, &total_bytes))
+      {
+	_cupsLangPrintFilter(stderr, "ERROR",
+			     _("Unable to send data to printer."));
+	status = CUPS_BACKEND_FAILED;
+	break;
+      }
+
       FD_ZERO(&input_set);
 
       if (!g.print_bytes)
@@ -357,12 +441,12 @@ print_device(const char *uri,		/* I - Device URI */
 
      /*
       * Calculate select timeout...
-      *   If we have data waiting to send timeout is 100ms.
+      *   If we have data waiting to send or in flight timeout is 100ms.
       *   else if we're draining print_fd timeout is 0.
       *   else we're waiting forever...
       */
 
-      if (g.print_bytes)
+      if (g.print_bytes || g.write_pending)
       {
 	tv.tv_sec  = 0;
 	tv.tv_usec = 100000;		/* 100ms */
@@ -421,7 +505,7 @@ print_device(const char *uri,		/* I - Device URI */
       * If drain output has finished send a response...
       */
 
-      if (g.drain_output && !nfds && !g.print_bytes)
+      if (g.drain_output && !nfds && !g.print_bytes && !g.write_pending)
       {
 	/* Send a response... */
 	cupsSideChannelWrite(CUPS_SC_CMD_DRAIN_OUTPUT, CUPS_SC_STATUS_OK, NULL, 0, 1.0);
@@ -434,7 +518,16 @@ print_device(const char *uri,		/* I - Device URI */
 
       if (FD_ISSET(print_fd, &input_set))
       {
-	g.print_bytes = read(print_fd, print_buffer, sizeof(print_buffer));
+        if (g.num_writes > 0)
+        {
+	  print_ptr     = g.writes[g.write_next].buffer;
+	  g.print_bytes = read(print_fd, print_ptr, (size_t)g.write_size);
+        }
+        else
+        {
+	  print_ptr     = print_buffer;
+	  g.print_bytes = read(print_fd, print_buffer, sizeof(print_buffer));
+	}
 
 	if (g.print_bytes < 0)
 	{
@@ -462,13 +555,46 @@ print_device(const char *uri,		/* I - Device URI */
 	  break;
 	}
 
-	print_ptr = print_buffer;
-
 	fprintf(stderr, "DEBUG: Read %d bytes of print data...\n",
 		(int)g.print_bytes);
       }
 
-      if (g.print_bytes)
+      if (g.print_bytes && g.num_writes > 0)
+      {
+       /*
+        * Queue the buffer we just read into...
+	*/
+
+        usb_write_t *w = g.writes + g.write_next;
+					/* Current write */
+
+	libusb_fill_bulk_transfer(w->transfer, g.printer->handle,
+				  (unsigned char)g.printer->write_endp,
+				  w->buffer, (int)g.print_bytes, write_cb, w,
+				  0);
+
+	w->done = 0;
+
+	if ((iostatus = libusb_submit_transfer(w->transfer)) != 0)
+	{
+	  _cupsLangPrintFilter(stderr, "ERROR",
+	                       _("Unable to send data to printer."));
+	  fprintf(stderr, "DEBUG: libusb submit operation returned %x.\n",
+	          iostatus);
+
+	  status = CUPS_BACKEND_FAILED;
+	  break;
+	}
+
+	fprintf(stderr, "DEBUG: Queued %d bytes of print data...\n",
+		(int)g.print_bytes);
+
+	w->active     = 1;
+	g.write_next  = (g.write_next + 1) % g.num_writes;
+	g.write_pending ++;
+	g.print_bytes = 0;
+      }
+      else if (g.print_bytes)
       {
 	iostatus = libusb_bulk_transfer(g.printer->handle,
 					g.printer->write_endp,
@@ -545,6 +671,14 @@ print_device(const char *uri,		/* I - Device URI */
     }
   }
 
+  if (status == CUPS_BACKEND_OK && g.write_pending > 0 &&
+      reap_writes(2, &total_bytes))
+  {
+    _cupsLangPrintFilter(stderr, "ERROR",
+			 _("Unable to send data to printer."));
+    status = CUPS_BACKEND_FAILED;
+  }
+
   fprintf(stderr, "DEBUG: Sent " CUPS_LLFMT " bytes...\n",
           CUPS_LLCAST total_bytes);
 
@@ -667,6 +801,9 @@ close_device(usb_printer_t *printer)	/* I - Printer */
                                         /* Pointer to current configuration */
 
 
+  if (g.writes)
+    free_writes();
+
   if (printer->handle)
   {
    /*
@@ -1036,6 +1173,54 @@ find_quirks(int vendor_id,		/* I - Vendor ID */
 }
 
 
+/*
+ * 'free_writes()' - Cancel and free the asynchronous writes.
+ */
+
+static void
+free_writes(void)
+{
+  int		i,			/* Looping var */
+		busy = 0;		/* Writes still owned by libusb? */
+  usb_write_t	*w;			/* Current write */
+
+
+  for (i = 0, w = g.writes; i < g.num_writes; i ++, w ++)
+  {
+    if (w->active && !w->done)
+    {
+      libusb_cancel_transfer(w->transfer);
+
+      while (!w->done)
+	if (libusb_handle_events_completed(NULL, &w->done) < 0 && !w->done)
+	  break;
+
+      if (!w->done)
+      {
+       /*
+        * Can't safely free a transfer that libusb still owns...
+	*/
+
+        fputs("DEBUG: Unable to cancel pending USB write.\n", stderr);
+        busy = 1;
+        continue;
+      }
+    }
+
+    libusb_free_transfer(w->transfer);
+    free(w->buffer);
+  }
+
+  if (!busy)
+    free(g.writes);
+
+  g.writes        = NULL;
+  g.num_writes    = 0;
+  g.write_next    = 0;
+  g.write_pending = 0;
+}
+
+
 /*
  * 'get_device_id()' - Get the IEEE-1284 device ID for the printer.
  */
@@ -1766,6 +1951,87 @@ static void *read_thread(void *reference)
 }
 
 
+/*
+ * 'reap_writes()' - Collect finished asynchronous writes.
+ *
+ * Writes are reaped in the order they were submitted.  The "wait" argument
+ * is 0 to only collect writes that have already finished, 1 to also wait
+ * until the next write buffer is free, and 2 to wait for all writes.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+reap_writes(int     wait,		/* I - What to wait for */
+            ssize_t *total_bytes)	/* IO - Total bytes written */
+{
+  int		status = 0,		/* Return status */
+		iostatus;		/* Current IO status */
+  usb_write_t	*w;			/* Oldest write */
+  struct timeval tv;			/* Time value */
+
+
+  if (g.write_pending == 0)
+    return (0);
+
+ /*
+  * Process any completed transfers without blocking...
+  */
+
+  tv.tv_sec  = 0;
+  tv.tv_usec = 0;
+
+  libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+
+  while (g.write_pending > 0)
+  {
+    w = g.writes + (g.write_next + g.num_writes - g.write_pending) %
+                   g.num_writes;
+
+    if (!w->done)
+    {
+      if (wait == 0 || (wait == 1 && !g.writes[g.write_next].active))
+        break;
+
+      if ((iostatus = libusb_handle_events_completed(NULL, &w->done)) < 0 &&
+          iostatus != LIBUSB_ERROR_INTERRUPTED)
+      {
+	fprintf(stderr, "DEBUG: libusb event handling returned %x.\n",
+		iostatus);
+        status = -1;
+	break;
+      }
+
+      continue;
+    }
+
+    w->active = 0;
+    g.write_pending --;
+
+    if (w->transfer->status != LIBUSB_TRANSFER_COMPLETED)
+    {
+      fprintf(stderr, "DEBUG: libusb write transfer returned status %d.\n",
+              w->transfer->status);
+      status = -1;
+      break;
+    }
+
+    fprintf(stderr, "DEBUG: Wrote %d bytes of print data...\n",
+	    w->transfer->actual_length);
+
+    *total_bytes += w->transfer->actual_length;
+
+    if (w->transfer->actual_length < w->transfer->length)
+    {
+      fprintf(stderr, "DEBUG: Short USB write of %d of %d bytes.\n",
+              w->transfer->actual_length, w->transfer->length);
+      status = -1;
+      break;
+    }
+  }
+
+  return (status);
+}
+
+
 /*
  * 'sidechannel_thread()' - Handle side-channel requests.
  */
@@ -2012,3 +2278,54 @@ soft_reset_printer(
 
   return (errcode);
 }
+
+
+/*
+ * 'start_writes()' - Allocate the ring of asynchronous writes.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+start_writes(void)
+{
+  int		i;			/* Looping var */
+  usb_write_t	*w;			/* Current write */
+
+
+  if ((g.writes = calloc((size_t)g.num_writes, sizeof(usb_write_t))) == NULL)
+    return (-1);
+
+  g.write_next    = 0;
+  g.write_pending = 0;
+
+  for (i = 0, w = g.writes; i < g.num_writes; i ++, w ++)
+  {
+    if ((w->transfer = libusb_alloc_transfer(0)) == NULL ||
+        (w->buffer = malloc((size_t)g.write_size)) == NULL)
+    {
+      if (w->transfer)
+        libusb_free_transfer(w->transfer);
+
+      g.num_writes = i;
+      free_writes();
+      return (-1);
+    }
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'write_cb()' - Mark an asynchronous write as done.
+ */
+
+static void LIBUSB_CALL
+write_cb(struct libusb_transfer *transfer)
+					/* I - Transfer that finished */
+{
+  usb_write_t	*w = (usb_write_t *)transfer->user_data;
+					/* Write for transfer */
+
+
+  w->done = 1;
+}
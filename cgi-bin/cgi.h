@@ -49,6 +49,9 @@ typedef struct cgi_file_s		/**** Uploaded file data ****/
   size_t	filesize;		/* Size of uploaded file */
 } cgi_file_t;
 
+typedef int (*cgi_main_cb_t)(int argc, char *argv[]);
+					/**** Request callback ****/
+
 
 /*
  * Prototypes...
@@ -77,6 +80,7 @@ extern char		*cgiGetTemplateDir(void);
 extern char		*cgiGetVariable(const char *name);
 extern int		cgiInitialize(void);
 extern int		cgiIsPOST(void);
+extern int		cgiMain(int argc, char *argv[], cgi_main_cb_t cb);
 extern void		cgiMoveJobs(http_t *http, const char *dest, int job_id);
 extern void		cgiPrintCommand(http_t *http, const char *dest,
 			                const char *command, const char *title);
@@ -20,6 +20,7 @@
 
 static void	do_class_op(http_t *http, const char *printer, ipp_op_t op,
 		            const char *title);
+static int	do_request(int argc, char *argv[]);
 static void	show_all_classes(http_t *http, const char *username);
 static void	show_class(http_t *http, const char *printer);
 
@@ -29,7 +30,103 @@ static void	show_class(http_t *http, const char *printer);
  */
 
 int					/* O - Exit status */
-main(void)
+main(int  argc,				/* I - Number of command-line arguments */
+     char *argv[])			/* I - Command-line arguments */
+{
+  return (cgiMain(argc, argv, do_request));
+}
+
+
+/*
+ * 'do_class_op()' - Do a class operation.
+ */
+
+static void
+do_class_op(http_t      *http,		/* I - HTTP connection */
+            const char	*printer,	/* I - Printer name */
+	    ipp_op_t    op,		/* I - Operation to perform */
+	    const char  *title)		/* I - Title of page */
+{
+  ipp_t		*request;		/* IPP request */
+  char		uri[HTTP_MAX_URI],	/* Printer URI */
+		resource[HTTP_MAX_URI];	/* Path for request */
+
+
+ /*
+  * Build a printer request, which requires the following
+  * attributes:
+  *
+  *    attributes-charset
+  *    attributes-natural-language
+  *    printer-uri
+  */
+
+  request = ippNewRequest(op);
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL,
+                   "localhost", 0, "/classes/%s", printer);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+               NULL, uri);
+
+ /*
+  * Do the request and get back a response...
+  */
+
+  snprintf(resource, sizeof(resource), "/classes/%s", printer);
+  ippDelete(cupsDoRequest(http, request, resource));
+
+  if (cupsLastError() == IPP_NOT_AUTHORIZED)
+  {
+    puts("Status: 401\n");
+    exit(0);
+  }
+  else if (cupsLastError() > IPP_OK_CONFLICT)
+  {
+    cgiStartHTML(title);
+    cgiShowIPPError(_("Unable to do maintenance command"));
+  }
+  else
+  {
+   /*
+    * Redirect successful updates back to the printer page...
+    */
+
+    char	url[1024],		/* Printer/class URL */
+		refresh[1024];		/* Refresh URL */
+
+
+    cgiRewriteURL(uri, url, sizeof(url), NULL);
+    cgiFormEncode(uri, url, sizeof(uri));
+    snprintf(refresh, sizeof(refresh), "5;URL=%s", uri);
+    cgiSetVariable("refresh_page", refresh);
+
+    cgiStartHTML(title);
+
+    cgiSetVariable("IS_CLASS", "YES");
+
+    if (op == IPP_PAUSE_PRINTER)
+      cgiCopyTemplateLang("printer-stop.tmpl");
+    else if (op == IPP_RESUME_PRINTER)
+      cgiCopyTemplateLang("printer-start.tmpl");
+    else if (op == CUPS_ACCEPT_JOBS)
+      cgiCopyTemplateLang("printer-accept.tmpl");
+    else if (op == CUPS_REJECT_JOBS)
+      cgiCopyTemplateLang("printer-reject.tmpl");
+    else if (op == IPP_OP_CANCEL_JOBS)
+      cgiCopyTemplateLang("printer-cancel-jobs.tmpl");
+  }
+
+  cgiEndHTML();
+}
+
+
+/*
+ * 'do_request()' - Process a request.
+ */
+
+static int				/* O - Exit status */
+do_request(int  argc,			/* I - Number of command-line arguments */
+           char *argv[])		/* I - Command-line arguments */
 {
   const char	*pclass;		/* Class name */
   const char	*user;			/* Username */
@@ -45,6 +142,9 @@ main(void)
 		};
 
 
+  (void)argc;
+  (void)argv;
+
  /*
   * Get any form variables...
   */
@@ -197,89 +297,6 @@ main(void)
 }
 
 
-/*
- * 'do_class_op()' - Do a class operation.
- */
-
-static void
-do_class_op(http_t      *http,		/* I - HTTP connection */
-            const char	*printer,	/* I - Printer name */
-	    ipp_op_t    op,		/* I - Operation to perform */
-	    const char  *title)		/* I - Title of page */
-{
-  ipp_t		*request;		/* IPP request */
-  char		uri[HTTP_MAX_URI],	/* Printer URI */
-		resource[HTTP_MAX_URI];	/* Path for request */
-
-
- /*
-  * Build a printer request, which requires the following
-  * attributes:
-  *
-  *    attributes-charset
-  *    attributes-natural-language
-  *    printer-uri
-  */
-
-  request = ippNewRequest(op);
-
-  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL,
-                   "localhost", 0, "/classes/%s", printer);
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
-               NULL, uri);
-
- /*
-  * Do the request and get back a response...
-  */
-
-  snprintf(resource, sizeof(resource), "/classes/%s", printer);
-  ippDelete(cupsDoRequest(http, request, resource));
-
-  if (cupsLastError() == IPP_NOT_AUTHORIZED)
-  {
-    puts("Status: 401\n");
-    exit(0);
-  }
-  else if (cupsLastError() > IPP_OK_CONFLICT)
-  {
-    cgiStartHTML(title);
-    cgiShowIPPError(_("Unable to do maintenance command"));
-  }
-  else
-  {
-   /*
-    * Redirect successful updates back to the printer page...
-    */
-
-    char	url[1024],		/* Printer/class URL */
-		refresh[1024];		/* Refresh URL */
-
-
-    cgiRewriteURL(uri, url, sizeof(url), NULL);
-    cgiFormEncode(uri, url, sizeof(uri));
-    snprintf(refresh, sizeof(refresh), "5;URL=%s", uri);
-    cgiSetVariable("refresh_page", refresh);
-
-    cgiStartHTML(title);
-
-    cgiSetVariable("IS_CLASS", "YES");
-
-    if (op == IPP_PAUSE_PRINTER)
-      cgiCopyTemplateLang("printer-stop.tmpl");
-    else if (op == IPP_RESUME_PRINTER)
-      cgiCopyTemplateLang("printer-start.tmpl");
-    else if (op == CUPS_ACCEPT_JOBS)
-      cgiCopyTemplateLang("printer-accept.tmpl");
-    else if (op == CUPS_REJECT_JOBS)
-      cgiCopyTemplateLang("printer-reject.tmpl");
-    else if (op == IPP_OP_CANCEL_JOBS)
-      cgiCopyTemplateLang("printer-cancel-jobs.tmpl");
-  }
-
-  cgiEndHTML();
-}
-
-
 /*
  * 'show_all_classes()' - Show all classes...
  */
@@ -14,6 +14,64 @@
 
 #include "cgi-private.h"
 #include <cups/dir.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+
+/*
+ * Index file format...
+ *
+ * The index file is a header followed by the nodes, terms, postings, and
+ * strings, in that order, using the native byte order.  Each term is a word
+ * found in the help files and its postings list the nodes containing the word
+ * with the number of times it occurs, so searches only look at the words and
+ * nodes that match.  String offsets of 0 mean "none".
+ */
+
+#define HELP_MAGIC	"HELPV3"	/* File identifier */
+#define HELP_BYTEORDER	0x01020304	/* Byte order check */
+
+typedef struct help_fheader_s		/**** Index file header ****/
+{
+  char		magic[8];		/* HELP_MAGIC */
+  unsigned	byteorder,		/* HELP_BYTEORDER */
+		num_nodes,		/* Number of nodes */
+		num_terms,		/* Number of terms */
+		num_postings,		/* Number of postings */
+		num_strings,		/* Number of bytes of strings */
+		reserved;		/* Reserved, 0 */
+} help_fheader_t;
+
+typedef struct help_fnode_s		/**** Index file node ****/
+{
+  long long	mtime,			/* Last modification time */
+		offset,			/* Offset in file */
+		length;			/* Length in bytes */
+  unsigned	filename,		/* Offset of filename */
+		anchor,			/* Offset of anchor */
+		section,		/* Offset of section */
+		text;			/* Offset of text */
+} help_fnode_t;
+
+typedef struct help_fterm_s		/**** Index file term ****/
+{
+  unsigned	text,			/* Offset of word text */
+		first,			/* First posting */
+		count;			/* Number of postings */
+} help_fterm_t;
+
+typedef struct help_fposting_s		/**** Index file posting ****/
+{
+  unsigned	node,			/* Node number */
+		count;			/* Number of occurrences */
+} help_fposting_t;
+
+typedef struct help_fword_s		/**** Word being written ****/
+{
+  const char	*text;			/* Word text */
+  unsigned	node,			/* Node number */
+		count;			/* Number of occurrences */
+} help_fword_t;
 
 
 /*
@@ -126,6 +184,8 @@ static char		help_common_words[][6] =
  */
 
 static help_word_t	*help_add_word(help_node_t *n, const char *text);
+static unsigned		help_add_string(char **strings, size_t *num_strings, size_t *alloc_strings, const char *s);
+static int		help_compare_fwords(help_fword_t *w1, help_fword_t *w2);
 static void		help_delete_node(help_node_t *n);
 static void		help_delete_word(help_word_t *w);
 static int		help_load_directory(help_index_t *hi,
@@ -135,10 +195,12 @@ static int		help_load_file(help_index_t *hi,
 			               const char *filename,
 				       const char *relative,
 				       time_t     mtime);
+static int		help_map_index(help_index_t *hi, const char *hifile);
 static help_node_t	*help_new_node(const char *filename, const char *anchor, const char *section, const char *text, time_t mtime, off_t offset, size_t length) _CUPS_NONNULL(1,3,4);
 static int		help_sort_by_name(help_node_t *p1, help_node_t *p2);
 static int		help_sort_by_score(help_node_t *p1, help_node_t *p2);
 static int		help_sort_words(help_word_t *w1, help_word_t *w2);
+static void		help_unmap_index(help_index_t *hi, int load_words);
 
 
 /*
@@ -165,6 +227,8 @@ helpDeleteIndex(help_index_t *hi)	/* I - Help index */
   cupsArrayDelete(hi->nodes);
   cupsArrayDelete(hi->sorted);
 
+  help_unmap_index(hi, 0);
+
   free(hi);
 }
 
@@ -212,20 +276,8 @@ helpLoadIndex(const char *hifile,	/* I - Index filename */
               const char *directory)	/* I - Directory that is indexed */
 {
   help_index_t	*hi;			/* Help index */
-  cups_file_t	*fp;			/* Current file */
-  char		line[2048],		/* Line from file */
-		*ptr,			/* Pointer into line */
-		*filename,		/* Filename in line */
-		*anchor,		/* Anchor in line */
-		*sectptr,		/* Section pointer in line */
-		section[1024],		/* Section name */
-		*text;			/* Text in line */
-  time_t	mtime;			/* Modification time */
-  off_t		offset;			/* Offset into file */
-  size_t	length;			/* Length in bytes */
   int		update;			/* Update? */
   help_node_t	*node;			/* Current node */
-  help_word_t	*word;			/* Current word */
 
 
  /*
@@ -250,127 +302,8 @@ helpLoadIndex(const char *hifile,	/* I - Index filename */
   * Try loading the existing index file...
   */
 
-  if ((fp = cupsFileOpen(hifile, "r")) != NULL)
-  {
-   /*
-    * Lock the file and then read the first line...
-    */
-
-    cupsFileLock(fp, 1);
-
-    if (cupsFileGets(fp, line, sizeof(line)) && !strcmp(line, "HELPV2"))
-    {
-     /*
-      * Got a valid header line, now read the data lines...
-      */
-
-      node = NULL;
-
-      while (cupsFileGets(fp, line, sizeof(line)))
-      {
-       /*
-	* Each line looks like one of the following:
-	*
-	*     filename mtime offset length "section" "text"
-	*     filename#anchor offset length "text"
-	*     SP count word
-	*/
-
-        if (line[0] == ' ')
-	{
-	 /*
-	  * Read a word in the current node...
-	  */
-
-          if (!node || (ptr = strrchr(line, ' ')) == NULL)
-	    continue;
-
-          if ((word = help_add_word(node, ptr + 1)) != NULL)
-	    word->count = atoi(line + 1);
-        }
-	else
-	{
-	 /*
-	  * Add a node...
-	  */
-
-	  filename = line;
-
-	  if ((ptr = strchr(line, ' ')) == NULL)
-            break;
-
-	  while (isspace(*ptr & 255))
-            *ptr++ = '\0';
-
-	  if ((anchor = strrchr(filename, '#')) != NULL)
-	  {
-            *anchor++ = '\0';
-	    mtime = 0;
-	  }
-	  else
-	    mtime = strtol(ptr, &ptr, 10);
-
-	  offset = strtoll(ptr, &ptr, 10);
-	  length = (size_t)strtoll(ptr, &ptr, 10);
-
-	  while (isspace(*ptr & 255))
-            ptr ++;
-
-          if (!anchor)
-	  {
-	   /*
-	    * Get section...
-	    */
-
-            if (*ptr != '\"')
-	      break;
-
-            ptr ++;
-	    sectptr = ptr;
-
-            while (*ptr && *ptr != '\"')
-	      ptr ++;
-
-            if (*ptr != '\"')
-	      break;
-
-            *ptr++ = '\0';
-
-            strlcpy(section, sectptr, sizeof(section));
-
-	    while (isspace(*ptr & 255))
-              ptr ++;
-          }
-          else
-            section[0] = '\0';
-
-          if (*ptr != '\"')
-	    break;
-
-          ptr ++;
-	  text = ptr;
-
-          while (*ptr && *ptr != '\"')
-	    ptr ++;
-
-          if (*ptr != '\"')
-	    break;
-
-          *ptr++ = '\0';
-
-	  if ((node = help_new_node(filename, anchor, section, text,
-				    mtime, offset, length)) == NULL)
-            break;
-
-	  node->score = -1;
-
-	  cupsArrayAdd(hi->nodes, node);
-        }
-      }
-    }
-
-    cupsFileClose(fp);
-  }
+  if (hifile)
+    help_map_index(hi, hifile);
 
  /*
   * Scan for new/updated files...
@@ -388,11 +321,17 @@ helpLoadIndex(const char *hifile,	/* I - Index filename */
     if (node->score < 0)
     {
      /*
-      * Delete this node...
+      * Delete this node, loading the words of the remaining nodes from the
+      * index file first so that the index can be saved without it...
       */
 
+      if (hi->map)
+        help_unmap_index(hi, 1);
+
       cupsArrayRemove(hi->nodes, node);
       help_delete_node(node);
+
+      update = 1;
     }
 
  /*
@@ -408,7 +347,7 @@ helpLoadIndex(const char *hifile,	/* I - Index filename */
   * Save the index if we updated it...
   */
 
-  if (update)
+  if (update && hifile)
     helpSaveIndex(hi, hifile);
 
  /*
@@ -421,6 +360,9 @@ helpLoadIndex(const char *hifile,	/* I - Index filename */
 
 /*
  * 'helpSaveIndex()' - Save a help index to disk.
+ *
+ * The new index is written to a temporary file and then renamed, so that
+ * programs that have the old index file mapped are not affected.
  */
 
 int					/* O - 0 on success, -1 on error */
@@ -428,69 +370,161 @@ helpSaveIndex(help_index_t *hi,		/* I - Index */
               const char   *hifile)	/* I - Index filename */
 {
   cups_file_t	*fp;			/* Index file */
-  help_node_t	*node;			/* Current node */
+  char		tempfile[1024];		/* Temporary index filename */
+  help_node_t	*node,			/* Current node */
+		*prev = NULL;		/* Previous node */
   help_word_t	*word;			/* Current word */
-
+  help_fheader_t header;		/* File header */
+  help_fnode_t	*fnodes = NULL,		/* File nodes */
+		*fnode;			/* Current file node */
+  help_fterm_t	*fterms = NULL;		/* File terms */
+  help_fposting_t *fpostings = NULL;	/* File postings */
+  help_fword_t	*fwords = NULL;		/* Words */
+  char		*strings = NULL;	/* Strings */
+  size_t	num_nodes,		/* Number of nodes */
+		num_words = 0,		/* Number of words */
+		num_terms = 0,		/* Number of terms */
+		num_strings = 0,	/* Number of bytes of strings */
+		alloc_strings = 0,	/* Allocated bytes of strings */
+		i;			/* Looping var */
+  int		status = -1;		/* Return status */
+
+
+  if (!hi || !hifile)
+    return (-1);
 
  /*
-  * Try creating a new index file...
+  * Make sure all of the words are in memory...
   */
 
-  if ((fp = cupsFileOpen(hifile, "w9")) == NULL)
-    return (-1);
+  if (hi->map)
+    help_unmap_index(hi, 1);
 
  /*
-  * Lock the file while we write it...
+  * Collect the nodes and their words...
   */
 
-  cupsFileLock(fp, 1);
-
-  cupsFilePuts(fp, "HELPV2\n");
+  num_nodes = (size_t)cupsArrayCount(hi->nodes);
 
   for (node = (help_node_t *)cupsArrayFirst(hi->nodes);
        node;
        node = (help_node_t *)cupsArrayNext(hi->nodes))
+    num_words += (size_t)cupsArrayCount(node->words);
+
+  if ((fnodes = calloc(num_nodes + 1, sizeof(help_fnode_t))) == NULL ||
+      (fwords = calloc(num_words + 1, sizeof(help_fword_t))) == NULL ||
+      (fterms = calloc(num_words + 1, sizeof(help_fterm_t))) == NULL ||
+      (fpostings = calloc(num_words + 1, sizeof(help_fposting_t))) == NULL ||
+      !help_add_string(&strings, &num_strings, &alloc_strings, ""))
+    goto cleanup;
+
+  for (node = (help_node_t *)cupsArrayFirst(hi->nodes), fnode = fnodes,
+           num_words = 0;
+       node;
+       prev = node, node = (help_node_t *)cupsArrayNext(hi->nodes), fnode ++)
   {
-   /*
-    * Write the current node with/without the anchor...
-    */
+    fnode->mtime  = (long long)node->mtime;
+    fnode->offset = (long long)node->offset;
+    fnode->length = (long long)node->length;
+
+    if (prev && !strcmp(prev->filename, node->filename))
+      fnode->filename = fnode[-1].filename;
+    else if ((fnode->filename = help_add_string(&strings, &num_strings, &alloc_strings, node->filename)) == 0)
+      goto cleanup;
+
+    if (node->section && prev && prev->section && !strcmp(prev->section, node->section))
+      fnode->section = fnode[-1].section;
+    else if (node->section && (fnode->section = help_add_string(&strings, &num_strings, &alloc_strings, node->section)) == 0)
+      goto cleanup;
 
-    if (node->anchor)
+    if (node->anchor && (fnode->anchor = help_add_string(&strings, &num_strings, &alloc_strings, node->anchor)) == 0)
+      goto cleanup;
+
+    if ((fnode->text = help_add_string(&strings, &num_strings, &alloc_strings, node->text)) == 0)
+      goto cleanup;
+
+    for (word = (help_word_t *)cupsArrayFirst(node->words);
+         word;
+	 word = (help_word_t *)cupsArrayNext(node->words), num_words ++)
     {
-      if (cupsFilePrintf(fp, "%s#%s " CUPS_LLFMT " " CUPS_LLFMT " \"%s\"\n",
-                         node->filename, node->anchor,
-                         CUPS_LLCAST node->offset, CUPS_LLCAST node->length,
-			 node->text) < 0)
-        break;
+      fwords[num_words].text  = word->text;
+      fwords[num_words].node  = (unsigned)(fnode - fnodes);
+      fwords[num_words].count = (unsigned)word->count;
     }
-    else
+  }
+
+ /*
+  * Sort the words to get the postings for each term...
+  */
+
+  qsort(fwords, num_words, sizeof(help_fword_t), (int (*)(const void *, const void *))help_compare_fwords);
+
+  for (i = 0; i < num_words; i ++)
+  {
+    if (!num_terms || _cups_strcasecmp(fwords[i - 1].text, fwords[i].text))
     {
-      if (cupsFilePrintf(fp, "%s %d " CUPS_LLFMT " " CUPS_LLFMT " \"%s\" \"%s\"\n",
-                         node->filename, (int)node->mtime,
-                         CUPS_LLCAST node->offset, CUPS_LLCAST node->length,
-			 node->section ? node->section : "", node->text) < 0)
-        break;
+      if ((fterms[num_terms].text = help_add_string(&strings, &num_strings, &alloc_strings, fwords[i].text)) == 0)
+        goto cleanup;
+
+      fterms[num_terms].first = (unsigned)i;
+      num_terms ++;
     }
 
-   /*
-    * Then write the words associated with the node...
-    */
+    fterms[num_terms - 1].count ++;
 
-    for (word = (help_word_t *)cupsArrayFirst(node->words);
-         word;
-	 word = (help_word_t *)cupsArrayNext(node->words))
-      if (cupsFilePrintf(fp, " %d %s\n", word->count, word->text) < 0)
-        break;
+    fpostings[i].node  = fwords[i].node;
+    fpostings[i].count = fwords[i].count;
+  }
+
+ /*
+  * Write the index to a temporary file...
+  */
+
+  memset(&header, 0, sizeof(header));
+  strlcpy(header.magic, HELP_MAGIC, sizeof(header.magic));
+  header.byteorder    = HELP_BYTEORDER;
+  header.num_nodes    = (unsigned)num_nodes;
+  header.num_terms    = (unsigned)num_terms;
+  header.num_postings = (unsigned)num_words;
+  header.num_strings  = (unsigned)num_strings;
+
+  snprintf(tempfile, sizeof(tempfile), "%s.%d", hifile, (int)getpid());
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+    goto cleanup;
+
+  if (cupsFileWrite(fp, (char *)&header, sizeof(header)) < 0 ||
+      cupsFileWrite(fp, (char *)fnodes, num_nodes * sizeof(help_fnode_t)) < 0 ||
+      cupsFileWrite(fp, (char *)fterms, num_terms * sizeof(help_fterm_t)) < 0 ||
+      cupsFileWrite(fp, (char *)fpostings, num_words * sizeof(help_fposting_t)) < 0 ||
+      cupsFileWrite(fp, strings, num_strings) < 0)
+  {
+    cupsFileClose(fp);
+    unlink(tempfile);
+    goto cleanup;
   }
 
-  cupsFileFlush(fp);
+  if (cupsFileClose(fp) || rename(tempfile, hifile))
+  {
+    unlink(tempfile);
+    goto cleanup;
+  }
 
-  if (cupsFileClose(fp) < 0)
-    return (-1);
-  else if (node)
-    return (-1);
-  else
-    return (0);
+  status = 0;
+
+ /*
+  * Free memory and return...
+  */
+
+  cleanup:
+
+  free(fnodes);
+  free(fwords);
+  free(fterms);
+  free(fpostings);
+  free(strings);
+
+  return (status);
 }
 
 
@@ -578,6 +612,31 @@ helpSearchIndex(help_index_t *hi,	/* I - Index */
   * search index...
   */
 
+  if (hi->map)
+  {
+   /*
+    * Add up the scores from the postings of the matching terms...
+    */
+
+    const help_fheader_t *header = (const help_fheader_t *)hi->map;
+					/* File header */
+    const help_fterm_t	*fterm = (const help_fterm_t *)((const help_fnode_t *)(header + 1) + header->num_nodes);
+					/* Current term */
+    const help_fposting_t *fposting = (const help_fposting_t *)(fterm + header->num_terms);
+					/* Postings */
+    const char		*strings = (const char *)(fposting + header->num_postings);
+					/* Strings */
+    unsigned		i, j;		/* Looping vars */
+
+
+    for (i = header->num_terms; i > 0; i --, fterm ++)
+      if (cgiDoSearch(sc, strings + fterm->text) > 0)
+      {
+        for (j = 0; j < fterm->count; j ++)
+	  hi->mapnodes[fposting[fterm->first + j].node]->score += (int)fposting[fterm->first + j].count;
+      }
+  }
+
   for (; node; node = (help_node_t *)cupsArrayNext(hi->nodes))
     if (section && strcmp(node->section, section))
       continue;
@@ -585,7 +644,7 @@ helpSearchIndex(help_index_t *hi,	/* I - Index */
       continue;
     else
     {
-      matches = cgiDoSearch(sc, node->text);
+      matches = node->score + cgiDoSearch(sc, node->text);
 
       for (word = (help_word_t *)cupsArrayFirst(node->words);
            word;
@@ -620,6 +679,42 @@ helpSearchIndex(help_index_t *hi,	/* I - Index */
 }
 
 
+/*
+ * 'help_add_string()' - Add a string to the index file strings.
+ */
+
+static unsigned				/* O - Offset of string or 0 on error */
+help_add_string(char       **strings,	/* IO - Strings */
+                size_t     *num_strings,/* IO - Number of bytes of strings */
+		size_t     *alloc_strings,
+					/* IO - Allocated bytes of strings */
+		const char *s)		/* I - String to add */
+{
+  size_t	len = strlen(s) + 1;	/* Length of string */
+  unsigned	offset = (unsigned)*num_strings;
+					/* Offset of string */
+
+
+  if ((*num_strings + len) > *alloc_strings)
+  {
+    size_t	alloc = 2 * *alloc_strings + len + 65536;
+					/* New allocation */
+    char	*temp;			/* New strings */
+
+    if ((temp = realloc(*strings, alloc)) == NULL)
+      return (0);
+
+    *strings       = temp;
+    *alloc_strings = alloc;
+  }
+
+  memcpy(*strings + *num_strings, s, len);
+  *num_strings += len;
+
+  return (offset ? offset : 1);
+}
+
+
 /*
  * 'help_add_word()' - Add a word to a node.
  */
@@ -673,6 +768,26 @@ help_add_word(help_node_t *n,		/* I - Node */
 }
 
 
+/*
+ * 'help_compare_fwords()' - Compare words by text and node.
+ */
+
+static int				/* O - Result of comparison */
+help_compare_fwords(help_fword_t *w1,	/* I - First word */
+                    help_fword_t *w2)	/* I - Second word */
+{
+  int	diff;				/* Difference */
+
+
+  if ((diff = _cups_strcasecmp(w1->text, w2->text)) != 0)
+    return (diff);
+  else if (w1->node < w2->node)
+    return (-1);
+  else
+    return (w1->node > w2->node);
+}
+
+
 /*
  * 'help_delete_node()' - Free all memory used by a node.
  */
@@ -857,6 +972,9 @@ help_load_file(
   if ((fp = cupsFileOpen(filename, "r")) == NULL)
     return (-1);
 
+  if (hi->map)
+    help_unmap_index(hi, 1);
+
   node   = NULL;
   offset = 0;
 
@@ -1169,6 +1287,127 @@ help_load_file(
 }
 
 
+/*
+ * 'help_map_index()' - Map an index file and load its nodes.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+help_map_index(help_index_t *hi,	/* I - Index */
+               const char   *hifile)	/* I - Index filename */
+{
+  int			fd;		/* Index file */
+  struct stat		fileinfo;	/* Index file information */
+  void			*map;		/* Mapped index file */
+  const help_fheader_t	*header;	/* File header */
+  const help_fnode_t	*fnode;		/* Current node */
+  const help_fterm_t	*fterms,	/* Terms */
+			*fterm;		/* Current term */
+  const help_fposting_t	*fpostings;	/* Postings */
+  const char		*strings;	/* Strings */
+  size_t		length;		/* Expected length of file */
+  unsigned		i;		/* Looping var */
+  help_node_t		*node;		/* New node */
+
+
+  if ((fd = open(hifile, O_RDONLY)) < 0)
+    return (0);
+
+  if (fstat(fd, &fileinfo) || fileinfo.st_size < (off_t)sizeof(help_fheader_t) ||
+      (off_t)(size_t)fileinfo.st_size != fileinfo.st_size ||
+      (map = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    close(fd);
+    return (0);
+  }
+
+  close(fd);
+
+  hi->map    = map;
+  hi->maplen = (size_t)fileinfo.st_size;
+
+ /*
+  * Validate the header and contents...
+  */
+
+  header = (const help_fheader_t *)map;
+  length = sizeof(help_fheader_t) +
+           (size_t)header->num_nodes * sizeof(help_fnode_t) +
+           (size_t)header->num_terms * sizeof(help_fterm_t) +
+           (size_t)header->num_postings * sizeof(help_fposting_t) +
+           (size_t)header->num_strings;
+
+  if (memcmp(header->magic, HELP_MAGIC, sizeof(HELP_MAGIC)) ||
+      header->byteorder != HELP_BYTEORDER || length != hi->maplen ||
+      header->num_strings < 1)
+    goto error;
+
+  fnode     = (const help_fnode_t *)(header + 1);
+  fterms    = (const help_fterm_t *)(fnode + header->num_nodes);
+  fpostings = (const help_fposting_t *)(fterms + header->num_terms);
+  strings   = (const char *)(fpostings + header->num_postings);
+
+  if (strings[header->num_strings - 1])
+    goto error;
+
+  for (i = header->num_terms, fterm = fterms; i > 0; i --, fterm ++)
+    if (fterm->text >= header->num_strings || fterm->first > header->num_postings ||
+        fterm->count > (header->num_postings - fterm->first))
+      goto error;
+
+  for (i = 0; i < header->num_postings; i ++)
+    if (fpostings[i].node >= header->num_nodes)
+      goto error;
+
+ /*
+  * Create the nodes...
+  */
+
+  if ((hi->mapnodes = calloc((size_t)header->num_nodes + 1, sizeof(help_node_t *))) == NULL)
+    goto error;
+
+  for (i = 0; i < header->num_nodes; i ++, fnode ++)
+  {
+    if (!fnode->filename || fnode->filename >= header->num_strings ||
+        fnode->anchor >= header->num_strings ||
+        fnode->section >= header->num_strings ||
+        !fnode->text || fnode->text >= header->num_strings)
+      goto error;
+
+    if ((node = help_new_node(strings + fnode->filename,
+                              fnode->anchor ? strings + fnode->anchor : NULL,
+			      fnode->section ? strings + fnode->section : NULL,
+			      strings + fnode->text, (time_t)fnode->mtime,
+			      (off_t)fnode->offset, (size_t)fnode->length)) == NULL)
+      goto error;
+
+    node->score = -1;
+
+    hi->mapnodes[i] = node;
+
+    cupsArrayAdd(hi->nodes, node);
+  }
+
+  return (1);
+
+ /*
+  * If we get here the file is not usable, start over with an empty index...
+  */
+
+  error:
+
+  for (node = (help_node_t *)cupsArrayFirst(hi->nodes);
+       node;
+       node = (help_node_t *)cupsArrayNext(hi->nodes))
+    help_delete_node(node);
+
+  cupsArrayClear(hi->nodes);
+
+  help_unmap_index(hi, 0);
+
+  return (0);
+}
+
+
 /*
  * 'help_new_node()' - Create a new node and add it to an index.
  */
@@ -1262,3 +1501,47 @@ help_sort_words(help_word_t *w1,	/* I - Second word */
 {
   return (_cups_strcasecmp(w1->text, w2->text));
 }
+
+
+/*
+ * 'help_unmap_index()' - Unmap the index file, optionally loading the words
+ *                        for each node.
+ */
+
+static void
+help_unmap_index(help_index_t *hi,	/* I - Index */
+                 int          load_words)
+					/* I - Load words into the nodes? */
+{
+  const help_fheader_t	*header;	/* File header */
+  const help_fterm_t	*fterm;		/* Current term */
+  const help_fposting_t	*fposting,	/* Current posting */
+			*fpostings;	/* Postings */
+  const char		*strings;	/* Strings */
+  unsigned		i, j;		/* Looping vars */
+  help_word_t		*word;		/* Current word */
+
+
+  if (!hi->map)
+    return;
+
+  if (load_words && hi->mapnodes)
+  {
+    header    = (const help_fheader_t *)hi->map;
+    fterm     = (const help_fterm_t *)((const help_fnode_t *)(header + 1) + header->num_nodes);
+    fpostings = (const help_fposting_t *)(fterm + header->num_terms);
+    strings   = (const char *)(fpostings + header->num_postings);
+
+    for (i = header->num_terms; i > 0; i --, fterm ++)
+      for (j = fterm->count, fposting = fpostings + fterm->first; j > 0; j --, fposting ++)
+	if ((word = help_add_word(hi->mapnodes[fposting->node], strings + fterm->text)) != NULL)
+	  word->count = (int)fposting->count;
+  }
+
+  munmap(hi->map, hi->maplen);
+  free(hi->mapnodes);
+
+  hi->map      = NULL;
+  hi->maplen   = 0;
+  hi->mapnodes = NULL;
+}
@@ -53,6 +53,9 @@ typedef struct help_index_s		/**** Help index structure ****/
   int		search;			/* 1 = search index, 0 = normal */
   cups_array_t	*nodes;			/* Nodes sorted by filename */
   cups_array_t	*sorted;		/* Nodes sorted by score + text */
+  void		*map;			/* Mapped index file, if any */
+  size_t	maplen;			/* Length of mapped index file */
+  help_node_t	**mapnodes;		/* Nodes in index file order */
 } help_index_t;
 
 
@@ -14,6 +14,13 @@
 #include "cgi-private.h"
 
 
+/*
+ * Local functions...
+ */
+
+static int	do_request(int argc, char *argv[]);
+
+
 /*
  * 'main()' - Main entry for CGI.
  */
@@ -21,6 +28,18 @@
 int					/* O - Exit status */
 main(int  argc,				/* I - Number of command-line arguments */
      char *argv[])			/* I - Command-line arguments */
+{
+  return (cgiMain(argc, argv, do_request));
+}
+
+
+/*
+ * 'do_request()' - Process a request.
+ */
+
+static int				/* O - Exit status */
+do_request(int  argc,			/* I - Number of command-line arguments */
+           char *argv[])		/* I - Command-line arguments */
 {
   help_index_t	*hi,			/* Help index */
 		*si;			/* Search index */
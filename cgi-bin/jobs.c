@@ -19,6 +19,7 @@
  */
 
 static void	do_job_op(http_t *http, int job_id, ipp_op_t op);
+static int	do_request(int argc, char *argv[]);
 
 
 /*
@@ -26,7 +27,99 @@ static void	do_job_op(http_t *http, int job_id, ipp_op_t op);
  */
 
 int					/* O - Exit status */
-main(void)
+main(int  argc,				/* I - Number of command-line arguments */
+     char *argv[])			/* I - Command-line arguments */
+{
+  return (cgiMain(argc, argv, do_request));
+}
+
+
+/*
+ * 'do_job_op()' - Do a job operation.
+ */
+
+static void
+do_job_op(http_t      *http,		/* I - HTTP connection */
+          int         job_id,		/* I - Job ID */
+	  ipp_op_t    op)		/* I - Operation to perform */
+{
+  ipp_t		*request;		/* IPP request */
+  char		uri[HTTP_MAX_URI];	/* Job URI */
+  const char	*user;			/* Username */
+
+
+ /*
+  * Build a job request, which requires the following
+  * attributes:
+  *
+  *    attributes-charset
+  *    attributes-natural-language
+  *    job-uri or printer-uri (purge-jobs)
+  *    requesting-user-name
+  */
+
+  request = ippNewRequest(op);
+
+  snprintf(uri, sizeof(uri), "ipp://localhost/jobs/%d", job_id);
+
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "job-uri",
+               NULL, uri);
+
+  if ((user = getenv("REMOTE_USER")) == NULL)
+    user = "guest";
+
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+               "requesting-user-name", NULL, user);
+
+ /*
+  * Do the request and get back a response...
+  */
+
+  ippDelete(cupsDoRequest(http, request, "/jobs"));
+
+  if (cupsLastError() <= IPP_OK_CONFLICT && getenv("HTTP_REFERER"))
+  {
+   /*
+    * Redirect successful updates back to the parent page...
+    */
+
+    char	url[1024];		/* Encoded URL */
+
+
+    strlcpy(url, "5;URL=", sizeof(url));
+    cgiFormEncode(url + 6, getenv("HTTP_REFERER"), sizeof(url) - 6);
+    cgiSetVariable("refresh_page", url);
+  }
+  else if (cupsLastError() == IPP_NOT_AUTHORIZED)
+  {
+    puts("Status: 401\n");
+    exit(0);
+  }
+
+  cgiStartHTML(cgiText(_("Jobs")));
+
+  if (cupsLastError() > IPP_OK_CONFLICT)
+    cgiShowIPPError(_("Job operation failed"));
+  else if (op == IPP_CANCEL_JOB)
+    cgiCopyTemplateLang("job-cancel.tmpl");
+  else if (op == IPP_HOLD_JOB)
+    cgiCopyTemplateLang("job-hold.tmpl");
+  else if (op == IPP_RELEASE_JOB)
+    cgiCopyTemplateLang("job-release.tmpl");
+  else if (op == IPP_RESTART_JOB)
+    cgiCopyTemplateLang("job-restart.tmpl");
+
+  cgiEndHTML();
+}
+
+
+/*
+ * 'do_request()' - Process a request.
+ */
+
+static int				/* O - Exit status */
+do_request(int  argc,			/* I - Number of command-line arguments */
+           char *argv[])		/* I - Command-line arguments */
 {
   http_t	*http;			/* Connection to the server */
   const char	*op;			/* Operation name */
@@ -34,6 +127,9 @@ main(void)
   int		job_id;			/* Job ID */
 
 
+  (void)argc;
+  (void)argv;
+
  /*
   * Get any form variables...
   */
@@ -116,82 +212,3 @@ main(void)
 
   return (0);
 }
-
-
-/*
- * 'do_job_op()' - Do a job operation.
- */
-
-static void
-do_job_op(http_t      *http,		/* I - HTTP connection */
-          int         job_id,		/* I - Job ID */
-	  ipp_op_t    op)		/* I - Operation to perform */
-{
-  ipp_t		*request;		/* IPP request */
-  char		uri[HTTP_MAX_URI];	/* Job URI */
-  const char	*user;			/* Username */
-
-
- /*
-  * Build a job request, which requires the following
-  * attributes:
-  *
-  *    attributes-charset
-  *    attributes-natural-language
-  *    job-uri or printer-uri (purge-jobs)
-  *    requesting-user-name
-  */
-
-  request = ippNewRequest(op);
-
-  snprintf(uri, sizeof(uri), "ipp://localhost/jobs/%d", job_id);
-
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "job-uri",
-               NULL, uri);
-
-  if ((user = getenv("REMOTE_USER")) == NULL)
-    user = "guest";
-
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-               "requesting-user-name", NULL, user);
-
- /*
-  * Do the request and get back a response...
-  */
-
-  ippDelete(cupsDoRequest(http, request, "/jobs"));
-
-  if (cupsLastError() <= IPP_OK_CONFLICT && getenv("HTTP_REFERER"))
-  {
-   /*
-    * Redirect successful updates back to the parent page...
-    */
-
-    char	url[1024];		/* Encoded URL */
-
-
-    strlcpy(url, "5;URL=", sizeof(url));
-    cgiFormEncode(url + 6, getenv("HTTP_REFERER"), sizeof(url) - 6);
-    cgiSetVariable("refresh_page", url);
-  }
-  else if (cupsLastError() == IPP_NOT_AUTHORIZED)
-  {
-    puts("Status: 401\n");
-    exit(0);
-  }
-
-  cgiStartHTML(cgiText(_("Jobs")));
-
-  if (cupsLastError() > IPP_OK_CONFLICT)
-    cgiShowIPPError(_("Job operation failed"));
-  else if (op == IPP_CANCEL_JOB)
-    cgiCopyTemplateLang("job-cancel.tmpl");
-  else if (op == IPP_HOLD_JOB)
-    cgiCopyTemplateLang("job-hold.tmpl");
-  else if (op == IPP_RELEASE_JOB)
-    cgiCopyTemplateLang("job-release.tmpl");
-  else if (op == IPP_RESTART_JOB)
-    cgiCopyTemplateLang("job-restart.tmpl");
-
-  cgiEndHTML();
-}
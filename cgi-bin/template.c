@@ -12,26 +12,85 @@
 #include <regex.h>
 
 
+/*
+ * Local types...
+ */
+
+typedef enum cgi_opcode_e		/**** Template operations ****/
+{
+  CGI_OP_TEXT,				/* Literal text */
+  CGI_OP_VALUE,				/* {name} */
+  CGI_OP_TEST,				/* {name?true:false} and friends */
+  CGI_OP_LOOP,				/* {[name]...} */
+  CGI_OP_ELEMENT,			/* # in a comparison string */
+  CGI_OP_SIZE,				/* {#name} in a comparison string */
+  CGI_OP_ARRAY,				/* {?name} or {name-N} in a comparison string */
+  CGI_OP_VARIABLE			/* {name} in a comparison string */
+} cgi_opcode_t;
+
+typedef struct cgi_node_s		/**** Compiled template node ****/
+{
+  struct cgi_node_s	*next;		/* Next node */
+  cgi_opcode_t		opcode;		/* Operation */
+  char			op;		/* Comparison operator */
+  int			uriencode,	/* Encode as URI? */
+			indexed,	/* Use "index" instead of the element? */
+			index;		/* Array index or loop count */
+  char			*data;		/* Text or variable name */
+  size_t		length;		/* Length of text */
+  struct cgi_node_s	*child,		/* Loop body or true part */
+			*alt,		/* False part */
+			*compare;	/* Comparison string */
+} cgi_node_t;
+
+typedef struct cgi_template_s		/**** Compiled template file ****/
+{
+  char			*filename;	/* Template filename */
+  int			error;		/* errno value if the file could not be opened */
+  cgi_node_t		*nodes;		/* Compiled template */
+} cgi_template_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*cgi_templates = NULL;
+					/* Templates that have been compiled */
+
+
 /*
  * Local functions...
  */
 
-static void	cgi_copy(FILE *out, FILE *in, int element, char term,
-		         int indent);
+static void	cgi_add_text(cgi_node_t ***tail, char *text, size_t *textlen);
+static int	cgi_compare_templates(cgi_template_t *a, cgi_template_t *b);
+static cgi_node_t *cgi_compile(FILE *in, char term);
+static void	cgi_copy(FILE *out, cgi_node_t *node, int element);
+static cgi_template_t *cgi_get_template(const char *filename);
+static cgi_node_t *cgi_new_node(cgi_node_t ***tail, cgi_opcode_t opcode,
+		                const char *data, size_t length);
 static void	cgi_puts(const char *s, FILE *out);
 static void	cgi_puturi(const char *s, FILE *out);
+static void	cgi_string(cgi_node_t *node, int element, char *buffer,
+		           size_t bufsize);
+static const char *cgi_value(cgi_node_t *node, int element, char *buffer,
+		             size_t bufsize);
 
 
 /*
  * 'cgiCopyTemplateFile()' - Copy a template file and replace all the
  *                           '{variable}' strings with the variable value.
+ *
+ * Template files are compiled the first time they are used, so copying the
+ * same template more than once only reads the file once.
  */
 
 void
 cgiCopyTemplateFile(FILE       *out,	/* I - Output file */
                     const char *tmpl)	/* I - Template file to read */
 {
-  FILE	*in;				/* Input file */
+  cgi_template_t	*t;		/* Compiled template */
 
 
   fprintf(stderr, "DEBUG2: cgiCopyTemplateFile(out=%p, tmpl=\"%s\")\n", out,
@@ -48,24 +107,23 @@ cgiCopyTemplateFile(FILE       *out,	/* I - Output file */
   * Open the template file...
   */
 
-  if ((in = fopen(tmpl, "r")) == NULL)
+  if ((t = cgi_get_template(tmpl)) == NULL || t->error)
   {
+    if (t)
+      errno = t->error;
+
     fprintf(stderr, "ERROR: Unable to open template file \"%s\" - %s\n",
             tmpl ? tmpl : "(null)", strerror(errno));
     return;
   }
 
  /*
-  * Parse the file to the end...
+  * Copy the template...
   */
 
-  cgi_copy(out, in, 0, 0, 0);
+  cgi_copy(out, t->nodes, 0);
 
- /*
-  * Close the template file and return...
-  */
-
-  fclose(in);
+  fflush(out);
 }
 
 
@@ -81,7 +139,7 @@ cgiCopyTemplateLang(const char *tmpl)	/* I - Base filename */
 		*locptr;		/* Pointer into locale name */
   const char	*directory,		/* Directory for templates */
 		*lang;			/* Language */
-  FILE		*in;			/* Input file */
+  cgi_template_t *t;			/* Compiled template */
 
 
   fprintf(stderr, "DEBUG2: cgiCopyTemplateLang(tmpl=\"%s\")\n",
@@ -112,15 +170,15 @@ cgiCopyTemplateLang(const char *tmpl)	/* I - Base filename */
   directory = cgiGetTemplateDir();
 
   snprintf(filename, sizeof(filename), "%s%s/%s", directory, locale, tmpl);
-  if ((in = fopen(filename, "r")) == NULL)
+  if ((t = cgi_get_template(filename)) == NULL || t->error)
   {
     locale[3] = '\0';
 
     snprintf(filename, sizeof(filename), "%s%s/%s", directory, locale, tmpl);
-    if ((in = fopen(filename, "r")) == NULL)
+    if ((t = cgi_get_template(filename)) == NULL || t->error)
     {
       snprintf(filename, sizeof(filename), "%s/%s", directory, tmpl);
-      in = fopen(filename, "r");
+      t = cgi_get_template(filename);
     }
   }
 
@@ -130,24 +188,23 @@ cgiCopyTemplateLang(const char *tmpl)	/* I - Base filename */
   * Open the template file...
   */
 
-  if (!in)
+  if (!t || t->error)
   {
+    if (t)
+      errno = t->error;
+
     fprintf(stderr, "ERROR: Unable to open template file \"%s\" - %s\n",
             filename, strerror(errno));
     return;
   }
 
  /*
-  * Parse the file to the end...
+  * Copy the template...
   */
 
-  cgi_copy(stdout, in, 0, 0, 0);
-
- /*
-  * Close the template file and return...
-  */
+  cgi_copy(stdout, t->nodes, 0);
 
-  fclose(in);
+  fflush(stdout);
 }
 
 
@@ -196,41 +253,68 @@ cgiSetServerVersion(void)
 
 
 /*
- * 'cgi_copy()' - Copy the template file, substituting as needed...
+ * 'cgi_add_text()' - Add any pending literal text to a node list.
  */
 
 static void
-cgi_copy(FILE *out,			/* I - Output file */
-         FILE *in,			/* I - Input file */
-	 int  element,			/* I - Element number (0 to N) */
-	 char term,			/* I - Terminating character */
-	 int  indent)			/* I - Debug info indentation */
+cgi_add_text(cgi_node_t ***tail,	/* IO - End of node list */
+             char       *text,		/* I  - Pending text */
+	     size_t     *textlen)	/* IO - Length of pending text */
+{
+  if (*textlen > 0)
+  {
+    cgi_new_node(tail, CGI_OP_TEXT, text, *textlen);
+    *textlen = 0;
+  }
+}
+
+
+/*
+ * 'cgi_compare_templates()' - Compare two compiled templates.
+ */
+
+static int				/* O - Result of comparison */
+cgi_compare_templates(
+    cgi_template_t *a,			/* I - First template */
+    cgi_template_t *b)			/* I - Second template */
+{
+  return (strcmp(a->filename, b->filename));
+}
+
+
+/*
+ * 'cgi_compile()' - Compile the template file up to the terminating
+ *                   character...
+ */
+
+static cgi_node_t *			/* O - List of nodes */
+cgi_compile(FILE *in,			/* I - Input file */
+	    char term)			/* I - Terminating character */
 {
   int		ch;			/* Character from file */
-  char		op;			/* Operation */
   char		name[255],		/* Name of variable */
 		*nameptr,		/* Pointer into name */
 		innername[255],		/* Inner comparison name */
 		*innerptr,		/* Pointer into inner name */
 		*s;			/* String pointer */
-  const char	*value;			/* Value of variable */
-  const char	*innerval;		/* Inner value */
-  const char	*outptr;		/* Output string pointer */
-  char		outval[1024],		/* Formatted output string */
-		compare[1024];		/* Comparison string */
-  int		result;			/* Result of comparison */
+  char		text[1024];		/* Pending literal text */
+  size_t	textlen = 0;		/* Length of pending text */
   int		uriencode;		/* Encode as URI */
-  regex_t	re;			/* Regular expression to match */
-
+  cgi_node_t	*nodes = NULL,		/* List of nodes */
+		**tail = &nodes,	/* End of list */
+		*node,			/* Current node */
+		**ctail;		/* End of comparison string */
 
-  fprintf(stderr, "DEBUG2: %*sStarting at file position %ld...\n", indent, "",
-          ftell(in));
 
  /*
   * Parse the file to the end...
   */
 
   while ((ch = getc(in)) != EOF)
+  {
+    if (textlen >= (sizeof(text) - 1))
+      cgi_add_text(&tail, text, &textlen);
+
     if (ch == term)
       break;
     else if (ch == '{')
@@ -255,163 +339,69 @@ cgi_copy(FILE *out,			/* I - Output file */
 
       if (s == name && isspace(ch & 255))
       {
-        fprintf(stderr, "DEBUG2: %*sLone { at %ld...\n", indent, "", ftell(in));
-
-        if (out)
-	{
-          putc('{', out);
-	  putc(ch, out);
-        }
+       /*
+        * Lone { is copied as-is...
+	*/
 
+        text[textlen ++] = '{';
+        text[textlen ++] = (char)ch;
 	continue;
       }
 
-      if (ch == '}')
-	fprintf(stderr, "DEBUG2: %*s\"{%s}\" at %ld...\n", indent, "", name,
-        	ftell(in));
-
-     /*
-      * See if it has a value...
-      */
+      cgi_add_text(&tail, text, &textlen);
 
-      if (name[0] == '?')
+      if (name[0] == '[')
       {
        /*
-        * Insert value only if it exists...
+        * Loop for # of elements...
 	*/
 
-	if ((nameptr = strrchr(name, '-')) != NULL && isdigit(nameptr[1] & 255))
-	{
-	  *nameptr++ = '\0';
+        node = cgi_new_node(&tail, CGI_OP_LOOP, name + 1, strlen(name + 1));
 
-	  if ((value = cgiGetArray(name + 1, atoi(nameptr) - 1)) != NULL)
-	    outptr = value;
-	  else
-	  {
-	    outval[0] = '\0';
-	    outptr    = outval;
-	  }
-	}
-        else if ((value = cgiGetArray(name + 1, element)) != NULL)
-	  outptr = value;
-	else
+        if (node && isdigit(name[1] & 255))
 	{
-	  outval[0] = '\0';
-	  outptr    = outval;
+	  node->indexed = 1;
+	  node->index   = atoi(name + 1);
 	}
-      }
-      else if (name[0] == '#')
-      {
-       /*
-        * Insert count...
-	*/
 
-        if (name[1])
-          sprintf(outval, "%d", cgiGetSize(name + 1));
+        if (node)
+	  node->child = cgi_compile(in, '}');
 	else
-	  sprintf(outval, "%d", element + 1);
+	  cgi_compile(in, '}');
 
-        outptr = outval;
+        continue;
       }
-      else if (name[0] == '[')
-      {
-       /*
-        * Loop for # of elements...
-	*/
-
-	int  i;		/* Looping var */
-        long pos;	/* File position */
-	int  count;	/* Number of elements */
-
-
-        if (isdigit(name[1] & 255))
-	  count = atoi(name + 1);
-	else
-          count = cgiGetSize(name + 1);
-
-	pos = ftell(in);
-
-        fprintf(stderr, "DEBUG2: %*sLooping on \"%s\" at %ld, count=%d...\n",
-	        indent, "", name + 1, pos, count);
 
-        if (count > 0)
-	{
-          for (i = 0; i < count; i ++)
-	  {
-	    if (i)
-	      fseek(in, pos, SEEK_SET);
+     /*
+      * Variables and {?variable} lookups can name a specific array element...
+      */
 
-	    cgi_copy(out, in, i, '}', indent + 2);
-	  }
-        }
-	else
-	  cgi_copy(NULL, in, 0, '}', indent + 2);
+      if (name[0] != '#' && name[0] != '$' &&
+          (nameptr = strrchr(name, '-')) != NULL && isdigit(nameptr[1] & 255))
+        *nameptr++ = '\0';
+      else
+        nameptr = NULL;
 
-        fprintf(stderr, "DEBUG2: %*sFinished looping on \"%s\"...\n", indent,
-	        "", name + 1);
+      if ((node = cgi_new_node(NULL, ch == '}' ? CGI_OP_VALUE : CGI_OP_TEST,
+                               name, strlen(name))) == NULL)
+        return (nodes);
 
-        continue;
-      }
-      else if (name[0] == '$')
-      {
-       /*
-        * Insert cookie value or nothing if not defined.
-	*/
+      node->uriencode = uriencode;
 
-        if ((value = cgiGetCookie(name + 1)) != NULL)
-	  outptr = value;
-	else
-	{
-	  outval[0] = '\0';
-	  outptr    = outval;
-	}
-      }
-      else
+      if (nameptr)
       {
-       /*
-        * Insert variable or variable name (if element is NULL)...
-	*/
-
-	if ((nameptr = strrchr(name, '-')) != NULL && isdigit(nameptr[1] & 255))
-	{
-	  *nameptr++ = '\0';
-	  if ((value = cgiGetArray(name, atoi(nameptr) - 1)) == NULL)
-          {
-	    snprintf(outval, sizeof(outval), "{%s}", name);
-	    outptr = outval;
-	  }
-	  else
-	    outptr = value;
-	}
-	else if ((value = cgiGetArray(name, element)) == NULL)
-        {
-	  snprintf(outval, sizeof(outval), "{%s}", name);
-	  outptr = outval;
-	}
-	else
-	  outptr = value;
+        node->indexed = 1;
+        node->index   = atoi(nameptr) - 1;
       }
 
-     /*
-      * See if the terminating character requires another test...
-      */
-
       if (ch == '}')
       {
        /*
         * End of substitution...
         */
 
-	if (out)
-	{
-	  if (uriencode)
-	    cgi_puturi(outptr, out);
-	  else if (!_cups_strcasecmp(name, "?cupsdconf_default"))
-	    fputs(outptr, stdout);
-	  else
-	    cgi_puts(outptr, out);
-        }
-
+        *tail = node;
+	tail  = &(node->next);
         continue;
       }
 
@@ -426,39 +416,27 @@ cgi_copy(FILE *out,			/* I - Output file */
       *   {name~refex?true:false}    Regex match
       */
 
-      op = (char)ch;
+      node->op = (char)ch;
 
-      if (ch == '?')
+      if (ch != '?')
       {
        /*
-        * Test for existance...
+        * Compile the comparison string...
 	*/
 
-        if (name[0] == '?')
-	  result = cgiGetArray(name + 1, element) != NULL;
-	else if (name[0] == '#')
-	  result = cgiGetVariable(name + 1) != NULL;
-        else
-          result = cgiGetArray(name, element) != NULL;
+        ctail = &(node->compare);
 
-	result     = result && outptr[0];
-	compare[0] = '\0';
-      }
-      else
-      {
-       /*
-        * Compare to a string...
-	*/
+	while ((ch = getc(in)) != EOF)
+	{
+	  if (textlen >= (sizeof(text) - 1))
+	    cgi_add_text(&ctail, text, &textlen);
 
-	for (s = compare; (ch = getc(in)) != EOF;)
           if (ch == '?')
             break;
-	  else if (s >= (compare + sizeof(compare) - 1))
-	    continue;
 	  else if (ch == '#')
 	  {
-	    sprintf(s, "%d", element + 1);
-	    s += strlen(s);
+	    cgi_add_text(&ctail, text, &textlen);
+	    cgi_new_node(&ctail, CGI_OP_ELEMENT, NULL, 0);
 	  }
 	  else if (ch == '{')
 	  {
@@ -466,168 +444,317 @@ cgi_copy(FILE *out,			/* I - Output file */
 	    * Grab the value of a variable...
 	    */
 
+	    cgi_node_t *inner;		/* Inner variable */
+
 	    innerptr = innername;
 	    while ((ch = getc(in)) != EOF && ch != '}')
 	      if (innerptr < (innername + sizeof(innername) - 1))
 	        *innerptr++ = (char)ch;
 	    *innerptr = '\0';
 
+	    cgi_add_text(&ctail, text, &textlen);
+
             if (innername[0] == '#')
-	      sprintf(s, "%d", cgiGetSize(innername + 1));
+	      cgi_new_node(&ctail, CGI_OP_SIZE, innername + 1,
+	                   strlen(innername + 1));
 	    else if ((innerptr = strrchr(innername, '-')) != NULL &&
 	             isdigit(innerptr[1] & 255))
             {
 	      *innerptr++ = '\0';
-	      if ((innerval = cgiGetArray(innername, atoi(innerptr) - 1)) == NULL)
-	        *s = '\0';
-	      else
-	        strlcpy(s, innerval, sizeof(compare) - (size_t)(s - compare));
+
+	      if ((inner = cgi_new_node(&ctail, CGI_OP_ARRAY, innername,
+	                                strlen(innername))) != NULL)
+	      {
+	        inner->indexed = 1;
+		inner->index   = atoi(innerptr) - 1;
+	      }
 	    }
 	    else if (innername[0] == '?')
-	    {
-	      if ((innerval = cgiGetArray(innername + 1, element)) == NULL)
-		*s = '\0';
-	      else
-	        strlcpy(s, innerval, sizeof(compare) - (size_t)(s - compare));
-            }
-	    else if ((innerval = cgiGetArray(innername, element)) == NULL)
-	      snprintf(s, sizeof(compare) - (size_t)(s - compare), "{%s}", innername);
+	      cgi_new_node(&ctail, CGI_OP_ARRAY, innername + 1,
+	                   strlen(innername + 1));
 	    else
-	      strlcpy(s, innerval, sizeof(compare) - (size_t)(s - compare));
-
-            s += strlen(s);
+	      cgi_new_node(&ctail, CGI_OP_VARIABLE, innername,
+	                   strlen(innername));
 	  }
           else if (ch == '\\')
-	    *s++ = (char)getc(in);
+	    text[textlen ++] = (char)getc(in);
 	  else
-            *s++ = (char)ch;
+            text[textlen ++] = (char)ch;
+        }
 
-        *s = '\0';
+        cgi_add_text(&ctail, text, &textlen);
 
         if (ch != '?')
 	{
-	  fprintf(stderr,
-	          "DEBUG2: %*sBad terminator '%c' at file position %ld...\n",
-	          indent, "", ch, ftell(in));
-	  return;
+	  fprintf(stderr, "DEBUG2: Bad terminator '%c' at file position %ld...\n",
+	          ch, ftell(in));
+
+          node->op = '\0';		/* Nothing is output */
+          *tail    = node;
+
+	  return (nodes);
 	}
+      }
 
-       /*
-        * Do the comparison...
-	*/
+     /*
+      * Compile both parts...
+      */
 
-        switch (op)
-	{
-	  case '<' :
-	      result = _cups_strcasecmp(outptr, compare) < 0;
-	      break;
-	  case '>' :
-	      result = _cups_strcasecmp(outptr, compare) > 0;
-	      break;
-	  case '=' :
-	      result = _cups_strcasecmp(outptr, compare) == 0;
-	      break;
-	  case '!' :
-	      result = _cups_strcasecmp(outptr, compare) != 0;
-	      break;
-	  case '~' :
-	      fprintf(stderr, "DEBUG: Regular expression \"%s\"\n", compare);
-
-	      if (regcomp(&re, compare, REG_EXTENDED | REG_ICASE))
-	      {
-	        fprintf(stderr,
-		        "ERROR: Unable to compile regular expression \"%s\"!\n",
-			compare);
-		result = 0;
-	      }
-	      else
-	      {
-	        regmatch_t matches[10];
+      *tail = node;
+      tail  = &(node->next);
+
+      node->child = cgi_compile(in, ':');
+      node->alt   = cgi_compile(in, '}');
+    }
+    else if (ch == '\\')		/* Quoted char */
+      text[textlen ++] = (char)getc(in);
+    else
+      text[textlen ++] = (char)ch;
+  }
+
+  cgi_add_text(&tail, text, &textlen);
+
+  if (ch == EOF && term)
+    fprintf(stderr, "ERROR: Saw EOF, expected '%c'!\n", term);
 
-		result = 0;
+  return (nodes);
+}
+
+
+/*
+ * 'cgi_copy()' - Copy the compiled template, substituting as needed...
+ */
 
-	        if (!regexec(&re, outptr, 10, matches, 0))
-		{
-		  int i;
-		  for (i = 0; i < 10; i ++)
+static void
+cgi_copy(FILE       *out,		/* I - Output file */
+         cgi_node_t *node,		/* I - First node */
+	 int        element)		/* I - Element number (0 to N) */
+{
+  int		i,			/* Looping var */
+		count;			/* Number of elements */
+  const char	*outptr;		/* Output string pointer */
+  char		outval[1024],		/* Formatted output string */
+		compare[1024];		/* Comparison string */
+  int		result;			/* Result of comparison */
+  regex_t	re;			/* Regular expression to match */
+
+
+  for (; node; node = node->next)
+  {
+    switch (node->opcode)
+    {
+      case CGI_OP_TEXT :
+          fwrite(node->data, 1, node->length, out);
+	  break;
+
+      case CGI_OP_LOOP :
+         /*
+	  * Loop for # of elements...
+	  */
+
+	  if (node->indexed)
+	    count = node->index;
+	  else
+	    count = cgiGetSize(node->data);
+
+          for (i = 0; i < count; i ++)
+	    cgi_copy(out, node->child, i);
+	  break;
+
+      case CGI_OP_VALUE :
+         /*
+	  * Insert value...
+	  */
+
+          outptr = cgi_value(node, element, outval, sizeof(outval));
+
+	  if (node->uriencode)
+	    cgi_puturi(outptr, out);
+	  else if (!_cups_strcasecmp(node->data, "?cupsdconf_default"))
+	    fputs(outptr, stdout);
+	  else
+	    cgi_puts(outptr, out);
+	  break;
+
+      case CGI_OP_TEST :
+         /*
+	  * Test a value...
+	  */
+
+          if (!node->op)
+	    break;			/* Bad terminator */
+
+          outptr = cgi_value(node, element, outval, sizeof(outval));
+
+          if (node->op == '?')
+	  {
+	   /*
+	    * Test for existance...
+	    */
+
+	    if (node->data[0] == '?')
+	      result = cgiGetArray(node->data + 1, element) != NULL;
+	    else if (node->data[0] == '#')
+	      result = cgiGetVariable(node->data + 1) != NULL;
+	    else
+	      result = cgiGetArray(node->data, element) != NULL;
+
+	    result = result && outptr[0];
+	  }
+	  else
+	  {
+	   /*
+	    * Compare to a string...
+	    */
+
+	    cgi_string(node->compare, element, compare, sizeof(compare));
+
+	    switch (node->op)
+	    {
+	      case '<' :
+		  result = _cups_strcasecmp(outptr, compare) < 0;
+		  break;
+	      case '>' :
+		  result = _cups_strcasecmp(outptr, compare) > 0;
+		  break;
+	      case '=' :
+		  result = _cups_strcasecmp(outptr, compare) == 0;
+		  break;
+	      case '!' :
+		  result = _cups_strcasecmp(outptr, compare) != 0;
+		  break;
+	      case '~' :
+		  fprintf(stderr, "DEBUG: Regular expression \"%s\"\n", compare);
+
+		  if (regcomp(&re, compare, REG_EXTENDED | REG_ICASE))
 		  {
-		    fprintf(stderr, "DEBUG: matches[%d].rm_so=%d\n", i,
-		            (int)matches[i].rm_so);
-		    if (matches[i].rm_so < 0)
-		      break;
+		    fprintf(stderr,
+			    "ERROR: Unable to compile regular expression \"%s\"!\n",
+			    compare);
+		    result = 0;
+		  }
+		  else
+		  {
+		    regmatch_t matches[10];
+
+		    result = 0;
 
-		    result ++;
+		    if (!regexec(&re, outptr, 10, matches, 0))
+		    {
+		      for (i = 0; i < 10; i ++)
+		      {
+			fprintf(stderr, "DEBUG: matches[%d].rm_so=%d\n", i,
+				(int)matches[i].rm_so);
+			if (matches[i].rm_so < 0)
+			  break;
+
+			result ++;
+		      }
+		    }
+
+		    regfree(&re);
 		  }
-		}
+		  break;
+	      default :
+		  result = 1;
+		  break;
+	    }
+	  }
 
-		regfree(&re);
-	      }
-	      break;
-	  default :
-	      result = 1;
-	      break;
-	}
-      }
+          cgi_copy(out, result ? node->child : node->alt, element);
+	  break;
 
-      fprintf(stderr,
-              "DEBUG2: %*sStarting \"{%s%c%s\" at %ld, result=%d...\n",
-	      indent, "", name, op, compare, ftell(in), result);
+      default :
+          break;
+    }
+  }
+}
 
-      if (result)
-      {
-       /*
-	* Comparison true; output first part and ignore second...
-	*/
 
-        fprintf(stderr, "DEBUG2: %*sOutput first part...\n", indent, "");
-	cgi_copy(out, in, element, ':', indent + 2);
+/*
+ * 'cgi_get_template()' - Get a compiled template file, compiling it as
+ *                        needed.
+ */
 
-        fprintf(stderr, "DEBUG2: %*sSkip second part...\n", indent, "");
-	cgi_copy(NULL, in, element, '}', indent + 2);
-      }
-      else
-      {
-       /*
-	* Comparison false; ignore first part and output second...
-	*/
+static cgi_template_t *			/* O - Template or NULL on error */
+cgi_get_template(const char *filename)	/* I - Template filename */
+{
+  cgi_template_t	key,		/* Search key */
+			*t;		/* Template */
+  FILE			*in;		/* Input file */
 
-        fprintf(stderr, "DEBUG2: %*sSkip first part...\n", indent, "");
-	cgi_copy(NULL, in, element, ':', indent + 2);
 
-        fprintf(stderr, "DEBUG2: %*sOutput second part...\n", indent, "");
-	cgi_copy(out, in, element, '}', indent + 2);
-      }
+  key.filename = (char *)filename;
 
-      fprintf(stderr, "DEBUG2: %*sFinished \"{%s%c%s\", out=%p...\n", indent, "",
-              name, op, compare, out);
-    }
-    else if (ch == '\\')	/* Quoted char */
-    {
-      if (out)
-        putc(getc(in), out);
-      else
-        getc(in);
-    }
-    else if (out)
-      putc(ch, out);
+  if ((t = (cgi_template_t *)cupsArrayFind(cgi_templates, &key)) != NULL)
+    return (t);
+
+  if (!cgi_templates &&
+      (cgi_templates = cupsArrayNew((cups_array_func_t)cgi_compare_templates,
+                                    NULL)) == NULL)
+    return (NULL);
+
+  if ((t = calloc(1, sizeof(cgi_template_t))) == NULL)
+    return (NULL);
+
+  if ((t->filename = strdup(filename)) == NULL)
+  {
+    free(t);
+    return (NULL);
+  }
 
-  if (ch == EOF)
-    fprintf(stderr, "DEBUG2: %*sReturning at file position %ld on EOF...\n",
-	    indent, "", ftell(in));
+  if ((in = fopen(filename, "r")) == NULL)
+    t->error = errno;
   else
-    fprintf(stderr,
-            "DEBUG2: %*sReturning at file position %ld on character '%c'...\n",
-	    indent, "", ftell(in), ch);
+  {
+    t->nodes = cgi_compile(in, 0);
+    fclose(in);
+  }
 
-  if (ch == EOF && term)
-    fprintf(stderr, "ERROR: %*sSaw EOF, expected '%c'!\n", indent, "", term);
+  cupsArrayAdd(cgi_templates, t);
+
+  return (t);
+}
 
- /*
-  * Flush any pending output...
-  */
 
-  if (out)
-    fflush(out);
+/*
+ * 'cgi_new_node()' - Create a new template node.
+ */
+
+static cgi_node_t *			/* O  - New node or NULL on error */
+cgi_new_node(cgi_node_t   ***tail,	/* IO - End of node list or NULL */
+             cgi_opcode_t opcode,	/* I  - Operation */
+	     const char   *data,	/* I  - Text or name or NULL */
+	     size_t       length)	/* I  - Length of data */
+{
+  cgi_node_t	*node;			/* New node */
+
+
+  if ((node = calloc(1, sizeof(cgi_node_t))) == NULL)
+    return (NULL);
+
+  if (data && (node->data = malloc(length + 1)) == NULL)
+  {
+    free(node);
+    return (NULL);
+  }
+
+  node->opcode = opcode;
+  node->length = length;
+
+  if (data)
+  {
+    memcpy(node->data, data, length);
+    node->data[length] = '\0';
+  }
+
+  if (tail)
+  {
+    **tail = node;
+    *tail  = &(node->next);
+  }
+
+  return (node);
 }
 
 
@@ -677,3 +804,127 @@ cgi_puturi(const char *s,		/* I - String to output */
     s ++;
   }
 }
+
+
+/*
+ * 'cgi_string()' - Build a comparison string.
+ */
+
+static void
+cgi_string(cgi_node_t *node,		/* I - First node */
+           int        element,		/* I - Element number (0 to N) */
+           char       *buffer,		/* I - String buffer */
+	   size_t     bufsize)		/* I - Size of string buffer */
+{
+  char		*s,			/* Pointer into buffer */
+		*end;			/* End of buffer */
+  const char	*value;			/* Value of variable */
+  size_t	length;			/* Length of text */
+
+
+  for (s = buffer, end = buffer + bufsize - 1, *s = '\0';
+       node && s < end;
+       node = node->next, s += strlen(s))
+  {
+    switch (node->opcode)
+    {
+      case CGI_OP_TEXT :
+          if ((length = node->length) > (size_t)(end - s))
+	    length = (size_t)(end - s);
+
+          memcpy(s, node->data, length);
+	  s[length] = '\0';
+	  break;
+
+      case CGI_OP_ELEMENT :
+          snprintf(s, (size_t)(end - s + 1), "%d", element + 1);
+	  break;
+
+      case CGI_OP_SIZE :
+          snprintf(s, (size_t)(end - s + 1), "%d", cgiGetSize(node->data));
+	  break;
+
+      case CGI_OP_ARRAY :
+          if ((value = cgiGetArray(node->data, node->indexed ? node->index : element)) == NULL)
+	    value = "";
+
+          strlcpy(s, value, (size_t)(end - s + 1));
+	  break;
+
+      case CGI_OP_VARIABLE :
+          if ((value = cgiGetArray(node->data, element)) == NULL)
+	    snprintf(s, (size_t)(end - s + 1), "{%s}", node->data);
+	  else
+	    strlcpy(s, value, (size_t)(end - s + 1));
+	  break;
+
+      default :
+          break;
+    }
+  }
+}
+
+
+/*
+ * 'cgi_value()' - Get the value of a template variable.
+ */
+
+static const char *			/* O - Value */
+cgi_value(cgi_node_t *node,		/* I - Node */
+          int        element,		/* I - Element number (0 to N) */
+	  char       *buffer,		/* I - Buffer for formatted values */
+	  size_t     bufsize)		/* I - Size of buffer */
+{
+  const char	*value;			/* Value of variable */
+  int		index = node->indexed ? node->index : element;
+					/* Array element */
+
+
+  switch (node->data[0])
+  {
+    case '?' :
+       /*
+        * Insert value only if it exists...
+	*/
+
+        if ((value = cgiGetArray(node->data + 1, index)) == NULL)
+	  value = "";
+	break;
+
+    case '#' :
+       /*
+        * Insert count...
+	*/
+
+        if (node->data[1])
+          snprintf(buffer, bufsize, "%d", cgiGetSize(node->data + 1));
+	else
+	  snprintf(buffer, bufsize, "%d", element + 1);
+
+        value = buffer;
+	break;
+
+    case '$' :
+       /*
+        * Insert cookie value or nothing if not defined.
+	*/
+
+        if ((value = cgiGetCookie(node->data + 1)) == NULL)
+	  value = "";
+	break;
+
+    default :
+       /*
+        * Insert variable or variable name (if element is NULL)...
+	*/
+
+	if ((value = cgiGetArray(node->data, index)) == NULL)
+        {
+	  snprintf(buffer, bufsize, "{%s}", node->data);
+	  value = buffer;
+	}
+	break;
+  }
+
+  return (value);
+}
@@ -15,6 +15,10 @@
 /*#define DEBUG*/
 #include "cgi-private.h"
 #include <cups/http.h>
+#include <fcntl.h>
+#include <poll.h>
+
+extern char **environ;
 
 
 /*
@@ -24,6 +28,20 @@
 #define CUPS_SID	"org.cups.sid"
 
 
+/*
+ * Seconds a resident CGI program waits for another request...
+ */
+
+#define CUPS_WORKER_TIMEOUT	60
+
+
+/*
+ * Size of the form variable lookup hash...
+ */
+
+#define CGI_VAR_HASH	1024
+
+
 /*
  * Data structure to hold all the CGI form variables and arrays...
  */
@@ -43,9 +61,8 @@ typedef struct				/**** Form variable structure ****/
 
 static int		num_cookies = 0;/* Number of cookies */
 static cups_option_t	*cookies = NULL;/* Cookies */
-static int		form_count = 0,	/* Form variable count */
-			form_alloc = 0;	/* Number of variables allocated */
-static _cgi_var_t	*form_vars = NULL;
+static int		form_count = 0;	/* Form variable count */
+static cups_array_t	*form_vars = NULL;
 					/* Form variables */
 static cgi_file_t	*form_file = NULL;
 					/* Uploaded file */
@@ -60,6 +77,8 @@ static void		cgi_add_variable(const char *name, int element,
 static int		cgi_compare_variables(const _cgi_var_t *v1,
 			                      const _cgi_var_t *v2);
 static _cgi_var_t	*cgi_find_variable(const char *name);
+static void		cgi_free_variable(_cgi_var_t *var);
+static int		cgi_hash_variable(const _cgi_var_t *var);
 static void		cgi_initialize_cookies(void);
 static int		cgi_initialize_get(void);
 static int		cgi_initialize_multipart(const char *boundary);
@@ -67,8 +86,9 @@ static int		cgi_initialize_post(void);
 static int		cgi_initialize_string(const char *data);
 static const char	*cgi_passwd(const char *prompt);
 static const char	*cgi_set_sid(void);
-static void		cgi_sort_variables(void);
+static int		cgi_size_values(_cgi_var_t *var, int size);
 static void		cgi_unlink_file(void);
+static int		cgi_wait_request(int *argc, char ***argv);
 
 
 /*
@@ -133,19 +153,17 @@ cgiCheckVariables(const char *names)	/* I - Variables to look for */
 void
 cgiClearVariables(void)
 {
-  int		i, j;			/* Looping vars */
   _cgi_var_t	*v;			/* Current variable */
 
 
   fputs("DEBUG: cgiClearVariables called.\n", stderr);
 
-  for (v = form_vars, i = form_count; i > 0; v ++, i --)
-  {
-    free(v->name);
-    for (j = 0; j < v->nvalues; j ++)
-      if (v->values[j])
-        free(v->values[j]);
-  }
+  for (v = (_cgi_var_t *)cupsArrayFirst(form_vars);
+       v;
+       v = (_cgi_var_t *)cupsArrayNext(form_vars))
+    cgi_free_variable(v);
+
+  cupsArrayClear(form_vars);
 
   form_count = 0;
 
@@ -248,6 +266,17 @@ cgiInitialize(void)
 		*cups_sid_form;		/* SID form variable */
 
 
+ /*
+  * Clear anything left over from a previous request...
+  */
+
+  if (form_count > 0 || form_file)
+    cgiClearVariables();
+
+  cupsFreeOptions(num_cookies, cookies);
+  num_cookies = 0;
+  cookies     = NULL;
+
  /*
   * Setup a password callback for authentication...
   */
@@ -356,6 +385,37 @@ cgiIsPOST(void)
 }
 
 
+/*
+ * 'cgiMain()' - Run the requests for a CGI program.
+ *
+ * The callback is called for the current request.  When the scheduler
+ * starts the program as a resident worker (MaxCGIWorkers), it is then
+ * called again for each request that arrives on the request socket (file
+ * descriptor 3), until no request has been received for 60 seconds.
+ */
+
+int					/* O - Exit status of last request */
+cgiMain(int           argc,		/* I - Number of command-line arguments */
+        char          *argv[],		/* I - Command-line arguments */
+        cgi_main_cb_t cb)		/* I - Request callback */
+{
+  int		status;			/* Exit status */
+  struct stat	fileinfo;		/* Request socket information */
+
+
+  status = (cb)(argc, argv);
+
+  if (!getenv("CUPS_CGI_WORKER") || fstat(3, &fileinfo) ||
+      !S_ISSOCK(fileinfo.st_mode))
+    return (status);
+
+  while (cgi_wait_request(&argc, &argv))
+    status = (cb)(argc, argv);
+
+  return (status);
+}
+
+
 /*
  * 'cgiSetArray()' - Set array element N to the specified string.
  *
@@ -378,23 +438,11 @@ cgiSetArray(const char *name,		/* I - Name of variable */
   fprintf(stderr, "DEBUG: cgiSetArray: %s[%d]=\"%s\"\n", name, element, value);
 
   if ((var = cgi_find_variable(name)) == NULL)
-  {
     cgi_add_variable(name, element, value);
-    cgi_sort_variables();
-  }
   else
   {
-    if (element >= var->avalues)
-    {
-      char **temp;			/* Temporary pointer */
-
-      temp = (char **)realloc((void *)(var->values), sizeof(char *) * (size_t)(element + 16));
-      if (!temp)
-        return;
-
-      var->avalues = element + 16;
-      var->values  = temp;
-    }
+    if (!cgi_size_values(var, element + 1))
+      return;
 
     if (element >= var->nvalues)
     {
@@ -461,17 +509,8 @@ cgiSetSize(const char *name,		/* I - Name of variable */
   if ((var = cgi_find_variable(name)) == NULL)
     return;
 
-  if (size >= var->avalues)
-  {
-    char **temp;			/* Temporary pointer */
-
-    temp = (char **)realloc((void *)(var->values), sizeof(char *) * (size_t)(size + 16));
-    if (!temp)
-      return;
-
-    var->avalues = size + 16;
-    var->values  = temp;
-  }
+  if (!cgi_size_values(var, size))
+    return;
 
   if (size > var->nvalues)
   {
@@ -509,10 +548,7 @@ cgiSetVariable(const char *name,	/* I - Name of variable */
   fprintf(stderr, "cgiSetVariable: %s=\"%s\"\n", name, value);
 
   if ((var = cgi_find_variable(name)) == NULL)
-  {
     cgi_add_variable(name, 0, value);
-    cgi_sort_variables();
-  }
   else
   {
     for (i = 0; i < var->nvalues; i ++)
@@ -540,33 +576,28 @@ cgi_add_variable(const char *name,	/* I - Variable name */
   if (name == NULL || value == NULL || element < 0 || element > 100000)
     return;
 
-  if (form_count >= form_alloc)
-  {
-    _cgi_var_t	*temp_vars;		/* Temporary form pointer */
-
-
-    if (form_alloc == 0)
-      temp_vars = malloc(sizeof(_cgi_var_t) * 16);
-    else
-      temp_vars = realloc(form_vars, (size_t)(form_alloc + 16) * sizeof(_cgi_var_t));
-
-    if (!temp_vars)
-      return;
-
-    form_vars  = temp_vars;
-    form_alloc += 16;
-  }
+  if (!form_vars &&
+      (form_vars = cupsArrayNew2((cups_array_func_t)cgi_compare_variables,
+                                 NULL, (cups_ahash_func_t)cgi_hash_variable,
+				 CGI_VAR_HASH)) == NULL)
+    return;
 
-  var = form_vars + form_count;
+  if ((var = calloc(1, sizeof(_cgi_var_t))) == NULL)
+    return;
 
   if ((var->values = calloc((size_t)element + 1, sizeof(char *))) == NULL)
+  {
+    free(var);
     return;
+  }
 
   var->name            = strdup(name);
   var->nvalues         = element + 1;
   var->avalues         = element + 1;
   var->values[element] = strdup(value);
 
+  cupsArrayAdd(form_vars, var);
+
   form_count ++;
 }
 
@@ -599,8 +630,46 @@ cgi_find_variable(const char *name)	/* I - Name of variable */
 
   key.name = (char *)name;
 
-  return ((_cgi_var_t *)bsearch(&key, form_vars, (size_t)form_count, sizeof(_cgi_var_t),
-                           (int (*)(const void *, const void *))cgi_compare_variables));
+  return ((_cgi_var_t *)cupsArrayFind(form_vars, &key));
+}
+
+
+/*
+ * 'cgi_free_variable()' - Free a variable and its values.
+ */
+
+static void
+cgi_free_variable(_cgi_var_t *var)	/* I - Variable */
+{
+  int	i;				/* Looping var */
+
+
+  for (i = 0; i < var->nvalues; i ++)
+    free(var->values[i]);
+
+  free(var->values);
+  free(var->name);
+  free(var);
+}
+
+
+/*
+ * 'cgi_hash_variable()' - Generate a lookup hash for a variable name.
+ *
+ * Names are compared without regard to case, so the hash is too.
+ */
+
+static int				/* O - Hash index */
+cgi_hash_variable(const _cgi_var_t *var)/* I - Variable */
+{
+  unsigned	hash = 0;		/* Hash value */
+  const char	*ptr;			/* Pointer into name */
+
+
+  for (ptr = var->name; *ptr; ptr ++)
+    hash = 33 * hash + (unsigned)_cups_tolower(*ptr);
+
+  return ((int)(hash % CGI_VAR_HASH));
 }
 
 
@@ -1232,17 +1301,36 @@ cgi_set_sid(void)
 
 
 /*
- * 'cgi_sort_variables()' - Sort all form variables for faster lookup.
+ * 'cgi_size_values()' - Make room for at least "size" values.
+ *
+ * The values array grows geometrically so that arrays filled one element at
+ * a time, as cgiSetIPPVars() does for long job lists, take linear time.
  */
 
-static void
-cgi_sort_variables(void)
+static int				/* O - 1 on success, 0 on error */
+cgi_size_values(_cgi_var_t *var,	/* I - Variable */
+                int        size)	/* I - Number of values */
 {
-  if (form_count < 2)
-    return;
+  int	avalues;			/* New number of values allocated */
+  char	**temp;				/* New values */
+
+
+  if (size <= var->avalues)
+    return (1);
+
+  if ((avalues = 2 * var->avalues) < 16)
+    avalues = 16;
+
+  if (avalues < size)
+    avalues = size;
+
+  if ((temp = (char **)realloc((void *)(var->values), sizeof(char *) * (size_t)avalues)) == NULL)
+    return (0);
 
-  qsort(form_vars, (size_t)form_count, sizeof(_cgi_var_t),
-        (int (*)(const void *, const void *))cgi_compare_variables);
+  var->avalues = avalues;
+  var->values  = temp;
+
+  return (1);
 }
 
 
@@ -1273,3 +1361,151 @@ cgi_unlink_file(void)
     form_file = NULL;
   }
 }
+
+
+/*
+ * 'cgi_wait_request()' - Wait for the next request from the scheduler.
+ *
+ * The request is three unsigned integers (argc, envc, and the length of the
+ * strings) followed by the argument and environment strings; the output pipe
+ * and standard input file (if any) come as SCM_RIGHTS.
+ */
+
+static int				/* O - 1 on success, 0 to exit */
+cgi_wait_request(int  *argc,		/* O - Number of command-line arguments */
+                 char ***argv)		/* O - Command-line arguments */
+{
+  int		fd,			/* /dev/null */
+		fds[2],			/* Received descriptors */
+		num_fds = 0;		/* Number of received descriptors */
+  unsigned	header[3];		/* argc, envc, and length of strings */
+  ssize_t	bytes;			/* Bytes received */
+  size_t	total;			/* Total bytes of strings */
+  unsigned	i;			/* Looping var */
+  char		*ptr,			/* Pointer into strings */
+		*end;			/* End of strings */
+  struct pollfd	pfd;			/* Request socket */
+  struct iovec	iov;			/* Received data */
+  struct msghdr	msg;			/* Received message */
+  struct cmsghdr *cmsg;			/* Control message */
+  char		control[CMSG_SPACE(sizeof(fds))];
+					/* Control message buffer */
+  static char	*strings = NULL,	/* Argument and environment strings */
+		**vars = NULL;		/* Argument and environment pointers */
+
+
+ /*
+  * Finish the previous request - closing the output pipe tells the scheduler
+  * that we are done...
+  */
+
+  fflush(stdout);
+  fflush(stderr);
+
+  if ((fd = open("/dev/null", O_RDWR)) < 0)
+    return (0);
+
+  dup2(fd, 0);
+  dup2(fd, 1);
+  close(fd);
+
+ /*
+  * Wait for the next one...
+  */
+
+  pfd.fd     = 3;
+  pfd.events = POLLIN;
+
+  if (poll(&pfd, 1, CUPS_WORKER_TIMEOUT * 1000) <= 0)
+    return (0);
+
+  iov.iov_base = header;
+  iov.iov_len  = sizeof(header);
+
+  memset(&msg, 0, sizeof(msg));
+
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control;
+  msg.msg_controllen = sizeof(control);
+
+  bytes = recvmsg(3, &msg, 0);
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      num_fds = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+      if (num_fds > 2)
+        num_fds = 2;
+
+      memcpy(fds, CMSG_DATA(cmsg), (size_t)num_fds * sizeof(int));
+    }
+
+  if (bytes != (ssize_t)sizeof(header) || num_fds < 1 ||
+      header[0] < 1 || header[2] < 1 || header[2] > 1048576)
+    goto error;
+
+ /*
+  * Read the argument and environment strings...
+  */
+
+  free(strings);
+  free(vars);
+
+  strings = malloc(header[2]);
+  vars    = calloc(header[0] + header[1] + 2, sizeof(char *));
+
+  if (!strings || !vars)
+    goto error;
+
+  for (total = 0; total < header[2]; total += (size_t)bytes)
+    if ((bytes = read(3, strings + total, header[2] - total)) <= 0)
+      goto error;
+
+  for (i = 0, ptr = strings, end = strings + header[2];
+       i < (header[0] + header[1]) && ptr < end;
+       i ++, ptr += strlen(ptr) + 1)
+  {
+    if (!memchr(ptr, '\0', (size_t)(end - ptr)))
+      goto error;
+
+    vars[i + (i >= header[0])] = ptr;
+  }
+
+  if (i < (header[0] + header[1]))
+    goto error;
+
+  *argc   = (int)header[0];
+  *argv   = vars;
+  environ = vars + header[0] + 1;
+
+ /*
+  * Use the output pipe and input file...
+  */
+
+  dup2(fds[0], 1);
+  close(fds[0]);
+
+  if (num_fds > 1)
+  {
+    dup2(fds[1], 0);
+    close(fds[1]);
+  }
+
+  clearerr(stdout);
+  clearerr(stdin);
+  fseek(stdin, 0, SEEK_SET);
+
+  return (1);
+
+ /*
+  * If we get here the scheduler sent something we don't understand...
+  */
+
+  error:
+
+  while (num_fds > 0)
+    close(fds[-- num_fds]);
+
+  return (0);
+}
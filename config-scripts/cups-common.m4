@@ -100,6 +100,14 @@ fi
 
 AC_SUBST(LIBMALLOC)
 
+dnl Check for static tracing probes...
+AC_ARG_ENABLE(probes, [  --enable-probes         build the scheduler with USDT/DTrace probes])
+
+if test x$enable_probes = xyes; then
+	AC_CHECK_HEADER(sys/sdt.h, AC_DEFINE(HAVE_SYS_SDT_H),
+		AC_MSG_ERROR([Static probes require <sys/sdt.h>.]))
+fi
+
 dnl Check for libpaper support...
 AC_ARG_ENABLE(libpaper, [  --enable-libpaper       build with libpaper support])
 
@@ -208,6 +216,17 @@ AC_TRY_COMPILE([#include <sys/stat.h>],[struct stat t;
 dnl See if we have the removefile(3) function for securely removing files
 AC_CHECK_FUNCS(removefile)
 
+dnl See if we have the Linux/Solaris sendfile(2) function for copying files
+dnl to sockets
+AC_CHECK_HEADER(sys/sendfile.h,AC_CHECK_FUNCS(sendfile))
+
+dnl See if we have the Linux fallocate(2) and splice(2) functions for
+dnl receiving files from sockets
+AC_CHECK_FUNCS(fallocate splice)
+
+dnl See if we have the Linux copy_file_range(2) function for copying files
+AC_CHECK_FUNCS(copy_file_range)
+
 dnl See if we have libusb...
 AC_ARG_ENABLE(libusb, [  --enable-libusb         use libusb for USB printing])
 
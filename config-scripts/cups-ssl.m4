@@ -60,6 +60,7 @@ if test x$enable_ssl != xno; then
 	    LIBS="$LIBS $SSLLIBS"
 	    AC_CHECK_FUNC(gnutls_transport_set_pull_timeout_function, AC_DEFINE(HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION))
 	    AC_CHECK_FUNC(gnutls_priority_set_direct, AC_DEFINE(HAVE_GNUTLS_PRIORITY_SET_DIRECT))
+	    AC_CHECK_FUNC(gnutls_alpn_set_protocols, AC_DEFINE(HAVE_GNUTLS_ALPN_SET_PROTOCOLS))
 	    LIBS="$SAVELIBS"
 	fi
     fi
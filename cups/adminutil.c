@@ -134,10 +134,11 @@ cupsAdminGetServerSettings(
 	   cg->http->encryption == HTTP_ENCRYPTION_NEVER))
       {
        /*
-	* Need to close the current connection because something has changed...
+	* Something has changed, so put the current connection back in the
+	* pool...
 	*/
 
-	httpClose(cg->http);
+	_httpPoolRelease(cg->http);
 	cg->http = NULL;
       }
     }
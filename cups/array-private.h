@@ -25,12 +25,36 @@ extern "C" {
 #  endif /* __cplusplus */
 
 
+/*
+ * Types and structures...
+ */
+
+typedef struct _cups_array_iter_s	/**** Array iterator ****/
+{
+  cups_array_t	*array;			/* Array */
+  int		index;			/* Index of current element */
+  void		*element;		/* Current element */
+} _cups_array_iter_t;
+
+
 /*
  * Functions...
  */
 
 extern int		_cupsArrayAddStrings(cups_array_t *a, const char *s,
 			                     char delim) _CUPS_PRIVATE;
+extern void		*_cupsArrayIterFirst(_cups_array_iter_t *iter,
+			                     cups_array_t *a) _CUPS_PRIVATE;
+extern void		*_cupsArrayIterNext(_cups_array_iter_t *iter)
+			                    _CUPS_PRIVATE;
+extern cups_array_t	*_cupsArrayNewChunked(cups_array_func_t f, void *d,
+			                      cups_ahash_func_t h, int hsize,
+			                      cups_acopy_func_t cf,
+			                      cups_afree_func_t ff) _CUPS_PRIVATE;
+extern cups_array_t	*_cupsArrayNewLocked(cups_array_func_t f, void *d,
+			                     cups_ahash_func_t h, int hsize,
+			                     cups_acopy_func_t cf,
+			                     cups_afree_func_t ff) _CUPS_PRIVATE;
 extern cups_array_t	*_cupsArrayNewStrings(const char *s, char delim)
 			                      _CUPS_PRIVATE;
 
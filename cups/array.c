@@ -15,6 +15,7 @@
 #include "string-private.h"
 #include "debug-internal.h"
 #include "array-private.h"
+#include "thread-private.h"
 
 
 /*
@@ -22,17 +23,27 @@
  */
 
 #define _CUPS_MAXSAVE	32		/**** Maximum number of saves ****/
+#define _CUPS_CHUNKSIZE	256		/**** Elements per chunk ****/
 
 
 /*
  * Types and structures...
  */
 
+typedef struct _cups_achunk_s		/**** Chunk of array elements ****/
+{
+  int			num_elements;	/* Number of elements in chunk */
+  void			*elements[_CUPS_CHUNKSIZE];
+					/* Chunk elements */
+} _cups_achunk_t;
+
 struct _cups_array_s			/**** CUPS array structure ****/
 {
  /*
   * The current implementation uses an insertion sort into an array of
-  * sorted pointers.  We leave the array type private/opaque so that we
+  * sorted pointers.  Chunked arrays instead keep the sorted pointers in a
+  * list of fixed-size chunks so that an insertion or removal only moves the
+  * elements of one chunk.  We leave the array type private/opaque so that we
   * can change the underlying implementation without affecting the users
   * of this API.
   */
@@ -53,6 +64,14 @@ struct _cups_array_s			/**** CUPS array structure ****/
 			*hash;		/* Hash array */
   cups_acopy_func_t	copyfunc;	/* Copy function */
   cups_afree_func_t	freefunc;	/* Free function */
+  int			chunked,	/* Use chunked storage? */
+			num_chunks,	/* Number of chunks */
+			alloc_chunks,	/* Allocated chunk pointers */
+			cache_chunk,	/* Last chunk accessed */
+			cache_start;	/* Index of first element in last chunk */
+  _cups_achunk_t	**chunks;	/* Element chunks */
+  int			locked;		/* Lock the array for each access? */
+  _cups_mutex_t		mutex;		/* Mutex for locked arrays */
 };
 
 
@@ -61,7 +80,16 @@ struct _cups_array_s			/**** CUPS array structure ****/
  */
 
 static int	cups_array_add(cups_array_t *a, void *e, int insert);
+static int	cups_array_chunk_start(cups_array_t *a, int chunk);
+static void	*cups_array_current(cups_array_t *a);
 static int	cups_array_find(cups_array_t *a, void *e, int prev, int *rdiff);
+static void	*cups_array_get(cups_array_t *a, int n);
+static int	cups_array_insert_chunk(cups_array_t *a, int n, void *e);
+static int	cups_array_locate(cups_array_t *a, int n, int *offset);
+static void	cups_array_lock(cups_array_t *a);
+static _cups_achunk_t *cups_array_new_chunk(cups_array_t *a, int chunk);
+static void	*cups_array_remove_chunk(cups_array_t *a, int n);
+static void	cups_array_unlock(cups_array_t *a);
 
 
 /*
@@ -78,6 +106,9 @@ int					/* O - 1 on success, 0 on failure */
 cupsArrayAdd(cups_array_t *a,		/* I - Array */
              void         *e)		/* I - Element */
 {
+  int	status;				/* Add status */
+
+
   DEBUG_printf(("2cupsArrayAdd(a=%p, e=%p)", (void *)a, e));
 
  /*
@@ -94,7 +125,11 @@ cupsArrayAdd(cups_array_t *a,		/* I - Array */
   * Append the element...
   */
 
-  return (cups_array_add(a, e, 0));
+  cups_array_lock(a);
+  status = cups_array_add(a, e, 0);
+  cups_array_unlock(a);
+
+  return (status);
 }
 
 
@@ -218,7 +253,28 @@ cupsArrayClear(cups_array_t *a)		/* I - Array */
   * Free the existing elements as needed..
   */
 
-  if (a->freefunc)
+  cups_array_lock(a);
+
+  if (a->chunked)
+  {
+    int		i, j;			/* Looping vars */
+
+    for (i = 0; i < a->num_chunks; i ++)
+    {
+      if (a->freefunc)
+      {
+        for (j = 0; j < a->chunks[i]->num_elements; j ++)
+          (a->freefunc)(a->chunks[i]->elements[j], a->data);
+      }
+
+      free(a->chunks[i]);
+    }
+
+    a->num_chunks  = 0;
+    a->cache_chunk = 0;
+    a->cache_start = 0;
+  }
+  else if (a->freefunc)
   {
     int		i;			/* Looping var */
     void	**e;			/* Current element */
@@ -237,6 +293,8 @@ cupsArrayClear(cups_array_t *a)		/* I - Array */
   a->insert       = -1;
   a->unique       = 1;
   a->num_saved    = 0;
+
+  cups_array_unlock(a);
 }
 
 
@@ -276,6 +334,9 @@ cupsArrayCount(cups_array_t *a)		/* I - Array */
 void *					/* O - Element */
 cupsArrayCurrent(cups_array_t *a)	/* I - Array */
 {
+  void	*e;				/* Current element */
+
+
  /*
   * Range check input...
   */
@@ -287,10 +348,11 @@ cupsArrayCurrent(cups_array_t *a)	/* I - Array */
   * Return the current element...
   */
 
-  if (a->current >= 0 && a->current < a->num_elements)
-    return (a->elements[a->current]);
-  else
-    return (NULL);
+  cups_array_lock(a);
+  e = cups_array_current(a);
+  cups_array_unlock(a);
+
+  return (e);
 }
 
 
@@ -318,7 +380,11 @@ cupsArrayDelete(cups_array_t *a)	/* I - Array */
   * responsible for doing the dirty work...)
   */
 
-  if (a->freefunc)
+  if (a->chunked)
+  {
+    cupsArrayClear(a);
+  }
+  else if (a->freefunc)
   {
     int		i;			/* Looping var */
     void	**e;			/* Current element */
@@ -334,6 +400,9 @@ cupsArrayDelete(cups_array_t *a)	/* I - Array */
   if (a->alloc_elements)
     free(a->elements);
 
+  if (a->alloc_chunks)
+    free(a->chunks);
+
   if (a->hashsize)
     free(a->hash);
 
@@ -368,6 +437,14 @@ cupsArrayDup(cups_array_t *a)		/* I - Array */
   if (!da)
     return (NULL);
 
+  cups_array_lock(a);
+
+  if (a->locked)
+  {
+    da->locked = 1;
+    _cupsMutexInit(&da->mutex);
+  }
+
   da->compare   = a->compare;
   da->data      = a->data;
   da->current   = a->current;
@@ -377,7 +454,56 @@ cupsArrayDup(cups_array_t *a)		/* I - Array */
 
   memcpy(da->saved, a->saved, sizeof(a->saved));
 
-  if (a->num_elements)
+  if (a->chunked)
+  {
+   /*
+    * Copy the chunks...
+    */
+
+    int	i, j;				/* Looping vars */
+
+    da->chunked = 1;
+
+    if (a->num_chunks)
+    {
+      if ((da->chunks = calloc((size_t)a->num_chunks, sizeof(_cups_achunk_t *))) == NULL)
+      {
+        cups_array_unlock(a);
+        free(da);
+        return (NULL);
+      }
+
+      da->alloc_chunks = a->num_chunks;
+
+      for (i = 0; i < a->num_chunks; i ++)
+      {
+        if ((da->chunks[i] = malloc(sizeof(_cups_achunk_t))) == NULL)
+        {
+          while (i > 0)
+            free(da->chunks[-- i]);
+
+          cups_array_unlock(a);
+          free(da->chunks);
+          free(da);
+          return (NULL);
+        }
+
+        da->chunks[i]->num_elements = a->chunks[i]->num_elements;
+
+        if (a->copyfunc)
+        {
+          for (j = 0; j < a->chunks[i]->num_elements; j ++)
+	    da->chunks[i]->elements[j] = (a->copyfunc)(a->chunks[i]->elements[j], a->data);
+        }
+        else
+          memcpy(da->chunks[i]->elements, a->chunks[i]->elements, (size_t)a->chunks[i]->num_elements * sizeof(void *));
+      }
+
+      da->num_chunks   = a->num_chunks;
+      da->num_elements = a->num_elements;
+    }
+  }
+  else if (a->num_elements)
   {
    /*
     * Allocate memory for the elements...
@@ -386,6 +512,7 @@ cupsArrayDup(cups_array_t *a)		/* I - Array */
     da->elements = malloc((size_t)a->num_elements * sizeof(void *));
     if (!da->elements)
     {
+      cups_array_unlock(a);
       free(da);
       return (NULL);
     }
@@ -422,6 +549,8 @@ cupsArrayDup(cups_array_t *a)		/* I - Array */
   * Return the new array...
   */
 
+  cups_array_unlock(a);
+
   return (da);
 }
 
@@ -452,8 +581,13 @@ cupsArrayFind(cups_array_t *a,		/* I - Array */
   * See if we have any elements...
   */
 
+  cups_array_lock(a);
+
   if (!a->num_elements)
+  {
+    cups_array_unlock(a);
     return (NULL);
+  }
 
  /*
   * Yes, look for a match...
@@ -496,7 +630,7 @@ cupsArrayFind(cups_array_t *a,		/* I - Array */
       * The array is not unique, find the first match...
       */
 
-      while (current > 0 && !(*(a->compare))(e, a->elements[current - 1],
+      while (current > 0 && !(*(a->compare))(e, cups_array_get(a, current - 1),
                                              a->data))
         current --;
     }
@@ -506,7 +640,7 @@ cupsArrayFind(cups_array_t *a,		/* I - Array */
     if (hash >= 0)
       a->hash[hash] = current;
 
-    return (a->elements[current]);
+    e = cups_array_get(a, current);
   }
   else
   {
@@ -516,8 +650,12 @@ cupsArrayFind(cups_array_t *a,		/* I - Array */
 
     a->current = -1;
 
-    return (NULL);
+    e = NULL;
   }
+
+  cups_array_unlock(a);
+
+  return (e);
 }
 
 
@@ -530,6 +668,9 @@ cupsArrayFind(cups_array_t *a,		/* I - Array */
 void *					/* O - First element or @code NULL@ if the array is empty */
 cupsArrayFirst(cups_array_t *a)		/* I - Array */
 {
+  void	*e;				/* First element */
+
+
  /*
   * Range check input...
   */
@@ -541,9 +682,12 @@ cupsArrayFirst(cups_array_t *a)		/* I - Array */
   * Return the first element...
   */
 
+  cups_array_lock(a);
   a->current = 0;
+  e          = cups_array_current(a);
+  cups_array_unlock(a);
 
-  return (cupsArrayCurrent(a));
+  return (e);
 }
 
 
@@ -592,12 +736,18 @@ void *					/* O - N-th element or @code NULL@ */
 cupsArrayIndex(cups_array_t *a,		/* I - Array */
                int          n)		/* I - Index into array, starting at 0 */
 {
+  void	*e;				/* N-th element */
+
+
   if (!a)
     return (NULL);
 
+  cups_array_lock(a);
   a->current = n;
+  e          = cups_array_current(a);
+  cups_array_unlock(a);
 
-  return (cupsArrayCurrent(a));
+  return (e);
 }
 
 
@@ -615,6 +765,9 @@ int					/* O - 0 on failure, 1 on success */
 cupsArrayInsert(cups_array_t *a,	/* I - Array */
 		void         *e)	/* I - Element */
 {
+  int	status;				/* Insert status */
+
+
   DEBUG_printf(("2cupsArrayInsert(a=%p, e=%p)", (void *)a, e));
 
  /*
@@ -631,7 +784,74 @@ cupsArrayInsert(cups_array_t *a,	/* I - Array */
   * Insert the element...
   */
 
-  return (cups_array_add(a, e, 1));
+  cups_array_lock(a);
+  status = cups_array_add(a, e, 1);
+  cups_array_unlock(a);
+
+  return (status);
+}
+
+
+/*
+ * '_cupsArrayIterFirst()' - Start iterating over an array.
+ *
+ * Iterators keep their position outside of the array, so any number of
+ * iterations can run at the same time without disturbing the current element
+ * or the @link cupsArraySave@ stack.  Removing the element an iterator is on
+ * is safe; other changes to the array during iteration may cause elements to
+ * be skipped or returned twice.
+ */
+
+void *					/* O - First element or @code NULL@ if the array is empty */
+_cupsArrayIterFirst(
+    _cups_array_iter_t *iter,		/* I - Iterator */
+    cups_array_t       *a)		/* I - Array */
+{
+  if (!iter)
+    return (NULL);
+
+  iter->array   = a;
+  iter->index   = -1;
+  iter->element = NULL;
+
+  return (_cupsArrayIterNext(iter));
+}
+
+
+/*
+ * '_cupsArrayIterNext()' - Get the next element for an iterator.
+ */
+
+void *					/* O - Next element or @code NULL@ */
+_cupsArrayIterNext(
+    _cups_array_iter_t *iter)		/* I - Iterator */
+{
+  cups_array_t	*a;			/* Array */
+
+
+  if (!iter || (a = iter->array) == NULL)
+    return (NULL);
+
+  cups_array_lock(a);
+
+ /*
+  * Move past the current element, unless it was removed and the next element
+  * has already moved into its place...
+  */
+
+  if (iter->index < 0)
+    iter->index = 0;
+  else if (iter->index < a->num_elements && cups_array_get(a, iter->index) == iter->element)
+    iter->index ++;
+
+  if (iter->index < a->num_elements)
+    iter->element = cups_array_get(a, iter->index);
+  else
+    iter->element = NULL;
+
+  cups_array_unlock(a);
+
+  return (iter->element);
 }
 
 
@@ -644,6 +864,9 @@ cupsArrayInsert(cups_array_t *a,	/* I - Array */
 void *					/* O - Last element or @code NULL@ if the array is empty */
 cupsArrayLast(cups_array_t *a)		/* I - Array */
 {
+  void	*e;				/* Last element */
+
+
  /*
   * Range check input...
   */
@@ -655,9 +878,12 @@ cupsArrayLast(cups_array_t *a)		/* I - Array */
   * Return the last element...
   */
 
+  cups_array_lock(a);
   a->current = a->num_elements - 1;
+  e          = cups_array_current(a);
+  cups_array_unlock(a);
 
-  return (cupsArrayCurrent(a));
+  return (e);
 }
 
 
@@ -772,6 +998,66 @@ cupsArrayNew3(cups_array_func_t  f,	/* I - Comparison function or @code NULL@ fo
 }
 
 
+/*
+ * '_cupsArrayNewChunked()' - Create a new array using chunked storage.
+ *
+ * Chunked arrays behave exactly like arrays created with @link cupsArrayNew3@
+ * but store their elements in a list of fixed-size chunks, so adding and
+ * removing elements in large sorted arrays does not need to move the whole
+ * array of element pointers.
+ */
+
+cups_array_t *				/* O - Array */
+_cupsArrayNewChunked(
+    cups_array_func_t f,		/* I - Comparison function or @code NULL@ for an unsorted array */
+    void              *d,		/* I - User data or @code NULL@ */
+    cups_ahash_func_t h,		/* I - Hash function or @code NULL@ for unhashed lookups */
+    int               hsize,		/* I - Hash size (>= 0) */
+    cups_acopy_func_t cf,		/* I - Copy function */
+    cups_afree_func_t ff)		/* I - Free function */
+{
+  cups_array_t	*a;			/* Array */
+
+
+  if ((a = cupsArrayNew3(f, d, h, hsize, cf, ff)) != NULL)
+    a->chunked = 1;
+
+  return (a);
+}
+
+
+/*
+ * '_cupsArrayNewLocked()' - Create a new array that is safe to share between threads.
+ *
+ * Locked arrays behave exactly like arrays created with @link cupsArrayNew3@
+ * but hold a mutex while accessing the array.  The current element and the
+ * @link cupsArraySave@ stack are still shared by all threads, so threads
+ * should use @link _cupsArrayIterFirst@ and @link _cupsArrayIterNext@ to
+ * walk the array.
+ */
+
+cups_array_t *				/* O - Array */
+_cupsArrayNewLocked(
+    cups_array_func_t f,		/* I - Comparison function or @code NULL@ for an unsorted array */
+    void              *d,		/* I - User data or @code NULL@ */
+    cups_ahash_func_t h,		/* I - Hash function or @code NULL@ for unhashed lookups */
+    int               hsize,		/* I - Hash size (>= 0) */
+    cups_acopy_func_t cf,		/* I - Copy function */
+    cups_afree_func_t ff)		/* I - Free function */
+{
+  cups_array_t	*a;			/* Array */
+
+
+  if ((a = cupsArrayNew3(f, d, h, hsize, cf, ff)) != NULL)
+  {
+    a->locked = 1;
+    _cupsMutexInit(&a->mutex);
+  }
+
+  return (a);
+}
+
+
 /*
  * '_cupsArrayNewStrings()' - Create a new array of comma-delimited strings.
  *
@@ -811,6 +1097,9 @@ _cupsArrayNewStrings(const char *s,	/* I - Delimited strings or NULL */
 void *					/* O - Next element or @code NULL@ */
 cupsArrayNext(cups_array_t *a)		/* I - Array */
 {
+  void	*e;				/* Next element */
+
+
  /*
   * Range check input...
   */
@@ -822,10 +1111,16 @@ cupsArrayNext(cups_array_t *a)		/* I - Array */
   * Return the next element...
   */
 
+  cups_array_lock(a);
+
   if (a->current < a->num_elements)
     a->current ++;
 
-  return (cupsArrayCurrent(a));
+  e = cups_array_current(a);
+
+  cups_array_unlock(a);
+
+  return (e);
 }
 
 
@@ -844,6 +1139,9 @@ cupsArrayNext(cups_array_t *a)		/* I - Array */
 void *					/* O - Previous element or @code NULL@ */
 cupsArrayPrev(cups_array_t *a)		/* I - Array */
 {
+  void	*e;				/* Previous element */
+
+
  /*
   * Range check input...
   */
@@ -855,10 +1153,16 @@ cupsArrayPrev(cups_array_t *a)		/* I - Array */
   * Return the previous element...
   */
 
+  cups_array_lock(a);
+
   if (a->current >= 0)
     a->current --;
 
-  return (cupsArrayCurrent(a));
+  e = cups_array_current(a);
+
+  cups_array_unlock(a);
+
+  return (e);
 }
 
 
@@ -894,25 +1198,45 @@ cupsArrayRemove(cups_array_t *a,	/* I - Array */
   * See if the element is in the array...
   */
 
+  cups_array_lock(a);
+
   if (!a->num_elements)
+  {
+    cups_array_unlock(a);
     return (0);
+  }
 
   current = cups_array_find(a, e, a->current, &diff);
   if (diff)
+  {
+    cups_array_unlock(a);
     return (0);
+  }
 
  /*
   * Yes, now remove it...
   */
 
-  a->num_elements --;
+  if (a->chunked)
+  {
+    e = cups_array_remove_chunk(a, (int)current);
 
-  if (a->freefunc)
-    (a->freefunc)(a->elements[current], a->data);
+    a->num_elements --;
 
-  if (current < a->num_elements)
-    memmove(a->elements + current, a->elements + current + 1,
-            (size_t)(a->num_elements - current) * sizeof(void *));
+    if (a->freefunc)
+      (a->freefunc)(e, a->data);
+  }
+  else
+  {
+    a->num_elements --;
+
+    if (a->freefunc)
+      (a->freefunc)(a->elements[current], a->data);
+
+    if (current < a->num_elements)
+      memmove(a->elements + current, a->elements + current + 1,
+	      (size_t)(a->num_elements - current) * sizeof(void *));
+  }
 
   if (current <= a->current)
     a->current --;
@@ -929,6 +1253,8 @@ cupsArrayRemove(cups_array_t *a,	/* I - Array */
   if (a->num_elements <= 1)
     a->unique = 1;
 
+  cups_array_unlock(a);
+
   return (1);
 }
 
@@ -942,19 +1268,27 @@ cupsArrayRemove(cups_array_t *a,	/* I - Array */
 void *					/* O - New current element */
 cupsArrayRestore(cups_array_t *a)	/* I - Array */
 {
+  void	*e;				/* New current element */
+
+
   if (!a)
     return (NULL);
 
+  cups_array_lock(a);
+
   if (a->num_saved <= 0)
+  {
+    cups_array_unlock(a);
     return (NULL);
+  }
 
   a->num_saved --;
   a->current = a->saved[a->num_saved];
+  e          = cups_array_current(a);
 
-  if (a->current >= 0 && a->current < a->num_elements)
-    return (a->elements[a->current]);
-  else
-    return (NULL);
+  cups_array_unlock(a);
+
+  return (e);
 }
 
 
@@ -973,16 +1307,25 @@ cupsArrayRestore(cups_array_t *a)	/* I - Array */
 int					/* O - 1 on success, 0 on failure */
 cupsArraySave(cups_array_t *a)		/* I - Array */
 {
+  int	status = 0;			/* Save status */
+
+
   if (!a)
     return (0);
 
-  if (a->num_saved >= _CUPS_MAXSAVE)
-    return (0);
+  cups_array_lock(a);
 
-  a->saved[a->num_saved] = a->current;
-  a->num_saved ++;
+  if (a->num_saved < _CUPS_MAXSAVE)
+  {
+    a->saved[a->num_saved] = a->current;
+    a->num_saved ++;
 
-  return (1);
+    status = 1;
+  }
+
+  cups_array_unlock(a);
+
+  return (status);
 }
 
 
@@ -1024,7 +1367,7 @@ cups_array_add(cups_array_t *a,		/* I - Array */
   * Verify we have room for the new element...
   */
 
-  if (a->num_elements >= a->alloc_elements)
+  if (!a->chunked && a->num_elements >= a->alloc_elements)
   {
    /*
     * Allocate additional elements; start with 16 elements, then
@@ -1110,7 +1453,7 @@ cups_array_add(cups_array_t *a,		/* I - Array */
         * Insert at beginning of run...
 	*/
 
-	while (current > 0 && !(*(a->compare))(e, a->elements[current - 1],
+	while (current > 0 && !(*(a->compare))(e, cups_array_get(a, current - 1),
                                                a->data))
           current --;
       }
@@ -1125,7 +1468,7 @@ cups_array_add(cups_array_t *a,		/* I - Array */
           current ++;
 	}
 	while (current < a->num_elements &&
-               !(*(a->compare))(e, a->elements[current], a->data));
+               !(*(a->compare))(e, cups_array_get(a, current), a->data));
       }
     }
   }
@@ -1134,7 +1477,35 @@ cups_array_add(cups_array_t *a,		/* I - Array */
   * Insert or append the element...
   */
 
-  if (current < a->num_elements)
+  if (a->chunked)
+  {
+    if (a->copyfunc && (e = (a->copyfunc)(e, a->data)) == NULL)
+    {
+      DEBUG_puts("8cups_array_add: Copy function returned NULL, returning 0");
+      return (0);
+    }
+
+    if (!cups_array_insert_chunk(a, current, e))
+    {
+      DEBUG_puts("9cups_array_add: allocation failed, returning 0");
+
+      if (a->copyfunc && a->freefunc)
+        (a->freefunc)(e, a->data);
+
+      return (0);
+    }
+
+    if (current < a->num_elements)
+    {
+      if (a->current >= current)
+	a->current ++;
+
+      for (i = 0; i < a->num_saved; i ++)
+	if (a->saved[i] >= current)
+	  a->saved[i] ++;
+    }
+  }
+  else if (current < a->num_elements)
   {
    /*
     * Shift other elements to the right...
@@ -1157,23 +1528,26 @@ cups_array_add(cups_array_t *a,		/* I - Array */
     DEBUG_printf(("9cups_array_add: append element at " CUPS_LLFMT, CUPS_LLCAST current));
 #endif /* DEBUG */
 
-  if (a->copyfunc)
+  if (!a->chunked)
   {
-    if ((a->elements[current] = (a->copyfunc)(e, a->data)) == NULL)
+    if (a->copyfunc)
     {
-      DEBUG_puts("8cups_array_add: Copy function returned NULL, returning 0");
-      return (0);
+      if ((a->elements[current] = (a->copyfunc)(e, a->data)) == NULL)
+      {
+	DEBUG_puts("8cups_array_add: Copy function returned NULL, returning 0");
+	return (0);
+      }
     }
+    else
+      a->elements[current] = e;
   }
-  else
-    a->elements[current] = e;
 
   a->num_elements ++;
   a->insert = current;
 
 #ifdef DEBUG
   for (current = 0; current < a->num_elements; current ++)
-    DEBUG_printf(("9cups_array_add: a->elements[" CUPS_LLFMT "]=%p", CUPS_LLCAST current, a->elements[current]));
+    DEBUG_printf(("9cups_array_add: a->elements[" CUPS_LLFMT "]=%p", CUPS_LLCAST current, cups_array_get(a, current)));
 #endif /* DEBUG */
 
   DEBUG_puts("9cups_array_add: returning 1");
@@ -1182,6 +1556,66 @@ cups_array_add(cups_array_t *a,		/* I - Array */
 }
 
 
+/*
+ * 'cups_array_chunk_start()' - Get the index of the first element in a chunk.
+ */
+
+static int				/* O - Index of first element */
+cups_array_chunk_start(
+    cups_array_t *a,			/* I - Array */
+    int          chunk)			/* I - Chunk index */
+{
+  int	current,			/* Current chunk */
+	start;				/* Index of first element in chunk */
+
+
+  current = a->cache_chunk;
+  start   = a->cache_start;
+
+  if (current < 0 || current >= a->num_chunks || chunk < (current - chunk))
+  {
+    current = 0;
+    start   = 0;
+  }
+  else if (chunk > current && (a->num_chunks - chunk) < (chunk - current))
+  {
+    current = a->num_chunks - 1;
+    start   = a->num_elements - a->chunks[current]->num_elements;
+  }
+
+  while (current > chunk)
+  {
+    current --;
+    start -= a->chunks[current]->num_elements;
+  }
+
+  while (current < chunk)
+  {
+    start += a->chunks[current]->num_elements;
+    current ++;
+  }
+
+  a->cache_chunk = chunk;
+  a->cache_start = start;
+
+  return (start);
+}
+
+
+/*
+ * 'cups_array_current()' - Get the current element without locking.
+ */
+
+static void *				/* O - Element */
+cups_array_current(cups_array_t *a)	/* I - Array */
+{
+  if (a->current >= 0 && a->current < a->num_elements)
+    return (cups_array_get(a, a->current));
+  else
+    return (NULL);
+}
+
+
 /*
  * 'cups_array_find()' - Find an element in the array.
  */
@@ -1200,7 +1634,62 @@ cups_array_find(cups_array_t *a,	/* I - Array */
 
   DEBUG_printf(("7cups_array_find(a=%p, e=%p, prev=%d, rdiff=%p)", (void *)a, e, prev, (void *)rdiff));
 
-  if (a->compare)
+  if (a->compare && a->chunked)
+  {
+    int			chunk;		/* Current chunk */
+    _cups_achunk_t	*c;		/* Chunk */
+
+
+   /*
+    * Do a binary search for the chunk and then the element, after checking
+    * the previous element...
+    */
+
+    DEBUG_puts("9cups_array_find: chunked binary search");
+
+    if (prev >= 0 && prev < a->num_elements &&
+        !(*(a->compare))(e, cups_array_get(a, prev), a->data))
+    {
+      DEBUG_printf(("9cups_array_find: Returning %d, diff=0", prev));
+
+      *rdiff = 0;
+
+      return (prev);
+    }
+
+    left  = 0;
+    right = a->num_chunks - 1;
+
+    while (left < right)
+    {
+      chunk = (left + right) / 2;
+      c     = a->chunks[chunk];
+
+      if ((*(a->compare))(e, c->elements[c->num_elements - 1], a->data) > 0)
+        left = chunk + 1;
+      else
+        right = chunk;
+    }
+
+    chunk = left;
+    c     = a->chunks[chunk];
+    left  = 0;
+    right = c->num_elements - 1;
+
+    while (left < right)
+    {
+      current = (left + right) / 2;
+
+      if ((*(a->compare))(e, c->elements[current], a->data) > 0)
+        left = current + 1;
+      else
+        right = current;
+    }
+
+    diff    = (*(a->compare))(e, c->elements[left], a->data);
+    current = cups_array_chunk_start(a, chunk) + left;
+  }
+  else if (a->compare)
   {
    /*
     * Do a binary search for the element...
@@ -1300,7 +1789,7 @@ cups_array_find(cups_array_t *a,	/* I - Array */
     diff = 1;
 
     for (current = 0; current < a->num_elements; current ++)
-      if (a->elements[current] == e)
+      if (cups_array_get(a, current) == e)
       {
         diff = 0;
         break;
@@ -1317,3 +1806,305 @@ cups_array_find(cups_array_t *a,	/* I - Array */
 
   return (current);
 }
+
+
+/*
+ * 'cups_array_get()' - Get the N-th element of an array.
+ */
+
+static void *				/* O - Element */
+cups_array_get(cups_array_t *a,		/* I - Array */
+               int          n)		/* I - Index of element, starting at 0 */
+{
+  int	chunk,				/* Chunk containing element */
+	offset;				/* Offset of element in chunk */
+
+
+  if (!a->chunked)
+    return (a->elements[n]);
+
+  chunk = cups_array_locate(a, n, &offset);
+
+  return (a->chunks[chunk]->elements[offset]);
+}
+
+
+/*
+ * 'cups_array_insert_chunk()' - Insert an element into a chunked array.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+cups_array_insert_chunk(
+    cups_array_t *a,			/* I - Array */
+    int          n,			/* I - Index for new element */
+    void         *e)			/* I - Element */
+{
+  int			chunk,		/* Chunk for element */
+			start,		/* Index of first element in chunk */
+			offset,		/* Offset of element in chunk */
+			half;		/* Elements left in a split chunk */
+  _cups_achunk_t	*c,		/* Chunk */
+			*next;		/* Chunk after split */
+
+
+  if (n >= a->num_elements)
+  {
+   /*
+    * Append to the last chunk, adding a new one as needed...
+    */
+
+    if (!a->num_chunks || a->chunks[a->num_chunks - 1]->num_elements >= _CUPS_CHUNKSIZE)
+    {
+      if (!cups_array_new_chunk(a, a->num_chunks))
+        return (0);
+    }
+
+    chunk  = a->num_chunks - 1;
+    c      = a->chunks[chunk];
+    start  = a->num_elements - c->num_elements;
+    offset = c->num_elements;
+  }
+  else
+  {
+   /*
+    * Insert into the chunk holding the current N-th element, splitting it in
+    * half if it is full...
+    */
+
+    chunk = cups_array_locate(a, n, &offset);
+    start = n - offset;
+    c     = a->chunks[chunk];
+
+    if (c->num_elements >= _CUPS_CHUNKSIZE)
+    {
+      if ((next = cups_array_new_chunk(a, chunk + 1)) == NULL)
+        return (0);
+
+      half               = c->num_elements / 2;
+      next->num_elements = c->num_elements - half;
+      c->num_elements    = half;
+
+      memcpy(next->elements, c->elements + half, (size_t)next->num_elements * sizeof(void *));
+
+      if (offset > half)
+      {
+        chunk ++;
+        start  += half;
+        offset -= half;
+        c      = next;
+      }
+    }
+  }
+
+  if (offset < c->num_elements)
+    memmove(c->elements + offset + 1, c->elements + offset, (size_t)(c->num_elements - offset) * sizeof(void *));
+
+  c->elements[offset] = e;
+  c->num_elements ++;
+
+  a->cache_chunk = chunk;
+  a->cache_start = start;
+
+  return (1);
+}
+
+
+/*
+ * 'cups_array_locate()' - Find the chunk holding the N-th element.
+ *
+ * The search starts from the last chunk accessed so that sequential access is
+ * fast.
+ */
+
+static int				/* O - Chunk index */
+cups_array_locate(cups_array_t *a,	/* I - Array */
+                  int          n,	/* I - Index of element, starting at 0 */
+                  int          *offset)	/* O - Offset of element in chunk */
+{
+  int	chunk,				/* Current chunk */
+	start;				/* Index of first element in chunk */
+
+
+  chunk = a->cache_chunk;
+  start = a->cache_start;
+
+  if (chunk < 0 || chunk >= a->num_chunks || n < (start - n))
+  {
+   /*
+    * Start at the beginning...
+    */
+
+    chunk = 0;
+    start = 0;
+  }
+  else if (n >= start && (a->num_elements - n) < (n - start))
+  {
+   /*
+    * Start at the end...
+    */
+
+    chunk = a->num_chunks - 1;
+    start = a->num_elements - a->chunks[chunk]->num_elements;
+  }
+
+  while (n < start)
+  {
+    chunk --;
+    start -= a->chunks[chunk]->num_elements;
+  }
+
+  while (n >= (start + a->chunks[chunk]->num_elements))
+  {
+    start += a->chunks[chunk]->num_elements;
+    chunk ++;
+  }
+
+  a->cache_chunk = chunk;
+  a->cache_start = start;
+
+  *offset = n - start;
+
+  return (chunk);
+}
+
+
+/*
+ * 'cups_array_lock()' - Lock a locked array.
+ */
+
+static void
+cups_array_lock(cups_array_t *a)	/* I - Array */
+{
+  if (a->locked)
+    _cupsMutexLock(&a->mutex);
+}
+
+
+/*
+ * 'cups_array_new_chunk()' - Add an empty chunk to a chunked array.
+ */
+
+static _cups_achunk_t *			/* O - New chunk or NULL on error */
+cups_array_new_chunk(cups_array_t *a,	/* I - Array */
+                     int          chunk)/* I - Index for new chunk */
+{
+  _cups_achunk_t	*c;		/* New chunk */
+
+
+  if (a->num_chunks >= a->alloc_chunks)
+  {
+    _cups_achunk_t	**temp;		/* New chunk pointers */
+    int			count;		/* New allocation count */
+
+    count = a->alloc_chunks ? 2 * a->alloc_chunks : 16;
+
+    if ((temp = realloc(a->chunks, (size_t)count * sizeof(_cups_achunk_t *))) == NULL)
+      return (NULL);
+
+    a->alloc_chunks = count;
+    a->chunks       = temp;
+  }
+
+  if ((c = malloc(sizeof(_cups_achunk_t))) == NULL)
+    return (NULL);
+
+  c->num_elements = 0;
+
+  if (chunk < a->num_chunks)
+    memmove(a->chunks + chunk + 1, a->chunks + chunk, (size_t)(a->num_chunks - chunk) * sizeof(_cups_achunk_t *));
+
+  a->chunks[chunk] = c;
+  a->num_chunks ++;
+
+  if (a->cache_chunk >= chunk)
+  {
+    a->cache_chunk = 0;
+    a->cache_start = 0;
+  }
+
+  return (c);
+}
+
+
+/*
+ * 'cups_array_remove_chunk()' - Remove the N-th element from a chunked array.
+ */
+
+static void *				/* O - Removed element */
+cups_array_remove_chunk(
+    cups_array_t *a,			/* I - Array */
+    int          n)			/* I - Index of element */
+{
+  int			chunk,		/* Chunk holding element */
+			start,		/* Index of first element in chunk */
+			offset;		/* Offset of element in chunk */
+  _cups_achunk_t	*c,		/* Chunk */
+			*next;		/* Next chunk */
+  void			*e;		/* Removed element */
+
+
+  chunk = cups_array_locate(a, n, &offset);
+  start = n - offset;
+  c     = a->chunks[chunk];
+  e     = c->elements[offset];
+
+  c->num_elements --;
+
+  if (offset < c->num_elements)
+    memmove(c->elements + offset, c->elements + offset + 1, (size_t)(c->num_elements - offset) * sizeof(void *));
+
+  if (c->num_elements == 0)
+  {
+   /*
+    * Free the empty chunk...
+    */
+
+    free(c);
+
+    a->num_chunks --;
+
+    if (chunk < a->num_chunks)
+      memmove(a->chunks + chunk, a->chunks + chunk + 1, (size_t)(a->num_chunks - chunk) * sizeof(_cups_achunk_t *));
+  }
+  else if (chunk < (a->num_chunks - 1) && (c->num_elements + (next = a->chunks[chunk + 1])->num_elements) <= (_CUPS_CHUNKSIZE / 2))
+  {
+   /*
+    * Merge the next chunk into this one...
+    */
+
+    memcpy(c->elements + c->num_elements, next->elements, (size_t)next->num_elements * sizeof(void *));
+    c->num_elements += next->num_elements;
+
+    free(next);
+
+    a->num_chunks --;
+
+    if ((chunk + 1) < a->num_chunks)
+      memmove(a->chunks + chunk + 1, a->chunks + chunk + 2, (size_t)(a->num_chunks - chunk - 1) * sizeof(_cups_achunk_t *));
+  }
+
+  if (chunk < a->num_chunks)
+  {
+    a->cache_chunk = chunk;
+    a->cache_start = start;
+  }
+  else
+  {
+    a->cache_chunk = 0;
+    a->cache_start = 0;
+  }
+
+  return (e);
+}
+
+
+/*
+ * 'cups_array_unlock()' - Unlock a locked array.
+ */
+
+static void
+cups_array_unlock(cups_array_t *a)	/* I - Array */
+{
+  if (a->locked)
+    _cupsMutexUnlock(&a->mutex);
+}
@@ -0,0 +1,915 @@
+/*
+ * Core API benchmark program for CUPS.
+ *
+ * Copyright 2007-2016 by Apple Inc.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cups-private.h"
+#include "http-private.h"
+#include "ipp-private.h"
+#include <sys/time.h>
+#include <sys/socket.h>
+
+
+/*
+ * Constants...
+ */
+
+#define BENCH_PASSES	5		/* Default number of passes */
+#define BENCH_MAX_PASSES 100		/* Maximum number of passes */
+#define BENCH_OPS	100000		/* Target operations per pass */
+
+
+/*
+ * Local types...
+ */
+
+typedef int (*bench_func_t)(int size, double *secs);
+					/**** Benchmark function ****/
+
+typedef struct bench_s			/**** Benchmark ****/
+{
+  const char	*name;			/* Name of benchmark */
+  bench_func_t	func;			/* Function to run */
+  int		sizes[4];		/* Sizes to test, 0 terminated */
+} bench_t;
+
+typedef struct bench_buffer_s		/**** Memory buffer for IPP I/O ****/
+{
+  size_t	rpos,			/* Read position */
+		wused,			/* Bytes used */
+		wsize;			/* Size of buffer */
+  ipp_uchar_t	*wbuffer;		/* Buffer */
+} bench_buffer_t;
+
+
+/*
+ * Local functions...
+ */
+
+static int	bench_array_add(int size, double *secs);
+static int	bench_array_find(int size, double *secs);
+static int	bench_array_iterate(int size, double *secs);
+static int	bench_file_gets(int size, double *secs);
+static int	bench_file_gets_gz(int size, double *secs);
+static int	bench_http_update(int size, double *secs);
+static int	bench_ipp_find(int size, double *secs);
+static int	bench_ipp_read(int size, double *secs);
+static int	bench_ipp_write(int size, double *secs);
+static int	bench_str_alloc(int size, double *secs);
+static int	compare_secs(const void *a, const void *b);
+static int	file_gets(int size, double *secs, int compression);
+static double	get_time(void);
+static char	**make_keys(int size);
+static ipp_t	*make_printer_attrs(void);
+static ssize_t	read_cb(bench_buffer_t *buffer, ipp_uchar_t *data, size_t bytes);
+static void	*str_alloc_thread(void *data);
+static int	usage(void);
+static ssize_t	write_cb(bench_buffer_t *buffer, ipp_uchar_t *data, size_t bytes);
+
+
+/*
+ * Local globals...
+ */
+
+static const bench_t benches[] =	/* Benchmarks */
+{
+  { "array-add",	bench_array_add,	{ 100, 10000, 100000, 0 } },
+  { "array-find",	bench_array_find,	{ 100, 10000, 100000, 0 } },
+  { "array-iterate",	bench_array_iterate,	{ 100, 10000, 100000, 0 } },
+  { "file-gets",	bench_file_gets,	{ 10000, 0 } },
+  { "file-gets-gz",	bench_file_gets_gz,	{ 10000, 0 } },
+  { "http-update",	bench_http_update,	{ 10, 30, 0 } },
+  { "ipp-find",		bench_ipp_find,		{ 1, 0 } },
+  { "ipp-read",		bench_ipp_read,		{ 1, 0 } },
+  { "ipp-write",	bench_ipp_write,	{ 1, 0 } },
+  { "str-alloc",	bench_str_alloc,	{ 1, 4, 8, 0 } }
+};
+
+
+/*
+ * 'main()' - Run the core API benchmarks.
+ *
+ * Each benchmark is run for several passes and the median and minimum time
+ * per operation are reported.  Arguments other than options select the
+ * benchmarks to run by name prefix.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line args */
+     char *argv[])			/* I - Command-line arguments */
+{
+  int		i, j, k;		/* Looping vars */
+  int		num_passes = BENCH_PASSES,
+					/* Number of passes */
+		csv = 0,		/* Produce CSV output? */
+		num_names = 0,		/* Number of benchmark names */
+		ops = 0;		/* Operations in pass */
+  const char	*names[100];		/* Benchmark names */
+  double	secs,			/* Time for pass */
+		nsecs[BENCH_MAX_PASSES];/* Nanoseconds per operation */
+
+
+ /*
+  * See if we have anything on the command-line...
+  */
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-o") && (i + 1) < argc)
+    {
+      i ++;
+
+      if (!strcmp(argv[i], "csv"))
+        csv = 1;
+      else if (strcmp(argv[i], "text"))
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-p") && (i + 1) < argc)
+    {
+      i ++;
+
+      if ((num_passes = atoi(argv[i])) < 1 || num_passes > BENCH_MAX_PASSES)
+        return (usage());
+    }
+    else if (argv[i][0] != '-' && num_names < (int)(sizeof(names) / sizeof(names[0])))
+      names[num_names ++] = argv[i];
+    else
+      return (usage());
+  }
+
+ /*
+  * Run the benchmarks...
+  */
+
+  if (csv)
+    puts("benchmark,size,passes,ops,ns_per_op_p50,ns_per_op_min,ops_per_sec_p50");
+  else
+    printf("%-16s %8s %10s %14s %14s %14s\n", "Benchmark", "Size", "Ops/Pass", "ns/op (p50)", "ns/op (min)", "ops/s (p50)");
+
+  for (i = 0; i < (int)(sizeof(benches) / sizeof(benches[0])); i ++)
+  {
+    if (num_names > 0)
+    {
+      for (j = 0; j < num_names; j ++)
+        if (!strncmp(benches[i].name, names[j], strlen(names[j])))
+          break;
+
+      if (j >= num_names)
+        continue;
+    }
+
+    for (j = 0; j < 4 && benches[i].sizes[j]; j ++)
+    {
+      for (k = 0; k < num_passes; k ++)
+      {
+        if ((ops = (benches[i].func)(benches[i].sizes[j], &secs)) <= 0)
+        {
+          fprintf(stderr, "corebench: %s(%d) failed.\n", benches[i].name, benches[i].sizes[j]);
+          return (1);
+        }
+
+        nsecs[k] = 1000000000.0 * secs / ops;
+      }
+
+      qsort(nsecs, (size_t)num_passes, sizeof(double), compare_secs);
+
+      if (csv)
+        printf("%s,%d,%d,%d,%.1f,%.1f,%.0f\n", benches[i].name, benches[i].sizes[j], num_passes, ops, nsecs[num_passes / 2], nsecs[0], 1000000000.0 / nsecs[num_passes / 2]);
+      else
+        printf("%-16s %8d %10d %14.1f %14.1f %14.0f\n", benches[i].name, benches[i].sizes[j], ops, nsecs[num_passes / 2], nsecs[0], 1000000000.0 / nsecs[num_passes / 2]);
+
+      fflush(stdout);
+    }
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'bench_array_add()' - Benchmark adding elements to a sorted array.
+ */
+
+static int				/* O - Number of operations */
+bench_array_add(int    size,		/* I - Number of elements */
+                double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  char		**keys;			/* Keys to add */
+  cups_array_t	*array;			/* Array */
+  double	start;			/* Start time */
+
+
+  if ((keys = make_keys(size)) == NULL)
+    return (0);
+
+  array = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+  start = get_time();
+
+  for (i = 0; i < size; i ++)
+    cupsArrayAdd(array, keys[i]);
+
+  *secs = get_time() - start;
+
+  cupsArrayDelete(array);
+  free(keys[0]);
+  free(keys);
+
+  return (size);
+}
+
+
+/*
+ * 'bench_array_find()' - Benchmark finding elements in a sorted array.
+ */
+
+static int				/* O - Number of operations */
+bench_array_find(int    size,		/* I - Number of elements */
+                 double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  char		**keys;			/* Keys to find */
+  cups_array_t	*array;			/* Array */
+  double	start;			/* Start time */
+
+
+  if ((keys = make_keys(size)) == NULL)
+    return (0);
+
+  array = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+
+  for (i = 0; i < size; i ++)
+    cupsArrayAdd(array, keys[i]);
+
+  start = get_time();
+
+  for (i = 0; i < BENCH_OPS; i ++)
+    if (!cupsArrayFind(array, keys[(i * 7919) % size]))
+      break;
+
+  *secs = get_time() - start;
+
+  cupsArrayDelete(array);
+  free(keys[0]);
+  free(keys);
+
+  return (i < BENCH_OPS ? 0 : BENCH_OPS);
+}
+
+
+/*
+ * 'bench_array_iterate()' - Benchmark iterating over an array.
+ */
+
+static int				/* O - Number of operations */
+bench_array_iterate(int    size,	/* I - Number of elements */
+                    double *secs)	/* O - Elapsed time */
+{
+  int		i,			/* Looping var */
+		count,			/* Number of elements seen */
+		rounds;			/* Number of times to iterate */
+  char		**keys;			/* Keys to add */
+  cups_array_t	*array;			/* Array */
+  void		*element;		/* Current element */
+  double	start;			/* Start time */
+
+
+  if ((keys = make_keys(size)) == NULL)
+    return (0);
+
+  array = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+
+  for (i = 0; i < size; i ++)
+    cupsArrayAdd(array, keys[i]);
+
+  if ((rounds = BENCH_OPS / size) < 1)
+    rounds = 1;
+
+  start = get_time();
+
+  for (i = 0, count = 0; i < rounds; i ++)
+    for (element = cupsArrayFirst(array); element; element = cupsArrayNext(array))
+      count ++;
+
+  *secs = get_time() - start;
+
+  cupsArrayDelete(array);
+  free(keys[0]);
+  free(keys);
+
+  return (count == rounds * size ? count : 0);
+}
+
+
+/*
+ * 'bench_file_gets()' - Benchmark reading lines from an uncompressed file.
+ */
+
+static int				/* O - Number of operations */
+bench_file_gets(int    size,		/* I - Number of lines */
+                double *secs)		/* O - Elapsed time */
+{
+  return (file_gets(size, secs, 0));
+}
+
+
+/*
+ * 'bench_file_gets_gz()' - Benchmark reading lines from a compressed file.
+ */
+
+static int				/* O - Number of operations */
+bench_file_gets_gz(int    size,		/* I - Number of lines */
+                   double *secs)	/* O - Elapsed time */
+{
+  return (file_gets(size, secs, 1));
+}
+
+
+/*
+ * 'bench_http_update()' - Benchmark parsing HTTP response header fields.
+ */
+
+static int				/* O - Number of operations */
+bench_http_update(int    size,		/* I - Number of header fields */
+                  double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  int		fds[2];			/* Socket pair */
+  http_t	*http;			/* HTTP connection */
+  char		response[8192],		/* HTTP response */
+		*ptr;			/* Pointer into response */
+  size_t	length;			/* Length of response */
+  double	start,			/* Start time */
+		elapsed = 0.0;		/* Elapsed time */
+  static const char * const fields[] =	/* Header fields to send */
+  {
+    "Connection: Keep-Alive",
+    "Content-Language: en-US",
+    "Content-Length: 0",
+    "Content-Type: application/ipp",
+    "Date: Tue, 15 Oct 2024 12:00:00 GMT",
+    "Keep-Alive: timeout=30",
+    "Last-Modified: Tue, 15 Oct 2024 12:00:00 GMT",
+    "Server: CUPS/2.3 IPP/2.1",
+    "Cache-Control: no-cache",
+    "X-Frame-Options: DENY"
+  };
+
+
+ /*
+  * Build a response with the requested number of header fields...
+  */
+
+  strlcpy(response, "HTTP/1.1 200 OK\r\n", sizeof(response));
+
+  for (i = 0, ptr = response + strlen(response); i < size; i ++, ptr += strlen(ptr))
+  {
+    if (i < (int)(sizeof(fields) / sizeof(fields[0])))
+      snprintf(ptr, sizeof(response) - (size_t)(ptr - response), "%s\r\n", fields[i]);
+    else
+      snprintf(ptr, sizeof(response) - (size_t)(ptr - response), "X-Field-%d: value-%d\r\n", i, i);
+  }
+
+  strlcpy(ptr, "\r\n", sizeof(response) - (size_t)(ptr - response));
+  length = strlen(response);
+
+ /*
+  * Create an unconnected client and attach it to one end of a socket pair so
+  * the response can be parsed without a server...
+  */
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+    return (0);
+
+  if ((http = httpConnect2("localhost", 631, NULL, AF_UNSPEC, HTTP_ENCRYPTION_NEVER, 1, 0, NULL)) == NULL)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return (0);
+  }
+
+  http->fd = fds[0];
+
+  for (i = 0; i < BENCH_OPS / 10; i ++)
+  {
+    if (write(fds[1], response, length) != (ssize_t)length)
+      break;
+
+    http->state = HTTP_STATE_GET;
+    start       = get_time();
+
+    if (httpUpdate(http) != HTTP_STATUS_OK)
+      break;
+
+    elapsed += get_time() - start;
+  }
+
+  *secs = elapsed;
+
+  httpClose(http);
+  close(fds[1]);
+
+  return (i < (BENCH_OPS / 10) ? 0 : i);
+}
+
+
+/*
+ * 'bench_ipp_find()' - Benchmark finding attributes in a printer response.
+ */
+
+static int				/* O - Number of operations */
+bench_ipp_find(int    size,		/* I - Unused */
+               double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  ipp_t		*ipp;			/* Printer attributes */
+  ipp_attribute_t *attr;		/* Current attribute */
+  const char	*names[100];		/* Attribute names */
+  int		num_names;		/* Number of attribute names */
+  double	start;			/* Start time */
+
+
+  (void)size;
+
+  ipp = make_printer_attrs();
+
+  for (attr = ippFirstAttribute(ipp), num_names = 0; attr && num_names < (int)(sizeof(names) / sizeof(names[0])); attr = ippNextAttribute(ipp))
+    if (ippGetName(attr))
+      names[num_names ++] = ippGetName(attr);
+
+  start = get_time();
+
+  for (i = 0; i < BENCH_OPS; i ++)
+    ippFindAttribute(ipp, names[(i * 7919) % num_names], IPP_TAG_ZERO);
+
+  *secs = get_time() - start;
+
+  ippDelete(ipp);
+
+  return (BENCH_OPS);
+}
+
+
+/*
+ * 'bench_ipp_read()' - Benchmark reading a printer response.
+ */
+
+static int				/* O - Number of operations */
+bench_ipp_read(int    size,		/* I - Unused */
+               double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  ipp_t		*ipp;			/* Printer attributes */
+  bench_buffer_t buffer;		/* Memory buffer */
+  ipp_state_t	state;			/* Read state */
+  double	start;			/* Start time */
+
+
+  (void)size;
+
+  ipp = make_printer_attrs();
+
+  buffer.wsize   = ippLength(ipp);
+  buffer.wused   = 0;
+  buffer.rpos    = 0;
+  buffer.wbuffer = malloc(buffer.wsize);
+
+  while ((state = ippWriteIO(&buffer, (ipp_iocb_t)write_cb, 1, NULL, ipp)) != IPP_STATE_DATA)
+    if (state == IPP_STATE_ERROR)
+      break;
+
+  ippDelete(ipp);
+
+  start = get_time();
+
+  for (i = 0; i < BENCH_OPS / 100 && state == IPP_STATE_DATA; i ++)
+  {
+    buffer.rpos = 0;
+    ipp         = ippNew();
+
+    while ((state = ippReadIO(&buffer, (ipp_iocb_t)read_cb, 1, NULL, ipp)) != IPP_STATE_DATA)
+      if (state == IPP_STATE_ERROR)
+        break;
+
+    ippDelete(ipp);
+  }
+
+  *secs = get_time() - start;
+
+  free(buffer.wbuffer);
+
+  return (state == IPP_STATE_DATA ? i : 0);
+}
+
+
+/*
+ * 'bench_ipp_write()' - Benchmark writing a printer response.
+ */
+
+static int				/* O - Number of operations */
+bench_ipp_write(int    size,		/* I - Unused */
+                double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  ipp_t		*ipp;			/* Printer attributes */
+  bench_buffer_t buffer;		/* Memory buffer */
+  ipp_state_t	state = IPP_STATE_DATA;	/* Write state */
+  double	start;			/* Start time */
+
+
+  (void)size;
+
+  ipp = make_printer_attrs();
+
+  buffer.wsize   = ippLength(ipp);
+  buffer.rpos    = 0;
+  buffer.wbuffer = malloc(buffer.wsize);
+
+  start = get_time();
+
+  for (i = 0; i < BENCH_OPS / 100 && state == IPP_STATE_DATA; i ++)
+  {
+    buffer.wused = 0;
+    ippSetState(ipp, IPP_STATE_IDLE);
+
+    while ((state = ippWriteIO(&buffer, (ipp_iocb_t)write_cb, 1, NULL, ipp)) != IPP_STATE_DATA)
+      if (state == IPP_STATE_ERROR)
+        break;
+  }
+
+  *secs = get_time() - start;
+
+  ippDelete(ipp);
+  free(buffer.wbuffer);
+
+  return (state == IPP_STATE_DATA ? i : 0);
+}
+
+
+/*
+ * 'bench_str_alloc()' - Benchmark the string pool from multiple threads.
+ */
+
+static int				/* O - Number of operations */
+bench_str_alloc(int    size,		/* I - Number of threads */
+                double *secs)		/* O - Elapsed time */
+{
+  int		i;			/* Looping var */
+  _cups_thread_t threads[8];		/* Threads */
+  double	start;			/* Start time */
+
+
+  if (size > (int)(sizeof(threads) / sizeof(threads[0])))
+    size = (int)(sizeof(threads) / sizeof(threads[0]));
+
+  start = get_time();
+
+  for (i = 0; i < size; i ++)
+    threads[i] = _cupsThreadCreate(str_alloc_thread, NULL);
+
+  for (i = 0; i < size; i ++)
+    _cupsThreadWait(threads[i]);
+
+  *secs = get_time() - start;
+
+  return (size * BENCH_OPS);
+}
+
+
+/*
+ * 'compare_secs()' - Compare two time samples.
+ */
+
+static int				/* O - Result of comparison */
+compare_secs(const void *a,		/* I - First sample */
+             const void *b)		/* I - Second sample */
+{
+  double	da = *((const double *)a),
+		db = *((const double *)b);
+
+
+  return (da < db ? -1 : da > db);
+}
+
+
+/*
+ * 'file_gets()' - Benchmark reading lines from a file.
+ */
+
+static int				/* O - Number of operations */
+file_gets(int    size,			/* I - Number of lines */
+          double *secs,			/* O - Elapsed time */
+          int    compression)		/* I - Compress the file? */
+{
+  int		i;			/* Looping var */
+  cups_file_t	*fp;			/* File */
+  char		filename[1024],		/* Temporary file */
+		line[1024];		/* Line from file */
+  int		count = 0;		/* Number of lines read */
+  double	start;			/* Start time */
+
+
+  if ((fp = cupsTempFile2(filename, sizeof(filename))) == NULL)
+    return (0);
+
+  cupsFileClose(fp);
+
+  if ((fp = cupsFileOpen(filename, compression ? "w9" : "w")) == NULL)
+  {
+    unlink(filename);
+    return (0);
+  }
+
+  for (i = 0; i < size; i ++)
+    cupsFilePrintf(fp, "*%% Line %d of a typical configuration file.\n*Option%d: \"value-%d\"\n", i, i, i);
+
+  cupsFileClose(fp);
+
+  start = get_time();
+
+  if ((fp = cupsFileOpen(filename, "r")) != NULL)
+  {
+    while (cupsFileGets(fp, line, sizeof(line)))
+      count ++;
+
+    cupsFileClose(fp);
+  }
+
+  *secs = get_time() - start;
+
+  unlink(filename);
+
+  return (count == 2 * size ? count : 0);
+}
+
+
+/*
+ * 'get_time()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+get_time(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
+/*
+ * 'make_keys()' - Make an array of unique string keys in a shuffled order.
+ *
+ * The keys share a single allocation that is freed using the first key.
+ */
+
+static char **				/* O - Keys or `NULL` on error */
+make_keys(int size)			/* I - Number of keys */
+{
+  int		i, j;			/* Looping vars */
+  char		**keys,			/* Keys */
+		*key,			/* Current key */
+		*temp;			/* Swap variable */
+
+
+  if ((keys = calloc((size_t)size, sizeof(char *))) == NULL)
+    return (NULL);
+
+  if ((key = malloc((size_t)size * 16)) == NULL)
+  {
+    free(keys);
+    return (NULL);
+  }
+
+  for (i = 0; i < size; i ++, key += 16)
+  {
+    snprintf(key, 16, "key-%08d", i);
+    keys[i] = key;
+  }
+
+ /*
+  * Shuffle the keys (but not the first, which owns the allocation) using a
+  * fixed seed so that every pass does the same work...
+  */
+
+  for (i = size - 1, j = 1; i > 1; i --)
+  {
+    j       = 1 + (int)(((unsigned)j * 1103515245U + 12345U) % (unsigned)i);
+    temp    = keys[i];
+    keys[i] = keys[j];
+    keys[j] = temp;
+  }
+
+  return (keys);
+}
+
+
+/*
+ * 'make_printer_attrs()' - Make a typical set of printer attributes.
+ */
+
+static ipp_t *				/* O - Printer attributes */
+make_printer_attrs(void)
+{
+  int		i;			/* Looping var */
+  ipp_t		*ipp,			/* Printer attributes */
+		*col;			/* media-col value */
+  char		name[256];		/* Attribute name */
+  static const char * const media[] =	/* media-supported values */
+  {
+    "iso_a3_297x420mm", "iso_a4_210x297mm", "iso_a5_148x210mm",
+    "iso_a6_105x148mm", "iso_b5_176x250mm", "iso_c5_162x229mm",
+    "iso_dl_110x220mm", "jis_b5_182x257mm", "na_index-4x6_4x6in",
+    "na_legal_8.5x14in", "na_letter_8.5x11in", "na_number-10_4.125x9.5in",
+    "na_5x7_5x7in", "na_ledger_11x17in", "om_small-photo_100x150mm"
+  };
+  static const char * const formats[] =	/* document-format-supported values */
+  {
+    "application/octet-stream", "application/pdf", "application/postscript",
+    "image/jpeg", "image/pwg-raster", "image/urf", "text/plain"
+  };
+  static const int ops[] =		/* operations-supported values */
+  {
+    IPP_OP_PRINT_JOB, IPP_OP_VALIDATE_JOB, IPP_OP_CREATE_JOB,
+    IPP_OP_SEND_DOCUMENT, IPP_OP_CANCEL_JOB, IPP_OP_GET_JOB_ATTRIBUTES,
+    IPP_OP_GET_JOBS, IPP_OP_GET_PRINTER_ATTRIBUTES, IPP_OP_HOLD_JOB,
+    IPP_OP_RELEASE_JOB, IPP_OP_PAUSE_PRINTER, IPP_OP_RESUME_PRINTER,
+    IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS, IPP_OP_CREATE_JOB_SUBSCRIPTIONS,
+    IPP_OP_GET_SUBSCRIPTION_ATTRIBUTES, IPP_OP_GET_SUBSCRIPTIONS,
+    IPP_OP_CANCEL_SUBSCRIPTION, IPP_OP_GET_NOTIFICATIONS,
+    IPP_OP_CANCEL_MY_JOBS, IPP_OP_CLOSE_JOB, IPP_OP_IDENTIFY_PRINTER
+  };
+
+
+  ipp = ippNew();
+
+  ippSetOperation(ipp, IPP_OP_GET_PRINTER_ATTRIBUTES);
+  ippSetRequestId(ipp, 1);
+
+  ippAddString(ipp, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_CHARSET), "attributes-charset", NULL, "utf-8");
+  ippAddString(ipp, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_LANGUAGE), "attributes-natural-language", NULL, "en");
+
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_URI, "printer-uri-supported", NULL, "ipp://printer.example.com/ipp/print");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "uri-security-supported", NULL, "none");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "uri-authentication-supported", NULL, "none");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_NAME, "printer-name", NULL, "Example Printer");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-location", NULL, "Second Floor");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-info", NULL, "Example Printer");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-make-and-model", NULL, "Example Laser Printer");
+  ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_ENUM, "printer-state", IPP_PSTATE_IDLE);
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "printer-state-reasons", NULL, "none");
+  ippAddBoolean(ipp, IPP_TAG_PRINTER, "printer-is-accepting-jobs", 1);
+  ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "printer-up-time", 123456);
+  ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", 0);
+  ippAddIntegers(ipp, IPP_TAG_PRINTER, IPP_TAG_ENUM, "operations-supported", (int)(sizeof(ops) / sizeof(ops[0])), ops);
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_CHARSET), "charset-configured", NULL, "utf-8");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_CHARSET), "charset-supported", NULL, "utf-8");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_LANGUAGE), "natural-language-configured", NULL, "en");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_LANGUAGE), "generated-natural-language-supported", NULL, "en");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_MIMETYPE), "document-format-default", NULL, "application/octet-stream");
+  ippAddStrings(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_MIMETYPE), "document-format-supported", (int)(sizeof(formats) / sizeof(formats[0])), NULL, formats);
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-default", NULL, "na_letter_8.5x11in");
+  ippAddStrings(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-supported", (int)(sizeof(media) / sizeof(media[0])), NULL, media);
+  ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "copies-default", 1);
+  ippAddRange(ipp, IPP_TAG_PRINTER, "copies-supported", 1, 999);
+  ippAddResolution(ipp, IPP_TAG_PRINTER, "printer-resolution-default", IPP_RES_PER_INCH, 600, 600);
+  ippAddResolution(ipp, IPP_TAG_PRINTER, "printer-resolution-supported", IPP_RES_PER_INCH, 600, 600);
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "sides-default", NULL, "one-sided");
+  ippAddString(ipp, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "print-color-mode-default", NULL, "auto");
+
+  for (i = 0; i < (int)(sizeof(media) / sizeof(media[0])); i ++)
+  {
+    pwg_media_t	*pwg = pwgMediaForPWG(media[i]);
+					/* Media size */
+    ipp_t	*size = ippNew();	/* media-size value */
+
+    ippAddInteger(size, IPP_TAG_ZERO, IPP_TAG_INTEGER, "x-dimension", pwg ? pwg->width : 21000);
+    ippAddInteger(size, IPP_TAG_ZERO, IPP_TAG_INTEGER, "y-dimension", pwg ? pwg->length : 29700);
+
+    col = ippNew();
+    ippAddCollection(col, IPP_TAG_ZERO, "media-size", size);
+    ippAddString(col, IPP_TAG_ZERO, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-source", NULL, "main");
+    ippAddString(col, IPP_TAG_ZERO, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-type", NULL, "stationery");
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "media-bottom-margin", 423);
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "media-left-margin", 423);
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "media-right-margin", 423);
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "media-top-margin", 423);
+
+    snprintf(name, sizeof(name), "media-col-ready-%d", i);
+    ippAddCollection(ipp, IPP_TAG_PRINTER, name, col);
+
+    ippDelete(size);
+    ippDelete(col);
+  }
+
+  for (i = 0; i < 20; i ++)
+  {
+    snprintf(name, sizeof(name), "marker-level-%d", i);
+    ippAddInteger(ipp, IPP_TAG_PRINTER, IPP_TAG_INTEGER, name, 50 + i);
+  }
+
+  return (ipp);
+}
+
+
+/*
+ * 'read_cb()' - Read data from a buffer.
+ */
+
+static ssize_t				/* O - Number of bytes read */
+read_cb(bench_buffer_t *buffer,		/* I - Buffer */
+        ipp_uchar_t    *data,		/* O - Data read */
+        size_t         bytes)		/* I - Number of bytes to read */
+{
+  size_t	count;			/* Number of bytes */
+
+
+  if ((count = buffer->wused - buffer->rpos) > bytes)
+    count = bytes;
+
+  memcpy(data, buffer->wbuffer + buffer->rpos, count);
+  buffer->rpos += count;
+
+  return ((ssize_t)count);
+}
+
+
+/*
+ * 'str_alloc_thread()' - Allocate and free pooled strings.
+ */
+
+static void *				/* O - Thread exit status */
+str_alloc_thread(void *data)		/* I - Unused */
+{
+  int		i;			/* Looping var */
+  char		*strings[100],		/* Allocated strings */
+		s[32];			/* String value */
+
+
+  (void)data;
+
+  memset(strings, 0, sizeof(strings));
+
+  for (i = 0; i < BENCH_OPS; i ++)
+  {
+    if (strings[i % 100])
+      _cupsStrFree(strings[i % 100]);
+
+    snprintf(s, sizeof(s), "string-%d", i % 1000);
+    strings[i % 100] = _cupsStrAlloc(s);
+  }
+
+  for (i = 0; i < 100; i ++)
+    _cupsStrFree(strings[i]);
+
+  return (NULL);
+}
+
+
+/*
+ * 'usage()' - Show program usage.
+ */
+
+static int				/* O - Exit status */
+usage(void)
+{
+  puts("Usage: corebench [options] [benchmark ...]");
+  puts("Options:");
+  puts("  -o {text,csv}           Output format (default text).");
+  puts("  -p passes               Number of passes (default 5).");
+  puts("Benchmarks:");
+  puts("  array-add, array-find, array-iterate, file-gets, file-gets-gz,");
+  puts("  http-update, ipp-find, ipp-read, ipp-write, str-alloc");
+
+  return (1);
+}
+
+
+/*
+ * 'write_cb()' - Write data into a buffer.
+ */
+
+static ssize_t				/* O - Number of bytes written */
+write_cb(bench_buffer_t *buffer,	/* I - Buffer */
+         ipp_uchar_t    *data,		/* I - Data to write */
+         size_t         bytes)		/* I - Number of bytes to write */
+{
+  size_t	count;			/* Number of bytes */
+
+
+  if ((count = buffer->wsize - buffer->wused) > bytes)
+    count = bytes;
+
+  memcpy(buffer->wbuffer + buffer->wused, data, count);
+  buffer->wused += count;
+
+  return ((ssize_t)count);
+}
@@ -142,6 +142,7 @@ typedef struct _cups_globals_s		/**** CUPS global state data ****/
   cups_array_t		*leg_size_lut,	/* Lookup table for legacy names */
 			*ppd_size_lut,	/* Lookup table for PPD names */
 			*pwg_size_lut;	/* Lookup table for PWG names */
+  pwg_media_t		**dim_size_lut;	/* Lookup table for dimensions */
   pwg_media_t		pwg_media;	/* PWG media data for custom size */
   char			pwg_name[65],	/* PWG media name for custom size */
 			ppd_name[41];	/* PPD media name for custom size */
@@ -218,8 +219,15 @@ typedef struct _cups_dconstres_s	/* Constraint/resolver */
 {
   char	*name;				/* Name of resolver */
   ipp_t	*collection;			/* Collection containing attrs */
+  int	index;				/* Index in constraints array */
 } _cups_dconstres_t;
 
+typedef struct _cups_dconstopt_s	/* Options used by constraints */
+{
+  const char	*name;			/* Option/attribute name */
+  cups_array_t	*constraints;		/* Constraints using the option */
+} _cups_dconstopt_t;
+
 struct _cups_dinfo_s			/* Destination capability and status
 					 * information */
 {
@@ -230,6 +238,7 @@ struct _cups_dinfo_s			/* Destination capability and status
   int			num_defaults;	/* Number of default options */
   cups_option_t		*defaults;	/* Default options */
   cups_array_t		*constraints;	/* Job constraints */
+  cups_array_t		*constraint_opts;/* Constraints indexed by option */
   cups_array_t		*resolvers;	/* Job resolvers */
   cups_array_t		*localizations;	/* Localization information */
   cups_array_t		*media_db;	/* Media database */
@@ -240,6 +249,10 @@ struct _cups_dinfo_s			/* Destination capability and status
   time_t		ready_time;	/* When xxx-ready attributes were last queried */
   ipp_t			*ready_attrs;	/* xxx-ready attributes */
   cups_array_t		*ready_db;	/* media[-col]-ready media database */
+  int			config_time;	/* printer-config-change-time value */
+  char			*cache_uri;	/* Copy of URI for cached information */
+  int			cached,		/* In the destination information cache? */
+			in_use;		/* Checked out of the cache? */
 };
 
 
@@ -247,6 +247,10 @@ typedef struct cups_option_s		/**** Printer Options ****/
   char		*value;			/* Value of option */
 } cups_option_t;
 
+typedef struct _cups_options_s cups_options_t;
+					/**** Option container
+					 * @since CUPS 2.4@ ****/
+
 typedef struct cups_dest_s		/**** Destination ****/
 {
   char		*name,			/* Printer or class name */
@@ -604,6 +608,18 @@ extern const char	*cupsHashString(const unsigned char *hash, size_t hashsize, ch
 extern int		cupsAddDestMediaOptions(http_t *http, cups_dest_t *dest, cups_dinfo_t *dinfo, unsigned flags, cups_size_t *size, int num_options, cups_option_t **options) _CUPS_API_2_3;
 extern ipp_attribute_t	*cupsEncodeOption(ipp_t *ipp, ipp_tag_t group_tag, const char *name, const char *value) _CUPS_API_2_3;
 
+/* New in CUPS 2.4 */
+extern int		cupsGetResponses(http_t *http, int num_responses, ipp_t **responses, const char *resource) _CUPS_API_2_4;
+extern int		cupsOptionsAdd(cups_options_t *opts, const char *name, const char *value) _CUPS_API_2_4;
+extern int		cupsOptionsCount(cups_options_t *opts) _CUPS_API_2_4;
+extern void		cupsOptionsDelete(cups_options_t *opts) _CUPS_API_2_4;
+extern const char	*cupsOptionsGet(cups_options_t *opts, const char *name) _CUPS_API_2_4;
+extern cups_option_t	*cupsOptionsGetArray(cups_options_t *opts) _CUPS_API_2_4;
+extern cups_options_t	*cupsOptionsNew(void) _CUPS_API_2_4;
+extern int		cupsOptionsParse(cups_options_t *opts, const char *arg) _CUPS_API_2_4;
+extern int		cupsOptionsRemove(cups_options_t *opts, const char *name) _CUPS_API_2_4;
+extern int		cupsSendRequests(http_t *http, int num_requests, ipp_t **requests, const char *resource) _CUPS_API_2_4;
+
 #  ifdef __cplusplus
 }
 #  endif /* __cplusplus */
@@ -12,13 +12,49 @@
 
 #include "cups-private.h"
 #include "debug-internal.h"
+#include <sys/stat.h>
+
+
+/*
+ * Local constants...
+ */
+
+#define _CUPS_STRINGS_MAX	16	/* Max strings files cached in memory */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct _cups_strings_s		/* Cached printer strings file */
+{
+  char		*uri;			/* printer-strings-uri value */
+  int		config_time;		/* printer-config-change-time value */
+  time_t	used;			/* Time of last use */
+  cups_array_t	*messages;		/* Localized strings */
+} _cups_strings_t;
+
+
+/*
+ * Local globals...
+ */
+
+static _cups_mutex_t	strings_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex to control access to cache */
+static cups_array_t	*strings_cache = NULL;
+					/* Cached strings files */
 
 
 /*
  * Local functions...
  */
 
-static void	cups_create_localizations(http_t *http, cups_dinfo_t *dinfo);
+static cups_array_t	*cups_copy_localizations(cups_array_t *a);
+static void		cups_create_localizations(http_t *http, cups_dinfo_t *dinfo);
+static int		cups_strings_compare(_cups_strings_t *a, _cups_strings_t *b);
+static cups_array_t	*cups_strings_get(const char *uri, int config_time);
+static void		cups_strings_put(const char *uri, int config_time, cups_array_t *messages);
+static void		cups_strings_write(const char *filename, const char *uri, int config_time, time_t mtime, const char *srcfile, int skip);
 
 
 /*
@@ -316,9 +352,52 @@ cupsLocalizeDestValue(
 }
 
 
+/*
+ * 'cups_copy_localizations()' - Copy a localizations array.
+ */
+
+static cups_array_t *			/* O - New localizations array */
+cups_copy_localizations(cups_array_t *a)/* I - Localizations to copy */
+{
+  cups_array_t		*na;		/* New localizations array */
+  _cups_message_t	*m,		/* Current message */
+			*nm;		/* New message */
+
+
+  if ((na = _cupsMessageNew(NULL)) == NULL)
+    return (NULL);
+
+  for (m = (_cups_message_t *)cupsArrayFirst(a); m; m = (_cups_message_t *)cupsArrayNext(a))
+  {
+    if ((nm = calloc(1, sizeof(_cups_message_t))) == NULL)
+      break;
+
+    nm->msg = strdup(m->msg);
+    nm->str = strdup(m->str);
+
+    if (!nm->msg || !nm->str)
+    {
+      free(nm->msg);
+      free(nm->str);
+      free(nm);
+      break;
+    }
+
+    cupsArrayAdd(na, nm);
+  }
+
+  return (na);
+}
+
+
 /*
  * 'cups_create_localizations()' - Create the localizations array for a
  *                                 destination.
+ *
+ * Strings files are cached in memory and in the per-user "~/.cups/strings"
+ * directory, keyed by the printer-strings-uri value and validated by the
+ * printer-config-change-time value.  When the configuration time changes,
+ * the cached file is revalidated using If-Modified-Since.
  */
 
 static void
@@ -329,16 +408,27 @@ cups_create_localizations(
   http_t		*http2;		/* Connection for strings file */
   http_status_t		status;		/* Request status */
   ipp_attribute_t	*attr;		/* "printer-strings-uri" attribute */
+  const char		*uri;		/* printer-strings-uri value */
+  int			config_time,	/* printer-config-change-time value */
+			cached = 0,	/* Have a cached file? */
+			cache_time = 0;	/* Cached printer-config-change-time */
+  time_t		mtime = 0;	/* Last-Modified time of cached file */
   char			scheme[32],	/* URI scheme */
   			userpass[256],	/* Username/password info */
   			hostname[256],	/* Hostname */
   			resource[1024],	/* Resource */
   			http_hostname[256],
   					/* Hostname of connection */
-			tempfile[1024];	/* Temporary filename */
+			tempfile[1024],	/* Temporary filename */
+			cachefile[1024],/* Cached strings file */
+			cacheuri[1024],	/* Cached printer-strings-uri value */
+			line[2048];	/* Line from cached file */
+  unsigned char		hash[32];	/* SHA-256 hash of URI */
   int			port;		/* Port number */
   http_encryption_t	encryption;	/* Encryption to use */
   cups_file_t		*temp;		/* Temporary file */
+  _cups_globals_t	*cg = _cupsGlobals();
+					/* Pointer to library globals */
 
 
  /*
@@ -357,21 +447,72 @@ cups_create_localizations(
     return;
   }
 
+  uri         = ippGetString(attr, 0, NULL);
+  config_time = ippGetInteger(ippFindAttribute(dinfo->attrs, "printer-config-change-time", IPP_TAG_INTEGER), 0);
+
+ /*
+  * Use the in-memory copy if the printer configuration has not changed...
+  */
+
+  if (config_time && (dinfo->localizations = cups_strings_get(uri, config_time)) != NULL)
+  {
+    DEBUG_printf(("4cups_create_localizations: %d cached messages.", cupsArrayCount(dinfo->localizations)));
+    return;
+  }
+
  /*
   * Pull apart the URI and determine whether we need to try a different
   * server...
   */
 
-  if (httpSeparateURI(HTTP_URI_CODING_ALL, attr->values[0].string.text,
+  if (httpSeparateURI(HTTP_URI_CODING_ALL, uri,
                       scheme, sizeof(scheme), userpass, sizeof(userpass),
                       hostname, sizeof(hostname), &port, resource,
                       sizeof(resource)) < HTTP_URI_STATUS_OK)
   {
     dinfo->localizations = _cupsMessageNew(NULL);
-    DEBUG_printf(("4cups_create_localizations: Bad printer-strings-uri value \"%s\".", attr->values[0].string.text));
+    DEBUG_printf(("4cups_create_localizations: Bad printer-strings-uri value \"%s\".", uri));
     return;
   }
 
+ /*
+  * Then see if we have the file on disk...  The first line is a comment with
+  * the printer-config-change-time value, Last-Modified time, and URI.
+  */
+
+  cachefile[0] = '\0';
+
+  if (cg->home && cupsHashData("sha2-256", uri, strlen(uri), hash, sizeof(hash)) == sizeof(hash))
+  {
+    char	hashstr[65];		/* Hex version of hash */
+
+    snprintf(cachefile, sizeof(cachefile), "%s/.cups/strings/%s.strings", cg->home, cupsHashString(hash, sizeof(hash), hashstr, sizeof(hashstr)));
+
+    if ((temp = cupsFileOpen(cachefile, "r")) != NULL)
+    {
+      long	temptime;		/* Last-Modified time */
+
+      if (cupsFileGets(temp, line, sizeof(line)) && sscanf(line, "/* CUPS-Strings %d %ld %1023s */", &cache_time, &temptime, cacheuri) == 3 && !strcmp(cacheuri, uri))
+      {
+        cached = 1;
+        mtime  = (time_t)temptime;
+      }
+
+      cupsFileClose(temp);
+    }
+
+    if (cached && config_time && cache_time == config_time)
+    {
+      DEBUG_printf(("4cups_create_localizations: Using cached \"%s\".", cachefile));
+
+      if ((dinfo->localizations = _cupsMessageLoad(cachefile, _CUPS_MESSAGE_STRINGS)) != NULL)
+      {
+        cups_strings_put(uri, config_time, dinfo->localizations);
+        return;
+      }
+    }
+  }
+
   httpGetHostname(http, http_hostname, sizeof(http_hostname));
 
   if (!_cups_strcasecmp(http_hostname, hostname) &&
@@ -416,6 +557,15 @@ cups_create_localizations(
     return;
   }
 
+ /*
+  * Revalidate the cached file, if any...
+  */
+
+  httpClearFields(http2);
+
+  if (mtime)
+    httpSetField(http2, HTTP_FIELD_IF_MODIFIED_SINCE, httpGetDateString(mtime));
+
   status = cupsGetFd(http2, resource, cupsFileNumber(temp));
   cupsFileClose(temp);
 
@@ -424,12 +574,30 @@ cups_create_localizations(
   if (status == HTTP_STATUS_OK)
   {
    /*
-    * Got the file, read it...
+    * Got the file, read it and save a copy...
     */
 
     dinfo->localizations = _cupsMessageLoad(tempfile, _CUPS_MESSAGE_STRINGS);
+
+    if (cachefile[0])
+      cups_strings_write(cachefile, uri, config_time, httpGetDateTime(httpGetField(http2, HTTP_FIELD_LAST_MODIFIED)), tempfile, 0);
+  }
+  else if (status == HTTP_STATUS_NOT_MODIFIED && mtime)
+  {
+   /*
+    * The cached file is still good, update the configuration time as
+    * needed...
+    */
+
+    dinfo->localizations = _cupsMessageLoad(cachefile, _CUPS_MESSAGE_STRINGS);
+
+    if (cache_time != config_time)
+      cups_strings_write(cachefile, uri, config_time, mtime, cachefile, 1);
   }
 
+  if (dinfo->localizations && config_time)
+    cups_strings_put(uri, config_time, dinfo->localizations);
+
   DEBUG_printf(("4cups_create_localizations: %d messages loaded.",
                 cupsArrayCount(dinfo->localizations)));
 
@@ -443,3 +611,182 @@ cups_create_localizations(
     httpClose(http2);
 }
 
+
+/*
+ * 'cups_strings_compare()' - Compare two cached strings files.
+ */
+
+static int				/* O - Result of comparison */
+cups_strings_compare(
+    _cups_strings_t *a,			/* I - First strings file */
+    _cups_strings_t *b)			/* I - Second strings file */
+{
+  return (strcmp(a->uri, b->uri));
+}
+
+
+/*
+ * 'cups_strings_get()' - Copy a cached strings file from memory.
+ */
+
+static cups_array_t *			/* O - Localizations or @code NULL@ if not cached */
+cups_strings_get(const char *uri,	/* I - printer-strings-uri value */
+                 int        config_time)/* I - printer-config-change-time value */
+{
+  _cups_strings_t	key,		/* Search key */
+			*strings;	/* Cached strings file */
+  cups_array_t		*a = NULL;	/* Localizations */
+
+
+  key.uri = (char *)uri;
+
+  _cupsMutexLock(&strings_mutex);
+
+  if ((strings = (_cups_strings_t *)cupsArrayFind(strings_cache, &key)) != NULL && strings->config_time == config_time)
+  {
+    strings->used = time(NULL);
+    a             = cups_copy_localizations(strings->messages);
+  }
+
+  _cupsMutexUnlock(&strings_mutex);
+
+  return (a);
+}
+
+
+/*
+ * 'cups_strings_put()' - Save a copy of a strings file in memory.
+ */
+
+static void
+cups_strings_put(
+    const char   *uri,			/* I - printer-strings-uri value */
+    int          config_time,		/* I - printer-config-change-time value */
+    cups_array_t *messages)		/* I - Localizations */
+{
+  _cups_strings_t	key,		/* Search key */
+			*strings,	/* Cached strings file */
+			*current;	/* Current strings file */
+
+
+  key.uri = (char *)uri;
+
+  _cupsMutexLock(&strings_mutex);
+
+  if (!strings_cache)
+    strings_cache = cupsArrayNew((cups_array_func_t)cups_strings_compare, NULL);
+
+  if ((strings = (_cups_strings_t *)cupsArrayFind(strings_cache, &key)) == NULL)
+  {
+    if (cupsArrayCount(strings_cache) >= _CUPS_STRINGS_MAX)
+    {
+     /*
+      * Reuse the least recently used entry...
+      */
+
+      for (strings = current = (_cups_strings_t *)cupsArrayFirst(strings_cache); current; current = (_cups_strings_t *)cupsArrayNext(strings_cache))
+        if (current->used < strings->used)
+          strings = current;
+
+      cupsArrayRemove(strings_cache, strings);
+      free(strings->uri);
+      cupsArrayDelete(strings->messages);
+      strings->uri      = NULL;
+      strings->messages = NULL;
+    }
+    else if ((strings = calloc(1, sizeof(_cups_strings_t))) == NULL)
+    {
+      _cupsMutexUnlock(&strings_mutex);
+      return;
+    }
+
+    if ((strings->uri = strdup(uri)) == NULL)
+    {
+      free(strings);
+      _cupsMutexUnlock(&strings_mutex);
+      return;
+    }
+
+    cupsArrayAdd(strings_cache, strings);
+  }
+  else
+    cupsArrayDelete(strings->messages);
+
+  strings->config_time = config_time;
+  strings->used        = time(NULL);
+  strings->messages    = cups_copy_localizations(messages);
+
+  _cupsMutexUnlock(&strings_mutex);
+}
+
+
+/*
+ * 'cups_strings_write()' - Write a strings file to the per-user cache.
+ */
+
+static void
+cups_strings_write(
+    const char *filename,		/* I - Cache filename */
+    const char *uri,			/* I - printer-strings-uri value */
+    int        config_time,		/* I - printer-config-change-time value */
+    time_t     mtime,			/* I - Last-Modified time */
+    const char *srcfile,		/* I - File to copy */
+    int        skip)			/* I - Skip the first line of the file? */
+{
+  cups_file_t	*src,			/* Source file */
+		*dst;			/* Cache file */
+  char		dirname[1024],		/* Cache directory */
+		tempfile[1024],		/* Temporary cache file */
+		buffer[8192];		/* Copy buffer */
+  ssize_t	bytes;			/* Bytes read */
+  _cups_globals_t *cg = _cupsGlobals();	/* Pointer to library globals */
+
+
+ /*
+  * URIs containing line breaks cannot be cached...
+  */
+
+  if (strchr(uri, '\n') || strchr(uri, '\r'))
+    return;
+
+ /*
+  * Create ~/.cups/strings subdirectory as needed...
+  */
+
+  snprintf(dirname, sizeof(dirname), "%s/.cups", cg->home);
+  if (access(dirname, 0))
+    mkdir(dirname, 0700);
+
+  strlcat(dirname, "/strings", sizeof(dirname));
+  if (access(dirname, 0))
+    mkdir(dirname, 0700);
+
+ /*
+  * Write to a temporary file and then rename it so that other processes
+  * never see a partial file...
+  */
+
+  if ((src = cupsFileOpen(srcfile, "r")) == NULL)
+    return;
+
+  if (skip)
+    cupsFileGets(src, buffer, sizeof(buffer));
+
+  snprintf(tempfile, sizeof(tempfile), "%s.%d", filename, (int)getpid());
+
+  if ((dst = cupsFileOpen(tempfile, "w")) == NULL)
+  {
+    cupsFileClose(src);
+    return;
+  }
+
+  cupsFilePrintf(dst, "/* CUPS-Strings %d %ld %s */\n", config_time, (long)mtime, uri);
+
+  while ((bytes = cupsFileRead(src, buffer, sizeof(buffer))) > 0)
+    cupsFileWrite(dst, buffer, (size_t)bytes);
+
+  cupsFileClose(src);
+
+  if (cupsFileClose(dst) || rename(tempfile, filename))
+    unlink(tempfile);
+}
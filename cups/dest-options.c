@@ -20,6 +20,17 @@
  */
 
 #define _CUPS_MEDIA_READY_TTL	30	/* Life of xxx-ready values */
+#define _CUPS_DINFO_CACHE_MAX	16	/* Maximum cached destinations */
+
+
+/*
+ * Local globals...
+ */
+
+static _cups_mutex_t	dinfo_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex to control access to cache */
+static cups_array_t	*dinfo_cache = NULL;
+					/* Destination information cache */
 
 
 /*
@@ -27,10 +38,14 @@
  */
 
 static void		cups_add_dconstres(cups_array_t *a, ipp_t *collection);
+static void		cups_cache_dinfo(cups_dinfo_t *dinfo, int config_time);
 static int		cups_collection_contains(ipp_t *test, ipp_t *match);
 static size_t		cups_collection_string(ipp_attribute_t *attr, char *buffer, size_t bufsize) _CUPS_NONNULL((1,2));
+static int		cups_compare_dconstopt(_cups_dconstopt_t *a,
+			                       _cups_dconstopt_t *b);
 static int		cups_compare_dconstres(_cups_dconstres_t *a,
 			                       _cups_dconstres_t *b);
+static int		cups_compare_dinfo(cups_dinfo_t *a, cups_dinfo_t *b);
 static int		cups_compare_media_db(_cups_media_db_t *a,
 			                      _cups_media_db_t *b);
 static _cups_media_db_t	*cups_copy_media_db(_cups_media_db_t *mdb);
@@ -40,7 +55,11 @@ static void		cups_create_constraints(cups_dinfo_t *dinfo);
 static void		cups_create_defaults(cups_dinfo_t *dinfo);
 static void		cups_create_media_db(cups_dinfo_t *dinfo,
 			                     unsigned flags);
+static void		cups_free_dconstopt(_cups_dconstopt_t *opt);
+static void		cups_free_dinfo(cups_dinfo_t *dinfo);
 static void		cups_free_media_db(_cups_media_db_t *mdb);
+static cups_dinfo_t	*cups_get_cached_dinfo(http_t *http, const char *uri,
+			                       const char *resource);
 static int		cups_get_media_db(http_t *http, cups_dinfo_t *dinfo,
 			                  pwg_media_t *pwg, unsigned flags,
 			                  cups_size_t *size);
@@ -668,6 +687,11 @@ cupsCopyDestConflicts(
  * The caller is responsible for calling @link cupsFreeDestInfo@ on the return
  * value. @code NULL@ is returned on error.
  *
+ * Destination information is cached for printers that report the
+ * "printer-config-change-time" attribute, so later calls for the same
+ * printer only ask for that attribute and reuse the supported values, media
+ * database, and constraints while the printer configuration is unchanged.
+ *
  * @since CUPS 1.6/macOS 10.8@
  */
 
@@ -680,6 +704,7 @@ cupsCopyDestInfo(
   unsigned	dflags;			/* Destination flags */
   ipp_t		*request,		/* Get-Printer-Attributes request */
 		*response;		/* Supported attributes */
+  ipp_attribute_t *attr;		/* printer-config-change-time attribute */
   int		tries,			/* Number of tries so far */
 		delay,			/* Current retry delay */
 		prev_delay;		/* Next retry delay */
@@ -743,6 +768,17 @@ cupsCopyDestInfo(
     return (NULL);
   }
 
+ /*
+  * Use the cached information if the printer configuration has not
+  * changed...
+  */
+
+  if ((dinfo = cups_get_cached_dinfo(http, uri, resource)) != NULL)
+  {
+    DEBUG_printf(("1cupsCopyDestInfo: Using cached information for \"%s\".", uri));
+    return (dinfo);
+  }
+
  /*
   * Get the supported attributes...
   */
@@ -816,6 +852,9 @@ cupsCopyDestInfo(
   dinfo->resource = _cupsStrAlloc(resource);
   dinfo->attrs    = response;
 
+  if ((attr = ippFindAttribute(response, "printer-config-change-time", IPP_TAG_INTEGER)) != NULL)
+    cups_cache_dinfo(dinfo, ippGetInteger(attr, 0));
+
   return (dinfo);
 }
 
@@ -984,26 +1023,25 @@ cupsFreeDestInfo(cups_dinfo_t *dinfo)	/* I - Destination information */
     return;
 
  /*
-  * Free memory and return...
+  * Return cached information to the cache...
   */
 
-  _cupsStrFree(dinfo->resource);
-
-  cupsArrayDelete(dinfo->constraints);
-  cupsArrayDelete(dinfo->resolvers);
-
-  cupsArrayDelete(dinfo->localizations);
+  _cupsMutexLock(&dinfo_mutex);
 
-  cupsArrayDelete(dinfo->media_db);
+  if (dinfo->cached)
+  {
+    dinfo->in_use = 0;
+    dinfo         = NULL;
+  }
 
-  cupsArrayDelete(dinfo->cached_db);
+  _cupsMutexUnlock(&dinfo_mutex);
 
-  ippDelete(dinfo->ready_attrs);
-  cupsArrayDelete(dinfo->ready_db);
-
-  ippDelete(dinfo->attrs);
+ /*
+  * Otherwise free memory and return...
+  */
 
-  free(dinfo);
+  if (dinfo)
+    cups_free_dinfo(dinfo);
 }
 
 
@@ -1385,6 +1423,74 @@ cups_add_dconstres(
 }
 
 
+/*
+ * 'cups_cache_dinfo()' - Add destination information to the cache.
+ *
+ * The information is returned checked out to the caller of
+ * @link cupsCopyDestInfo@.
+ */
+
+static void
+cups_cache_dinfo(
+    cups_dinfo_t *dinfo,		/* I - Destination information */
+    int          config_time)		/* I - printer-config-change-time value */
+{
+  cups_dinfo_t	*current;		/* Current cached information */
+
+
+  _cupsMutexLock(&dinfo_mutex);
+
+  if (!dinfo_cache)
+    dinfo_cache = cupsArrayNew((cups_array_func_t)cups_compare_dinfo, NULL);
+
+ /*
+  * Replace any idle information for the same printer and make room as
+  * needed...
+  */
+
+  if ((current = (cups_dinfo_t *)cupsArrayFind(dinfo_cache, dinfo)) != NULL && current->in_use)
+  {
+   /*
+    * Someone else has the cached copy, don't cache this one...
+    */
+
+    _cupsMutexUnlock(&dinfo_mutex);
+    return;
+  }
+  else if (current)
+  {
+    cupsArrayRemove(dinfo_cache, current);
+    cups_free_dinfo(current);
+  }
+
+  for (current = (cups_dinfo_t *)cupsArrayFirst(dinfo_cache); current && cupsArrayCount(dinfo_cache) >= _CUPS_DINFO_CACHE_MAX; current = (cups_dinfo_t *)cupsArrayNext(dinfo_cache))
+  {
+    if (!current->in_use)
+    {
+      cupsArrayRemove(dinfo_cache, current);
+      cups_free_dinfo(current);
+    }
+  }
+
+  if (cupsArrayCount(dinfo_cache) < _CUPS_DINFO_CACHE_MAX)
+  {
+   /*
+    * The URI belongs to the destination, so keep a copy...
+    */
+
+    dinfo->cache_uri   = _cupsStrAlloc(dinfo->uri);
+    dinfo->uri         = dinfo->cache_uri;
+    dinfo->config_time = config_time;
+    dinfo->cached      = 1;
+    dinfo->in_use      = 1;
+
+    cupsArrayAdd(dinfo_cache, dinfo);
+  }
+
+  _cupsMutexUnlock(&dinfo_mutex);
+}
+
+
 /*
  * 'cups_collection_contains()' - Check whether test collection is contained in the matching collection.
  */
@@ -1725,6 +1831,19 @@ cups_collection_string(
 }
 
 
+/*
+ * 'cups_compare_dconstopt()' - Compare two constraint option entries.
+ */
+
+static int				/* O - Result of comparison */
+cups_compare_dconstopt(
+    _cups_dconstopt_t *a,		/* I - First option */
+    _cups_dconstopt_t *b)		/* I - Second option */
+{
+  return (strcmp(a->name, b->name));
+}
+
+
 /*
  * 'cups_compare_dconstres()' - Compare to resolver entries.
  */
@@ -1738,6 +1857,24 @@ cups_compare_dconstres(
 }
 
 
+/*
+ * 'cups_compare_dinfo()' - Compare two cached destinations.
+ */
+
+static int				/* O - Result of comparison */
+cups_compare_dinfo(cups_dinfo_t *a,	/* I - First destination */
+                   cups_dinfo_t *b)	/* I - Second destination */
+{
+  int	result;				/* Result of comparison */
+
+
+  if ((result = strcmp(a->uri, b->uri)) == 0)
+    result = strcmp(a->resource, b->resource);
+
+  return (result);
+}
+
+
 /*
  * 'cups_compare_media_db()' - Compare two media entries.
  */
@@ -1886,13 +2023,19 @@ cups_create_constraints(
   int			i;		/* Looping var */
   ipp_attribute_t	*attr;		/* Attribute */
   _ipp_value_t		*val;		/* Current value */
+  _cups_dconstres_t	*c;		/* Current constraint */
+  _cups_dconstopt_t	key,		/* Search key */
+			*opt;		/* Option entry */
 
 
-  dinfo->constraints = cupsArrayNew3(NULL, NULL, NULL, 0, NULL,
-                                     (cups_afree_func_t)free);
-  dinfo->resolvers   = cupsArrayNew3((cups_array_func_t)cups_compare_dconstres,
-				     NULL, NULL, 0, NULL,
-                                     (cups_afree_func_t)free);
+  dinfo->constraints     = cupsArrayNew3(NULL, NULL, NULL, 0, NULL,
+                                         (cups_afree_func_t)free);
+  dinfo->constraint_opts = cupsArrayNew3((cups_array_func_t)cups_compare_dconstopt,
+                                         NULL, NULL, 0, NULL,
+                                         (cups_afree_func_t)cups_free_dconstopt);
+  dinfo->resolvers       = cupsArrayNew3((cups_array_func_t)cups_compare_dconstres,
+				         NULL, NULL, 0, NULL,
+                                         (cups_afree_func_t)free);
 
   if ((attr = ippFindAttribute(dinfo->attrs, "job-constraints-supported",
 			       IPP_TAG_BEGIN_COLLECTION)) != NULL)
@@ -1901,6 +2044,39 @@ cups_create_constraints(
       cups_add_dconstres(dinfo->constraints, val->collection);
   }
 
+ /*
+  * Index the constraints by the options they use so that
+  * cups_test_constraints can skip constraints with unset options...
+  */
+
+  for (c = (_cups_dconstres_t *)cupsArrayFirst(dinfo->constraints), i = 0;
+       c;
+       c = (_cups_dconstres_t *)cupsArrayNext(dinfo->constraints), i ++)
+  {
+    c->index = i;
+
+    for (attr = c->collection->attrs; attr; attr = attr->next)
+    {
+      if (!attr->name)
+        continue;
+
+      key.name = attr->name;
+
+      if ((opt = (_cups_dconstopt_t *)cupsArrayFind(dinfo->constraint_opts, &key)) == NULL)
+      {
+        if ((opt = calloc(1, sizeof(_cups_dconstopt_t))) == NULL)
+          break;
+
+        opt->name        = attr->name;
+        opt->constraints = cupsArrayNew(NULL, NULL);
+
+        cupsArrayAdd(dinfo->constraint_opts, opt);
+      }
+
+      cupsArrayAdd(opt->constraints, c);
+    }
+  }
+
   if ((attr = ippFindAttribute(dinfo->attrs, "job-resolvers-supported",
 			       IPP_TAG_BEGIN_COLLECTION)) != NULL)
   {
@@ -2247,6 +2423,48 @@ cups_create_media_db(
 }
 
 
+/*
+ * 'cups_free_dconstopt()' - Free a constraint option entry.
+ */
+
+static void
+cups_free_dconstopt(
+    _cups_dconstopt_t *opt)		/* I - Option entry */
+{
+  cupsArrayDelete(opt->constraints);
+  free(opt);
+}
+
+
+/*
+ * 'cups_free_dinfo()' - Free destination information.
+ */
+
+static void
+cups_free_dinfo(cups_dinfo_t *dinfo)	/* I - Destination information */
+{
+  _cupsStrFree(dinfo->resource);
+  _cupsStrFree(dinfo->cache_uri);
+
+  cupsArrayDelete(dinfo->constraints);
+  cupsArrayDelete(dinfo->constraint_opts);
+  cupsArrayDelete(dinfo->resolvers);
+
+  cupsArrayDelete(dinfo->localizations);
+
+  cupsArrayDelete(dinfo->media_db);
+
+  cupsArrayDelete(dinfo->cached_db);
+
+  ippDelete(dinfo->ready_attrs);
+  cupsArrayDelete(dinfo->ready_db);
+
+  ippDelete(dinfo->attrs);
+
+  free(dinfo);
+}
+
+
 /*
  * 'cups_free_media_cb()' - Free a media entry.
  */
@@ -2272,6 +2490,86 @@ cups_free_media_db(
 }
 
 
+/*
+ * 'cups_get_cached_dinfo()' - Check out cached destination information.
+ *
+ * The cached information is only used when nobody else has it checked out
+ * (cups_dinfo_t is not thread-safe) and the printer reports the same
+ * "printer-config-change-time" value.
+ */
+
+static cups_dinfo_t *			/* O - Destination information or `NULL` */
+cups_get_cached_dinfo(
+    http_t     *http,			/* I - Connection to destination */
+    const char *uri,			/* I - Printer URI */
+    const char *resource)		/* I - Resource path */
+{
+  cups_dinfo_t		key,		/* Search key */
+			*dinfo;		/* Cached information */
+  ipp_t			*request,	/* Get-Printer-Attributes request */
+			*response;	/* printer-config-change-time */
+  ipp_attribute_t	*attr;		/* printer-config-change-time attribute */
+  int			unchanged;	/* Is the configuration unchanged? */
+
+
+ /*
+  * Find and check out the cached information...
+  */
+
+  key.uri      = uri;
+  key.resource = (char *)resource;
+
+  _cupsMutexLock(&dinfo_mutex);
+
+  if ((dinfo = (cups_dinfo_t *)cupsArrayFind(dinfo_cache, &key)) != NULL)
+  {
+    if (dinfo->in_use)
+      dinfo = NULL;
+    else
+      dinfo->in_use = 1;
+  }
+
+  _cupsMutexUnlock(&dinfo_mutex);
+
+  if (!dinfo)
+    return (NULL);
+
+ /*
+  * Ask the printer whether its configuration has changed...
+  */
+
+  request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+
+  ippSetVersion(request, dinfo->version / 10, dinfo->version % 10);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", NULL, "printer-config-change-time");
+
+  response  = cupsDoRequest(http, request, resource);
+  unchanged = cupsLastError() <= IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED && (attr = ippFindAttribute(response, "printer-config-change-time", IPP_TAG_INTEGER)) != NULL && ippGetInteger(attr, 0) == dinfo->config_time;
+
+  ippDelete(response);
+
+  if (unchanged)
+    return (dinfo);
+
+ /*
+  * Configuration changed (or the printer is not responding), so remove the
+  * stale information...
+  */
+
+  DEBUG_printf(("4cups_get_cached_dinfo: Discarding cached information for \"%s\".", uri));
+
+  _cupsMutexLock(&dinfo_mutex);
+  cupsArrayRemove(dinfo_cache, dinfo);
+  _cupsMutexUnlock(&dinfo_mutex);
+
+  cups_free_dinfo(dinfo);
+
+  return (NULL);
+}
+
+
 /*
  * 'cups_get_media_db()' - Lookup the media entry for a given size.
  */
@@ -2595,12 +2893,39 @@ cups_test_constraints(
   int			xres_value,	/* Horizontal resolution */
 			yres_value;	/* Vertical resolution */
   ipp_res_t		units_value;	/* Resolution units */
+  char			*skip;		/* Constraints with unset options */
+  _cups_dconstopt_t	*opt;		/* Current constraint option */
+
 
+ /*
+  * A constraint only applies when all of its options are set, so look up
+  * each indexed option once and skip the constraints that use unset
+  * options...
+  */
+
+  if ((skip = calloc((size_t)cupsArrayCount(dinfo->constraints) + 1, 1)) != NULL)
+  {
+    for (opt = (_cups_dconstopt_t *)cupsArrayFirst(dinfo->constraint_opts);
+         opt;
+	 opt = (_cups_dconstopt_t *)cupsArrayNext(dinfo->constraint_opts))
+    {
+      if ((new_option && new_value && !strcmp(opt->name, new_option)) || cupsGetOption(opt->name, num_options, options) || cupsGetOption(opt->name, dinfo->num_defaults, dinfo->defaults))
+        continue;
+
+      for (c = (_cups_dconstres_t *)cupsArrayFirst(opt->constraints);
+           c;
+	   c = (_cups_dconstres_t *)cupsArrayNext(opt->constraints))
+        skip[c->index] = 1;
+    }
+  }
 
   for (c = (_cups_dconstres_t *)cupsArrayFirst(dinfo->constraints);
        c;
        c = (_cups_dconstres_t *)cupsArrayNext(dinfo->constraints))
   {
+    if (skip && skip[c->index])
+      continue;
+
     num_matching = 0;
     matching     = NULL;
 
@@ -2774,6 +3099,8 @@ cups_test_constraints(
     cupsFreeOptions(num_matching, matching);
   }
 
+  free(skip);
+
   return (active);
 }
 
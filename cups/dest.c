@@ -14,6 +14,7 @@
 
 #include "cups-private.h"
 #include "debug-internal.h"
+#include "md5-internal.h"
 #include <sys/stat.h>
 
 #ifdef HAVE_NOTIFY_H
@@ -59,6 +60,8 @@
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
 #  define _CUPS_DNSSD_GET_DESTS 250     /* Milliseconds for cupsGetDests */
 #  define _CUPS_DNSSD_MAXTIME	50	/* Milliseconds for maximum quantum of time */
+#  define _CUPS_DNSSD_MAXQUERIES	50	/* Maximum number of active TXT queries */
+#  define _CUPS_DNSSD_CACHETIME	60	/* Seconds to reuse TXT query results */
 #else
 #  define _CUPS_DNSSD_GET_DESTS 0       /* Milliseconds for cupsGetDests */
 #endif /* HAVE_DNSSD || HAVE_AVAHI */
@@ -120,6 +123,16 @@ typedef struct _cups_dnssd_resolve_s	/* Data for resolving URI */
   int			*cancel;	/* Pointer to "cancel" variable */
   struct timeval	end_time;	/* Ending time */
 } _cups_dnssd_resolve_t;
+
+typedef struct _cups_dnssd_cached_s	/* Cached TXT query results */
+{
+  char			*fullName;	/* Full name */
+  time_t		expires;	/* Time when results expire */
+  _cups_dnssd_state_t	state;		/* Pending or incompatible */
+  cups_ptype_t		type;		/* Device registration type */
+  int			num_options;	/* Number of destination options */
+  cups_option_t		*options;	/* Destination options */
+} _cups_dnssd_cached_t;
 #endif /* HAVE_DNSSD */
 
 typedef struct _cups_getdata_s
@@ -137,6 +150,18 @@ typedef struct _cups_namedata_s
 } _cups_namedata_t;
 
 
+/*
+ * Local globals...
+ */
+
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+static _cups_mutex_t	dnssd_cache_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex to control access to cache */
+static cups_array_t	*dnssd_cache = NULL;
+					/* TXT query results for this process */
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
+
+
 /*
  * Local functions...
  */
@@ -183,6 +208,10 @@ static void		cups_dnssd_client_cb(AvahiClient *client,
 					     AvahiClientState state,
 					     void *context);
 #  endif /* HAVE_DNSSD */
+static int		cups_dnssd_cache_get(_cups_dnssd_device_t *device);
+static void		cups_dnssd_cache_put(_cups_dnssd_device_t *device);
+static int		cups_dnssd_compare_cached(_cups_dnssd_cached_t *a,
+			                          _cups_dnssd_cached_t *b);
 static int		cups_dnssd_compare_devices(_cups_dnssd_device_t *a,
 			                           _cups_dnssd_device_t *b);
 static void		cups_dnssd_free_device(_cups_dnssd_device_t *device,
@@ -227,6 +256,7 @@ static int              cups_enum_dests(http_t *http, unsigned flags, int msec,
 static int		cups_find_dest(const char *name, const char *instance,
 				       int num_dests, cups_dest_t *dests, int prev,
 				       int *rdiff);
+static int              cups_get_cached_dests(http_t *http, cups_dest_t **dests, cups_ptype_t type, cups_ptype_t mask);
 static int              cups_get_cb(_cups_getdata_t *data, unsigned flags, cups_dest_t *dest);
 static char		*cups_get_default(const char *filename, char *namebuf,
 					  size_t namesize, const char **instance);
@@ -235,6 +265,7 @@ static char		*cups_make_string(ipp_attribute_t *attr, char *buffer,
 			                  size_t bufsize);
 static int              cups_name_cb(_cups_namedata_t *data, unsigned flags, cups_dest_t *dest);
 static void		cups_queue_name(char *name, const char *serviceName, size_t namesize);
+static void		cups_write_cached_dests(const char *filename, const char *key, int num_dests, cups_dest_t *dests);
 
 
 /*
@@ -2678,6 +2709,111 @@ cups_dnssd_client_cb(
 #  endif /* HAVE_DNSSD */
 
 
+/*
+ * 'cups_dnssd_cache_get()' - Copy cached TXT query results to a device.
+ */
+
+static int				/* O - 1 if cached, 0 otherwise */
+cups_dnssd_cache_get(
+    _cups_dnssd_device_t *device)	/* I - Device */
+{
+  int			i;		/* Looping var */
+  _cups_dnssd_cached_t	key,		/* Search key */
+			*cached;	/* Cached results */
+  cups_option_t		*option;	/* Current option */
+
+
+  key.fullName = device->fullName;
+
+  _cupsMutexLock(&dnssd_cache_mutex);
+
+  if ((cached = (_cups_dnssd_cached_t *)cupsArrayFind(dnssd_cache, &key)) == NULL || cached->expires < time(NULL))
+  {
+    _cupsMutexUnlock(&dnssd_cache_mutex);
+    return (0);
+  }
+
+  DEBUG_printf(("6cups_dnssd_cache_get: Using cached TXT record for '%s'.", device->fullName));
+
+  cupsFreeOptions(device->dest.num_options, device->dest.options);
+  device->dest.num_options = 0;
+  device->dest.options     = NULL;
+
+  for (i = cached->num_options, option = cached->options; i > 0; i --, option ++)
+    device->dest.num_options = cupsAddOption(option->name, option->value, device->dest.num_options, &device->dest.options);
+
+  device->type  = cached->type;
+  device->state = cached->state;
+
+  _cupsMutexUnlock(&dnssd_cache_mutex);
+
+  return (1);
+}
+
+
+/*
+ * 'cups_dnssd_cache_put()' - Save the TXT query results for a device.
+ */
+
+static void
+cups_dnssd_cache_put(
+    _cups_dnssd_device_t *device)	/* I - Device */
+{
+  int			i;		/* Looping var */
+  _cups_dnssd_cached_t	key,		/* Search key */
+			*cached;	/* Cached results */
+  cups_option_t		*option;	/* Current option */
+
+
+  key.fullName = device->fullName;
+
+  _cupsMutexLock(&dnssd_cache_mutex);
+
+  if (!dnssd_cache)
+    dnssd_cache = cupsArrayNew((cups_array_func_t)cups_dnssd_compare_cached, NULL);
+
+  if ((cached = (_cups_dnssd_cached_t *)cupsArrayFind(dnssd_cache, &key)) != NULL)
+  {
+    cupsFreeOptions(cached->num_options, cached->options);
+    cached->num_options = 0;
+    cached->options     = NULL;
+  }
+  else if ((cached = calloc(1, sizeof(_cups_dnssd_cached_t))) != NULL)
+  {
+    cached->fullName = _cupsStrAlloc(device->fullName);
+
+    cupsArrayAdd(dnssd_cache, cached);
+  }
+  else
+  {
+    _cupsMutexUnlock(&dnssd_cache_mutex);
+    return;
+  }
+
+  for (i = device->dest.num_options, option = device->dest.options; i > 0; i --, option ++)
+    cached->num_options = cupsAddOption(option->name, option->value, cached->num_options, &cached->options);
+
+  cached->expires = time(NULL) + _CUPS_DNSSD_CACHETIME;
+  cached->type    = device->type;
+  cached->state   = device->state;
+
+  _cupsMutexUnlock(&dnssd_cache_mutex);
+}
+
+
+/*
+ * 'cups_dnssd_compare_cached()' - Compare two cached TXT query results.
+ */
+
+static int				/* O - Result of comparison */
+cups_dnssd_compare_cached(
+    _cups_dnssd_cached_t *a,		/* I - First results */
+    _cups_dnssd_cached_t *b)		/* I - Second results */
+{
+  return (strcmp(a->fullName, b->fullName));
+}
+
+
 /*
  * 'cups_dnssd_compare_device()' - Compare two devices.
  */
@@ -3200,6 +3336,8 @@ cups_dnssd_query_cb(
     DEBUG_printf(("6cups_dnssd_query: device-uri=\"%s\"", uri));
 
     device->dest.num_options = cupsAddOption("device-uri", uri, device->dest.num_options, &device->dest.options);
+
+    cups_dnssd_cache_put(device);
   }
   else
     DEBUG_printf(("6cups_dnssd_query: Ignoring TXT record for '%s'.",
@@ -3385,6 +3523,7 @@ cups_enum_dests(
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
   int           count,                  /* Number of queries started */
                 completed,              /* Number of completed queries */
+                queries,                /* Number of active queries */
                 remaining;              /* Remainder of timeout */
   struct timeval curtime;               /* Current time */
   _cups_dnssd_data_t data;		/* Data for callback */
@@ -3497,7 +3636,7 @@ cups_enum_dests(
     * Get the list of local printers and pass them to the callback function...
     */
 
-    num_dests = _cupsGetDests(http, IPP_OP_CUPS_GET_PRINTERS, NULL, &dests, type, mask);
+    num_dests = cups_get_cached_dests(http, &dests, type, mask);
 
     if (data.def_name[0])
     {
@@ -3735,6 +3874,13 @@ cups_enum_dests(
 
     remaining -= cups_elapsed(&curtime);
 
+    for (device = (_cups_dnssd_device_t *)cupsArrayFirst(data.devices),
+             queries = 0;
+         device;
+         device = (_cups_dnssd_device_t *)cupsArrayNext(data.devices))
+      if (device->ref && device->state == _CUPS_DNSSD_NEW)
+        queries ++;
+
     for (device = (_cups_dnssd_device_t *)cupsArrayFirst(data.devices),
              count = 0, completed = 0;
          device;
@@ -3746,8 +3892,19 @@ cups_enum_dests(
       if (device->state == _CUPS_DNSSD_ACTIVE)
         completed ++;
 
-      if (!device->ref && device->state == _CUPS_DNSSD_NEW)
+      if (!device->ref && device->state == _CUPS_DNSSD_NEW && cups_dnssd_cache_get(device))
+      {
+        DEBUG_printf(("1cups_enum_dests: Using cached TXT record for '%s'.", device->fullName));
+      }
+      else if (!device->ref && device->state == _CUPS_DNSSD_NEW)
       {
+       /*
+        * Query the TXT record, but limit the number of active queries...
+        */
+
+        if (queries >= _CUPS_DNSSD_MAXQUERIES)
+          continue;
+
         DEBUG_printf(("1cups_enum_dests: Querying '%s'.", device->fullName));
 
 #  ifdef HAVE_DNSSD
@@ -3756,6 +3913,7 @@ cups_enum_dests(
         if (DNSServiceQueryRecord(&(device->ref), kDNSServiceFlagsShareConnection, 0, device->fullName, kDNSServiceType_TXT, kDNSServiceClass_IN, (DNSServiceQueryRecordReply)cups_dnssd_query_cb, &data) == kDNSServiceErr_NoError)
         {
           count ++;
+          queries ++;
         }
         else
         {
@@ -3770,6 +3928,7 @@ cups_enum_dests(
         {
           DEBUG_printf(("1cups_enum_dests: Query ref=%p", device->ref));
           count ++;
+          queries ++;
         }
         else
         {
@@ -3779,7 +3938,8 @@ cups_enum_dests(
         }
 #  endif /* HAVE_DNSSD */
       }
-      else if (device->ref && device->state == _CUPS_DNSSD_PENDING)
+
+      if (device->state == _CUPS_DNSSD_PENDING)
       {
         completed ++;
 
@@ -3980,6 +4140,150 @@ cups_find_dest(const char  *name,	/* I - Destination name */
 }
 
 
+/*
+ * 'cups_get_cached_dests()' - Get the local destinations, using the per-user
+ *                             destination cache when it is current.
+ *
+ * The cache is validated by a small CUPS-Get-Printers request for the
+ * attributes that change whenever a destination's configuration or state
+ * changes.  When the signature of that response matches the cache, the much
+ * larger full request is skipped.
+ */
+
+static int				/* O - Number of destinations */
+cups_get_cached_dests(
+    http_t       *http,			/* I - Connection to server */
+    cups_dest_t  **dests,		/* O - Destinations */
+    cups_ptype_t type,			/* I - Printer type bits */
+    cups_ptype_t mask)			/* I - Printer type mask */
+{
+  int			num_dests = 0;	/* Number of destinations */
+  cups_dest_t		*dest = NULL;	/* Current destination */
+  ipp_t			*request,	/* IPP request */
+			*response;	/* IPP response */
+  ipp_attribute_t	*attr;		/* Current attribute */
+  const char		*name;		/* Attribute name */
+  _cups_md5_state_t	md5;		/* MD5 state */
+  unsigned char		digest[16];	/* MD5 digest */
+  char			signature[33],	/* Signature of response */
+			hostname[256],	/* Server hostname */
+			key[1024],	/* Cache key */
+			filename[1024],	/* Cache filename */
+			line[8192],	/* Line from cache */
+			value[2048];	/* Attribute value */
+  cups_file_t		*fp;		/* Cache file */
+  _cups_globals_t	*cg = _cupsGlobals();
+					/* Pointer to library globals */
+  static const char * const pattrs[] =	/* Attributes that validate the cache */
+  {
+    "marker-change-time",
+    "printer-config-change-time",
+    "printer-is-accepting-jobs",
+    "printer-name",
+    "printer-state",
+    "printer-state-change-time",
+    "printer-state-reasons"
+  };
+
+
+  *dests = NULL;
+
+  if (!cg->home)
+    return (_cupsGetDests(http, IPP_OP_CUPS_GET_PRINTERS, NULL, dests, type, mask));
+
+ /*
+  * Get the signature of the current destinations...
+  */
+
+  request = ippNewRequest(IPP_OP_CUPS_GET_PRINTERS);
+
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", sizeof(pattrs) / sizeof(pattrs[0]), NULL, pattrs);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+
+  if (mask)
+  {
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_ENUM, "printer-type", (int)type);
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_ENUM, "printer-type-mask", (int)mask);
+  }
+
+  if ((response = cupsDoRequest(http, request, "/")) == NULL)
+    return (0);
+
+  _cupsMD5Init(&md5);
+
+  for (attr = ippFirstAttribute(response); attr; attr = ippNextAttribute(response))
+  {
+    if (ippGetGroupTag(attr) != IPP_TAG_PRINTER || (name = ippGetName(attr)) == NULL)
+      continue;
+
+    ippAttributeString(attr, value, sizeof(value));
+
+    _cupsMD5Append(&md5, (const unsigned char *)name, (int)strlen(name) + 1);
+    _cupsMD5Append(&md5, (const unsigned char *)value, (int)strlen(value) + 1);
+  }
+
+  ippDelete(response);
+
+  _cupsMD5Finish(&md5, digest);
+  cupsHashString(digest, sizeof(digest), signature, sizeof(signature));
+
+  snprintf(key, sizeof(key), "CUPS-Dests %s:%d %s %x %x %s", httpGetHostname(http, hostname, sizeof(hostname)), httpAddrPort(httpGetAddress(http)), cupsUser(), type, mask, signature);
+
+ /*
+  * Load the cache if it matches...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/.cups/dests.cache", cg->home);
+
+  if ((fp = cupsFileOpen(filename, "r")) != NULL)
+  {
+    if (cupsFileGets(fp, line, sizeof(line)) && !strcmp(line, key))
+    {
+      while (cupsFileGets(fp, line, sizeof(line)))
+      {
+        if (!strncmp(line, "Dest ", 5))
+        {
+          if ((dest = cups_add_dest(line + 5, NULL, &num_dests, dests)) == NULL)
+            break;
+        }
+        else if (!strncmp(line, "Option ", 7) && dest)
+          dest->num_options = cupsParseOptions(line + 7, dest->num_options, &dest->options);
+        else if (!strcmp(line, "End"))
+        {
+          cupsFileClose(fp);
+
+          DEBUG_printf(("1cups_get_cached_dests: Using %d cached destinations.", num_dests));
+
+          return (num_dests);
+        }
+      }
+
+     /*
+      * Truncated or bad cache file, discard what we loaded...
+      */
+
+      cupsFreeDests(num_dests, *dests);
+
+      num_dests = 0;
+      *dests    = NULL;
+    }
+
+    cupsFileClose(fp);
+  }
+
+ /*
+  * Get the full list of destinations and update the cache...
+  */
+
+  num_dests = _cupsGetDests(http, IPP_OP_CUPS_GET_PRINTERS, NULL, dests, type, mask);
+
+  if (cupsLastError() <= IPP_STATUS_OK_EVENTS_COMPLETE || cupsLastError() == IPP_STATUS_ERROR_NOT_FOUND)
+    cups_write_cached_dests(filename, key, num_dests, *dests);
+
+  return (num_dests);
+}
+
+
 /*
  * 'cups_get_cb()' - Collect enumerated destinations.
  */
@@ -4368,3 +4672,86 @@ cups_queue_name(
 
   *nameptr = '\0';
 }
+
+
+/*
+ * 'cups_write_cached_dests()' - Write the per-user destination cache.
+ */
+
+static void
+cups_write_cached_dests(
+    const char  *filename,		/* I - Cache filename */
+    const char  *key,			/* I - Cache key */
+    int         num_dests,		/* I - Number of destinations */
+    cups_dest_t *dests)			/* I - Destinations */
+{
+  int		i, j;			/* Looping vars */
+  cups_dest_t	*dest;			/* Current destination */
+  cups_option_t	*option;		/* Current option */
+  const char	*val;			/* Pointer into value */
+  char		dirname[1024],		/* ~/.cups directory */
+		tempfile[1024];		/* Temporary cache file */
+  cups_file_t	*fp;			/* Cache file */
+
+
+ /*
+  * Values containing line breaks cannot be cached...
+  */
+
+  for (i = num_dests, dest = dests; i > 0; i --, dest ++)
+    for (j = dest->num_options, option = dest->options; j > 0; j --, option ++)
+      if (strchr(option->value, '\n') || strchr(option->value, '\r'))
+        return;
+
+ /*
+  * Create ~/.cups subdirectory as needed...
+  */
+
+  strlcpy(dirname, filename, sizeof(dirname));
+  if ((val = strrchr(dirname, '/')) != NULL)
+    dirname[val - dirname] = '\0';
+
+  if (access(dirname, 0))
+    mkdir(dirname, 0700);
+
+ /*
+  * Write to a temporary file and then rename it so that other processes
+  * never see a partial cache...
+  */
+
+  if (snprintf(tempfile, sizeof(tempfile), "%s.%d", filename, (int)getpid()) >= (int)sizeof(tempfile))
+    return;
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+    return;
+
+  cupsFilePrintf(fp, "%s\n", key);
+
+  for (i = num_dests, dest = dests; i > 0; i --, dest ++)
+  {
+    if (dest->instance)
+      continue;
+
+    cupsFilePrintf(fp, "Dest %s\n", dest->name);
+
+    for (j = dest->num_options, option = dest->options; j > 0; j --, option ++)
+    {
+      cupsFilePrintf(fp, "Option %s=\"", option->name);
+
+      for (val = option->value; *val; val ++)
+      {
+	if (strchr("\"\'\\", *val))
+	  cupsFilePutChar(fp, '\\');
+
+	cupsFilePutChar(fp, *val);
+      }
+
+      cupsFilePuts(fp, "\"\n");
+    }
+  }
+
+  cupsFilePuts(fp, "End\n");
+
+  if (cupsFileClose(fp) || rename(tempfile, filename))
+    unlink(tempfile);
+}
@@ -51,6 +51,14 @@
 #  endif /* !O_BINARY */
 
 
+/*
+ * Constants...
+ */
+
+#  define _CUPS_FILE_BUFSIZE	4096	/* Default size of file buffers */
+#  define _CUPS_FILE_MAX_BUFSIZE 1048576	/* Max size of file buffers */
+
+
 #  ifdef __cplusplus
 extern "C" {
 #  endif /* __cplusplus */
@@ -86,6 +94,7 @@ typedef void (*_cups_fc_func_t)(void *context, _cups_fc_result_t result,
 
 extern _cups_fc_result_t	_cupsFileCheck(const char *filename, _cups_fc_filetype_t filetype, int dorootchecks, _cups_fc_func_t cb, void *context) _CUPS_PRIVATE;
 extern void			_cupsFileCheckFilter(void *context, _cups_fc_result_t result, const char *message) _CUPS_PRIVATE;
+extern size_t			_cupsFileGetLines(cups_file_t *fp, char *buf, size_t buflen, int ch) _CUPS_PRIVATE;
 extern int			_cupsFilePeekAhead(cups_file_t *fp, int ch);
 
 #  ifdef __cplusplus
@@ -39,15 +39,16 @@ struct _cups_file_s			/**** CUPS file structure... ****/
 		compressed,		/* Compression used? */
 		is_stdio,		/* stdin/out/err? */
 		eof,			/* End of file? */
-		buf[4096],		/* Buffer */
+		*buf,			/* Buffer */
 		*ptr,			/* Pointer into buffer */
 		*end;			/* End of buffer data */
+  size_t	bufsize;		/* Size of buffer */
   off_t		pos,			/* Position in file */
 		bufpos;			/* File position for start of buffer */
 
 #ifdef HAVE_LIBZ
   z_stream	stream;			/* (De)compression stream */
-  Bytef		cbuf[4096];		/* (De)compression buffer */
+  Bytef		*cbuf;			/* (De)compression buffer, bufsize bytes */
   uLong		crc;			/* (De)compression CRC */
 #endif /* HAVE_LIBZ */
 
@@ -402,7 +403,7 @@ cupsFileClose(cups_file_t *fp)		/* I - CUPS file */
 	    status = -1;
 
 	  fp->stream.next_out  = fp->cbuf;
-	  fp->stream.avail_out = sizeof(fp->cbuf);
+	  fp->stream.avail_out = fp->bufsize;
 	}
 
         if (done || status < 0)
@@ -455,6 +456,7 @@ cupsFileClose(cups_file_t *fp)		/* I - CUPS file */
   if (fp->printf_buffer)
     free(fp->printf_buffer);
 
+  free(fp->buf);
   free(fp);
 
  /*
@@ -925,6 +927,86 @@ cupsFileGetLine(cups_file_t *fp,	/* I - File to read from */
 }
 
 
+/*
+ * '_cupsFileGetLines()' - Get whole lines from a file up to a marker line.
+ *
+ * Copies complete lines from the read buffer until the next line that starts
+ * with the character "ch", so callers that only care about marked lines (DSC
+ * comments and the like) can pass everything else through in bulk.  At most
+ * "buflen - 2" bytes are returned so that the lines match what
+ * cupsFileGetLine would return with the same buffer size.  Returns 0 when the
+ * next line starts with "ch" or cannot be returned whole; use cupsFileGetLine
+ * to read it.
+ */
+
+size_t					/* O - Number of bytes copied */
+_cupsFileGetLines(cups_file_t *fp,	/* I - File to read from */
+                  char        *buf,	/* I - Buffer */
+                  size_t      buflen,	/* I - Size of buffer */
+                  int         ch)	/* I - First character of marker lines */
+{
+  char		*start,			/* Start of buffered data */
+		*end,			/* End of data to scan */
+		*ptr,			/* Current position */
+		*eol;			/* End of last complete line */
+  size_t	bytes;			/* Bytes to copy */
+
+
+  if (!fp || (fp->mode != 'r' && fp->mode != 's') || !buf || buflen < 3)
+    return (0);
+
+  if (fp->ptr >= fp->end)
+    if (cups_fill(fp) <= 0)
+      return (0);
+
+  if (*(fp->ptr) == ch)
+    return (0);
+
+  start = fp->ptr;
+  end   = fp->end;
+
+  if ((size_t)(end - start) > (buflen - 2))
+    end = start + buflen - 2;
+
+ /*
+  * Look for the next marker at the start of a line...
+  */
+
+  for (ptr = start + 1; ptr < end; ptr ++)
+  {
+    if ((ptr = memchr(ptr, ch, (size_t)(end - ptr))) == NULL)
+      break;
+
+    if (ptr[-1] == '\n' || ptr[-1] == '\r')
+    {
+      end = ptr;
+      break;
+    }
+  }
+
+ /*
+  * Only return complete lines...
+  */
+
+  for (eol = end; eol > start; eol --)
+    if (eol[-1] == '\n' || eol[-1] == '\r')
+      break;
+
+  if ((bytes = (size_t)(eol - start)) == 0)
+    return (0);
+
+  memcpy(buf, start, bytes);
+  buf[bytes] = '\0';
+
+  fp->ptr += bytes;
+  fp->pos += (off_t)bytes;
+
+  DEBUG_printf(("4_cupsFileGetLines: pos=" CUPS_LLFMT ", bytes=" CUPS_LLFMT, CUPS_LLCAST fp->pos, CUPS_LLCAST bytes));
+
+  return (bytes);
+}
+
+
 /*
  * 'cupsFileGets()' - Get a CR and/or LF-terminated line.
  *
@@ -1217,6 +1299,17 @@ cupsFileOpenFd(int        fd,		/* I - File descriptor */
   if ((fp = calloc(1, sizeof(cups_file_t))) == NULL)
     return (NULL);
 
+  if ((fp->buf = malloc(2 * _CUPS_FILE_BUFSIZE)) == NULL)
+  {
+    free(fp);
+    return (NULL);
+  }
+
+  fp->bufsize = _CUPS_FILE_BUFSIZE;
+#ifdef HAVE_LIBZ
+  fp->cbuf    = (Bytef *)fp->buf + _CUPS_FILE_BUFSIZE;
+#endif /* HAVE_LIBZ */
+
  /*
   * Open the file...
   */
@@ -1231,7 +1324,7 @@ cupsFileOpenFd(int        fd,		/* I - File descriptor */
     case 'w' :
 	fp->mode = 'w';
 	fp->ptr  = fp->buf;
-	fp->end  = fp->buf + sizeof(fp->buf);
+	fp->end  = fp->buf + fp->bufsize;
 
 #ifdef HAVE_LIBZ
 	if (mode[1] >= '1' && mode[1] <= '9')
@@ -1267,7 +1360,7 @@ cupsFileOpenFd(int        fd,		/* I - File descriptor */
 	               Z_DEFAULT_STRATEGY);
 
 	  fp->stream.next_out  = fp->cbuf;
-	  fp->stream.avail_out = sizeof(fp->cbuf);
+	  fp->stream.avail_out = fp->bufsize;
 	  fp->compressed       = 1;
 	  fp->crc              = crc32(0L, Z_NULL, 0);
 	}
@@ -1276,6 +1369,15 @@ cupsFileOpenFd(int        fd,		/* I - File descriptor */
 
     case 'r' :
 	fp->mode = 'r';
+
+#ifdef POSIX_FADV_SEQUENTIAL
+       /*
+        * Files are almost always read from start to finish, so ask for more
+        * aggressive read-ahead (this fails harmlessly for pipes)...
+        */
+
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif /* POSIX_FADV_SEQUENTIAL */
 	break;
 
     case 's' :
@@ -1283,6 +1385,8 @@ cupsFileOpenFd(int        fd,		/* I - File descriptor */
 	break;
 
     default : /* Remove bogus compiler warning... */
+        free(fp->buf);
+        free(fp);
         return (NULL);
   }
 
@@ -1421,7 +1525,7 @@ cupsFilePrintf(cups_file_t *fp,		/* I - CUPS file */
 
   DEBUG_printf(("4cupsFilePrintf: pos=" CUPS_LLFMT, CUPS_LLCAST fp->pos));
 
-  if ((size_t)bytes > sizeof(fp->buf))
+  if ((size_t)bytes > fp->bufsize)
   {
 #ifdef HAVE_LIBZ
     if (fp->compressed)
@@ -1604,7 +1708,7 @@ cupsFilePuts(cups_file_t *fp,		/* I - CUPS file */
 
   DEBUG_printf(("4cupsFilePuts: pos=" CUPS_LLFMT, CUPS_LLCAST fp->pos));
 
-  if ((size_t)bytes > sizeof(fp->buf))
+  if ((size_t)bytes > fp->bufsize)
   {
 #ifdef HAVE_LIBZ
     if (fp->compressed)
@@ -1932,6 +2036,122 @@ cupsFileSeek(cups_file_t *fp,		/* I - CUPS file */
 }
 
 
+/*
+ * 'cupsFileSetBufferSize()' - Set the size of the I/O buffers.
+ *
+ * The default size of 4k works well for configuration files.  Larger buffers
+ * reduce the number of reads and writes needed for long lines and bulk data
+ * such as print files, and give the decompressor more input to work with for
+ * compressed files.  The size is limited to between 4k and 1MB.  Pending
+ * output is flushed and any buffered input is preserved.
+ *
+ * @since CUPS 2.4@
+ */
+
+int					/* O - 0 on success, -1 on error */
+cupsFileSetBufferSize(cups_file_t *fp,	/* I - CUPS file */
+                      size_t      size)	/* I - Size of each buffer in bytes */
+{
+  char		*buf;			/* New buffers */
+  size_t	used = 0;		/* Bytes of buffered input */
+#ifdef HAVE_LIBZ
+  size_t	cused = 0;		/* Bytes of buffered compressed data */
+#endif /* HAVE_LIBZ */
+
+
+  DEBUG_printf(("cupsFileSetBufferSize(fp=%p, size=" CUPS_LLFMT ")", (void *)fp, CUPS_LLCAST size));
+
+  if (!fp)
+    return (-1);
+
+  if (size < _CUPS_FILE_BUFSIZE)
+    size = _CUPS_FILE_BUFSIZE;
+  else if (size > _CUPS_FILE_MAX_BUFSIZE)
+    size = _CUPS_FILE_MAX_BUFSIZE;
+
+  if (size == fp->bufsize)
+    return (0);
+
+ /*
+  * Flush pending output and figure out how much buffered data needs to be
+  * kept...
+  */
+
+  if (fp->mode == 'w')
+  {
+    if (cupsFileFlush(fp))
+      return (-1);
+  }
+  else if (fp->ptr)
+    used = (size_t)(fp->end - fp->ptr);
+
+#ifdef HAVE_LIBZ
+  if (fp->compressed)
+  {
+    if (fp->mode == 'w')
+      cused = (size_t)(fp->stream.next_out - fp->cbuf);
+    else
+      cused = fp->stream.avail_in;
+  }
+
+  if (size < cused)
+    size = cused;
+#endif /* HAVE_LIBZ */
+
+  if (size < used)
+    size = used;
+
+  if ((buf = malloc(2 * size)) == NULL)
+    return (-1);
+
+ /*
+  * Copy the buffered data to the new buffers...
+  */
+
+  if (fp->mode == 'w')
+  {
+    fp->ptr = buf;
+    fp->end = buf + size;
+  }
+  else if (fp->ptr)
+  {
+    memcpy(buf, fp->ptr, used);
+
+    fp->bufpos += fp->ptr - fp->buf;
+    fp->ptr    = buf;
+    fp->end    = buf + used;
+  }
+
+#ifdef HAVE_LIBZ
+  if (fp->compressed)
+  {
+    if (fp->mode == 'w')
+    {
+      memcpy(buf + size, fp->cbuf, cused);
+
+      fp->stream.next_out  = (Bytef *)buf + size + cused;
+      fp->stream.avail_out = (uInt)(size - cused);
+    }
+    else
+    {
+      memcpy(buf + size, fp->stream.next_in, cused);
+
+      fp->stream.next_in = (Bytef *)buf + size;
+    }
+  }
+
+  fp->cbuf = (Bytef *)buf + size;
+#endif /* HAVE_LIBZ */
+
+  free(fp->buf);
+
+  fp->buf     = buf;
+  fp->bufsize = size;
+
+  return (0);
+}
+
+
 /*
  * 'cupsFileStderr()' - Return a CUPS file associated with stderr.
  *
@@ -2127,7 +2347,7 @@ cupsFileWrite(cups_file_t *fp,		/* I - CUPS file */
 
   DEBUG_printf(("4cupsFileWrite: pos=" CUPS_LLFMT, CUPS_LLCAST fp->pos));
 
-  if (bytes > sizeof(fp->buf))
+  if (bytes > fp->bufsize)
   {
 #ifdef HAVE_LIBZ
     if (fp->compressed)
@@ -2179,13 +2399,13 @@ cups_compress(cups_file_t *fp,		/* I - CUPS file */
     DEBUG_printf(("9cups_compress: avail_in=%d, avail_out=%d",
                   fp->stream.avail_in, fp->stream.avail_out));
 
-    if (fp->stream.avail_out < (uInt)(sizeof(fp->cbuf) / 8))
+    if (fp->stream.avail_out < (uInt)(fp->bufsize / 8))
     {
       if (cups_write(fp, (char *)fp->cbuf, (size_t)(fp->stream.next_out - fp->cbuf)) < 0)
         return (-1);
 
       fp->stream.next_out  = fp->cbuf;
-      fp->stream.avail_out = sizeof(fp->cbuf);
+      fp->stream.avail_out = fp->bufsize;
     }
 
     deflate(&(fp->stream), Z_NO_FLUSH);
@@ -2240,7 +2460,7 @@ cups_fill(cups_file_t *fp)		/* I - CUPS file */
       * file...
       */
 
-      if ((bytes = cups_read(fp, (char *)fp->buf, sizeof(fp->buf))) < 0)
+      if ((bytes = cups_read(fp, (char *)fp->buf, fp->bufsize)) < 0)
       {
        /*
 	* Can't read from file!
@@ -2443,7 +2663,7 @@ cups_fill(cups_file_t *fp)		/* I - CUPS file */
 
       if (fp->stream.avail_in == 0)
       {
-	if ((bytes = cups_read(fp, (char *)fp->cbuf, sizeof(fp->cbuf))) <= 0)
+	if ((bytes = cups_read(fp, (char *)fp->cbuf, fp->bufsize)) <= 0)
 	{
 	  DEBUG_printf(("9cups_fill: cups_read error, returning %d.", (int)bytes));
 
@@ -2461,7 +2681,7 @@ cups_fill(cups_file_t *fp)		/* I - CUPS file */
       */
 
       fp->stream.next_out  = (Bytef *)fp->buf;
-      fp->stream.avail_out = sizeof(fp->buf);
+      fp->stream.avail_out = fp->bufsize;
 
       status = inflate(&(fp->stream), Z_NO_FLUSH);
 
@@ -2544,7 +2764,7 @@ cups_fill(cups_file_t *fp)		/* I - CUPS file */
 	return (-1);
       }
 
-      bytes = (ssize_t)sizeof(fp->buf) - (ssize_t)fp->stream.avail_out;
+      bytes = (ssize_t)fp->bufsize - (ssize_t)fp->stream.avail_out;
 
      /*
       * Return the decompressed data...
@@ -2566,7 +2786,7 @@ cups_fill(cups_file_t *fp)		/* I - CUPS file */
   * Read a buffer's full of data...
   */
 
-  if ((bytes = cups_read(fp, fp->buf, sizeof(fp->buf))) <= 0)
+  if ((bytes = cups_read(fp, fp->buf, fp->bufsize)) <= 0)
   {
    /*
     * Can't read from file!
@@ -359,8 +359,9 @@ cups_globals_free(_cups_globals_t *cg)	/* I - Pointer to global data */
   cupsArrayDelete(cg->leg_size_lut);
   cupsArrayDelete(cg->ppd_size_lut);
   cupsArrayDelete(cg->pwg_size_lut);
+  free(cg->dim_size_lut);
 
-  httpClose(cg->http);
+  _httpPoolRelease(cg->http);
 
 #ifdef HAVE_SSL
   _httpFreeCredentials(cg->tls_credentials);
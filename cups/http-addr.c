@@ -932,3 +932,16 @@ httpResolveHostname(http_t *http,	/* I - HTTP connection */
   else
     return (http->hostname);
 }
+
+
+/*
+ * '_httpSetHostname()' - Set the hostname of a connection after a lookup.
+ */
+
+void
+_httpSetHostname(http_t     *http,	/* I - HTTP connection */
+                 const char *hostname)	/* I - Hostname */
+{
+  if (http && hostname)
+    strlcpy(http->hostname, hostname, sizeof(http->hostname));
+}
@@ -25,6 +25,57 @@
 #endif /* _WIN32 */
 
 
+#ifdef HAVE_GETADDRINFO
+/*
+ * Local constants...
+ */
+
+#  define _HTTP_ADDR_CACHE_MAX	32	/* Maximum number of cached lookups */
+#  define _HTTP_ADDR_CACHE_TTL	60	/* Seconds to cache addresses */
+#  define _HTTP_ADDR_CACHE_NEGTTL 10	/* Seconds to cache unknown hosts */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct _http_addrcache_s	/* Cached hostname lookup */
+{
+  char			hostname[256],	/* Hostname */
+			service[32];	/* Service name or port number */
+  int			family,		/* Address family */
+			error;		/* getaddrinfo() error, if any */
+  time_t		expires;	/* Expiration time */
+  http_addrlist_t	*addrlist;	/* Addresses */
+} _http_addrcache_t;
+
+
+/*
+ * Local globals...
+ */
+
+static _http_addrcache_t http_addrcache[_HTTP_ADDR_CACHE_MAX];
+					/* Cached lookups */
+static _cups_mutex_t	http_addrcache_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for cache */
+
+
+/*
+ * Local functions...
+ */
+
+static int		http_addrcache_get(const char *hostname, int family,
+			                   const char *service,
+					   http_addrlist_t **addrlist,
+					   int *error);
+static void		http_addrcache_put(const char *hostname, int family,
+			                   const char *service,
+					   http_addrlist_t *addrlist,
+					   int error);
+static http_addrlist_t	*http_addr_interleave(http_addrlist_t *addrlist);
+#endif /* HAVE_GETADDRINFO */
+
+
 /*
  * 'httpAddrConnect()' - Connect to any of the addresses in the list.
  *
@@ -465,6 +516,11 @@ httpAddrFreeList(
 /*
  * 'httpAddrGetList()' - Get a list of addresses for a hostname.
  *
+ * Hostname lookups are cached for a short time, so repeated connections to
+ * the same host do not each wait for the resolver.  When both IPv6 and IPv4
+ * addresses are returned, the list alternates between the two families so
+ * that @link httpAddrConnect2@ tries both early on (RFC 8305).
+ *
  * @since CUPS 1.2/macOS 10.5@
  */
 
@@ -599,7 +655,15 @@ httpAddrGetList(const char *hostname,	/* I - Hostname, IP address, or NULL for p
       }
     }
 
-    if ((error = getaddrinfo(hostname, service, &hints, &results)) == 0)
+    if (hostname && http_addrcache_get(hostname, family, service, &first, &error))
+    {
+     /*
+      * Use the cached lookup...
+      */
+
+      addr = first;
+    }
+    else if ((error = getaddrinfo(hostname, service, &hints, &results)) == 0)
     {
      /*
       * Copy the results to our own address list structure...
@@ -646,12 +710,27 @@ httpAddrGetList(const char *hostname,	/* I - Hostname, IP address, or NULL for p
       */
 
       freeaddrinfo(results);
+
+     /*
+      * Alternate address families and remember the result...
+      */
+
+      if (family == AF_UNSPEC)
+        first = http_addr_interleave(first);
+
+      if (hostname)
+        http_addrcache_put(hostname, family, service, first, 0);
     }
     else
     {
       if (error == EAI_FAIL)
         cg->need_res_init = 1;
+      else if (hostname && error == EAI_NONAME)
+        http_addrcache_put(hostname, family, service, NULL, error);
+    }
 
+    if (error)
+    {
 #  ifdef _WIN32 /* Really, Microsoft?!? */
       _cupsSetError(IPP_STATUS_ERROR_INTERNAL, gai_strerrorA(error), 0);
 #  else
@@ -952,3 +1031,190 @@ httpAddrGetList(const char *hostname,	/* I - Hostname, IP address, or NULL for p
 
   return (first);
 }
+
+
+#ifdef HAVE_GETADDRINFO
+/*
+ * 'http_addrcache_get()' - Get a cached hostname lookup.
+ */
+
+static int				/* O - 1 if found, 0 otherwise */
+http_addrcache_get(
+    const char      *hostname,		/* I - Hostname */
+    int             family,		/* I - Address family */
+    const char      *service,		/* I - Service name or port number */
+    http_addrlist_t **addrlist,		/* O - Copy of addresses */
+    int             *error)		/* O - getaddrinfo() error, if any */
+{
+  int			i;		/* Looping var */
+  _http_addrcache_t	*cache;		/* Current cache entry */
+  time_t		curtime = time(NULL);
+					/* Current time */
+
+
+  if (!service)
+    service = "";
+
+  _cupsMutexLock(&http_addrcache_mutex);
+
+  for (i = _HTTP_ADDR_CACHE_MAX, cache = http_addrcache; i > 0; i --, cache ++)
+  {
+    if (cache->expires > curtime && cache->family == family && !_cups_strcasecmp(cache->hostname, hostname) && !strcmp(cache->service, service))
+    {
+      *addrlist = httpAddrCopyList(cache->addrlist);
+      *error    = cache->error;
+
+      _cupsMutexUnlock(&http_addrcache_mutex);
+
+      if (!*addrlist && !*error)
+        return (0);			/* Out of memory, do a normal lookup */
+
+      DEBUG_printf(("4http_addrcache_get: Using cached lookup for \"%s\".", hostname));
+
+      return (1);
+    }
+  }
+
+  _cupsMutexUnlock(&http_addrcache_mutex);
+
+  return (0);
+}
+
+
+/*
+ * 'http_addrcache_put()' - Cache a hostname lookup.
+ */
+
+static void
+http_addrcache_put(
+    const char      *hostname,		/* I - Hostname */
+    int             family,		/* I - Address family */
+    const char      *service,		/* I - Service name or port number */
+    http_addrlist_t *addrlist,		/* I - Addresses or NULL */
+    int             error)		/* I - getaddrinfo() error, if any */
+{
+  int			i;		/* Looping var */
+  _http_addrcache_t	*cache,		/* Current cache entry */
+			*oldest;	/* Entry to replace */
+  time_t		curtime = time(NULL);
+					/* Current time */
+
+
+  if (!service)
+    service = "";
+
+  if (strlen(hostname) >= sizeof(cache->hostname) || strlen(service) >= sizeof(cache->service))
+    return;
+
+  _cupsMutexLock(&http_addrcache_mutex);
+
+ /*
+  * Replace an entry for the same lookup or the one that expires first...
+  */
+
+  for (i = _HTTP_ADDR_CACHE_MAX, cache = http_addrcache, oldest = cache; i > 0; i --, cache ++)
+  {
+    if (cache->family == family && !_cups_strcasecmp(cache->hostname, hostname) && !strcmp(cache->service, service))
+    {
+      oldest = cache;
+      break;
+    }
+
+    if (cache->expires < oldest->expires)
+      oldest = cache;
+  }
+
+  httpAddrFreeList(oldest->addrlist);
+
+  strlcpy(oldest->hostname, hostname, sizeof(oldest->hostname));
+  strlcpy(oldest->service, service, sizeof(oldest->service));
+
+  oldest->family   = family;
+  oldest->error    = error;
+  oldest->expires  = curtime + (error ? _HTTP_ADDR_CACHE_NEGTTL : _HTTP_ADDR_CACHE_TTL);
+  oldest->addrlist = httpAddrCopyList(addrlist);
+
+  if (!oldest->addrlist && !error)
+    oldest->expires = 0;		/* Out of memory, don't use this entry */
+
+  _cupsMutexUnlock(&http_addrcache_mutex);
+}
+
+
+/*
+ * 'http_addr_interleave()' - Alternate the address families in a list.
+ *
+ * The family of the first address is kept first since that is the one the
+ * resolver prefers.
+ */
+
+static http_addrlist_t *		/* O - New first address */
+http_addr_interleave(
+    http_addrlist_t *addrlist)		/* I - Address list */
+{
+  int			family;		/* Preferred address family */
+  http_addrlist_t	*preferred = NULL,
+					/* Addresses in the preferred family */
+			**prefnext = &preferred,
+					/* End of preferred list */
+			*other = NULL,	/* Addresses in other families */
+			**othernext = &other,
+					/* End of other list */
+			*first = NULL,	/* New first address */
+			**next = &first;/* End of new list */
+
+
+  if (!addrlist || !addrlist->next)
+    return (addrlist);
+
+ /*
+  * Split the list by family...
+  */
+
+  family = httpAddrFamily(&(addrlist->addr));
+
+  while (addrlist)
+  {
+    if (httpAddrFamily(&(addrlist->addr)) == family)
+    {
+      *prefnext = addrlist;
+      prefnext  = &(addrlist->next);
+    }
+    else
+    {
+      *othernext = addrlist;
+      othernext  = &(addrlist->next);
+    }
+
+    addrlist = addrlist->next;
+  }
+
+  *prefnext  = NULL;
+  *othernext = NULL;
+
+ /*
+  * Then merge them back together, alternating between the two...
+  */
+
+  while (preferred || other)
+  {
+    if (preferred)
+    {
+      *next     = preferred;
+      next      = &(preferred->next);
+      preferred = preferred->next;
+    }
+
+    if (other)
+    {
+      *next = other;
+      next  = &(other->next);
+      other = other->next;
+    }
+  }
+
+  *next = NULL;
+
+  return (first);
+}
+#endif /* HAVE_GETADDRINFO */
@@ -117,6 +117,8 @@ extern "C" {
  */
 
 #  define _HTTP_MAX_SBUFFER	65536	/* Size of (de)compression buffer */
+#  define _HTTP_MAX_BUFSIZE	1048576	/* Max size of data buffers */
+#  define _HTTP_MAX_FIELDBUF	4096	/* Size of field value buffer */
 #  define _HTTP_RESOLVE_DEFAULT	0	/* Just resolve with default options */
 #  define _HTTP_RESOLVE_STDERR	1	/* Log resolve progress to stderr */
 #  define _HTTP_RESOLVE_FQDN	2	/* Resolve to a FQDN */
@@ -227,8 +229,7 @@ struct _http_s				/**** HTTP connection structure ****/
   http_encoding_t	data_encoding;	/* Chunked or not */
   int			_data_remaining;/* Number of bytes left (deprecated) */
   int			used;		/* Number of bytes used in buffer */
-  char			buffer[HTTP_MAX_BUFFER];
-					/* Buffer for incoming data */
+  char			*buffer;	/* Buffer for incoming data */
   int			_auth_type;	/* Authentication in use (deprecated) */
   unsigned char		_md5_state[88];	/* MD5 state (deprecated) */
   char			nonce[HTTP_MAX_VALUE];
@@ -253,8 +254,7 @@ struct _http_s				/**** HTTP connection structure ****/
   off_t			data_remaining;	/* Number of bytes left */
   http_addr_t		*hostaddr;	/* Current host address and port */
   http_addrlist_t	*addrlist;	/* List of valid addresses */
-  char			wbuffer[HTTP_MAX_BUFFER];
-					/* Buffer for outgoing data */
+  char			*wbuffer;	/* Buffer for outgoing data */
   int			wused;		/* Write buffer bytes used */
 
   /**** New in CUPS 1.3 ****/
@@ -302,6 +302,18 @@ struct _http_s				/**** HTTP connection structure ****/
 					/* Allocated field values */
   			*default_fields[HTTP_FIELD_MAX];
 					/* Default field values, if any */
+
+  /**** New in CUPS 2.4 ****/
+  size_t		bufsize;	/* Size of buffer and wbuffer */
+  void			*tls_session;	/* Saved TLS session for resumption */
+  size_t		tls_session_size;
+					/* Size of saved TLS session */
+  int			sendfd,		/* File descriptor to pass with next write */
+			recvfd;		/* File descriptor passed by peer */
+  int			tls_handshake;	/* Non-zero during a non-blocking TLS handshake */
+  int			precompressed;	/* Next response data is already content-coded */
+  char			*fieldbuf;	/* Buffer for field values */
+  size_t		fieldused;	/* Bytes used in field buffer */
 };
 #  endif /* !_HTTP_NO_PRIVATE */
 
@@ -329,12 +341,22 @@ extern void		_httpDisconnect(http_t *http) _CUPS_PRIVATE;
 extern char		*_httpEncodeURI(char *dst, const char *src,
 			                size_t dstsize) _CUPS_PRIVATE;
 extern void		_httpFreeCredentials(http_tls_credentials_t credentials) _CUPS_PRIVATE;
+extern size_t		_httpMemoryUsage(http_t *http) _CUPS_PRIVATE;
+extern http_t		*_httpPoolConnect(const char *host, int port, http_encryption_t encryption, const char *user) _CUPS_PRIVATE;
+extern void		_httpPoolRelease(http_t *http) _CUPS_PRIVATE;
 extern const char	*_httpResolveURI(const char *uri, char *resolved_uri,
 			                 size_t resolved_size, int options,
 					 int (*cb)(void *context),
 					 void *context) _CUPS_PRIVATE;
+extern ssize_t		_httpRecvFile(http_t *http, int fd, size_t length) _CUPS_PRIVATE;
+extern int		_httpSendFd(http_t *http, int fd) _CUPS_PRIVATE;
+extern ssize_t		_httpSendFile(http_t *http, int fd, size_t length) _CUPS_PRIVATE;
 extern int		_httpSetDigestAuthString(http_t *http, const char *nonce, const char *method, const char *resource) _CUPS_PRIVATE;
+extern void		_httpSetHostname(http_t *http, const char *hostname) _CUPS_PRIVATE;
+extern void		_httpSetPrecompressed(http_t *http) _CUPS_PRIVATE;
+extern void		_httpShrinkBuffers(http_t *http) _CUPS_PRIVATE;
 extern const char	*_httpStatus(cups_lang_t *lang, http_status_t status) _CUPS_PRIVATE;
+extern int		_httpTLSHandshake(http_t *http) _CUPS_PRIVATE;
 extern void		_httpTLSInitialize(void) _CUPS_PRIVATE;
 extern size_t		_httpTLSPending(http_t *http) _CUPS_PRIVATE;
 extern int		_httpTLSRead(http_t *http, char *buf, int len) _CUPS_PRIVATE;
@@ -342,6 +364,7 @@ extern void		_httpTLSSetOptions(int options, int min_version, int max_version) _
 extern int		_httpTLSStart(http_t *http) _CUPS_PRIVATE;
 extern void		_httpTLSStop(http_t *http) _CUPS_PRIVATE;
 extern int		_httpTLSWrite(http_t *http, const char *buf, int len) _CUPS_PRIVATE;
+extern int		_httpTakeFd(http_t *http) _CUPS_PRIVATE;
 extern int		_httpUpdate(http_t *http, http_status_t *status) _CUPS_PRIVATE;
 extern int		_httpWait(http_t *http, int msec, int usessl) _CUPS_PRIVATE;
 
@@ -29,9 +29,40 @@
 #ifdef HAVE_POLL
 #  include <poll.h>
 #endif /* HAVE_POLL */
+#ifdef HAVE_SENDFILE
+#  include <sys/sendfile.h>
+#endif /* HAVE_SENDFILE */
 #  ifdef HAVE_LIBZ
 #    include <zlib.h>
 #  endif /* HAVE_LIBZ */
+#ifndef MSG_DONTWAIT
+#  define MSG_DONTWAIT 0
+#endif /* !MSG_DONTWAIT */
+
+
+/*
+ * Local constants...
+ */
+
+#define _HTTP_POOL_IDLE	30		/* Seconds to keep idle connections */
+#define _HTTP_POOL_MAX	16		/* Maximum number of idle connections */
+#define _HTTP_MAX_FREEBUF 256		/* Maximum number of spare I/O buffers */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct _http_pool_s		/**** Connection pool entry ****/
+{
+  http_t		*http;		/* Connection */
+  char			host[256];	/* Host name */
+  int			port;		/* Port number */
+  http_encryption_t	encryption;	/* Requested encryption */
+  char			user[256];	/* Credentials (user name) */
+  int			in_use;		/* Connection checked out? */
+  time_t		idle_time;	/* Time connection went idle */
+} _http_pool_t;
 
 
 /*
@@ -39,6 +70,8 @@
  */
 
 static void		http_add_field(http_t *http, http_field_t field, const char *value, int append);
+static int		http_alloc_buffer(http_t *http);
+static char		*http_alloc_field(http_t *http, size_t length);
 #ifdef HAVE_LIBZ
 static void		http_content_coding_finish(http_t *http);
 static void		http_content_coding_start(http_t *http,
@@ -52,11 +85,21 @@ static http_t		*http_create(const char *host, int port,
 static void		http_debug_hex(const char *prefix, const char *buffer,
 			               int bytes);
 #endif /* DEBUG */
+static void		http_free_field(http_t *http, http_field_t field);
+static int		http_pool_check(http_t *http);
+static void		http_pool_remove(http_t *http);
 static ssize_t		http_read(http_t *http, char *buffer, size_t length);
 static ssize_t		http_read_buffered(http_t *http, char *buffer, size_t length);
 static ssize_t		http_read_chunk(http_t *http, char *buffer, size_t length);
+#ifdef SCM_RIGHTS
+static ssize_t		http_recv_fd(http_t *http, char *buffer, size_t length);
+#endif /* SCM_RIGHTS */
 static int		http_send(http_t *http, http_state_t request,
 			          const char *uri);
+#ifdef SCM_RIGHTS
+static ssize_t		http_send_fd(http_t *http, const char *buffer,
+			             size_t length);
+#endif /* SCM_RIGHTS */
 static ssize_t		http_write(http_t *http, const char *buffer,
 			           size_t length);
 static ssize_t		http_write_chunk(http_t *http, const char *buffer,
@@ -74,6 +117,16 @@ static int		http_tls_upgrade(http_t *http);
  * Local globals...
  */
 
+static _cups_mutex_t	http_pool_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for connection pool */
+static cups_array_t	*http_pool = NULL;
+					/* Connection pool */
+static _cups_mutex_t	http_freebuf_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for spare I/O buffers */
+static char		*http_freebufs[_HTTP_MAX_FREEBUF];
+					/* Spare default-size I/O buffers */
+static int		http_num_freebufs = 0;
+					/* Number of spare I/O buffers */
 static const char * const http_fields[] =
 			{
 			  "Accept-Language",
@@ -106,7 +159,47 @@ static const char * const http_fields[] =
 			  "Accept-Encoding",
 			  "Allow",
 			  "Server",
-			  "Authentication-Info"
+			  "Authentication-Info",
+			  "ETag",
+			  "If-None-Match",
+			  "Vary"
+			};
+static const http_field_t http_fields_sorted[] =
+			{		/* Fields sorted by name for lookups */
+			  HTTP_FIELD_ACCEPT_ENCODING,
+			  HTTP_FIELD_ACCEPT_LANGUAGE,
+			  HTTP_FIELD_ACCEPT_RANGES,
+			  HTTP_FIELD_ALLOW,
+			  HTTP_FIELD_AUTHENTICATION_INFO,
+			  HTTP_FIELD_AUTHORIZATION,
+			  HTTP_FIELD_CONNECTION,
+			  HTTP_FIELD_CONTENT_ENCODING,
+			  HTTP_FIELD_CONTENT_LANGUAGE,
+			  HTTP_FIELD_CONTENT_LENGTH,
+			  HTTP_FIELD_CONTENT_LOCATION,
+			  HTTP_FIELD_CONTENT_MD5,
+			  HTTP_FIELD_CONTENT_RANGE,
+			  HTTP_FIELD_CONTENT_TYPE,
+			  HTTP_FIELD_CONTENT_VERSION,
+			  HTTP_FIELD_DATE,
+			  HTTP_FIELD_ETAG,
+			  HTTP_FIELD_HOST,
+			  HTTP_FIELD_IF_MODIFIED_SINCE,
+			  HTTP_FIELD_IF_NONE_MATCH,
+			  HTTP_FIELD_IF_UNMODIFIED_SINCE,
+			  HTTP_FIELD_KEEP_ALIVE,
+			  HTTP_FIELD_LAST_MODIFIED,
+			  HTTP_FIELD_LINK,
+			  HTTP_FIELD_LOCATION,
+			  HTTP_FIELD_RANGE,
+			  HTTP_FIELD_REFERER,
+			  HTTP_FIELD_RETRY_AFTER,
+			  HTTP_FIELD_SERVER,
+			  HTTP_FIELD_TRANSFER_ENCODING,
+			  HTTP_FIELD_UPGRADE,
+			  HTTP_FIELD_USER_AGENT,
+			  HTTP_FIELD_VARY,
+			  HTTP_FIELD_WWW_AUTHENTICATE
 			};
 
 
@@ -155,9 +248,13 @@ httpAcceptConnection(int fd,		/* I - Listen socket file descriptor */
   if ((http->fd = accept(fd, (struct sockaddr *)&(http->addrlist->addr),
 			 &addrlen)) < 0)
   {
+    int	error = errno;			/* Error from accept() */
+
     _cupsSetHTTPError(HTTP_STATUS_ERROR);
     httpClose(http);
 
+    errno = error;			/* Preserve errno for the caller */
+
     return (NULL);
   }
 
@@ -298,12 +395,9 @@ httpClearFields(http_t *http)		/* I - HTTP connection */
     memset(http->_fields, 0, sizeof(http->fields));
 
     for (field = HTTP_FIELD_ACCEPT_LANGUAGE; field < HTTP_FIELD_MAX; field ++)
-    {
-      if (http->fields[field] && http->fields[field] != http->_fields[field])
-        free(http->fields[field]);
+      http_free_field(http, field);
 
-      http->fields[field] = NULL;
-    }
+    http->fieldused = 0;
 
     if (http->mode == _HTTP_MODE_CLIENT)
     {
@@ -339,6 +433,13 @@ httpClose(http_t *http)			/* I - HTTP connection */
   if (!http)
     return;
 
+ /*
+  * Forget about it if it came from the connection pool...
+  */
+
+  if (http_pool)
+    http_pool_remove(http);
+
  /*
   * Close any open connection...
   */
@@ -369,9 +470,16 @@ httpClose(http_t *http)			/* I - HTTP connection */
 
   httpClearFields(http);
 
+  if (http->fieldbuf)
+    free(http->fieldbuf);
+
   if (http->authstring && http->authstring != http->_authstring)
     free(http->authstring);
 
+  if (http->tls_session)
+    free(http->tls_session);
+
+  free(http->buffer);
   free(http);
 }
 
@@ -514,6 +622,12 @@ _httpDisconnect(http_t *http)		/* I - HTTP connection */
   httpAddrClose(NULL, http->fd);
 
   http->fd = -1;
+
+  if (http->recvfd >= 0)
+  {
+    close(http->recvfd);
+    http->recvfd = -1;
+  }
 }
 
 
@@ -585,12 +699,30 @@ httpError(http_t *http)			/* I - HTTP connection */
 http_field_t				/* O - Field index */
 httpFieldValue(const char *name)	/* I - String name */
 {
-  int	i;				/* Looping var */
+  int	left,				/* Left side of search */
+	right,				/* Right side of search */
+	current,			/* Current element */
+	diff;				/* Comparison with current element */
 
 
-  for (i = 0; i < HTTP_FIELD_MAX; i ++)
-    if (!_cups_strcasecmp(name, http_fields[i]))
-      return ((http_field_t)i);
+ /*
+  * Do a binary search of the sorted field names...
+  */
+
+  left  = 0;
+  right = (int)(sizeof(http_fields_sorted) / sizeof(http_fields_sorted[0])) - 1;
+
+  while (left <= right)
+  {
+    current = (left + right) / 2;
+
+    if ((diff = _cups_strcasecmp(name, http_fields[http_fields_sorted[current]])) == 0)
+      return (http_fields_sorted[current]);
+    else if (diff < 0)
+      right = current - 1;
+    else
+      left = current + 1;
+  }
 
   return (HTTP_FIELD_UNKNOWN);
 }
@@ -1134,6 +1266,9 @@ httpGets(char   *line,			/* I - Line to read into */
   if (!http || !line || length <= 1)
     return (NULL);
 
+  if (!http_alloc_buffer(http))
+    return (NULL);
+
  /*
   * Read a line from the buffer...
   */
@@ -1175,7 +1310,7 @@ httpGets(char   *line,			/* I - Line to read into */
         return (NULL);
       }
 
-      bytes = http_read(http, http->buffer + http->used, (size_t)(HTTP_MAX_BUFFER - http->used));
+      bytes = http_read(http, http->buffer + http->used, http->bufsize - (size_t)http->used);
 
       DEBUG_printf(("4httpGets: read " CUPS_LLFMT " bytes.", CUPS_LLCAST bytes));
 
@@ -1568,6 +1703,50 @@ httpIsEncrypted(http_t *http)		/* I - HTTP connection */
 }
 
 
+/*
+ * '_httpMemoryUsage()' - Estimate the memory used by an HTTP connection.
+ *
+ * Pass @code NULL@ to get the size of the shared spare I/O buffers instead.
+ * TLS session state is not included.
+ */
+
+size_t					/* O - Bytes used */
+_httpMemoryUsage(http_t *http)		/* I - HTTP connection or @code NULL@ */
+{
+  size_t	bytes;			/* Bytes used */
+  int		field;			/* Current field */
+
+
+  if (!http)
+  {
+    _cupsMutexLock(&http_freebuf_mutex);
+    bytes = (size_t)http_num_freebufs * 2 * HTTP_MAX_BUFFER;
+    _cupsMutexUnlock(&http_freebuf_mutex);
+
+    return (bytes);
+  }
+
+  bytes = sizeof(http_t);
+
+  if (http->buffer)
+    bytes += 2 * http->bufsize;
+
+  if (http->fieldbuf)
+    bytes += _HTTP_MAX_FIELDBUF;
+
+  for (field = 0; field < HTTP_FIELD_MAX; field ++)
+    if (http->fields[field] && (field >= HTTP_FIELD_ACCEPT_ENCODING || http->fields[field] != http->_fields[field]) && (!http->fieldbuf || http->fields[field] < http->fieldbuf || http->fields[field] >= (http->fieldbuf + _HTTP_MAX_FIELDBUF)))
+      bytes += strlen(http->fields[field]) + 1;
+
+#ifdef HAVE_LIBZ
+  if (http->sbuffer)
+    bytes += _HTTP_MAX_SBUFFER;
+#endif /* HAVE_LIBZ */
+
+  return (bytes);
+}
+
+
 /*
  * 'httpOptions()' - Send an OPTIONS request to the server.
  */
@@ -1704,8 +1883,11 @@ httpPeek(http_t *http,			/* I - HTTP connection */
       }
     }
 
-    if ((size_t)http->data_remaining > sizeof(http->buffer))
-      buflen = sizeof(http->buffer);
+    if (!http_alloc_buffer(http))
+      return (-1);
+
+    if ((size_t)http->data_remaining > http->bufsize)
+      buflen = (ssize_t)http->bufsize;
     else
       buflen = (ssize_t)http->data_remaining;
 
@@ -1836,6 +2018,167 @@ httpPeek(http_t *http,			/* I - HTTP connection */
 }
 
 
+/*
+ * '_httpPoolConnect()' - Get a pooled connection to a server.
+ *
+ * Idle connections to the same host, port, and encryption that were opened
+ * for the same user are reused after a liveness check; otherwise a new
+ * connection is opened with @link httpConnect2@.  Return the connection with
+ * @code _httpPoolRelease@ when done.
+ */
+
+http_t *				/* O - HTTP connection or @code NULL@ */
+_httpPoolConnect(
+    const char        *host,		/* I - Host name */
+    int               port,		/* I - Port number */
+    http_encryption_t encryption,	/* I - Type of encryption to use */
+    const char        *user)		/* I - Credentials or @code NULL@ */
+{
+  _http_pool_t	*entry;			/* Current pool entry */
+  http_t	*http = NULL;		/* HTTP connection */
+  int		i,			/* Looping var */
+		num_stale = 0;		/* Number of stale connections */
+  http_t	*stale[_HTTP_POOL_MAX];	/* Stale connections to close */
+  time_t	curtime = time(NULL);	/* Current time */
+
+
+  if (!host)
+    return (NULL);
+
+  if (!user)
+    user = "";
+
+  _cupsMutexLock(&http_pool_mutex);
+
+  for (entry = (_http_pool_t *)cupsArrayFirst(http_pool);
+       entry;
+       entry = (_http_pool_t *)cupsArrayNext(http_pool))
+  {
+    if (entry->in_use)
+      continue;
+
+    if (num_stale < _HTTP_POOL_MAX &&
+        ((curtime - entry->idle_time) > _HTTP_POOL_IDLE ||
+         !http_pool_check(entry->http)))
+    {
+     /*
+      * Stale or dropped by the server, close once we drop the lock...
+      */
+
+      DEBUG_printf(("4_httpPoolConnect: Closing stale connection to %s:%d.", entry->host, entry->port));
+
+      stale[num_stale ++] = entry->http;
+
+      cupsArrayRemove(http_pool, entry);
+      free(entry);
+      continue;
+    }
+
+    if (!http && entry->port == port && entry->encryption == encryption &&
+        !_cups_strcasecmp(entry->host, host) && !strcmp(entry->user, user))
+    {
+      entry->in_use = 1;
+      http          = entry->http;
+    }
+  }
+
+  _cupsMutexUnlock(&http_pool_mutex);
+
+  for (i = 0; i < num_stale; i ++)
+    httpClose(stale[i]);
+
+  if (http)
+  {
+    DEBUG_printf(("3_httpPoolConnect: Reusing %p for %s:%d.", (void *)http, host, port));
+    return (http);
+  }
+
+ /*
+  * Open a new connection and track it...
+  */
+
+  if ((http = httpConnect2(host, port, NULL, AF_UNSPEC, encryption, 1, 30000, NULL)) == NULL)
+    return (NULL);
+
+  if ((entry = calloc(1, sizeof(_http_pool_t))) != NULL)
+  {
+    entry->http       = http;
+    entry->port       = port;
+    entry->encryption = encryption;
+    entry->in_use     = 1;
+
+    strlcpy(entry->host, host, sizeof(entry->host));
+    strlcpy(entry->user, user, sizeof(entry->user));
+
+    _cupsMutexLock(&http_pool_mutex);
+
+    if (!http_pool)
+      http_pool = cupsArrayNew(NULL, NULL);
+
+    if (!cupsArrayAdd(http_pool, entry))
+      free(entry);
+
+    _cupsMutexUnlock(&http_pool_mutex);
+  }
+
+  return (http);
+}
+
+
+/*
+ * '_httpPoolRelease()' - Return a connection to the pool.
+ *
+ * Connections that are idle and still open are kept for reuse, up to a small
+ * limit; anything else (including connections that did not come from
+ * @code _httpPoolConnect@) is closed.
+ */
+
+void
+_httpPoolRelease(http_t *http)		/* I - HTTP connection */
+{
+  _http_pool_t	*entry,			/* Current pool entry */
+		*match = NULL;		/* Entry for this connection */
+  int		num_idle = 0;		/* Number of idle connections */
+
+
+  if (!http)
+    return;
+
+  _cupsMutexLock(&http_pool_mutex);
+
+  for (entry = (_http_pool_t *)cupsArrayFirst(http_pool);
+       entry;
+       entry = (_http_pool_t *)cupsArrayNext(http_pool))
+  {
+    if (entry->http == http)
+      match = entry;
+    else if (!entry->in_use)
+      num_idle ++;
+  }
+
+  if ((entry = match) != NULL)
+  {
+    if (num_idle < _HTTP_POOL_MAX && http->fd >= 0 &&
+        http->state == HTTP_STATE_WAITING &&
+        _cups_strcasecmp(httpGetField(http, HTTP_FIELD_CONNECTION), "close"))
+    {
+      entry->in_use    = 0;
+      entry->idle_time = time(NULL);
+      http             = NULL;
+    }
+    else
+    {
+      cupsArrayRemove(http_pool, entry);
+      free(entry);
+    }
+  }
+
+  _cupsMutexUnlock(&http_pool_mutex);
+
+  httpClose(http);
+}
+
+
 /*
  * 'httpPost()' - Send a POST request to the server.
  */
@@ -2438,102 +2781,496 @@ httpReconnect2(http_t *http,		/* I - HTTP connection */
 
 
 /*
- * 'httpSetAuthString()' - Set the current authorization string.
+ * '_httpRecvFile()' - Receive message data without copying it through a
+ *                     buffer.
  *
- * This function just stores a copy of the current authorization string in
- * the HTTP connection object.  You must still call @link httpSetField@ to set
- * @code HTTP_FIELD_AUTHORIZATION@ prior to issuing a HTTP request using
- * @link httpGet@, @link httpHead@, @link httpOptions@, @link httpPost@, or
- * @link httpPut@.
- *
- * @since CUPS 1.3/macOS 10.5@
+ * Up to "length" bytes are moved from the socket to the current offset of
+ * "fd" using splice().  Data that is already buffered is written first.  This
+ * only works for unencrypted, uncompressed messages with a Content-Length -
+ * otherwise -1 is returned with errno set to ENOTSUP and the caller must use
+ * @link httpRead2@ and write() instead.
  */
 
-void
-httpSetAuthString(http_t     *http,	/* I - HTTP connection */
-                  const char *scheme,	/* I - Auth scheme (NULL to clear it) */
-		  const char *data)	/* I - Auth data (NULL for none) */
+ssize_t					/* O - Bytes received, 0 on EOF, -1 on error */
+_httpRecvFile(http_t *http,		/* I - HTTP connection */
+              int    fd,		/* I - File to write to */
+	      size_t length)		/* I - Maximum number of bytes to receive */
 {
- /*
-  * Range check input...
-  */
+#ifdef HAVE_SPLICE
+  ssize_t	bytes,			/* Bytes moved */
+		written;		/* Bytes written to file */
+  size_t	total = 0;		/* Total bytes received */
+  int		pipefds[2],		/* Pipe between socket and file */
+		error = 0;		/* Error, if any */
 
-  if (!http)
-    return;
 
-  if (http->authstring && http->authstring != http->_authstring)
-    free(http->authstring);
+  DEBUG_printf(("_httpRecvFile(http=%p, fd=%d, length=" CUPS_LLFMT ")", (void *)http, fd, CUPS_LLCAST length));
 
-  http->authstring = http->_authstring;
+  if (!http || fd < 0 || http->tls ||
+      http->data_encoding != HTTP_ENCODING_LENGTH)
+  {
+    errno = ENOTSUP;
+    return (-1);
+  }
 
-  if (scheme)
+#ifdef HAVE_LIBZ
+  if (http->coding != _HTTP_CODING_IDENTITY)
+  {
+    errno = ENOTSUP;
+    return (-1);
+  }
+#endif /* HAVE_LIBZ */
+
+  if ((off_t)length > http->data_remaining)
+    length = (size_t)http->data_remaining;
+
+  if (length == 0)
+    return (0);
+
+  http->activity = time(NULL);
+
+  if (http->used > 0)
   {
    /*
-    * Set the current authorization string...
+    * Write anything that is already buffered...
     */
 
-    size_t len = strlen(scheme) + (data ? strlen(data) + 1 : 0) + 1;
-    char *temp;
+    if ((size_t)http->used < length)
+      length = (size_t)http->used;
 
-    if (len > sizeof(http->_authstring))
+    if ((bytes = write(fd, http->buffer, length)) < 0)
     {
-      if ((temp = malloc(len)) == NULL)
-        len = sizeof(http->_authstring);
-      else
-        http->authstring = temp;
+      http->error = errno;
+      return (-1);
     }
 
-    if (data)
-      snprintf(http->authstring, len, "%s %s", scheme, data);
-    else
-      strlcpy(http->authstring, scheme, len);
+    http->used -= (int)bytes;
+
+    if (http->used > 0)
+      memmove(http->buffer, http->buffer + bytes, (size_t)http->used);
+
+    total = (size_t)bytes;
   }
   else
   {
    /*
-    * Clear the current authorization string...
+    * Move the data from the socket to the file through a pipe...
     */
 
-    http->_authstring[0] = '\0';
-  }
-}
+    if (pipe(pipefds))
+    {
+      errno = ENOTSUP;
+      return (-1);
+    }
 
+    while (total < length)
+    {
+      if ((bytes = splice(http->fd, NULL, pipefds[1], NULL, length - total, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) < 0)
+      {
+        if (errno == EINTR)
+	  continue;
+	else if ((errno == EAGAIN || errno == EWOULDBLOCK) && total == 0)
+	{
+	  struct pollfd	pfd;		/* Polled file descriptor */
 
-/*
- * 'httpSetCredentials()' - Set the credentials associated with an encrypted
- *			    connection.
- *
- * @since CUPS 1.5/macOS 10.7@
- */
+	  pfd.fd     = http->fd;
+	  pfd.events = POLLIN;
 
-int						/* O - Status of call (0 = success) */
-httpSetCredentials(http_t	*http,		/* I - HTTP connection */
-		   cups_array_t *credentials)	/* I - Array of credentials */
-{
-  if (!http || cupsArrayCount(credentials) < 1)
-    return (-1);
+	  if (poll(&pfd, 1, http->wait_value) > 0)
+	    continue;
 
-#ifdef HAVE_SSL
-  _httpFreeCredentials(http->tls_credentials);
+	  error = ETIMEDOUT;
+	}
+	else if (errno == EAGAIN || errno == EWOULDBLOCK)
+	  break;
+	else if ((errno == EINVAL || errno == ENOSYS) && total == 0)
+	{
+	 /*
+	  * The socket or file cannot be used with splice() and nothing has
+	  * been received...
+	  */
 
-  http->tls_credentials = _httpCreateCredentials(credentials);
-#endif /* HAVE_SSL */
+	  error = ENOTSUP;
+	}
+	else
+	  error = errno;
 
-  return (http->tls_credentials ? 0 : -1);
-}
+	break;
+      }
+      else if (bytes == 0)
+        break;
 
+      while (bytes > 0)
+      {
+        if ((written = splice(pipefds[0], NULL, fd, NULL, (size_t)bytes, SPLICE_F_MOVE)) <= 0)
+	{
+	  if (written < 0 && errno == EINTR)
+	    continue;
 
-/*
- * 'httpSetCookie()' - Set the cookie value(s).
- *
- * @since CUPS 1.1.19/macOS 10.3@
- */
+	  error = written < 0 ? errno : EIO;
+	  break;
+	}
 
-void
-httpSetCookie(http_t     *http,		/* I - Connection */
-              const char *cookie)	/* I - Cookie string */
-{
-  if (!http)
+	bytes -= written;
+	total += (size_t)written;
+      }
+
+      if (error)
+        break;
+    }
+
+    close(pipefds[0]);
+    close(pipefds[1]);
+
+    if (error)
+    {
+      DEBUG_printf(("1_httpRecvFile: splice() failed: %s", strerror(error)));
+
+      if (error != ENOTSUP)
+        http->error = error;
+
+      errno = error;
+      return (-1);
+    }
+  }
+
+  DEBUG_printf(("1_httpRecvFile: Received " CUPS_LLFMT " bytes.", CUPS_LLCAST total));
+
+  http->data_remaining -= (off_t)total;
+
+  if (http->data_remaining == 0)
+  {
+   /*
+    * Finished with the transfer...
+    */
+
+    if (http->state == HTTP_STATE_POST_RECV)
+      http->state ++;
+    else if (http->state == HTTP_STATE_GET_SEND ||
+             http->state == HTTP_STATE_POST_SEND)
+      http->state = HTTP_STATE_WAITING;
+    else
+      http->state = HTTP_STATE_STATUS;
+
+    DEBUG_printf(("1_httpRecvFile: Changed state to %s.", httpStateString(http->state)));
+  }
+
+  return ((ssize_t)total);
+
+#else
+  (void)http;
+  (void)fd;
+  (void)length;
+
+  errno = ENOTSUP;
+  return (-1);
+#endif /* HAVE_SPLICE */
+}
+
+
+/*
+ * '_httpSendFd()' - Pass a file descriptor with the next data that is sent.
+ *
+ * The file descriptor is sent using SCM_RIGHTS over a domain socket
+ * connection and is not closed.  -1 is returned with errno set to ENOTSUP for
+ * other kinds of connections.
+ */
+
+int					/* O - 0 on success, -1 on error */
+_httpSendFd(http_t *http,		/* I - HTTP connection */
+            int    fd)			/* I - File descriptor to pass */
+{
+#ifdef SCM_RIGHTS
+  if (http && fd >= 0 && !http->tls && http->hostaddr &&
+      httpAddrFamily(http->hostaddr) == AF_LOCAL)
+  {
+    http->sendfd = fd;
+    return (0);
+  }
+#else
+  (void)http;
+  (void)fd;
+#endif /* SCM_RIGHTS */
+
+  errno = ENOTSUP;
+  return (-1);
+}
+
+
+/*
+ * '_httpSendFile()' - Send file data without copying it through the write
+ *                     buffer.
+ *
+ * Up to "length" bytes are sent from the current offset of "fd" using
+ * sendfile().  This only works for unencrypted, uncompressed messages with a
+ * Content-Length - otherwise -1 is returned with errno set to ENOTSUP and the
+ * caller must use read() and @link httpWrite2@ instead.
+ */
+
+ssize_t					/* O - Bytes written, 0 on EOF, -1 on error */
+_httpSendFile(http_t *http,		/* I - HTTP connection */
+              int    fd,		/* I - File to send */
+	      size_t length)		/* I - Maximum number of bytes to send */
+{
+#ifdef HAVE_SENDFILE
+  ssize_t	bytes;			/* Bytes written */
+
+
+  DEBUG_printf(("_httpSendFile(http=%p, fd=%d, length=" CUPS_LLFMT ")", (void *)http, fd, CUPS_LLCAST length));
+
+  if (!http || fd < 0 || http->tls ||
+      http->data_encoding != HTTP_ENCODING_LENGTH)
+  {
+    errno = ENOTSUP;
+    return (-1);
+  }
+
+#ifdef HAVE_LIBZ
+  if (http->coding != _HTTP_CODING_IDENTITY)
+  {
+    errno = ENOTSUP;
+    return (-1);
+  }
+#endif /* HAVE_LIBZ */
+
+  if ((off_t)length > http->data_remaining)
+    length = (size_t)http->data_remaining;
+
+  if (length == 0)
+    return (0);
+
+ /*
+  * Send anything that is already buffered, then the file data...
+  */
+
+  if (http->wused && httpFlushWrite(http) < 0)
+    return (-1);
+
+  http->activity = time(NULL);
+
+  while ((bytes = sendfile(http->fd, fd, NULL, length)) < 0)
+  {
+    if (errno == EINTR)
+      continue;
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      struct pollfd	pfd;		/* Polled file descriptor */
+
+      pfd.fd     = http->fd;
+      pfd.events = POLLOUT;
+
+      if (poll(&pfd, 1, http->wait_value) < 0 && errno != EINTR)
+        break;
+    }
+    else if (errno == EINVAL || errno == ENOSYS)
+    {
+     /*
+      * The file cannot be used with sendfile() and nothing has been sent...
+      */
+
+      errno = ENOTSUP;
+      return (-1);
+    }
+    else
+      break;
+  }
+
+  if (bytes < 0)
+  {
+    http->error = errno;
+    DEBUG_printf(("1_httpSendFile: sendfile() failed: %s", strerror(errno)));
+    return (-1);
+  }
+
+  DEBUG_printf(("1_httpSendFile: Sent " CUPS_LLFMT " bytes.", CUPS_LLCAST bytes));
+
+  http->data_remaining -= bytes;
+
+  if (http->data_remaining == 0)
+  {
+   /*
+    * Finished with the transfer; unless we are sending POST or PUT data, go
+    * idle...
+    */
+
+    if (http->state == HTTP_STATE_POST_RECV)
+      http->state ++;
+    else if (http->state == HTTP_STATE_POST_SEND ||
+             http->state == HTTP_STATE_GET_SEND)
+      http->state = HTTP_STATE_WAITING;
+    else
+      http->state = HTTP_STATE_STATUS;
+
+    DEBUG_printf(("1_httpSendFile: Changed state to %s.", httpStateString(http->state)));
+  }
+
+  return (bytes);
+
+#else
+  (void)http;
+  (void)fd;
+  (void)length;
+
+  errno = ENOTSUP;
+  return (-1);
+#endif /* HAVE_SENDFILE */
+}
+
+
+/*
+ * 'httpSetAuthString()' - Set the current authorization string.
+ *
+ * This function just stores a copy of the current authorization string in
+ * the HTTP connection object.  You must still call @link httpSetField@ to set
+ * @code HTTP_FIELD_AUTHORIZATION@ prior to issuing a HTTP request using
+ * @link httpGet@, @link httpHead@, @link httpOptions@, @link httpPost@, or
+ * @link httpPut@.
+ *
+ * @since CUPS 1.3/macOS 10.5@
+ */
+
+void
+httpSetAuthString(http_t     *http,	/* I - HTTP connection */
+                  const char *scheme,	/* I - Auth scheme (NULL to clear it) */
+		  const char *data)	/* I - Auth data (NULL for none) */
+{
+ /*
+  * Range check input...
+  */
+
+  if (!http)
+    return;
+
+  if (http->authstring && http->authstring != http->_authstring)
+    free(http->authstring);
+
+  http->authstring = http->_authstring;
+
+  if (scheme)
+  {
+   /*
+    * Set the current authorization string...
+    */
+
+    size_t len = strlen(scheme) + (data ? strlen(data) + 1 : 0) + 1;
+    char *temp;
+
+    if (len > sizeof(http->_authstring))
+    {
+      if ((temp = malloc(len)) == NULL)
+        len = sizeof(http->_authstring);
+      else
+        http->authstring = temp;
+    }
+
+    if (data)
+      snprintf(http->authstring, len, "%s %s", scheme, data);
+    else
+      strlcpy(http->authstring, scheme, len);
+  }
+  else
+  {
+   /*
+    * Clear the current authorization string...
+    */
+
+    http->_authstring[0] = '\0';
+  }
+}
+
+
+/*
+ * 'httpSetBufferSize()' - Set the size of the input and output buffers.
+ *
+ * The default size of @code HTTP_MAX_BUFFER@ bytes works well for most
+ * requests.  Larger buffers reduce the number of reads and writes needed for
+ * bulk transfers such as document uploads.  The size is limited to between
+ * @code HTTP_MAX_BUFFER@ bytes and 1MB.  Any pending output is flushed before
+ * the buffers are resized.
+ *
+ * @since CUPS 2.4@
+ */
+
+int					/* O - 1 on success, 0 on error */
+httpSetBufferSize(http_t *http,		/* I - HTTP connection */
+                  size_t size)		/* I - Size of each buffer in bytes */
+{
+  char	*buffer;			/* New buffers */
+
+
+  DEBUG_printf(("httpSetBufferSize(http=%p, size=" CUPS_LLFMT ")", (void *)http, CUPS_LLCAST size));
+
+  if (!http)
+    return (0);
+
+  if (size < HTTP_MAX_BUFFER)
+    size = HTTP_MAX_BUFFER;
+  else if (size > _HTTP_MAX_BUFSIZE)
+    size = _HTTP_MAX_BUFSIZE;
+
+  if (size < (size_t)http->used)
+    size = (size_t)http->used;
+
+  if (size == http->bufsize)
+    return (1);
+
+  if (http->wused && httpFlushWrite(http) < 0)
+    return (0);
+
+  if ((buffer = malloc(2 * size)) == NULL)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    return (0);
+  }
+
+  if (http->used > 0)
+    memcpy(buffer, http->buffer, (size_t)http->used);
+
+  free(http->buffer);
+
+  http->buffer  = buffer;
+  http->wbuffer = buffer + size;
+  http->bufsize = size;
+
+  return (1);
+}
+
+
+/*
+ * 'httpSetCredentials()' - Set the credentials associated with an encrypted
+ *			    connection.
+ *
+ * @since CUPS 1.5/macOS 10.7@
+ */
+
+int						/* O - Status of call (0 = success) */
+httpSetCredentials(http_t	*http,		/* I - HTTP connection */
+		   cups_array_t *credentials)	/* I - Array of credentials */
+{
+  if (!http || cupsArrayCount(credentials) < 1)
+    return (-1);
+
+#ifdef HAVE_SSL
+  _httpFreeCredentials(http->tls_credentials);
+
+  http->tls_credentials = _httpCreateCredentials(credentials);
+#endif /* HAVE_SSL */
+
+  return (http->tls_credentials ? 0 : -1);
+}
+
+
+/*
+ * 'httpSetCookie()' - Set the cookie value(s).
+ *
+ * @since CUPS 1.1.19/macOS 10.3@
+ */
+
+void
+httpSetCookie(http_t     *http,		/* I - Connection */
+              const char *cookie)	/* I - Cookie string */
+{
+  if (!http)
     return;
 
   if (http->cookie)
@@ -2659,6 +3396,22 @@ httpSetLength(http_t *http,		/* I - HTTP connection */
 }
 
 
+/*
+ * '_httpSetPrecompressed()' - Mark the next response data as already coded.
+ *
+ * Servers call this before httpWriteResponse() when the data they send is
+ * already compressed using the Content-Encoding of the response, for example
+ * a precompressed file, so that it is sent as-is.
+ */
+
+void
+_httpSetPrecompressed(http_t *http)	/* I - HTTP connection */
+{
+  if (http)
+    http->precompressed = 1;
+}
+
+
 /*
  * 'httpSetTimeout()' - Set read/write timeouts and an optional callback.
  *
@@ -2690,6 +3443,51 @@ httpSetTimeout(
 }
 
 
+/*
+ * '_httpShrinkBuffers()' - Release the I/O and field buffers of an idle
+ *                          connection.
+ *
+ * The buffers are only released when no data is buffered, and are allocated
+ * again (from a shared pool when they are the default size) the next time the
+ * connection is used.
+ */
+
+void
+_httpShrinkBuffers(http_t *http)	/* I - HTTP connection */
+{
+  int	field;				/* Current field */
+
+
+  if (!http)
+    return;
+
+  if (http->buffer && !http->used && !http->wused)
+  {
+    _cupsMutexLock(&http_freebuf_mutex);
+
+    if (http->bufsize == HTTP_MAX_BUFFER && http_num_freebufs < _HTTP_MAX_FREEBUF)
+      http_freebufs[http_num_freebufs ++] = http->buffer;
+    else
+      free(http->buffer);
+
+    _cupsMutexUnlock(&http_freebuf_mutex);
+
+    http->buffer  = NULL;
+    http->wbuffer = NULL;
+  }
+
+  if (http->fieldbuf && !http->fieldused)
+  {
+    for (field = 0; field < HTTP_FIELD_MAX; field ++)
+      if ((http->fields[field] >= http->fieldbuf && http->fields[field] < (http->fieldbuf + _HTTP_MAX_FIELDBUF)) || (http->default_fields[field] >= http->fieldbuf && http->default_fields[field] < (http->fieldbuf + _HTTP_MAX_FIELDBUF)))
+        return;
+
+    free(http->fieldbuf);
+    http->fieldbuf = NULL;
+  }
+}
+
+
 /*
  * 'httpShutdown()' - Shutdown one side of an HTTP connection.
  *
@@ -2715,6 +3513,28 @@ httpShutdown(http_t *http)		/* I - HTTP connection */
 }
 
 
+/*
+ * '_httpTakeFd()' - Get the file descriptor passed by the peer, if any.
+ *
+ * The caller owns the returned file descriptor.
+ */
+
+int					/* O - File descriptor or -1 if none */
+_httpTakeFd(http_t *http)		/* I - HTTP connection */
+{
+  int	fd;				/* File descriptor */
+
+
+  if (!http)
+    return (-1);
+
+  fd           = http->recvfd;
+  http->recvfd = -1;
+
+  return (fd);
+}
+
+
 /*
  * 'httpTrace()' - Send an TRACE request to the server.
  *
@@ -3163,6 +3983,9 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
 
   http->activity = time(NULL);
 
+  if (!http_alloc_buffer(http))
+    return (-1);
+
  /*
   * Buffer small writes for better performance...
   */
@@ -3220,7 +4043,7 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
 #endif /* HAVE_LIBZ */
   if (length > 0)
   {
-    if (http->wused && (length + (size_t)http->wused) > sizeof(http->wbuffer))
+    if (http->wused && (length + (size_t)http->wused) > http->bufsize)
     {
       DEBUG_printf(("2httpWrite2: Flushing buffer (wused=%d, length="
                     CUPS_LLFMT ")", http->wused, CUPS_LLCAST length));
@@ -3228,7 +4051,7 @@ httpWrite2(http_t     *http,		/* I - HTTP connection */
       httpFlushWrite(http);
     }
 
-    if ((length + (size_t)http->wused) <= sizeof(http->wbuffer) && length < sizeof(http->wbuffer))
+    if ((length + (size_t)http->wused) <= http->bufsize && length < http->bufsize)
     {
      /*
       * Write to buffer...
@@ -3334,6 +4157,9 @@ httpWriteResponse(http_t        *http,	/* I - HTTP connection */
 {
   http_encoding_t	old_encoding;	/* Old data_encoding value */
   off_t			old_remaining;	/* Old data_remaining value */
+#ifdef HAVE_LIBZ
+  int			precompressed;	/* Data is already content-coded? */
+#endif /* HAVE_LIBZ */
 
 
  /*
@@ -3348,6 +4174,11 @@ httpWriteResponse(http_t        *http,	/* I - HTTP connection */
     return (-1);
   }
 
+#ifdef HAVE_LIBZ
+  precompressed       = http->precompressed;
+#endif /* HAVE_LIBZ */
+  http->precompressed = 0;
+
  /*
   * Set the various standard fields if they aren't already...
   */
@@ -3532,9 +4363,12 @@ httpWriteResponse(http_t        *http,	/* I - HTTP connection */
     * Then start any content encoding...
     */
 
-    DEBUG_puts("1httpWriteResponse: Calling http_content_coding_start.");
-    http_content_coding_start(http,
-			      httpGetField(http, HTTP_FIELD_CONTENT_ENCODING));
+    if (!precompressed)
+    {
+      DEBUG_puts("1httpWriteResponse: Calling http_content_coding_start.");
+      http_content_coding_start(http,
+				httpGetField(http, HTTP_FIELD_CONTENT_ENCODING));
+    }
 #endif /* HAVE_LIBZ */
 
   }
@@ -3599,12 +4433,7 @@ http_add_field(http_t       *http,	/* I - HTTP connection */
     append = 0;
 
   if (!append && http->fields[field])
-  {
-    if (http->fields[field] != http->_fields[field])
-      free(http->fields[field]);
-
-    http->fields[field] = NULL;
-  }
+    http_free_field(http, field);
 
   valuelen = strlen(value);
 
@@ -3652,12 +4481,15 @@ http_add_field(http_t       *http,	/* I - HTTP connection */
 
     char	*combined;		/* New value string */
 
-    if (http->fields[field] == http->_fields[field])
+    if (http->fields[field] == http->_fields[field] || (http->fieldbuf && http->fields[field] >= http->fieldbuf && http->fields[field] < (http->fieldbuf + _HTTP_MAX_FIELDBUF)))
     {
-      if ((combined = malloc(total + 1)) != NULL)
+      if ((combined = http_alloc_field(http, total + 1)) == NULL)
+        combined = malloc(total + 1);
+
+      if (combined)
       {
+	snprintf(combined, total + 1, "%s, %s", http->fields[field], value);
 	http->fields[field] = combined;
-	snprintf(combined, total + 1, "%s, %s", http->_fields[field], value);
       }
     }
     else if ((combined = realloc(http->fields[field], total + 1)) != NULL)
@@ -3670,10 +4502,14 @@ http_add_field(http_t       *http,	/* I - HTTP connection */
   else
   {
    /*
-    * Allocate the field value...
+    * Allocate the field value, using the connection's field buffer when
+    * possible so that per-request headers don't need separate allocations...
     */
 
-    http->fields[field] = strdup(value);
+    if ((http->fields[field] = http_alloc_field(http, valuelen + 1)) != NULL)
+      memcpy(http->fields[field], value, valuelen + 1);
+    else
+      http->fields[field] = strdup(value);
   }
 
 #ifdef HAVE_LIBZ
@@ -3686,6 +4522,71 @@ http_add_field(http_t       *http,	/* I - HTTP connection */
 }
 
 
+/*
+ * 'http_alloc_buffer()' - Make sure the I/O buffers are allocated.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+http_alloc_buffer(http_t *http)		/* I - HTTP connection */
+{
+  char	*buffer = NULL;			/* New buffers */
+
+
+  if (http->buffer)
+    return (1);
+
+  if (http->bufsize == HTTP_MAX_BUFFER)
+  {
+    _cupsMutexLock(&http_freebuf_mutex);
+
+    if (http_num_freebufs > 0)
+      buffer = http_freebufs[-- http_num_freebufs];
+
+    _cupsMutexUnlock(&http_freebuf_mutex);
+  }
+
+  if (!buffer && (buffer = malloc(2 * http->bufsize)) == NULL)
+  {
+    http->error = errno;
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    return (0);
+  }
+
+  http->buffer  = buffer;
+  http->wbuffer = buffer + http->bufsize;
+
+  return (1);
+}
+
+
+/*
+ * 'http_alloc_field()' - Allocate space for a field value from the field
+ *                        buffer.
+ *
+ * The field buffer is reset by @link httpClearFields@ and reused for the
+ * life of the connection.
+ */
+
+static char *				/* O - Field value storage or @code NULL@ if full */
+http_alloc_field(http_t *http,		/* I - HTTP connection */
+                 size_t length)		/* I - Number of bytes needed */
+{
+  char	*ptr;				/* Pointer to storage */
+
+
+  if (!http->fieldbuf && (http->fieldbuf = malloc(_HTTP_MAX_FIELDBUF)) == NULL)
+    return (NULL);
+
+  if (length > (_HTTP_MAX_FIELDBUF - http->fieldused))
+    return (NULL);
+
+  ptr             = http->fieldbuf + http->fieldused;
+  http->fieldused += length;
+
+  return (ptr);
+}
+
+
 #ifdef HAVE_LIBZ
 /*
  * 'http_content_coding_finish()' - Finish doing any content encoding.
@@ -3973,6 +4874,21 @@ http_create(
     return (NULL);
   }
 
+ /*
+  * The input and output buffers share a single allocation...
+  */
+
+  if ((http->buffer = malloc(2 * HTTP_MAX_BUFFER)) == NULL)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    httpAddrFreeList(myaddrlist);
+    free(http);
+    return (NULL);
+  }
+
+  http->wbuffer = http->buffer + HTTP_MAX_BUFFER;
+  http->bufsize = HTTP_MAX_BUFFER;
+
  /*
   * Initialize the HTTP data...
   */
@@ -3982,6 +4898,8 @@ http_create(
   http->addrlist = myaddrlist;
   http->blocking = blocking;
   http->fd       = -1;
+  http->sendfd   = -1;
+  http->recvfd   = -1;
 #ifdef HAVE_GSSAPI
   http->gssctx   = GSS_C_NO_CONTEXT;
   http->gssname  = GSS_C_NO_NAME;
@@ -4064,6 +4982,84 @@ http_debug_hex(const char *prefix,	/* I - Prefix for line */
 #endif /* DEBUG */
 
 
+/*
+ * 'http_free_field()' - Free a field value.
+ */
+
+static void
+http_free_field(http_t       *http,	/* I - HTTP connection */
+                http_field_t field)	/* I - HTTP field */
+{
+  char	*value = http->fields[field];	/* Field value */
+
+
+  if (value && value != http->_fields[field] && (!http->fieldbuf || value < http->fieldbuf || value >= (http->fieldbuf + _HTTP_MAX_FIELDBUF)))
+    free(value);
+
+  http->fields[field] = NULL;
+}
+
+
+/*
+ * 'http_pool_check()' - Check whether an idle connection is still open.
+ */
+
+static int				/* O - 1 if open, 0 if closed */
+http_pool_check(http_t *http)		/* I - HTTP connection */
+{
+  char		ch;			/* Connection check byte */
+  ssize_t	n;			/* Number of bytes */
+
+
+  if (http->fd < 0)
+    return (0);
+
+#ifdef _WIN32
+  if ((n = recv(http->fd, &ch, 1, MSG_PEEK)) == 0 ||
+      (n < 0 && WSAGetLastError() != WSAEWOULDBLOCK))
+#else
+  if ((n = recv(http->fd, &ch, 1, MSG_PEEK | MSG_DONTWAIT)) == 0 ||
+      (n < 0 && errno != EWOULDBLOCK))
+#endif /* _WIN32 */
+    return (0);
+
+ /*
+  * Anything already waiting on an idle connection is unexpected (an error
+  * or close notification), so don't reuse it...
+  */
+
+  return (n < 0);
+}
+
+
+/*
+ * 'http_pool_remove()' - Remove a connection from the pool.
+ */
+
+static void
+http_pool_remove(http_t *http)		/* I - HTTP connection */
+{
+  _http_pool_t	*entry;			/* Current pool entry */
+
+
+  _cupsMutexLock(&http_pool_mutex);
+
+  for (entry = (_http_pool_t *)cupsArrayFirst(http_pool);
+       entry;
+       entry = (_http_pool_t *)cupsArrayNext(http_pool))
+  {
+    if (entry->http == http)
+    {
+      cupsArrayRemove(http_pool, entry);
+      free(entry);
+      break;
+    }
+  }
+
+  _cupsMutexUnlock(&http_pool_mutex);
+}
+
+
 /*
  * 'http_read()' - Read a buffer from a HTTP connection.
  *
@@ -4102,6 +5098,11 @@ http_read(http_t *http,			/* I - HTTP connection */
       bytes = _httpTLSRead(http, buffer, (int)length);
     else
 #endif /* HAVE_SSL */
+#ifdef SCM_RIGHTS
+    if (http->hostaddr && httpAddrFamily(http->hostaddr) == AF_LOCAL)
+      bytes = http_recv_fd(http, buffer, length);
+    else
+#endif /* SCM_RIGHTS */
     bytes = recv(http->fd, buffer, length, 0);
 
     if (bytes < 0)
@@ -4285,6 +5286,70 @@ http_read_chunk(http_t *http,		/* I - HTTP connection */
 }
 
 
+#ifdef SCM_RIGHTS
+/*
+ * 'http_recv_fd()' - Read from a domain socket, keeping any passed file
+ *                    descriptor.
+ */
+
+static ssize_t				/* O - Number of bytes read or -1 on error */
+http_recv_fd(http_t *http,		/* I - HTTP connection */
+             char   *buffer,		/* I - Buffer */
+             size_t length)		/* I - Maximum bytes to read */
+{
+  ssize_t	bytes;			/* Bytes read */
+  struct msghdr	msg;			/* Message header */
+  struct iovec	iov;			/* Data buffer */
+  struct cmsghdr *cmsg;			/* Control message */
+  union
+  {
+    struct cmsghdr	hdr;		/* Alignment */
+    char		buf[CMSG_SPACE(sizeof(int))];
+  }		control;		/* Control message buffer */
+  int		fd;			/* Passed file descriptor */
+
+
+  memset(&msg, 0, sizeof(msg));
+
+  iov.iov_base       = buffer;
+  iov.iov_len        = length;
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+#ifdef MSG_CMSG_CLOEXEC
+  if ((bytes = recvmsg(http->fd, &msg, MSG_CMSG_CLOEXEC)) <= 0)
+#else
+  if ((bytes = recvmsg(http->fd, &msg, 0)) <= 0)
+#endif /* MSG_CMSG_CLOEXEC */
+    return (bytes);
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len < CMSG_LEN(sizeof(int)))
+      continue;
+
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+
+   /*
+    * Only the last file descriptor is kept...
+    */
+
+    if (http->recvfd >= 0)
+      close(http->recvfd);
+
+    http->recvfd = fd;
+
+    DEBUG_printf(("4http_recv_fd: Received file descriptor %d.", fd));
+  }
+
+  return (bytes);
+}
+#endif /* SCM_RIGHTS */
+
+
 /*
  * 'http_send()' - Send a request with all fields and the trailing blank line.
  */
@@ -4470,6 +5535,56 @@ http_send(http_t       *http,		/* I - HTTP connection */
 }
 
 
+#ifdef SCM_RIGHTS
+/*
+ * 'http_send_fd()' - Write to a domain socket, passing a file descriptor.
+ */
+
+static ssize_t				/* O - Number of bytes written or -1 on error */
+http_send_fd(http_t     *http,		/* I - HTTP connection */
+             const char *buffer,	/* I - Buffer for data */
+	     size_t     length)		/* I - Number of bytes to write */
+{
+  ssize_t	bytes;			/* Bytes written */
+  struct msghdr	msg;			/* Message header */
+  struct iovec	iov;			/* Data buffer */
+  struct cmsghdr *cmsg;			/* Control message */
+  union
+  {
+    struct cmsghdr	hdr;		/* Alignment */
+    char		buf[CMSG_SPACE(sizeof(int))];
+  }		control;		/* Control message buffer */
+
+
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+
+  iov.iov_base       = (void *)buffer;
+  iov.iov_len        = length;
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  cmsg             = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type  = SCM_RIGHTS;
+  cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+
+  memcpy(CMSG_DATA(cmsg), &http->sendfd, sizeof(int));
+
+  if ((bytes = sendmsg(http->fd, &msg, 0)) > 0)
+  {
+    DEBUG_printf(("4http_send_fd: Passed file descriptor %d.", http->sendfd));
+
+    http->sendfd = -1;
+  }
+
+  return (bytes);
+}
+#endif /* SCM_RIGHTS */
+
+
 /*
  * 'http_set_length()' - Set the data_encoding and data_remaining values.
  */
@@ -4742,6 +5857,11 @@ http_write(http_t     *http,		/* I - HTTP connection */
       bytes = _httpTLSWrite(http, buffer, (int)length);
     else
 #endif /* HAVE_SSL */
+#ifdef SCM_RIGHTS
+    if (http->sendfd >= 0)
+      bytes = http_send_fd(http, buffer, length);
+    else
+#endif /* SCM_RIGHTS */
     bytes = send(http->fd, buffer, length, 0);
 
     DEBUG_printf(("3http_write: Write of " CUPS_LLFMT " bytes returned "
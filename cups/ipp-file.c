@@ -14,20 +14,71 @@
 
 #include "ipp-private.h"
 #include "string-private.h"
+#include "thread-private.h"
 #include "debug-internal.h"
+#include <sys/stat.h>
+
+
+/*
+ * Constants...
+ */
+
+#define _IPP_FILE_MAX_CACHE	256	/* Maximum number of cached files */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct _ipp_ftoken_s		/**** Token ****/
+{
+  const char	*token;			/* Token string */
+  int		linenum;		/* Line number after token */
+} _ipp_ftoken_t;
+
+struct _ipp_ftokens_s			/**** Tokenized File ****/
+{
+  char		*filename;		/* Filename */
+  time_t	mtime;			/* Modification time */
+  off_t		size;			/* File size */
+  int		users,			/* Number of parsers using tokens */
+		cached,			/* In the cache? */
+		linenum;		/* Number of lines */
+  size_t	num_tokens;		/* Number of tokens */
+  _ipp_ftoken_t	*tokens;		/* Tokens */
+  char		*data;			/* Token strings */
+};
+
+
+/*
+ * Local globals...
+ */
+
+static _cups_mutex_t	ipp_file_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for token cache */
+static cups_array_t	*ipp_file_cache = NULL;
+					/* Token cache */
 
 
 /*
  * Local functions...
  */
 
+static int	compare_tokens(struct _ipp_ftokens_s *a, struct _ipp_ftokens_s *b);
+static void	free_tokens(struct _ipp_ftokens_s *tokens);
+static struct _ipp_ftokens_s *get_tokens(const char *filename);
 static ipp_t	*parse_collection(_ipp_file_t *f, _ipp_vars_t *v, void *user_data);
 static int	parse_value(_ipp_file_t *f, _ipp_vars_t *v, void *user_data, ipp_t *ipp, ipp_attribute_t **attr, int element);
+static void	release_tokens(struct _ipp_ftokens_s *tokens);
 static void	report_error(_ipp_file_t *f, _ipp_vars_t *v, void *user_data, const char *message, ...) _CUPS_FORMAT(4, 5);
+static struct _ipp_ftokens_s *tokenize_file(const char *filename, struct stat *fileinfo);
 
 
 /*
  * '_ippFileParse()' - Parse an IPP data file.
+ *
+ * Files are tokenized once and the tokens are cached until the file changes,
+ * so files that are included or parsed repeatedly are only read once.
  */
 
 ipp_t *					/* O - IPP attributes or @code NULL@ on failure */
@@ -53,7 +104,7 @@ _ippFileParse(
   f.filename = filename;
   f.linenum  = 1;
 
-  if ((f.fp = cupsFileOpen(filename, "r")) == NULL)
+  if ((f.tokens = get_tokens(filename)) == NULL)
   {
     DEBUG_printf(("1_ippFileParse: Unable to open \"%s\": %s", filename, strerror(errno)));
     return (0);
@@ -191,7 +242,7 @@ _ippFileParse(
   * kept...
   */
 
-  cupsFileClose(f.fp);
+  release_tokens(f.tokens);
   ippDelete(ignored);
 
   return (f.attrs);
@@ -207,215 +258,125 @@ _ippFileReadToken(_ipp_file_t *f,	/* I - File to read from */
                   char        *token,	/* I - Token string buffer */
                   size_t      tokensize)/* I - Size of token string buffer */
 {
-  int	ch,				/* Character from file */
-	quote = 0;			/* Quoting character */
-  char	*tokptr = token,		/* Pointer into token buffer */
-	*tokend = token + tokensize - 1;/* End of token buffer */
-
-
- /*
-  * Skip whitespace and comments...
-  */
+  _ipp_ftoken_t	*t;			/* Current token */
 
-  DEBUG_printf(("1_ippFileReadToken: linenum=%d, pos=%ld", f->linenum, (long)cupsFileTell(f->fp)));
 
-  while ((ch = cupsFileGetChar(f->fp)) != EOF)
+  if (!f->tokens || f->tokindex >= f->tokens->num_tokens)
   {
-    if (_cups_isspace(ch))
-    {
-     /*
-      * Whitespace...
-      */
-
-      if (ch == '\n')
-      {
-        f->linenum ++;
-        DEBUG_printf(("1_ippFileReadToken: LF in leading whitespace, linenum=%d, pos=%ld", f->linenum, (long)cupsFileTell(f->fp)));
-      }
-    }
-    else if (ch == '#')
-    {
-     /*
-      * Comment...
-      */
-
-      DEBUG_puts("1_ippFileReadToken: Skipping comment in leading whitespace...");
+    DEBUG_puts("1_ippFileReadToken: EOF");
 
-      while ((ch = cupsFileGetChar(f->fp)) != EOF)
-      {
-        if (ch == '\n')
-          break;
-      }
+    if (f->tokens)
+      f->linenum = f->tokens->linenum;
 
-      if (ch == '\n')
-      {
-        f->linenum ++;
-        DEBUG_printf(("1_ippFileReadToken: LF at end of comment, linenum=%d, pos=%ld", f->linenum, (long)cupsFileTell(f->fp)));
-      }
-      else
-        break;
-    }
-    else
-      break;
+    *token = '\0';
+    return (0);
   }
 
-  if (ch == EOF)
+  t          = f->tokens->tokens + f->tokindex;
+  f->linenum = t->linenum;
+  f->tokindex ++;
+
+  if (strlcpy(token, t->token, tokensize) >= tokensize)
   {
-    DEBUG_puts("1_ippFileReadToken: EOF");
+    DEBUG_printf(("1_ippFileReadToken: Too long: \"%s\".", token));
     return (0);
   }
 
- /*
-  * Read a token...
-  */
+  DEBUG_printf(("1_ippFileReadToken: Returning \"%s\", linenum=%d.", token, f->linenum));
 
-  while (ch != EOF)
-  {
-    if (ch == '\n')
-    {
-      f->linenum ++;
-      DEBUG_printf(("1_ippFileReadToken: LF in token, linenum=%d, pos=%ld", f->linenum, (long)cupsFileTell(f->fp)));
-    }
+  return (1);
+}
 
-    if (ch == quote)
-    {
-     /*
-      * End of quoted text...
-      */
 
-      *tokptr = '\0';
-      DEBUG_printf(("1_ippFileReadToken: Returning \"%s\" at closing quote.", token));
-      return (1);
-    }
-    else if (!quote && _cups_isspace(ch))
-    {
-     /*
-      * End of unquoted text...
-      */
+/*
+ * 'compare_tokens()' - Compare two tokenized files.
+ */
 
-      *tokptr = '\0';
-      DEBUG_printf(("1_ippFileReadToken: Returning \"%s\" before whitespace.", token));
-      return (1);
-    }
-    else if (!quote && (ch == '\'' || ch == '\"'))
-    {
-     /*
-      * Start of quoted text or regular expression...
-      */
+static int				/* O - Result of comparison */
+compare_tokens(
+    struct _ipp_ftokens_s *a,		/* I - First file */
+    struct _ipp_ftokens_s *b)		/* I - Second file */
+{
+  return (strcmp(a->filename, b->filename));
+}
 
-      if (ch == '<')
-        quote = '>';
-      else
-        quote = ch;
 
-      DEBUG_printf(("1_ippFileReadToken: Start of quoted string, quote=%c, pos=%ld", quote, (long)cupsFileTell(f->fp)));
-    }
-    else if (!quote && ch == '#')
-    {
-     /*
-      * Start of comment...
-      */
+/*
+ * 'free_tokens()' - Free a tokenized file.
+ */
 
-      cupsFileSeek(f->fp, cupsFileTell(f->fp) - 1);
-      *tokptr = '\0';
-      DEBUG_printf(("1_ippFileReadToken: Returning \"%s\" before comment.", token));
-      return (1);
-    }
-    else if (!quote && (ch == '{' || ch == '}' || ch == ','))
-    {
-     /*
-      * Delimiter...
-      */
+static void
+free_tokens(struct _ipp_ftokens_s *tokens)/* I - Tokenized file */
+{
+  free(tokens->filename);
+  free(tokens->tokens);
+  free(tokens->data);
+  free(tokens);
+}
 
-      if (tokptr > token)
-      {
-       /*
-        * Return the preceding token first...
-        */
 
-	cupsFileSeek(f->fp, cupsFileTell(f->fp) - 1);
-      }
-      else
-      {
-       /*
-        * Return this delimiter by itself...
-        */
+/*
+ * 'get_tokens()' - Get the tokens for a file, using the cache if possible.
+ */
 
-        *tokptr++ = (char)ch;
-      }
+static struct _ipp_ftokens_s *		/* O - Tokenized file or @code NULL@ on error */
+get_tokens(const char *filename)	/* I - Filename */
+{
+  struct stat		fileinfo;	/* File information */
+  struct _ipp_ftokens_s	key,		/* Search key */
+			*tokens;	/* Tokenized file */
 
-      *tokptr = '\0';
-      DEBUG_printf(("1_ippFileReadToken: Returning \"%s\".", token));
-      return (1);
-    }
-    else
-    {
-      if (ch == '\\')
-      {
-       /*
-        * Quoted character...
-        */
 
-        DEBUG_printf(("1_ippFileReadToken: Quoted character at pos=%ld", (long)cupsFileTell(f->fp)));
+  if (stat(filename, &fileinfo))
+    return (NULL);
 
-        if ((ch = cupsFileGetChar(f->fp)) == EOF)
-        {
-	  *token = '\0';
-	  DEBUG_puts("1_ippFileReadToken: EOF");
-	  return (0);
-	}
-	else if (ch == '\n')
-	{
-	  f->linenum ++;
-	  DEBUG_printf(("1_ippFileReadToken: quoted LF, linenum=%d, pos=%ld", f->linenum, (long)cupsFileTell(f->fp)));
-	}
-	else if (ch == 'a')
-	  ch = '\a';
-	else if (ch == 'b')
-	  ch = '\b';
-	else if (ch == 'f')
-	  ch = '\f';
-	else if (ch == 'n')
-	  ch = '\n';
-	else if (ch == 'r')
-	  ch = '\r';
-	else if (ch == 't')
-	  ch = '\t';
-	else if (ch == 'v')
-	  ch = '\v';
-      }
+  key.filename = (char *)filename;
 
-      if (tokptr < tokend)
-      {
-       /*
-	* Add to current token...
-	*/
+  _cupsMutexLock(&ipp_file_mutex);
 
-	*tokptr++ = (char)ch;
-      }
-      else
-      {
-       /*
-	* Token too long...
-	*/
+  if ((tokens = (struct _ipp_ftokens_s *)cupsArrayFind(ipp_file_cache, &key)) != NULL)
+  {
+    if (tokens->mtime == fileinfo.st_mtime && tokens->size == fileinfo.st_size)
+    {
+      tokens->users ++;
 
-	*tokptr = '\0';
-	DEBUG_printf(("1_ippFileReadToken: Too long: \"%s\".", token));
-	return (0);
-      }
+      _cupsMutexUnlock(&ipp_file_mutex);
+
+      return (tokens);
     }
 
    /*
-    * Get the next character...
+    * File has changed, drop the cached tokens...
     */
 
-    ch = cupsFileGetChar(f->fp);
+    cupsArrayRemove(ipp_file_cache, tokens);
+    tokens->cached = 0;
+
+    if (!tokens->users)
+      free_tokens(tokens);
   }
 
-  *tokptr = '\0';
-  DEBUG_printf(("1_ippFileReadToken: Returning \"%s\" at EOF.", token));
+  _cupsMutexUnlock(&ipp_file_mutex);
+
+  if ((tokens = tokenize_file(filename, &fileinfo)) == NULL)
+    return (NULL);
+
+  tokens->users = 1;
 
-  return (tokptr > token);
+  _cupsMutexLock(&ipp_file_mutex);
+
+  if (!ipp_file_cache)
+    ipp_file_cache = cupsArrayNew((cups_array_func_t)compare_tokens, NULL);
+
+  if (cupsArrayCount(ipp_file_cache) < _IPP_FILE_MAX_CACHE && !cupsArrayFind(ipp_file_cache, tokens))
+  {
+    cupsArrayAdd(ipp_file_cache, tokens);
+    tokens->cached = 1;
+  }
+
+  _cupsMutexUnlock(&ipp_file_mutex);
+
+  return (tokens);
 }
 
 
@@ -819,6 +780,25 @@ parse_value(_ipp_file_t      *f,	/* I  - IPP data file */
 }
 
 
+/*
+ * 'release_tokens()' - Release the tokens for a file.
+ */
+
+static void
+release_tokens(
+    struct _ipp_ftokens_s *tokens)	/* I - Tokenized file */
+{
+  _cupsMutexLock(&ipp_file_mutex);
+
+  tokens->users --;
+
+  if (!tokens->users && !tokens->cached)
+    free_tokens(tokens);
+
+  _cupsMutexUnlock(&ipp_file_mutex);
+}
+
+
 /*
  * 'report_error()' - Report an error.
  */
@@ -844,3 +824,272 @@ report_error(
   else
     fprintf(stderr, "%s\n", buffer);
 }
+
+
+/*
+ * 'tokenize_file()' - Read and tokenize a file.
+ *
+ * The whole file is read in large blocks and split into tokens in memory.
+ */
+
+static struct _ipp_ftokens_s *		/* O - Tokenized file or @code NULL@ on error */
+tokenize_file(const char  *filename,	/* I - Filename */
+              struct stat *fileinfo)	/* I - File information */
+{
+  cups_file_t		*fp;		/* File pointer */
+  struct _ipp_ftokens_s	*tokens;	/* Tokenized file */
+  char			*buffer = NULL,	/* File contents */
+			*temp;		/* New buffer */
+  size_t		bufsize = 0,	/* Size of buffer */
+			buflen = 0,	/* Bytes in buffer */
+			alloc_tokens = 0;
+					/* Allocated tokens */
+  ssize_t		bytes;		/* Bytes read */
+  const char		*ptr,		/* Pointer into file contents */
+			*end;		/* End of file contents */
+  char			*token,		/* Start of current token */
+			*tokptr;	/* Pointer into token strings */
+  int			ch,		/* Current character */
+			quote,		/* Quoting character */
+			done,		/* Found the end of the token? */
+			linenum = 1;	/* Current line number */
+  _ipp_ftoken_t		*t;		/* New token */
+
+
+ /*
+  * Read the file...
+  */
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  {
+    DEBUG_printf(("1tokenize_file: Unable to open \"%s\": %s", filename, strerror(errno)));
+    return (NULL);
+  }
+
+  do
+  {
+    if (buflen >= bufsize)
+    {
+      if ((temp = realloc(buffer, bufsize + 65536)) == NULL)
+      {
+        free(buffer);
+        cupsFileClose(fp);
+        return (NULL);
+      }
+
+      buffer  = temp;
+      bufsize += 65536;
+    }
+
+    if ((bytes = cupsFileRead(fp, buffer + buflen, bufsize - buflen)) > 0)
+      buflen += (size_t)bytes;
+  }
+  while (bytes > 0);
+
+  cupsFileClose(fp);
+
+ /*
+  * Allocate the tokenized file - each token needs at most one character from
+  * the file plus a nul per source character...
+  */
+
+  if ((tokens = calloc(1, sizeof(struct _ipp_ftokens_s))) == NULL)
+  {
+    free(buffer);
+    return (NULL);
+  }
+
+  tokens->filename = strdup(filename);
+  tokens->mtime    = fileinfo->st_mtime;
+  tokens->size     = fileinfo->st_size;
+  tokens->data     = malloc(2 * buflen + 1);
+
+  if (!tokens->filename || !tokens->data)
+  {
+    free(buffer);
+    free_tokens(tokens);
+    return (NULL);
+  }
+
+ /*
+  * Split the file into tokens...
+  */
+
+  ptr    = buffer;
+  end    = buffer + buflen;
+  tokptr = tokens->data;
+
+  for (;;)
+  {
+   /*
+    * Skip whitespace and comments...
+    */
+
+    while (ptr < end)
+    {
+      if (_cups_isspace(*ptr))
+      {
+        if (*ptr == '\n')
+          linenum ++;
+
+        ptr ++;
+      }
+      else if (*ptr == '#')
+      {
+        while (ptr < end && *ptr != '\n')
+          ptr ++;
+      }
+      else
+        break;
+    }
+
+    if (ptr >= end)
+      break;
+
+   /*
+    * Read a token...
+    */
+
+    token = tokptr;
+    quote = 0;
+    done  = 0;
+
+    while (ptr < end)
+    {
+      ch = *ptr++ & 255;
+
+      if (ch == '\n')
+        linenum ++;
+
+      if (ch == quote)
+      {
+       /*
+        * End of quoted text...
+        */
+
+        done = 1;
+        break;
+      }
+      else if (!quote && _cups_isspace(ch))
+      {
+       /*
+        * End of unquoted text...
+        */
+
+        done = 1;
+        break;
+      }
+      else if (!quote && (ch == '\'' || ch == '\"'))
+      {
+       /*
+        * Start of quoted text...
+        */
+
+        quote = ch;
+      }
+      else if (!quote && ch == '#')
+      {
+       /*
+        * Start of comment...
+        */
+
+        ptr --;
+        done = 1;
+        break;
+      }
+      else if (!quote && (ch == '{' || ch == '}' || ch == ','))
+      {
+       /*
+        * Delimiter - return the preceding token first or this delimiter by
+        * itself...
+        */
+
+        if (tokptr > token)
+          ptr --;
+        else
+          *tokptr++ = (char)ch;
+
+        done = 1;
+        break;
+      }
+      else
+      {
+        if (ch == '\\')
+        {
+         /*
+          * Quoted character...
+          */
+
+          if (ptr >= end)
+          {
+            tokptr = token;
+            break;
+          }
+
+          ch = *ptr++ & 255;
+
+	  if (ch == '\n')
+	    linenum ++;
+	  else if (ch == 'a')
+	    ch = '\a';
+	  else if (ch == 'b')
+	    ch = '\b';
+	  else if (ch == 'f')
+	    ch = '\f';
+	  else if (ch == 'n')
+	    ch = '\n';
+	  else if (ch == 'r')
+	    ch = '\r';
+	  else if (ch == 't')
+	    ch = '\t';
+	  else if (ch == 'v')
+	    ch = '\v';
+        }
+
+        *tokptr++ = (char)ch;
+      }
+    }
+
+    if (!done && tokptr == token)
+    {
+     /*
+      * Empty token or dangling backslash at end of file...
+      */
+
+      break;
+    }
+
+    *tokptr++ = '\0';
+
+   /*
+    * Add the token...
+    */
+
+    if (tokens->num_tokens >= alloc_tokens)
+    {
+      if ((t = realloc(tokens->tokens, (alloc_tokens + 1024) * sizeof(_ipp_ftoken_t))) == NULL)
+      {
+        free(buffer);
+        free_tokens(tokens);
+        return (NULL);
+      }
+
+      tokens->tokens = t;
+      alloc_tokens   += 1024;
+    }
+
+    t = tokens->tokens + tokens->num_tokens;
+    tokens->num_tokens ++;
+
+    t->token   = token;
+    t->linenum = linenum;
+  }
+
+  free(buffer);
+
+  tokens->linenum = linenum;
+
+  DEBUG_printf(("1tokenize_file: \"%s\" has %d tokens.", filename, (int)tokens->num_tokens));
+
+  return (tokens);
+}
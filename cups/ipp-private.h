@@ -33,6 +33,8 @@ extern "C" {
 
 #  define IPP_BUF_SIZE	(IPP_MAX_LENGTH + 2)
 					/* Size of buffer */
+#  define IPP_ARENA_SIZE	4096		/* Size of attribute arena chunks */
+#  define IPP_INDEX_MIN	32		/* Attributes scanned before indexing */
 
 
 /*
@@ -115,9 +117,23 @@ struct _ipp_attribute_s			/**** IPP attribute ****/
 		value_tag;		/* What type of value is it? */
   char		*name;			/* Name of attribute */
   int		num_values;		/* Number of values */
+  int		arena;			/* Allocated from message arena? */
   _ipp_value_t	values[1];		/* Values */
 };
 
+typedef struct _ipp_arena_s		/**** Attribute arena chunk ****/
+{
+  struct _ipp_arena_s	*next;		/* Next (older) chunk */
+  size_t		used,		/* Bytes used */
+			size;		/* Bytes available after header */
+} _ipp_arena_t;
+
+typedef struct _ipp_index_s		/**** Attribute name index entry ****/
+{
+  ipp_attribute_t	*attr,		/* First attribute with this name */
+			*prev;		/* Previous attribute in list */
+} _ipp_index_t;
+
 struct _ipp_s				/**** IPP Request/Response/Notification ****/
 {
   ipp_state_t		state;		/* State of request */
@@ -135,6 +151,11 @@ struct _ipp_s				/**** IPP Request/Response/Notification ****/
 /**** New in CUPS 2.0 ****/
   int			atend,		/* At end of list? */
 			curindex;	/* Current attribute index for hierarchical search */
+/**** New in CUPS 2.3.4 ****/
+  int			num_index,	/* Number of names in index */
+			alloc_index;	/* Allocated index entries (power of 2) */
+  _ipp_index_t		*index;		/* Attribute name index or NULL */
+  _ipp_arena_t		*arena;		/* Attribute arena or NULL */
 };
 
 typedef struct _ipp_option_s		/**** Attribute mapping data ****/
@@ -179,7 +200,8 @@ struct _ipp_vars_s			/**** Variables ****/
 struct _ipp_file_s			/**** File Parser */
 {
   const char		*filename;	/* Filename */
-  cups_file_t		*fp;		/* File pointer */
+  struct _ipp_ftokens_s	*tokens;	/* Tokens from file */
+  size_t		tokindex;	/* Index of next token */
   int			linenum;	/* Current line number */
   ipp_t			*attrs;		/* Attributes */
   ipp_tag_t		group_tag;	/* Current group for new attributes */
@@ -195,6 +217,8 @@ struct _ipp_file_s			/**** File Parser */
 extern const char	*_ippCheckOptions(void) _CUPS_PRIVATE;
 #endif /* DEBUG */
 extern _ipp_option_t	*_ippFindOption(const char *name) _CUPS_PRIVATE;
+extern size_t		_ippMemoryUsage(ipp_t *ipp) _CUPS_PRIVATE;
+extern ipp_t		*_ippNewArena(void) _CUPS_PRIVATE;
 
 /* ipp-file.c */
 extern ipp_t		*_ippFileParse(_ipp_vars_t *v, const char *filename, void *user_data) _CUPS_PRIVATE;
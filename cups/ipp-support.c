@@ -16,6 +16,25 @@
 #include "debug-internal.h"
 
 
+/*
+ * Local types...
+ */
+
+typedef struct _ipp_name_s		/**** Name lookup entry ****/
+{
+  const char	*name;			/* Name */
+  int		value,			/* Value */
+		order;			/* Order in the source tables */
+} _ipp_name_t;
+
+typedef struct _ipp_names_s		/**** Sorted name lookup table ****/
+{
+  int		nocase,			/* Compare names without case? */
+		num_names;		/* Number of names */
+  _ipp_name_t	*names;			/* Names sorted for binary search */
+} _ipp_names_t;
+
+
 /*
  * Local globals...
  */
@@ -272,7 +291,8 @@ static const char * const ipp_std_ops[] =
 		* const ipp_cups_ops2[] =
 		{
 		  "CUPS-Get-Document",
-		  "CUPS-Create-Local-Printer"
+		  "CUPS-Create-Local-Printer",
+		  "CUPS-Get-Statistics"
 		},
 		* const ipp_tag_names[] =
 		{			/* Value/group tag names */
@@ -635,12 +655,49 @@ static const char * const ipp_document_states[] =
 		  "stopped"
 		};
 
+static _cups_mutex_t	ipp_names_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for name lookup tables */
+static int		ipp_names_init = 0;
+					/* Name lookup tables initialized? */
+static _ipp_name_t	ipp_op_buffer[sizeof(ipp_std_ops) / sizeof(ipp_std_ops[0]) + sizeof(ipp_cups_ops) / sizeof(ipp_cups_ops[0]) + sizeof(ipp_cups_ops2) / sizeof(ipp_cups_ops2[0]) + 5],
+			ipp_status_buffer[sizeof(ipp_status_oks) / sizeof(ipp_status_oks[0]) + sizeof(ipp_status_400s) / sizeof(ipp_status_400s[0]) + sizeof(ipp_status_480s) / sizeof(ipp_status_480s[0]) + sizeof(ipp_status_500s) / sizeof(ipp_status_500s[0]) + sizeof(ipp_status_1000s) / sizeof(ipp_status_1000s[0]) + 2],
+			ipp_tag_buffer[sizeof(ipp_tag_names) / sizeof(ipp_tag_names[0]) + 11],
+			ipp_document_state_buffer[sizeof(ipp_document_states) / sizeof(ipp_document_states[0])],
+			ipp_finishings_buffer[sizeof(ipp_finishings_vendor) / sizeof(ipp_finishings_vendor[0]) + sizeof(ipp_finishings) / sizeof(ipp_finishings[0])],
+			ipp_job_collation_type_buffer[sizeof(ipp_job_collation_types) / sizeof(ipp_job_collation_types[0])],
+			ipp_job_state_buffer[sizeof(ipp_job_states) / sizeof(ipp_job_states[0])],
+			ipp_orientation_requested_buffer[sizeof(ipp_orientation_requesteds) / sizeof(ipp_orientation_requesteds[0])],
+			ipp_print_quality_buffer[sizeof(ipp_print_qualities) / sizeof(ipp_print_qualities[0])],
+			ipp_printer_state_buffer[sizeof(ipp_printer_states) / sizeof(ipp_printer_states[0])],
+			ipp_resource_state_buffer[sizeof(ipp_resource_states) / sizeof(ipp_resource_states[0])],
+			ipp_system_state_buffer[sizeof(ipp_system_states) / sizeof(ipp_system_states[0])];
+static _ipp_names_t	ipp_op_names = { 1, 0, ipp_op_buffer },
+			ipp_status_names = { 1, 0, ipp_status_buffer },
+			ipp_tag_lookup = { 1, 0, ipp_tag_buffer },
+			ipp_document_state_names = { 0, 0, ipp_document_state_buffer },
+			ipp_finishings_names = { 0, 0, ipp_finishings_buffer },
+			ipp_job_collation_type_names = { 0, 0, ipp_job_collation_type_buffer },
+			ipp_job_state_names = { 0, 0, ipp_job_state_buffer },
+			ipp_orientation_requested_names = { 0, 0, ipp_orientation_requested_buffer },
+			ipp_print_quality_names = { 0, 0, ipp_print_quality_buffer },
+			ipp_printer_state_names = { 0, 0, ipp_printer_state_buffer },
+			ipp_resource_state_names = { 0, 0, ipp_resource_state_buffer },
+			ipp_system_state_names = { 0, 0, ipp_system_state_buffer };
+					/* Sorted name lookup tables */
+
 
 /*
  * Local functions...
  */
 
+static void	ipp_add_name(_ipp_names_t *names, const char *name, int value);
+static void	ipp_add_names(_ipp_names_t *names, const char * const *strings, size_t num_strings, int value);
 static size_t	ipp_col_string(ipp_t *col, char *buffer, size_t bufsize);
+static int	ipp_compare_names(_ipp_name_t *a, _ipp_name_t *b);
+static int	ipp_compare_names_nocase(_ipp_name_t *a, _ipp_name_t *b);
+static int	ipp_find_name(_ipp_names_t *names, const char *name);
+static void	ipp_init_names(void);
+static void	ipp_sort_names(_ipp_names_t *names);
 
 
 /*
@@ -2130,9 +2187,7 @@ int					/* O - Enum value or -1 if unknown */
 ippEnumValue(const char *attrname,	/* I - Attribute name */
              const char *enumstring)	/* I - Enum string */
 {
-  int		i,			/* Looping var */
-		num_strings;		/* Number of strings to compare */
-  const char * const *strings;		/* Strings to compare */
+  _ipp_names_t	*names;			/* Names to search */
 
 
  /*
@@ -2147,80 +2202,43 @@ ippEnumValue(const char *attrname,	/* I - Attribute name */
   */
 
   if (!strcmp(attrname, "document-state"))
-  {
-    num_strings = (int)(sizeof(ipp_document_states) / sizeof(ipp_document_states[0]));
-    strings     = ipp_document_states;
-  }
+    names = &ipp_document_state_names;
   else if (!strcmp(attrname, "finishings") ||
 	   !strcmp(attrname, "finishings-actual") ||
 	   !strcmp(attrname, "finishings-default") ||
 	   !strcmp(attrname, "finishings-ready") ||
 	   !strcmp(attrname, "finishings-supported"))
-  {
-    for (i = 0;
-         i < (int)(sizeof(ipp_finishings_vendor) /
-                   sizeof(ipp_finishings_vendor[0]));
-         i ++)
-      if (!strcmp(enumstring, ipp_finishings_vendor[i]))
-	return (i + 0x40000000);
-
-    num_strings = (int)(sizeof(ipp_finishings) / sizeof(ipp_finishings[0]));
-    strings     = ipp_finishings;
-  }
+    names = &ipp_finishings_names;
   else if (!strcmp(attrname, "job-collation-type") ||
            !strcmp(attrname, "job-collation-type-actual"))
-  {
-    num_strings = (int)(sizeof(ipp_job_collation_types) /
-                        sizeof(ipp_job_collation_types[0]));
-    strings     = ipp_job_collation_types;
-  }
+    names = &ipp_job_collation_type_names;
   else if (!strcmp(attrname, "job-state"))
-  {
-    num_strings = (int)(sizeof(ipp_job_states) / sizeof(ipp_job_states[0]));
-    strings     = ipp_job_states;
-  }
+    names = &ipp_job_state_names;
   else if (!strcmp(attrname, "operations-supported"))
     return (ippOpValue(enumstring));
   else if (!strcmp(attrname, "orientation-requested") ||
            !strcmp(attrname, "orientation-requested-actual") ||
            !strcmp(attrname, "orientation-requested-default") ||
            !strcmp(attrname, "orientation-requested-supported"))
-  {
-    num_strings = (int)(sizeof(ipp_orientation_requesteds) /
-                        sizeof(ipp_orientation_requesteds[0]));
-    strings     = ipp_orientation_requesteds;
-  }
+    names = &ipp_orientation_requested_names;
   else if (!strcmp(attrname, "print-quality") ||
            !strcmp(attrname, "print-quality-actual") ||
            !strcmp(attrname, "print-quality-default") ||
            !strcmp(attrname, "print-quality-supported"))
-  {
-    num_strings = (int)(sizeof(ipp_print_qualities) / sizeof(ipp_print_qualities[0]));
-    strings     = ipp_print_qualities;
-  }
+    names = &ipp_print_quality_names;
   else if (!strcmp(attrname, "printer-state"))
-  {
-    num_strings = (int)(sizeof(ipp_printer_states) / sizeof(ipp_printer_states[0]));
-    strings     = ipp_printer_states;
-  }
+    names = &ipp_printer_state_names;
   else if (!strcmp(attrname, "resource-state"))
-  {
-    num_strings = (int)(sizeof(ipp_resource_states) / sizeof(ipp_resource_states[0]));
-    strings     = ipp_resource_states;
-  }
+    names = &ipp_resource_state_names;
   else if (!strcmp(attrname, "system-state"))
-  {
-    num_strings = (int)(sizeof(ipp_system_states) / sizeof(ipp_system_states[0]));
-    strings     = ipp_system_states;
-  }
+    names = &ipp_system_state_names;
   else
     return (-1);
 
-  for (i = 0; i < num_strings; i ++)
-    if (!strcmp(enumstring, strings[i]))
-      return (i + 3);
+  if (!ipp_names_init)
+    ipp_init_names();
 
-  return (-1);
+  return (ipp_find_name(names, enumstring));
 }
 
 
@@ -2277,36 +2295,10 @@ ippErrorString(ipp_status_t error)	/* I - Error status */
 ipp_status_t				/* O - IPP status code */
 ippErrorValue(const char *name)		/* I - Name */
 {
-  size_t	i;			/* Looping var */
-
-
-  for (i = 0; i < (sizeof(ipp_status_oks) / sizeof(ipp_status_oks[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_status_oks[i]))
-      return ((ipp_status_t)i);
-
-  if (!_cups_strcasecmp(name, "redirection-other-site"))
-    return (IPP_STATUS_REDIRECTION_OTHER_SITE);
-
-  if (!_cups_strcasecmp(name, "cups-see-other"))
-    return (IPP_STATUS_CUPS_SEE_OTHER);
-
-  for (i = 0; i < (sizeof(ipp_status_400s) / sizeof(ipp_status_400s[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_status_400s[i]))
-      return ((ipp_status_t)(i + 0x400));
+  if (!ipp_names_init)
+    ipp_init_names();
 
-  for (i = 0; i < (sizeof(ipp_status_480s) / sizeof(ipp_status_480s[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_status_480s[i]))
-      return ((ipp_status_t)(i + 0x480));
-
-  for (i = 0; i < (sizeof(ipp_status_500s) / sizeof(ipp_status_500s[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_status_500s[i]))
-      return ((ipp_status_t)(i + 0x500));
-
-  for (i = 0; i < (sizeof(ipp_status_1000s) / sizeof(ipp_status_1000s[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_status_1000s[i]))
-      return ((ipp_status_t)(i + 0x1000));
-
-  return ((ipp_status_t)-1);
+  return ((ipp_status_t)ipp_find_name(&ipp_status_names, name));
 }
 
 
@@ -2332,7 +2324,7 @@ ippOpString(ipp_op_t op)		/* I - Operation ID */
     return ("windows-ext");
   else if (op >= IPP_OP_CUPS_GET_DEFAULT && op <= IPP_OP_CUPS_GET_PPD)
     return (ipp_cups_ops[op - IPP_OP_CUPS_GET_DEFAULT]);
-  else if (op >= IPP_OP_CUPS_GET_DOCUMENT && op <= IPP_OP_CUPS_CREATE_LOCAL_PRINTER)
+  else if (op >= IPP_OP_CUPS_GET_DOCUMENT && op <= IPP_OP_CUPS_GET_STATISTICS)
     return (ipp_cups_ops2[op - IPP_OP_CUPS_GET_DOCUMENT]);
 
  /*
@@ -2354,40 +2346,13 @@ ippOpString(ipp_op_t op)		/* I - Operation ID */
 ipp_op_t				/* O - Operation ID */
 ippOpValue(const char *name)		/* I - Textual name */
 {
-  size_t	i;			/* Looping var */
-
-
   if (!strncmp(name, "0x", 2))
     return ((ipp_op_t)strtol(name + 2, NULL, 16));
 
-  for (i = 0; i < (sizeof(ipp_std_ops) / sizeof(ipp_std_ops[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_std_ops[i]))
-      return ((ipp_op_t)i);
-
-  if (!_cups_strcasecmp(name, "windows-ext"))
-    return (IPP_OP_PRIVATE);
-
-  for (i = 0; i < (sizeof(ipp_cups_ops) / sizeof(ipp_cups_ops[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_cups_ops[i]))
-      return ((ipp_op_t)(i + 0x4001));
-
-  for (i = 0; i < (sizeof(ipp_cups_ops2) / sizeof(ipp_cups_ops2[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_cups_ops2[i]))
-      return ((ipp_op_t)(i + 0x4027));
+  if (!ipp_names_init)
+    ipp_init_names();
 
-  if (!_cups_strcasecmp(name, "Create-Job-Subscription"))
-    return (IPP_OP_CREATE_JOB_SUBSCRIPTIONS);
-
-  if (!_cups_strcasecmp(name, "Create-Printer-Subscription"))
-    return (IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS);
-
-  if (!_cups_strcasecmp(name, "CUPS-Add-Class"))
-    return (IPP_OP_CUPS_ADD_MODIFY_CLASS);
-
-  if (!_cups_strcasecmp(name, "CUPS-Add-Printer"))
-    return (IPP_OP_CUPS_ADD_MODIFY_PRINTER);
-
-  return (IPP_OP_CUPS_INVALID);
+  return ((ipp_op_t)ipp_find_name(&ipp_op_names, name));
 }
 
 
@@ -2472,37 +2437,54 @@ ippTagString(ipp_tag_t tag)		/* I - Tag value */
 ipp_tag_t				/* O - Tag value */
 ippTagValue(const char *name)		/* I - Tag name */
 {
-  size_t	i;			/* Looping var */
+  int	tag;				/* Tag value */
 
 
-  for (i = 0; i < (sizeof(ipp_tag_names) / sizeof(ipp_tag_names[0])); i ++)
-    if (!_cups_strcasecmp(name, ipp_tag_names[i]))
-      return ((ipp_tag_t)i);
-
-  if (!_cups_strcasecmp(name, "operation"))
-    return (IPP_TAG_OPERATION);
-  else if (!_cups_strcasecmp(name, "job"))
-    return (IPP_TAG_JOB);
-  else if (!_cups_strcasecmp(name, "printer"))
-    return (IPP_TAG_PRINTER);
-  else if (!_cups_strcasecmp(name, "unsupported"))
-    return (IPP_TAG_UNSUPPORTED_GROUP);
-  else if (!_cups_strcasecmp(name, "subscription"))
-    return (IPP_TAG_SUBSCRIPTION);
-  else if (!_cups_strcasecmp(name, "event"))
-    return (IPP_TAG_EVENT_NOTIFICATION);
-  else if (!_cups_strcasecmp(name, "language"))
-    return (IPP_TAG_LANGUAGE);
-  else if (!_cups_strcasecmp(name, "mimetype"))
-    return (IPP_TAG_MIMETYPE);
-  else if (!_cups_strcasecmp(name, "name"))
-    return (IPP_TAG_NAME);
-  else if (!_cups_strcasecmp(name, "text"))
-    return (IPP_TAG_TEXT);
-  else if (!_cups_strcasecmp(name, "begCollection"))
-    return (IPP_TAG_BEGIN_COLLECTION);
-  else
+  if (!ipp_names_init)
+    ipp_init_names();
+
+  if ((tag = ipp_find_name(&ipp_tag_lookup, name)) < 0)
     return (IPP_TAG_ZERO);
+  else
+    return ((ipp_tag_t)tag);
+}
+
+
+/*
+ * 'ipp_add_name()' - Add a name to a lookup table.
+ */
+
+static void
+ipp_add_name(_ipp_names_t *names,	/* I - Lookup table */
+             const char   *name,	/* I - Name */
+             int          value)	/* I - Value */
+{
+  _ipp_name_t	*entry = names->names + names->num_names;
+					/* New entry */
+
+
+  entry->name  = name;
+  entry->value = value;
+  entry->order = names->num_names ++;
+}
+
+
+/*
+ * 'ipp_add_names()' - Add an array of sequential names to a lookup table.
+ */
+
+static void
+ipp_add_names(
+    _ipp_names_t       *names,		/* I - Lookup table */
+    const char * const *strings,	/* I - Names */
+    size_t             num_strings,	/* I - Number of names */
+    int                value)		/* I - Value of first name */
+{
+  size_t	i;			/* Looping var */
+
+
+  for (i = 0; i < num_strings; i ++)
+    ipp_add_name(names, strings[i], value + (int)i);
 }
 
 
@@ -2567,3 +2549,196 @@ ipp_col_string(ipp_t  *col,		/* I - Collection attribute */
 
   return ((size_t)(bufptr - buffer));
 }
+
+
+/*
+ * 'ipp_compare_names()' - Compare two names, then their table order.
+ */
+
+static int				/* O - Result of comparison */
+ipp_compare_names(_ipp_name_t *a,	/* I - First name */
+                  _ipp_name_t *b)	/* I - Second name */
+{
+  int	result;				/* Result of comparison */
+
+
+  if ((result = strcmp(a->name, b->name)) == 0)
+    result = a->order - b->order;
+
+  return (result);
+}
+
+
+/*
+ * 'ipp_compare_names_nocase()' - Compare two names without case, then their
+ *                                table order.
+ */
+
+static int				/* O - Result of comparison */
+ipp_compare_names_nocase(
+    _ipp_name_t *a,			/* I - First name */
+    _ipp_name_t *b)			/* I - Second name */
+{
+  int	result;				/* Result of comparison */
+
+
+  if ((result = _cups_strcasecmp(a->name, b->name)) == 0)
+    result = a->order - b->order;
+
+  return (result);
+}
+
+
+/*
+ * 'ipp_find_name()' - Find the value for a name using a binary search.
+ */
+
+static int				/* O - Value or -1 if not found */
+ipp_find_name(_ipp_names_t *names,	/* I - Lookup table */
+              const char   *name)	/* I - Name */
+{
+  int	left,				/* Left side of search */
+	right,				/* Right side of search */
+	current,			/* Current entry */
+	diff;				/* Result of comparison */
+
+
+  for (left = 0, right = names->num_names - 1; left <= right;)
+  {
+    current = (left + right) / 2;
+
+    if (names->nocase)
+      diff = _cups_strcasecmp(name, names->names[current].name);
+    else
+      diff = strcmp(name, names->names[current].name);
+
+    if (!diff)
+      return (names->names[current].value);
+    else if (diff < 0)
+      right = current - 1;
+    else
+      left  = current + 1;
+  }
+
+  return (-1);
+}
+
+
+/*
+ * 'ipp_init_names()' - Build the sorted name lookup tables.
+ *
+ * Names are added in the order the old linear searches used, so the first
+ * match wins when a name appears more than once.
+ */
+
+static void
+ipp_init_names(void)
+{
+  _cupsMutexLock(&ipp_names_mutex);
+
+  if (!ipp_names_init)
+  {
+    ipp_add_names(&ipp_op_names, ipp_std_ops, sizeof(ipp_std_ops) / sizeof(ipp_std_ops[0]), 0);
+    ipp_add_name(&ipp_op_names, "windows-ext", IPP_OP_PRIVATE);
+    ipp_add_names(&ipp_op_names, ipp_cups_ops, sizeof(ipp_cups_ops) / sizeof(ipp_cups_ops[0]), 0x4001);
+    ipp_add_names(&ipp_op_names, ipp_cups_ops2, sizeof(ipp_cups_ops2) / sizeof(ipp_cups_ops2[0]), 0x4027);
+    ipp_add_name(&ipp_op_names, "Create-Job-Subscription", IPP_OP_CREATE_JOB_SUBSCRIPTIONS);
+    ipp_add_name(&ipp_op_names, "Create-Printer-Subscription", IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS);
+    ipp_add_name(&ipp_op_names, "CUPS-Add-Class", IPP_OP_CUPS_ADD_MODIFY_CLASS);
+    ipp_add_name(&ipp_op_names, "CUPS-Add-Printer", IPP_OP_CUPS_ADD_MODIFY_PRINTER);
+    ipp_sort_names(&ipp_op_names);
+
+    ipp_add_names(&ipp_status_names, ipp_status_oks, sizeof(ipp_status_oks) / sizeof(ipp_status_oks[0]), 0);
+    ipp_add_name(&ipp_status_names, "redirection-other-site", IPP_STATUS_REDIRECTION_OTHER_SITE);
+    ipp_add_name(&ipp_status_names, "cups-see-other", IPP_STATUS_CUPS_SEE_OTHER);
+    ipp_add_names(&ipp_status_names, ipp_status_400s, sizeof(ipp_status_400s) / sizeof(ipp_status_400s[0]), 0x400);
+    ipp_add_names(&ipp_status_names, ipp_status_480s, sizeof(ipp_status_480s) / sizeof(ipp_status_480s[0]), 0x480);
+    ipp_add_names(&ipp_status_names, ipp_status_500s, sizeof(ipp_status_500s) / sizeof(ipp_status_500s[0]), 0x500);
+    ipp_add_names(&ipp_status_names, ipp_status_1000s, sizeof(ipp_status_1000s) / sizeof(ipp_status_1000s[0]), 0x1000);
+    ipp_sort_names(&ipp_status_names);
+
+    ipp_add_names(&ipp_tag_lookup, ipp_tag_names, sizeof(ipp_tag_names) / sizeof(ipp_tag_names[0]), 0);
+    ipp_add_name(&ipp_tag_lookup, "operation", IPP_TAG_OPERATION);
+    ipp_add_name(&ipp_tag_lookup, "job", IPP_TAG_JOB);
+    ipp_add_name(&ipp_tag_lookup, "printer", IPP_TAG_PRINTER);
+    ipp_add_name(&ipp_tag_lookup, "unsupported", IPP_TAG_UNSUPPORTED_GROUP);
+    ipp_add_name(&ipp_tag_lookup, "subscription", IPP_TAG_SUBSCRIPTION);
+    ipp_add_name(&ipp_tag_lookup, "event", IPP_TAG_EVENT_NOTIFICATION);
+    ipp_add_name(&ipp_tag_lookup, "language", IPP_TAG_LANGUAGE);
+    ipp_add_name(&ipp_tag_lookup, "mimetype", IPP_TAG_MIMETYPE);
+    ipp_add_name(&ipp_tag_lookup, "name", IPP_TAG_NAME);
+    ipp_add_name(&ipp_tag_lookup, "text", IPP_TAG_TEXT);
+    ipp_add_name(&ipp_tag_lookup, "begCollection", IPP_TAG_BEGIN_COLLECTION);
+    ipp_sort_names(&ipp_tag_lookup);
+
+    ipp_add_names(&ipp_document_state_names, ipp_document_states, sizeof(ipp_document_states) / sizeof(ipp_document_states[0]), 3);
+    ipp_sort_names(&ipp_document_state_names);
+
+    ipp_add_names(&ipp_finishings_names, ipp_finishings_vendor, sizeof(ipp_finishings_vendor) / sizeof(ipp_finishings_vendor[0]), 0x40000000);
+    ipp_add_names(&ipp_finishings_names, ipp_finishings, sizeof(ipp_finishings) / sizeof(ipp_finishings[0]), 3);
+    ipp_sort_names(&ipp_finishings_names);
+
+    ipp_add_names(&ipp_job_collation_type_names, ipp_job_collation_types, sizeof(ipp_job_collation_types) / sizeof(ipp_job_collation_types[0]), 3);
+    ipp_sort_names(&ipp_job_collation_type_names);
+
+    ipp_add_names(&ipp_job_state_names, ipp_job_states, sizeof(ipp_job_states) / sizeof(ipp_job_states[0]), 3);
+    ipp_sort_names(&ipp_job_state_names);
+
+    ipp_add_names(&ipp_orientation_requested_names, ipp_orientation_requesteds, sizeof(ipp_orientation_requesteds) / sizeof(ipp_orientation_requesteds[0]), 3);
+    ipp_sort_names(&ipp_orientation_requested_names);
+
+    ipp_add_names(&ipp_print_quality_names, ipp_print_qualities, sizeof(ipp_print_qualities) / sizeof(ipp_print_qualities[0]), 3);
+    ipp_sort_names(&ipp_print_quality_names);
+
+    ipp_add_names(&ipp_printer_state_names, ipp_printer_states, sizeof(ipp_printer_states) / sizeof(ipp_printer_states[0]), 3);
+    ipp_sort_names(&ipp_printer_state_names);
+
+    ipp_add_names(&ipp_resource_state_names, ipp_resource_states, sizeof(ipp_resource_states) / sizeof(ipp_resource_states[0]), 3);
+    ipp_sort_names(&ipp_resource_state_names);
+
+    ipp_add_names(&ipp_system_state_names, ipp_system_states, sizeof(ipp_system_states) / sizeof(ipp_system_states[0]), 3);
+    ipp_sort_names(&ipp_system_state_names);
+
+    ipp_names_init = 1;
+  }
+
+  _cupsMutexUnlock(&ipp_names_mutex);
+}
+
+
+/*
+ * 'ipp_sort_names()' - Sort a lookup table and drop duplicate names.
+ */
+
+static void
+ipp_sort_names(_ipp_names_t *names)	/* I - Lookup table */
+{
+  int		i,			/* Looping var */
+		count;			/* Number of unique names */
+  int		(*compare)(const char *, const char *);
+					/* Name comparison function */
+
+
+  if (names->nocase)
+  {
+    qsort(names->names, (size_t)names->num_names, sizeof(_ipp_name_t), (int (*)(const void *, const void *))ipp_compare_names_nocase);
+    compare = _cups_strcasecmp;
+  }
+  else
+  {
+    qsort(names->names, (size_t)names->num_names, sizeof(_ipp_name_t), (int (*)(const void *, const void *))ipp_compare_names);
+    compare = strcmp;
+  }
+
+ /*
+  * Keep the first (earliest) entry for each name...
+  */
+
+  for (i = 1, count = names->num_names > 0 ? 1 : 0; i < names->num_names; i ++)
+  {
+    if ((*compare)(names->names[i].name, names->names[count - 1].name))
+      names->names[count ++] = names->names[i];
+  }
+
+  names->num_names = count;
+}
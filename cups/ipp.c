@@ -20,6 +20,31 @@
 #endif /* _WIN32 */
 
 
+/*
+ * Local globals...
+ */
+
+#define IPP_CHAR_KEYWORD	1	/* keyword: A-Z a-z 0-9 - . _ */
+#define IPP_CHAR_SCHEME		2	/* uriScheme: a-z 0-9 + - . */
+#define IPP_CHAR_CHARSET	4	/* charset: printable, not upper or space */
+#define IPP_CHAR_LANGUAGE	8	/* naturalLanguage: a-z 0-9 - */
+#define IPP_CHAR_MIMETYPE	16	/* mimeMediaType token: A-Z a-z 0-9 -!#$&.+^_ */
+#define IPP_CHAR_LOWER		32	/* Lowercase letters: a-z */
+
+static _cups_mutex_t	ipp_validate_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for validation data */
+static int		ipp_validate_init = 0;
+					/* Validation data initialized? */
+static unsigned char	ipp_validate_chars[256];
+					/* Character classes */
+static int		ipp_language_status = 0,
+					/* naturalLanguage regcomp status */
+			ipp_mimetype_status = 0;
+					/* mimeMediaType regcomp status */
+static regex_t		ipp_language_re,/* naturalLanguage regular expression */
+			ipp_mimetype_re;/* mimeMediaType regular expression */
+
+
 /*
  * Local functions...
  */
@@ -27,9 +52,18 @@
 static ipp_attribute_t	*ipp_add_attr(ipp_t *ipp, const char *name,
 			              ipp_tag_t  group_tag, ipp_tag_t value_tag,
 			              int num_values);
+static int		ipp_add_index(ipp_t *ipp, ipp_attribute_t *attr,
+			              ipp_attribute_t *prev);
+static char		*ipp_alloc_string(ipp_t *ipp, const char *s);
+static void		*ipp_arena_alloc(ipp_t *ipp, size_t size);
+static void		ipp_build_index(ipp_t *ipp);
+static _ipp_index_t	*ipp_find_index(ipp_t *ipp, const char *name);
+static void		ipp_free_index(ipp_t *ipp);
 static void		ipp_free_values(ipp_attribute_t *attr, int element,
 			                int count);
 static char		*ipp_get_code(const char *locale, char *buffer, size_t bufsize) _CUPS_NONNULL(1,2);
+static unsigned		ipp_hash_name(const char *name);
+static void		ipp_init_validate(void);
 static char		*ipp_lang_code(const char *locale, char *buffer, size_t bufsize) _CUPS_NONNULL(1,2);
 static size_t		ipp_length(ipp_t *ipp, int collection);
 static ssize_t		ipp_read_http(http_t *http, ipp_uchar_t *buffer,
@@ -40,6 +74,7 @@ static void		ipp_set_error(ipp_status_t status, const char *format,
 			              ...);
 static _ipp_value_t	*ipp_set_value(ipp_t *ipp, ipp_attribute_t **attr,
 			               int element);
+static size_t		ipp_span(const char *s, int chars);
 static ssize_t		ipp_write_file(int *fd, ipp_uchar_t *buffer,
 			               size_t length);
 
@@ -95,6 +130,36 @@ _cupsBufferRelease(char *b)		/* I - Buffer to release */
 }
 
 
+/*
+ * '_ippNewArena()' - Allocate a new IPP message with an attribute arena.
+ *
+ * Attributes added to the message are carved out of large chunks that are
+ * freed together by @link ippDelete@ rather than being allocated and freed
+ * one at a time.  Deleted or resized attributes are not reclaimed until the
+ * message is deleted, so this is intended for short-lived messages.
+ * Attribute names and the string values read by @link ippReadIO@ are copied
+ * into the arena as well; other string values come from the shared string
+ * pool.
+ */
+
+ipp_t *					/* O - New IPP message */
+_ippNewArena(void)
+{
+  ipp_t	*temp;				/* New IPP message */
+
+
+  if ((temp = ippNew()) != NULL)
+  {
+    if ((temp->arena = calloc(1, sizeof(_ipp_arena_t) + 16 + IPP_ARENA_SIZE)) != NULL)
+      temp->arena->size = IPP_ARENA_SIZE;
+  }
+
+  return (temp);
+}
+
+
+
+
 /*
  * 'ippAddBoolean()' - Add a boolean attribute to an IPP message.
  *
@@ -1543,15 +1608,24 @@ ippCopyAttribute(
 
 	  memcpy(dstattr->values, srcattr->values, (size_t)srcattr->num_values * sizeof(_ipp_value_t));
         }
-	else
+	else if ((srcattr->value_tag & IPP_TAG_CUPS_CONST) || srcattr->arena)
 	{
 	 /*
-	  * Otherwise do a normal reference counted copy...
+	  * Constant and arena strings are not in the string pool, so copy them...
 	  */
 
 	  for (i = srcattr->num_values, srcval = srcattr->values, dstval = dstattr->values; i > 0; i --, srcval ++, dstval ++)
 	    dstval->string.text = _cupsStrAlloc(srcval->string.text);
 	}
+	else
+	{
+	 /*
+	  * Otherwise share the (immutable) pooled strings by reference...
+	  */
+
+	  for (i = srcattr->num_values, srcval = srcattr->values, dstval = dstattr->values; i > 0; i --, srcval ++, dstval ++)
+	    dstval->string.text = _cupsStrRetain(srcval->string.text);
+	}
         break;
 
     case IPP_TAG_TEXTLANG :
@@ -1567,10 +1641,10 @@ ippCopyAttribute(
 
 	  memcpy(dstattr->values, srcattr->values, (size_t)srcattr->num_values * sizeof(_ipp_value_t));
         }
-	else if (srcattr->value_tag & IPP_TAG_CUPS_CONST)
+	else if ((srcattr->value_tag & IPP_TAG_CUPS_CONST) || srcattr->arena)
 	{
 	 /*
-	  * Otherwise do a normal reference counted copy...
+	  * Constant and arena strings are not in the string pool, so copy them...
 	  */
 
 	  for (i = srcattr->num_values, srcval = srcattr->values, dstval = dstattr->values; i > 0; i --, srcval ++, dstval ++)
@@ -1583,6 +1657,22 @@ ippCopyAttribute(
 	    dstval->string.text = _cupsStrAlloc(srcval->string.text);
           }
         }
+	else
+	{
+	 /*
+	  * Otherwise share the (immutable) pooled strings by reference...
+	  */
+
+	  for (i = srcattr->num_values, srcval = srcattr->values, dstval = dstattr->values; i > 0; i --, srcval ++, dstval ++)
+	  {
+	    if (srcval == srcattr->values)
+              dstval->string.language = _cupsStrRetain(srcval->string.language);
+	    else
+              dstval->string.language = dstattr->values[0].string.language;
+
+	    dstval->string.text = _cupsStrRetain(srcval->string.text);
+          }
+	}
         break;
 
     case IPP_TAG_BEGIN_COLLECTION :
@@ -1757,9 +1847,19 @@ ippDelete(ipp_t *ipp)			/* I - IPP message */
     if (attr->name)
       _cupsStrFree(attr->name);
 
-    free(attr);
+    if (!attr->arena)
+      free(attr);
   }
 
+  while (ipp->arena)
+  {
+    _ipp_arena_t *arena = ipp->arena;	/* Current arena chunk */
+
+    ipp->arena = arena->next;
+    free(arena);
+  }
+
+  free(ipp->index);
   free(ipp);
 }
 
@@ -1818,6 +1918,8 @@ ippDeleteAttribute(
 
     if (!current)
       return;
+
+    ipp_free_index(ipp);
   }
 
  /*
@@ -1829,7 +1931,8 @@ ippDeleteAttribute(
   if (attr->name)
     _cupsStrFree(attr->name);
 
-  free(attr);
+  if (!attr->arena)
+    free(attr);
 }
 
 
@@ -1934,6 +2037,7 @@ ippFindNextAttribute(ipp_t      *ipp,	/* I - IPP message */
   ipp_tag_t		value_tag;	/* Value tag */
   char			parent[1024],	/* Parent attribute name */
 			*child = NULL;	/* Child attribute name */
+  int			scanned = -1;	/* Attributes scanned from the start */
 
 
   DEBUG_printf(("2ippFindNextAttribute(ipp=%p, name=\"%s\", type=%02x(%s))", (void *)ipp, name, type, ippTagString(type)));
@@ -1999,16 +2103,37 @@ ippFindNextAttribute(ipp_t      *ipp,	/* I - IPP message */
     ipp->prev = ipp->current;
     attr      = ipp->current->next;
   }
+  else if (ipp->index)
+  {
+   /*
+    * Start at the first attribute with this name...
+    */
+
+    _ipp_index_t *entry = ipp_find_index(ipp, name);
+					/* Index entry */
+
+    if (entry)
+    {
+      ipp->prev = entry->prev;
+      attr      = entry->attr;
+    }
+    else
+      attr = NULL;
+  }
   else
   {
     ipp->prev = NULL;
     attr      = ipp->attrs;
+    scanned   = 0;
   }
 
   for (; attr != NULL; ipp->prev = attr, attr = attr->next)
   {
     DEBUG_printf(("4ippFindAttribute: attr=%p, name=\"%s\"", (void *)attr, attr->name));
 
+    if (scanned >= 0)
+      scanned ++;
+
     value_tag = (ipp_tag_t)(attr->value_tag & IPP_TAG_CUPS_MASK);
 
     if (attr->name != NULL && _cups_strcasecmp(attr->name, name) == 0 &&
@@ -2032,10 +2157,18 @@ ippFindNextAttribute(ipp_t      *ipp,	/* I - IPP message */
         }
       }
       else
+      {
+        if (scanned > IPP_INDEX_MIN)
+          ipp_build_index(ipp);
+
         return (attr);
+      }
     }
   }
 
+  if (scanned > IPP_INDEX_MIN)
+    ipp_build_index(ipp);
+
   ipp->current = NULL;
   ipp->prev    = NULL;
   ipp->atend   = 1;
@@ -2581,6 +2714,63 @@ ippLength(ipp_t *ipp)			/* I - IPP message */
 }
 
 
+/*
+ * '_ippMemoryUsage()' - Estimate the memory used by an IPP message.
+ *
+ * The estimate includes the message, attribute, index, and arena allocations
+ * along with octetString values and nested collections.  Strings from the
+ * shared string pool are not included since they are accounted for by
+ * @code _cupsStrStatistics@.
+ */
+
+size_t					/* O - Bytes used */
+_ippMemoryUsage(ipp_t *ipp)		/* I - IPP message */
+{
+  int			i,		/* Looping var */
+			alloc_values;	/* Number of values allocated */
+  size_t		bytes;		/* Bytes used */
+  ipp_attribute_t	*attr;		/* Current attribute */
+  _ipp_value_t		*value;		/* Current value */
+  _ipp_arena_t		*arena;		/* Current arena chunk */
+
+
+  if (!ipp)
+    return (0);
+
+  bytes = sizeof(ipp_t) + (size_t)ipp->alloc_index * sizeof(_ipp_index_t);
+
+  for (arena = ipp->arena; arena; arena = arena->next)
+    bytes += sizeof(_ipp_arena_t) + 16 + arena->size;
+
+  for (attr = ipp->attrs; attr; attr = attr->next)
+  {
+    if (!attr->arena)
+    {
+      if (attr->num_values <= 1)
+        alloc_values = 1;
+      else
+        alloc_values = (attr->num_values + IPP_MAX_VALUES - 1) & ~(IPP_MAX_VALUES - 1);
+
+      bytes += sizeof(ipp_attribute_t) + (size_t)(alloc_values - 1) * sizeof(_ipp_value_t);
+    }
+
+    if (attr->value_tag == IPP_TAG_BEGIN_COLLECTION)
+    {
+      for (i = attr->num_values, value = attr->values; i > 0; i --, value ++)
+        bytes += _ippMemoryUsage(value->collection);
+    }
+    else if (attr->value_tag == IPP_TAG_STRING)
+    {
+      for (i = attr->num_values, value = attr->values; i > 0; i --, value ++)
+        if (value->unknown.data)
+          bytes += (size_t)value->unknown.length;
+    }
+  }
+
+  return (bytes);
+}
+
+
 /*
  * 'ippNextAttribute()' - Return the next attribute in the message.
  *
@@ -3340,7 +3530,7 @@ ippReadIO(void       *src,		/* I - Data source */
 		}
 
 		buffer[n] = '\0';
-		value->string.text = _cupsStrAlloc((char *)buffer);
+		value->string.text = ipp_alloc_string(ipp, (char *)buffer);
 		DEBUG_printf(("2ippReadIO: value=\"%s\"", value->string.text));
 	        break;
 
@@ -3476,7 +3666,7 @@ ippReadIO(void       *src,		/* I - Data source */
 		memcpy(string, bufptr + 2, (size_t)n);
 		string[n] = '\0';
 
-		value->string.language = _cupsStrAlloc((char *)string);
+		value->string.language = ipp_alloc_string(ipp, (char *)string);
 
                 bufptr += 2 + n;
 		n = (bufptr[0] << 8) | bufptr[1];
@@ -3491,7 +3681,7 @@ ippReadIO(void       *src,		/* I - Data source */
 		}
 
 		bufptr[2 + n] = '\0';
-                value->string.text = _cupsStrAlloc((char *)bufptr + 2);
+                value->string.text = ipp_alloc_string(ipp, (char *)bufptr + 2);
 	        break;
 
             case IPP_TAG_BEGIN_COLLECTION :
@@ -3564,7 +3754,9 @@ ippReadIO(void       *src,		/* I - Data source */
 		}
 
 		buffer[n] = '\0';
-		attr->name = _cupsStrAlloc((char *)buffer);
+		attr->name = ipp_alloc_string(ipp, (char *)buffer);
+
+		ipp_free_index(ipp);
 
                /*
 	        * Since collection members are encoded differently than
@@ -3892,6 +4084,8 @@ ippSetName(ipp_t           *ipp,	/* I  - IPP message */
       _cupsStrFree((*attr)->name);
 
     (*attr)->name = temp;
+
+    ipp_free_index(ipp);
   }
 
   return (temp != NULL);
@@ -4722,8 +4916,9 @@ ippValidateAttribute(
   int		port,			/* Port number from URI */
 		uri_status;		/* URI separation status */
   const char	*ptr;			/* Pointer into string */
+  size_t	len;			/* Length of token */
+  int		simple;			/* Simple naturalLanguage value? */
   ipp_attribute_t *colattr;		/* Collection attribute */
-  regex_t	re;			/* Regular expression */
   ipp_uchar_t	*date;			/* Current date value */
 
 
@@ -4734,13 +4929,14 @@ ippValidateAttribute(
   if (!attr->name)
     return (1);
 
+  if (!ipp_validate_init)
+    ipp_init_validate();
+
  /*
   * Validate the attribute name.
   */
 
-  for (ptr = attr->name; *ptr; ptr ++)
-    if (!isalnum(*ptr & 255) && *ptr != '-' && *ptr != '.' && *ptr != '_')
-      break;
+  ptr = attr->name + ipp_span(attr->name, IPP_CHAR_KEYWORD);
 
   if (*ptr || ptr == attr->name)
   {
@@ -4905,7 +5101,10 @@ ippValidateAttribute(
     case IPP_TAG_TEXTLANG :
         for (i = 0; i < attr->num_values; i ++)
 	{
-	  for (ptr = attr->values[i].string.text; *ptr; ptr ++)
+	  ptr = attr->values[i].string.text;
+	  ptr += _cupsUTF8PrintableLength((const cups_utf8_t *)ptr, strlen(ptr));
+
+	  for (; *ptr; ptr ++)
 	  {
 	    if ((*ptr & 0xe0) == 0xc0)
 	    {
@@ -4960,7 +5159,10 @@ ippValidateAttribute(
     case IPP_TAG_NAMELANG :
         for (i = 0; i < attr->num_values; i ++)
 	{
-	  for (ptr = attr->values[i].string.text; *ptr; ptr ++)
+	  ptr = attr->values[i].string.text;
+	  ptr += _cupsUTF8PrintableLength((const cups_utf8_t *)ptr, strlen(ptr));
+
+	  for (; *ptr; ptr ++)
 	  {
 	    if ((*ptr & 0xe0) == 0xc0)
 	    {
@@ -5014,12 +5216,8 @@ ippValidateAttribute(
     case IPP_TAG_KEYWORD :
         for (i = 0; i < attr->num_values; i ++)
 	{
-	  for (ptr = attr->values[i].string.text; *ptr; ptr ++)
-	  {
-	    if (!isalnum(*ptr & 255) && *ptr != '-' && *ptr != '.' &&
-	        *ptr != '_')
-	      break;
-	  }
+	  ptr = attr->values[i].string.text;
+	  ptr += ipp_span(ptr, IPP_CHAR_KEYWORD);
 
 	  if (*ptr || ptr == attr->values[i].string.text)
 	  {
@@ -5057,15 +5255,8 @@ ippValidateAttribute(
         for (i = 0; i < attr->num_values; i ++)
 	{
 	  ptr = attr->values[i].string.text;
-	  if (islower(*ptr & 255))
-	  {
-	    for (ptr ++; *ptr; ptr ++)
-	    {
-	      if (!islower(*ptr & 255) && !isdigit(*ptr & 255) &&
-	          *ptr != '+' && *ptr != '-' && *ptr != '.')
-                break;
-	    }
-	  }
+	  if (*ptr >= 'a' && *ptr <= 'z')
+	    ptr += ipp_span(ptr, IPP_CHAR_SCHEME);
 
 	  if (*ptr || ptr == attr->values[i].string.text)
 	  {
@@ -5084,12 +5275,8 @@ ippValidateAttribute(
     case IPP_TAG_CHARSET :
         for (i = 0; i < attr->num_values; i ++)
 	{
-	  for (ptr = attr->values[i].string.text; *ptr; ptr ++)
-	  {
-	    if (!isprint(*ptr & 255) || isupper(*ptr & 255) ||
-	        isspace(*ptr & 255))
-	      break;
-	  }
+	  ptr = attr->values[i].string.text;
+	  ptr += ipp_span(ptr, IPP_CHAR_CHARSET);
 
 	  if (*ptr || ptr == attr->values[i].string.text)
 	  {
@@ -5106,98 +5293,80 @@ ippValidateAttribute(
         break;
 
     case IPP_TAG_LANGUAGE :
-       /*
-        * The following regular expression is derived from the ABNF for
-	* language tags in RFC 4646.  All I can say is that this is the
-	* easiest way to check the values...
-	*/
-
-        if ((i = regcomp(&re,
-			 "^("
-			 "(([a-z]{2,3}(-[a-z][a-z][a-z]){0,3})|[a-z]{4,8})"
-								/* language */
-			 "(-[a-z][a-z][a-z][a-z]){0,1}"		/* script */
-			 "(-([a-z][a-z]|[0-9][0-9][0-9])){0,1}"	/* region */
-			 "(-([a-z]{5,8}|[0-9][0-9][0-9]))*"	/* variant */
-			 "(-[a-wy-z](-[a-z0-9]{2,8})+)*"	/* extension */
-			 "(-x(-[a-z0-9]{1,8})+)*"		/* privateuse */
-			 "|"
-			 "x(-[a-z0-9]{1,8})+"			/* privateuse */
-			 "|"
-			 "[a-z]{1,3}(-[a-z][0-9]{2,8}){1,2}"	/* grandfathered */
-			 ")$",
-			 REG_NOSUB | REG_EXTENDED)) != 0)
+        if (ipp_language_status)
         {
           char	temp[256];		/* Temporary error string */
 
-          regerror(i, &re, temp, sizeof(temp));
+          regerror(ipp_language_status, &ipp_language_re, temp, sizeof(temp));
 	  ipp_set_error(IPP_STATUS_ERROR_INTERNAL, _("Unable to compile naturalLanguage regular expression: %s."), temp);
 	  return (0);
         }
 
         for (i = 0; i < attr->num_values; i ++)
 	{
-	  if (regexec(&re, attr->values[i].string.text, 0, NULL, 0))
+	 /*
+	  * Reject bad characters right away and accept the common "ll" and
+	  * "ll-cc" forms without running the regular expression...
+	  */
+
+	  ptr    = attr->values[i].string.text;
+	  len    = ipp_span(ptr, IPP_CHAR_LOWER);
+	  simple = (len == 2 || len == 3) && (!ptr[len] || (ptr[len] == '-' && ipp_span(ptr + len + 1, IPP_CHAR_LOWER) == 2 && !ptr[len + 3]));
+	  len    = ipp_span(ptr, IPP_CHAR_LANGUAGE);
+
+	  if (ptr[len] || (!simple && regexec(&ipp_language_re, ptr, 0, NULL, 0)))
 	  {
 	    ipp_set_error(IPP_STATUS_ERROR_BAD_REQUEST, _("\"%s\": Bad naturalLanguage value \"%s\" - bad characters (RFC 8011 section 5.1.9)."), attr->name, attr->values[i].string.text);
-	    regfree(&re);
 	    return (0);
 	  }
 
-	  if (strlen(attr->values[i].string.text) > (IPP_MAX_LANGUAGE - 1))
+	  if (len > (IPP_MAX_LANGUAGE - 1))
 	  {
-	    ipp_set_error(IPP_STATUS_ERROR_BAD_REQUEST, _("\"%s\": Bad naturalLanguage value \"%s\" - bad length %d (RFC 8011 section 5.1.9)."), attr->name, attr->values[i].string.text, (int)strlen(attr->values[i].string.text));
-	    regfree(&re);
+	    ipp_set_error(IPP_STATUS_ERROR_BAD_REQUEST, _("\"%s\": Bad naturalLanguage value \"%s\" - bad length %d (RFC 8011 section 5.1.9)."), attr->name, attr->values[i].string.text, (int)len);
 	    return (0);
 	  }
 	}
-
-	regfree(&re);
         break;
 
     case IPP_TAG_MIMETYPE :
-       /*
-        * The following regular expression is derived from the ABNF for
-	* MIME media types in RFC 2045 and 4288.  All I can say is that this is
-	* the easiest way to check the values...
-	*/
-
-        if ((i = regcomp(&re,
-			 "^"
-			 "[-a-zA-Z0-9!#$&.+^_]{1,127}"		/* type-name */
-			 "/"
-			 "[-a-zA-Z0-9!#$&.+^_]{1,127}"		/* subtype-name */
-			 "(;[-a-zA-Z0-9!#$&.+^_]{1,127}="	/* parameter= */
-			 "([-a-zA-Z0-9!#$&.+^_]{1,127}|\"[^\"]*\"))*"
-			 					/* value */
-			 "$",
-			 REG_NOSUB | REG_EXTENDED)) != 0)
+        if (ipp_mimetype_status)
         {
           char	temp[256];		/* Temporary error string */
 
-          regerror(i, &re, temp, sizeof(temp));
+          regerror(ipp_mimetype_status, &ipp_mimetype_re, temp, sizeof(temp));
 	  ipp_set_error(IPP_STATUS_ERROR_BAD_REQUEST, _("Unable to compile mimeMediaType regular expression: %s."), temp);
 	  return (0);
         }
 
         for (i = 0; i < attr->num_values; i ++)
 	{
-	  if (regexec(&re, attr->values[i].string.text, 0, NULL, 0))
+	 /*
+	  * Accept plain "type/subtype" values without running the regular
+	  * expression...
+	  */
+
+	  ptr = attr->values[i].string.text;
+
+	  if ((len = ipp_span(ptr, IPP_CHAR_MIMETYPE)) >= 1 && len <= 127 && ptr[len] == '/')
+	  {
+	    ptr += len + 1;
+	    len = ipp_span(ptr, IPP_CHAR_MIMETYPE);
+	  }
+	  else
+	    len = 0;
+
+	  if ((len < 1 || len > 127 || ptr[len]) && regexec(&ipp_mimetype_re, attr->values[i].string.text, 0, NULL, 0))
 	  {
 	    ipp_set_error(IPP_STATUS_ERROR_BAD_REQUEST, _("\"%s\": Bad mimeMediaType value \"%s\" - bad characters (RFC 8011 section 5.1.10)."), attr->name, attr->values[i].string.text);
-	    regfree(&re);
 	    return (0);
 	  }
 
 	  if (strlen(attr->values[i].string.text) > (IPP_MAX_MIMETYPE - 1))
 	  {
 	    ipp_set_error(IPP_STATUS_ERROR_BAD_REQUEST, _("\"%s\": Bad mimeMediaType value \"%s\" - bad length %d (RFC 8011 section 5.1.10)."), attr->name, attr->values[i].string.text, (int)strlen(attr->values[i].string.text));
-	    regfree(&re);
 	    return (0);
 	  }
 	}
-
-	regfree(&re);
         break;
 
     default :
@@ -5302,6 +5471,13 @@ ippWriteIO(void       *dst,		/* I - Destination */
     return (IPP_STATE_ERROR);
   }
 
+ /*
+  * In blocking mode the header and as many attributes as will fit are
+  * collected in the buffer before calling the write callback...
+  */
+
+  bufptr = buffer;
+
   switch (ipp->state)
   {
     case IPP_STATE_IDLE :
@@ -5319,8 +5495,6 @@ ippWriteIO(void       *dst,		/* I - Destination */
 	  *                   Total = 8 bytes
 	  */
 
-          bufptr = buffer;
-
 	  *bufptr++ = ipp->request.any.version[0];
 	  *bufptr++ = ipp->request.any.version[1];
 	  *bufptr++ = (ipp_uchar_t)(ipp->request.any.op_status >> 8);
@@ -5335,13 +5509,6 @@ ippWriteIO(void       *dst,		/* I - Destination */
 			ipp->request.any.op_status));
 	  DEBUG_printf(("2ippWriteIO: request_id=%d",
 			ipp->request.any.request_id));
-
-          if ((*cb)(dst, buffer, (size_t)(bufptr - buffer)) < 0)
-	  {
-	    DEBUG_puts("1ippWriteIO: Could not write IPP header...");
-	    _cupsBufferRelease((char *)buffer);
-	    return (IPP_STATE_ERROR);
-	  }
 	}
 
        /*
@@ -5360,20 +5527,41 @@ ippWriteIO(void       *dst,		/* I - Destination */
 	*/
 
         if (!blocking)
+	{
+	  if (bufptr > buffer && (*cb)(dst, buffer, (size_t)(bufptr - buffer)) < 0)
+	  {
+	    DEBUG_puts("1ippWriteIO: Could not write IPP header...");
+	    _cupsBufferRelease((char *)buffer);
+	    return (IPP_STATE_ERROR);
+	  }
+
 	  break;
+	}
 
     case IPP_STATE_ATTRIBUTE :
         while (ipp->current != NULL)
 	{
 	 /*
-	  * Write this attribute...
+	  * Write this attribute, first flushing the buffer if the tags and name
+	  * might not fit...
 	  */
 
-	  bufptr = buffer;
-	  attr   = ipp->current;
+	  attr = ipp->current;
 
 	  ipp->current = ipp->current->next;
 
+	  if (bufptr > buffer && attr->name && (IPP_BUF_SIZE - (bufptr - buffer)) < ((int)strlen(attr->name) + 13))
+	  {
+	    if ((*cb)(dst, buffer, (size_t)(bufptr - buffer)) < 0)
+	    {
+	      DEBUG_puts("1ippWriteIO: Could not write IPP attribute...");
+	      _cupsBufferRelease((char *)buffer);
+	      return (IPP_STATE_ERROR);
+	    }
+
+	    bufptr = buffer;
+	  }
+
           if (!parent)
 	  {
 	    if (ipp->curtag != attr->group_tag)
@@ -6096,10 +6284,11 @@ ippWriteIO(void       *dst,		/* I - Destination */
 	  }
 
          /*
-	  * Write the data out...
+	  * Write the data out if blocking is disabled, otherwise keep filling
+	  * the buffer...
 	  */
 
-	  if (bufptr > buffer)
+	  if (!blocking && bufptr > buffer)
 	  {
 	    if ((*cb)(dst, buffer, (size_t)(bufptr - buffer)) < 0)
 	    {
@@ -6110,6 +6299,8 @@ ippWriteIO(void       *dst,		/* I - Destination */
 
 	    DEBUG_printf(("2ippWriteIO: wrote %d bytes",
 			  (int)(bufptr - buffer)));
+
+	    bufptr = buffer;
 	  }
 
 	 /*
@@ -6128,22 +6319,32 @@ ippWriteIO(void       *dst,		/* I - Destination */
 	  * tag or end-collection attribute...
 	  */
 
+          if ((IPP_BUF_SIZE - (bufptr - buffer)) < 5)
+	  {
+	    if ((*cb)(dst, buffer, (size_t)(bufptr - buffer)) < 0)
+	    {
+	      DEBUG_puts("1ippWriteIO: Could not write IPP attribute...");
+	      _cupsBufferRelease((char *)buffer);
+	      return (IPP_STATE_ERROR);
+	    }
+
+	    bufptr = buffer;
+	  }
+
           if (parent == NULL)
 	  {
-            buffer[0] = IPP_TAG_END;
-	    n         = 1;
+            *bufptr++ = IPP_TAG_END;
 	  }
 	  else
 	  {
-            buffer[0] = IPP_TAG_END_COLLECTION;
-	    buffer[1] = 0; /* empty name */
-	    buffer[2] = 0;
-	    buffer[3] = 0; /* empty value */
-	    buffer[4] = 0;
-	    n         = 5;
+            *bufptr++ = IPP_TAG_END_COLLECTION;
+	    *bufptr++ = 0; /* empty name */
+	    *bufptr++ = 0;
+	    *bufptr++ = 0; /* empty value */
+	    *bufptr++ = 0;
 	  }
 
-	  if ((*cb)(dst, buffer, (size_t)n) < 0)
+	  if ((*cb)(dst, buffer, (size_t)(bufptr - buffer)) < 0)
 	  {
 	    DEBUG_puts("1ippWriteIO: Could not write IPP end-tag...");
 	    _cupsBufferRelease((char *)buffer);
@@ -6200,8 +6401,19 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
   else
     alloc_values = (num_values + IPP_MAX_VALUES - 1) & ~(IPP_MAX_VALUES - 1);
 
-  attr = calloc(sizeof(ipp_attribute_t) +
-                (size_t)(alloc_values - 1) * sizeof(_ipp_value_t), 1);
+  if (ipp->arena)
+  {
+   /*
+    * Don't fall back on the heap for arena messages - ippCopyAttribute relies
+    * on non-arena attributes only holding pooled strings...
+    */
+
+    if ((attr = ipp_arena_alloc(ipp, sizeof(ipp_attribute_t) + (size_t)(alloc_values - 1) * sizeof(_ipp_value_t))) != NULL)
+      attr->arena = 1;
+  }
+  else
+    attr = calloc(sizeof(ipp_attribute_t) +
+                  (size_t)(alloc_values - 1) * sizeof(_ipp_value_t), 1);
 
   if (attr)
   {
@@ -6212,7 +6424,7 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
     DEBUG_printf(("4debug_alloc: %p %s %s%s (%d values)", (void *)attr, name, num_values > 1 ? "1setOf " : "", ippTagString(value_tag), num_values));
 
     if (name)
-      attr->name = _cupsStrAlloc(name);
+      attr->name = ipp_alloc_string(ipp, name);
 
     attr->group_tag  = group_tag;
     attr->value_tag  = value_tag;
@@ -6229,6 +6441,9 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
 
     ipp->prev = ipp->last;
     ipp->last = ipp->current = attr;
+
+    if (ipp->index && name && !ipp_add_index(ipp, attr, ipp->prev))
+      ipp_free_index(ipp);
   }
 
   DEBUG_printf(("5ipp_add_attr: Returning %p", (void *)attr));
@@ -6237,6 +6452,192 @@ ipp_add_attr(ipp_t      *ipp,		/* I - IPP message */
 }
 
 
+/*
+ * 'ipp_add_index()' - Add an attribute to the name index.
+ *
+ * Only the first attribute with a given name is indexed, so appending a later
+ * attribute with the same name leaves the index alone.
+ */
+
+static int				/* O - 1 on success, 0 if the index is full */
+ipp_add_index(ipp_t           *ipp,	/* I - IPP message */
+              ipp_attribute_t *attr,	/* I - Attribute */
+              ipp_attribute_t *prev)	/* I - Previous attribute in list */
+{
+  unsigned	bucket,			/* Current bucket */
+		mask;			/* Bucket mask */
+
+
+  if ((ipp->num_index + 1) * 2 > ipp->alloc_index)
+    return (0);
+
+  mask = (unsigned)ipp->alloc_index - 1;
+
+  for (bucket = ipp_hash_name(attr->name) & mask;
+       ipp->index[bucket].attr;
+       bucket = (bucket + 1) & mask)
+    if (!_cups_strcasecmp(ipp->index[bucket].attr->name, attr->name))
+      return (1);
+
+  ipp->index[bucket].attr = attr;
+  ipp->index[bucket].prev = prev;
+  ipp->num_index ++;
+
+  return (1);
+}
+
+
+/*
+ * 'ipp_alloc_string()' - Allocate a string for a message.
+ *
+ * Arena messages copy the string into the arena, avoiding the locking and
+ * lookup of the shared string pool.  _cupsStrFree ignores strings that are
+ * not in the pool, so arena strings can be freed like any other value.
+ */
+
+static char *				/* O - String or NULL */
+ipp_alloc_string(ipp_t      *ipp,	/* I - IPP message */
+                 const char *s)		/* I - String */
+{
+  char		*temp;			/* New string */
+  size_t	len;			/* Length of string */
+
+
+  if (ipp->arena)
+  {
+    len = strlen(s) + 1;
+
+    if ((temp = ipp_arena_alloc(ipp, len)) != NULL)
+    {
+      memcpy(temp, s, len);
+      return (temp);
+    }
+  }
+
+  return (_cupsStrAlloc(s));
+}
+
+
+/*
+ * 'ipp_arena_alloc()' - Allocate zeroed memory from a message arena.
+ */
+
+static void *				/* O - Memory or NULL */
+ipp_arena_alloc(ipp_t  *ipp,		/* I - IPP message */
+                size_t size)		/* I - Number of bytes */
+{
+  _ipp_arena_t	*arena = ipp->arena;	/* Current chunk */
+  void		*ptr;			/* Allocated memory */
+
+
+  size = (size + 15) & ~(size_t)15;
+
+  if (arena->size - arena->used < size)
+  {
+   /*
+    * Start a new chunk; chunks are calloc'd and never reused, so memory
+    * handed out from them is already zeroed...
+    */
+
+    size_t chunk = size > IPP_ARENA_SIZE ? size : IPP_ARENA_SIZE;
+					/* Size of new chunk */
+
+    if ((arena = calloc(1, sizeof(_ipp_arena_t) + 16 + chunk)) == NULL)
+      return (NULL);
+
+    arena->next = ipp->arena;
+    arena->size = chunk;
+    ipp->arena  = arena;
+  }
+
+  ptr = (char *)arena + ((sizeof(_ipp_arena_t) + 15) & ~(size_t)15) + arena->used;
+  arena->used += size;
+
+  return (ptr);
+}
+
+
+/*
+ * 'ipp_build_index()' - Build the attribute name index for a message.
+ *
+ * The index is built by ippFindAttribute once a lookup has to walk more than
+ * IPP_INDEX_MIN attributes, and is thrown away whenever attributes are
+ * deleted, renamed, or reallocated.
+ */
+
+static void
+ipp_build_index(ipp_t *ipp)		/* I - IPP message */
+{
+  int			count;		/* Number of attributes */
+  ipp_attribute_t	*attr,		/* Current attribute */
+			*prev;		/* Previous attribute */
+
+
+  ipp_free_index(ipp);
+
+  for (count = 0, attr = ipp->attrs; attr; attr = attr->next)
+    count ++;
+
+ /*
+  * Leave room for the message to double in size before the index fills up...
+  */
+
+  for (ipp->alloc_index = 64; ipp->alloc_index < 4 * count; ipp->alloc_index *= 2);
+
+  if ((ipp->index = calloc((size_t)ipp->alloc_index, sizeof(_ipp_index_t))) == NULL)
+  {
+    ipp->alloc_index = 0;
+    return;
+  }
+
+  for (prev = NULL, attr = ipp->attrs; attr; prev = attr, attr = attr->next)
+    if (attr->name)
+      ipp_add_index(ipp, attr, prev);
+}
+
+
+/*
+ * 'ipp_find_index()' - Find the first attribute with a name in the index.
+ */
+
+static _ipp_index_t *			/* O - Index entry or NULL */
+ipp_find_index(ipp_t      *ipp,		/* I - IPP message */
+               const char *name)	/* I - Attribute name */
+{
+  unsigned	bucket,			/* Current bucket */
+		mask;			/* Bucket mask */
+
+
+  mask = (unsigned)ipp->alloc_index - 1;
+
+  for (bucket = ipp_hash_name(name) & mask;
+       ipp->index[bucket].attr;
+       bucket = (bucket + 1) & mask)
+    if (!_cups_strcasecmp(ipp->index[bucket].attr->name, name))
+      return (ipp->index + bucket);
+
+  return (NULL);
+}
+
+
+/*
+ * 'ipp_free_index()' - Free the attribute name index for a message.
+ */
+
+static void
+ipp_free_index(ipp_t *ipp)		/* I - IPP message */
+{
+  if (ipp->index)
+  {
+    free(ipp->index);
+
+    ipp->index       = NULL;
+    ipp->num_index   = 0;
+    ipp->alloc_index = 0;
+  }
+}
+
+
 /*
  * 'ipp_free_values()' - Free attribute values.
  */
@@ -6379,6 +6780,104 @@ ipp_get_code(const char *value,		/* I - Locale/charset string */
 }
 
 
+/*
+ * 'ipp_hash_name()' - Compute the case-insensitive hash of an attribute name.
+ */
+
+static unsigned				/* O - Hash value */
+ipp_hash_name(const char *name)		/* I - Attribute name */
+{
+  unsigned	hash;			/* Hash value */
+
+
+  for (hash = 2166136261U; *name; name ++)
+    hash = (hash ^ (unsigned)_cups_tolower(*name)) * 16777619U;
+
+  return (hash);
+}
+
+
+/*
+ * 'ipp_init_validate()' - Initialize the character classes and regular
+ *                         expressions used by ippValidateAttribute.
+ */
+
+static void
+ipp_init_validate(void)
+{
+  int	ch;				/* Current character */
+
+
+  _cupsMutexLock(&ipp_validate_mutex);
+
+  if (!ipp_validate_init)
+  {
+    for (ch = 0; ch < 256; ch ++)
+    {
+      int	lower = ch >= 'a' && ch <= 'z',
+		upper = ch >= 'A' && ch <= 'Z',
+		digit = ch >= '0' && ch <= '9';
+
+      if (lower || upper || digit || ch == '-' || ch == '.' || ch == '_')
+        ipp_validate_chars[ch] |= IPP_CHAR_KEYWORD;
+      if (lower || digit || ch == '+' || ch == '-' || ch == '.')
+        ipp_validate_chars[ch] |= IPP_CHAR_SCHEME;
+      if (ch > ' ' && ch < 0x7f && !upper)
+        ipp_validate_chars[ch] |= IPP_CHAR_CHARSET;
+      if (lower || digit || ch == '-')
+        ipp_validate_chars[ch] |= IPP_CHAR_LANGUAGE;
+      if (lower || upper || digit || (ch && strchr("-!#$&.+^_", ch)))
+        ipp_validate_chars[ch] |= IPP_CHAR_MIMETYPE;
+      if (lower)
+        ipp_validate_chars[ch] |= IPP_CHAR_LOWER;
+    }
+
+   /*
+    * The following regular expression is derived from the ABNF for
+    * language tags in RFC 4646.  All I can say is that this is the
+    * easiest way to check the values...
+    */
+
+    ipp_language_status = regcomp(&ipp_language_re,
+				  "^("
+				  "(([a-z]{2,3}(-[a-z][a-z][a-z]){0,3})|[a-z]{4,8})"
+									/* language */
+				  "(-[a-z][a-z][a-z][a-z]){0,1}"	/* script */
+				  "(-([a-z][a-z]|[0-9][0-9][0-9])){0,1}"/* region */
+				  "(-([a-z]{5,8}|[0-9][0-9][0-9]))*"	/* variant */
+				  "(-[a-wy-z](-[a-z0-9]{2,8})+)*"	/* extension */
+				  "(-x(-[a-z0-9]{1,8})+)*"		/* privateuse */
+				  "|"
+				  "x(-[a-z0-9]{1,8})+"			/* privateuse */
+				  "|"
+				  "[a-z]{1,3}(-[a-z][0-9]{2,8}){1,2}"	/* grandfathered */
+				  ")$",
+				  REG_NOSUB | REG_EXTENDED);
+
+   /*
+    * The following regular expression is derived from the ABNF for
+    * MIME media types in RFC 2045 and 4288.  All I can say is that this is
+    * the easiest way to check the values...
+    */
+
+    ipp_mimetype_status = regcomp(&ipp_mimetype_re,
+				  "^"
+				  "[-a-zA-Z0-9!#$&.+^_]{1,127}"		/* type-name */
+				  "/"
+				  "[-a-zA-Z0-9!#$&.+^_]{1,127}"		/* subtype-name */
+				  "(;[-a-zA-Z0-9!#$&.+^_]{1,127}="	/* parameter= */
+				  "([-a-zA-Z0-9!#$&.+^_]{1,127}|\"[^\"]*\"))*"
+									/* value */
+				  "$",
+				  REG_NOSUB | REG_EXTENDED);
+
+    ipp_validate_init = 1;
+  }
+
+  _cupsMutexUnlock(&ipp_validate_mutex);
+}
+
+
 /*
  * 'ipp_lang_code()' - Convert a C locale name into an IPP language code.
  *
@@ -6709,7 +7208,8 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
   ipp_attribute_t	*temp,		/* New attribute pointer */
 			*current,	/* Current attribute in list */
 			*prev;		/* Previous attribute in list */
-  int			alloc_values;	/* Allocated values */
+  int			alloc_values,	/* Allocated values */
+			old_values;	/* Previously allocated values */
 
 
  /*
@@ -6737,6 +7237,8 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
   * values when num_values > 1.
   */
 
+  old_values = alloc_values;
+
   if (alloc_values < IPP_MAX_VALUES)
     alloc_values = IPP_MAX_VALUES;
   else
@@ -6749,7 +7251,20 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
   * Reallocate memory...
   */
 
-  if ((temp = realloc(temp, sizeof(ipp_attribute_t) + (size_t)(alloc_values - 1) * sizeof(_ipp_value_t))) == NULL)
+  if (temp->arena)
+  {
+   /*
+    * Arena attributes cannot be resized in place, copy to a larger block and
+    * let the old one go with the arena...
+    */
+
+    if ((temp = ipp_arena_alloc(ipp, sizeof(ipp_attribute_t) + (size_t)(alloc_values - 1) * sizeof(_ipp_value_t))) != NULL)
+      memcpy(temp, *attr, sizeof(ipp_attribute_t) + (size_t)(old_values - 1) * sizeof(_ipp_value_t));
+  }
+  else
+    temp = realloc(temp, sizeof(ipp_attribute_t) + (size_t)(alloc_values - 1) * sizeof(_ipp_value_t));
+
+  if (!temp)
   {
     _cupsSetHTTPError(HTTP_STATUS_ERROR);
     DEBUG_puts("4ipp_set_value: Unable to resize attribute.");
@@ -6773,6 +7288,8 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
 #endif /* !__clang_analyzer__ */
     DEBUG_printf(("4debug_alloc: %p %s %s%s (%d)", (void *)temp, temp->name, temp->num_values > 1 ? "1setOf " : "", ippTagString(temp->value_tag), temp->num_values));
 
+    ipp_free_index(ipp);
+
     if (ipp->current == *attr && ipp->prev)
     {
      /*
@@ -6830,6 +7347,33 @@ ipp_set_value(ipp_t           *ipp,	/* IO - IPP message */
 }
 
 
+/*
+ * 'ipp_span()' - Return the number of leading characters in a class.
+ */
+
+static size_t				/* O - Length of span */
+ipp_span(const char *s,			/* I - String */
+         int        chars)		/* I - Character class bits */
+{
+  const unsigned char	*ptr = (const unsigned char *)s;
+					/* Pointer into string */
+
+
+ /*
+  * Check 4 characters per iteration - the nul character is in no class, so
+  * we never look past the end of the string...
+  */
+
+  while ((ipp_validate_chars[ptr[0]] & chars) && (ipp_validate_chars[ptr[1]] & chars) && (ipp_validate_chars[ptr[2]] & chars) && (ipp_validate_chars[ptr[3]] & chars))
+    ptr += 4;
+
+  while (ipp_validate_chars[*ptr] & chars)
+    ptr ++;
+
+  return ((size_t)(ptr - (const unsigned char *)s));
+}
+
+
 /*
  * 'ipp_write_file()' - Write IPP data to a file.
  */
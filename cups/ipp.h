@@ -363,7 +363,8 @@ typedef enum ipp_op_e			/**** IPP operations ****/
   IPP_OP_CUPS_AUTHENTICATE_JOB,		/* CUPS-Authenticate-Job: Authenticate a job @since CUPS 1.2/macOS 10.5@ */
   IPP_OP_CUPS_GET_PPD,			/* CUPS-Get-PPD: Get a PPD file @deprecated@ */
   IPP_OP_CUPS_GET_DOCUMENT = 0x4027,	/* CUPS-Get-Document: Get a document file @since CUPS 1.4/macOS 10.6@ */
-  IPP_OP_CUPS_CREATE_LOCAL_PRINTER	/* CUPS-Create-Local-Printer: Create a local (temporary) printer @since CUPS 2.2@ */
+  IPP_OP_CUPS_CREATE_LOCAL_PRINTER,	/* CUPS-Create-Local-Printer: Create a local (temporary) printer @since CUPS 2.2@ */
+  IPP_OP_CUPS_GET_STATISTICS		/* CUPS-Get-Statistics: Get scheduler memory statistics @since CUPS 2.3.4@ */
 
 #  ifndef _CUPS_NO_DEPRECATED
 #    define IPP_PRINT_JOB			IPP_OP_PRINT_JOB
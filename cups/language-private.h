@@ -42,6 +42,7 @@ extern "C" {
 #  define _CUPS_MESSAGE_UNQUOTE	1	/* Unescape \foo in strings? */
 #  define _CUPS_MESSAGE_STRINGS	2	/* Message file is in Apple .strings format */
 #  define _CUPS_MESSAGE_EMPTY	4	/* Allow empty localized strings */
+#  define _CUPS_MESSAGE_CATALOG	8	/* Message file is a compiled catalog */
 
 
 /*
@@ -76,6 +77,8 @@ extern const char	*_cupsMessageLookup(cups_array_t *a, const char *m) _CUPS_PRIV
 extern cups_array_t	*_cupsMessageNew(void *context) _CUPS_PRIVATE;
 extern int		_cupsMessageSave(const char *filename, int flags, cups_array_t *a) _CUPS_PRIVATE;
 extern void		_cupsSetLocale(char *argv[]) _CUPS_PRIVATE;
+extern size_t		_cupsUTF8ASCIILength(const cups_utf8_t *s, size_t slen) _CUPS_PRIVATE;
+extern size_t		_cupsUTF8PrintableLength(const cups_utf8_t *s, size_t slen) _CUPS_PRIVATE;
 
 
 #  ifdef __cplusplus
@@ -21,6 +21,12 @@
 #else
 #  include <unistd.h>
 #endif /* _WIN32 */
+#include <fcntl.h>
+#include <sys/stat.h>
+#if !defined(_WIN32) && !(defined(__APPLE__) && defined(CUPS_BUNDLEDIR))
+#  include <sys/mman.h>
+#  define CUPS_CATALOG_MMAP 1		/* Compiled catalogs can be mapped */
+#endif /* !_WIN32 && !(__APPLE__ && CUPS_BUNDLEDIR) */
 #ifdef HAVE_COREFOUNDATION_H
 #  include <CoreFoundation/CoreFoundation.h>
 #endif /* HAVE_COREFOUNDATION_H */
@@ -126,6 +132,40 @@ static const _apple_language_locale_t apple_language_locale[] =
 #endif /* __APPLE__ */
 
 
+/*
+ * Compiled message catalogs...
+ *
+ * A compiled catalog (cups_ll.cat, written by po2cat) is a native byte order
+ * image that is mapped read-only and shared by every process using the
+ * language:
+ *
+ *     header    "CUPSCAT1", byte order word, entry count, bucket count,
+ *               reserved word
+ *     buckets   power-of-2 open addressing hash table of entry indices + 1
+ *               (0 = empty slot)
+ *     entries   hash, msgid offset, msgstr offset for each message, sorted
+ *               by msgid
+ *     strings   nul-terminated msgid and msgstr strings
+ *
+ * All words are 32-bit unsigned integers and all offsets are from the start
+ * of the file.
+ */
+
+#define CUPS_CATALOG_MAGIC	"CUPSCAT1"
+#define CUPS_CATALOG_ORDER	0x01020304
+#define CUPS_CATALOG_HEADER	24	/* Size of header */
+
+typedef struct _cups_catalog_s		/**** Mapped message catalog ****/
+{
+  char		*data;			/* Start of file */
+  size_t	datalen;		/* Length of file */
+  const unsigned *buckets;		/* Hash table */
+  unsigned	num_buckets;		/* Number of buckets */
+  const unsigned *entries;		/* Messages (3 words each) */
+  unsigned	num_entries;		/* Number of messages */
+} _cups_catalog_t;
+
+
 /*
  * Local functions...
  */
@@ -145,6 +185,12 @@ static cups_array_t	*appleMessageLoad(const char *locale) CF_RETURNS_RETAINED;
 #  endif /* CUPS_BUNDLEDIR */
 #endif /* __APPLE__ */
 static cups_lang_t	*cups_cache_lookup(const char *name, cups_encoding_t encoding);
+static unsigned		cups_catalog_hash(const char *s);
+#ifdef CUPS_CATALOG_MMAP
+static cups_array_t	*cups_catalog_load(const char *filename);
+static const char	*cups_catalog_lookup(_cups_catalog_t *cat, const char *m);
+#endif /* CUPS_CATALOG_MMAP */
+static int		cups_catalog_save(const char *filename, cups_array_t *a);
 static int		cups_message_compare(_cups_message_t *m1, _cups_message_t *m2);
 static void		cups_message_free(_cups_message_t *m);
 static void		cups_message_load(cups_lang_t *lang);
@@ -895,6 +941,20 @@ _cupsMessageFree(cups_array_t *a)	/* I - Message array */
 
   if (cupsArrayUserData(a))
     CFRelease((CFDictionaryRef)cupsArrayUserData(a));
+
+#elif defined(CUPS_CATALOG_MMAP)
+  _cups_catalog_t	*cat;		/* Compiled catalog */
+
+
+ /*
+  * Unmap the compiled catalog as needed...
+  */
+
+  if ((cat = (_cups_catalog_t *)cupsArrayUserData(a)) != NULL)
+  {
+    munmap(cat->data, cat->datalen);
+    free(cat);
+  }
 #endif /* __APPLE__ && CUPS_BUNDLEDIR */
 
  /*
@@ -907,6 +967,10 @@ _cupsMessageFree(cups_array_t *a)	/* I - Message array */
 
 /*
  * '_cupsMessageLoad()' - Load a .po or .strings file into a messages array.
+ *
+ * Compiled catalogs (@code _CUPS_MESSAGE_CATALOG@) are mapped into memory
+ * rather than loaded, and @code NULL@ is returned if the catalog cannot be
+ * used so the caller can fall back on the .po file.
  */
 
 cups_array_t *				/* O - New message array */
@@ -925,6 +989,15 @@ _cupsMessageLoad(const char *filename,	/* I - Message catalog to load */
 
   DEBUG_printf(("4_cupsMessageLoad(filename=\"%s\")", filename));
 
+  if (flags & _CUPS_MESSAGE_CATALOG)
+  {
+#ifdef CUPS_CATALOG_MMAP
+    return (cups_catalog_load(filename));
+#else
+    return (NULL);
+#endif /* CUPS_CATALOG_MMAP */
+  }
+
  /*
   * Create an array to hold the messages...
   */
@@ -1204,6 +1277,10 @@ _cupsMessageLookup(cups_array_t *a,	/* I - Message array */
     if (cfm)
       CFRelease(cfm);
   }
+
+#elif defined(CUPS_CATALOG_MMAP)
+  if (!match && cupsArrayUserData(a))
+    return (cups_catalog_lookup((_cups_catalog_t *)cupsArrayUserData(a), m));
 #endif /* __APPLE__ && CUPS_BUNDLEDIR */
 
   if (match && match->str)
@@ -1229,6 +1306,9 @@ _cupsMessageNew(void *context)		/* I - User data */
 
 /*
  * '_cupsMessageSave()' - Save a message catalog array.
+ *
+ * @code _CUPS_MESSAGE_CATALOG@ writes a compiled catalog for the current
+ * platform that can be mapped by @code _cupsMessageLoad@.
  */
 
 int					/* O - 0 on success, -1 on failure */
@@ -1244,6 +1324,9 @@ _cupsMessageSave(const char   *filename,/* I - Output filename */
   * Output message catalog file...
   */
 
+  if (flags & _CUPS_MESSAGE_CATALOG)
+    return (cups_catalog_save(filename, a));
+
   if ((fp = cupsFileOpen(filename, "w")) == NULL)
     return (-1);
 
@@ -1642,6 +1725,255 @@ cups_cache_lookup(
 }
 
 
+/*
+ * 'cups_catalog_hash()' - Compute the FNV-1a hash of a message.
+ */
+
+static unsigned				/* O - Hash value */
+cups_catalog_hash(const char *s)	/* I - Message */
+{
+  unsigned	hash = 2166136261U;	/* Hash value */
+
+
+  while (*s)
+  {
+    hash ^= (unsigned char)*s++;
+    hash *= 16777619U;
+  }
+
+  return (hash);
+}
+
+
+#ifdef CUPS_CATALOG_MMAP
+/*
+ * 'cups_catalog_load()' - Map a compiled message catalog.
+ */
+
+static cups_array_t *			/* O - Message array or `NULL` */
+cups_catalog_load(const char *filename)	/* I - Compiled catalog */
+{
+  int			fd;		/* File descriptor */
+  struct stat		fileinfo;	/* File information */
+  void			*data;		/* Mapped file */
+  size_t		datalen;	/* Length of file */
+  const unsigned	*header;	/* Header words */
+  _cups_catalog_t	*cat;		/* Compiled catalog */
+  cups_array_t		*a;		/* Message array */
+
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+  {
+    DEBUG_printf(("5cups_catalog_load: Unable to open \"%s\": %s", filename, strerror(errno)));
+    return (NULL);
+  }
+
+  if (fstat(fd, &fileinfo) || fileinfo.st_size < CUPS_CATALOG_HEADER || fileinfo.st_size > INT_MAX)
+  {
+    close(fd);
+    return (NULL);
+  }
+
+  datalen = (size_t)fileinfo.st_size;
+  data    = mmap(NULL, datalen, PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+  {
+    DEBUG_printf(("5cups_catalog_load: Unable to map \"%s\": %s", filename, strerror(errno)));
+    return (NULL);
+  }
+
+ /*
+  * Validate the header and table sizes; the string offsets are checked as
+  * they are used...
+  */
+
+  header = (const unsigned *)data + 2;
+
+  if (memcmp(data, CUPS_CATALOG_MAGIC, 8) || header[0] != CUPS_CATALOG_ORDER || header[1] > header[2] || header[2] == 0 || (header[2] & (header[2] - 1)) || header[2] > (INT_MAX / 16) || (CUPS_CATALOG_HEADER + 4 * (size_t)header[2] + 12 * (size_t)header[1]) > datalen || ((char *)data)[datalen - 1])
+  {
+    DEBUG_printf(("5cups_catalog_load: \"%s\" is not a usable catalog.", filename));
+    munmap(data, datalen);
+    return (NULL);
+  }
+
+  if ((cat = calloc(1, sizeof(_cups_catalog_t))) == NULL)
+  {
+    munmap(data, datalen);
+    return (NULL);
+  }
+
+  cat->data        = data;
+  cat->datalen     = datalen;
+  cat->num_entries = header[1];
+  cat->num_buckets = header[2];
+  cat->buckets     = (const unsigned *)((char *)data + CUPS_CATALOG_HEADER);
+  cat->entries     = cat->buckets + cat->num_buckets;
+
+  if ((a = _cupsMessageNew(cat)) == NULL)
+  {
+    munmap(data, datalen);
+    free(cat);
+    return (NULL);
+  }
+
+  DEBUG_printf(("5cups_catalog_load: Mapped %u messages from \"%s\".", cat->num_entries, filename));
+
+  return (a);
+}
+
+
+/*
+ * 'cups_catalog_lookup()' - Lookup a message in a compiled catalog.
+ */
+
+static const char *			/* O - Localized message */
+cups_catalog_lookup(
+    _cups_catalog_t *cat,		/* I - Compiled catalog */
+    const char      *m)			/* I - Message */
+{
+  unsigned		hash,		/* Hash of message */
+			bucket,		/* Current bucket */
+			count,		/* Buckets checked */
+			index;		/* Entry index + 1 */
+  const unsigned	*entry;		/* Current entry */
+
+
+  hash = cups_catalog_hash(m);
+
+  for (bucket = hash & (cat->num_buckets - 1), count = cat->num_buckets; count > 0; bucket = (bucket + 1) & (cat->num_buckets - 1), count --)
+  {
+    if ((index = cat->buckets[bucket]) == 0 || index > cat->num_entries)
+      break;
+
+    entry = cat->entries + 3 * (index - 1);
+
+    if (entry[0] == hash && entry[1] < cat->datalen && entry[2] < cat->datalen && !strcmp(cat->data + entry[1], m))
+      return (cat->data + entry[2]);
+  }
+
+  return (m);
+}
+#endif /* CUPS_CATALOG_MMAP */
+
+
+/*
+ * 'cups_catalog_save()' - Save a message array as a compiled catalog.
+ */
+
+static int				/* O - 0 on success, -1 on failure */
+cups_catalog_save(const char   *filename,/* I - Output filename */
+                  cups_array_t *a)	/* I - Message array */
+{
+  cups_file_t		*fp;		/* Output file */
+  _cups_message_t	*m;		/* Current message */
+  unsigned		header[4],	/* Header words */
+			*buckets,	/* Hash table */
+			*entries,	/* Messages */
+			*entry,		/* Current message */
+			num_entries,	/* Number of messages */
+			num_buckets,	/* Number of buckets */
+			bucket,		/* Current bucket */
+			offset;		/* Current string offset */
+  size_t		length;		/* Length of strings */
+  int			status = 0;	/* Return status */
+
+
+ /*
+  * Count the messages that have a translation...
+  */
+
+  for (m = (_cups_message_t *)cupsArrayFirst(a), num_entries = 0, length = 0; m; m = (_cups_message_t *)cupsArrayNext(a))
+  {
+    if (m->msg && m->str)
+    {
+      num_entries ++;
+      length += strlen(m->msg) + strlen(m->str) + 2;
+    }
+  }
+
+  for (num_buckets = 16; num_buckets < 2 * num_entries; num_buckets *= 2);
+
+  if (length > (INT_MAX / 2) || num_buckets > (INT_MAX / 16))
+    return (-1);
+
+  buckets = calloc(num_buckets, sizeof(unsigned));
+  entries = calloc(num_entries + 1, 3 * sizeof(unsigned));
+
+  if (!buckets || !entries)
+  {
+    free(buckets);
+    free(entries);
+    return (-1);
+  }
+
+ /*
+  * Build the entries and hash table; the array is already sorted...
+  */
+
+  offset = CUPS_CATALOG_HEADER + 4 * num_buckets + 12 * num_entries;
+
+  for (m = (_cups_message_t *)cupsArrayFirst(a), entry = entries; m; m = (_cups_message_t *)cupsArrayNext(a))
+  {
+    if (!m->msg || !m->str)
+      continue;
+
+    entry[0] = cups_catalog_hash(m->msg);
+    entry[1] = offset;
+    offset   += (unsigned)strlen(m->msg) + 1;
+    entry[2] = offset;
+    offset   += (unsigned)strlen(m->str) + 1;
+
+    for (bucket = entry[0] & (num_buckets - 1); buckets[bucket]; bucket = (bucket + 1) & (num_buckets - 1));
+
+    buckets[bucket] = (unsigned)((entry - entries) / 3) + 1;
+    entry += 3;
+  }
+
+ /*
+  * Write the file...
+  */
+
+  if ((fp = cupsFileOpen(filename, "w")) == NULL)
+  {
+    free(buckets);
+    free(entries);
+    return (-1);
+  }
+
+  header[0] = CUPS_CATALOG_ORDER;
+  header[1] = num_entries;
+  header[2] = num_buckets;
+  header[3] = 0;
+
+  if (cupsFileWrite(fp, CUPS_CATALOG_MAGIC, 8) < 0 || cupsFileWrite(fp, (char *)header, sizeof(header)) < 0 || cupsFileWrite(fp, (char *)buckets, 4 * num_buckets) < 0 || cupsFileWrite(fp, (char *)entries, 12 * num_entries) < 0)
+    status = -1;
+
+  for (m = (_cups_message_t *)cupsArrayFirst(a); m && !status; m = (_cups_message_t *)cupsArrayNext(a))
+  {
+    if (m->msg && m->str && (cupsFileWrite(fp, m->msg, strlen(m->msg) + 1) < 0 || cupsFileWrite(fp, m->str, strlen(m->str) + 1) < 0))
+      status = -1;
+  }
+
+ /*
+  * An empty catalog still needs a trailing nul...
+  */
+
+  if (!num_entries && !status && cupsFilePutChar(fp, 0) < 0)
+    status = -1;
+
+  if (cupsFileClose(fp))
+    status = -1;
+
+  free(buckets);
+  free(entries);
+
+  return (status);
+}
+
+
 /*
  * 'cups_message_compare()' - Compare two messages.
  */
@@ -1686,6 +2018,11 @@ cups_message_load(cups_lang_t *lang)	/* I - Language */
   char			filename[1024];	/* Filename for language locale file */
   _cups_globals_t	*cg = _cupsGlobals();
   					/* Pointer to library globals */
+#  ifdef CUPS_CATALOG_MMAP
+  char			catname[1024];	/* Compiled catalog filename */
+  struct stat		poinfo,		/* .po file information */
+			catinfo;	/* Compiled catalog information */
+#  endif /* CUPS_CATALOG_MMAP */
 
 
   snprintf(filename, sizeof(filename), "%s/%s/cups_%s.po", cg->localedir,
@@ -1717,6 +2054,17 @@ cups_message_load(cups_lang_t *lang)	/* I - Language */
   * Read the strings from the file...
   */
 
+#  ifdef CUPS_CATALOG_MMAP
+ /*
+  * Use the compiled catalog next to the .po file when it is up-to-date...
+  */
+
+  snprintf(catname, sizeof(catname), "%.*s.cat", (int)strlen(filename) - 3, filename);
+
+  if (!stat(catname, &catinfo) && (stat(filename, &poinfo) || catinfo.st_mtime >= poinfo.st_mtime) && (lang->strings = _cupsMessageLoad(catname, _CUPS_MESSAGE_CATALOG)) != NULL)
+    return;
+#  endif /* CUPS_CATALOG_MMAP */
+
   lang->strings = _cupsMessageLoad(filename, _CUPS_MESSAGE_UNQUOTE);
 #endif /* __APPLE__ && CUPS_BUNDLEDIR */
 }
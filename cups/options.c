@@ -15,6 +15,27 @@
 #include "debug-internal.h"
 
 
+/*
+ * Local types...
+ */
+
+typedef struct _cups_optstr_s		/**** Option string storage ****/
+{
+  struct _cups_optstr_s	*next;		/* Next (older) block */
+  size_t		used,		/* Bytes used */
+			size;		/* Size of block */
+  char			data[1];	/* Strings */
+} _cups_optstr_t;
+
+struct _cups_options_s			/**** Option container ****/
+{
+  int			num_options,	/* Number of options */
+			alloc_options;	/* Allocated options */
+  cups_option_t		*options;	/* Options, sorted by name */
+  _cups_optstr_t	*strings;	/* Name and value strings */
+};
+
+
 /*
  * Local functions...
  */
@@ -22,6 +43,12 @@
 static int	cups_compare_options(cups_option_t *a, cups_option_t *b);
 static int	cups_find_option(const char *name, int num_options,
 	                         cups_option_t *option, int prev, int *rdiff);
+static int	cups_options_add(cups_options_t *opts, const char *name,
+		                 const char *value, int copy);
+static char	*cups_options_strdup(cups_options_t *opts, const char *s);
+static int	cups_parse_options(char *arg, int num_options,
+		                   cups_option_t **options,
+		                   cups_options_t *opts);
 
 
 /*
@@ -246,220 +273,233 @@ cupsGetOption(const char    *name,	/* I - Name of option */
 
 
 /*
- * 'cupsParseOptions()' - Parse options from a command-line argument.
+ * 'cupsOptionsAdd()' - Add an option to a container.
  *
- * This function converts space-delimited name/value pairs according
- * to the PAPI text option ABNF specification. Collection values
- * ("name={a=... b=... c=...}") are stored with the curley brackets
- * intact - use @code cupsParseOptions@ on the value to extract the
- * collection attributes.
+ * The name and value strings are copied to the container.  Any existing value
+ * for the named option is replaced.
+ *
+ * @since CUPS 2.4@
  */
 
-int					/* O - Number of options found */
-cupsParseOptions(
-    const char    *arg,			/* I - Argument to parse */
-    int           num_options,		/* I - Number of options */
-    cups_option_t **options)		/* O - Options found */
+int					/* O - 1 on success, 0 on error */
+cupsOptionsAdd(cups_options_t *opts,	/* I - Option container */
+               const char     *name,	/* I - Name of option */
+               const char     *value)	/* I - Value of option */
 {
-  char	*copyarg,			/* Copy of input string */
-	*ptr,				/* Pointer into string */
-	*name,				/* Pointer to name */
-	*value,				/* Pointer to value */
-	sep,				/* Separator character */
-	quote;				/* Quote character */
+  DEBUG_printf(("2cupsOptionsAdd(opts=%p, name=\"%s\", value=\"%s\")", (void *)opts, name, value));
 
+  if (!opts || !name || !name[0] || !value)
+    return (0);
 
-  DEBUG_printf(("cupsParseOptions(arg=\"%s\", num_options=%d, options=%p)", arg, num_options, (void *)options));
+  return (cups_options_add(opts, name, value, 1));
+}
 
- /*
-  * Range check input...
-  */
 
-  if (!arg)
-  {
-    DEBUG_printf(("1cupsParseOptions: Returning %d", num_options));
-    return (num_options);
-  }
+/*
+ * 'cupsOptionsCount()' - Get the number of options in a container.
+ *
+ * @since CUPS 2.4@
+ */
 
-  if (!options || num_options < 0)
-  {
-    DEBUG_puts("1cupsParseOptions: Returning 0");
-    return (0);
-  }
+int					/* O - Number of options */
+cupsOptionsCount(cups_options_t *opts)	/* I - Option container */
+{
+  return (opts ? opts->num_options : 0);
+}
 
- /*
-  * Make a copy of the argument string and then divide it up...
-  */
 
-  if ((copyarg = strdup(arg)) == NULL)
+/*
+ * 'cupsOptionsDelete()' - Free all memory used by an option container.
+ *
+ * @since CUPS 2.4@
+ */
+
+void
+cupsOptionsDelete(cups_options_t *opts)	/* I - Option container */
+{
+  _cups_optstr_t	*strings,	/* Current string storage */
+			*next;		/* Next string storage */
+
+
+  if (!opts)
+    return;
+
+  for (strings = opts->strings; strings; strings = next)
   {
-    DEBUG_puts("1cupsParseOptions: Unable to copy arg string");
-    DEBUG_printf(("1cupsParseOptions: Returning %d", num_options));
-    return (num_options);
+    next = strings->next;
+    free(strings);
   }
 
-  if (*copyarg == '{')
-  {
-   /*
-    * Remove surrounding {} so we can parse "{name=value ... name=value}"...
-    */
+  free(opts->options);
+  free(opts);
+}
 
-    if ((ptr = copyarg + strlen(copyarg) - 1) > copyarg && *ptr == '}')
-    {
-      *ptr = '\0';
-      ptr  = copyarg + 1;
-    }
-    else
-      ptr = copyarg;
-  }
-  else
-    ptr = copyarg;
 
- /*
-  * Skip leading spaces...
-  */
+/*
+ * 'cupsOptionsGet()' - Get an option value from a container.
+ *
+ * @since CUPS 2.4@
+ */
 
-  while (_cups_isspace(*ptr))
-    ptr ++;
+const char *				/* O - Option value or @code NULL@ */
+cupsOptionsGet(cups_options_t *opts,	/* I - Option container */
+               const char     *name)	/* I - Name of option */
+{
+  if (!opts)
+    return (NULL);
 
- /*
-  * Loop through the string...
-  */
+  return (cupsGetOption(name, opts->num_options, opts->options));
+}
 
-  while (*ptr != '\0')
-  {
-   /*
-    * Get the name up to a SPACE, =, or end-of-string...
-    */
 
-    name = ptr;
-    while (!strchr("\f\n\r\t\v =", *ptr) && *ptr)
-      ptr ++;
+/*
+ * 'cupsOptionsGetArray()' - Get the options in a container as an array.
+ *
+ * The returned array contains @link cupsOptionsCount@ options and can be
+ * passed to functions such as @link cupsGetOption@ and
+ * @link cupsEncodeOptions2@.  It is owned by the container and is valid until
+ * the container is changed or deleted - do not free it with
+ * @link cupsFreeOptions@.
+ *
+ * @since CUPS 2.4@
+ */
 
-   /*
-    * Avoid an empty name...
-    */
+cups_option_t *				/* O - Options or @code NULL@ if none */
+cupsOptionsGetArray(
+    cups_options_t *opts)		/* I - Option container */
+{
+  return (opts ? opts->options : NULL);
+}
 
-    if (ptr == name)
-      break;
 
-   /*
-    * Skip trailing spaces...
-    */
+/*
+ * 'cupsOptionsNew()' - Create a new option container.
+ *
+ * Option containers hold the same sorted name/value pairs as an option array
+ * but grow geometrically and keep all of their strings in a few large blocks,
+ * so building, parsing, and freeing large sets of options is much cheaper
+ * than with @link cupsAddOption@ and @link cupsParseOptions@.
+ *
+ * @since CUPS 2.4@
+ */
 
-    while (_cups_isspace(*ptr))
-      *ptr++ = '\0';
+cups_options_t *			/* O - New option container or @code NULL@ on error */
+cupsOptionsNew(void)
+{
+  return ((cups_options_t *)calloc(1, sizeof(cups_options_t)));
+}
 
-    if ((sep = *ptr) == '=')
-      *ptr++ = '\0';
 
-    DEBUG_printf(("2cupsParseOptions: name=\"%s\"", name));
+/*
+ * 'cupsOptionsParse()' - Parse options from a command-line argument into a
+ *                        container.
+ *
+ * The argument uses the same syntax as @link cupsParseOptions@ and is copied
+ * once to the container's string storage.
+ *
+ * @since CUPS 2.4@
+ */
+
+int					/* O - Number of options in container */
+cupsOptionsParse(cups_options_t *opts,	/* I - Option container */
+                 const char     *arg)	/* I - Argument to parse */
+{
+  char	*copyarg;			/* Copy of argument */
 
-    if (sep != '=')
-    {
-     /*
-      * Boolean option...
-      */
 
-      if (!_cups_strncasecmp(name, "no", 2))
-        num_options = cupsAddOption(name + 2, "false", num_options,
-	                            options);
-      else
-        num_options = cupsAddOption(name, "true", num_options, options);
+  DEBUG_printf(("cupsOptionsParse(opts=%p, arg=\"%s\")", (void *)opts, arg));
 
-      continue;
-    }
+  if (!opts)
+    return (0);
 
-   /*
-    * Remove = and parse the value...
-    */
+  if (!arg || (copyarg = cups_options_strdup(opts, arg)) == NULL)
+    return (opts->num_options);
 
-    value = ptr;
+  return (cups_parse_options(copyarg, 0, NULL, opts));
+}
 
-    while (*ptr && !_cups_isspace(*ptr))
-    {
-      if (*ptr == ',')
-        ptr ++;
-      else if (*ptr == '\'' || *ptr == '\"')
-      {
-       /*
-	* Quoted string constant...
-	*/
 
-	quote = *ptr;
-	_cups_strcpy(ptr, ptr + 1);
+/*
+ * 'cupsOptionsRemove()' - Remove an option from a container.
+ *
+ * @since CUPS 2.4@
+ */
 
-	while (*ptr != quote && *ptr)
-	{
-	  if (*ptr == '\\' && ptr[1])
-	    _cups_strcpy(ptr, ptr + 1);
+int					/* O - 1 if removed, 0 if not found */
+cupsOptionsRemove(cups_options_t *opts,	/* I - Option container */
+                  const char     *name)	/* I - Name of option */
+{
+  int	match,				/* Matching index */
+	diff;				/* Result of search */
 
-	  ptr ++;
-	}
 
-	if (*ptr)
-	  _cups_strcpy(ptr, ptr + 1);
-      }
-      else if (*ptr == '{')
-      {
-       /*
-	* Collection value...
-	*/
+  if (!opts || !name || opts->num_options == 0)
+    return (0);
 
-	int depth;
+  match = cups_find_option(name, opts->num_options, opts->options, -1, &diff);
 
-	for (depth = 0; *ptr; ptr ++)
-	{
-	  if (*ptr == '{')
-	    depth ++;
-	  else if (*ptr == '}')
-	  {
-	    depth --;
-	    if (!depth)
-	    {
-	      ptr ++;
-	      break;
-	    }
-	  }
-	  else if (*ptr == '\\' && ptr[1])
-	    _cups_strcpy(ptr, ptr + 1);
-	}
-      }
-      else
-      {
-       /*
-	* Normal space-delimited string...
-	*/
+  if (diff)
+    return (0);
 
-	while (*ptr && !_cups_isspace(*ptr))
-	{
-	  if (*ptr == '\\' && ptr[1])
-	    _cups_strcpy(ptr, ptr + 1);
+  opts->num_options --;
 
-	  ptr ++;
-	}
-      }
-    }
+  if (match < opts->num_options)
+    memmove(opts->options + match, opts->options + match + 1, (size_t)(opts->num_options - match) * sizeof(cups_option_t));
 
-    if (*ptr != '\0')
-      *ptr++ = '\0';
+  return (1);
+}
 
-    DEBUG_printf(("2cupsParseOptions: value=\"%s\"", value));
 
-   /*
-    * Skip trailing whitespace...
-    */
+/*
+ * 'cupsParseOptions()' - Parse options from a command-line argument.
+ *
+ * This function converts space-delimited name/value pairs according
+ * to the PAPI text option ABNF specification. Collection values
+ * ("name={a=... b=... c=...}") are stored with the curley brackets
+ * intact - use @code cupsParseOptions@ on the value to extract the
+ * collection attributes.
+ */
 
-    while (_cups_isspace(*ptr))
-      ptr ++;
+int					/* O - Number of options found */
+cupsParseOptions(
+    const char    *arg,			/* I - Argument to parse */
+    int           num_options,		/* I - Number of options */
+    cups_option_t **options)		/* O - Options found */
+{
+  char	*copyarg;			/* Copy of input string */
 
-   /*
-    * Add the string value...
-    */
 
-    num_options = cupsAddOption(name, value, num_options, options);
+  DEBUG_printf(("cupsParseOptions(arg=\"%s\", num_options=%d, options=%p)", arg, num_options, (void *)options));
+
+ /*
+  * Range check input...
+  */
+
+  if (!arg)
+  {
+    DEBUG_printf(("1cupsParseOptions: Returning %d", num_options));
+    return (num_options);
+  }
+
+  if (!options || num_options < 0)
+  {
+    DEBUG_puts("1cupsParseOptions: Returning 0");
+    return (0);
+  }
+
+ /*
+  * Make a copy of the argument string and then divide it up...
+  */
+
+  if ((copyarg = strdup(arg)) == NULL)
+  {
+    DEBUG_puts("1cupsParseOptions: Unable to copy arg string");
+    DEBUG_printf(("1cupsParseOptions: Returning %d", num_options));
+    return (num_options);
   }
 
+  num_options = cups_parse_options(copyarg, num_options, options, NULL);
+
  /*
   * Free the copy of the argument we made and return the number of options
   * found.
@@ -739,3 +779,325 @@ cups_find_option(
 
   return (current);
 }
+
+
+/*
+ * 'cups_options_add()' - Add an option to a container.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+cups_options_add(cups_options_t *opts,	/* I - Option container */
+                 const char     *name,	/* I - Name of option */
+                 const char     *value,	/* I - Value of option */
+                 int            copy)	/* I - Copy the name and value strings? */
+{
+  cups_option_t	*temp;			/* Pointer to new option */
+  int		insert,			/* Insertion point */
+		diff;			/* Result of search */
+
+
+  if (!_cups_strcasecmp(name, "cupsPrintQuality"))
+    cupsOptionsRemove(opts, "print-quality");
+  else if (!_cups_strcasecmp(name, "print-quality"))
+    cupsOptionsRemove(opts, "cupsPrintQuality");
+
+ /*
+  * Look for an existing option with the same name...
+  */
+
+  if (opts->num_options == 0)
+  {
+    insert = 0;
+    diff   = 1;
+  }
+  else
+  {
+    insert = cups_find_option(name, opts->num_options, opts->options, opts->num_options - 1, &diff);
+
+    if (diff > 0)
+      insert ++;
+  }
+
+  if (copy && (value = cups_options_strdup(opts, value)) == NULL)
+    return (0);
+
+  if (diff)
+  {
+   /*
+    * No matching option name, grow the array as needed...
+    */
+
+    if (copy && (name = cups_options_strdup(opts, name)) == NULL)
+      return (0);
+
+    if (opts->num_options >= opts->alloc_options)
+    {
+      int alloc_options = opts->alloc_options ? 2 * opts->alloc_options : 16;
+					/* New size of array */
+
+      if ((temp = realloc(opts->options, (size_t)alloc_options * sizeof(cups_option_t))) == NULL)
+        return (0);
+
+      opts->options       = temp;
+      opts->alloc_options = alloc_options;
+    }
+
+    temp = opts->options + insert;
+
+    if (insert < opts->num_options)
+      memmove(temp + 1, temp, (size_t)(opts->num_options - insert) * sizeof(cups_option_t));
+
+    temp->name = (char *)name;
+    opts->num_options ++;
+  }
+  else
+    temp = opts->options + insert;
+
+  temp->value = (char *)value;
+
+  return (1);
+}
+
+
+/*
+ * 'cups_options_strdup()' - Copy a string to the container's string storage.
+ */
+
+static char *				/* O - Copy of string or @code NULL@ on error */
+cups_options_strdup(
+    cups_options_t *opts,		/* I - Option container */
+    const char     *s)			/* I - String to copy */
+{
+  size_t	len = strlen(s) + 1;	/* Length of string with nul */
+  _cups_optstr_t *strings = opts->strings;
+					/* Current string storage */
+  char		*copy;			/* Copy of string */
+
+
+  if (!strings || (strings->used + len) > strings->size)
+  {
+   /*
+    * Add another block that is twice as big as the last one...
+    */
+
+    size_t size = strings ? 2 * strings->size : 1024;
+					/* Size of new block */
+
+    if (size < len)
+      size = len;
+
+    if ((strings = malloc(sizeof(_cups_optstr_t) + size)) == NULL)
+      return (NULL);
+
+    strings->next = opts->strings;
+    strings->used = 0;
+    strings->size = size;
+    opts->strings = strings;
+  }
+
+  copy = strings->data + strings->used;
+  strings->used += len;
+
+  memcpy(copy, s, len);
+
+  return (copy);
+}
+
+
+/*
+ * 'cups_parse_options()' - Parse options from a command-line argument.
+ *
+ * The argument is modified in place.  Options are added to the container when
+ * "opts" is not @code NULL@, pointing into the argument, otherwise they are
+ * copied to the "options" array.
+ */
+
+static int				/* O - Number of options */
+cups_parse_options(
+    char           *arg,		/* I - Argument to parse */
+    int            num_options,		/* I - Number of options */
+    cups_option_t  **options,		/* IO - Options */
+    cups_options_t *opts)		/* I - Option container or @code NULL@ */
+{
+  char	*copyarg = arg,			/* Argument string */
+	*ptr,				/* Pointer into string */
+	*name,				/* Pointer to name */
+	*value,				/* Pointer to value */
+	sep,				/* Separator character */
+	quote;				/* Quote character */
+
+
+  if (*copyarg == '{')
+  {
+   /*
+    * Remove surrounding {} so we can parse "{name=value ... name=value}"...
+    */
+
+    if ((ptr = copyarg + strlen(copyarg) - 1) > copyarg && *ptr == '}')
+    {
+      *ptr = '\0';
+      ptr  = copyarg + 1;
+    }
+    else
+      ptr = copyarg;
+  }
+  else
+    ptr = copyarg;
+
+ /*
+  * Skip leading spaces...
+  */
+
+  while (_cups_isspace(*ptr))
+    ptr ++;
+
+ /*
+  * Loop through the string...
+  */
+
+  while (*ptr != '\0')
+  {
+   /*
+    * Get the name up to a SPACE, =, or end-of-string...
+    */
+
+    name = ptr;
+    while (!strchr("\f\n\r\t\v =", *ptr) && *ptr)
+      ptr ++;
+
+   /*
+    * Avoid an empty name...
+    */
+
+    if (ptr == name)
+      break;
+
+   /*
+    * Skip trailing spaces...
+    */
+
+    while (_cups_isspace(*ptr))
+      *ptr++ = '\0';
+
+    if ((sep = *ptr) == '=')
+      *ptr++ = '\0';
+
+    DEBUG_printf(("9cups_parse_options: name=\"%s\"", name));
+
+    if (sep != '=')
+    {
+     /*
+      * Boolean option...
+      */
+
+      if (opts)
+      {
+        if (!_cups_strncasecmp(name, "no", 2))
+          cups_options_add(opts, name + 2, "false", 0);
+        else
+          cups_options_add(opts, name, "true", 0);
+      }
+      else if (!_cups_strncasecmp(name, "no", 2))
+        num_options = cupsAddOption(name + 2, "false", num_options,
+	                            options);
+      else
+        num_options = cupsAddOption(name, "true", num_options, options);
+
+      continue;
+    }
+
+   /*
+    * Remove = and parse the value...
+    */
+
+    value = ptr;
+
+    while (*ptr && !_cups_isspace(*ptr))
+    {
+      if (*ptr == ',')
+        ptr ++;
+      else if (*ptr == '\'' || *ptr == '\"')
+      {
+       /*
+	* Quoted string constant...
+	*/
+
+	quote = *ptr;
+	_cups_strcpy(ptr, ptr + 1);
+
+	while (*ptr != quote && *ptr)
+	{
+	  if (*ptr == '\\' && ptr[1])
+	    _cups_strcpy(ptr, ptr + 1);
+
+	  ptr ++;
+	}
+
+	if (*ptr)
+	  _cups_strcpy(ptr, ptr + 1);
+      }
+      else if (*ptr == '{')
+      {
+       /*
+	* Collection value...
+	*/
+
+	int depth;
+
+	for (depth = 0; *ptr; ptr ++)
+	{
+	  if (*ptr == '{')
+	    depth ++;
+	  else if (*ptr == '}')
+	  {
+	    depth --;
+	    if (!depth)
+	    {
+	      ptr ++;
+	      break;
+	    }
+	  }
+	  else if (*ptr == '\\' && ptr[1])
+	    _cups_strcpy(ptr, ptr + 1);
+	}
+      }
+      else
+      {
+       /*
+	* Normal space-delimited string...
+	*/
+
+	while (*ptr && !_cups_isspace(*ptr))
+	{
+	  if (*ptr == '\\' && ptr[1])
+	    _cups_strcpy(ptr, ptr + 1);
+
+	  ptr ++;
+	}
+      }
+    }
+
+    if (*ptr != '\0')
+      *ptr++ = '\0';
+
+    DEBUG_printf(("9cups_parse_options: value=\"%s\"", value));
+
+   /*
+    * Skip trailing whitespace...
+    */
+
+    while (_cups_isspace(*ptr))
+      ptr ++;
+
+   /*
+    * Add the string value...
+    */
+
+    if (opts)
+      cups_options_add(opts, name, value, 0);
+    else
+      num_options = cupsAddOption(name, value, num_options, options);
+  }
+
+  return (opts ? opts->num_options : num_options);
+}
@@ -32,15 +32,39 @@ static int	cups_get_url(http_t **http, const char *url, char *name, size_t names
 static void	pwg_add_finishing(cups_array_t *finishings, ipp_finishings_t template, const char *name, const char *value);
 static void	pwg_add_message(cups_array_t *a, const char *msg, const char *str);
 static int	pwg_compare_finishings(_pwg_finishings_t *a, _pwg_finishings_t *b);
+static int	pwg_compare_size_order(_ppd_size_order_t *a, _ppd_size_order_t *b);
 static int	pwg_compare_sizes(cups_size_t *a, cups_size_t *b);
 static cups_size_t *pwg_copy_size(cups_size_t *size);
+static int	pwg_find_name(_ppd_index_t *index, const void *elements, size_t elsize, int num_elements, const size_t *keys, int num_keys, const char *name);
 static void	pwg_free_finishings(_pwg_finishings_t *f);
+static unsigned	pwg_hash_name(const char *name);
+static int	pwg_next_ints(char **ptr, int *values, int num_values);
+static char	*pwg_next_word(char **ptr, size_t maxlen);
 static void	pwg_ppdize_name(const char *ipp, char *name, size_t namesize);
 static void	pwg_ppdize_resolution(ipp_attribute_t *attr, int element, int *xres, int *yres, char *name, size_t namesize);
 static void	pwg_unppdize_name(const char *ppd, char *name, size_t namesize,
 		                  const char *dashchars);
 
 
+/*
+ * Local globals...
+ */
+
+static const size_t	pwg_map_ppd[] =	/* Key for pwg_map_t PPD names */
+			{
+			  offsetof(pwg_map_t, ppd)
+			};
+static const size_t	pwg_map_pwg[] =	/* Key for pwg_map_t PWG names */
+			{
+			  offsetof(pwg_map_t, pwg)
+			};
+static const size_t	pwg_size_names[] =
+			{		/* Keys for pwg_size_t names */
+			  offsetof(pwg_size_t, map.ppd),
+			  offsetof(pwg_size_t, map.pwg)
+			};
+
+
 /*
  * '_cupsConvertOptions()' - Convert printer options to standard IPP attributes.
  *
@@ -425,6 +449,9 @@ _ppdCacheCreateWithFile(
   pwg_size_t	*size;			/* Current size */
   pwg_map_t	*map;			/* Current map */
   _pwg_finishings_t *finishings;	/* Current finishings option */
+  char		*pwg,			/* PWG keyword in line */
+		*ppd;			/* PPD keyword in line */
+  int		dims[6];		/* Size dimensions in line */
   int		linenum,		/* Current line number */
 		num_bins,		/* Number of bins in file */
 		num_sizes,		/* Number of sizes in file */
@@ -630,7 +657,10 @@ _ppdCacheCreateWithFile(
     }
     else if (!_cups_strcasecmp(line, "Bin"))
     {
-      if (sscanf(value, "%127s%40s", pwg_keyword, ppd_keyword) != 2)
+      valueptr = value;
+
+      if ((pwg = pwg_next_word(&valueptr, sizeof(pwg_keyword) - 1)) == NULL ||
+          (ppd = pwg_next_word(&valueptr, sizeof(ppd_keyword) - 1)) == NULL)
       {
         DEBUG_printf(("_ppdCacheCreateWithFile: Bad Bin on line %d.", linenum));
 	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("Bad PPD cache file."), 1);
@@ -646,8 +676,8 @@ _ppdCacheCreateWithFile(
       }
 
       map      = pc->bins + pc->num_bins;
-      map->pwg = strdup(pwg_keyword);
-      map->ppd = strdup(ppd_keyword);
+      map->pwg = strdup(pwg);
+      map->ppd = strdup(ppd);
 
       pc->num_bins ++;
     }
@@ -689,11 +719,12 @@ _ppdCacheCreateWithFile(
 	goto create_error;
       }
 
-      size = pc->sizes + pc->num_sizes;
+      size     = pc->sizes + pc->num_sizes;
+      valueptr = value;
 
-      if (sscanf(value, "%127s%40s%d%d%d%d%d%d", pwg_keyword, ppd_keyword,
-		 &(size->width), &(size->length), &(size->left),
-		 &(size->bottom), &(size->right), &(size->top)) != 8)
+      if ((pwg = pwg_next_word(&valueptr, sizeof(pwg_keyword) - 1)) == NULL ||
+          (ppd = pwg_next_word(&valueptr, sizeof(ppd_keyword) - 1)) == NULL ||
+          !pwg_next_ints(&valueptr, dims, 6))
       {
         DEBUG_printf(("_ppdCacheCreateWithFile: Bad Size on line %d.",
 	              linenum));
@@ -701,8 +732,14 @@ _ppdCacheCreateWithFile(
 	goto create_error;
       }
 
-      size->map.pwg = strdup(pwg_keyword);
-      size->map.ppd = strdup(ppd_keyword);
+      size->map.pwg = strdup(pwg);
+      size->map.ppd = strdup(ppd);
+      size->width   = dims[0];
+      size->length  = dims[1];
+      size->left    = dims[2];
+      size->bottom  = dims[3];
+      size->right   = dims[4];
+      size->top     = dims[5];
 
       pc->num_sizes ++;
     }
@@ -768,7 +805,10 @@ _ppdCacheCreateWithFile(
     }
     else if (!_cups_strcasecmp(line, "Source"))
     {
-      if (sscanf(value, "%127s%40s", pwg_keyword, ppd_keyword) != 2)
+      valueptr = value;
+
+      if ((pwg = pwg_next_word(&valueptr, sizeof(pwg_keyword) - 1)) == NULL ||
+          (ppd = pwg_next_word(&valueptr, sizeof(ppd_keyword) - 1)) == NULL)
       {
         DEBUG_printf(("_ppdCacheCreateWithFile: Bad Source on line %d.",
 	              linenum));
@@ -785,8 +825,8 @@ _ppdCacheCreateWithFile(
       }
 
       map      = pc->sources + pc->num_sources;
-      map->pwg = strdup(pwg_keyword);
-      map->ppd = strdup(ppd_keyword);
+      map->pwg = strdup(pwg);
+      map->ppd = strdup(ppd);
 
       pc->num_sources ++;
     }
@@ -817,7 +857,10 @@ _ppdCacheCreateWithFile(
     }
     else if (!_cups_strcasecmp(line, "Type"))
     {
-      if (sscanf(value, "%127s%40s", pwg_keyword, ppd_keyword) != 2)
+      valueptr = value;
+
+      if ((pwg = pwg_next_word(&valueptr, sizeof(pwg_keyword) - 1)) == NULL ||
+          (ppd = pwg_next_word(&valueptr, sizeof(ppd_keyword) - 1)) == NULL)
       {
         DEBUG_printf(("_ppdCacheCreateWithFile: Bad Type on line %d.",
 	              linenum));
@@ -834,8 +877,8 @@ _ppdCacheCreateWithFile(
       }
 
       map      = pc->types + pc->num_types;
-      map->pwg = strdup(pwg_keyword);
-      map->ppd = strdup(ppd_keyword);
+      map->pwg = strdup(pwg);
+      map->ppd = strdup(ppd);
 
       pc->num_types ++;
     }
@@ -2024,6 +2067,15 @@ _ppdCacheDestroy(_ppd_cache_t *pc)	/* I - PPD cache and mapping data */
 
   cupsArrayDelete(pc->strings);
 
+  free(pc->bins_ppd.buckets);
+  free(pc->bins_pwg.buckets);
+  free(pc->sizes_names.buckets);
+  free(pc->sources_ppd.buckets);
+  free(pc->sources_pwg.buckets);
+  free(pc->types_ppd.buckets);
+  free(pc->types_pwg.buckets);
+  free(pc->size_order);
+
   free(pc);
 }
 
@@ -2053,9 +2105,8 @@ _ppdCacheGetBin(
   */
 
 
-  for (i = 0; i < pc->num_bins; i ++)
-    if (!_cups_strcasecmp(output_bin, pc->bins[i].ppd))
-      return (pc->bins[i].pwg);
+  if ((i = pwg_find_name(&pc->bins_ppd, pc->bins, sizeof(pwg_map_t), pc->num_bins, pwg_map_ppd, 1, output_bin)) >= 0)
+    return (pc->bins[i].pwg);
 
   return (NULL);
 }
@@ -2270,9 +2321,8 @@ _ppdCacheGetInputSlot(
   {
     int	i;				/* Looping var */
 
-    for (i = 0; i < pc->num_sources; i ++)
-      if (!_cups_strcasecmp(keyword, pc->sources[i].pwg))
-        return (pc->sources[i].ppd);
+    if ((i = pwg_find_name(&pc->sources_pwg, pc->sources, sizeof(pwg_map_t), pc->num_sources, pwg_map_pwg, 1, keyword)) >= 0)
+      return (pc->sources[i].ppd);
   }
 
   return (NULL);
@@ -2324,9 +2374,8 @@ _ppdCacheGetMediaType(
   {
     int	i;				/* Looping var */
 
-    for (i = 0; i < pc->num_types; i ++)
-      if (!_cups_strcasecmp(keyword, pc->types[i].pwg))
-        return (pc->types[i].ppd);
+    if ((i = pwg_find_name(&pc->types_pwg, pc->types, sizeof(pwg_map_t), pc->num_types, pwg_map_pwg, 1, keyword)) >= 0)
+      return (pc->types[i].ppd);
   }
 
   return (NULL);
@@ -2358,9 +2407,8 @@ _ppdCacheGetOutputBin(
   */
 
 
-  for (i = 0; i < pc->num_bins; i ++)
-    if (!_cups_strcasecmp(output_bin, pc->bins[i].pwg))
-      return (pc->bins[i].ppd);
+  if ((i = pwg_find_name(&pc->bins_pwg, pc->bins, sizeof(pwg_map_t), pc->num_bins, pwg_map_pwg, 1, output_bin)) >= 0)
+    return (pc->bins[i].ppd);
 
   return (NULL);
 }
@@ -2383,7 +2431,6 @@ _ppdCacheGetPageSize(
 		*closest,		/* Closest size */
 		jobsize;		/* Size data from job */
   int		margins_set,		/* Were the margins set? */
-		dwidth,			/* Difference in width */
 		dlength,		/* Difference in length */
 		dleft,			/* Difference in left margins */
 		dright,			/* Difference in right margins */
@@ -2442,21 +2489,14 @@ _ppdCacheGetPageSize(
     * Try looking up the named PPD size first...
     */
 
-    for (i = pc->num_sizes, size = pc->sizes; i > 0; i --, size ++)
+    if ((i = pwg_find_name(&pc->sizes_names, pc->sizes, sizeof(pwg_size_t), pc->num_sizes, pwg_size_names, 2, ppd_name)) >= 0)
     {
-      DEBUG_printf(("2_ppdCacheGetPageSize: size[%d]=[\"%s\" \"%s\"]",
-                    (int)(size - pc->sizes), size->map.pwg, size->map.ppd));
-
-      if (!_cups_strcasecmp(ppd_name, size->map.ppd) ||
-          !_cups_strcasecmp(ppd_name, size->map.pwg))
-      {
-	if (exact)
-	  *exact = 1;
+      if (exact)
+	*exact = 1;
 
-        DEBUG_printf(("1_ppdCacheGetPageSize: Returning \"%s\"", ppd_name));
+      DEBUG_printf(("1_ppdCacheGetPageSize: Returning \"%s\"", ppd_name));
 
-        return (size->map.ppd);
-      }
+      return (pc->sizes[i].map.ppd);
     }
   }
 
@@ -2500,17 +2540,62 @@ _ppdCacheGetPageSize(
   if (!ppd_name || _cups_strncasecmp(ppd_name, "Custom.", 7) ||
       _cups_strncasecmp(ppd_name, "custom_", 7))
   {
-    for (i = pc->num_sizes, size = pc->sizes; i > 0; i --, size ++)
+    _ppd_size_order_t	*order,		/* Current size in width order */
+			*end;		/* End of sizes */
+    pwg_size_t		*match = NULL;	/* First size that matches */
+
+
+   /*
+    * Adobe uses a size matching algorithm with an epsilon of 5 points, which
+    * is just about 176/2540ths...
+    *
+    * The sizes are sorted by width, so only look at the ones that are close
+    * enough in width.  The first matching size in PPD order is used, or the
+    * first size with the closest margins...
+    */
+
+    if (pc->num_size_order != pc->num_sizes)
     {
-     /*
-      * Adobe uses a size matching algorithm with an epsilon of 5 points, which
-      * is just about 176/2540ths...
-      */
+      free(pc->size_order);
+
+      pc->num_size_order = 0;
+
+      if (pc->num_sizes > 0 && (pc->size_order = calloc((size_t)pc->num_sizes, sizeof(_ppd_size_order_t))) != NULL)
+      {
+        for (i = 0; i < pc->num_sizes; i ++)
+        {
+          pc->size_order[i].width = pc->sizes[i].width;
+          pc->size_order[i].index = i;
+        }
+
+        qsort(pc->size_order, (size_t)pc->num_sizes, sizeof(_ppd_size_order_t), (int (*)(const void *, const void *))pwg_compare_size_order);
+
+        pc->num_size_order = pc->num_sizes;
+      }
+    }
+
+    order = pc->size_order;
+    end   = order + pc->num_size_order;
+
+    for (i = pc->num_size_order; i > 0;)
+    {
+      int half = i / 2;			/* Half of the remaining sizes */
+
+      if (order[half].width - jobsize.width <= -176)
+      {
+        order += half + 1;
+        i     -= half + 1;
+      }
+      else
+        i = half;
+    }
 
-      dwidth  = size->width - jobsize.width;
+    for (; order < end && order->width - jobsize.width < 176; order ++)
+    {
+      size    = pc->sizes + order->index;
       dlength = size->length - jobsize.length;
 
-      if (dwidth <= -176 || dwidth >= 176 || dlength <= -176 || dlength >= 176)
+      if (dlength <= -176 || dlength >= 176 || (match && size > match))
 	continue;
 
       if (margins_set)
@@ -2533,7 +2618,7 @@ _ppdCacheGetPageSize(
 	  dtop    = dtop < 0 ? -dtop : dtop;
 	  dmin    = dleft + dright + dbottom + dtop;
 
-	  if (dmin < dclosest)
+	  if (dmin < dclosest || (dmin == dclosest && size < closest))
 	  {
 	    dclosest = dmin;
 	    closest  = size;
@@ -2543,12 +2628,17 @@ _ppdCacheGetPageSize(
 	}
       }
 
+      match = size;
+    }
+
+    if (match)
+    {
       if (exact)
 	*exact = 1;
 
-      DEBUG_printf(("1_ppdCacheGetPageSize: Returning \"%s\"", size->map.ppd));
+      DEBUG_printf(("1_ppdCacheGetPageSize: Returning \"%s\"", match->map.ppd));
 
-      return (size->map.ppd);
+      return (match->map.ppd);
     }
   }
 
@@ -2615,9 +2705,8 @@ _ppdCacheGetSize(
     _ppd_cache_t *pc,			/* I - PPD cache and mapping data */
     const char   *page_size)		/* I - PPD PageSize */
 {
-  int		i;			/* Looping var */
+  int		i;			/* Size index */
   pwg_media_t	*media;			/* Media */
-  pwg_size_t	*size;			/* Current size */
 
 
  /*
@@ -2694,10 +2783,8 @@ _ppdCacheGetSize(
   * Not a custom size - look it up...
   */
 
-  for (i = pc->num_sizes, size = pc->sizes; i > 0; i --, size ++)
-    if (!_cups_strcasecmp(page_size, size->map.ppd) ||
-        !_cups_strcasecmp(page_size, size->map.pwg))
-      return (size);
+  if ((i = pwg_find_name(&pc->sizes_names, pc->sizes, sizeof(pwg_size_t), pc->num_sizes, pwg_size_names, 2, page_size)) >= 0)
+    return (pc->sizes + i);
 
  /*
   * Look up standard sizes...
@@ -2729,8 +2816,7 @@ _ppdCacheGetSource(
     _ppd_cache_t *pc,			/* I - PPD cache and mapping data */
     const char   *input_slot)		/* I - PPD InputSlot */
 {
-  int		i;			/* Looping var */
-  pwg_map_t	*source;		/* Current source */
+  int		i;			/* Source index */
 
 
  /*
@@ -2740,9 +2826,8 @@ _ppdCacheGetSource(
   if (!pc || !input_slot)
     return (NULL);
 
-  for (i = pc->num_sources, source = pc->sources; i > 0; i --, source ++)
-    if (!_cups_strcasecmp(input_slot, source->ppd))
-      return (source->pwg);
+  if ((i = pwg_find_name(&pc->sources_ppd, pc->sources, sizeof(pwg_map_t), pc->num_sources, pwg_map_ppd, 1, input_slot)) >= 0)
+    return (pc->sources[i].pwg);
 
   return (NULL);
 }
@@ -2758,8 +2843,7 @@ _ppdCacheGetType(
     _ppd_cache_t *pc,			/* I - PPD cache and mapping data */
     const char   *media_type)		/* I - PPD MediaType */
 {
-  int		i;			/* Looping var */
-  pwg_map_t	*type;			/* Current type */
+  int		i;			/* Type index */
 
 
  /*
@@ -2769,9 +2853,8 @@ _ppdCacheGetType(
   if (!pc || !media_type)
     return (NULL);
 
-  for (i = pc->num_types, type = pc->types; i > 0; i --, type ++)
-    if (!_cups_strcasecmp(media_type, type->ppd))
-      return (type->pwg);
+  if ((i = pwg_find_name(&pc->types_ppd, pc->types, sizeof(pwg_map_t), pc->num_types, pwg_map_ppd, 1, media_type)) >= 0)
+    return (pc->types[i].pwg);
 
   return (NULL);
 }
@@ -2812,7 +2895,7 @@ _ppdCacheWriteFile(
   */
 
   snprintf(newfile, sizeof(newfile), "%s.N", filename);
-  if ((fp = cupsFileOpen(newfile, "w9")) == NULL)
+  if ((fp = cupsFileOpen(newfile, "w")) == NULL)
   {
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
     return (0);
@@ -5016,6 +5099,22 @@ pwg_compare_finishings(
 }
 
 
+/*
+ * 'pwg_compare_size_order()' - Compare two media sizes by width.
+ */
+
+static int				/* O - Result of comparison */
+pwg_compare_size_order(
+    _ppd_size_order_t *a,		/* I - First media size */
+    _ppd_size_order_t *b)		/* I - Second media size */
+{
+  if (a->width != b->width)
+    return (a->width - b->width);
+  else
+    return (a->index - b->index);
+}
+
+
 /*
  * 'pwg_compare_sizes()' - Compare two media sizes...
  */
@@ -5045,6 +5144,100 @@ pwg_copy_size(cups_size_t *size)	/* I - Media size to copy */
 }
 
 
+/*
+ * 'pwg_find_name()' - Find the first element with a given name.
+ *
+ * The hash index is built the first time it is used and again whenever the
+ * number of elements changes.
+ */
+
+static int				/* O - Element number or -1 if not found */
+pwg_find_name(
+    _ppd_index_t *index,		/* I - Hash index */
+    const void   *elements,		/* I - Array of elements */
+    size_t       elsize,		/* I - Size of each element */
+    int          num_elements,		/* I - Number of elements */
+    const size_t *keys,			/* I - Offsets of name pointers */
+    int          num_keys,		/* I - Number of keys */
+    const char   *name)			/* I - Name to find */
+{
+  int		i, j,			/* Looping vars */
+		bucket,			/* Current bucket */
+		found = -1;		/* Element found */
+  const char	*element,		/* Current element */
+		*elname;		/* Name of element */
+
+
+  if (num_elements <= 0 || !name)
+    return (-1);
+
+  if (index->num_elements != num_elements)
+  {
+   /*
+    * (Re)build the index...
+    */
+
+    free(index->buckets);
+
+    index->num_elements = num_elements;
+
+    for (index->num_buckets = 16; index->num_buckets < 2 * num_elements * num_keys; index->num_buckets *= 2);
+
+    if ((index->buckets = calloc((size_t)index->num_buckets, sizeof(int))) != NULL)
+    {
+      for (i = 0, element = (const char *)elements; i < num_elements; i ++, element += elsize)
+      {
+        for (j = 0; j < num_keys; j ++)
+        {
+          if ((elname = *(char * const *)(element + keys[j])) == NULL)
+            continue;
+
+          for (bucket = (int)(pwg_hash_name(elname) & (unsigned)(index->num_buckets - 1)); index->buckets[bucket]; bucket = (bucket + 1) & (index->num_buckets - 1));
+
+          index->buckets[bucket] = i + 1;
+        }
+      }
+    }
+  }
+
+  if (!index->buckets)
+  {
+   /*
+    * Unable to allocate the index, look through the elements one by one...
+    */
+
+    for (i = 0, element = (const char *)elements; i < num_elements; i ++, element += elsize)
+      for (j = 0; j < num_keys; j ++)
+        if ((elname = *(char * const *)(element + keys[j])) != NULL && !_cups_strcasecmp(name, elname))
+          return (i);
+
+    return (-1);
+  }
+
+ /*
+  * Look through the buckets for this name, keeping the first matching
+  * element...
+  */
+
+  for (bucket = (int)(pwg_hash_name(name) & (unsigned)(index->num_buckets - 1)); index->buckets[bucket]; bucket = (bucket + 1) & (index->num_buckets - 1))
+  {
+    if ((i = index->buckets[bucket] - 1) >= found && found >= 0)
+      continue;
+
+    element = (const char *)elements + (size_t)i * elsize;
+
+    for (j = 0; j < num_keys; j ++)
+      if ((elname = *(char * const *)(element + keys[j])) != NULL && !_cups_strcasecmp(name, elname))
+      {
+        found = i;
+        break;
+      }
+  }
+
+  return (found);
+}
+
+
 /*
  * 'pwg_free_finishings()' - Free a finishings value.
  */
@@ -5058,6 +5251,86 @@ pwg_free_finishings(
 }
 
 
+/*
+ * 'pwg_hash_name()' - Compute a case-insensitive hash of a name.
+ */
+
+static unsigned				/* O - Hash value */
+pwg_hash_name(const char *name)		/* I - Name */
+{
+  unsigned	hash = 2166136261U;	/* Hash value */
+
+
+  while (*name)
+  {
+    hash ^= (unsigned)_cups_tolower(*name & 255);
+    hash *= 16777619U;
+    name ++;
+  }
+
+  return (hash);
+}
+
+
+/*
+ * 'pwg_next_ints()' - Get the next integers from a cache file line.
+ */
+
+static int				/* O  - 1 on success, 0 on error */
+pwg_next_ints(char **ptr,		/* IO - Pointer into line */
+              int  *values,		/* O  - Values */
+              int  num_values)		/* I  - Number of values */
+{
+  char	*end;				/* End of value */
+
+
+  while (num_values > 0)
+  {
+    *values = (int)strtol(*ptr, &end, 10);
+
+    if (end == *ptr || (*end && !_cups_isspace(*end)))
+      return (0);
+
+    *ptr = end;
+    values ++;
+    num_values --;
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'pwg_next_word()' - Get the next word from a cache file line.
+ *
+ * The word is nul-terminated in place and the line pointer is advanced past
+ * it.
+ */
+
+static char *				/* O  - Word or `NULL` on error */
+pwg_next_word(char   **ptr,		/* IO - Pointer into line */
+              size_t maxlen)		/* I  - Maximum length of word */
+{
+  char	*start,				/* Start of word */
+	*end;				/* End of word */
+
+
+  for (start = *ptr; _cups_isspace(*start); start ++);
+
+  for (end = start; *end && !_cups_isspace(*end); end ++);
+
+  if (end == start || (size_t)(end - start) > maxlen)
+    return (NULL);
+
+  if (*end)
+    *end++ = '\0';
+
+  *ptr = end;
+
+  return (start);
+}
+
+
 /*
  * 'pwg_ppdize_name()' - Convert an IPP keyword to a PPD keyword.
  */
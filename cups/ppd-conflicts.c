@@ -31,13 +31,50 @@ enum
 };
 
 
+/*
+ * Local types...
+ */
+
+typedef struct _ppd_uioption_s		/**** Constraints by option ****/
+{
+  const char		*keyword;	/* Option keyword */
+  int			num_consts,	/* Number of constraints */
+			alloc_consts;	/* Allocated constraints */
+  _ppd_cups_uiconsts_t	**consts;	/* Constraints using this option */
+} _ppd_uioption_t;
+
+typedef struct _ppd_uitest_s		/**** Constraint test state ****/
+{
+  const char		*option,	/* Current option */
+			*choice;	/* Current choice */
+  int			num_options;	/* Number of additional options */
+  cups_option_t		*options;	/* Additional options */
+  ppd_option_t		*cur_option,	/* PPD option for "option" */
+			*first_option,	/* PPD option for "AP_FIRSTPAGE_option" */
+			*page_size,	/* PageSize option */
+			*page_region;	/* PageRegion option */
+  int			have_first,	/* Any AP_FIRSTPAGE_ options? */
+			have_page;	/* Page size values looked up? */
+  const char		*page_value,	/* Selected page size */
+			*first_page_value;
+					/* Selected first page size */
+} _ppd_uitest_t;
+
+
 /*
  * Local functions...
  */
 
+static int		ppd_compare_uioptions(_ppd_uioption_t *a,
+			                      _ppd_uioption_t *b, void *data);
+static void		ppd_free_uioption(_ppd_uioption_t *uiopt, void *data);
+static void		ppd_index_constraints(ppd_file_t *ppd);
 static int		ppd_is_installable(ppd_group_t *installable,
 			                   const char *option);
 static void		ppd_load_constraints(ppd_file_t *ppd);
+static int		ppd_test_constraint(ppd_file_t *ppd,
+			                    _ppd_cups_uiconsts_t *consts,
+					    _ppd_uitest_t *test);
 static cups_array_t	*ppd_test_constraints(ppd_file_t *ppd,
 			                      const char *option,
 					      const char *choice,
@@ -664,6 +701,109 @@ ppdInstallableConflict(
 }
 
 
+/*
+ * 'ppd_compare_uioptions()' - Compare two option constraint lists.
+ */
+
+static int				/* O - Result of comparison */
+ppd_compare_uioptions(
+    _ppd_uioption_t *a,			/* I - First list */
+    _ppd_uioption_t *b,			/* I - Second list */
+    void            *data)		/* I - Callback data (unused) */
+{
+  (void)data;
+
+  return (_cups_strcasecmp(a->keyword, b->keyword));
+}
+
+
+/*
+ * 'ppd_free_uioption()' - Free an option constraint list.
+ */
+
+static void
+ppd_free_uioption(
+    _ppd_uioption_t *uiopt,		/* I - List to free */
+    void            *data)		/* I - Callback data (unused) */
+{
+  (void)data;
+
+  free(uiopt->consts);
+  free(uiopt);
+}
+
+
+/*
+ * 'ppd_index_constraints()' - Index the loaded constraints by option.
+ *
+ * The index is kept as the user data of the "cups_uiconstraints" array so
+ * that the public ppd_file_t structure does not change.  Each list holds the
+ * constraints in load order, so testing a list in order reports active
+ * constraints in the same order as testing the whole array.  An empty index
+ * means "not available" and callers fall back to testing every constraint.
+ */
+
+static void
+ppd_index_constraints(ppd_file_t *ppd)	/* I - PPD file */
+{
+  int			i;		/* Looping var */
+  cups_array_t		*index;		/* Option index */
+  _ppd_cups_uiconsts_t	*consts;	/* Current constraints */
+  _ppd_cups_uiconst_t	*constptr;	/* Current constraint */
+  _ppd_uioption_t	key,		/* Search key */
+			*uiopt;		/* Current option list */
+  _ppd_cups_uiconsts_t	**temp;		/* New list memory */
+
+
+  index = cupsArrayUserData(ppd->cups_uiconstraints);
+
+  for (consts = (_ppd_cups_uiconsts_t *)cupsArrayFirst(ppd->cups_uiconstraints);
+       consts;
+       consts = (_ppd_cups_uiconsts_t *)cupsArrayNext(ppd->cups_uiconstraints))
+  {
+    for (i = consts->num_constraints, constptr = consts->constraints;
+         i > 0;
+	 i --, constptr ++)
+    {
+      key.keyword = constptr->option->keyword;
+
+      if ((uiopt = (_ppd_uioption_t *)cupsArrayFind(index, &key)) == NULL)
+      {
+        if ((uiopt = calloc(1, sizeof(_ppd_uioption_t))) == NULL)
+	{
+	  DEBUG_puts("8ppd_index_constraints: Unable to allocate memory for "
+	             "index!");
+	  cupsArrayClear(index);
+	  return;
+	}
+
+        uiopt->keyword = constptr->option->keyword;
+
+	cupsArrayAdd(index, uiopt);
+      }
+      else if (uiopt->consts[uiopt->num_consts - 1] == consts)
+        continue;			/* Option used twice in constraint */
+
+      if (uiopt->num_consts >= uiopt->alloc_consts)
+      {
+        if ((temp = realloc(uiopt->consts, (size_t)(uiopt->alloc_consts + 8) * sizeof(_ppd_cups_uiconsts_t *))) == NULL)
+	{
+	  DEBUG_puts("8ppd_index_constraints: Unable to allocate memory for "
+	             "index!");
+	  cupsArrayClear(index);
+	  return;
+	}
+
+        uiopt->consts       = temp;
+	uiopt->alloc_consts += 8;
+      }
+
+      uiopt->consts[uiopt->num_consts ++] = consts;
+    }
+  }
+}
+
+
 /*
  * 'ppd_is_installable()' - Determine whether an option is in the
  *                          InstallableOptions group.
@@ -716,7 +856,7 @@ ppd_load_constraints(ppd_file_t *ppd)	/* I - PPD file */
   * Create an array to hold the constraint data...
   */
 
-  ppd->cups_uiconstraints = cupsArrayNew(NULL, NULL);
+  ppd->cups_uiconstraints = cupsArrayNew(NULL, cupsArrayNew3((cups_array_func_t)ppd_compare_uioptions, NULL, NULL, 0, NULL, (cups_afree_func_t)ppd_free_uioption));
 
  /*
   * Find the installable options group if it exists...
@@ -933,6 +1073,205 @@ ppd_load_constraints(ppd_file_t *ppd)	/* I - PPD file */
       free(consts);
     }
   }
+
+ /*
+  * Finally index the constraints by option...
+  */
+
+  ppd_index_constraints(ppd);
+}
+
+
+/*
+ * 'ppd_test_constraint()' - See if a single constraint is active.
+ */
+
+static int				/* O - 1 if active, 0 if not */
+ppd_test_constraint(
+    ppd_file_t           *ppd,		/* I - PPD file */
+    _ppd_cups_uiconsts_t *consts,	/* I - Constraint to test */
+    _ppd_uitest_t        *test)		/* I - Option/choice being tested */
+{
+  int			i;		/* Looping var */
+  _ppd_cups_uiconst_t	*constptr;	/* Current constraint */
+  ppd_choice_t		key,		/* Search key */
+			*marked;	/* Marked choice */
+  const char		*value,		/* Current value */
+			*firstvalue;	/* AP_FIRSTPAGE_Keyword value */
+  char			firstpage[255];	/* AP_FIRSTPAGE_Keyword string */
+
+
+  DEBUG_puts("9ppd_test_constraints: Testing...");
+
+  for (i = consts->num_constraints, constptr = consts->constraints;
+       i > 0;
+       i --, constptr ++)
+  {
+    DEBUG_printf(("9ppd_test_constraints: %s=%s?", constptr->option->keyword,
+		  constptr->choice ? constptr->choice->choice : ""));
+
+    if (constptr->choice &&
+        (constptr->option == test->page_size ||
+         constptr->option == test->page_region))
+    {
+     /*
+      * PageSize and PageRegion are used depending on the selected input slot
+      * and manual feed mode.  Validate against the selected page size instead
+      * of an individual option...
+      */
+
+      if (!test->have_page)
+      {
+        if (test->option && test->choice &&
+	    (!_cups_strcasecmp(test->option, "PageSize") ||
+	     !_cups_strcasecmp(test->option, "PageRegion")))
+	{
+	  value = test->choice;
+	}
+	else if ((value = cupsGetOption("PageSize", test->num_options,
+					test->options)) == NULL)
+	  if ((value = cupsGetOption("PageRegion", test->num_options,
+				     test->options)) == NULL)
+	    if ((value = cupsGetOption("media", test->num_options,
+	                               test->options)) == NULL)
+	    {
+	      ppd_size_t *size = ppdPageSize(ppd, NULL);
+
+	      if (size)
+		value = size->name;
+	    }
+
+	if (value && !_cups_strncasecmp(value, "Custom.", 7))
+	  value = "Custom";
+
+	if (test->option && test->choice &&
+	    (!_cups_strcasecmp(test->option, "AP_FIRSTPAGE_PageSize") ||
+	     !_cups_strcasecmp(test->option, "AP_FIRSTPAGE_PageRegion")))
+	{
+	  firstvalue = test->choice;
+	}
+	else if ((firstvalue = cupsGetOption("AP_FIRSTPAGE_PageSize",
+					     test->num_options,
+					     test->options)) == NULL)
+	  firstvalue = cupsGetOption("AP_FIRSTPAGE_PageRegion",
+				     test->num_options, test->options);
+
+	if (firstvalue && !_cups_strncasecmp(firstvalue, "Custom.", 7))
+	  firstvalue = "Custom";
+
+        test->have_page        = 1;
+	test->page_value       = value;
+	test->first_page_value = firstvalue;
+      }
+      else
+      {
+        value      = test->page_value;
+	firstvalue = test->first_page_value;
+      }
+
+      if ((!value || _cups_strcasecmp(value, constptr->choice->choice)) &&
+	  (!firstvalue || _cups_strcasecmp(firstvalue, constptr->choice->choice)))
+      {
+	DEBUG_puts("9ppd_test_constraints: NO");
+	break;
+      }
+    }
+    else if (constptr->choice)
+    {
+     /*
+      * Compare against the constrained choice...
+      */
+
+      if (test->choice && constptr->option == test->cur_option)
+      {
+	if (!_cups_strncasecmp(test->choice, "Custom.", 7))
+	  value = "Custom";
+	else
+	  value = test->choice;
+      }
+      else if ((value = cupsGetOption(constptr->option->keyword,
+				      test->num_options,
+				      test->options)) != NULL)
+      {
+	if (!_cups_strncasecmp(value, "Custom.", 7))
+	  value = "Custom";
+      }
+      else if (constptr->choice->marked)
+	value = constptr->choice->choice;
+      else
+	value = NULL;
+
+     /*
+      * Now check AP_FIRSTPAGE_option...
+      */
+
+      if (test->choice && constptr->option == test->first_option)
+      {
+	if (!_cups_strncasecmp(test->choice, "Custom.", 7))
+	  firstvalue = "Custom";
+	else
+	  firstvalue = test->choice;
+      }
+      else if (test->have_first)
+      {
+	snprintf(firstpage, sizeof(firstpage), "AP_FIRSTPAGE_%s",
+		 constptr->option->keyword);
+
+	if ((firstvalue = cupsGetOption(firstpage, test->num_options,
+					test->options)) != NULL &&
+	    !_cups_strncasecmp(firstvalue, "Custom.", 7))
+	  firstvalue = "Custom";
+      }
+      else
+	firstvalue = NULL;
+
+      DEBUG_printf(("9ppd_test_constraints: value=%s, firstvalue=%s", value,
+		    firstvalue));
+
+      if ((!value || _cups_strcasecmp(value, constptr->choice->choice)) &&
+	  (!firstvalue || _cups_strcasecmp(firstvalue, constptr->choice->choice)))
+      {
+	DEBUG_puts("9ppd_test_constraints: NO");
+	break;
+      }
+    }
+    else if (test->choice && constptr->option == test->cur_option)
+    {
+      if (!_cups_strcasecmp(test->choice, "None") ||
+          !_cups_strcasecmp(test->choice, "Off") ||
+	  !_cups_strcasecmp(test->choice, "False"))
+      {
+	DEBUG_puts("9ppd_test_constraints: NO");
+	break;
+      }
+    }
+    else if ((value = cupsGetOption(constptr->option->keyword,
+				    test->num_options, test->options)) != NULL)
+    {
+      if (!_cups_strcasecmp(value, "None") || !_cups_strcasecmp(value, "Off") ||
+	  !_cups_strcasecmp(value, "False"))
+      {
+	DEBUG_puts("9ppd_test_constraints: NO");
+	break;
+      }
+    }
+    else
+    {
+      key.option = constptr->option;
+
+      if ((marked = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key))
+	      == NULL ||
+	  (!_cups_strcasecmp(marked->choice, "None") ||
+	   !_cups_strcasecmp(marked->choice, "Off") ||
+	   !_cups_strcasecmp(marked->choice, "False")))
+      {
+	DEBUG_puts("9ppd_test_constraints: NO");
+	break;
+      }
+    }
+  }
+
+  return (i <= 0);
 }
 
 
@@ -952,12 +1291,13 @@ ppd_test_constraints(
   int			i;		/* Looping var */
   _ppd_cups_uiconsts_t	*consts;	/* Current constraints */
   _ppd_cups_uiconst_t	*constptr;	/* Current constraint */
-  ppd_choice_t		key,		/* Search key */
-			*marked;	/* Marked choice */
+  cups_array_t		*index;		/* Option index */
+  _ppd_uioption_t	key,		/* Search key */
+			*uiopt = NULL,	/* Constraints for option */
+			*firstopt = NULL;
+					/* Constraints for AP_FIRSTPAGE_ option */
+  _ppd_uitest_t		test;		/* Test state */
   cups_array_t		*active = NULL;	/* Active constraints */
-  const char		*value,		/* Current value */
-			*firstvalue;	/* AP_FIRSTPAGE_Keyword value */
-  char			firstpage[255];	/* AP_FIRSTPAGE_Keyword string */
 
 
   DEBUG_printf(("7ppd_test_constraints(ppd=%p, option=\"%s\", choice=\"%s\", "
@@ -970,6 +1310,101 @@ ppd_test_constraints(
   DEBUG_printf(("9ppd_test_constraints: %d constraints!",
 	        cupsArrayCount(ppd->cups_uiconstraints)));
 
+ /*
+  * Look up the options that get special treatment once so that each
+  * constraint can compare option pointers instead of names...
+  */
+
+  memset(&test, 0, sizeof(test));
+
+  test.option      = option;
+  test.choice      = choice;
+  test.num_options = num_options;
+  test.options     = options;
+
+  cupsArraySave(ppd->options);
+
+  if (option)
+  {
+    test.cur_option = ppdFindOption(ppd, option);
+
+    if (!_cups_strncasecmp(option, "AP_FIRSTPAGE_", 13))
+      test.first_option = ppdFindOption(ppd, option + 13);
+  }
+
+  for (i = 0; i < num_options; i ++)
+    if (!_cups_strncasecmp(options[i].name, "AP_FIRSTPAGE_", 13))
+    {
+      test.have_first = 1;
+      break;
+    }
+
+  test.page_size   = ppdFindOption(ppd, "PageSize");
+  test.page_region = ppdFindOption(ppd, "PageRegion");
+
+  cupsArrayRestore(ppd->options);
+
+  if ((which == _PPD_OPTION_CONSTRAINTS || which == _PPD_INSTALLABLE_CONSTRAINTS) && option &&
+      (index = cupsArrayUserData(ppd->cups_uiconstraints)) != NULL &&
+      cupsArrayCount(index) > 0)
+  {
+   /*
+    * Only test the constraints that involve the current option...
+    */
+
+    key.keyword = option;
+    uiopt       = (_ppd_uioption_t *)cupsArrayFind(index, &key);
+
+    if (!_cups_strncasecmp(option, "AP_FIRSTPAGE_", 13))
+    {
+      key.keyword = option + 13;
+      firstopt    = (_ppd_uioption_t *)cupsArrayFind(index, &key);
+    }
+
+    if (!uiopt && !firstopt)
+      return (NULL);
+
+    if (!uiopt || !firstopt)
+    {
+      if (!uiopt)
+        uiopt = firstopt;
+
+      cupsArraySave(ppd->marked);
+
+      for (i = 0; i < uiopt->num_consts; i ++)
+      {
+        consts = uiopt->consts[i];
+
+	if (consts->installable && which < _PPD_INSTALLABLE_CONSTRAINTS)
+	  continue;			/* Skip installable option constraint */
+
+	if (!consts->installable && which == _PPD_INSTALLABLE_CONSTRAINTS)
+	  continue;			/* Skip non-installable option constraint */
+
+	if (ppd_test_constraint(ppd, consts, &test))
+	{
+	  if (!active)
+	    active = cupsArrayNew(NULL, NULL);
+
+	  cupsArrayAdd(active, consts);
+	  DEBUG_puts("9ppd_test_constraints: Added...");
+	}
+      }
+
+      cupsArrayRestore(ppd->marked);
+
+      DEBUG_printf(("8ppd_test_constraints: Found %d active constraints!",
+		    cupsArrayCount(active)));
+
+      return (active);
+    }
+
+   /*
+    * Both "AP_FIRSTPAGE_Foo" and "Foo" are constrained; this is rare, so just
+    * test everything below...
+    */
+  }
+
   cupsArraySave(ppd->marked);
 
   for (consts = (_ppd_cups_uiconsts_t *)cupsArrayFirst(ppd->cups_uiconstraints);
@@ -1015,161 +1450,7 @@ ppd_test_constraints(
         continue;
     }
 
-    DEBUG_puts("9ppd_test_constraints: Testing...");
-
-    for (i = consts->num_constraints, constptr = consts->constraints;
-         i > 0;
-	 i --, constptr ++)
-    {
-      DEBUG_printf(("9ppd_test_constraints: %s=%s?", constptr->option->keyword,
-		    constptr->choice ? constptr->choice->choice : ""));
-
-      if (constptr->choice &&
-          (!_cups_strcasecmp(constptr->option->keyword, "PageSize") ||
-           !_cups_strcasecmp(constptr->option->keyword, "PageRegion")))
-      {
-       /*
-        * PageSize and PageRegion are used depending on the selected input slot
-	* and manual feed mode.  Validate against the selected page size instead
-	* of an individual option...
-	*/
-
-        if (option && choice &&
-	    (!_cups_strcasecmp(option, "PageSize") ||
-	     !_cups_strcasecmp(option, "PageRegion")))
-	{
-	  value = choice;
-        }
-	else if ((value = cupsGetOption("PageSize", num_options,
-	                                options)) == NULL)
-	  if ((value = cupsGetOption("PageRegion", num_options,
-	                             options)) == NULL)
-	    if ((value = cupsGetOption("media", num_options, options)) == NULL)
-	    {
-	      ppd_size_t *size = ppdPageSize(ppd, NULL);
-
-              if (size)
-	        value = size->name;
-	    }
-
-        if (value && !_cups_strncasecmp(value, "Custom.", 7))
-	  value = "Custom";
-
-        if (option && choice &&
-	    (!_cups_strcasecmp(option, "AP_FIRSTPAGE_PageSize") ||
-	     !_cups_strcasecmp(option, "AP_FIRSTPAGE_PageRegion")))
-	{
-	  firstvalue = choice;
-        }
-	else if ((firstvalue = cupsGetOption("AP_FIRSTPAGE_PageSize",
-	                                     num_options, options)) == NULL)
-	  firstvalue = cupsGetOption("AP_FIRSTPAGE_PageRegion", num_options,
-	                             options);
-
-        if (firstvalue && !_cups_strncasecmp(firstvalue, "Custom.", 7))
-	  firstvalue = "Custom";
-
-        if ((!value || _cups_strcasecmp(value, constptr->choice->choice)) &&
-	    (!firstvalue || _cups_strcasecmp(firstvalue, constptr->choice->choice)))
-	{
-	  DEBUG_puts("9ppd_test_constraints: NO");
-	  break;
-	}
-      }
-      else if (constptr->choice)
-      {
-       /*
-        * Compare against the constrained choice...
-	*/
-
-        if (option && choice && !_cups_strcasecmp(option, constptr->option->keyword))
-	{
-	  if (!_cups_strncasecmp(choice, "Custom.", 7))
-	    value = "Custom";
-	  else
-	    value = choice;
-	}
-        else if ((value = cupsGetOption(constptr->option->keyword, num_options,
-	                                options)) != NULL)
-        {
-	  if (!_cups_strncasecmp(value, "Custom.", 7))
-	    value = "Custom";
-	}
-        else if (constptr->choice->marked)
-	  value = constptr->choice->choice;
-	else
-	  value = NULL;
-
-       /*
-        * Now check AP_FIRSTPAGE_option...
-	*/
-
-        snprintf(firstpage, sizeof(firstpage), "AP_FIRSTPAGE_%s",
-	         constptr->option->keyword);
-
-        if (option && choice && !_cups_strcasecmp(option, firstpage))
-	{
-	  if (!_cups_strncasecmp(choice, "Custom.", 7))
-	    firstvalue = "Custom";
-	  else
-	    firstvalue = choice;
-	}
-        else if ((firstvalue = cupsGetOption(firstpage, num_options,
-	                                     options)) != NULL)
-        {
-	  if (!_cups_strncasecmp(firstvalue, "Custom.", 7))
-	    firstvalue = "Custom";
-	}
-	else
-	  firstvalue = NULL;
-
-        DEBUG_printf(("9ppd_test_constraints: value=%s, firstvalue=%s", value,
-	              firstvalue));
-
-        if ((!value || _cups_strcasecmp(value, constptr->choice->choice)) &&
-	    (!firstvalue || _cups_strcasecmp(firstvalue, constptr->choice->choice)))
-	{
-	  DEBUG_puts("9ppd_test_constraints: NO");
-	  break;
-	}
-      }
-      else if (option && choice &&
-               !_cups_strcasecmp(option, constptr->option->keyword))
-      {
-	if (!_cups_strcasecmp(choice, "None") || !_cups_strcasecmp(choice, "Off") ||
-	    !_cups_strcasecmp(choice, "False"))
-	{
-	  DEBUG_puts("9ppd_test_constraints: NO");
-	  break;
-	}
-      }
-      else if ((value = cupsGetOption(constptr->option->keyword, num_options,
-				      options)) != NULL)
-      {
-	if (!_cups_strcasecmp(value, "None") || !_cups_strcasecmp(value, "Off") ||
-	    !_cups_strcasecmp(value, "False"))
-	{
-	  DEBUG_puts("9ppd_test_constraints: NO");
-	  break;
-	}
-      }
-      else
-      {
-	key.option = constptr->option;
-
-	if ((marked = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key))
-		== NULL ||
-	    (!_cups_strcasecmp(marked->choice, "None") ||
-	     !_cups_strcasecmp(marked->choice, "Off") ||
-	     !_cups_strcasecmp(marked->choice, "False")))
-	{
-	  DEBUG_puts("9ppd_test_constraints: NO");
-	  break;
-	}
-      }
-    }
-
-    if (i <= 0)
+    if (ppd_test_constraint(ppd, consts, &test))
     {
       if (!active)
         active = cupsArrayNew(NULL, NULL);
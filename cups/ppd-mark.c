@@ -30,8 +30,11 @@ static void	ppd_debug_marked(ppd_file_t *ppd, const char *title);
 #endif /* DEBUG */
 static void	ppd_defaults(ppd_file_t *ppd, ppd_group_t *g);
 static void	ppd_mark_choices(ppd_file_t *ppd, const char *s);
+static void	ppd_mark_defaults(ppd_file_t *ppd);
 static void	ppd_mark_option(ppd_file_t *ppd, const char *option,
 		                const char *choice);
+static void	ppd_mark_options(ppd_file_t *ppd, int num_options,
+		                 cups_option_t *options);
 
 
 /*
@@ -49,22 +52,6 @@ cupsMarkOptions(
     int           num_options,		/* I - Number of options */
     cups_option_t *options)		/* I - Options */
 {
-  int		i, j;			/* Looping vars */
-  char		*ptr,			/* Pointer into string */
-		s[255];			/* Temporary string */
-  const char	*val,			/* Pointer into value */
-		*media,			/* media option */
-		*output_bin,		/* output-bin option */
-		*page_size,		/* PageSize option */
-		*ppd_keyword,		/* PPD keyword */
-		*print_color_mode,	/* print-color-mode option */
-		*print_quality,		/* print-quality option */
-		*sides;			/* sides option */
-  cups_option_t	*optptr;		/* Current option */
-  ppd_attr_t	*attr;			/* PPD attribute */
-  _ppd_cache_t	*cache;			/* PPD cache and mapping data */
-
-
  /*
   * Check arguments...
   */
@@ -72,287 +59,11 @@ cupsMarkOptions(
   if (!ppd || num_options <= 0 || !options)
     return (0);
 
-  ppd_debug_marked(ppd, "Before...");
-
  /*
-  * Do special handling for finishings, media, output-bin, output-mode,
-  * print-color-mode, print-quality, and PageSize...
+  * Mark the options and then check for conflicts...
   */
 
-  media         = cupsGetOption("media", num_options, options);
-  output_bin    = cupsGetOption("output-bin", num_options, options);
-  page_size     = cupsGetOption("PageSize", num_options, options);
-  print_quality = cupsGetOption("print-quality", num_options, options);
-  sides         = cupsGetOption("sides", num_options, options);
-
-  if ((print_color_mode = cupsGetOption("print-color-mode", num_options,
-                                        options)) == NULL)
-    print_color_mode = cupsGetOption("output-mode", num_options, options);
-
-  if ((media || output_bin || print_color_mode || print_quality || sides) &&
-      !ppd->cache)
-  {
-   /*
-    * Load PPD cache and mapping data as needed...
-    */
-
-    ppd->cache = _ppdCacheCreateWithPPD(ppd);
-  }
-
-  cache = ppd->cache;
-
-  if (media)
-  {
-   /*
-    * Loop through the option string, separating it at commas and marking each
-    * individual option as long as the corresponding PPD option (PageSize,
-    * InputSlot, etc.) is not also set.
-    *
-    * For PageSize, we also check for an empty option value since some versions
-    * of macOS use it to specify auto-selection of the media based solely on
-    * the size.
-    */
-
-    for (val = media; *val;)
-    {
-     /*
-      * Extract the sub-option from the string...
-      */
-
-      for (ptr = s; *val && *val != ',' && (size_t)(ptr - s) < (sizeof(s) - 1);)
-	*ptr++ = *val++;
-      *ptr++ = '\0';
-
-      if (*val == ',')
-	val ++;
-
-     /*
-      * Mark it...
-      */
-
-      if (!page_size || !page_size[0])
-      {
-        if (!_cups_strncasecmp(s, "Custom.", 7) || ppdPageSize(ppd, s))
-          ppd_mark_option(ppd, "PageSize", s);
-        else if ((ppd_keyword = _ppdCacheGetPageSize(cache, NULL, s, NULL)) != NULL)
-	  ppd_mark_option(ppd, "PageSize", ppd_keyword);
-      }
-
-      if (cache && cache->source_option &&
-          !cupsGetOption(cache->source_option, num_options, options) &&
-	  (ppd_keyword = _ppdCacheGetInputSlot(cache, NULL, s)) != NULL)
-	ppd_mark_option(ppd, cache->source_option, ppd_keyword);
-
-      if (!cupsGetOption("MediaType", num_options, options) &&
-	  (ppd_keyword = _ppdCacheGetMediaType(cache, NULL, s)) != NULL)
-	ppd_mark_option(ppd, "MediaType", ppd_keyword);
-    }
-  }
-
-  if (cache)
-  {
-    if (!cupsGetOption("com.apple.print.DocumentTicket.PMSpoolFormat",
-                       num_options, options) &&
-        !cupsGetOption("APPrinterPreset", num_options, options) &&
-        (print_color_mode || print_quality))
-    {
-     /*
-      * Map output-mode and print-quality to a preset...
-      */
-
-      _pwg_print_color_mode_t	pwg_pcm;/* print-color-mode index */
-      _pwg_print_quality_t	pwg_pq;	/* print-quality index */
-      cups_option_t		*preset;/* Current preset option */
-
-      if (print_color_mode && !strcmp(print_color_mode, "monochrome"))
-	pwg_pcm = _PWG_PRINT_COLOR_MODE_MONOCHROME;
-      else
-	pwg_pcm = _PWG_PRINT_COLOR_MODE_COLOR;
-
-      if (print_quality)
-      {
-	pwg_pq = (_pwg_print_quality_t)(atoi(print_quality) - IPP_QUALITY_DRAFT);
-	if (pwg_pq < _PWG_PRINT_QUALITY_DRAFT)
-	  pwg_pq = _PWG_PRINT_QUALITY_DRAFT;
-	else if (pwg_pq > _PWG_PRINT_QUALITY_HIGH)
-	  pwg_pq = _PWG_PRINT_QUALITY_HIGH;
-      }
-      else
-	pwg_pq = _PWG_PRINT_QUALITY_NORMAL;
-
-      if (cache->num_presets[pwg_pcm][pwg_pq] == 0)
-      {
-       /*
-	* Try to find a preset that works so that we maximize the chances of us
-	* getting a good print using IPP attributes.
-	*/
-
-	if (cache->num_presets[pwg_pcm][_PWG_PRINT_QUALITY_NORMAL] > 0)
-	  pwg_pq = _PWG_PRINT_QUALITY_NORMAL;
-	else if (cache->num_presets[_PWG_PRINT_COLOR_MODE_COLOR][pwg_pq] > 0)
-	  pwg_pcm = _PWG_PRINT_COLOR_MODE_COLOR;
-	else
-	{
-	  pwg_pq  = _PWG_PRINT_QUALITY_NORMAL;
-	  pwg_pcm = _PWG_PRINT_COLOR_MODE_COLOR;
-	}
-      }
-
-      if (cache->num_presets[pwg_pcm][pwg_pq] > 0)
-      {
-       /*
-	* Copy the preset options as long as the corresponding names are not
-	* already defined in the IPP request...
-	*/
-
-	for (i = cache->num_presets[pwg_pcm][pwg_pq],
-		 preset = cache->presets[pwg_pcm][pwg_pq];
-	     i > 0;
-	     i --, preset ++)
-	{
-	  if (!cupsGetOption(preset->name, num_options, options))
-	    ppd_mark_option(ppd, preset->name, preset->value);
-	}
-      }
-    }
-
-    if (output_bin && !cupsGetOption("OutputBin", num_options, options) &&
-	(ppd_keyword = _ppdCacheGetOutputBin(cache, output_bin)) != NULL)
-    {
-     /*
-      * Map output-bin to OutputBin...
-      */
-
-      ppd_mark_option(ppd, "OutputBin", ppd_keyword);
-    }
-
-    if (sides && cache->sides_option &&
-        !cupsGetOption(cache->sides_option, num_options, options))
-    {
-     /*
-      * Map sides to duplex option...
-      */
-
-      if (!strcmp(sides, "one-sided") && cache->sides_1sided)
-        ppd_mark_option(ppd, cache->sides_option, cache->sides_1sided);
-      else if (!strcmp(sides, "two-sided-long-edge") &&
-               cache->sides_2sided_long)
-        ppd_mark_option(ppd, cache->sides_option, cache->sides_2sided_long);
-      else if (!strcmp(sides, "two-sided-short-edge") &&
-               cache->sides_2sided_short)
-        ppd_mark_option(ppd, cache->sides_option, cache->sides_2sided_short);
-    }
-  }
-
- /*
-  * Mark other options...
-  */
-
-  for (i = num_options, optptr = options; i > 0; i --, optptr ++)
-  {
-    if (!_cups_strcasecmp(optptr->name, "media") ||
-        !_cups_strcasecmp(optptr->name, "output-bin") ||
-	!_cups_strcasecmp(optptr->name, "output-mode") ||
-	!_cups_strcasecmp(optptr->name, "print-quality") ||
-	!_cups_strcasecmp(optptr->name, "sides"))
-      continue;
-    else if (!_cups_strcasecmp(optptr->name, "resolution") ||
-             !_cups_strcasecmp(optptr->name, "printer-resolution"))
-    {
-      ppd_mark_option(ppd, "Resolution", optptr->value);
-      ppd_mark_option(ppd, "SetResolution", optptr->value);
-      	/* Calcomp, Linotype, QMS, Summagraphics, Tektronix, Varityper */
-      ppd_mark_option(ppd, "JCLResolution", optptr->value);
-      	/* HP */
-      ppd_mark_option(ppd, "CNRes_PGP", optptr->value);
-      	/* Canon */
-    }
-    else if (!_cups_strcasecmp(optptr->name, "multiple-document-handling"))
-    {
-      if (!cupsGetOption("Collate", num_options, options) &&
-          ppdFindOption(ppd, "Collate"))
-      {
-        if (_cups_strcasecmp(optptr->value, "separate-documents-uncollated-copies"))
-	  ppd_mark_option(ppd, "Collate", "True");
-	else
-	  ppd_mark_option(ppd, "Collate", "False");
-      }
-    }
-    else if (!_cups_strcasecmp(optptr->name, "finishings"))
-    {
-     /*
-      * Lookup cupsIPPFinishings attributes for each value...
-      */
-
-      for (ptr = optptr->value; *ptr;)
-      {
-       /*
-        * Get the next finishings number...
-	*/
-
-        if (!isdigit(*ptr & 255))
-	  break;
-
-        if ((j = (int)strtol(ptr, &ptr, 10)) < 3)
-	  break;
-
-       /*
-        * Skip separator as needed...
-	*/
-
-        if (*ptr == ',')
-	  ptr ++;
-
-       /*
-        * Look it up in the PPD file...
-	*/
-
-	sprintf(s, "%d", j);
-
-        if ((attr = ppdFindAttr(ppd, "cupsIPPFinishings", s)) == NULL)
-	  continue;
-
-       /*
-        * Apply "*Option Choice" settings from the attribute value...
-	*/
-
-        ppd_mark_choices(ppd, attr->value);
-      }
-    }
-    else if (!_cups_strcasecmp(optptr->name, "APPrinterPreset"))
-    {
-     /*
-      * Lookup APPrinterPreset value...
-      */
-
-      if ((attr = ppdFindAttr(ppd, "APPrinterPreset", optptr->value)) != NULL)
-      {
-       /*
-        * Apply "*Option Choice" settings from the attribute value...
-	*/
-
-        ppd_mark_choices(ppd, attr->value);
-      }
-    }
-    else if (!_cups_strcasecmp(optptr->name, "mirror"))
-      ppd_mark_option(ppd, "MirrorPrint", optptr->value);
-    else
-      ppd_mark_option(ppd, optptr->name, optptr->value);
-  }
-
-  if (print_quality)
-  {
-    int pq = atoi(print_quality);       /* print-quaity value */
-
-    if (pq == IPP_QUALITY_DRAFT)
-      ppd_mark_option(ppd, "cupsPrintQuality", "Draft");
-    else if (pq == IPP_QUALITY_HIGH)
-      ppd_mark_option(ppd, "cupsPrintQuality", "High");
-    else
-      ppd_mark_option(ppd, "cupsPrintQuality", "Normal");
-  }
-
-  ppd_debug_marked(ppd, "After...");
+  ppd_mark_options(ppd, num_options, options);
 
   return (ppdConflicts(ppd) > 0);
 }
@@ -497,32 +208,10 @@ ppdIsMarked(ppd_file_t *ppd,		/* I - PPD file data */
 void
 ppdMarkDefaults(ppd_file_t *ppd)	/* I - PPD file record */
 {
-  int		i;			/* Looping variables */
-  ppd_group_t	*g;			/* Current group */
-  ppd_choice_t	*c;			/* Current choice */
-
-
   if (!ppd)
     return;
 
- /*
-  * Clean out the marked array...
-  */
-
-  for (c = (ppd_choice_t *)cupsArrayFirst(ppd->marked);
-       c;
-       c = (ppd_choice_t *)cupsArrayNext(ppd->marked))
-  {
-    cupsArrayRemove(ppd->marked, c);
-    c->marked = 0;
-  }
-
- /*
-  * Then repopulate it with the defaults...
-  */
-
-  for (i = ppd->num_groups, g = ppd->groups; i > 0; i --, g ++)
-    ppd_defaults(ppd, g);
+  ppd_mark_defaults(ppd);
 
  /*
   * Finally, tag any conflicts (API compatibility) once at the end.
@@ -602,6 +291,33 @@ ppdNextOption(ppd_file_t *ppd)		/* I - PPD file */
 }
 
 
+/*
+ * '_ppdMarkDefaultsAndOptions()' - Mark the default options and then the
+ *                                  command-line options in a PPD file.
+ *
+ * This is the same as calling @link ppdMarkDefaults@ followed by
+ * @link cupsMarkOptions@, but only checks for conflicts once after all of the
+ * options have been marked.
+ */
+
+int					/* O - 1 if conflicts exist, 0 otherwise */
+_ppdMarkDefaultsAndOptions(
+    ppd_file_t    *ppd,			/* I - PPD file */
+    int           num_options,		/* I - Number of options */
+    cups_option_t *options)		/* I - Options */
+{
+  if (!ppd)
+    return (0);
+
+  ppd_mark_defaults(ppd);
+
+  if (num_options > 0 && options)
+    ppd_mark_options(ppd, num_options, options);
+
+  return (ppdConflicts(ppd) > 0);
+}
+
+
 /*
  * '_ppdParseOptions()' - Parse options from a PPD file.
  *
@@ -759,6 +475,40 @@ ppd_mark_choices(ppd_file_t *ppd,	/* I - PPD file */
 }
 
 
+/*
+ * 'ppd_mark_defaults()' - Mark all default options without checking for
+ *                         conflicts.
+ */
+
+static void
+ppd_mark_defaults(ppd_file_t *ppd)	/* I - PPD file record */
+{
+  int		i;			/* Looping variables */
+  ppd_group_t	*g;			/* Current group */
+  ppd_choice_t	*c;			/* Current choice */
+
+
+ /*
+  * Clean out the marked array...
+  */
+
+  for (c = (ppd_choice_t *)cupsArrayFirst(ppd->marked);
+       c;
+       c = (ppd_choice_t *)cupsArrayNext(ppd->marked))
+  {
+    cupsArrayRemove(ppd->marked, c);
+    c->marked = 0;
+  }
+
+ /*
+  * Then repopulate it with the defaults...
+  */
+
+  for (i = ppd->num_groups, g = ppd->groups; i > 0; i --, g ++)
+    ppd_defaults(ppd, g);
+}
+
+
 /*
  * 'ppd_mark_option()' - Quick mark an option without checking for conflicts.
  */
@@ -976,123 +726,448 @@ ppd_mark_option(ppd_file_t *ppd,	/* I - PPD file */
 	}
       }
 
-      cupsFreeOptions(num_vals, vals);
+      cupsFreeOptions(num_vals, vals);
+    }
+  }
+  else
+  {
+    for (i = o->num_choices, c = o->choices; i > 0; i --, c ++)
+      if (!_cups_strcasecmp(c->choice, choice))
+        break;
+
+    if (!i)
+      return;
+
+    if (c->marked &&
+        _cups_strcasecmp(option, "PageSize") &&
+        _cups_strcasecmp(option, "PageRegion") &&
+        _cups_strcasecmp(option, "InputSlot") &&
+        _cups_strcasecmp(option, "ManualFeed"))
+    {
+     /*
+      * Choice is already marked and nothing else depends on it, so there is
+      * nothing to change...
+      */
+
+      return;
+    }
+  }
+
+ /*
+  * Option found; mark it and then handle unmarking any other options.
+  */
+
+  if (o->ui != PPD_UI_PICKMANY)
+  {
+   /*
+    * Unmark all other choices...
+    */
+
+    if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, c)) != NULL)
+    {
+      oldc->marked = 0;
+      cupsArrayRemove(ppd->marked, oldc);
+    }
+
+    if (!_cups_strcasecmp(option, "PageSize") || !_cups_strcasecmp(option, "PageRegion"))
+    {
+     /*
+      * Mark current page size...
+      */
+
+      for (j = 0; j < ppd->num_sizes; j ++)
+	ppd->sizes[j].marked = !_cups_strcasecmp(ppd->sizes[j].name,
+		                           choice);
+
+     /*
+      * Unmark the current PageSize or PageRegion setting, as
+      * appropriate...
+      */
+
+      cupsArraySave(ppd->options);
+
+      if (!_cups_strcasecmp(option, "PageSize"))
+      {
+	if ((o = ppdFindOption(ppd, "PageRegion")) != NULL)
+        {
+          key.option = o;
+          if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
+          {
+            oldc->marked = 0;
+            cupsArrayRemove(ppd->marked, oldc);
+          }
+        }
+      }
+      else
+      {
+	if ((o = ppdFindOption(ppd, "PageSize")) != NULL)
+        {
+          key.option = o;
+          if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
+          {
+            oldc->marked = 0;
+            cupsArrayRemove(ppd->marked, oldc);
+          }
+        }
+      }
+
+      cupsArrayRestore(ppd->options);
+    }
+    else if (!_cups_strcasecmp(option, "InputSlot"))
+    {
+     /*
+      * Unmark ManualFeed option...
+      */
+
+      cupsArraySave(ppd->options);
+
+      if ((o = ppdFindOption(ppd, "ManualFeed")) != NULL)
+      {
+        key.option = o;
+        if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
+        {
+          oldc->marked = 0;
+          cupsArrayRemove(ppd->marked, oldc);
+        }
+      }
+
+      cupsArrayRestore(ppd->options);
+    }
+    else if (!_cups_strcasecmp(option, "ManualFeed") &&
+	     !_cups_strcasecmp(choice, "True"))
+    {
+     /*
+      * Unmark InputSlot option...
+      */
+
+      cupsArraySave(ppd->options);
+
+      if ((o = ppdFindOption(ppd, "InputSlot")) != NULL)
+      {
+        key.option = o;
+        if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
+        {
+          oldc->marked = 0;
+          cupsArrayRemove(ppd->marked, oldc);
+        }
+      }
+
+      cupsArrayRestore(ppd->options);
+    }
+  }
+
+  c->marked = 1;
+
+  cupsArrayAdd(ppd->marked, c);
+}
+
+
+/*
+ * 'ppd_mark_options()' - Mark command-line options without checking for
+ *                        conflicts.
+ */
+
+static void
+ppd_mark_options(
+    ppd_file_t    *ppd,			/* I - PPD file */
+    int           num_options,		/* I - Number of options */
+    cups_option_t *options)		/* I - Options */
+{
+  int		i, j;			/* Looping vars */
+  char		*ptr,			/* Pointer into string */
+		s[255];			/* Temporary string */
+  const char	*val,			/* Pointer into value */
+		*media,			/* media option */
+		*output_bin,		/* output-bin option */
+		*page_size,		/* PageSize option */
+		*ppd_keyword,		/* PPD keyword */
+		*print_color_mode,	/* print-color-mode option */
+		*print_quality,		/* print-quality option */
+		*sides;			/* sides option */
+  cups_option_t	*optptr;		/* Current option */
+  ppd_attr_t	*attr;			/* PPD attribute */
+  _ppd_cache_t	*cache;			/* PPD cache and mapping data */
+
+
+  ppd_debug_marked(ppd, "Before...");
+
+ /*
+  * Do special handling for finishings, media, output-bin, output-mode,
+  * print-color-mode, print-quality, and PageSize...
+  */
+
+  media         = cupsGetOption("media", num_options, options);
+  output_bin    = cupsGetOption("output-bin", num_options, options);
+  page_size     = cupsGetOption("PageSize", num_options, options);
+  print_quality = cupsGetOption("print-quality", num_options, options);
+  sides         = cupsGetOption("sides", num_options, options);
+
+  if ((print_color_mode = cupsGetOption("print-color-mode", num_options,
+                                        options)) == NULL)
+    print_color_mode = cupsGetOption("output-mode", num_options, options);
+
+  if ((media || output_bin || print_color_mode || print_quality || sides) &&
+      !ppd->cache)
+  {
+   /*
+    * Load PPD cache and mapping data as needed...
+    */
+
+    ppd->cache = _ppdCacheCreateWithPPD(ppd);
+  }
+
+  cache = ppd->cache;
+
+  if (media)
+  {
+   /*
+    * Loop through the option string, separating it at commas and marking each
+    * individual option as long as the corresponding PPD option (PageSize,
+    * InputSlot, etc.) is not also set.
+    *
+    * For PageSize, we also check for an empty option value since some versions
+    * of macOS use it to specify auto-selection of the media based solely on
+    * the size.
+    */
+
+    for (val = media; *val;)
+    {
+     /*
+      * Extract the sub-option from the string...
+      */
+
+      for (ptr = s; *val && *val != ',' && (size_t)(ptr - s) < (sizeof(s) - 1);)
+	*ptr++ = *val++;
+      *ptr++ = '\0';
+
+      if (*val == ',')
+	val ++;
+
+     /*
+      * Mark it...
+      */
+
+      if (!page_size || !page_size[0])
+      {
+        if (!_cups_strncasecmp(s, "Custom.", 7) || ppdPageSize(ppd, s))
+          ppd_mark_option(ppd, "PageSize", s);
+        else if ((ppd_keyword = _ppdCacheGetPageSize(cache, NULL, s, NULL)) != NULL)
+	  ppd_mark_option(ppd, "PageSize", ppd_keyword);
+      }
+
+      if (cache && cache->source_option &&
+          !cupsGetOption(cache->source_option, num_options, options) &&
+	  (ppd_keyword = _ppdCacheGetInputSlot(cache, NULL, s)) != NULL)
+	ppd_mark_option(ppd, cache->source_option, ppd_keyword);
+
+      if (!cupsGetOption("MediaType", num_options, options) &&
+	  (ppd_keyword = _ppdCacheGetMediaType(cache, NULL, s)) != NULL)
+	ppd_mark_option(ppd, "MediaType", ppd_keyword);
     }
   }
-  else
+
+  if (cache)
   {
-    for (i = o->num_choices, c = o->choices; i > 0; i --, c ++)
-      if (!_cups_strcasecmp(c->choice, choice))
-        break;
+    if (!cupsGetOption("com.apple.print.DocumentTicket.PMSpoolFormat",
+                       num_options, options) &&
+        !cupsGetOption("APPrinterPreset", num_options, options) &&
+        (print_color_mode || print_quality))
+    {
+     /*
+      * Map output-mode and print-quality to a preset...
+      */
 
-    if (!i)
-      return;
-  }
+      _pwg_print_color_mode_t	pwg_pcm;/* print-color-mode index */
+      _pwg_print_quality_t	pwg_pq;	/* print-quality index */
+      cups_option_t		*preset;/* Current preset option */
 
- /*
-  * Option found; mark it and then handle unmarking any other options.
-  */
+      if (print_color_mode && !strcmp(print_color_mode, "monochrome"))
+	pwg_pcm = _PWG_PRINT_COLOR_MODE_MONOCHROME;
+      else
+	pwg_pcm = _PWG_PRINT_COLOR_MODE_COLOR;
 
-  if (o->ui != PPD_UI_PICKMANY)
-  {
-   /*
-    * Unmark all other choices...
-    */
+      if (print_quality)
+      {
+	pwg_pq = (_pwg_print_quality_t)(atoi(print_quality) - IPP_QUALITY_DRAFT);
+	if (pwg_pq < _PWG_PRINT_QUALITY_DRAFT)
+	  pwg_pq = _PWG_PRINT_QUALITY_DRAFT;
+	else if (pwg_pq > _PWG_PRINT_QUALITY_HIGH)
+	  pwg_pq = _PWG_PRINT_QUALITY_HIGH;
+      }
+      else
+	pwg_pq = _PWG_PRINT_QUALITY_NORMAL;
 
-    if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, c)) != NULL)
-    {
-      oldc->marked = 0;
-      cupsArrayRemove(ppd->marked, oldc);
+      if (cache->num_presets[pwg_pcm][pwg_pq] == 0)
+      {
+       /*
+	* Try to find a preset that works so that we maximize the chances of us
+	* getting a good print using IPP attributes.
+	*/
+
+	if (cache->num_presets[pwg_pcm][_PWG_PRINT_QUALITY_NORMAL] > 0)
+	  pwg_pq = _PWG_PRINT_QUALITY_NORMAL;
+	else if (cache->num_presets[_PWG_PRINT_COLOR_MODE_COLOR][pwg_pq] > 0)
+	  pwg_pcm = _PWG_PRINT_COLOR_MODE_COLOR;
+	else
+	{
+	  pwg_pq  = _PWG_PRINT_QUALITY_NORMAL;
+	  pwg_pcm = _PWG_PRINT_COLOR_MODE_COLOR;
+	}
+      }
+
+      if (cache->num_presets[pwg_pcm][pwg_pq] > 0)
+      {
+       /*
+	* Copy the preset options as long as the corresponding names are not
+	* already defined in the IPP request...
+	*/
+
+	for (i = cache->num_presets[pwg_pcm][pwg_pq],
+		 preset = cache->presets[pwg_pcm][pwg_pq];
+	     i > 0;
+	     i --, preset ++)
+	{
+	  if (!cupsGetOption(preset->name, num_options, options))
+	    ppd_mark_option(ppd, preset->name, preset->value);
+	}
+      }
     }
 
-    if (!_cups_strcasecmp(option, "PageSize") || !_cups_strcasecmp(option, "PageRegion"))
+    if (output_bin && !cupsGetOption("OutputBin", num_options, options) &&
+	(ppd_keyword = _ppdCacheGetOutputBin(cache, output_bin)) != NULL)
     {
      /*
-      * Mark current page size...
+      * Map output-bin to OutputBin...
       */
 
-      for (j = 0; j < ppd->num_sizes; j ++)
-	ppd->sizes[j].marked = !_cups_strcasecmp(ppd->sizes[j].name,
-		                           choice);
+      ppd_mark_option(ppd, "OutputBin", ppd_keyword);
+    }
 
+    if (sides && cache->sides_option &&
+        !cupsGetOption(cache->sides_option, num_options, options))
+    {
      /*
-      * Unmark the current PageSize or PageRegion setting, as
-      * appropriate...
+      * Map sides to duplex option...
       */
 
-      cupsArraySave(ppd->options);
+      if (!strcmp(sides, "one-sided") && cache->sides_1sided)
+        ppd_mark_option(ppd, cache->sides_option, cache->sides_1sided);
+      else if (!strcmp(sides, "two-sided-long-edge") &&
+               cache->sides_2sided_long)
+        ppd_mark_option(ppd, cache->sides_option, cache->sides_2sided_long);
+      else if (!strcmp(sides, "two-sided-short-edge") &&
+               cache->sides_2sided_short)
+        ppd_mark_option(ppd, cache->sides_option, cache->sides_2sided_short);
+    }
+  }
 
-      if (!_cups_strcasecmp(option, "PageSize"))
-      {
-	if ((o = ppdFindOption(ppd, "PageRegion")) != NULL)
-        {
-          key.option = o;
-          if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
-          {
-            oldc->marked = 0;
-            cupsArrayRemove(ppd->marked, oldc);
-          }
-        }
-      }
-      else
+ /*
+  * Mark other options...
+  */
+
+  for (i = num_options, optptr = options; i > 0; i --, optptr ++)
+  {
+    if (!_cups_strcasecmp(optptr->name, "media") ||
+        !_cups_strcasecmp(optptr->name, "output-bin") ||
+	!_cups_strcasecmp(optptr->name, "output-mode") ||
+	!_cups_strcasecmp(optptr->name, "print-quality") ||
+	!_cups_strcasecmp(optptr->name, "sides"))
+      continue;
+    else if (!_cups_strcasecmp(optptr->name, "resolution") ||
+             !_cups_strcasecmp(optptr->name, "printer-resolution"))
+    {
+      ppd_mark_option(ppd, "Resolution", optptr->value);
+      ppd_mark_option(ppd, "SetResolution", optptr->value);
+      	/* Calcomp, Linotype, QMS, Summagraphics, Tektronix, Varityper */
+      ppd_mark_option(ppd, "JCLResolution", optptr->value);
+      	/* HP */
+      ppd_mark_option(ppd, "CNRes_PGP", optptr->value);
+      	/* Canon */
+    }
+    else if (!_cups_strcasecmp(optptr->name, "multiple-document-handling"))
+    {
+      if (!cupsGetOption("Collate", num_options, options) &&
+          ppdFindOption(ppd, "Collate"))
       {
-	if ((o = ppdFindOption(ppd, "PageSize")) != NULL)
-        {
-          key.option = o;
-          if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
-          {
-            oldc->marked = 0;
-            cupsArrayRemove(ppd->marked, oldc);
-          }
-        }
+        if (_cups_strcasecmp(optptr->value, "separate-documents-uncollated-copies"))
+	  ppd_mark_option(ppd, "Collate", "True");
+	else
+	  ppd_mark_option(ppd, "Collate", "False");
       }
-
-      cupsArrayRestore(ppd->options);
     }
-    else if (!_cups_strcasecmp(option, "InputSlot"))
+    else if (!_cups_strcasecmp(optptr->name, "finishings"))
     {
      /*
-      * Unmark ManualFeed option...
+      * Lookup cupsIPPFinishings attributes for each value...
       */
 
-      cupsArraySave(ppd->options);
-
-      if ((o = ppdFindOption(ppd, "ManualFeed")) != NULL)
+      for (ptr = optptr->value; *ptr;)
       {
-        key.option = o;
-        if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
-        {
-          oldc->marked = 0;
-          cupsArrayRemove(ppd->marked, oldc);
-        }
-      }
+       /*
+        * Get the next finishings number...
+	*/
 
-      cupsArrayRestore(ppd->options);
+        if (!isdigit(*ptr & 255))
+	  break;
+
+        if ((j = (int)strtol(ptr, &ptr, 10)) < 3)
+	  break;
+
+       /*
+        * Skip separator as needed...
+	*/
+
+        if (*ptr == ',')
+	  ptr ++;
+
+       /*
+        * Look it up in the PPD file...
+	*/
+
+	sprintf(s, "%d", j);
+
+        if ((attr = ppdFindAttr(ppd, "cupsIPPFinishings", s)) == NULL)
+	  continue;
+
+       /*
+        * Apply "*Option Choice" settings from the attribute value...
+	*/
+
+        ppd_mark_choices(ppd, attr->value);
+      }
     }
-    else if (!_cups_strcasecmp(option, "ManualFeed") &&
-	     !_cups_strcasecmp(choice, "True"))
+    else if (!_cups_strcasecmp(optptr->name, "APPrinterPreset"))
     {
      /*
-      * Unmark InputSlot option...
+      * Lookup APPrinterPreset value...
       */
 
-      cupsArraySave(ppd->options);
-
-      if ((o = ppdFindOption(ppd, "InputSlot")) != NULL)
+      if ((attr = ppdFindAttr(ppd, "APPrinterPreset", optptr->value)) != NULL)
       {
-        key.option = o;
-        if ((oldc = (ppd_choice_t *)cupsArrayFind(ppd->marked, &key)) != NULL)
-        {
-          oldc->marked = 0;
-          cupsArrayRemove(ppd->marked, oldc);
-        }
-      }
+       /*
+        * Apply "*Option Choice" settings from the attribute value...
+	*/
 
-      cupsArrayRestore(ppd->options);
+        ppd_mark_choices(ppd, attr->value);
+      }
     }
+    else if (!_cups_strcasecmp(optptr->name, "mirror"))
+      ppd_mark_option(ppd, "MirrorPrint", optptr->value);
+    else
+      ppd_mark_option(ppd, optptr->name, optptr->value);
   }
 
-  c->marked = 1;
+  if (print_quality)
+  {
+    int pq = atoi(print_quality);       /* print-quaity value */
 
-  cupsArrayAdd(ppd->marked, c);
+    if (pq == IPP_QUALITY_DRAFT)
+      ppd_mark_option(ppd, "cupsPrintQuality", "Draft");
+    else if (pq == IPP_QUALITY_HIGH)
+      ppd_mark_option(ppd, "cupsPrintQuality", "High");
+    else
+      ppd_mark_option(ppd, "cupsPrintQuality", "Normal");
+  }
+
+  ppd_debug_marked(ppd, "After...");
 }
@@ -107,6 +107,19 @@ typedef struct _pwg_finishings_s	/**** PWG finishings mapping data ****/
   cups_option_t		*options;	/* Options to apply */
 } _pwg_finishings_t;
 
+typedef struct _ppd_index_s		/**** Hash index of PWG mapping names ****/
+{
+  int		num_elements,		/* Number of elements indexed */
+		num_buckets,		/* Number of buckets (power of 2) */
+		*buckets;		/* Element number + 1 or 0 if empty */
+} _ppd_index_t;
+
+typedef struct _ppd_size_order_s	/**** Media size sorted by width ****/
+{
+  int		width,			/* Width in hundredths of millimeters */
+		index;			/* Index in sizes array */
+} _ppd_size_order_t;
+
 struct _ppd_cache_s			/**** PPD cache and PWG conversion data ****/
 {
   int		num_bins;		/* Number of output bins */
@@ -148,6 +161,15 @@ struct _ppd_cache_s			/**** PPD cache and PWG conversion data ****/
   char		*charge_info_uri;	/* cupsChargeInfoURI value */
   cups_array_t	*strings;		/* Localization strings */
   cups_array_t	*support_files;		/* Support files - ICC profiles, etc. */
+  _ppd_index_t	bins_ppd,		/* Output bins by PPD name */
+		bins_pwg,		/* Output bins by PWG name */
+		sizes_names,		/* Media sizes by PPD and PWG names */
+		sources_ppd,		/* Media sources by PPD name */
+		sources_pwg,		/* Media sources by PWG name */
+		types_ppd,		/* Media types by PPD name */
+		types_pwg;		/* Media types by PWG name */
+  int		num_size_order;		/* Number of sizes in size_order */
+  _ppd_size_order_t *size_order;	/* Media sizes sorted by width */
 };
 
 
@@ -195,6 +217,9 @@ extern _ppd_globals_t	*_ppdGlobals(void) _CUPS_PRIVATE;
 extern unsigned		_ppdHashName(const char *name) _CUPS_PRIVATE;
 extern ppd_attr_t	*_ppdLocalizedAttr(ppd_file_t *ppd, const char *keyword,
 			                   const char *spec, const char *ll_CC) _CUPS_PRIVATE;
+extern int		_ppdMarkDefaultsAndOptions(ppd_file_t *ppd,
+			                           int num_options,
+			                           cups_option_t *options) _CUPS_PRIVATE;
 extern char		*_ppdNormalizeMakeAndModel(const char *make_and_model,
 			                           char *buffer,
 						   size_t bufsize) _CUPS_PRIVATE;
@@ -202,9 +227,13 @@ extern ppd_file_t	*_ppdOpen(cups_file_t *fp,
 				  _ppd_localization_t localization) _CUPS_PRIVATE;
 extern ppd_file_t	*_ppdOpenFile(const char *filename,
 				      _ppd_localization_t localization) _CUPS_PRIVATE;
+extern ppd_file_t	*_ppdOpenSnapshot(const char *snapfile,
+			                  const char *ppdfile) _CUPS_PRIVATE;
 extern int		_ppdParseOptions(const char *s, int num_options,
 			                 cups_option_t **options,
 					 _ppd_parse_t which) _CUPS_PRIVATE;
+extern int		_ppdWriteSnapshot(ppd_file_t *ppd, const char *ppdfile,
+			                  const char *snapfile) _CUPS_PRIVATE;
 extern const char	*_pwgInputSlotForSource(const char *media_source,
 			                        char *name, size_t namesize) _CUPS_PRIVATE;
 extern const char	*_pwgMediaTypeForType(const char *media_type,
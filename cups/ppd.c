@@ -17,6 +17,12 @@
 #include "cups-private.h"
 #include "ppd-private.h"
 #include "debug-internal.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#  include <sys/mman.h>
+#  define PPD_SNAP_MMAP	1		/* Snapshots can be mapped */
+#endif /* !_WIN32 */
 
 
 /*
@@ -30,18 +36,58 @@
 
 #define PPD_HASHSIZE	512		/* Size of hash */
 
+#define PPD_READSIZE	65536		/* Size of input blocks */
+
+#define PPD_SNAP_MAGIC	"PPDSNAP1"	/* Snapshot file magic */
+#define PPD_SNAP_ORDER	0x01020304	/* Snapshot byte order and version */
+
+#define ppd_getc(l)	((l)->ptr < (l)->end ? (*(l)->ptr++ & 255) : ppd_fill((l), 1))
+#define ppd_peekc(l)	((l)->ptr < (l)->end ? (*(l)->ptr & 255) : ppd_fill((l), 0))
+
 
 /*
  * Line buffer structure...
+ *
+ * The file is read in large blocks and scanned from memory rather than one
+ * cupsFileGetChar() call per byte.
  */
 
 typedef struct _ppd_line_s
 {
   char		*buffer;		/* Pointer to buffer */
   size_t	bufsize;		/* Size of the buffer */
+  cups_file_t	*fp;			/* File being read */
+  char		*data;			/* Input block */
+  const char	*ptr,			/* Next input byte */
+		*end;			/* End of input block */
 } _ppd_line_t;
 
 
+/*
+ * Snapshot header and reader structures...
+ *
+ * A snapshot holds the structures of a parsed PPD file in host byte order and
+ * layout, so the header records the structure sizes along with the size, time
+ * and inode of the PPD file it was made from.
+ */
+
+typedef struct _ppd_snap_header_s
+{
+  char		magic[8];		/* PPD_SNAP_MAGIC */
+  unsigned	order,			/* PPD_SNAP_ORDER */
+		sizes[11];		/* Sizes of PPD structures */
+  long long	ppd_size,		/* Size of PPD file */
+		ppd_mtime,		/* Modification time of PPD file */
+		ppd_ino;		/* Inode of PPD file */
+} _ppd_snap_header_t;
+
+typedef struct _ppd_snap_s
+{
+  const char	*ptr,			/* Next byte */
+		*end;			/* End of snapshot */
+} _ppd_snap_t;
+
+
 /*
  * Local globals...
  */
@@ -52,6 +98,17 @@ static _cups_threadkey_t ppd_globals_key = _CUPS_THREADKEY_INITIALIZER;
 static pthread_once_t	ppd_globals_key_once = PTHREAD_ONCE_INIT;
 					/* One-time initialization object */
 #endif /* HAVE_PTHREAD_H */
+static const size_t	ppd_snap_fields[] =
+			{		/* Strings shared with attributes */
+			  offsetof(ppd_file_t, lang_version),
+			  offsetof(ppd_file_t, manufacturer),
+			  offsetof(ppd_file_t, modelname),
+			  offsetof(ppd_file_t, pcfilename),
+			  offsetof(ppd_file_t, product),
+			  offsetof(ppd_file_t, protocols),
+			  offsetof(ppd_file_t, shortnickname),
+			  offsetof(ppd_file_t, ttrasterizer)
+			};
 
 
 /*
@@ -69,6 +126,9 @@ static int		ppd_compare_coptions(ppd_coption_t *a,
 			                     ppd_coption_t *b);
 static int		ppd_compare_options(ppd_option_t *a, ppd_option_t *b);
 static int		ppd_decode(char *string);
+static int		ppd_default_localization(char *ll_CC,
+			                         size_t ll_CC_size, char *ll,
+						 size_t ll_size);
 static void		ppd_free_filters(ppd_file_t *ppd);
 static void		ppd_free_group(ppd_group_t *group);
 static void		ppd_free_option(ppd_option_t *option);
@@ -87,11 +147,29 @@ static void		ppd_globals_free(_ppd_globals_t *g);
 #ifdef HAVE_PTHREAD_H
 static void		ppd_globals_init(void);
 #endif /* HAVE_PTHREAD_H */
+static int		ppd_fill(_ppd_line_t *line, int consume);
 static int		ppd_hash_option(ppd_option_t *option);
-static int		ppd_read(cups_file_t *fp, _ppd_line_t *line,
+static int		ppd_is_localization(const char *keyword);
+static int		ppd_read(_ppd_line_t *line,
 			         char *keyword, char *option, char *text,
 				 char **string, int ignoreblank,
 				 _ppd_globals_t *pg);
+static int		ppd_snap_get(_ppd_snap_t *snap, void *data,
+			             size_t bytes);
+static int		ppd_snap_get_array(_ppd_snap_t *snap, void **array,
+			                   int num_elements, size_t size);
+static int		ppd_snap_get_group(_ppd_snap_t *snap,
+			                   ppd_group_t *group);
+static int		ppd_snap_get_string(_ppd_snap_t *snap, char **s);
+static int		ppd_snap_get_strings(_ppd_snap_t *snap, char ***array,
+			                     int num_strings);
+static void		ppd_snap_header(_ppd_snap_header_t *header,
+			                struct stat *fileinfo);
+static int		ppd_snap_put(cups_file_t *fp, const void *data,
+			             size_t bytes);
+static int		ppd_snap_put_group(cups_file_t *fp,
+			                   ppd_group_t *group);
+static int		ppd_snap_put_string(cups_file_t *fp, const char *s);
 static int		ppd_update_filters(ppd_file_t *ppd,
 			                   _ppd_globals_t *pg);
 
@@ -251,6 +329,7 @@ ppdClose(ppd_file_t *ppd)		/* I - PPD file record */
       free(consts);
     }
 
+    cupsArrayDelete(cupsArrayUserData(ppd->cups_uiconstraints));
     cupsArrayDelete(ppd->cups_uiconstraints);
   }
 
@@ -438,7 +517,6 @@ _ppdOpen(
   char			**filter;	/* Pointer to filter */
   struct lconv		*loc;		/* Locale data */
   int			ui_keyword;	/* Is this line a UI keyword? */
-  cups_lang_t		*lang;		/* Language data */
   cups_encoding_t	encoding;	/* Encoding of PPD file */
   _ppd_globals_t	*pg = _ppdGlobals();
 					/* Global data */
@@ -542,38 +620,9 @@ _ppdOpen(
 
   if (localization == _PPD_LOCALIZATION_DEFAULT)
   {
-    if ((lang = cupsLangDefault()) == NULL)
+    if (!ppd_default_localization(ll_CC, sizeof(ll_CC), ll, sizeof(ll)))
       return (NULL);
 
-    snprintf(ll_CC, sizeof(ll_CC), "%s.", lang->language);
-
-   /*
-    * <rdar://problem/22130168>
-    * <rdar://problem/27245567>
-    *
-    * Need to use a different base language for some locales...
-    */
-
-    if (!strcmp(lang->language, "zh_HK"))
-    {					/* Traditional Chinese + variants */
-      strlcpy(ll_CC, "zh_TW.", sizeof(ll_CC));
-      strlcpy(ll, "zh_", sizeof(ll));
-    }
-    else if (!strncmp(lang->language, "zh", 2))
-      strlcpy(ll, "zh_", sizeof(ll));	/* Any Chinese variant */
-    else if (!strncmp(lang->language, "jp", 2))
-    {					/* Any Japanese variant */
-      strlcpy(ll_CC, "ja", sizeof(ll_CC));
-      strlcpy(ll, "jp", sizeof(ll));
-    }
-    else if (!strncmp(lang->language, "nb", 2) || !strncmp(lang->language, "no", 2))
-    {					/* Any Norwegian variant */
-      strlcpy(ll_CC, "nb", sizeof(ll_CC));
-      strlcpy(ll, "no", sizeof(ll));
-    }
-    else
-      snprintf(ll, sizeof(ll), "%2.2s.", lang->language);
-
     ll_CC_len = strlen(ll_CC);
     ll_len    = strlen(ll);
 
@@ -585,10 +634,10 @@ _ppdOpen(
   * Grab the first line and make sure it reads '*PPD-Adobe: "major.minor"'...
   */
 
-  line.buffer  = NULL;
-  line.bufsize = 0;
+  memset(&line, 0, sizeof(line));
+  line.fp = fp;
 
-  mask = ppd_read(fp, &line, keyword, name, text, &string, 0, pg);
+  mask = ppd_read(&line, keyword, name, text, &string, 0, pg);
 
   DEBUG_printf(("2_ppdOpen: mask=%x, keyword=\"%s\"...", mask, keyword));
 
@@ -605,6 +654,7 @@ _ppdOpen(
 
     free(string);
     free(line.buffer);
+    free(line.data);
 
     return (NULL);
   }
@@ -621,6 +671,7 @@ _ppdOpen(
 
     free(string);
     free(line.buffer);
+    free(line.data);
 
     return (NULL);
   }
@@ -646,7 +697,7 @@ _ppdOpen(
   encoding   = CUPS_ISO8859_1;
   loc        = localeconv();
 
-  while ((mask = ppd_read(fp, &line, keyword, name, text, &string, 1, pg)) != 0)
+  while ((mask = ppd_read(&line, keyword, name, text, &string, 1, pg)) != 0)
   {
     DEBUG_printf(("2_ppdOpen: mask=%x, keyword=\"%s\", name=\"%s\", "
                   "text=\"%s\", string=%d chars...", mask, keyword, name, text,
@@ -691,13 +742,7 @@ _ppdOpen(
     */
 
     if (localization != _PPD_LOCALIZATION_ALL &&
-        (temp = strchr(keyword, '.')) != NULL &&
-        ((temp - keyword) == 2 || (temp - keyword) == 5) &&
-        _cups_isalpha(keyword[0]) &&
-        _cups_isalpha(keyword[1]) &&
-        (keyword[2] == '.' ||
-         (keyword[2] == '_' && _cups_isalpha(keyword[3]) &&
-          _cups_isalpha(keyword[4]) && keyword[5] == '.')))
+        ppd_is_localization(keyword))
     {
       if (localization == _PPD_LOCALIZATION_NONE ||
 	  (localization == _PPD_LOCALIZATION_DEFAULT &&
@@ -715,6 +760,8 @@ _ppdOpen(
         * Only load localizations for the color profile related keywords...
         */
 
+        temp = strchr(keyword, '.');
+
 	for (i = 0;
 	     i < (int)(sizeof(color_keywords) / sizeof(color_keywords[0]));
 	     i ++)
@@ -2013,6 +2060,7 @@ _ppdOpen(
   }
 
   free(line.buffer);
+  free(line.data);
 
  /*
   * Reset language preferences...
@@ -2096,6 +2144,7 @@ _ppdOpen(
 
   free(string);
   free(line.buffer);
+  free(line.data);
 
   ppdClose(ppd);
 
@@ -2258,10 +2307,383 @@ _ppdOpenFile(const char		  *filename,	/* I - File to read from */
 ppd_file_t *				/* O - PPD file record or @code NULL@ if the PPD file could not be opened. */
 ppdOpenFile(const char *filename)	/* I - File to read from */
 {
+  const char	*snapfile,		/* Snapshot filename */
+		*ppdenv;		/* PPD environment variable */
+  ppd_file_t	*ppd;			/* PPD file record */
+
+
+ /*
+  * Filters started by the scheduler get a parsed snapshot of the printer's
+  * PPD file in the PPD_SNAPSHOT environment variable - use it when opening
+  * that same file...
+  */
+
+  if (filename && (snapfile = getenv("PPD_SNAPSHOT")) != NULL && (ppdenv = getenv("PPD")) != NULL && !strcmp(filename, ppdenv) && (ppd = _ppdOpenSnapshot(snapfile, filename)) != NULL)
+    return (ppd);
+
   return _ppdOpenFile(filename, _PPD_LOCALIZATION_DEFAULT);
 }
 
 
+/*
+ * '_ppdOpenSnapshot()' - Load a PPD file from a snapshot.
+ *
+ * The snapshot must have been written by @link _ppdWriteSnapshot@ for the
+ * current version of "ppdfile".  Localizations are filtered for the current
+ * locale as for @link ppdOpenFile@.  @code NULL@ is returned if the snapshot
+ * is missing, stale, or unusable so that the caller can load the PPD file
+ * instead.
+ */
+
+ppd_file_t *				/* O - PPD file record or @code NULL@ */
+_ppdOpenSnapshot(const char *snapfile,	/* I - Snapshot file */
+                 const char *ppdfile)	/* I - PPD file it was made from */
+{
+#ifdef PPD_SNAP_MMAP
+  int			fd;		/* Snapshot file descriptor */
+  struct stat		snapinfo,	/* Snapshot file information */
+			ppdinfo;	/* PPD file information */
+  void			*data;		/* Mapped snapshot */
+  size_t		datalen;	/* Length of snapshot */
+  _ppd_snap_header_t	header;		/* Expected header */
+  _ppd_snap_t		snap;		/* Snapshot reader */
+  ppd_file_t		temp,		/* Stored PPD file record */
+			*ppd;		/* PPD file record */
+  int			i, j,		/* Looping vars */
+			fields[8],	/* Attribute indices for strings */
+			num_attrs,	/* Number of stored attributes */
+			num_coptions,	/* Number of custom options */
+			num_cparams;	/* Number of custom parameters */
+  ppd_group_t		*group;		/* Current group */
+  ppd_option_t		*option;	/* Current option */
+  ppd_attr_t		*attr;		/* Current attribute */
+  ppd_coption_t		*coption;	/* Current custom option */
+  ppd_cparam_t		*cparam;	/* Current custom parameter */
+  char			ll[7],		/* Base language + '.' */
+			ll_CC[7];	/* Language w/country + '.' */
+  size_t		ll_len,		/* Base language length */
+			ll_CC_len;	/* Language w/country length */
+  _ppd_globals_t	*pg = _ppdGlobals();
+					/* Global data */
+
+
+  if (!snapfile || !ppdfile || stat(ppdfile, &ppdinfo))
+    return (NULL);
+
+  if ((fd = open(snapfile, O_RDONLY)) < 0)
+    return (NULL);
+
+  if (fstat(fd, &snapinfo) || snapinfo.st_size < (off_t)(sizeof(_ppd_snap_header_t) + sizeof(ppd_file_t)))
+  {
+    close(fd);
+    return (NULL);
+  }
+
+  datalen = (size_t)snapinfo.st_size;
+  data    = mmap(NULL, datalen, PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return (NULL);
+
+ /*
+  * Validate the header against the current PPD file...
+  */
+
+  ppd_snap_header(&header, &ppdinfo);
+
+  if (memcmp(data, &header, sizeof(header)))
+  {
+    DEBUG_printf(("1_ppdOpenSnapshot: \"%s\" does not match \"%s\".", snapfile, ppdfile));
+    munmap(data, datalen);
+    return (NULL);
+  }
+
+  if (!ppd_default_localization(ll_CC, sizeof(ll_CC), ll, sizeof(ll)) || (ppd = calloc(1, sizeof(ppd_file_t))) == NULL)
+  {
+    munmap(data, datalen);
+    return (NULL);
+  }
+
+  ll_CC_len = strlen(ll_CC);
+  ll_len    = strlen(ll);
+
+  snap.ptr = (const char *)data + sizeof(header);
+  snap.end = (const char *)data + datalen;
+
+ /*
+  * Copy the scalar values from the stored record; every pointer and count
+  * is filled in as the corresponding data is read so that ppdClose can clean
+  * up after a failure at any point...
+  */
+
+  ppd_snap_get(&snap, &temp, sizeof(temp));
+
+  ppd->language_level   = temp.language_level;
+  ppd->color_device     = temp.color_device;
+  ppd->variable_sizes   = temp.variable_sizes;
+  ppd->accurate_screens = temp.accurate_screens;
+  ppd->contone_only     = temp.contone_only;
+  ppd->landscape        = temp.landscape;
+  ppd->model_number     = temp.model_number;
+  ppd->manual_copies    = temp.manual_copies;
+  ppd->throughput       = temp.throughput;
+  ppd->colorspace       = temp.colorspace;
+  ppd->flip_duplex      = temp.flip_duplex;
+
+  memcpy(ppd->custom_min, temp.custom_min, sizeof(ppd->custom_min));
+  memcpy(ppd->custom_max, temp.custom_max, sizeof(ppd->custom_max));
+  memcpy(ppd->custom_margins, temp.custom_margins, sizeof(ppd->custom_margins));
+
+  if (!ppd_snap_get_string(&snap, &ppd->lang_encoding) || !ppd_snap_get_string(&snap, &ppd->nickname) || !ppd_snap_get_string(&snap, &ppd->patches) || !ppd_snap_get_string(&snap, &ppd->jcl_begin) || !ppd_snap_get_string(&snap, &ppd->jcl_end) || !ppd_snap_get_string(&snap, &ppd->jcl_ps))
+    goto error;
+
+  if (!ppd_snap_get_array(&snap, (void **)&ppd->emulations, temp.num_emulations, sizeof(ppd_emul_t)))
+    goto error;
+
+  ppd->num_emulations = temp.num_emulations;
+
+  for (i = 0; i < ppd->num_emulations; i ++)
+    ppd->emulations[i].start = ppd->emulations[i].stop = NULL;
+
+ /*
+  * Groups, options, and choices...
+  */
+
+  if (temp.num_groups < 0 || (size_t)temp.num_groups > (size_t)(snap.end - snap.ptr) / sizeof(ppd_group_t))
+    goto error;
+
+  if (temp.num_groups > 0)
+  {
+    if ((ppd->groups = calloc((size_t)temp.num_groups, sizeof(ppd_group_t))) == NULL)
+      goto error;
+
+    for (group = ppd->groups; ppd->num_groups < temp.num_groups; group ++)
+    {
+      ppd->num_groups ++;
+
+      if (!ppd_snap_get_group(&snap, group))
+        goto error;
+    }
+  }
+
+ /*
+  * Sizes, constraints, profiles, fonts, and filters...
+  */
+
+  if (!ppd_snap_get_array(&snap, (void **)&ppd->sizes, temp.num_sizes, sizeof(ppd_size_t)))
+    goto error;
+
+  ppd->num_sizes = temp.num_sizes;
+
+  if (!ppd_snap_get_array(&snap, (void **)&ppd->consts, temp.num_consts, sizeof(ppd_const_t)))
+    goto error;
+
+  ppd->num_consts = temp.num_consts;
+
+  if (!ppd_snap_get_array(&snap, (void **)&ppd->profiles, temp.num_profiles, sizeof(ppd_profile_t)))
+    goto error;
+
+  ppd->num_profiles = temp.num_profiles;
+
+  if (!ppd_snap_get_strings(&snap, &ppd->fonts, temp.num_fonts))
+    goto error;
+
+  ppd->num_fonts = temp.num_fonts;
+
+  if (!ppd_snap_get_strings(&snap, &ppd->filters, temp.num_filters))
+    goto error;
+
+  ppd->num_filters = temp.num_filters;
+
+ /*
+  * Attributes, skipping localizations for other languages...
+  */
+
+  if (!ppd_snap_get(&snap, fields, sizeof(fields)) || !ppd_snap_get(&snap, &num_attrs, sizeof(num_attrs)) || num_attrs < 0 || (size_t)num_attrs > (size_t)(snap.end - snap.ptr) / sizeof(ppd_attr_t))
+    goto error;
+
+  if (num_attrs > 0)
+  {
+    if ((ppd->attrs = calloc((size_t)num_attrs, sizeof(ppd_attr_t *))) == NULL)
+      goto error;
+
+    ppd->sorted_attrs = cupsArrayNew((cups_array_func_t)ppd_compare_attrs, NULL);
+
+    for (i = 0; i < num_attrs; i ++)
+    {
+      if ((attr = malloc(sizeof(ppd_attr_t))) == NULL)
+        goto error;
+
+      if (!ppd_snap_get(&snap, attr, sizeof(ppd_attr_t)))
+      {
+        free(attr);
+        goto error;
+      }
+
+      attr->value = NULL;
+      attr->name[sizeof(attr->name) - 1] = '\0';
+      attr->spec[sizeof(attr->spec) - 1] = '\0';
+      attr->text[sizeof(attr->text) - 1] = '\0';
+
+      ppd->attrs[ppd->num_attrs ++] = attr;
+
+      if (!ppd_snap_get_string(&snap, &attr->value))
+        goto error;
+
+      if (ppd_is_localization(attr->name) && strncmp(ll_CC, attr->name, ll_CC_len) && strncmp(ll, attr->name, ll_len))
+      {
+        free(attr->value);
+        free(attr);
+        ppd->num_attrs --;
+        continue;
+      }
+
+      cupsArrayAdd(ppd->sorted_attrs, attr);
+
+      for (j = 0; j < (int)(sizeof(fields) / sizeof(fields[0])); j ++)
+        if (fields[j] == i)
+          *(char **)((char *)ppd + ppd_snap_fields[j]) = attr->value;
+    }
+
+    if (ppd->num_attrs == 0)
+    {
+      free(ppd->attrs);
+      ppd->attrs = NULL;
+    }
+  }
+
+ /*
+  * Custom options...
+  */
+
+  ppd->coptions = cupsArrayNew((cups_array_func_t)ppd_compare_coptions, NULL);
+
+  if (!ppd_snap_get(&snap, &num_coptions, sizeof(num_coptions)) || num_coptions < 0)
+    goto error;
+
+  for (i = 0; i < num_coptions; i ++)
+  {
+    if ((coption = calloc(1, sizeof(ppd_coption_t))) == NULL)
+      goto error;
+
+    if (!ppd_snap_get(&snap, coption, sizeof(ppd_coption_t)))
+    {
+      free(coption);
+      goto error;
+    }
+
+    coption->keyword[sizeof(coption->keyword) - 1] = '\0';
+    coption->option = NULL;
+    coption->params = cupsArrayNew(NULL, NULL);
+
+    cupsArrayAdd(ppd->coptions, coption);
+
+    if (!ppd_snap_get(&snap, &num_cparams, sizeof(num_cparams)) || num_cparams < 0)
+      goto error;
+
+    for (j = 0; j < num_cparams; j ++)
+    {
+      if ((cparam = calloc(1, sizeof(ppd_cparam_t))) == NULL)
+        goto error;
+
+      if (!ppd_snap_get(&snap, cparam, sizeof(ppd_cparam_t)))
+      {
+        free(cparam);
+        goto error;
+      }
+
+      cupsArrayAdd(coption->params, cparam);
+
+      switch (cparam->type)
+      {
+        case PPD_CUSTOM_PASSCODE :
+        case PPD_CUSTOM_PASSWORD :
+        case PPD_CUSTOM_STRING :
+            cparam->current.custom_string = NULL;
+
+            if (!ppd_snap_get_string(&snap, &cparam->current.custom_string))
+              goto error;
+	    break;
+
+	default :
+	    break;
+      }
+    }
+  }
+
+  munmap(data, datalen);
+
+ /*
+  * Create the sorted options array and set the option back-pointer for each
+  * custom option, then record any choices that were marked when the snapshot
+  * was written...
+  */
+
+  ppd->options = cupsArrayNew2((cups_array_func_t)ppd_compare_options, NULL,
+                               (cups_ahash_func_t)ppd_hash_option,
+			       PPD_HASHSIZE);
+
+  for (i = ppd->num_groups, group = ppd->groups; i > 0; i --, group ++)
+  {
+    for (j = group->num_options, option = group->options; j > 0; j --, option ++)
+    {
+      cupsArrayAdd(ppd->options, option);
+
+      if ((coption = ppdFindCustomOption(ppd, option->keyword)) != NULL)
+        coption->option = option;
+    }
+  }
+
+  ppd->marked = cupsArrayNew((cups_array_func_t)ppd_compare_choices, NULL);
+
+  for (option = (ppd_option_t *)cupsArrayFirst(ppd->options); option; option = (ppd_option_t *)cupsArrayNext(ppd->options))
+  {
+    for (i = 0; i < option->num_choices; i ++)
+      if (option->choices[i].marked)
+      {
+        cupsArrayAdd(ppd->marked, option->choices + i);
+        break;
+      }
+  }
+
+  pg->ppd_status = PPD_OK;
+  pg->ppd_line   = 0;
+
+  DEBUG_printf(("1_ppdOpenSnapshot: Loaded \"%s\" from \"%s\".", ppdfile, snapfile));
+
+  return (ppd);
+
+ /*
+  * Common exit point for errors...
+  */
+
+  error:
+
+  DEBUG_printf(("1_ppdOpenSnapshot: \"%s\" is not a usable snapshot.", snapfile));
+
+  munmap(data, datalen);
+
+  if (ppd->num_attrs == 0)
+  {
+    free(ppd->attrs);
+    ppd->attrs = NULL;
+  }
+
+  ppdClose(ppd);
+
+  return (NULL);
+
+#else
+  (void)snapfile;
+  (void)ppdfile;
+
+  return (NULL);
+#endif /* PPD_SNAP_MMAP */
+}
+
+
 /*
  * 'ppdSetConformance()' - Set the conformance level for PPD files.
  *
@@ -2278,6 +2700,114 @@ ppdSetConformance(ppd_conform_t c)	/* I - Conformance level */
   pg->ppd_conform = c;
 }
 
+/*
+ * '_ppdWriteSnapshot()' - Write a snapshot of a loaded PPD file.
+ *
+ * The snapshot can be loaded with @link _ppdOpenSnapshot@ for as long as
+ * "ppdfile" is not changed.  Load the PPD file with all localizations
+ * (@code _PPD_LOCALIZATION_ALL@) so that readers can pick their own.  Any
+ * marked choices are saved with the snapshot.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+_ppdWriteSnapshot(ppd_file_t *ppd,	/* I - PPD file record */
+                  const char *ppdfile,	/* I - PPD file it was loaded from */
+                  const char *snapfile)	/* I - Snapshot file */
+{
+  int			i,		/* Looping var */
+			j,		/* Looping var */
+			status,		/* Write status */
+			fields[8],	/* Attribute indices for strings */
+			count;		/* Number of custom options/parameters */
+  struct stat		ppdinfo;	/* PPD file information */
+  _ppd_snap_header_t	header;		/* Snapshot header */
+  cups_file_t		*fp;		/* Snapshot file */
+  char			tempfile[1024];	/* Temporary snapshot file */
+  ppd_coption_t		*coption;	/* Current custom option */
+  ppd_cparam_t		*cparam;	/* Current custom parameter */
+
+
+  if (!ppd || !ppdfile || !snapfile || stat(ppdfile, &ppdinfo))
+    return (0);
+
+ /*
+  * Find the attributes holding the strings that are shared with the PPD file
+  * record...
+  */
+
+  for (i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i ++)
+  {
+    char *value = *(char **)((char *)ppd + ppd_snap_fields[i]);
+					/* Shared string */
+
+    for (fields[i] = -1, j = 0; value && j < ppd->num_attrs; j ++)
+      if (ppd->attrs[j]->value == value)
+      {
+        fields[i] = j;
+        break;
+      }
+  }
+
+ /*
+  * Write to a temporary file and then rename it so that readers never see a
+  * partial snapshot...
+  */
+
+  snprintf(tempfile, sizeof(tempfile), "%s.N", snapfile);
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+    return (0);
+
+  ppd_snap_header(&header, &ppdinfo);
+
+  status = ppd_snap_put(fp, &header, sizeof(header)) && ppd_snap_put(fp, ppd, sizeof(ppd_file_t)) && ppd_snap_put_string(fp, ppd->lang_encoding) && ppd_snap_put_string(fp, ppd->nickname) && ppd_snap_put_string(fp, ppd->patches) && ppd_snap_put_string(fp, ppd->jcl_begin) && ppd_snap_put_string(fp, ppd->jcl_end) && ppd_snap_put_string(fp, ppd->jcl_ps) && ppd_snap_put(fp, ppd->emulations, (size_t)ppd->num_emulations * sizeof(ppd_emul_t));
+
+  for (i = 0; status && i < ppd->num_groups; i ++)
+    status = ppd_snap_put_group(fp, ppd->groups + i);
+
+  status = status && ppd_snap_put(fp, ppd->sizes, (size_t)ppd->num_sizes * sizeof(ppd_size_t)) && ppd_snap_put(fp, ppd->consts, (size_t)ppd->num_consts * sizeof(ppd_const_t)) && ppd_snap_put(fp, ppd->profiles, (size_t)ppd->num_profiles * sizeof(ppd_profile_t));
+
+  for (i = 0; status && i < ppd->num_fonts; i ++)
+    status = ppd_snap_put_string(fp, ppd->fonts[i]);
+
+  for (i = 0; status && i < ppd->num_filters; i ++)
+    status = ppd_snap_put_string(fp, ppd->filters[i]);
+
+  status = status && ppd_snap_put(fp, fields, sizeof(fields)) && ppd_snap_put(fp, &ppd->num_attrs, sizeof(ppd->num_attrs));
+
+  for (i = 0; status && i < ppd->num_attrs; i ++)
+    status = ppd_snap_put(fp, ppd->attrs[i], sizeof(ppd_attr_t)) && ppd_snap_put_string(fp, ppd->attrs[i]->value);
+
+  count  = cupsArrayCount(ppd->coptions);
+  status = status && ppd_snap_put(fp, &count, sizeof(count));
+
+  for (coption = (ppd_coption_t *)cupsArrayFirst(ppd->coptions); status && coption; coption = (ppd_coption_t *)cupsArrayNext(ppd->coptions))
+  {
+    count  = cupsArrayCount(coption->params);
+    status = ppd_snap_put(fp, coption, sizeof(ppd_coption_t)) && ppd_snap_put(fp, &count, sizeof(count));
+
+    for (cparam = (ppd_cparam_t *)cupsArrayFirst(coption->params); status && cparam; cparam = (ppd_cparam_t *)cupsArrayNext(coption->params))
+    {
+      status = ppd_snap_put(fp, cparam, sizeof(ppd_cparam_t));
+
+      if (status && (cparam->type == PPD_CUSTOM_PASSCODE || cparam->type == PPD_CUSTOM_PASSWORD || cparam->type == PPD_CUSTOM_STRING))
+        status = ppd_snap_put_string(fp, cparam->current.custom_string);
+    }
+  }
+
+  if (cupsFileClose(fp))
+    status = 0;
+
+  if (!status || rename(tempfile, snapfile))
+  {
+    unlink(tempfile);
+    return (0);
+  }
+
+  return (1);
+}
+
+
 
 /*
  * 'ppd_add_attr()' - Add an attribute to the PPD data.
@@ -2518,6 +3048,83 @@ ppd_decode(char *string)		/* I - String to decode */
   return ((int)(outptr - string));
 }
 
+/*
+ * 'ppd_default_localization()' - Get the localization prefixes for the current locale.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_default_localization(
+    char   *ll_CC,			/* O - Language w/country + '.' */
+    size_t ll_CC_size,			/* I - Size of ll_CC buffer */
+    char   *ll,				/* O - Base language + '.' */
+    size_t ll_size)			/* I - Size of ll buffer */
+{
+  cups_lang_t	*lang;			/* Language data */
+
+
+  if ((lang = cupsLangDefault()) == NULL)
+    return (0);
+
+  snprintf(ll_CC, ll_CC_size, "%s.", lang->language);
+
+ /*
+  * <rdar://problem/22130168>
+  * <rdar://problem/27245567>
+  *
+  * Need to use a different base language for some locales...
+  */
+
+  if (!strcmp(lang->language, "zh_HK"))
+  {					/* Traditional Chinese + variants */
+    strlcpy(ll_CC, "zh_TW.", ll_CC_size);
+    strlcpy(ll, "zh_", ll_size);
+  }
+  else if (!strncmp(lang->language, "zh", 2))
+    strlcpy(ll, "zh_", ll_size);	/* Any Chinese variant */
+  else if (!strncmp(lang->language, "jp", 2))
+  {					/* Any Japanese variant */
+    strlcpy(ll_CC, "ja", ll_CC_size);
+    strlcpy(ll, "jp", ll_size);
+  }
+  else if (!strncmp(lang->language, "nb", 2) || !strncmp(lang->language, "no", 2))
+  {					/* Any Norwegian variant */
+    strlcpy(ll_CC, "nb", ll_CC_size);
+    strlcpy(ll, "no", ll_size);
+  }
+  else
+    snprintf(ll, ll_size, "%2.2s.", lang->language);
+
+  return (1);
+}
+
+
+
+/*
+ * 'ppd_fill()' - Read the next block of the PPD file.
+ */
+
+static int				/* O - Next character or EOF */
+ppd_fill(_ppd_line_t *line,		/* I - Line buffer and input */
+         int         consume)		/* I - 1 to consume the character */
+{
+  ssize_t	bytes;			/* Bytes read */
+
+
+  if (!line->data && (line->data = malloc(PPD_READSIZE)) == NULL)
+    return (EOF);
+
+  if ((bytes = cupsFileRead(line->fp, line->data, PPD_READSIZE)) <= 0)
+    return (EOF);
+
+  line->ptr = line->data;
+  line->end = line->data + bytes;
+
+  if (consume)
+    return (*(line->ptr)++ & 255);
+  else
+    return (*(line->ptr) & 255);
+}
+
 
 /*
  * 'ppd_free_filters()' - Free the filters array.
@@ -2844,6 +3451,26 @@ ppd_hash_option(ppd_option_t *option)	/* I - Option */
   return (hash & 511);
 }
 
+/*
+ * 'ppd_is_localization()' - Determine whether a keyword is a localization ("ll.Keyword" or "ll_CC.Keyword").
+ */
+
+static int				/* O - 1 if localization, 0 otherwise */
+ppd_is_localization(const char *keyword)/* I - Keyword */
+{
+  const char	*temp;			/* Pointer to '.' */
+
+
+  return ((temp = strchr(keyword, '.')) != NULL &&
+          ((temp - keyword) == 2 || (temp - keyword) == 5) &&
+          _cups_isalpha(keyword[0]) &&
+          _cups_isalpha(keyword[1]) &&
+          (keyword[2] == '.' ||
+           (keyword[2] == '_' && _cups_isalpha(keyword[3]) &&
+            _cups_isalpha(keyword[4]) && keyword[5] == '.')));
+}
+
+
 
 /*
  * 'ppd_read()' - Read a line from a PPD file, skipping comment lines as
@@ -2851,8 +3478,7 @@ ppd_hash_option(ppd_option_t *option)	/* I - Option */
  */
 
 static int				/* O - Bitmask of fields read */
-ppd_read(cups_file_t    *fp,		/* I - File to read from */
-         _ppd_line_t    *line,		/* I - Line buffer */
+ppd_read(_ppd_line_t    *line,		/* I - Line buffer and input */
          char           *keyword,	/* O - Keyword from line */
 	 char           *option,	/* O - Option from line */
          char           *text,		/* O - Human-readable text from line */
@@ -2901,7 +3527,7 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
     endquote = 0;
     colon    = 0;
 
-    while ((ch = cupsFileGetChar(fp)) != EOF)
+    while ((ch = ppd_getc(line)) != EOF)
     {
       if (lineptr >= (line->buffer + line->bufsize - 1))
       {
@@ -2953,14 +3579,14 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
           * Check for a trailing line feed...
 	  */
 
-	  if ((ch = cupsFilePeekChar(fp)) == EOF)
+	  if ((ch = ppd_peekc(line)) == EOF)
 	  {
 	    ch = '\n';
 	    break;
 	  }
 
 	  if (ch == 0x0a)
-	    cupsFileGetChar(fp);
+	    ppd_getc(line);
 	}
 
 	if (lineptr == line->buffer && ignoreblank)
@@ -3010,6 +3636,38 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
 
 	if (ch == '\"' && colon)
 	  endquote = !endquote;
+
+        if (line->ptr < line->end)
+	{
+	 /*
+	  * Copy any following ordinary characters in one pass, stopping
+	  * before anything the checks above need to see...
+	  */
+
+	  const char	*runptr = line->ptr,
+					/* End of run */
+			*runend = line->end;
+					/* Limit of run */
+	  size_t	runmax = (size_t)(line->buffer + line->bufsize - 1 - lineptr);
+					/* Maximum length of run */
+
+	  if (runmax > (size_t)(PPD_MAX_LINE - 1 - col))
+	    runmax = (size_t)(PPD_MAX_LINE - 1 - col);
+
+	  if ((size_t)(runend - runptr) > runmax)
+	    runend = runptr + runmax;
+
+	  while (runptr < runend &&
+	         ((unsigned char)*runptr >= ' ' || *runptr == '\t') &&
+		 *runptr != ':' && *runptr != '\"')
+	    runptr ++;
+
+	  memcpy(lineptr, line->ptr, (size_t)(runptr - line->ptr));
+
+	  lineptr   += runptr - line->ptr;
+	  col       += (int)(runptr - line->ptr);
+	  line->ptr = runptr;
+	}
       }
     }
 
@@ -3019,7 +3677,7 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
       * Didn't finish this quoted string...
       */
 
-      while ((ch = cupsFileGetChar(fp)) != EOF)
+      while ((ch = ppd_getc(line)) != EOF)
         if (ch == '\"')
 	  break;
 	else if (ch == '\r' || ch == '\n')
@@ -3033,10 +3691,10 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
             * Check for a trailing line feed...
 	    */
 
-	    if ((ch = cupsFilePeekChar(fp)) == EOF)
+	    if ((ch = ppd_peekc(line)) == EOF)
 	      break;
 	    if (ch == 0x0a)
-	      cupsFileGetChar(fp);
+	      ppd_getc(line);
 	  }
 	}
 	else if (ch < ' ' && ch != '\t' && pg->ppd_conform == PPD_CONFORM_STRICT)
@@ -3074,7 +3732,7 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
       * Didn't finish this line...
       */
 
-      while ((ch = cupsFileGetChar(fp)) != EOF)
+      while ((ch = ppd_getc(line)) != EOF)
 	if (ch == '\r' || ch == '\n')
 	{
 	 /*
@@ -3090,10 +3748,10 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
             * Check for a trailing line feed...
 	    */
 
-	    if ((ch = cupsFilePeekChar(fp)) == EOF)
+	    if ((ch = ppd_peekc(line)) == EOF)
 	      break;
 	    if (ch == 0x0a)
-	      cupsFileGetChar(fp);
+	      ppd_getc(line);
 	  }
 
 	  break;
@@ -3346,6 +4004,297 @@ ppd_read(cups_file_t    *fp,		/* I - File to read from */
 }
 
 
+/*
+ * 'ppd_snap_get()' - Copy bytes from a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 at end of snapshot */
+ppd_snap_get(_ppd_snap_t *snap,		/* I - Snapshot reader */
+             void        *data,		/* I - Buffer */
+             size_t      bytes)		/* I - Number of bytes */
+{
+  if ((size_t)(snap->end - snap->ptr) < bytes)
+    return (0);
+
+  memcpy(data, snap->ptr, bytes);
+  snap->ptr += bytes;
+
+  return (1);
+}
+
+
+/*
+ * 'ppd_snap_get_array()' - Copy an array of structures from a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_get_array(
+    _ppd_snap_t *snap,			/* I - Snapshot reader */
+    void        **array,		/* O - Allocated array */
+    int         num_elements,		/* I - Number of elements */
+    size_t      size)			/* I - Size of each element */
+{
+  if (num_elements < 0 || (size_t)num_elements > (size_t)(snap->end - snap->ptr) / size)
+    return (0);
+  else if (num_elements == 0)
+    return (1);
+
+  if ((*array = malloc((size_t)num_elements * size)) == NULL)
+    return (0);
+
+  return (ppd_snap_get(snap, *array, (size_t)num_elements * size));
+}
+
+
+/*
+ * 'ppd_snap_get_group()' - Read a group and its options from a snapshot.
+ *
+ * The group must be zeroed on entry; it is always left in a state that
+ * ppd_free_group() can handle.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_get_group(_ppd_snap_t *snap,	/* I - Snapshot reader */
+                   ppd_group_t *group)	/* I - Group */
+{
+  int		i,			/* Looping var */
+		num_options,		/* Number of options */
+		num_subgroups,		/* Number of subgroups */
+		num_choices;		/* Number of choices */
+  ppd_option_t	*option;		/* Current option */
+  ppd_choice_t	*choice;		/* Current choice */
+
+
+  if (!ppd_snap_get(snap, group, sizeof(ppd_group_t)))
+    return (0);
+
+  num_options          = group->num_options;
+  num_subgroups        = group->num_subgroups;
+  group->num_options   = 0;
+  group->options       = NULL;
+  group->num_subgroups = 0;
+  group->subgroups     = NULL;
+
+  if (num_options < 0 || (size_t)num_options > (size_t)(snap->end - snap->ptr) / sizeof(ppd_option_t) || num_subgroups < 0 || (size_t)num_subgroups > (size_t)(snap->end - snap->ptr) / sizeof(ppd_group_t))
+    return (0);
+
+  if (num_options > 0)
+  {
+    if ((group->options = calloc((size_t)num_options, sizeof(ppd_option_t))) == NULL)
+      return (0);
+
+    for (option = group->options; group->num_options < num_options; option ++)
+    {
+      if (!ppd_snap_get(snap, option, sizeof(ppd_option_t)))
+        return (0);
+
+      num_choices         = option->num_choices;
+      option->num_choices = 0;
+      option->choices     = NULL;
+
+      group->num_options ++;
+
+      if (num_choices < 0 || (size_t)num_choices > (size_t)(snap->end - snap->ptr) / sizeof(ppd_choice_t))
+        return (0);
+      else if (num_choices == 0)
+        continue;
+
+      if ((option->choices = calloc((size_t)num_choices, sizeof(ppd_choice_t))) == NULL)
+        return (0);
+
+      for (i = 0, choice = option->choices; i < num_choices; i ++, choice ++)
+      {
+        if (!ppd_snap_get(snap, choice, sizeof(ppd_choice_t)))
+          return (0);
+
+        choice->code   = NULL;
+        choice->option = option;
+
+        option->num_choices ++;
+
+        if (!ppd_snap_get_string(snap, &choice->code))
+          return (0);
+      }
+    }
+  }
+
+  if (num_subgroups > 0)
+  {
+    if ((group->subgroups = calloc((size_t)num_subgroups, sizeof(ppd_group_t))) == NULL)
+      return (0);
+
+    for (i = 0; i < num_subgroups; i ++)
+    {
+      group->num_subgroups ++;
+
+      if (!ppd_snap_get_group(snap, group->subgroups + i))
+        return (0);
+    }
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'ppd_snap_get_string()' - Copy a string from a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_get_string(_ppd_snap_t *snap,	/* I - Snapshot reader */
+                    char        **s)	/* O - Allocated string or `NULL` */
+{
+  int	len;				/* Length of string */
+
+
+  *s = NULL;
+
+  if (!ppd_snap_get(snap, &len, sizeof(len)))
+    return (0);
+  else if (len < 0)
+    return (1);
+  else if ((size_t)len > (size_t)(snap->end - snap->ptr) || (*s = malloc((size_t)len + 1)) == NULL)
+    return (0);
+
+  memcpy(*s, snap->ptr, (size_t)len);
+  (*s)[len] = '\0';
+  snap->ptr += len;
+
+  return (1);
+}
+
+
+/*
+ * 'ppd_snap_get_strings()' - Copy an array of strings from a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_get_strings(
+    _ppd_snap_t *snap,			/* I - Snapshot reader */
+    char        ***array,		/* O - Allocated array */
+    int         num_strings)		/* I - Number of strings */
+{
+  int	i;				/* Looping var */
+
+
+  if (num_strings < 0 || (size_t)num_strings > (size_t)(snap->end - snap->ptr) / sizeof(int))
+    return (0);
+  else if (num_strings == 0)
+    return (1);
+
+  if ((*array = calloc((size_t)num_strings, sizeof(char *))) == NULL)
+    return (0);
+
+  for (i = 0; i < num_strings; i ++)
+  {
+    if (!ppd_snap_get_string(snap, (*array) + i) || !(*array)[i])
+    {
+      while (i >= 0)
+        free((*array)[i --]);
+
+      free(*array);
+      *array = NULL;
+
+      return (0);
+    }
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'ppd_snap_header()' - Fill in a snapshot header for a PPD file.
+ */
+
+static void
+ppd_snap_header(
+    _ppd_snap_header_t *header,		/* O - Snapshot header */
+    struct stat        *fileinfo)	/* I - PPD file information */
+{
+  memset(header, 0, sizeof(_ppd_snap_header_t));
+
+  memcpy(header->magic, PPD_SNAP_MAGIC, sizeof(header->magic));
+
+  header->order     = PPD_SNAP_ORDER;
+  header->sizes[0]  = sizeof(ppd_file_t);
+  header->sizes[1]  = sizeof(ppd_group_t);
+  header->sizes[2]  = sizeof(ppd_option_t);
+  header->sizes[3]  = sizeof(ppd_choice_t);
+  header->sizes[4]  = sizeof(ppd_attr_t);
+  header->sizes[5]  = sizeof(ppd_size_t);
+  header->sizes[6]  = sizeof(ppd_const_t);
+  header->sizes[7]  = sizeof(ppd_profile_t);
+  header->sizes[8]  = sizeof(ppd_emul_t);
+  header->sizes[9]  = sizeof(ppd_coption_t);
+  header->sizes[10] = sizeof(ppd_cparam_t);
+  header->ppd_size  = (long long)fileinfo->st_size;
+  header->ppd_mtime = (long long)fileinfo->st_mtime;
+  header->ppd_ino   = (long long)fileinfo->st_ino;
+}
+
+
+/*
+ * 'ppd_snap_put()' - Write bytes to a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_put(cups_file_t *fp,		/* I - Snapshot file */
+             const void  *data,		/* I - Data */
+             size_t      bytes)		/* I - Number of bytes */
+{
+  return (bytes == 0 || cupsFileWrite(fp, (const char *)data, bytes) == (ssize_t)bytes);
+}
+
+
+/*
+ * 'ppd_snap_put_group()' - Write a group and its options to a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_put_group(cups_file_t *fp,	/* I - Snapshot file */
+                   ppd_group_t *group)	/* I - Group */
+{
+  int		i, j;			/* Looping vars */
+  ppd_option_t	*option;		/* Current option */
+
+
+  if (!ppd_snap_put(fp, group, sizeof(ppd_group_t)))
+    return (0);
+
+  for (i = group->num_options, option = group->options; i > 0; i --, option ++)
+  {
+    if (!ppd_snap_put(fp, option, sizeof(ppd_option_t)))
+      return (0);
+
+    for (j = 0; j < option->num_choices; j ++)
+      if (!ppd_snap_put(fp, option->choices + j, sizeof(ppd_choice_t)) || !ppd_snap_put_string(fp, option->choices[j].code))
+        return (0);
+  }
+
+  for (i = 0; i < group->num_subgroups; i ++)
+    if (!ppd_snap_put_group(fp, group->subgroups + i))
+      return (0);
+
+  return (1);
+}
+
+
+/*
+ * 'ppd_snap_put_string()' - Write a string to a snapshot.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_snap_put_string(cups_file_t *fp,	/* I - Snapshot file */
+                    const char  *s)	/* I - String or `NULL` */
+{
+  int	len = s ? (int)strlen(s) : -1;	/* Length of string */
+
+
+  return (ppd_snap_put(fp, &len, sizeof(len)) && (len <= 0 || ppd_snap_put(fp, s, (size_t)len)));
+}
+
+
 /*
  * 'ppd_update_filters()' - Update the filters array as needed.
  *
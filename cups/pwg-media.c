@@ -23,12 +23,14 @@
 #define _PWG_MEDIA_IN(p,l,a,x,y) {p, l, a, (int)(x * 2540), (int)(y * 2540)}
 #define _PWG_MEDIA_MM(p,l,a,x,y) {p, l, a, (int)(x * 100), (int)(y * 100)}
 #define _PWG_EPSILON	50		/* Matching tolerance */
+#define _PWG_MAX_NEAR	64		/* Maximum sizes to check by dimensions */
 
 
 /*
  * Local functions...
  */
 
+static int	pwg_compare_dims(const void *a, const void *b);
 static int	pwg_compare_legacy(pwg_media_t *a, pwg_media_t *b);
 static int	pwg_compare_pwg(pwg_media_t *a, pwg_media_t *b);
 static int	pwg_compare_ppd(pwg_media_t *a, pwg_media_t *b);
@@ -930,14 +932,20 @@ _pwgMediaNearSize(int width,	        /* I - Width in hundredths of millimeters *
 		  int length,		/* I - Length in hundredths of millimeters */
 		  int epsilon)		/* I - Match within this tolernace. PWG units */
 {
-  int		i;			/* Looping var */
+  int		i, j,			/* Looping vars */
+		lo, hi,			/* Range of widths in lookup table */
+		num_near;		/* Number of sizes to check */
   pwg_media_t	*media,			/* Current media */
-		*best_media = NULL;	/* Best match */
+		*best_media = NULL,	/* Best match */
+		*near_media[_PWG_MAX_NEAR];
+					/* Sizes with a similar width */
   int		dw, dl,			/* Difference in width and length */
 		best_dw = 999,		/* Best difference in width and length */
 		best_dl = 999;
   char		wstr[32], lstr[32];	/* Width and length as strings */
   _cups_globals_t *cg = _cupsGlobals();	/* Global data */
+  const int	num_media = (int)(sizeof(cups_pwg_media) / sizeof(cups_pwg_media[0]));
+					/* Number of standard sizes */
 
 
  /*
@@ -947,15 +955,65 @@ _pwgMediaNearSize(int width,	        /* I - Width in hundredths of millimeters *
   if (width <= 0 || length <= 0)
     return (NULL);
 
+ /*
+  * Build the lookup table for dimensions as needed...
+  */
+
+  if (!cg->dim_size_lut &&
+      (cg->dim_size_lut = calloc((size_t)num_media, sizeof(pwg_media_t *))) != NULL)
+  {
+    for (i = 0; i < num_media; i ++)
+      cg->dim_size_lut[i] = (pwg_media_t *)cups_pwg_media + i;
+
+    qsort(cg->dim_size_lut, (size_t)num_media, sizeof(pwg_media_t *), pwg_compare_dims);
+  }
+
+ /*
+  * Find the standard sizes whose width is within the tolerance, in table
+  * order so that the best match is the same as a search of the whole table...
+  */
+
+  num_near = -1;
+
+  if (cg->dim_size_lut)
+  {
+    for (lo = 0, hi = num_media; lo < hi;)
+    {
+      i = (lo + hi) / 2;
+
+      if (cg->dim_size_lut[i]->width < width - epsilon)
+        lo = i + 1;
+      else
+        hi = i;
+    }
+
+    for (num_near = 0;
+         lo < num_media && cg->dim_size_lut[lo]->width <= width + epsilon;
+         lo ++)
+    {
+      if (num_near >= _PWG_MAX_NEAR)
+      {
+        num_near = -1;
+        break;
+      }
+
+      media = cg->dim_size_lut[lo];
+
+      for (j = num_near; j > 0 && near_media[j - 1] > media; j --)
+        near_media[j] = near_media[j - 1];
+
+      near_media[j] = media;
+      num_near ++;
+    }
+  }
+
  /*
   * Look for a standard size...
   */
 
-  for (i = (int)(sizeof(cups_pwg_media) / sizeof(cups_pwg_media[0])),
-	   media = (pwg_media_t *)cups_pwg_media;
-       i > 0;
-       i --, media ++)
+  for (i = 0; i < (num_near >= 0 ? num_near : num_media); i ++)
   {
+    media = num_near >= 0 ? near_media[i] : (pwg_media_t *)cups_pwg_media + i;
 
     dw = abs(media->width - width);
     dl = abs(media->length - length);
@@ -1012,6 +1070,29 @@ _pwgMediaTable(size_t *num_media)	/* O - Number of entries */
 }
 
 
+/*
+ * 'pwg_compare_dims()' - Compare two sizes using the width, then table order.
+ */
+
+static int				/* O - Result of comparison */
+pwg_compare_dims(const void *a,		/* I - First size */
+                 const void *b)		/* I - Second size */
+{
+  const pwg_media_t	*ma = *(const pwg_media_t * const *)a,
+					/* First size */
+			*mb = *(const pwg_media_t * const *)b;
+					/* Second size */
+
+
+  if (ma->width != mb->width)
+    return (ma->width < mb->width ? -1 : 1);
+  else if (ma != mb)
+    return (ma < mb ? -1 : 1);
+  else
+    return (0);
+}
+
+
 /*
  * 'pwg_compare_legacy()' - Compare two sizes using the legacy names.
  */
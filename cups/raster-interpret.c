@@ -17,6 +17,14 @@
 #include "debug-internal.h"
 
 
+/*
+ * Local constants...
+ */
+
+#define _CUPS_PS_CACHE_MAGIC	"CUPSPH01"
+					/* Page header cache file magic */
+
+
 /*
  * Stack values for the PostScript mini-interpreter...
  */
@@ -65,6 +73,13 @@ typedef struct
   _cups_ps_obj_t	*objs;		/* Objects in stack */
 } _cups_ps_stack_t;
 
+typedef struct
+{
+  char			magic[8];	/* _CUPS_PS_CACHE_MAGIC */
+  int			preferred_bits;	/* Preferred bits per color */
+  cups_page_header2_t	header;		/* Page header after PPD code */
+} _cups_ps_cache_t;
+
 
 /*
  * Local functions...
@@ -75,16 +90,28 @@ static int		copy_stack(_cups_ps_stack_t *st, int count);
 static void		delete_stack(_cups_ps_stack_t *st);
 static void		error_object(_cups_ps_obj_t *obj);
 static void		error_stack(_cups_ps_stack_t *st, const char *title);
+static int		exec_ppd(cups_page_header2_t *h, int *preferred_bits,
+			         ppd_file_t *ppd);
 static _cups_ps_obj_t	*index_stack(_cups_ps_stack_t *st, int n);
 static _cups_ps_stack_t	*new_stack(void);
 static _cups_ps_obj_t	*pop_stack(_cups_ps_stack_t *st);
 static _cups_ps_obj_t	*push_stack(_cups_ps_stack_t *st,
 			            _cups_ps_obj_t *obj);
+#ifndef _WIN32
+static int		read_cache(const char *filename,
+			           cups_page_header2_t *h,
+			           int *preferred_bits);
+#endif /* !_WIN32 */
 static int		roll_stack(_cups_ps_stack_t *st, int c, int s);
 static _cups_ps_obj_t	*scan_ps(_cups_ps_stack_t *st, char **ptr);
 static int		setpagedevice(_cups_ps_stack_t *st,
 			                cups_page_header2_t *h,
 			                int *preferred_bits);
+#ifndef _WIN32
+static void		write_cache(const char *filename,
+			            cups_page_header2_t *h,
+			            int preferred_bits);
+#endif /* !_WIN32 */
 #ifdef DEBUG
 static void		DEBUG_object(const char *prefix, _cups_ps_obj_t *obj);
 static void		DEBUG_stack(const char *prefix, _cups_ps_stack_t *st);
@@ -130,7 +157,6 @@ _cupsRasterInterpretPPD(
     cups_interpret_cb_t func)		/* I - Optional page header callback (@code NULL@ for none) */
 {
   int		status;			/* Cummulative status */
-  char		*code;			/* Code to run */
   const char	*val;			/* Option value */
   ppd_size_t	*size;			/* Current size */
   float		left,			/* Left position */
@@ -194,42 +220,7 @@ _cupsRasterInterpretPPD(
   preferred_bits = 0;
 
   if (ppd)
-  {
-   /*
-    * Apply any patch code (used to override the defaults...)
-    */
-
-    if (ppd->patches)
-      status |= _cupsRasterExecPS(h, &preferred_bits, ppd->patches);
-
-   /*
-    * Then apply printer options in the proper order...
-    */
-
-    if ((code = ppdEmitString(ppd, PPD_ORDER_DOCUMENT, 0.0)) != NULL)
-    {
-      status |= _cupsRasterExecPS(h, &preferred_bits, code);
-      free(code);
-    }
-
-    if ((code = ppdEmitString(ppd, PPD_ORDER_ANY, 0.0)) != NULL)
-    {
-      status |= _cupsRasterExecPS(h, &preferred_bits, code);
-      free(code);
-    }
-
-    if ((code = ppdEmitString(ppd, PPD_ORDER_PROLOG, 0.0)) != NULL)
-    {
-      status |= _cupsRasterExecPS(h, &preferred_bits, code);
-      free(code);
-    }
-
-    if ((code = ppdEmitString(ppd, PPD_ORDER_PAGE, 0.0)) != NULL)
-    {
-      status |= _cupsRasterExecPS(h, &preferred_bits, code);
-      free(code);
-    }
-  }
+    status = exec_ppd(h, &preferred_bits, ppd);
 
  /*
   * Allow option override for page scaling...
@@ -866,6 +857,110 @@ error_stack(_cups_ps_stack_t *st,	/* I - Stack */
 }
 
 
+/*
+ * 'exec_ppd()' - Execute the patch and option code from a PPD file.
+ *
+ * When running under cupsd, the resulting page header is cached in the
+ * "raster" subdirectory of CUPS_CACHEDIR, if it exists.  Cache files are named
+ * using the SHA-256 hash of the code, which depends only on the PPD file and
+ * the marked choices, so repeated option combinations skip the interpreter.
+ */
+
+static int				/* O  - 0 on success, -1 on error */
+exec_ppd(cups_page_header2_t *h,	/* IO - Page header */
+         int                 *preferred_bits,
+					/* O  - Preferred bits per color */
+         ppd_file_t          *ppd)	/* I  - PPD file */
+{
+  int		i,			/* Looping var */
+		status = 0;		/* Cummulative status */
+  char		*code[5];		/* Code to run */
+  char		cachefile[1024];	/* Page header cache file */
+#ifndef _WIN32
+  const char	*cachedir;		/* CUPS_CACHEDIR environment variable */
+  char		*buffer,		/* All code, for hashing */
+		*bufptr;		/* Pointer into buffer */
+  size_t	bufsize,		/* Size of buffer */
+		length;			/* Length of code */
+  unsigned char	hash[32];		/* SHA-256 hash of code */
+  char		hashstr[65];		/* Hex version of hash */
+#endif /* !_WIN32 */
+
+
+ /*
+  * Get the patch code (used to override the defaults) and then the printer
+  * options in the proper order...
+  */
+
+  code[0] = ppd->patches;
+  code[1] = ppdEmitString(ppd, PPD_ORDER_DOCUMENT, 0.0);
+  code[2] = ppdEmitString(ppd, PPD_ORDER_ANY, 0.0);
+  code[3] = ppdEmitString(ppd, PPD_ORDER_PROLOG, 0.0);
+  code[4] = ppdEmitString(ppd, PPD_ORDER_PAGE, 0.0);
+
+  cachefile[0] = '\0';
+
+#ifndef _WIN32
+  if ((cachedir = getenv("CUPS_CACHEDIR")) != NULL)
+  {
+   /*
+    * Hash all of the code, separating each section with a nul character...
+    */
+
+    for (i = 0, bufsize = 0; i < 5; i ++)
+      bufsize += (code[i] ? strlen(code[i]) : 0) + 1;
+
+    if ((buffer = malloc(bufsize)) != NULL)
+    {
+      for (i = 0, bufptr = buffer; i < 5; i ++)
+      {
+        if (code[i])
+        {
+          length = strlen(code[i]);
+          memcpy(bufptr, code[i], length);
+          bufptr += length;
+        }
+
+        *bufptr++ = '\0';
+      }
+
+      if (cupsHashData("sha2-256", buffer, bufsize, hash, sizeof(hash)) == sizeof(hash))
+        snprintf(cachefile, sizeof(cachefile), "%s/raster/%s", cachedir, cupsHashString(hash, sizeof(hash), hashstr, sizeof(hashstr)));
+
+      free(buffer);
+    }
+  }
+
+  if (cachefile[0] && !read_cache(cachefile, h, preferred_bits))
+  {
+    DEBUG_printf(("4exec_ppd: Using cached page header \"%s\".", cachefile));
+
+    cachefile[0] = '\0';
+  }
+  else
+#endif /* !_WIN32 */
+  {
+    for (i = 0; i < 5; i ++)
+      if (code[i])
+        status |= _cupsRasterExecPS(h, preferred_bits, code[i]);
+
+#ifndef _WIN32
+   /*
+    * Only cache headers from code that ran without errors...
+    */
+
+    if (cachefile[0] && !status && !_cupsRasterErrorString())
+      write_cache(cachefile, h, *preferred_bits);
+#endif /* !_WIN32 */
+  }
+
+  for (i = 1; i < 5; i ++)
+    free(code[i]);
+
+  return (status);
+}
+
+
 /*
  * 'index_stack()' - Copy the Nth value on the stack.
  */
@@ -958,6 +1053,40 @@ push_stack(_cups_ps_stack_t *st,	/* I - Stack */
 }
 
 
+#ifndef _WIN32
+/*
+ * 'read_cache()' - Read a cached page header.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+read_cache(
+    const char          *filename,	/* I - Cache file */
+    cups_page_header2_t *h,		/* O - Page header */
+    int                 *preferred_bits)/* O - Preferred bits per color */
+{
+  int			fd;		/* File descriptor */
+  ssize_t		bytes;		/* Bytes read */
+  _cups_ps_cache_t	cache;		/* Cache file contents */
+
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return (-1);
+
+  bytes = read(fd, &cache, sizeof(cache));
+
+  close(fd);
+
+  if (bytes != (ssize_t)sizeof(cache) || memcmp(cache.magic, _CUPS_PS_CACHE_MAGIC, sizeof(cache.magic)))
+    return (-1);
+
+  *h              = cache.header;
+  *preferred_bits = cache.preferred_bits;
+
+  return (0);
+}
+#endif /* !_WIN32 */
+
+
 /*
  * 'roll_stack()' - Rotate stack objects.
  */
@@ -1606,6 +1735,51 @@ setpagedevice(
 }
 
 
+#ifndef _WIN32
+/*
+ * 'write_cache()' - Write a cached page header.
+ *
+ * The header is written to a temporary file that is then renamed, so other
+ * filters never see a partial cache file.
+ */
+
+static void
+write_cache(
+    const char          *filename,	/* I - Cache file */
+    cups_page_header2_t *h,		/* I - Page header */
+    int                 preferred_bits)	/* I - Preferred bits per color */
+{
+  int			fd;		/* File descriptor */
+  char			tempfile[1024];	/* Temporary file */
+  _cups_ps_cache_t	cache;		/* Cache file contents */
+
+
+  memset(&cache, 0, sizeof(cache));
+  memcpy(cache.magic, _CUPS_PS_CACHE_MAGIC, sizeof(cache.magic));
+  cache.preferred_bits = preferred_bits;
+  cache.header         = *h;
+
+  if (snprintf(tempfile, sizeof(tempfile), "%s.%d", filename, (int)getpid()) >= (int)sizeof(tempfile))
+    return;
+
+  if ((fd = open(tempfile, O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0640)) < 0)
+    return;
+
+  if (write(fd, &cache, sizeof(cache)) != (ssize_t)sizeof(cache))
+  {
+    close(fd);
+    unlink(tempfile);
+    return;
+  }
+
+  close(fd);
+
+  if (rename(tempfile, filename))
+    unlink(tempfile);
+}
+#endif /* !_WIN32 */
+
+
 #ifdef DEBUG
 /*
  * 'DEBUG_object()' - Print an object's value...
@@ -61,6 +61,9 @@ struct _cups_raster_s			/**** Raster stream data ****/
 			iocount;	/* Number of bytes read/written */
 #  endif /* DEBUG */
   unsigned		apple_page_count;/* Apple raster page count */
+  struct _cups_raster_pipe_s *pipe;	/* Threaded encoder state */
+  unsigned char		*band;		/* Band buffer for _cupsRasterReadLines */
+  size_t		bandsize;	/* Size of band buffer */
 };
 
 
@@ -85,11 +88,13 @@ struct _cups_raster_s			/**** Raster stream data ****/
 extern void		_cupsRasterAddError(const char *f, ...) _CUPS_FORMAT(1,2) _CUPS_PRIVATE;
 extern void		_cupsRasterClearError(void) _CUPS_PRIVATE;
 extern const char	*_cupsRasterColorSpaceString(cups_cspace_t cspace) _CUPS_PRIVATE;
+extern int		_cupsRasterCopyPage(cups_raster_t *in, cups_raster_t *out) _CUPS_PRIVATE;
 extern void		_cupsRasterDelete(cups_raster_t *r) _CUPS_PRIVATE;
 extern const char	*_cupsRasterErrorString(void) _CUPS_PRIVATE;
 extern int		_cupsRasterInitPWGHeader(cups_page_header2_t *h, pwg_media_t *media, const char *type, int xdpi, int ydpi, const char *sides, const char *sheet_back) _CUPS_PRIVATE;
 extern cups_raster_t	*_cupsRasterNew(cups_raster_iocb_t iocb, void *ctx, cups_mode_t mode) _CUPS_PRIVATE;
 extern unsigned		_cupsRasterReadHeader(cups_raster_t *r) _CUPS_PRIVATE;
+extern unsigned		_cupsRasterReadLines(cups_raster_t *r, const unsigned char **lines, unsigned max_lines) _CUPS_PRIVATE;
 extern unsigned		_cupsRasterReadPixels(cups_raster_t *r, unsigned char *p, unsigned len) _CUPS_PRIVATE;
 extern unsigned		_cupsRasterWriteHeader(cups_raster_t *r) _CUPS_PRIVATE;
 extern unsigned		_cupsRasterWritePixels(cups_raster_t *r, unsigned char *p, unsigned len) _CUPS_PRIVATE;
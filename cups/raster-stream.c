@@ -15,6 +15,7 @@
  */
 
 #include "raster-private.h"
+#include "thread-private.h"
 #include "debug-internal.h"
 #ifdef HAVE_STDINT_H
 #  include <stdint.h>
@@ -27,6 +28,60 @@
 
 typedef void (*_cups_copyfunc_t)(void *dst, const void *src, size_t bytes);
 
+#ifdef HAVE_PTHREAD_H
+#  define _CUPS_RASTER_BAND_LINES	32
+					/* Lines per encoder band */
+#  define _CUPS_RASTER_MAX_THREADS	8
+					/* Maximum number of encoder threads */
+#  define _CUPS_RASTER_MAX_PREFIX	(sizeof(cups_page_header2_t) + 64)
+					/* Maximum queued page header data */
+
+typedef enum _cups_raster_bstate_e	/**** Encoder band states ****/
+{
+  _CUPS_RASTER_BAND_FREE,		/* Available for filling */
+  _CUPS_RASTER_BAND_QUEUED,		/* Waiting for a worker */
+  _CUPS_RASTER_BAND_BUSY,		/* Being compressed */
+  _CUPS_RASTER_BAND_DONE		/* Compressed, waiting to be written */
+} _cups_raster_bstate_t;
+
+typedef struct _cups_raster_band_s	/**** Encoder band ****/
+{
+  _cups_raster_bstate_t	state;		/* Band state */
+  unsigned		num_lines,	/* Number of lines in band */
+			repeats[_CUPS_RASTER_BAND_LINES],
+					/* Row repeat count for each line */
+			bytes_per_line,	/* Bytes per line */
+			bpp;		/* Bytes per pixel */
+  int			swap;		/* Swap bytes? */
+  unsigned char		*pixels;	/* Pixel data */
+  size_t		pixsize;	/* Size of pixel data buffer */
+  unsigned char		*out;		/* Compressed data */
+  size_t		outsize,	/* Size of compressed data buffer */
+			outlen;		/* Length of compressed data */
+} _cups_raster_band_t;
+
+typedef struct _cups_raster_pipe_s	/**** Encoder pipeline ****/
+{
+  cups_raster_t		*r;		/* Raster stream */
+  _cups_mutex_t		mutex;		/* Mutex for pipeline state */
+  _cups_cond_t		cond;		/* Condition for band state changes */
+  int			num_threads;	/* Number of worker threads */
+  _cups_thread_t	threads[_CUPS_RASTER_MAX_THREADS];
+					/* Worker threads */
+  int			num_bands,	/* Number of bands */
+			head,		/* Next band to write */
+			next,		/* Next band to compress */
+			tail;		/* Band being filled */
+  _cups_raster_band_t	bands[2 * _CUPS_RASTER_MAX_THREADS];
+					/* Bands */
+  unsigned char		prefix[_CUPS_RASTER_MAX_PREFIX];
+					/* Page header for the next band */
+  size_t		prefixlen;	/* Length of page header */
+  int			error,		/* Write error? */
+			shutdown;	/* Stop the workers? */
+} _cups_raster_pipe_t;
+#endif /* HAVE_PTHREAD_H */
+
 
 /*
  * Local globals...
@@ -66,7 +121,19 @@ static const char * const cups_modes[] =
  * Local functions...
  */
 
+static size_t	cups_raster_encode(unsigned char *buffer, const unsigned char *pixels, unsigned bytes_per_line, unsigned bpp, unsigned repeat, int swap);
+static ssize_t	cups_raster_header_io(cups_raster_t *r, unsigned char *buf, size_t bytes);
 static ssize_t	cups_raster_io(cups_raster_t *r, unsigned char *buf, size_t bytes);
+#ifdef HAVE_PTHREAD_H
+static int	cups_raster_pipe_drain(cups_raster_t *r, int wait_all);
+static int	cups_raster_pipe_flush(cups_raster_t *r, int wait_all);
+static void	cups_raster_pipe_free(cups_raster_t *r);
+static _cups_raster_pipe_t *cups_raster_pipe_new(cups_raster_t *r);
+static ssize_t	cups_raster_pipe_queue(cups_raster_t *r, const unsigned char *pixels);
+static void	*cups_raster_pipe_thread(_cups_raster_pipe_t *pl);
+static ssize_t	cups_raster_pipe_write(cups_raster_t *r, unsigned char *buf, size_t bytes);
+#endif /* HAVE_PTHREAD_H */
+static int	cups_raster_pixcmp(const unsigned char *a, const unsigned char *b, unsigned bpp);
 static ssize_t	cups_raster_read(cups_raster_t *r, unsigned char *buf, size_t bytes);
 static int	cups_raster_update(cups_raster_t *r);
 static ssize_t	cups_raster_write(cups_raster_t *r, const unsigned char *pixels);
@@ -157,6 +224,193 @@ _cupsRasterColorSpaceString(
 }
 
 
+/*
+ * '_cupsRasterCopyPage()' - Copy compressed page data between streams.
+ *
+ * This function copies the pixel data of the current page from "in" to "out"
+ * without decompressing it, after the page header has been written to "out".
+ * Both streams must use the same line layout and run-length encoding, and
+ * "out" must be a CUPS or PWG compressed stream.  Only the line repeat and
+ * run counts are rewritten, so that runs past the end of a line are trimmed
+ * and "clear to end of line" codes become runs of white pixels.
+ *
+ * Returns -1 without reading anything if the page cannot be copied this way,
+ * in which case the caller reads and writes the pixels as usual.
+ */
+
+int					/* O - 1 on success, 0 on error, -1 if not supported */
+_cupsRasterCopyPage(
+    cups_raster_t *in,			/* I - Input raster stream */
+    cups_raster_t *out)			/* I - Output raster stream */
+{
+  unsigned	bpl,			/* Bytes per line */
+		bpp,			/* Bytes per pixel */
+		lines,			/* Line repeat count */
+		count;			/* Run length in bytes */
+  ssize_t	bytes;			/* Bytes left in line */
+  size_t	bufsize;		/* Size of write buffer */
+  unsigned char	byte,			/* Byte from input */
+		white,			/* White pixel value */
+		*wptr,			/* Pointer into write buffer */
+		*wend;			/* End of write buffer */
+  int		swap16;			/* 16-bit data that might need swapping? */
+
+
+  DEBUG_printf(("_cupsRasterCopyPage(in=%p, out=%p)", (void *)in, (void *)out));
+
+  if (!in || !out || in->mode != CUPS_RASTER_READ || (out->mode != CUPS_RASTER_WRITE_COMPRESSED && out->mode != CUPS_RASTER_WRITE_PWG))
+    return (-1);
+
+  bpl    = in->header.cupsBytesPerLine;
+  bpp    = in->bpp;
+  swap16 = in->header.cupsBitsPerColor == 16 || in->header.cupsBitsPerPixel == 12 || in->header.cupsBitsPerPixel == 16;
+
+  if (!in->compressed || !out->compressed || in->count > 0 || out->count > 0 || in->remaining == 0 || in->remaining != out->remaining || bpl == 0 || bpl != out->header.cupsBytesPerLine || bpp != out->bpp || (bpl % bpp) != 0 || in->header.cupsColorOrder != CUPS_ORDER_CHUNKED || out->header.cupsColorOrder != CUPS_ORDER_CHUNKED || (swap16 && in->swapped != out->swapped))
+  {
+    DEBUG_puts("1_cupsRasterCopyPage: Unable to copy, returning -1.");
+    return (-1);
+  }
+
+#ifdef HAVE_PTHREAD_H
+ /*
+  * Write out the prior page and the header before copying anything...
+  */
+
+  if (out->pipe && !cups_raster_pipe_flush(out, 1))
+    return (0);
+#endif /* HAVE_PTHREAD_H */
+
+ /*
+  * Allocate a write buffer as needed...
+  */
+
+  bufsize = 2 * (size_t)bpl + 2;
+  if (bufsize < 65536)
+    bufsize = 65536;
+
+  if (bufsize > out->bufsize)
+  {
+    if ((wptr = realloc(out->buffer, bufsize)) == NULL)
+    {
+      DEBUG_printf(("1_cupsRasterCopyPage: Unable to allocate " CUPS_LLFMT " bytes for raster buffer: %s", CUPS_LLCAST bufsize, strerror(errno)));
+      return (0);
+    }
+
+    out->buffer  = wptr;
+    out->bufsize = bufsize;
+  }
+
+  switch (in->header.cupsColorSpace)
+  {
+    case CUPS_CSPACE_W :
+    case CUPS_CSPACE_RGB :
+    case CUPS_CSPACE_SW :
+    case CUPS_CSPACE_SRGB :
+    case CUPS_CSPACE_RGBW :
+    case CUPS_CSPACE_ADOBERGB :
+        white = 0xff;
+        break;
+    default :
+        white = 0x00;
+        break;
+  }
+
+  wptr = out->buffer;
+  wend = out->buffer + out->bufsize - 2 * bpl - 2;
+
+  while (in->remaining > 0)
+  {
+   /*
+    * Get the line repeat count...
+    */
+
+    if (!cups_raster_read(in, &byte, 1))
+      return (0);
+
+    if ((lines = (unsigned)byte + 1) > in->remaining)
+      lines = in->remaining;
+
+    *wptr++ = (unsigned char)(lines - 1);
+
+   /*
+    * Then copy the runs for the line...
+    */
+
+    for (bytes = (ssize_t)bpl; bytes > 0;)
+    {
+      if (!cups_raster_read(in, &byte, 1))
+        return (0);
+
+      if (byte == 128)
+      {
+       /*
+        * Clear to end of line...
+        */
+
+        for (count = (unsigned)bytes / bpp; count > 0; count -= byte)
+        {
+          byte    = count > 128 ? 128 : (unsigned char)count;
+          *wptr++ = (unsigned char)(byte - 1);
+          memset(wptr, white, bpp);
+          wptr += bpp;
+        }
+
+        bytes = 0;
+      }
+      else if (byte & 128)
+      {
+       /*
+        * Copy N literal pixels...
+        */
+
+        if ((count = (unsigned)(257 - byte) * bpp) > (unsigned)bytes)
+          count = (unsigned)bytes;
+
+        *wptr++ = (unsigned char)(257 - count / bpp);
+
+        if (cups_raster_read(in, wptr, count) < (ssize_t)count)
+          return (0);
+
+        wptr  += count;
+        bytes -= (ssize_t)count;
+      }
+      else
+      {
+       /*
+        * Repeat the next pixel N times...
+        */
+
+        if ((count = ((unsigned)byte + 1) * bpp) > (unsigned)bytes)
+          count = (unsigned)bytes;
+
+        *wptr++ = (unsigned char)(count / bpp - 1);
+
+        if (cups_raster_read(in, wptr, bpp) < (ssize_t)bpp)
+          return (0);
+
+        wptr  += bpp;
+        bytes -= (ssize_t)count;
+      }
+    }
+
+    in->remaining  -= lines;
+    out->remaining -= lines;
+
+    if (wptr >= wend || in->remaining == 0)
+    {
+      if (cups_raster_io(out, out->buffer, (size_t)(wptr - out->buffer)) < (ssize_t)(wptr - out->buffer))
+        return (0);
+
+      wptr = out->buffer;
+    }
+  }
+
+  DEBUG_puts("1_cupsRasterCopyPage: Returning 1.");
+
+  return (1);
+}
+
+
 /*
  * '_cupsRasterDelete()' - Free a raster stream.
  *
@@ -169,9 +423,17 @@ _cupsRasterDelete(cups_raster_t *r)	/* I - Stream to free */
 {
   if (r != NULL)
   {
+#ifdef HAVE_PTHREAD_H
+    if (r->pipe)
+      cups_raster_pipe_free(r);
+#endif /* HAVE_PTHREAD_H */
+
     if (r->buffer)
       free(r->buffer);
 
+    if (r->band)
+      free(r->band);
+
     if (r->pixels)
       free(r->pixels);
 
@@ -439,12 +701,18 @@ _cupsRasterNew(
     cups_mode_t        mode)		/* I - Mode - @code CUPS_RASTER_READ@,
 	                                       @code CUPS_RASTER_WRITE@,
 					       @code CUPS_RASTER_WRITE_COMPRESSED@,
-					       or @code CUPS_RASTER_WRITE_PWG@ */
+					       or @code CUPS_RASTER_WRITE_PWG@,
+					       optionally with
+					       @code CUPS_RASTER_WRITE_THREADED@ */
 {
   cups_raster_t	*r;			/* New stream */
+  int		threaded = (mode & CUPS_RASTER_WRITE_THREADED) != 0;
+					/* Compress in worker threads? */
+
 
+  mode = (cups_mode_t)((unsigned)mode & ~(unsigned)CUPS_RASTER_WRITE_THREADED);
 
-  DEBUG_printf(("_cupsRasterOpenIO(iocb=%p, ctx=%p, mode=%s)", (void *)iocb, ctx, cups_modes[mode]));
+  DEBUG_printf(("_cupsRasterOpenIO(iocb=%p, ctx=%p, mode=%s, threaded=%d)", (void *)iocb, ctx, cups_modes[mode], threaded));
 
   _cupsRasterClearError();
 
@@ -565,6 +833,16 @@ _cupsRasterNew(
       DEBUG_puts("1_cupsRasterOpenIO: Unable to write header, returning NULL.");
       return (NULL);
     }
+
+#ifdef HAVE_PTHREAD_H
+   /*
+    * Start the encoder threads as needed; if that fails we just compress
+    * in the calling thread...
+    */
+
+    if (threaded && r->compressed)
+      r->pipe = cups_raster_pipe_new(r);
+#endif /* HAVE_PTHREAD_H */
   }
 
   DEBUG_printf(("1_cupsRasterOpenIO: compressed=%d, swapped=%d, returning %p", r->compressed, r->swapped, (void *)r));
@@ -737,6 +1015,113 @@ _cupsRasterReadHeader(
 }
 
 
+/*
+ * '_cupsRasterReadLines()' - Read a band of raster lines.
+ *
+ * This function reads up to "max_lines" whole lines of the current page and
+ * stores a pointer to each in the "lines" array.  The pointers refer to a
+ * buffer owned by the raster stream and remain valid until the next read on
+ * the stream.  Repeated lines in compressed streams share a single copy, and
+ * uncompressed lines are read with a single call, so filters avoid copying
+ * each line into their own buffer.
+ *
+ * Do not mix with partial-line calls to @link cupsRasterReadPixels@.
+ */
+
+unsigned				/* O - Number of lines read or 0 on EOF/error */
+_cupsRasterReadLines(
+    cups_raster_t       *r,		/* I - Raster stream */
+    const unsigned char **lines,	/* O - Pointers to lines */
+    unsigned            max_lines)	/* I - Maximum number of lines */
+{
+  unsigned	i,			/* Looping var */
+		num_lines = 0,		/* Number of lines read */
+		bpl;			/* Bytes per line */
+  size_t	bandsize;		/* Size of band buffer */
+  unsigned char	*slot;			/* Next free line in band buffer */
+
+
+  DEBUG_printf(("_cupsRasterReadLines(r=%p, lines=%p, max_lines=%u)", (void *)r, (void *)lines, max_lines));
+
+  if (r == NULL || r->mode != CUPS_RASTER_READ || r->remaining == 0 ||
+      r->header.cupsBytesPerLine == 0 || !lines || max_lines == 0)
+    return (0);
+
+  if (max_lines > r->remaining)
+    max_lines = r->remaining;
+
+  bpl      = r->header.cupsBytesPerLine;
+  bandsize = (size_t)bpl * max_lines;
+
+  if (bandsize > r->bandsize)
+  {
+    if ((slot = realloc(r->band, bandsize)) == NULL)
+    {
+      DEBUG_printf(("1_cupsRasterReadLines: Unable to allocate " CUPS_LLFMT " bytes for band: %s", CUPS_LLCAST bandsize, strerror(errno)));
+      return (0);
+    }
+
+    r->band     = slot;
+    r->bandsize = bandsize;
+  }
+
+  if (!r->compressed)
+  {
+   /*
+    * Uncompressed data is read in one go...
+    */
+
+    if (_cupsRasterReadPixels(r, r->band, (unsigned)bandsize) != bandsize)
+      return (0);
+
+    for (i = 0, slot = r->band; i < max_lines; i ++, slot += bpl)
+      lines[i] = slot;
+
+    return (max_lines);
+  }
+
+  for (slot = r->band; num_lines < max_lines;)
+  {
+    if (r->count > 0 && r->pcurrent == r->pixels)
+    {
+     /*
+      * The rest of a repeated line is sitting in the pixel buffer; after a
+      * fresh decode below it is also the previous line in the band...
+      */
+
+      const unsigned char *line;	/* Repeated line */
+
+      if (num_lines == 0)
+      {
+        memcpy(slot, r->pixels, bpl);
+        line = slot;
+        slot += bpl;
+      }
+      else
+        line = lines[num_lines - 1];
+
+      while (r->count > 0 && num_lines < max_lines)
+      {
+        lines[num_lines ++] = line;
+        r->count --;
+        r->remaining --;
+      }
+    }
+    else if (_cupsRasterReadPixels(r, slot, bpl) == bpl)
+    {
+      lines[num_lines ++] = slot;
+      slot += bpl;
+    }
+    else
+      return (0);
+  }
+
+  DEBUG_printf(("1_cupsRasterReadLines: Returning %u.", num_lines));
+
+  return (num_lines);
+}
+
+
 /*
  * '_cupsRasterReadPixels()' - Read raster pixels.
  *
@@ -919,15 +1304,34 @@ _cupsRasterReadPixels(
 	    return (0);
 	  }
 
-	  temp  += r->bpp;
-	  count -= r->bpp;
+	  if (r->bpp == 1)
+	  {
+	   /*
+	    * Single byte pixels are just a fill...
+	    */
 
-	  while (count > 0)
+	    memset(temp + 1, *temp, count - 1);
+	    temp += count;
+	  }
+	  else
 	  {
-	    memcpy(temp, temp - r->bpp, r->bpp);
-	    temp  += r->bpp;
-	    count -= r->bpp;
-          }
+	   /*
+	    * Replicate the pixel by doubling the copied span, so that large
+	    * runs take a handful of memcpy calls rather than one per pixel...
+	    */
+
+	    unsigned char	*run = temp;	/* Start of run */
+	    unsigned		filled,		/* Bytes filled so far */
+			n;		/* Bytes to copy */
+
+	    for (filled = r->bpp, temp += r->bpp, count -= r->bpp; count > 0; filled += n, temp += n, count -= n)
+	    {
+	      if ((n = filled) > count)
+	        n = count;
+
+	      memcpy(temp, run, n);
+	    }
+	  }
 	}
       }
 
@@ -1015,6 +1419,19 @@ _cupsRasterWriteHeader(
   DEBUG_printf(("1_cupsRasterWriteHeader: cupsWidth=%u", r->header.cupsWidth));
   DEBUG_printf(("1_cupsRasterWriteHeader: cupsHeight=%u", r->header.cupsHeight));
 
+#ifdef HAVE_PTHREAD_H
+ /*
+  * Queue the rest of any prior page; the new header is written after it
+  * without waiting for the encoder threads to finish...
+  */
+
+  if (r->pipe && !cups_raster_pipe_flush(r, 0))
+  {
+    DEBUG_puts("1_cupsRasterWriteHeader: Unable to write prior page, returning 0.");
+    return (0);
+  }
+#endif /* HAVE_PTHREAD_H */
+
  /*
   * Compute the number of raster lines in the page image...
   */
@@ -1094,7 +1511,7 @@ _cupsRasterWriteHeader(
     fh.cupsInteger[6]        = htonl((unsigned)(r->header.cupsImagingBBox[3] * r->header.HWResolution[1] / 72.0));
     fh.cupsInteger[7]        = htonl(0xffffff);
 
-    return (cups_raster_io(r, (unsigned char *)&fh, sizeof(fh)) == sizeof(fh));
+    return (cups_raster_header_io(r, (unsigned char *)&fh, sizeof(fh)) == sizeof(fh));
   }
   else if (r->mode == CUPS_RASTER_WRITE_APPLE)
   {
@@ -1125,7 +1542,7 @@ _cupsRasterWriteHeader(
       appleheader[6] = (unsigned char)(r->apple_page_count >> 8);
       appleheader[7] = (unsigned char)(r->apple_page_count);
 
-      if (cups_raster_io(r, appleheader, 8) != 8)
+      if (cups_raster_header_io(r, appleheader, 8) != 8)
         return (0);
     }
 
@@ -1163,10 +1580,10 @@ _cupsRasterWriteHeader(
       }
     }
 
-    return (cups_raster_io(r, appleheader, sizeof(appleheader)) == sizeof(appleheader));
+    return (cups_raster_header_io(r, appleheader, sizeof(appleheader)) == sizeof(appleheader));
   }
   else
-    return (cups_raster_io(r, (unsigned char *)&(r->header), sizeof(r->header))
+    return (cups_raster_header_io(r, (unsigned char *)&(r->header), sizeof(r->header))
 		== sizeof(r->header));
 }
 
@@ -1353,64 +1770,584 @@ _cupsRasterWritePixels(
 
 
 /*
- * 'cups_raster_io()' - Read/write bytes from a context, handling interruptions.
+ * 'cups_raster_encode()' - Compress a row of raster data.
+ *
+ * The output buffer must hold at least 2 * "bytes_per_line" + 2 bytes.
  */
 
-static ssize_t				/* O - Bytes read/write or -1 */
-cups_raster_io(cups_raster_t *r,	/* I - Raster stream */
-               unsigned char *buf,	/* I - Buffer for read/write */
-               size_t        bytes)	/* I - Number of bytes to read/write */
+static size_t				/* O - Number of bytes encoded */
+cups_raster_encode(
+    unsigned char       *buffer,	/* I - Output buffer */
+    const unsigned char *pixels,	/* I - Pixel data to write */
+    unsigned            bytes_per_line,	/* I - Bytes per line */
+    unsigned            bpp,		/* I - Bytes per pixel */
+    unsigned            repeat,		/* I - Row repeat count */
+    int                 swap)		/* I - Swap bytes? */
 {
-  ssize_t	count,			/* Number of bytes read/written */
-		total;			/* Total bytes read/written */
-
+  const unsigned char	*start,		/* Start of sequence */
+			*ptr,		/* Current pointer in sequence */
+			*pend,		/* End of raster buffer */
+			*plast;		/* Pointer to last pixel */
+  unsigned char		*wptr;		/* Pointer into write buffer */
+  unsigned		count;		/* Count */
+  _cups_copyfunc_t	cf;		/* Copy function */
 
-  DEBUG_printf(("5cups_raster_io(r=%p, buf=%p, bytes=" CUPS_LLFMT ")", (void *)r, (void *)buf, CUPS_LLCAST bytes));
 
-  for (total = 0; total < (ssize_t)bytes; total += count, buf += count)
-  {
-    count = (*r->iocb)(r->ctx, buf, bytes - (size_t)total);
+ /*
+  * Determine whether we need to swap bytes...
+  */
 
-    DEBUG_printf(("6cups_raster_io: count=%d, total=%d", (int)count, (int)total));
-    if (count == 0)
-      break;
-//    {
-//      DEBUG_puts("6cups_raster_io: Returning 0.");
-//      return (0);
-//    }
-    else if (count < 0)
-    {
-      DEBUG_puts("6cups_raster_io: Returning -1 on error.");
-      return (-1);
-    }
+  if (swap)
+    cf = (_cups_copyfunc_t)cups_swap_copy;
+  else
+    cf = (_cups_copyfunc_t)memcpy;
 
-#ifdef DEBUG
-    r->iocount += (size_t)count;
-#endif /* DEBUG */
-  }
+ /*
+  * Write the row repeat count...
+  */
 
-  DEBUG_printf(("6cups_raster_io: iocount=" CUPS_LLFMT, CUPS_LLCAST r->iocount));
-  DEBUG_printf(("6cups_raster_io: Returning " CUPS_LLFMT ".", CUPS_LLCAST total));
+  pend    = pixels + bytes_per_line;
+  plast   = pend - bpp;
+  wptr    = buffer;
+  *wptr++ = (unsigned char)(repeat - 1);
 
-  return (total);
-}
+ /*
+  * Write using a modified PackBits compression...
+  */
 
+  for (ptr = pixels; ptr < pend;)
+  {
+    start = ptr;
+    ptr += bpp;
 
-/*
- * 'cups_raster_read()' - Read through the raster buffer.
- */
+    if (ptr == pend)
+    {
+     /*
+      * Encode a single pixel at the end...
+      */
 
-static ssize_t				/* O - Number of bytes read */
-cups_raster_read(cups_raster_t *r,	/* I - Raster stream */
-                 unsigned char *buf,	/* I - Buffer */
-                 size_t        bytes)	/* I - Number of bytes to read */
-{
-  ssize_t	count,			/* Number of bytes read */
-		remaining,		/* Remaining bytes in buffer */
-		total;			/* Total bytes read */
+      *wptr++ = 0;
+      (*cf)(wptr, start, bpp);
+      wptr += bpp;
+    }
+    else if (!cups_raster_pixcmp(start, ptr, bpp))
+    {
+     /*
+      * Encode a sequence of repeating pixels...
+      */
 
+      for (count = 2; count < 128 && ptr < plast; count ++, ptr += bpp)
+        if (cups_raster_pixcmp(ptr, ptr + bpp, bpp))
+	  break;
 
-  DEBUG_printf(("4cups_raster_read(r=%p, buf=%p, bytes=" CUPS_LLFMT "), offset=" CUPS_LLFMT, (void *)r, (void *)buf, CUPS_LLCAST bytes, CUPS_LLCAST (r->iostart + r->bufptr - r->buffer)));
+      *wptr++ = (unsigned char)(count - 1);
+      (*cf)(wptr, ptr, bpp);
+      wptr += bpp;
+      ptr  += bpp;
+    }
+    else
+    {
+     /*
+      * Encode a sequence of non-repeating pixels...
+      */
+
+      for (count = 1; count < 128 && ptr < plast; count ++, ptr += bpp)
+        if (!cups_raster_pixcmp(ptr, ptr + bpp, bpp))
+	  break;
+
+      if (ptr >= plast && count < 128)
+      {
+        count ++;
+	ptr += bpp;
+      }
+
+      *wptr++ = (unsigned char)(257 - count);
+
+      count *= bpp;
+      (*cf)(wptr, start, count);
+      wptr += count;
+    }
+  }
+
+
+  return ((size_t)(wptr - buffer));
+}
+
+
+/*
+ * 'cups_raster_header_io()' - Write a page header to the stream.
+ *
+ * With the encoder pipeline the header is queued behind the bands of the
+ * previous page so that the next page can be filled while those compress.
+ */
+
+static ssize_t				/* O - Bytes written or -1 on error */
+cups_raster_header_io(
+    cups_raster_t *r,			/* I - Raster stream */
+    unsigned char *buf,			/* I - Header data */
+    size_t        bytes)		/* I - Number of bytes */
+{
+#ifdef HAVE_PTHREAD_H
+  if (r->pipe)
+    return (cups_raster_pipe_write(r, buf, bytes));
+#endif /* HAVE_PTHREAD_H */
+
+  return (cups_raster_io(r, buf, bytes));
+}
+
+
+/*
+ * 'cups_raster_io()' - Read/write bytes from a context, handling interruptions.
+ */
+
+static ssize_t				/* O - Bytes read/write or -1 */
+cups_raster_io(cups_raster_t *r,	/* I - Raster stream */
+               unsigned char *buf,	/* I - Buffer for read/write */
+               size_t        bytes)	/* I - Number of bytes to read/write */
+{
+  ssize_t	count,			/* Number of bytes read/written */
+		total;			/* Total bytes read/written */
+
+
+  DEBUG_printf(("5cups_raster_io(r=%p, buf=%p, bytes=" CUPS_LLFMT ")", (void *)r, (void *)buf, CUPS_LLCAST bytes));
+
+  for (total = 0; total < (ssize_t)bytes; total += count, buf += count)
+  {
+    count = (*r->iocb)(r->ctx, buf, bytes - (size_t)total);
+
+    DEBUG_printf(("6cups_raster_io: count=%d, total=%d", (int)count, (int)total));
+    if (count == 0)
+      break;
+//    {
+//      DEBUG_puts("6cups_raster_io: Returning 0.");
+//      return (0);
+//    }
+    else if (count < 0)
+    {
+      DEBUG_puts("6cups_raster_io: Returning -1 on error.");
+      return (-1);
+    }
+
+#ifdef DEBUG
+    r->iocount += (size_t)count;
+#endif /* DEBUG */
+  }
+
+  DEBUG_printf(("6cups_raster_io: iocount=" CUPS_LLFMT, CUPS_LLCAST r->iocount));
+  DEBUG_printf(("6cups_raster_io: Returning " CUPS_LLFMT ".", CUPS_LLCAST total));
+
+  return (total);
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * 'cups_raster_pipe_drain()' - Write out encoded bands in order.
+ *
+ * When "wait_all" is 0, returns as soon as a band is available for filling;
+ * otherwise waits until every queued band has been written.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+cups_raster_pipe_drain(
+    cups_raster_t *r,			/* I - Raster stream */
+    int           wait_all)		/* I - Wait for all bands? */
+{
+  _cups_raster_pipe_t	*pl = r->pipe;	/* Encoder pipeline */
+  _cups_raster_band_t	*band;		/* Current band */
+
+
+  _cupsMutexLock(&pl->mutex);
+
+  while ((band = pl->bands + pl->head)->state != _CUPS_RASTER_BAND_FREE)
+  {
+    if (band->state == _CUPS_RASTER_BAND_DONE)
+    {
+     /*
+      * Write this band without holding the lock; the workers never touch a
+      * finished band...
+      */
+
+      _cupsMutexUnlock(&pl->mutex);
+
+      if (!pl->error && cups_raster_io(r, band->out, band->outlen) < (ssize_t)band->outlen)
+        pl->error = 1;
+
+      _cupsMutexLock(&pl->mutex);
+
+      band->state     = _CUPS_RASTER_BAND_FREE;
+      band->num_lines = 0;
+      pl->head      = (pl->head + 1) % pl->num_bands;
+    }
+    else if (wait_all || pl->bands[pl->tail].state != _CUPS_RASTER_BAND_FREE)
+      _cupsCondWait(&pl->cond, &pl->mutex, 0.0);
+    else
+      break;
+  }
+
+  _cupsMutexUnlock(&pl->mutex);
+
+  return (!pl->error);
+}
+
+
+/*
+ * 'cups_raster_pipe_flush()' - Queue any partial band and write bands.
+ *
+ * When "wait_all" is 0 only the bands that are already compressed are
+ * written; otherwise all bands and any queued page header are written.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+cups_raster_pipe_flush(
+    cups_raster_t *r,			/* I - Raster stream */
+    int           wait_all)		/* I - Wait for all bands? */
+{
+  _cups_raster_pipe_t	*pl = r->pipe;	/* Encoder pipeline */
+
+
+  if (pl->bands[pl->tail].num_lines > 0)
+  {
+    _cupsMutexLock(&pl->mutex);
+
+    pl->bands[pl->tail].state = _CUPS_RASTER_BAND_QUEUED;
+    pl->tail                    = (pl->tail + 1) % pl->num_bands;
+
+    _cupsCondBroadcast(&pl->cond);
+    _cupsMutexUnlock(&pl->mutex);
+  }
+
+  if (!cups_raster_pipe_drain(r, wait_all))
+    return (0);
+
+  if (wait_all && pl->prefixlen > 0)
+  {
+    if (cups_raster_io(r, pl->prefix, pl->prefixlen) < (ssize_t)pl->prefixlen)
+      pl->error = 1;
+
+    pl->prefixlen = 0;
+  }
+
+  return (!pl->error);
+}
+
+
+/*
+ * 'cups_raster_pipe_free()' - Stop the encoder threads and free the pipeline.
+ */
+
+static void
+cups_raster_pipe_free(
+    cups_raster_t *r)			/* I - Raster stream */
+{
+  int			i;		/* Looping var */
+  _cups_raster_pipe_t	*pl = r->pipe;	/* Encoder pipeline */
+
+
+  cups_raster_pipe_flush(r, 1);
+
+  _cupsMutexLock(&pl->mutex);
+  pl->shutdown = 1;
+  _cupsCondBroadcast(&pl->cond);
+  _cupsMutexUnlock(&pl->mutex);
+
+  for (i = 0; i < pl->num_threads; i ++)
+    _cupsThreadWait(pl->threads[i]);
+
+  for (i = 0; i < pl->num_bands; i ++)
+  {
+    free(pl->bands[i].pixels);
+    free(pl->bands[i].out);
+  }
+
+  free(pl);
+
+  r->pipe = NULL;
+}
+
+
+/*
+ * 'cups_raster_pipe_new()' - Start worker threads for compressed writing.
+ */
+
+static _cups_raster_pipe_t *		/* O - Encoder pipeline or @code NULL@ */
+cups_raster_pipe_new(
+    cups_raster_t *r)			/* I - Raster stream */
+{
+  int			i;		/* Looping var */
+  long			num_cpus;	/* Number of processors */
+  _cups_raster_pipe_t	*pl;		/* Encoder pipeline */
+
+
+ /*
+  * Threads only pay off with more than one processor...
+  */
+
+  if ((num_cpus = sysconf(_SC_NPROCESSORS_ONLN)) < 2)
+    return (NULL);
+  else if (num_cpus > _CUPS_RASTER_MAX_THREADS)
+    num_cpus = _CUPS_RASTER_MAX_THREADS;
+
+  if ((pl = calloc(1, sizeof(_cups_raster_pipe_t))) == NULL)
+    return (NULL);
+
+  _cupsMutexInit(&pl->mutex);
+  _cupsCondInit(&pl->cond);
+
+  pl->r         = r;
+  pl->num_bands = 2 * (int)num_cpus;
+
+  for (i = 0; i < num_cpus; i ++)
+  {
+    if ((pl->threads[i] = _cupsThreadCreate((_cups_thread_func_t)cups_raster_pipe_thread, pl)) == 0)
+      break;
+
+    pl->num_threads ++;
+  }
+
+  if (!pl->num_threads)
+  {
+    free(pl);
+    return (NULL);
+  }
+
+  DEBUG_printf(("4cups_raster_pipe_new: Started %d encoder threads.", pl->num_threads));
+
+  return (pl);
+}
+
+
+/*
+ * 'cups_raster_pipe_queue()' - Queue a row of raster data for compression.
+ */
+
+static ssize_t				/* O - Number of bytes queued or -1 on error */
+cups_raster_pipe_queue(
+    cups_raster_t       *r,		/* I - Raster stream */
+    const unsigned char *pixels)	/* I - Pixel data to write */
+{
+  _cups_raster_pipe_t	*pl = r->pipe;	/* Encoder pipeline */
+  _cups_raster_band_t	*band = pl->bands + pl->tail;
+					/* Band being filled */
+  unsigned		bpl = r->header.cupsBytesPerLine;
+					/* Bytes per line */
+
+
+  if (pl->error)
+    return (-1);
+
+  if (band->num_lines == 0)
+  {
+   /*
+    * Starting a new band, make sure the buffers are big enough and capture
+    * the page parameters...
+    */
+
+    size_t	pixsize = (size_t)bpl * _CUPS_RASTER_BAND_LINES,
+					/* Size of pixel buffer */
+		outsize = (2 * (size_t)bpl + 2) * _CUPS_RASTER_BAND_LINES + pl->prefixlen;
+					/* Size of output buffer */
+
+    if (pixsize > band->pixsize)
+    {
+      unsigned char *temp = realloc(band->pixels, pixsize);
+					/* New pixel buffer */
+
+      if (!temp)
+        return (-1);
+
+      band->pixels  = temp;
+      band->pixsize = pixsize;
+    }
+
+    if (outsize > band->outsize)
+    {
+      unsigned char *temp = realloc(band->out, outsize);
+					/* New output buffer */
+
+      if (!temp)
+        return (-1);
+
+      band->out     = temp;
+      band->outsize = outsize;
+    }
+
+   /*
+    * The first band of a page carries the page header...
+    */
+
+    memcpy(band->out, pl->prefix, pl->prefixlen);
+    band->outlen  = pl->prefixlen;
+    pl->prefixlen = 0;
+
+    band->bytes_per_line = bpl;
+    band->bpp            = r->bpp;
+    band->swap           = r->swapped && (r->header.cupsBitsPerColor == 16 || r->header.cupsBitsPerPixel == 12 || r->header.cupsBitsPerPixel == 16);
+  }
+
+  memcpy(band->pixels + band->num_lines * bpl, pixels, bpl);
+  band->repeats[band->num_lines ++] = r->count;
+
+  if (band->num_lines == _CUPS_RASTER_BAND_LINES && r->remaining > 0)
+  {
+   /*
+    * Hand the full band to the workers and write anything that is done...
+    */
+
+    _cupsMutexLock(&pl->mutex);
+
+    band->state = _CUPS_RASTER_BAND_QUEUED;
+    pl->tail  = (pl->tail + 1) % pl->num_bands;
+
+    _cupsCondBroadcast(&pl->cond);
+    _cupsMutexUnlock(&pl->mutex);
+
+    if (!cups_raster_pipe_drain(r, 0))
+      return (-1);
+  }
+  else if (r->remaining == 0 && !cups_raster_pipe_flush(r, 0))
+    return (-1);
+
+  return ((ssize_t)bpl);
+}
+
+
+/*
+ * 'cups_raster_pipe_thread()' - Compress queued bands of raster data.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+cups_raster_pipe_thread(
+    _cups_raster_pipe_t *pl)		/* I - Encoder pipeline */
+{
+  _cups_raster_band_t	*band;		/* Current band */
+  unsigned		i;		/* Looping var */
+  size_t		outlen;		/* Output length */
+
+
+  _cupsMutexLock(&pl->mutex);
+
+  while (!pl->shutdown)
+  {
+    band = pl->bands + pl->next;
+
+    if (band->state != _CUPS_RASTER_BAND_QUEUED)
+    {
+      _cupsCondWait(&pl->cond, &pl->mutex, 0.0);
+      continue;
+    }
+
+    band->state = _CUPS_RASTER_BAND_BUSY;
+    pl->next  = (pl->next + 1) % pl->num_bands;
+
+    _cupsMutexUnlock(&pl->mutex);
+
+    for (i = 0, outlen = band->outlen; i < band->num_lines; i ++)
+      outlen += cups_raster_encode(band->out + outlen, band->pixels + i * band->bytes_per_line, band->bytes_per_line, band->bpp, band->repeats[i], band->swap);
+
+    _cupsMutexLock(&pl->mutex);
+
+    band->outlen = outlen;
+    band->state  = _CUPS_RASTER_BAND_DONE;
+
+    _cupsCondBroadcast(&pl->cond);
+  }
+
+  _cupsMutexUnlock(&pl->mutex);
+
+  return (NULL);
+}
+
+
+/*
+ * 'cups_raster_pipe_write()' - Queue header data behind the pending bands.
+ */
+
+static ssize_t				/* O - Bytes written or -1 on error */
+cups_raster_pipe_write(
+    cups_raster_t *r,			/* I - Raster stream */
+    unsigned char *buf,			/* I - Header data */
+    size_t        bytes)		/* I - Number of bytes */
+{
+  _cups_raster_pipe_t	*pl = r->pipe;	/* Encoder pipeline */
+  int			pending;	/* Bands waiting to be written? */
+
+
+  if (pl->error)
+    return (-1);
+
+  _cupsMutexLock(&pl->mutex);
+  pending = pl->bands[pl->head].state != _CUPS_RASTER_BAND_FREE;
+  _cupsMutexUnlock(&pl->mutex);
+
+  if ((pending || pl->prefixlen > 0) && bytes <= (sizeof(pl->prefix) - pl->prefixlen))
+  {
+   /*
+    * Attach the header to the first band of the next page...
+    */
+
+    memcpy(pl->prefix + pl->prefixlen, buf, bytes);
+    pl->prefixlen += bytes;
+
+    return ((ssize_t)bytes);
+  }
+
+ /*
+  * Otherwise write everything out and then the header...
+  */
+
+  if (!cups_raster_pipe_flush(r, 1))
+    return (-1);
+
+  return (cups_raster_io(r, buf, bytes));
+}
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * 'cups_raster_pixcmp()' - Compare two pixels.
+ *
+ * The common pixel sizes are compared inline since calling memcmp() for each
+ * pixel of a line dominates the cost of compression.
+ */
+
+static int				/* O - 0 if equal, non-zero otherwise */
+cups_raster_pixcmp(
+    const unsigned char *a,		/* I - First pixel */
+    const unsigned char *b,		/* I - Second pixel */
+    unsigned            bpp)		/* I - Bytes per pixel */
+{
+  switch (bpp)
+  {
+    case 1 :
+        return (a[0] != b[0]);
+    case 2 :
+        return (a[0] != b[0] || a[1] != b[1]);
+    case 3 :
+        return (a[0] != b[0] || a[1] != b[1] || a[2] != b[2]);
+    case 4 :
+        return (a[0] != b[0] || a[1] != b[1] || a[2] != b[2] || a[3] != b[3]);
+    default :
+        return (memcmp(a, b, bpp));
+  }
+}
+
+
+/*
+ * 'cups_raster_read()' - Read through the raster buffer.
+ */
+
+static ssize_t				/* O - Number of bytes read */
+cups_raster_read(cups_raster_t *r,	/* I - Raster stream */
+                 unsigned char *buf,	/* I - Buffer */
+                 size_t        bytes)	/* I - Number of bytes to read */
+{
+  ssize_t	count,			/* Number of bytes read */
+		remaining,		/* Remaining bytes in buffer */
+		total;			/* Total bytes read */
+
+
+  DEBUG_printf(("4cups_raster_read(r=%p, buf=%p, bytes=" CUPS_LLFMT "), offset=" CUPS_LLFMT, (void *)r, (void *)buf, CUPS_LLCAST bytes, CUPS_LLCAST (r->iostart + r->bufptr - r->buffer)));
 
   if (!r->compressed)
     return (cups_raster_io(r, buf, bytes));
@@ -1700,29 +2637,20 @@ cups_raster_write(
     cups_raster_t       *r,		/* I - Raster stream */
     const unsigned char *pixels)	/* I - Pixel data to write */
 {
-  const unsigned char	*start,		/* Start of sequence */
-			*ptr,		/* Current pointer in sequence */
-			*pend,		/* End of raster buffer */
-			*plast;		/* Pointer to last pixel */
   unsigned char		*wptr;		/* Pointer into write buffer */
-  unsigned		bpp,		/* Bytes per pixel */
-			count;		/* Count */
-  _cups_copyfunc_t	cf;		/* Copy function */
+  size_t		count;		/* Count */
 
 
   DEBUG_printf(("3cups_raster_write(r=%p, pixels=%p)", (void *)r, (void *)pixels));
 
+#ifdef HAVE_PTHREAD_H
  /*
-  * Determine whether we need to swap bytes...
+  * Hand off to the encoder threads as needed...
   */
 
-  if (r->swapped && (r->header.cupsBitsPerColor == 16 || r->header.cupsBitsPerPixel == 12 || r->header.cupsBitsPerPixel == 16))
-  {
-    DEBUG_puts("4cups_raster_write: Swapping bytes when writing.");
-    cf = (_cups_copyfunc_t)cups_swap_copy;
-  }
-  else
-    cf = (_cups_copyfunc_t)memcpy;
+  if (r->pipe)
+    return (cups_raster_pipe_queue(r, pixels));
+#endif /* HAVE_PTHREAD_H */
 
   /*
   * Allocate a write buffer as needed...
@@ -1732,7 +2660,7 @@ cups_raster_write(
   if (count < 65536)
     count = 65536;
 
-  if ((size_t)count > r->bufsize)
+  if (count > r->bufsize)
   {
     if (r->buffer)
       wptr = realloc(r->buffer, count);
@@ -1750,79 +2678,18 @@ cups_raster_write(
   }
 
  /*
-  * Write the row repeat count...
+  * Compress the row, swapping bytes as needed...
   */
 
-  bpp     = r->bpp;
-  pend    = pixels + r->header.cupsBytesPerLine;
-  plast   = pend - bpp;
-  wptr    = r->buffer;
-  *wptr++ = (unsigned char)(r->count - 1);
+  count = cups_raster_encode(r->buffer, pixels, r->header.cupsBytesPerLine, r->bpp, r->count, r->swapped && (r->header.cupsBitsPerColor == 16 || r->header.cupsBitsPerPixel == 12 || r->header.cupsBitsPerPixel == 16));
 
- /*
-  * Write using a modified PackBits compression...
-  */
+  DEBUG_printf(("4cups_raster_write: Writing " CUPS_LLFMT " bytes.", CUPS_LLCAST count));
 
-  for (ptr = pixels; ptr < pend;)
-  {
-    start = ptr;
-    ptr += bpp;
-
-    if (ptr == pend)
-    {
-     /*
-      * Encode a single pixel at the end...
-      */
-
-      *wptr++ = 0;
-      (*cf)(wptr, start, bpp);
-      wptr += bpp;
-    }
-    else if (!memcmp(start, ptr, bpp))
-    {
-     /*
-      * Encode a sequence of repeating pixels...
-      */
-
-      for (count = 2; count < 128 && ptr < plast; count ++, ptr += bpp)
-        if (memcmp(ptr, ptr + bpp, bpp))
-	  break;
-
-      *wptr++ = (unsigned char)(count - 1);
-      (*cf)(wptr, ptr, bpp);
-      wptr += bpp;
-      ptr  += bpp;
-    }
-    else
-    {
-     /*
-      * Encode a sequence of non-repeating pixels...
-      */
-
-      for (count = 1; count < 128 && ptr < plast; count ++, ptr += bpp)
-        if (!memcmp(ptr, ptr + bpp, bpp))
-	  break;
-
-      if (ptr >= plast && count < 128)
-      {
-        count ++;
-	ptr += bpp;
-      }
-
-      *wptr++ = (unsigned char)(257 - count);
-
-      count *= bpp;
-      (*cf)(wptr, start, count);
-      wptr += count;
-    }
-  }
-
-  DEBUG_printf(("4cups_raster_write: Writing " CUPS_LLFMT " bytes.", CUPS_LLCAST (wptr - r->buffer)));
-
-  return (cups_raster_io(r, r->buffer, (size_t)(wptr - r->buffer)));
+  return (cups_raster_io(r, r->buffer, count));
 }
 
 
+
 /*
  * 'cups_swap()' - Swap bytes in raster data...
  */
@@ -208,7 +208,8 @@ enum cups_mode_e			/**** cupsRasterOpen modes ****/
   CUPS_RASTER_WRITE = 1,		/* Open stream for writing */
   CUPS_RASTER_WRITE_COMPRESSED = 2,	/* Open stream for compressed writing @since CUPS 1.3/macOS 10.5@ */
   CUPS_RASTER_WRITE_PWG = 3,		/* Open stream for compressed writing in PWG Raster mode @since CUPS 1.5/macOS 10.7@ */
-  CUPS_RASTER_WRITE_APPLE = 4		/* Open stream for compressed writing in AppleRaster mode (beta) @private@ */
+  CUPS_RASTER_WRITE_APPLE = 4,		/* Open stream for compressed writing in AppleRaster mode (beta) @private@ */
+  CUPS_RASTER_WRITE_THREADED = 0x100	/* Flag: compress lines in worker threads @since CUPS 2.3@ */
 };
 
 typedef enum cups_mode_e cups_mode_t;	/**** cupsRasterOpen modes ****/
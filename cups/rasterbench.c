@@ -29,17 +29,82 @@
 #define TEST_HEIGHT	1024
 #define TEST_PAGES	16
 #define TEST_PASSES	20
+#define TEST_MAX_PASSES	1000
+
+
+/*
+ * Local types...
+ */
+
+typedef enum bench_content_e		/**** Content patterns ****/
+{
+  BENCH_TEXT,				/* Sparse runs, like text with whitespace */
+  BENCH_PHOTO,				/* Noisy continuous tone */
+  BENCH_BLANK,				/* Blank page */
+  BENCH_NUM_CONTENT
+} bench_content_t;
+
+typedef struct bench_format_s		/**** Color space/bit depth ****/
+{
+  const char	*name;			/* Name for reports */
+  cups_cspace_t	cups_cspace,		/* Color space for CUPS raster */
+		pwg_cspace,		/* Color space for PWG raster */
+		apple_cspace;		/* Color space for Apple raster */
+  unsigned	num_colors,		/* Number of colors */
+		bits_per_color;		/* Bits per color */
+} bench_format_t;
+
+typedef struct bench_stats_s		/**** Results for one test ****/
+{
+  int		num_passes;		/* Number of passes */
+  double	write_secs[TEST_MAX_PASSES],
+					/* Write times */
+		total_secs[TEST_MAX_PASSES];
+					/* Write+read times */
+} bench_stats_t;
+
+
+/*
+ * Local globals...
+ */
+
+static const char * const contents[] =	/* Content pattern names */
+{
+  "text",
+  "photo",
+  "blank"
+};
+static const bench_format_t formats[] =	/* Color spaces and bit depths */
+{
+  { "gray8",  CUPS_CSPACE_K,    CUPS_CSPACE_SW,   CUPS_CSPACE_W,    1, 8 },
+  { "gray16", CUPS_CSPACE_K,    CUPS_CSPACE_SW,   CUPS_CSPACE_W,    1, 16 },
+  { "rgb8",   CUPS_CSPACE_RGB,  CUPS_CSPACE_SRGB, CUPS_CSPACE_SRGB, 3, 8 },
+  { "cmyk8",  CUPS_CSPACE_CMYK, CUPS_CSPACE_CMYK, CUPS_CSPACE_CMYK, 4, 8 },
+  { "cmyk16", CUPS_CSPACE_CMYK, CUPS_CSPACE_CMYK, CUPS_CSPACE_CMYK, 4, 16 }
+};
+static const char * const modes[] =	/* Write mode names */
+{
+  "read",
+  "cups",
+  "compressed",
+  "pwg",
+  "apple"
+};
 
 
 /*
  * Local functions...
  */
 
-static double	compute_median(double *secs);
+static int	compare_secs(const void *a, const void *b);
+static double	compute_percentile(double *secs, int num_secs, double pct);
 static double	get_time(void);
+static void	make_data(unsigned char *data, size_t linesize, bench_content_t content);
 static void	read_test(int fd);
+static void	report(const char *mode, int threaded, const char *content, const bench_format_t *format, bench_stats_t *stats, int csv);
 static int	run_read_test(void);
-static void	write_test(int fd, cups_mode_t mode);
+static int	usage(void);
+static void	write_test(int fd, cups_mode_t mode, const bench_format_t *format, const unsigned char *data, size_t linesize);
 
 
 /*
@@ -55,22 +120,123 @@ main(int  argc,				/* I - Number of command-line args */
 		status;			/* Exit status of read process */
   double	start_secs,		/* Start time */
 		write_secs,		/* Write time */
-		read_secs,		/* Read time */
-		pass_secs[TEST_PASSES];	/* Total test times */
-  cups_mode_t	mode;			/* Write mode */
+		read_secs;		/* Read time */
+  int		m, c, f,		/* Current mode, content, format */
+		mode_first = CUPS_RASTER_WRITE,
+		mode_last = CUPS_RASTER_WRITE,
+					/* Range of write modes */
+		content_first = BENCH_TEXT,
+		content_last = BENCH_TEXT,
+					/* Range of content patterns */
+		format_first = 0,
+		format_last = (int)(sizeof(formats) / sizeof(formats[0])) - 1,
+					/* Range of formats */
+		num_passes = TEST_PASSES,
+					/* Number of passes */
+		threaded = 0,		/* Use threaded compression? */
+		csv = 0,		/* Produce CSV output? */
+		verbose = 1;		/* Show each pass? */
+  size_t	linesize;		/* Bytes per line */
+  unsigned char	*data;			/* Raster data to write */
+  bench_stats_t	stats;			/* Results for current test */
 
 
  /*
   * See if we have anything on the command-line...
   */
 
-  if (argc > 2 || (argc == 2 && strcmp(argv[1], "-z")))
+  for (i = 1; i < argc; i ++)
   {
-    puts("Usage: rasterbench [-z]");
-    return (1);
+    if (!strcmp(argv[i], "-z"))
+    {
+      mode_first = mode_last = CUPS_RASTER_WRITE_COMPRESSED;
+    }
+    else if (!strcmp(argv[i], "-a"))
+    {
+      mode_first    = CUPS_RASTER_WRITE;
+      mode_last     = CUPS_RASTER_WRITE_APPLE;
+      content_first = BENCH_TEXT;
+      content_last  = BENCH_NUM_CONTENT - 1;
+    }
+    else if (!strcmp(argv[i], "-c") && (i + 1) < argc)
+    {
+      i ++;
+
+      for (c = 0; c < BENCH_NUM_CONTENT; c ++)
+        if (!strcmp(argv[i], contents[c]))
+	  break;
+
+      if (c < BENCH_NUM_CONTENT)
+        content_first = content_last = c;
+      else if (!strcmp(argv[i], "all"))
+      {
+        content_first = BENCH_TEXT;
+        content_last  = BENCH_NUM_CONTENT - 1;
+      }
+      else
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-f") && (i + 1) < argc)
+    {
+      i ++;
+
+      for (f = 0; f < (int)(sizeof(formats) / sizeof(formats[0])); f ++)
+        if (!strcmp(argv[i], formats[f].name))
+	  break;
+
+      if (f < (int)(sizeof(formats) / sizeof(formats[0])))
+        format_first = format_last = f;
+      else if (strcmp(argv[i], "all"))
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-j"))
+    {
+      threaded = 1;
+    }
+    else if (!strcmp(argv[i], "-m") && (i + 1) < argc)
+    {
+      i ++;
+
+      for (m = CUPS_RASTER_WRITE; m <= CUPS_RASTER_WRITE_APPLE; m ++)
+        if (!strcmp(argv[i], modes[m]))
+	  break;
+
+      if (m <= CUPS_RASTER_WRITE_APPLE)
+        mode_first = mode_last = m;
+      else if (!strcmp(argv[i], "all"))
+      {
+        mode_first = CUPS_RASTER_WRITE;
+        mode_last  = CUPS_RASTER_WRITE_APPLE;
+      }
+      else
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-o") && (i + 1) < argc)
+    {
+      i ++;
+
+      if (!strcmp(argv[i], "csv"))
+        csv = 1;
+      else if (strcmp(argv[i], "text"))
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-p") && (i + 1) < argc)
+    {
+      i ++;
+
+      if ((num_passes = atoi(argv[i])) < 2 || num_passes > TEST_MAX_PASSES)
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-q"))
+    {
+      verbose = 0;
+    }
+    else
+      return (usage());
   }
 
-  mode = argc > 1 ? CUPS_RASTER_WRITE_COMPRESSED : CUPS_RASTER_WRITE;
+  if (csv)
+    verbose = 0;
 
  /*
   * Ignore SIGPIPE...
@@ -78,70 +244,121 @@ main(int  argc,				/* I - Number of command-line args */
 
   signal(SIGPIPE, SIG_IGN);
 
+ /*
+  * Allocate the line data, big enough for the widest format...
+  */
+
+  linesize = 8 * TEST_WIDTH;
+
+  if ((data = malloc(32 * linesize)) == NULL)
+  {
+    perror("Unable to allocate raster data");
+    return (1);
+  }
+
+  if (csv)
+    puts("mode,threaded,content,format,passes,write_mbps_p50,write_mbps_p90,write_lps_p50,total_mbps_p50,total_mbps_p10,total_mbps_p90,total_lps_p50,total_secs_p50");
+  else
+    printf("Test read/write speed of %d pages, %dx%d pixels, %d passes...\n\n",
+	   TEST_PAGES, TEST_WIDTH, TEST_HEIGHT, num_passes);
+
  /*
   * Run the tests several times to get a good average...
   */
 
-  printf("Test read/write speed of %d pages, %dx%d pixels...\n\n",
-         TEST_PAGES, TEST_WIDTH, TEST_HEIGHT);
-  for (i = 0; i < TEST_PASSES; i ++)
+  for (m = mode_first; m <= mode_last; m ++)
   {
-    printf("PASS %2d: ", i + 1);
-    fflush(stdout);
+    for (c = content_first; c <= content_last; c ++)
+    {
+      make_data(data, linesize, (bench_content_t)c);
+
+      for (f = format_first; f <= format_last; f ++)
+      {
+        if (verbose)
+	  printf("%s%s %s %s:\n", modes[m], threaded && m > CUPS_RASTER_WRITE ? "+threads" : "", contents[c], formats[f].name);
+
+	stats.num_passes = num_passes;
+
+	for (i = 0; i < num_passes; i ++)
+	{
+	  if (verbose)
+	  {
+	    printf("PASS %2d: ", i + 1);
+	    fflush(stdout);
+	  }
 
-    ras_fd     = run_read_test();
-    start_secs = get_time();
+	  ras_fd     = run_read_test();
+	  start_secs = get_time();
 
-    write_test(ras_fd, mode);
+	  write_test(ras_fd, (cups_mode_t)(m | (threaded ? CUPS_RASTER_WRITE_THREADED : 0)), formats + f, data, linesize);
 
-    write_secs = get_time();
-    printf(" %.3f write,", write_secs - start_secs);
-    fflush(stdout);
+	  write_secs = get_time();
+	  close(ras_fd);
+	  wait(&status);
+	  read_secs  = get_time();
 
-    close(ras_fd);
-    wait(&status);
+	  stats.write_secs[i] = write_secs - start_secs;
+	  stats.total_secs[i] = read_secs - start_secs;
 
-    read_secs    = get_time();
-    pass_secs[i] = read_secs - start_secs;
-    printf(" %.3f read, %.3f total\n", read_secs - write_secs, pass_secs[i]);
+	  if (verbose)
+	    printf(" %.3f write, %.3f read, %.3f total\n", write_secs - start_secs, read_secs - write_secs, stats.total_secs[i]);
+	}
+
+	report(modes[m], threaded && m > CUPS_RASTER_WRITE, contents[c], formats + f, &stats, csv);
+      }
+    }
   }
 
-  printf("\nMedian Total Time: %.3f seconds per document\n",
-         compute_median(pass_secs));
+  free(data);
 
   return (0);
 }
 
 
 /*
- * 'compute_median()' - Compute the median time for a test.
+ * 'compare_secs()' - Compare two time samples.
  */
 
-static double				/* O - Median time in seconds */
-compute_median(double *secs)		/* I - Array of time samples */
+static int				/* O - Result of comparison */
+compare_secs(const void *a,		/* I - First sample */
+             const void *b)		/* I - Second sample */
 {
-  int		i, j;			/* Looping vars */
-  double	temp;			/* Swap variable */
+  double	da = *((const double *)a),
+		db = *((const double *)b);
 
 
- /*
-  * Sort the array into ascending order using a quicky bubble sort...
-  */
+  return (da < db ? -1 : da > db);
+}
 
-  for (i = 0; i < (TEST_PASSES - 1); i ++)
-    for (j = i + 1; j < TEST_PASSES; j ++)
-      if (secs[i] > secs[j])
-      {
-        temp    = secs[i];
-	secs[i] = secs[j];
-	secs[j] = temp;
-      }
+
+/*
+ * 'compute_percentile()' - Compute a percentile time for a test.
+ *
+ * The samples are sorted in place.
+ */
+
+static double				/* O - Percentile time in seconds */
+compute_percentile(double *secs,	/* I - Array of time samples */
+                   int    num_secs,	/* I - Number of samples */
+                   double pct)		/* I - Percentile (0 to 100) */
+{
+  double	pos;			/* Position in sorted samples */
+  int		i;			/* Index of lower sample */
+
+
+  qsort(secs, (size_t)num_secs, sizeof(double), compare_secs);
 
  /*
-  * Return the average of the middle two samples...
+  * Linearly interpolate between the closest samples...
   */
 
-  return (0.5 * (secs[TEST_PASSES / 2 - 1] + secs[TEST_PASSES / 2]));
+  pos = (num_secs - 1) * pct / 100.0;
+  i   = (int)pos;
+
+  if (i >= (num_secs - 1))
+    return (secs[num_secs - 1]);
+
+  return (secs[i] + (pos - i) * (secs[i + 1] - secs[i]));
 }
 
 
@@ -160,6 +377,68 @@ get_time(void)
 }
 
 
+/*
+ * 'make_data()' - Create 32 lines of raster data for a content pattern.
+ */
+
+static void
+make_data(unsigned char   *data,	/* I - Line buffers */
+          size_t          linesize,	/* I - Size of each line */
+          bench_content_t content)	/* I - Content pattern */
+{
+  unsigned	x, y;			/* Looping vars */
+  unsigned	count;			/* Number of bytes to set */
+  unsigned char	*line;			/* Current line */
+
+
+  CUPS_SRAND(time(NULL));
+
+  memset(data, 0, 32 * linesize);
+
+  switch (content)
+  {
+    case BENCH_TEXT :
+       /*
+        * Create a combination of random data and repeated data to simulate
+	* text with some whitespace.
+	*/
+
+	for (y = 0, line = data; y < 28; y ++, line += linesize)
+	{
+	  for (x = CUPS_RAND() & 127, count = (CUPS_RAND() & 15) + 1;
+	       x < linesize;
+	       x ++, count --)
+	  {
+	    if (count <= 0)
+	    {
+	      x     += (CUPS_RAND() & 15) + 1;
+	      count = (CUPS_RAND() & 15) + 1;
+
+	      if (x >= linesize)
+		break;
+	    }
+
+	    line[x] = (unsigned char)CUPS_RAND();
+	  }
+	}
+        break;
+
+    case BENCH_PHOTO :
+       /*
+        * Smooth gradients with a little noise, so few pixels repeat...
+	*/
+
+	for (y = 0, line = data; y < 32; y ++, line += linesize)
+	  for (x = 0; x < linesize; x ++)
+	    line[x] = (unsigned char)(((x + 3 * y) / 5) ^ (CUPS_RAND() & 7));
+        break;
+
+    default :
+        break;
+  }
+}
+
+
 /*
  * 'read_test()' - Benchmark the raster read functions.
  */
@@ -194,6 +473,48 @@ read_test(int fd)			/* I - File descriptor to read from */
 }
 
 
+/*
+ * 'report()' - Report the results of a test.
+ */
+
+static void
+report(const char           *mode,	/* I - Write mode */
+       int                  threaded,	/* I - Threaded compression? */
+       const char           *content,	/* I - Content pattern */
+       const bench_format_t *format,	/* I - Color space/bit depth */
+       bench_stats_t        *stats,	/* I - Results */
+       int                  csv)	/* I - Produce CSV output? */
+{
+  double	bytes,			/* Uncompressed bytes per pass */
+		lines,			/* Lines per pass */
+		write_p50,		/* Median write time */
+		write_p90,		/* 90th percentile write time */
+		total_p10,		/* 10th percentile total time */
+		total_p50,		/* Median total time */
+		total_p90;		/* 90th percentile total time */
+
+
+  lines = (double)TEST_PAGES * TEST_HEIGHT;
+  bytes = lines * TEST_WIDTH * format->num_colors * format->bits_per_color / 8;
+
+  write_p50 = compute_percentile(stats->write_secs, stats->num_passes, 50.0);
+  write_p90 = compute_percentile(stats->write_secs, stats->num_passes, 90.0);
+  total_p10 = compute_percentile(stats->total_secs, stats->num_passes, 10.0);
+  total_p50 = compute_percentile(stats->total_secs, stats->num_passes, 50.0);
+  total_p90 = compute_percentile(stats->total_secs, stats->num_passes, 90.0);
+
+ /*
+  * Throughput percentiles are reported from the time percentiles, so the
+  * "p90" rate is the slow end of the distribution...
+  */
+
+  if (csv)
+    printf("%s,%d,%s,%s,%d,%.1f,%.1f,%.0f,%.1f,%.1f,%.1f,%.0f,%.4f\n", mode, threaded, content, format->name, stats->num_passes, bytes / write_p50 / 1000000.0, bytes / write_p90 / 1000000.0, lines / write_p50, bytes / total_p50 / 1000000.0, bytes / total_p10 / 1000000.0, bytes / total_p90 / 1000000.0, lines / total_p50, total_p50);
+  else
+    printf("%-10s %-5s %-6s  write %8.1f MB/s (p90 %8.1f) %9.0f lines/s  total %8.1f MB/s (p10 %8.1f, p90 %8.1f) %9.0f lines/s\n\n", mode, content, format->name, bytes / write_p50 / 1000000.0, bytes / write_p90 / 1000000.0, lines / write_p50, bytes / total_p50 / 1000000.0, bytes / total_p10 / 1000000.0, bytes / total_p90 / 1000000.0, lines / total_p50);
+}
+
+
 /*
  * 'run_read_test()' - Run the read test as a child process via pipes.
  */
@@ -208,6 +529,12 @@ run_read_test(void)
   if (pipe(ras_pipes))
     return (-1);
 
+ /*
+  * Flush any pending output so the child doesn't write it again...
+  */
+
+  fflush(stdout);
+
   if ((pid = fork()) < 0)
   {
    /*
@@ -241,49 +568,45 @@ run_read_test(void)
 }
 
 
+/*
+ * 'usage()' - Show program usage.
+ */
+
+static int				/* O - Exit status */
+usage(void)
+{
+  puts("Usage: rasterbench [options]");
+  puts("Options:");
+  puts("  -a                      Test all modes and content patterns.");
+  puts("  -c {text,photo,blank,all}  Content pattern (default text).");
+  puts("  -f {gray8,gray16,rgb8,cmyk8,cmyk16,all}  Color space/bit depth (default all).");
+  puts("  -j                      Compress using worker threads.");
+  puts("  -m {cups,compressed,pwg,apple,all}  Write mode (default cups).");
+  puts("  -o {text,csv}           Output format (default text).");
+  puts("  -p passes               Number of passes (default 20).");
+  puts("  -q                      Don't show individual passes.");
+  puts("  -z                      Same as \"-m compressed\".");
+
+  return (1);
+}
+
+
 /*
  * 'write_test()' - Benchmark the raster write functions.
  */
 
 static void
-write_test(int         fd,		/* I - File descriptor to write to */
-           cups_mode_t mode)		/* I - Write mode */
+write_test(int                  fd,	/* I - File descriptor to write to */
+           cups_mode_t          mode,	/* I - Write mode */
+           const bench_format_t *format,/* I - Color space/bit depth */
+           const unsigned char  *data,	/* I - Line data */
+           size_t               linesize)/* I - Size of each line buffer */
 {
-  unsigned		page, x, y;	/* Looping vars */
-  unsigned		count;		/* Number of bytes to set */
+  unsigned		page, y;	/* Looping vars */
   cups_raster_t		*r;		/* Raster stream */
   cups_page_header2_t	header;		/* Page header */
-  unsigned char		data[32][8 * TEST_WIDTH];
-					/* Raster data to write */
-
-
- /*
-  * Create a combination of random data and repeated data to simulate
-  * text with some whitespace.
-  */
-
-  CUPS_SRAND(time(NULL));
-
-  memset(data, 0, sizeof(data));
-
-  for (y = 0; y < 28; y ++)
-  {
-    for (x = CUPS_RAND() & 127, count = (CUPS_RAND() & 15) + 1;
-         x < sizeof(data[0]);
-         x ++, count --)
-    {
-      if (count <= 0)
-      {
-	x     += (CUPS_RAND() & 15) + 1;
-	count = (CUPS_RAND() & 15) + 1;
-
-        if (x >= sizeof(data[0]))
-	  break;
-      }
+  cups_mode_t		base;		/* Mode without flags */
 
-      data[y][x] = (unsigned char)CUPS_RAND();
-    }
-  }
 
  /*
   * Test write speed...
@@ -295,41 +618,33 @@ write_test(int         fd,		/* I - File descriptor to write to */
     return;
   }
 
+  base = (cups_mode_t)((unsigned)mode & ~(unsigned)CUPS_RASTER_WRITE_THREADED);
+
   for (page = 0; page < TEST_PAGES; page ++)
   {
     memset(&header, 0, sizeof(header));
     header.cupsWidth        = TEST_WIDTH;
     header.cupsHeight       = TEST_HEIGHT;
-    header.cupsBytesPerLine = TEST_WIDTH;
-
-    if (page & 1)
-    {
-      header.cupsBytesPerLine *= 4;
-      header.cupsColorSpace = CUPS_CSPACE_CMYK;
-      header.cupsColorOrder = CUPS_ORDER_CHUNKED;
-    }
+    header.HWResolution[0]  = 300;
+    header.HWResolution[1]  = 300;
+    header.cupsBitsPerColor = format->bits_per_color;
+    header.cupsBitsPerPixel = format->num_colors * format->bits_per_color;
+    header.cupsBytesPerLine = TEST_WIDTH * header.cupsBitsPerPixel / 8;
+    header.cupsColorOrder   = CUPS_ORDER_CHUNKED;
+    header.cupsNumColors    = format->num_colors;
+    header.cupsInteger[0]   = TEST_PAGES;
+
+    if (base == CUPS_RASTER_WRITE_PWG)
+      header.cupsColorSpace = format->pwg_cspace;
+    else if (base == CUPS_RASTER_WRITE_APPLE)
+      header.cupsColorSpace = format->apple_cspace;
     else
-    {
-      header.cupsColorSpace = CUPS_CSPACE_K;
-      header.cupsColorOrder = CUPS_ORDER_BANDED;
-    }
-
-    if (page & 2)
-    {
-      header.cupsBytesPerLine *= 2;
-      header.cupsBitsPerColor = 16;
-      header.cupsBitsPerPixel = (page & 1) ? 64 : 16;
-    }
-    else
-    {
-      header.cupsBitsPerColor = 8;
-      header.cupsBitsPerPixel = (page & 1) ? 32 : 8;
-    }
+      header.cupsColorSpace = format->cups_cspace;
 
     cupsRasterWriteHeader2(r, &header);
 
     for (y = 0; y < TEST_HEIGHT; y ++)
-      cupsRasterWritePixels(r, data[y & 31], header.cupsBytesPerLine);
+      cupsRasterWritePixels(r, (unsigned char *)data + (y & 31) * linesize, header.cupsBytesPerLine);
   }
 
   cupsRasterClose(r);
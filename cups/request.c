@@ -28,6 +28,13 @@
 #endif /* !MSG_DONTWAIT */
 
 
+/*
+ * Local constants...
+ */
+
+#define _CUPS_MAX_BATCH	65536		/* Maximum bytes of requests to queue */
+
+
 /*
  * 'cupsDoFileRequest()' - Do an IPP request with a file.
  *
@@ -460,6 +467,171 @@ cupsGetResponse(http_t     *http,	/* I - Connection to server or @code CUPS_HTTP
 }
 
 
+/*
+ * 'cupsGetResponses()' - Get the responses to a batch of IPP requests.
+ *
+ * This function reads the responses to requests sent with
+ * @link cupsSendRequests@, in the order the requests were sent.  Each element
+ * of the "responses" array is set to the corresponding IPP response or
+ * @code NULL@ if that request failed at the HTTP level.  Requests that need
+ * authentication or encryption are not retried - when authentication is
+ * needed the credentials for "resource" are set up on the connection so the
+ * failed requests can be resent.  The last IPP status is available using
+ * @link cupsLastError@.
+ *
+ * @since CUPS 2.4@
+ */
+
+int					/* O - Number of responses received */
+cupsGetResponses(
+    http_t     *http,			/* I - Connection to server or @code CUPS_HTTP_DEFAULT@ */
+    int        num_responses,		/* I - Number of responses to read */
+    ipp_t      **responses,		/* O - Array of IPP responses */
+    const char *resource)		/* I - HTTP resource for POST */
+{
+  int		i,			/* Looping var */
+		count = 0,		/* Number of responses received */
+		authorized = 0;		/* Set up authentication? */
+  http_status_t	status;			/* HTTP status */
+  ipp_state_t	state;			/* IPP read state */
+  char		buffer[8192];		/* Junk buffer */
+
+
+  DEBUG_printf(("cupsGetResponses(http=%p, num_responses=%d, responses=%p, resource=\"%s\")", (void *)http, num_responses, (void *)responses, resource));
+
+ /*
+  * Range check input...
+  */
+
+  if (num_responses <= 0 || !responses)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
+    return (0);
+  }
+
+  memset(responses, 0, (size_t)num_responses * sizeof(ipp_t *));
+
+  if (!http && (http = _cupsGlobals()->http) == NULL)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("No active connection."), 1);
+    return (0);
+  }
+
+  if (http->state != HTTP_STATE_POST_RECV && http->state != HTTP_STATE_POST_SEND)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, _("No request sent."), 1);
+    return (0);
+  }
+
+ /*
+  * Read each response in turn...
+  */
+
+  for (i = 0; i < num_responses; i ++)
+  {
+   /*
+    * Each response starts with a new status line; the HTTP state machine only
+    * tracks a single request, so rewind it for the next response...
+    */
+
+    http->state  = HTTP_STATE_POST_SEND;
+    http->status = HTTP_STATUS_CONTINUE;
+
+    do
+    {
+      status = httpUpdate(http);
+    }
+    while (status == HTTP_STATUS_CONTINUE);
+
+    DEBUG_printf(("2cupsGetResponses: responses[%d] status=%d", i, status));
+
+    if (status == HTTP_STATUS_ERROR)
+    {
+      _cupsSetHTTPError(status);
+      break;
+    }
+
+    if (status == HTTP_STATUS_OK)
+    {
+      responses[i] = ippNew();
+
+      while ((state = ippRead(http, responses[i])) != IPP_STATE_DATA)
+	if (state == IPP_STATE_ERROR)
+	  break;
+
+      if (state == IPP_STATE_ERROR)
+      {
+	DEBUG_printf(("1cupsGetResponses: IPP read error for responses[%d]!", i));
+
+	ippDelete(responses[i]);
+	responses[i] = NULL;
+
+	_cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
+        break;
+      }
+    }
+    else
+    {
+      _cupsSetHTTPError(status);
+
+      if (status == HTTP_STATUS_UNAUTHORIZED && resource && !authorized)
+      {
+       /*
+        * Get credentials once so the caller can resend the failed requests...
+	*/
+
+        DEBUG_puts("2cupsGetResponses: Need authorization...");
+
+        authorized = 1;
+
+	if (cupsDoAuthentication(http, "POST", resource))
+	  _cupsSetHTTPError(HTTP_STATUS_CUPS_AUTHORIZATION_CANCELED);
+      }
+    }
+
+   /*
+    * Consume the rest of the message body (error text, trailing chunk) so
+    * that the next status line is at the front of the buffer...
+    */
+
+    while (httpRead2(http, buffer, sizeof(buffer)) > 0);
+
+    if (responses[i])
+    {
+      ipp_attribute_t	*attr;		/* status-message attribute */
+
+
+      attr = ippFindAttribute(responses[i], "status-message", IPP_TAG_TEXT);
+
+      _cupsSetError(responses[i]->request.status.status_code,
+		    attr ? attr->values[0].string.text :
+			ippErrorString(responses[i]->request.status.status_code), 0);
+
+      count ++;
+    }
+
+    if (http->state != HTTP_STATE_WAITING)
+    {
+      DEBUG_printf(("1cupsGetResponses: Unable to finish responses[%d].", i));
+      break;
+    }
+  }
+
+ /*
+  * Leave the connection in a known state; if we did not read every response
+  * there is no way to resynchronize, so reconnect...
+  */
+
+  if (i < num_responses)
+  {
+    http->state = HTTP_STATE_WAITING;
+    httpReconnect2(http, 30000, NULL);
+  }
+
+  return (count);
+}
+
+
 /*
  * 'cupsLastError()' - Return the last IPP status code received on the current
  *                     thread.
@@ -886,6 +1058,141 @@ cupsSendRequest(http_t     *http,	/* I - Connection to server or @code CUPS_HTTP
 }
 
 
+/*
+ * 'cupsSendRequests()' - Send a batch of IPP requests.
+ *
+ * This function writes the IPP requests back-to-back on the connection without
+ * waiting for each response, allowing the server to process them as a
+ * pipeline.  Use @link cupsGetResponses@ to collect the responses in order.
+ * The requests must not have any attached document data and are NOT freed.
+ *
+ * To avoid filling the socket buffers in both directions, the function stops
+ * after roughly 64k bytes of requests have been queued; the return value is
+ * the number of requests actually sent, which should be passed to
+ * @link cupsGetResponses@ before sending the remainder.
+ *
+ * @since CUPS 2.4@
+ */
+
+int					/* O - Number of requests sent or -1 on error */
+cupsSendRequests(
+    http_t     *http,			/* I - Connection to server or @code CUPS_HTTP_DEFAULT@ */
+    int        num_requests,		/* I - Number of requests */
+    ipp_t      **requests,		/* I - Array of IPP requests */
+    const char *resource)		/* I - Resource path */
+{
+  int		i;			/* Looping var */
+  size_t	length,			/* Length of current request */
+		total = 0;		/* Total bytes queued */
+  ipp_state_t	state;			/* State of IPP processing */
+  char		date[256];		/* Date: header value */
+
+
+  DEBUG_printf(("cupsSendRequests(http=%p, num_requests=%d, requests=%p, resource=\"%s\")", (void *)http, num_requests, (void *)requests, resource));
+
+ /*
+  * Range check input...
+  */
+
+  if (num_requests <= 0 || !requests || !resource)
+  {
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
+    return (-1);
+  }
+
+  for (i = 0; i < num_requests; i ++)
+  {
+    if (!requests[i])
+    {
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(EINVAL), 0);
+      return (-1);
+    }
+  }
+
+ /*
+  * Get the default connection as needed...
+  */
+
+  if (!http && (http = _cupsConnect()) == NULL)
+    return (-1);
+
+ /*
+  * If the prior request was not flushed out, do so now...
+  */
+
+  if (http->state == HTTP_STATE_GET_SEND ||
+      http->state == HTTP_STATE_POST_SEND)
+    httpFlush(http);
+
+  if (http->state != HTTP_STATE_WAITING || http->fd < 0 ||
+      !_cups_strcasecmp(httpGetField(http, HTTP_FIELD_CONNECTION), "close"))
+  {
+    DEBUG_puts("2cupsSendRequests: Reconnecting.");
+    httpClearFields(http);
+    if (httpReconnect2(http, 30000, NULL))
+    {
+      _cupsSetHTTPError(HTTP_STATUS_SERVICE_UNAVAILABLE);
+      return (-1);
+    }
+  }
+
+ /*
+  * Write each request with a fixed Content-Length so that the server can find
+  * the start of the next one...
+  */
+
+  for (i = 0; i < num_requests && total < _CUPS_MAX_BATCH; i ++)
+  {
+    length = ippLength(requests[i]);
+
+    httpClearFields(http);
+    httpSetExpect(http, (http_status_t)0);
+    httpSetField(http, HTTP_FIELD_CONTENT_TYPE, "application/ipp");
+    httpSetField(http, HTTP_FIELD_DATE, httpGetDateString2(time(NULL), date, (int)sizeof(date)));
+    httpSetLength(http, length);
+
+    if (http->authstring && !strncmp(http->authstring, "Digest ", 7))
+      _httpSetDigestAuthString(http, http->nextnonce, "POST", resource);
+
+#ifdef HAVE_GSSAPI
+    if (http->authstring && !strncmp(http->authstring, "Negotiate", 9))
+      _cupsSetNegotiateAuthString(http, "POST", resource);
+#endif /* HAVE_GSSAPI */
+
+    httpSetField(http, HTTP_FIELD_AUTHORIZATION, http->authstring);
+
+    if (httpPost(http, resource))
+      break;
+
+    requests[i]->state = IPP_STATE_IDLE;
+
+    while ((state = ippWrite(http, requests[i])) != IPP_STATE_DATA)
+      if (state == IPP_STATE_ERROR)
+        break;
+
+    if (state == IPP_STATE_ERROR)
+      break;
+
+    total += length;
+  }
+
+  if (i == 0 || httpFlushWrite(http) < 0)
+  {
+    DEBUG_puts("1cupsSendRequests: Unable to send requests.");
+
+    http->status = HTTP_STATUS_ERROR;
+    http->state  = HTTP_STATE_WAITING;
+
+    _cupsSetHTTPError(HTTP_STATUS_ERROR);
+    return (-1);
+  }
+
+  DEBUG_printf(("1cupsSendRequests: Sent %d requests (" CUPS_LLFMT " bytes).", i, CUPS_LLCAST total));
+
+  return (i);
+}
+
+
 /*
  * 'cupsWriteRequestData()' - Write additional data after an IPP request.
  *
@@ -1008,10 +1315,11 @@ _cupsConnect(void)
 	 cg->http->encryption == HTTP_ENCRYPTION_NEVER))
     {
      /*
-      * Need to close the current connection because something has changed...
+      * Something has changed, so put the current connection back in the
+      * pool - we may well switch back to that server later...
       */
 
-      httpClose(cg->http);
+      _httpPoolRelease(cg->http);
       cg->http = NULL;
     }
     else
@@ -1047,8 +1355,8 @@ _cupsConnect(void)
 
   if (!cg->http)
   {
-    if ((cg->http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC,
-				 cupsEncryption(), 1, 30000, NULL)) == NULL)
+    if ((cg->http = _httpPoolConnect(cupsServer(), ippPort(),
+				     cupsEncryption(), cupsUser())) == NULL)
     {
       if (errno)
         _cupsSetError(IPP_STATUS_ERROR_SERVICE_UNAVAILABLE, NULL, 0);
@@ -24,11 +24,13 @@
  */
 
 #define CUPS_SNMP_PORT		161	/* SNMP well-known port */
+#define CUPS_SNMP_MAX_BULK_PACKET 65507	/* Maximum size of SNMP GetBulk response */
 #define CUPS_SNMP_MAX_COMMUNITY	512	/* Maximum size of community name */
 #define CUPS_SNMP_MAX_OID	128	/* Maximum number of OID numbers */
 #define CUPS_SNMP_MAX_PACKET	1472	/* Maximum size of SNMP packet */
 #define CUPS_SNMP_MAX_STRING	1024	/* Maximum size of string */
 #define CUPS_SNMP_VERSION_1	0	/* SNMPv1 */
+#define CUPS_SNMP_VERSION_2C	1	/* SNMPv2c */
 
 
 /*
@@ -49,9 +51,13 @@ enum cups_asn1_e			/**** ASN1 request/object types ****/
   CUPS_ASN1_COUNTER = 0x41,		/* 32-bit unsigned aka Counter32 */
   CUPS_ASN1_GAUGE = 0x42,		/* 32-bit unsigned aka Gauge32 */
   CUPS_ASN1_TIMETICKS = 0x43,		/* 32-bit unsigned aka Timeticks32 */
+  CUPS_ASN1_NO_SUCH_OBJECT = 0x80,	/* noSuchObject exception (SNMPv2c) */
+  CUPS_ASN1_NO_SUCH_INSTANCE = 0x81,	/* noSuchInstance exception (SNMPv2c) */
+  CUPS_ASN1_END_OF_MIB_VIEW = 0x82,	/* endOfMibView exception (SNMPv2c) */
   CUPS_ASN1_GET_REQUEST = 0xa0,		/* GetRequest-PDU */
   CUPS_ASN1_GET_NEXT_REQUEST = 0xa1,	/* GetNextRequest-PDU */
-  CUPS_ASN1_GET_RESPONSE = 0xa2		/* GetResponse-PDU */
+  CUPS_ASN1_GET_RESPONSE = 0xa2,	/* GetResponse-PDU */
+  CUPS_ASN1_GET_BULK_REQUEST = 0xa5	/* GetBulkRequest-PDU (SNMPv2c) */
 };
 typedef enum cups_asn1_e cups_asn1_t;	/**** ASN1 request/object types ****/
 
@@ -101,6 +107,12 @@ typedef void (*cups_snmp_cb_t)(cups_snmp_t *packet, void *data);
 extern "C" {
 #  endif /* __cplusplus */
 
+extern int		_cupsSNMPBulkWalk(int fd, http_addr_t *address,
+			                  const char *community,
+					  const int *prefix,
+					  int max_repetitions, double timeout,
+					  cups_snmp_cb_t cb, void *data)
+					  _CUPS_PRIVATE;
 extern void		_cupsSNMPClose(int fd) _CUPS_PRIVATE;
 extern int		*_cupsSNMPCopyOID(int *dst, const int *src, int dstsize)
 			    _CUPS_PRIVATE;
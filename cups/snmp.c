@@ -27,7 +27,11 @@
 static void		asn1_debug(const char *prefix, unsigned char *buffer,
 			           size_t len, int indent);
 static int		asn1_decode_snmp(unsigned char *buffer, size_t len,
-			                 cups_snmp_t *packet);
+			                 cups_snmp_t *packet,
+					 unsigned char **varbinds);
+static int		asn1_decode_varbind(unsigned char **buffer,
+			                    unsigned char *bufend,
+					    cups_snmp_t *packet);
 static int		asn1_encode_snmp(unsigned char *buffer, size_t len,
 			                 cups_snmp_t *packet);
 static int		asn1_get_integer(unsigned char **buffer,
@@ -58,10 +62,187 @@ static unsigned		asn1_size_integer(int integer);
 static unsigned		asn1_size_length(unsigned length);
 static unsigned		asn1_size_oid(const int *oid);
 static unsigned		asn1_size_packed(int integer);
+static ssize_t		snmp_recv(int fd, unsigned char *buffer,
+			          size_t bufsize, double timeout,
+				  http_addr_t *address);
+static int		snmp_send(int fd, http_addr_t *address,
+			          cups_snmp_t *packet);
 static void		snmp_set_error(cups_snmp_t *packet,
 			               const char *message);
 
 
+/*
+ * '_cupsSNMPBulkWalk()' - Enumerate a group of OIDs using GetBulk requests.
+ *
+ * This function works like @code _cupsSNMPWalk@ but uses SNMPv2c
+ * GetBulkRequest-PDUs to retrieve up to "max_repetitions" OIDs per request,
+ * which avoids a round trip per OID for large tables.
+ *
+ * The array pointed to by "prefix" is terminated by the value -1.
+ *
+ * If "timeout" is negative, @code _cupsSNMPBulkWalk@ will wait for a response
+ * indefinitely.  Agents that only support SNMPv1 will not respond, so callers
+ * should fall back to @code _cupsSNMPWalk@ when -1 is returned.
+ */
+
+int					/* O - Number of OIDs found or -1 on error */
+_cupsSNMPBulkWalk(
+    int            fd,			/* I - SNMP socket */
+    http_addr_t    *address,		/* I - Address to query */
+    const char     *community,		/* I - Community name */
+    const int      *prefix,		/* I - OID prefix */
+    int            max_repetitions,	/* I - Maximum OIDs per response */
+    double         timeout,		/* I - Timeout for each response in seconds */
+    cups_snmp_cb_t cb,			/* I - Function to call for each response */
+    void           *data)		/* I - User data pointer that is passed to the callback function */
+{
+  int		count = 0;		/* Number of OIDs found */
+  unsigned	request_id = 0;		/* Current request ID */
+  cups_snmp_t	request,		/* GetBulk request packet */
+		packet;			/* Current response packet */
+  unsigned char	*buffer,		/* Response buffer */
+		*bufptr,		/* Pointer to next VarBind */
+		*bufend;		/* End of response */
+  ssize_t	bytes;			/* Size of response */
+  http_addr_t	from;			/* Source address */
+  int		lastoid[CUPS_SNMP_MAX_OID];
+					/* Last OID we got */
+
+
+ /*
+  * Range check input...
+  */
+
+  DEBUG_printf(("4_cupsSNMPBulkWalk(fd=%d, address=%p, community=\"%s\", "
+                "prefix=%p, max_repetitions=%d, timeout=%.1f, cb=%p, "
+		"data=%p)", fd, address, community, prefix, max_repetitions,
+		timeout, cb, data));
+
+  if (fd < 0 || !address || !community || !prefix || !cb)
+  {
+    DEBUG_puts("5_cupsSNMPBulkWalk: Returning -1");
+
+    return (-1);
+  }
+
+  if (max_repetitions < 1)
+    max_repetitions = 1;
+
+  if ((buffer = malloc(CUPS_SNMP_MAX_BULK_PACKET)) == NULL)
+  {
+    DEBUG_puts("5_cupsSNMPBulkWalk: Returning -1 (out of memory)");
+
+    return (-1);
+  }
+
+ /*
+  * The GetBulk PDU reuses the error-status and error-index fields for the
+  * non-repeaters and max-repetitions values...
+  */
+
+  memset(&request, 0, sizeof(request));
+
+  request.version      = CUPS_SNMP_VERSION_2C;
+  request.request_type = CUPS_ASN1_GET_BULK_REQUEST;
+  request.error_status = 0;
+  request.error_index  = max_repetitions;
+  request.object_type  = CUPS_ASN1_NULL_VALUE;
+
+  strlcpy(request.community, community, sizeof(request.community));
+
+  if (!_cupsSNMPCopyOID(request.object_name, prefix, CUPS_SNMP_MAX_OID))
+  {
+    free(buffer);
+
+    DEBUG_puts("5_cupsSNMPBulkWalk: Returning -1 (OID too big)");
+
+    errno = E2BIG;
+    return (-1);
+  }
+
+  lastoid[0] = -1;
+
+  for (;;)
+  {
+    request.request_id = ++ request_id;
+
+    if (!snmp_send(fd, address, &request))
+    {
+      count = -1;
+      break;
+    }
+
+   /*
+    * Wait for the matching response, ignoring any stale ones...
+    */
+
+    do
+    {
+      if ((bytes = snmp_recv(fd, buffer, CUPS_SNMP_MAX_BULK_PACKET, timeout,
+                             &from)) < 0)
+        break;
+
+      asn1_decode_snmp(buffer, (size_t)bytes, &packet, &bufptr);
+    }
+    while (packet.request_id != request_id);
+
+    if (bytes < 0)
+    {
+      count = -1;
+      break;
+    }
+
+    if (packet.error || packet.error_status)
+    {
+      if (count == 0)
+        count = -1;
+      break;
+    }
+
+    memcpy(&(packet.address), &from, sizeof(packet.address));
+
+   /*
+    * Report each VarBind in the response until we leave the prefix...
+    */
+
+    bufend = buffer + bytes;
+
+    for (;;)
+    {
+      if (packet.error || packet.object_type == CUPS_ASN1_END_OF_MIB_VIEW ||
+          !_cupsSNMPIsOIDPrefixed(&packet, prefix) ||
+          _cupsSNMPIsOID(&packet, lastoid))
+      {
+        lastoid[0] = -1;
+        break;
+      }
+
+      _cupsSNMPCopyOID(lastoid, packet.object_name, CUPS_SNMP_MAX_OID);
+
+      count ++;
+
+      (*cb)(&packet, data);
+
+      if (bufptr >= bufend)
+        break;
+
+      asn1_decode_varbind(&bufptr, bufend, &packet);
+    }
+
+    if (lastoid[0] < 0)
+      break;
+
+    _cupsSNMPCopyOID(request.object_name, lastoid, CUPS_SNMP_MAX_OID);
+  }
+
+  free(buffer);
+
+  DEBUG_printf(("5_cupsSNMPBulkWalk: Returning %d", count));
+
+  return (count);
+}
+
+
 /*
  * '_cupsSNMPClose()' - Close a SNMP socket.
  */
@@ -347,7 +528,6 @@ _cupsSNMPRead(int         fd,		/* I - SNMP socket file descriptor */
   unsigned char	buffer[CUPS_SNMP_MAX_PACKET];
 					/* Data packet */
   ssize_t	bytes;			/* Number of bytes received */
-  socklen_t	addrlen;		/* Source address length */
   http_addr_t	address;		/* Source address */
 
 
@@ -365,65 +545,13 @@ _cupsSNMPRead(int         fd,		/* I - SNMP socket file descriptor */
     return (NULL);
   }
 
- /*
-  * Optionally wait for a response...
-  */
-
-  if (timeout >= 0.0)
-  {
-    int			ready;		/* Data ready on socket? */
-#ifdef HAVE_POLL
-    struct pollfd	pfd;		/* Polled file descriptor */
-
-    pfd.fd     = fd;
-    pfd.events = POLLIN;
-
-    while ((ready = poll(&pfd, 1, (int)(timeout * 1000.0))) < 0 &&
-           (errno == EINTR || errno == EAGAIN));
-
-#else
-    fd_set		input_set;	/* select() input set */
-    struct timeval	stimeout;	/* select() timeout */
-
-    do
-    {
-      FD_ZERO(&input_set);
-      FD_SET(fd, &input_set);
-
-      stimeout.tv_sec  = (int)timeout;
-      stimeout.tv_usec = (int)((timeout - stimeout.tv_sec) * 1000000);
-
-      ready = select(fd + 1, &input_set, NULL, NULL, &stimeout);
-    }
-#  ifdef _WIN32
-    while (ready < 0 && WSAGetLastError() == WSAEINTR);
-#  else
-    while (ready < 0 && (errno == EINTR || errno == EAGAIN));
-#  endif /* _WIN32 */
-#endif /* HAVE_POLL */
-
-   /*
-    * If we don't have any data ready, return right away...
-    */
-
-    if (ready <= 0)
-    {
-      DEBUG_puts("5_cupsSNMPRead: Returning NULL (timeout)");
-
-      return (NULL);
-    }
-  }
-
  /*
   * Read the response data...
   */
 
-  addrlen = sizeof(address);
-
-  if ((bytes = recvfrom(fd, buffer, sizeof(buffer), 0, (void *)&address,
-                        &addrlen)) < 0)
+  if ((bytes = snmp_recv(fd, buffer, sizeof(buffer), timeout, &address)) < 0)
   {
-    DEBUG_printf(("5_cupsSNMPRead: Returning NULL (%s)", strerror(errno)));
+    DEBUG_puts("5_cupsSNMPRead: Returning NULL");
 
     return (NULL);
   }
@@ -432,9 +560,7 @@ _cupsSNMPRead(int         fd,		/* I - SNMP socket file descriptor */
   * Look for the response status code in the SNMP message header...
   */
 
-  asn1_debug("DEBUG: IN ", buffer, (size_t)bytes, 0);
-
-  asn1_decode_snmp(buffer, (size_t)bytes, packet);
+  asn1_decode_snmp(buffer, (size_t)bytes, packet, NULL);
 
   memcpy(&(packet->address), &address, sizeof(packet->address));
 
@@ -646,10 +772,6 @@ _cupsSNMPWrite(
 {
   int		i;			/* Looping var */
   cups_snmp_t	packet;			/* SNMP message packet */
-  unsigned char	buffer[CUPS_SNMP_MAX_PACKET];
-					/* SNMP message buffer */
-  ssize_t	bytes;			/* Size of message */
-  http_addr_t	temp;			/* Copy of address */
 
 
  /*
@@ -660,8 +782,9 @@ _cupsSNMPWrite(
                 "community=\"%s\", request_type=%d, request_id=%u, oid=%p)",
 		fd, address, version, community, request_type, request_id, oid));
 
-  if (fd < 0 || !address || version != CUPS_SNMP_VERSION_1 || !community ||
-      (request_type != CUPS_ASN1_GET_REQUEST &&
+  if (fd < 0 || !address ||
+      (version != CUPS_SNMP_VERSION_1 && version != CUPS_SNMP_VERSION_2C) ||
+      !community || (request_type != CUPS_ASN1_GET_REQUEST &&
        request_type != CUPS_ASN1_GET_NEXT_REQUEST) || request_id < 1 || !oid)
   {
     DEBUG_puts("5_cupsSNMPWrite: Returning 0 (bad arguments)");
@@ -694,27 +817,7 @@ _cupsSNMPWrite(
     return (0);
   }
 
-  bytes = asn1_encode_snmp(buffer, sizeof(buffer), &packet);
-
-  if (bytes < 0)
-  {
-    DEBUG_puts("5_cupsSNMPWrite: Returning 0 (request too big)");
-
-    errno = E2BIG;
-    return (0);
-  }
-
-  asn1_debug("DEBUG: OUT ", buffer, (size_t)bytes, 0);
-
- /*
-  * Send the message...
-  */
-
-  temp = *address;
-
-  _httpAddrSetPort(&temp, CUPS_SNMP_PORT);
-
-  return (sendto(fd, buffer, (size_t)bytes, 0, (void *)&temp, (socklen_t)httpAddrLength(&temp)) == bytes);
+  return (snmp_send(fd, address, &packet));
 }
 
 
@@ -908,6 +1011,21 @@ asn1_debug(const char    *prefix,	/* I - Prefix string */
 	  buffer += value_length;
           break;
 
+      case CUPS_ASN1_GET_BULK_REQUEST :
+          fprintf(stderr, "%s%*sGet-Bulk-Request-PDU %d bytes\n", prefix,
+	          indent, "", value_length);
+          asn1_debug(prefix, buffer, value_length, indent + 4);
+
+	  buffer += value_length;
+          break;
+
+      case CUPS_ASN1_END_OF_MIB_VIEW :
+          fprintf(stderr, "%s%*sEND OF MIB VIEW %d bytes\n", prefix, indent,
+	          "", value_length);
+
+	  buffer += value_length;
+          break;
+
       default :
           fprintf(stderr, "%s%*sUNKNOWN(%x) %d bytes\n", prefix, indent, "",
 	          value_type, value_length);
@@ -924,9 +1042,11 @@ asn1_debug(const char    *prefix,	/* I - Prefix string */
  */
 
 static int				/* O - 0 on success, -1 on error */
-asn1_decode_snmp(unsigned char *buffer,	/* I - Buffer */
-                 size_t        len,	/* I - Size of buffer */
-                 cups_snmp_t   *packet)	/* I - SNMP packet */
+asn1_decode_snmp(
+    unsigned char *buffer,		/* I - Buffer */
+    size_t        len,			/* I - Size of buffer */
+    cups_snmp_t   *packet,		/* I - SNMP packet */
+    unsigned char **varbinds)		/* O - Remaining VarBinds or @code NULL@ */
 {
   unsigned char	*bufptr,		/* Pointer into the data */
 		*bufend;		/* End of data */
@@ -952,7 +1072,7 @@ asn1_decode_snmp(unsigned char *buffer,	/* I - Buffer */
   else if ((length = asn1_get_length(&bufptr, bufend)) == 0)
     snmp_set_error(packet, _("Version uses indefinite length"));
   else if ((packet->version = asn1_get_integer(&bufptr, bufend, length))
-               != CUPS_SNMP_VERSION_1)
+               != CUPS_SNMP_VERSION_1 && packet->version != CUPS_SNMP_VERSION_2C)
     snmp_set_error(packet, _("Bad SNMP version number"));
   else if (asn1_get_type(&bufptr, bufend) != CUPS_ASN1_OCTET_STRING)
     snmp_set_error(packet, _("No community name"));
@@ -997,82 +1117,120 @@ asn1_decode_snmp(unsigned char *buffer,	/* I - Buffer */
 	  else if (asn1_get_length(&bufptr, bufend) == 0)
 	    snmp_set_error(packet,
 	                   _("variable-bindings uses indefinite length"));
-	  else if (asn1_get_type(&bufptr, bufend) != CUPS_ASN1_SEQUENCE)
-	    snmp_set_error(packet, _("No VarBind SEQUENCE"));
-	  else if (asn1_get_length(&bufptr, bufend) == 0)
-	    snmp_set_error(packet, _("VarBind uses indefinite length"));
-	  else if (asn1_get_type(&bufptr, bufend) != CUPS_ASN1_OID)
-	    snmp_set_error(packet, _("No name OID"));
-	  else if ((length = asn1_get_length(&bufptr, bufend)) == 0)
-	    snmp_set_error(packet, _("Name OID uses indefinite length"));
-          else
-	  {
-	    asn1_get_oid(&bufptr, bufend, length, packet->object_name,
-	                 CUPS_SNMP_MAX_OID);
-
-            packet->object_type = (cups_asn1_t)asn1_get_type(&bufptr, bufend);
-
-	    if ((length = asn1_get_length(&bufptr, bufend)) == 0 &&
-	        packet->object_type != CUPS_ASN1_NULL_VALUE &&
-	        packet->object_type != CUPS_ASN1_OCTET_STRING)
-	      snmp_set_error(packet, _("Value uses indefinite length"));
-	    else
-	    {
-	      switch (packet->object_type)
-	      {
-	        case CUPS_ASN1_BOOLEAN :
-		    packet->object_value.boolean =
-		        asn1_get_integer(&bufptr, bufend, length);
-	            break;
-
-	        case CUPS_ASN1_INTEGER :
-		    packet->object_value.integer =
-		        asn1_get_integer(&bufptr, bufend, length);
-	            break;
-
-		case CUPS_ASN1_NULL_VALUE :
-		    break;
-
-	        case CUPS_ASN1_OCTET_STRING :
-	        case CUPS_ASN1_BIT_STRING :
-	        case CUPS_ASN1_HEX_STRING :
-		    packet->object_value.string.num_bytes = length;
-		    asn1_get_string(&bufptr, bufend, length,
-		                    (char *)packet->object_value.string.bytes,
-				    sizeof(packet->object_value.string.bytes));
-	            break;
-
-	        case CUPS_ASN1_OID :
-		    asn1_get_oid(&bufptr, bufend, length,
-		                 packet->object_value.oid, CUPS_SNMP_MAX_OID);
-	            break;
-
-	        case CUPS_ASN1_COUNTER :
-		    packet->object_value.counter =
-		        asn1_get_integer(&bufptr, bufend, length);
-	            break;
-
-	        case CUPS_ASN1_GAUGE :
-		    packet->object_value.gauge =
-		        (unsigned)asn1_get_integer(&bufptr, bufend, length);
-	            break;
-
-	        case CUPS_ASN1_TIMETICKS :
-		    packet->object_value.timeticks =
-		        (unsigned)asn1_get_integer(&bufptr, bufend, length);
-	            break;
-
-                default :
-		    snmp_set_error(packet, _("Unsupported value type"));
-		    break;
-	      }
-	    }
-          }
+	  else
+	    asn1_decode_varbind(&bufptr, bufend, packet);
 	}
       }
     }
   }
 
+  if (varbinds)
+    *varbinds = bufptr;
+
+  return (packet->error ? -1 : 0);
+}
+
+
+/*
+ * 'asn1_decode_varbind()' - Decode a single VarBind from a SNMP packet.
+ */
+
+static int				/* O  - 0 on success, -1 on error */
+asn1_decode_varbind(
+    unsigned char **buffer,		/* IO - Pointer in buffer */
+    unsigned char *bufend,		/* I  - End of buffer */
+    cups_snmp_t   *packet)		/* I  - SNMP packet */
+{
+  unsigned char	*bufptr = *buffer;	/* Pointer into the data */
+  unsigned	length;			/* Length of value */
+
+
+  packet->object_name[0] = -1;
+  packet->object_type    = CUPS_ASN1_END_OF_CONTENTS;
+
+  memset(&(packet->object_value), 0, sizeof(packet->object_value));
+
+  if (asn1_get_type(&bufptr, bufend) != CUPS_ASN1_SEQUENCE)
+    snmp_set_error(packet, _("No VarBind SEQUENCE"));
+  else if (asn1_get_length(&bufptr, bufend) == 0)
+    snmp_set_error(packet, _("VarBind uses indefinite length"));
+  else if (asn1_get_type(&bufptr, bufend) != CUPS_ASN1_OID)
+    snmp_set_error(packet, _("No name OID"));
+  else if ((length = asn1_get_length(&bufptr, bufend)) == 0)
+    snmp_set_error(packet, _("Name OID uses indefinite length"));
+  else
+  {
+    asn1_get_oid(&bufptr, bufend, length, packet->object_name,
+		 CUPS_SNMP_MAX_OID);
+
+    packet->object_type = (cups_asn1_t)asn1_get_type(&bufptr, bufend);
+
+    if ((length = asn1_get_length(&bufptr, bufend)) == 0 &&
+	packet->object_type != CUPS_ASN1_NULL_VALUE &&
+	packet->object_type != CUPS_ASN1_OCTET_STRING &&
+	packet->object_type != CUPS_ASN1_NO_SUCH_OBJECT &&
+	packet->object_type != CUPS_ASN1_NO_SUCH_INSTANCE &&
+	packet->object_type != CUPS_ASN1_END_OF_MIB_VIEW)
+      snmp_set_error(packet, _("Value uses indefinite length"));
+    else
+    {
+      switch (packet->object_type)
+      {
+	case CUPS_ASN1_BOOLEAN :
+	    packet->object_value.boolean =
+		asn1_get_integer(&bufptr, bufend, length);
+	    break;
+
+	case CUPS_ASN1_INTEGER :
+	    packet->object_value.integer =
+		asn1_get_integer(&bufptr, bufend, length);
+	    break;
+
+	case CUPS_ASN1_NULL_VALUE :
+	case CUPS_ASN1_NO_SUCH_OBJECT :
+	case CUPS_ASN1_NO_SUCH_INSTANCE :
+	case CUPS_ASN1_END_OF_MIB_VIEW :
+	    bufptr += length;
+	    break;
+
+	case CUPS_ASN1_OCTET_STRING :
+	case CUPS_ASN1_BIT_STRING :
+	case CUPS_ASN1_HEX_STRING :
+	    packet->object_value.string.num_bytes = length;
+	    asn1_get_string(&bufptr, bufend, length,
+			    (char *)packet->object_value.string.bytes,
+			    sizeof(packet->object_value.string.bytes));
+	    break;
+
+	case CUPS_ASN1_OID :
+	    asn1_get_oid(&bufptr, bufend, length,
+			 packet->object_value.oid, CUPS_SNMP_MAX_OID);
+	    break;
+
+	case CUPS_ASN1_COUNTER :
+	    packet->object_value.counter =
+		asn1_get_integer(&bufptr, bufend, length);
+	    break;
+
+	case CUPS_ASN1_GAUGE :
+	    packet->object_value.gauge =
+		(unsigned)asn1_get_integer(&bufptr, bufend, length);
+	    break;
+
+	case CUPS_ASN1_TIMETICKS :
+	    packet->object_value.timeticks =
+		(unsigned)asn1_get_integer(&bufptr, bufend, length);
+	    break;
+
+	default :
+	    snmp_set_error(packet, _("Unsupported value type"));
+	    break;
+      }
+    }
+  }
+
+  *buffer = bufptr;
+
   return (packet->error ? -1 : 0);
 }
 
@@ -1678,6 +1836,129 @@ asn1_size_packed(int integer)		/* I - Integer value */
 }
 
 
+/*
+ * 'snmp_recv()' - Receive a SNMP message.
+ */
+
+static ssize_t				/* O - Number of bytes or -1 on error */
+snmp_recv(int           fd,		/* I - SNMP socket */
+          unsigned char *buffer,	/* I - Message buffer */
+          size_t        bufsize,	/* I - Size of message buffer */
+	  double        timeout,	/* I - Timeout in seconds */
+	  http_addr_t   *address)	/* O - Source address */
+{
+  ssize_t	bytes;			/* Number of bytes received */
+  socklen_t	addrlen;		/* Source address length */
+
+
+ /*
+  * Optionally wait for a response...
+  */
+
+  if (timeout >= 0.0)
+  {
+    int			ready;		/* Data ready on socket? */
+#ifdef HAVE_POLL
+    struct pollfd	pfd;		/* Polled file descriptor */
+
+    pfd.fd     = fd;
+    pfd.events = POLLIN;
+
+    while ((ready = poll(&pfd, 1, (int)(timeout * 1000.0))) < 0 &&
+           (errno == EINTR || errno == EAGAIN));
+
+#else
+    fd_set		input_set;	/* select() input set */
+    struct timeval	stimeout;	/* select() timeout */
+
+    do
+    {
+      FD_ZERO(&input_set);
+      FD_SET(fd, &input_set);
+
+      stimeout.tv_sec  = (int)timeout;
+      stimeout.tv_usec = (int)((timeout - stimeout.tv_sec) * 1000000);
+
+      ready = select(fd + 1, &input_set, NULL, NULL, &stimeout);
+    }
+#  ifdef _WIN32
+    while (ready < 0 && WSAGetLastError() == WSAEINTR);
+#  else
+    while (ready < 0 && (errno == EINTR || errno == EAGAIN));
+#  endif /* _WIN32 */
+#endif /* HAVE_POLL */
+
+   /*
+    * If we don't have any data ready, return right away...
+    */
+
+    if (ready <= 0)
+    {
+      DEBUG_puts("6snmp_recv: Returning -1 (timeout)");
+
+      return (-1);
+    }
+  }
+
+ /*
+  * Read the response data...
+  */
+
+  addrlen = sizeof(http_addr_t);
+
+  if ((bytes = recvfrom(fd, buffer, bufsize, 0, (void *)address,
+                        &addrlen)) < 0)
+  {
+    DEBUG_printf(("6snmp_recv: Returning -1 (%s)", strerror(errno)));
+
+    return (-1);
+  }
+
+  asn1_debug("DEBUG: IN ", buffer, (size_t)bytes, 0);
+
+  return (bytes);
+}
+
+
+/*
+ * 'snmp_send()' - Encode and send a SNMP message.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+snmp_send(int         fd,		/* I - SNMP socket */
+          http_addr_t *address,		/* I - Address to send to */
+          cups_snmp_t *packet)		/* I - SNMP message packet */
+{
+  unsigned char	buffer[CUPS_SNMP_MAX_PACKET];
+					/* SNMP message buffer */
+  ssize_t	bytes;			/* Size of message */
+  http_addr_t	temp;			/* Copy of address */
+
+
+  bytes = asn1_encode_snmp(buffer, sizeof(buffer), packet);
+
+  if (bytes < 0)
+  {
+    DEBUG_puts("6snmp_send: Returning 0 (request too big)");
+
+    errno = E2BIG;
+    return (0);
+  }
+
+  asn1_debug("DEBUG: OUT ", buffer, (size_t)bytes, 0);
+
+ /*
+  * Send the message...
+  */
+
+  temp = *address;
+
+  _httpAddrSetPort(&temp, CUPS_SNMP_PORT);
+
+  return (sendto(fd, buffer, (size_t)bytes, 0, (void *)&temp, (socklen_t)httpAddrLength(&temp)) == bytes);
+}
+
+
 /*
  * 'snmp_set_error()' - Set the localized error for a packet.
  */
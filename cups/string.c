@@ -19,14 +19,42 @@
 #include <limits.h>
 
 
+/*
+ * Local constants...
+ */
+
+#define _CUPS_SP_SHARDS		16	/* Number of string pool shards (power of 2) */
+#define _CUPS_SP_HASHSIZE	1024	/* Size of hash table for each shard */
+#define _CUPS_SP_ITEMSIZE(len)	(sizeof(_cups_sp_item_t) + (((len) + 8) & (size_t)~7))
+					/* Allocated size of a string, using a 64-bit aligned buffer as a basis */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct _cups_sp_shard_s		/**** String Pool Shard ****/
+{
+  _cups_mutex_t	mutex;			/* Mutex to control access to shard */
+  cups_array_t	*pool;			/* Strings in shard */
+  size_t	refs,			/* References to strings in shard */
+		bytes;			/* Bytes allocated for strings in shard */
+} _cups_sp_shard_t;
+
+
 /*
  * Local globals...
  */
 
-static _cups_mutex_t	sp_mutex = _CUPS_MUTEX_INITIALIZER;
-					/* Mutex to control access to pool */
-static cups_array_t	*stringpool = NULL;
-					/* Global string pool */
+#define _CUPS_SP_SHARD_INIT { _CUPS_MUTEX_INITIALIZER, NULL, 0, 0 }
+
+static _cups_sp_shard_t	sp_shards[_CUPS_SP_SHARDS] =
+{					/* String pool shards */
+  _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT,
+  _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT,
+  _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT,
+  _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT, _CUPS_SP_SHARD_INIT
+};
 
 
 /*
@@ -34,6 +62,8 @@ static cups_array_t	*stringpool = NULL;
  */
 
 static int	compare_sp_items(_cups_sp_item_t *a, _cups_sp_item_t *b);
+static int	hash_sp_item(_cups_sp_item_t *item, void *data);
+static unsigned	hash_sp_string(const char *s);
 
 
 /*
@@ -44,6 +74,7 @@ char *					/* O - String pointer */
 _cupsStrAlloc(const char *s)		/* I - String */
 {
   size_t		slen;		/* Length of string */
+  _cups_sp_shard_t	*shard;		/* String pool shard */
   _cups_sp_item_t	*item,		/* String pool item */
 			*key;		/* Search key */
 
@@ -56,17 +87,19 @@ _cupsStrAlloc(const char *s)		/* I - String */
     return (NULL);
 
  /*
-  * Get the string pool...
+  * Get the string pool shard...
   */
 
-  _cupsMutexLock(&sp_mutex);
+  shard = sp_shards + (hash_sp_string(s) & (_CUPS_SP_SHARDS - 1));
+
+  _cupsMutexLock(&shard->mutex);
 
-  if (!stringpool)
-    stringpool = cupsArrayNew((cups_array_func_t)compare_sp_items, NULL);
+  if (!shard->pool)
+    shard->pool = _cupsArrayNewChunked((cups_array_func_t)compare_sp_items, NULL, (cups_ahash_func_t)hash_sp_item, _CUPS_SP_HASHSIZE, NULL, NULL);
 
-  if (!stringpool)
+  if (!shard->pool)
   {
-    _cupsMutexUnlock(&sp_mutex);
+    _cupsMutexUnlock(&shard->mutex);
 
     return (NULL);
   }
@@ -77,13 +110,14 @@ _cupsStrAlloc(const char *s)		/* I - String */
 
   key = (_cups_sp_item_t *)(s - offsetof(_cups_sp_item_t, str));
 
-  if ((item = (_cups_sp_item_t *)cupsArrayFind(stringpool, key)) != NULL)
+  if ((item = (_cups_sp_item_t *)cupsArrayFind(shard->pool, key)) != NULL)
   {
    /*
     * Found it, return the cached string...
     */
 
     item->ref_count ++;
+    shard->refs ++;
 
 #ifdef DEBUG_GUARDS
     DEBUG_printf(("5_cupsStrAlloc: Using string %p(%s) for \"%s\", guard=%08x, "
@@ -94,7 +128,7 @@ _cupsStrAlloc(const char *s)		/* I - String */
       abort();
 #endif /* DEBUG_GUARDS */
 
-    _cupsMutexUnlock(&sp_mutex);
+    _cupsMutexUnlock(&shard->mutex);
 
     return (item->str);
   }
@@ -107,7 +141,7 @@ _cupsStrAlloc(const char *s)		/* I - String */
   item = (_cups_sp_item_t *)calloc(1, sizeof(_cups_sp_item_t) + slen);
   if (!item)
   {
-    _cupsMutexUnlock(&sp_mutex);
+    _cupsMutexUnlock(&shard->mutex);
 
     return (NULL);
   }
@@ -115,6 +149,9 @@ _cupsStrAlloc(const char *s)		/* I - String */
   item->ref_count = 1;
   memcpy(item->str, s, slen + 1);
 
+  shard->refs ++;
+  shard->bytes += _CUPS_SP_ITEMSIZE(slen);
+
 #ifdef DEBUG_GUARDS
   item->guard = _CUPS_STR_GUARD;
 
@@ -127,9 +164,9 @@ _cupsStrAlloc(const char *s)		/* I - String */
   * Add the string to the pool and return it...
   */
 
-  cupsArrayAdd(stringpool, item);
+  cupsArrayAdd(shard->pool, item);
 
-  _cupsMutexUnlock(&sp_mutex);
+  _cupsMutexUnlock(&shard->mutex);
 
   return (item->str);
 }
@@ -175,23 +212,29 @@ _cupsStrDate(char   *buf,		/* I - Buffer */
 void
 _cupsStrFlush(void)
 {
+  int			i;		/* Looping var */
+  _cups_sp_shard_t	*shard;		/* Current shard */
   _cups_sp_item_t	*item;		/* Current item */
 
 
-  DEBUG_printf(("4_cupsStrFlush: %d strings in array",
-                cupsArrayCount(stringpool)));
+  for (i = _CUPS_SP_SHARDS, shard = sp_shards; i > 0; i --, shard ++)
+  {
+    _cupsMutexLock(&shard->mutex);
 
-  _cupsMutexLock(&sp_mutex);
+    DEBUG_printf(("4_cupsStrFlush: %d strings in shard %d", cupsArrayCount(shard->pool), _CUPS_SP_SHARDS - i));
 
-  for (item = (_cups_sp_item_t *)cupsArrayFirst(stringpool);
-       item;
-       item = (_cups_sp_item_t *)cupsArrayNext(stringpool))
-    free(item);
+    for (item = (_cups_sp_item_t *)cupsArrayFirst(shard->pool);
+	 item;
+	 item = (_cups_sp_item_t *)cupsArrayNext(shard->pool))
+      free(item);
 
-  cupsArrayDelete(stringpool);
-  stringpool = NULL;
+    cupsArrayDelete(shard->pool);
+    shard->pool  = NULL;
+    shard->refs  = 0;
+    shard->bytes = 0;
 
-  _cupsMutexUnlock(&sp_mutex);
+    _cupsMutexUnlock(&shard->mutex);
+  }
 }
 
 
@@ -282,6 +325,7 @@ _cupsStrFormatd(char         *buf,	/* I - String */
 void
 _cupsStrFree(const char *s)		/* I - String to free */
 {
+  _cups_sp_shard_t	*shard;		/* String pool shard */
   _cups_sp_item_t	*item,		/* String pool item */
 			*key;		/* Search key */
 
@@ -294,25 +338,27 @@ _cupsStrFree(const char *s)		/* I - String to free */
     return;
 
  /*
-  * Check the string pool...
+  * Check the string pool shard...
   *
   * We don't need to lock the mutex yet, as we only want to know if
-  * the stringpool is initialized.  The rest of the code will still
-  * work if it is initialized before we lock...
+  * the shard is initialized.  The rest of the code will still work if
+  * it is initialized before we lock...
   */
 
-  if (!stringpool)
+  shard = sp_shards + (hash_sp_string(s) & (_CUPS_SP_SHARDS - 1));
+
+  if (!shard->pool)
     return;
 
  /*
   * See if the string is already in the pool...
   */
 
-  _cupsMutexLock(&sp_mutex);
+  _cupsMutexLock(&shard->mutex);
 
   key = (_cups_sp_item_t *)(s - offsetof(_cups_sp_item_t, str));
 
-  if ((item = (_cups_sp_item_t *)cupsArrayFind(stringpool, key)) != NULL &&
+  if ((item = (_cups_sp_item_t *)cupsArrayFind(shard->pool, key)) != NULL &&
       item == key)
   {
    /*
@@ -328,6 +374,7 @@ _cupsStrFree(const char *s)		/* I - String to free */
 #endif /* DEBUG_GUARDS */
 
     item->ref_count --;
+    shard->refs --;
 
     if (!item->ref_count)
     {
@@ -335,13 +382,14 @@ _cupsStrFree(const char *s)		/* I - String to free */
       * Remove and free...
       */
 
-      cupsArrayRemove(stringpool, item);
+      cupsArrayRemove(shard->pool, item);
+      shard->bytes -= _CUPS_SP_ITEMSIZE(strlen(item->str));
 
       free(item);
     }
   }
 
-  _cupsMutexUnlock(&sp_mutex);
+  _cupsMutexUnlock(&shard->mutex);
 }
 
 
@@ -356,6 +404,7 @@ _cupsStrFree(const char *s)		/* I - String to free */
 char *					/* O - Pointer to string */
 _cupsStrRetain(const char *s)		/* I - String to retain */
 {
+  _cups_sp_shard_t	*shard;		/* String pool shard */
   _cups_sp_item_t	*item;		/* Pointer to string pool item */
 
 
@@ -372,11 +421,14 @@ _cupsStrRetain(const char *s)		/* I - String to retain */
     }
 #endif /* DEBUG_GUARDS */
 
-    _cupsMutexLock(&sp_mutex);
+    shard = sp_shards + (hash_sp_string(s) & (_CUPS_SP_SHARDS - 1));
+
+    _cupsMutexLock(&shard->mutex);
 
     item->ref_count ++;
+    shard->refs ++;
 
-    _cupsMutexUnlock(&sp_mutex);
+    _cupsMutexUnlock(&shard->mutex);
   }
 
   return ((char *)s);
@@ -523,12 +575,17 @@ _cupsStrScand(const char   *buf,	/* I - Pointer to number */
 
 /*
  * '_cupsStrStatistics()' - Return allocation statistics for string pool.
+ *
+ * The number of strings and allocated bytes are kept as running counters, so
+ * the pool is only walked when the total string bytes are requested.
  */
 
 size_t					/* O - Number of strings */
 _cupsStrStatistics(size_t *alloc_bytes,	/* O - Allocated bytes */
                    size_t *total_bytes)	/* O - Total string bytes */
 {
+  int			i;		/* Looping var */
+  _cups_sp_shard_t	*shard;		/* Current shard */
   size_t		count,		/* Number of strings */
 			abytes,		/* Allocated string bytes */
 			tbytes,		/* Total string bytes */
@@ -537,27 +594,29 @@ _cupsStrStatistics(size_t *alloc_bytes,	/* O - Allocated bytes */
 
 
  /*
-  * Loop through strings in pool, counting everything up...
+  * Loop through strings in each shard, counting everything up...
   */
 
-  _cupsMutexLock(&sp_mutex);
-
-  for (count = 0, abytes = 0, tbytes = 0,
-           item = (_cups_sp_item_t *)cupsArrayFirst(stringpool);
-       item;
-       item = (_cups_sp_item_t *)cupsArrayNext(stringpool))
+  for (i = _CUPS_SP_SHARDS, shard = sp_shards, count = 0, abytes = 0, tbytes = 0; i > 0; i --, shard ++)
   {
-   /*
-    * Count allocated memory, using a 64-bit aligned buffer as a basis.
-    */
+    _cupsMutexLock(&shard->mutex);
 
-    count  += item->ref_count;
-    len    = (strlen(item->str) + 8) & (size_t)~7;
-    abytes += sizeof(_cups_sp_item_t) + len;
-    tbytes += item->ref_count * len;
-  }
+    count  += shard->refs;
+    abytes += shard->bytes;
 
-  _cupsMutexUnlock(&sp_mutex);
+    if (total_bytes)
+    {
+      for (item = (_cups_sp_item_t *)cupsArrayFirst(shard->pool);
+	   item;
+	   item = (_cups_sp_item_t *)cupsArrayNext(shard->pool))
+      {
+	len    = (strlen(item->str) + 8) & (size_t)~7;
+	tbytes += item->ref_count * len;
+      }
+    }
+
+    _cupsMutexUnlock(&shard->mutex);
+  }
 
  /*
   * Return values...
@@ -763,3 +822,42 @@ compare_sp_items(_cups_sp_item_t *a,	/* I - First item */
 {
   return (strcmp(a->str, b->str));
 }
+
+
+/*
+ * 'hash_sp_item()' - Compute the hash table index for a string pool item.
+ */
+
+static int				/* O - Hash index */
+hash_sp_item(_cups_sp_item_t *item,	/* I - Item */
+             void            *data)	/* I - Callback data (unused) */
+{
+  (void)data;
+
+ /*
+  * The low bits of the hash select the shard, so use the remaining bits for
+  * the shard's hash table...
+  */
+
+  return ((int)((hash_sp_string(item->str) / _CUPS_SP_SHARDS) % _CUPS_SP_HASHSIZE));
+}
+
+
+/*
+ * 'hash_sp_string()' - Compute the FNV-1a hash of a string.
+ */
+
+static unsigned				/* O - Hash value */
+hash_sp_string(const char *s)		/* I - String */
+{
+  unsigned	hash = 2166136261U;	/* Hash value */
+
+
+  while (*s)
+  {
+    hash ^= (unsigned char)*s++;
+    hash *= 16777619U;
+  }
+
+  return (hash);
+}
@@ -14,6 +14,7 @@
 #include "string-private.h"
 #include "debug-private.h"
 #include "array-private.h"
+#include "thread-private.h"
 #include "dir.h"
 
 
@@ -23,6 +24,8 @@
 
 static double	get_seconds(void);
 static int	load_words(const char *filename, cups_array_t *array);
+static void	*locked_iter(cups_array_t *array);
+static void	*locked_update(cups_array_t *array);
 
 
 /*
@@ -34,7 +37,12 @@ main(void)
 {
   int		i;			/* Looping var */
   cups_array_t	*array,			/* Test array */
-		*dup_array;		/* Duplicate array */
+		*dup_array,		/* Duplicate array */
+		*chunk_array,		/* Chunked array */
+		*locked_array;		/* Locked array */
+  _cups_array_iter_t iter,		/* Array iterator */
+		iter2;			/* Nested array iterator */
+  _cups_thread_t threads[4];		/* Iteration threads */
   int		status;			/* Exit status */
   char		*text;			/* Text from array */
   char		word[256];		/* Word from file */
@@ -381,6 +389,169 @@ main(void)
   else
     puts("PASS");
 
+ /*
+  * _cupsArrayNewChunked()
+  */
+
+  fputs("_cupsArrayNewChunked: ", stdout);
+
+  if ((chunk_array = _cupsArrayNewChunked((cups_array_func_t)strcmp, data, NULL, 0, NULL, NULL)) == NULL)
+  {
+    puts("FAIL (returned NULL, expected pointer)");
+    status ++;
+  }
+  else
+  {
+   /*
+    * Add the words in reverse order so that every element is inserted at the
+    * front of the array...
+    */
+
+    for (text = (char *)cupsArrayLast(array); text; text = (char *)cupsArrayPrev(array))
+      cupsArrayAdd(chunk_array, text);
+
+    if (cupsArrayCount(chunk_array) != cupsArrayCount(array))
+    {
+      printf("FAIL (%d elements, expected %d)\n", cupsArrayCount(chunk_array), cupsArrayCount(array));
+      status ++;
+    }
+    else
+    {
+      for (text = (char *)cupsArrayFirst(array), i = 0; text; text = (char *)cupsArrayNext(array), i ++)
+      {
+        if (cupsArrayIndex(chunk_array, i) != text || cupsArrayFind(chunk_array, text) != text || cupsArrayGetIndex(chunk_array) != i)
+          break;
+      }
+
+      if (text)
+      {
+        printf("FAIL (element %d \"%s\" not found)\n", i, text);
+        status ++;
+      }
+      else
+        puts("PASS");
+    }
+
+    fputs("_cupsArrayNewChunked (remove): ", stdout);
+
+    for (text = (char *)cupsArrayFirst(chunk_array), i = 0; text; text = (char *)cupsArrayNext(chunk_array), i ++)
+    {
+      if (i & 1)
+        cupsArrayRemove(chunk_array, text);
+    }
+
+    if (cupsArrayCount(chunk_array) != (cupsArrayCount(array) + 1) / 2)
+    {
+      printf("FAIL (%d elements, expected %d)\n", cupsArrayCount(chunk_array), (cupsArrayCount(array) + 1) / 2);
+      status ++;
+    }
+    else
+    {
+      for (text = (char *)cupsArrayFirst(array), i = 0; text; text = (char *)cupsArrayNext(array), i ++)
+      {
+        if ((cupsArrayFind(chunk_array, text) != NULL) != !(i & 1))
+          break;
+      }
+
+      if (text)
+      {
+        printf("FAIL (element %d \"%s\" %s)\n", i, text, (i & 1) ? "not removed" : "not found");
+        status ++;
+      }
+      else
+        puts("PASS");
+    }
+
+    cupsArrayDelete(chunk_array);
+  }
+
+ /*
+  * _cupsArrayIterFirst() and _cupsArrayIterNext()
+  */
+
+  fputs("_cupsArrayIterFirst/Next: ", stdout);
+
+  saved[0] = (char *)cupsArrayIndex(array, 1);
+
+  cupsArrayFind(array, "main");
+
+  for (text = (char *)_cupsArrayIterFirst(&iter, array), i = 0; text; text = (char *)_cupsArrayIterNext(&iter))
+  {
+    if (_cupsArrayIterFirst(&iter2, array) && _cupsArrayIterNext(&iter2) == saved[0])
+      i ++;
+  }
+
+  if (i != cupsArrayCount(array))
+  {
+    printf("FAIL (%d iterations, expected %d)\n", i, cupsArrayCount(array));
+    status ++;
+  }
+  else if ((text = (char *)cupsArrayCurrent(array)) == NULL || strcmp(text, "main"))
+  {
+    printf("FAIL (current element \"%s\", expected \"main\")\n", text ? text : "(null)");
+    status ++;
+  }
+  else
+    puts("PASS");
+
+  fputs("_cupsArrayIterNext (remove): ", stdout);
+
+  cupsArrayDelete(dup_array);
+  dup_array = cupsArrayDup(array);
+
+  for (text = (char *)_cupsArrayIterFirst(&iter, dup_array), i = 0; text; text = (char *)_cupsArrayIterNext(&iter), i ++)
+  {
+    if (i & 1)
+      cupsArrayRemove(dup_array, text);
+  }
+
+  if (i != cupsArrayCount(array) || cupsArrayCount(dup_array) != (i + 1) / 2)
+  {
+    printf("FAIL (%d iterations and %d elements, expected %d and %d)\n", i, cupsArrayCount(dup_array), cupsArrayCount(array), (cupsArrayCount(array) + 1) / 2);
+    status ++;
+  }
+  else
+    puts("PASS");
+
+ /*
+  * _cupsArrayNewLocked()
+  */
+
+  fputs("_cupsArrayNewLocked: ", stdout);
+
+  if ((locked_array = _cupsArrayNewLocked((cups_array_func_t)strcmp, NULL, NULL, 0, NULL, NULL)) == NULL)
+  {
+    puts("FAIL (returned NULL, expected pointer)");
+    status ++;
+  }
+  else
+  {
+    for (text = (char *)cupsArrayFirst(array); text; text = (char *)cupsArrayNext(array))
+      cupsArrayAdd(locked_array, text);
+
+    for (i = 0; i < 4; i ++)
+      threads[i] = _cupsThreadCreate((_cups_thread_func_t)(i ? locked_iter : locked_update), locked_array);
+
+    for (i = 0; i < 4; i ++)
+      if (_cupsThreadWait(threads[i]))
+        break;
+
+    if (i < 4)
+    {
+      printf("FAIL (thread %d failed)\n", i);
+      status ++;
+    }
+    else if (cupsArrayCount(locked_array) != cupsArrayCount(array))
+    {
+      printf("FAIL (%d elements, expected %d)\n", cupsArrayCount(locked_array), cupsArrayCount(array));
+      status ++;
+    }
+    else
+      puts("PASS");
+
+    cupsArrayDelete(locked_array);
+  }
+
  /*
   * Delete the arrays...
   */
@@ -539,3 +710,60 @@ load_words(const char   *filename,	/* I - File to load */
 
   return (1);
 }
+
+
+/*
+ * 'locked_iter()' - Iterate over a locked array while it is updated.
+ */
+
+static void *				/* O - NULL on success, array on failure */
+locked_iter(cups_array_t *array)	/* I - Array */
+{
+  int			i;		/* Looping var */
+  _cups_array_iter_t	iter;		/* Array iterator */
+  char			*text;		/* Current element */
+
+
+  for (i = 0; i < 100; i ++)
+  {
+    for (text = (char *)_cupsArrayIterFirst(&iter, array); text; text = (char *)_cupsArrayIterNext(&iter))
+    {
+      if (!*text)
+        return (array);
+    }
+  }
+
+  return (NULL);
+}
+
+
+/*
+ * 'locked_update()' - Remove and add elements in a locked array.
+ */
+
+static void *				/* O - NULL on success, array on failure */
+locked_update(cups_array_t *array)	/* I - Array */
+{
+  int			i, j;		/* Looping vars */
+  _cups_array_iter_t	iter;		/* Array iterator */
+  char			*text,		/* Current element */
+			*removed[10];	/* Removed elements */
+
+
+  for (i = 0; i < 100; i ++)
+  {
+    for (j = 0, text = (char *)_cupsArrayIterFirst(&iter, array); text && j < 10; j ++, text = (char *)_cupsArrayIterNext(&iter))
+    {
+      removed[j] = text;
+      cupsArrayRemove(array, text);
+    }
+
+    while (j > 0)
+    {
+      if (!cupsArrayAdd(array, removed[-- j]))
+        return (array);
+    }
+  }
+
+  return (NULL);
+}
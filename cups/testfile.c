@@ -530,6 +530,20 @@ read_write_tests(int compression)	/* I - Use compression? */
       status ++;
     }
 
+   /*
+    * cupsFileSetBufferSize()
+    */
+
+    fputs("cupsFileSetBufferSize(write): ", stdout);
+
+    if (!cupsFileSetBufferSize(fp, 65536))
+      puts("PASS");
+    else
+    {
+      printf("FAIL (%s)\n", strerror(errno));
+      status ++;
+    }
+
    /*
     * cupsFilePutChar()
     */
@@ -647,6 +661,20 @@ read_write_tests(int compression)	/* I - Use compression? */
       status ++;
     }
 
+   /*
+    * cupsFileSetBufferSize() with buffered input...
+    */
+
+    fputs("cupsFileSetBufferSize(read): ", stdout);
+
+    if (!cupsFileSetBufferSize(fp, 65536))
+      puts("PASS");
+    else
+    {
+      printf("FAIL (%s)\n", strerror(errno));
+      status ++;
+    }
+
    /*
     * cupsFileCompression()
     */
@@ -134,7 +134,19 @@ main(int  argc,				/* I - Argument Count */
     { 0x41, 0x20, 0x21, 0x3D, 0x20, 0xE4, 0xB9, 0x82, 0x2E, 0x00 };
     /* "A != <CJK U+4E42>." - use Windows 950 (Big5) or EUC-TW */
   cups_utf8_t	utf8dest[1024];		/* UTF-8 destination string */
-  cups_utf32_t	utf32dest[1024];	/* UTF-32 destination string */
+  cups_utf32_t	utf32dest[1024],	/* UTF-32 destination string */
+		utf32buf[1024];		/* UTF-32 destination buffer */
+  ssize_t	buflen;			/* Length of UTF-32 buffer */
+  size_t	i;			/* Looping var */
+  static const char * const bad_utf8[] =/* Invalid UTF-8 sequences */
+  {
+    "\xc0\xaf",			/* Overlong '/' */
+    "\xe0\x80\xaf",			/* Overlong '/' */
+    "\xed\xa0\x80",			/* UTF-16 surrogate */
+    "\xf4\x90\x80\x80",		/* Beyond Plane 16 */
+    "\xe2\x89",			/* Truncated sequence */
+    "\xff"				/* Invalid octet */
+  };
 
 
   if (argc > 1)
@@ -219,6 +231,82 @@ main(int  argc,				/* I - Argument Count */
   if (!status)
     puts("PASS");
 
+ /*
+  * cupsUTF8ToUTF32Buffer and cupsUTF8Validate
+  */
+
+  fputs("cupsUTF8ToUTF32Buffer of utfdemo.txt: ", stdout);
+
+  rewind(fp);
+
+  for (count = 0, status = 0; fgets(line, sizeof(line), fp);)
+  {
+    count ++;
+
+    len    = cupsUTF8ToUTF32(utf32dest, (cups_utf8_t *)line, 1024);
+    buflen = cupsUTF8ToUTF32Buffer(utf32buf, 1024, (cups_utf8_t *)line, strlen(line));
+
+    if (buflen != len || memcmp(utf32dest, utf32buf, (size_t)len * sizeof(cups_utf32_t)))
+    {
+      printf("FAIL (got %d characters, expected %d on line %d)\n", (int)buflen, len, count);
+      errors ++;
+      status = 1;
+      break;
+    }
+    else if (cupsUTF8Validate((cups_utf8_t *)line, strlen(line)) != strlen(line))
+    {
+      printf("FAIL (line %d not valid)\n", count);
+      errors ++;
+      status = 1;
+      break;
+    }
+  }
+
+  if (!status)
+    puts("PASS");
+
+  fputs("cupsUTF8Validate(bad sequences): ", stdout);
+
+  for (i = 0, status = 0; i < (sizeof(bad_utf8) / sizeof(bad_utf8[0])); i ++)
+  {
+    snprintf(line, sizeof(line), "Some valid US-ASCII text before %s and after", bad_utf8[i]);
+
+    if (cupsUTF8Validate((cups_utf8_t *)line, strlen(line)) != 32)
+    {
+      printf("FAIL (sequence %d not detected)\n", (int)i + 1);
+      errors ++;
+      status = 1;
+      break;
+    }
+    else if (cupsUTF8ToUTF32Buffer(utf32buf, 1024, (cups_utf8_t *)line, strlen(line)) >= 0)
+    {
+      printf("FAIL (sequence %d converted)\n", (int)i + 1);
+      errors ++;
+      status = 1;
+      break;
+    }
+  }
+
+  if (!status)
+    puts("PASS");
+
+  fputs("_cupsUTF8PrintableLength: ", stdout);
+
+  strlcpy(line, "All of these characters are printable US-ASCII!\tBut not tab.", sizeof(line));
+
+  if (_cupsUTF8PrintableLength((cups_utf8_t *)line, strlen(line)) != 47)
+  {
+    printf("FAIL (got %d, expected 47)\n", (int)_cupsUTF8PrintableLength((cups_utf8_t *)line, strlen(line)));
+    errors ++;
+  }
+  else if (_cupsUTF8ASCIILength((cups_utf8_t *)line, strlen(line)) != strlen(line))
+  {
+    printf("FAIL (got %d US-ASCII characters, expected %d)\n", (int)_cupsUTF8ASCIILength((cups_utf8_t *)line, strlen(line)), (int)strlen(line));
+    errors ++;
+  }
+  else
+    puts("PASS");
+
  /*
   * cupsUTF8ToCharset(CUPS_EUC_JP)
   */
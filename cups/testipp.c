@@ -15,6 +15,8 @@
 #include "file.h"
 #include "string-private.h"
 #include "ipp-private.h"
+#include "cups.h"
+#include "thread-private.h"
 #ifdef _WIN32
 #  include <io.h>
 #else
@@ -287,6 +289,9 @@ static ipp_uchar_t mixed[] =		/* Mixed value buffer */
  */
 
 void	hex_dump(const char *title, ipp_uchar_t *buffer, size_t bytes);
+#ifndef _WIN32
+void	*pipeline_cb(int *fd);
+#endif /* !_WIN32 */
 void	print_attributes(ipp_t *ipp, int indent);
 ssize_t	read_cb(_ippdata_t *data, ipp_uchar_t *buffer, size_t bytes);
 ssize_t	read_hex(cups_file_t *fp, ipp_uchar_t *buffer, size_t bytes);
@@ -315,9 +320,7 @@ main(int  argc,			/* I - Number of command-line arguments */
   cups_file_t	*fp;		/* File pointer */
   size_t	i;		/* Looping var */
   int		status;		/* Status of tests (0 = success, 1 = fail) */
-#ifdef DEBUG
-  const char	*name;		/* Option name */
-#endif /* DEBUG */
+  const char	*name;		/* Option or value name */
 
 
   status = 0;
@@ -380,6 +383,25 @@ main(int  argc,			/* I - Number of command-line arguments */
     else
       puts("PASS");
 
+   /*
+    * Memory usage of the collection request...
+    */
+
+    fputs("_ippMemoryUsage: ", stdout);
+
+    if ((attr = ippFindAttribute(request, "media-col", IPP_TAG_BEGIN_COLLECTION)) == NULL)
+    {
+      puts("FAIL (no media-col)");
+      status = 1;
+    }
+    else if ((length = _ippMemoryUsage(request)) <= (sizeof(ipp_t) + _ippMemoryUsage(ippGetCollection(attr, 0)) + _ippMemoryUsage(ippGetCollection(attr, 1))))
+    {
+      printf("FAIL (%d bytes is too small)\n", (int)length);
+      status = 1;
+    }
+    else
+      printf("PASS (%d bytes)\n", (int)length);
+
    /*
     * Write test #1...
     */
@@ -748,6 +770,163 @@ main(int  argc,			/* I - Number of command-line arguments */
 
     ippDelete(request);
 
+   /*
+    * Test lookups in a message large enough to use the attribute index...
+    */
+
+    fputs("ippFindAttribute(large message): ", stdout);
+
+    request = ippNew();
+
+    for (i = 0; i < 200; i ++)
+    {
+      char	name[32];		/* Attribute name */
+
+      snprintf(name, sizeof(name), "attr-%d", (int)i);
+      ippAddInteger(request, IPP_TAG_PRINTER, IPP_TAG_INTEGER, name, (int)i);
+    }
+
+    for (i = 0; i < 200; i ++)
+    {
+      char	name[32];		/* Attribute name */
+
+      snprintf(name, sizeof(name), "ATTR-%d", (int)(199 - i));
+      if ((attr = ippFindAttribute(request, name, IPP_TAG_INTEGER)) == NULL || ippGetInteger(attr, 0) != (int)(199 - i))
+        break;
+    }
+
+    ippAddInteger(request, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "attr-5", 1005);
+    ippAddInteger(request, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "attr-new", 1000);
+
+    if (i < 200)
+    {
+      printf("FAIL (attr-%d not found)\n", (int)(199 - i));
+      status = 1;
+    }
+    else if (ippFindAttribute(request, "attr-5", IPP_TAG_KEYWORD))
+    {
+      puts("FAIL (attr-5 found with the wrong type)");
+      status = 1;
+    }
+    else if ((attr = ippFindAttribute(request, "attr-5", IPP_TAG_INTEGER)) == NULL || ippGetInteger(attr, 0) != 5 || (attr = ippFindNextAttribute(request, "attr-5", IPP_TAG_INTEGER)) == NULL || ippGetInteger(attr, 0) != 1005)
+    {
+      puts("FAIL (wrong attr-5 values)");
+      status = 1;
+    }
+    else if ((attr = ippFindAttribute(request, "attr-new", IPP_TAG_INTEGER)) == NULL || ippGetInteger(attr, 0) != 1000)
+    {
+      puts("FAIL (attr-new not found)");
+      status = 1;
+    }
+    else
+    {
+      ippDeleteAttribute(request, ippFindAttribute(request, "attr-10", IPP_TAG_ZERO));
+      attr = ippFindAttribute(request, "attr-11", IPP_TAG_ZERO);
+      ippSetName(request, &attr, "attr-renamed");
+
+      if (ippFindAttribute(request, "attr-10", IPP_TAG_ZERO) || ippFindAttribute(request, "attr-11", IPP_TAG_ZERO))
+      {
+        puts("FAIL (deleted or renamed attribute found)");
+	status = 1;
+      }
+      else if ((attr = ippFindAttribute(request, "attr-renamed", IPP_TAG_INTEGER)) == NULL || ippGetInteger(attr, 0) != 11)
+      {
+        puts("FAIL (renamed attribute not found)");
+	status = 1;
+      }
+      else
+        puts("PASS");
+    }
+
+    ippDelete(request);
+
+   /*
+    * Test an arena-backed message...
+    */
+
+    fputs("_ippNewArena: ", stdout);
+
+    request = _ippNewArena();
+
+    for (i = 0; i < 200; i ++)
+    {
+      char	name[32];		/* Attribute name */
+
+      snprintf(name, sizeof(name), "attr-%d", (int)i);
+      ippAddString(request, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, name, NULL, name);
+    }
+
+    attr = ippAddString(request, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "grow", NULL, "value-0");
+    for (i = 1; i < 100; i ++)
+    {
+      char	value[32];		/* Attribute value */
+
+      snprintf(value, sizeof(value), "value-%d", (int)i);
+      ippSetString(request, &attr, (int)i, value);
+    }
+
+    ippDeleteAttribute(request, ippFindAttribute(request, "attr-10", IPP_TAG_ZERO));
+
+    cols[0] = ippNew();
+    ippCopyAttributes(cols[0], request, 0, NULL, NULL);
+
+    if ((attr = ippFindAttribute(cols[0], "grow", IPP_TAG_KEYWORD)) == NULL || ippGetCount(attr) != 100 || strcmp(ippGetString(attr, 99, NULL), "value-99"))
+    {
+      puts("FAIL (wrong grow values)");
+      status = 1;
+    }
+    else if ((attr = ippFindAttribute(request, "attr-199", IPP_TAG_KEYWORD)) == NULL || strcmp(ippGetString(attr, 0, NULL), "attr-199") || ippFindAttribute(cols[0], "attr-10", IPP_TAG_ZERO))
+    {
+      puts("FAIL (wrong attr values)");
+      status = 1;
+    }
+    else
+      puts("PASS");
+
+    ippDelete(request);
+    ippDelete(cols[0]);
+
+   /*
+    * Read the sample request into an arena message...
+    */
+
+    fputs("ippReadIO(arena): ", stdout);
+
+    request      = _ippNewArena();
+    data.rpos    = 0;
+    data.wused   = sizeof(collection);
+    data.wsize   = sizeof(collection);
+    data.wbuffer = collection;
+
+    while ((state = ippReadIO(&data, (ipp_iocb_t)read_cb, 1, NULL, request)) != IPP_STATE_DATA)
+      if (state == IPP_STATE_ERROR)
+	break;
+
+    if (state != IPP_STATE_DATA)
+    {
+      puts("FAIL (read error)");
+      status = 1;
+    }
+    else if ((attr = ippFindAttribute(request, "attributes-charset", IPP_TAG_CHARSET)) == NULL || strcmp(ippGetString(attr, 0, NULL), "utf-8"))
+    {
+      puts("FAIL (wrong attributes-charset)");
+      status = 1;
+    }
+    else if (ippLength(request) != sizeof(collection))
+    {
+      printf("FAIL - wrong ippLength(), %d instead of %d bytes!\n", (int)ippLength(request), (int)sizeof(collection));
+      status = 1;
+    }
+    else if (!ippSetString(request, &attr, 0, "us-ascii") || strcmp(ippGetString(attr, 0, NULL), "us-ascii"))
+    {
+      puts("FAIL (unable to set attributes-charset)");
+      status = 1;
+    }
+    else
+      puts("PASS");
+
+    ippDelete(request);
+
 #ifdef DEBUG
    /*
     * Test that private option array is sorted...
@@ -776,6 +955,127 @@ main(int  argc,			/* I - Number of command-line arguments */
       status = 1;
     }
 
+#ifndef _WIN32
+   /*
+    * Test pipelined requests against a local test server...
+    */
+
+    printf("cupsSendRequests/cupsGetResponses: ");
+    fflush(stdout);
+
+    {
+      http_addrlist_t	*addrlist;	/* Loopback address */
+      http_addr_t	addr;		/* Listening address */
+      socklen_t		addrlen = sizeof(addr);
+					/* Length of address */
+      int		listenfd = -1;	/* Listening socket */
+      _cups_thread_t	server;		/* Server thread */
+      http_t		*http;		/* Client connection */
+      ipp_t		*requests[5],	/* Pipelined requests */
+			*responses[5];	/* Responses */
+      int		count;		/* Number of requests/responses */
+
+
+      if ((addrlist = httpAddrGetList("127.0.0.1", AF_INET, "0")) != NULL)
+      {
+        listenfd = httpAddrListen(&(addrlist->addr), 0);
+        httpAddrFreeList(addrlist);
+      }
+
+      if (listenfd < 0 || getsockname(listenfd, (struct sockaddr *)&addr, &addrlen))
+      {
+        printf("FAIL (unable to listen: %s)\n", strerror(errno));
+        status = 1;
+      }
+      else
+      {
+        server = _cupsThreadCreate((_cups_thread_func_t)pipeline_cb, &listenfd);
+
+        for (i = 0; i < 5; i ++)
+        {
+          requests[i] = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+          ippSetRequestId(requests[i], (int)i + 1);
+          ippAddString(requests[i], IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, "ipp://localhost/ipp/print");
+        }
+
+        if ((http = httpConnect2("127.0.0.1", httpAddrPort(&addr), NULL, AF_INET, HTTP_ENCRYPTION_NEVER, 1, 30000, NULL)) == NULL)
+        {
+          printf("FAIL (unable to connect: %s)\n", cupsLastErrorString());
+          status = 1;
+        }
+        else if ((count = cupsSendRequests(http, 5, requests, "/ipp/print")) != 5)
+        {
+          printf("FAIL (sent %d requests, expected 5: %s)\n", count, cupsLastErrorString());
+          status = 1;
+        }
+        else if ((count = cupsGetResponses(http, 5, responses, "/ipp/print")) != 5)
+        {
+          printf("FAIL (got %d responses, expected 5: %s)\n", count, cupsLastErrorString());
+          status = 1;
+
+          for (i = 0; i < 5; i ++)
+            ippDelete(responses[i]);
+        }
+        else
+        {
+          for (i = 0; i < 5; i ++)
+          {
+            if (ippGetRequestId(responses[i]) != (int)i + 1 || ippGetStatusCode(responses[i]) != IPP_STATUS_OK)
+            {
+              printf("FAIL (response %d has request-id %d and status %s)\n", (int)i + 1, ippGetRequestId(responses[i]), ippErrorString(ippGetStatusCode(responses[i])));
+              status = 1;
+              break;
+            }
+          }
+
+          if (i == 5)
+            puts("PASS");
+
+          for (i = 0; i < 5; i ++)
+            ippDelete(responses[i]);
+        }
+
+        for (i = 0; i < 5; i ++)
+          ippDelete(requests[i]);
+
+        httpClose(http);
+
+        _cupsThreadWait(server);
+      }
+
+      if (listenfd >= 0)
+        httpAddrClose(NULL, listenfd);
+    }
+#endif /* !_WIN32 */
+
+   /*
+    * Test the name lookup functions against their string functions...
+    */
+
+    fputs("ippOpValue/ippTagValue/ippEnumValue: ", stdout);
+    for (i = 0; i < 0x5000; i ++)
+    {
+      if (strncmp(name = ippOpString((ipp_op_t)i), "0x", 2) && ippOpValue(name) != (ipp_op_t)i)
+        break;
+      else if (i < 0x80 && strcmp(name = ippTagString((ipp_tag_t)i), "UNKNOWN") && (ipp_tag_t)i != IPP_TAG_EXTENSION && ippTagValue(name) != (ipp_tag_t)i)
+        break;
+      else if (i >= 3 && i < 0x100 && !isdigit(*(name = ippEnumString("finishings", (int)i)) & 255) && ippEnumValue("finishings", name) != (int)i)
+        break;
+    }
+
+    if (i < 0x5000)
+    {
+      printf("FAIL (\"%s\" != 0x%04x)\n", name, (unsigned)i);
+      status = 1;
+    }
+    else if (ippOpValue("cups-get-ppd") != IPP_OP_CUPS_GET_PPD || ippTagValue("printer") != IPP_TAG_PRINTER || ippEnumValue("printer-state", "stopped") != IPP_PSTATE_STOPPED || ippErrorValue("server-error-busy") != IPP_STATUS_ERROR_BUSY || ippOpValue("bogus") != IPP_OP_CUPS_INVALID)
+    {
+      puts("FAIL (bad alias or case lookup)");
+      status = 1;
+    }
+    else
+      puts("PASS");
+
    /*
     * Summarize...
     */
@@ -935,6 +1235,70 @@ hex_dump(const char  *title,		/* I - Title */
 }
 
 
+#ifndef _WIN32
+/*
+ * 'pipeline_cb()' - Answer IPP requests on the first connection to a socket.
+ *
+ * Each response copies the request-id of its request so the client can check
+ * that pipelined responses come back in order.
+ */
+
+void *					/* O - Thread exit status */
+pipeline_cb(int *fd)			/* I - Listening socket */
+{
+  http_t	*http;			/* Server connection */
+  ipp_t		*request,		/* IPP request */
+		*response;		/* IPP response */
+  ipp_state_t	state;			/* IPP read state */
+  char		resource[256];		/* Resource path */
+
+
+  if ((http = httpAcceptConnection(*fd, 1)) == NULL)
+    return (NULL);
+
+  while (httpReadRequest(http, resource, sizeof(resource)) == HTTP_STATE_POST)
+  {
+    while (httpUpdate(http) == HTTP_STATUS_CONTINUE);
+
+    request = ippNew();
+
+    while ((state = ippRead(http, request)) != IPP_STATE_DATA)
+      if (state == IPP_STATE_ERROR)
+        break;
+
+    if (state == IPP_STATE_ERROR)
+    {
+      ippDelete(request);
+      break;
+    }
+
+    response = ippNewResponse(request);
+
+    httpClearFields(http);
+    httpSetField(http, HTTP_FIELD_CONTENT_TYPE, "application/ipp");
+    httpSetLength(http, ippLength(response));
+
+    if (httpWriteResponse(http, HTTP_STATUS_OK) < 0)
+      state = IPP_STATE_ERROR;
+    else
+      while ((state = ippWrite(http, response)) != IPP_STATE_DATA)
+        if (state == IPP_STATE_ERROR)
+          break;
+
+    ippDelete(request);
+    ippDelete(response);
+
+    if (state == IPP_STATE_ERROR)
+      break;
+  }
+
+  httpClose(http);
+
+  return (NULL);
+}
+#endif /* !_WIN32 */
+
+
 /*
  * 'print_attributes()' - Print the attributes in a request...
  */
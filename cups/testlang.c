@@ -27,6 +27,7 @@
  */
 
 static int	show_ppd(const char *filename);
+static int	test_catalog(const char *filename);
 static int	test_string(cups_lang_t *language, const char *msgid);
 static void	usage(void);
 
@@ -182,6 +183,16 @@ main(int  argc,				/* I - Number of command-line arguments */
       }
     }
 
+#if !defined(_WIN32) && !(defined(__APPLE__) && defined(CUPS_BUNDLEDIR))
+   /*
+    * Test compiled message catalogs...
+    */
+
+    snprintf(buffer, sizeof(buffer), "%s/de/cups_de.po", _cupsGlobals()->localedir);
+    if (!access(buffer, 0))
+      errors += test_catalog(buffer);
+#endif /* !_WIN32 && !(__APPLE__ && CUPS_BUNDLEDIR) */
+
 #ifdef __APPLE__
    /*
     * Test all possible language IDs for compatibility with _cupsAppleLocale...
@@ -327,6 +338,82 @@ show_ppd(const char *filename)		/* I - Filename */
 }
 
 
+/*
+ * 'test_catalog()' - Test that a compiled catalog matches its .po file.
+ */
+
+static int				/* O - Number of errors */
+test_catalog(const char *filename)	/* I - .po file */
+{
+  int			errors = 0,	/* Number of errors */
+			fd;		/* Temporary file */
+  cups_array_t		*po,		/* .po messages */
+			*cat;		/* Compiled catalog */
+  _cups_message_t	*m;		/* Current message */
+  char			catname[1024];	/* Compiled catalog filename */
+  const char		*str;		/* Localized string */
+
+
+  printf("_cupsMessageSave(\"%s\", _CUPS_MESSAGE_CATALOG): ", filename);
+
+  if ((fd = cupsTempFd(catname, sizeof(catname))) < 0)
+  {
+    printf("FAIL (%s)\n", strerror(errno));
+    return (1);
+  }
+
+  close(fd);
+
+  po = _cupsMessageLoad(filename, _CUPS_MESSAGE_UNQUOTE);
+
+  if (_cupsMessageSave(catname, _CUPS_MESSAGE_CATALOG, po))
+  {
+    unlink(catname);
+    printf("FAIL (%s)\n", strerror(errno));
+    _cupsMessageFree(po);
+    return (1);
+  }
+
+  puts("PASS");
+
+  fputs("_cupsMessageLoad(_CUPS_MESSAGE_CATALOG): ", stdout);
+
+  if ((cat = _cupsMessageLoad(catname, _CUPS_MESSAGE_CATALOG)) == NULL)
+  {
+    puts("FAIL (unable to map catalog)");
+    errors ++;
+  }
+  else
+  {
+    for (m = (_cups_message_t *)cupsArrayFirst(po); m; m = (_cups_message_t *)cupsArrayNext(po))
+    {
+      if (strcmp(str = _cupsMessageLookup(cat, m->msg), m->str))
+      {
+        printf("FAIL (\"%s\" is \"%s\", expected \"%s\")\n", m->msg, str, m->str);
+        errors ++;
+        break;
+      }
+    }
+
+    if (!errors && strcmp(_cupsMessageLookup(cat, "No Such Message"), "No Such Message"))
+    {
+      puts("FAIL (unknown message was localized)");
+      errors ++;
+    }
+
+    if (!errors)
+      printf("PASS (%d messages)\n", cupsArrayCount(po));
+
+    _cupsMessageFree(cat);
+  }
+
+  unlink(catname);
+  _cupsMessageFree(po);
+
+  return (errors);
+}
+
+
 /*
  * 'test_string()' - Test the localization of a string.
  */
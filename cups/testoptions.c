@@ -24,6 +24,7 @@ main(int  argc,				/* I - Number of command-line arguments */
   int		status = 0,		/* Exit status */
 		num_options;		/* Number of options */
   cups_option_t	*options;		/* Options */
+  cups_options_t *opts;			/* Option container */
   const char	*value;			/* Value of an option */
   ipp_t		*request;		/* IPP request */
   ipp_attribute_t *attr;		/* IPP attribute */
@@ -150,6 +151,106 @@ main(int  argc,				/* I - Number of command-line arguments */
     }
     else
       puts("PASS");
+
+    ippDelete(request);
+    cupsFreeOptions(num_options, options);
+
+   /*
+    * cupsOptionsParse()
+    */
+
+    fputs("cupsOptionsParse: ", stdout);
+
+    opts = cupsOptionsNew();
+
+    if (cupsOptionsParse(opts, "foo=1234 nobar baz={param1=1 param2=2} "
+                               "foobar=FOO\\ BAR print-quality=5") != 5)
+    {
+      printf("FAIL (%d options, expected 5)\n", cupsOptionsCount(opts));
+      status ++;
+    }
+    else if ((value = cupsOptionsGet(opts, "bar")) == NULL || strcmp(value, "false"))
+    {
+      printf("FAIL (bar=\"%s\", expected \"false\")\n", value);
+      status ++;
+    }
+    else if ((value = cupsOptionsGet(opts, "foobar")) == NULL || strcmp(value, "FOO BAR"))
+    {
+      printf("FAIL (foobar=\"%s\", expected \"FOO BAR\")\n", value);
+      status ++;
+    }
+    else
+      puts("PASS");
+
+   /*
+    * cupsOptionsAdd()
+    */
+
+    fputs("cupsOptionsAdd: ", stdout);
+
+    for (count = 0; count < 1000; count ++)
+    {
+      char	name[32],		/* Option name */
+		temp[32];		/* Option value */
+
+      snprintf(name, sizeof(name), "option-%d", (count * 7919) % 1000);
+      snprintf(temp, sizeof(temp), "value-%d", count);
+
+      if (!cupsOptionsAdd(opts, name, temp))
+        break;
+    }
+
+    cupsOptionsAdd(opts, "foo", "5678");
+    cupsOptionsAdd(opts, "cupsPrintQuality", "High");
+
+    if (count < 1000)
+    {
+      puts("FAIL (unable to add option)");
+      status ++;
+    }
+    else if (cupsOptionsCount(opts) != 1005)
+    {
+      printf("FAIL (%d options, expected 1005)\n", cupsOptionsCount(opts));
+      status ++;
+    }
+    else if ((value = cupsOptionsGet(opts, "foo")) == NULL || strcmp(value, "5678"))
+    {
+      printf("FAIL (foo=\"%s\", expected \"5678\")\n", value);
+      status ++;
+    }
+    else if (cupsOptionsGet(opts, "print-quality"))
+    {
+      puts("FAIL (print-quality not replaced by cupsPrintQuality)");
+      status ++;
+    }
+    else if ((value = cupsGetOption("option-999", cupsOptionsCount(opts), cupsOptionsGetArray(opts))) == NULL)
+    {
+      puts("FAIL (option-999 not found in array)");
+      status ++;
+    }
+    else
+      puts("PASS");
+
+   /*
+    * cupsOptionsRemove()
+    */
+
+    fputs("cupsOptionsRemove: ", stdout);
+
+    if (!cupsOptionsRemove(opts, "baz") || cupsOptionsRemove(opts, "baz"))
+    {
+      puts("FAIL (unable to remove baz exactly once)");
+      status ++;
+    }
+    else if (cupsOptionsGet(opts, "baz") || !cupsOptionsGet(opts, "foobar"))
+    {
+      puts("FAIL (wrong option removed)");
+      status ++;
+    }
+    else
+      puts("PASS");
+
+    cupsOptionsDelete(opts);
   }
   else
   {
@@ -299,7 +299,8 @@ main(int  argc,				/* I - Number of command-line arguments */
      char *argv[])			/* I - Command-line arguments */
 {
   int		i;			/* Looping var */
-  ppd_file_t	*ppd = NULL;		/* PPD file loaded from disk */
+  ppd_file_t	*ppd = NULL,		/* PPD file loaded from disk */
+		*snap;			/* PPD file loaded from snapshot */
   int		status;			/* Status of tests (0 = success, 1 = fail) */
   int		conflicts;		/* Number of conflicts */
   char		*s;			/* String */
@@ -406,6 +407,57 @@ main(int  argc,				/* I - Number of command-line arguments */
     else
       puts("PASS");
 
+    fputs("_ppdWriteSnapshot: ", stdout);
+    if (_ppdWriteSnapshot(ppd, "test.ppd", "test.snapshot"))
+      puts("PASS");
+    else
+    {
+      status ++;
+      printf("FAIL (%s)\n", strerror(errno));
+    }
+
+    fputs("_ppdOpenSnapshot: ", stdout);
+    if ((snap = _ppdOpenSnapshot("test.snapshot", "test.ppd")) == NULL)
+    {
+      status ++;
+      puts("FAIL");
+    }
+    else
+    {
+      ppdMarkDefaults(snap);
+
+      if ((s = ppdEmitString(snap, PPD_ORDER_ANY, 0.0)) == NULL || strcmp(s, default_code))
+      {
+	status ++;
+	printf("FAIL (%d bytes of default code instead of %d)\n", s ? (int)strlen(s) : 0, (int)strlen(default_code));
+      }
+      else if (!ppdFindAttr(snap, "cupsTest", "Bar") || !snap->modelname || strcmp(snap->modelname, ppd->modelname))
+      {
+        status ++;
+        puts("FAIL (bad attributes)");
+      }
+      else
+      {
+        ppd_file_t *def = ppdOpenFile("test.ppd");
+					/* PPD file with default localization */
+
+        if (!def || def->num_attrs != snap->num_attrs)
+        {
+          status ++;
+          printf("FAIL (%d attributes instead of %d)\n", snap->num_attrs, def ? def->num_attrs : 0);
+        }
+        else
+          puts("PASS");
+
+        ppdClose(def);
+      }
+
+      free(s);
+      ppdClose(snap);
+    }
+
+    unlink("test.snapshot");
+
     fputs("ppdMarkDefaults: ", stdout);
     ppdMarkDefaults(ppd);
 
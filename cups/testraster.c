@@ -20,6 +20,7 @@
  * Local functions...
  */
 
+static int	do_copy_tests(void);
 static int	do_ras_file(const char *filename);
 static int	do_raster_tests(cups_mode_t mode);
 static void	print_changes(cups_page_header2_t *header, cups_page_header2_t *expected);
@@ -42,6 +43,9 @@ main(int  argc,				/* I - Number of command-line args */
     errors += do_raster_tests(CUPS_RASTER_WRITE_COMPRESSED);
     errors += do_raster_tests(CUPS_RASTER_WRITE_PWG);
     errors += do_raster_tests(CUPS_RASTER_WRITE_APPLE);
+    errors += do_raster_tests((cups_mode_t)(CUPS_RASTER_WRITE_COMPRESSED | CUPS_RASTER_WRITE_THREADED));
+    errors += do_raster_tests((cups_mode_t)(CUPS_RASTER_WRITE_PWG | CUPS_RASTER_WRITE_THREADED));
+    errors += do_copy_tests();
   }
   else
   {
@@ -55,6 +59,118 @@ main(int  argc,				/* I - Number of command-line args */
 }
 
 
+/*
+ * 'do_copy_tests()' - Test copying of compressed raster pages.
+ */
+
+static int				/* O - Number of errors */
+do_copy_tests(void)
+{
+  int			page;		/* Current page */
+  unsigned		y;		/* Current line */
+  cups_raster_t		*in,		/* Input stream */
+			*out,		/* Output stream */
+			*copy;		/* Copied stream */
+  FILE			*infp,		/* Input file */
+			*outfp,		/* Output file */
+			*copyfp;	/* Copied file */
+  cups_page_header2_t	header,		/* Page header */
+			expected;	/* Expected page header */
+  unsigned char		data[2048],	/* Original line data */
+			cdata[2048];	/* Copied line data */
+  int			errors = 0;	/* Number of errors */
+
+
+ /*
+  * Copy the pages written by the last do_raster_tests() call...
+  */
+
+  fputs("_cupsRasterCopyPage: ", stdout);
+  fflush(stdout);
+
+  if ((infp = fopen("test.raster", "rb")) == NULL)
+  {
+    printf("FAIL (%s)\n", strerror(errno));
+    return (1);
+  }
+
+  if ((outfp = fopen("test-copy.raster", "wb")) == NULL)
+  {
+    printf("FAIL (%s)\n", strerror(errno));
+    fclose(infp);
+    return (1);
+  }
+
+  in  = cupsRasterOpen(fileno(infp), CUPS_RASTER_READ);
+  out = cupsRasterOpen(fileno(outfp), CUPS_RASTER_WRITE_PWG);
+
+  for (page = 0; cupsRasterReadHeader2(in, &header); page ++)
+  {
+    if (!cupsRasterWriteHeader2(out, &header) || _cupsRasterCopyPage(in, out) != 1)
+    {
+      printf("FAIL (page %d not copied)\n", page + 1);
+      errors ++;
+      break;
+    }
+  }
+
+  cupsRasterClose(in);
+  cupsRasterClose(out);
+  fclose(infp);
+  fclose(outfp);
+
+  if (errors)
+    return (errors);
+
+ /*
+  * Then compare the decoded pixels...
+  */
+
+  infp   = fopen("test.raster", "rb");
+  copyfp = fopen("test-copy.raster", "rb");
+  in     = cupsRasterOpen(fileno(infp), CUPS_RASTER_READ);
+  copy   = cupsRasterOpen(fileno(copyfp), CUPS_RASTER_READ);
+
+  for (page = 0; !errors && cupsRasterReadHeader2(in, &expected); page ++)
+  {
+    if (!cupsRasterReadHeader2(copy, &header) || memcmp(&header, &expected, sizeof(header)))
+    {
+      printf("FAIL (bad page header for page %d)\n", page + 1);
+      errors ++;
+      break;
+    }
+
+    for (y = 0; y < header.cupsHeight; y ++)
+    {
+      if (!cupsRasterReadPixels(in, data, header.cupsBytesPerLine) ||
+          !cupsRasterReadPixels(copy, cdata, header.cupsBytesPerLine) ||
+	  memcmp(data, cdata, header.cupsBytesPerLine))
+      {
+        printf("FAIL (bad data on page %d, line %u)\n", page + 1, y);
+	errors ++;
+	break;
+      }
+    }
+  }
+
+  if (!errors && cupsRasterReadHeader2(copy, &header))
+  {
+    puts("FAIL (extra page)");
+    errors ++;
+  }
+
+  cupsRasterClose(in);
+  cupsRasterClose(copy);
+  fclose(infp);
+  fclose(copyfp);
+
+  if (!errors)
+    printf("PASS (%d pages)\n", page);
+
+  return (errors);
+}
+
+
 /*
  * 'do_ras_file()' - Test reading of a raster file.
  */
@@ -132,17 +248,21 @@ do_raster_tests(cups_mode_t mode)	/* O - Write mode */
 			expected;	/* Expected page header */
   unsigned char		data[2048];	/* Raster data */
   int			errors = 0;	/* Number of errors */
+  cups_mode_t		wmode = mode;	/* Write mode with flags */
 
 
  /*
   * Test writing...
   */
 
-  printf("cupsRasterOpen(%s): ",
+  mode = (cups_mode_t)((unsigned)mode & ~(unsigned)CUPS_RASTER_WRITE_THREADED);
+
+  printf("cupsRasterOpen(%s%s): ",
          mode == CUPS_RASTER_WRITE ? "CUPS_RASTER_WRITE" :
 	     mode == CUPS_RASTER_WRITE_COMPRESSED ? "CUPS_RASTER_WRITE_COMPRESSED" :
 	     mode == CUPS_RASTER_WRITE_PWG ? "CUPS_RASTER_WRITE_PWG" :
-				             "CUPS_RASTER_WRITE_APPLE");
+				             "CUPS_RASTER_WRITE_APPLE",
+	 wmode != mode ? " | CUPS_RASTER_WRITE_THREADED" : "");
   fflush(stdout);
 
   if ((fp = fopen("test.raster", "wb")) == NULL)
@@ -151,7 +271,7 @@ do_raster_tests(cups_mode_t mode)	/* O - Write mode */
     return (1);
   }
 
-  if ((r = cupsRasterOpen(fileno(fp), mode)) == NULL)
+  if ((r = cupsRasterOpen(fileno(fp), wmode)) == NULL)
   {
     printf("FAIL (%s)\n", strerror(errno));
     fclose(fp);
@@ -66,6 +66,8 @@ main(int  argc,				/* I - Number of command-line args */
     }
     else if (!strcmp(argv[i], "-d"))
       _cupsSNMPSetDebug(10);
+    else if (!strcmp(argv[i], "-b"))
+      walk = 2;
     else if (!strcmp(argv[i], "-w"))
       walk = 1;
     else if (!host)
@@ -195,7 +197,7 @@ show_oid(int         fd,		/* I - SNMP socket */
          const char  *community,	/* I - Community name */
 	 http_addr_t *addr,		/* I - Address to query */
          const char  *s,		/* I - OID to query */
-	 int         walk)		/* I - Walk OIDs? */
+	 int         walk)		/* I - Walk OIDs (1 = GetNext, 2 = GetBulk)? */
 {
   int		i;			/* Looping var */
   int		oid[CUPS_SNMP_MAX_OID];	/* OID */
@@ -209,7 +211,18 @@ show_oid(int         fd,		/* I - SNMP socket */
     return (0);
   }
 
-  if (walk)
+  if (walk == 2)
+  {
+    printf("_cupsSNMPBulkWalk(%s): ", _cupsSNMPOIDToString(oid, temp, sizeof(temp)));
+
+    if (_cupsSNMPBulkWalk(fd, addr, community, oid, 16, 5.0, print_packet,
+                          NULL) < 0)
+    {
+      printf("FAIL (%s)\n", strerror(errno));
+      return (0);
+    }
+  }
+  else if (walk)
   {
     printf("_cupsSNMPWalk(%s): ", _cupsSNMPOIDToString(oid, temp, sizeof(temp)));
 
@@ -276,6 +289,7 @@ usage(void)
   puts("");
   puts("Options:");
   puts("");
+  puts("  -b              Walk OIDs using SNMPv2c GetBulk requests");
   puts("  -c community    Set community name");
   puts("  -d              Enable debugging");
   puts("  -w              Walk all OIDs under the specified one");
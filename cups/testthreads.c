@@ -11,41 +11,482 @@
  * Include necessary headers...
  */
 
-#include <stdio.h>
-#include <errno.h>
-#include <cups/cups.h>
-#include <cups/thread-private.h>
+#include "cups-private.h"
+#include "ppd-private.h"
+#include "thread-private.h"
+#include <sys/time.h>
+
+
+/*
+ * Constants...
+ */
+
+#define BENCH_DURATION	5		/* Default seconds per thread count */
+#define BENCH_MAX_THREADS 256		/* Maximum number of threads */
+#define BENCH_THREADS	8		/* Default maximum number of threads */
+
+typedef enum bench_op_e			/**** Benchmark workloads ****/
+{
+  BENCH_OP_DO_REQUEST,			/* cupsDoRequest(CUPS-Get-Printers) */
+  BENCH_OP_COPY_DEST_INFO,		/* cupsCopyDestInfo */
+  BENCH_OP_STR_ALLOC,			/* _cupsStrAlloc/_cupsStrFree */
+  BENCH_OP_LANG_GET,			/* cupsLangGet/cupsLangFree */
+  BENCH_OP_PPD_OPEN,			/* ppdOpenFile/ppdClose */
+  BENCH_OP_MAX
+} bench_op_t;
+
+
+/*
+ * Local types...
+ */
+
+typedef struct bench_thread_s		/**** Benchmark thread data ****/
+{
+  _cups_thread_t thread;		/* Thread ID */
+  int		first;			/* First workload to run */
+  int		ops[BENCH_OP_MAX],	/* Operations completed */
+		errors[BENCH_OP_MAX];	/* Operations that failed */
+  double	secs[BENCH_OP_MAX];	/* Time spent in operations */
+} bench_thread_t;
+
+typedef struct bench_result_s		/**** Benchmark results for a thread count ****/
+{
+  int		threads;		/* Number of threads */
+  double	secs;			/* Elapsed time */
+  int		ops[BENCH_OP_MAX],	/* Operations completed */
+		errors[BENCH_OP_MAX];	/* Operations that failed */
+  double	op_secs[BENCH_OP_MAX];	/* Time spent in operations */
+  _cups_lockstats_t locks;		/* Lock contention */
+} bench_result_t;
+
+
+/*
+ * Local globals...
+ */
+
+static const char * const bench_names[BENCH_OP_MAX] =
+{					/* Workload names */
+  "do-request",
+  "copy-dest-info",
+  "str-alloc",
+  "lang-get",
+  "ppd-open"
+};
+static int		bench_enabled[BENCH_OP_MAX];
+					/* Enabled workloads */
+static cups_dest_t	*bench_dest = NULL;
+					/* Destination for cupsCopyDestInfo */
+static const char	*bench_ppd = "test.ppd";
+					/* PPD file for ppdOpenFile */
+static double		bench_end = 0.0;/* End time for the current run */
 
 
 /*
  * Local functions...
  */
 
+static int	bench_run(int num_threads, int duration, bench_result_t *result);
+static void	*bench_thread(bench_thread_t *bt);
 static int	enum_dests_cb(void *_name, unsigned flags, cups_dest_t *dest);
+static double	get_time(void);
 static void	*run_query(cups_dest_t *dest);
 static void	show_supported(http_t *http, cups_dest_t *dest, cups_dinfo_t *dinfo, const char *option, const char *value);
+static int	usage(void);
 
 
 /*
  * 'main()' - Main entry.
+ *
+ * Without options, query the capabilities of each destination (or the named
+ * destination) on a separate thread.  With "-b", run a mixed multithreaded
+ * workload against the current server for increasing numbers of threads and
+ * report the throughput, scalability, and lock contention.
  */
 
 int					/* O - Exit status */
 main(int  argc,				/* I - Number of command-line arguments */
      char *argv[])			/* I - Command-line arguments */
 {
+  int		i, j,			/* Looping vars */
+		bench = 0,		/* Run benchmark? */
+		csv = 0,		/* Produce CSV output? */
+		duration = BENCH_DURATION,
+					/* Seconds per thread count */
+		max_threads = BENCH_THREADS,
+					/* Maximum number of threads */
+		num_results = 0,	/* Number of results */
+		num_workloads = 0,	/* Number of workloads on the command-line */
+		total,			/* Total operations */
+		errors;			/* Total errors */
+  const char	*name = NULL;		/* Printer name */
+  bench_result_t results[32],		/* Results for each thread count */
+		*r;			/* Current result */
+  double	rate,			/* Operations per second */
+		base_rate = 0.0;	/* Operations per second with one thread */
+
+
+ /*
+  * Parse the command-line...
+  */
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-b"))
+    {
+      bench = 1;
+    }
+    else if (!strcmp(argv[i], "-d") && (i + 1) < argc)
+    {
+      i ++;
+
+      if ((duration = atoi(argv[i])) < 1)
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-o") && (i + 1) < argc)
+    {
+      i ++;
+
+      if (!strcmp(argv[i], "csv"))
+        csv = 1;
+      else if (strcmp(argv[i], "text"))
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-p") && (i + 1) < argc)
+    {
+      i ++;
+      bench_ppd = argv[i];
+    }
+    else if (!strcmp(argv[i], "-t") && (i + 1) < argc)
+    {
+      i ++;
+
+      if ((max_threads = atoi(argv[i])) < 1 || max_threads > BENCH_MAX_THREADS)
+        return (usage());
+    }
+    else if (!strcmp(argv[i], "-w") && (i + 1) < argc)
+    {
+      i ++;
+
+      for (j = 0; j < BENCH_OP_MAX; j ++)
+        if (!strcmp(argv[i], bench_names[j]))
+          break;
+
+      if (j >= BENCH_OP_MAX)
+        return (usage());
+
+      bench_enabled[j] = 1;
+      num_workloads ++;
+    }
+    else if (argv[i][0] != '-' && !name)
+    {
+      name = argv[i];
+    }
+    else
+      return (usage());
+  }
+
+  if (!bench)
+  {
+   /*
+    * Go through all the available destinations to find the requested one...
+    */
+
+    cupsEnumDests(CUPS_DEST_FLAGS_NONE, -1, NULL, 0, 0, enum_dests_cb, (void *)name);
+
+    return (0);
+  }
+
+ /*
+  * Figure out which workloads can be run...
+  */
+
+  if (!num_workloads)
+  {
+    for (j = 0; j < BENCH_OP_MAX; j ++)
+      bench_enabled[j] = 1;
+  }
+
+  if (bench_enabled[BENCH_OP_COPY_DEST_INFO] && (bench_dest = cupsGetNamedDest(CUPS_HTTP_DEFAULT, name, NULL)) == NULL)
+  {
+    fprintf(stderr, "testthreads: No destination for %s (%s), skipping.\n", bench_names[BENCH_OP_COPY_DEST_INFO], cupsLastErrorString());
+    bench_enabled[BENCH_OP_COPY_DEST_INFO] = 0;
+  }
+
+  if (bench_enabled[BENCH_OP_PPD_OPEN] && access(bench_ppd, R_OK))
+  {
+    fprintf(stderr, "testthreads: Unable to read \"%s\" (%s), skipping %s.\n", bench_ppd, strerror(errno), bench_names[BENCH_OP_PPD_OPEN]);
+    bench_enabled[BENCH_OP_PPD_OPEN] = 0;
+  }
+
+  for (j = 0; j < BENCH_OP_MAX; j ++)
+    if (bench_enabled[j])
+      break;
+
+  if (j >= BENCH_OP_MAX)
+  {
+    fputs("testthreads: No workloads to run.\n", stderr);
+    return (1);
+  }
+
  /*
-  * Go through all the available destinations to find the requested one...
+  * Run with 1, 2, 4, ... threads up to the maximum...
   */
 
-  (void)argc;
+  if (csv)
+    puts("threads,workload,ops,ops_per_sec,avg_ms,errors,mutex_waits,mutex_wait_ms,rwlock_waits,rwlock_wait_ms");
+  else
+    printf("%7s %10s %8s %6s %12s %12s %12s %12s %7s\n", "Threads", "Ops/s", "Speedup", "Effcy", "Mutex Waits", "Mutex ms", "RWLock Waits", "RWLock ms", "Errors");
+
+  for (i = 1; num_results < (int)(sizeof(results) / sizeof(results[0])); i *= 2)
+  {
+    if (i > max_threads)
+      i = max_threads;
+
+    r = results + num_results;
 
-  cupsEnumDests(CUPS_DEST_FLAGS_NONE, -1, NULL, 0, 0, enum_dests_cb, argv[1]);
+    if (!bench_run(i, duration, r))
+      return (1);
+
+    num_results ++;
+
+    for (j = 0, total = 0, errors = 0; j < BENCH_OP_MAX; j ++)
+    {
+      total  += r->ops[j];
+      errors += r->errors[j];
+    }
+
+    rate = total / r->secs;
+    if (!base_rate)
+      base_rate = rate;
+
+    if (csv)
+    {
+      for (j = 0; j < BENCH_OP_MAX; j ++)
+        if (bench_enabled[j])
+          printf("%d,%s,%d,%.0f,%.3f,%d,,,,\n", r->threads, bench_names[j], r->ops[j], r->ops[j] / r->secs, r->ops[j] ? 1000.0 * r->op_secs[j] / r->ops[j] : 0.0, r->errors[j]);
+
+      printf("%d,total,%d,%.0f,,%d,%lu,%.3f,%lu,%.3f\n", r->threads, total, rate, errors, r->locks.mutex_waits, 1000.0 * r->locks.mutex_secs, r->locks.rwlock_waits, 1000.0 * r->locks.rwlock_secs);
+    }
+    else
+      printf("%7d %10.0f %7.2fx %5.0f%% %12lu %12.3f %12lu %12.3f %7d\n", r->threads, rate, rate / base_rate, 100.0 * rate / base_rate / r->threads, r->locks.mutex_waits, 1000.0 * r->locks.mutex_secs, r->locks.rwlock_waits, 1000.0 * r->locks.rwlock_secs, errors);
+
+    fflush(stdout);
+
+    if (i >= max_threads)
+      break;
+  }
+
+ /*
+  * Show the per-workload scalability curves...
+  */
+
+  if (!csv)
+  {
+    printf("\n%-16s", "Ops/s");
+    for (i = 0; i < num_results; i ++)
+      printf(" %9dT", results[i].threads);
+    putchar('\n');
+
+    for (j = 0; j < BENCH_OP_MAX; j ++)
+    {
+      if (!bench_enabled[j])
+        continue;
+
+      printf("%-16s", bench_names[j]);
+      for (i = 0; i < num_results; i ++)
+        printf(" %10.0f", results[i].ops[j] / results[i].secs);
+      putchar('\n');
+    }
+  }
+
+  cupsFreeDests(1, bench_dest);
 
   return (0);
 }
 
 
+/*
+ * 'bench_run()' - Run the mixed workload with the given number of threads.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+bench_run(int            num_threads,	/* I - Number of threads */
+          int            duration,	/* I - Duration in seconds */
+          bench_result_t *result)	/* O - Results */
+{
+  int		i, j;			/* Looping vars */
+  bench_thread_t *threads;		/* Threads */
+  double	start;			/* Start time */
+
+
+  if ((threads = calloc((size_t)num_threads, sizeof(bench_thread_t))) == NULL)
+  {
+    fprintf(stderr, "testthreads: Unable to allocate %d threads: %s\n", num_threads, strerror(errno));
+    return (0);
+  }
+
+  memset(result, 0, sizeof(bench_result_t));
+  result->threads = num_threads;
+
+  _cupsThreadSetLockStats(1);
+
+  start     = get_time();
+  bench_end = start + duration;
+
+  for (i = 0; i < num_threads; i ++)
+  {
+    threads[i].first = i % BENCH_OP_MAX;
+
+    if ((threads[i].thread = _cupsThreadCreate((_cups_thread_func_t)bench_thread, threads + i)) == 0)
+    {
+      fprintf(stderr, "testthreads: Unable to create thread %d: %s\n", i + 1, strerror(errno));
+      num_threads = i;
+      bench_end   = 0.0;
+      break;
+    }
+  }
+
+  for (i = 0; i < num_threads; i ++)
+  {
+    _cupsThreadWait(threads[i].thread);
+
+    for (j = 0; j < BENCH_OP_MAX; j ++)
+    {
+      result->ops[j]     += threads[i].ops[j];
+      result->errors[j]  += threads[i].errors[j];
+      result->op_secs[j] += threads[i].secs[j];
+    }
+  }
+
+  result->secs = get_time() - start;
+
+  _cupsThreadGetLockStats(&result->locks);
+  _cupsThreadSetLockStats(0);
+
+  free(threads);
+
+  return (num_threads == result->threads);
+}
+
+
+/*
+ * 'bench_thread()' - Run workloads in a loop until the end time.
+ */
+
+static void *				/* O - Thread exit status (not used) */
+bench_thread(bench_thread_t *bt)	/* I - Thread data */
+{
+  int		op;			/* Current workload */
+  int		ok;			/* Did the workload succeed? */
+  http_t	*http;			/* Connection to server */
+  ipp_t		*request,		/* IPP request */
+		*response;		/* IPP response */
+  cups_dinfo_t	*dinfo;			/* Destination information */
+  cups_lang_t	*lang;			/* Language data */
+  ppd_file_t	*ppd;			/* PPD file */
+  char		*str;			/* Pooled string */
+  char		value[64];		/* String value */
+  double	start,			/* Start of operation */
+		end;			/* End of operation */
+  static const char * const locales[] =	/* Locales for cupsLangGet */
+  {
+    "C",
+    "de",
+    "en_US",
+    "es",
+    "fr",
+    "ja"
+  };
+  static const char * const pattrs[] =	/* Requested printer attributes */
+  {
+    "printer-name",
+    "printer-state",
+    "printer-uri-supported"
+  };
+
+
+  http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, 30000, NULL);
+
+  for (op = bt->first, start = get_time(); start < bench_end; op = (op + 1) % BENCH_OP_MAX)
+  {
+    if (!bench_enabled[op])
+      continue;
+
+    switch (op)
+    {
+      case BENCH_OP_DO_REQUEST :
+          request = ippNewRequest(IPP_OP_CUPS_GET_PRINTERS);
+          ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", (int)(sizeof(pattrs) / sizeof(pattrs[0])), NULL, pattrs);
+
+          response = cupsDoRequest(http, request, "/");
+          ok       = response != NULL && cupsLastError() <= IPP_STATUS_ERROR_NOT_FOUND;
+
+          ippDelete(response);
+          break;
+
+      case BENCH_OP_COPY_DEST_INFO :
+          if ((dinfo = cupsCopyDestInfo(http, bench_dest)) != NULL)
+          {
+            ok = cupsFindDestSupported(http, bench_dest, dinfo, CUPS_MEDIA) != NULL || cupsFindDestSupported(http, bench_dest, dinfo, "job-creation-attributes") != NULL;
+            cupsFreeDestInfo(dinfo);
+          }
+          else
+            ok = 0;
+          break;
+
+      case BENCH_OP_STR_ALLOC :
+          snprintf(value, sizeof(value), "testthreads-%d", bt->ops[op] % 64);
+
+          if ((str = _cupsStrAlloc(value)) != NULL)
+          {
+            ok = !strcmp(str, value);
+            _cupsStrFree(str);
+          }
+          else
+            ok = 0;
+          break;
+
+      case BENCH_OP_LANG_GET :
+          if ((lang = cupsLangGet(locales[bt->ops[op] % (int)(sizeof(locales) / sizeof(locales[0]))])) != NULL)
+          {
+            ok = _cupsLangString(lang, "Unknown") != NULL;
+            cupsLangFree(lang);
+          }
+          else
+            ok = 0;
+          break;
+
+      case BENCH_OP_PPD_OPEN :
+          if ((ppd = ppdOpenFile(bench_ppd)) != NULL)
+          {
+            ok = ppd->num_groups > 0;
+            ppdClose(ppd);
+          }
+          else
+            ok = 0;
+          break;
+
+      default :
+          ok = 0;
+          break;
+    }
+
+    end = get_time();
+
+    bt->ops[op] ++;
+    bt->secs[op] += end - start;
+    if (!ok)
+      bt->errors[op] ++;
+
+    start = end;
+  }
+
+  httpClose(http);
+
+  return (NULL);
+}
+
+
 /*
  * 'enum_dests_cb()' - Destination enumeration function...
  */
@@ -86,6 +527,21 @@ enum_dests_cb(void        *_name,	/* I - Printer name, if any */
 }
 
 
+/*
+ * 'get_time()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+get_time(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
 /*
  * 'run_query()' - Query printer capabilities on a separate thread.
  */
@@ -266,3 +722,26 @@ show_supported(http_t       *http,	/* I - Connection to destination */
   else
     puts("NO");
 }
+
+
+/*
+ * 'usage()' - Show program usage.
+ */
+
+static int				/* O - Exit status */
+usage(void)
+{
+  puts("Usage: testthreads [printer]");
+  puts("       testthreads -b [options] [printer]");
+  puts("Options:");
+  puts("  -b                      Run the multithreaded benchmark.");
+  puts("  -d seconds              Duration for each thread count (default 5).");
+  puts("  -o {text,csv}           Output format (default text).");
+  puts("  -p filename.ppd         PPD file for ppd-open (default test.ppd).");
+  puts("  -t threads              Maximum number of threads (default 8).");
+  puts("  -w workload             Run only the named workload (repeatable).");
+  puts("Workloads:");
+  puts("  do-request, copy-dest-info, str-alloc, lang-get, ppd-open");
+
+  return (1);
+}
@@ -78,6 +78,19 @@ typedef void	*_cups_threadkey_t;
 #  endif /* HAVE_PTHREAD_H */
 
 
+/*
+ * Types...
+ */
+
+typedef struct _cups_lockstats_s	/**** Lock contention statistics ****/
+{
+  unsigned long	mutex_waits;		/* Number of contended mutex locks */
+  double	mutex_secs;		/* Time spent waiting for mutexes */
+  unsigned long	rwlock_waits;		/* Number of contended reader/writer locks */
+  double	rwlock_secs;		/* Time spent waiting for reader/writer locks */
+} _cups_lockstats_t;
+
+
 /*
  * Functions...
  */
@@ -95,6 +108,8 @@ extern void	_cupsRWUnlock(_cups_rwlock_t *rwlock) _CUPS_PRIVATE;
 extern void	_cupsThreadCancel(_cups_thread_t thread) _CUPS_PRIVATE;
 extern _cups_thread_t _cupsThreadCreate(_cups_thread_func_t func, void *arg) _CUPS_PRIVATE;
 extern void     _cupsThreadDetach(_cups_thread_t thread) _CUPS_PRIVATE;
+extern void	_cupsThreadGetLockStats(_cups_lockstats_t *stats) _CUPS_PRIVATE;
+extern void	_cupsThreadSetLockStats(int enable) _CUPS_PRIVATE;
 extern void	*_cupsThreadWait(_cups_thread_t thread) _CUPS_PRIVATE;
 
 #  ifdef __cplusplus
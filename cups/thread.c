@@ -16,6 +16,24 @@
 
 
 #if defined(HAVE_PTHREAD_H)
+/*
+ * Local globals...
+ */
+
+static int		lock_stats_enabled = 0;
+					/* Collect lock statistics? */
+static pthread_mutex_t	lock_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+					/* Mutex for lock statistics */
+static _cups_lockstats_t lock_stats;	/* Lock statistics */
+
+
+/*
+ * Local functions...
+ */
+
+static void	cups_add_lock_wait(unsigned long *waits, double *secs, struct timespec *start);
+
+
 /*
  * '_cupsCondBroadcast()' - Wake up waiting threads.
  */
@@ -87,7 +105,18 @@ _cupsMutexInit(_cups_mutex_t *mutex)	/* I - Mutex */
 void
 _cupsMutexLock(_cups_mutex_t *mutex)	/* I - Mutex */
 {
-  pthread_mutex_lock(mutex);
+  if (!lock_stats_enabled)
+  {
+    pthread_mutex_lock(mutex);
+  }
+  else if (pthread_mutex_trylock(mutex))
+  {
+    struct timespec start;		/* Start of wait */
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(mutex);
+    cups_add_lock_wait(&lock_stats.mutex_waits, &lock_stats.mutex_secs, &start);
+  }
 }
 
 
@@ -120,7 +149,18 @@ _cupsRWInit(_cups_rwlock_t *rwlock)	/* I - Reader/writer lock */
 void
 _cupsRWLockRead(_cups_rwlock_t *rwlock)	/* I - Reader/writer lock */
 {
-  pthread_rwlock_rdlock(rwlock);
+  if (!lock_stats_enabled)
+  {
+    pthread_rwlock_rdlock(rwlock);
+  }
+  else if (pthread_rwlock_tryrdlock(rwlock))
+  {
+    struct timespec start;		/* Start of wait */
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_rwlock_rdlock(rwlock);
+    cups_add_lock_wait(&lock_stats.rwlock_waits, &lock_stats.rwlock_secs, &start);
+  }
 }
 
 
@@ -131,7 +171,18 @@ _cupsRWLockRead(_cups_rwlock_t *rwlock)	/* I - Reader/writer lock */
 void
 _cupsRWLockWrite(_cups_rwlock_t *rwlock)/* I - Reader/writer lock */
 {
-  pthread_rwlock_wrlock(rwlock);
+  if (!lock_stats_enabled)
+  {
+    pthread_rwlock_wrlock(rwlock);
+  }
+  else if (pthread_rwlock_trywrlock(rwlock))
+  {
+    struct timespec start;		/* Start of wait */
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_rwlock_wrlock(rwlock);
+    cups_add_lock_wait(&lock_stats.rwlock_waits, &lock_stats.rwlock_secs, &start);
+  }
 }
 
 
@@ -186,6 +237,39 @@ _cupsThreadDetach(_cups_thread_t thread)/* I - Thread ID */
 }
 
 
+/*
+ * '_cupsThreadGetLockStats()' - Get lock contention statistics.
+ *
+ * Only locks that had to wait are counted, and only while statistics are
+ * enabled with @link _cupsThreadSetLockStats@.
+ */
+
+void
+_cupsThreadGetLockStats(
+    _cups_lockstats_t *stats)		/* O - Lock statistics */
+{
+  pthread_mutex_lock(&lock_stats_mutex);
+  *stats = lock_stats;
+  pthread_mutex_unlock(&lock_stats_mutex);
+}
+
+
+/*
+ * '_cupsThreadSetLockStats()' - Enable or disable lock contention statistics.
+ *
+ * The statistics are cleared each time this function is called.
+ */
+
+void
+_cupsThreadSetLockStats(int enable)	/* I - 1 to enable, 0 to disable */
+{
+  pthread_mutex_lock(&lock_stats_mutex);
+  memset(&lock_stats, 0, sizeof(lock_stats));
+  lock_stats_enabled = enable;
+  pthread_mutex_unlock(&lock_stats_mutex);
+}
+
+
 /*
  * '_cupsThreadWait()' - Wait for a thread to exit.
  */
@@ -203,6 +287,28 @@ _cupsThreadWait(_cups_thread_t thread)	/* I - Thread ID */
 }
 
 
+/*
+ * 'cups_add_lock_wait()' - Add a lock wait to the statistics.
+ */
+
+static void
+cups_add_lock_wait(
+    unsigned long   *waits,		/* I - Wait counter */
+    double          *secs,		/* I - Wait time */
+    struct timespec *start)		/* I - Start of wait */
+{
+  struct timespec	end;		/* End of wait */
+
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  pthread_mutex_lock(&lock_stats_mutex);
+  (*waits) ++;
+  *secs += (end.tv_sec - start->tv_sec) + 0.000000001 * (end.tv_nsec - start->tv_nsec);
+  pthread_mutex_unlock(&lock_stats_mutex);
+}
+
+
 #elif defined(_WIN32)
 #  include <process.h>
 
@@ -369,6 +475,29 @@ _cupsThreadDetach(_cups_thread_t thread)/* I - Thread ID */
 }
 
 
+/*
+ * '_cupsThreadGetLockStats()' - Get lock contention statistics.
+ */
+
+void
+_cupsThreadGetLockStats(
+    _cups_lockstats_t *stats)		/* O - Lock statistics */
+{
+  memset(stats, 0, sizeof(_cups_lockstats_t));
+}
+
+
+/*
+ * '_cupsThreadSetLockStats()' - Enable or disable lock contention statistics.
+ */
+
+void
+_cupsThreadSetLockStats(int enable)	/* I - 1 to enable, 0 to disable */
+{
+  (void)enable;
+}
+
+
 /*
  * '_cupsThreadWait()' - Wait for a thread to exit.
  */
@@ -536,6 +665,29 @@ _cupsThreadDetach(_cups_thread_t thread)/* I - Thread ID */
 }
 
 
+/*
+ * '_cupsThreadGetLockStats()' - Get lock contention statistics.
+ */
+
+void
+_cupsThreadGetLockStats(
+    _cups_lockstats_t *stats)		/* O - Lock statistics */
+{
+  memset(stats, 0, sizeof(_cups_lockstats_t));
+}
+
+
+/*
+ * '_cupsThreadSetLockStats()' - Enable or disable lock contention statistics.
+ */
+
+void
+_cupsThreadSetLockStats(int enable)	/* I - 1 to enable, 0 to disable */
+{
+  (void)enable;
+}
+
+
 /*
  * '_cupsThreadWait()' - Wait for a thread to exit.
  */
@@ -17,6 +17,30 @@
 #include <sys/stat.h>
 
 
+/*
+ * Local constants...
+ */
+
+#define HTTP_GNUTLS_MAX_CREDS	32	/* Maximum cached server credentials */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct _http_gnutls_creds_s	/**** Cached server credentials ****/
+{
+  gnutls_certificate_credentials_t creds;
+					/* Credentials (must be first) */
+  char			crtfile[1024],	/* Certificate file */
+			keyfile[1024];	/* Private key file */
+  time_t		crtmtime,	/* Modification time of certificate */
+			keymtime;	/* Modification time of private key */
+  int			users,		/* Number of connections using them */
+			stale;		/* Files have changed? */
+} _http_gnutls_creds_t;
+
+
 /*
  * Local globals...
  */
@@ -25,7 +49,15 @@ static int		tls_auto_create = 0;
 					/* Auto-create self-signed certs? */
 static char		*tls_common_name = NULL;
 					/* Default common name */
+static _http_gnutls_creds_t *tls_creds[HTTP_GNUTLS_MAX_CREDS];
+					/* Cached server credentials */
+static int		tls_num_creds = 0;
+					/* Number of cached server credentials */
 static gnutls_x509_crl_t tls_crl = NULL;/* Certificate revocation list */
+static time_t		tls_crl_mtime = 0;
+					/* Modification time of CRL file */
+static off_t		tls_crl_size = 0;
+					/* Size of CRL file */
 static char		*tls_keypath = NULL;
 					/* Server cert keychain path */
 static _cups_mutex_t	tls_mutex = _CUPS_MUTEX_INITIALIZER;
@@ -33,6 +65,8 @@ static _cups_mutex_t	tls_mutex = _CUPS_MUTEX_INITIALIZER;
 static int		tls_options = -1,/* Options for TLS connections */
 			tls_min_version = _HTTP_TLS_1_0,
 			tls_max_version = _HTTP_TLS_MAX;
+static gnutls_datum_t	tls_ticket_key = { NULL, 0 };
+					/* Session ticket master key */
 
 
 /*
@@ -41,9 +75,15 @@ static int		tls_options = -1,/* Options for TLS connections */
 
 static gnutls_x509_crt_t http_gnutls_create_credential(http_credential_t *credential);
 static const char	*http_gnutls_default_path(char *buffer, size_t bufsize);
+static gnutls_certificate_credentials_t *http_gnutls_get_creds(const char *crtfile, const char *keyfile, int *status);
 static void		http_gnutls_load_crl(void);
 static const char	*http_gnutls_make_path(char *buffer, size_t bufsize, const char *dirname, const char *filename, const char *ext);
 static ssize_t		http_gnutls_read(gnutls_transport_ptr_t ptr, void *data, size_t length);
+static void		http_gnutls_release_creds(gnutls_certificate_credentials_t *credentials);
+static void		http_gnutls_resume(http_t *http);
+#ifdef HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION
+static int		http_gnutls_wait(gnutls_transport_ptr_t ptr, unsigned int ms);
+#endif /* HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION */
 static ssize_t		http_gnutls_write(gnutls_transport_ptr_t ptr, const void *data, size_t length);
 
 
@@ -469,10 +509,9 @@ httpCredentialsGetTrust(
   }
 
   if (cg->any_root < 0)
-  {
     _cupsSetDefaults();
-    http_gnutls_load_crl();
-  }
+
+  http_gnutls_load_crl();
 
  /*
   * Look this common name up in the default keychains...
@@ -972,6 +1011,122 @@ http_gnutls_default_path(char   *buffer,/* I - Path buffer */
 }
 
 
+/*
+ * 'http_gnutls_get_creds()' - Get server credentials for a certificate and key.
+ *
+ * Parsed credentials are shared by all connections using the same files and
+ * are reloaded when either file changes.  Release them with
+ * http_gnutls_release_creds().
+ */
+
+static gnutls_certificate_credentials_t *	/* O - Credentials or `NULL` on error */
+http_gnutls_get_creds(
+    const char *crtfile,		/* I - Certificate file */
+    const char *keyfile,		/* I - Private key file */
+    int        *status)			/* O - GNU TLS status */
+{
+  int			i;		/* Looping var */
+  _http_gnutls_creds_t	*creds;		/* Current credentials */
+  struct stat		crtinfo,	/* Certificate file information */
+			keyinfo;	/* Private key file information */
+
+
+  if (stat(crtfile, &crtinfo) || stat(keyfile, &keyinfo))
+  {
+    *status = GNUTLS_E_FILE_ERROR;
+    return (NULL);
+  }
+
+  _cupsMutexLock(&tls_mutex);
+
+  for (i = 0; i < tls_num_creds; i ++)
+  {
+    creds = tls_creds[i];
+
+    if (creds->stale || strcmp(creds->crtfile, crtfile) || strcmp(creds->keyfile, keyfile))
+      continue;
+
+    if (creds->crtmtime == crtinfo.st_mtime && creds->keymtime == keyinfo.st_mtime)
+    {
+      creds->users ++;
+
+      _cupsMutexUnlock(&tls_mutex);
+
+      *status = 0;
+      return (&creds->creds);
+    }
+
+   /*
+    * Files have changed, free the old credentials once nobody uses them...
+    */
+
+    creds->stale = 1;
+  }
+
+ /*
+  * Purge stale credentials and make room for new ones...
+  */
+
+  for (i = 0; i < tls_num_creds;)
+  {
+    creds = tls_creds[i];
+
+    if (!creds->users && (creds->stale || tls_num_creds >= HTTP_GNUTLS_MAX_CREDS))
+    {
+      gnutls_certificate_free_credentials(creds->creds);
+      free(creds);
+
+      tls_num_creds --;
+      if (i < tls_num_creds)
+        memmove(tls_creds + i, tls_creds + i + 1, (size_t)(tls_num_creds - i) * sizeof(_http_gnutls_creds_t *));
+    }
+    else
+      i ++;
+  }
+
+ /*
+  * Load the certificate and key...
+  */
+
+  if ((creds = (_http_gnutls_creds_t *)calloc(1, sizeof(_http_gnutls_creds_t))) == NULL)
+  {
+    _cupsMutexUnlock(&tls_mutex);
+
+    *status = GNUTLS_E_MEMORY_ERROR;
+    return (NULL);
+  }
+
+  gnutls_certificate_allocate_credentials(&creds->creds);
+
+  if ((*status = gnutls_certificate_set_x509_key_file(creds->creds, crtfile, keyfile, GNUTLS_X509_FMT_PEM)) != 0)
+  {
+    _cupsMutexUnlock(&tls_mutex);
+
+    gnutls_certificate_free_credentials(creds->creds);
+    free(creds);
+    return (NULL);
+  }
+
+  strlcpy(creds->crtfile, crtfile, sizeof(creds->crtfile));
+  strlcpy(creds->keyfile, keyfile, sizeof(creds->keyfile));
+  creds->crtmtime = crtinfo.st_mtime;
+  creds->keymtime = keyinfo.st_mtime;
+  creds->users    = 1;
+
+ /*
+  * When every cache slot is in use the credentials are not cached and are
+  * freed like client credentials...
+  */
+
+  if (tls_num_creds < HTTP_GNUTLS_MAX_CREDS)
+    tls_creds[tls_num_creds ++] = creds;
+
+  _cupsMutexUnlock(&tls_mutex);
+
+  return (&creds->creds);
+}
+
+
 /*
  * 'http_gnutls_load_crl()' - Load the certificate revocation list, if any.
  */
@@ -979,13 +1134,43 @@ http_gnutls_default_path(char   *buffer,/* I - Path buffer */
 static void
 http_gnutls_load_crl(void)
 {
+  char		filename[1024];		/* site.crl */
+  struct stat	fileinfo;		/* CRL file information */
+
+
+  http_gnutls_make_path(filename, sizeof(filename), CUPS_SERVERROOT, "site", "crl");
+
+  if (stat(filename, &fileinfo))
+  {
+    fileinfo.st_mtime = 0;
+    fileinfo.st_size  = 0;
+  }
+
   _cupsMutexLock(&tls_mutex);
 
+  if (tls_crl && fileinfo.st_mtime == tls_crl_mtime && fileinfo.st_size == tls_crl_size)
+  {
+   /*
+    * CRL has not changed since we loaded it...
+    */
+
+    _cupsMutexUnlock(&tls_mutex);
+    return;
+  }
+
+  if (tls_crl)
+  {
+    gnutls_x509_crl_deinit(tls_crl);
+    tls_crl = NULL;
+  }
+
+  tls_crl_mtime = fileinfo.st_mtime;
+  tls_crl_size  = fileinfo.st_size;
+
   if (!gnutls_x509_crl_init(&tls_crl))
   {
     cups_file_t		*fp;		/* CRL file */
-    char		filename[1024],	/* site.crl */
-			line[256];	/* Base64-encoded line */
+    char		line[256];	/* Base64-encoded line */
     unsigned char	*data = NULL;	/* Buffer for cert data */
     size_t		alloc_data = 0,	/* Bytes allocated */
 			num_data = 0;	/* Bytes used */
@@ -993,8 +1178,6 @@ http_gnutls_load_crl(void)
     gnutls_datum_t	datum;		/* Data record */
 
 
-    http_gnutls_make_path(filename, sizeof(filename), CUPS_SERVERROOT, "site", "crl");
-
     if ((fp = cupsFileOpen(filename, "r")) != NULL)
     {
       while (cupsFileGets(fp, line, sizeof(line)))
@@ -1123,7 +1306,19 @@ http_gnutls_read(
 
   http = (http_t *)ptr;
 
-  if (!http->blocking || http->timeout_value > 0.0)
+  if (http->tls_handshake)
+  {
+   /*
+    * Non-blocking handshake, return to the caller if nothing is available...
+    */
+
+    if (!_httpWait(http, 0, 0))
+    {
+      errno = EAGAIN;
+      return (-1);
+    }
+  }
+  else if (!http->blocking || http->timeout_value > 0.0)
   {
    /*
     * Make sure we have data before we read...
@@ -1145,6 +1340,125 @@ http_gnutls_read(
 }
 
 
+/*
+ * 'http_gnutls_release_creds()' - Release credentials used by a connection.
+ */
+
+static void
+http_gnutls_release_creds(
+    gnutls_certificate_credentials_t *credentials)
+					/* I - Credentials */
+{
+  int			i;		/* Looping var */
+  _http_gnutls_creds_t	*creds;		/* Current credentials */
+
+
+  if (!credentials)
+    return;
+
+  _cupsMutexLock(&tls_mutex);
+
+  for (i = 0; i < tls_num_creds; i ++)
+  {
+    creds = tls_creds[i];
+
+    if (&creds->creds != credentials)
+      continue;
+
+    creds->users --;
+
+    if (creds->stale && !creds->users)
+    {
+      gnutls_certificate_free_credentials(creds->creds);
+      free(creds);
+
+      tls_num_creds --;
+      if (i < tls_num_creds)
+        memmove(tls_creds + i, tls_creds + i + 1, (size_t)(tls_num_creds - i) * sizeof(_http_gnutls_creds_t *));
+    }
+
+    _cupsMutexUnlock(&tls_mutex);
+    return;
+  }
+
+  _cupsMutexUnlock(&tls_mutex);
+
+ /*
+  * Not cached, free them now...
+  */
+
+  gnutls_certificate_free_credentials(*credentials);
+  free(credentials);
+}
+
+
+/*
+ * 'http_gnutls_resume()' - Set up TLS session resumption for a connection.
+ *
+ * Servers issue session tickets using a master key that is shared by all
+ * connections.  GnuTLS derives the actual ticket encryption keys from it and
+ * rotates them on its own, accepting tickets made with the previous key for
+ * a while.  Clients offer the session saved by the last @code _httpTLSStop@
+ * call on the same connection.
+ */
+
+static void
+http_gnutls_resume(http_t *http)	/* I - HTTP connection */
+{
+  int	status;				/* Status of call */
+
+
+  if (http->mode == _HTTP_MODE_SERVER)
+  {
+    _cupsMutexLock(&tls_mutex);
+
+    if (!tls_ticket_key.data)
+    {
+      if ((status = gnutls_session_ticket_key_generate(&tls_ticket_key)) == GNUTLS_E_SUCCESS)
+        DEBUG_puts("4http_gnutls_resume: New session ticket key.");
+      else
+        DEBUG_printf(("4http_gnutls_resume: Unable to create session ticket key: %s", gnutls_strerror(status)));
+    }
+
+    if (tls_ticket_key.data && (status = gnutls_session_ticket_enable_server(http->tls, &tls_ticket_key)) != GNUTLS_E_SUCCESS)
+      DEBUG_printf(("4http_gnutls_resume: Unable to enable session tickets: %s", gnutls_strerror(status)));
+
+    _cupsMutexUnlock(&tls_mutex);
+  }
+  else if (http->tls_session)
+  {
+    if ((status = gnutls_session_set_data(http->tls, http->tls_session, http->tls_session_size)) != GNUTLS_E_SUCCESS)
+      DEBUG_printf(("4http_gnutls_resume: Unable to set session data: %s", gnutls_strerror(status)));
+  }
+}
+
+
+#ifdef HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION
+/*
+ * 'http_gnutls_wait()' - Pull timeout function for the GNU TLS library.
+ */
+
+static int				/* O - 1 if data is available, 0 otherwise */
+http_gnutls_wait(
+    gnutls_transport_ptr_t ptr,		/* I - Connection to server */
+    unsigned int           ms)		/* I - Timeout in milliseconds */
+{
+  http_t	*http = (http_t *)ptr;	/* HTTP connection */
+
+
+ /*
+  * Don't wait during a non-blocking handshake - http_gnutls_read reports
+  * EAGAIN when there is nothing to read...
+  */
+
+  if (http->tls_handshake)
+    return (1);
+
+  return (httpWait(http, (int)ms));
+}
+#endif /* HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION */
+
+
 /*
  * 'http_gnutls_write()' - Write function for the GNU TLS library.
  */
@@ -1167,6 +1481,61 @@ http_gnutls_write(
 }
 
 
+/*
+ * '_httpTLSHandshake()' - Start or continue a non-blocking TLS handshake.
+ *
+ * The first call sets up TLS on the connection.  Each call then processes
+ * whatever handshake data is available without waiting for more, so servers
+ * can drive many handshakes from their own select loop.
+ */
+
+int					/* O - 1 when done, 0 if more data is needed, -1 on error */
+_httpTLSHandshake(http_t *http)		/* I - HTTP connection */
+{
+  int	status;				/* Status of handshake */
+
+
+  DEBUG_printf(("3_httpTLSHandshake(http=%p)", http));
+
+  if (!http->tls)
+  {
+    http->tls_handshake = 1;
+
+    if (_httpTLSStart(http))
+    {
+      http->tls_handshake = 0;
+      return (-1);
+    }
+  }
+
+  if ((status = gnutls_handshake(http->tls)) == GNUTLS_E_SUCCESS)
+  {
+    http->tls_handshake = 0;
+    return (1);
+  }
+
+  DEBUG_printf(("4_httpTLSHandshake: gnutls_handshake returned %d (%s)", status, gnutls_strerror(status)));
+
+  if (!gnutls_error_is_fatal(status))
+    return (0);
+
+  http->error  = EIO;
+  http->status = HTTP_STATUS_ERROR;
+
+  _cupsSetError(IPP_STATUS_ERROR_CUPS_PKI, gnutls_strerror(status), 0);
+
+  gnutls_deinit(http->tls);
+  http->tls = NULL;
+
+  http_gnutls_release_creds(http->tls_credentials);
+  http->tls_credentials = NULL;
+
+  http->tls_handshake = 0;
+
+  return (-1);
+}
+
+
 /*
  * '_httpTLSInitialize()' - Initialize the TLS stack.
  */
@@ -1301,20 +1670,30 @@ _httpTLSStart(http_t *http)		/* I - Connection to server */
     return (-1);
   }
 
-  credentials = (gnutls_certificate_credentials_t *)
-                    malloc(sizeof(gnutls_certificate_credentials_t));
-  if (credentials == NULL)
+  if (http->mode == _HTTP_MODE_CLIENT)
   {
-    DEBUG_printf(("8_httpStartTLS: Unable to allocate credentials: %s",
-                  strerror(errno)));
-    http->error  = errno;
-    http->status = HTTP_STATUS_ERROR;
-    _cupsSetHTTPError(HTTP_STATUS_ERROR);
+   /*
+    * Clients get their own credentials, servers use the shared cache below...
+    */
 
-    return (-1);
+    credentials = (gnutls_certificate_credentials_t *)
+		      malloc(sizeof(gnutls_certificate_credentials_t));
+    if (credentials == NULL)
+    {
+      DEBUG_printf(("8_httpStartTLS: Unable to allocate credentials: %s",
+		    strerror(errno)));
+      http->error  = errno;
+      http->status = HTTP_STATUS_ERROR;
+      _cupsSetHTTPError(HTTP_STATUS_ERROR);
+
+      return (-1);
+    }
+
+    gnutls_certificate_allocate_credentials(credentials);
   }
+  else
+    credentials = NULL;
 
-  gnutls_certificate_allocate_credentials(credentials);
   status = gnutls_init(&http->tls, http->mode == _HTTP_MODE_CLIENT ? GNUTLS_CLIENT : GNUTLS_SERVER);
   if (!status)
     status = gnutls_set_default_priority(http->tls);
@@ -1328,8 +1707,7 @@ _httpTLSStart(http_t *http)		/* I - Connection to server */
     _cupsSetError(IPP_STATUS_ERROR_CUPS_PKI, gnutls_strerror(status), 0);
 
     gnutls_deinit(http->tls);
-    gnutls_certificate_free_credentials(*credentials);
-    free(credentials);
+    http_gnutls_release_creds(credentials);
     http->tls = NULL;
 
     return (-1);
@@ -1517,7 +1895,7 @@ _httpTLSStart(http_t *http)		/* I - Connection to server */
     DEBUG_printf(("4_httpTLSStart: Using certificate \"%s\" and private key \"%s\".", crtfile, keyfile));
 
     if (!status)
-      status = gnutls_certificate_set_x509_key_file(*credentials, crtfile, keyfile, GNUTLS_X509_FMT_PEM);
+      credentials = http_gnutls_get_creds(crtfile, keyfile, &status);
   }
 
   if (!status)
@@ -1532,8 +1910,7 @@ _httpTLSStart(http_t *http)		/* I - Connection to server */
     _cupsSetError(IPP_STATUS_ERROR_CUPS_PKI, gnutls_strerror(status), 0);
 
     gnutls_deinit(http->tls);
-    gnutls_certificate_free_credentials(*credentials);
-    free(credentials);
+    http_gnutls_release_creds(credentials);
     http->tls = NULL;
 
     return (-1);
@@ -1597,13 +1974,43 @@ _httpTLSStart(http_t *http)		/* I - Connection to server */
   gnutls_priority_deinit(priority);
 #endif /* HAVE_GNUTLS_PRIORITY_SET_DIRECT */
 
+#ifdef HAVE_GNUTLS_ALPN_SET_PROTOCOLS
+ /*
+  * Negotiate the application protocol so that peers can tell which HTTP
+  * versions we speak.  Only HTTP/1.1 is offered: HTTP/2 framing, HPACK and
+  * stream multiplexing are not implemented by the http_t API or by cupsd's
+  * client state machine, so a peer offering "h2" gets an explicit "http/1.1"
+  * instead.  Add "h2" to this list once HTTP/2 is supported...
+  */
+
+  gnutls_datum_t alpn;			/* Application protocol */
+
+  alpn.data = (unsigned char *)"http/1.1";
+  alpn.size = 8;
+
+  gnutls_alpn_set_protocols(http->tls, &alpn, 1, 0);
+#endif /* HAVE_GNUTLS_ALPN_SET_PROTOCOLS */
+
+  http_gnutls_resume(http);
+
   gnutls_transport_set_ptr(http->tls, (gnutls_transport_ptr_t)http);
   gnutls_transport_set_pull_function(http->tls, http_gnutls_read);
 #ifdef HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION
-  gnutls_transport_set_pull_timeout_function(http->tls, (gnutls_pull_timeout_func)httpWait);
+  gnutls_transport_set_pull_timeout_function(http->tls, http_gnutls_wait);
 #endif /* HAVE_GNUTLS_TRANSPORT_SET_PULL_TIMEOUT_FUNCTION */
   gnutls_transport_set_push_function(http->tls, http_gnutls_write);
 
+  if (http->tls_handshake)
+  {
+   /*
+    * Non-blocking handshake, _httpTLSHandshake does the rest...
+    */
+
+    http->tls_credentials = credentials;
+
+    return (0);
+  }
+
  /*
   * Enforce a minimum timeout of 10 seconds for the TLS handshake...
   */
@@ -1635,8 +2042,7 @@ _httpTLSStart(http_t *http)		/* I - Connection to server */
       _cupsSetError(IPP_STATUS_ERROR_CUPS_PKI, gnutls_strerror(status), 0);
 
       gnutls_deinit(http->tls);
-      gnutls_certificate_free_credentials(*credentials);
-      free(credentials);
+      http_gnutls_release_creds(credentials);
       http->tls = NULL;
 
       httpSetTimeout(http, old_timeout, old_cb, old_data);
@@ -1667,6 +2073,29 @@ _httpTLSStop(http_t *http)		/* I - Connection to server */
   int	error;				/* Error code */
 
 
+  if (http->mode == _HTTP_MODE_CLIENT)
+  {
+   /*
+    * Save the session so that the next connection can resume it...
+    */
+
+    gnutls_datum_t	data;		/* Session data */
+
+    if (gnutls_session_get_data2(http->tls, &data) == GNUTLS_E_SUCCESS)
+    {
+      if (http->tls_session)
+        free(http->tls_session);
+
+      if ((http->tls_session = malloc(data.size)) != NULL)
+      {
+        memcpy(http->tls_session, data.data, data.size);
+        http->tls_session_size = data.size;
+      }
+
+      gnutls_free(data.data);
+    }
+  }
+
   error = gnutls_bye(http->tls, http->mode == _HTTP_MODE_CLIENT ? GNUTLS_SHUT_RDWR : GNUTLS_SHUT_WR);
   if (error != GNUTLS_E_SUCCESS)
     _cupsSetError(IPP_STATUS_ERROR_INTERNAL, gnutls_strerror(errno), 0);
@@ -1676,8 +2105,7 @@ _httpTLSStop(http_t *http)		/* I - Connection to server */
 
   if (http->tls_credentials)
   {
-    gnutls_certificate_free_credentials(*(http->tls_credentials));
-    free(http->tls_credentials);
+    http_gnutls_release_creds(http->tls_credentials);
     http->tls_credentials = NULL;
   }
 }
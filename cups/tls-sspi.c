@@ -662,6 +662,19 @@ cleanup:
 }
 
 
+/*
+ * '_httpTLSHandshake()' - Start or continue a non-blocking TLS handshake.
+ *
+ * The handshake is done synchronously with this TLS implementation.
+ */
+
+int					/* O - 1 when done, 0 if more data is needed, -1 on error */
+_httpTLSHandshake(http_t *http)		/* I - HTTP connection */
+{
+  return (_httpTLSStart(http) ? -1 : 1);
+}
+
+
 /*
  * '_httpTLSInitialize()' - Initialize the TLS stack.
  */
@@ -14,10 +14,16 @@
 #include "cups-private.h"
 #include "debug-internal.h"
 #include <limits.h>
+#include <stdint.h>
 #include <time.h>
 #ifdef HAVE_ICONV_H
 #  include <iconv.h>
 #endif /* HAVE_ICONV_H */
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif /* __SSE2__ */
 
 
 /*
@@ -36,6 +42,14 @@ static cups_encoding_t	map_encoding = CUPS_AUTO_ENCODING;
 #endif /* HAVE_ICONV_H */
 
 
+/*
+ * Local functions...
+ */
+
+static size_t	cups_ascii_length(const cups_utf8_t *s, size_t slen, int printable);
+static size_t	cups_utf8_decode(const cups_utf8_t *s, const cups_utf8_t *end, cups_utf32_t *ch);
+
+
 /*
  * '_cupsCharmapFlush()' - Flush all character set maps out of cache.
  */
@@ -61,6 +75,36 @@ _cupsCharmapFlush(void)
 }
 
 
+/*
+ * '_cupsUTF8ASCIILength()' - Return the length of the US-ASCII prefix of a
+ *                            string.
+ */
+
+size_t					/* O - Number of US-ASCII bytes */
+_cupsUTF8ASCIILength(
+    const cups_utf8_t *s,		/* I - String */
+    size_t            slen)		/* I - Length of string */
+{
+  return (cups_ascii_length(s, slen, 0));
+}
+
+
+/*
+ * '_cupsUTF8PrintableLength()' - Return the length of the printable US-ASCII
+ *                                prefix of a string.
+ *
+ * Printable characters are space (0x20) through tilde (0x7e).
+ */
+
+size_t					/* O - Number of printable bytes */
+_cupsUTF8PrintableLength(
+    const cups_utf8_t *s,		/* I - String */
+    size_t            slen)		/* I - Length of string */
+{
+  return (cups_ascii_length(s, slen, 1));
+}
+
+
 /*
  * 'cupsCharsetToUTF8()' - Convert legacy character set to UTF-8.
  */
@@ -115,12 +159,30 @@ cupsCharsetToUTF8(
   {
     int		ch;			/* Character from string */
     cups_utf8_t	*destend;		/* End of UTF-8 buffer */
+    const char	*srcend;		/* End of source string */
+    size_t	count;			/* Number of US-ASCII characters */
 
 
     destend = dest + maxout - 2;
+    srcend  = src + strlen(src);
 
-    while (*src && destptr < destend)
+    while (src < srcend && destptr < destend)
     {
+      if (!(*src & 128))
+      {
+       /*
+        * Copy runs of US-ASCII characters as-is...
+	*/
+
+        if ((count = _cupsUTF8ASCIILength((const cups_utf8_t *)src, (size_t)(srcend - src))) > (size_t)(destend - destptr))
+          count = (size_t)(destend - destptr);
+
+        memcpy(destptr, src, count);
+        destptr += count;
+        src     += count;
+        continue;
+      }
+
       ch = *src++ & 255;
 
       if (ch & 128)
@@ -237,12 +299,30 @@ cupsUTF8ToCharset(
     int		ch,			/* Character from string */
 		maxch;			/* Maximum character for charset */
     char	*destend;		/* End of ISO-8859-1 buffer */
+    const cups_utf8_t *srcend;		/* End of source string */
+    size_t	count;			/* Number of US-ASCII characters */
 
     maxch   = encoding == CUPS_ISO8859_1 ? 256 : 128;
     destend = dest + maxout - 1;
+    srcend  = src + strlen((const char *)src);
 
-    while (*src && destptr < destend)
+    while (src < srcend && destptr < destend)
     {
+      if (!(*src & 0x80))
+      {
+       /*
+        * Copy runs of US-ASCII characters as-is...
+	*/
+
+        if ((count = _cupsUTF8ASCIILength(src, (size_t)(srcend - src))) > (size_t)(destend - destptr))
+          count = (size_t)(destend - destptr);
+
+        memcpy(destptr, src, count);
+        destptr += count;
+        src     += count;
+        continue;
+      }
+
       ch = *src++;
 
       if ((ch & 0xe0) == 0xc0)
@@ -340,6 +420,8 @@ cupsUTF8ToUTF32(
   cups_utf8_t	ch;			/* Character value */
   cups_utf8_t	next;			/* Next character value */
   cups_utf32_t	ch32;			/* UTF-32 character value */
+  const cups_utf8_t *srcend;		/* End of source string */
+  size_t	count;			/* Number of US-ASCII characters */
 
 
  /*
@@ -362,26 +444,39 @@ cupsUTF8ToUTF32(
   * Convert input UTF-8 to output UTF-32...
   */
 
-  for (i = maxout - 1; *src && i > 0; i --)
-  {
-    ch = *src++;
+  srcend = src + strlen((const char *)src);
 
-   /*
-    * Convert UTF-8 character(s) to UTF-32 character...
-    */
-
-    if (!(ch & 0x80))
+  for (i = maxout - 1; src < srcend && i > 0; i --)
+  {
+    if (!(*src & 0x80))
     {
      /*
-      * One-octet UTF-8 <= 127 (US-ASCII)...
+      * Runs of one-octet UTF-8 <= 127 (US-ASCII)...
       */
 
-      *dest++ = ch;
+      if ((count = _cupsUTF8ASCIILength(src, (size_t)(srcend - src))) > (size_t)i)
+        count = (size_t)i;
+
+      DEBUG_printf(("4cupsUTF8ToUTF32: %d US-ASCII characters", (int)count));
+
+      i -= (int)count - 1;
+
+      while (count > 0)
+      {
+        *dest++ = *src++;
+        count --;
+      }
 
-      DEBUG_printf(("4cupsUTF8ToUTF32: %02x => %08X", src[-1], ch));
       continue;
     }
-    else if ((ch & 0xe0) == 0xc0)
+
+    ch = *src++;
+
+   /*
+    * Convert UTF-8 character(s) to UTF-32 character...
+    */
+
+    if ((ch & 0xe0) == 0xc0)
     {
      /*
       * Two-octet UTF-8 <= 2047 (Latin-x)...
@@ -703,3 +798,256 @@ cupsUTF32ToUTF8(
 
   return ((int)(dest - start));
 }
+
+
+/*
+ * 'cupsUTF8ToUTF32Buffer()' - Convert a buffer of UTF-8 to UTF-32.
+ *
+ * Unlike @link cupsUTF8ToUTF32@, the source buffer does not need to be
+ * nul-terminated and the destination buffer is not nul-terminated, so large
+ * blocks of text can be converted at once.  The whole buffer must be valid,
+ * shortest form UTF-8; use @link cupsUTF8Validate@ to find the end of the
+ * valid data in a partial buffer.
+ *
+ * @since CUPS 2.4@
+ */
+
+ssize_t					/* O - Number of characters or -1 on error */
+cupsUTF8ToUTF32Buffer(
+    cups_utf32_t      *dest,		/* O - Target buffer */
+    size_t            maxout,		/* I - Size of target buffer in characters */
+    const cups_utf8_t *src,		/* I - Source buffer */
+    size_t            srclen)		/* I - Length of source buffer in bytes */
+{
+  cups_utf32_t		*destptr,	/* Pointer into target buffer */
+			*destend;	/* End of target buffer */
+  const cups_utf8_t	*srcend;	/* End of source buffer */
+  size_t		count;		/* Number of bytes */
+
+
+  DEBUG_printf(("2cupsUTF8ToUTF32Buffer(dest=%p, maxout=" CUPS_LLFMT ", src=%p, srclen=" CUPS_LLFMT ")", (void *)dest, CUPS_LLCAST maxout, (void *)src, CUPS_LLCAST srclen));
+
+  if (!dest || (!src && srclen > 0))
+  {
+    DEBUG_puts("3cupsUTF8ToUTF32Buffer: Returning -1 (bad arguments)");
+
+    return (-1);
+  }
+
+  for (destptr = dest, destend = dest + maxout, srcend = src + srclen; src < srcend; destptr ++)
+  {
+    if (destptr >= destend)
+    {
+      DEBUG_puts("3cupsUTF8ToUTF32Buffer: Returning -1 (target buffer too small)");
+
+      return (-1);
+    }
+
+    if (!(*src & 0x80))
+    {
+     /*
+      * Widen runs of US-ASCII characters...
+      */
+
+      if ((count = _cupsUTF8ASCIILength(src, (size_t)(srcend - src))) > (size_t)(destend - destptr))
+        count = (size_t)(destend - destptr);
+
+      while (count > 1)
+      {
+        *destptr++ = *src++;
+        count --;
+      }
+
+      *destptr = *src++;
+    }
+    else if ((count = cups_utf8_decode(src, srcend, destptr)) > 0)
+    {
+      src += count;
+    }
+    else
+    {
+      DEBUG_puts("3cupsUTF8ToUTF32Buffer: Returning -1 (bad UTF-8 sequence)");
+
+      return (-1);
+    }
+  }
+
+  DEBUG_printf(("3cupsUTF8ToUTF32Buffer: Returning %d characters", (int)(destptr - dest)));
+
+  return ((ssize_t)(destptr - dest));
+}
+
+
+/*
+ * 'cupsUTF8Validate()' - Validate a buffer of UTF-8.
+ *
+ * This function returns the number of bytes at the start of the buffer that
+ * are complete, shortest form UTF-8 sequences for Unicode scalar values,
+ * which is "srclen" when the whole buffer is valid.  Nul bytes are valid.
+ *
+ * @since CUPS 2.4@
+ */
+
+size_t					/* O - Number of valid bytes */
+cupsUTF8Validate(
+    const cups_utf8_t *src,		/* I - Source buffer */
+    size_t            srclen)		/* I - Length of source buffer in bytes */
+{
+  const cups_utf8_t	*srcptr,	/* Pointer into source buffer */
+			*srcend;	/* End of source buffer */
+  size_t		count;		/* Number of bytes */
+  cups_utf32_t		ch;		/* Decoded character */
+
+
+  if (!src)
+    return (0);
+
+  for (srcptr = src, srcend = src + srclen; srcptr < srcend; srcptr += count)
+  {
+    if (!(*srcptr & 0x80))
+      count = _cupsUTF8ASCIILength(srcptr, (size_t)(srcend - srcptr));
+    else if ((count = cups_utf8_decode(srcptr, srcend, &ch)) == 0)
+      break;
+  }
+
+  return ((size_t)(srcptr - src));
+}
+
+
+/*
+ * 'cups_ascii_length()' - Return the length of the (printable) US-ASCII prefix
+ *                         of a string.
+ *
+ * Whole vectors are checked with SSE2 or NEON where available, otherwise
+ * 8 bytes at a time, and the remainder a byte at a time.
+ */
+
+static size_t				/* O - Number of bytes */
+cups_ascii_length(
+    const cups_utf8_t *s,		/* I - String */
+    size_t            slen,		/* I - Length of string */
+    int               printable)	/* I - Only allow printable characters? */
+{
+  const cups_utf8_t	*start = s,	/* Start of string */
+			*end = s + slen;/* End of string */
+
+
+#ifdef __SSE2__
+  const __m128i	space = _mm_set1_epi8(0x1f),
+					/* Characters must be > 0x1f... */
+		del = _mm_set1_epi8(0x7f);
+					/* ...and < 0x7f (signed) */
+
+  for (; (end - s) >= 16; s += 16)
+  {
+    __m128i	v = _mm_loadu_si128((const __m128i *)s);
+					/* 16 characters */
+
+    if (printable)
+    {
+      if (_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmplt_epi8(v, del))) != 0xffff)
+        break;
+    }
+    else if (_mm_movemask_epi8(v))
+      break;
+  }
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  for (; (end - s) >= 16; s += 16)
+  {
+    uint8x16_t	v = vld1q_u8(s);	/* 16 characters */
+
+    if (vmaxvq_u8(v) >= (printable ? 0x7f : 0x80) || (printable && vminvq_u8(v) < 0x20))
+      break;
+  }
+
+#else
+  for (; (end - s) >= 8; s += 8)
+  {
+    uint64_t	v;			/* 8 characters */
+
+    memcpy(&v, s, sizeof(v));
+
+    if (v & 0x8080808080808080ULL)
+      break;
+
+   /*
+    * With the high bits clear, adding 1 sets the high bit of 0x7f and
+    * subtracting 0x20 borrows into the high bit of any control character...
+    */
+
+    if (printable && ((v + 0x0101010101010101ULL) | (v - 0x2020202020202020ULL)) & 0x8080808080808080ULL)
+      break;
+  }
+#endif /* __SSE2__ */
+
+  if (printable)
+  {
+    while (s < end && *s >= ' ' && *s < 0x7f)
+      s ++;
+  }
+  else
+  {
+    while (s < end && !(*s & 0x80))
+      s ++;
+  }
+
+  return ((size_t)(s - start));
+}
+
+
+/*
+ * 'cups_utf8_decode()' - Decode a multi-byte UTF-8 sequence.
+ *
+ * Overlong sequences, UTF-16 surrogates, and characters beyond Plane 16 are
+ * rejected.
+ */
+
+static size_t				/* O - Number of bytes or 0 if invalid */
+cups_utf8_decode(
+    const cups_utf8_t *s,		/* I - Start of sequence */
+    const cups_utf8_t *end,		/* I - End of buffer */
+    cups_utf32_t      *ch)		/* O - Character */
+{
+  size_t	i,			/* Looping var */
+		count;			/* Number of bytes */
+  cups_utf32_t	minch;			/* Shortest form minimum */
+
+
+  if ((*s & 0xe0) == 0xc0)
+  {
+    count = 2;
+    minch = 0x80;
+    *ch   = *s & 0x1f;
+  }
+  else if ((*s & 0xf0) == 0xe0)
+  {
+    count = 3;
+    minch = 0x800;
+    *ch   = *s & 0x0f;
+  }
+  else if ((*s & 0xf8) == 0xf0)
+  {
+    count = 4;
+    minch = 0x10000;
+    *ch   = *s & 0x07;
+  }
+  else
+    return (0);
+
+  if ((size_t)(end - s) < count)
+    return (0);
+
+  for (i = 1; i < count; i ++)
+  {
+    if ((s[i] & 0xc0) != 0x80)
+      return (0);
+
+    *ch = (*ch << 6) | (cups_utf32_t)(s[i] & 0x3f);
+  }
+
+  if (*ch < minch || *ch > 0x10ffff || (*ch >= 0xd800 && *ch <= 0xdfff))
+    return (0);
+
+  return (count);
+}
@@ -15,6 +15,13 @@
  */
 
 #  include "language.h"
+#  include <stddef.h>
+#  include <sys/types.h>
+#  if defined(_WIN32) && !defined(__CUPS_SSIZE_T_DEFINED)
+#    define __CUPS_SSIZE_T_DEFINED
+/* Windows does not support the ssize_t type, so map it to off_t... */
+typedef off_t ssize_t;			/* @private@ */
+#  endif /* _WIN32 && !__CUPS_SSIZE_T_DEFINED */
 
 #  ifdef __cplusplus
 extern "C" {
@@ -61,6 +68,13 @@ extern int	cupsUTF32ToUTF8(cups_utf8_t *dest,
 				const cups_utf32_t *src,
 				const int maxout) _CUPS_API_1_2;
 
+/* New in CUPS 2.4 */
+extern ssize_t	cupsUTF8ToUTF32Buffer(cups_utf32_t *dest, size_t maxout,
+				      const cups_utf8_t *src,
+				      size_t srclen) _CUPS_API_2_4;
+extern size_t	cupsUTF8Validate(const cups_utf8_t *src,
+				 size_t srclen) _CUPS_API_2_4;
+
 #  ifdef __cplusplus
 }
 #  endif /* __cplusplus */
@@ -438,7 +438,7 @@ cupsSetServer(const char *server)	/* I - Server name */
 
   if (cg->http)
   {
-    httpClose(cg->http);
+    _httpPoolRelease(cg->http);
     cg->http = NULL;
   }
 }
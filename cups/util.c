@@ -425,6 +425,10 @@ cupsGetJobs2(http_t     *http,		/* I - Connection to server or @code CUPS_HTTP_D
   ipp_attribute_t *attr;		/* Current attribute */
   cups_job_t	*temp;			/* Temporary pointer */
   int		id,			/* job-id */
+		last_id,		/* Highest job-id received */
+		first,			/* first-job-id or first-index */
+		count,			/* Number of jobs in response */
+		limit,			/* limit reported by server */
 		priority,		/* job-priority */
 		size;			/* job-k-octets */
   ipp_jstate_t	state;			/* job-state */
@@ -487,184 +491,221 @@ cupsGetJobs2(http_t     *http,		/* I - Connection to server or @code CUPS_HTTP_D
     if ((http = _cupsConnect()) == NULL)
       return (-1);
 
- /*
-  * Build an IPP_GET_JOBS request, which requires the following
-  * attributes:
-  *
-  *    attributes-charset
-  *    attributes-natural-language
-  *    printer-uri
-  *    requesting-user-name
-  *    which-jobs
-  *    my-jobs
-  *    requested-attributes
-  */
+  n       = 0;
+  *jobs   = NULL;
+  first   = 0;
+  last_id = 0;
 
-  request = ippNewRequest(IPP_OP_GET_JOBS);
+  do
+  {
+   /*
+    * Build an IPP_GET_JOBS request, which requires the following
+    * attributes:
+    *
+    *    attributes-charset
+    *    attributes-natural-language
+    *    printer-uri
+    *    requesting-user-name
+    *    which-jobs
+    *    my-jobs
+    *    requested-attributes
+    *    first-job-id or first-index (when continuing a limited response)
+    */
 
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI,
-               "printer-uri", NULL, uri);
+    request = ippNewRequest(IPP_OP_GET_JOBS);
 
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-               "requesting-user-name", NULL, cupsUser());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI,
+		 "printer-uri", NULL, uri);
 
-  if (myjobs)
-    ippAddBoolean(request, IPP_TAG_OPERATION, "my-jobs", 1);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+		 "requesting-user-name", NULL, cupsUser());
 
-  if (whichjobs == CUPS_WHICHJOBS_COMPLETED)
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                 "which-jobs", NULL, "completed");
-  else if (whichjobs == CUPS_WHICHJOBS_ALL)
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                 "which-jobs", NULL, "all");
+    if (myjobs)
+      ippAddBoolean(request, IPP_TAG_OPERATION, "my-jobs", 1);
 
-  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                "requested-attributes", sizeof(attrs) / sizeof(attrs[0]),
-		NULL, attrs);
+    if (whichjobs == CUPS_WHICHJOBS_COMPLETED)
+      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+		   "which-jobs", NULL, "completed");
+    else if (whichjobs == CUPS_WHICHJOBS_ALL)
+      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+		   "which-jobs", NULL, "all");
 
- /*
-  * Do the request and get back a response...
-  */
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+		  "requested-attributes", sizeof(attrs) / sizeof(attrs[0]),
+		  NULL, attrs);
 
-  n     = 0;
-  *jobs = NULL;
+    if (first > 0)
+      ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
+                    whichjobs == CUPS_WHICHJOBS_ALL ? "first-job-id" :
+                                                      "first-index", first);
 
-  if ((response = cupsDoRequest(http, request, "/")) != NULL)
-  {
-    for (attr = response->attrs; attr; attr = attr->next)
-    {
-     /*
-      * Skip leading attributes until we hit a job...
-      */
-
-      while (attr && attr->group_tag != IPP_TAG_JOB)
-        attr = attr->next;
+   /*
+    * Do the request and get back a response...
+    */
 
-      if (!attr)
-        break;
+    count = 0;
+    limit = 0;
 
-     /*
-      * Pull the needed attributes from this job...
-      */
+    if ((response = cupsDoRequest(http, request, "/")) != NULL)
+    {
+      if ((attr = ippFindAttribute(response, "limit", IPP_TAG_INTEGER)) != NULL && ippGetGroupTag(attr) == IPP_TAG_OPERATION)
+	limit = ippGetInteger(attr, 0);
 
-      id              = 0;
-      size            = 0;
-      priority        = 50;
-      state           = IPP_JSTATE_PENDING;
-      user            = "unknown";
-      dest            = NULL;
-      format          = "application/octet-stream";
-      title           = "untitled";
-      creation_time   = 0;
-      completed_time  = 0;
-      processing_time = 0;
-
-      while (attr && attr->group_tag == IPP_TAG_JOB)
+      for (attr = response->attrs; attr; attr = attr->next)
       {
-        if (!strcmp(attr->name, "job-id") &&
-	    attr->value_tag == IPP_TAG_INTEGER)
-	  id = attr->values[0].integer;
-        else if (!strcmp(attr->name, "job-state") &&
-	         attr->value_tag == IPP_TAG_ENUM)
-	  state = (ipp_jstate_t)attr->values[0].integer;
-        else if (!strcmp(attr->name, "job-priority") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  priority = attr->values[0].integer;
-        else if (!strcmp(attr->name, "job-k-octets") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  size = attr->values[0].integer;
-        else if (!strcmp(attr->name, "time-at-completed") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  completed_time = attr->values[0].integer;
-        else if (!strcmp(attr->name, "time-at-creation") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  creation_time = attr->values[0].integer;
-        else if (!strcmp(attr->name, "time-at-processing") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  processing_time = attr->values[0].integer;
-        else if (!strcmp(attr->name, "job-printer-uri") &&
-	         attr->value_tag == IPP_TAG_URI)
-	{
-	  if ((dest = strrchr(attr->values[0].string.text, '/')) != NULL)
-	    dest ++;
-        }
-        else if (!strcmp(attr->name, "job-originating-user-name") &&
-	         attr->value_tag == IPP_TAG_NAME)
-	  user = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "document-format") &&
-	         attr->value_tag == IPP_TAG_MIMETYPE)
-	  format = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "job-name") &&
-	         (attr->value_tag == IPP_TAG_TEXT ||
-		  attr->value_tag == IPP_TAG_NAME))
-	  title = attr->values[0].string.text;
-
-        attr = attr->next;
-      }
+       /*
+	* Skip leading attributes until we hit a job...
+	*/
 
-     /*
-      * See if we have everything needed...
-      */
+	while (attr && attr->group_tag != IPP_TAG_JOB)
+	  attr = attr->next;
 
-      if (!dest || !id)
-      {
-        if (!attr)
+	if (!attr)
 	  break;
-	else
-          continue;
-      }
 
-     /*
-      * Allocate memory for the job...
-      */
+       /*
+	* Pull the needed attributes from this job...
+	*/
+
+	id              = 0;
+	size            = 0;
+	priority        = 50;
+	state           = IPP_JSTATE_PENDING;
+	user            = "unknown";
+	dest            = NULL;
+	format          = "application/octet-stream";
+	title           = "untitled";
+	creation_time   = 0;
+	completed_time  = 0;
+	processing_time = 0;
+
+	while (attr && attr->group_tag == IPP_TAG_JOB)
+	{
+	  if (!strcmp(attr->name, "job-id") &&
+	      attr->value_tag == IPP_TAG_INTEGER)
+	    id = attr->values[0].integer;
+	  else if (!strcmp(attr->name, "job-state") &&
+		   attr->value_tag == IPP_TAG_ENUM)
+	    state = (ipp_jstate_t)attr->values[0].integer;
+	  else if (!strcmp(attr->name, "job-priority") &&
+		   attr->value_tag == IPP_TAG_INTEGER)
+	    priority = attr->values[0].integer;
+	  else if (!strcmp(attr->name, "job-k-octets") &&
+		   attr->value_tag == IPP_TAG_INTEGER)
+	    size = attr->values[0].integer;
+	  else if (!strcmp(attr->name, "time-at-completed") &&
+		   attr->value_tag == IPP_TAG_INTEGER)
+	    completed_time = attr->values[0].integer;
+	  else if (!strcmp(attr->name, "time-at-creation") &&
+		   attr->value_tag == IPP_TAG_INTEGER)
+	    creation_time = attr->values[0].integer;
+	  else if (!strcmp(attr->name, "time-at-processing") &&
+		   attr->value_tag == IPP_TAG_INTEGER)
+	    processing_time = attr->values[0].integer;
+	  else if (!strcmp(attr->name, "job-printer-uri") &&
+		   attr->value_tag == IPP_TAG_URI)
+	  {
+	    if ((dest = strrchr(attr->values[0].string.text, '/')) != NULL)
+	      dest ++;
+	  }
+	  else if (!strcmp(attr->name, "job-originating-user-name") &&
+		   attr->value_tag == IPP_TAG_NAME)
+	    user = attr->values[0].string.text;
+	  else if (!strcmp(attr->name, "document-format") &&
+		   attr->value_tag == IPP_TAG_MIMETYPE)
+	    format = attr->values[0].string.text;
+	  else if (!strcmp(attr->name, "job-name") &&
+		   (attr->value_tag == IPP_TAG_TEXT ||
+		    attr->value_tag == IPP_TAG_NAME))
+	    title = attr->values[0].string.text;
+
+	  attr = attr->next;
+	}
+
+	count ++;
+
+	if (id > last_id)
+	  last_id = id;
 
-      if (n == 0)
-        temp = malloc(sizeof(cups_job_t));
-      else
-	temp = realloc(*jobs, sizeof(cups_job_t) * (size_t)(n + 1));
+       /*
+	* See if we have everything needed...
+	*/
+
+	if (!dest || !id)
+	{
+	  if (!attr)
+	    break;
+	  else
+	    continue;
+	}
 
-      if (!temp)
-      {
        /*
-        * Ran out of memory!
-        */
+	* Allocate memory for the job...
+	*/
 
-        _cupsSetError(IPP_STATUS_ERROR_INTERNAL, NULL, 0);
+	if (n == 0)
+	  temp = malloc(sizeof(cups_job_t));
+	else
+	  temp = realloc(*jobs, sizeof(cups_job_t) * (size_t)(n + 1));
 
-	cupsFreeJobs(n, *jobs);
-	*jobs = NULL;
+	if (!temp)
+	{
+	 /*
+	  * Ran out of memory!
+	  */
 
-        ippDelete(response);
+	  _cupsSetError(IPP_STATUS_ERROR_INTERNAL, NULL, 0);
 
-	return (-1);
-      }
+	  cupsFreeJobs(n, *jobs);
+	  *jobs = NULL;
 
-      *jobs = temp;
-      temp  += n;
-      n ++;
+	  ippDelete(response);
 
-     /*
-      * Copy the data over...
-      */
+	  return (-1);
+	}
 
-      temp->dest            = _cupsStrAlloc(dest);
-      temp->user            = _cupsStrAlloc(user);
-      temp->format          = _cupsStrAlloc(format);
-      temp->title           = _cupsStrAlloc(title);
-      temp->id              = id;
-      temp->priority        = priority;
-      temp->state           = state;
-      temp->size            = size;
-      temp->completed_time  = completed_time;
-      temp->creation_time   = creation_time;
-      temp->processing_time = processing_time;
-
-      if (!attr)
-        break;
+	*jobs = temp;
+	temp  += n;
+	n ++;
+
+       /*
+	* Copy the data over...
+	*/
+
+	temp->dest            = _cupsStrAlloc(dest);
+	temp->user            = _cupsStrAlloc(user);
+	temp->format          = _cupsStrAlloc(format);
+	temp->title           = _cupsStrAlloc(title);
+	temp->id              = id;
+	temp->priority        = priority;
+	temp->state           = state;
+	temp->size            = size;
+	temp->completed_time  = completed_time;
+	temp->creation_time   = creation_time;
+	temp->processing_time = processing_time;
+
+	if (!attr)
+	  break;
+      }
+
+      ippDelete(response);
     }
 
-    ippDelete(response);
+   /*
+    * The scheduler limits the size of job history responses and reports the
+    * limit it used.  Ask for the next page when the whole limit was returned,
+    * resuming after the last job ID for "all" (sorted by ID) or at the next
+    * index for "completed" (sorted by completion time)...
+    */
+
+    if (limit > 0 && count >= limit && whichjobs == CUPS_WHICHJOBS_ALL && last_id >= first)
+      first = last_id + 1;
+    else if (limit > 0 && count >= limit && whichjobs == CUPS_WHICHJOBS_COMPLETED && !myjobs)
+      first = (first > 0 ? first : 1) + count;
+    else
+      first = 0;
   }
+  while (first > 0);
 
   if (n == 0 && cg->last_error >= IPP_STATUS_ERROR_BAD_REQUEST)
     return (-1);
@@ -790,6 +831,16 @@ cupsPrintFiles2(
   _cups_globals_t *cg = _cupsGlobals();	/* Global data */
   ipp_status_t	cancel_status;		/* Status code to preserve */
   char		*cancel_message;	/* Error message to preserve */
+#ifdef SCM_RIGHTS
+  http_t	*conn;			/* Connection to server */
+  int		fd;			/* File descriptor to pass */
+  struct stat	fileinfo;		/* File information */
+  int		passed = 0;		/* Were any documents passed? */
+  ipp_t		*request,		/* Send-Document request */
+		*response;		/* Send-Document response */
+  char		resource[1024],		/* Resource for destination */
+		printer_uri[1024];	/* Printer URI */
+#endif /* SCM_RIGHTS */
 
 
   DEBUG_printf(("cupsPrintFiles2(http=%p, name=\"%s\", num_files=%d, files=%p, title=\"%s\", num_options=%d, options=%p)", (void *)http, name, num_files, (void *)files, title, num_options, (void *)options));
@@ -833,6 +884,54 @@ cupsPrintFiles2(
     else
       docname = files[i];
 
+#ifdef SCM_RIGHTS
+   /*
+    * Pass regular files to a local server over the domain socket so they are
+    * never copied through the connection.  Each passed document leaves the
+    * job open so that a server that doesn't support this rejects the request
+    * and the file is sent normally...
+    */
+
+    conn = http ? http : cg->http;
+
+    if (conn && conn->hostaddr && httpAddrFamily(conn->hostaddr) == AF_LOCAL &&
+        (fd = open(files[i], O_RDONLY | O_CLOEXEC)) >= 0)
+    {
+      response = NULL;
+
+      if (!fstat(fd, &fileinfo) && S_ISREG(fileinfo.st_mode) &&
+          fileinfo.st_size > 0 && !_httpSendFd(conn, fd) &&
+          (request = ippNewRequest(IPP_OP_SEND_DOCUMENT)) != NULL)
+      {
+	httpAssembleURIf(HTTP_URI_CODING_ALL, printer_uri, sizeof(printer_uri), "ipp", NULL, "localhost", ippPort(), "/printers/%s", name);
+	snprintf(resource, sizeof(resource), "/printers/%s", name);
+
+	ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri);
+	ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", job_id);
+	ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+	ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "document-name", NULL, docname);
+	ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format", NULL, format);
+	ippAddBoolean(request, IPP_TAG_OPERATION, "last-document", 0);
+	ippAddBoolean(request, IPP_TAG_OPERATION, "document-fd", 1);
+
+        response = cupsDoRequest(conn, request, resource);
+      }
+
+      close(fd);
+
+      conn->sendfd = -1;
+
+      if (response && cupsLastError() <= IPP_STATUS_OK_CONFLICTING)
+      {
+        ippDelete(response);
+	passed ++;
+	continue;
+      }
+
+      ippDelete(response);
+    }
+#endif /* SCM_RIGHTS */
+
     if ((fp = cupsFileOpen(files[i], "rb")) == NULL)
     {
      /*
@@ -860,7 +959,39 @@ cupsPrintFiles2(
 
       goto cancel_job;
     }
+#ifdef SCM_RIGHTS
+
+    passed = 0;
+#endif /* SCM_RIGHTS */
+  }
+
+#ifdef SCM_RIGHTS
+  if (passed)
+  {
+   /*
+    * Close the job after passing the last document...
+    */
+
+    if ((request = ippNewRequest(IPP_OP_SEND_DOCUMENT)) == NULL)
+    {
+      _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(ENOMEM), 0);
+      goto cancel_job;
+    }
+
+    httpAssembleURIf(HTTP_URI_CODING_ALL, printer_uri, sizeof(printer_uri), "ipp", NULL, "localhost", ippPort(), "/printers/%s", name);
+    snprintf(resource, sizeof(resource), "/printers/%s", name);
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri);
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", job_id);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    ippAddBoolean(request, IPP_TAG_OPERATION, "last-document", 1);
+
+    ippDelete(cupsDoRequest(http, request, resource));
+
+    if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
+      goto cancel_job;
   }
+#endif /* SCM_RIGHTS */
 
   return (job_id);
 
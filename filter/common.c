@@ -12,6 +12,7 @@
  */
 
 #include "common.h"
+#include <cups/ppd-private.h>
 #include <locale.h>
 
 
@@ -52,8 +53,7 @@ SetCommonOptions(
 
   ppd = ppdOpenFile(getenv("PPD"));
 
-  ppdMarkDefaults(ppd);
-  cupsMarkOptions(ppd, num_options, options);
+  _ppdMarkDefaultsAndOptions(ppd, num_options, options);
 
   if ((pagesize = ppdPageSize(ppd, NULL)) != NULL)
   {
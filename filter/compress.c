@@ -0,0 +1,218 @@
+/*
+ * Raster compression routines for the CUPS sample drivers.
+ *
+ * Copyright 2007-2018 by Apple Inc.
+ * Copyright 1993-2007 by Easy Software Products.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "compress.h"
+#include <string.h>
+
+
+/*
+ * Local constants...
+ *
+ * On little-endian systems with GCC-style builtins the run scanners look at
+ * 8 bytes at a time; elsewhere they fall back to a simple byte loop.
+ */
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define COMPRESS_WORDS	1
+#  define COMPRESS_ONES		0x0101010101010101ULL
+#  define COMPRESS_HIGHS	0x8080808080808080ULL
+#endif /* __GNUC__ && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ */
+
+
+/*
+ * Local functions...
+ */
+
+static size_t	compress_diff(const unsigned char *p, size_t n);
+static size_t	compress_same(const unsigned char *p, size_t n);
+
+
+/*
+ * 'PackBitsEncode()' - Compress a line using TIFF PackBits encoding.
+ *
+ * The "dst" buffer must hold at least "length + (length + 126) / 127 + 1"
+ * bytes.  A trailing single byte is always sent as its own literal run, which
+ * matches the output of the original sample drivers.
+ */
+
+size_t					/* O - Number of bytes in "dst" */
+PackBitsEncode(unsigned char       *dst,/* I - Destination buffer */
+               const unsigned char *src,/* I - Data to compress */
+	       size_t              length)
+					/* I - Number of bytes */
+{
+  const unsigned char	*end = src + length;
+					/* End of data */
+  unsigned char		*start = dst;	/* Start of destination */
+  size_t		count,		/* Count of bytes for output */
+			n;		/* Maximum count */
+
+
+  while (src < end)
+  {
+    if ((src + 1) >= end)
+    {
+     /*
+      * Single byte on the end...
+      */
+
+      *dst++ = 0x00;
+      *dst++ = *src++;
+    }
+    else if (src[0] == src[1])
+    {
+     /*
+      * Repeated sequence...
+      */
+
+      if ((n = (size_t)(end - src)) > 127)
+        n = 127;
+
+      count = compress_same(src, n);
+
+      *dst++ = (unsigned char)(257 - count);
+      *dst++ = *src;
+
+      src += count;
+    }
+    else
+    {
+     /*
+      * Non-repeated sequence, not including the last byte...
+      */
+
+      if ((n = (size_t)(end - src - 1)) > 127)
+        n = 127;
+
+      count = compress_diff(src, n);
+
+      *dst++ = (unsigned char)(count - 1);
+
+      memcpy(dst, src, count);
+      dst += count;
+      src += count;
+    }
+  }
+
+  return ((size_t)(dst - start));
+}
+
+
+/*
+ * 'RunLengthEncode()' - Compress a line using HP PCL run-length encoding.
+ *
+ * The "dst" buffer must hold at least "2 * length" bytes.
+ */
+
+size_t					/* O - Number of bytes in "dst" */
+RunLengthEncode(unsigned char       *dst,
+					/* I - Destination buffer */
+                const unsigned char *src,
+					/* I - Data to compress */
+		size_t              length)
+					/* I - Number of bytes */
+{
+  const unsigned char	*end = src + length;
+					/* End of data */
+  unsigned char		*start = dst;	/* Start of destination */
+  size_t		count,		/* Count of bytes for output */
+			n;		/* Maximum count */
+
+
+  while (src < end)
+  {
+    if ((n = (size_t)(end - src)) > 256)
+      n = 256;
+
+    count = compress_same(src, n);
+
+    *dst++ = (unsigned char)(count - 1);
+    *dst++ = *src;
+
+    src += count;
+  }
+
+  return ((size_t)(dst - start));
+}
+
+
+/*
+ * 'compress_diff()' - Find the length of a literal run.
+ *
+ * Returns the offset of the first byte after "p" that equals the byte that
+ * follows it, or "n" if there is none.  "p[n]" must be readable.
+ */
+
+static size_t				/* O - Length of run, 1 to n */
+compress_diff(const unsigned char *p,	/* I - Start of run */
+              size_t              n)	/* I - Maximum length */
+{
+  size_t	i = 1;			/* Current offset */
+
+
+#ifdef COMPRESS_WORDS
+  for (; (i + 8) <= n; i += 8)
+  {
+    unsigned long long	a, b, x;	/* Adjacent words and difference */
+
+    memcpy(&a, p + i, sizeof(a));
+    memcpy(&b, p + i + 1, sizeof(b));
+
+    x = a ^ b;
+
+    if ((x = (x - COMPRESS_ONES) & ~x & COMPRESS_HIGHS) != 0)
+      return (i + (size_t)__builtin_ctzll(x) / 8);
+  }
+#endif /* COMPRESS_WORDS */
+
+  for (; i < n; i ++)
+    if (p[i] == p[i + 1])
+      break;
+
+  return (i);
+}
+
+
+/*
+ * 'compress_same()' - Find the length of a repeated run.
+ */
+
+static size_t				/* O - Length of run, 1 to n */
+compress_same(const unsigned char *p,	/* I - Start of run */
+              size_t              n)	/* I - Maximum length */
+{
+  size_t	i = 1;			/* Current offset */
+
+
+#ifdef COMPRESS_WORDS
+  unsigned long long	pattern = COMPRESS_ONES * p[0];
+					/* Repeated byte */
+
+  for (; (i + 8) <= n; i += 8)
+  {
+    unsigned long long	x;		/* Difference */
+
+    memcpy(&x, p + i, sizeof(x));
+
+    if ((x ^= pattern) != 0)
+      return (i + (size_t)__builtin_ctzll(x) / 8);
+  }
+#endif /* COMPRESS_WORDS */
+
+  for (; i < n; i ++)
+    if (p[i] != p[0])
+      break;
+
+  return (i);
+}
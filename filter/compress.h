@@ -0,0 +1,47 @@
+/*
+ * Raster compression definitions for the CUPS sample drivers.
+ *
+ * Copyright 2007-2010 by Apple Inc.
+ * Copyright 1997-2006 by Easy Software Products.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ */
+
+#ifndef _CUPS_FILTER_COMPRESS_H_
+#  define _CUPS_FILTER_COMPRESS_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stddef.h>
+
+
+/*
+ * C++ magic...
+ */
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Prototypes...
+ */
+
+extern size_t	PackBitsEncode(unsigned char *dst, const unsigned char *src,
+		               size_t length);
+extern size_t	RunLengthEncode(unsigned char *dst, const unsigned char *src,
+		                size_t length);
+
+
+/*
+ * C++ magic...
+ */
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_CUPS_FILTER_COMPRESS_H_ */
@@ -0,0 +1,387 @@
+/*
+ * Raster compression benchmark program for the CUPS sample drivers.
+ *
+ * Copyright 2007-2016 by Apple Inc.
+ * Copyright 1997-2006 by Easy Software Products.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ *
+ * Usage:
+ *
+ *   ./compressbench [-p passes]
+ *
+ * Compresses rendered 1-bit pages with the byte-wise loops the drivers used
+ * to contain and with the shared PackBitsEncode() and RunLengthEncode()
+ * routines, checks that the output is identical, and reports the speed of
+ * each.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "compress.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+
+/*
+ * Constants...
+ */
+
+#define TEST_WIDTH	5100		/* 8.5" at 600dpi */
+#define TEST_HEIGHT	6600		/* 11" at 600dpi */
+#define TEST_BPL	((TEST_WIDTH + 7) / 8)
+#define TEST_PASSES	5
+
+
+/*
+ * Local types...
+ */
+
+typedef size_t (*bench_func_t)(unsigned char *dst, const unsigned char *src, size_t length);
+
+typedef enum bench_content_e		/**** Content patterns ****/
+{
+  BENCH_TEXT,				/* Lines of text with whitespace */
+  BENCH_HALFTONE,			/* Dithered photo */
+  BENCH_BLANK,				/* Blank page */
+  BENCH_NUM_CONTENT
+} bench_content_t;
+
+
+/*
+ * Local globals...
+ */
+
+static const char * const bench_contents[] =
+{					/* Content names */
+  "text",
+  "halftone",
+  "blank"
+};
+
+
+/*
+ * Local functions...
+ */
+
+static int	bench(const char *name, const char *content, bench_func_t ref_func, bench_func_t new_func, const unsigned char *page, int passes);
+static double	get_time(void);
+static void	make_page(unsigned char *page, bench_content_t content);
+static size_t	ref_packbits(unsigned char *dst, const unsigned char *src, size_t length);
+static size_t	ref_runlength(unsigned char *dst, const unsigned char *src, size_t length);
+static double	run(bench_func_t func, unsigned char *dst, const unsigned char *page, int passes, size_t *total);
+
+
+/*
+ * 'main()' - Benchmark the compression routines.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line args */
+     char *argv[])			/* I - Command-line arguments */
+{
+  int			i;		/* Looping var */
+  int			passes = TEST_PASSES;
+					/* Number of passes */
+  bench_content_t	content;	/* Current content */
+  unsigned char		*page;		/* Page bitmap */
+  int			status = 0;	/* Exit status */
+
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-p") && (i + 1) < argc)
+    {
+      if ((passes = atoi(argv[++ i])) < 1)
+        passes = 1;
+    }
+    else
+    {
+      puts("Usage: ./compressbench [-p passes]");
+      return (1);
+    }
+  }
+
+  if ((page = malloc(TEST_BPL * TEST_HEIGHT)) == NULL)
+  {
+    perror("Unable to allocate page");
+    return (1);
+  }
+
+  printf("%-8s  %-9s  %10s  %10s  %7s  %s\n", "Method", "Content", "Old MB/s",
+         "New MB/s", "Speedup", "Ratio");
+
+  for (content = BENCH_TEXT; content < BENCH_NUM_CONTENT; content ++)
+  {
+    make_page(page, content);
+
+    status |= bench("packbits", bench_contents[content], ref_packbits, PackBitsEncode, page, passes);
+    status |= bench("rle", bench_contents[content], ref_runlength, RunLengthEncode, page, passes);
+  }
+
+  free(page);
+
+  return (status);
+}
+
+
+/*
+ * 'bench()' - Compare one compression method against its reference.
+ */
+
+static int				/* O - 0 on success, 1 on mismatch */
+bench(const char          *name,	/* I - Method name */
+      const char          *content,	/* I - Content name */
+      bench_func_t        ref_func,	/* I - Reference function */
+      bench_func_t        new_func,	/* I - New function */
+      const unsigned char *page,	/* I - Page bitmap */
+      int                 passes)	/* I - Number of passes */
+{
+  int		y;			/* Current line */
+  unsigned char	ref[2 * TEST_BPL],	/* Reference output */
+		out[2 * TEST_BPL];	/* New output */
+  size_t	ref_len,		/* Length of reference output */
+		out_len,		/* Length of new output */
+		total;			/* Total compressed bytes */
+  double	ref_secs,		/* Reference time */
+		new_secs,		/* New time */
+		bytes;			/* Bytes per run */
+
+
+ /*
+  * Make sure the output is the same...
+  */
+
+  for (y = 0; y < TEST_HEIGHT; y ++)
+  {
+    ref_len = (ref_func)(ref, page + y * TEST_BPL, TEST_BPL);
+    out_len = (new_func)(out, page + y * TEST_BPL, TEST_BPL);
+
+    if (ref_len != out_len || memcmp(ref, out, ref_len))
+    {
+      printf("%-8s  %-9s  FAIL (line %d: %u bytes, expected %u)\n", name, content, y, (unsigned)out_len, (unsigned)ref_len);
+      return (1);
+    }
+  }
+
+ /*
+  * Time both...
+  */
+
+  ref_secs = run(ref_func, ref, page, passes, &total);
+  new_secs = run(new_func, out, page, passes, &total);
+  bytes    = (double)TEST_BPL * TEST_HEIGHT * passes / 1048576.0;
+
+  printf("%-8s  %-9s  %10.1f  %10.1f  %6.2fx  %.3f\n", name, content, bytes / ref_secs, bytes / new_secs, ref_secs / new_secs, (double)total / (TEST_BPL * TEST_HEIGHT * passes));
+
+  return (0);
+}
+
+
+/*
+ * 'get_time()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+get_time(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
+/*
+ * 'make_page()' - Render a 1-bit test page.
+ */
+
+static void
+make_page(unsigned char   *page,	/* I - Page bitmap */
+          bench_content_t content)	/* I - Content pattern */
+{
+  int		x, y;			/* Looping vars */
+  unsigned char	*line;			/* Current line */
+  static const unsigned char dither[4][4] =
+  {					/* Ordered dither matrix */
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+  };
+
+
+  memset(page, 0, TEST_BPL * TEST_HEIGHT);
+  srand(1);
+
+  for (y = 0, line = page; y < TEST_HEIGHT; y ++, line += TEST_BPL)
+  {
+    switch (content)
+    {
+      case BENCH_TEXT :
+         /*
+	  * 60 lines of 12pt text with 1" margins and ragged right edges...
+	  */
+
+          if ((y % 110) < 70 && y > 600 && y < (TEST_HEIGHT - 600))
+	  {
+	    int right = 600 + (rand() % 3600);	/* Right edge of line */
+
+            for (x = 600; x < right; x ++)
+	      if ((rand() % 5) == 0)
+	        line[x / 8] |= (unsigned char)(128 >> (x & 7));
+	  }
+          break;
+
+      case BENCH_HALFTONE :
+         /*
+	  * Dithered gradient with some noise...
+	  */
+
+          for (x = 0; x < TEST_WIDTH; x ++)
+	  {
+	    int level = (x * 16 / TEST_WIDTH + y * 4 / TEST_HEIGHT + rand() % 2) & 15;
+					/* Gray level */
+
+	    if (level > dither[y & 3][x & 3])
+	      line[x / 8] |= (unsigned char)(128 >> (x & 7));
+	  }
+          break;
+
+      default :
+          break;
+    }
+  }
+}
+
+
+/*
+ * 'ref_packbits()' - Byte-wise TIFF PackBits encoding from the drivers.
+ */
+
+static size_t				/* O - Number of bytes in "dst" */
+ref_packbits(unsigned char       *dst,	/* I - Destination buffer */
+             const unsigned char *src,	/* I - Data to compress */
+	     size_t              length)/* I - Number of bytes */
+{
+  const unsigned char	*line_ptr = src,/* Current byte pointer */
+			*line_end = src + length,
+					/* End-of-line byte pointer */
+			*start;		/* Start of compression sequence */
+  unsigned char		*comp_ptr = dst;/* Pointer into compression buffer */
+  int			count;		/* Count of bytes for output */
+
+
+  while (line_ptr < line_end)
+  {
+    if ((line_ptr + 1) >= line_end)
+    {
+      *comp_ptr++ = 0x00;
+      *comp_ptr++ = *line_ptr++;
+    }
+    else if (line_ptr[0] == line_ptr[1])
+    {
+      line_ptr ++;
+      count = 2;
+
+      while (line_ptr < (line_end - 1) &&
+             line_ptr[0] == line_ptr[1] &&
+             count < 127)
+      {
+        line_ptr ++;
+        count ++;
+      }
+
+      *comp_ptr++ = (unsigned char)(257 - count);
+      *comp_ptr++ = *line_ptr++;
+    }
+    else
+    {
+      start    = line_ptr;
+      line_ptr ++;
+      count    = 1;
+
+      while (line_ptr < (line_end - 1) &&
+             line_ptr[0] != line_ptr[1] &&
+             count < 127)
+      {
+        line_ptr ++;
+        count ++;
+      }
+
+      *comp_ptr++ = (unsigned char)(count - 1);
+
+      memcpy(comp_ptr, start, (size_t)count);
+      comp_ptr += count;
+    }
+  }
+
+  return ((size_t)(comp_ptr - dst));
+}
+
+
+/*
+ * 'ref_runlength()' - Byte-wise HP run-length encoding from the drivers.
+ */
+
+static size_t				/* O - Number of bytes in "dst" */
+ref_runlength(unsigned char       *dst,	/* I - Destination buffer */
+              const unsigned char *src,	/* I - Data to compress */
+	      size_t              length)
+					/* I - Number of bytes */
+{
+  const unsigned char	*line_ptr,	/* Current byte pointer */
+			*line_end = src + length;
+					/* End-of-line byte pointer */
+  unsigned char		*comp_ptr;	/* Pointer into compression buffer */
+  unsigned		count;		/* Count of bytes for output */
+
+
+  for (line_ptr = src, comp_ptr = dst;
+       line_ptr < line_end;
+       comp_ptr += 2, line_ptr += count)
+  {
+    for (count = 1;
+         (line_ptr + count) < line_end &&
+	     line_ptr[0] == line_ptr[count] &&
+             count < 256;
+         count ++);
+
+    comp_ptr[0] = (unsigned char)(count - 1);
+    comp_ptr[1] = line_ptr[0];
+  }
+
+  return ((size_t)(comp_ptr - dst));
+}
+
+
+/*
+ * 'run()' - Time a compression function over a page.
+ */
+
+static double				/* O - Elapsed time in seconds */
+run(bench_func_t        func,		/* I - Compression function */
+    unsigned char       *dst,		/* I - Output buffer */
+    const unsigned char *page,		/* I - Page bitmap */
+    int                 passes,		/* I - Number of passes */
+    size_t              *total)		/* O - Total compressed bytes */
+{
+  int		pass,			/* Current pass */
+		y;			/* Current line */
+  double	start;			/* Start time */
+
+
+  *total = 0;
+  start  = get_time();
+
+  for (pass = 0; pass < passes; pass ++)
+    for (y = 0; y < TEST_HEIGHT; y ++)
+      *total += (func)(dst, page + y * TEST_BPL, TEST_BPL);
+
+  return (get_time() - start);
+}
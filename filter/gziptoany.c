@@ -12,6 +12,25 @@
  */
 
 #include <cups/cups-private.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+
+/*
+ * Local constants...
+ */
+
+#define GZIPTOANY_BUFFER	65536	/* Size of copy buffer */
+#define GZIPTOANY_MEMORY	(8 * 1024 * 1024)
+					/* Largest copy spooled in memory */
+
+
+/*
+ * Local functions...
+ */
+
+static int	copy_fd(int fd);
+static int	write_data(const char *buffer, size_t bytes);
 
 
 /*
@@ -23,9 +42,18 @@ main(int  argc,				/* I - Number of command-line arguments */
      char *argv[])			/* I - Command-line arguments */
 {
   cups_file_t	*fp;			/* File */
-  char		buffer[8192];		/* Data buffer */
+  char		buffer[GZIPTOANY_BUFFER];
+					/* Data buffer */
   ssize_t	bytes;			/* Number of bytes read/written */
   int		copies;			/* Number of copies */
+  int		rawfd = -1;		/* Uncompressed print file */
+  int		spoolfd = -1;		/* Uncompressed copy in a temp file */
+  char		spoolname[1024];	/* Temporary filename */
+  char		*spool = NULL;		/* Uncompressed copy in memory */
+  size_t	spoolsize = 0,		/* Size of memory copy */
+		spoollen = 0;		/* Length of memory copy */
+  int		spooling;		/* Saving this copy for the next? */
+  int		status = 0;		/* Exit status */
 
 
  /*
@@ -66,28 +94,114 @@ main(int  argc,				/* I - Number of command-line arguments */
     return (1);
   }
 
+  cupsFileSetBufferSize(fp, GZIPTOANY_BUFFER);
+
+  if (cupsFilePeekChar(fp) != -1 &&
+      cupsFileCompression(fp) == CUPS_FILE_NONE)
+  {
+   /*
+    * Uncompressed files are copied straight from the file descriptor (the
+    * compression of a file is known once the first bytes have been read)...
+    */
+
+    rawfd = cupsFileNumber(fp);
+  }
+
  /*
-  * Copy the file to stdout...
+  * Copy the file to stdout.  Compressed files are only decompressed once;
+  * the first copy is saved in memory or a temporary file for the rest...
   */
 
-  while (copies > 0)
+  while (copies > 0 && !status)
   {
     if (!getenv("FINAL_CONTENT_TYPE"))
       fputs("PAGE: 1 1\n", stderr);
 
-    cupsFileRewind(fp);
+    if (spool)
+      status = write_data(spool, spoollen);
+    else if (spoolfd >= 0)
+      status = copy_fd(spoolfd);
+    else if (rawfd >= 0)
+      status = copy_fd(rawfd);
+    else
+    {
+      spooling = copies > 1;
+
+      if (spooling && (spool = malloc(GZIPTOANY_BUFFER)) != NULL)
+        spoolsize = GZIPTOANY_BUFFER;
+
+      cupsFileRewind(fp);
+
+      while ((bytes = cupsFileRead(fp, buffer, sizeof(buffer))) > 0)
+      {
+        if ((status = write_data(buffer, (size_t)bytes)) != 0)
+	  break;
+
+        if (!spooling)
+	  continue;
+
+        if (spool && (spoollen + (size_t)bytes) > spoolsize)
+	{
+	 /*
+	  * Grow the memory copy or move it to a temporary file...
+	  */
+
+	  char	*temp;			/* New memory copy */
+
+          if ((spoollen + (size_t)bytes) <= GZIPTOANY_MEMORY &&
+	      (temp = realloc(spool, 2 * spoolsize)) != NULL)
+	  {
+	    spool     = temp;
+	    spoolsize *= 2;
+	  }
+	  else
+	  {
+	    if ((spoolfd = cupsTempFd(spoolname, sizeof(spoolname))) >= 0)
+	    {
+	      unlink(spoolname);
+
+	      if (write(spoolfd, spool, spoollen) < (ssize_t)spoollen)
+	      {
+	        close(spoolfd);
+		spoolfd = -1;
+	      }
+	    }
+
+	    free(spool);
+	    spool    = NULL;
+	    spooling = spoolfd >= 0;
+	  }
+	}
+
+        if (spool)
+	{
+	  memcpy(spool + spoollen, buffer, (size_t)bytes);
+	  spoollen += (size_t)bytes;
+	}
+	else if (spoolfd >= 0 && write(spoolfd, buffer, (size_t)bytes) < bytes)
+	{
+	  close(spoolfd);
+	  spoolfd  = -1;
+	  spooling = 0;
+	}
+      }
 
-    while ((bytes = cupsFileRead(fp, buffer, sizeof(buffer))) > 0)
-      if (write(1, buffer, (size_t)bytes) < bytes)
+      if (!spooling)
       {
-	_cupsLangPrintFilter(stderr, "ERROR",
-			     _("Unable to write uncompressed print data: %s"),
-			     strerror(errno));
-        if (argc == 7)
-	  cupsFileClose(fp);
+       /*
+        * Could not save this copy, decompress again for the next one...
+	*/
 
-	return (1);
+        free(spool);
+	spool = NULL;
+
+	if (spoolfd >= 0)
+	{
+	  close(spoolfd);
+	  spoolfd = -1;
+	}
       }
+    }
 
     copies --;
   }
@@ -96,8 +210,110 @@ main(int  argc,				/* I - Number of command-line arguments */
   * Close the file and return...
   */
 
+  free(spool);
+
+  if (spoolfd >= 0)
+    close(spoolfd);
+
   if (argc == 7)
     cupsFileClose(fp);
 
+  return (status);
+}
+
+
+/*
+ * 'copy_fd()' - Copy an uncompressed file to stdout.
+ *
+ * On Linux the data is spliced into stdout when it is a pipe, which is how
+ * cupsd runs filters, so it never passes through this process.
+ */
+
+static int				/* O - 0 on success, 1 on error */
+copy_fd(int fd)				/* I - File to copy */
+{
+  off_t		offset = 0;		/* Offset in file */
+  ssize_t	bytes;			/* Bytes copied */
+  char		buffer[GZIPTOANY_BUFFER];
+					/* Data buffer */
+#if defined(__linux) && defined(SPLICE_F_MOVE)
+  struct stat	fileinfo;		/* File information */
+  size_t	length;			/* Bytes to splice */
+
+
+ /*
+  * Only ask for the bytes that are left - splice() reports EPIPE rather than
+  * end-of-file once the next filter has read everything and exited...
+  */
+
+  if (!fstat(fd, &fileinfo))
+  {
+    bytes = 0;
+
+    while (offset < fileinfo.st_size)
+    {
+      if ((length = (size_t)(fileinfo.st_size - offset)) > GZIPTOANY_BUFFER)
+        length = GZIPTOANY_BUFFER;
+
+      if ((bytes = splice(fd, &offset, 1, NULL, length, SPLICE_F_MOVE | SPLICE_F_MORE)) <= 0)
+        break;
+    }
+
+    if (bytes >= 0)
+      return (0);
+    else if (errno != EINVAL && errno != ENOSYS)
+    {
+      _cupsLangPrintFilter(stderr, "ERROR",
+			   _("Unable to write uncompressed print data: %s"),
+			   strerror(errno));
+      return (1);
+    }
+  }
+
+ /*
+  * stdout is not a pipe, copy the rest the usual way...
+  */
+#endif /* __linux && SPLICE_F_MOVE */
+
+  while ((bytes = pread(fd, buffer, sizeof(buffer), offset)) > 0)
+  {
+    if (write_data(buffer, (size_t)bytes))
+      return (1);
+
+    offset += bytes;
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'write_data()' - Write data to stdout.
+ */
+
+static int				/* O - 0 on success, 1 on error */
+write_data(const char *buffer,		/* I - Data to write */
+           size_t     bytes)		/* I - Number of bytes */
+{
+  ssize_t	written;		/* Bytes written */
+
+
+  while (bytes > 0)
+  {
+    if ((written = write(1, buffer, bytes)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      _cupsLangPrintFilter(stderr, "ERROR",
+			   _("Unable to write uncompressed print data: %s"),
+			   strerror(errno));
+      return (1);
+    }
+
+    buffer += written;
+    bytes  -= (size_t)written;
+  }
+
   return (0);
 }
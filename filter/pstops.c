@@ -15,10 +15,12 @@
 #include "common.h"
 #include <limits.h>
 #include <math.h>
-#include <cups/file.h>
+#include <cups/file-private.h>
 #include <cups/array.h>
 #include <cups/language-private.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 /*
@@ -76,6 +78,8 @@ typedef struct				/**** Document information ****/
   cups_array_t	*pages;			/* Pages in document */
   cups_file_t	*temp;			/* Temporary file, if any */
   char		tempfile[1024];		/* Temporary filename */
+  const char	*tempmap;		/* Mapped temporary file, if any */
+  size_t	tempsize;		/* Size of mapped temporary file */
   int		job_id;			/* Job ID */
   const char	*user,			/* User name */
 		*title;			/* Job name */
@@ -140,6 +144,8 @@ static ssize_t		copy_comments(cups_file_t *fp, pstops_doc_t *doc,
 static void		copy_dsc(cups_file_t *fp, pstops_doc_t *doc,
 			         ppd_file_t *ppd, char *line, ssize_t linelen,
 				 size_t linesize);
+static void		copy_lines(cups_file_t *fp, pstops_doc_t *doc,
+			           char *line, size_t linesize);
 static void		copy_non_dsc(cups_file_t *fp, pstops_doc_t *doc,
 			             ppd_file_t *ppd, char *line,
 				     ssize_t linelen, size_t linesize);
@@ -152,6 +158,8 @@ static ssize_t		copy_prolog(cups_file_t *fp, pstops_doc_t *doc,
 static ssize_t		copy_setup(cups_file_t *fp, pstops_doc_t *doc,
 			           ppd_file_t *ppd, char *line,
 				   ssize_t linelen, size_t linesize);
+static void		copy_temp(pstops_doc_t *doc, off_t offset,
+			          size_t length);
 static ssize_t		copy_trailer(cups_file_t *fp, pstops_doc_t *doc,
 			             ppd_file_t *ppd, int number, char *line,
 				     ssize_t linelen, size_t linesize);
@@ -164,6 +172,7 @@ static void		end_nup(pstops_doc_t *doc, int number);
 static int		include_feature(ppd_file_t *ppd, const char *line,
 			                int num_options,
 					cups_option_t **options);
+static void		open_temp(pstops_doc_t *doc);
 static char		*parse_text(const char *start, char **end, char *buffer,
 			            size_t bufsize);
 static void		set_pstops_options(pstops_doc_t *doc, ppd_file_t *ppd,
@@ -194,6 +203,7 @@ main(int  argc,				/* I - Number of command-line args */
   ppd_file_t	*ppd;			/* PPD file */
   int		num_options;		/* Number of print options */
   cups_option_t	*options;		/* Print options */
+  cups_options_t *opts;			/* Print option container */
   char		line[8192];		/* Line buffer */
   ssize_t	len;			/* Length of line buffer */
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
@@ -266,6 +276,8 @@ main(int  argc,				/* I - Number of command-line args */
     }
   }
 
+  cupsFileSetBufferSize(fp, 65536);
+
  /*
   * Read the first line to see if we have DSC comments...
   */
@@ -280,8 +292,11 @@ main(int  argc,				/* I - Number of command-line args */
   * Process command-line options...
   */
 
-  options     = NULL;
-  num_options = cupsParseOptions(argv[5], 0, &options);
+  opts = cupsOptionsNew();
+  cupsOptionsParse(opts, argv[5]);
+
+  num_options = cupsOptionsCount(opts);
+  options     = cupsOptionsGetArray(opts);
   ppd         = SetCommonOptions(num_options, options, 1);
 
   set_pstops_options(&doc, ppd, argv, num_options, options);
@@ -375,6 +390,9 @@ main(int  argc,				/* I - Number of command-line args */
   * Close files and remove the temporary file if needed...
   */
 
+  if (doc.tempmap)
+    munmap((void *)doc.tempmap, doc.tempsize);
+
   if (doc.temp)
   {
     cupsFileClose(doc.temp);
@@ -382,7 +400,7 @@ main(int  argc,				/* I - Number of command-line args */
   }
 
   ppdClose(ppd);
-  cupsFreeOptions(num_options, options);
+  cupsOptionsDelete(opts);
 
   cupsFileClose(fp);
 
@@ -911,9 +929,7 @@ copy_dsc(cups_file_t  *fp,		/* I - File to read from */
     * Reopen the temporary file for reading...
     */
 
-    cupsFileClose(doc->temp);
-
-    doc->temp = cupsFileOpen(doc->tempfile, "r");
+    open_temp(doc);
 
    /*
     * Make the copies...
@@ -970,7 +986,7 @@ copy_dsc(cups_file_t  *fp,		/* I - File to read from */
       if (!number)
       {
         pageinfo = (pstops_page_t *)cupsArrayFirst(doc->pages);
-	copy_bytes(doc->temp, 0, (size_t)pageinfo->offset);
+	copy_temp(doc, 0, (size_t)pageinfo->offset);
       }
 
      /*
@@ -1005,7 +1021,7 @@ copy_dsc(cups_file_t  *fp,		/* I - File to read from */
 		 pageinfo->bounding_box[2], pageinfo->bounding_box[3]);
 	}
 
-	copy_bytes(doc->temp, pageinfo->offset, (size_t)pageinfo->length);
+	copy_temp(doc, pageinfo->offset, (size_t)pageinfo->length);
 
 	pageinfo = doc->slow_order ? (pstops_page_t *)cupsArrayPrev(doc->pages) :
                                      (pstops_page_t *)cupsArrayNext(doc->pages);
@@ -1029,6 +1045,29 @@ copy_dsc(cups_file_t  *fp,		/* I - File to read from */
 }
 
 
+/*
+ * 'copy_lines()' - Copy lines that are not comments in bulk.
+ *
+ * Everything up to the next line starting with "%" is passed through without
+ * looking at each line.  If "doc" is NULL the lines are skipped instead.  On
+ * return, the next line still needs to be read with cupsFileGetLine().
+ */
+
+static void
+copy_lines(cups_file_t  *fp,		/* I - File to read from */
+           pstops_doc_t *doc,		/* I - Document info or NULL to skip */
+           char         *line,		/* I - Line buffer */
+	   size_t       linesize)	/* I - Size of line buffer */
+{
+  size_t	bytes;			/* Bytes of data */
+
+
+  while ((bytes = _cupsFileGetLines(fp, line, linesize, '%')) > 0)
+    if (doc)
+      doc_write(doc, line, bytes);
+}
+
+
 /*
  * 'copy_non_dsc()' - Copy a document that does not conform to the DSC.
  *
@@ -1168,9 +1207,7 @@ copy_non_dsc(cups_file_t  *fp,		/* I - File to read from */
     * Reopen the temporary file for reading...
     */
 
-    cupsFileClose(doc->temp);
-
-    doc->temp = cupsFileOpen(doc->tempfile, "r");
+    open_temp(doc);
 
    /*
     * Make the additional copies as needed...
@@ -1190,7 +1227,7 @@ copy_non_dsc(cups_file_t  *fp,		/* I - File to read from */
       puts("%%EndPageSetup");
       puts("%%BeginDocument: nondsc");
 
-      copy_bytes(doc->temp, 0, 0);
+      copy_temp(doc, 0, 0);
 
       puts("%%EndDocument");
 
@@ -1652,6 +1689,8 @@ copy_page(cups_file_t  *fp,		/* I - File to read from */
     }
     else
       doc_write(doc, line, (size_t)linelen);
+
+    copy_lines(fp, doc, line, linesize);
   }
   while ((linelen = (ssize_t)cupsFileGetLine(fp, line, linesize)) > 0);
 
@@ -1707,6 +1746,8 @@ copy_prolog(cups_file_t  *fp,		/* I - File to read from */
         break;
 
       doc_write(doc, line, (size_t)linelen);
+
+      copy_lines(fp, doc, line, linesize);
     }
 
     if (!strncmp(line, "%%EndProlog", 11))
@@ -1798,6 +1839,39 @@ copy_setup(cups_file_t  *fp,		/* I - File to read from */
 }
 
 
+/*
+ * 'copy_temp()' - Copy bytes from the temporary file to stdout.
+ *
+ * When the temporary file is mapped, the bytes are written directly from the
+ * mapping so that each additional copy or reordered page costs a single write
+ * instead of a seek and a series of buffered reads.
+ */
+
+static void
+copy_temp(pstops_doc_t *doc,		/* I - Document information */
+          off_t        offset,		/* I - Offset to page data */
+	  size_t       length)		/* I - Length of page data, 0 for all */
+{
+  if (!doc->tempmap)
+  {
+    copy_bytes(doc->temp, offset, length);
+    return;
+  }
+
+  if (offset < 0 || (size_t)offset > doc->tempsize)
+  {
+    _cupsLangPrintError("ERROR", _("Unable to see in file"));
+    return;
+  }
+
+  if (length == 0 || length > doc->tempsize - (size_t)offset)
+    length = doc->tempsize - (size_t)offset;
+
+  if (length > 0)
+    fwrite(doc->tempmap + offset, 1, length, stdout);
+}
+
+
 /*
  * 'copy_trailer()' - Copy the document trailer.
  *
@@ -2192,6 +2266,50 @@ include_feature(
 }
 
 
+/*
+ * 'open_temp()' - Reopen the temporary file for copying.
+ *
+ * The temporary file is a plain seekable file that we wrote ourselves, so map
+ * it read-only and let the kernel page it in as the copies are written.  If
+ * the mapping fails we fall back to buffered reads.
+ */
+
+static void
+open_temp(pstops_doc_t *doc)		/* I - Document information */
+{
+  struct stat	fileinfo;		/* Temporary file information */
+  void		*map;			/* Mapped file */
+
+
+  cupsFileClose(doc->temp);
+
+  doc->temp = cupsFileOpen(doc->tempfile, "r");
+
+  if (!doc->temp || fstat(cupsFileNumber(doc->temp), &fileinfo) ||
+      fileinfo.st_size <= 0 || (off_t)(size_t)fileinfo.st_size != fileinfo.st_size)
+    return;
+
+  if ((map = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE,
+                  cupsFileNumber(doc->temp), 0)) == MAP_FAILED)
+  {
+    fprintf(stderr, "DEBUG: Unable to map temporary file: %s\n",
+            strerror(errno));
+    return;
+  }
+
+#ifdef MADV_SEQUENTIAL
+  if (!doc->slow_order)
+    madvise(map, (size_t)fileinfo.st_size, MADV_SEQUENTIAL);
+#endif /* MADV_SEQUENTIAL */
+
+  doc->tempmap  = (const char *)map;
+  doc->tempsize = (size_t)fileinfo.st_size;
+
+  fprintf(stderr, "DEBUG: Mapped %lu bytes of temporary file.\n",
+          (unsigned long)doc->tempsize);
+}
+
+
 /*
  * 'parse_text()' - Parse a text value in a comment.
  *
@@ -2713,6 +2831,8 @@ skip_page(cups_file_t *fp,		/* I - File to read from */
 	bytes -= linelen;
       }
     }
+
+    copy_lines(fp, NULL, line, linesize);
   }
 
   return (linelen);
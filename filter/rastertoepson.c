@@ -17,6 +17,7 @@
 #include <cups/string-private.h>
 #include <cups/language-private.h>
 #include <cups/raster.h>
+#include "compress.h"
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -410,13 +411,14 @@ CompressData(const unsigned char *line,	/* I - Data to compress */
 	     unsigned            ystep)	/* I - Y resolution */
 {
   const unsigned char	*line_ptr,	/* Current byte pointer */
-        		*line_end,	/* End-of-line byte pointer */
-        		*start;		/* Start of compression sequence */
+        		*line_end;	/* End-of-line byte pointer */
   unsigned char      	*comp_ptr,	/* Pointer into compression buffer */
 			temp;		/* Current byte */
-  int   	        count;		/* Count of bytes for output */
   static int		ctable[6] = { 0, 2, 1, 4, 18, 17 };
 					/* KCMYcm color values */
+  static int		deplete_init = 0;
+					/* Depletion table initialized? */
+  static unsigned char	deplete[256];	/* Depleted value of each byte */
 
 
  /*
@@ -432,33 +434,46 @@ CompressData(const unsigned char *line,	/* I - Data to compress */
 
   if (ystep == 5)
   {
-    for (comp_ptr = (unsigned char *)line; comp_ptr < line_end;)
+    if (!deplete_init)
     {
      /*
-      * Grab the current byte...
+      * Check adjacent bits within each possible byte value once...
       */
 
-      temp = *comp_ptr;
+      int	i;			/* Looping var */
+
+      for (i = 0; i < 256; i ++)
+      {
+        temp = (unsigned char)i;
+
+	if ((temp & 0xc0) == 0xc0)
+	  temp &= 0xbf;
+	if ((temp & 0x60) == 0x60)
+	  temp &= 0xdf;
+	if ((temp & 0x30) == 0x30)
+	  temp &= 0xef;
+	if ((temp & 0x18) == 0x18)
+	  temp &= 0xf7;
+	if ((temp & 0x0c) == 0x0c)
+	  temp &= 0xfb;
+	if ((temp & 0x06) == 0x06)
+	  temp &= 0xfd;
+	if ((temp & 0x03) == 0x03)
+	  temp &= 0xfe;
+
+        deplete[i] = temp;
+      }
 
+      deplete_init = 1;
+    }
+
+    for (comp_ptr = (unsigned char *)line; comp_ptr < line_end;)
+    {
      /*
-      * Check adjacent bits...
+      * Deplete the current byte...
       */
 
-      if ((temp & 0xc0) == 0xc0)
-        temp &= 0xbf;
-      if ((temp & 0x60) == 0x60)
-        temp &= 0xdf;
-      if ((temp & 0x30) == 0x30)
-        temp &= 0xef;
-      if ((temp & 0x18) == 0x18)
-        temp &= 0xf7;
-      if ((temp & 0x0c) == 0x0c)
-        temp &= 0xfb;
-      if ((temp & 0x06) == 0x06)
-        temp &= 0xfd;
-      if ((temp & 0x03) == 0x03)
-        temp &= 0xfe;
-
+      temp        = deplete[*comp_ptr];
       *comp_ptr++ = temp;
 
      /*
@@ -484,66 +499,8 @@ CompressData(const unsigned char *line,	/* I - Data to compress */
         * Do TIFF pack-bits encoding...
         */
 
-	comp_ptr = CompBuffer;
-
-	while (line_ptr < line_end)
-	{
-	  if ((line_ptr + 1) >= line_end)
-	  {
-	   /*
-	    * Single byte on the end...
-	    */
-
-	    *comp_ptr++ = 0x00;
-	    *comp_ptr++ = *line_ptr++;
-	  }
-	  else if (line_ptr[0] == line_ptr[1])
-	  {
-	   /*
-	    * Repeated sequence...
-	    */
-
-	    line_ptr ++;
-	    count = 2;
-
-	    while (line_ptr < (line_end - 1) &&
-        	   line_ptr[0] == line_ptr[1] &&
-        	   count < 127)
-	    {
-              line_ptr ++;
-              count ++;
-	    }
-
-	    *comp_ptr++ = (unsigned char)(257 - count);
-	    *comp_ptr++ = *line_ptr++;
-	  }
-	  else
-	  {
-	   /*
-	    * Non-repeated sequence...
-	    */
-
-	    start    = line_ptr;
-	    line_ptr ++;
-	    count    = 1;
-
-	    while (line_ptr < (line_end - 1) &&
-        	   line_ptr[0] != line_ptr[1] &&
-        	   count < 127)
-	    {
-              line_ptr ++;
-              count ++;
-	    }
-
-	    *comp_ptr++ = (unsigned char)(count - 1);
-
-	    memcpy(comp_ptr, start, (size_t)count);
-	    comp_ptr += count;
-	  }
-	}
-
+	line_end = CompBuffer + PackBitsEncode(CompBuffer, line, length);
         line_ptr = CompBuffer;
-        line_end = comp_ptr;
 	break;
   }
 
@@ -619,7 +576,9 @@ OutputLine(
     unsigned char	*tempptr,
 			*evenptr,
 			*oddptr;
-    unsigned int	x;
+    unsigned int	x,
+			i,
+			count;
     unsigned char	bit;
     const unsigned char	*pixel;
     unsigned char 	*temp;
@@ -629,20 +588,21 @@ OutputLine(
     * Collect bitmap data in the line buffers and write after each buffer.
     */
 
-    for (x = header->cupsWidth, bit = 128, pixel = Planes[0],
-             temp = CompBuffer;
+    for (x = header->cupsWidth, pixel = Planes[0], temp = CompBuffer;
 	 x > 0;
-	 x --, temp ++)
+	 x -= count, temp += count, pixel ++)
     {
-      if (*pixel & bit)
-        *temp |= DotBit;
+      count = x > 8 ? 8 : x;
 
-      if (bit > 1)
-	bit >>= 1;
-      else
+     /*
+      * Blank bytes (the common case) need no work...
+      */
+
+      if (*pixel)
       {
-	bit = 128;
-	pixel ++;
+        for (i = 0, bit = 128; i < count; i ++, bit >>= 1)
+	  if (*pixel & bit)
+	    temp[i] |= DotBit;
       }
     }
 
@@ -16,6 +16,7 @@
 #include <cups/string-private.h>
 #include <cups/language-private.h>
 #include <cups/raster.h>
+#include "compress.h"
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -425,10 +426,7 @@ CompressData(unsigned char *line,	/* I - Data to compress */
 	     unsigned      type)	/* I - Type of compression */
 {
   unsigned char	*line_ptr,		/* Current byte pointer */
-        	*line_end,		/* End-of-line byte pointer */
-        	*comp_ptr,		/* Pointer into compression buffer */
-        	*start;			/* Start of compression sequence */
-  unsigned	count;			/* Count of bytes for output */
+        	*line_end;		/* End-of-line byte pointer */
 
 
   switch (type)
@@ -447,23 +445,8 @@ CompressData(unsigned char *line,	/* I - Data to compress */
         * Do run-length encoding...
         */
 
-	line_end = line + length;
-	for (line_ptr = line, comp_ptr = CompBuffer;
-	     line_ptr < line_end;
-	     comp_ptr += 2, line_ptr += count)
-	{
-	  for (count = 1;
-               (line_ptr + count) < line_end &&
-	           line_ptr[0] == line_ptr[count] &&
-        	   count < 256;
-               count ++);
-
-	  comp_ptr[0] = (unsigned char)(count - 1);
-	  comp_ptr[1] = line_ptr[0];
-	}
-
+	line_end = CompBuffer + RunLengthEncode(CompBuffer, line, length);
         line_ptr = CompBuffer;
-        line_end = comp_ptr;
 	break;
 
     case 2 :
@@ -471,68 +454,8 @@ CompressData(unsigned char *line,	/* I - Data to compress */
         * Do TIFF pack-bits encoding...
         */
 
-	line_ptr = line;
-	line_end = line + length;
-	comp_ptr = CompBuffer;
-
-	while (line_ptr < line_end)
-	{
-	  if ((line_ptr + 1) >= line_end)
-	  {
-	   /*
-	    * Single byte on the end...
-	    */
-
-	    *comp_ptr++ = 0x00;
-	    *comp_ptr++ = *line_ptr++;
-	  }
-	  else if (line_ptr[0] == line_ptr[1])
-	  {
-	   /*
-	    * Repeated sequence...
-	    */
-
-	    line_ptr ++;
-	    count = 2;
-
-	    while (line_ptr < (line_end - 1) &&
-        	   line_ptr[0] == line_ptr[1] &&
-        	   count < 127)
-	    {
-              line_ptr ++;
-              count ++;
-	    }
-
-	    *comp_ptr++ = (unsigned char)(257 - count);
-	    *comp_ptr++ = *line_ptr++;
-	  }
-	  else
-	  {
-	   /*
-	    * Non-repeated sequence...
-	    */
-
-	    start    = line_ptr;
-	    line_ptr ++;
-	    count    = 1;
-
-	    while (line_ptr < (line_end - 1) &&
-        	   line_ptr[0] != line_ptr[1] &&
-        	   count < 127)
-	    {
-              line_ptr ++;
-              count ++;
-	    }
-
-	    *comp_ptr++ = (unsigned char)(count - 1);
-
-	    memcpy(comp_ptr, start, count);
-	    comp_ptr += count;
-	  }
-	}
-
+	line_end = CompBuffer + PackBitsEncode(CompBuffer, line, length);
         line_ptr = CompBuffer;
-        line_end = comp_ptr;
 	break;
   }
 
@@ -13,13 +13,16 @@
  */
 
 #include <cups/cups.h>
-#include <cups/ppd.h>
+#include <cups/ppd-private.h>
 #include <cups/string-private.h>
 #include <cups/language-private.h>
 #include <cups/raster.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#ifdef HAVE_LIBZ
+#  include <zlib.h>
+#endif /* HAVE_LIBZ */
 
 
 /*
@@ -53,6 +56,14 @@
 #define INTELLITECH_PCL	0x20		/* Intellitech PCL-based printers */
 
 
+/*
+ * ZPL graphics constants...
+ */
+
+#define ZPL_BAND_HEIGHT	64		/* Lines per stored graphic band */
+#define ZPL_MAX_BANDS	1000		/* Maximum number of graphic bands */
+
+
 /*
  * Globals...
  */
@@ -60,11 +71,16 @@
 unsigned char	*Buffer;		/* Output buffer */
 unsigned char	*CompBuffer;		/* Compression buffer */
 unsigned char	*LastBuffer;		/* Last buffer */
+unsigned char	*PageBuffer,		/* Page bitmap (ZPL) */
+		*LastPage;		/* Previous page bitmap (ZPL) */
+unsigned	LastBytesPerLine,	/* Bytes per line of previous page */
+		LastHeight;		/* Height of previous page */
 unsigned	Feed;			/* Number of lines to skip */
 int		LastSet;		/* Number of repeat characters */
 int		ModelNumber,		/* cupsModelNumber attribute */
 		Page,			/* Current page */
-		Canceled;		/* Non-zero if job is canceled */
+		Canceled,		/* Non-zero if job is canceled */
+		ZPLCompressed;		/* Send Z64 compressed graphics? */
 
 
 /*
@@ -74,10 +90,13 @@ int		ModelNumber,		/* cupsModelNumber attribute */
 void	Setup(ppd_file_t *ppd);
 void	StartPage(ppd_file_t *ppd, cups_page_header2_t *header);
 void	EndPage(ppd_file_t *ppd, cups_page_header2_t *header);
+void	Shutdown(void);
 void	CancelJob(int sig);
 void	OutputLine(ppd_file_t *ppd, cups_page_header2_t *header, unsigned y);
 void	PCLCompress(unsigned char *line, unsigned length);
 void	ZPLCompress(unsigned char repeat_char, unsigned repeat_count);
+void	ZPLOutputBand(cups_page_header2_t *header, unsigned band, unsigned y,
+		      unsigned height);
 
 
 /*
@@ -125,6 +144,15 @@ Setup(ppd_file_t *ppd)			/* I - PPD file */
 	break;
 
     case ZEBRA_ZPL :
+       /*
+        * See if we should send compressed graphics...
+	*/
+
+#ifdef HAVE_LIBZ
+        ZPLCompressed = ppdIsMarked(ppd, "zeGraphicsFormat", "Z64");
+#else
+        ZPLCompressed = 0;
+#endif /* HAVE_LIBZ */
         break;
 
     case ZEBRA_CPCL :
@@ -276,20 +304,12 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
 	  printf("~SD%02u\n", 30 * header->cupsCompression / 100);
 
        /*
-        * Start bitmap graphics...
-	*/
-
-        printf("~DGR:CUPS.GRF,%u,%u,\n",
-	       header->cupsHeight * header->cupsBytesPerLine,
-	       header->cupsBytesPerLine);
-
-       /*
-        * Allocate compression buffers...
+        * Allocate the page and compression buffers - the graphics are sent
+	* in bands when the page is done...
 	*/
 
+	PageBuffer = calloc(header->cupsHeight, header->cupsBytesPerLine);
 	CompBuffer = malloc(2 * header->cupsBytesPerLine + 1);
-	LastBuffer = malloc(header->cupsBytesPerLine);
-	LastSet    = 0;
         break;
 
     case ZEBRA_CPCL :
@@ -439,6 +459,13 @@ EndPage(ppd_file_t          *ppd,	/* I - PPD file */
 {
   int		val;			/* Option value */
   ppd_choice_t	*choice;		/* Marked choice */
+  unsigned	band,			/* Current graphic band */
+		band_height,		/* Lines per band */
+		y,			/* Current line */
+		height,			/* Lines in current band */
+		bytes,			/* Bytes in current band */
+		same_size;		/* Same size as previous page? */
+  unsigned char	*bandptr;		/* Pointer to current band */
 
 
   switch (ModelNumber)
@@ -476,13 +503,37 @@ EndPage(ppd_file_t          *ppd,	/* I - PPD file */
 
     case ZEBRA_ZPL :
         if (Canceled)
+	  break;
+
+       /*
+        * Download the graphic bands that are not blank and have changed
+	* since the previous page - the others are already stored in the
+	* printer...
+	*/
+
+        band_height = ZPL_BAND_HEIGHT;
+	if (header->cupsHeight > ZPL_BAND_HEIGHT * ZPL_MAX_BANDS)
+	  band_height = (header->cupsHeight + ZPL_MAX_BANDS - 1) / ZPL_MAX_BANDS;
+
+        same_size = LastPage && LastBytesPerLine == header->cupsBytesPerLine &&
+	            LastHeight == header->cupsHeight;
+
+        for (band = 0, y = 0; y < header->cupsHeight; band ++, y += band_height)
 	{
-	 /*
-	  * Cancel bitmap download...
-	  */
+	  height = header->cupsHeight - y;
+	  if (height > band_height)
+	    height = band_height;
 
-	  puts("~DN");
-	  break;
+	  bytes   = height * header->cupsBytesPerLine;
+	  bandptr = PageBuffer + y * header->cupsBytesPerLine;
+
+	  if (!bandptr[0] && !memcmp(bandptr, bandptr + 1, bytes - 1))
+	    continue;
+
+	  if (same_size && !memcmp(bandptr, LastPage + y * header->cupsBytesPerLine, bytes))
+	    continue;
+
+	  ZPLOutputBand(header, band, y, height);
 	}
 
        /*
@@ -605,10 +656,21 @@ EndPage(ppd_file_t          *ppd,	/* I - PPD file */
 	  printf("^PQ%d, 0, 0, N\n", header->NumCopies);
 
        /*
-        * Display the label image...
+        * Display the label image bands...
 	*/
 
-	puts("^FO0,0^XGR:CUPS.GRF,1,1^FS");
+        for (band = 0, y = 0; y < header->cupsHeight; band ++, y += band_height)
+	{
+	  height = header->cupsHeight - y;
+	  if (height > band_height)
+	    height = band_height;
+
+	  bytes   = height * header->cupsBytesPerLine;
+	  bandptr = PageBuffer + y * header->cupsBytesPerLine;
+
+	  if (bandptr[0] || memcmp(bandptr, bandptr + 1, bytes - 1))
+	    printf("^FO0,%u^XGR:CUPS%03u.GRF,1,1^FS\n", y, band);
+	}
 
        /*
         * End the label and eject...
@@ -617,12 +679,15 @@ EndPage(ppd_file_t          *ppd,	/* I - PPD file */
 	puts("^XZ");
 
        /*
-        * Delete the label image...
-        */
+        * Keep this page for comparison with the next one...
+	*/
 
-	puts("^XA");
-        puts("^IDR:CUPS.GRF^FS");
-	puts("^XZ");
+        free(LastPage);
+
+	LastPage         = PageBuffer;
+	LastBytesPerLine = header->cupsBytesPerLine;
+	LastHeight       = header->cupsHeight;
+	PageBuffer       = NULL;
 
        /*
         * Cut the label as needed...
@@ -710,6 +775,42 @@ EndPage(ppd_file_t          *ppd,	/* I - PPD file */
     free(LastBuffer);
     LastBuffer = NULL;
   }
+
+  if (PageBuffer)
+  {
+    free(PageBuffer);
+    PageBuffer = NULL;
+  }
+}
+
+
+/*
+ * 'Shutdown()' - Shutdown the printer.
+ */
+
+void
+Shutdown(void)
+{
+  switch (ModelNumber)
+  {
+    case ZEBRA_ZPL :
+       /*
+        * Delete the stored label images...
+	*/
+
+        if (LastPage)
+	{
+	  puts("^XA");
+	  puts("^IDR:CUPS*.GRF^FS");
+	  puts("^XZ");
+
+	  fflush(stdout);
+
+	  free(LastPage);
+	  LastPage = NULL;
+	}
+        break;
+  }
 }
 
 
@@ -741,11 +842,6 @@ OutputLine(ppd_file_t         *ppd,	/* I - PPD file */
 {
   unsigned	i;			/* Looping var */
   unsigned char	*ptr;			/* Pointer into buffer */
-  unsigned char	*compptr;		/* Pointer into compression buffer */
-  unsigned char	repeat_char;		/* Repeated character */
-  unsigned	repeat_count;		/* Number of repeated characters */
-  static const unsigned char *hex = (const unsigned char *)"0123456789ABCDEF";
-					/* Hex digits */
 
 
   (void)ppd;
@@ -799,75 +895,11 @@ OutputLine(ppd_file_t         *ppd,	/* I - PPD file */
 
     case ZEBRA_ZPL :
        /*
-	* Determine if this row is the same as the previous line.
-        * If so, output a ':' and return...
-        */
-
-        if (LastSet)
-	{
-	  if (!memcmp(Buffer, LastBuffer, header->cupsBytesPerLine))
-	  {
-	    putchar(':');
-	    return;
-	  }
-	}
-
-       /*
-        * Convert the line to hex digits...
-	*/
-
-	for (ptr = Buffer, compptr = CompBuffer, i = header->cupsBytesPerLine;
-	     i > 0;
-	     i --, ptr ++)
-        {
-	  *compptr++ = hex[*ptr >> 4];
-	  *compptr++ = hex[*ptr & 15];
-	}
-
-        *compptr = '\0';
-
-       /*
-        * Run-length compress the graphics...
+        * Save the line in the page bitmap...
 	*/
 
-	for (compptr = CompBuffer + 1, repeat_char = CompBuffer[0], repeat_count = 1;
-	     *compptr;
-	     compptr ++)
-	  if (*compptr == repeat_char)
-	    repeat_count ++;
-	  else
-	  {
-	    ZPLCompress(repeat_char, repeat_count);
-	    repeat_char  = *compptr;
-	    repeat_count = 1;
-	  }
-
-        if (repeat_char == '0')
-	{
-	 /*
-	  * Handle 0's on the end of the line...
-	  */
-
-	  if (repeat_count & 1)
-	  {
-	    repeat_count --;
-	    putchar('0');
-	  }
-
-          if (repeat_count > 0)
-	    putchar(',');
-	}
-	else
-	  ZPLCompress(repeat_char, repeat_count);
-
-	fflush(stdout);
-
-       /*
-        * Save this line for the next round...
-	*/
-
-	memcpy(LastBuffer, Buffer, header->cupsBytesPerLine);
-	LastSet = 1;
+        memcpy(PageBuffer + y * header->cupsBytesPerLine, Buffer,
+	       header->cupsBytesPerLine);
         break;
 
     case ZEBRA_CPCL :
@@ -1080,6 +1112,152 @@ ZPLCompress(unsigned char repeat_char,	/* I - Character to repeat */
 }
 
 
+/*
+ * 'ZPLOutputBand()' - Download a band of the page bitmap as a stored graphic.
+ */
+
+void
+ZPLOutputBand(
+    cups_page_header2_t *header,	/* I - Page header */
+    unsigned            band,		/* I - Band number */
+    unsigned            y,		/* I - First line of band */
+    unsigned            height)		/* I - Number of lines in band */
+{
+  unsigned	i;			/* Looping var */
+  unsigned	bytes;			/* Bytes in band */
+  unsigned char	*line,			/* Current line */
+		*ptr;			/* Pointer into line */
+  unsigned char	*compptr;		/* Pointer into compression buffer */
+  unsigned char	repeat_char;		/* Repeated character */
+  unsigned	repeat_count;		/* Number of repeated characters */
+  static const unsigned char *hex = (const unsigned char *)"0123456789ABCDEF";
+					/* Hex digits */
+
+
+  bytes = height * header->cupsBytesPerLine;
+  line  = PageBuffer + y * header->cupsBytesPerLine;
+
+#ifdef HAVE_LIBZ
+  if (ZPLCompressed)
+  {
+    uLongf	complen;		/* Length of compressed data */
+    Bytef	*comp;			/* Compressed data */
+    char	*b64,			/* Base64 encoded data */
+		*b64ptr;		/* Pointer into base64 data */
+    size_t	b64size;		/* Size of base64 buffer */
+    unsigned	crc,			/* CRC-16 of base64 data */
+		bit;			/* Current bit */
+
+
+   /*
+    * Send the band as base64-encoded zlib data ("Z64") followed by the
+    * CRC-16/CCITT of the encoded data...
+    */
+
+    complen = compressBound(bytes);
+    comp    = malloc(complen);
+    b64size = 4 * ((complen + 2) / 3) + 1;
+    b64     = malloc(b64size);
+
+    if (comp && b64 && compress2(comp, &complen, line, bytes, Z_DEFAULT_COMPRESSION) == Z_OK)
+    {
+      httpEncode64_2(b64, (int)b64size, (char *)comp, (int)complen);
+
+      for (crc = 0, b64ptr = b64; *b64ptr; b64ptr ++)
+      {
+        crc ^= (unsigned)(*b64ptr & 255) << 8;
+
+        for (bit = 0; bit < 8; bit ++)
+	  crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) & 0xffff : (crc << 1) & 0xffff;
+      }
+
+      printf("~DGR:CUPS%03u.GRF,%u,%u,:Z64:%s:%04X\n", band, bytes,
+             header->cupsBytesPerLine, b64, crc);
+
+      free(comp);
+      free(b64);
+      fflush(stdout);
+      return;
+    }
+
+    free(comp);
+    free(b64);
+  }
+#endif /* HAVE_LIBZ */
+
+ /*
+  * Send the band as run-length compressed hex digits...
+  */
+
+  printf("~DGR:CUPS%03u.GRF,%u,%u,\n", band, bytes, header->cupsBytesPerLine);
+
+  for (i = 0; i < height; i ++, line += header->cupsBytesPerLine)
+  {
+   /*
+    * Determine if this row is the same as the previous line.
+    * If so, output a ':' and continue...
+    */
+
+    if (i > 0 && !memcmp(line, line - header->cupsBytesPerLine, header->cupsBytesPerLine))
+    {
+      putchar(':');
+      continue;
+    }
+
+   /*
+    * Convert the line to hex digits...
+    */
+
+    for (ptr = line, compptr = CompBuffer, repeat_count = header->cupsBytesPerLine;
+	 repeat_count > 0;
+	 repeat_count --, ptr ++)
+    {
+      *compptr++ = hex[*ptr >> 4];
+      *compptr++ = hex[*ptr & 15];
+    }
+
+    *compptr = '\0';
+
+   /*
+    * Run-length compress the graphics...
+    */
+
+    for (compptr = CompBuffer + 1, repeat_char = CompBuffer[0], repeat_count = 1;
+	 *compptr;
+	 compptr ++)
+      if (*compptr == repeat_char)
+	repeat_count ++;
+      else
+      {
+	ZPLCompress(repeat_char, repeat_count);
+	repeat_char  = *compptr;
+	repeat_count = 1;
+      }
+
+    if (repeat_char == '0')
+    {
+     /*
+      * Handle 0's on the end of the line...
+      */
+
+      if (repeat_count & 1)
+      {
+	repeat_count --;
+	putchar('0');
+      }
+
+      if (repeat_count > 0)
+	putchar(',');
+    }
+    else
+      ZPLCompress(repeat_char, repeat_count);
+  }
+
+  putchar('\n');
+  fflush(stdout);
+}
+
+
 /*
  * 'main()' - Main entry and processing of driver.
  */
@@ -1182,8 +1360,7 @@ main(int  argc,				/* I - Number of command-line arguments */
     return (1);
   }
 
-  ppdMarkDefaults(ppd);
-  cupsMarkOptions(ppd, num_options, options);
+  _ppdMarkDefaultsAndOptions(ppd, num_options, options);
 
  /*
   * Initialize the print device...
@@ -1265,6 +1442,12 @@ main(int  argc,				/* I - Number of command-line arguments */
       break;
   }
 
+ /*
+  * Shutdown the printer...
+  */
+
+  Shutdown();
+
  /*
   * Close the raster stream...
   */
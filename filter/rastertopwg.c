@@ -13,7 +13,7 @@
 
 #include <cups/cups-private.h>
 #include <cups/ppd-private.h>
-#include <cups/raster.h>
+#include <cups/raster-private.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -29,6 +29,8 @@ main(int  argc,				/* I - Number of command-line args */
   const char		*final_content_type;
 					/* FINAL_CONTENT_TYPE env var */
   int			fd;		/* Raster file */
+  int			outmode;	/* Output raster mode */
+  int			copied;		/* Result of copying compressed page */
   cups_raster_t		*inras,		/* Input raster stream */
 			*outras;	/* Output raster stream */
   cups_page_header2_t	inheader,	/* Input raster page header */
@@ -73,16 +75,25 @@ main(int  argc,				/* I - Number of command-line args */
   if ((final_content_type = getenv("FINAL_CONTENT_TYPE")) == NULL)
     final_content_type = "image/pwg-raster";
 
+  if (!strcmp(final_content_type, "image/pwg-raster"))
+    outmode = CUPS_RASTER_WRITE_PWG;
+  else
+    outmode = CUPS_RASTER_WRITE_APPLE;
+
+ /*
+  * Compress the output in worker threads so that the next lines and pages
+  * can be read while the previous ones are encoded...
+  */
+
   inras  = cupsRasterOpen(fd, CUPS_RASTER_READ);
-  outras = cupsRasterOpen(1, !strcmp(final_content_type, "image/pwg-raster") ? CUPS_RASTER_WRITE_PWG : CUPS_RASTER_WRITE_APPLE);
+  outras = cupsRasterOpen(1, (cups_mode_t)(outmode | CUPS_RASTER_WRITE_THREADED));
 
   ppd   = ppdOpenFile(getenv("PPD"));
   back  = ppdFindAttr(ppd, "cupsBackSide", NULL);
 
   num_options = cupsParseOptions(argv[5], 0, &options);
 
-  ppdMarkDefaults(ppd);
-  cupsMarkOptions(ppd, num_options, options);
+  _ppdMarkDefaultsAndOptions(ppd, num_options, options);
 
   cache = ppd ? ppd->cache : NULL;
 
@@ -445,22 +456,68 @@ main(int  argc,				/* I - Number of command-line args */
 	return (1);
       }
 
-    for (y = inheader.cupsHeight; y > 0; y --)
+    if (lineoffset == 0 && inheader.cupsBytesPerLine == outheader.cupsBytesPerLine && page_top == 0 && page_bottom == 0 && (copied = _cupsRasterCopyPage(inras, outras)) >= 0)
     {
-      if (cupsRasterReadPixels(inras, line + lineoffset, inheader.cupsBytesPerLine) != inheader.cupsBytesPerLine)
+     /*
+      * Same page image and encoding, so copy the compressed lines as-is...
+      */
+
+      if (!copied)
       {
-	_cupsLangPrintFilter(stderr, "ERROR", _("Error reading raster data."));
-	fprintf(stderr, "DEBUG: Unable to read line %d for page %d.\n",
-	        inheader.cupsHeight - y + page_top + 1, page);
+	_cupsLangPrintFilter(stderr, "ERROR", _("Error sending raster data."));
+	fprintf(stderr, "DEBUG: Unable to copy raster data for page %d.\n", page);
 	return (1);
       }
+    }
+    else if (lineoffset == 0 && inheader.cupsBytesPerLine == outheader.cupsBytesPerLine)
+    {
+     /*
+      * Same line layout, so pass bands of input lines straight through...
+      */
 
-      if (!cupsRasterWritePixels(outras, line, outheader.cupsBytesPerLine))
+      const unsigned char *lines[64];	/* Lines in current band */
+      unsigned		i,		/* Looping var */
+			num_lines;	/* Number of lines in band */
+
+      for (y = inheader.cupsHeight; y > 0; y -= num_lines)
       {
-	_cupsLangPrintFilter(stderr, "ERROR", _("Error sending raster data."));
-	fprintf(stderr, "DEBUG: Unable to write line %d for page %d.\n",
-	        inheader.cupsHeight - y + page_top + 1, page);
-	return (1);
+        if ((num_lines = _cupsRasterReadLines(inras, lines, y < 64 ? y : 64)) == 0)
+	{
+	  _cupsLangPrintFilter(stderr, "ERROR", _("Error reading raster data."));
+	  fprintf(stderr, "DEBUG: Unable to read line %d for page %d.\n",
+		  inheader.cupsHeight - y + page_top + 1, page);
+	  return (1);
+	}
+
+        for (i = 0; i < num_lines; i ++)
+	  if (!cupsRasterWritePixels(outras, (unsigned char *)lines[i], outheader.cupsBytesPerLine))
+	  {
+	    _cupsLangPrintFilter(stderr, "ERROR", _("Error sending raster data."));
+	    fprintf(stderr, "DEBUG: Unable to write line %d for page %d.\n",
+		    inheader.cupsHeight - y + i + page_top + 1, page);
+	    return (1);
+	  }
+      }
+    }
+    else
+    {
+      for (y = inheader.cupsHeight; y > 0; y --)
+      {
+        if (cupsRasterReadPixels(inras, line + lineoffset, inheader.cupsBytesPerLine) != inheader.cupsBytesPerLine)
+        {
+	  _cupsLangPrintFilter(stderr, "ERROR", _("Error reading raster data."));
+	  fprintf(stderr, "DEBUG: Unable to read line %d for page %d.\n",
+		  inheader.cupsHeight - y + page_top + 1, page);
+	  return (1);
+        }
+
+        if (!cupsRasterWritePixels(outras, line, outheader.cupsBytesPerLine))
+        {
+	  _cupsLangPrintFilter(stderr, "ERROR", _("Error sending raster data."));
+	  fprintf(stderr, "DEBUG: Unable to write line %d for page %d.\n",
+		  inheader.cupsHeight - y + page_top + 1, page);
+	  return (1);
+        }
       }
     }
 
@@ -0,0 +1,70 @@
+/*
+ * Convert a GNU gettext .po file to a compiled CUPS message catalog.
+ *
+ * Copyright 2007-2017 by Apple Inc.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ *
+ * Usage:
+ *
+ *   po2cat filename.po filename.cat
+ *
+ * Compile with:
+ *
+ *   gcc -o po2cat po2cat.c `cups-config --libs`
+ */
+
+#include <cups/cups-private.h>
+
+
+/*
+ * The compiled catalog is a hash table of the messages in the .po file that
+ * libcups maps read-only into memory instead of parsing the .po file in
+ * every process.  Catalogs use the byte order of the system they are
+ * compiled on; libcups falls back on the .po file when a catalog is missing,
+ * out-of-date, or was compiled elsewhere.
+ */
+
+
+/*
+ *   main() - Convert .po file to compiled catalog.
+ */
+
+int					/* O - Exit code */
+main(int  argc,				/* I - Number of command-line args */
+     char *argv[])			/* I - Command-line arguments */
+{
+  cups_array_t	*po;			/* .po messages */
+
+
+  if (argc != 3)
+  {
+    puts("Usage: po2cat filename.po filename.cat");
+    return (1);
+  }
+
+  if (access(argv[1], R_OK))
+  {
+    perror(argv[1]);
+    return (1);
+  }
+
+  if ((po = _cupsMessageLoad(argv[1], _CUPS_MESSAGE_UNQUOTE)) == NULL)
+  {
+    perror(argv[1]);
+    return (1);
+  }
+
+  if (_cupsMessageSave(argv[2], _CUPS_MESSAGE_CATALOG, po))
+  {
+    perror(argv[2]);
+    _cupsMessageFree(po);
+    return (1);
+  }
+
+  printf("%s: %d messages.\n", argv[2], cupsArrayCount(po));
+
+  _cupsMessageFree(po);
+
+  return (0);
+}
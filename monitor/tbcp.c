@@ -15,6 +15,14 @@
 #include <cups/ppd.h>
 
 
+/*
+ * Characters that must be quoted (CTRL-A, CTRL-C, CTRL-D, CTRL-E, CTRL-Q,
+ * CTRL-S, CTRL-T, ESC, and CTRL-\), as a bitmask of control codes 0x00-0x1f...
+ */
+
+#define TBCP_QUOTE_MASK	0x181a003aU
+
+
 /*
  * Local functions...
  */
@@ -215,48 +223,57 @@ psgets(char   *buf,			/* I  - Buffer to read into */
 
 /*
  * 'pswrite()' - Write data from a file.
+ *
+ * Runs of bytes that need no quoting are written with a single fwrite()
+ * call; only the special control characters are quoted individually.
  */
 
 static ssize_t				/* O - Number of bytes written */
 pswrite(const char *buf,		/* I - Buffer to write */
         size_t     bytes)		/* I - Bytes to write */
 {
-  size_t	count;			/* Remaining bytes */
+  const char	*bufptr,		/* Pointer into buffer */
+		*bufend,		/* End of buffer */
+		*start;			/* Start of unquoted run */
+  int		ch;			/* Current character */
 
 
-  for (count = bytes; count > 0; count --, buf ++)
-    switch (*buf)
-    {
-      case 0x04 : /* CTRL-D */
-          if (bytes == 1)
-	  {
-	   /*
-	    * Don't quote the last CTRL-D...
-	    */
-
-	    putchar(0x04);
-	    break;
-	  }
-
-      case 0x01 : /* CTRL-A */
-      case 0x03 : /* CTRL-C */
-      case 0x05 : /* CTRL-E */
-      case 0x11 : /* CTRL-Q */
-      case 0x13 : /* CTRL-S */
-      case 0x14 : /* CTRL-T */
-      case 0x1b : /* CTRL-[ (aka ESC) */
-      case 0x1c : /* CTRL-\ */
-	  if (putchar(0x01) < 0)
-	    return (-1);
-	  if (putchar(*buf ^ 0x40) < 0)
-	    return (-1);
-	  break;
-
-      default :
-	  if (putchar(*buf) < 0)
-	    return (-1);
-	  break;
-    }
+  if (bytes == 1 && *buf == 0x04)
+  {
+   /*
+    * Don't quote the last CTRL-D...
+    */
+
+    if (putchar(0x04) < 0)
+      return (-1);
+
+    return (1);
+  }
+
+  for (start = bufptr = buf, bufend = buf + bytes; bufptr < bufend; bufptr ++)
+  {
+    ch = *bufptr & 255;
+
+    if (ch >= 0x20 || !(TBCP_QUOTE_MASK & (1U << ch)))
+      continue;
+
+   /*
+    * Flush the unquoted run and quote this character...
+    */
+
+    if (bufptr > start && fwrite(start, 1, (size_t)(bufptr - start), stdout) < (size_t)(bufptr - start))
+      return (-1);
+
+    if (putchar(0x01) < 0)
+      return (-1);
+    if (putchar(ch ^ 0x40) < 0)
+      return (-1);
+
+    start = bufptr + 1;
+  }
+
+  if (bufptr > start && fwrite(start, 1, (size_t)(bufptr - start), stdout) < (size_t)(bufptr - start))
+    return (-1);
 
   return ((ssize_t)bytes);
 }
@@ -16,6 +16,7 @@
 #include <cups/cups.h>
 #include <cups/string-private.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -134,6 +135,8 @@
  * Constants...
  */
 
+#define MAX_PENDING	100		/* Maximum number of unflushed signals */
+
 enum
 {
   PARAMS_NONE,
@@ -154,6 +157,7 @@ static char		lock_filename[1024];	/* Lock filename */
  */
 
 static int	acquire_lock(int *fd, char *lockfile, size_t locksize);
+static int	events_pending(void);
 static void	release_lock(void);
 
 
@@ -173,6 +177,7 @@ main(int  argc,				/* I - Number of command-line args */
   DBusMessage		*message;	/* Message to send */
   DBusMessageIter	iter;		/* Iterator for message data */
   int			lock_fd = -1;	/* Lock file descriptor */
+  int			pending = 0;	/* Number of unflushed signals */
 
 
  /*
@@ -224,6 +229,19 @@ main(int  argc,				/* I - Number of command-line args */
 					/* What parameters to include? */
 
 
+   /*
+    * Send queued signals when the scheduler has nothing more for us right
+    * now, so that bursts of events cost a single round trip...
+    */
+
+    if (pending && (pending >= MAX_PENDING || !events_pending()))
+    {
+      if (con && dbus_connection_get_is_connected(con))
+	dbus_connection_flush(con);
+
+      pending = 0;
+    }
+
    /*
     * Get the next event...
     */
@@ -545,7 +563,7 @@ main(int  argc,				/* I - Number of command-line args */
     }
 
     dbus_connection_send(con, message, NULL);
-    dbus_connection_flush(con);
+    pending ++;
 
    /*
     * Cleanup...
@@ -565,9 +583,12 @@ main(int  argc,				/* I - Number of command-line args */
   }
 
  /*
-  * Remove lock file...
+  * Send any remaining signals and remove lock file...
   */
 
+  if (pending && con && dbus_connection_get_is_connected(con))
+    dbus_connection_flush(con);
+
   if (lock_fd >= 0)
   {
     close(lock_fd);
@@ -578,6 +599,24 @@ main(int  argc,				/* I - Number of command-line args */
 }
 
 
+/*
+ * 'events_pending()' - See if more events are waiting on stdin.
+ */
+
+static int				/* O - 1 if events are waiting, 0 otherwise */
+events_pending(void)
+{
+  struct pollfd	pfd;			/* Polling data */
+
+
+  pfd.fd      = 0;
+  pfd.events  = POLLIN;
+  pfd.revents = 0;
+
+  return (poll(&pfd, 1, 0) > 0);
+}
+
+
 /*
  * 'release_lock()' - Release the singleton lock.
  */
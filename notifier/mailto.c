@@ -14,9 +14,38 @@
 
 #include <cups/cups-private.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <signal.h>
 
 
+/*
+ * Constants...
+ */
+
+#define MAILTO_MAX_DELAY	300	/* Maximum backoff delay in seconds */
+#define MAILTO_RETRY_DELAY	30	/* Initial delay after a failure */
+#define MAILTO_SLOW_TIME	5	/* Seconds before a send is "slow" */
+#define MAILTO_SMTP_IDLE	30	/* Seconds to keep idle SMTP sessions */
+
+
+/*
+ * Types...
+ */
+
+typedef struct mailto_digest_s		/**** Pending messages for a recipient ****/
+{
+  char		*to,			/* To: address */
+		*reply_to,		/* Reply-To: address */
+		*subject,		/* Subject of first event */
+		*text;			/* Text of collected events */
+  size_t	textlen,		/* Length of text */
+		textsize;		/* Size of text buffer */
+  int		count,			/* Number of events */
+		dropped;		/* Number of events over DigestLimit */
+  time_t	first;			/* Time of first event */
+} mailto_digest_t;
+
+
 /*
  * Globals...
  */
@@ -27,16 +56,29 @@ char	mailtoReplyTo[1024];		/* Reply-To email address */
 char	mailtoSubject[1024];		/* Subject prefix */
 char	mailtoSMTPServer[1024];		/* SMTP server to use */
 char	mailtoSendmail[1024];		/* Sendmail program to use */
+int	mailtoDigestInterval;		/* Seconds to collect events for */
+int	mailtoDigestLimit;		/* Maximum events per message */
+int	mailtoDelay = 0;		/* Backoff delay for a slow mail server */
+cups_array_t *mailtoDigests = NULL;	/* Pending messages */
+cups_file_t *mailtoSMTP = NULL;		/* Open SMTP session */
+int	mailtoSMTPPipelining = 0;	/* Does the SMTP server pipeline? */
 
 
 /*
  * Local functions...
  */
 
-void		email_message(const char *to, const char *subject, const char *text);
+int		append_text(mailto_digest_t *digest, const char *s);
+int		compare_digests(mailto_digest_t *a, mailto_digest_t *b);
+int		email_message(const char *to, const char *reply_to, const char *subject, const char *text);
+time_t		flush_messages(int force);
 int		load_configuration(void);
 cups_file_t	*pipe_sendmail(const char *to);
 void		print_attributes(ipp_t *ipp, int indent);
+void		queue_message(const char *to, const char *reply_to, const char *subject, const char *text);
+void		smtp_close(int quit);
+int		smtp_open(void);
+int		smtp_response(char *response, size_t responsesize, int *pipelining);
 
 
 /*
@@ -50,11 +92,19 @@ main(int  argc,				/* I - Number of command-line arguments */
   int		i;			/* Looping var */
   ipp_t		*msg;			/* Event message from scheduler */
   ipp_state_t	state;			/* IPP event state */
+  ipp_attribute_t *attr;		/* notify-recipient-uri/user-data */
+  const char	*recipient;		/* Recipient URI */
+  const char	*data;			/* notify-user-data value */
+  int		datalen;		/* Length of notify-user-data */
   char		*subject,		/* Subject for notification message */
 		*text;			/* Text for notification message */
   cups_lang_t	*lang;			/* Language info */
   char		temp[1024];		/* Temporary string */
   int		templen;		/* Length of temporary string */
+  char		reply_to[1024];		/* Reply-To address for event */
+  time_t	next;			/* Time of next pending message */
+  int		timeout;		/* Timeout for poll() */
+  struct pollfd	pfd;			/* Polling data for stdin */
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* POSIX sigaction data */
 #endif /* HAVE_SIGACTION && !HAVE_SIGSET */
@@ -129,6 +179,37 @@ main(int  argc,				/* I - Number of command-line arguments */
 
   for (;;)
   {
+   /*
+    * Send pending messages that are due and wait for the next event, closing
+    * an idle SMTP session after a while...
+    */
+
+    if ((next = flush_messages(0)) > 0)
+    {
+      if ((timeout = (int)(next - time(NULL))) < 0)
+        timeout = 0;
+
+      timeout *= 1000;
+    }
+    else if (mailtoSMTP)
+      timeout = MAILTO_SMTP_IDLE * 1000;
+    else
+      timeout = -1;
+
+    pfd.fd      = 0;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+
+    if ((i = poll(&pfd, 1, timeout)) < 0 && errno == EINTR)
+      continue;
+    else if (i == 0)
+    {
+      if (!next && mailtoSMTP)
+        smtp_close(1);
+
+      continue;
+    }
+
    /*
     * Get the next event...
     */
@@ -148,15 +229,54 @@ main(int  argc,				/* I - Number of command-line arguments */
     if (state <= IPP_IDLE)
     {
      /*
-      * Out of messages, free memory and then exit...
+      * Out of messages, send anything that is pending, free memory and then
+      * exit...
       */
 
+      flush_messages(1);
+
+      if (mailtoSMTP)
+        smtp_close(1);
+
       ippDelete(msg);
       return (0);
     }
 
    /*
-    * Get the subject and text for the message, then email it...
+    * Multiplexed notifiers get the recipient and reply-to address with each
+    * event...
+    */
+
+    if ((attr = ippFindAttribute(msg, "notify-recipient-uri", IPP_TAG_URI)) != NULL)
+    {
+      recipient = ippGetString(attr, 0, NULL);
+
+      reply_to[0] = '\0';
+
+      if ((attr = ippFindAttribute(msg, "notify-user-data", IPP_TAG_STRING)) != NULL && (data = ippGetOctetString(attr, 0, &datalen)) != NULL && datalen > 7 && !strncmp(data, "mailto:", 7))
+      {
+        if ((size_t)(datalen - 7) >= sizeof(reply_to))
+          datalen = (int)sizeof(reply_to) + 6;
+
+        memcpy(reply_to, data + 7, (size_t)(datalen - 7));
+        reply_to[datalen - 7] = '\0';
+      }
+    }
+    else
+    {
+      recipient = argv[1];
+      strlcpy(reply_to, mailtoReplyTo, sizeof(reply_to));
+    }
+
+    if (strncmp(recipient, "mailto:", 7))
+    {
+      fprintf(stderr, "ERROR: Bad recipient \"%s\"!\n", recipient);
+      ippDelete(msg);
+      continue;
+    }
+
+   /*
+    * Get the subject and text for the message, then queue it...
     */
 
     subject = cupsNotifySubject(lang, msg);
@@ -166,7 +286,7 @@ main(int  argc,				/* I - Number of command-line arguments */
     fprintf(stderr, "DEBUG: text=\"%s\"\n", text);
 
     if (subject && text)
-      email_message(argv[1] + 7, subject, text);
+      queue_message(recipient + 7, reply_to, subject, text);
     else
     {
       fputs("ERROR: Missing attributes in event notification!\n", stderr);
@@ -188,18 +308,75 @@ main(int  argc,				/* I - Number of command-line arguments */
 }
 
 
+/*
+ * 'append_text()' - Append text to a pending message.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+append_text(mailto_digest_t *digest,	/* I - Pending message */
+            const char      *s)		/* I - Text to append */
+{
+  size_t	len = strlen(s);	/* Length of text */
+
+
+  if (digest->textlen + len >= digest->textsize)
+  {
+    size_t	size = 2 * digest->textsize + len + 1;
+					/* New size of buffer */
+    char	*text;			/* New buffer */
+
+    if ((text = realloc(digest->text, size)) == NULL)
+      return (0);
+
+    digest->text     = text;
+    digest->textsize = size;
+  }
+
+  memcpy(digest->text + digest->textlen, s, len + 1);
+  digest->textlen += len;
+
+  return (1);
+}
+
+
+/*
+ * 'compare_digests()' - Compare two pending messages.
+ */
+
+int					/* O - Result of comparison */
+compare_digests(mailto_digest_t *a,	/* I - First message */
+                mailto_digest_t *b)	/* I - Second message */
+{
+  int	result;				/* Result of comparison */
+
+
+  if ((result = strcmp(a->to, b->to)) == 0)
+    result = strcmp(a->reply_to, b->reply_to);
+
+  return (result);
+}
+
+
 /*
  * 'email_message()' - Email a notification message.
+ *
+ * Returns 0 when the mail server could not be reached or reported a
+ * temporary failure, so that the message can be sent again later.
  */
 
-void
+int					/* O - 1 if handled, 0 to retry later */
 email_message(const char *to,		/* I - Recipient of message */
+              const char *reply_to,	/* I - Reply-To address or "" */
               const char *subject,	/* I - Subject of message */
 	      const char *text)		/* I - Text of message */
 {
   cups_file_t	*fp;			/* Pipe/socket to mail server */
   const char	*nl;			/* Newline to use */
   char		response[1024];		/* SMTP response buffer */
+  int		i,			/* Looping var */
+		code = 0,		/* SMTP response code */
+		temp,			/* Response code for pipelined command */
+		reused;			/* Reusing an open SMTP session? */
 
 
  /*
@@ -215,73 +392,77 @@ email_message(const char *to,		/* I - Recipient of message */
     fp = pipe_sendmail(to);
 
     if (!fp)
-      return;
+      return (0);
 
     nl = "\n";
   }
   else
   {
    /*
-    * Use an SMTP server...
+    * Use an SMTP server, reusing the session from the previous message if
+    * possible.  If the server closed an idle session we reconnect once...
     */
 
-    char	hostbuf[1024];		/* Local hostname */
-
+    reused = mailtoSMTP != NULL;
 
-    if (strchr(mailtoSMTPServer, ':'))
+    do
     {
-      fp = cupsFileOpen(mailtoSMTPServer, "s");
-    }
-    else
-    {
-      char	spec[1024];		/* Host:service spec */
+      if (!mailtoSMTP && !smtp_open())
+        return (0);
 
+      fp = mailtoSMTP;
 
-      snprintf(spec, sizeof(spec), "%s:smtp", mailtoSMTPServer);
-      fp = cupsFileOpen(spec, "s");
-    }
+      if (mailtoSMTPPipelining)
+      {
+       /*
+	* Send the envelope in one go and then collect the responses...
+	*/
+
+	cupsFilePrintf(fp, "MAIL FROM:%s\r\nRCPT TO:%s\r\nDATA\r\n", mailtoFrom, to);
+	cupsFileFlush(fp);
+	fprintf(stderr, "DEBUG: >>> MAIL FROM:%s, RCPT TO:%s, DATA\n", mailtoFrom, to);
+
+	for (i = 0, code = 354; i < 3; i ++)
+	{
+	  if ((temp = smtp_response(response, sizeof(response), NULL)) == 0)
+	  {
+	    code = 0;
+	    break;
+	  }
+	  else if (code < 400)
+	    code = temp;
+	}
+      }
+      else
+      {
+	cupsFilePrintf(fp, "MAIL FROM:%s\r\n", mailtoFrom);
+	cupsFileFlush(fp);
+	fprintf(stderr, "DEBUG: >>> MAIL FROM:%s\n", mailtoFrom);
+
+	if ((code = smtp_response(response, sizeof(response), NULL)) > 0 && code < 400)
+	{
+	  cupsFilePrintf(fp, "RCPT TO:%s\r\n", to);
+	  cupsFileFlush(fp);
+	  fprintf(stderr, "DEBUG: >>> RCPT TO:%s\n", to);
+
+	  if ((code = smtp_response(response, sizeof(response), NULL)) < 400)
+	  {
+	    cupsFilePuts(fp, "DATA\r\n");
+	    cupsFileFlush(fp);
+	    fputs("DEBUG: DATA\n", stderr);
+
+	    code = smtp_response(response, sizeof(response), NULL);
+	  }
+	}
+      }
 
-    if (!fp)
-    {
-      fprintf(stderr, "ERROR: Unable to connect to SMTP server \"%s\"!\n",
-              mailtoSMTPServer);
-      return;
+      if (code == 0 && reused)
+        smtp_close(0);
     }
+    while (code == 0 && reused --);
 
-    fprintf(stderr, "DEBUG: Connected to \"%s\"...\n", mailtoSMTPServer);
-
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
+    if (code == 0 || code >= 400)
       goto smtp_error;
-    fprintf(stderr, "DEBUG: <<< %s\n", response);
-
-    cupsFilePrintf(fp, "HELO %s\r\n",
-                   httpGetHostname(NULL, hostbuf, sizeof(hostbuf)));
-    fprintf(stderr, "DEBUG: >>> HELO %s\n", hostbuf);
-
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
-      goto smtp_error;
-    fprintf(stderr, "DEBUG: <<< %s\n", response);
-
-    cupsFilePrintf(fp, "MAIL FROM:%s\r\n", mailtoFrom);
-    fprintf(stderr, "DEBUG: >>> MAIL FROM:%s\n", mailtoFrom);
-
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
-      goto smtp_error;
-    fprintf(stderr, "DEBUG: <<< %s\n", response);
-
-    cupsFilePrintf(fp, "RCPT TO:%s\r\n", to);
-    fprintf(stderr, "DEBUG: >>> RCPT TO:%s\n", to);
-
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
-      goto smtp_error;
-    fprintf(stderr, "DEBUG: <<< %s\n", response);
-
-    cupsFilePuts(fp, "DATA\r\n");
-    fputs("DEBUG: DATA\n", stderr);
-
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
-      goto smtp_error;
-    fprintf(stderr, "DEBUG: <<< %s\n", response);
 
     nl = "\r\n";
   }
@@ -293,10 +474,10 @@ email_message(const char *to,		/* I - Recipient of message */
   cupsFilePrintf(fp, "Date: %s%s", httpGetDateString(time(NULL)), nl);
   cupsFilePrintf(fp, "From: %s%s", mailtoFrom, nl);
   cupsFilePrintf(fp, "Subject: %s %s%s", mailtoSubject, subject, nl);
-  if (mailtoReplyTo[0])
+  if (reply_to[0])
   {
-    cupsFilePrintf(fp, "Sender: %s%s", mailtoReplyTo, nl);
-    cupsFilePrintf(fp, "Reply-To: %s%s", mailtoReplyTo, nl);
+    cupsFilePrintf(fp, "Sender: %s%s", reply_to, nl);
+    cupsFilePrintf(fp, "Reply-To: %s%s", reply_to, nl);
   }
   cupsFilePrintf(fp, "To: %s%s", to, nl);
   if (mailtoCc[0])
@@ -345,37 +526,136 @@ email_message(const char *to,		/* I - Recipient of message */
         fprintf(stderr, "ERROR: Sendmail command crashed on signal %d!\n",
 	        WTERMSIG(status));
     }
+
+    return (1);
   }
+
+ /*
+  * Finish up the SMTP submission and keep the session open for the next
+  * message...
+  */
+
+  cupsFileFlush(fp);
+
+  if ((code = smtp_response(response, sizeof(response), NULL)) > 0 && code < 400)
+    return (1);
+
+ /*
+  * Process SMTP errors here - permanent (5xx) errors are reported and the
+  * message discarded, anything else is retried later...
+  */
+
+  smtp_error:
+
+  if (code >= 500)
+    fprintf(stderr, "ERROR: Unable to send message to \"%s\": %s\n", to, response);
   else
+    fprintf(stderr, "ERROR: Unable to send message to \"%s\", will retry.\n", to);
+
+  smtp_close(code > 0);
+
+  return (code >= 500);
+}
+
+
+/*
+ * 'flush_messages()' - Send pending messages that are due.
+ *
+ * Messages are due "DigestInterval" seconds after their first event, or
+ * right away once they reach "DigestLimit" events.  A slow or failing mail
+ * server adds a growing delay so that more events are collected into each
+ * message instead of piling up.
+ */
+
+time_t					/* O - Time when the next message is due or 0 */
+flush_messages(int force)		/* I - Send everything now? */
+{
+  mailto_digest_t	*digest;	/* Current message */
+  time_t		now,		/* Current time */
+			due,		/* When message is due */
+			next = 0,	/* Next message due */
+			start;		/* Start of send */
+  int			sent;		/* Was the message handled? */
+  char			subject[1024];	/* Subject for message */
+
+
+  now = time(NULL);
+
+  for (digest = (mailto_digest_t *)cupsArrayFirst(mailtoDigests); digest; digest = (mailto_digest_t *)cupsArrayNext(mailtoDigests))
   {
+    due = digest->first + mailtoDelay;
+    if (digest->count < mailtoDigestLimit)
+      due += mailtoDigestInterval;
+
+    if (!force && due > now)
+    {
+      if (!next || due < next)
+        next = due;
+
+      continue;
+    }
+
    /*
-    * Finish up the SMTP submission and close the connection...
+    * Send the message...
     */
 
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
-      goto smtp_error;
-    fprintf(stderr, "DEBUG: <<< %s\n", response);
+    if (digest->count > 1)
+      snprintf(subject, sizeof(subject), "%s (%d notifications)", digest->subject, digest->count + digest->dropped);
+    else
+      strlcpy(subject, digest->subject, sizeof(subject));
+
+    if (digest->dropped)
+    {
+      char	note[256];		/* Note about dropped events */
+
+      snprintf(note, sizeof(note), "\n\n%d more notifications were not included.", digest->dropped);
+      append_text(digest, note);
+      digest->dropped = 0;
+    }
+
+    start = time(NULL);
+    sent  = email_message(digest->to, digest->reply_to, subject, digest->text);
+    now   = time(NULL);
 
    /*
-    * Process SMTP errors here...
+    * Adjust the backoff delay...
     */
 
-    smtp_error:
-
-    cupsFilePuts(fp, "QUIT\r\n");
-    fputs("DEBUG: QUIT\n", stderr);
+    if (!sent || (now - start) >= MAILTO_SLOW_TIME)
+    {
+      if (!mailtoDelay)
+        mailtoDelay = sent ? MAILTO_SLOW_TIME : MAILTO_RETRY_DELAY;
+      else if ((mailtoDelay *= 2) > MAILTO_MAX_DELAY)
+        mailtoDelay = MAILTO_MAX_DELAY;
 
-    if (!cupsFileGets(fp, response, sizeof(response)) || atoi(response) >= 500)
-      fprintf(stderr, "ERROR: Got \"%s\" trying to QUIT connection.\n",
-              response);
+      fprintf(stderr, "DEBUG: Mail server is slow or unavailable, delaying messages by %d seconds.\n", mailtoDelay);
+    }
     else
-      fprintf(stderr, "DEBUG: <<< %s\n", response);
+      mailtoDelay /= 2;
 
-    cupsFileClose(fp);
+    if (!sent && !force)
+    {
+     /*
+      * Try again later...
+      */
 
-    fprintf(stderr, "DEBUG: Closed connection to \"%s\"...\n",
-            mailtoSMTPServer);
+      due = now + mailtoDelay;
+      if (!next || due < next)
+        next = due;
+
+      break;
+    }
+
+    cupsArrayRemove(mailtoDigests, digest);
+
+    free(digest->to);
+    free(digest->reply_to);
+    free(digest->subject);
+    free(digest->text);
+    free(digest);
   }
+
+  return (next);
 }
 
 
@@ -400,6 +680,9 @@ load_configuration(void)
 
   mailtoCc[0] = '\0';
 
+  mailtoDigestInterval = 0;
+  mailtoDigestLimit    = 100;
+
   if ((server_admin = getenv("SERVER_ADMIN")) != NULL)
     strlcpy(mailtoFrom, server_admin, sizeof(mailtoFrom));
   else
@@ -447,6 +730,16 @@ load_configuration(void)
 
     if (!_cups_strcasecmp(line, "Cc"))
       strlcpy(mailtoCc, value, sizeof(mailtoCc));
+    else if (!_cups_strcasecmp(line, "DigestInterval"))
+    {
+      if ((mailtoDigestInterval = atoi(value)) < 0)
+        mailtoDigestInterval = 0;
+    }
+    else if (!_cups_strcasecmp(line, "DigestLimit"))
+    {
+      if ((mailtoDigestLimit = atoi(value)) < 1)
+        mailtoDigestLimit = 1;
+    }
     else if (!_cups_strcasecmp(line, "From"))
       strlcpy(mailtoFrom, value, sizeof(mailtoFrom));
     else if (!_cups_strcasecmp(line, "Sendmail"))
@@ -631,3 +924,233 @@ print_attributes(ipp_t *ipp,		/* I - IPP request */
 	    ippTagString(attr->value_tag), buffer);
   }
 }
+
+
+/*
+ * 'queue_message()' - Queue a notification message for a recipient.
+ *
+ * Events for the same recipient are collected into a single message until
+ * it is sent by flush_messages().
+ */
+
+void
+queue_message(const char *to,		/* I - Recipient of message */
+              const char *reply_to,	/* I - Reply-To address or "" */
+              const char *subject,	/* I - Subject of event */
+	      const char *text)		/* I - Text of event */
+{
+  mailto_digest_t	key,		/* Search key */
+			*digest;	/* Pending message */
+
+
+  if (!mailtoDigests)
+    mailtoDigests = cupsArrayNew((cups_array_func_t)compare_digests, NULL);
+
+  key.to       = (char *)to;
+  key.reply_to = (char *)reply_to;
+
+  if ((digest = (mailto_digest_t *)cupsArrayFind(mailtoDigests, &key)) == NULL)
+  {
+   /*
+    * First event for this recipient...
+    */
+
+    if ((digest = calloc(1, sizeof(mailto_digest_t))) == NULL)
+    {
+      fprintf(stderr, "ERROR: Unable to queue message: %s\n", strerror(errno));
+      return;
+    }
+
+    digest->to       = strdup(to);
+    digest->reply_to = strdup(reply_to);
+    digest->subject  = strdup(subject);
+    digest->first    = time(NULL);
+
+    if (!digest->to || !digest->reply_to || !digest->subject || !append_text(digest, text))
+    {
+      fprintf(stderr, "ERROR: Unable to queue message: %s\n", strerror(errno));
+      free(digest->to);
+      free(digest->reply_to);
+      free(digest->subject);
+      free(digest->text);
+      free(digest);
+      return;
+    }
+
+    digest->count = 1;
+
+    cupsArrayAdd(mailtoDigests, digest);
+    return;
+  }
+
+  if (digest->count >= mailtoDigestLimit)
+  {
+    digest->dropped ++;
+    return;
+  }
+
+  if (digest->count == 1)
+  {
+   /*
+    * Second event, put the subject of the first event in front of its
+    * text...
+    */
+
+    char	*first = digest->text;	/* Text of first event */
+
+    digest->text     = NULL;
+    digest->textlen  = 0;
+    digest->textsize = 0;
+
+    if (!append_text(digest, digest->subject) || !append_text(digest, "\n") || !append_text(digest, first))
+    {
+      free(digest->text);
+      digest->text     = first;
+      digest->textlen  = strlen(first);
+      digest->textsize = digest->textlen + 1;
+      digest->dropped ++;
+      return;
+    }
+
+    free(first);
+  }
+
+  if (append_text(digest, "\n\n") && append_text(digest, subject) && append_text(digest, "\n") && append_text(digest, text))
+    digest->count ++;
+  else
+    digest->dropped ++;
+}
+
+
+/*
+ * 'smtp_close()' - Close the SMTP session.
+ */
+
+void
+smtp_close(int quit)			/* I - Send QUIT command? */
+{
+  char	response[1024];			/* SMTP response buffer */
+
+
+  if (quit)
+  {
+    cupsFilePuts(mailtoSMTP, "QUIT\r\n");
+    cupsFileFlush(mailtoSMTP);
+    fputs("DEBUG: QUIT\n", stderr);
+
+    if (smtp_response(response, sizeof(response), NULL) >= 500)
+      fprintf(stderr, "ERROR: Got \"%s\" trying to QUIT connection.\n",
+              response);
+  }
+
+  cupsFileClose(mailtoSMTP);
+  mailtoSMTP = NULL;
+
+  fprintf(stderr, "DEBUG: Closed connection to \"%s\"...\n",
+          mailtoSMTPServer);
+}
+
+
+/*
+ * 'smtp_open()' - Open a SMTP session.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+smtp_open(void)
+{
+  char	hostbuf[1024],			/* Local hostname */
+	response[1024];			/* SMTP response buffer */
+  int	code;				/* SMTP response code */
+
+
+  if (strchr(mailtoSMTPServer, ':'))
+  {
+    mailtoSMTP = cupsFileOpen(mailtoSMTPServer, "s");
+  }
+  else
+  {
+    char	spec[1024];		/* Host:service spec */
+
+
+    snprintf(spec, sizeof(spec), "%s:smtp", mailtoSMTPServer);
+    mailtoSMTP = cupsFileOpen(spec, "s");
+  }
+
+  if (!mailtoSMTP)
+  {
+    fprintf(stderr, "ERROR: Unable to connect to SMTP server \"%s\"!\n",
+            mailtoSMTPServer);
+    return (0);
+  }
+
+  fprintf(stderr, "DEBUG: Connected to \"%s\"...\n", mailtoSMTPServer);
+
+  if ((code = smtp_response(response, sizeof(response), NULL)) == 0 || code >= 400)
+    goto smtp_error;
+
+ /*
+  * Say hello, using EHLO to see whether the server supports pipelining...
+  */
+
+  httpGetHostname(NULL, hostbuf, sizeof(hostbuf));
+
+  cupsFilePrintf(mailtoSMTP, "EHLO %s\r\n", hostbuf);
+  cupsFileFlush(mailtoSMTP);
+  fprintf(stderr, "DEBUG: >>> EHLO %s\n", hostbuf);
+
+  mailtoSMTPPipelining = 0;
+
+  if ((code = smtp_response(response, sizeof(response), &mailtoSMTPPipelining)) >= 500)
+  {
+    cupsFilePrintf(mailtoSMTP, "HELO %s\r\n", hostbuf);
+    cupsFileFlush(mailtoSMTP);
+    fprintf(stderr, "DEBUG: >>> HELO %s\n", hostbuf);
+
+    code = smtp_response(response, sizeof(response), NULL);
+  }
+
+  if (code == 0 || code >= 400)
+    goto smtp_error;
+
+  return (1);
+
+ /*
+  * Process SMTP errors here...
+  */
+
+  smtp_error:
+
+  fprintf(stderr, "ERROR: SMTP server \"%s\" did not accept connection: %s\n", mailtoSMTPServer, code ? response : "closed");
+
+  smtp_close(code > 0);
+
+  return (0);
+}
+
+
+/*
+ * 'smtp_response()' - Read a (multi-line) SMTP response.
+ */
+
+int					/* O - Response code or 0 on error */
+smtp_response(char   *response,		/* I - Response buffer */
+              size_t responsesize,	/* I - Size of response buffer */
+	      int    *pipelining)	/* O - PIPELINING extension seen, if not NULL */
+{
+  do
+  {
+    if (!cupsFileGets(mailtoSMTP, response, responsesize))
+    {
+      *response = '\0';
+      return (0);
+    }
+
+    fprintf(stderr, "DEBUG: <<< %s\n", response);
+
+    if (pipelining && strlen(response) >= 14 && !_cups_strncasecmp(response + 4, "PIPELINING", 10) && (!response[14] || isspace(response[14] & 255)))
+      *pipelining = 1;
+  }
+  while (strlen(response) > 3 && response[3] == '-');
+
+  return (atoi(response));
+}
@@ -13,6 +13,7 @@
 
 #include <cups/cups.h>
 #include <sys/stat.h>
+#include <signal.h>
 #include <cups/language.h>
 #include <cups/string-private.h>
 #include <cups/array.h>
@@ -20,6 +21,13 @@
 #include <cups/ipp-private.h>	/* TODO: Update so we don't need this */
 
 
+/*
+ * Constants...
+ */
+
+#define RSS_SAVE_DELAY	5		/* Seconds to coalesce changes before saving */
+
+
 /*
  * Structures...
  */
@@ -39,6 +47,8 @@ typedef struct _cups_rss_s		/**** RSS message data ****/
  */
 
 static char		*rss_password;	/* Password for remote RSS */
+static int		rss_terminate = 0;
+					/* Save and exit? */
 
 
 /*
@@ -54,6 +64,7 @@ static _cups_rss_t	*new_message(int sequence_number, char *subject,
 static const char	*password_cb(const char *prompt);
 static int		save_rss(cups_array_t *rss, const char *filename,
 			         const char *baseurl);
+static void		sigterm_handler(int sig);
 static char		*xml_escape(const char *s);
 
 
@@ -97,13 +108,24 @@ main(int  argc,				/* I - Number of command-line arguments */
   fd_set	input;			/* Input set for select() */
   struct timeval timeout;		/* Timeout for select() */
   int		changed;		/* Has the RSS data changed? */
+  time_t	save_time;		/* When to save changes */
+  int		done;			/* Out of events? */
   int		exit_status;		/* Exit status */
+  struct sigaction action;		/* POSIX signal action */
 
 
   fprintf(stderr, "DEBUG: argc=%d\n", argc);
   for (i = 0; i < argc; i ++)
     fprintf(stderr, "DEBUG: argv[%d]=\"%s\"\n", i, argv[i]);
 
+ /*
+  * Catch SIGTERM so that pending changes are saved before we exit...
+  */
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = sigterm_handler;
+  sigaction(SIGTERM, &action, NULL);
+
  /*
   * See whether we are publishing this RSS feed locally or remotely...
   */
@@ -218,7 +240,8 @@ main(int  argc,				/* I - Number of command-line arguments */
 
   load_rss(rss, filename);
 
-  changed = cupsArrayCount(rss) == 0;
+  changed   = cupsArrayCount(rss) == 0;
+  save_time = 0;
 
  /*
   * Localize for the user's chosen language...
@@ -227,12 +250,17 @@ main(int  argc,				/* I - Number of command-line arguments */
   language = cupsLangDefault();
 
  /*
-  * Read events and update the RSS file until we are out of events.
+  * Read events and update the RSS file until we are out of events.  Changes
+  * are collected for up to RSS_SAVE_DELAY seconds so that bursts of events
+  * only rewrite the file once...
   */
 
-  for (exit_status = 0, event = NULL;;)
+  for (exit_status = 0, done = 0, event = NULL;;)
   {
-    if (changed)
+    if (rss_terminate)
+      done = 1;
+
+    if (changed && (done || time(NULL) >= save_time))
     {
      /*
       * Save the messages to the file again, uploading as needed...
@@ -263,13 +291,27 @@ main(int  argc,				/* I - Number of command-line arguments */
 
 	changed = 0;
       }
+      else
+        save_time = time(NULL) + RSS_SAVE_DELAY;
     }
 
+    if (done)
+      break;
+
    /*
-    * Wait up to 30 seconds for an event...
+    * Wait up to 30 seconds for an event, or until it is time to save the
+    * pending changes...
     */
 
-    timeout.tv_sec  = 30;
+    if (changed)
+    {
+      timeout.tv_sec = save_time - time(NULL);
+      if (timeout.tv_sec < 0)
+        timeout.tv_sec = 0;
+    }
+    else
+      timeout.tv_sec = 30;
+
     timeout.tv_usec = 0;
 
     FD_ZERO(&input);
@@ -279,6 +321,9 @@ main(int  argc,				/* I - Number of command-line arguments */
       continue;
     else if (!FD_ISSET(0, &input))
     {
+      if (changed)
+        continue;
+
       fprintf(stderr, "DEBUG: %s is bored, exiting...\n", argv[1]);
       break;
     }
@@ -298,7 +343,10 @@ main(int  argc,				/* I - Number of command-line arguments */
       fputs("DEBUG: ippReadFile() returned IPP_ERROR!\n", stderr);
 
     if (state <= IPP_IDLE)
-      break;
+    {
+      done = 1;
+      continue;
+    }
 
    /*
     * Collect the info from the event...
@@ -342,28 +390,34 @@ main(int  argc,				/* I - Number of command-line arguments */
         fprintf(stderr, "ERROR: Unable to create message: %s\n",
 	        strerror(errno));
         exit_status = 1;
-	break;
+	done        = 1;
       }
+      else
+      {
+       /*
+	* Add it to the array...
+	*/
 
-     /*
-      * Add it to the array...
-      */
-
-      cupsArrayAdd(rss, msg);
+	cupsArrayAdd(rss, msg);
 
-      changed = 1;
+	if (!changed)
+	{
+	  changed   = 1;
+	  save_time = time(NULL) + RSS_SAVE_DELAY;
+	}
 
-     /*
-      * Trim the array as needed...
-      */
+       /*
+	* Trim the array as needed...
+	*/
 
-      while (cupsArrayCount(rss) > max_events)
-      {
-        msg = cupsArrayFirst(rss);
+	while (cupsArrayCount(rss) > max_events)
+	{
+	  msg = cupsArrayFirst(rss);
 
-	cupsArrayRemove(rss, msg);
+	  cupsArrayRemove(rss, msg);
 
-	delete_message(msg);
+	  delete_message(msg);
+	}
       }
     }
 
@@ -659,6 +713,19 @@ save_rss(cups_array_t *rss,		/* I - RSS messages */
 }
 
 
+/*
+ * 'sigterm_handler()' - Handle SIGTERM by saving pending changes and exiting.
+ */
+
+static void
+sigterm_handler(int sig)		/* I - Signal number (unused) */
+{
+  (void)sig;
+
+  rss_terminate = 1;
+}
+
+
 /*
  * 'xml_escape()' - Copy a string, escaping &, <, and > as needed.
  */
@@ -34,6 +34,7 @@ typedef enum
 #if defined(__APPLE__) && defined(CUPS_BUNDLEDIR)
 static void	apple_add_message(CFStringRef key, CFStringRef val, ppdcCatalog *c);
 #endif /* __APPLE__ && CUPS_BUNDLEDIR */
+static int	compare_messages(ppdcMessage *a, ppdcMessage *b);
 static int	get_utf8(char *&ptr);
 static int	get_utf16(cups_file_t *fp, ppdc_cs_t &cs);
 static int	put_utf8(int ch, char *&ptr, char *end);
@@ -45,7 +46,9 @@ static int	put_utf16(cups_file_t *fp, int ch);
 //
 
 ppdcCatalog::ppdcCatalog(const char *l,	// I - Locale
-                         const char *f)	// I - Message catalog file
+                         const char *f,	// I - Message catalog file
+			 bool       defer)
+					// I - Load messages on first use?
   : ppdcShared()
 {
   PPDC_NEW;
@@ -53,6 +56,122 @@ ppdcCatalog::ppdcCatalog(const char *l,	// I - Locale
   locale   = new ppdcString(l);
   filename = new ppdcString(f);
   messages = new ppdcArray();
+  index    = cupsArrayNew((cups_array_func_t)compare_messages, NULL);
+  pending  = new ppdcString(f);
+  loaded   = false;
+
+  if (!defer)
+    load();
+}
+
+
+
+//
+// 'ppdcCatalog::~ppdcCatalog()' - Destroy a shared message catalog.
+//
+
+ppdcCatalog::~ppdcCatalog()
+{
+  PPDC_DELETE;
+
+  locale->release();
+  filename->release();
+  messages->release();
+
+  if (pending)
+    pending->release();
+
+  cupsArrayDelete(index);
+}
+
+
+//
+// 'ppdcCatalog::add_message()' - Add a new message.
+//
+
+void
+ppdcCatalog::add_message(
+    const char *id,			// I - Message ID to add
+    const char *string)			// I - Translation string
+{
+  ppdcMessage	*m;			// Current message
+  char		text[1024];		// Text to translate
+
+
+  // Range check input...
+  if (!id)
+    return;
+
+  // Make sure messages loaded later do not replace this one...
+  load();
+
+  // Verify that we don't already have the message ID...
+  ppdcMessage	key(id, NULL);		// Search key
+
+  if ((m = (ppdcMessage *)cupsArrayFind(index, &key)) != NULL)
+  {
+    if (string)
+    {
+      m->string->release();
+      m->string = new ppdcString(string);
+    }
+    return;
+  }
+
+  // Add the message...
+  if (!string)
+  {
+    snprintf(text, sizeof(text), "TRANSLATE %s", id);
+    string = text;
+  }
+
+  m = new ppdcMessage(id, string);
+
+  messages->add(m);
+  cupsArrayAdd(index, m);
+}
+
+
+//
+// 'ppdcCatalog::find_message()' - Find a message in a catalog...
+//
+
+const char *				// O - Message text
+ppdcCatalog::find_message(
+    const char *id)			// I - Message ID
+{
+  ppdcMessage	*m;			// Current message
+
+
+  if (!*id)
+    return (id);
+
+  load();
+
+  ppdcMessage	key(id, NULL);		// Search key
+
+  if ((m = (ppdcMessage *)cupsArrayFind(index, &key)) != NULL)
+    return (m->string->value);
+
+  return (id);
+}
+
+
+//
+// 'ppdcCatalog::load()' - Load the base messages for the locale and the
+//                         translation file, if not already loaded.
+//
+
+void
+ppdcCatalog::load()
+{
+  const char	*l = locale->value;	// Locale name
+
+
+  if (loaded)
+    return;
+
+  loaded = true;
 
   if (l && strcmp(l, "en"))
   {
@@ -140,88 +259,12 @@ ppdcCatalog::ppdcCatalog(const char *l,	// I - Locale
 #endif /* __APPLE__ && CUPS_BUNDLEDIR */
   }
 
-  if (f && *f)
-    load_messages(f);
-}
 
+  if (pending->value && *pending->value)
+    load_messages(pending->value);
 
-//
-// 'ppdcCatalog::~ppdcCatalog()' - Destroy a shared message catalog.
-//
-
-ppdcCatalog::~ppdcCatalog()
-{
-  PPDC_DELETE;
-
-  locale->release();
-  filename->release();
-  messages->release();
-}
-
-
-//
-// 'ppdcCatalog::add_message()' - Add a new message.
-//
-
-void
-ppdcCatalog::add_message(
-    const char *id,			// I - Message ID to add
-    const char *string)			// I - Translation string
-{
-  ppdcMessage	*m;			// Current message
-  char		text[1024];		// Text to translate
-
-
-  // Range check input...
-  if (!id)
-    return;
-
-  // Verify that we don't already have the message ID...
-  for (m = (ppdcMessage *)messages->first();
-       m;
-       m = (ppdcMessage *)messages->next())
-    if (!strcmp(m->id->value, id))
-    {
-      if (string)
-      {
-        m->string->release();
-	m->string = new ppdcString(string);
-      }
-      return;
-    }
-
-  // Add the message...
-  if (!string)
-  {
-    snprintf(text, sizeof(text), "TRANSLATE %s", id);
-    string = text;
-  }
-
-  messages->add(new ppdcMessage(id, string));
-}
-
-
-//
-// 'ppdcCatalog::find_message()' - Find a message in a catalog...
-//
-
-const char *				// O - Message text
-ppdcCatalog::find_message(
-    const char *id)			// I - Message ID
-{
-  ppdcMessage	*m;			// Current message
-
-
-  if (!*id)
-    return (id);
-
-  for (m = (ppdcMessage *)messages->first();
-       m;
-       m = (ppdcMessage *)messages->next())
-    if (!strcmp(m->id->value, id))
-      return (m->string->value);
-
-  return (id);
+  pending->release();
+  pending = NULL;
 }
 
 
@@ -241,6 +284,9 @@ ppdcCatalog::load_messages(
   int		linenum;		// Line number
 
 
+  // Load any pending messages first so these take precedence...
+  load();
+
   // Open the message catalog file...
   if ((fp = cupsFileOpen(f, "r")) == NULL)
     return (-1);
@@ -525,6 +571,8 @@ ppdcCatalog::save_messages(
   int		ch;			// Current character
 
 
+  load();
+
   // Open the file...
   if ((ptr = (char *)strrchr(f, '.')) == NULL)
     return (-1);
@@ -675,6 +723,18 @@ apple_add_message(CFStringRef key,	// I - Localization key
 #endif /* __APPLE__ && CUPS_BUNDLEDIR */
 
 
+//
+// 'compare_messages()' - Compare two messages by ID.
+//
+
+static int				// O - Result of comparison
+compare_messages(ppdcMessage *a,	// I - First message
+                 ppdcMessage *b)	// I - Second message
+{
+  return (strcmp(a->id->value, b->id->value));
+}
+
+
 //
 // 'get_utf8()' - Get a UTF-8 character.
 //
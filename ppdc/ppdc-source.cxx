@@ -25,6 +25,13 @@
 #endif // !_WIN32
 
 
+//
+// Local functions...
+//
+
+static int	compare_sizes(ppdcMediaSize *a, ppdcMediaSize *b);
+
+
 //
 // Class globals...
 //
@@ -55,9 +62,12 @@ ppdcSource::ppdcSource(const char  *f,	// I - File to read
   filename      = new ppdcString(f);
   base_fonts    = new ppdcArray();
   drivers       = new ppdcArray();
+  files         = new ppdcArray();
   po_files      = new ppdcArray();
   sizes         = new ppdcArray();
   vars          = new ppdcArray();
+  size_index    = NULL;
+  size_count    = 0;
   cond_state    = PPDC_COND_NORMAL;
   cond_current  = cond_stack;
   cond_stack[0] = PPDC_COND_NORMAL;
@@ -105,9 +115,12 @@ ppdcSource::~ppdcSource()
   filename->release();
   base_fonts->release();
   drivers->release();
+  files->release();
   po_files->release();
   sizes->release();
   vars->release();
+
+  cupsArrayDelete(size_index);
 }
 
 
@@ -256,11 +269,25 @@ ppdcSource::find_size(const char *s)	// I - Size name
   ppdcMediaSize	*m;			// Current media size
 
 
-  for (m = (ppdcMediaSize *)sizes->first(); m; m = (ppdcMediaSize *)sizes->next())
-    if (!_cups_strcasecmp(s, m->name->value))
-      return (m);
+  // Drivers look up sizes for every MediaSize line, so keep an index of the
+  // predefined sizes and rebuild it when more sizes have been added...
+  if (!size_index || size_count != sizes->count)
+  {
+    cupsArrayDelete(size_index);
 
-  return (NULL);
+    size_index = cupsArrayNew((cups_array_func_t)compare_sizes, NULL);
+    size_count = sizes->count;
+
+    // Only index the first of any duplicate names, like the linear search...
+    for (m = (ppdcMediaSize *)sizes->first(); m; m = (ppdcMediaSize *)sizes->next())
+      if (!cupsArrayFind(size_index, m))
+        cupsArrayAdd(size_index, m);
+  }
+
+  ppdcMediaSize key(s, NULL, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, NULL, NULL);
+					// Size to look up
+
+  return ((ppdcMediaSize *)cupsArrayFind(size_index, &key));
 }
 
 
@@ -1666,8 +1693,11 @@ ppdcSource::get_po(ppdcFile *fp)	// I - File to read
   if (!poname[0] ||
       find_include(poname, basedir, pofilename, sizeof(pofilename)))
   {
-    // Found it, so load it...
-    cat = new ppdcCatalog(locale, pofilename);
+    // Found it, load it when a PPD file needs it...
+    cat = new ppdcCatalog(locale, pofilename, true);
+
+    if (pofilename[0])
+      files->add(new ppdcString(pofilename));
 
     // Reset the filename to the name supplied by the user...
     cat->filename->release();
@@ -2358,6 +2388,7 @@ ppdcSource::read_file(const char  *f,	// I - File to read
                       cups_file_t *ffp)	// I - File pointer to use
 {
   ppdcFile *fp = new ppdcFile(f, ffp);
+  files->add(new ppdcString(f));
   scan_file(fp);
   delete fp;
 
@@ -2590,6 +2621,7 @@ ppdcSource::scan_file(ppdcFile   *fp,	// I - File to read
       {
 	// Open the include file, scan it, and then close it...
 	incfile = new ppdcFile(incname);
+	files->add(new ppdcString(incname));
 	scan_file(incfile, d, true);
 	delete incfile;
 
@@ -3798,3 +3830,15 @@ ppdcSource::write_file(const char *f)	// I - File to write
 
   return (0);
 }
+
+
+//
+// 'compare_sizes()' - Compare two media sizes by name.
+//
+
+static int				// O - Result of comparison
+compare_sizes(ppdcMediaSize *a,		// I - First size
+              ppdcMediaSize *b)		// I - Second size
+{
+  return (_cups_strcasecmp(a->name->value, b->name->value));
+}
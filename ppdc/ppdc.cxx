@@ -15,6 +15,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 
 //
@@ -33,6 +34,9 @@ main(int  argc,				// I - Number of command-line arguments
      char *argv[])			// I - Command-line arguments
 {
   int			i, j;		// Looping vars
+  int			index,		// Index of current driver
+			jobs,		// Number of worker processes
+			worker;		// Current worker process
   ppdcCatalog		*catalog;	// Message catalog
   const char		*outdir;	// Output directory
   ppdcSource		*src;		// PPD source file data
@@ -70,6 +74,7 @@ main(int  argc,				// I - Number of command-line arguments
   use_model_name  = 0;
   verbose         = 0;
   filenames       = cupsArrayNew((cups_array_func_t)_cups_strcasecmp, NULL);
+  jobs            = 1;
 
   for (i = 1; i < argc; i ++)
     if (argv[i][0] == '-')
@@ -140,6 +145,12 @@ main(int  argc,				// I - Number of command-line arguments
 	      outdir = argv[i];
 	      break;
 
+          case 'j' :			// Number of jobs...
+	      i ++;
+	      if (i >= argc || (jobs = atoi(argv[i])) < 1)
+        	usage();
+	      break;
+
           case 'l' :			// Language(s)...
 	      i ++;
 	      if (i >= argc)
@@ -258,13 +269,67 @@ main(int  argc,				// I - Number of command-line arguments
       }
     }
 
+    // Start worker processes as needed; each one writes every Nth driver
+    // from its own copy of the source data...
+    worker = 0;
+
+    if ((size_t)jobs > src->drivers->count)
+      jobs = (int)src->drivers->count;
+
+    if (jobs > 1)
+    {
+      int	pid = 0,		// Process ID
+		status,			// Exit status of worker
+		failed = 0;		// Did any worker fail?
+
+
+      fflush(stdout);
+      fflush(stderr);
+
+      for (worker = 0; worker < jobs; worker ++)
+      {
+        if ((pid = fork()) == 0)
+	  break;
+	else if (pid < 0)
+	{
+	  _cupsLangPrintf(stderr, _("ppdc: Unable to start worker process: %s"),
+			  strerror(errno));
+	  failed = 1;
+	  break;
+	}
+      }
+
+      if (pid != 0)
+      {
+        // Parent process waits for the workers to finish...
+	while ((pid = wait(&status)) != 0)
+	{
+	  if (pid < 0)
+	  {
+	    if (errno == EINTR)
+	      continue;
+
+	    break;
+	  }
+
+	  if (!WIFEXITED(status) || WEXITSTATUS(status))
+	    failed = 1;
+	}
+
+	return (failed);
+      }
+    }
+
     // Write PPD files...
-    for (d = (ppdcDriver *)src->drivers->first();
+    for (d = (ppdcDriver *)src->drivers->first(), index = 0;
          d;
-	 d = (ppdcDriver *)src->drivers->next())
+	 d = (ppdcDriver *)src->drivers->next(), index ++)
     {
       if (do_test)
       {
+        if ((index % jobs) != worker)
+	  continue;
+
         // Test the PPD file for this driver...
 	int	pid,			// Process ID
 		fds[2];			// Pipe file descriptors
@@ -350,12 +415,20 @@ main(int  argc,				// I - Number of command-line arguments
 	  snprintf(filename, sizeof(filename), "%s/%s", outdir, pcfilename);
 
         if (cupsArrayFind(filenames, filename))
-	  _cupsLangPrintf(stderr,
-	                  _("ppdc: Warning - overlapping filename \"%s\"."),
-			  filename);
+	{
+	  if ((index % jobs) == worker)
+	    _cupsLangPrintf(stderr,
+			    _("ppdc: Warning - overlapping filename \"%s\"."),
+			    filename);
+	}
 	else
 	  cupsArrayAdd(filenames, strdup(filename));
 
+        // Every worker tracks all of the filenames but only writes its own
+	// drivers...
+        if ((index % jobs) != worker)
+	  continue;
+
 	fp = cupsFileOpen(filename, comp ? "w9" : "w");
 	if (!fp)
 	{
@@ -432,6 +505,8 @@ usage(void)
                           "message catalog."));
   _cupsLangPuts(stdout, _("  -d output-dir           Specify the output "
                           "directory."));
+  _cupsLangPuts(stdout, _("  -j jobs                 Write PPD files using "
+                          "multiple processes."));
   _cupsLangPuts(stdout, _("  -l lang[,lang,...]      Specify the output "
                           "language(s) (locale)."));
   _cupsLangPuts(stdout, _("  -m                      Use the ModelName value "
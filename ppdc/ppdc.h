@@ -14,6 +14,7 @@
 // Include necessary headers...
 //
 
+#  include <cups/array.h>
 #  include <cups/file.h>
 #  include <stdlib.h>
 
@@ -168,14 +169,18 @@ class ppdcCatalog			//// Translation catalog
   ppdcString	*locale;		// Name of locale
   ppdcString	*filename;		// Name of translation file
   ppdcArray	*messages;		// Array of translation messages
+  cups_array_t	*index;			// Messages sorted by ID
+  ppdcString	*pending;		// Translation file to load on first use
+  bool		loaded;			// Have the messages been loaded?
 
-  ppdcCatalog(const char *l, const char *f = 0);
+  ppdcCatalog(const char *l, const char *f = 0, bool defer = false);
   ~ppdcCatalog();
 
   PPDC_NAME("ppdcCatalog")
 
   void		add_message(const char *id, const char *string = NULL);
   const char	*find_message(const char *id);
+  void		load();
   int		load_messages(const char *f);
   int		save_messages(const char *f);
 };
@@ -464,9 +469,12 @@ class ppdcSource			//// Source File
   ppdcString	*filename;		// Filename
   ppdcArray	*base_fonts,		// Base fonts
 		*drivers,		// Printer drivers
+		*files,			// Files read (source, includes, catalogs)
 		*po_files,		// Message catalogs
 		*sizes,			// Predefined media sizes
 		*vars;			// Defined variables
+  cups_array_t	*size_index;		// Media sizes sorted by name
+  size_t	size_count;		// Number of sizes in index
   int		cond_state,		// Cummulative conditional state
 		*cond_current,		// Current #if state
 		cond_stack[101];	// #if state stack
@@ -53,17 +53,99 @@ typedef struct sockpeercred cupsd_ucred_t;
 #endif /* HAVE_SYS_UCRED_H */
 
 
+/*
+ * Local constants...
+ */
+
+#define CUPSD_AUTH_CACHE_LIFE	60	/* Seconds to remember Basic credentials */
+#define CUPSD_AUTH_CACHE_MAX	256	/* Maximum number of remembered users */
+#define CUPSD_GROUP_CACHE_LIFE	60	/* Seconds to remember group membership */
+#define CUPSD_GROUP_CACHE_MAX	1024	/* Maximum number of remembered lookups */
+#define CUPSD_GSS_COOKIE	"org.cups.gss"
+					/* Name of Negotiate session cookie */
+#define CUPSD_GSS_SESSION_MAX	1024	/* Maximum number of Negotiate sessions */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_authcache_s	/**** Remembered Basic credentials ****/
+{
+  char		username[HTTP_MAX_VALUE],
+					/* Username */
+		hostname[HTTP_MAX_HOST];
+					/* Client hostname */
+  unsigned char	hash[32];		/* SHA2-256 of salt, hostname, username, and password */
+  time_t	expires;		/* Time when entry expires */
+} cupsd_authcache_t;
+
+typedef struct cupsd_groupcache_s	/**** Remembered group membership ****/
+{
+  char		username[HTTP_MAX_VALUE],
+					/* Username */
+		groupname[HTTP_MAX_VALUE];
+					/* Group name */
+  int		uid,			/* User ID or -1 */
+		gid,			/* Primary group ID or -1 */
+		is_member;		/* 1 if member, 0 otherwise */
+  time_t	expires;		/* Time when entry expires */
+} cupsd_groupcache_t;
+
+#ifdef HAVE_GSSAPI
+typedef struct cupsd_gsssession_s	/**** Negotiate session ****/
+{
+  char		id[33];			/* Session ID from cookie */
+  char		username[HTTP_MAX_VALUE];
+					/* Username */
+  http_addr_t	addr;			/* Client address */
+  time_t	expires;		/* Time when session expires */
+} cupsd_gsssession_t;
+#endif /* HAVE_GSSAPI */
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*auth_cache = NULL;
+					/* Remembered Basic credentials */
+static char		auth_salt[33] = "";
+					/* Random salt for credential hashes */
+static cups_array_t	*group_cache = NULL;
+					/* Remembered group memberships */
+#ifdef HAVE_GSSAPI
+static cups_array_t	*gss_sessions = NULL;
+					/* Negotiate sessions */
+#endif /* HAVE_GSSAPI */
+
+
 /*
  * Local functions...
  */
 
+static void		add_auth_cache(cupsd_client_t *con, const char *username, const char *password);
+#ifdef HAVE_GSSAPI
+static void		add_gss_session(cupsd_client_t *con, const char *username);
+#endif /* HAVE_GSSAPI */
+static int		check_auth_cache(cupsd_client_t *con, const char *username, const char *password);
 #ifdef HAVE_AUTHORIZATION_H
 static int		check_authref(cupsd_client_t *con, const char *right);
 #endif /* HAVE_AUTHORIZATION_H */
+static int		check_group(const char *username, struct passwd *user, const char *groupname);
+#ifdef HAVE_GSSAPI
+static int		check_gss_session(cupsd_client_t *con, int type, const char *authorization, char *username, size_t usersize);
+#endif /* HAVE_GSSAPI */
+static int		compare_auth_cache(cupsd_authcache_t *a, cupsd_authcache_t *b, void *data);
+static int		compare_group_cache(cupsd_groupcache_t *a, cupsd_groupcache_t *b, void *data);
+#ifdef HAVE_GSSAPI
+static int		compare_gss_sessions(cupsd_gsssession_t *a, cupsd_gsssession_t *b, void *data);
+#endif /* HAVE_GSSAPI */
 static int		compare_locations(cupsd_location_t *a,
 			                  cupsd_location_t *b);
 static cupsd_authmask_t	*copy_authmask(cupsd_authmask_t *am, void *data);
 static void		free_authmask(cupsd_authmask_t *am, void *data);
+static void		hash_auth(const char *hostname, const char *username, const char *password, unsigned char *hash);
 #if HAVE_LIBPAM
 static int		pam_func(int, const struct pam_message **,
 			         struct pam_response **, void *);
@@ -299,6 +381,20 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
   }
 #endif /* HAVE_AUTHORIZATION_H */
 
+#ifdef HAVE_GSSAPI
+  if (check_gss_session(con, type, authorization, username, sizeof(username)))
+  {
+   /*
+    * Reuse the result of an earlier Negotiate exchange...
+    */
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Authorized as \"%s\" using Negotiate session.", username);
+
+    con->have_gss = 1;
+    con->type     = CUPSD_AUTH_NEGOTIATE;
+  }
+  else
+#endif /* HAVE_GSSAPI */
   if (!*authorization)
   {
    /*
@@ -559,14 +655,21 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 	   /*
 	    * Only use PAM to do authentication.  This supports MD5
 	    * passwords, among other things...
+	    *
+	    * Cached credentials only skip pam_authenticate(); the account
+	    * checks in pam_acct_mgmt() still run for every request so that
+	    * locked or expired accounts are refused right away.
 	    */
 
 	    pam_handle_t	*pamh;	/* PAM authentication handle */
 	    int			pamerr;	/* PAM error code */
 	    struct pam_conv	pamdata;/* PAM conversation data */
 	    cupsd_authdata_t	data;	/* Authentication data */
+	    int			cached;	/* Credentials in the cache? */
 
 
+            cached = check_auth_cache(con, username, password);
+
             strlcpy(data.username, username, sizeof(data.username));
 	    strlcpy(data.password, password, sizeof(data.password));
 
@@ -600,12 +703,15 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 #    endif /* PAM_TTY */
 #  endif /* HAVE_PAM_SET_ITEM */
 
-	    pamerr = pam_authenticate(pamh, PAM_SILENT);
-	    if (pamerr != PAM_SUCCESS)
+	    if (!cached)
 	    {
-	      cupsdLogClient(con, CUPSD_LOG_ERROR, "pam_authenticate() returned %d (%s)", pamerr, pam_strerror(pamh, pamerr));
-	      pam_end(pamh, 0);
-	      return;
+	      pamerr = pam_authenticate(pamh, PAM_SILENT);
+	      if (pamerr != PAM_SUCCESS)
+	      {
+		cupsdLogClient(con, CUPSD_LOG_ERROR, "pam_authenticate() returned %d (%s)", pamerr, pam_strerror(pamh, pamerr));
+		pam_end(pamh, 0);
+		return;
+	      }
 	    }
 
 #  ifdef HAVE_PAM_SETCRED
@@ -624,6 +730,12 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 
 	    pam_end(pamh, PAM_SUCCESS);
 
+	    if (cached)
+	    {
+	      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Authorized as \"%s\" using cached Basic credentials.", username);
+	      break;
+	    }
+
 #else
            /*
 	    * Use normal UNIX password file-based authentication...
@@ -636,6 +748,12 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 #  endif /* HAVE_SHADOW_H */
 
 
+	    if (check_auth_cache(con, username, password))
+	    {
+	      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Authorized as \"%s\" using cached Basic credentials.", username);
+	      break;
+	    }
+
 	    pw = getpwnam(username);	/* Get the current password */
 	    endpwent();			/* Close the password file */
 
@@ -706,6 +824,8 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
 #endif /* HAVE_LIBPAM */
           }
 
+          add_auth_cache(con, username, password);
+
 	  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Authorized as \"%s\" using Basic.", username);
           break;
     }
@@ -822,6 +942,8 @@ cupsdAuthorize(cupsd_client_t *con)	/* I - Client connection */
       gss_release_buffer(&minor_status, &output_token);
 
       con->type = CUPSD_AUTH_NEGOTIATE;
+
+      add_gss_session(con, username);
     }
 
     gss_delete_sec_context(&minor_status, &context, GSS_C_NO_BUFFER);
@@ -1044,13 +1166,10 @@ cupsdCheckAuth(unsigned     ip[4],	/* I - Client address */
 	    * Check the named interface...
 	    */
 
-	    for (iface = (cupsd_netif_t *)cupsArrayFirst(NetIFList);
-	         iface;
+	    for (iface = cupsdNetIFFind(mask->mask.name.name);
+	         iface && !strcmp(mask->mask.name.name, iface->name);
 		 iface = (cupsd_netif_t *)cupsArrayNext(NetIFList))
 	    {
-              if (strcmp(mask->mask.name.name, iface->name))
-                continue;
-
               if (iface->address.addr.sa_family == AF_INET)
 	      {
 	       /*
@@ -1124,6 +1243,9 @@ cupsdCheckAuth(unsigned     ip[4],	/* I - Client address */
 
 /*
  * 'cupsdCheckGroup()' - Check for a user's group membership.
+ *
+ * Results, including non-membership, are cached for a short time so that
+ * repeated policy checks don't go out to the directory service each time.
  */
 
 int					/* O - 1 if user is a member, 0 otherwise */
@@ -1132,14 +1254,9 @@ cupsdCheckGroup(
     struct passwd *user,		/* I - System user info */
     const char    *groupname)		/* I - Group name */
 {
-  int		i;			/* Looping var */
-  struct group	*group;			/* Group info */
-  gid_t		groupid;		/* ID of named group */
-#ifdef HAVE_MBR_UID_TO_UUID
-  uuid_t	useruuid,		/* UUID for username */
-		groupuuid;		/* UUID for groupname */
-  int		is_member;		/* True if user is a member of group */
-#endif /* HAVE_MBR_UID_TO_UUID */
+  cupsd_groupcache_t	key,		/* Search key */
+			*cache;		/* Cache entry */
+  time_t		curtime;	/* Current time */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckGroup(username=\"%s\", user=%p, groupname=\"%s\")", username, user, groupname);
@@ -1152,116 +1269,88 @@ cupsdCheckGroup(
     return (0);
 
  /*
-  * Check to see if the user is a member of the named group...
+  * See if we have a recent answer...
   */
 
-  group = getgrnam(groupname);
-  endgrent();
+  strlcpy(key.username, username, sizeof(key.username));
+  strlcpy(key.groupname, groupname, sizeof(key.groupname));
+  key.uid  = user ? (int)user->pw_uid : -1;
+  key.gid  = user ? (int)user->pw_gid : -1;
+  curtime  = time(NULL);
 
-  if (group != NULL)
+  if (!group_cache)
+    group_cache = cupsArrayNew3((cups_array_func_t)compare_group_cache, NULL, NULL, 0, NULL, (cups_afree_func_t)free);
+
+  if ((cache = (cupsd_groupcache_t *)cupsArrayFind(group_cache, &key)) != NULL)
   {
-   /*
-    * Group exists, check it...
-    */
+    if (cache->expires > curtime)
+    {
+      GroupCacheHits ++;
+      return (cache->is_member);
+    }
 
-    groupid = group->gr_gid;
+    cupsArrayRemove(group_cache, cache);
+  }
 
-    for (i = 0; group->gr_mem[i]; i ++)
-    {
-     /*
-      * User appears in the group membership...
-      */
+  GroupCacheMisses ++;
 
-      if (!_cups_strcasecmp(username, group->gr_mem[i]))
-	return (1);
-    }
+ /*
+  * Look up the membership and remember the result...
+  */
 
-#ifdef HAVE_GETGROUPLIST
+  key.is_member = check_group(username, user, groupname);
+  key.expires   = curtime + CUPSD_GROUP_CACHE_LIFE;
+
+  if (cupsArrayCount(group_cache) >= CUPSD_GROUP_CACHE_MAX)
+  {
    /*
-    * If the user isn't in the group membership list, try the results from
-    * getgrouplist() which is supposed to return the full list of groups a user
-    * belongs to...
+    * Drop expired entries, or the first entry if none have expired...
     */
 
-    if (user)
-    {
-      int	ngroups;		/* Number of groups */
-#  ifdef __APPLE__
-      int	groups[2048];		/* Groups that user belongs to */
-#  else
-      gid_t	groups[2048];		/* Groups that user belongs to */
-#  endif /* __APPLE__ */
+    for (cache = (cupsd_groupcache_t *)cupsArrayFirst(group_cache);
+         cache;
+	 cache = (cupsd_groupcache_t *)cupsArrayNext(group_cache))
+      if (cache->expires <= curtime)
+        cupsArrayRemove(group_cache, cache);
 
-      ngroups = (int)(sizeof(groups) / sizeof(groups[0]));
-#  ifdef __APPLE__
-      getgrouplist(username, (int)user->pw_gid, groups, &ngroups);
-#  else
-      getgrouplist(username, user->pw_gid, groups, &ngroups);
-#endif /* __APPLE__ */
-
-      for (i = 0; i < ngroups; i ++)
-        if ((int)groupid == (int)groups[i])
-	  return (1);
-    }
-#endif /* HAVE_GETGROUPLIST */
+    if (cupsArrayCount(group_cache) >= CUPSD_GROUP_CACHE_MAX)
+      cupsArrayRemove(group_cache, cupsArrayFirst(group_cache));
   }
-  else
-    groupid = (gid_t)-1;
 
- /*
-  * Group doesn't exist or user not in group list, check the group ID
-  * against the user's group ID...
-  */
+  if ((cache = malloc(sizeof(cupsd_groupcache_t))) != NULL)
+  {
+    memcpy(cache, &key, sizeof(cupsd_groupcache_t));
+    cupsArrayAdd(group_cache, cache);
+  }
 
-  if (user && groupid == user->pw_gid)
-    return (1);
+  return (key.is_member);
+}
 
-#ifdef HAVE_MBR_UID_TO_UUID
- /*
-  * Check group membership through macOS membership API...
-  */
 
-  if (user && !mbr_uid_to_uuid(user->pw_uid, useruuid))
-  {
-    if (groupid != (gid_t)-1)
-    {
-     /*
-      * Map group name to UUID and check membership...
-      */
+/*
+ * 'cupsdClearAuthCache()' - Forget all remembered Basic credentials.
+ */
 
-      if (!mbr_gid_to_uuid(groupid, groupuuid))
-        if (!mbr_check_membership(useruuid, groupuuid, &is_member))
-	  if (is_member)
-	    return (1);
-    }
-    else if (groupname[0] == '#')
-    {
-     /*
-      * Use UUID directly and check for equality (user UUID) and
-      * membership (group UUID)...
-      */
+void
+cupsdClearAuthCache(void)
+{
+  cupsArrayDelete(auth_cache);
+  auth_cache = NULL;
+}
 
-      if (!uuid_parse((char *)groupname + 1, groupuuid))
-      {
-        if (!uuid_compare(useruuid, groupuuid))
-	  return (1);
-	else if (!mbr_check_membership(useruuid, groupuuid, &is_member))
-	  if (is_member)
-	    return (1);
-      }
 
-      return (0);
-    }
-  }
-  else if (groupname[0] == '#')
-    return (0);
-#endif /* HAVE_MBR_UID_TO_UUID */
+/*
+ * 'cupsdClearGroupCache()' - Forget all cached group memberships.
+ */
 
- /*
-  * If we get this far, then the user isn't part of the named group...
-  */
+void
+cupsdClearGroupCache(void)
+{
+  if (GroupCacheHits || GroupCacheMisses)
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Group membership cache: %d hits, %d misses.", GroupCacheHits, GroupCacheMisses);
 
-  return (0);
+  cupsArrayDelete(group_cache);
+  group_cache = NULL;
 }
 
 
@@ -1889,6 +1978,185 @@ cupsdNewLocation(const char *location)	/* I - Location path */
 }
 
 
+/*
+ * 'add_auth_cache()' - Remember Basic credentials that have been validated.
+ */
+
+static void
+add_auth_cache(cupsd_client_t *con,	/* I - Client connection */
+               const char     *username,/* I - Username */
+               const char     *password)/* I - Password */
+{
+  cupsd_authcache_t	key,		/* Search key */
+			*cache;		/* Cache entry */
+  const char		*hostname = httpGetHostname(con->http, NULL, 0);
+					/* Client hostname */
+
+
+  if (!auth_cache)
+  {
+    int	i;				/* Looping var */
+
+    if ((auth_cache = cupsArrayNew3((cups_array_func_t)compare_auth_cache, NULL, NULL, 0, NULL, (cups_afree_func_t)free)) == NULL)
+      return;
+
+    for (i = 0; i < (int)(sizeof(auth_salt) - 1); i ++)
+      auth_salt[i] = "0123456789abcdef"[CUPS_RAND() & 15];
+  }
+
+  strlcpy(key.username, username, sizeof(key.username));
+  strlcpy(key.hostname, hostname, sizeof(key.hostname));
+
+  if ((cache = (cupsd_authcache_t *)cupsArrayFind(auth_cache, &key)) == NULL)
+  {
+    if (cupsArrayCount(auth_cache) >= CUPSD_AUTH_CACHE_MAX)
+    {
+     /*
+      * Drop expired entries, or the first entry if none have expired...
+      */
+
+      time_t curtime = time(NULL);	/* Current time */
+
+      for (cache = (cupsd_authcache_t *)cupsArrayFirst(auth_cache);
+           cache;
+	   cache = (cupsd_authcache_t *)cupsArrayNext(auth_cache))
+        if (cache->expires <= curtime)
+	  cupsArrayRemove(auth_cache, cache);
+
+      if (cupsArrayCount(auth_cache) >= CUPSD_AUTH_CACHE_MAX)
+        cupsArrayRemove(auth_cache, cupsArrayFirst(auth_cache));
+    }
+
+    if ((cache = calloc(1, sizeof(cupsd_authcache_t))) == NULL)
+      return;
+
+    strlcpy(cache->username, username, sizeof(cache->username));
+    strlcpy(cache->hostname, hostname, sizeof(cache->hostname));
+    cupsArrayAdd(auth_cache, cache);
+  }
+
+  hash_auth(hostname, username, password, cache->hash);
+  cache->expires = time(NULL) + CUPSD_AUTH_CACHE_LIFE;
+}
+
+
+#ifdef HAVE_GSSAPI
+/*
+ * 'add_gss_session()' - Remember a completed Negotiate exchange.
+ *
+ * The Negotiate data is remembered for the rest of the connection.  When
+ * GSSSessionTimeout is set, a session cookie is also sent that lets the
+ * client skip the exchange on later connections from the same address.
+ */
+
+static void
+add_gss_session(cupsd_client_t *con,	/* I - Client connection */
+                const char     *username)
+					/* I - Authenticated username */
+{
+  int			i;		/* Looping var */
+  const char		*authorization;	/* Authorization header */
+  cupsd_gsssession_t	*session;	/* New session */
+  char			cookie[256];	/* Set-Cookie value */
+
+
+  authorization = httpGetField(con->http, HTTP_FIELD_AUTHORIZATION);
+
+  cupsHashData("sha2-256", authorization, strlen(authorization), con->gss_hash, sizeof(con->gss_hash));
+  strlcpy(con->gss_username, username, sizeof(con->gss_username));
+
+  if (GSSSessionTimeout <= 0)
+    return;
+
+  if (!gss_sessions && (gss_sessions = cupsArrayNew3((cups_array_func_t)compare_gss_sessions, NULL, NULL, 0, NULL, (cups_afree_func_t)free)) == NULL)
+    return;
+
+  if (cupsArrayCount(gss_sessions) >= CUPSD_GSS_SESSION_MAX)
+  {
+   /*
+    * Drop expired sessions, or the first session if none have expired...
+    */
+
+    time_t curtime = time(NULL);	/* Current time */
+
+    for (session = (cupsd_gsssession_t *)cupsArrayFirst(gss_sessions);
+         session;
+	 session = (cupsd_gsssession_t *)cupsArrayNext(gss_sessions))
+      if (session->expires <= curtime)
+	cupsArrayRemove(gss_sessions, session);
+
+    if (cupsArrayCount(gss_sessions) >= CUPSD_GSS_SESSION_MAX)
+      cupsArrayRemove(gss_sessions, cupsArrayFirst(gss_sessions));
+  }
+
+  if ((session = calloc(1, sizeof(cupsd_gsssession_t))) == NULL)
+    return;
+
+  for (i = 0; i < (int)(sizeof(session->id) - 1); i ++)
+    session->id[i] = "0123456789abcdef"[CUPS_RAND() & 15];
+
+  strlcpy(session->username, username, sizeof(session->username));
+  memcpy(&session->addr, httpGetAddress(con->http), sizeof(session->addr));
+  session->expires = time(NULL) + GSSSessionTimeout;
+
+  cupsArrayAdd(gss_sessions, session);
+
+  snprintf(cookie, sizeof(cookie), CUPSD_GSS_COOKIE "=%s; path=/; max-age=%d; httponly%s", session->id, GSSSessionTimeout, httpIsEncrypted(con->http) ? "; secure" : "");
+  httpSetCookie(con->http, cookie);
+}
+#endif /* HAVE_GSSAPI */
+
+
+/*
+ * 'check_auth_cache()' - Check Basic credentials against the cache.
+ *
+ * Entries are only used for the client hostname they were validated for.
+ */
+
+static int				/* O - 1 if remembered, 0 otherwise */
+check_auth_cache(cupsd_client_t *con,	/* I - Client connection */
+                 const char     *username,
+					/* I - Username */
+                 const char     *password)
+					/* I - Password */
+{
+  size_t		i;		/* Looping var */
+  cupsd_authcache_t	key,		/* Search key */
+			*cache;		/* Cache entry */
+  const char		*hostname = httpGetHostname(con->http, NULL, 0);
+					/* Client hostname */
+  unsigned char		hash[32],	/* Hash of credentials */
+			diff;		/* Differences between hashes */
+
+
+  if (!auth_cache)
+    return (0);
+
+  strlcpy(key.username, username, sizeof(key.username));
+  strlcpy(key.hostname, hostname, sizeof(key.hostname));
+
+  if ((cache = (cupsd_authcache_t *)cupsArrayFind(auth_cache, &key)) == NULL)
+    return (0);
+
+  if (cache->expires <= time(NULL))
+  {
+    cupsArrayRemove(auth_cache, cache);
+    return (0);
+  }
+
+  hash_auth(hostname, username, password, hash);
+
+ /*
+  * Compare every byte so the time taken does not depend on the password...
+  */
+
+  for (i = 0, diff = 0; i < sizeof(hash); i ++)
+    diff |= hash[i] ^ cache->hash[i];
+
+  return (!diff);
+}
+
+
 #ifdef HAVE_AUTHORIZATION_H
 /*
  * 'check_authref()' - Check if an authorization services reference has the
@@ -1938,6 +2206,293 @@ check_authref(cupsd_client_t *con,	/* I - Connection */
 #endif /* HAVE_AUTHORIZATION_H */
 
 
+/*
+ * 'check_group()' - Look up a user's group membership.
+ */
+
+static int				/* O - 1 if user is a member, 0 otherwise */
+check_group(
+    const char    *username,		/* I - User name */
+    struct passwd *user,		/* I - System user info */
+    const char    *groupname)		/* I - Group name */
+{
+  int		i;			/* Looping var */
+  struct group	*group;			/* Group info */
+  gid_t		groupid;		/* ID of named group */
+#ifdef HAVE_MBR_UID_TO_UUID
+  uuid_t	useruuid,		/* UUID for username */
+		groupuuid;		/* UUID for groupname */
+  int		is_member;		/* True if user is a member of group */
+#endif /* HAVE_MBR_UID_TO_UUID */
+
+
+ /*
+  * Check to see if the user is a member of the named group...
+  */
+
+  group = getgrnam(groupname);
+  endgrent();
+
+  if (group != NULL)
+  {
+   /*
+    * Group exists, check it...
+    */
+
+    groupid = group->gr_gid;
+
+    for (i = 0; group->gr_mem[i]; i ++)
+    {
+     /*
+      * User appears in the group membership...
+      */
+
+      if (!_cups_strcasecmp(username, group->gr_mem[i]))
+	return (1);
+    }
+
+#ifdef HAVE_GETGROUPLIST
+   /*
+    * If the user isn't in the group membership list, try the results from
+    * getgrouplist() which is supposed to return the full list of groups a user
+    * belongs to...
+    */
+
+    if (user)
+    {
+      int	ngroups;		/* Number of groups */
+#  ifdef __APPLE__
+      int	groups[2048];		/* Groups that user belongs to */
+#  else
+      gid_t	groups[2048];		/* Groups that user belongs to */
+#  endif /* __APPLE__ */
+
+      ngroups = (int)(sizeof(groups) / sizeof(groups[0]));
+#  ifdef __APPLE__
+      getgrouplist(username, (int)user->pw_gid, groups, &ngroups);
+#  else
+      getgrouplist(username, user->pw_gid, groups, &ngroups);
+#endif /* __APPLE__ */
+
+      for (i = 0; i < ngroups; i ++)
+        if ((int)groupid == (int)groups[i])
+	  return (1);
+    }
+#endif /* HAVE_GETGROUPLIST */
+  }
+  else
+    groupid = (gid_t)-1;
+
+ /*
+  * Group doesn't exist or user not in group list, check the group ID
+  * against the user's group ID...
+  */
+
+  if (user && groupid == user->pw_gid)
+    return (1);
+
+#ifdef HAVE_MBR_UID_TO_UUID
+ /*
+  * Check group membership through macOS membership API...
+  */
+
+  if (user && !mbr_uid_to_uuid(user->pw_uid, useruuid))
+  {
+    if (groupid != (gid_t)-1)
+    {
+     /*
+      * Map group name to UUID and check membership...
+      */
+
+      if (!mbr_gid_to_uuid(groupid, groupuuid))
+        if (!mbr_check_membership(useruuid, groupuuid, &is_member))
+	  if (is_member)
+	    return (1);
+    }
+    else if (groupname[0] == '#')
+    {
+     /*
+      * Use UUID directly and check for equality (user UUID) and
+      * membership (group UUID)...
+      */
+
+      if (!uuid_parse((char *)groupname + 1, groupuuid))
+      {
+        if (!uuid_compare(useruuid, groupuuid))
+	  return (1);
+	else if (!mbr_check_membership(useruuid, groupuuid, &is_member))
+	  if (is_member)
+	    return (1);
+      }
+
+      return (0);
+    }
+  }
+  else if (groupname[0] == '#')
+    return (0);
+#endif /* HAVE_MBR_UID_TO_UUID */
+
+ /*
+  * If we get this far, then the user isn't part of the named group...
+  */
+
+  return (0);
+}
+
+
+#ifdef HAVE_GSSAPI
+/*
+ * 'check_gss_session()' - Check for an earlier Negotiate exchange.
+ *
+ * A request whose Negotiate data matches what was accepted earlier on the same
+ * connection, or a request without an Authorization header that carries a
+ * valid session cookie, is authorized without another GSSAPI exchange.
+ */
+
+static int				/* O - 1 if authorized, 0 otherwise */
+check_gss_session(
+    cupsd_client_t *con,		/* I - Client connection */
+    int            type,		/* I - Authentication type for resource */
+    const char     *authorization,	/* I - Authorization header */
+    char           *username,		/* O - Username */
+    size_t         usersize)		/* I - Size of username buffer */
+{
+  const char		*cookie;	/* Cookie header */
+  char			*idptr;		/* Pointer into session ID */
+  cupsd_gsssession_t	key,		/* Search key */
+			*session;	/* Matching session */
+  unsigned char		hash[32];	/* Hash of Negotiate data */
+
+
+#ifdef AF_LOCAL
+  if (httpAddrFamily(httpGetAddress(con->http)) == AF_LOCAL)
+    return (0);				/* Need the peer UID for each request */
+#endif /* AF_LOCAL */
+
+  if (*authorization)
+  {
+    if (strncmp(authorization, "Negotiate", 9) || !con->gss_username[0])
+      return (0);
+
+    cupsHashData("sha2-256", authorization, strlen(authorization), hash, sizeof(hash));
+
+    if (memcmp(hash, con->gss_hash, sizeof(hash)))
+      return (0);
+
+    strlcpy(username, con->gss_username, usersize);
+    return (1);
+  }
+
+  if (GSSSessionTimeout <= 0 || type != CUPSD_AUTH_NEGOTIATE || !gss_sessions || (cookie = httpGetCookie(con->http)) == NULL)
+    return (0);
+
+ /*
+  * Find the session cookie...
+  */
+
+  while ((cookie = strstr(cookie, CUPSD_GSS_COOKIE "=")) != NULL)
+  {
+    if (cookie == httpGetCookie(con->http) || cookie[-1] == ' ' || cookie[-1] == ';')
+      break;
+
+    cookie ++;
+  }
+
+  if (!cookie)
+    return (0);
+
+  for (cookie += sizeof(CUPSD_GSS_COOKIE), idptr = key.id; *cookie && *cookie != ';' && !isspace(*cookie & 255) && idptr < (key.id + sizeof(key.id) - 1); cookie ++)
+    *idptr++ = *cookie;
+
+  *idptr = '\0';
+
+  if ((session = (cupsd_gsssession_t *)cupsArrayFind(gss_sessions, &key)) == NULL)
+    return (0);
+
+  if (session->expires <= time(NULL))
+  {
+    cupsArrayRemove(gss_sessions, session);
+    return (0);
+  }
+
+  if (!httpAddrEqual(&session->addr, httpGetAddress(con->http)))
+    return (0);
+
+  strlcpy(username, session->username, usersize);
+
+  return (1);
+}
+#endif /* HAVE_GSSAPI */
+
+
+/*
+ * 'compare_auth_cache()' - Compare two credential cache entries.
+ */
+
+static int				/* O - Result of comparison */
+compare_auth_cache(
+    cupsd_authcache_t *a,		/* I - First entry */
+    cupsd_authcache_t *b,		/* I - Second entry */
+    void              *data)		/* I - Callback data (unused) */
+{
+  int	result;				/* Result of comparison */
+
+
+  (void)data;
+
+  if ((result = strcmp(a->username, b->username)) == 0)
+    result = strcmp(a->hostname, b->hostname);
+
+  return (result);
+}
+
+
+/*
+ * 'compare_group_cache()' - Compare two group membership cache entries.
+ */
+
+static int				/* O - Result of comparison */
+compare_group_cache(
+    cupsd_groupcache_t *a,		/* I - First entry */
+    cupsd_groupcache_t *b,		/* I - Second entry */
+    void               *data)		/* I - Callback data (unused) */
+{
+  int	result;				/* Result of comparison */
+
+
+  (void)data;
+
+  if ((result = strcmp(a->username, b->username)) != 0)
+    return (result);
+  else if ((result = strcmp(a->groupname, b->groupname)) != 0)
+    return (result);
+  else if (a->uid != b->uid)
+    return (a->uid < b->uid ? -1 : 1);
+  else if (a->gid != b->gid)
+    return (a->gid < b->gid ? -1 : 1);
+  else
+    return (0);
+}
+
+
+#ifdef HAVE_GSSAPI
+/*
+ * 'compare_gss_sessions()' - Compare two Negotiate sessions.
+ */
+
+static int				/* O - Result of comparison */
+compare_gss_sessions(
+    cupsd_gsssession_t *a,		/* I - First session */
+    cupsd_gsssession_t *b,		/* I - Second session */
+    void               *data)		/* I - Callback data (unused) */
+{
+  (void)data;
+
+  return (strcmp(a->id, b->id));
+}
+#endif /* HAVE_GSSAPI */
+
+
 /*
  * 'compare_locations()' - Compare two locations.
  */
@@ -2006,6 +2561,26 @@ free_authmask(cupsd_authmask_t *mask,	/* I - Auth mask to free */
 }
 
 
+/*
+ * 'hash_auth()' - Compute the salted hash of a hostname, username, and password.
+ */
+
+static void
+hash_auth(const char    *hostname,	/* I - Client hostname */
+          const char    *username,	/* I - Username */
+          const char    *password,	/* I - Password */
+          unsigned char *hash)		/* O - SHA2-256 hash (32 bytes) */
+{
+  char	data[33 + HTTP_MAX_HOST + 2 * HTTP_MAX_VALUE + 3];
+					/* Salt:hostname:username:password */
+
+
+  snprintf(data, sizeof(data), "%s:%s:%s:%s", auth_salt, hostname, username, password);
+  cupsHashData("sha2-256", data, strlen(data), hash, 32);
+  memset(data, 0, sizeof(data));
+}
+
+
 #if HAVE_LIBPAM
 /*
  * 'pam_func()' - PAM conversation function.
@@ -105,6 +105,10 @@ typedef struct cupsd_client_s cupsd_client_t;
 
 VAR cups_array_t	*Locations	VALUE(NULL);
 					/* Authorization locations */
+VAR int			GroupCacheHits	VALUE(0),
+					/* Group lookups answered from cache */
+			GroupCacheMisses VALUE(0);
+					/* Group lookups sent to the OS */
 #ifdef HAVE_SSL
 VAR http_encryption_t	DefaultEncryption VALUE(HTTP_ENCRYPT_REQUIRED);
 					/* Default encryption for authentication */
@@ -127,6 +131,8 @@ extern int		cupsdCheckAuth(unsigned ip[4], const char *name, size_t namelen, cup
 extern int		cupsdCheckGroup(const char *username,
 			                struct passwd *user,
 			                const char *groupname);
+extern void		cupsdClearAuthCache(void);
+extern void		cupsdClearGroupCache(void);
 extern cupsd_location_t	*cupsdCopyLocation(cupsd_location_t *loc);
 extern void		cupsdDeleteAllLocations(void);
 extern cupsd_location_t	*cupsdFindBest(const char *path, http_state_t state);
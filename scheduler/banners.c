@@ -15,14 +15,27 @@
 #include <cups/dir.h>
 
 
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*banner_templates = NULL;
+					/* Parsed banner templates */
+
+
 /*
  * Local functions...
  */
 
 static void	add_banner(const char *name, const char *filename);
+static int	add_segment(cupsd_btemplate_t *tmpl, const char *attr);
 static int	compare_banners(const cupsd_banner_t *b0,
 		                const cupsd_banner_t *b1);
+static int	compare_templates(const cupsd_btemplate_t *t0,
+		                  const cupsd_btemplate_t *t1);
 static void	free_banners(void);
+static void	free_template(cupsd_btemplate_t *tmpl);
+static cupsd_btemplate_t *load_template(const char *filename, struct stat *fileinfo);
 
 
 /*
@@ -41,6 +54,51 @@ cupsdFindBanner(const char *name)	/* I - Name of banner */
 }
 
 
+/*
+ * 'cupsdGetBannerTemplate()' - Get the parsed banner template for a file.
+ *
+ * Templates are parsed once and kept until the file changes or the banners
+ * are reloaded, so each banner job only needs to substitute the attribute
+ * values.
+ */
+
+cupsd_btemplate_t *			/* O - Banner template or NULL on error */
+cupsdGetBannerTemplate(
+    const char *filename)		/* I - Template filename */
+{
+  struct stat		fileinfo;	/* File information */
+  cupsd_btemplate_t	key,		/* Search key */
+			*tmpl;		/* Banner template */
+
+
+  if (stat(filename, &fileinfo))
+    return (NULL);
+
+  key.filename = (char *)filename;
+
+  if ((tmpl = (cupsd_btemplate_t *)cupsArrayFind(banner_templates, &key)) != NULL)
+  {
+    if (tmpl->mtime == fileinfo.st_mtime && tmpl->size == fileinfo.st_size)
+      return (tmpl);
+
+    cupsArrayRemove(banner_templates, tmpl);
+    free_template(tmpl);
+  }
+
+  if ((tmpl = load_template(filename, &fileinfo)) == NULL)
+    return (NULL);
+
+  if (!banner_templates)
+    banner_templates = cupsArrayNew((cups_array_func_t)compare_templates, NULL);
+
+  cupsArrayAdd(banner_templates, tmpl);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdGetBannerTemplate: Loaded \"%s\" with %d segments.", filename, tmpl->num_segs);
+
+  return (tmpl);
+}
+
+
 /*
  * 'cupsdLoadBanners()' - Load all available banner files...
  */
@@ -169,6 +227,38 @@ add_banner(const char *name,		/* I - Name of banner */
 }
 
 
+/*
+ * 'add_segment()' - Add a segment to a banner template.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+add_segment(cupsd_btemplate_t *tmpl,	/* I - Banner template */
+            const char        *attr)	/* I - Attribute name or NULL for text */
+{
+  cupsd_bannerseg_t	*seg;		/* New segment */
+
+
+  if ((tmpl->num_segs & 15) == 0)
+  {
+    if ((seg = realloc(tmpl->segs, (size_t)(tmpl->num_segs + 16) * sizeof(cupsd_bannerseg_t))) == NULL)
+      return (0);
+
+    tmpl->segs = seg;
+  }
+
+  seg = tmpl->segs + tmpl->num_segs;
+
+  memset(seg, 0, sizeof(cupsd_bannerseg_t));
+
+  if (attr && (seg->attr = strdup(attr)) == NULL)
+    return (0);
+
+  tmpl->num_segs ++;
+
+  return (1);
+}
+
+
 /*
  * 'compare_banners()' - Compare two banners.
  */
@@ -182,6 +272,19 @@ compare_banners(
 }
 
 
+/*
+ * 'compare_templates()' - Compare two banner templates.
+ */
+
+static int				/* O - Result of comparison */
+compare_templates(
+    const cupsd_btemplate_t *t0,	/* I - First template */
+    const cupsd_btemplate_t *t1)	/* I - Second template */
+{
+  return (strcmp(t0->filename, t1->filename));
+}
+
+
 /*
  * 'free_banners()' - Free all banners.
  */
@@ -190,6 +293,7 @@ static void
 free_banners(void)
 {
   cupsd_banner_t	*temp;		/* Current banner */
+  cupsd_btemplate_t	*tmpl;		/* Current template */
 
 
   for (temp = (cupsd_banner_t *)cupsArrayFirst(Banners);
@@ -202,4 +306,203 @@ free_banners(void)
 
   cupsArrayDelete(Banners);
   Banners = NULL;
+
+  for (tmpl = (cupsd_btemplate_t *)cupsArrayFirst(banner_templates);
+       tmpl;
+       tmpl = (cupsd_btemplate_t *)cupsArrayNext(banner_templates))
+    free_template(tmpl);
+
+  cupsArrayDelete(banner_templates);
+  banner_templates = NULL;
+}
+
+
+/*
+ * 'free_template()' - Free a banner template.
+ */
+
+static void
+free_template(cupsd_btemplate_t *tmpl)	/* I - Banner template */
+{
+  int	i;				/* Looping var */
+
+
+  for (i = 0; i < tmpl->num_segs; i ++)
+    free(tmpl->segs[i].attr);
+
+  free(tmpl->segs);
+  free(tmpl->text);
+  free(tmpl->filename);
+  free(tmpl);
+}
+
+
+/*
+ * 'load_template()' - Load and parse a banner template.
+ *
+ * Attribute references look like "{name}" or "{?name}".  Anything else
+ * inside braces is copied as-is, as is text following a backslash except
+ * that "\{" becomes a literal brace.
+ */
+
+static cupsd_btemplate_t *		/* O - Banner template or NULL on error */
+load_template(const char  *filename,	/* I - Template filename */
+              struct stat *fileinfo)	/* I - File information */
+{
+  cupsd_btemplate_t	*tmpl;		/* Banner template */
+  cups_file_t		*fp;		/* Template file */
+  char			*data = NULL,	/* File contents */
+			*dataptr,	/* Pointer into file contents */
+			*dataend,	/* End of file contents */
+			*textptr,	/* Pointer into literal text */
+			*start,		/* Start of text for this character */
+			attrname[255],	/* Name of attribute */
+			*s;		/* Pointer into name */
+  size_t		datasize = 0,	/* Size of data buffer */
+			datalen = 0;	/* Length of file contents */
+  ssize_t		bytes;		/* Bytes read */
+  int			ch;		/* Current character */
+
+
+ /*
+  * Read the whole file - banner templates are small...
+  */
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+    return (NULL);
+
+  do
+  {
+    if (datalen + 4096 > datasize)
+    {
+      char *temp;			/* New buffer */
+
+      if ((temp = realloc(data, datasize + 65536)) == NULL)
+      {
+        free(data);
+        cupsFileClose(fp);
+        return (NULL);
+      }
+
+      data     = temp;
+      datasize += 65536;
+    }
+
+    if ((bytes = cupsFileRead(fp, data + datalen, datasize - datalen)) > 0)
+      datalen += (size_t)bytes;
+  }
+  while (bytes > 0);
+
+  cupsFileClose(fp);
+
+  if ((tmpl = calloc(1, sizeof(cupsd_btemplate_t))) == NULL)
+  {
+    free(data);
+    return (NULL);
+  }
+
+  tmpl->mtime = fileinfo->st_mtime;
+  tmpl->size  = fileinfo->st_size;
+
+  if ((tmpl->filename = strdup(filename)) == NULL || (tmpl->text = malloc(datalen + 1)) == NULL)
+    goto error;
+
+ /*
+  * Split the file into literal text and attribute references...
+  */
+
+  for (dataptr = data, dataend = data + datalen, textptr = tmpl->text; dataptr < dataend;)
+  {
+    start = textptr;
+    ch    = *dataptr++ & 255;
+
+    if (ch == '{')
+    {
+     /*
+      * Get an attribute name...
+      */
+
+      for (s = attrname, ch = EOF; dataptr < dataend;)
+      {
+        ch = *dataptr++ & 255;
+
+        if (!isalpha(ch) && ch != '-' && ch != '?')
+          break;
+	else if (s < (attrname + sizeof(attrname) - 1))
+          *s++ = (char)ch;
+	else
+	  break;
+
+        ch = EOF;
+      }
+
+      *s = '\0';
+
+      if (ch == '}')
+      {
+        if (!add_segment(tmpl, attrname))
+          goto error;
+
+        continue;
+      }
+
+     /*
+      * Copy { followed by stuff that is not an attribute name...
+      */
+
+      *textptr++ = '{';
+      memcpy(textptr, attrname, (size_t)(s - attrname));
+      textptr += s - attrname;
+
+      if (ch != EOF)
+        *textptr++ = (char)ch;
+    }
+    else if (ch == '\\')
+    {
+     /*
+      * Quoted char - only do special handling for \{...
+      */
+
+      if (dataptr < dataend && *dataptr == '{')
+        *textptr++ = *dataptr++;
+      else
+      {
+        *textptr++ = '\\';
+
+        if (dataptr < dataend)
+          *textptr++ = *dataptr++;
+      }
+    }
+    else
+      *textptr++ = (char)ch;
+
+   /*
+    * Extend the current text segment or start a new one...
+    */
+
+    if (tmpl->num_segs == 0 || tmpl->segs[tmpl->num_segs - 1].attr)
+    {
+      if (!add_segment(tmpl, NULL))
+        goto error;
+
+      tmpl->segs[tmpl->num_segs - 1].offset = (size_t)(start - tmpl->text);
+    }
+
+    tmpl->segs[tmpl->num_segs - 1].length += (size_t)(textptr - start);
+  }
+
+  free(data);
+
+  return (tmpl);
+
+ /*
+  * If we get here there was an allocation error...
+  */
+
+  error:
+
+  free(data);
+  free_template(tmpl);
+
+  return (NULL);
 }
@@ -17,6 +17,23 @@ typedef struct				/**** Banner file information ****/
   mime_type_t	*filetype;		/* Filetype for banner */
 } cupsd_banner_t;
 
+typedef struct				/**** Banner template segment ****/
+{
+  size_t	offset,			/* Offset of literal text */
+		length;			/* Length of literal text */
+  char		*attr;			/* Attribute name or NULL for text */
+} cupsd_bannerseg_t;
+
+typedef struct				/**** Parsed banner template ****/
+{
+  char		*filename;		/* Template filename */
+  time_t	mtime;			/* Modification time of file */
+  off_t		size;			/* Size of file */
+  char		*text;			/* Literal text */
+  int		num_segs;		/* Number of segments */
+  cupsd_bannerseg_t *segs;		/* Literal text and attribute segments */
+} cupsd_btemplate_t;
+
 
 /*
  * Globals...
@@ -31,4 +48,5 @@ VAR cups_array_t	*Banners	VALUE(NULL);
  */
 
 extern cupsd_banner_t	*cupsdFindBanner(const char *name);
+extern cupsd_btemplate_t *cupsdGetBannerTemplate(const char *filename);
 extern void		cupsdLoadBanners(const char *d);
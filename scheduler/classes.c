@@ -14,6 +14,22 @@
 #include "cupsd.h"
 
 
+/*
+ * Local globals...
+ */
+
+static double	kb_per_page = 0.0;	/* Average job size per page */
+
+
+/*
+ * Local functions...
+ */
+
+static double	estimate_pages(cupsd_job_t *job);
+static cupsd_printer_t *find_fastest_printer(cupsd_printer_t *c,
+			                     cupsd_job_t *job, int *wait);
+
+
 /*
  * 'cupsdAddClass()' - Add a class to the system.
  */
@@ -178,10 +194,13 @@ cupsdDeletePrinterFromClasses(
 
 cupsd_printer_t *			/* O - Available printer or NULL */
 cupsdFindAvailablePrinter(
-    const char *name)			/* I - Class to check */
+    const char  *name,			/* I - Class to check */
+    cupsd_job_t *job)			/* I - Job to print */
 {
   int			i;		/* Looping var */
-  cupsd_printer_t	*c;		/* Printer class */
+  cupsd_printer_t	*c,		/* Printer class */
+			*p;		/* Fastest printer */
+  int			wait;		/* Wait for a busy printer? */
 
 
  /*
@@ -205,6 +224,17 @@ cupsdFindAvailablePrinter(
   if (c->last_printer >= c->num_printers)
     c->last_printer = 0;
 
+ /*
+  * When scheduling by throughput, use the printer that is expected to finish
+  * the job first, even if that means waiting for it...
+  */
+
+  if (ClassScheduling == CUPSD_CLASS_THROUGHPUT && job)
+  {
+    if ((p = find_fastest_printer(c, job, &wait)) != NULL || wait)
+      return (p);
+  }
+
  /*
   * Loop through the printers in the class and return the first idle
   * printer...  We keep track of the last printer that we used so that
@@ -441,16 +471,7 @@ cupsdLoadAllClasses(void)
       {
         p->state = IPP_PRINTER_STOPPED;
 
-        for (i = 0 ; i < p->num_reasons; i ++)
-	  if (!strcmp("paused", p->reasons[i]))
-	    break;
-
-        if (i >= p->num_reasons &&
-	    p->num_reasons < (int)(sizeof(p->reasons) / sizeof(p->reasons[0])))
-	{
-	  p->reasons[p->num_reasons] = _cupsStrAlloc("paused");
-	  p->num_reasons ++;
-	}
+        cupsdAddPrinterReason(p, "paused");
       }
       else
 	cupsdLogMessage(CUPSD_LOG_ERROR,
@@ -807,3 +828,182 @@ cupsdSaveAllClasses(void)
 
   cupsdCloseCreatedConfFile(fp, filename);
 }
+
+
+/*
+ * 'cupsdUpdatePrinterThroughput()' - Update the measured speed of a printer.
+ *
+ * The pages per minute of the printer and the average size of a page are
+ * moving averages over the jobs that printed successfully.
+ */
+
+void
+cupsdUpdatePrinterThroughput(
+    cupsd_printer_t *p,			/* I - Printer */
+    cupsd_job_t     *job)		/* I - Job that was printed */
+{
+  ipp_attribute_t	*attr;		/* time-at-processing attribute */
+  int			pages;		/* Pages printed */
+  time_t		seconds;	/* Time spent printing */
+  double		ppm;		/* Pages per minute for this job */
+
+
+  if ((pages = ippGetInteger(job->impressions, 0)) <= 0 ||
+      (attr = ippFindAttribute(job->attrs, "time-at-processing", IPP_TAG_INTEGER)) == NULL)
+    return;
+
+  if ((seconds = time(NULL) - ippGetInteger(attr, 0)) < 1)
+    seconds = 1;
+
+  ppm = 60.0 * pages / seconds;
+
+  if (p->ppm > 0.0)
+    p->ppm = 0.75 * p->ppm + 0.25 * ppm;
+  else
+    p->ppm = ppm;
+
+  if (job->koctets > 0)
+  {
+    if (kb_per_page > 0.0)
+      kb_per_page = 0.75 * kb_per_page + 0.25 * job->koctets / pages;
+    else
+      kb_per_page = (double)job->koctets / pages;
+  }
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdUpdatePrinterThroughput: %s printed %d pages in %d seconds, now %.1f pages per minute.", p->name, pages, (int)seconds, p->ppm);
+}
+
+
+/*
+ * 'estimate_pages()' - Estimate the number of pages in a job.
+ *
+ * Uses the job-impressions value from the client when there is one and
+ * otherwise the size of the job.
+ */
+
+static double				/* O - Number of pages */
+estimate_pages(cupsd_job_t *job)	/* I - Job */
+{
+  ipp_attribute_t	*attr;		/* job-impressions attribute */
+  double		pages = 1.0;	/* Number of pages */
+
+
+  if (job->attrs && (attr = ippFindAttribute(job->attrs, "job-impressions", IPP_TAG_INTEGER)) != NULL)
+    pages = ippGetInteger(attr, 0);
+  else if (kb_per_page > 0.0)
+    pages = job->koctets / kb_per_page;
+
+  return (pages < 1.0 ? 1.0 : pages);
+}
+
+
+/*
+ * 'find_fastest_printer()' - Find the printer in a class that is expected to
+ *                            finish a job first.
+ *
+ * Printers that have not printed anything yet are assumed to run at the
+ * average speed of the others.  If no printer has been measured, or the best
+ * printer is busy, NULL is returned and "wait" says which it was.
+ */
+
+static cupsd_printer_t *		/* O - Printer or NULL */
+find_fastest_printer(
+    cupsd_printer_t *c,			/* I - Class */
+    cupsd_job_t     *job,		/* I - Job to print */
+    int             *wait)		/* O - 1 to wait for a busy printer */
+{
+  int			i,		/* Looping var */
+			count,		/* Number of printers checked */
+			num_known,	/* Number of measured printers */
+			available,	/* Is the printer available? */
+			best_index = -1,/* Index of best printer */
+			best_available = 0;
+					/* Is the best printer available? */
+  cupsd_printer_t	*p;		/* Current printer */
+  double		pages,		/* Pages in job */
+			ppm,		/* Speed of current printer */
+			avg_ppm,	/* Average speed of measured printers */
+			busy,		/* Time until current printer is free */
+			finish,		/* Time until job is finished */
+			best_finish = 0.0;
+					/* Finish time on best printer */
+  time_t		curtime = time(NULL);
+					/* Current time */
+
+
+  *wait = 0;
+
+  for (i = 0, num_known = 0, avg_ppm = 0.0; i < c->num_printers; i ++)
+    if (c->printers[i]->ppm > 0.0)
+    {
+      avg_ppm += c->printers[i]->ppm;
+      num_known ++;
+    }
+
+  if (!num_known)
+    return (NULL);
+
+  avg_ppm /= num_known;
+  pages   = estimate_pages(job);
+
+ /*
+  * Check the printers in round-robin order so that ties are shared...
+  */
+
+  for (count = 0, i = c->last_printer + 1; count < c->num_printers; count ++, i ++)
+  {
+    if (i >= c->num_printers)
+      i = 0;
+
+    p = c->printers[i];
+
+    if (!p->accepting)
+      continue;
+
+    ppm = p->ppm > 0.0 ? p->ppm : avg_ppm;
+
+    if (p->state == IPP_PRINTER_IDLE ||
+        ((p->type & CUPS_PRINTER_REMOTE) && !p->job))
+    {
+      available = 1;
+      busy      = 0.0;
+    }
+    else if (p->state == IPP_PRINTER_PROCESSING && p->job)
+    {
+      available = 0;
+      busy      = 60.0 * estimate_pages(p->job) / ppm - (curtime - p->state_time);
+
+      if (busy < 0.0)
+        busy = 0.0;
+    }
+    else
+      continue;
+
+    finish = busy + 60.0 * pages / ppm;
+
+    if (best_index < 0 || finish < best_finish ||
+        (finish == best_finish && available && !best_available))
+    {
+      best_index     = i;
+      best_available = available;
+      best_finish    = finish;
+    }
+  }
+
+  if (best_index < 0)
+    return (NULL);
+
+  p = c->printers[best_index];
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Expecting %s to finish the job in %.0f seconds.", p->name, best_finish);
+
+  if (!best_available)
+  {
+    *wait = 1;
+    return (NULL);
+  }
+
+  c->last_printer = best_index;
+
+  return (p);
+}
@@ -8,6 +8,25 @@
  */
 
 
+/*
+ * Class scheduling modes...
+ */
+
+typedef enum cupsd_classsched_e		/**** Class scheduling modes ****/
+{
+  CUPSD_CLASS_ROUND_ROBIN,		/* Next idle printer */
+  CUPSD_CLASS_THROUGHPUT		/* Printer that finishes the job first */
+} cupsd_classsched_t;
+
+
+/*
+ * Globals...
+ */
+
+VAR cupsd_classsched_t	ClassScheduling	VALUE(CUPSD_CLASS_ROUND_ROBIN);
+					/* How jobs are assigned to members */
+
+
 /*
  * Prototypes...
  */
@@ -18,7 +37,10 @@ extern void		cupsdAddPrinterToClass(cupsd_printer_t *c,
 extern int		cupsdDeletePrinterFromClass(cupsd_printer_t *c,
 			                            cupsd_printer_t *p);
 extern int		cupsdDeletePrinterFromClasses(cupsd_printer_t *p);
-extern cupsd_printer_t	*cupsdFindAvailablePrinter(const char *name);
+extern cupsd_printer_t	*cupsdFindAvailablePrinter(const char *name,
+			                           cupsd_job_t *job);
 extern cupsd_printer_t	*cupsdFindClass(const char *name);
 extern void		cupsdLoadAllClasses(void);
 extern void		cupsdSaveAllClasses(void);
+extern void		cupsdUpdatePrinterThroughput(cupsd_printer_t *p,
+			                             cupsd_job_t *job);
@@ -18,6 +18,7 @@
 #define _CUPS_NO_DEPRECATED
 #define _HTTP_NO_PRIVATE
 #include "cupsd.h"
+#include <poll.h>
 
 #ifdef __APPLE__
 #  include <libproc.h>
@@ -27,476 +28,291 @@
 #endif /* HAVE_TCPD_H */
 
 
+/*
+ * Local constants...
+ */
+
+#define CUPSD_ACCEPT_MAX	16	/* Max connections accepted per wakeup */
+#define CUPSD_HOSTNAME_MAX	1024	/* Max cached hostname lookups */
+#define CUPSD_HOSTNAME_TTL	300	/* Seconds to cache hostname lookups */
+#define CUPSD_SENDFILE_SIZE	65536	/* Max bytes per sendfile() call */
+#define CUPSD_RECVFILE_SIZE	1048576	/* Max bytes per _httpRecvFile() call */
+#define CUPSD_COPYDOC_SIZE	1048576	/* Max bytes per copy_document() call */
+#define CUPSD_CGI_IDLE		30	/* Seconds before idle CGI workers are stopped */
+#define CUPSD_FILE_CACHE_MAX	65536	/* Max size of a cached static file */
+#define CUPSD_FILE_CACHE_SIZE	4194304	/* Max bytes of cached static files */
+#define CUPSD_TLS_TIMEOUT	10	/* Seconds allowed for a TLS handshake */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_cgiworker_s	/**** Resident CGI program ****/
+{
+  char		*command,		/* Program */
+		*username,		/* User the program runs requests for */
+		*lang;			/* LANG environment variable */
+  int		type,			/* Authentication type */
+		root,			/* Running as root? */
+		pid,			/* Process ID */
+		fd,			/* Request socket */
+		busy;			/* Handling a request? */
+  time_t	time;			/* Time of last request */
+} cupsd_cgiworker_t;
+
+typedef struct cupsd_clienthost_s	/**** Connections from an address ****/
+{
+  http_addr_t	addr;			/* Client address (must be first) */
+  int		count;			/* Number of connections */
+} cupsd_clienthost_t;
+
+typedef struct cupsd_filecache_s	/**** Cached static file ****/
+{
+  char		*filename;		/* Filename */
+  time_t	mtime;			/* Modification time */
+  off_t		size;			/* Size of file */
+  char		*data;			/* File contents */
+} cupsd_filecache_t;
+
+typedef struct cupsd_hostname_s		/**** Cached hostname lookup ****/
+{
+  http_addr_t	addr;			/* Address (must be first) */
+  time_t	expires;		/* Time when lookup expires */
+  char		name[256];		/* Hostname or "" if lookup failed */
+} cupsd_hostname_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*CGIWorkers = NULL;
+					/* Resident CGI programs */
+static cups_array_t	*ClientHosts = NULL;
+					/* Connection counts by address */
+static cups_array_t	*FileCache = NULL;
+					/* Cached static files */
+static size_t		FileCacheBytes = 0;
+					/* Bytes of cached file contents */
+static cups_array_t	*HostNames = NULL;
+					/* Cached hostname lookups */
+static unsigned		RequestID = 0;	/* Request ID for temp files */
+
+
 /*
  * Local functions...
  */
 
+static int		accept_client(cupsd_listener_t *lis);
 static int		check_if_modified(cupsd_client_t *con,
 			                  struct stat *filestats);
+static int		compare_addrs(http_addr_t *a, http_addr_t *b, void *data);
 static int		compare_clients(cupsd_client_t *a, cupsd_client_t *b,
 			                void *data);
+static int		compare_filecache(cupsd_filecache_t *a, cupsd_filecache_t *b, void *data);
+static int		copy_document(cupsd_client_t *con);
 #ifdef HAVE_SSL
+static int		cupsd_accept_tls(cupsd_client_t *con);
 static int		cupsd_start_tls(cupsd_client_t *con, http_encryption_t e);
 #endif /* HAVE_SSL */
+static cupsd_cgiworker_t *find_worker(int pid);
+static void		free_filecache(cupsd_filecache_t *cache);
+static int		get_api_option(const char *query, const char *name, char *value, size_t valuesize);
 static char		*get_file(cupsd_client_t *con, struct stat *filestats,
 			          char *filename, size_t len);
+static cupsd_filecache_t *get_filecache(const char *filename, struct stat *filestats);
 static http_status_t	install_cupsd_conf(cupsd_client_t *con);
 static int		is_cgi(cupsd_client_t *con, const char *filename,
 		               struct stat *filestats, mime_type_t *type);
 static int		is_path_absolute(const char *path);
+static const char	*lookup_hostname(http_addr_t *addr, char *name, size_t namelen);
+static void		make_etag(struct stat *filestats, int gzip, char *buffer, size_t bufsize);
 static int		pipe_command(cupsd_client_t *con, int infile, int *outfile,
 			             char *command, char *options, int root);
+static const char	*resolve_hostname(cupsd_client_t *con);
+static int		send_worker(cupsd_client_t *con, char *command,
+			            char *argv[], char *envp[], const char *lang,
+				    int root, int infile, int outfile);
+static void		stop_worker(cupsd_cgiworker_t *worker);
 static int		valid_host(cupsd_client_t *con);
+static int		write_api(cupsd_client_t *con);
+static int		write_api_jobs(cupsd_client_t *con, const char *query, const char *fields, int offset, int limit);
+static int		write_api_printers(cupsd_client_t *con, const char *fields, int offset, int limit);
 static int		write_file(cupsd_client_t *con, http_status_t code,
 		        	   char *filename, char *type,
 				   struct stat *filestats);
+static int		write_json_name(cupsd_client_t *con, const char *fields, const char *name, int *count);
+static int		write_json_printf(cupsd_client_t *con, const char *format, ...) _CUPS_FORMAT(2, 3);
+static void		write_json_string(cupsd_client_t *con, const char *s);
+static int		write_metrics(cupsd_client_t *con);
 static void		write_pipe(cupsd_client_t *con);
 
 
 /*
- * 'cupsdAcceptClient()' - Accept a new client.
+ * 'cupsdAcceptClient()' - Accept new clients.
+ *
+ * Up to CUPSD_ACCEPT_MAX pending connections are accepted per call so that a
+ * burst of connections does not need one trip through the main loop each,
+ * while still letting existing clients run between bursts.
  */
 
 void
 cupsdAcceptClient(cupsd_listener_t *lis)/* I - Listener socket */
 {
-  const char		*hostname;	/* Hostname of client */
-  char			name[256];	/* Hostname of client */
-  int			count;		/* Count of connections on a host */
-  cupsd_client_t	*con,		/* New client pointer */
-			*tempcon;	/* Temporary client pointer */
-  socklen_t		addrlen;	/* Length of address */
-  http_addr_t		temp;		/* Temporary address variable */
-  static time_t		last_dos = 0;	/* Time of last DoS attack */
-#ifdef HAVE_TCPD_H
-  struct request_info	wrap_req;	/* TCP wrappers request information */
-#endif /* HAVE_TCPD_H */
-
+  int	i;				/* Looping var */
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdAcceptClient(lis=%p(%d)) Clients=%d", lis, lis->fd, cupsArrayCount(Clients));
 
- /*
-  * Make sure we don't have a full set of clients already...
-  */
-
-  if (cupsArrayCount(Clients) == MaxClients)
-    return;
-
-  cupsdSetBusyState(1);
+  for (i = 0; i < CUPSD_ACCEPT_MAX; i ++)
+    if (!accept_client(lis))
+      break;
+}
 
- /*
-  * Get a pointer to the next available client...
-  */
 
-  if (!Clients)
-    Clients = cupsArrayNew(NULL, NULL);
+/*
+ * 'cupsdCloseAllClients()' - Close all remote clients immediately.
+ */
 
-  if (!Clients)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR,
-                    "Unable to allocate memory for clients array!");
-    cupsdPauseListening();
-    return;
-  }
+void
+cupsdCloseAllClients(void)
+{
+  cupsd_client_t	*con;		/* Current client */
 
-  if (!ActiveClients)
-    ActiveClients = cupsArrayNew((cups_array_func_t)compare_clients, NULL);
 
-  if (!ActiveClients)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR,
-                    "Unable to allocate memory for active clients array!");
-    cupsdPauseListening();
-    return;
-  }
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCloseAllClients() Clients=%d", cupsArrayCount(Clients));
 
-  if ((con = calloc(1, sizeof(cupsd_client_t))) == NULL)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for client!");
-    cupsdPauseListening();
-    return;
-  }
+  for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
+       con;
+       con = (cupsd_client_t *)cupsArrayNext(Clients))
+    if (cupsdCloseClient(con))
+      cupsdCloseClient(con);
 
  /*
-  * Accept the client and get the remote address...
+  * Stop any resident CGI programs...
   */
 
-  con->number = ++ LastClientNumber;
-  con->file   = -1;
-
-  if ((con->http = httpAcceptConnection(lis->fd, 0)) == NULL)
-  {
-    if (errno == ENFILE || errno == EMFILE)
-      cupsdPauseListening();
-
-    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to accept client connection - %s.",
-                    strerror(errno));
-    free(con);
+  while (cupsArrayCount(CGIWorkers) > 0)
+    stop_worker((cupsd_cgiworker_t *)cupsArrayFirst(CGIWorkers));
+}
 
-    return;
-  }
 
- /*
-  * Save the connected address and port number...
-  */
+/*
+ * 'cupsdCloseClient()' - Close a remote client.
+ */
 
-  addrlen = sizeof(con->clientaddr);
+int					/* O - 1 if partial close, 0 if fully closed */
+cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
+{
+  int		partial;		/* Do partial close for SSL? */
 
-  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&con->clientaddr, &addrlen) || addrlen == 0)
-    con->clientaddr = lis->address;
 
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Server address is \"%s\".", httpAddrString(&con->clientaddr, name, sizeof(name)));
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing connection.");
 
  /*
-  * Check the number of clients on the same address...
+  * Flush pending writes before closing...
   */
 
-  for (count = 0, tempcon = (cupsd_client_t *)cupsArrayFirst(Clients);
-       tempcon;
-       tempcon = (cupsd_client_t *)cupsArrayNext(Clients))
-    if (httpAddrEqual(httpGetAddress(tempcon->http), httpGetAddress(con->http)))
-    {
-      count ++;
-      if (count >= MaxClientsPerHost)
-	break;
-    }
+  httpFlushWrite(con->http);
 
-  if (count >= MaxClientsPerHost)
+  partial = 0;
+
+  if (con->pipe_pid != 0)
   {
-    if ((time(NULL) - last_dos) >= 60)
-    {
-      last_dos = time(NULL);
-      cupsdLogMessage(CUPSD_LOG_WARN,
-                      "Possible DoS attack - more than %d clients connecting "
-		      "from %s.",
-	              MaxClientsPerHost,
-		      httpGetHostname(con->http, name, sizeof(name)));
-    }
+   /*
+    * Stop any CGI process...
+    */
 
-    httpClose(con->http);
-    free(con);
-    return;
-  }
+    cupsd_cgiworker_t *worker;		/* Resident CGI program */
 
- /*
-  * Get the hostname or format the IP address as needed...
-  */
+    if ((worker = find_worker(con->pipe_pid)) != NULL)
+      stop_worker(worker);
+    else
+      cupsdEndProcess(con->pipe_pid, 1);
 
-  if (HostNameLookups)
-    hostname = httpResolveHostname(con->http, NULL, 0);
-  else
-    hostname = httpGetHostname(con->http, NULL, 0);
+    con->pipe_pid = 0;
+  }
 
-  if (hostname == NULL && HostNameLookups == 2)
+  if (con->file >= 0)
   {
-   /*
-    * Can't have an unresolved IP address with double-lookups enabled...
-    */
-
-    httpClose(con->http);
+    cupsdRemoveSelect(con->file);
 
-    cupsdLogClient(con, CUPSD_LOG_WARN,
-                    "Name lookup failed - connection from %s closed!",
-                    httpGetHostname(con->http, NULL, 0));
+    close(con->file);
+    con->file = -1;
+  }
 
-    free(con);
-    return;
+  if (con->doc_fd >= 0)
+  {
+    close(con->doc_fd);
+    con->doc_fd = -1;
   }
 
-  if (HostNameLookups == 2)
+ /*
+  * Close the socket and clear the file from the input set for select()...
+  */
+
+  if (httpGetFd(con->http) >= 0)
   {
+    cupsArrayRemove(ActiveClients, con);
+    cupsArrayRemove(NotifyWaiters, con);
+    cupsdSetBusyState(0);
+
+#ifdef HAVE_SSL
    /*
-    * Do double lookups as needed...
+    * Shutdown encryption as needed...
     */
 
-    http_addrlist_t	*addrlist,	/* List of addresses */
-			*addr;		/* Current address */
+    if (httpIsEncrypted(con->http))
+      partial = 1;
+#endif /* HAVE_SSL */
 
-    if ((addrlist = httpAddrGetList(hostname, AF_UNSPEC, NULL)) != NULL)
+    if (partial)
     {
      /*
-      * See if the hostname maps to the same IP address...
+      * Only do a partial close so that the encrypted client gets everything.
       */
 
-      for (addr = addrlist; addr; addr = addr->next)
-        if (httpAddrEqual(httpGetAddress(con->http), &(addr->addr)))
-          break;
+      httpShutdown(con->http);
+      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
+                     NULL, con);
+
+      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for socket close.");
     }
     else
-      addr = NULL;
-
-    httpAddrFreeList(addrlist);
-
-    if (!addr)
     {
      /*
-      * Can't have a hostname that doesn't resolve to the same IP address
-      * with double-lookups enabled...
+      * Shut the socket down fully...
       */
 
+      cupsdRemoveSelect(httpGetFd(con->http));
       httpClose(con->http);
-
-      cupsdLogClient(con, CUPSD_LOG_WARN,
-                      "IP lookup failed - connection from %s closed!",
-                      httpGetHostname(con->http, NULL, 0));
-      free(con);
-      return;
+      con->http = NULL;
     }
   }
 
-#ifdef HAVE_TCPD_H
- /*
-  * See if the connection is denied by TCP wrappers...
-  */
+  if (!partial)
+  {
+   /*
+    * Free memory...
+    */
 
-  request_init(&wrap_req, RQ_DAEMON, "cupsd", RQ_FILE, httpGetFd(con->http),
-               NULL);
-  fromhost(&wrap_req);
+    cupsdRemoveSelect(httpGetFd(con->http));
 
-  if (!hosts_access(&wrap_req))
-  {
     httpClose(con->http);
 
-    cupsdLogClient(con, CUPSD_LOG_WARN,
-                    "Connection from %s refused by /etc/hosts.allow and "
-		    "/etc/hosts.deny rules.", httpGetHostname(con->http, NULL, 0));
-    free(con);
-    return;
-  }
-#endif /* HAVE_TCPD_H */
+    if (con->filename)
+    {
+      unlink(con->filename);
+      cupsdClearString(&con->filename);
+    }
 
-#ifdef AF_LOCAL
-  if (httpAddrFamily(httpGetAddress(con->http)) == AF_LOCAL)
-  {
-#  ifdef __APPLE__
-    socklen_t	peersize;		/* Size of peer credentials */
-    pid_t	peerpid;		/* Peer process ID */
-    char	peername[256];		/* Name of process */
+    cupsdClearString(&con->command);
+    cupsdClearString(&con->options);
+    cupsdClearString(&con->query_string);
 
-    peersize = sizeof(peerpid);
-    if (!getsockopt(httpGetFd(con->http), SOL_LOCAL, LOCAL_PEERPID, &peerpid,
-                    &peersize))
+    if (con->request)
     {
-      if (!proc_name((int)peerpid, peername, sizeof(peername)))
-	cupsdLogClient(con, CUPSD_LOG_DEBUG,
-	               "Accepted from %s (Domain ???[%d])",
-                       httpGetHostname(con->http, NULL, 0), (int)peerpid);
-      else
-	cupsdLogClient(con, CUPSD_LOG_DEBUG,
-                       "Accepted from %s (Domain %s[%d])",
-                       httpGetHostname(con->http, NULL, 0), peername, (int)peerpid);
-    }
-    else
-#  endif /* __APPLE__ */
-
-    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Accepted from %s (Domain)",
-                   httpGetHostname(con->http, NULL, 0));
-  }
-  else
-#endif /* AF_LOCAL */
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Accepted from %s:%d (IPv%d)",
-                 httpGetHostname(con->http, NULL, 0),
-		 httpAddrPort(httpGetAddress(con->http)),
-		 httpAddrFamily(httpGetAddress(con->http)) == AF_INET ? 4 : 6);
-
- /*
-  * Get the local address the client connected to...
-  */
-
-  addrlen = sizeof(temp);
-  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&temp, &addrlen))
-  {
-    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to get local address - %s",
-                   strerror(errno));
-
-    strlcpy(con->servername, "localhost", sizeof(con->servername));
-    con->serverport = LocalPort;
-  }
-#ifdef AF_LOCAL
-  else if (httpAddrFamily(&temp) == AF_LOCAL)
-  {
-    strlcpy(con->servername, "localhost", sizeof(con->servername));
-    con->serverport = LocalPort;
-  }
-#endif /* AF_LOCAL */
-  else
-  {
-    if (httpAddrLocalhost(&temp))
-      strlcpy(con->servername, "localhost", sizeof(con->servername));
-    else if (HostNameLookups)
-      httpAddrLookup(&temp, con->servername, sizeof(con->servername));
-    else
-      httpAddrString(&temp, con->servername, sizeof(con->servername));
-
-    con->serverport = httpAddrPort(&(lis->address));
-  }
-
- /*
-  * Add the connection to the array of active clients...
-  */
-
-  cupsArrayAdd(Clients, con);
-
- /*
-  * Add the socket to the server select.
-  */
-
-  cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL,
-                 con);
-
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for request.");
-
- /*
-  * Temporarily suspend accept()'s until we lose a client...
-  */
-
-  if (cupsArrayCount(Clients) == MaxClients)
-    cupsdPauseListening();
-
-#ifdef HAVE_SSL
- /*
-  * See if we are connecting on a secure port...
-  */
-
-  if (lis->encryption == HTTP_ENCRYPTION_ALWAYS)
-  {
-   /*
-    * https connection; go secure...
-    */
-
-    if (cupsd_start_tls(con, HTTP_ENCRYPTION_ALWAYS))
-      cupsdCloseClient(con);
-  }
-  else
-    con->auto_ssl = 1;
-#endif /* HAVE_SSL */
-}
-
-
-/*
- * 'cupsdCloseAllClients()' - Close all remote clients immediately.
- */
-
-void
-cupsdCloseAllClients(void)
-{
-  cupsd_client_t	*con;		/* Current client */
-
-
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCloseAllClients() Clients=%d", cupsArrayCount(Clients));
-
-  for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
-       con;
-       con = (cupsd_client_t *)cupsArrayNext(Clients))
-    if (cupsdCloseClient(con))
-      cupsdCloseClient(con);
-}
-
-
-/*
- * 'cupsdCloseClient()' - Close a remote client.
- */
-
-int					/* O - 1 if partial close, 0 if fully closed */
-cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
-{
-  int		partial;		/* Do partial close for SSL? */
-
-
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing connection.");
-
- /*
-  * Flush pending writes before closing...
-  */
-
-  httpFlushWrite(con->http);
-
-  partial = 0;
-
-  if (con->pipe_pid != 0)
-  {
-   /*
-    * Stop any CGI process...
-    */
-
-    cupsdEndProcess(con->pipe_pid, 1);
-    con->pipe_pid = 0;
-  }
-
-  if (con->file >= 0)
-  {
-    cupsdRemoveSelect(con->file);
-
-    close(con->file);
-    con->file = -1;
-  }
-
- /*
-  * Close the socket and clear the file from the input set for select()...
-  */
-
-  if (httpGetFd(con->http) >= 0)
-  {
-    cupsArrayRemove(ActiveClients, con);
-    cupsdSetBusyState(0);
-
-#ifdef HAVE_SSL
-   /*
-    * Shutdown encryption as needed...
-    */
-
-    if (httpIsEncrypted(con->http))
-      partial = 1;
-#endif /* HAVE_SSL */
-
-    if (partial)
-    {
-     /*
-      * Only do a partial close so that the encrypted client gets everything.
-      */
-
-      httpShutdown(con->http);
-      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
-                     NULL, con);
-
-      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for socket close.");
-    }
-    else
-    {
-     /*
-      * Shut the socket down fully...
-      */
-
-      cupsdRemoveSelect(httpGetFd(con->http));
-      httpClose(con->http);
-      con->http = NULL;
-    }
-  }
-
-  if (!partial)
-  {
-   /*
-    * Free memory...
-    */
-
-    cupsdRemoveSelect(httpGetFd(con->http));
-
-    httpClose(con->http);
-
-    if (con->filename)
-    {
-      unlink(con->filename);
-      cupsdClearString(&con->filename);
-    }
-
-    cupsdClearString(&con->command);
-    cupsdClearString(&con->options);
-    cupsdClearString(&con->query_string);
-
-    if (con->request)
-    {
-      ippDelete(con->request);
-      con->request = NULL;
+      ippDelete(con->request);
+      con->request = NULL;
     }
 
     if (con->response)
@@ -505,6 +321,9 @@ cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
       con->response = NULL;
     }
 
+    cupsArrayDelete(con->attr_refs);
+    con->attr_refs = NULL;
+
     if (con->language)
     {
       cupsLangFree(con->language);
@@ -533,7 +352,13 @@ cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
 
     cupsArrayRemove(Clients, con);
 
-    free(con);
+    if (con->host && -- con->host->count <= 0)
+    {
+      cupsArrayRemove(ClientHosts, con->host);
+      free(con->host);
+    }
+
+    cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
   }
 
   return (partial);
@@ -557,11 +382,14 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
   char			buf[1024];	/* Buffer for real filename */
   struct stat		filestats;	/* File information */
   mime_type_t		*type;		/* MIME type of file */
-  static unsigned	request_id = 0;	/* Request ID for temp files */
+  struct timeval	authtime,	/* Start of authorization */
+			curtime;	/* Current time */
 
 
   status = HTTP_STATUS_CONTINUE;
 
+  CUPSD_PROBE2(client__read, con->number, httpGetState(con->http));
+
   cupsdLogClient(con, CUPSD_LOG_DEBUG2, "cupsdReadClient: error=%d, used=%d, state=%s, data_encoding=HTTP_ENCODING_%s, data_remaining=" CUPS_LLFMT ", request=%p(%s), file=%d", httpError(con->http), (int)httpGetReady(con->http), httpStateString(httpGetState(con->http)), httpIsChunked(con->http) ? "CHUNKED" : "LENGTH", CUPS_LLCAST httpGetRemaining(con->http), con->request, con->request ? ippStateString(ippGetState(con->request)) : "", con->file);
 
   if (httpError(con->http) == EPIPE && !httpGetReady(con->http) && recv(httpGetFd(con->http), buf, 1, MSG_PEEK) < 1)
@@ -575,6 +403,26 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
     return;
   }
 
+  if (con->doc_fd >= 0)
+  {
+   /*
+    * Continue copying a passed document, then process the request...
+    */
+
+    if (!copy_document(con))
+    {
+      cupsdProcessIPPRequest(con);
+
+      if (con->filename)
+      {
+	unlink(con->filename);
+	cupsdClearString(&con->filename);
+      }
+    }
+
+    return;
+  }
+
   if (httpGetState(con->http) == HTTP_STATE_GET_SEND ||
       httpGetState(con->http) == HTTP_STATE_POST_SEND ||
       httpGetState(con->http) == HTTP_STATE_STATUS)
@@ -590,6 +438,18 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
   }
 
 #ifdef HAVE_SSL
+  if (con->tls_timeout)
+  {
+   /*
+    * Continue the TLS handshake...
+    */
+
+    if (cupsd_accept_tls(con) < 0)
+      cupsdCloseClient(con);
+
+    return;
+  }
+
   if (con->auto_ssl)
   {
    /*
@@ -607,7 +467,7 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
       cupsdLogClient(con, CUPSD_LOG_DEBUG2, "Saw first byte %02X, auto-negotiating SSL/TLS session.", buf[0] & 255);
 
-      if (cupsd_start_tls(con, HTTP_ENCRYPTION_ALWAYS))
+      if (cupsd_accept_tls(con) < 0)
         cupsdCloseClient(con);
 
       return;
@@ -674,6 +534,9 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	  con->response = NULL;
 	}
 
+	cupsArrayDelete(con->attr_refs);
+	con->attr_refs = NULL;
+
 	if (con->language)
 	{
 	  cupsLangFree(con->language);
@@ -750,6 +613,12 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
         gettimeofday(&(con->start), NULL);
 
+        timerclear(&con->fields_time);
+        timerclear(&con->ipp_start);
+        timerclear(&con->ipp_end);
+        con->auth_secs   = 0.0;
+        con->policy_secs = 0.0;
+
         cupsdLogClient(con, CUPSD_LOG_DEBUG, "%s %s HTTP/%d.%d",
 	               httpStateString(con->operation) + 11, con->uri,
 		       httpGetVersion(con->http) / 100,
@@ -864,8 +733,13 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
     else
       con->language = cupsLangGet(DefaultLocale);
 
+    gettimeofday(&con->fields_time, NULL);
+
     cupsdAuthorize(con);
 
+    gettimeofday(&curtime, NULL);
+    con->auth_secs = cupsdElapsedTime(&con->fields_time, &curtime);
+
     if (!_cups_strncasecmp(httpGetField(con->http, HTTP_FIELD_CONNECTION),
                            "Keep-Alive", 10) && KeepAlive)
       httpSetKeepAlive(con->http, HTTP_KEEPALIVE_ON);
@@ -1007,7 +881,14 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 #endif /* HAVE_SSL */
       }
 
-      if ((status = cupsdIsAuthorized(con, NULL)) != HTTP_STATUS_OK)
+      gettimeofday(&authtime, NULL);
+
+      status = cupsdIsAuthorized(con, NULL);
+
+      gettimeofday(&curtime, NULL);
+      con->auth_secs += cupsdElapsedTime(&authtime, &curtime);
+
+      if (status != HTTP_STATUS_OK)
       {
 	cupsdSendError(con, status, CUPSD_AUTH_NONE);
 	cupsdCloseClient(con);
@@ -1049,23 +930,49 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	case HTTP_STATE_GET_SEND :
             cupsdLogClient(con, CUPSD_LOG_DEBUG, "Processing GET %s", con->uri);
 
-            if ((filename = get_file(con, &filestats, buf, sizeof(buf))) != NULL)
+            if (!strncmp(con->uri, "/metrics", 8) && (!con->uri[8] || con->uri[8] == '?'))
             {
-	      type = mimeFileType(MimeDatabase, filename, NULL, NULL);
-
-              cupsdLogClient(con, CUPSD_LOG_DEBUG, "filename=\"%s\", type=%s/%s", filename, type ? type->super : "", type ? type->type : "");
+             /*
+	      * Send scheduler metrics...
+	      */
 
-              if (is_cgi(con, filename, &filestats, type))
+              if (!write_metrics(con))
 	      {
-	       /*
-	        * Note: con->command and con->options were set by is_cgi()...
-		*/
+		cupsdCloseClient(con);
+		return;
+	      }
 
-        	if (!cupsdSendCommand(con, con->command, con->options, 0))
-		{
-		  if (!cupsdSendError(con, HTTP_STATUS_NOT_FOUND, CUPSD_AUTH_NONE))
-		  {
-		    cupsdCloseClient(con);
+	      cupsdLogRequest(con, HTTP_STATUS_OK);
+            }
+            else if (!strncmp(con->uri, "/api/", 5))
+            {
+             /*
+	      * Send JSON status information...
+	      */
+
+              if (!write_api(con))
+	      {
+		cupsdCloseClient(con);
+		return;
+	      }
+            }
+            else if ((filename = get_file(con, &filestats, buf, sizeof(buf))) != NULL)
+            {
+	      type = mimeFileType(MimeDatabase, filename, NULL, NULL);
+
+              cupsdLogClient(con, CUPSD_LOG_DEBUG, "filename=\"%s\", type=%s/%s", filename, type ? type->super : "", type ? type->type : "");
+
+              if (is_cgi(con, filename, &filestats, type))
+	      {
+	       /*
+	        * Note: con->command and con->options were set by is_cgi()...
+		*/
+
+        	if (!cupsdSendCommand(con, con->command, con->options, 0))
+		{
+		  if (!cupsdSendError(con, HTTP_STATUS_NOT_FOUND, CUPSD_AUTH_NONE))
+		  {
+		    cupsdCloseClient(con);
 		    return;
 		  }
         	}
@@ -1224,7 +1131,7 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
 	    if (!strcmp(httpGetField(con->http, HTTP_FIELD_CONTENT_TYPE), "application/ipp"))
 	    {
-              con->request = ippNew();
+              con->request = _ippNewArena();
               break;
             }
             else if (!WebInterface)
@@ -1380,7 +1287,7 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	    * Open a temporary file to hold the request...
 	    */
 
-            cupsdSetStringf(&con->filename, "%s/%08x", RequestRoot, request_id ++);
+            cupsdSetStringf(&con->filename, "%s/%08x", RequestRoot, RequestID ++);
 	    con->file = open(con->filename, O_WRONLY | O_CREAT | O_TRUNC, 0640);
 
 	    if (con->file < 0)
@@ -1420,6 +1327,8 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	      }
 	      else
 	      {
+	        char	etag[256];	/* ETag for file */
+
 	       /*
 		* Serve a file...
 		*/
@@ -1435,6 +1344,9 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 		httpSetField(con->http, HTTP_FIELD_LAST_MODIFIED, httpGetDateString(filestats.st_mtime));
 		httpSetLength(con->http, (size_t)filestats.st_size);
 
+		make_etag(&filestats, 0, etag, sizeof(etag));
+		httpSetField(con->http, HTTP_FIELD_ETAG, etag);
+
 		if (!cupsdSendHeader(con, HTTP_STATUS_OK, line, CUPSD_AUTH_NONE))
 		{
 		  cupsdCloseClient(con);
@@ -1658,8 +1570,9 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	    */
 
             cupsdSetStringf(&con->filename, "%s/%08x", RequestRoot,
-	                    request_id ++);
-	    con->file = open(con->filename, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+	                    RequestID ++);
+	    con->file      = open(con->filename, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+	    con->file_hash = 2166136261U;
 
 	    if (con->file < 0)
 	    {
@@ -1677,12 +1590,50 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	    fchmod(con->file, 0640);
 	    fchown(con->file, RunUser, Group);
             fcntl(con->file, F_SETFD, fcntl(con->file, F_GETFD) | FD_CLOEXEC);
+
+#ifdef HAVE_FALLOCATE
+           /*
+	    * Reserve space for the rest of the request up front so the file
+	    * doesn't grow a block at a time; the file size is unchanged...
+	    */
+
+            if (con->file >= 0 && !httpIsChunked(con->http) &&
+	        httpGetRemaining(con->http) > 0)
+	      fallocate(con->file, FALLOC_FL_KEEP_SIZE, 0,
+	                (off_t)httpGetRemaining(con->http));
+#endif /* HAVE_FALLOCATE */
 	  }
 
 	  if (httpGetState(con->http) != HTTP_STATE_POST_SEND)
 	  {
 	    if (!httpWait(con->http, 0))
 	      return;
+#ifdef HAVE_SPLICE
+	    else if (!DeduplicateJobFiles && con->file >= 0 &&
+	             (bytes = (int)_httpRecvFile(con->http, con->file,
+		                                 CUPSD_RECVFILE_SIZE)) > 0)
+	    {
+	     /*
+	      * Received data straight from the socket into the file (documents
+	      * that are hashed for DeduplicateJobFiles use httpRead2)...
+	      */
+	      con->bytes += bytes;
+
+              if (MaxRequestSize > 0 && con->bytes > MaxRequestSize)
+              {
+                close(con->file);
+                con->file = -1;
+                unlink(con->filename);
+                cupsdClearString(&con->filename);
+
+                if (!cupsdSendError(con, HTTP_STATUS_REQUEST_TOO_LARGE, CUPSD_AUTH_NONE))
+                {
+                  cupsdCloseClient(con);
+                  return;
+                }
+              }
+	    }
+#endif /* HAVE_SPLICE */
             else if ((bytes = httpRead2(con->http, line, sizeof(line))) < 0)
 	    {
 	      if (httpError(con->http) && httpError(con->http) != EPIPE)
@@ -1714,6 +1665,17 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
                 }
               }
 
+             /*
+	      * Hash the data as it arrives so identical documents can be found
+	      * without reading them again (FNV-1a)...
+	      */
+
+	      if (DeduplicateJobFiles)
+	      {
+	        for (ptr = line; ptr < (line + bytes); ptr ++)
+		  con->file_hash = (con->file_hash ^ (unsigned char)*ptr) * 16777619U;
+	      }
+
               if (write(con->file, line, (size_t)bytes) < bytes)
 	      {
         	cupsdLogClient(con, CUPSD_LOG_ERROR,
@@ -1809,6 +1771,9 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
           if (con->request)
 	  {
+	    if (copy_document(con))
+	      return;			/* Request is processed after the copy */
+
 	    cupsdProcessIPPRequest(con);
 
 	    if (con->filename)
@@ -1838,6 +1803,14 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
     {
       cupsArrayRemove(ActiveClients, con);
       cupsdSetBusyState(0);
+
+     /*
+      * Release the header fields and I/O buffers while waiting for the next
+      * request...
+      */
+
+      httpClearFields(con->http);
+      _httpShrinkBuffers(con->http);
     }
   }
 }
@@ -2219,7 +2192,7 @@ cupsdUpdateCGI(void)
     if (loglevel == CUPSD_LOG_INFO)
       cupsdLogMessage(CUPSD_LOG_INFO, "%s", message);
 
-    if (!strchr(CGIStatusBuffer->buffer, '\n'))
+    if (!CGIStatusBuffer->buflines)
       break;
   }
 
@@ -2250,6 +2223,8 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
   ipp_state_t	ipp_state;		/* IPP state value */
 
 
+  CUPSD_PROBE2(client__write, con->number, httpGetState(con->http));
+
   cupsdLogClient(con, CUPSD_LOG_DEBUG, "con->http=%p", con->http);
   cupsdLogClient(con, CUPSD_LOG_DEBUG,
 		 "cupsdWriteClient "
@@ -2355,6 +2330,17 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
                    (int)bytes, httpGetState(con->http),
                    CUPS_LLCAST httpGetLength2(con->http));
   }
+#ifdef HAVE_SENDFILE
+  else if (!con->pipe_pid &&
+           (bytes = (int)_httpSendFile(con->http, con->file, CUPSD_SENDFILE_SIZE)) >= 0)
+  {
+   /*
+    * Sent file data straight from the file to the socket...
+    */
+
+    con->bytes += bytes;
+  }
+#endif /* HAVE_SENDFILE */
   else if ((bytes = read(con->file, con->header + con->header_used, (size_t)bytes)) > 0)
   {
     con->header_used += bytes;
@@ -2536,9 +2522,20 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
 
     if (con->file >= 0)
     {
+      cupsd_cgiworker_t *worker;	/* Resident CGI program */
+
       cupsdRemoveSelect(con->file);
 
-      if (con->pipe_pid)
+      if (con->pipe_pid && (worker = find_worker(con->pipe_pid)) != NULL)
+      {
+       /*
+        * The request is done, keep the program for the next one...
+	*/
+
+        worker->busy = 0;
+	worker->time = time(NULL);
+      }
+      else if (con->pipe_pid)
 	cupsdEndProcess(con->pipe_pid, 0);
 
       close(con->file);
@@ -2564,6 +2561,9 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
       con->response = NULL;
     }
 
+    cupsArrayDelete(con->attr_refs);
+    con->attr_refs = NULL;
+
     cupsdClearString(&con->command);
     cupsdClearString(&con->options);
     cupsdClearString(&con->query_string);
@@ -2579,103 +2579,828 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
     {
       cupsArrayRemove(ActiveClients, con);
       cupsdSetBusyState(0);
+
+     /*
+      * Start on the next pipelined request right away rather than waiting
+      * for another trip through the main loop...
+      */
+
+      if (httpGetReady(con->http))
+        cupsdReadClient(con);
+      else
+      {
+        httpClearFields(con->http);
+        _httpShrinkBuffers(con->http);
+      }
     }
   }
 }
 
 
 /*
- * 'check_if_modified()' - Decode an "If-Modified-Since" line.
+ * 'accept_client()' - Accept a single new client.
  */
 
-static int				/* O - 1 if modified since */
-check_if_modified(
-    cupsd_client_t *con,		/* I - Client connection */
-    struct stat    *filestats)		/* I - File information */
+static int				/* O - 1 to continue accepting, 0 to stop */
+accept_client(cupsd_listener_t *lis)	/* I - Listener socket */
 {
-  const char	*ptr;			/* Pointer into field */
-  time_t	date;			/* Time/date value */
-  off_t		size;			/* Size/length value */
+  const char		*hostname;	/* Hostname of client */
+  char			name[256];	/* Hostname of client */
+  int			count;		/* Count of connections on a host */
+  cupsd_client_t	*con;		/* New client pointer */
+  cupsd_clienthost_t	key,		/* Search key for client address */
+			*host;		/* Connections from client address */
+  socklen_t		addrlen;	/* Length of address */
+  http_addr_t		temp;		/* Temporary address variable */
+  static time_t		last_dos = 0;	/* Time of last DoS attack */
+#ifdef HAVE_TCPD_H
+  struct request_info	wrap_req;	/* TCP wrappers request information */
+#endif /* HAVE_TCPD_H */
 
 
-  size = 0;
-  date = 0;
-  ptr  = httpGetField(con->http, HTTP_FIELD_IF_MODIFIED_SINCE);
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "accept_client(lis=%p(%d)) Clients=%d", lis, lis->fd, cupsArrayCount(Clients));
 
-  if (*ptr == '\0')
-    return (1);
+ /*
+  * Make sure we don't have a full set of clients already...
+  */
 
-  cupsdLogClient(con, CUPSD_LOG_DEBUG2, "check_if_modified: filestats=%p(" CUPS_LLFMT ", %d)) If-Modified-Since=\"%s\"", filestats, CUPS_LLCAST filestats->st_size, (int)filestats->st_mtime, ptr);
+  if (cupsArrayCount(Clients) >= MaxClients)
+    return (0);
 
-  while (*ptr != '\0')
+  cupsdSetBusyState(1);
+
+ /*
+  * Get a pointer to the next available client...
+  */
+
+  if (!Clients)
+    Clients = cupsArrayNew(NULL, NULL);
+
+  if (!Clients)
   {
-    while (isspace(*ptr) || *ptr == ';')
-      ptr ++;
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for clients array!");
+    cupsdPauseListening();
+    return (0);
+  }
 
-    if (_cups_strncasecmp(ptr, "length=", 7) == 0)
-    {
-      ptr += 7;
-      size = strtoll(ptr, NULL, 10);
+  if (!ClientHosts)
+    ClientHosts = cupsArrayNew((cups_array_func_t)compare_addrs, NULL);
 
-      while (isdigit(*ptr))
-        ptr ++;
-    }
-    else if (isalpha(*ptr))
+  if (!ClientHosts)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for client hosts array!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+  if (!ActiveClients)
+    ActiveClients = cupsArrayNew((cups_array_func_t)compare_clients, NULL);
+
+  if (!ActiveClients)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for active clients array!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+  if ((con = cupsdSlabAlloc(CUPSD_SLAB_CLIENT)) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for client!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+ /*
+  * Accept the client and get the remote address...
+  */
+
+  con->file   = -1;
+  con->doc_fd = -1;
+
+  if ((con->http = httpAcceptConnection(lis->fd, 0)) == NULL)
+  {
+   /*
+    * The listening socket is non-blocking, so EAGAIN/EWOULDBLOCK just means
+    * there are no more pending connections...
+    */
+
+    if (errno == ENFILE || errno == EMFILE)
+      cupsdPauseListening();
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to accept client connection - %s.",
+                      strerror(errno));
+
+    cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
+
+    return (0);
+  }
+
+  con->number = ++ LastClientNumber;
+
+#ifndef __linux
+ /*
+  * Other platforms copy O_NONBLOCK from the listening socket...
+  */
+
+  fcntl(httpGetFd(con->http), F_SETFL, fcntl(httpGetFd(con->http), F_GETFL) & ~O_NONBLOCK);
+#endif /* !__linux */
+
+  if (HTTPBufferSize > 0)
+    httpSetBufferSize(con->http, (size_t)HTTPBufferSize);
+
+ /*
+  * Save the connected address and port number...
+  */
+
+  addrlen = sizeof(con->clientaddr);
+
+  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&con->clientaddr, &addrlen) || addrlen == 0)
+    con->clientaddr = lis->address;
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Server address is \"%s\".", httpAddrString(&con->clientaddr, name, sizeof(name)));
+
+ /*
+  * Check the number of clients on the same address...
+  */
+
+  key.addr = *httpGetAddress(con->http);
+  host     = (cupsd_clienthost_t *)cupsArrayFind(ClientHosts, &key);
+  count    = host ? host->count : 0;
+
+  if (count >= MaxClientsPerHost)
+  {
+    if ((time(NULL) - last_dos) >= 60)
     {
-      date = httpGetDateTime(ptr);
-      while (*ptr != '\0' && *ptr != ';')
-        ptr ++;
+      last_dos = time(NULL);
+      cupsdLogMessage(CUPSD_LOG_WARN,
+                      "Possible DoS attack - more than %d clients connecting "
+		      "from %s.",
+	              MaxClientsPerHost,
+		      httpGetHostname(con->http, name, sizeof(name)));
     }
-    else
-      ptr ++;
+
+    httpClose(con->http);
+    cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
+    return (1);
   }
 
-  return ((size != filestats->st_size && size != 0) ||
-          (date < filestats->st_mtime && date != 0) ||
-	  (size == 0 && date == 0));
-}
+ /*
+  * Get the hostname or format the IP address as needed...
+  */
 
+  if (HostNameLookups)
+    hostname = resolve_hostname(con);
+  else
+    hostname = httpGetHostname(con->http, NULL, 0);
 
-/*
- * 'compare_clients()' - Compare two client connections.
+  if (hostname == NULL && HostNameLookups == 2)
+  {
+   /*
+    * Can't have an unresolved IP address with double-lookups enabled...
+    */
+
+    httpClose(con->http);
+
+    cupsdLogClient(con, CUPSD_LOG_WARN,
+                    "Name lookup failed - connection from %s closed!",
+                    httpGetHostname(con->http, NULL, 0));
+
+    cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
+    return (1);
+  }
+
+  if (HostNameLookups == 2)
+  {
+   /*
+    * Do double lookups as needed...
+    */
+
+    http_addrlist_t	*addrlist,	/* List of addresses */
+			*addr;		/* Current address */
+
+    if ((addrlist = httpAddrGetList(hostname, AF_UNSPEC, NULL)) != NULL)
+    {
+     /*
+      * See if the hostname maps to the same IP address...
+      */
+
+      for (addr = addrlist; addr; addr = addr->next)
+        if (httpAddrEqual(httpGetAddress(con->http), &(addr->addr)))
+          break;
+    }
+    else
+      addr = NULL;
+
+    httpAddrFreeList(addrlist);
+
+    if (!addr)
+    {
+     /*
+      * Can't have a hostname that doesn't resolve to the same IP address
+      * with double-lookups enabled...
+      */
+
+      httpClose(con->http);
+
+      cupsdLogClient(con, CUPSD_LOG_WARN,
+                      "IP lookup failed - connection from %s closed!",
+                      httpGetHostname(con->http, NULL, 0));
+      cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
+      return (1);
+    }
+  }
+
+#ifdef HAVE_TCPD_H
+ /*
+  * See if the connection is denied by TCP wrappers...
+  */
+
+  request_init(&wrap_req, RQ_DAEMON, "cupsd", RQ_FILE, httpGetFd(con->http),
+               NULL);
+  fromhost(&wrap_req);
+
+  if (!hosts_access(&wrap_req))
+  {
+    httpClose(con->http);
+
+    cupsdLogClient(con, CUPSD_LOG_WARN,
+                    "Connection from %s refused by /etc/hosts.allow and "
+		    "/etc/hosts.deny rules.", httpGetHostname(con->http, NULL, 0));
+    cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
+    return (1);
+  }
+#endif /* HAVE_TCPD_H */
+
+#ifdef AF_LOCAL
+  if (httpAddrFamily(httpGetAddress(con->http)) == AF_LOCAL)
+  {
+#  ifdef __APPLE__
+    socklen_t	peersize;		/* Size of peer credentials */
+    pid_t	peerpid;		/* Peer process ID */
+    char	peername[256];		/* Name of process */
+
+    peersize = sizeof(peerpid);
+    if (!getsockopt(httpGetFd(con->http), SOL_LOCAL, LOCAL_PEERPID, &peerpid,
+                    &peersize))
+    {
+      if (!proc_name((int)peerpid, peername, sizeof(peername)))
+	cupsdLogClient(con, CUPSD_LOG_DEBUG,
+	               "Accepted from %s (Domain ???[%d])",
+                       httpGetHostname(con->http, NULL, 0), (int)peerpid);
+      else
+	cupsdLogClient(con, CUPSD_LOG_DEBUG,
+                       "Accepted from %s (Domain %s[%d])",
+                       httpGetHostname(con->http, NULL, 0), peername, (int)peerpid);
+    }
+    else
+#  endif /* __APPLE__ */
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Accepted from %s (Domain)",
+                   httpGetHostname(con->http, NULL, 0));
+  }
+  else
+#endif /* AF_LOCAL */
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Accepted from %s:%d (IPv%d)",
+                 httpGetHostname(con->http, NULL, 0),
+		 httpAddrPort(httpGetAddress(con->http)),
+		 httpAddrFamily(httpGetAddress(con->http)) == AF_INET ? 4 : 6);
+
+ /*
+  * Get the local address the client connected to...
+  */
+
+  addrlen = sizeof(temp);
+  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&temp, &addrlen))
+  {
+    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to get local address - %s",
+                   strerror(errno));
+
+    strlcpy(con->servername, "localhost", sizeof(con->servername));
+    con->serverport = LocalPort;
+  }
+#ifdef AF_LOCAL
+  else if (httpAddrFamily(&temp) == AF_LOCAL)
+  {
+    strlcpy(con->servername, "localhost", sizeof(con->servername));
+    con->serverport = LocalPort;
+  }
+#endif /* AF_LOCAL */
+  else
+  {
+    if (httpAddrLocalhost(&temp))
+      strlcpy(con->servername, "localhost", sizeof(con->servername));
+    else if (!HostNameLookups || !lookup_hostname(&temp, con->servername, sizeof(con->servername)))
+      httpAddrString(&temp, con->servername, sizeof(con->servername));
+
+    con->serverport = httpAddrPort(&(lis->address));
+  }
+
+ /*
+  * Add the connection to the array of active clients...
+  */
+
+  if (!host)
+  {
+    if ((host = calloc(1, sizeof(cupsd_clienthost_t))) == NULL)
+    {
+      cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to allocate memory for client host!");
+      httpClose(con->http);
+      cupsdSlabFree(CUPSD_SLAB_CLIENT, con);
+      return (0);
+    }
+
+    host->addr = key.addr;
+    cupsArrayAdd(ClientHosts, host);
+  }
+
+  host->count ++;
+  con->host = host;
+
+  cupsArrayAdd(Clients, con);
+
+ /*
+  * Add the socket to the server select.
+  */
+
+  cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL,
+                 con);
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for request.");
+
+ /*
+  * Temporarily suspend accept()'s until we lose a client...
+  */
+
+  if (cupsArrayCount(Clients) == MaxClients)
+    cupsdPauseListening();
+
+#ifdef HAVE_SSL
+ /*
+  * See if we are connecting on a secure port...
+  */
+
+  if (lis->encryption == HTTP_ENCRYPTION_ALWAYS)
+  {
+   /*
+    * https connection; go secure...
+    */
+
+    if (cupsd_accept_tls(con) < 0)
+      cupsdCloseClient(con);
+  }
+  else
+    con->auto_ssl = 1;
+#endif /* HAVE_SSL */
+
+  return (1);
+}
+
+
+/*
+ * 'check_if_modified()' - Decode an "If-Modified-Since" line.
+ */
+
+static int				/* O - 1 if modified since */
+check_if_modified(
+    cupsd_client_t *con,		/* I - Client connection */
+    struct stat    *filestats)		/* I - File information */
+{
+  const char	*ptr;			/* Pointer into field */
+  time_t	date;			/* Time/date value */
+  off_t		size;			/* Size/length value */
+
+
+  ptr = httpGetField(con->http, HTTP_FIELD_IF_NONE_MATCH);
+
+  if (*ptr)
+  {
+   /*
+    * If-None-Match takes precedence over If-Modified-Since; both the plain
+    * and precompressed representations have the same contents...
+    */
+
+    char	etag[256];		/* ETag for file */
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG2, "check_if_modified: If-None-Match=\"%s\"", ptr);
+
+    if (!strcmp(ptr, "*"))
+      return (0);
+
+    make_etag(filestats, 0, etag, sizeof(etag));
+    if (strstr(ptr, etag))
+      return (0);
+
+    make_etag(filestats, 1, etag, sizeof(etag));
+    return (strstr(ptr, etag) == NULL);
+  }
+
+  size = 0;
+  date = 0;
+  ptr  = httpGetField(con->http, HTTP_FIELD_IF_MODIFIED_SINCE);
+
+  if (*ptr == '\0')
+    return (1);
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG2, "check_if_modified: filestats=%p(" CUPS_LLFMT ", %d)) If-Modified-Since=\"%s\"", filestats, CUPS_LLCAST filestats->st_size, (int)filestats->st_mtime, ptr);
+
+  while (*ptr != '\0')
+  {
+    while (isspace(*ptr) || *ptr == ';')
+      ptr ++;
+
+    if (_cups_strncasecmp(ptr, "length=", 7) == 0)
+    {
+      ptr += 7;
+      size = strtoll(ptr, NULL, 10);
+
+      while (isdigit(*ptr))
+        ptr ++;
+    }
+    else if (isalpha(*ptr))
+    {
+      date = httpGetDateTime(ptr);
+      while (*ptr != '\0' && *ptr != ';')
+        ptr ++;
+    }
+    else
+      ptr ++;
+  }
+
+  return ((size != filestats->st_size && size != 0) ||
+          (date < filestats->st_mtime && date != 0) ||
+	  (size == 0 && date == 0));
+}
+
+
+/*
+ * 'compare_addrs()' - Compare the addresses of two client hosts or hostnames.
+ *
+ * Ports are ignored, matching httpAddrEqual().
+ */
+
+static int				/* O - Result of comparison */
+compare_addrs(http_addr_t *a,		/* I - First address */
+              http_addr_t *b,		/* I - Second address */
+              void        *data)	/* I - User data (unused) */
+{
+  int	result;				/* Result of comparison */
+
+
+  (void)data;
+
+  if ((result = a->addr.sa_family - b->addr.sa_family) != 0)
+    return (result);
+
+#ifdef AF_LOCAL
+  if (a->addr.sa_family == AF_LOCAL)
+    return (strcmp(a->un.sun_path, b->un.sun_path));
+#endif /* AF_LOCAL */
+
+#ifdef AF_INET6
+  if (a->addr.sa_family == AF_INET6)
+    return (memcmp(&(a->ipv6.sin6_addr), &(b->ipv6.sin6_addr), 16));
+#endif /* AF_INET6 */
+
+  return (memcmp(&(a->ipv4.sin_addr), &(b->ipv4.sin_addr), sizeof(a->ipv4.sin_addr)));
+}
+
+
+/*
+ * 'compare_clients()' - Compare two client connections.
+ */
+
+static int				/* O - Result of comparison */
+compare_clients(cupsd_client_t *a,	/* I - First client */
+                cupsd_client_t *b,	/* I - Second client */
+                void           *data)	/* I - User data (not used) */
+{
+  (void)data;
+
+  if (a == b)
+    return (0);
+  else if (a < b)
+    return (-1);
+  else
+    return (1);
+}
+
+
+/*
+ * 'compare_filecache()' - Compare two cached static files.
+ */
+
+static int				/* O - Result of comparison */
+compare_filecache(
+    cupsd_filecache_t *a,		/* I - First file */
+    cupsd_filecache_t *b,		/* I - Second file */
+    void              *data)		/* I - User data (not used) */
+{
+  (void)data;
+
+  return (strcmp(a->filename, b->filename));
+}
+
+
+/*
+ * 'copy_document()' - Copy a document passed as a file descriptor.
+ *
+ * Local clients can pass an open document over the domain socket instead of
+ * sending its contents (the "document-fd" operation attribute).  The file is
+ * copied into the spool with copy_file_range(), which lets the filesystem
+ * share the data blocks when it can.
+ *
+ * At most CUPSD_COPYDOC_SIZE bytes are copied per call so a large document
+ * does not stall other clients - the main loop calls cupsdReadClient() again
+ * until the copy is done.
+ */
+
+static int				/* O - 1 if copy in progress, 0 if done */
+copy_document(cupsd_client_t *con)	/* I - Client connection */
+{
+  int		srcfd;			/* Passed file descriptor */
+  struct stat	srcinfo;		/* Passed file information */
+  off_t		total = 0;		/* Bytes copied by this call */
+  ssize_t	bytes = 0;		/* Bytes copied */
+  size_t	length;			/* Bytes to copy */
+  char		buffer[32768],		/* Copy buffer */
+		*ptr;			/* Pointer into buffer */
+
+
+  if (con->doc_fd < 0)
+  {
+   /*
+    * Start a new copy...
+    */
+
+    if ((srcfd = _httpTakeFd(con->http)) < 0)
+      return (0);
+
+    if (con->filename || !ippFindAttribute(con->request, "document-fd", IPP_TAG_BOOLEAN))
+    {
+      close(srcfd);
+      return (0);
+    }
+
+    if (fstat(srcfd, &srcinfo) || !S_ISREG(srcinfo.st_mode))
+    {
+      cupsdLogClient(con, CUPSD_LOG_ERROR, "Passed document is not a regular file.");
+      close(srcfd);
+      return (0);
+    }
+
+    if (MaxRequestSize > 0 && srcinfo.st_size > MaxRequestSize)
+    {
+      cupsdLogClient(con, CUPSD_LOG_ERROR, "Passed document is too large (" CUPS_LLFMT " bytes).", CUPS_LLCAST srcinfo.st_size);
+      close(srcfd);
+      return (0);
+    }
+
+    cupsdSetStringf(&con->filename, "%s/%08x", RequestRoot, RequestID ++);
+
+    if ((con->file = open(con->filename, O_WRONLY | O_CREAT | O_TRUNC, 0640)) < 0)
+    {
+      cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to create request file \"%s\": %s", con->filename, strerror(errno));
+      cupsdClearString(&con->filename);
+      close(srcfd);
+      return (0);
+    }
+
+    fchmod(con->file, 0640);
+    fchown(con->file, RunUser, Group);
+
+    con->doc_fd    = srcfd;
+    con->doc_size  = srcinfo.st_size;
+    con->doc_bytes = 0;
+    con->file_hash = 2166136261U;
+  }
+
+ /*
+  * Copy the next chunk, never more than the size checked above...
+  */
+
+  while (total < CUPSD_COPYDOC_SIZE && con->doc_bytes < con->doc_size)
+  {
+    length = (size_t)(con->doc_size - con->doc_bytes);
+    if (length > (size_t)(CUPSD_COPYDOC_SIZE - total))
+      length = (size_t)(CUPSD_COPYDOC_SIZE - total);
+
+#ifdef HAVE_COPY_FILE_RANGE
+   /*
+    * Documents that are hashed for DeduplicateJobFiles are read below...
+    */
+
+    if (!DeduplicateJobFiles && (bytes = copy_file_range(con->doc_fd, NULL, con->file, NULL, length, 0)) > 0)
+    {
+      total          += bytes;
+      con->doc_bytes += bytes;
+      continue;
+    }
+#endif /* HAVE_COPY_FILE_RANGE */
+
+    if (length > sizeof(buffer))
+      length = sizeof(buffer);
+
+    if ((bytes = read(con->doc_fd, buffer, length)) <= 0)
+      break;
+
+    if (DeduplicateJobFiles)
+    {
+      for (ptr = buffer; ptr < (buffer + bytes); ptr ++)
+	con->file_hash = (con->file_hash ^ (unsigned char)*ptr) * 16777619U;
+    }
+
+    if (write(con->file, buffer, (size_t)bytes) < bytes)
+    {
+      bytes = -1;
+      break;
+    }
+
+    total          += bytes;
+    con->doc_bytes += bytes;
+  }
+
+  if (bytes > 0 && con->doc_bytes < con->doc_size)
+    return (1);
+
+ /*
+  * Done, close the files...
+  */
+
+  close(con->doc_fd);
+  con->doc_fd = -1;
+
+  if (close(con->file) || bytes < 0 || con->doc_bytes == 0)
+  {
+    if (con->doc_bytes > 0)
+      cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to copy passed document to \"%s\": %s", con->filename, strerror(errno));
+
+    con->file = -1;
+
+    unlink(con->filename);
+    cupsdClearString(&con->filename);
+    return (0);
+  }
+
+  con->file   = -1;
+  con->bytes += con->doc_bytes;
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Copied " CUPS_LLFMT " bytes from passed document.", CUPS_LLCAST con->doc_bytes);
+
+  return (0);
+}
+
+
+#ifdef HAVE_SSL
+/*
+ * 'cupsd_accept_tls()' - Start or continue the TLS handshake on a connection.
+ *
+ * The handshake is driven by the select loop, so a slow client does not hold
+ * up other clients.  The main loop closes the connection if the handshake
+ * is not done by the deadline in "tls_timeout".
+ */
+
+static int				/* O - 1 when encrypted, 0 if in progress, -1 on error */
+cupsd_accept_tls(cupsd_client_t *con)	/* I - Client connection */
+{
+  int	status;				/* Handshake status */
+
+
+  if (!con->tls_timeout)
+  {
+    cupsdLogClient(con, CUPSD_LOG_DEBUG2, "Starting TLS handshake.");
+    con->tls_timeout = time(NULL) + CUPSD_TLS_TIMEOUT;
+  }
+
+  if ((status = _httpTLSHandshake(con->http)) < 0)
+  {
+    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to encrypt connection: %s",
+                   cupsLastErrorString());
+    con->tls_timeout = 0;
+  }
+  else if (status > 0)
+  {
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Connection now encrypted.");
+    con->tls_timeout = 0;
+  }
+
+  return (status);
+}
+
+
+/*
+ * 'cupsd_start_tls()' - Start encryption on a connection.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+cupsd_start_tls(cupsd_client_t    *con,	/* I - Client connection */
+                http_encryption_t e)	/* I - Encryption mode */
+{
+  if (httpEncryption(con->http, e))
+  {
+    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to encrypt connection: %s",
+                   cupsLastErrorString());
+    return (-1);
+  }
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Connection now encrypted.");
+  return (0);
+}
+#endif /* HAVE_SSL */
+
+
+/*
+ * 'find_worker()' - Find the resident CGI program for a process ID.
+ */
+
+static cupsd_cgiworker_t *		/* O - CGI program or NULL */
+find_worker(int pid)			/* I - Process ID */
+{
+  cupsd_cgiworker_t	*worker;	/* Current CGI program */
+
+
+  for (worker = (cupsd_cgiworker_t *)cupsArrayFirst(CGIWorkers);
+       worker;
+       worker = (cupsd_cgiworker_t *)cupsArrayNext(CGIWorkers))
+    if (worker->pid == pid)
+      break;
+
+  return (worker);
+}
+
+
+/*
+ * 'free_filecache()' - Free a cached static file.
  */
 
-static int				/* O - Result of comparison */
-compare_clients(cupsd_client_t *a,	/* I - First client */
-                cupsd_client_t *b,	/* I - Second client */
-                void           *data)	/* I - User data (not used) */
+static void
+free_filecache(cupsd_filecache_t *cache)/* I - Cached file */
 {
-  (void)data;
+  FileCacheBytes -= (size_t)cache->size;
 
-  if (a == b)
-    return (0);
-  else if (a < b)
-    return (-1);
-  else
-    return (1);
+  free(cache->filename);
+  free(cache->data);
+  free(cache);
 }
 
 
-#ifdef HAVE_SSL
 /*
- * 'cupsd_start_tls()' - Start encryption on a connection.
+ * 'get_api_option()' - Get the value of a query string option.
  */
 
-static int				/* O - 0 on success, -1 on error */
-cupsd_start_tls(cupsd_client_t    *con,	/* I - Client connection */
-                http_encryption_t e)	/* I - Encryption mode */
+static int				/* O - 1 if found, 0 otherwise */
+get_api_option(const char *query,	/* I - Query string */
+               const char *name,	/* I - Option name */
+               char       *value,	/* O - Option value */
+               size_t     valuesize)	/* I - Size of value buffer */
 {
-  if (httpEncryption(con->http, e))
+  size_t	namelen = strlen(name);	/* Length of name */
+  char		*valptr,		/* Pointer into value */
+		*valend;		/* End of value buffer */
+
+
+  *value = '\0';
+
+  while (*query)
   {
-    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to encrypt connection: %s",
-                   cupsLastErrorString());
-    return (-1);
+    if (!strncmp(query, name, namelen) && query[namelen] == '=')
+    {
+     /*
+      * Copy and decode the value...
+      */
+
+      for (query += namelen + 1, valptr = value, valend = value + valuesize - 1; *query && *query != '&' && valptr < valend; query ++)
+      {
+        if (*query == '+')
+	  *valptr++ = ' ';
+	else if (*query == '%' && isxdigit(query[1] & 255) && isxdigit(query[2] & 255))
+	{
+	  int	ch;			/* Decoded character */
+
+	  sscanf(query + 1, "%2x", &ch);
+	  *valptr++ = (char)ch;
+	  query += 2;
+	}
+	else
+	  *valptr++ = *query;
+      }
+
+      *valptr = '\0';
+
+      return (1);
+    }
+
+    if ((query = strchr(query, '&')) == NULL)
+      break;
+
+    query ++;
   }
 
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Connection now encrypted.");
   return (0);
 }
-#endif /* HAVE_SSL */
 
 
 /*
@@ -2991,6 +3716,91 @@ get_file(cupsd_client_t *con,		/* I  - Client connection */
 }
 
 
+/*
+ * 'get_filecache()' - Get the contents of a small static file from the cache.
+ *
+ * Files are reloaded when their size or modification time changes.  Files
+ * that are too large or can't be read are not cached.
+ */
+
+static cupsd_filecache_t *		/* O - Cached file or `NULL` */
+get_filecache(const char  *filename,	/* I - Filename */
+              struct stat *filestats)	/* I - File information */
+{
+  cupsd_filecache_t	key,		/* Search key */
+			*cache;		/* Cached file */
+  int			fd;		/* File descriptor */
+  ssize_t		bytes;		/* Bytes read */
+  off_t			total;		/* Total bytes read */
+
+
+  if (filestats->st_size <= 0 || filestats->st_size > CUPSD_FILE_CACHE_MAX)
+    return (NULL);
+
+  if (!FileCache && (FileCache = cupsArrayNew3((cups_array_func_t)compare_filecache, NULL, NULL, 0, NULL, (cups_afree_func_t)free_filecache)) == NULL)
+    return (NULL);
+
+  key.filename = (char *)filename;
+
+  if ((cache = (cupsd_filecache_t *)cupsArrayFind(FileCache, &key)) != NULL)
+  {
+    if (cache->mtime == filestats->st_mtime && cache->size == filestats->st_size)
+      return (cache);
+
+    cupsArrayRemove(FileCache, cache);
+  }
+
+ /*
+  * Make room and load the file...
+  */
+
+  while (FileCacheBytes + (size_t)filestats->st_size > CUPSD_FILE_CACHE_SIZE && (cache = (cupsd_filecache_t *)cupsArrayFirst(FileCache)) != NULL)
+    cupsArrayRemove(FileCache, cache);
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return (NULL);
+
+  if ((cache = calloc(1, sizeof(cupsd_filecache_t))) == NULL || (cache->data = malloc((size_t)filestats->st_size)) == NULL || (cache->filename = strdup(filename)) == NULL)
+  {
+    close(fd);
+
+    if (cache)
+    {
+      free(cache->data);
+      free(cache);
+    }
+
+    return (NULL);
+  }
+
+  for (total = 0; total < filestats->st_size; total += bytes)
+  {
+    if ((bytes = read(fd, cache->data + total, (size_t)(filestats->st_size - total))) <= 0)
+      break;
+  }
+
+  close(fd);
+
+  if (total < filestats->st_size)
+  {
+    free(cache->filename);
+    free(cache->data);
+    free(cache);
+
+    return (NULL);
+  }
+
+  cache->mtime = filestats->st_mtime;
+  cache->size  = filestats->st_size;
+
+  FileCacheBytes += (size_t)cache->size;
+
+  cupsArrayAdd(FileCache, cache);
+
+  return (cache);
+}
+
+
 /*
  * 'install_cupsd_conf()' - Install a configuration file.
  */
@@ -3188,6 +3998,89 @@ is_path_absolute(const char *path)	/* I - Input path */
 }
 
 
+/*
+ * 'lookup_hostname()' - Lookup the hostname for an address.
+ *
+ * Results, including failed lookups, are cached for CUPSD_HOSTNAME_TTL
+ * seconds so that repeat connections from the same address do not wait on
+ * the resolver each time.
+ */
+
+static const char *			/* O - Hostname or NULL on error */
+lookup_hostname(http_addr_t *addr,	/* I - Address */
+                char        *name,	/* I - Hostname buffer */
+		size_t      namelen)	/* I - Size of hostname buffer */
+{
+  cupsd_hostname_t	key,		/* Search key */
+			*entry;		/* Cached lookup */
+  const char		*result;	/* Result of lookup */
+
+
+  if (!HostNames)
+    HostNames = cupsArrayNew((cups_array_func_t)compare_addrs, NULL);
+
+  key.addr = *addr;
+
+  if ((entry = (cupsd_hostname_t *)cupsArrayFind(HostNames, &key)) != NULL)
+  {
+    if (entry->expires > time(NULL))
+    {
+      if (!entry->name[0])
+        return (NULL);
+
+      strlcpy(name, entry->name, namelen);
+      return (name);
+    }
+
+    cupsArrayRemove(HostNames, entry);
+    free(entry);
+  }
+
+  if (cupsArrayCount(HostNames) >= CUPSD_HOSTNAME_MAX)
+  {
+   /*
+    * Start over rather than tracking the least recently used lookup...
+    */
+
+    for (entry = (cupsd_hostname_t *)cupsArrayFirst(HostNames);
+         entry;
+	 entry = (cupsd_hostname_t *)cupsArrayNext(HostNames))
+      free(entry);
+
+    cupsArrayClear(HostNames);
+  }
+
+  result = httpAddrLookup(addr, name, (int)namelen);
+
+  if ((entry = calloc(1, sizeof(cupsd_hostname_t))) != NULL)
+  {
+    entry->addr    = *addr;
+    entry->expires = time(NULL) + CUPSD_HOSTNAME_TTL;
+
+    if (result)
+      strlcpy(entry->name, result, sizeof(entry->name));
+
+    cupsArrayAdd(HostNames, entry);
+  }
+
+  return (result);
+}
+
+
+/*
+ * 'make_etag()' - Make an entity tag for a static file.
+ */
+
+static void
+make_etag(struct stat *filestats,	/* I - File information */
+          int         gzip,		/* I - 1 for the precompressed copy */
+          char        *buffer,		/* O - ETag string */
+          size_t      bufsize)		/* I - Size of buffer */
+{
+  snprintf(buffer, bufsize, "\"%x-%x%s\"", (unsigned)filestats->st_size, (unsigned)filestats->st_mtime, gzip ? "-gz" : "");
+}
+
+
 /*
  * 'pipe_command()' - Pipe the output of a command to the remote client.
  */
@@ -3206,11 +4099,12 @@ pipe_command(cupsd_client_t *con,	/* I - Client connection */
 		commch;			/* Command string character */
   char		*uriptr;		/* URI string pointer */
   int		fds[2];			/* Pipe FDs */
+  int		sv[2];			/* Resident CGI request socket */
   int		argc;			/* Number of arguments */
   int		envc;			/* Number of environment variables */
   char		argbuf[10240],		/* Argument buffer */
 		*argv[100],		/* Argument strings */
-		*envp[MAX_ENV + 20];	/* Environment variables */
+		*envp[MAX_ENV + 21];	/* Environment variables */
   char		auth_type[256],		/* AUTH_TYPE environment variable */
 		content_length[1024],	/* CONTENT_LENGTH environment variable */
 		content_type[1024],	/* CONTENT_TYPE environment variable */
@@ -3515,39 +4409,313 @@ pipe_command(cupsd_client_t *con,	/* I - Client connection */
     return (0);
   }
 
+ /*
+  * The web interface programs can stay resident between requests...
+  */
+
+  sv[0] = sv[1] = -1;
+
+  if (MaxCGIWorkers > 0 && !strncmp(command, ServerBin, strlen(ServerBin)) &&
+      !strncmp(command + strlen(ServerBin), "/cgi-bin/", 9))
+  {
+    if ((pid = send_worker(con, command, argv, envp, lang, root, infile,
+                           fds[1])) > 0)
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "[CGI] Sent request to %s (PID %d)",
+                      command, pid);
+
+      *outfile = fds[0];
+      close(fds[1]);
+
+      return (pid);
+    }
+
+    if (cupsArrayCount(CGIWorkers) < MaxCGIWorkers &&
+        !socketpair(AF_LOCAL, SOCK_STREAM, 0, sv))
+    {
+      fcntl(sv[0], F_SETFD, fcntl(sv[0], F_GETFD) | FD_CLOEXEC);
+      fcntl(sv[1], F_SETFD, fcntl(sv[1], F_GETFD) | FD_CLOEXEC);
+
+      envp[envc ++] = "CUPS_CGI_WORKER=1";
+      envp[envc]    = NULL;
+    }
+  }
+
  /*
   * Then execute the command...
   */
 
   if (cupsdStartProcess(command, argv, envp, infile, fds[1], CGIPipes[1],
-			-1, -1, root, DefaultProfile, NULL, &pid) < 0)
+			sv[1], -1, root, DefaultProfile, NULL, &pid) < 0)
   {
    /*
     * Error - can't fork!
     */
 
-    cupsdLogMessage(CUPSD_LOG_ERROR, "[CGI] Unable to start %s - %s", argv[0],
-                    strerror(errno));
+    cupsdLogMessage(CUPSD_LOG_ERROR, "[CGI] Unable to start %s - %s", argv[0],
+                    strerror(errno));
+
+    cupsdClosePipe(fds);
+    pid = 0;
+
+    if (sv[0] >= 0)
+    {
+      close(sv[0]);
+      close(sv[1]);
+    }
+  }
+  else
+  {
+   /*
+    * Fork successful - return the PID...
+    */
+
+    if (con->username[0])
+      cupsdAddCert(pid, con->username, con->type);
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "[CGI] Started %s (PID %d)", command, pid);
+
+    *outfile = fds[0];
+    close(fds[1]);
+
+    if (sv[0] >= 0)
+    {
+     /*
+      * Remember the program so it can handle the next request...
+      */
+
+      cupsd_cgiworker_t	*worker;	/* New resident CGI program */
+
+      close(sv[1]);
+
+      if (!CGIWorkers)
+        CGIWorkers = cupsArrayNew(NULL, NULL);
+
+      if ((worker = calloc(1, sizeof(cupsd_cgiworker_t))) != NULL)
+      {
+        worker->command  = strdup(command);
+        worker->username = strdup(con->username);
+        worker->lang     = strdup(lang);
+        worker->type     = con->type;
+        worker->root     = root;
+        worker->pid      = pid;
+        worker->fd       = sv[0];
+        worker->busy     = 1;
+        worker->time     = time(NULL);
+
+        if (!worker->command || !worker->username || !worker->lang ||
+	    !cupsArrayAdd(CGIWorkers, worker))
+        {
+          free(worker->command);
+          free(worker->username);
+          free(worker->lang);
+          free(worker);
+          worker = NULL;
+        }
+      }
+
+      if (!worker)
+        close(sv[0]);
+    }
+  }
+
+  return (pid);
+}
+
+
+/*
+ * 'resolve_hostname()' - Resolve the hostname of a client connection.
+ *
+ * This is httpResolveHostname() using the hostname lookup cache.
+ */
+
+static const char *			/* O - Hostname or NULL on error */
+resolve_hostname(cupsd_client_t *con)	/* I - Client connection */
+{
+  char		name[256];		/* Hostname */
+  const char	*hostname = httpGetHostname(con->http, NULL, 0);
+					/* Current hostname */
+
+
+  if (isdigit(hostname[0] & 255) || hostname[0] == '[')
+  {
+    if (!lookup_hostname(httpGetAddress(con->http), name, sizeof(name)))
+      return (NULL);
+
+    _httpSetHostname(con->http, name);
+  }
+
+  return (httpGetHostname(con->http, NULL, 0));
+}
+
+
+/*
+ * 'send_worker()' - Send a request to a resident CGI program.
+ *
+ * The request is the command-line arguments and environment variables
+ * followed by the output pipe and standard input file (if any), which are
+ * passed as SCM_RIGHTS on the request socket.  The program closes the output
+ * pipe when it is done with the request.
+ */
+
+static int				/* O - Process ID or 0 if none */
+send_worker(cupsd_client_t *con,	/* I - Client connection */
+            char           *command,	/* I - Program */
+	    char           *argv[],	/* I - Command-line arguments */
+	    char           *envp[],	/* I - Environment variables */
+	    const char     *lang,	/* I - LANG environment variable */
+	    int            root,	/* I - Run as root? */
+	    int            infile,	/* I - Standard input for command */
+	    int            outfile)	/* I - Standard output for command */
+{
+  cupsd_cgiworker_t	*worker,	/* Current CGI program */
+			*match = NULL;	/* Matching CGI program */
+  time_t		curtime = time(NULL);
+					/* Current time */
+  struct pollfd		pfd;		/* Request socket status */
+  unsigned		header[3];	/* argc, envc, and length of strings */
+  char			*strings,	/* Argument and environment strings */
+			*ptr;		/* Pointer into strings */
+  size_t		length;		/* Length of strings */
+  int			i,		/* Looping var */
+			fds[2];		/* Descriptors to pass */
+  struct iovec		iov[2];		/* Data to send */
+  struct msghdr		msg;		/* Message to send */
+  struct cmsghdr	*cmsg;		/* Control message */
+  char			control[CMSG_SPACE(sizeof(fds))];
+					/* Control message buffer */
+
+
+ /*
+  * Stop programs that have exited or have been idle for too long, and look
+  * for one that is running requests for this user and language...
+  */
+
+  for (worker = (cupsd_cgiworker_t *)cupsArrayFirst(CGIWorkers);
+       worker;
+       worker = (cupsd_cgiworker_t *)cupsArrayNext(CGIWorkers))
+  {
+    if (worker->busy)
+      continue;
+
+    pfd.fd      = worker->fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 0) != 0)
+    {
+     /*
+      * The program never writes to the request socket, so this means it
+      * has exited...
+      */
+
+      worker->pid = 0;
+      stop_worker(worker);
+    }
+    else if ((curtime - worker->time) >= CUPSD_CGI_IDLE)
+      stop_worker(worker);
+    else if (!match && worker->root == root && worker->type == con->type &&
+             !strcmp(worker->command, command) &&
+             !strcmp(worker->username, con->username) &&
+             !strcmp(worker->lang, lang))
+      match = worker;
+  }
+
+  if (!match)
+    return (0);
+
+ /*
+  * Build the request...
+  */
+
+  for (i = 0, length = 0; argv[i]; i ++)
+    length += strlen(argv[i]) + 1;
+
+  header[0] = (unsigned)i;
+
+  for (i = 0; envp[i]; i ++)
+    length += strlen(envp[i]) + 1;
+
+  header[1] = (unsigned)i;
+  header[2] = (unsigned)length;
+
+  if ((strings = malloc(length)) == NULL)
+    return (0);
+
+  for (i = 0, ptr = strings; argv[i]; i ++)
+  {
+    strcpy(ptr, argv[i]);
+    ptr += strlen(ptr) + 1;
+  }
+
+  for (i = 0; envp[i]; i ++)
+  {
+    strcpy(ptr, envp[i]);
+    ptr += strlen(ptr) + 1;
+  }
+
+  fds[0] = outfile;
+  fds[1] = infile;
+
+  iov[0].iov_base = header;
+  iov[0].iov_len  = sizeof(header);
+  iov[1].iov_base = strings;
+  iov[1].iov_len  = length;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(control, 0, sizeof(control));
+
+  msg.msg_iov        = iov;
+  msg.msg_iovlen     = 2;
+  msg.msg_control    = control;
+  msg.msg_controllen = CMSG_SPACE(infile >= 0 ? 2 * sizeof(int) : sizeof(int));
+
+  cmsg             = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type  = SCM_RIGHTS;
+  cmsg->cmsg_len   = CMSG_LEN(infile >= 0 ? 2 * sizeof(int) : sizeof(int));
+
+  memcpy(CMSG_DATA(cmsg), fds, infile >= 0 ? 2 * sizeof(int) : sizeof(int));
+
+ /*
+  * Send it...
+  */
+
+  if (sendmsg(match->fd, &msg, 0) != (ssize_t)(sizeof(header) + length))
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "[CGI] Unable to send request to %s (PID %d) - %s", command, match->pid, strerror(errno));
+    free(strings);
+    stop_worker(match);
+    return (0);
+  }
+
+  free(strings);
+
+  match->busy = 1;
+  match->time = curtime;
+
+  return (match->pid);
+}
+
 
-    cupsdClosePipe(fds);
-    pid = 0;
-  }
-  else
-  {
-   /*
-    * Fork successful - return the PID...
-    */
+/*
+ * 'stop_worker()' - Stop a resident CGI program.
+ */
 
-    if (con->username[0])
-      cupsdAddCert(pid, con->username, con->type);
+static void
+stop_worker(cupsd_cgiworker_t *worker)	/* I - CGI program */
+{
+  cupsArrayRemove(CGIWorkers, worker);
 
-    cupsdLogMessage(CUPSD_LOG_DEBUG, "[CGI] Started %s (PID %d)", command, pid);
+  if (worker->pid)
+    cupsdEndProcess(worker->pid, 1);
 
-    *outfile = fds[0];
-    close(fds[1]);
-  }
+  close(worker->fd);
 
-  return (pid);
+  free(worker->command);
+  free(worker->username);
+  free(worker->lang);
+  free(worker);
 }
 
 
@@ -3559,7 +4727,6 @@ static int				/* O - 1 if valid, 0 if not */
 valid_host(cupsd_client_t *con)		/* I - Client connection */
 {
   cupsd_alias_t	*a;			/* Current alias */
-  cupsd_netif_t	*netif;			/* Current network interface */
   const char	*end;			/* End character */
   char		*ptr;			/* Pointer into host value */
 
@@ -3697,24 +4864,307 @@ valid_host(cupsd_client_t *con)		/* I - Client connection */
   * Check for interface hostname matches...
   */
 
-  for (netif = (cupsd_netif_t *)cupsArrayFirst(NetIFList);
-       netif;
-       netif = (cupsd_netif_t *)cupsArrayNext(NetIFList))
+  return (cupsdNetIFFindHost(con->clientname) != NULL);
+}
+
+
+/*
+ * 'write_api()' - Send JSON status information to a client.
+ *
+ * "/api/printers" lists printers and classes and "/api/jobs" lists jobs,
+ * generated directly from the scheduler's arrays and streamed to the client.
+ * Both accept the "fields" (comma-delimited names), "offset", and "limit"
+ * query options; "/api/jobs" also accepts "printer" and "which" (active,
+ * completed, or all).
+ */
+
+static int				/* O - 0 to close the connection, 1 otherwise */
+write_api(cupsd_client_t *con)		/* I - Client connection */
+{
+  const char	*resource = con->uri + 4,
+					/* Resource under /api */
+		*query;			/* Query string */
+  char		fields[1024],		/* Selected fields */
+		value[256];		/* Option value */
+  int		offset,			/* Index of first element */
+		limit,			/* Maximum number of elements */
+		status;			/* Status of write */
+
+
+  if ((query = strchr(resource, '?')) != NULL)
+    query ++;
+  else
+    query = "";
+
+  get_api_option(query, "fields", fields, sizeof(fields));
+
+  if (get_api_option(query, "offset", value, sizeof(value)))
+    offset = atoi(value);
+  else
+    offset = 0;
+
+  if (get_api_option(query, "limit", value, sizeof(value)))
+    limit = atoi(value);
+  else
+    limit = 0;
+
+  if (offset < 0)
+    offset = 0;
+  if (limit < 0)
+    limit = 0;
+
+  httpClearFields(con->http);
+
+  if (!strncmp(resource, "/jobs", 5) && (!resource[5] || resource[5] == '?'))
+  {
+    if (get_api_option(query, "which", value, sizeof(value)) && strcmp(value, "active") && strcmp(value, "completed") && strcmp(value, "all"))
+      return (cupsdSendError(con, HTTP_STATUS_BAD_REQUEST, CUPSD_AUTH_NONE));
+  }
+  else if (strncmp(resource, "/printers", 9) || (resource[9] && resource[9] != '?'))
+    return (cupsdSendError(con, HTTP_STATUS_NOT_FOUND, CUPSD_AUTH_NONE));
+
+ /*
+  * Stream the response using chunking, or by closing the connection for
+  * HTTP/1.0 clients...
+  */
+
+  if (httpGetVersion(con->http) >= HTTP_VERSION_1_1)
+    httpSetLength(con->http, 0);
+  else
+    httpSetKeepAlive(con->http, HTTP_KEEPALIVE_OFF);
+
+  if (!cupsdSendHeader(con, HTTP_STATUS_OK, "application/json", CUPSD_AUTH_NONE))
+    return (0);
+
+  if (resource[1] == 'j')
+    status = write_api_jobs(con, query, fields, offset, limit);
+  else
+    status = write_api_printers(con, fields, offset, limit);
+
+  if (!status || httpWrite2(con->http, "", 0) < 0 || httpFlushWrite(con->http) < 0)
+    return (0);
+
+  cupsdLogRequest(con, HTTP_STATUS_OK);
+
+  return (httpGetKeepAlive(con->http) != HTTP_KEEPALIVE_OFF);
+}
+
+
+/*
+ * 'write_api_jobs()' - Write the JSON job list.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+write_api_jobs(cupsd_client_t *con,	/* I - Client connection */
+               const char     *query,	/* I - Query string */
+               const char     *fields,	/* I - Selected fields */
+               int            offset,	/* I - Index of first job */
+               int            limit)	/* I - Maximum number of jobs */
+{
+  char		which[32],		/* Which jobs */
+		printer[256];		/* Printer name */
+  cups_array_t	*list;			/* Job list */
+  int		records,		/* List contains job records? */
+		index = 0,		/* Job index */
+		count = 0,		/* Number of jobs sent */
+		more = 0,		/* More jobs available? */
+		num_fields;		/* Number of fields for job */
+  void		*element;		/* Current element */
+  cupsd_job_t	*job,			/* Current job */
+		summary;		/* Job summary for records */
+  cupsd_printer_t *dest;		/* Job destination */
+  cups_array_t	*exclude;		/* Private attributes */
+
+
+  if (!get_api_option(query, "which", which, sizeof(which)))
+    strlcpy(which, "active", sizeof(which));
+
+  get_api_option(query, "printer", printer, sizeof(printer));
+
+  if (!strcmp(which, "active"))
+  {
+    list    = ActiveJobs;
+    records = 0;
+  }
+  else
+  {
+    list    = cupsdGetJobRecords(NULL, !strcmp(which, "completed"));
+    records = 1;
+  }
+
+  if (write_json_printf(con, "{\"jobs\":[") < 0)
+  {
+    if (records)
+      cupsdFreeJobRecords(list);
+
+    return (0);
+  }
+
+  for (element = cupsArrayFirst(list); element; element = cupsArrayNext(list))
   {
-    if (!_cups_strncasecmp(con->clientname, netif->hostname, netif->hostlen))
+    if (records)
+      job = cupsdGetRecordJob((cupsd_jobrec_t *)element, &summary);
+    else
+      job = (cupsd_job_t *)element;
+
+    if (!job->dest || !job->username)
     {
-     /*
-      * Prefix matches; check the character at the end - it must be "." or nul.
-      */
+      if (job == &summary && (job = cupsdFindJob(summary.id)) == NULL)
+        continue;
+
+      cupsdLoadJob(job);
+    }
 
-      end = con->clientname + netif->hostlen;
+    if (!job->dest || !job->username)
+      continue;
 
-      if (!*end || (*end == '.' && !end[1]))
-        return (1);
+    if (printer[0] && _cups_strcasecmp(printer, job->dest))
+      continue;
+
+    if (index ++ < offset)
+      continue;
+
+    if (limit > 0 && count >= limit)
+    {
+      more = 1;
+      break;
     }
+
+    dest    = cupsdFindDest(job->dest);
+    exclude = cupsdGetPrivateAttrs(dest ? dest->op_policy_ptr : DefaultPolicyPtr, con, dest, job->username);
+
+    write_json_printf(con, "%s\n{", count ? "," : "");
+    count ++;
+    num_fields = 0;
+
+    if (write_json_name(con, fields, "job-id", &num_fields))
+      write_json_printf(con, "%d", job->id);
+
+    if (!cupsArrayFind(exclude, "all") && !cupsArrayFind(exclude, "job-name") && write_json_name(con, fields, "job-name", &num_fields))
+      write_json_string(con, job->name ? job->name : "");
+
+    if (!cupsArrayFind(exclude, "all") && !cupsArrayFind(exclude, "job-originating-user-name") && write_json_name(con, fields, "job-originating-user-name", &num_fields))
+      write_json_string(con, job->username);
+
+    if (write_json_name(con, fields, "job-printer", &num_fields))
+      write_json_string(con, job->dest);
+
+    if (write_json_name(con, fields, "job-state", &num_fields))
+      write_json_string(con, ippEnumString("job-state", (int)job->state_value));
+
+    if (write_json_name(con, fields, "job-priority", &num_fields))
+      write_json_printf(con, "%d", job->priority);
+
+    if (write_json_name(con, fields, "job-k-octets", &num_fields))
+      write_json_printf(con, "%d", job->koctets);
+
+    if (write_json_name(con, fields, "time-at-creation", &num_fields))
+      write_json_printf(con, "%ld", (long)job->creation_time);
+
+    if (write_json_name(con, fields, "time-at-completed", &num_fields))
+      write_json_printf(con, "%ld", (long)job->completed_time);
+
+    if (write_json_printf(con, "}") < 0)
+      break;
   }
 
-  return (0);
+  if (records)
+    cupsdFreeJobRecords(list);
+
+  return (write_json_printf(con, "\n],\"more\":%s}\n", more ? "true" : "false") >= 0);
+}
+
+
+/*
+ * 'write_api_printers()' - Write the JSON printer list.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+write_api_printers(
+    cupsd_client_t *con,		/* I - Client connection */
+    const char     *fields,		/* I - Selected fields */
+    int            offset,		/* I - Index of first printer */
+    int            limit)		/* I - Maximum number of printers */
+{
+  cupsd_printer_t	*p;		/* Current printer */
+  int			index = 0,	/* Printer index */
+			count = 0,	/* Number of printers sent */
+			more = 0,	/* More printers available? */
+			num_fields,	/* Number of fields for printer */
+			i;		/* Looping var */
+
+
+  if (write_json_printf(con, "{\"printers\":[") < 0)
+    return (0);
+
+  for (p = (cupsd_printer_t *)cupsArrayFirst(Printers); p; p = (cupsd_printer_t *)cupsArrayNext(Printers))
+  {
+    if (index ++ < offset)
+      continue;
+
+    if (limit > 0 && count >= limit)
+    {
+      more = 1;
+      break;
+    }
+
+    write_json_printf(con, "%s\n{", count ? "," : "");
+    count ++;
+    num_fields = 0;
+
+    if (write_json_name(con, fields, "printer-name", &num_fields))
+      write_json_string(con, p->name);
+
+    if (write_json_name(con, fields, "printer-type", &num_fields))
+      write_json_printf(con, "%d", (int)p->type);
+
+    if (write_json_name(con, fields, "printer-state", &num_fields))
+      write_json_string(con, ippEnumString("printer-state", (int)p->state));
+
+    if (write_json_name(con, fields, "printer-state-message", &num_fields))
+      write_json_string(con, p->state_message);
+
+    if (write_json_name(con, fields, "printer-state-reasons", &num_fields))
+    {
+      write_json_printf(con, "[");
+
+      if (p->num_reasons == 0)
+        write_json_string(con, "none");
+
+      for (i = 0; i < p->num_reasons; i ++)
+      {
+        if (i)
+          write_json_printf(con, ",");
+
+        write_json_string(con, p->reasons[i]);
+      }
+
+      write_json_printf(con, "]");
+    }
+
+    if (write_json_name(con, fields, "printer-is-accepting-jobs", &num_fields))
+      write_json_printf(con, "%s", p->accepting ? "true" : "false");
+
+    if (write_json_name(con, fields, "printer-is-shared", &num_fields))
+      write_json_printf(con, "%s", p->shared ? "true" : "false");
+
+    if (write_json_name(con, fields, "printer-info", &num_fields))
+      write_json_string(con, p->info ? p->info : "");
+
+    if (write_json_name(con, fields, "printer-location", &num_fields))
+      write_json_string(con, p->location ? p->location : "");
+
+    if (write_json_name(con, fields, "printer-make-and-model", &num_fields))
+      write_json_string(con, p->make_model ? p->make_model : "");
+
+    if (write_json_name(con, fields, "queued-job-count", &num_fields))
+      write_json_printf(con, "%d", cupsdGetPrinterJobCount(p->name));
+
+    if (write_json_printf(con, "}") < 0)
+      return (0);
+  }
+
+  return (write_json_printf(con, "\n],\"more\":%s}\n", more ? "true" : "false") >= 0);
 }
 
 
@@ -3729,6 +5179,74 @@ write_file(cupsd_client_t *con,		/* I - Client connection */
 	   char           *type,	/* I - File type */
 	   struct stat    *filestats)	/* O - File information */
 {
+  char			gzfilename[1024],
+					/* Precompressed copy of file */
+			etag[256];	/* ETag for file */
+  struct stat		gzstats,	/* Precompressed file information */
+			*datastats;	/* Information for file being sent */
+  const char		*coding;	/* Content coding accepted by client */
+  int			have_gzip,	/* Have a precompressed copy? */
+			gzip = 0;	/* Send the precompressed copy? */
+  cupsd_filecache_t	*cache;		/* Cached file contents */
+
+
+ /*
+  * Use a precompressed "file.gz" copy, if present and current, when the
+  * client accepts gzip...
+  */
+
+  snprintf(gzfilename, sizeof(gzfilename), "%s.gz", filename);
+
+  have_gzip = !stat(gzfilename, &gzstats) && S_ISREG(gzstats.st_mode) && gzstats.st_mtime >= filestats->st_mtime;
+
+  if (have_gzip && (coding = httpGetContentEncoding(con->http)) != NULL && strstr(coding, "gzip"))
+  {
+    gzip      = 1;
+    filename  = gzfilename;
+    datastats = &gzstats;
+  }
+  else
+    datastats = filestats;
+
+  httpClearFields(con->http);
+
+  httpSetLength(con->http, (size_t)datastats->st_size);
+
+  httpSetField(con->http, HTTP_FIELD_LAST_MODIFIED,
+	       httpGetDateString(filestats->st_mtime));
+
+  make_etag(filestats, gzip, etag, sizeof(etag));
+  httpSetField(con->http, HTTP_FIELD_ETAG, etag);
+
+  if (have_gzip)
+    httpSetField(con->http, HTTP_FIELD_VARY, "Accept-Encoding");
+
+  if (gzip)
+  {
+    httpSetField(con->http, HTTP_FIELD_CONTENT_ENCODING, "gzip");
+    _httpSetPrecompressed(con->http);
+  }
+
+  if ((cache = get_filecache(filename, datastats)) != NULL)
+  {
+   /*
+    * Send small files from memory...
+    */
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG2, "write_file: code=%d, filename=\"%s\" (cached), type=\"%s\", filestats=%p.", code, filename, type ? type : "(null)", filestats);
+
+    if (!cupsdSendHeader(con, code, type, CUPSD_AUTH_NONE) ||
+        httpWrite2(con->http, cache->data, (size_t)cache->size) < 0 ||
+        httpFlushWrite(con->http) < 0)
+      return (0);
+
+    con->bytes += cache->size;
+
+    cupsdLogRequest(con, code);
+
+    return (1);
+  }
+
   con->file = open(filename, O_RDONLY);
 
   cupsdLogClient(con, CUPSD_LOG_DEBUG2, "write_file: code=%d, filename=\"%s\" (%d), type=\"%s\", filestats=%p.", code, filename, con->file, type ? type : "(null)", filestats);
@@ -3741,13 +5259,6 @@ write_file(cupsd_client_t *con,		/* I - Client connection */
   con->pipe_pid    = 0;
   con->sent_header = 1;
 
-  httpClearFields(con->http);
-
-  httpSetLength(con->http, (size_t)filestats->st_size);
-
-  httpSetField(con->http, HTTP_FIELD_LAST_MODIFIED,
-	       httpGetDateString(filestats->st_mtime));
-
   if (!cupsdSendHeader(con, code, type, CUPSD_AUTH_NONE))
     return (0);
 
@@ -3759,6 +5270,138 @@ write_file(cupsd_client_t *con,		/* I - Client connection */
 }
 
 
+/*
+ * 'write_json_name()' - Write the name of a JSON member if it is selected.
+ */
+
+static int				/* O - 1 if selected, 0 otherwise */
+write_json_name(cupsd_client_t *con,	/* I  - Client connection */
+                const char     *fields,	/* I  - Selected fields or "" for all */
+                const char     *name,	/* I  - Member name */
+                int            *count)	/* IO - Number of members written */
+{
+  size_t	namelen;		/* Length of name */
+  const char	*ptr;			/* Pointer into fields */
+
+
+  if (*fields)
+  {
+    for (ptr = fields, namelen = strlen(name); ptr; ptr = strchr(ptr, ','))
+    {
+      if (*ptr == ',')
+        ptr ++;
+
+      if (!strncmp(ptr, name, namelen) && (!ptr[namelen] || ptr[namelen] == ','))
+        break;
+    }
+
+    if (!ptr)
+      return (0);
+  }
+
+  write_json_printf(con, "%s\"%s\":", *count ? "," : "", name);
+  (*count) ++;
+
+  return (1);
+}
+
+
+/*
+ * 'write_json_printf()' - Write formatted JSON text.
+ */
+
+static int				/* O - Number of bytes written or -1 on error */
+write_json_printf(cupsd_client_t *con,	/* I - Client connection */
+                  const char     *format,/* I - printf-style format string */
+                  ...)			/* I - Additional arguments as needed */
+{
+  char		buffer[1024];		/* Output buffer */
+  va_list	ap;			/* Pointer to arguments */
+
+
+  va_start(ap, format);
+  vsnprintf(buffer, sizeof(buffer), format, ap);
+  va_end(ap);
+
+  return ((int)httpWrite2(con->http, buffer, strlen(buffer)));
+}
+
+
+/*
+ * 'write_json_string()' - Write a JSON string value.
+ */
+
+static void
+write_json_string(cupsd_client_t *con,	/* I - Client connection */
+                  const char     *s)	/* I - String */
+{
+  char	buffer[1024],			/* Output buffer */
+	*bufptr,			/* Pointer into buffer */
+	*bufend = buffer + sizeof(buffer) - 8;
+					/* End of buffer */
+
+
+  buffer[0] = '\"';
+
+  for (bufptr = buffer + 1; *s; s ++)
+  {
+    if (bufptr >= bufend)
+    {
+      httpWrite2(con->http, buffer, (size_t)(bufptr - buffer));
+      bufptr = buffer;
+    }
+
+    if (*s == '\"' || *s == '\\')
+    {
+      *bufptr++ = '\\';
+      *bufptr++ = *s;
+    }
+    else if ((*s & 255) < ' ')
+    {
+      snprintf(bufptr, (size_t)(bufend + 8 - bufptr), "\\u%04x", *s);
+      bufptr += 6;
+    }
+    else
+      *bufptr++ = *s;
+  }
+
+  *bufptr++ = '\"';
+
+  httpWrite2(con->http, buffer, (size_t)(bufptr - buffer));
+}
+
+
+/*
+ * 'write_metrics()' - Send the scheduler metrics to a client.
+ */
+
+static int				/* O - 0 on failure, 1 on success */
+write_metrics(cupsd_client_t *con)	/* I - Client connection */
+{
+  char		*metrics;		/* Metrics text */
+  size_t	length;			/* Length of text */
+
+
+  if ((metrics = cupsdGetMetrics(&length)) == NULL)
+    return (cupsdSendError(con, HTTP_STATUS_SERVER_ERROR, CUPSD_AUTH_NONE));
+
+  httpClearFields(con->http);
+  httpSetLength(con->http, length);
+
+  if (!cupsdSendHeader(con, HTTP_STATUS_OK, "text/plain; version=0.0.4", CUPSD_AUTH_NONE) ||
+      httpWrite2(con->http, metrics, length) < 0 ||
+      httpFlushWrite(con->http) < 0)
+  {
+    free(metrics);
+    return (0);
+  }
+
+  free(metrics);
+
+  return (1);
+}
+
+
 /*
  * 'write_pipe()' - Flag that data is available on the CGI pipe.
  */
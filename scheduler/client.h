@@ -23,8 +23,14 @@ struct cupsd_client_s
   http_t		*http;		/* HTTP client connection */
   ipp_t			*request,	/* IPP request information */
 			*response;	/* IPP response information */
+  cups_array_t		*attr_refs;	/* Cached printer attributes used by response */
   cupsd_location_t	*best;		/* Best match for AAA */
-  struct timeval	start;		/* Request start time */
+  struct timeval	start,		/* Request start time */
+			fields_time,	/* Time request header was parsed */
+			ipp_start,	/* Start of IPP operation */
+			ipp_end;	/* End of IPP operation */
+  double		auth_secs,	/* Time spent authorizing */
+			policy_secs;	/* Time spent checking policies */
   http_state_t		operation;	/* Request operation */
   off_t			bytes;		/* Bytes transferred for this request */
   int			is_browser;	/* Is the client a web browser? */
@@ -40,6 +46,10 @@ struct cupsd_client_s
 			*options,	/* Options for command */
 			*query_string;	/* QUERY_STRING environment variable */
   int			file;		/* Input/output file */
+  unsigned		file_hash;	/* Hash of request data in file */
+  int			doc_fd;		/* Passed document being copied or -1 */
+  off_t			doc_size,	/* Size of passed document */
+			doc_bytes;	/* Bytes of passed document copied */
   int			file_ready;	/* Input ready on file/pipe? */
   int			pipe_pid;	/* Pipe process ID (or 0 if not a pipe) */
   http_status_t		pipe_status;	/* HTTP status from pipe process */
@@ -47,18 +57,25 @@ struct cupsd_client_s
 			got_fields,	/* Non-zero if all fields seen */
 			header_used;	/* Number of header bytes used */
   char			header[2048];	/* Header from CGI program */
+  time_t		notify_wait;	/* Time to stop waiting for events */
+  int			notify_ready;	/* Non-zero if events are ready */
   cups_lang_t		*language;	/* Language to use */
 #ifdef HAVE_SSL
   int			auto_ssl;	/* Automatic test for SSL/TLS */
+  time_t		tls_timeout;	/* Deadline for TLS handshake, if any */
 #endif /* HAVE_SSL */
   http_addr_t		clientaddr;	/* Client's server address */
   char			clientname[256];/* Client's server name for connection */
   int			clientport;	/* Client's server port for connection */
   char			servername[256];/* Server name for connection */
   int			serverport;	/* Server port for connection */
+  struct cupsd_clienthost_s *host;	/* Connection count for client address */
 #ifdef HAVE_GSSAPI
   int			have_gss;	/* Have GSS credentials? */
   uid_t			gss_uid;	/* User ID for local prints */
+  unsigned char		gss_hash[32];	/* SHA2-256 of accepted Negotiate data */
+  char			gss_username[HTTP_MAX_VALUE];
+					/* Username for accepted Negotiate data */
 #endif /* HAVE_GSSAPI */
 #ifdef HAVE_AUTHORIZATION_H
   AuthorizationRef	authref;	/* Authorization ref */
@@ -103,8 +120,10 @@ VAR time_t		ListeningPaused	VALUE(0);
 					/* Time when listening was paused */
 VAR cups_array_t	*Clients	VALUE(NULL),
 					/* HTTP clients */
-			*ActiveClients	VALUE(NULL);
+			*ActiveClients	VALUE(NULL),
 					/* Active HTTP clients */
+			*NotifyWaiters	VALUE(NULL);
+					/* Clients waiting for events */
 VAR char		*ServerHeader	VALUE(NULL);
 					/* Server header in requests */
 VAR int			CGIPipes[2]	VALUE2(-1,-1);
@@ -118,9 +137,12 @@ VAR cupsd_statbuf_t	*CGIStatusBuffer VALUE(NULL);
  */
 
 extern void	cupsdAcceptClient(cupsd_listener_t *lis);
+extern void	cupsdAdoptListener(int fd);
+extern void	cupsdCheckNotifyWaiters(void);
 extern void	cupsdCloseAllClients(void);
 extern int	cupsdCloseClient(cupsd_client_t *con);
 extern void	cupsdDeleteAllListeners(void);
+extern void	cupsdHandoffListeners(cups_file_t *fp);
 extern void	cupsdPauseListening(void);
 extern int	cupsdProcessIPPRequest(cupsd_client_t *con);
 extern void	cupsdReadClient(cupsd_client_t *con);
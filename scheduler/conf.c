@@ -13,6 +13,7 @@
  */
 
 #include "cupsd.h"
+#include <cups/dir.h>
 #include <stdarg.h>
 #include <grp.h>
 #include <sys/utsname.h>
@@ -60,6 +61,18 @@ typedef struct
 } cupsd_var_t;
 
 
+/*
+ * File stamp structure for deciding between full and partial reloads...
+ */
+
+typedef struct
+{
+  char			*filename;	/* Filename */
+  time_t		mtime;		/* Modification time */
+  off_t			size;		/* Size of file */
+} cupsd_stamp_t;
+
+
 /*
  * Local globals...
  */
@@ -74,6 +87,8 @@ static const cupsd_var_t	cupsd_vars[] =
   { "Browsing",			&Browsing,		CUPSD_VARTYPE_BOOLEAN },
   { "Classification",		&Classification,	CUPSD_VARTYPE_STRING },
   { "ClassifyOverride",		&ClassifyOverride,	CUPSD_VARTYPE_BOOLEAN },
+  { "CompressJobFiles",		&CompressJobFiles,	CUPSD_VARTYPE_BOOLEAN },
+  { "DeduplicateJobFiles",	&DeduplicateJobFiles,	CUPSD_VARTYPE_BOOLEAN },
   { "DefaultLanguage",		&DefaultLanguage,	CUPSD_VARTYPE_STRING },
   { "DefaultLeaseDuration",	&DefaultLeaseDuration,	CUPSD_VARTYPE_TIME },
   { "DefaultPaperSize",		&DefaultPaperSize,	CUPSD_VARTYPE_STRING },
@@ -88,7 +103,9 @@ static const cupsd_var_t	cupsd_vars[] =
   { "FilterNice",		&FilterNice,		CUPSD_VARTYPE_INTEGER },
 #ifdef HAVE_GSSAPI
   { "GSSServiceName",		&GSSServiceName,	CUPSD_VARTYPE_STRING },
+  { "GSSSessionTimeout",	&GSSSessionTimeout,	CUPSD_VARTYPE_TIME },
 #endif /* HAVE_GSSAPI */
+  { "HTTPBufferSize",		&HTTPBufferSize,	CUPSD_VARTYPE_INTEGER },
 #ifdef HAVE_ONDEMAND
   { "IdleExitTimeout",		&IdleExitTimeout,	CUPSD_VARTYPE_TIME },
 #endif /* HAVE_ONDEMAND */
@@ -104,6 +121,7 @@ static const cupsd_var_t	cupsd_vars[] =
   { "ListenBackLog",		&ListenBackLog,		CUPSD_VARTYPE_INTEGER },
   { "LogDebugHistory",		&LogDebugHistory,	CUPSD_VARTYPE_INTEGER },
   { "MaxActiveJobs",		&MaxActiveJobs,		CUPSD_VARTYPE_INTEGER },
+  { "MaxCGIWorkers",		&MaxCGIWorkers,		CUPSD_VARTYPE_INTEGER },
   { "MaxClients",		&MaxClients,		CUPSD_VARTYPE_INTEGER },
   { "MaxClientsPerHost",	&MaxClientsPerHost,	CUPSD_VARTYPE_INTEGER },
   { "MaxCopies",		&MaxCopies,		CUPSD_VARTYPE_INTEGER },
@@ -121,14 +139,20 @@ static const cupsd_var_t	cupsd_vars[] =
   { "MaxSubscriptionsPerPrinter",&MaxSubscriptionsPerPrinter,	CUPSD_VARTYPE_INTEGER },
   { "MaxSubscriptionsPerUser",	&MaxSubscriptionsPerUser,	CUPSD_VARTYPE_INTEGER },
   { "MultipleOperationTimeout",	&MultipleOperationTimeout,	CUPSD_VARTYPE_TIME },
+  { "MultiplexNotifiers",	&MultiplexNotifiers,	CUPSD_VARTYPE_STRING },
   { "PageLogFormat",		&PageLogFormat,		CUPSD_VARTYPE_STRING },
+  { "PrerenderJobs",		&PrerenderJobs,		CUPSD_VARTYPE_INTEGER },
+  { "PrerenderLimit",		&PrerenderLimit,	CUPSD_VARTYPE_INTEGER },
   { "PreserveJobFiles",		&JobFiles,		CUPSD_VARTYPE_TIME },
   { "PreserveJobHistory",	&JobHistory,		CUPSD_VARTYPE_TIME },
   { "ReloadTimeout",		&ReloadTimeout,		CUPSD_VARTYPE_TIME },
+  { "RenderCacheLimit",		&RenderCacheLimit,	CUPSD_VARTYPE_INTEGER },
   { "RIPCache",			&RIPCache,		CUPSD_VARTYPE_STRING },
   { "RootCertDuration",		&RootCertDuration,	CUPSD_VARTYPE_TIME },
   { "ServerAdmin",		&ServerAdmin,		CUPSD_VARTYPE_STRING },
   { "ServerName",		&ServerName,		CUPSD_VARTYPE_STRING },
+  { "SharedDBusNotifier",	&SharedDBusNotifier,	CUPSD_VARTYPE_BOOLEAN },
+  { "SlowRequestThreshold",	&SlowRequestThreshold,	CUPSD_VARTYPE_INTEGER },
   { "StrictConformance",	&StrictConformance,	CUPSD_VARTYPE_BOOLEAN },
   { "Timeout",			&Timeout,		CUPSD_VARTYPE_TIME },
   { "WebInterface",		&WebInterface,		CUPSD_VARTYPE_BOOLEAN }
@@ -149,6 +173,7 @@ static const cupsd_var_t	cupsfiles_vars[] =
   { "LogFilePerm",		&LogFilePerm,		CUPSD_VARTYPE_PERM },
   { "LPDConfigFile",		&LPDConfigFile,		CUPSD_VARTYPE_STRING },
   { "PageLog",			&PageLog,		CUPSD_VARTYPE_STRING },
+  { "PerPrinterConfig",		&PerPrinterConfig,	CUPSD_VARTYPE_BOOLEAN },
   { "Printcap",			&Printcap,		CUPSD_VARTYPE_STRING },
   { "RemoteRoot",		&RemoteRoot,		CUPSD_VARTYPE_STRING },
   { "RequestRoot",		&RequestRoot,		CUPSD_VARTYPE_STRING },
@@ -159,13 +184,14 @@ static const cupsd_var_t	cupsfiles_vars[] =
   { "ServerRoot",		&ServerRoot,		CUPSD_VARTYPE_PATHNAME },
   { "SMBConfigFile",		&SMBConfigFile,		CUPSD_VARTYPE_STRING },
   { "StateDir",			&StateDir,		CUPSD_VARTYPE_STRING },
-  { "SyncOnClose",		&SyncOnClose,		CUPSD_VARTYPE_BOOLEAN },
 #ifdef HAVE_AUTHORIZATION_H
   { "SystemGroupAuthKey",	&SystemGroupAuthKey,	CUPSD_VARTYPE_STRING },
 #endif /* HAVE_AUTHORIZATION_H */
   { "TempDir",			&TempDir,		CUPSD_VARTYPE_PATHNAME }
 };
 
+static cups_array_t	*conf_stamps = NULL;
+					/* Files read by the last full reload */
 static int		default_auth_type = CUPSD_AUTH_AUTO;
 					/* Default AuthType, if not specified */
 
@@ -183,6 +209,12 @@ static const unsigned	zeros[4] =
  * Local functions...
  */
 
+static void		add_mime_stamps(cups_array_t *stamps,
+			                const char *dirname);
+static void		add_stamp(cups_array_t *stamps, const char *filename);
+static int		compare_stamps(cupsd_stamp_t *a, cupsd_stamp_t *b,
+			               void *data);
+static void		free_stamp(cupsd_stamp_t *stamp, void *data);
 static http_addrlist_t	*get_address(const char *value, int defport);
 static int		get_addr_and_mask(const char *value, unsigned *ip,
 			                  unsigned *mask);
@@ -201,6 +233,7 @@ static int		read_cups_files_conf(cups_file_t *fp);
 static int		read_location(cups_file_t *fp, char *name, int linenum);
 static int		read_policy(cups_file_t *fp, char *name, int linenum);
 static void		set_policy_defaults(cupsd_policy_t *pol);
+static cups_array_t	*stamp_files(void);
 
 
 /*
@@ -522,6 +555,55 @@ cupsdFreeAliases(cups_array_t *aliases)	/* I - Array of aliases */
 }
 
 
+/*
+ * 'cupsdNeedFullReload()' - Check whether a reload must reload everything.
+ *
+ * A full reload is needed when cups-files.conf, the printer, class, or
+ * subscription files, the MIME type and conversion files, the banners, or
+ * the filters have changed since the last full reload.  Otherwise only
+ * cupsd.conf needs to be read again, leaving the MIME database, printers,
+ * and jobs in place.
+ */
+
+int					/* O - 1 if full reload needed, 0 otherwise */
+cupsdNeedFullReload(void)
+{
+  cups_array_t	*stamps;		/* Current file stamps */
+  cupsd_stamp_t	*current,		/* Current file stamp */
+		*saved;			/* Saved file stamp */
+  int		changed = 0;		/* Did anything change? */
+
+
+  if (!conf_stamps)
+    return (1);
+
+  stamps = stamp_files();
+
+  if (cupsArrayCount(stamps) != cupsArrayCount(conf_stamps))
+    changed = 1;
+
+  for (current = (cupsd_stamp_t *)cupsArrayFirst(stamps),
+           saved = (cupsd_stamp_t *)cupsArrayFirst(conf_stamps);
+       current && saved && !changed;
+       current = (cupsd_stamp_t *)cupsArrayNext(stamps),
+           saved = (cupsd_stamp_t *)cupsArrayNext(conf_stamps))
+  {
+    if (strcmp(current->filename, saved->filename) ||
+        current->mtime != saved->mtime || current->size != saved->size)
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG,
+                      "cupsdNeedFullReload: \"%s\" has changed.",
+		      current->filename);
+      changed = 1;
+    }
+  }
+
+  cupsArrayDelete(stamps);
+
+  return (changed);
+}
+
+
 /*
  * 'cupsdReadConfiguration()' - Read the cupsd.conf file.
  */
@@ -534,6 +616,8 @@ cupsdReadConfiguration(void)
   int		status;			/* Return status */
   char		temp[1024],		/* Temporary buffer */
 		mimedir[1024],		/* MIME directory */
+		mimepath[2048],		/* MIME directories to load */
+		mimecache[1024],	/* Compiled MIME database */
 		*slash;			/* Directory separator */
   cups_lang_t	*language;		/* Language */
   struct passwd	*user;			/* Default user */
@@ -560,6 +644,8 @@ cupsdReadConfiguration(void)
   */
 
   cupsdDeleteAllLocations();
+  cupsdClearAuthCache();
+  cupsdClearGroupCache();
 
   cupsdDeleteAllListeners();
 
@@ -635,6 +721,7 @@ cupsdReadConfiguration(void)
 
 #ifdef HAVE_GSSAPI
   cupsdSetString(&GSSServiceName, CUPS_DEFAULT_GSSSERVICENAME);
+  GSSSessionTimeout = 0;
 
   if (HaveServerCreds)
   {
@@ -701,10 +788,12 @@ cupsdReadConfiguration(void)
   * Numeric options...
   */
 
+  AccessLogFormat          = CUPSD_ACCESSFORMAT_COMMON;
   AccessLogLevel           = CUPSD_ACCESSLOG_ACTIONS;
   ConfigFilePerm           = CUPS_DEFAULT_CONFIG_FILE_PERM;
   FatalErrors              = parse_fatal_errors(CUPS_DEFAULT_FATAL_ERRORS);
   default_auth_type        = CUPSD_AUTH_BASIC;
+  ClassScheduling          = CUPSD_CLASS_ROUND_ROBIN;
 #ifdef HAVE_SSL
   CreateSelfSignedCerts    = TRUE;
   DefaultEncryption        = HTTP_ENCRYPT_REQUIRED;
@@ -718,6 +807,7 @@ cupsdReadConfiguration(void)
   FilterLimit              = 0;
   FilterNice               = 0;
   HostNameLookups          = FALSE;
+  HTTPBufferSize           = 0;
   KeepAlive                = TRUE;
   KeepAliveTimeout         = DEFAULT_KEEPALIVE;
   ListenBackLog            = SOMAXCONN;
@@ -725,17 +815,21 @@ cupsdReadConfiguration(void)
   LogFilePerm              = CUPS_DEFAULT_LOG_FILE_PERM;
   LogLevel                 = CUPSD_LOG_WARN;
   LogTimeFormat            = CUPSD_TIME_STANDARD;
+  MaxCGIWorkers            = 0;
   MaxClients               = 100;
   MaxClientsPerHost        = 0;
   MaxLogSize               = 1024 * 1024;
   MaxRequestSize           = 0;
   MultipleOperationTimeout = 900;
   NumSystemGroups          = 0;
+  PerPrinterConfig         = FALSE;
   ReloadTimeout	           = DEFAULT_KEEPALIVE;
   RootCertDuration         = 300;
+  SlowRequestThreshold     = 0;
   Sandboxing               = CUPSD_SANDBOXING_STRICT;
+  SpoolLayout              = CUPSD_SPOOL_FLAT;
   StrictConformance        = FALSE;
-  SyncOnClose              = FALSE;
+  SyncOnClose              = CUPSD_SYNC_NONE;
   Timeout                  = 900;
   WebInterface             = CUPS_DEFAULT_WEBIF;
 
@@ -756,6 +850,11 @@ cupsdReadConfiguration(void)
 
   JobHistory          = DEFAULT_HISTORY;
   JobFiles            = DEFAULT_FILES;
+  CompressJobFiles    = 0;
+  DeduplicateJobFiles = 0;
+  PrerenderJobs       = 0;
+  PrerenderLimit      = 100 * 1024 * 1024;
+  RenderCacheLimit    = 0;
   JobAutoPurge        = 0;
   MaxHoldTime         = 0;
   MaxJobs             = 500;
@@ -778,6 +877,8 @@ cupsdReadConfiguration(void)
   MaxSubscriptionsPerUser    = 0;
   DefaultLeaseDuration       = 86400;
   MaxLeaseDuration           = 0;
+  SharedDBusNotifier         = FALSE;
+  cupsdClearString(&MultiplexNotifiers);
 
 #ifdef HAVE_ONDEMAND
   IdleExitTimeout = 60;
@@ -1123,6 +1224,8 @@ cupsdReadConfiguration(void)
 			     Group, 1, 1) < 0 ||
        cupsdCheckPermissions(CacheDir, NULL, 0770, RunUser,
 			     Group, 1, 1) < 0 ||
+       cupsdCheckPermissions(CacheDir, "raster", 0770, RunUser,
+			     Group, 1, 1) < 0 ||
        cupsdCheckPermissions(temp, NULL, 0775, RunUser,
 			     Group, 1, 1) < 0 ||
        cupsdCheckPermissions(StateDir, NULL, 0755, RunUser,
@@ -1133,6 +1236,9 @@ cupsdReadConfiguration(void)
 			     Group, 1, 0) < 0 ||
        cupsdCheckPermissions(ServerRoot, "ppd", 0755, RunUser,
 			     Group, 1, 1) < 0 ||
+       (PerPrinterConfig &&
+        cupsdCheckPermissions(ServerRoot, "printers.d", 0755, RunUser,
+			      Group, 1, 1) < 0) ||
        cupsdCheckPermissions(ServerRoot, "ssl", 0700, RunUser,
 			     Group, 1, 0) < 0 ||
        cupsdCheckPermissions(ConfigurationFile, NULL, ConfigFilePerm, RunUser,
@@ -1468,6 +1574,7 @@ cupsdReadConfiguration(void)
       cupsdAddPolicyOp(p, po, CUPS_ACCEPT_JOBS);
       cupsdAddPolicyOp(p, po, CUPS_REJECT_JOBS);
       cupsdAddPolicyOp(p, po, CUPS_SET_DEFAULT);
+      cupsdAddPolicyOp(p, po, IPP_OP_CUPS_GET_STATISTICS);
 
       cupsdLogMessage(CUPSD_LOG_INFO, "</Limit>");
 
@@ -1546,14 +1653,13 @@ cupsdReadConfiguration(void)
 
     snprintf(temp, sizeof(temp), "%s/filter", ServerBin);
     snprintf(mimedir, sizeof(mimedir), "%s/mime", DataDir);
+    snprintf(mimepath, sizeof(mimepath), "%s:%s", mimedir, ServerRoot);
+    snprintf(mimecache, sizeof(mimecache), "%s/mime.cache", CacheDir);
 
     MimeDatabase = mimeNew();
     mimeSetErrorCallback(MimeDatabase, mime_error_cb, NULL);
 
-    MimeDatabase = mimeLoadTypes(MimeDatabase, mimedir);
-    MimeDatabase = mimeLoadTypes(MimeDatabase, ServerRoot);
-    MimeDatabase = mimeLoadFilters(MimeDatabase, mimedir, temp);
-    MimeDatabase = mimeLoadFilters(MimeDatabase, ServerRoot, temp);
+    MimeDatabase = mimeLoadCached(MimeDatabase, mimecache, mimepath, temp);
 
     if (!MimeDatabase)
     {
@@ -1650,12 +1756,25 @@ cupsdReadConfiguration(void)
 
     cupsdLoadAllJobs();
 
+   /*
+    * Load quota usage...
+    */
+
+    cupsdLoadAllQuotas();
+
    /*
     * Load subscriptions...
     */
 
     cupsdLoadAllSubscriptions();
 
+   /*
+    * Remember the files we just loaded for the next reload...
+    */
+
+    cupsArrayDelete(conf_stamps);
+    conf_stamps = stamp_files();
+
     cupsdLogMessage(CUPSD_LOG_INFO, "Full reload complete.");
   }
   else
@@ -1695,6 +1814,140 @@ cupsdReadConfiguration(void)
 }
 
 
+/*
+ * 'cupsdStampConfFile()' - Update the saved stamp of a file written by cupsd.
+ *
+ * Files such as printers.conf are rewritten by the scheduler itself and
+ * should not force a full reload on the next SIGHUP.
+ */
+
+void
+cupsdStampConfFile(const char *filename)/* I - File that was written */
+{
+  cupsd_stamp_t	key,			/* Search key */
+		*stamp;			/* Matching stamp */
+  struct stat	fileinfo;		/* File information */
+
+
+  key.filename = (char *)filename;
+
+  if ((stamp = (cupsd_stamp_t *)cupsArrayFind(conf_stamps, &key)) == NULL)
+    return;
+
+  if (stat(filename, &fileinfo))
+  {
+    stamp->mtime = 0;
+    stamp->size  = -1;
+  }
+  else
+  {
+    stamp->mtime = fileinfo.st_mtime;
+    stamp->size  = fileinfo.st_size;
+  }
+}
+
+
+/*
+ * 'add_mime_stamps()' - Add stamps for the MIME files in a directory.
+ */
+
+static void
+add_mime_stamps(cups_array_t *stamps,	/* I - Array of stamps */
+                const char   *dirname)	/* I - Directory */
+{
+  cups_dir_t	*dir;			/* Directory */
+  cups_dentry_t	*dent;			/* Directory entry */
+  const char	*ext;			/* Filename extension */
+  char		filename[1024];		/* Full filename */
+
+
+  if ((dir = cupsDirOpen(dirname)) == NULL)
+    return;
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if ((ext = strrchr(dent->filename, '.')) == NULL ||
+        (strcmp(ext, ".types") && strcmp(ext, ".convs")))
+      continue;
+
+    snprintf(filename, sizeof(filename), "%s/%s", dirname, dent->filename);
+    add_stamp(stamps, filename);
+  }
+
+  cupsDirClose(dir);
+}
+
+
+/*
+ * 'add_stamp()' - Add the stamp for a file or directory.
+ */
+
+static void
+add_stamp(cups_array_t *stamps,		/* I - Array of stamps */
+          const char   *filename)	/* I - File or directory */
+{
+  cupsd_stamp_t	*stamp;			/* New stamp */
+  struct stat	fileinfo;		/* File information */
+
+
+  if ((stamp = calloc(1, sizeof(cupsd_stamp_t))) == NULL)
+    return;
+
+  if ((stamp->filename = strdup(filename)) == NULL)
+  {
+    free(stamp);
+    return;
+  }
+
+  if (stat(filename, &fileinfo))
+  {
+   /*
+    * Record missing files so that we notice when they are created...
+    */
+
+    stamp->mtime = 0;
+    stamp->size  = -1;
+  }
+  else
+  {
+    stamp->mtime = fileinfo.st_mtime;
+    stamp->size  = fileinfo.st_size;
+  }
+
+  cupsArrayAdd(stamps, stamp);
+}
+
+
+/*
+ * 'compare_stamps()' - Compare two file stamps.
+ */
+
+static int				/* O - Result of comparison */
+compare_stamps(cupsd_stamp_t *a,	/* I - First stamp */
+               cupsd_stamp_t *b,	/* I - Second stamp */
+	       void          *data)	/* I - Callback data (unused) */
+{
+  (void)data;
+
+  return (strcmp(a->filename, b->filename));
+}
+
+
+/*
+ * 'free_stamp()' - Free a file stamp.
+ */
+
+static void
+free_stamp(cupsd_stamp_t *stamp,	/* I - Stamp */
+           void          *data)		/* I - Callback data (unused) */
+{
+  (void)data;
+
+  free(stamp->filename);
+  free(stamp);
+}
+
+
 /*
  * 'get_address()' - Get an address + port number from a line.
  */
@@ -3249,6 +3502,20 @@ read_cupsd_conf(cups_file_t *fp)	/* I - File to read from */
 	cupsdLogMessage(CUPSD_LOG_WARN, "Unknown HostNameLookups %s on line %d of %s.",
 	                value, linenum, ConfigurationFile);
     }
+    else if (!_cups_strcasecmp(line, "AccessLogFormat") && value)
+    {
+     /*
+      * Format of access log lines...
+      */
+
+      if (!_cups_strcasecmp(value, "common"))
+        AccessLogFormat = CUPSD_ACCESSFORMAT_COMMON;
+      else if (!_cups_strcasecmp(value, "timing"))
+        AccessLogFormat = CUPSD_ACCESSFORMAT_TIMING;
+      else
+        cupsdLogMessage(CUPSD_LOG_WARN, "Unknown AccessLogFormat %s on line %d of %s.",
+	                value, linenum, ConfigurationFile);
+    }
     else if (!_cups_strcasecmp(line, "AccessLogLevel") && value)
     {
      /*
@@ -3297,6 +3564,20 @@ read_cupsd_conf(cups_file_t *fp)	/* I - File to read from */
         cupsdLogMessage(CUPSD_LOG_WARN, "Unknown LogLevel %s on line %d of %s.",
 	                value, linenum, ConfigurationFile);
     }
+    else if (!_cups_strcasecmp(line, "ClassScheduling") && value)
+    {
+     /*
+      * How jobs for a class are assigned to its printers...
+      */
+
+      if (!_cups_strcasecmp(value, "roundrobin"))
+        ClassScheduling = CUPSD_CLASS_ROUND_ROBIN;
+      else if (!_cups_strcasecmp(value, "throughput"))
+        ClassScheduling = CUPSD_CLASS_THROUGHPUT;
+      else
+        cupsdLogMessage(CUPSD_LOG_WARN, "Unknown ClassScheduling %s on line %d of %s.",
+	                value, linenum, ConfigurationFile);
+    }
     else if (!_cups_strcasecmp(line, "LogTimeFormat") && value)
     {
      /*
@@ -3627,6 +3908,54 @@ read_cups_files_conf(cups_file_t *fp)	/* I - File to read from */
 	                "Missing value for SetEnv directive on line %d of %s.",
 	                linenum, ConfigurationFile);
     }
+    else if (!_cups_strcasecmp(line, "SpoolLayout") && value)
+    {
+     /*
+      * Layout of job files in RequestRoot?
+      */
+
+      if (!_cups_strcasecmp(value, "flat"))
+        SpoolLayout = CUPSD_SPOOL_FLAT;
+      else if (!_cups_strcasecmp(value, "hashed"))
+        SpoolLayout = CUPSD_SPOOL_HASHED;
+      else
+      {
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Unknown SpoolLayout \"%s\" on line %d of %s.",
+	                value, linenum, CupsFilesFile);
+        if (FatalErrors & CUPSD_FATAL_CONFIG)
+          return (0);
+      }
+    }
+    else if (!_cups_strcasecmp(line, "SyncOnClose") && value)
+    {
+     /*
+      * How to sync configuration and state files?
+      */
+
+      if (!_cups_strcasecmp(value, "batch"))
+        SyncOnClose = CUPSD_SYNC_BATCH;
+      else if (!_cups_strcasecmp(value, "full"))
+        SyncOnClose = CUPSD_SYNC_FULL;
+      else if (!_cups_strcasecmp(value, "yes") ||
+               !_cups_strcasecmp(value, "on") ||
+               !_cups_strcasecmp(value, "enabled") ||
+               !_cups_strcasecmp(value, "true"))
+        SyncOnClose = CUPSD_SYNC_FILE;
+      else if (!_cups_strcasecmp(value, "no") ||
+               !_cups_strcasecmp(value, "off") ||
+               !_cups_strcasecmp(value, "disabled") ||
+               !_cups_strcasecmp(value, "false"))
+        SyncOnClose = CUPSD_SYNC_NONE;
+      else
+      {
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Unknown SyncOnClose \"%s\" on line %d of %s.",
+	                value, linenum, CupsFilesFile);
+        if (FatalErrors & CUPSD_FATAL_CONFIG)
+          return (0);
+      }
+    }
     else if (!_cups_strcasecmp(line, "SystemGroup") && value)
     {
      /*
@@ -4251,3 +4580,46 @@ set_policy_defaults(cupsd_policy_t *pol)/* I - Policy */
     cupsdAddString(&(pol->sub_attrs), "notify-user-data");
   }
 }
+
+
+/*
+ * 'stamp_files()' - Get the stamps of the files read by a full reload.
+ */
+
+static cups_array_t *			/* O - Array of stamps */
+stamp_files(void)
+{
+  cups_array_t	*stamps;		/* Array of stamps */
+  char		filename[1024];		/* Filename */
+
+
+  stamps = cupsArrayNew3((cups_array_func_t)compare_stamps, NULL, NULL, 0,
+                         NULL, (cups_afree_func_t)free_stamp);
+
+  add_stamp(stamps, CupsFilesFile);
+
+  snprintf(filename, sizeof(filename), "%s/printers.conf", ServerRoot);
+  add_stamp(stamps, filename);
+  snprintf(filename, sizeof(filename), "%s/printers.d", ServerRoot);
+  add_stamp(stamps, filename);
+  snprintf(filename, sizeof(filename), "%s/classes.conf", ServerRoot);
+  add_stamp(stamps, filename);
+  snprintf(filename, sizeof(filename), "%s/subscriptions.conf", ServerRoot);
+  add_stamp(stamps, filename);
+
+  add_mime_stamps(stamps, ServerRoot);
+  snprintf(filename, sizeof(filename), "%s/mime", DataDir);
+  add_mime_stamps(stamps, filename);
+
+ /*
+  * Banners and filters only matter when files are added or removed, which
+  * changes the directory time...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/banners", DataDir);
+  add_stamp(stamps, filename);
+  snprintf(filename, sizeof(filename), "%s/filter", ServerBin);
+  add_stamp(stamps, filename);
+
+  return (stamps);
+}
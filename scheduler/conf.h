@@ -40,6 +40,12 @@ typedef enum
   CUPSD_ACCESSLOG_ALL			/* Log everything */
 } cupsd_accesslog_t;
 
+typedef enum
+{
+  CUPSD_ACCESSFORMAT_COMMON,		/* Common log format */
+  CUPSD_ACCESSFORMAT_TIMING		/* Common log format plus request time */
+} cupsd_accessformat_t;
+
 typedef enum
 {
   CUPSD_TIME_STANDARD,			/* "Standard" Apache/CLF format */
@@ -53,6 +59,12 @@ typedef enum
   CUPSD_SANDBOXING_STRICT		/* Strict sandboxing */
 } cupsd_sandboxing_t;
 
+typedef enum
+{
+  CUPSD_SPOOL_FLAT,			/* Job files in RequestRoot */
+  CUPSD_SPOOL_HASHED			/* Job files in subdirectories by job ID */
+} cupsd_spool_t;
+
 
 /*
  * FatalErrors flags...
@@ -76,6 +88,16 @@ typedef enum
 #define PRINTCAP_PLIST		2	/* macOS plist format */
 
 
+/*
+ * SyncOnClose levels...
+ */
+
+#define CUPSD_SYNC_NONE		0	/* Don't sync files */
+#define CUPSD_SYNC_FILE		1	/* fsync() each file */
+#define CUPSD_SYNC_BATCH	2	/* Group commit dirty files per interval */
+#define CUPSD_SYNC_FULL		3	/* fsync() each file and its directory */
+
+
 /*
  * ServerAlias data...
  */
@@ -157,6 +179,8 @@ VAR uid_t		User			VALUE(1),
 					/* User to run as, used for files */
 VAR gid_t		Group			VALUE(0);
 					/* Group ID for server */
+VAR cupsd_accessformat_t AccessLogFormat	VALUE(CUPSD_ACCESSFORMAT_COMMON);
+					/* Access log format */
 VAR cupsd_accesslog_t	AccessLogLevel		VALUE(CUPSD_ACCESSLOG_ACTIONS);
 					/* Access log level */
 VAR int			ClassifyOverride	VALUE(0),
@@ -165,10 +189,12 @@ VAR int			ClassifyOverride	VALUE(0),
 					/* Amount of automatic debug history */
 			FatalErrors		VALUE(CUPSD_FATAL_CONFIG),
 					/* Which errors are fatal? */
+			PerPrinterConfig	VALUE(FALSE),
+					/* Save printers in printers.d? */
 			StrictConformance	VALUE(FALSE),
 					/* Require strict IPP conformance? */
-			SyncOnClose		VALUE(FALSE);
-					/* Call fsync() when closing files? */
+			SyncOnClose		VALUE(CUPSD_SYNC_NONE);
+					/* How to sync files when closing */
 VAR mode_t		ConfigFilePerm		VALUE(0640U),
 					/* Permissions for config files */
 			LogFilePerm		VALUE(0644U);
@@ -183,7 +209,11 @@ VAR cupsd_sandboxing_t	Sandboxing		VALUE(CUPSD_SANDBOXING_STRICT);
 					/* Sandboxing level */
 VAR int			UseSandboxing	VALUE(1);
 					/* Use sandboxing for child procs? */
-VAR int			MaxClients		VALUE(100),
+VAR cupsd_spool_t	SpoolLayout		VALUE(CUPSD_SPOOL_FLAT);
+					/* Layout of job files in RequestRoot */
+VAR int			MaxCGIWorkers		VALUE(0),
+					/* Maximum number of resident CGI processes */
+			MaxClients		VALUE(100),
 					/* Maximum number of clients */
 			MaxClientsPerHost	VALUE(0),
 					/* Maximum number of clients per host */
@@ -195,6 +225,8 @@ VAR int			MaxClients		VALUE(100),
 					/* Maximum size of IPP requests */
 			HostNameLookups		VALUE(FALSE),
 					/* Do we do reverse lookups? */
+			HTTPBufferSize		VALUE(0),
+					/* Size of client HTTP buffers */
 			Timeout			VALUE(DEFAULT_TIMEOUT),
 					/* Timeout during requests */
 			KeepAlive		VALUE(TRUE),
@@ -209,6 +241,8 @@ VAR int			MaxClients		VALUE(100),
 					/* Current filter level */
 			FilterNice		VALUE(0),
 					/* Nice value for filters */
+			SlowRequestThreshold	VALUE(0),
+					/* Log requests slower than this (ms) */
 			ReloadTimeout		VALUE(DEFAULT_KEEPALIVE),
 					/* Timeout before reload from SIGHUP */
 			RootCertDuration	VALUE(300),
@@ -256,6 +290,8 @@ VAR char		*SystemGroupAuthKey	VALUE(NULL);
 #ifdef HAVE_GSSAPI
 VAR char		*GSSServiceName		VALUE(NULL);
 					/* GSS service name */
+VAR int			GSSSessionTimeout	VALUE(0);
+					/* Lifetime of Negotiate session cookies */
 VAR int			HaveServerCreds		VALUE(0);
 					/* Do we have server credentials? */
 VAR gss_cred_id_t	ServerCreds;	/* Server's GSS credentials */
@@ -274,6 +310,8 @@ extern int	cupsdCheckPermissions(const char *filename,
 				      int create_dir);
 extern int	cupsdCheckProgram(const char *filename, cupsd_printer_t *p);
 extern int	cupsdDefaultAuthType(void);
+extern double	cupsdElapsedTime(struct timeval *start, struct timeval *end);
+extern void	cupsdFlushLogs(void);
 extern void	cupsdFreeAliases(cups_array_t *aliases);
 extern char	*cupsdGetDateTime(struct timeval *t, cupsd_time_t format);
 extern int	cupsdLogClient(cupsd_client_t *con, int level, const char *message, ...) _CUPS_FORMAT(3, 4);
@@ -286,5 +324,7 @@ extern int	cupsdLogJob(cupsd_job_t *job, int level, const char *message,
 extern int	cupsdLogMessage(int level, const char *message, ...) _CUPS_FORMAT(2, 3);
 extern int	cupsdLogPage(cupsd_job_t *job, const char *page);
 extern int	cupsdLogRequest(cupsd_client_t *con, http_status_t code);
+extern int	cupsdNeedFullReload(void);
 extern int	cupsdReadConfiguration(void);
+extern void	cupsdStampConfFile(const char *filename);
 extern int	cupsdWriteErrorLog(int level, const char *message);
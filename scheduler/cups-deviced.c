@@ -25,6 +25,7 @@
  */
 
 #define MAX_BACKENDS	200		/* Maximum number of backends we'll run */
+#define DEVICE_CACHE_TIME 30		/* Seconds to reuse cached backend output */
 
 
 /*
@@ -38,6 +39,10 @@ typedef struct
 		status;			/* Exit status */
   cups_file_t	*pipe;			/* Pipe from backend stdout */
   int		count;			/* Number of devices found */
+  double	end_time;		/* Deadline for backend */
+  int		timed_out;		/* Stopped at its deadline? */
+  cups_file_t	*cache;			/* Temporary cache file */
+  char		cachefile[1024];	/* Cache filename */
 } cupsd_backend_t;
 
 
@@ -77,6 +82,7 @@ static int		send_class,	/* Send device-class attribute? */
 			send_location;	/* Send device-location attribute? */
 static int		dead_children = 0;
 					/* Dead children? */
+static const char	*cache_dir;	/* CUPS_CACHEDIR environment variable */
 
 
 /*
@@ -89,13 +95,19 @@ static int		add_device(const char *device_class,
 				   const char *device_uri,
 				   const char *device_id,
 				   const char *device_location);
+static void		cache_backend(cupsd_backend_t *backend, int discard);
 static int		compare_devices(cupsd_device_t *p0,
 			                cupsd_device_t *p1);
 static double		get_current_time(void);
 static int		get_device(cupsd_backend_t *backend);
+static int		parse_device(const char *name, char *line);
 static void		process_children(void);
+static int		send_cache(const char *name, const char *cachefile,
+			           struct stat *programinfo);
 static void		sigchld_handler(int sig);
-static int		start_backend(const char *backend, int root);
+static int		start_backend(const char *backend, int root,
+			              double end_time);
+static void		stop_backend(cupsd_backend_t *backend);
 
 
 /*
@@ -237,6 +249,25 @@ main(int  argc,				/* I - Number of command-line args */
 
   devices = cupsArrayNew((cups_array_func_t)compare_devices, NULL);
 
+  if ((cache_dir = getenv("CUPS_CACHEDIR")) == NULL)
+    cache_dir = CUPS_CACHEDIR;
+
+ /*
+  * Send the response header now so that devices are streamed to the client
+  * as soon as a backend (or its cached output) reports them...
+  */
+
+  if (getenv("SOFTWARE"))
+    puts("Content-Type: application/ipp\n");
+
+  cupsdSendIPPHeader(IPP_OK, request_id);
+  cupsdSendIPPGroup(IPP_TAG_OPERATION);
+  cupsdSendIPPString(IPP_TAG_CHARSET, "attributes-charset", "utf-8");
+  cupsdSendIPPString(IPP_TAG_LANGUAGE, "attributes-natural-language", "en-US");
+  fflush(stdout);
+
+  end_time = get_current_time() + timeout;
+
  /*
   * Loop through all of the device backends...
   */
@@ -265,7 +296,7 @@ main(int  argc,				/* I - Number of command-line args */
     * all others run as the unprivileged user...
     */
 
-    start_backend(dent->filename, !(dent->fileinfo.st_mode & (S_IWGRP | S_IRWXO)));
+    start_backend(dent->filename, !(dent->fileinfo.st_mode & (S_IWGRP | S_IRWXO)), end_time);
   }
 
   cupsDirClose(dir);
@@ -274,23 +305,35 @@ main(int  argc,				/* I - Number of command-line args */
   * Collect devices...
   */
 
-  if (getenv("SOFTWARE"))
-    puts("Content-Type: application/ipp\n");
+  while (active_backends > 0)
+  {
+   /*
+    * Stop backends that have run past their deadline and wait no longer
+    * than the next one...
+    */
 
-  cupsdSendIPPHeader(IPP_OK, request_id);
-  cupsdSendIPPGroup(IPP_TAG_OPERATION);
-  cupsdSendIPPString(IPP_TAG_CHARSET, "attributes-charset", "utf-8");
-  cupsdSendIPPString(IPP_TAG_LANGUAGE, "attributes-natural-language", "en-US");
+    current_time = get_current_time();
+    end_time     = 0.0;
 
-  end_time = get_current_time() + timeout;
+    for (i = 0; i < num_backends; i ++)
+    {
+      if (!backends[i].pid || backends[i].timed_out)
+        continue;
+
+      if (backends[i].end_time <= current_time)
+        stop_backend(backends + i);
+      else if (end_time == 0.0 || backends[i].end_time < end_time)
+        end_time = backends[i].end_time;
+    }
+
+    if (active_backends <= 0)
+      break;
 
-  while (active_backends > 0 && (current_time = get_current_time()) < end_time)
-  {
    /*
     * Collect the output from the backends...
     */
 
-    timeout = (int)(1000 * (end_time - current_time));
+    timeout = (int)(1000 * (end_time - current_time)) + 1;
 
     if (poll(backend_fds, (nfds_t)num_backends, timeout) > 0)
     {
@@ -304,7 +347,7 @@ main(int  argc,				/* I - Number of command-line args */
 	  {
 	    if (get_device(backends + i))
 	    {
-	      backend_fds[i].fd     = 0;
+	      backend_fds[i].fd     = -1;
 	      backend_fds[i].events = 0;
 	      break;
 	    }
@@ -324,14 +367,16 @@ main(int  argc,				/* I - Number of command-line args */
   cupsdSendIPPTrailer();
 
  /*
-  * Terminate any remaining backends and exit...
+  * Terminate any remaining backends, discard incomplete cache files, and
+  * exit...
   */
 
-  if (active_backends > 0)
+  for (i = 0; i < num_backends; i ++)
   {
-    for (i = 0; i < num_backends; i ++)
-      if (backends[i].pid)
-	kill(backends[i].pid, SIGTERM);
+    if (backends[i].pid)
+      kill(backends[i].pid, SIGTERM);
+
+    cache_backend(backends + i, 1);
   }
 
   return (0);
@@ -422,6 +467,38 @@ add_device(
 }
 
 
+/*
+ * 'cache_backend()' - Save or discard the cached output of a backend.
+ *
+ * The output is only saved once the backend has both closed its pipe and
+ * exited normally, so partial results are never reused.
+ */
+
+static void
+cache_backend(
+    cupsd_backend_t *backend,		/* I - Backend */
+    int             discard)		/* I - Discard the output? */
+{
+  char	tempfile[1040];			/* Temporary cache filename */
+
+
+  if (!backend->cache)
+    return;
+
+  if (!discard && (backend->pid || backend->pipe))
+    return;
+
+  cupsFileClose(backend->cache);
+  backend->cache = NULL;
+
+  snprintf(tempfile, sizeof(tempfile), "%s.%d", backend->cachefile,
+           (int)getpid());
+
+  if (discard || rename(tempfile, backend->cachefile))
+    unlink(tempfile);
+}
+
+
 /*
  * 'compare_devices()' - Compare device names to eliminate duplicates.
  */
@@ -469,8 +546,44 @@ get_current_time(void)
 static int				/* O - 0 on success, -1 on error */
 get_device(cupsd_backend_t *backend)	/* I - Backend to read from */
 {
-  char	line[2048],			/* Line from backend */
-	temp[2048],			/* Copy of line */
+  char	line[2048];			/* Line from backend */
+
+
+  if (cupsFileGets(backend->pipe, line, sizeof(line)))
+  {
+   /*
+    * Add the device and remember the line for the next request...
+    */
+
+    if (!parse_device(backend->name, line) && backend->cache)
+      cupsFilePrintf(backend->cache, "%s\n", line);
+
+    return (0);
+  }
+
+ /*
+  * End of file...
+  */
+
+  cupsFileClose(backend->pipe);
+  backend->pipe = NULL;
+
+  if (!backend->pid)
+    cache_backend(backend, backend->status != 0);
+
+  return (-1);
+}
+
+
+/*
+ * 'parse_device()' - Parse a device line from a backend.
+ */
+
+static int				/* O - 0 on success, -1 on bad line */
+parse_device(const char *name,		/* I - Name of backend */
+             char       *line)		/* I - Line from backend */
+{
+  char	temp[2048],			/* Copy of line */
 	*ptr,				/* Pointer into line */
 	*dclass,			/* Device class */
 	*uri,				/* Device URI */
@@ -480,72 +593,87 @@ get_device(cupsd_backend_t *backend)	/* I - Backend to read from */
 	*location;			/* Physical location */
 
 
-  if (cupsFileGets(backend->pipe, line, sizeof(line)))
-  {
-   /*
-    * Each line is of the form:
-    *
-    *   class URI "make model" "name" ["1284 device ID"] ["location"]
-    */
+ /*
+  * Each line is of the form:
+  *
+  *   class URI "make model" "name" ["1284 device ID"] ["location"]
+  */
 
-    strlcpy(temp, line, sizeof(temp));
+  strlcpy(temp, line, sizeof(temp));
 
-   /*
-    * device-class
-    */
+ /*
+  * device-class
+  */
 
-    dclass = temp;
+  dclass = temp;
 
-    for (ptr = temp; *ptr; ptr ++)
-      if (isspace(*ptr & 255))
-        break;
+  for (ptr = temp; *ptr; ptr ++)
+    if (isspace(*ptr & 255))
+      break;
 
-    while (isspace(*ptr & 255))
-      *ptr++ = '\0';
+  while (isspace(*ptr & 255))
+    *ptr++ = '\0';
 
-   /*
-    * device-uri
-    */
+ /*
+  * device-uri
+  */
 
-    if (!*ptr)
-      goto error;
+  if (!*ptr)
+    goto error;
 
-    for (uri = ptr; *ptr; ptr ++)
-      if (isspace(*ptr & 255))
-        break;
+  for (uri = ptr; *ptr; ptr ++)
+    if (isspace(*ptr & 255))
+      break;
 
-    while (isspace(*ptr & 255))
-      *ptr++ = '\0';
+  while (isspace(*ptr & 255))
+    *ptr++ = '\0';
 
-   /*
-    * device-make-and-model
-    */
+ /*
+  * device-make-and-model
+  */
 
-    if (*ptr != '\"')
-      goto error;
+  if (*ptr != '\"')
+    goto error;
 
-    for (ptr ++, make_model = ptr; *ptr && *ptr != '\"'; ptr ++)
-    {
-      if (*ptr == '\\' && ptr[1])
-        _cups_strcpy(ptr, ptr + 1);
-    }
+  for (ptr ++, make_model = ptr; *ptr && *ptr != '\"'; ptr ++)
+  {
+    if (*ptr == '\\' && ptr[1])
+      _cups_strcpy(ptr, ptr + 1);
+  }
 
-    if (*ptr != '\"')
-      goto error;
+  if (*ptr != '\"')
+    goto error;
 
-    for (*ptr++ = '\0'; isspace(*ptr & 255); *ptr++ = '\0');
+  for (*ptr++ = '\0'; isspace(*ptr & 255); *ptr++ = '\0');
 
-   /*
-    * device-info
-    */
+ /*
+  * device-info
+  */
 
-    if (*ptr != '\"')
-      goto error;
+  if (*ptr != '\"')
+    goto error;
 
-    for (ptr ++, info = ptr; *ptr && *ptr != '\"'; ptr ++)
+  for (ptr ++, info = ptr; *ptr && *ptr != '\"'; ptr ++)
+  {
+    if (*ptr == '\\' && ptr[1])
+      _cups_strcpy(ptr, ptr + 1);
+  }
+
+  if (*ptr != '\"')
+    goto error;
+
+  for (*ptr++ = '\0'; isspace(*ptr & 255); *ptr++ = '\0');
+
+ /*
+  * device-id
+  */
+
+  if (*ptr == '\"')
+  {
+    for (ptr ++, device_id = ptr; *ptr && *ptr != '\"'; ptr ++)
     {
       if (*ptr == '\\' && ptr[1])
-        _cups_strcpy(ptr, ptr + 1);
+	_cups_strcpy(ptr, ptr + 1);
     }
 
     if (*ptr != '\"')
@@ -554,12 +682,12 @@ get_device(cupsd_backend_t *backend)	/* I - Backend to read from */
     for (*ptr++ = '\0'; isspace(*ptr & 255); *ptr++ = '\0');
 
    /*
-    * device-id
+    * device-location
     */
 
     if (*ptr == '\"')
     {
-      for (ptr ++, device_id = ptr; *ptr && *ptr != '\"'; ptr ++)
+      for (ptr ++, location = ptr; *ptr && *ptr != '\"'; ptr ++)
       {
 	if (*ptr == '\\' && ptr[1])
 	  _cups_strcpy(ptr, ptr + 1);
@@ -568,52 +696,25 @@ get_device(cupsd_backend_t *backend)	/* I - Backend to read from */
       if (*ptr != '\"')
 	goto error;
 
-      for (*ptr++ = '\0'; isspace(*ptr & 255); *ptr++ = '\0');
-
-     /*
-      * device-location
-      */
-
-      if (*ptr == '\"')
-      {
-	for (ptr ++, location = ptr; *ptr && *ptr != '\"'; ptr ++)
-	{
-	  if (*ptr == '\\' && ptr[1])
-	    _cups_strcpy(ptr, ptr + 1);
-	}
-
-	if (*ptr != '\"')
-	  goto error;
-
-	*ptr = '\0';
-      }
-      else
-        location = NULL;
+      *ptr = '\0';
     }
     else
-    {
-      device_id = NULL;
-      location  = NULL;
-    }
-
-   /*
-    * Add the device to the array of available devices...
-    */
-
-    if (!add_device(dclass, make_model, info, uri, device_id, location))
-      fprintf(stderr, "DEBUG: [cups-deviced] Found device \"%s\"...\n", uri);
-
-    return (0);
+      location = NULL;
+  }
+  else
+  {
+    device_id = NULL;
+    location  = NULL;
   }
 
  /*
-  * End of file...
+  * Add the device to the array of available devices...
   */
 
-  cupsFileClose(backend->pipe);
-  backend->pipe = NULL;
+  if (!add_device(dclass, make_model, info, uri, device_id, location))
+    fprintf(stderr, "DEBUG: [cups-deviced] Found device \"%s\"...\n", uri);
 
-  return (-1);
+  return (0);
 
  /*
   * Bad format; strip trailing newline and write an error message.
@@ -625,8 +726,8 @@ get_device(cupsd_backend_t *backend)	/* I - Backend to read from */
     line[strlen(line) - 1] = '\0';
 
   fprintf(stderr, "ERROR: [cups-deviced] Bad line from \"%s\": %s\n",
-	  backend->name, line);
-  return (0);
+	  name, line);
+  return (-1);
 }
 
 
@@ -675,7 +776,11 @@ process_children(void)
       backend->pid    = 0;
       backend->status = status;
 
-      active_backends --;
+      if (!backend->timed_out)
+        active_backends --;
+
+      if (!backend->pipe)
+        cache_backend(backend, status != 0);
     }
     else
       name = "Unknown";
@@ -699,6 +804,45 @@ process_children(void)
 }
 
 
+/*
+ * 'send_cache()' - Send the devices from a recent run of a backend.
+ */
+
+static int				/* O - 1 if sent, 0 if not cached */
+send_cache(const char  *name,		/* I - Name of backend */
+           const char  *cachefile,	/* I - Cache filename */
+           struct stat *programinfo)	/* I - Backend file information */
+{
+  struct stat	cacheinfo;		/* Cache file information */
+  cups_file_t	*fp;			/* Cache file */
+  char		line[2048];		/* Line from cache */
+
+
+ /*
+  * Only use output that is newer than the backend and no more than
+  * DEVICE_CACHE_TIME seconds old...
+  */
+
+  if (stat(cachefile, &cacheinfo) ||
+      cacheinfo.st_mtime < programinfo->st_mtime ||
+      (time(NULL) - cacheinfo.st_mtime) >= DEVICE_CACHE_TIME)
+    return (0);
+
+  if ((fp = cupsFileOpen(cachefile, "r")) == NULL)
+    return (0);
+
+  fprintf(stderr, "DEBUG: [cups-deviced] Using cached devices for backend "
+                  "%s.\n", name);
+
+  while (cupsFileGets(fp, line, sizeof(line)))
+    parse_device(name, line);
+
+  cupsFileClose(fp);
+
+  return (1);
+}
+
+
 /*
  * 'sigchld_handler()' - Handle 'child' signals from old processes.
  */
@@ -730,12 +874,16 @@ sigchld_handler(int sig)		/* I - Signal number */
 
 static int				/* O - 0 on success, -1 on error */
 start_backend(const char *name,		/* I - Backend to run */
-              int        root)		/* I - Run as root? */
+              int        root,		/* I - Run as root? */
+              double     end_time)	/* I - Deadline for backend */
 {
   const char		*server_bin;	/* CUPS_SERVERBIN environment variable */
-  char			program[1024];	/* Full path to backend */
+  char			program[1024],	/* Full path to backend */
+			tempfile[1040];	/* Temporary cache filename */
+  struct stat		programinfo;	/* Backend file information */
   cupsd_backend_t	*backend;	/* Current backend */
   char			*argv[2];	/* Command-line arguments */
+  int			fd;		/* Cache file descriptor */
 
 
   if (num_backends >= MAX_BACKENDS)
@@ -750,11 +898,22 @@ start_backend(const char *name,		/* I - Backend to run */
   snprintf(program, sizeof(program), "%s/backend/%s", server_bin, name);
 
   if (_cupsFileCheck(program, _CUPS_FILE_CHECK_PROGRAM, !geteuid(),
-                     _cupsFileCheckFilter, NULL))
+                     _cupsFileCheckFilter, NULL) ||
+      stat(program, &programinfo))
     return (-1);
 
   backend = backends + num_backends;
 
+ /*
+  * Reuse the output of a recent run of the backend if we can...
+  */
+
+  snprintf(backend->cachefile, sizeof(backend->cachefile),
+           "%s/devices-%s.cache", cache_dir, name);
+
+  if (send_cache(name, backend->cachefile, &programinfo))
+    return (0);
+
   argv[0] = (char *)name;
   argv[1] = NULL;
 
@@ -776,12 +935,63 @@ start_backend(const char *name,		/* I - Backend to run */
   backend_fds[num_backends].fd     = cupsFileNumber(backend->pipe);
   backend_fds[num_backends].events = POLLIN;
 
-  backend->name   = strdup(name);
-  backend->status = 0;
-  backend->count  = 0;
+  backend->name      = strdup(name);
+  backend->status    = 0;
+  backend->count     = 0;
+  backend->end_time  = end_time;
+  backend->timed_out = 0;
+
+ /*
+  * Save the output for the next request...
+  */
+
+  snprintf(tempfile, sizeof(tempfile), "%s.%d", backend->cachefile,
+           (int)getpid());
+
+  if ((fd = open(tempfile, O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0)
+  {
+    if ((backend->cache = cupsFileOpenFd(fd, "w")) == NULL)
+    {
+      close(fd);
+      unlink(tempfile);
+    }
+  }
+  else
+    backend->cache = NULL;
 
   active_backends ++;
   num_backends ++;
 
   return (0);
 }
+
+
+/*
+ * 'stop_backend()' - Stop a backend that has run past its deadline.
+ *
+ * Any devices it has already reported have been sent to the client.
+ */
+
+static void
+stop_backend(cupsd_backend_t *backend)	/* I - Backend */
+{
+  fprintf(stderr,
+          "DEBUG: [cups-deviced] Stopping backend %s (PID %d) at its "
+	  "deadline.\n", backend->name, backend->pid);
+
+  kill(backend->pid, SIGTERM);
+
+  backend->timed_out = 1;
+  active_backends --;
+
+  if (backend->pipe)
+  {
+    cupsFileClose(backend->pipe);
+    backend->pipe = NULL;
+
+    backend_fds[backend - backends].fd     = -1;
+    backend_fds[backend - backends].events = 0;
+  }
+
+  cache_backend(backend, 1);
+}
@@ -22,13 +22,14 @@
 #include <cups/ppd-private.h>
 #include <ppdc/ppdc.h>
 #include <regex.h>
+#include <utime.h>
 
 
 /*
  * Constants...
  */
 
-#define PPD_SYNC	0x50504441	/* Sync word for ppds.dat (PPDA) */
+#define PPD_SYNC	0x50504442	/* Sync word for ppds.dat (PPDB) */
 #define PPD_MAX_LANG	32		/* Maximum languages */
 #define PPD_MAX_PROD	32		/* Maximum products */
 #define PPD_MAX_VERS	32		/* Maximum versions */
@@ -41,6 +42,8 @@
 #define PPD_TYPE_DRV		5	/* Driver info file */
 #define PPD_TYPE_ARCHIVE	6	/* Archive file */
 
+#define PPD_MAX_CACHE	100		/* Maximum cached .drv PPDs */
+
 #define TAR_BLOCK	512		/* Number of bytes in a block */
 #define TAR_BLOCKS	10		/* Blocking factor */
 
@@ -82,6 +85,14 @@ typedef struct				/**** PPD record ****/
 		scheme[128];		/* PPD scheme */
 } ppd_rec_t;
 
+typedef struct				/**** Fixed part of ppds.dat record ****/
+{
+  time_t	mtime;			/* Modification time */
+  off_t		size;			/* Size in bytes */
+  int		model_number;		/* cupsModelNumber */
+  int		type;			/* ppd-type */
+} ppd_dat_t;
+
 typedef struct				/**** In-memory record ****/
 {
   int		found;			/* 1 if PPD is found */
@@ -150,10 +161,18 @@ static ppd_info_t	*add_ppd(const char *filename, const char *name,
 				 const char *psversion, time_t mtime,
 				 size_t size, int model_number, int type,
 				 const char *scheme);
+static char		*cache_drv_name(const char *filename,
+			                const char *pc_file_name,
+			                struct stat *fileinfo, char *buffer,
+			                size_t bufsize);
+static void		cache_drv_trim(const char *dirname);
+static int		cat_cache(const char *filename, int request_id);
 static int		cat_drv(const char *name, int request_id);
 static void		cat_ppd(const char *name, int request_id);
 static int		cat_static(const char *name, int request_id);
 static int		cat_tar(const char *name, int request_id);
+static int		check_file(const char *filename,
+			           struct stat *fileinfo);
 static int		compare_inodes(struct stat *a, struct stat *b);
 static int		compare_matches(const ppd_info_t *p0,
 			                const ppd_info_t *p1);
@@ -179,10 +198,14 @@ static void		load_ppds_dat(char *filename, size_t filesize,
 			              int verbose);
 static int		load_tar(const char *filename, const char *name,
 			         cups_file_t *fp, time_t mtime, off_t size);
+static int		read_ppd_rec(const char **bufptr, const char *bufend,
+			             ppd_rec_t *record);
 static int		read_tar(cups_file_t *fp, char *name, size_t namesize,
 			         struct stat *info);
 static regex_t		*regex_device_id(const char *device_id);
 static regex_t		*regex_string(const char *s);
+static int		write_ppd_rec(cups_file_t *fp,
+			              const ppd_rec_t *record);
 
 
 /*
@@ -302,6 +325,173 @@ add_ppd(const char *filename,		/* I - PPD filename */
 }
 
 
+/*
+ * 'cache_drv_name()' - Get the cache filename for a generated PPD.
+ *
+ * Generated PPDs are keyed on the .drv file, the driver, and the CUPS version.
+ * Each cache file starts with the size and modification time of every file
+ * that was read to generate the PPD, which cat_cache() checks before using it.
+ */
+
+static char *				/* O - Filename or NULL */
+cache_drv_name(
+    const char  *filename,		/* I - .drv filename */
+    const char  *pc_file_name,		/* I - PPD filename in .drv file */
+    struct stat *fileinfo,		/* I - .drv file information */
+    char        *buffer,		/* I - Filename buffer */
+    size_t      bufsize)		/* I - Size of filename buffer */
+{
+  const char	*cups_cachedir;		/* CUPS_CACHEDIR environment variable */
+  char		key[2048],		/* Cache key */
+		hashstr[65];		/* Hash of key as hex */
+  unsigned char	hash[32];		/* SHA-256 hash of key */
+  ssize_t	hashlen;		/* Length of hash */
+
+
+  if ((cups_cachedir = getenv("CUPS_CACHEDIR")) == NULL)
+    cups_cachedir = CUPS_CACHEDIR;
+
+  snprintf(key, sizeof(key), "%s\n%s\n%ld\n%ld\n" CUPS_SVERSION, filename, pc_file_name, (long)fileinfo->st_mtime, (long)fileinfo->st_size);
+
+  if ((hashlen = cupsHashData("sha2-256", key, strlen(key), hash, sizeof(hash))) < 0)
+    return (NULL);
+
+  cupsHashString(hash, (size_t)hashlen, hashstr, sizeof(hashstr));
+
+  snprintf(buffer, bufsize, "%s/drv", cups_cachedir);
+  if (mkdir(buffer, 0755) && errno != EEXIST)
+    return (NULL);
+
+  snprintf(buffer, bufsize, "%s/drv/%s.ppd", cups_cachedir, hashstr);
+
+  return (buffer);
+}
+
+
+/*
+ * 'cache_drv_trim()' - Remove the least recently used generated PPD when
+ *                      there are too many.
+ */
+
+static void
+cache_drv_trim(const char *dirname)	/* I - Cache directory */
+{
+  cups_dir_t	*dir;			/* Cache directory */
+  cups_dentry_t	*dent;			/* Current cache file */
+  int		count = 0;		/* Number of cache files */
+  time_t	oldest = 0;		/* Oldest cache file time */
+  char		oldname[256] = "",	/* Oldest cache file */
+		filename[1024];		/* Cache filename */
+
+
+  if ((dir = cupsDirOpen(dirname)) == NULL)
+    return;
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if (!S_ISREG(dent->fileinfo.st_mode))
+      continue;
+
+    count ++;
+
+    if (!oldname[0] || dent->fileinfo.st_mtime < oldest)
+    {
+      strlcpy(oldname, dent->filename, sizeof(oldname));
+      oldest = dent->fileinfo.st_mtime;
+    }
+  }
+
+  cupsDirClose(dir);
+
+  if (count > PPD_MAX_CACHE && snprintf(filename, sizeof(filename), "%s/%s", dirname, oldname) < (int)sizeof(filename))
+    unlink(filename);
+}
+
+
+/*
+ * 'cat_cache()' - Copy a cached PPD file to stdout.
+ */
+
+static int				/* O - 1 if copied, 0 if not cached */
+cat_cache(const char *filename,		/* I - Cache filename */
+          int        request_id)	/* I - Request ID for response? */
+{
+  cups_file_t	*fp;			/* Cache file */
+  char		buffer[8192],		/* Copy buffer */
+		*ptr;			/* Pointer into buffer */
+  ssize_t	bytes;			/* Bytes read */
+  long		mtime,			/* Recorded modification time */
+		size;			/* Recorded size */
+  struct stat	fileinfo;		/* Current file information */
+
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+    return (0);
+
+ /*
+  * Make sure none of the files used to generate the PPD have changed.  Each
+  * line is "mtime size filename", and a blank line ends the list...
+  */
+
+  while ((ptr = cupsFileGets(fp, buffer, sizeof(buffer))) != NULL && buffer[0])
+  {
+    mtime = strtol(buffer, &ptr, 10);
+    size  = strtol(ptr, &ptr, 10);
+
+    if (*ptr != ' ')
+    {
+      ptr = NULL;
+      break;
+    }
+
+    if (stat(ptr + 1, &fileinfo))
+    {
+      fileinfo.st_mtime = 0;
+      fileinfo.st_size  = -1;
+    }
+
+    if ((long)fileinfo.st_mtime != mtime || (long)fileinfo.st_size != size)
+    {
+      fprintf(stderr, "DEBUG2: [cups-driverd] \"%s\" has changed, not using cached PPD \"%s\".\n", ptr + 1, filename);
+      ptr = NULL;
+      break;
+    }
+  }
+
+  if (!ptr)
+  {
+    cupsFileClose(fp);
+    return (0);
+  }
+
+  fprintf(stderr, "DEBUG2: [cups-driverd] Using cached PPD \"%s\".\n", filename);
+
+ /*
+  * Mark the file as recently used...
+  */
+
+  utime(filename, NULL);
+
+  if (request_id)
+  {
+    cupsdSendIPPHeader(IPP_OK, request_id);
+    cupsdSendIPPGroup(IPP_TAG_OPERATION);
+    cupsdSendIPPString(IPP_TAG_CHARSET, "attributes-charset", "utf-8");
+    cupsdSendIPPString(IPP_TAG_LANGUAGE, "attributes-natural-language",
+		       "en-US");
+    cupsdSendIPPTrailer();
+  }
+
+  while ((bytes = cupsFileRead(fp, buffer, sizeof(buffer))) > 0)
+    if (fwrite(buffer, (size_t)bytes, 1, stdout) != 1)
+      break;
+
+  cupsFileClose(fp);
+
+  return (1);
+}
+
+
 /*
  * 'cat_drv()' - Generate a PPD from a driver info file.
  */
@@ -320,8 +510,12 @@ cat_drv(const char *name,		/* I - PPD name */
 		userpass[256],		// User/password info (unused)
 		host[2],		// Hostname (unused)
 		resource[1024],		// Resource path (/dir/to/filename.drv)
-		*pc_file_name;		// Filename portion of URI
+		*pc_file_name,		// Filename portion of URI
+		cachename[1024],	// Cached PPD filename
+		tempname[1024],		// Temporary cache filename
+		*ptr;			// Pointer into filename
   int		port;			// Port number (unused)
+  struct stat	fileinfo;		// .drv file information
 
 
   // Pull out the path to the .drv file...
@@ -350,6 +544,16 @@ cat_drv(const char *name,		/* I - PPD name */
   if ((fp = get_file(resource, request_id, "drv", filename, sizeof(filename), &pc_file_name)) == NULL || !pc_file_name)
     return (1);
 
+  // Use the PPD we generated last time, if any...
+  if (fstat(cupsFileNumber(fp), &fileinfo) ||
+      !cache_drv_name(filename, pc_file_name, &fileinfo, cachename, sizeof(cachename)))
+    cachename[0] = '\0';
+  else if (cat_cache(cachename, request_id))
+  {
+    cupsFileClose(fp);
+    return (0);
+  }
+
   src = new ppdcSource(filename, fp);
 
   for (d = (ppdcDriver *)src->drivers->first();
@@ -378,20 +582,69 @@ cat_drv(const char *name,		/* I - PPD name */
       locales->add(catalog->locale);
     }
 
-    if (request_id)
+    // Save the PPD in the cache and then copy it, or write it directly when
+    // it cannot be cached...
+    if (cachename[0])
     {
-      cupsdSendIPPHeader(IPP_OK, request_id);
-      cupsdSendIPPGroup(IPP_TAG_OPERATION);
-      cupsdSendIPPString(IPP_TAG_CHARSET, "attributes-charset", "utf-8");
-      cupsdSendIPPString(IPP_TAG_LANGUAGE, "attributes-natural-language",
-			 "en-US");
-      cupsdSendIPPTrailer();
-      fflush(stdout);
+      if (snprintf(tempname, sizeof(tempname), "%s.%d", cachename, (int)getpid()) >= (int)sizeof(tempname))
+        cachename[0] = '\0';
+      else if ((out = cupsFileOpen(tempname, "w")) != NULL)
+      {
+        ppdcString	*dep;		// File used to generate the PPD
+	struct stat	depinfo;	// Dependency file information
+
+        // Record the files that were read so that changes to any of them,
+	// including #include and #po files, invalidate the cache...
+	for (dep = (ppdcString *)src->files->first();
+	     dep;
+	     dep = (ppdcString *)src->files->next())
+	{
+	  if (stat(dep->value, &depinfo))
+	  {
+	    depinfo.st_mtime = 0;
+	    depinfo.st_size  = -1;
+	  }
+
+	  cupsFilePrintf(out, "%ld %ld %s\n", (long)depinfo.st_mtime, (long)depinfo.st_size, dep->value);
+	}
+
+	cupsFilePuts(out, "\n");
+
+        if (d->write_ppd_file(out, NULL, locales, src, PPDC_LFONLY) ||
+	    cupsFileClose(out) || rename(tempname, cachename))
+	{
+	  unlink(tempname);
+	  cachename[0] = '\0';
+	}
+	else
+	{
+	  if ((ptr = strrchr(tempname, '/')) != NULL)
+	    *ptr = '\0';
+
+	  cache_drv_trim(tempname);
+	}
+      }
+      else
+        cachename[0] = '\0';
     }
 
-    out = cupsFileStdout();
-    d->write_ppd_file(out, NULL, locales, src, PPDC_LFONLY);
-    cupsFileClose(out);
+    if (!cachename[0] || !cat_cache(cachename, request_id))
+    {
+      if (request_id)
+      {
+	cupsdSendIPPHeader(IPP_OK, request_id);
+	cupsdSendIPPGroup(IPP_TAG_OPERATION);
+	cupsdSendIPPString(IPP_TAG_CHARSET, "attributes-charset", "utf-8");
+	cupsdSendIPPString(IPP_TAG_LANGUAGE, "attributes-natural-language",
+			   "en-US");
+	cupsdSendIPPTrailer();
+	fflush(stdout);
+      }
+
+      out = cupsFileStdout();
+      d->write_ppd_file(out, NULL, locales, src, PPDC_LFONLY);
+      cupsFileClose(out);
+    }
 
     locales->release();
   }
@@ -693,6 +946,30 @@ cat_tar(const char *name,		/* I - PPD name */
 }
 
 
+/*
+ * 'check_file()' - Check the permissions of a file found in a PPD directory.
+ *
+ * This is the same as _cupsFileCheck() with _CUPS_FILE_CHECK_FILE_ONLY, but
+ * uses the information cupsDirRead() already has so that files which pass
+ * don't need another stat() or a log message each.  Files that fail are passed
+ * to _cupsFileCheck() so the usual errors are logged.
+ */
+
+static int				/* O - 0 if OK, non-zero if not */
+check_file(const char  *filename,	/* I - Filename */
+           struct stat *fileinfo)	/* I - File information */
+{
+  if (!strstr(filename, "../") && S_ISREG(fileinfo->st_mode) &&
+      (geteuid() ||
+       (!fileinfo->st_uid &&
+        !(fileinfo->st_mode & (S_IWGRP | S_ISUID | S_IWOTH)))))
+    return (0);
+
+  return ((int)_cupsFileCheck(filename, _CUPS_FILE_CHECK_FILE_ONLY, !geteuid(),
+                              _cupsFileCheckFilter, NULL));
+}
+
+
 /*
  * 'compare_inodes()' - Compare two inodes.
  */
@@ -1143,11 +1420,16 @@ list_ppds(int        request_id,	/* I - Request ID */
       for (ppd = (ppd_info_t *)cupsArrayFirst(PPDsByName);
 	   ppd;
 	   ppd = (ppd_info_t *)cupsArrayNext(PPDsByName))
-	cupsFileWrite(fp, (char *)&(ppd->record), sizeof(ppd_rec_t));
-
-      cupsFileClose(fp);
+	if (write_ppd_rec(fp, &(ppd->record)))
+	  break;
 
-      if (rename(newname, filename))
+      if (cupsFileClose(fp) || ppd)
+      {
+	fprintf(stderr, "ERROR: [cups-driverd] Unable to write \"%s\" - %s\n",
+		newname, strerror(errno));
+	unlink(newname);
+      }
+      else if (rename(newname, filename))
 	fprintf(stderr, "ERROR: [cups-driverd] Unable to rename \"%s\" - %s\n",
 		newname, strerror(errno));
       else
@@ -1321,7 +1603,7 @@ list_ppds(int        request_id,	/* I - Request ID */
 
       ppd->matches = 0;
 
-      if (device_id_re &&
+      if (device_id_re && ppd->record.device_id[0] &&
 	  !regexec(device_id_re, ppd->record.device_id,
                    (size_t)(sizeof(re_matches) / sizeof(re_matches[0])),
 		   re_matches, 0))
@@ -1351,7 +1633,7 @@ list_ppds(int        request_id,	/* I - Request ID */
       if (make && !_cups_strcasecmp(ppd->record.make, make))
         ppd->matches ++;
 
-      if (make_and_model_re &&
+      if (make_and_model_re && ppd->record.make_and_model[0] &&
           !regexec(make_and_model_re, ppd->record.make_and_model,
 	           (size_t)(sizeof(re_matches) / sizeof(re_matches[0])),
 		   re_matches, 0))
@@ -2484,8 +2766,7 @@ load_ppds(const char *d,		/* I - Actual directory */
 
       continue;
     }
-    else if (_cupsFileCheck(filename, _CUPS_FILE_CHECK_FILE_ONLY, !geteuid(),
-		            _cupsFileCheckFilter, NULL))
+    else if (check_file(filename, &dent->fileinfo))
       continue;
 
    /*
@@ -2604,41 +2885,50 @@ load_ppds_dat(char   *filename,		/* I - Filename buffer */
     * See if we have the right sync word...
     */
 
-    unsigned ppdsync;			/* Sync word */
-    int      num_ppds;			/* Number of PPDs */
+    unsigned	ppdsync;		/* Sync word */
+    char	*buffer;		/* Records */
+    const char	*bufptr,		/* Pointer into records */
+		*bufend;		/* End of records */
+    size_t	bufsize;		/* Size of records */
 
     if ((size_t)cupsFileRead(fp, (char *)&ppdsync, sizeof(ppdsync)) == sizeof(ppdsync) &&
         ppdsync == PPD_SYNC &&
         !stat(filename, &fileinfo) &&
-	(((size_t)fileinfo.st_size - sizeof(ppdsync)) % sizeof(ppd_rec_t)) == 0 &&
-	(num_ppds = ((size_t)fileinfo.st_size - sizeof(ppdsync)) / sizeof(ppd_rec_t)) > 0)
+	(bufsize = (size_t)fileinfo.st_size - sizeof(ppdsync)) > 0 &&
+	(buffer = (char *)malloc(bufsize)) != NULL)
     {
      /*
-      * We have a ppds.dat file, so read it!
+      * We have a ppds.dat file, so read it!  Records are variable-length,
+      * with only the strings that are actually used...
       */
 
-      for (; num_ppds > 0; num_ppds --)
+      if ((size_t)cupsFileRead(fp, buffer, bufsize) == bufsize)
       {
-	if ((ppd = (ppd_info_t *)calloc(1, sizeof(ppd_info_t))) == NULL)
+	for (bufptr = buffer, bufend = buffer + bufsize; bufptr < bufend;)
 	{
-	  if (verbose)
-	    fputs("ERROR: [cups-driverd] Unable to allocate memory for PPD!\n",
-		  stderr);
-	  exit(1);
-	}
+	  if ((ppd = (ppd_info_t *)calloc(1, sizeof(ppd_info_t))) == NULL)
+	  {
+	    if (verbose)
+	      fputs("ERROR: [cups-driverd] Unable to allocate memory for PPD!\n",
+		    stderr);
+	    exit(1);
+	  }
 
-	if (cupsFileRead(fp, (char *)&(ppd->record), sizeof(ppd_rec_t)) > 0)
-	{
-	  cupsArrayAdd(PPDsByName, ppd);
-	  cupsArrayAdd(PPDsByMakeModel, ppd);
-	}
-	else
-	{
-	  free(ppd);
-	  break;
+	  if (read_ppd_rec(&bufptr, bufend, &(ppd->record)))
+	  {
+	    cupsArrayAdd(PPDsByName, ppd);
+	    cupsArrayAdd(PPDsByMakeModel, ppd);
+	  }
+	  else
+	  {
+	    free(ppd);
+	    break;
+	  }
 	}
       }
 
+      free(buffer);
+
       if (verbose)
 	fprintf(stderr, "INFO: [cups-driverd] Read \"%s\", %d PPDs...\n",
 		filename, cupsArrayCount(PPDsByName));
@@ -2701,6 +2991,101 @@ load_tar(const char  *filename,		/* I - Actual filename */
 }
 
 
+/*
+ * 'read_ppd_rec()' - Read a record from the ppds.dat file.
+ *
+ * See write_ppd_rec() for the record format.
+ */
+
+static int				/* O  - 1 on success, 0 on error */
+read_ppd_rec(const char **bufptr,	/* IO - Pointer into records */
+             const char *bufend,	/* I  - End of records */
+             ppd_rec_t  *record)	/* O  - Record */
+{
+  int		i;			/* Looping var */
+  const char	*ptr = *bufptr,		/* Pointer into records */
+		*next;			/* End of current string */
+  ppd_dat_t	dat;			/* Fixed part of record */
+  char		*strings[6];		/* Fixed strings */
+  size_t	sizes[6];		/* Sizes of fixed strings */
+  struct
+  {
+    char	*list;			/* First string in list */
+    int		count;			/* Number of strings */
+    size_t	size;			/* Size of each string */
+  }		lists[3];		/* String lists */
+  int		count;			/* Number of strings in list */
+
+
+  if ((size_t)(bufend - ptr) < sizeof(dat))
+    return (0);
+
+  memcpy(&dat, ptr, sizeof(dat));
+  ptr += sizeof(dat);
+
+  record->mtime        = dat.mtime;
+  record->size         = dat.size;
+  record->model_number = dat.model_number;
+  record->type         = dat.type;
+
+  strings[0] = record->filename;
+  sizes[0]   = sizeof(record->filename);
+  strings[1] = record->name;
+  sizes[1]   = sizeof(record->name);
+  strings[2] = record->make;
+  sizes[2]   = sizeof(record->make);
+  strings[3] = record->make_and_model;
+  sizes[3]   = sizeof(record->make_and_model);
+  strings[4] = record->device_id;
+  sizes[4]   = sizeof(record->device_id);
+  strings[5] = record->scheme;
+  sizes[5]   = sizeof(record->scheme);
+
+  for (i = 0; i < 6; i ++)
+  {
+    if ((next = (const char *)memchr(ptr, 0, (size_t)(bufend - ptr))) == NULL)
+      return (0);
+
+    strlcpy(strings[i], ptr, sizes[i]);
+    ptr = next + 1;
+  }
+
+  lists[0].list  = record->languages[0];
+  lists[0].count = PPD_MAX_LANG;
+  lists[0].size  = sizeof(record->languages[0]);
+  lists[1].list  = record->products[0];
+  lists[1].count = PPD_MAX_PROD;
+  lists[1].size  = sizeof(record->products[0]);
+  lists[2].list  = record->psversions[0];
+  lists[2].count = PPD_MAX_VERS;
+  lists[2].size  = sizeof(record->psversions[0]);
+
+  for (i = 0; i < 3; i ++)
+  {
+    for (count = 0;; count ++)
+    {
+      if ((next = (const char *)memchr(ptr, 0, (size_t)(bufend - ptr))) == NULL)
+	return (0);
+
+      if (next == ptr)
+      {
+        ptr ++;
+	break;
+      }
+
+      if (count < lists[i].count)
+        strlcpy(lists[i].list + (size_t)count * lists[i].size, ptr, lists[i].size);
+
+      ptr = next + 1;
+    }
+  }
+
+  *bufptr = ptr;
+
+  return (1);
+}
+
+
 /*
  * 'read_tar()' - Read a file header from an archive.
  *
@@ -2914,3 +3299,65 @@ regex_string(const char *s)		/* I - String to compare */
 
   return (NULL);
 }
+
+
+/*
+ * 'write_ppd_rec()' - Write a record to the ppds.dat file.
+ *
+ * Each record is the fixed ppd_dat_t fields followed by the filename, name,
+ * make, make-and-model, device ID, and scheme strings and then the language,
+ * product, and PostScript version lists.  Strings are nul-terminated and each
+ * list ends with an empty string, which keeps the file a small fraction of
+ * the size of the in-memory records.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+write_ppd_rec(cups_file_t     *fp,	/* I - ppds.dat file */
+              const ppd_rec_t *record)	/* I - Record */
+{
+  int		i;			/* Looping var */
+  ppd_dat_t	dat;			/* Fixed part of record */
+  const char	*strings[6];		/* Fixed strings */
+
+
+  memset(&dat, 0, sizeof(dat));
+
+  dat.mtime        = record->mtime;
+  dat.size         = record->size;
+  dat.model_number = record->model_number;
+  dat.type         = record->type;
+
+  if (cupsFileWrite(fp, (char *)&dat, sizeof(dat)) < 0)
+    return (-1);
+
+  strings[0] = record->filename;
+  strings[1] = record->name;
+  strings[2] = record->make;
+  strings[3] = record->make_and_model;
+  strings[4] = record->device_id;
+  strings[5] = record->scheme;
+
+  for (i = 0; i < 6; i ++)
+    if (cupsFileWrite(fp, strings[i], strlen(strings[i]) + 1) < 0)
+      return (-1);
+
+  for (i = 0; i < PPD_MAX_LANG && record->languages[i][0]; i ++)
+    if (cupsFileWrite(fp, record->languages[i], strlen(record->languages[i]) + 1) < 0)
+      return (-1);
+
+  if (cupsFilePutChar(fp, 0) < 0)
+    return (-1);
+
+  for (i = 0; i < PPD_MAX_PROD && record->products[i][0]; i ++)
+    if (cupsFileWrite(fp, record->products[i], strlen(record->products[i]) + 1) < 0)
+      return (-1);
+
+  if (cupsFilePutChar(fp, 0) < 0)
+    return (-1);
+
+  for (i = 0; i < PPD_MAX_VERS && record->psversions[i][0]; i ++)
+    if (cupsFileWrite(fp, record->psversions[i], strlen(record->psversions[i]) + 1) < 0)
+      return (-1);
+
+  return (cupsFilePutChar(fp, 0) < 0 ? -1 : 0);
+}
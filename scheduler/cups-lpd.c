@@ -20,6 +20,11 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <pwd.h>
+#include <grp.h>
 
 #ifdef HAVE_INTTYPES_H
 #  include <inttypes.h>
@@ -30,12 +35,15 @@
 
 
 /*
- * LPD "mini-daemon" for CUPS.  This program must be used in conjunction
+ * LPD "mini-daemon" for CUPS.  This program is normally used in conjunction
  * with inetd or another similar program that monitors ports and starts
  * daemons for each client connection.  A typical configuration is:
  *
  *    printer stream tcp nowait lp /usr/lib/cups/daemon/cups-lpd cups-lpd
  *
+ * For busy sites the "-l" option runs a standalone daemon instead, with a
+ * pool of worker processes that handle LPD clients one at a time.
+ *
  * This daemon implements most of RFC 1179 (the unofficial LPD specification)
  * except for:
  *
@@ -49,23 +57,64 @@
  * currently match the Solaris LPD mini-daemon.
  */
 
+/*
+ * Constants...
+ */
+
+#define LPD_MAX_DOCS	100		/* Maximum number of data files */
+#define LPD_MAX_LISTEN	10		/* Maximum number of listen addresses */
+#define LPD_WORKERS	4		/* Default number of worker processes */
+
+
+/*
+ * Types...
+ */
+
+typedef struct lpd_doc_s		/**** Document from control file ****/
+{
+  char		data[256],		/* Data file name */
+		docname[1024];		/* Document name */
+} lpd_doc_t;
+
+
+/*
+ * Globals...
+ */
+
+static http_t	*lpd_http = NULL;	/* Connection to the scheduler */
+static int	lpd_terminate = 0;	/* Set to 1 on SIGTERM */
+
+
 /*
  * Prototypes...
  */
 
+static void	cancel_job(http_t *http, int id, const char *user);
+static http_t	*connect_server(void);
 static int	create_job(http_t *http, const char *dest, const char *title, const char *user, int num_options, cups_option_t *options);
+static void	disconnect_server(void);
 static int	get_printer(http_t *http, const char *name, char *dest,
 		            size_t destsize, cups_option_t **options,
 			    int *accepting, int *shared, ipp_pstate_t *state);
+static int	parse_control(const char *control, int num_defaults,
+		              cups_option_t *defaults, char *title,
+			      size_t titlesize, char *user, size_t usersize,
+			      int *num_options, cups_option_t **options,
+			      lpd_doc_t *docs);
 static int	print_file(http_t *http, int id, const char *filename,
-		           const char *docname, const char *user,
-			   const char *format, int last);
+		           size_t length, const char *docname,
+			   const char *user, const char *format, int last);
+static int	process_connection(int num_defaults, cups_option_t *defaults,
+		                   int hostlookups);
 static int	recv_print_job(const char *name, int num_defaults,
 		               cups_option_t *defaults);
 static int	remove_jobs(const char *name, const char *agent,
 		            const char *list);
+static int	run_daemon(const char *address, int workers, int num_defaults,
+		           cups_option_t *defaults, int hostlookups);
 static int	send_state(const char *name, const char *list,
 		           int longstatus);
+static void	sigterm_handler(int sig);
 static char	*smart_gets(char *s, int len, FILE *fp);
 static void	smart_strlcpy(char *dst, const char *src, size_t dstsize);
 
@@ -81,18 +130,10 @@ main(int  argc,				/* I - Number of command-line arguments */
   int		i;			/* Looping var */
   int		num_defaults;		/* Number of default options */
   cups_option_t	*defaults;		/* Default options */
-  char		line[256],		/* Command string */
-		command,		/* Command code */
-		*dest,			/* Pointer to destination */
-		*list,			/* Pointer to list */
-		*agent,			/* Pointer to user */
-		status;			/* Status for client */
-  socklen_t	hostlen;		/* Size of client address */
-  http_addr_t	hostaddr;		/* Address of client */
-  char		hostname[256],		/* Name of client */
-		hostip[256],		/* IP address */
-		*hostfamily;		/* Address family */
   int		hostlookups;		/* Do hostname lookups? */
+  const char	*address;		/* Address to listen on */
+  int		workers;		/* Number of worker processes */
+  int		status;			/* Exit status */
 
 
 #ifdef __APPLE__
@@ -118,6 +159,8 @@ main(int  argc,				/* I - Number of command-line arguments */
   num_defaults = 0;
   defaults     = NULL;
   hostlookups  = 1;
+  address      = NULL;
+  workers      = LPD_WORKERS;
 
   for (i = 1; i < argc; i ++)
     if (argv[i][0] == '-')
@@ -137,6 +180,19 @@ main(int  argc,				/* I - Number of command-line arguments */
 	    }
 	    break;
 
+        case 'l' : /* -l [address:]port */
+            if (argv[i][2])
+	      address = argv[i] + 2;
+	    else
+	    {
+	      i ++;
+	      if (i < argc)
+	        address = argv[i];
+	      else
+	        syslog(LOG_WARNING, "Expected address string after -l option!");
+	    }
+	    break;
+
 	case 'o' : /* Option */
 	    if (argv[i][2])
 	      num_defaults = cupsParseOptions(argv[i] + 2, num_defaults,
@@ -156,6 +212,25 @@ main(int  argc,				/* I - Number of command-line arguments */
 	    hostlookups = 0;
 	    break;
 
+        case 'w' : /* -w workers */
+            if (argv[i][2])
+	      workers = atoi(argv[i] + 2);
+	    else
+	    {
+	      i ++;
+	      if (i < argc)
+	        workers = atoi(argv[i]);
+	      else
+	        syslog(LOG_WARNING, "Expected worker count after -w option!");
+	    }
+
+            if (workers < 1)
+            {
+              syslog(LOG_WARNING, "Bad worker count, using %d.", LPD_WORKERS);
+              workers = LPD_WORKERS;
+            }
+	    break;
+
 	default :
 	    syslog(LOG_WARNING, "Unknown option \"%c\" ignored!", argv[i][1]);
 	    break;
@@ -166,154 +241,72 @@ main(int  argc,				/* I - Number of command-line arguments */
              argv[i]);
 
  /*
-  * Get the address of the client...
+  * Run as a standalone daemon or handle the one connection on stdin...
   */
 
-  hostlen = sizeof(hostaddr);
-
-  if (getpeername(0, (struct sockaddr *)&hostaddr, &hostlen))
-  {
-    syslog(LOG_WARNING, "Unable to get client address - %s", strerror(errno));
-    strlcpy(hostname, "unknown", sizeof(hostname));
-  }
+  if (address)
+    status = run_daemon(address, workers, num_defaults, defaults, hostlookups);
   else
-  {
-    httpAddrString(&hostaddr, hostip, sizeof(hostip));
-
-    if (hostlookups)
-      httpAddrLookup(&hostaddr, hostname, sizeof(hostname));
-    else
-      strlcpy(hostname, hostip, sizeof(hostname));
+    status = process_connection(num_defaults, defaults, hostlookups);
 
-#ifdef AF_INET6
-    if (hostaddr.addr.sa_family == AF_INET6)
-      hostfamily = "IPv6";
-    else
-#endif /* AF_INET6 */
-    hostfamily = "IPv4";
-
-    syslog(LOG_INFO, "Connection from %s (%s %s)", hostname, hostfamily,
-           hostip);
-  }
-
-  num_defaults = cupsAddOption("job-originating-host-name", hostname,
-                               num_defaults, &defaults);
-
- /*
-  * RFC1179 specifies that only 1 daemon command can be received for
-  * every connection.
-  */
-
-  if (smart_gets(line, sizeof(line), stdin) == NULL)
-  {
-   /*
-    * Unable to get command from client!  Send an error status and return.
-    */
+  disconnect_server();
 
-    syslog(LOG_ERR, "Unable to get command line from client!");
-    putchar(1);
+  closelog();
 
 #ifdef __APPLE__
-    xpc_transaction_end();
+  xpc_transaction_end();
 #endif /* __APPLE__ */
 
-    return (1);
-  }
-
- /*
-  * The first byte is the command byte.  After that will be the queue name,
-  * resource list, and/or user name.
-  */
-
-  if ((command = line[0]) == '\0')
-    dest = line;
-  else
-    dest = line + 1;
-
-  if (command == 0x02)
-    list = NULL;
-  else
-  {
-    for (list = dest; *list && !isspace(*list & 255); list ++);
-
-    while (isspace(*list & 255))
-      *list++ = '\0';
-  }
-
- /*
-  * Do the command...
-  */
-
-  switch (command)
-  {
-    default : /* Unknown command */
-        syslog(LOG_ERR, "Unknown LPD command 0x%02X!", command);
-        syslog(LOG_ERR, "Command line = %s", line + 1);
-	putchar(1);
-
-        status = 1;
-	break;
-
-    case 0x01 : /* Print any waiting jobs */
-        syslog(LOG_INFO, "Print waiting jobs (no-op)");
-	putchar(0);
-
-        status = 0;
-	break;
-
-    case 0x02 : /* Receive a printer job */
-        syslog(LOG_INFO, "Receive print job for %s", dest);
-        /* recv_print_job() sends initial status byte */
-
-        status = (char)recv_print_job(dest, num_defaults, defaults);
-	break;
+  return (status);
+}
 
-    case 0x03 : /* Send queue state (short) */
-        syslog(LOG_INFO, "Send queue state (short) for %s %s", dest, list);
-	/* no status byte for this command */
 
-        status = (char)send_state(dest, list, 0);
-	break;
+/*
+ * 'cancel_job()' - Cancel a job that could not be received.
+ */
 
-    case 0x04 : /* Send queue state (long) */
-        syslog(LOG_INFO, "Send queue state (long) for %s %s", dest, list);
-	/* no status byte for this command */
+static void
+cancel_job(http_t     *http,		/* I - HTTP connection */
+           int        id,		/* I - Job ID */
+	   const char *user)		/* I - requesting-user-name */
+{
+  ipp_t		*request;		/* IPP request */
+  char		uri[HTTP_MAX_URI];	/* Job URI */
 
-        status = (char)send_state(dest, list, 1);
-	break;
 
-    case 0x05 : /* Remove jobs */
-        if (list)
-	{
-	 /*
-	  * Grab the agent and skip to the list of users and/or jobs.
-	  */
+  request = ippNewRequest(IPP_OP_CANCEL_JOB);
 
-	  agent = list;
+  snprintf(uri, sizeof(uri), "ipp://localhost/jobs/%d", id);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "job-uri", NULL, uri);
 
-	  for (; *list && !isspace(*list & 255); list ++);
-	  while (isspace(*list & 255))
-	    *list++ = '\0';
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+               "requesting-user-name", NULL, user);
 
-	  syslog(LOG_INFO, "Remove jobs %s on %s by %s", list, dest, agent);
+  ippDelete(cupsDoRequest(http, request, "/jobs"));
 
-	  status = (char)remove_jobs(dest, agent, list);
-        }
-	else
-	  status = 1;
+  if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
+    syslog(LOG_WARNING, "Cancel of job ID %d failed: %s", id,
+           cupsLastErrorString());
+  else
+    syslog(LOG_INFO, "Job ID %d canceled", id);
+}
 
-	putchar(status);
-	break;
-  }
 
-  syslog(LOG_INFO, "Closing connection");
-  closelog();
+/*
+ * 'connect_server()' - Connect to the scheduler.
+ *
+ * The connection is kept open and reused for later requests from the same
+ * client.  Daemon workers close it after each client so that no
+ * authentication state carries over from one client to the next.
+ */
 
-#ifdef __APPLE__
-  xpc_transaction_end();
-#endif /* __APPLE__ */
+static http_t *				/* O - HTTP connection or NULL */
+connect_server(void)
+{
+  if (!lpd_http)
+    lpd_http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, 30000, NULL);
 
-  return (status);
+  return (lpd_http);
 }
 
 
@@ -397,6 +390,18 @@ create_job(http_t        *http,		/* I - HTTP connection */
 }
 
 
+/*
+ * 'disconnect_server()' - Close the connection to the scheduler.
+ */
+
+static void
+disconnect_server(void)
+{
+  httpClose(lpd_http);
+  lpd_http = NULL;
+}
+
+
 /*
  * 'get_printer()' - Get the named printer and its options.
  */
@@ -703,14 +708,139 @@ get_printer(http_t        *http,	/* I - HTTP connection */
 }
 
 
+/*
+ * 'parse_control()' - Get the job information and documents from a control
+ *                     file.
+ */
+
+static int				/* O - Number of documents or -1 on error */
+parse_control(
+    const char    *control,		/* I - Control filename */
+    int           num_defaults,		/* I - Number of default options */
+    cups_option_t *defaults,		/* I - Default options */
+    char          *title,		/* O - Job title */
+    size_t        titlesize,		/* I - Size of title buffer */
+    char          *user,		/* O - User name */
+    size_t        usersize,		/* I - Size of user buffer */
+    int           *num_options,		/* IO - Number of options */
+    cups_option_t **options,		/* IO - Options */
+    lpd_doc_t     *docs)		/* O - Documents, LPD_MAX_DOCS in size */
+{
+  FILE		*fp;			/* Control file */
+  char		line[256],		/* Line from file */
+		docname[1024];		/* Document name */
+  const char	*job_sheets;		/* Job sheets */
+  int		num_docs;		/* Number of documents */
+
+
+  if ((fp = fopen(control, "rb")) == NULL)
+    return (-1);
+
+  title[0]   = '\0';
+  user[0]    = '\0';
+  docname[0] = '\0';
+  num_docs   = 0;
+
+  while (smart_gets(line, sizeof(line), fp) != NULL)
+  {
+   /*
+    * Process control lines...
+    */
+
+    switch (line[0])
+    {
+      case 'J' : /* Job name */
+	  smart_strlcpy(title, line + 1, titlesize);
+	  break;
+
+      case 'N' : /* Document name */
+	  smart_strlcpy(docname, line + 1, sizeof(docname));
+	  break;
+
+      case 'P' : /* User identification */
+	  smart_strlcpy(user, line + 1, usersize);
+	  break;
+
+      case 'L' : /* Print banner page */
+	 /*
+	  * If a banner was requested and it's not overridden by a
+	  * command line option and the destination's default is none
+	  * then add the standard banner...
+	  */
+
+	  if (cupsGetOption("job-sheets", num_defaults, defaults) == NULL &&
+	      ((job_sheets = cupsGetOption("job-sheets", *num_options,
+					   *options)) == NULL ||
+	       !strcmp(job_sheets, "none,none")))
+	  {
+	    *num_options = cupsAddOption("job-sheets", "standard",
+					 *num_options, options);
+	  }
+	  break;
+
+      case 'c' : /* Plot CIF file */
+      case 'd' : /* Print DVI file */
+      case 'f' : /* Print formatted file */
+      case 'g' : /* Plot file */
+      case 'l' : /* Print file leaving control characters (raw) */
+      case 'n' : /* Print ditroff output file */
+      case 'o' : /* Print PostScript output file */
+      case 'p' : /* Print file with 'pr' format (prettyprint) */
+      case 'r' : /* File to print with FORTRAN carriage control */
+      case 't' : /* Print troff output file */
+      case 'v' : /* Print raster file */
+	  if (num_docs >= LPD_MAX_DOCS)
+	  {
+	    syslog(LOG_ERR, "Too many documents in control file (%d)", num_docs);
+	    fclose(fp);
+	    return (-1);
+	  }
+
+	  strlcpy(docs[num_docs].data, line + 1, sizeof(docs[0].data));
+	  strlcpy(docs[num_docs].docname, docname, sizeof(docs[0].docname));
+	  num_docs ++;
+
+	  if (line[0] == 'l' &&
+	      !cupsGetOption("document-format", *num_options, *options))
+	    *num_options = cupsAddOption("raw", "", *num_options, options);
+
+	  if (line[0] == 'p')
+	    *num_options = cupsAddOption("prettyprint", "", *num_options,
+					 options);
+	  break;
+    }
+  }
+
+  fclose(fp);
+
+ /*
+  * Check that we have a username...
+  */
+
+  if (!user[0])
+  {
+    syslog(LOG_WARNING, "No username specified by client! "
+			"Using \"anonymous\"...");
+    strlcpy(user, "anonymous", usersize);
+  }
+
+  return (num_docs);
+}
+
+
 /*
  * 'print_file()' - Add a file to the current job.
+ *
+ * When "filename" is NULL, "length" bytes of document data are copied from
+ * the client as they arrive.  A NULL "filename" and zero "length" just closes
+ * the job.
  */
 
 static int				/* O - 0 on success, -1 on failure */
 print_file(http_t     *http,		/* I - HTTP connection */
            int        id,		/* I - Job ID */
-	   const char *filename,	/* I - File to print */
+	   const char *filename,	/* I - File to print or NULL */
+	   size_t     length,		/* I - Length of data from client */
            const char *docname,		/* I - document-name */
 	   const char *user,		/* I - requesting-user-name */
 	   const char *format,		/* I - document-format */
@@ -718,6 +848,9 @@ print_file(http_t     *http,		/* I - HTTP connection */
 {
   ipp_t		*request;		/* IPP request */
   char		uri[HTTP_MAX_URI];	/* Printer URI */
+  http_status_t	status;			/* HTTP status */
+  ssize_t	bytes;			/* Bytes read */
+  char		buffer[32768];		/* Copy buffer */
 
 
  /*
@@ -732,7 +865,7 @@ print_file(http_t     *http,		/* I - HTTP connection */
   ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
                "requesting-user-name", NULL, user);
 
-  if (docname)
+  if (docname && *docname)
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
         	 "document-name", NULL, docname);
 
@@ -748,7 +881,47 @@ print_file(http_t     *http,		/* I - HTTP connection */
 
   snprintf(uri, sizeof(uri), "/jobs/%d", id);
 
-  ippDelete(cupsDoFileRequest(http, request, uri, filename));
+  if (filename || !length)
+  {
+    ippDelete(cupsDoFileRequest(http, request, uri, filename));
+  }
+  else
+  {
+   /*
+    * Copy the document data from the client as it arrives...
+    */
+
+    status = cupsSendRequest(http, request, uri, ippLength(request) + length);
+
+    while (status == HTTP_STATUS_CONTINUE && length > 0)
+    {
+      if ((bytes = (ssize_t)fread(buffer, 1, length > sizeof(buffer) ? sizeof(buffer) : length, stdin)) < 1)
+      {
+	syslog(LOG_ERR, "Error while reading file - %s", strerror(errno));
+	break;
+      }
+
+      length -= (size_t)bytes;
+      status = cupsWriteRequestData(http, buffer, (size_t)bytes);
+    }
+
+    ippDelete(request);
+
+    if (length > 0)
+    {
+     /*
+      * The request is incomplete, so the connection can't be reused...
+      */
+
+      if (status != HTTP_STATUS_CONTINUE)
+        syslog(LOG_ERR, "Unable to send document - %s", httpStatus(status));
+
+      disconnect_server();
+      return (-1);
+    }
+
+    ippDelete(cupsGetResponse(http, uri));
+  }
 
   if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
   {
@@ -757,12 +930,195 @@ print_file(http_t     *http,		/* I - HTTP connection */
     return (-1);
   }
 
-  return (0);
+  return (0);
+}
+
+
+/*
+ * 'process_connection()' - Process the command from an LPD client on
+ *                          stdin/stdout.
+ */
+
+static int				/* O - Command status */
+process_connection(
+    int           num_defaults,		/* I - Number of default options */
+    cups_option_t *defaults,		/* I - Default options */
+    int           hostlookups)		/* I - Do hostname lookups? */
+{
+  int		i;			/* Looping var */
+  int		num_options;		/* Number of options */
+  cups_option_t	*options;		/* Options for this client */
+  char		line[256],		/* Command string */
+		command,		/* Command code */
+		*dest,			/* Pointer to destination */
+		*list,			/* Pointer to list */
+		*agent,			/* Pointer to user */
+		status;			/* Status for client */
+  socklen_t	hostlen;		/* Size of client address */
+  http_addr_t	hostaddr;		/* Address of client */
+  char		hostname[256],		/* Name of client */
+		hostip[256],		/* IP address */
+		*hostfamily;		/* Address family */
+
+
+ /*
+  * Get the address of the client...
+  */
+
+  hostlen = sizeof(hostaddr);
+
+  if (getpeername(0, (struct sockaddr *)&hostaddr, &hostlen))
+  {
+    syslog(LOG_WARNING, "Unable to get client address - %s", strerror(errno));
+    strlcpy(hostname, "unknown", sizeof(hostname));
+  }
+  else
+  {
+    httpAddrString(&hostaddr, hostip, sizeof(hostip));
+
+    if (hostlookups)
+      httpAddrLookup(&hostaddr, hostname, sizeof(hostname));
+    else
+      strlcpy(hostname, hostip, sizeof(hostname));
+
+#ifdef AF_INET6
+    if (hostaddr.addr.sa_family == AF_INET6)
+      hostfamily = "IPv6";
+    else
+#endif /* AF_INET6 */
+    hostfamily = "IPv4";
+
+    syslog(LOG_INFO, "Connection from %s (%s %s)", hostname, hostfamily,
+           hostip);
+  }
+
+  for (i = 0, num_options = 0, options = NULL; i < num_defaults; i ++)
+    num_options = cupsAddOption(defaults[i].name, defaults[i].value,
+                                num_options, &options);
+
+  num_options = cupsAddOption("job-originating-host-name", hostname,
+                              num_options, &options);
+
+ /*
+  * RFC1179 specifies that only 1 daemon command can be received for
+  * every connection.
+  */
+
+  if (smart_gets(line, sizeof(line), stdin) == NULL)
+  {
+   /*
+    * Unable to get command from client!  Send an error status and return.
+    */
+
+    syslog(LOG_ERR, "Unable to get command line from client!");
+    putchar(1);
+
+    cupsFreeOptions(num_options, options);
+
+    return (1);
+  }
+
+ /*
+  * The first byte is the command byte.  After that will be the queue name,
+  * resource list, and/or user name.
+  */
+
+  if ((command = line[0]) == '\0')
+    dest = line;
+  else
+    dest = line + 1;
+
+  if (command == 0x02)
+    list = NULL;
+  else
+  {
+    for (list = dest; *list && !isspace(*list & 255); list ++);
+
+    while (isspace(*list & 255))
+      *list++ = '\0';
+  }
+
+ /*
+  * Do the command...
+  */
+
+  switch (command)
+  {
+    default : /* Unknown command */
+        syslog(LOG_ERR, "Unknown LPD command 0x%02X!", command);
+        syslog(LOG_ERR, "Command line = %s", line + 1);
+	putchar(1);
+
+        status = 1;
+	break;
+
+    case 0x01 : /* Print any waiting jobs */
+        syslog(LOG_INFO, "Print waiting jobs (no-op)");
+	putchar(0);
+
+        status = 0;
+	break;
+
+    case 0x02 : /* Receive a printer job */
+        syslog(LOG_INFO, "Receive print job for %s", dest);
+        /* recv_print_job() sends initial status byte */
+
+        status = (char)recv_print_job(dest, num_options, options);
+	break;
+
+    case 0x03 : /* Send queue state (short) */
+        syslog(LOG_INFO, "Send queue state (short) for %s %s", dest, list);
+	/* no status byte for this command */
+
+        status = (char)send_state(dest, list, 0);
+	break;
+
+    case 0x04 : /* Send queue state (long) */
+        syslog(LOG_INFO, "Send queue state (long) for %s %s", dest, list);
+	/* no status byte for this command */
+
+        status = (char)send_state(dest, list, 1);
+	break;
+
+    case 0x05 : /* Remove jobs */
+        if (list)
+	{
+	 /*
+	  * Grab the agent and skip to the list of users and/or jobs.
+	  */
+
+	  agent = list;
+
+	  for (; *list && !isspace(*list & 255); list ++);
+	  while (isspace(*list & 255))
+	    *list++ = '\0';
+
+	  syslog(LOG_INFO, "Remove jobs %s on %s by %s", list, dest, agent);
+
+	  status = (char)remove_jobs(dest, agent, list);
+        }
+	else
+	  status = 1;
+
+	putchar(status);
+	break;
+  }
+
+  syslog(LOG_INFO, "Closing connection");
+
+  cupsFreeOptions(num_options, options);
+
+  return (status);
 }
 
 
 /*
  * 'recv_print_job()' - Receive a print job from the client.
+ *
+ * The job is created as soon as the control file has been received.  Data
+ * files that arrive after that in document order are copied straight to the
+ * scheduler; anything else is staged in a temporary file until the documents
+ * before it have been sent.
  */
 
 static int				/* O - Command status */
@@ -775,37 +1131,36 @@ recv_print_job(
   int		i;			/* Looping var */
   int		status;			/* Command status */
   int		fd;			/* Temporary file */
-  FILE		*fp;			/* File pointer */
-  char		filename[1024];		/* Temporary filename */
   ssize_t	bytes;			/* Bytes received */
   size_t	total;			/* Total bytes */
   char		line[256],		/* Line from file/stdin */
 		command,		/* Command from line */
 		*count,			/* Number of bytes */
 		*name;			/* Name of file */
-  const char	*job_sheets;		/* Job sheets */
+  char		buffer[8192];		/* Copy buffer */
   int		num_data;		/* Number of data files */
   char		control[1024],		/* Control filename */
-		data[100][256],		/* Data files */
-		temp[100][1024];	/* Temporary files */
+		data[LPD_MAX_DOCS][256],/* Data files */
+		temp[LPD_MAX_DOCS][1024];/* Temporary files */
+  int		stream;			/* Copy data file to the scheduler? */
   char		user[1024],		/* User name */
 		title[1024],		/* Job title */
-		docname[1024],		/* Document name */
 		dest[256];		/* Printer/class queue */
   int		accepting,		/* printer-is-accepting */
 		shared,			/* printer-is-shared */
 		num_options;		/* Number of options */
   cups_option_t	*options;		/* Options */
   int		id;			/* Job ID */
-  int		docnumber,		/* Current document number */
-		doccount;		/* Count of documents */
+  lpd_doc_t	docs[LPD_MAX_DOCS];	/* Documents in control file */
+  int		num_docs,		/* Number of documents */
+		docnumber;		/* Next document to send */
 
 
  /*
   * Connect to the server...
   */
 
-  http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, 30000, NULL);
+  http = connect_server();
   if (!http)
   {
     syslog(LOG_ERR, "Unable to connect to server: %s", strerror(errno));
@@ -830,8 +1185,6 @@ recv_print_job(
     else
       syslog(LOG_ERR, "Unable to get printer information for \"%s\"", queue);
 
-    httpClose(http);
-
     putchar(1);
 
     return (1);
@@ -839,15 +1192,27 @@ recv_print_job(
 
   putchar(0);				/* OK so far... */
 
+ /*
+  * Copy the default options...
+  */
+
+  for (i = 0; i < num_defaults; i ++)
+    num_options = cupsAddOption(defaults[i].name, defaults[i].value,
+				num_options, &options);
+
  /*
   * Read the request...
   */
 
-  status   = 0;
-  num_data = 0;
-  fd       = -1;
+  status    = 0;
+  num_data  = 0;
+  fd        = -1;
+  id        = 0;
+  num_docs  = 0;
+  docnumber = 0;
 
   control[0] = '\0';
+  user[0]    = '\0';
 
   while (smart_gets(line, sizeof(line), stdin) != NULL)
   {
@@ -859,6 +1224,7 @@ recv_print_job(
 
     command = line[0];
     count   = line + 1;
+    stream  = 0;
 
     for (name = count + 1; *name && !isspace(*name & 255); name ++);
     while (isspace(*name & 255))
@@ -910,8 +1276,6 @@ recv_print_job(
 	      status = 1;
 	      break;
 	    }
-
-	    strlcpy(filename, control, sizeof(filename));
 	  }
 	  break;
 
@@ -924,7 +1288,7 @@ recv_print_job(
 	    break;
 	  }
 
-          if (num_data >= (int)(sizeof(data) / sizeof(data[0])))
+          if (num_data >= LPD_MAX_DOCS)
 	  {
 	   /*
 	    * Too many data files...
@@ -937,8 +1301,23 @@ recv_print_job(
 	  }
 
 	  strlcpy(data[num_data], name, sizeof(data[0]));
+	  temp[num_data][0] = '\0';
 
-          if ((fd = cupsTempFd(temp[num_data], sizeof(temp[0]))) < 0)
+         /*
+	  * Copy the data file straight to the scheduler if it is the next
+	  * document and isn't printed again later...
+	  */
+
+          if (id > 0 && docnumber < num_docs && !strcmp(docs[docnumber].data, name))
+          {
+            for (i = docnumber + 1; i < num_docs; i ++)
+              if (!strcmp(docs[i].data, name))
+                break;
+
+            stream = i >= num_docs;
+          }
+
+          if (!stream && (fd = cupsTempFd(temp[num_data], sizeof(temp[0]))) < 0)
 	  {
 	    syslog(LOG_ERR, "Unable to open temporary data file \"%s\" - %s",
         	   temp[num_data], strerror(errno));
@@ -947,8 +1326,6 @@ recv_print_job(
 	    break;
 	  }
 
-	  strlcpy(filename, temp[num_data], sizeof(filename));
-
           num_data ++;
 	  break;
     }
@@ -962,23 +1339,40 @@ recv_print_job(
     * Copy the data or control file from the client...
     */
 
-    for (total = (size_t)strtoll(count, NULL, 10); total > 0; total -= (size_t)bytes)
+    total = (size_t)strtoll(count, NULL, 10);
+
+    if (stream)
     {
-      if (total > sizeof(line))
-        bytes = (ssize_t)sizeof(line);
+      if (print_file(http, id, NULL, total, docs[docnumber].docname, user,
+                     cupsGetOption("document-format", num_options, options),
+		     0))
+        status = 1;
       else
-        bytes = (ssize_t)total;
+        docnumber ++;
+    }
+    else
+    {
+      for (; total > 0; total -= (size_t)bytes)
+      {
+	if (total > sizeof(buffer))
+	  bytes = (ssize_t)sizeof(buffer);
+	else
+	  bytes = (ssize_t)total;
 
-      if ((bytes = (ssize_t)fread(line, 1, (size_t)bytes, stdin)) > 0)
-        bytes = write(fd, line, (size_t)bytes);
+	if ((bytes = (ssize_t)fread(buffer, 1, (size_t)bytes, stdin)) > 0)
+	  bytes = write(fd, buffer, (size_t)bytes);
 
-      if (bytes < 1)
-      {
-	syslog(LOG_ERR, "Error while reading file - %s",
-               strerror(errno));
-        status = 1;
-	break;
+	if (bytes < 1)
+	{
+	  syslog(LOG_ERR, "Error while reading file - %s",
+		 strerror(errno));
+	  status = 1;
+	  break;
+	}
       }
+
+      close(fd);
+      fd = -1;
     }
 
    /*
@@ -1001,213 +1395,84 @@ recv_print_job(
       }
     }
 
-   /*
-    * Close the file and send an acknowledgement...
-    */
-
-    close(fd);
-
-    putchar(status);
-
-    if (status)
-      break;
-  }
-
-  if (!status)
-  {
-   /*
-    * Process the control file and print stuff...
-    */
-
-    if ((fp = fopen(control, "rb")) == NULL)
-      status = 1;
-    else
+    if (!status && command == 0x02)
     {
      /*
-      * Copy the default options...
-      */
-
-      for (i = 0; i < num_defaults; i ++)
-	num_options = cupsAddOption(defaults[i].name,
-		                    defaults[i].value,
-		                    num_options, &options);
-
-     /*
-      * Grab the job information...
+      * Get the documents from the control file and create the job the
+      * first time around...
       */
 
-      title[0]   = '\0';
-      user[0]    = '\0';
-      docname[0] = '\0';
-      doccount   = 0;
-
-      while (smart_gets(line, sizeof(line), fp) != NULL)
+      if ((num_docs = parse_control(control, num_defaults, defaults, title,
+                                    sizeof(title), user, sizeof(user),
+				    &num_options, &options, docs)) < 0)
+        status = 1;
+      else if (!id && (id = create_job(http, dest, title, user, num_options,
+                                       options)) < 0)
       {
-       /*
-        * Process control lines...
-	*/
-
-	switch (line[0])
-	{
-	  case 'J' : /* Job name */
-	      smart_strlcpy(title, line + 1, sizeof(title));
-	      break;
-
-          case 'N' : /* Document name */
-              smart_strlcpy(docname, line + 1, sizeof(docname));
-              break;
-
-	  case 'P' : /* User identification */
-	      smart_strlcpy(user, line + 1, sizeof(user));
-	      break;
-
-	  case 'L' : /* Print banner page */
-	     /*
-	      * If a banner was requested and it's not overridden by a
-	      * command line option and the destination's default is none
-	      * then add the standard banner...
-	      */
-
-	      if (cupsGetOption("job-sheets", num_defaults, defaults) == NULL &&
-        	  ((job_sheets = cupsGetOption("job-sheets", num_options,
-					       options)) == NULL ||
-        	   !strcmp(job_sheets, "none,none")))
-	      {
-		num_options = cupsAddOption("job-sheets", "standard",
-		                	    num_options, &options);
-	      }
-	      break;
-
-	  case 'c' : /* Plot CIF file */
-	  case 'd' : /* Print DVI file */
-	  case 'f' : /* Print formatted file */
-	  case 'g' : /* Plot file */
-	  case 'l' : /* Print file leaving control characters (raw) */
-	  case 'n' : /* Print ditroff output file */
-	  case 'o' : /* Print PostScript output file */
-	  case 'p' : /* Print file with 'pr' format (prettyprint) */
-	  case 'r' : /* File to print with FORTRAN carriage control */
-	  case 't' : /* Print troff output file */
-	  case 'v' : /* Print raster file */
-	      doccount ++;
-
-	      if (line[0] == 'l' &&
-	          !cupsGetOption("document-format", num_options, options))
-		num_options = cupsAddOption("raw", "", num_options, &options);
-
-              if (line[0] == 'p')
-		num_options = cupsAddOption("prettyprint", "", num_options,
-		                	    &options);
-              break;
-	}
-
-	if (status)
-	  break;
+        id     = 0;
+        status = 1;
       }
+    }
 
-     /*
-      * Check that we have a username...
-      */
+   /*
+    * Send any documents whose data files are now complete, in order...
+    */
 
-      if (!user[0])
-      {
-	syslog(LOG_WARNING, "No username specified by client! "
-		            "Using \"anonymous\"...");
-	strlcpy(user, "anonymous", sizeof(user));
-      }
+    while (!status && id > 0 && docnumber < num_docs)
+    {
+      for (i = 0; i < num_data; i ++)
+        if (temp[i][0] && !strcmp(data[i], docs[docnumber].data))
+	  break;
 
-     /*
-      * Create the job...
-      */
+      if (i >= num_data)
+        break;
 
-      if ((id = create_job(http, dest, title, user, num_options, options)) < 0)
+      if (print_file(http, id, temp[i], 0, docs[docnumber].docname, user,
+		     cupsGetOption("document-format", num_options, options),
+		     0))
         status = 1;
       else
-      {
-       /*
-	* Then print the job files...
-	*/
-
-	rewind(fp);
-
-	docname[0] = '\0';
-	docnumber  = 0;
-
-	while (smart_gets(line, sizeof(line), fp) != NULL)
-	{
-	 /*
-          * Process control lines...
-	  */
-
-	  switch (line[0])
-	  {
-	    case 'N' : /* Document name */
-		smart_strlcpy(docname, line + 1, sizeof(docname));
-		break;
-
-	    case 'c' : /* Plot CIF file */
-	    case 'd' : /* Print DVI file */
-	    case 'f' : /* Print formatted file */
-	    case 'g' : /* Plot file */
-	    case 'l' : /* Print file leaving control characters (raw) */
-	    case 'n' : /* Print ditroff output file */
-	    case 'o' : /* Print PostScript output file */
-	    case 'p' : /* Print file with 'pr' format (prettyprint) */
-	    case 'r' : /* File to print with FORTRAN carriage control */
-	    case 't' : /* Print troff output file */
-	    case 'v' : /* Print raster file */
-               /*
-		* Figure out which file we are printing...
-		*/
-
-		for (i = 0; i < num_data; i ++)
-	          if (!strcmp(data[i], line + 1))
-		    break;
-
-        	if (i >= num_data)
-		{
-	          status = 1;
-		  break;
-		}
-
-               /*
-		* Send the print file...
-		*/
+        docnumber ++;
+    }
 
-        	docnumber ++;
+   /*
+    * Send an acknowledgement...
+    */
 
-        	if (print_file(http, id, temp[i], docname, user,
-		               cupsGetOption("document-format", num_options,
-			                     options),
-	                       docnumber == doccount))
-                  status = 1;
-		else
-	          status = 0;
+    putchar(status);
 
-		break;
-	  }
+    if (status)
+      break;
+  }
 
-	  if (status)
-	    break;
-	}
-      }
+  if (!status)
+  {
+   /*
+    * Make sure we got a control file and every document in it, then close
+    * the job...
+    */
 
-      fclose(fp);
-    }
+    if (!id || !num_docs || docnumber < num_docs)
+      status = 1;
+    else if (print_file(http, id, NULL, 0, NULL, user, NULL, 1))
+      status = 1;
   }
 
-  cupsFreeOptions(num_options, options);
+  if (status && id > 0 && (http = connect_server()) != NULL)
+    cancel_job(http, id, user);
 
-  httpClose(http);
+  cupsFreeOptions(num_options, options);
 
  /*
   * Clean up all temporary files and return...
   */
 
-  unlink(control);
+  if (control[0])
+    unlink(control);
 
   for (i = 0; i < num_data; i ++)
-    unlink(temp[i]);
+    if (temp[i][0])
+      unlink(temp[i]);
 
   return (status);
 }
@@ -1234,7 +1499,7 @@ remove_jobs(const char *dest,		/* I - Destination */
   * Try connecting to the local server...
   */
 
-  if ((http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, 30000, NULL)) == NULL)
+  if ((http = connect_server()) == NULL)
   {
     syslog(LOG_ERR, "Unable to connect to server %s: %s", cupsServer(),
            strerror(errno));
@@ -1284,14 +1549,262 @@ remove_jobs(const char *dest,		/* I - Destination */
     {
       syslog(LOG_WARNING, "Cancel of job ID %d failed: %s\n", id,
              cupsLastErrorString());
-      httpClose(http);
       return (1);
     }
     else
       syslog(LOG_INFO, "Job ID %d canceled", id);
   }
 
-  httpClose(http);
+  return (0);
+}
+
+
+/*
+ * 'run_daemon()' - Listen for LPD clients and process them with a pool of
+ *                  worker processes.
+ */
+
+static int				/* O - Exit status */
+run_daemon(
+    const char    *address,		/* I - "[address:]port" to listen on */
+    int           workers,		/* I - Number of worker processes */
+    int           num_defaults,		/* I - Number of default options */
+    cups_option_t *defaults,		/* I - Default options */
+    int           hostlookups)		/* I - Do hostname lookups? */
+{
+  int			i;		/* Looping var */
+  char			host[256],	/* Host portion of address */
+			*hostptr,	/* Pointer to host */
+			*port;		/* Port number */
+  http_addrlist_t	*addrlist,	/* List of listen addresses */
+			*addr;		/* Current address */
+  struct pollfd		pfds[LPD_MAX_LISTEN];
+					/* Listening sockets */
+  int			num_pfds;	/* Number of listening sockets */
+  pid_t			*pids,		/* Worker process IDs */
+			pid;		/* Current process ID */
+  int			client;		/* Client socket */
+  int			wstatus;	/* Worker exit status */
+  struct sigaction	action;		/* POSIX signal action */
+
+
+ /*
+  * Split "[address:]port" into its parts...
+  */
+
+  strlcpy(host, address, sizeof(host));
+
+  if ((port = strrchr(host, ':')) != NULL && !strchr(port, ']'))
+  {
+    *port++ = '\0';
+    hostptr = host;
+
+    if (*hostptr == '[' && hostptr[strlen(hostptr) - 1] == ']')
+    {
+      hostptr ++;
+      hostptr[strlen(hostptr) - 1] = '\0';
+    }
+
+    if (!strcmp(hostptr, "*"))
+      hostptr = NULL;
+  }
+  else
+  {
+    port    = host;
+    hostptr = NULL;
+  }
+
+  if ((addrlist = httpAddrGetList(hostptr, AF_UNSPEC, port)) == NULL)
+  {
+    syslog(LOG_ERR, "Unable to lookup listen address \"%s\" - %s", address,
+           cupsLastErrorString());
+    return (1);
+  }
+
+  for (addr = addrlist, num_pfds = 0; addr && num_pfds < LPD_MAX_LISTEN; addr = addr->next)
+  {
+    if ((pfds[num_pfds].fd = httpAddrListen(&(addr->addr), httpAddrPort(&(addr->addr)))) < 0)
+    {
+      char	temp[256];		/* Address string */
+
+      syslog(LOG_ERR, "Unable to listen on %s:%d - %s",
+             httpAddrString(&(addr->addr), temp, sizeof(temp)),
+	     httpAddrPort(&(addr->addr)), strerror(errno));
+      continue;
+    }
+
+   /*
+    * Allow for bursts of clients and use non-blocking sockets since all of
+    * the workers wait on them...
+    */
+
+    listen(pfds[num_pfds].fd, 128);
+
+    fcntl(pfds[num_pfds].fd, F_SETFL, fcntl(pfds[num_pfds].fd, F_GETFL) | O_NONBLOCK);
+
+    pfds[num_pfds].events = POLLIN;
+    num_pfds ++;
+  }
+
+  httpAddrFreeList(addrlist);
+
+  if (num_pfds == 0)
+    return (1);
+
+ /*
+  * Stop running as root now that the (privileged) listening sockets are
+  * open, before any client data is processed...
+  */
+
+  if (!getuid())
+  {
+    struct passwd	*pw;		/* User info */
+
+    if ((pw = getpwnam(CUPS_DEFAULT_USER)) == NULL)
+    {
+      syslog(LOG_ERR, "Unable to find user \"%s\".", CUPS_DEFAULT_USER);
+      return (1);
+    }
+
+    if (setgid(pw->pw_gid) || initgroups(pw->pw_name, pw->pw_gid) || setuid(pw->pw_uid))
+    {
+      syslog(LOG_ERR, "Unable to switch to user \"%s\" - %s", pw->pw_name, strerror(errno));
+      return (1);
+    }
+  }
+
+  syslog(LOG_INFO, "Listening on %s with %d workers.", address, workers);
+
+ /*
+  * Catch SIGTERM so that the workers can be stopped...
+  */
+
+  memset(&action, 0, sizeof(action));
+
+  sigemptyset(&action.sa_mask);
+  action.sa_handler = sigterm_handler;
+  sigaction(SIGTERM, &action, NULL);
+
+  if ((pids = calloc((size_t)workers, sizeof(pid_t))) == NULL)
+    return (1);
+
+  while (!lpd_terminate)
+  {
+   /*
+    * Start any missing workers...
+    */
+
+    for (i = 0; i < workers; i ++)
+    {
+      if (pids[i] > 0)
+        continue;
+
+      if ((pid = fork()) < 0)
+      {
+        syslog(LOG_ERR, "Unable to start worker - %s", strerror(errno));
+	break;
+      }
+      else if (pid > 0)
+      {
+        pids[i] = pid;
+        continue;
+      }
+
+     /*
+      * Child comes here, process clients until we are terminated.  Input is
+      * not buffered so that nothing carries over from one client to the
+      * next...
+      */
+
+      action.sa_handler = SIG_DFL;
+      sigaction(SIGTERM, &action, NULL);
+
+      action.sa_handler = SIG_IGN;
+      sigaction(SIGPIPE, &action, NULL);
+
+      setbuf(stdin, NULL);
+
+      for (;;)
+      {
+        if (poll(pfds, (nfds_t)num_pfds, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+
+          syslog(LOG_ERR, "Unable to wait for clients - %s", strerror(errno));
+	  exit(1);
+	}
+
+        for (i = 0; i < num_pfds; i ++)
+	{
+	  if (!(pfds[i].revents & POLLIN))
+	    continue;
+
+          if ((client = accept(pfds[i].fd, NULL, NULL)) < 0)
+	    continue;			/* Another worker got it */
+
+          fcntl(client, F_SETFL, fcntl(client, F_GETFL) & ~O_NONBLOCK);
+
+          if (client != 0)
+	    dup2(client, 0);
+	  if (client != 1)
+	    dup2(client, 1);
+	  if (client > 1)
+	    close(client);
+
+	  clearerr(stdin);
+	  clearerr(stdout);
+
+          process_connection(num_defaults, defaults, hostlookups);
+          disconnect_server();
+
+          close(0);
+	  close(1);
+	}
+      }
+    }
+
+   /*
+    * Wait for a worker to exit...
+    */
+
+    if ((pid = wait(&wstatus)) < 0)
+    {
+      if (errno != EINTR)
+        break;
+      continue;
+    }
+
+    for (i = 0; i < workers; i ++)
+      if (pids[i] == pid)
+      {
+        pids[i] = 0;
+	break;
+      }
+
+    if (!lpd_terminate)
+    {
+      syslog(LOG_WARNING, "Worker %d exited with status %d, restarting.", (int)pid, wstatus);
+      sleep(1);
+    }
+  }
+
+ /*
+  * Stop the workers...
+  */
+
+  for (i = 0; i < workers; i ++)
+    if (pids[i] > 0)
+      kill(pids[i], SIGTERM);
+
+  while (wait(NULL) > 0 || errno == EINTR);
+
+  free(pids);
+
+  for (i = 0; i < num_pfds; i ++)
+    close(pfds[i].fd);
+
+  syslog(LOG_INFO, "Shutting down.");
 
   return (0);
 }
@@ -1354,7 +1867,7 @@ send_state(const char *queue,		/* I - Destination */
   * Try connecting to the local server...
   */
 
-  if ((http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, 30000, NULL)) == NULL)
+  if ((http = connect_server()) == NULL)
   {
     syslog(LOG_ERR, "Unable to connect to server %s: %s", cupsServer(),
            strerror(errno));
@@ -1555,12 +2068,23 @@ send_state(const char *queue,		/* I - Destination */
   if (jobcount == 0)
     puts("no entries");
 
-  httpClose(http);
-
   return (0);
 }
 
 
+/*
+ * 'sigterm_handler()' - Handle SIGTERM by stopping the daemon.
+ */
+
+static void
+sigterm_handler(int sig)		/* I - Signal */
+{
+  (void)sig;
+
+  lpd_terminate = 1;
+}
+
+
 /*
  * 'smart_gets()' - Get a line of text, removing the trailing CR and/or LF.
  */
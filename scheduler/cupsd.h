@@ -26,6 +26,7 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 
 #ifdef _WIN32
 #  include <direct.h>
@@ -104,6 +105,8 @@ extern const char *cups_hstrerror(int);
  */
 
 #include "sysman.h"
+#include "slab.h"
+#include "metrics.h"
 #include "statbuf.h"
 #include "cert.h"
 #include "auth.h"
@@ -120,6 +123,22 @@ extern const char *cups_hstrerror(int);
 #include "subscriptions.h"
 
 
+/*
+ * Static tracing probes, compiled out unless configured with --enable-probes...
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#  include <sys/sdt.h>
+#  define CUPSD_PROBE1(name,a)		DTRACE_PROBE1(cupsd, name, a)
+#  define CUPSD_PROBE2(name,a,b)	DTRACE_PROBE2(cupsd, name, a, b)
+#  define CUPSD_PROBE3(name,a,b,c)	DTRACE_PROBE3(cupsd, name, a, b, c)
+#else
+#  define CUPSD_PROBE1(name,a)
+#  define CUPSD_PROBE2(name,a,b)
+#  define CUPSD_PROBE3(name,a,b,c)
+#endif /* HAVE_SYS_SDT_H */
+
+
 /*
  * Reload types...
  */
@@ -127,6 +146,7 @@ extern const char *cups_hstrerror(int);
 #define RELOAD_NONE	0		/* No reload needed */
 #define RELOAD_ALL	1		/* Reload everything */
 #define RELOAD_CUPSD	2		/* Reload only cupsd.conf */
+#define RELOAD_SIGNAL	3		/* Reload after SIGHUP, full or partial */
 
 
 /*
@@ -177,9 +197,14 @@ extern int		cupsdCloseCreatedConfFile(cups_file_t *fp,
 			                          const char *filename);
 extern void		cupsdClosePipe(int *fds);
 extern cups_file_t	*cupsdCreateConfFile(const char *filename, mode_t mode);
+extern void		cupsdFinishConfBatch(void);
+extern void		cupsdFinishPurge(void);
 extern cups_file_t	*cupsdOpenConfFile(const char *filename);
 extern int		cupsdOpenPipe(int *fds);
+extern void		cupsdPurgeFile(const char *filename);
 extern int		cupsdRemoveFile(const char *filename);
+extern void		cupsdStartConfBatch(void);
+extern int		cupsdSyncFile(cups_file_t *fp, const char *filename);
 extern int		cupsdUnlinkOrRemoveFile(const char *filename);
 
 /* main.c */
@@ -187,6 +212,7 @@ extern int		cupsdAddString(cups_array_t **a, const char *s);
 extern void		cupsdCheckProcess(void);
 extern void		cupsdClearString(char **s);
 extern void		cupsdFreeStrings(cups_array_t **a);
+extern void		cupsdHandoffFD(int fd);
 extern void		cupsdHoldSignals(void);
 extern char		*cupsdMakeUUID(const char *name, int number,
 				       char *buffer, size_t bufsize);
@@ -196,10 +222,12 @@ extern void		cupsdSetStringf(char **s, const char *f, ...)
 			__attribute__ ((__format__ (__printf__, 2, 3)));
 
 /* process.c */
+extern void		cupsdAdoptProcess(int pid, int job_id, const char *name);
 extern void		*cupsdCreateProfile(int job_id, int allow_networking);
 extern void		cupsdDestroyProfile(void *profile);
 extern int		cupsdEndProcess(int pid, int force);
 extern const char	*cupsdFinishProcess(int pid, char *name, size_t namelen, int *job_id);
+extern void		cupsdHandoffProcesses(cups_file_t *fp);
 extern int		cupsdStartProcess(const char *command, char *argv[],
 					  char *envp[], int infd, int outfd,
 					  int errfd, int backfd, int sidefd,
@@ -210,6 +238,7 @@ extern int		cupsdStartProcess(const char *command, char *argv[],
 extern int		cupsdAddSelect(int fd, cupsd_selfunc_t read_cb,
 			               cupsd_selfunc_t write_cb, void *data);
 extern int		cupsdDoSelect(long timeout);
+extern int		cupsdGetSelectCount(void);
 #ifdef CUPSD_IS_SELECTING
 extern int		cupsdIsSelecting(int fd);
 #endif /* CUPSD_IS_SELECTING */
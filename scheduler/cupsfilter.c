@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #if defined(__APPLE__)
 #  include <libgen.h>
@@ -103,7 +104,10 @@ main(int  argc,				/* I - Number of command-line args */
   int		compression;		/* Compression of file */
   int		cost;			/* Cost of filters */
   mime_t	*mime;			/* MIME database */
-  char		mimedir[1024];		/* MIME directory */
+  char		mimedir[1024],		/* MIME directory */
+		mimepath[2048],		/* MIME directories to load */
+		mimecache[1024];	/* Compiled MIME database */
+  _cups_globals_t *cg = _cupsGlobals();	/* Global data */
   char		*infile,		/* File to filter */
 		*outfile;		/* File to create */
   char		cupsfilesconf[1024];	/* cups-files.conf file */
@@ -365,11 +369,25 @@ main(int  argc,				/* I - Number of command-line args */
     return (1);
 
   snprintf(mimedir, sizeof(mimedir), "%s/mime", DataDir);
+  snprintf(mimepath, sizeof(mimepath), "%s:%s", mimedir, ServerRoot);
 
-  mime = mimeLoadTypes(NULL, mimedir);
-  mime = mimeLoadTypes(mime, ServerRoot);
-  mime = mimeLoadFilters(mime, mimedir, Path);
-  mime = mimeLoadFilters(mime, ServerRoot, Path);
+ /*
+  * Keep a compiled copy of the MIME database in ~/.cups so that later runs
+  * don't have to parse the .types and .convs files again...
+  */
+
+  if (cg->home)
+  {
+    snprintf(mimecache, sizeof(mimecache), "%s/.cups", cg->home);
+    if (access(mimecache, 0))
+      mkdir(mimecache, 0700);
+
+    snprintf(mimecache, sizeof(mimecache), "%s/.cups/mime.cache", cg->home);
+  }
+  else
+    mimecache[0] = '\0';
+
+  mime = mimeLoadCached(NULL, mimecache[0] ? mimecache : NULL, mimepath, Path);
 
   if (!mime)
   {
@@ -22,6 +22,15 @@
 #endif /* HAVE_DNSSD && __APPLE__ */
 
 
+/*
+ * Local constants...
+ */
+
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+#  define DNSSD_BATCH_SIZE	50	/* Printers to register per second */
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
+
+
 /*
  * Local globals...
  */
@@ -29,6 +38,12 @@
 #ifdef HAVE_AVAHI
 static int	avahi_running = 0;
 #endif /* HAVE_AVAHI */
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+static cups_array_t	*dnssd_pending = NULL;
+					/* Printers waiting to be registered */
+static _cups_mutex_t	dnssd_pending_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for pending printers */
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
 
 
 /*
@@ -55,11 +70,13 @@ static cupsd_txt_t	dnssdBuildTxtRecord(cupsd_printer_t *p, int for_lpd);
 #  ifdef HAVE_AVAHI
 static void		dnssdClientCallback(AvahiClient *c, AvahiClientState state, void *userdata);
 #  endif /* HAVE_AVAHI */
+static char		*dnssdCopyTxtRecord(cupsd_txt_t *txt, size_t *datalen);
 static void		dnssdDeregisterAllPrinters(int from_callback);
 static void		dnssdDeregisterInstance(cupsd_srv_t *srv, int from_callback);
 static void		dnssdDeregisterPrinter(cupsd_printer_t *p, int clear_name, int from_callback);
 static const char	*dnssdErrorString(int error);
 static void		dnssdFreeTxtRecord(cupsd_txt_t *txt);
+static void		dnssdQueuePrinter(cupsd_printer_t *p);
 static void		dnssdRegisterAllPrinters(int from_callback);
 #  ifdef HAVE_DNSSD
 static void		dnssdRegisterCallback(DNSServiceRef sdRef,
@@ -103,6 +120,20 @@ cupsdDeregisterPrinter(
                   "cupsdDeregisterPrinter(p=%p(%s), removeit=%d)", p, p->name,
 		  removeit);
 
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+ /*
+  * Drop any pending registration for a printer that is going away...
+  */
+
+  if (removeit && p->reg_pending)
+  {
+    _cupsMutexLock(&dnssd_pending_mutex);
+    cupsArrayRemove(dnssd_pending, p);
+    p->reg_pending = 0;
+    _cupsMutexUnlock(&dnssd_pending_mutex);
+  }
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
+
   if (!Browsing || !p->shared ||
       (p->type & (CUPS_PRINTER_REMOTE | CUPS_PRINTER_SCANNER)))
     return;
@@ -118,6 +149,62 @@ cupsdDeregisterPrinter(
 }
 
 
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+/*
+ * 'cupsdRegisterPendingPrinters()' - Register the next batch of pending
+ *                                    printers with DNS-SD.
+ */
+
+void
+cupsdRegisterPendingPrinters(void)
+{
+  int			count;		/* Number of printers registered */
+  cupsd_printer_t	*p;		/* Current printer */
+
+
+  for (count = 0; count < DNSSD_BATCH_SIZE; count ++)
+  {
+   /*
+    * Pull the next printer off the queue; registration is done without the
+    * lock to avoid lock-order problems with the Avahi poll thread...
+    */
+
+    _cupsMutexLock(&dnssd_pending_mutex);
+
+    if ((p = (cupsd_printer_t *)cupsArrayFirst(dnssd_pending)) != NULL)
+    {
+      cupsArrayRemove(dnssd_pending, p);
+      p->reg_pending = 0;
+    }
+
+    _cupsMutexUnlock(&dnssd_pending_mutex);
+
+    if (!p)
+      break;
+
+    if ((BrowseLocalProtocols & BROWSE_DNSSD) && DNSSDMaster)
+      dnssdRegisterPrinter(p, 0);
+  }
+
+ /*
+  * Schedule the next batch, if any...
+  */
+
+  _cupsMutexLock(&dnssd_pending_mutex);
+
+  if (cupsArrayCount(dnssd_pending) > 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "%d printers waiting for DNS-SD registration.", cupsArrayCount(dnssd_pending));
+    DNSSDRegisterTime = time(NULL) + 1;
+  }
+  else
+    DNSSDRegisterTime = 0;
+
+  _cupsMutexUnlock(&dnssd_pending_mutex);
+}
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
+
+
 /*
  * 'cupsdRegisterPrinter()' - Start sending broadcast information for a
  *                            printer or update the broadcast contents.
@@ -135,7 +222,7 @@ cupsdRegisterPrinter(cupsd_printer_t *p)/* I - Printer */
 
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
   if ((BrowseLocalProtocols & BROWSE_DNSSD) && DNSSDMaster)
-    dnssdRegisterPrinter(p, 0);
+    dnssdQueuePrinter(p);
 #endif /* HAVE_DNSSD || HAVE_AVAHI */
 }
 
@@ -656,6 +743,34 @@ dnssdClientCallback(
 #  endif /* HAVE_AVAHI */
 
 
+/*
+ * 'dnssdCopyTxtRecord()' - Copy the wire-format data of a TXT record.
+ */
+
+static char *				/* O - TXT record data or NULL */
+dnssdCopyTxtRecord(cupsd_txt_t *txt,	/* I - TXT record */
+                   size_t      *datalen)/* O - Length of data */
+{
+  char	*data;				/* TXT record data */
+
+
+#  ifdef HAVE_DNSSD
+  *datalen = TXTRecordGetLength(txt);
+
+  if ((data = malloc(*datalen + 1)) != NULL)
+    memcpy(data, TXTRecordGetBytesPtr(txt), *datalen);
+
+#  else /* HAVE_AVAHI */
+  *datalen = avahi_string_list_serialize(*txt, NULL, 0);
+
+  if ((data = malloc(*datalen + 1)) != NULL)
+    *datalen = avahi_string_list_serialize(*txt, data, *datalen);
+#  endif /* HAVE_DNSSD */
+
+  return (data);
+}
+
+
 /*
  * 'dnssdDeregisterAllPrinters()' - Deregister all printers.
  */
@@ -747,6 +862,17 @@ dnssdDeregisterPrinter(
 
   cupsArrayRemove(DNSSDPrinters, p);
 
+ /*
+  * Forget the registered TXT record...
+  */
+
+  if (p->reg_txt)
+  {
+    free(p->reg_txt);
+    p->reg_txt    = NULL;
+    p->reg_txtlen = 0;
+  }
+
  /*
   * Optionally clear the service name...
   */
@@ -887,6 +1013,31 @@ dnssdFreeTxtRecord(cupsd_txt_t *txt)	/* I - TXT record */
 }
 
 
+/*
+ * 'dnssdQueuePrinter()' - Queue a printer for DNS-SD registration.
+ */
+
+static void
+dnssdQueuePrinter(cupsd_printer_t *p)	/* I - Printer */
+{
+  _cupsMutexLock(&dnssd_pending_mutex);
+
+  if (!p->reg_pending)
+  {
+    if (!dnssd_pending)
+      dnssd_pending = cupsArrayNew(NULL, NULL);
+
+    if (cupsArrayAdd(dnssd_pending, p))
+      p->reg_pending = 1;
+  }
+
+  if (!DNSSDRegisterTime)
+    DNSSDRegisterTime = time(NULL);
+
+  _cupsMutexUnlock(&dnssd_pending_mutex);
+}
+
+
 /*
  * 'dnssdRegisterAllPrinters()' - Register all printers.
  */
@@ -904,7 +1055,17 @@ dnssdRegisterAllPrinters(int from_callback)	/* I - Called from callback? */
        p;
        p = (cupsd_printer_t *)cupsArrayNext(Printers))
     if (!(p->type & (CUPS_PRINTER_REMOTE | CUPS_PRINTER_SCANNER)))
-      dnssdRegisterPrinter(p, from_callback);
+    {
+     /*
+      * Registrations from the Avahi callback happen on the Avahi thread, the
+      * rest are throttled through the pending queue...
+      */
+
+      if (from_callback)
+        dnssdRegisterPrinter(p, from_callback);
+      else
+        dnssdQueuePrinter(p);
+    }
 }
 
 
@@ -1184,6 +1345,8 @@ dnssdRegisterPrinter(
   int		status;			/* Registration status */
   cupsd_txt_t	ipp_txt,		/* IPP(S) TXT record */
  		printer_txt;		/* LPD TXT record */
+  char		*txtdata;		/* IPP TXT record data */
+  size_t	txtlen;			/* Length of IPP TXT record data */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "dnssdRegisterPrinter(%s) %s", p->name,
@@ -1199,10 +1362,11 @@ dnssdRegisterPrinter(
   * per-printer sharing was just disabled...
   */
 
-  dnssdDeregisterPrinter(p, 0, from_callback);
-
   if (!p->shared)
+  {
+    dnssdDeregisterPrinter(p, 0, from_callback);
     return;
+  }
 
  /*
   * Set the registered name as needed; the registered name takes the form of
@@ -1234,7 +1398,24 @@ dnssdRegisterPrinter(
   * to share via LPD...
   */
 
-  ipp_txt     = dnssdBuildTxtRecord(p, 0);
+  ipp_txt = dnssdBuildTxtRecord(p, 0);
+  txtdata = dnssdCopyTxtRecord(&ipp_txt, &txtlen);
+
+  if (p->ipp_srv && p->reg_txt && txtdata && txtlen == p->reg_txtlen && !memcmp(txtdata, p->reg_txt, txtlen))
+  {
+   /*
+    * Nothing has changed since the last registration...
+    */
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "dnssdRegisterPrinter(%s) TXT record unchanged", p->name);
+
+    dnssdFreeTxtRecord(&ipp_txt);
+    free(txtdata);
+    return;
+  }
+
+  dnssdDeregisterPrinter(p, 0, from_callback);
+
   printer_txt = dnssdBuildTxtRecord(p, 1);
 
   if (BrowseLocalProtocols & BROWSE_LPD)
@@ -1273,6 +1454,9 @@ dnssdRegisterPrinter(
 
     cupsdSetString(&p->reg_name, name);
     cupsArrayAdd(DNSSDPrinters, p);
+
+    p->reg_txt    = txtdata;
+    p->reg_txtlen = txtlen;
   }
   else
   {
@@ -1280,6 +1464,8 @@ dnssdRegisterPrinter(
     * Registration failed for this printer...
     */
 
+    free(txtdata);
+
     dnssdDeregisterInstance(&p->ipp_srv, from_callback);
 
 #  ifdef HAVE_DNSSD
@@ -1343,6 +1529,23 @@ dnssdStop(void)
   cupsArrayDelete(DNSSDPrinters);
   DNSSDPrinters = NULL;
 
+ /*
+  * Drop any pending registrations...
+  */
+
+  _cupsMutexLock(&dnssd_pending_mutex);
+
+  for (p = (cupsd_printer_t *)cupsArrayFirst(dnssd_pending);
+       p;
+       p = (cupsd_printer_t *)cupsArrayNext(dnssd_pending))
+    p->reg_pending = 0;
+
+  cupsArrayDelete(dnssd_pending);
+  dnssd_pending     = NULL;
+  DNSSDRegisterTime = 0;
+
+  _cupsMutexUnlock(&dnssd_pending_mutex);
+
   DNSSDPort = 0;
 }
 
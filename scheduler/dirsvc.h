@@ -41,6 +41,8 @@ VAR int			DNSSDPort	VALUE(0);
 					/* Port number to register */
 VAR cups_array_t	*DNSSDPrinters	VALUE(NULL);
 					/* Printers we have registered */
+VAR time_t		DNSSDRegisterTime VALUE(0);
+					/* Time to register pending printers */
 #  ifdef HAVE_DNSSD
 VAR DNSServiceRef	DNSSDMaster	VALUE(NULL);
 					/* Master DNS-SD service reference */
@@ -69,5 +71,6 @@ extern void	cupsdRegisterPrinter(cupsd_printer_t *p);
 extern void	cupsdStartBrowsing(void);
 extern void	cupsdStopBrowsing(void);
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+extern void	cupsdRegisterPendingPrinters(void);
 extern void	cupsdUpdateDNSSDName(void);
 #endif /* HAVE_DNSSD || HAVE_AVAHI */
@@ -17,10 +17,42 @@
 #include <fnmatch.h>
 #ifdef HAVE_REMOVEFILE
 #  include <removefile.h>
-#else
+#endif /* HAVE_REMOVEFILE */
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*purge_queue = NULL;
+					/* Files waiting to be removed */
+static int		purge_busy = 0;	/* Is a file being removed? */
+static _cups_mutex_t	purge_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for purge queue */
+static _cups_cond_t	purge_cond = _CUPS_COND_INITIALIZER;
+					/* Condition for purge queue changes */
+static int		sync_batch = 0;	/* Is a group commit in progress? */
+static cups_array_t	*sync_files = NULL,
+					/* Files to sync at end of batch */
+			*sync_renames = NULL;
+					/* Files to move into place at end of batch */
+
+
+/*
+ * Local functions...
+ */
+
+static void	add_sync_dir(cups_array_t *dirs, const char *filename);
+static char	*file_dir(const char *filename, char *dir, size_t dirsize);
+static int	finalize_conf_file(const char *filename);
+#ifndef HAVE_REMOVEFILE
 static int	overwrite_data(int fd, const char *buffer, int bufsize,
 		               int filesize);
-#endif /* HAVE_REMOVEFILE */
+#endif /* !HAVE_REMOVEFILE */
+static void	*purge_files(void *data);
+static int	remove_file(const char *filename);
+static int	sync_dir(const char *filename);
+static int	sync_path(const char *path);
 
 
 /*
@@ -85,9 +117,30 @@ cupsdCloseCreatedConfFile(
     cups_file_t *fp,			/* I - File to close */
     const char  *filename)		/* I - Filename */
 {
-  char	newfile[1024],			/* filename.N */
-	oldfile[1024];			/* filename.O */
+ /*
+  * When a group commit is in progress, just close the file and move it into
+  * place from cupsdFinishConfBatch()...
+  */
+
+  if (SyncOnClose == CUPSD_SYNC_BATCH && sync_batch)
+  {
+    if (cupsFileClose(fp))
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write changes to \"%s\": %s",
+		      filename, strerror(errno));
+      return (-1);
+    }
+
+    if (!sync_renames)
+      sync_renames = cupsArrayNew3((cups_array_func_t)strcmp, NULL, NULL, 0,
+                                   (cups_acopy_func_t)strdup,
+				   (cups_afree_func_t)free);
 
+    if (!cupsArrayFind(sync_renames, (void *)filename))
+      cupsArrayAdd(sync_renames, (void *)filename);
+
+    return (0);
+  }
 
  /*
   * Synchronize changes to disk if SyncOnClose is enabled.
@@ -120,21 +173,15 @@ cupsdCloseCreatedConfFile(
     return (-1);
 
  /*
-  * Then remove "filename.O", rename "filename" to "filename.O", and rename
-  * "filename.N" to "filename".
+  * Then move it into place, syncing the directory for the "Full" and (outside
+  * of a group commit) "Batch" levels...
   */
 
-  snprintf(newfile, sizeof(newfile), "%s.N", filename);
-  snprintf(oldfile, sizeof(oldfile), "%s.O", filename);
-
-  if ((cupsdUnlinkOrRemoveFile(oldfile) && errno != ENOENT) ||
-      (rename(filename, oldfile) && errno != ENOENT) ||
-      rename(newfile, filename))
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to finalize \"%s\": %s",
-                    filename, strerror(errno));
+  if (finalize_conf_file(filename))
     return (-1);
-  }
+
+  if (SyncOnClose >= CUPSD_SYNC_BATCH)
+    sync_dir(filename);
 
   return (0);
 }
@@ -200,6 +247,152 @@ cupsdCreateConfFile(
 }
 
 
+/*
+ * 'cupsdFinishConfBatch()' - Commit the files written since
+ *                            cupsdStartConfBatch().
+ *
+ * The data for all of the files is flushed first, then each file is moved
+ * into place, and finally each directory is synchronized once.
+ */
+
+void
+cupsdFinishConfBatch(void)
+{
+  cups_array_t	*dirs;			/* Directories to sync */
+  const char	*filename;		/* Current file */
+  int		num_files;		/* Number of files */
+#ifdef __linux
+  int		fd;			/* Directory file descriptor */
+  struct stat	dirinfo;		/* Directory information */
+  dev_t		*devs;			/* Filesystems already synced */
+  int		i,			/* Looping var */
+		num_devs;		/* Number of filesystems synced */
+#else
+  char		newfile[1024];		/* filename.N */
+#endif /* __linux */
+
+
+  if (!sync_batch)
+    return;
+
+  sync_batch = 0;
+
+  if ((num_files = cupsArrayCount(sync_files) + cupsArrayCount(sync_renames)) == 0)
+    return;
+
+ /*
+  * Collect the directories involved...
+  */
+
+  dirs = cupsArrayNew3((cups_array_func_t)strcmp, NULL, NULL, 0,
+                       (cups_acopy_func_t)strdup, (cups_afree_func_t)free);
+
+  for (filename = (const char *)cupsArrayFirst(sync_files);
+       filename;
+       filename = (const char *)cupsArrayNext(sync_files))
+    add_sync_dir(dirs, filename);
+
+  for (filename = (const char *)cupsArrayFirst(sync_renames);
+       filename;
+       filename = (const char *)cupsArrayNext(sync_renames))
+    add_sync_dir(dirs, filename);
+
+ /*
+  * Flush the file data to disk.  On Linux a single syncfs() per filesystem
+  * covers every file, elsewhere each file gets its own fsync()...
+  */
+
+#ifdef __linux
+  devs     = calloc((size_t)cupsArrayCount(dirs), sizeof(dev_t));
+  num_devs = 0;
+
+  for (filename = (const char *)cupsArrayFirst(dirs);
+       filename && devs;
+       filename = (const char *)cupsArrayNext(dirs))
+  {
+    if ((fd = open(filename, O_RDONLY)) < 0)
+      continue;
+
+    if (!fstat(fd, &dirinfo))
+    {
+      for (i = 0; i < num_devs; i ++)
+        if (devs[i] == dirinfo.st_dev)
+	  break;
+
+      if (i >= num_devs)
+      {
+        devs[num_devs ++] = dirinfo.st_dev;
+
+        if (syncfs(fd))
+	  cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to sync \"%s\": %s",
+	                  filename, strerror(errno));
+      }
+    }
+
+    close(fd);
+  }
+
+  free(devs);
+
+#else
+  for (filename = (const char *)cupsArrayFirst(sync_renames);
+       filename;
+       filename = (const char *)cupsArrayNext(sync_renames))
+  {
+    snprintf(newfile, sizeof(newfile), "%s.N", filename);
+    sync_path(newfile);
+  }
+
+  for (filename = (const char *)cupsArrayFirst(sync_files);
+       filename;
+       filename = (const char *)cupsArrayNext(sync_files))
+    sync_path(filename);
+#endif /* __linux */
+
+ /*
+  * Move the new files into place...
+  */
+
+  for (filename = (const char *)cupsArrayFirst(sync_renames);
+       filename;
+       filename = (const char *)cupsArrayNext(sync_renames))
+    finalize_conf_file(filename);
+
+ /*
+  * Then sync each directory once...
+  */
+
+  for (filename = (const char *)cupsArrayFirst(dirs);
+       filename;
+       filename = (const char *)cupsArrayNext(dirs))
+    sync_path(filename);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG,
+                  "Committed %d file(s) in %d director%s.", num_files,
+		  cupsArrayCount(dirs), cupsArrayCount(dirs) == 1 ? "y" : "ies");
+
+  cupsArrayDelete(dirs);
+  cupsArrayClear(sync_files);
+  cupsArrayClear(sync_renames);
+}
+
+
+/*
+ * 'cupsdFinishPurge()' - Wait for queued files to be removed.
+ */
+
+void
+cupsdFinishPurge(void)
+{
+  _cupsMutexLock(&purge_mutex);
+
+  while (cupsArrayCount(purge_queue) > 0 || purge_busy)
+    _cupsCondWait(&purge_cond, &purge_mutex, 0.0);
+
+  _cupsMutexUnlock(&purge_mutex);
+}
+
+
 /*
  * 'cupsdOpenConfFile()' - Open a configuration file.
  *
@@ -288,6 +481,57 @@ cupsdOpenPipe(int *fds)			/* O - Pipe file descriptors (2) */
 }
 
 
+/*
+ * 'cupsdPurgeFile()' - Unlink or securely remove a file in the background.
+ *
+ * The file is removed by a separate thread according to the Classification
+ * setting, so large or securely erased files don't stall the main loop.
+ */
+
+void
+cupsdPurgeFile(const char *filename)	/* I - File to remove */
+{
+  char	*name;				/* Copy of filename */
+
+
+  if ((name = strdup(filename)) == NULL)
+  {
+    cupsdUnlinkOrRemoveFile(filename);
+    return;
+  }
+
+  _cupsMutexLock(&purge_mutex);
+
+  if (!purge_queue)
+  {
+   /*
+    * Start the purge thread...
+    */
+
+    _cups_thread_t	thread;		/* Purge thread */
+
+    if ((thread = _cupsThreadCreate((_cups_thread_func_t)purge_files, NULL)) == 0)
+    {
+      _cupsMutexUnlock(&purge_mutex);
+
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start file purge thread: %s", strerror(errno));
+      cupsdUnlinkOrRemoveFile(filename);
+      free(name);
+      return;
+    }
+
+    _cupsThreadDetach(thread);
+
+    purge_queue = cupsArrayNew(NULL, NULL);
+  }
+
+  cupsArrayAdd(purge_queue, name);
+
+  _cupsCondBroadcast(&purge_cond);
+  _cupsMutexUnlock(&purge_mutex);
+}
+
+
 /*
  * 'cupsdRemoveFile()' - Remove a file securely.
  */
@@ -295,7 +539,6 @@ cupsdOpenPipe(int *fds)			/* O - Pipe file descriptors (2) */
 int					/* O - 0 on success, -1 on error */
 cupsdRemoveFile(const char *filename)	/* I - File to remove */
 {
-#ifdef HAVE_REMOVEFILE
  /*
   * See if the file exists...
   */
@@ -305,6 +548,266 @@ cupsdRemoveFile(const char *filename)	/* I - File to remove */
 
   cupsdLogMessage(CUPSD_LOG_DEBUG, "Securely removing \"%s\".", filename);
 
+  return (remove_file(filename));
+}
+
+
+/*
+ * 'cupsdStartConfBatch()' - Start a group commit of configuration and state
+ *                           files.
+ *
+ * When SyncOnClose is "Batch", files closed with cupsdCloseCreatedConfFile()
+ * or synced with cupsdSyncFile() are committed together by
+ * cupsdFinishConfBatch().
+ */
+
+void
+cupsdStartConfBatch(void)
+{
+  if (SyncOnClose == CUPSD_SYNC_BATCH)
+    sync_batch = 1;
+}
+
+
+/*
+ * 'cupsdSyncFile()' - Flush a file to disk according to SyncOnClose.
+ */
+
+int					/* O - 0 on success, -1 on error */
+cupsdSyncFile(cups_file_t *fp,		/* I - File to sync */
+              const char  *filename)	/* I - Filename */
+{
+  if (!SyncOnClose)
+    return (0);
+
+  if (cupsFileFlush(fp))
+    return (-1);
+
+  if (SyncOnClose == CUPSD_SYNC_BATCH && sync_batch)
+  {
+    if (!sync_files)
+      sync_files = cupsArrayNew3((cups_array_func_t)strcmp, NULL, NULL, 0,
+                                 (cups_acopy_func_t)strdup,
+				 (cups_afree_func_t)free);
+
+    if (!cupsArrayFind(sync_files, (void *)filename))
+      cupsArrayAdd(sync_files, (void *)filename);
+
+    return (0);
+  }
+
+  if (fsync(cupsFileNumber(fp)))
+    return (-1);
+
+  if (SyncOnClose >= CUPSD_SYNC_BATCH)
+    return (sync_dir(filename));
+
+  return (0);
+}
+
+
+/*
+ * 'cupsdUnlinkOrRemoveFile()' - Unlink or securely remove a file depending
+ *                               on the configuration.
+ */
+
+int					/* O - 0 on success, -1 on error */
+cupsdUnlinkOrRemoveFile(
+    const char *filename)		/* I - Filename */
+{
+  if (Classification)
+    return (cupsdRemoveFile(filename));
+  else
+    return (unlink(filename));
+}
+
+
+/*
+ * 'add_sync_dir()' - Add the directory containing a file to a sync list.
+ */
+
+static void
+add_sync_dir(cups_array_t *dirs,	/* I - Directories */
+             const char   *filename)	/* I - Filename */
+{
+  char	dir[1024];			/* Directory name */
+
+
+  file_dir(filename, dir, sizeof(dir));
+
+  if (!cupsArrayFind(dirs, dir))
+    cupsArrayAdd(dirs, dir);
+}
+
+
+/*
+ * 'file_dir()' - Get the directory containing a file.
+ */
+
+static char *				/* O - Directory name */
+file_dir(const char *filename,		/* I - Filename */
+         char       *dir,		/* I - Directory buffer */
+         size_t     dirsize)		/* I - Size of directory buffer */
+{
+  char	*ptr;				/* Pointer into directory name */
+
+
+  strlcpy(dir, filename, dirsize);
+
+  if ((ptr = strrchr(dir, '/')) == NULL)
+    strlcpy(dir, ".", dirsize);
+  else if (ptr == dir)
+    ptr[1] = '\0';
+  else
+    *ptr = '\0';
+
+  return (dir);
+}
+
+
+/*
+ * 'finalize_conf_file()' - Move a created configuration file into place.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+finalize_conf_file(const char *filename)/* I - Filename */
+{
+  char	newfile[1024],			/* filename.N */
+	oldfile[1024];			/* filename.O */
+
+
+ /*
+  * Remove "filename.O", rename "filename" to "filename.O", and rename
+  * "filename.N" to "filename".
+  */
+
+  snprintf(newfile, sizeof(newfile), "%s.N", filename);
+  snprintf(oldfile, sizeof(oldfile), "%s.O", filename);
+
+  if ((cupsdUnlinkOrRemoveFile(oldfile) && errno != ENOENT) ||
+      (rename(filename, oldfile) && errno != ENOENT) ||
+      rename(newfile, filename))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to finalize \"%s\": %s",
+                    filename, strerror(errno));
+    return (-1);
+  }
+
+ /*
+  * Our own changes don't require a full reload...
+  */
+
+  cupsdStampConfFile(filename);
+
+  return (0);
+}
+
+
+#ifndef HAVE_REMOVEFILE
+/*
+ * 'overwrite_data()' - Overwrite the data in a file.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+overwrite_data(int        fd,		/* I - File descriptor */
+               const char *buffer,	/* I - Buffer to write */
+	       int        bufsize,	/* I - Size of buffer */
+               int        filesize)	/* I - Size of file */
+{
+  int	bytes;				/* Bytes to write/written */
+
+
+ /*
+  * Start at the beginning of the file...
+  */
+
+  if (lseek(fd, 0, SEEK_SET) < 0)
+    return (-1);
+
+ /*
+  * Fill the file with the provided data...
+  */
+
+  while (filesize > 0)
+  {
+    if (filesize > bufsize)
+      bytes = bufsize;
+    else
+      bytes = filesize;
+
+    if ((bytes = write(fd, buffer, (size_t)bytes)) < 0)
+      return (-1);
+
+    filesize -= bytes;
+  }
+
+ /*
+  * Force the changes to disk...
+  */
+
+  return (fsync(fd));
+}
+#endif /* HAVE_REMOVEFILE */
+
+
+/*
+ * 'purge_files()' - Remove queued files.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+purge_files(void *data)			/* I - Unused */
+{
+  char	*filename;			/* File to remove */
+
+
+  (void)data;
+
+  _cupsMutexLock(&purge_mutex);
+
+  for (;;)
+  {
+    while ((filename = (char *)cupsArrayFirst(purge_queue)) == NULL)
+      _cupsCondWait(&purge_cond, &purge_mutex, 0.0);
+
+    cupsArrayRemove(purge_queue, filename);
+    purge_busy = 1;
+
+    _cupsMutexUnlock(&purge_mutex);
+
+    if (Classification)
+      remove_file(filename);
+    else
+      unlink(filename);
+
+    free(filename);
+
+    _cupsMutexLock(&purge_mutex);
+
+    purge_busy = 0;
+    _cupsCondBroadcast(&purge_cond);
+  }
+
+  return (NULL);
+}
+
+
+/*
+ * 'remove_file()' - Remove a file securely without logging.
+ *
+ * This is also used by the purge thread, which must not log.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+remove_file(const char *filename)	/* I - File to remove */
+{
+#ifdef HAVE_REMOVEFILE
+ /*
+  * See if the file exists...
+  */
+
+  if (access(filename, 0))
+    return (0);
+
  /*
   * Remove the file...
   */
@@ -325,8 +828,6 @@ cupsdRemoveFile(const char *filename)	/* I - File to remove */
   if (access(filename, 0))
     return (0);
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG, "Securely removing \"%s\".", filename);
-
  /*
   * First open the file for writing in exclusive mode.
   */
@@ -379,63 +880,42 @@ cupsdRemoveFile(const char *filename)	/* I - File to remove */
 
 
 /*
- * 'cupsdUnlinkOrRemoveFile()' - Unlink or securely remove a file depending
- *                               on the configuration.
+ * 'sync_dir()' - Sync the directory containing a file.
  */
 
-int					/* O - 0 on success, -1 on error */
-cupsdUnlinkOrRemoveFile(
-    const char *filename)		/* I - Filename */
+static int				/* O - 0 on success, -1 on error */
+sync_dir(const char *filename)		/* I - Filename */
 {
-  if (Classification)
-    return (cupsdRemoveFile(filename));
-  else
-    return (unlink(filename));
+  char	dir[1024];			/* Directory name */
+
+
+  return (sync_path(file_dir(filename, dir, sizeof(dir))));
 }
 
 
-#ifndef HAVE_REMOVEFILE
 /*
- * 'overwrite_data()' - Overwrite the data in a file.
+ * 'sync_path()' - Sync a file or directory to disk.
  */
 
 static int				/* O - 0 on success, -1 on error */
-overwrite_data(int        fd,		/* I - File descriptor */
-               const char *buffer,	/* I - Buffer to write */
-	       int        bufsize,	/* I - Size of buffer */
-               int        filesize)	/* I - Size of file */
+sync_path(const char *path)		/* I - File or directory */
 {
-  int	bytes;				/* Bytes to write/written */
-
-
- /*
-  * Start at the beginning of the file...
-  */
+  int	fd,				/* File descriptor */
+	status;				/* Status of fsync() */
 
-  if (lseek(fd, 0, SEEK_SET) < 0)
-    return (-1);
-
- /*
-  * Fill the file with the provided data...
-  */
 
-  while (filesize > 0)
+  if ((fd = open(path, O_RDONLY)) < 0)
   {
-    if (filesize > bufsize)
-      bytes = bufsize;
-    else
-      bytes = filesize;
-
-    if ((bytes = write(fd, buffer, (size_t)bytes)) < 0)
-      return (-1);
-
-    filesize -= bytes;
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open \"%s\" for sync: %s",
+                    path, strerror(errno));
+    return (-1);
   }
 
- /*
-  * Force the changes to disk...
-  */
+  if ((status = fsync(fd)) != 0)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to sync \"%s\": %s", path,
+                    strerror(errno));
 
-  return (fsync(fd));
+  close(fd);
+
+  return (status);
 }
-#endif /* HAVE_REMOVEFILE */
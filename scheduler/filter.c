@@ -27,6 +27,14 @@
  * Local types...
  */
 
+typedef struct _mime_chain_s		/**** Cached filter chain ****/
+{
+  mime_type_t		*src,		/* Source type */
+			*dst;		/* Destination type */
+  cups_array_t		*filters;	/* Filters to run or NULL for none */
+  int			cost;		/* Cost of filters or -1 if not minimal */
+} _mime_chain_t;
+
 typedef struct _mime_typelist_s		/**** List of source types ****/
 {
   struct _mime_typelist_s *next;	/* Next source type */
@@ -38,11 +46,19 @@ typedef struct _mime_typelist_s		/**** List of source types ****/
  * Local functions...
  */
 
+static int		mime_compare_chains(_mime_chain_t *, _mime_chain_t *);
 static int		mime_compare_filters(mime_filter_t *, mime_filter_t *);
+static int		mime_compare_printers(mime_type_t *t0, mime_type_t *t1);
 static int		mime_compare_srcs(mime_filter_t *, mime_filter_t *);
 static cups_array_t	*mime_find_filters(mime_t *mime, mime_type_t *src,
 				      size_t srcsize, mime_type_t *dst,
 				      int *cost, _mime_typelist_t *visited);
+static mime_filter_t	*mime_first_src(mime_t *mime, mime_filter_t *key,
+			            mime_type_t *dst);
+static void		mime_free_chain(_mime_chain_t *chain);
+static mime_filter_t	*mime_next_src(mime_t *mime, mime_filter_t *key,
+			               mime_type_t *dst);
+static mime_filter_t	*mime_seek_src(mime_t *mime, mime_filter_t *key);
 
 
 /*
@@ -124,6 +140,14 @@ mimeAddFilter(mime_t      *mime,	/* I - MIME database */
     cupsArrayAdd(mime->srcs, temp);
   }
 
+ /*
+  * Any new or cheaper filter can change the best chain between any two
+  * types, so discard the cached chains...
+  */
+
+  cupsArrayDelete(mime->chains);
+  mime->chains = NULL;
+
  /*
   * Return the new/updated filter...
   */
@@ -167,6 +191,9 @@ mimeFilter2(mime_t      *mime,		/* I - MIME database */
 	    int         *cost)		/* O - Cost of filters */
 {
   cups_array_t	*filters;		/* Array of filters to run */
+  _mime_chain_t	key,			/* Search key */
+		*chain;			/* Cached filter chain */
+  mime_filter_t	*current;		/* Current filter */
 
 
  /*
@@ -192,8 +219,6 @@ mimeFilter2(mime_t      *mime,		/* I - MIME database */
 
   if (!mime->srcs)
   {
-    mime_filter_t	*current;	/* Current filter */
-
     mime->srcs = cupsArrayNew((cups_array_func_t)mime_compare_srcs, NULL);
 
     for (current = mimeFirstFilter(mime);
@@ -202,6 +227,63 @@ mimeFilter2(mime_t      *mime,		/* I - MIME database */
       cupsArrayAdd(mime->srcs, current);
   }
 
+ /*
+  * See if we have already looked up this conversion.  Chains are cached for
+  * an unlimited file size; a cached chain is only used for a specific file
+  * size if none of its filters has a lower size limit...
+  */
+
+  if (!mime->chains)
+    mime->chains = cupsArrayNew3((cups_array_func_t)mime_compare_chains, NULL,
+                                 (cups_ahash_func_t)NULL, 0,
+				 (cups_acopy_func_t)NULL,
+				 (cups_afree_func_t)mime_free_chain);
+
+  key.src = src;
+  key.dst = dst;
+
+  if ((chain = (_mime_chain_t *)cupsArrayFind(mime->chains, &key)) != NULL &&
+      cost && chain->cost < 0)
+  {
+   /*
+    * Cached chain is not the cheapest one, look it up again...
+    */
+
+    cupsArrayRemove(mime->chains, chain);
+    chain = NULL;
+  }
+
+  if (!chain && (chain = calloc(1, sizeof(_mime_chain_t))) != NULL)
+  {
+    chain->src     = src;
+    chain->dst     = dst;
+    chain->filters = mime_find_filters(mime, src, 0, dst, cost ? &(chain->cost) : NULL, NULL);
+
+    if (!cost && chain->filters)
+      chain->cost = -1;
+
+    cupsArrayAdd(mime->chains, chain);
+  }
+
+  if (chain)
+  {
+    for (current = (mime_filter_t *)cupsArrayFirst(chain->filters);
+         current;
+	 current = (mime_filter_t *)cupsArrayNext(chain->filters))
+      if (current->maxsize > 0 && srcsize > current->maxsize)
+        break;
+
+    if (!current)
+    {
+      DEBUG_puts("1mimeFilter2: Using cached filter chain.");
+
+      if (cost)
+        *cost = chain->cost;
+
+      return (cupsArrayDup(chain->filters));
+    }
+  }
+
  /*
   * Find the filters...
   */
@@ -254,6 +336,23 @@ mimeFilterLookup(mime_t      *mime,	/* I - MIME database */
 }
 
 
+/*
+ * 'mime_compare_chains()' - Compare two cached filter chains.
+ */
+
+static int				/* O - Comparison result */
+mime_compare_chains(_mime_chain_t *c0,	/* I - First chain */
+                    _mime_chain_t *c1)	/* I - Second chain */
+{
+  if (c0->src != c1->src)
+    return (c0->src < c1->src ? -1 : 1);
+  else if (c0->dst != c1->dst)
+    return (c0->dst < c1->dst ? -1 : 1);
+  else
+    return (0);
+}
+
+
 /*
  * 'mime_compare_filters()' - Compare two filters.
  */
@@ -274,8 +373,47 @@ mime_compare_filters(mime_filter_t *f0,	/* I - First filter */
 }
 
 
+/*
+ * 'mime_compare_printers()' - Compare the printers of two types.
+ *
+ * Printer types are named "printer/name" or "printer/name/super/type".  All
+ * other types sort before them and compare equal to each other.
+ */
+
+static int				/* O - Comparison result */
+mime_compare_printers(mime_type_t *t0,	/* I - First type */
+                      mime_type_t *t1)	/* I - Second type */
+{
+  int		i,			/* Result of comparison */
+		p0,			/* First type is a printer type? */
+		p1;			/* Second type is a printer type? */
+  size_t	len0,			/* Length of first printer name */
+		len1;			/* Length of second printer name */
+
+
+  p0 = !strcmp(t0->super, "printer");
+  p1 = !strcmp(t1->super, "printer");
+
+  if (p0 != p1)
+    return (p0 - p1);
+  else if (!p0)
+    return (0);
+
+  len0 = strcspn(t0->type, "/");
+  len1 = strcspn(t1->type, "/");
+
+  if ((i = strncmp(t0->type, t1->type, len0 < len1 ? len0 : len1)) == 0)
+    i = len0 < len1 ? -1 : len0 > len1;
+
+  return (i);
+}
+
+
 /*
  * 'mime_compare_srcs()' - Compare two filter source types.
+ *
+ * Filters are grouped by source type and then by destination printer so
+ * that mime_find_filters() only needs to look at the filters of one printer.
  */
 
 static int				/* O - Comparison result */
@@ -286,7 +424,10 @@ mime_compare_srcs(mime_filter_t *f0,	/* I - First filter */
 
 
   if ((i = strcmp(f0->src->super, f1->src->super)) == 0)
-    i = strcmp(f0->src->type, f1->src->type);
+    if ((i = strcmp(f0->src->type, f1->src->type)) == 0)
+      if ((i = mime_compare_printers(f0->dst, f1->dst)) == 0)
+        if ((i = strcmp(f0->dst->super, f1->dst->super)) == 0)
+          i = strcmp(f0->dst->type, f1->dst->type);
 
   return (i);
 }
@@ -376,9 +517,9 @@ mime_find_filters(
 
   srckey.src = src;
 
-  for (current = (mime_filter_t *)cupsArrayFind(mime->srcs, &srckey);
-       current && current->src == src;
-       current = (mime_filter_t *)cupsArrayNext(mime->srcs))
+  for (current = mime_first_src(mime, &srckey, dst);
+       current;
+       current = mime_next_src(mime, &srckey, dst))
   {
    /*
     * See if we have already tried the destination type as a source
@@ -485,3 +626,117 @@ mime_find_filters(
 
   return (NULL);
 }
+
+
+/*
+ * 'mime_first_src()' - Find the first filter from a source type.
+ *
+ * Printer-specific types only convert to types for the same printer, so only
+ * the filters to non-printer types and to the destination printer are
+ * returned.
+ */
+
+static mime_filter_t *			/* O - First filter or NULL */
+mime_first_src(mime_t        *mime,	/* I - MIME database */
+               mime_filter_t *key,	/* I - Source type key */
+               mime_type_t   *dst)	/* I - Destination type */
+{
+  mime_filter_t		*current;	/* Current filter */
+  static mime_type_t	anytype;	/* Key for non-printer types */
+
+
+  key->dst = &anytype;
+
+  if ((current = mime_seek_src(mime, key)) == NULL &&
+      !strcmp(dst->super, "printer"))
+  {
+    key->dst = dst;
+    current  = mime_seek_src(mime, key);
+  }
+
+  return (current);
+}
+
+
+/*
+ * 'mime_free_chain()' - Free a cached filter chain.
+ */
+
+static void
+mime_free_chain(_mime_chain_t *chain)	/* I - Filter chain */
+{
+  cupsArrayDelete(chain->filters);
+  free(chain);
+}
+
+
+/*
+ * 'mime_next_src()' - Find the next filter from a source type.
+ */
+
+static mime_filter_t *			/* O - Next filter or NULL */
+mime_next_src(mime_t        *mime,	/* I - MIME database */
+              mime_filter_t *key,	/* I - Source type key */
+              mime_type_t   *dst)	/* I - Destination type */
+{
+  mime_filter_t	*current;		/* Current filter */
+
+
+  if ((current = (mime_filter_t *)cupsArrayNext(mime->srcs)) != NULL &&
+      current->src == key->src && !mime_compare_printers(current->dst, key->dst))
+    return (current);
+
+  if (key->dst == dst || strcmp(dst->super, "printer"))
+    return (NULL);
+
+ /*
+  * Move on to the filters for the destination printer...
+  */
+
+  key->dst = dst;
+
+  return (mime_seek_src(mime, key));
+}
+
+
+/*
+ * 'mime_seek_src()' - Find the first filter for a source type and printer.
+ */
+
+static mime_filter_t *			/* O - First filter or NULL */
+mime_seek_src(mime_t        *mime,	/* I - MIME database */
+              mime_filter_t *key)	/* I - Source type key */
+{
+  int		left,			/* Left side of search */
+		right,			/* Right side of search */
+		current,		/* Current element */
+		diff;			/* Result of comparison */
+  mime_filter_t	*filter;		/* Current filter */
+
+
+ /*
+  * Do a binary search for the first filter with the same source type and
+  * printer...
+  */
+
+  for (left = 0, right = cupsArrayCount(mime->srcs); left < right;)
+  {
+    current = (left + right) / 2;
+    filter  = (mime_filter_t *)cupsArrayIndex(mime->srcs, current);
+
+    if ((diff = strcmp(filter->src->super, key->src->super)) == 0)
+      if ((diff = strcmp(filter->src->type, key->src->type)) == 0)
+        diff = mime_compare_printers(filter->dst, key->dst);
+
+    if (diff < 0)
+      left = current + 1;
+    else
+      right = current;
+  }
+
+  if ((filter = (mime_filter_t *)cupsArrayIndex(mime->srcs, left)) != NULL &&
+      filter->src == key->src && !mime_compare_printers(filter->dst, key->dst))
+    return (filter);
+
+  return (NULL);
+}
@@ -28,6 +28,25 @@ extern int mbr_check_membership_by_id(uuid_t user, gid_t group, int* ismember);
 #endif /* __APPLE__ */
 
 
+/*
+ * Local constants...
+ */
+
+#define CUPSD_LOCAL_MAX_WORKERS	4	/* Max threads creating local queues */
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*local_queue = NULL;
+					/* Local printers waiting for a PPD */
+static int		local_workers = 0;
+					/* Number of running queue workers */
+static _cups_mutex_t	local_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for local printer queue */
+
+
 /*
  * Local functions...
  */
@@ -67,11 +86,16 @@ static void	copy_job_attrs(cupsd_client_t *con,
 static void	copy_printer_attrs(cupsd_client_t *con,
 		                   cupsd_printer_t *printer,
 				   cups_array_t *ra);
+static void	copy_printer_cache(cupsd_client_t *con,
+		                   cupsd_printer_t *printer,
+				   cups_array_t *ra);
 static void	copy_subscription_attrs(cupsd_client_t *con,
 		                        cupsd_subscription_t *sub,
 					cups_array_t *ra,
 					cups_array_t *exclude);
 static void	create_job(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	*create_local_bg_thread(void *data);
+static void	create_local_ppd(cupsd_printer_t *printer);
 static void	create_local_printer(cupsd_client_t *con);
 static cups_array_t *create_requested_array(ipp_t *request);
 static void	create_subscriptions(cupsd_client_t *con, ipp_attribute_t *uri);
@@ -81,17 +105,19 @@ static void	get_devices(cupsd_client_t *con);
 static void	get_document(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_jobs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_job_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
-static void	get_notifications(cupsd_client_t *con);
+static void	get_notifications(cupsd_client_t *con, int wait);
 static void	get_ppd(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_ppds(cupsd_client_t *con);
 static void	get_printers(cupsd_client_t *con, int type);
 static void	get_printer_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_printer_supported(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	get_statistics(cupsd_client_t *con);
 static void	get_subscription_attrs(cupsd_client_t *con, int sub_id);
 static void	get_subscriptions(cupsd_client_t *con, ipp_attribute_t *uri);
 static const char *get_username(cupsd_client_t *con);
 static void	hold_job(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	hold_new_jobs(cupsd_client_t *con, ipp_attribute_t *uri);
+static ipp_t	*load_local_cache(const char *uuid, int config_time, char *ppdfile, size_t ppdsize);
 static void	move_job(cupsd_client_t *con, ipp_attribute_t *uri);
 static int	ppd_parse_line(const char *line, char *option, int olen,
 		               char *choice, int clen);
@@ -105,10 +131,12 @@ static void	renew_subscription(cupsd_client_t *con, int sub_id);
 static void	restart_job(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	save_auth_info(cupsd_client_t *con, cupsd_job_t *job,
 		               ipp_attribute_t *auth_info);
+static void	save_local_cache(const char *uuid, ipp_t *response, const char *ppdfile);
 static void	send_document(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	send_http_error(cupsd_client_t *con, http_status_t status,
 		                cupsd_printer_t *printer);
 static void	send_ipp_status(cupsd_client_t *con, ipp_status_t status, const char *message, ...) _CUPS_FORMAT(3, 4);
+static int	send_response(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	set_default(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	set_job_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	set_printer_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
@@ -123,6 +151,46 @@ static int	validate_name(const char *name);
 static int	validate_user(cupsd_job_t *job, cupsd_client_t *con, const char *owner, char *username, size_t userlen);
 
 
+/*
+ * 'cupsdCheckNotifyWaiters()' - Answer waiting Get-Notifications requests.
+ */
+
+void
+cupsdCheckNotifyWaiters(void)
+{
+  cupsd_client_t	*con;		/* Current client */
+  time_t		curtime;	/* Current time */
+
+
+  if (!cupsArrayCount(NotifyWaiters))
+    return;
+
+  curtime = time(NULL);
+
+  for (con = (cupsd_client_t *)cupsArrayFirst(NotifyWaiters);
+       con;
+       con = (cupsd_client_t *)cupsArrayNext(NotifyWaiters))
+  {
+    if (!con->notify_ready && con->notify_wait > curtime)
+      continue;
+
+    cupsArrayRemove(NotifyWaiters, con);
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Done waiting for events (%s).",
+                   con->notify_ready ? "new events" : "timeout");
+
+    con->notify_wait  = 0;
+    con->notify_ready = 0;
+
+    get_notifications(con, 0);
+
+    if (!send_response(con, ippFindAttribute(con->request, "printer-uri",
+                                             IPP_TAG_URI)))
+      cupsdCloseClient(con);
+  }
+}
+
+
 /*
  * 'cupsdProcessIPPRequest()' - Process an incoming IPP request.
  */
@@ -141,6 +209,10 @@ cupsdProcessIPPRequest(
   int			valid = 1;	/* Valid request? */
 
 
+  gettimeofday(&con->ipp_start, NULL);
+
+  CUPSD_PROBE2(ipp__request__start, con->number, con->request->request.op.operation_id);
+
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdProcessIPPRequest(%p[%d]): operation_id=%04x(%s)", con, con->number, con->request->request.op.operation_id, ippOpString(con->request->request.op.operation_id));
 
   if (LogLevel >= CUPSD_LOG_DEBUG2)
@@ -170,7 +242,7 @@ cupsdProcessIPPRequest(
   * First build an empty response message for this request...
   */
 
-  con->response = ippNew();
+  con->response = _ippNewArena();
 
   con->response->request.status.version[0] = con->request->request.op.version[0];
   con->response->request.status.version[1] = con->request->request.op.version[1];
@@ -303,6 +375,7 @@ cupsdProcessIPPRequest(
 	        con->request->request.op.operation_id != CUPS_GET_PRINTERS &&
 	        con->request->request.op.operation_id != CUPS_GET_CLASSES &&
 	        con->request->request.op.operation_id != CUPS_GET_DEVICES &&
+	        con->request->request.op.operation_id != IPP_OP_CUPS_GET_STATISTICS &&
 	        con->request->request.op.operation_id != CUPS_GET_PPDS))
       {
        /*
@@ -565,6 +638,10 @@ cupsdProcessIPPRequest(
 		get_ppds(con);
 		break;
 
+	    case IPP_OP_CUPS_GET_STATISTICS :
+		get_statistics(con);
+		break;
+
 	    case IPP_OP_CUPS_MOVE_JOB :
 		move_job(con, uri);
 		break;
@@ -595,7 +672,7 @@ cupsdProcessIPPRequest(
 		break;
 
 	    case IPP_OP_GET_NOTIFICATIONS :
-		get_notifications(con);
+		get_notifications(con, 1);
 		break;
 
 	    case IPP_OP_CUPS_CREATE_LOCAL_PRINTER :
@@ -613,78 +690,23 @@ cupsdProcessIPPRequest(
     }
   }
 
-  if (con->response)
+  if (con->notify_wait)
   {
    /*
-    * Sending data from the scheduler...
-    */
-
-    cupsdLogClient(con, con->response->request.status.status_code >= IPP_STATUS_ERROR_BAD_REQUEST && con->response->request.status.status_code != IPP_STATUS_ERROR_NOT_FOUND ? CUPSD_LOG_ERROR : CUPSD_LOG_DEBUG, "Returning IPP %s for %s (%s) from %s.",  ippErrorString(con->response->request.status.status_code), ippOpString(con->request->request.op.operation_id), uri ? uri->values[0].string.text : "no URI", con->http->hostname);
-
-    httpClearFields(con->http);
-
-#ifdef CUPSD_USE_CHUNKING
-   /*
-    * Because older versions of CUPS (1.1.17 and older) and some IPP
-    * clients do not implement chunking properly, we cannot use
-    * chunking by default.  This may become the default in future
-    * CUPS releases, or we might add a configuration directive for
-    * it.
+    * Get-Notifications is waiting for new events, tell the caller everything
+    * is A-OK so far...
     */
 
-    if (con->http->version == HTTP_1_1)
-    {
-      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Transfer-Encoding: chunked");
-      cupsdSetLength(con->http, 0);
-    }
-    else
-#endif /* CUPSD_USE_CHUNKING */
-    {
-      size_t	length;			/* Length of response */
-
-
-      length = ippLength(con->response);
-
-      if (con->file >= 0 && !con->pipe_pid)
-      {
-	struct stat	fileinfo;	/* File information */
-
-	if (!fstat(con->file, &fileinfo))
-	  length += (size_t)fileinfo.st_size;
-      }
-
-      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Content-Length: " CUPS_LLFMT, CUPS_LLCAST length);
-      httpSetLength(con->http, length);
-    }
-
-    if (cupsdSendHeader(con, HTTP_OK, "application/ipp", CUPSD_AUTH_NONE))
-    {
-     /*
-      * Tell the caller the response header was sent successfully...
-      */
+    return (1);
+  }
 
-      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, (cupsd_selfunc_t)cupsdWriteClient, con);
+  gettimeofday(&con->ipp_end, NULL);
 
-      return (1);
-    }
-    else
-    {
-     /*
-      * Tell the caller the response header could not be sent...
-      */
+  cupsdAddIPPMetric(con->request->request.op.operation_id, cupsdElapsedTime(&con->ipp_start, &con->ipp_end));
 
-      return (0);
-    }
-  }
-  else
-  {
-   /*
-    * Sending data from a subprocess like cups-deviced; tell the caller
-    * everything is A-OK so far...
-    */
+  CUPSD_PROBE3(ipp__request__done, con->number, con->request->request.op.operation_id, con->response->request.status.status_code);
 
-    return (1);
-  }
+  return (send_response(con, uri));
 }
 
 
@@ -792,7 +814,7 @@ accept_jobs(cupsd_client_t  *con,	/* I - Client connection */
   }
   else
   {
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkPrinterDirty(printer);
 
     cupsdLogMessage(CUPSD_LOG_INFO,
                     "Printer \"%s\" now accepting jobs (\"%s\").",
@@ -1491,10 +1513,10 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
   * Make sure we aren't over our limit...
   */
 
-  if (MaxJobs && cupsArrayCount(Jobs) >= MaxJobs)
+  if (MaxJobs && (cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs)) >= MaxJobs)
     cupsdCleanJobs();
 
-  if (MaxJobs && cupsArrayCount(Jobs) >= MaxJobs)
+  if (MaxJobs && (cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs)) >= MaxJobs)
   {
     send_ipp_status(con, IPP_NOT_POSSIBLE, _("Too many active jobs."));
     return (NULL);
@@ -1745,6 +1767,8 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
     ippSetString(job->attrs, &job->reasons, 0, "none");
   }
 
+  cupsdUpdateJobQueues(job);
+
   if (!(printer->type & CUPS_PRINTER_REMOTE) || Classification)
   {
    /*
@@ -2157,18 +2181,12 @@ add_job_subscriptions(
       * Free and remove this attribute...
       */
 
-      ippDeleteAttribute(NULL, attr);
-
-      if (prev)
-        prev->next = next;
-      else
-        job->attrs->attrs = next;
+      ippDeleteAttribute(job->attrs, attr);
     }
     else
       prev = attr;
   }
 
-  job->attrs->last    = prev;
   job->attrs->current = prev;
 }
 
@@ -2581,17 +2599,14 @@ add_printer(cupsd_client_t  *con,	/* I - Client connection */
       return;
     }
 
-    for (i = 0; i < printer->num_reasons; i ++)
-      _cupsStrFree(printer->reasons[i]);
+    cupsdClearPrinterReasons(printer);
 
-    printer->num_reasons = 0;
     for (i = 0; i < attr->num_values; i ++)
     {
       if (!strcmp(attr->values[i].string.text, "none"))
         continue;
 
-      printer->reasons[printer->num_reasons] = _cupsStrAlloc(attr->values[i].string.text);
-      printer->num_reasons ++;
+      cupsdAddPrinterReason(printer, attr->values[i].string.text);
 
       if (!strcmp(attr->values[i].string.text, "paused") &&
           printer->state != IPP_PRINTER_STOPPED)
@@ -2803,7 +2818,7 @@ add_printer(cupsd_client_t  *con,	/* I - Client connection */
     if (!printer->printer_id)
       printer->printer_id = NextPrinterId ++;
 
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkPrinterDirty(printer);
   }
 
   cupsdSetPrinterAttrs(printer);
@@ -3980,6 +3995,8 @@ close_job(cupsd_client_t  *con,		/* I - Client connection */
     }
   }
 
+  cupsdUpdateJobQueues(job);
+
   job->dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
@@ -4097,11 +4114,12 @@ copy_banner(cupsd_client_t *con,	/* I - Client connection */
   int		kbytes;			/* Size of banner file in kbytes */
   char		filename[1024];		/* Job filename */
   cupsd_banner_t *banner;		/* Pointer to banner */
-  cups_file_t	*in;			/* Input file */
+  cupsd_btemplate_t *tmpl;		/* Banner template */
+  cupsd_bannerseg_t *seg;		/* Current template segment */
+  int		j;			/* Looping var */
   cups_file_t	*out;			/* Output file */
-  int		ch;			/* Character from file */
-  char		attrname[255],		/* Name of attribute */
-		*s;			/* Pointer into name */
+  char		attrname[255];		/* Name of locale */
+  const char	*s;			/* Name of attribute */
   ipp_attribute_t *attr;		/* Attribute */
 
 
@@ -4125,8 +4143,7 @@ copy_banner(cupsd_client_t *con,	/* I - Client connection */
   if (add_file(con, job, banner->filetype, 0))
     return (-1);
 
-  snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, job->id,
-           job->num_files);
+  cupsdGetJobFilename(job->id, 'd', job->num_files, filename, sizeof(filename));
   if ((out = cupsFileOpen(filename, "w")) == NULL)
   {
     cupsdLogMessage(CUPSD_LOG_ERROR,
@@ -4181,176 +4198,145 @@ copy_banner(cupsd_client_t *con,	/* I - Client connection */
     snprintf(filename, sizeof(filename), "%s/banners/%s", DataDir, name);
   }
 
-  if ((in = cupsFileOpen(filename, "r")) == NULL)
+  if ((tmpl = cupsdGetBannerTemplate(filename)) == NULL)
   {
-    cupsFileClose(out);
-    unlink(filename);
     cupsdLogMessage(CUPSD_LOG_ERROR,
                     "Unable to open banner template file %s - %s",
                     filename, strerror(errno));
+    cupsFileClose(out);
+    cupsdGetJobFilename(job->id, 'd', job->num_files, filename, sizeof(filename));
+    unlink(filename);
     job->num_files --;
     return (0);
   }
 
  /*
-  * Parse the file to the end...
+  * Copy the literal text and substitute attribute values...
   */
 
-  while ((ch = cupsFileGetChar(in)) != EOF)
-    if (ch == '{')
+  for (j = tmpl->num_segs, seg = tmpl->segs; j > 0; j --, seg ++)
+  {
+    if (!seg->attr)
     {
-     /*
-      * Get an attribute name...
-      */
-
-      for (s = attrname; (ch = cupsFileGetChar(in)) != EOF;)
-        if (!isalpha(ch & 255) && ch != '-' && ch != '?')
-          break;
-	else if (s < (attrname + sizeof(attrname) - 1))
-          *s++ = (char)ch;
-	else
-	  break;
-
-      *s = '\0';
+      cupsFileWrite(out, tmpl->text + seg->offset, seg->length);
+      continue;
+    }
 
-      if (ch != '}')
-      {
-       /*
-        * Ignore { followed by stuff that is not an attribute name...
-	*/
+   /*
+    * See if it is defined...
+    */
 
-        cupsFilePrintf(out, "{%s%c", attrname, ch);
-	continue;
-      }
+    if (seg->attr[0] == '?')
+      s = seg->attr + 1;
+    else
+      s = seg->attr;
 
+    if (!strcmp(s, "printer-name"))
+    {
+      cupsFilePuts(out, job->dest);
+      continue;
+    }
+    else if ((attr = ippFindAttribute(job->attrs, s, IPP_TAG_ZERO)) == NULL)
+    {
      /*
-      * See if it is defined...
+      * See if we have a leading question mark...
       */
 
-      if (attrname[0] == '?')
-        s = attrname + 1;
-      else
-        s = attrname;
-
-      if (!strcmp(s, "printer-name"))
-      {
-        cupsFilePuts(out, job->dest);
-	continue;
-      }
-      else if ((attr = ippFindAttribute(job->attrs, s, IPP_TAG_ZERO)) == NULL)
+      if (seg->attr[0] != '?')
       {
        /*
-        * See if we have a leading question mark...
+	* Nope, write to file as-is; probably a PostScript procedure...
 	*/
 
-	if (attrname[0] != '?')
-	{
-	 /*
-          * Nope, write to file as-is; probably a PostScript procedure...
-	  */
+	cupsFilePrintf(out, "{%s}", seg->attr);
+      }
 
-	  cupsFilePrintf(out, "{%s}", attrname);
-        }
+      continue;
+    }
 
-        continue;
-      }
+   /*
+    * Output value(s)...
+    */
 
-     /*
-      * Output value(s)...
-      */
+    for (i = 0; i < attr->num_values; i ++)
+    {
+      if (i)
+	cupsFilePutChar(out, ',');
 
-      for (i = 0; i < attr->num_values; i ++)
+      switch (attr->value_tag)
       {
-	if (i)
-	  cupsFilePutChar(out, ',');
-
-	switch (attr->value_tag)
-	{
-	  case IPP_TAG_INTEGER :
-	  case IPP_TAG_ENUM :
-	      if (!strncmp(s, "time-at-", 8))
-	      {
-	        struct timeval tv;	/* Time value */
+	case IPP_TAG_INTEGER :
+	case IPP_TAG_ENUM :
+	    if (!strncmp(s, "time-at-", 8))
+	    {
+	      struct timeval tv;      /* Time value */
 
-		tv.tv_sec  = attr->values[i].integer;
-		tv.tv_usec = 0;
+	      tv.tv_sec  = attr->values[i].integer;
+	      tv.tv_usec = 0;
 
-	        cupsFilePuts(out, cupsdGetDateTime(&tv, CUPSD_TIME_STANDARD));
-	      }
-	      else
-	        cupsFilePrintf(out, "%d", attr->values[i].integer);
-	      break;
+	      cupsFilePuts(out, cupsdGetDateTime(&tv, CUPSD_TIME_STANDARD));
+	    }
+	    else
+	      cupsFilePrintf(out, "%d", attr->values[i].integer);
+	    break;
 
-	  case IPP_TAG_BOOLEAN :
-	      cupsFilePrintf(out, "%d", attr->values[i].boolean);
-	      break;
+	case IPP_TAG_BOOLEAN :
+	    cupsFilePrintf(out, "%d", attr->values[i].boolean);
+	    break;
 
-	  case IPP_TAG_NOVALUE :
-	      cupsFilePuts(out, "novalue");
-	      break;
+	case IPP_TAG_NOVALUE :
+	    cupsFilePuts(out, "novalue");
+	    break;
 
-	  case IPP_TAG_RANGE :
-	      cupsFilePrintf(out, "%d-%d", attr->values[i].range.lower,
-		      attr->values[i].range.upper);
-	      break;
+	case IPP_TAG_RANGE :
+	    cupsFilePrintf(out, "%d-%d", attr->values[i].range.lower,
+		    attr->values[i].range.upper);
+	    break;
 
-	  case IPP_TAG_RESOLUTION :
-	      cupsFilePrintf(out, "%dx%d%s", attr->values[i].resolution.xres,
-		      attr->values[i].resolution.yres,
-		      attr->values[i].resolution.units == IPP_RES_PER_INCH ?
-			  "dpi" : "dpcm");
-	      break;
+	case IPP_TAG_RESOLUTION :
+	    cupsFilePrintf(out, "%dx%d%s", attr->values[i].resolution.xres,
+		    attr->values[i].resolution.yres,
+		    attr->values[i].resolution.units == IPP_RES_PER_INCH ?
+			"dpi" : "dpcm");
+	    break;
 
-	  case IPP_TAG_URI :
-          case IPP_TAG_STRING :
-	  case IPP_TAG_TEXT :
-	  case IPP_TAG_NAME :
-	  case IPP_TAG_KEYWORD :
-	  case IPP_TAG_CHARSET :
-	  case IPP_TAG_LANGUAGE :
-	      if (!_cups_strcasecmp(banner->filetype->type, "postscript"))
-	      {
-	       /*
-	        * Need to quote strings for PS banners...
-		*/
+	case IPP_TAG_URI :
+	case IPP_TAG_STRING :
+	case IPP_TAG_TEXT :
+	case IPP_TAG_NAME :
+	case IPP_TAG_KEYWORD :
+	case IPP_TAG_CHARSET :
+	case IPP_TAG_LANGUAGE :
+	    if (!_cups_strcasecmp(banner->filetype->type, "postscript"))
+	    {
+	     /*
+	      * Need to quote strings for PS banners...
+	      */
 
-	        const char *p;
+	      const char *p;
 
-		for (p = attr->values[i].string.text; *p; p ++)
+	      for (p = attr->values[i].string.text; *p; p ++)
+	      {
+		if (*p == '(' || *p == ')' || *p == '\\')
 		{
-		  if (*p == '(' || *p == ')' || *p == '\\')
-		  {
-		    cupsFilePutChar(out, '\\');
-		    cupsFilePutChar(out, *p);
-		  }
-		  else if (*p < 32 || *p > 126)
-		    cupsFilePrintf(out, "\\%03o", *p & 255);
-		  else
-		    cupsFilePutChar(out, *p);
+		  cupsFilePutChar(out, '\\');
+		  cupsFilePutChar(out, *p);
 		}
+		else if (*p < 32 || *p > 126)
+		  cupsFilePrintf(out, "\\%03o", *p & 255);
+		else
+		  cupsFilePutChar(out, *p);
 	      }
-	      else
-		cupsFilePuts(out, attr->values[i].string.text);
-	      break;
+	    }
+	    else
+	      cupsFilePuts(out, attr->values[i].string.text);
+	    break;
 
-          default :
-	      break; /* anti-compiler-warning-code */
-	}
+	default :
+	    break; /* anti-compiler-warning-code */
       }
     }
-    else if (ch == '\\')	/* Quoted char */
-    {
-      ch = cupsFileGetChar(in);
-
-      if (ch != '{')		/* Only do special handling for \{ */
-        cupsFilePutChar(out, '\\');
-
-      cupsFilePutChar(out, ch);
-    }
-    else
-      cupsFilePutChar(out, ch);
-
-  cupsFileClose(in);
+  }
 
   kbytes = (cupsFileTell(out) + 1023) / 1024;
 
@@ -4805,6 +4791,9 @@ copy_job_attrs(cupsd_client_t *con,	/* I - Client connection */
     if (job->username && (!ra || cupsArrayFind(ra, "job-originating-user-name")))
       ippAddString(con->response, IPP_TAG_JOB, IPP_TAG_NAME, "job-originating-user-name", NULL, job->username);
 
+    if (!ra || cupsArrayFind(ra, "job-priority"))
+      ippAddInteger(con->response, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-priority", job->priority);
+
     if (!ra || cupsArrayFind(ra, "job-state"))
       ippAddInteger(con->response, IPP_TAG_JOB, IPP_TAG_ENUM, "job-state", (int)job->state_value);
 
@@ -5016,82 +5005,218 @@ copy_printer_attrs(
   if (!ra || cupsArrayFind(ra, "queued-job-count"))
     add_queued_job_count(con, printer);
 
-  copy_attrs(con->response, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
-  if (printer->ppd_attrs)
-    copy_attrs(con->response, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
-  copy_attrs(con->response, CommonData, ra, IPP_TAG_ZERO, IPP_TAG_COPY, NULL);
+  copy_printer_cache(con, printer, ra);
 
   _cupsRWUnlock(&printer->lock);
 }
 
 
 /*
- * 'copy_subscription_attrs()' - Copy subscription attributes.
+ * 'copy_printer_cache()' - Copy the static printer attributes.
+ *
+ * The printer, PPD, and common attributes only change when the printer is
+ * modified, so filtered copies are kept for the most recent
+ * requested-attributes lists.  Responses reference the cached values and hold
+ * a reference to the cache entry until they have been sent.
  */
 
 static void
-copy_subscription_attrs(
-    cupsd_client_t       *con,		/* I - Client connection */
-    cupsd_subscription_t *sub,		/* I - Subscription */
-    cups_array_t         *ra,		/* I - Requested attributes array */
-    cups_array_t         *exclude)	/* I - Private attributes array */
+copy_printer_cache(
+    cupsd_client_t  *con,		/* I - Client connection */
+    cupsd_printer_t *printer,		/* I - Printer */
+    cups_array_t    *ra)		/* I - Requested attributes array */
 {
+  char			requested[8192],/* requested-attributes key */
+			*ptr;		/* Pointer into key */
+  const char		*name;		/* Current attribute name */
+  size_t		namelen;	/* Length of name */
+  int			ipp1;		/* Filter for an IPP/1.x client? */
+  cupsd_attrcache_t	*cache;		/* Cache entry */
   ipp_attribute_t	*attr;		/* Current attribute */
-  char			printer_uri[HTTP_MAX_URI];
-					/* Printer URI */
-  int			count;		/* Number of events */
-  unsigned		mask;		/* Current event mask */
-  const char		*name;		/* Current event name */
 
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2,
-                  "copy_subscription_attrs(con=%p, sub=%p, ra=%p, exclude=%p)",
-		  con, sub, ra, exclude);
+ /*
+  * Collection attributes are only sent to IPP/1.x clients when requested by
+  * name...
+  */
+
+  ipp1 = !ra && con->response->request.status.version[0] == 1;
 
  /*
-  * Copy the subscription attributes to the response using the
-  * requested-attributes attribute that may be provided by the client.
+  * Build the cache key from the (sorted) requested attributes...
   */
 
-  if (!exclude || !cupsArrayFind(exclude, "all"))
+  requested[0] = '\0';
+
+  for (name = (const char *)cupsArrayFirst(ra), ptr = requested;
+       name;
+       name = (const char *)cupsArrayNext(ra))
   {
-    if ((!exclude || !cupsArrayFind(exclude, "notify-events")) &&
-        (!ra || cupsArrayFind(ra, "notify-events")))
-    {
-      cupsdLogMessage(CUPSD_LOG_DEBUG2, "copy_subscription_attrs: notify-events");
+    namelen = strlen(name);
 
-      if ((name = cupsdEventName((cupsd_eventmask_t)sub->mask)) != NULL)
-      {
-       /*
-	* Simple event list...
-	*/
+    if ((size_t)(ptr - requested) + namelen + 2 > sizeof(requested))
+      goto uncached;
 
-	ippAddString(con->response, IPP_TAG_SUBSCRIPTION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events", NULL, name);
-      }
-      else
-      {
-       /*
-	* Complex event list...
-	*/
+    if (ptr > requested)
+      *ptr++ = ',';
 
-	for (mask = 1, count = 0; mask < CUPSD_EVENT_ALL; mask <<= 1)
-	  if (sub->mask & mask)
-	    count ++;
+    memcpy(ptr, name, namelen + 1);
+    ptr += namelen;
+  }
 
-	attr = ippAddStrings(con->response, IPP_TAG_SUBSCRIPTION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events", count, NULL, NULL);
+ /*
+  * Find or create the cache entry...
+  */
 
-	for (mask = 1, count = 0; mask < CUPSD_EVENT_ALL; mask <<= 1)
-	  if (sub->mask & mask)
-	  {
-	    attr->values[count].string.text = (char *)cupsdEventName((cupsd_eventmask_t)mask);
+  for (cache = (cupsd_attrcache_t *)cupsArrayFirst(printer->attr_cache);
+       cache;
+       cache = (cupsd_attrcache_t *)cupsArrayNext(printer->attr_cache))
+  {
+    if (cache->ipp1 == ipp1 && (ra ? cache->requested && !strcmp(cache->requested, requested) : !cache->requested))
+      break;
+  }
 
-	    count ++;
-	  }
-      }
-    }
+  if (!cache)
+  {
+    if (!printer->attr_cache)
+      printer->attr_cache = cupsArrayNew(NULL, NULL);
 
-    if ((!exclude || !cupsArrayFind(exclude, "notify-lease-duration")) &&
-        (!sub->job && (!ra || cupsArrayFind(ra, "notify-lease-duration"))))
+    if (cupsArrayCount(printer->attr_cache) >= CUPSD_ATTR_CACHE_MAX)
+    {
+     /*
+      * Drop the oldest entry...
+      */
+
+      cache = (cupsd_attrcache_t *)cupsArrayFirst(printer->attr_cache);
+      cupsArrayRemove(printer->attr_cache, cache);
+
+      free(cache->requested);
+      ippDelete(cache->attrs);
+      free(cache);
+    }
+
+    if ((cache = calloc(1, sizeof(cupsd_attrcache_t))) == NULL ||
+        (cache->attrs = ippNew()) == NULL ||
+        (ra && (cache->requested = strdup(requested)) == NULL))
+    {
+      if (cache)
+      {
+        ippDelete(cache->attrs);
+        free(cache);
+      }
+
+      goto uncached;
+    }
+
+    cache->ipp1                              = ipp1;
+    cache->attrs->request.status.version[0] = (char)(ipp1 ? 1 : 2);
+
+    copy_attrs(cache->attrs, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
+    if (printer->ppd_attrs)
+      copy_attrs(cache->attrs, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
+    copy_attrs(cache->attrs, CommonData, ra, IPP_TAG_ZERO, 0, NULL);
+
+    cupsArrayAdd(printer->attr_cache, cache);
+  }
+
+ /*
+  * Reference the cached attributes from the response...
+  */
+
+  if (!con->attr_refs)
+    con->attr_refs = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, (cups_afree_func_t)ippDelete);
+
+  if (con->attr_refs)
+  {
+    cache->attrs->use ++;
+    cupsArrayAdd(con->attr_refs, cache->attrs);
+
+    for (attr = cache->attrs->attrs; attr; attr = attr->next)
+      ippCopyAttribute(con->response, attr, 1);
+
+    return;
+  }
+
+ /*
+  * If we get here we can't use the cache, so filter the attributes directly...
+  */
+
+  uncached:
+
+  copy_attrs(con->response, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
+  if (printer->ppd_attrs)
+    copy_attrs(con->response, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
+  copy_attrs(con->response, CommonData, ra, IPP_TAG_ZERO, IPP_TAG_COPY, NULL);
+}
+
+
+/*
+ * 'copy_subscription_attrs()' - Copy subscription attributes.
+ */
+
+static void
+copy_subscription_attrs(
+    cupsd_client_t       *con,		/* I - Client connection */
+    cupsd_subscription_t *sub,		/* I - Subscription */
+    cups_array_t         *ra,		/* I - Requested attributes array */
+    cups_array_t         *exclude)	/* I - Private attributes array */
+{
+  ipp_attribute_t	*attr;		/* Current attribute */
+  char			printer_uri[HTTP_MAX_URI];
+					/* Printer URI */
+  int			count;		/* Number of events */
+  unsigned		mask;		/* Current event mask */
+  const char		*name;		/* Current event name */
+
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2,
+                  "copy_subscription_attrs(con=%p, sub=%p, ra=%p, exclude=%p)",
+		  con, sub, ra, exclude);
+
+ /*
+  * Copy the subscription attributes to the response using the
+  * requested-attributes attribute that may be provided by the client.
+  */
+
+  if (!exclude || !cupsArrayFind(exclude, "all"))
+  {
+    if ((!exclude || !cupsArrayFind(exclude, "notify-events")) &&
+        (!ra || cupsArrayFind(ra, "notify-events")))
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "copy_subscription_attrs: notify-events");
+
+      if ((name = cupsdEventName((cupsd_eventmask_t)sub->mask)) != NULL)
+      {
+       /*
+	* Simple event list...
+	*/
+
+	ippAddString(con->response, IPP_TAG_SUBSCRIPTION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events", NULL, name);
+      }
+      else
+      {
+       /*
+	* Complex event list...
+	*/
+
+	for (mask = 1, count = 0; mask < CUPSD_EVENT_ALL; mask <<= 1)
+	  if (sub->mask & mask)
+	    count ++;
+
+	attr = ippAddStrings(con->response, IPP_TAG_SUBSCRIPTION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "notify-events", count, NULL, NULL);
+
+	for (mask = 1, count = 0; mask < CUPSD_EVENT_ALL; mask <<= 1)
+	  if (sub->mask & mask)
+	  {
+	    attr->values[count].string.text = (char *)cupsdEventName((cupsd_eventmask_t)mask);
+
+	    count ++;
+	  }
+      }
+    }
+
+    if ((!exclude || !cupsArrayFind(exclude, "notify-lease-duration")) &&
+        (!sub->job && (!ra || cupsArrayFind(ra, "notify-lease-duration"))))
       ippAddInteger(con->response, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
 		    "notify-lease-duration", sub->lease);
 
@@ -5220,11 +5345,49 @@ create_job(cupsd_client_t  *con,	/* I - Client connection */
 
 
 /*
- * 'create_local_bg_thread()' - Background thread for creating a local print queue.
+ * 'create_local_bg_thread()' - Background thread for creating local print queues.
  */
 
 static void *				/* O - Exit status */
-create_local_bg_thread(
+create_local_bg_thread(void *data)	/* I - Unused */
+{
+  cupsd_printer_t	*printer;	/* Printer */
+
+
+  (void)data;
+
+  for (;;)
+  {
+    _cupsMutexLock(&local_mutex);
+
+    if ((printer = (cupsd_printer_t *)cupsArrayFirst(local_queue)) == NULL)
+    {
+      local_workers --;
+      _cupsMutexUnlock(&local_mutex);
+      break;
+    }
+
+    cupsArrayRemove(local_queue, printer);
+
+    _cupsMutexUnlock(&local_mutex);
+
+    create_local_ppd(printer);
+
+    _cupsRWLockWrite(&printer->lock);
+    printer->local_pending = 0;
+    _cupsRWUnlock(&printer->lock);
+  }
+
+  return (NULL);
+}
+
+
+/*
+ * 'create_local_ppd()' - Create the PPD file for a local print queue.
+ */
+
+static void
+create_local_ppd(
     cupsd_printer_t *printer)		/* I - Printer */
 {
   cups_file_t	*from,			/* Source file */
@@ -5235,14 +5398,24 @@ create_local_bg_thread(
 		userpass[256],		/* User:pass */
 		host[256],		/* Hostname */
 		resource[1024],		/* Resource path */
-		line[1024];		/* Line from PPD */
-  int		port;			/* Port number */
+		line[1024],		/* Line from PPD */
+		uuid[64],		/* Sanitized printer-uuid value */
+		*uuidptr;		/* Pointer into UUID */
+  const char	*ptr;			/* Pointer into attribute value */
+  int		port,			/* Port number */
+		config_time,		/* printer-config-change-time value */
+		cached = 0;		/* Using cached attributes and PPD? */
   http_encryption_t encryption;		/* Type of encryption to use */
   http_t	*http;			/* Connection to printer */
   ipp_t		*request,		/* Request to printer */
 		*response;		/* Response from printer */
   ipp_attribute_t *attr;		/* Attribute in response */
   ipp_status_t	status;			/* Status code */
+  static const char * const cattrs[] =	/* Printer attributes for the cache */
+  {
+    "printer-config-change-time",
+    "printer-uuid"
+  };
   static const char * const pattrs[] =	/* Printer attributes we need */
   {
     "all",
@@ -5259,7 +5432,7 @@ create_local_bg_thread(
   if (httpSeparateURI(HTTP_URI_CODING_ALL, printer->device_uri, scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port, resource, sizeof(resource)) < HTTP_URI_STATUS_OK)
   {
     cupsdLogMessage(CUPSD_LOG_ERROR, "%s: Bad device URI \"%s\".", printer->name, printer->device_uri);
-    return (NULL);
+    return;
   }
 
   if (!strcmp(scheme, "ipps") || port == 443)
@@ -5270,11 +5443,13 @@ create_local_bg_thread(
   if ((http = httpConnect2(host, port, NULL, AF_UNSPEC, encryption, 1, 30000, NULL)) == NULL)
   {
     cupsdLogMessage(CUPSD_LOG_ERROR, "%s: Unable to connect to %s:%d: %s", printer->name, host, port, cupsLastErrorString());
-    return (NULL);
+    return;
   }
 
  /*
-  * Query the printer for its capabilities...
+  * Get the printer-uuid and printer-config-change-time values so we can
+  * reuse the attributes and PPD from an earlier query of the same printer
+  * configuration...
   */
 
   cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: Connected to %s:%d, sending Get-Printer-Attributes request...", printer->name, host, port);
@@ -5282,32 +5457,77 @@ create_local_bg_thread(
   request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
   ippSetVersion(request, 2, 0);
   ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer->device_uri);
-  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", (int)(sizeof(pattrs) / sizeof(pattrs[0])), NULL, pattrs);
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", (int)(sizeof(cattrs) / sizeof(cattrs[0])), NULL, cattrs);
+
+  response    = cupsDoRequest(http, request, resource);
+  uuid[0]     = '\0';
+  config_time = -1;
+
+  if (cupsLastError() <= IPP_STATUS_OK_CONFLICTING)
+  {
+    if ((attr = ippFindAttribute(response, "printer-uuid", IPP_TAG_URI)) != NULL && (ptr = ippGetString(attr, 0, NULL)) != NULL && !strncmp(ptr, "urn:uuid:", 9))
+    {
+      for (ptr += 9, uuidptr = uuid; *ptr && uuidptr < (uuid + sizeof(uuid) - 1); ptr ++)
+      {
+        if (isxdigit(*ptr & 255) || *ptr == '-')
+          *uuidptr++ = (char)tolower(*ptr & 255);
+	else
+	  break;
+      }
+
+      *uuidptr = '\0';
+
+      if (*ptr)
+        uuid[0] = '\0';			/* Not a valid UUID */
+    }
 
-  response = cupsDoRequest(http, request, resource);
-  status   = cupsLastError();
+    if ((attr = ippFindAttribute(response, "printer-config-change-time", IPP_TAG_INTEGER)) != NULL)
+      config_time = ippGetInteger(attr, 0);
+  }
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: Get-Printer-Attributes returned %s (%s)", printer->name, ippErrorString(cupsLastError()), cupsLastErrorString());
+  ippDelete(response);
 
-  if (status == IPP_STATUS_ERROR_BAD_REQUEST || status == IPP_STATUS_ERROR_VERSION_NOT_SUPPORTED)
+  if (uuid[0] && config_time >= 0 && (response = load_local_cache(uuid, config_time, fromppd, sizeof(fromppd))) != NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: Using cached attributes and PPD file \"%s\".", printer->name, fromppd);
+    cached = 1;
+  }
+  else
   {
    /*
-    * Try request using IPP/1.1, in case we are talking to an old CUPS server or
-    * printer...
+    * Query the printer for its capabilities...
     */
 
-    ippDelete(response);
-
-    cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: Re-sending Get-Printer-Attributes request using IPP/1.1...", printer->name);
-
     request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
-    ippSetVersion(request, 1, 1);
+    ippSetVersion(request, 2, 0);
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer->device_uri);
-    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", NULL, "all");
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", (int)(sizeof(pattrs) / sizeof(pattrs[0])), NULL, pattrs);
 
     response = cupsDoRequest(http, request, resource);
+    status   = cupsLastError();
 
-    cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: IPP/1.1 Get-Printer-Attributes returned %s (%s)", printer->name, ippErrorString(cupsLastError()), cupsLastErrorString());
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: Get-Printer-Attributes returned %s (%s)", printer->name, ippErrorString(cupsLastError()), cupsLastErrorString());
+
+    if (status == IPP_STATUS_ERROR_BAD_REQUEST || status == IPP_STATUS_ERROR_VERSION_NOT_SUPPORTED)
+    {
+     /*
+      * Try request using IPP/1.1, in case we are talking to an old CUPS server
+      * or printer...
+      */
+
+      ippDelete(response);
+
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: Re-sending Get-Printer-Attributes request using IPP/1.1...", printer->name);
+
+      request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+      ippSetVersion(request, 1, 1);
+      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer->device_uri);
+      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", NULL, "all");
+
+      response = cupsDoRequest(http, request, resource);
+
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "%s: IPP/1.1 Get-Printer-Attributes returned %s (%s)", printer->name, ippErrorString(cupsLastError()), cupsLastErrorString());
+    }
   }
 
   // TODO: Grab printer icon file...
@@ -5317,8 +5537,11 @@ create_local_bg_thread(
   * Write the PPD for the queue...
   */
 
-  if (_ppdCreateFromIPP(fromppd, sizeof(fromppd), response))
+  if (cached || _ppdCreateFromIPP(fromppd, sizeof(fromppd), response))
   {
+    if (!cached && uuid[0] && config_time >= 0)
+      save_local_cache(uuid, response, fromppd);
+
     _cupsRWLockWrite(&printer->lock);
 
     if ((!printer->info || !*(printer->info)) && (attr = ippFindAttribute(response, "printer-info", IPP_TAG_TEXT)) != NULL)
@@ -5332,10 +5555,17 @@ create_local_bg_thread(
 
     _cupsRWUnlock(&printer->lock);
 
-    if ((from = cupsFileOpen(fromppd, "r")) == NULL)
+    ippDelete(response);
+
+    from = cupsFileOpen(fromppd, "r");
+
+    if (!cached)
+      unlink(fromppd);
+
+    if (!from)
     {
       cupsdLogMessage(CUPSD_LOG_ERROR, "%s: Unable to read generated PPD: %s", printer->name, strerror(errno));
-      return (NULL);
+      return;
     }
 
     snprintf(toppd, sizeof(toppd), "%s/ppd/%s.ppd", ServerRoot, printer->name);
@@ -5343,7 +5573,7 @@ create_local_bg_thread(
     {
       cupsdLogMessage(CUPSD_LOG_ERROR, "%s: Unable to create PPD for printer: %s", printer->name, strerror(errno));
       cupsFileClose(from);
-      return (NULL);
+      return;
     }
 
     while (cupsFileGets(from, line, sizeof(line)))
@@ -5363,9 +5593,10 @@ create_local_bg_thread(
     }
   }
   else
+  {
     cupsdLogMessage(CUPSD_LOG_ERROR, "%s: PPD creation failed: %s", printer->name, cupsLastErrorString());
-
-  return (NULL);
+    ippDelete(response);
+  }
 }
 
 
@@ -5491,10 +5722,41 @@ create_local_printer(
   cupsdSetPrinterAttrs(printer);
 
  /*
-  * Run a background thread to create the PPD...
+  * Queue the printer for one of the background threads that create the PPD,
+  * starting another thread if we are below the limit...
   */
 
-  _cupsThreadCreate((_cups_thread_func_t)create_local_bg_thread, printer);
+  printer->local_pending = 1;
+
+  _cupsMutexLock(&local_mutex);
+
+  if (!local_queue)
+    local_queue = cupsArrayNew(NULL, NULL);
+
+  cupsArrayAdd(local_queue, printer);
+
+  if (local_workers < CUPSD_LOCAL_MAX_WORKERS)
+  {
+    _cups_thread_t	thread;		/* Worker thread */
+
+    if ((thread = _cupsThreadCreate((_cups_thread_func_t)create_local_bg_thread, NULL)) != 0)
+    {
+      _cupsThreadDetach(thread);
+      local_workers ++;
+    }
+    else
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start local printer thread: %s", strerror(errno));
+
+      if (!local_workers)
+      {
+        cupsArrayRemove(local_queue, printer);
+        printer->local_pending = 0;
+      }
+    }
+  }
+
+  _cupsMutexUnlock(&local_mutex);
 
  /*
   * Return printer attributes...
@@ -5915,7 +6177,8 @@ create_subscriptions(
 
     sub->interval = interval;
     sub->lease    = lease;
-    sub->expire   = lease ? time(NULL) + lease : 0;
+
+    cupsdSetSubscriptionExpire(sub, lease ? time(NULL) + lease : 0);
 
     cupsdSetString(&sub->owner, username);
 
@@ -6011,12 +6274,22 @@ delete_printer(cupsd_client_t  *con,	/* I - Client connection */
            printer->name);
   unlink(filename);
 
+  snprintf(filename, sizeof(filename), "%s/printers.d/%s.conf", ServerRoot,
+           printer->name);
+  unlink(filename);
+  snprintf(filename, sizeof(filename), "%s/printers.d/%s.conf.O", ServerRoot,
+           printer->name);
+  unlink(filename);
+
   snprintf(filename, sizeof(filename), "%s/%s.png", CacheDir, printer->name);
   unlink(filename);
 
   snprintf(filename, sizeof(filename), "%s/%s.data", CacheDir, printer->name);
   unlink(filename);
 
+  snprintf(filename, sizeof(filename), "%s/%s.snapshot", CacheDir, printer->name);
+  unlink(filename);
+
  /*
   * Unregister color profiles...
   */
@@ -6304,8 +6577,7 @@ get_document(cupsd_client_t  *con,	/* I - Client connection */
     return;
   }
 
-  snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, jobid,
-           docnum);
+  cupsdGetJobFilename(jobid, 'd', docnum, filename, sizeof(filename));
   if ((con->file = open(filename, O_RDONLY)) == -1)
   {
     cupsdLogMessage(CUPSD_LOG_ERROR,
@@ -6321,6 +6593,63 @@ get_document(cupsd_client_t  *con,	/* I - Client connection */
 
   cupsdLoadJob(job);
 
+  if (job->compressions && job->compressions[docnum - 1])
+  {
+   /*
+    * Send gzip'd documents as-is when the client can take them, otherwise
+    * decompress into a temporary file...
+    */
+
+    if ((attr = ippFindAttribute(con->request, "compression-accepted",
+                                 IPP_TAG_KEYWORD)) != NULL &&
+        ippContainsString(attr, "gzip"))
+    {
+      ippAddString(con->response, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+                   "compression", NULL, "gzip");
+    }
+    else
+    {
+      cups_file_t	*fp;		/* Compressed document */
+      int		tempfd;		/* Decompressed document */
+      char		tempfile[1024],	/* Temporary filename */
+			buffer[32768];	/* Copy buffer */
+      ssize_t		bytes;		/* Bytes read */
+
+      snprintf(tempfile, sizeof(tempfile), "%s/d%05d-%03d.XXXXXX", TempDir,
+               jobid, docnum);
+
+      if ((tempfd = mkstemp(tempfile)) < 0)
+      {
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Unable to create temporary file for document %d in "
+			"job %d - %s", docnum, jobid, strerror(errno));
+        close(con->file);
+	con->file = -1;
+	send_ipp_status(con, IPP_INTERNAL_ERROR,
+			_("Unable to open document #%d in job #%d."), docnum,
+			jobid);
+	return;
+      }
+
+      unlink(tempfile);
+      fcntl(tempfd, F_SETFD, fcntl(tempfd, F_GETFD) | FD_CLOEXEC);
+
+      if ((fp = cupsFileOpenFd(con->file, "r")) == NULL)
+        close(con->file);
+      else
+      {
+        while ((bytes = cupsFileRead(fp, buffer, sizeof(buffer))) > 0)
+	  if (write(tempfd, buffer, (size_t)bytes) < bytes)
+	    break;
+
+        cupsFileClose(fp);
+      }
+
+      con->file = tempfd;
+      lseek(tempfd, 0, SEEK_SET);
+    }
+  }
+
   snprintf(format, sizeof(format), "%s/%s", job->filetypes[docnum - 1]->super,
            job->filetypes[docnum - 1]->type);
 
@@ -6480,10 +6809,13 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 		need_load_job = 0;	/* Do we need to load the job? */
   const char	*job_attr;		/* Job attribute requested */
   ipp_attribute_t *job_ids;		/* job-ids attribute */
-  cupsd_job_t	*job;			/* Current job pointer */
+  cupsd_job_t	*job,			/* Current job pointer */
+		summary;		/* Summary of compacted job */
+  void		*element;		/* Current job or job record */
   cupsd_printer_t *printer;		/* Printer */
   cups_array_t	*list;			/* Which job list... */
-  int		delete_list = 0;	/* Delete the list afterwards? */
+  int		delete_list = 0,	/* List of job records to delete? */
+		all_jobs = 0;		/* List of all jobs by ID? */
   cups_array_t	*ra,			/* Requested attributes array */
 		*exclude;		/* Private attributes array */
   cupsd_policy_t *policy;		/* Current policy */
@@ -6583,27 +6915,29 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
   {
     job_comparison = 1;
     job_state      = IPP_JOB_CANCELED;
-    list           = cupsdGetCompletedJobs(printer);
+    list           = cupsdGetJobRecords(printer, 1);
     delete_list    = 1;
   }
   else if (!strcmp(attr->values[0].string.text, "aborted"))
   {
     job_comparison = 0;
     job_state      = IPP_JOB_ABORTED;
-    list           = cupsdGetCompletedJobs(printer);
+    list           = cupsdGetJobRecords(printer, 1);
     delete_list    = 1;
   }
   else if (!strcmp(attr->values[0].string.text, "all"))
   {
     job_comparison = 1;
     job_state      = IPP_JOB_PENDING;
-    list           = Jobs;
+    list           = cupsdGetJobRecords(NULL, 0);
+    delete_list    = 1;
+    all_jobs       = 1;
   }
   else if (!strcmp(attr->values[0].string.text, "canceled"))
   {
     job_comparison = 0;
     job_state      = IPP_JOB_CANCELED;
-    list           = cupsdGetCompletedJobs(printer);
+    list           = cupsdGetJobRecords(printer, 1);
     delete_list    = 1;
   }
   else if (!strcmp(attr->values[0].string.text, "pending"))
@@ -6700,7 +7034,9 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 
   ra = create_requested_array(con->request);
   for (job_attr = (char *)cupsArrayFirst(ra); job_attr; job_attr = (char *)cupsArrayNext(ra))
-    if (strcmp(job_attr, "job-id") &&
+    if (strcmp(job_attr, "date-time-at-completed") &&
+	strcmp(job_attr, "date-time-at-creation") &&
+	strcmp(job_attr, "job-id") &&
 	strcmp(job_attr, "job-k-octets") &&
 	strcmp(job_attr, "job-media-progress") &&
 	strcmp(job_attr, "job-more-info") &&
@@ -6709,6 +7045,7 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 	strcmp(job_attr, "job-preserved") &&
 	strcmp(job_attr, "job-printer-up-time") &&
         strcmp(job_attr, "job-printer-uri") &&
+	strcmp(job_attr, "job-priority") &&
 	strcmp(job_attr, "job-state") &&
 	strcmp(job_attr, "job-state-reasons") &&
 	strcmp(job_attr, "job-uri") &&
@@ -6720,7 +7057,7 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
       break;
     }
 
-  if (need_load_job && (limit == 0 || limit > 500) && (list == Jobs || delete_list))
+  if (need_load_job && (limit == 0 || limit > 500) && delete_list)
   {
    /*
     * Limit expensive Get-Jobs for job history to 500 jobs...
@@ -6785,13 +7122,52 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
   }
   else
   {
+    if (!list)
+    {
+      send_ipp_status(con, IPP_INTERNAL_ERROR, _("Out of memory."));
+      cupsArrayDelete(ra);
+      return;
+    }
+
     if (first_index > 1)
-      job = (cupsd_job_t *)cupsArrayIndex(list, first_index - 1);
+      element = cupsArrayIndex(list, first_index - 1);
+    else if (first_job_id > 1 && all_jobs)
+    {
+     /*
+      * All jobs are sorted by ID, so resume directly at the first job at or
+      * after first-job-id rather than walking the history from the start...
+      */
+
+      int	low,			/* Low index */
+		high,			/* High index */
+		middle;			/* Middle index */
+
+      for (low = 0, high = cupsArrayCount(list); low < high;)
+      {
+        middle = (low + high) / 2;
+
+        if (((cupsd_jobrec_t *)cupsArrayIndex(list, middle))->id < first_job_id)
+          low = middle + 1;
+	else
+	  high = middle;
+      }
+
+      element = cupsArrayIndex(list, low);
+    }
     else
-      job = (cupsd_job_t *)cupsArrayFirst(list);
+      element = cupsArrayFirst(list);
 
-    for (count = 0; (limit <= 0 || count < limit) && job; job = (cupsd_job_t *)cupsArrayNext(list))
+    for (count = 0; (limit <= 0 || count < limit) && element; element = cupsArrayNext(list))
     {
+     /*
+      * Job history lists have a summary of compacted jobs...
+      */
+
+      if (delete_list)
+        job = cupsdGetRecordJob((cupsd_jobrec_t *)element, &summary);
+      else
+        job = (cupsd_job_t *)element;
+
      /*
       * Filter out jobs that don't match...
       */
@@ -6802,7 +7178,12 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 		      job->username, job->state_value, job->attrs);
 
       if (!job->dest || !job->username)
+      {
+        if (job == &summary && (job = cupsdFindJob(summary.id)) == NULL)
+	  continue;
+
 	cupsdLoadJob(job);
+      }
 
       if (!job->dest || !job->username)
 	continue;
@@ -6822,8 +7203,14 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
       if (job->id < first_job_id)
 	continue;
 
+      if (username[0] && _cups_strcasecmp(username, job->username))
+	continue;
+
       if (need_load_job && !job->attrs)
       {
+        if (job == &summary && (job = cupsdFindJob(summary.id)) == NULL)
+	  continue;
+
         cupsdLoadJob(job);
 
 	if (!job->attrs)
@@ -6833,9 +7220,6 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 	}
       }
 
-      if (username[0] && _cups_strcasecmp(username, job->username))
-	continue;
-
       if (count > 0)
 	ippAddSeparator(con->response);
 
@@ -6855,7 +7239,7 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
   cupsArrayDelete(ra);
 
   if (delete_list)
-    cupsArrayDelete(list);
+    cupsdFreeJobRecords(list);
 
   con->response->request.status.status_code = IPP_OK;
 }
@@ -6866,19 +7250,21 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
  */
 
 static void
-get_notifications(cupsd_client_t *con)	/* I - Client connection */
+get_notifications(cupsd_client_t *con,	/* I - Client connection */
+                  int            wait)	/* I - Wait for new events? */
 {
   int			i, j;		/* Looping vars */
   http_status_t		status;		/* Policy status */
   cupsd_subscription_t	*sub;		/* Subscription */
+  cupsd_event_t		*event;		/* Current event */
   ipp_attribute_t	*ids,		/* notify-subscription-ids */
 			*sequences;	/* notify-sequence-numbers */
   int			min_seq;	/* Minimum sequence number */
   int			interval;	/* Poll interval */
 
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "get_notifications(con=%p[%d])",
-                  con, con->number);
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "get_notifications(con=%p[%d], wait=%d)",
+                  con, con->number, wait);
 
  /*
   * Get subscription attributes...
@@ -6939,6 +7325,43 @@ get_notifications(cupsd_client_t *con)	/* I - Client connection */
       interval = 30;
   }
 
+ /*
+  * If the client asked us to wait and there are no new events, park the
+  * connection until cupsd_send_notification() wakes it up or the wait times
+  * out...
+  */
+
+  if (wait && interval > 0 && ippGetBoolean(ippFindAttribute(con->request, "notify-wait", IPP_TAG_BOOLEAN), 0))
+  {
+    for (i = 0; i < ids->num_values; i ++)
+    {
+      sub = cupsdFindSubscription(ids->values[i].integer);
+
+      if (sequences && i < sequences->num_values)
+	min_seq = sequences->values[i].integer;
+      else
+	min_seq = 1;
+
+      if (min_seq < (sub->first_event_id + cupsArrayCount(sub->events)))
+        break;
+    }
+
+    if (i >= ids->num_values)
+    {
+      if (!NotifyWaiters)
+        NotifyWaiters = cupsArrayNew(NULL, NULL);
+
+      if (cupsArrayAdd(NotifyWaiters, con))
+      {
+	con->notify_wait  = time(NULL) + Timeout / 2;
+	con->notify_ready = 0;
+
+	cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting up to %d seconds for events.", Timeout / 2);
+	return;
+      }
+    }
+  }
+
  /*
   * Tell the client to poll again in N seconds...
   */
@@ -6990,9 +7413,12 @@ get_notifications(cupsd_client_t *con)	/* I - Client connection */
     {
       ippAddSeparator(con->response);
 
-      copy_attrs(con->response,
-                 ((cupsd_event_t *)cupsArrayIndex(sub->events, j))->attrs, NULL,
-        	 IPP_TAG_EVENT_NOTIFICATION, 0, NULL);
+      event = (cupsd_event_t *)cupsArrayIndex(sub->events, j);
+
+      copy_attrs(con->response, event->attrs, NULL,
+                 IPP_TAG_EVENT_NOTIFICATION, 0, NULL);
+      copy_attrs(con->response, event->shared_attrs, NULL,
+                 IPP_TAG_EVENT_NOTIFICATION, 0, NULL);
     }
   }
 }
@@ -7545,7 +7971,28 @@ get_printers(cupsd_client_t *con,	/* I - Client connection */
   if (first_printer_name)
   {
     if ((printer = cupsdFindDest(first_printer_name)) == NULL)
-      printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
+    {
+     /*
+      * The printer went away since the last request, resume with the next
+      * printer in name order...
+      */
+
+      int	low,			/* Low index */
+		high,			/* High index */
+		middle;			/* Middle index */
+
+      for (low = 0, high = cupsArrayCount(Printers); low < high;)
+      {
+        middle = (low + high) / 2;
+
+        if (_cups_strcasecmp(((cupsd_printer_t *)cupsArrayIndex(Printers, middle))->name, first_printer_name) < 0)
+          low = middle + 1;
+	else
+	  high = middle;
+      }
+
+      printer = (cupsd_printer_t *)cupsArrayIndex(Printers, low);
+    }
   }
   else
     printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
@@ -7597,6 +8044,56 @@ get_printers(cupsd_client_t *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'get_statistics()' - Get the scheduler memory statistics.
+ */
+
+static void
+get_statistics(cupsd_client_t *con)	/* I - Client connection */
+{
+  http_status_t		status;		/* Policy status */
+  cupsd_memtype_t	type;		/* Current subsystem */
+  cupsd_memusage_t	usage[CUPSD_MEM_MAX];
+					/* Memory usage by subsystem */
+  size_t		total = 0;	/* Total bytes */
+  char			name[256];	/* Attribute name */
+
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "get_statistics(%p[%d])", con, con->number);
+
+ /*
+  * Check policy...
+  */
+
+  if ((status = cupsdCheckPolicy(DefaultPolicyPtr, con, NULL)) != HTTP_OK)
+  {
+    send_http_error(con, status, NULL);
+    return;
+  }
+
+ /*
+  * Report the object count and size in kilobytes for each subsystem...
+  */
+
+  cupsdGetMemoryUsage(usage);
+
+  for (type = CUPSD_MEM_CLIENTS; type < CUPSD_MEM_MAX; type ++)
+  {
+    snprintf(name, sizeof(name), "cups-memory-%s-count", usage[type].name);
+    ippAddInteger(con->response, IPP_TAG_SYSTEM, IPP_TAG_INTEGER, name, usage[type].count);
+
+    snprintf(name, sizeof(name), "cups-memory-%s-kbytes", usage[type].name);
+    ippAddInteger(con->response, IPP_TAG_SYSTEM, IPP_TAG_INTEGER, name, usage[type].bytes / 1024 > INT_MAX ? INT_MAX : (int)(usage[type].bytes / 1024));
+
+    total += usage[type].bytes;
+  }
+
+  ippAddInteger(con->response, IPP_TAG_SYSTEM, IPP_TAG_INTEGER, "cups-memory-total-kbytes", total / 1024 > INT_MAX ? INT_MAX : (int)(total / 1024));
+
+  con->response->request.status.status_code = IPP_STATUS_OK;
+}
+
+
 /*
  * 'get_subscription_attrs()' - Get subscription attributes.
  */
@@ -8053,6 +8550,48 @@ hold_new_jobs(cupsd_client_t  *con,	/* I - Connection */
 }
 
 
+/*
+ * 'load_local_cache()' - Load cached attributes and PPD file for a local printer.
+ */
+
+static ipp_t *				/* O - Cached printer attributes or NULL */
+load_local_cache(const char *uuid,	/* I - Sanitized printer-uuid value */
+                 int        config_time,/* I - printer-config-change-time value */
+                 char       *ppdfile,	/* I - PPD filename buffer */
+		 size_t     ppdsize)	/* I - Size of PPD filename buffer */
+{
+  cups_file_t	*fp;			/* Attribute file */
+  char		filename[1024];		/* Attribute filename */
+  ipp_t		*response;		/* Cached attributes */
+  ipp_state_t	state;			/* Read state */
+
+
+  snprintf(ppdfile, ppdsize, "%s/ipp-%s.ppd", CacheDir, uuid);
+  if (access(ppdfile, R_OK))
+    return (NULL);
+
+  snprintf(filename, sizeof(filename), "%s/ipp-%s.ipp", CacheDir, uuid);
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+    return (NULL);
+
+  response = ippNew();
+
+  while ((state = ippReadIO(fp, (ipp_iocb_t)cupsFileRead, 1, NULL, response)) != IPP_STATE_DATA)
+    if (state == IPP_STATE_ERROR)
+      break;
+
+  cupsFileClose(fp);
+
+  if (state != IPP_STATE_DATA || ippGetInteger(ippFindAttribute(response, "printer-config-change-time", IPP_TAG_INTEGER), 0) != config_time)
+  {
+    ippDelete(response);
+    return (NULL);
+  }
+
+  return (response);
+}
+
+
 /*
  * 'move_job()' - Move a job to a new destination.
  */
@@ -8614,7 +9153,7 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   if (add_file(con, job, filetype, compression))
     return;
 
-  snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, job->id, job->num_files);
+  cupsdGetJobFilename(job->id, 'd', job->num_files, filename, sizeof(filename));
   if (rename(con->filename, filename))
   {
     cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to rename job document file \"%s\": %s", filename, strerror(errno));
@@ -8624,6 +9163,7 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   }
 
   cupsdClearString(&con->filename);
+  cupsdShareJobFile(job, job->num_files, con->file_hash);
 
  /*
   * See if we need to add the ending sheet...
@@ -8693,8 +9233,7 @@ read_job_ticket(cupsd_client_t *con)	/* I - Client connection */
   cups_option_t		*options;	/* Options */
   ipp_t			*ticket;	/* New attributes */
   ipp_attribute_t	*attr,		/* Current attribute */
-			*attr2,		/* Job attribute */
-			*prev2;		/* Previous job attribute */
+			*attr2;		/* Job attribute */
 
 
  /*
@@ -8802,25 +9341,7 @@ read_job_ticket(cupsd_client_t *con)	/* I - Client connection */
       * Some other value; first free the old value...
       */
 
-      if (con->request->attrs == attr2)
-      {
-	con->request->attrs = attr2->next;
-	prev2               = NULL;
-      }
-      else
-      {
-	for (prev2 = con->request->attrs; prev2; prev2 = prev2->next)
-	  if (prev2->next == attr2)
-	  {
-	    prev2->next = attr2->next;
-	    break;
-	  }
-      }
-
-      if (con->request->last == attr2)
-        con->request->last = prev2;
-
-      ippDeleteAttribute(NULL, attr2);
+      ippDeleteAttribute(con->request, attr2);
     }
 
    /*
@@ -8907,7 +9428,7 @@ reject_jobs(cupsd_client_t  *con,	/* I - Client connection */
   }
   else
   {
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkPrinterDirty(printer);
 
     cupsdLogMessage(CUPSD_LOG_INFO, "Printer \"%s\" rejecting jobs (\"%s\").",
                     printer->name, get_username(con));
@@ -8933,6 +9454,8 @@ release_held_new_jobs(
   http_status_t		status;		/* Policy status */
   cups_ptype_t		dtype;		/* Destination type (printer/class) */
   cupsd_printer_t	*printer;	/* Printer data */
+  cupsd_job_t		*job;		/* Current job */
+  const char		*reasons;	/* job-state-reasons value */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "release_held_new_jobs(%p[%d], %s)", con,
@@ -8971,6 +9494,17 @@ release_held_new_jobs(
 
   cupsdSetPrinterReasons(printer, "-hold-new-jobs");
 
+  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+  {
+    reasons = ippGetString(job->reasons, 0, NULL);
+
+    if (reasons && !strcmp(reasons, "job-held-on-create") &&
+        !_cups_strcasecmp(job->dest, printer->name))
+      ippSetString(job->attrs, &job->reasons, 0, "none");
+  }
+
   if (dtype & CUPS_PRINTER_CLASS)
     cupsdLogMessage(CUPSD_LOG_INFO,
                     "Class \"%s\" now printing pending/new jobs (\"%s\").",
@@ -9203,7 +9737,7 @@ renew_subscription(
     sub->lease = MaxLeaseDuration;
   }
 
-  sub->expire = sub->lease ? time(NULL) + sub->lease : 0;
+  cupsdSetSubscriptionExpire(sub, sub->lease ? time(NULL) + sub->lease : 0);
 
   cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
 
@@ -9425,7 +9959,7 @@ save_auth_info(
   * Create the authentication file and change permissions...
   */
 
-  snprintf(filename, sizeof(filename), "%s/a%05d", RequestRoot, job->id);
+  cupsdGetJobFilename(job->id, 'a', 0, filename, sizeof(filename));
   if ((fp = cupsFileOpen(filename, "w")) == NULL)
   {
     cupsdLogMessage(CUPSD_LOG_ERROR,
@@ -9544,6 +10078,85 @@ save_auth_info(
 }
 
 
+/*
+ * 'save_local_cache()' - Save the attributes and PPD file for a local printer.
+ */
+
+static void
+save_local_cache(const char *uuid,	/* I - Sanitized printer-uuid value */
+                 ipp_t      *response,	/* I - Printer attributes */
+		 const char *ppdfile)	/* I - Generated PPD file */
+{
+  cups_file_t	*from,			/* Source file */
+		*to;			/* Destination file */
+  char		filename[1024],		/* Cache filename */
+		tempfile[1024],		/* Temporary filename */
+		line[1024];		/* Line from PPD */
+  int		error;			/* Write error? */
+  ipp_state_t	state;			/* Write state */
+
+
+ /*
+  * Write the attributes...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/ipp-%s.ipp", CacheDir, uuid);
+  snprintf(tempfile, sizeof(tempfile), "%s/ipp-%s.ipp.N", CacheDir, uuid);
+
+  if ((to = cupsFileOpen(tempfile, "w")) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create \"%s\": %s", tempfile, strerror(errno));
+    return;
+  }
+
+  ippSetState(response, IPP_STATE_IDLE);
+
+  while ((state = ippWriteIO(to, (ipp_iocb_t)cupsFileWrite, 1, NULL, response)) != IPP_STATE_DATA)
+    if (state == IPP_STATE_ERROR)
+      break;
+
+  error = cupsFileClose(to) || state != IPP_STATE_DATA;
+
+  if (error || rename(tempfile, filename))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write \"%s\": %s", filename, strerror(errno));
+    unlink(tempfile);
+    return;
+  }
+
+ /*
+  * Then copy the PPD file...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/ipp-%s.ppd", CacheDir, uuid);
+  snprintf(tempfile, sizeof(tempfile), "%s/ipp-%s.ppd.N", CacheDir, uuid);
+
+  if ((from = cupsFileOpen(ppdfile, "r")) == NULL)
+    return;
+
+  if ((to = cupsFileOpen(tempfile, "w")) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create \"%s\": %s", tempfile, strerror(errno));
+    cupsFileClose(from);
+    return;
+  }
+
+  error = 0;
+
+  while (cupsFileGets(from, line, sizeof(line)))
+    if (cupsFilePrintf(to, "%s\n", line) < 0)
+      error = 1;
+
+  cupsFileClose(from);
+
+  if (cupsFileClose(to) || error || rename(tempfile, filename))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write \"%s\": %s", filename, strerror(errno));
+    unlink(tempfile);
+  }
+}
+
+
 /*
  * 'send_document()' - Send a file to a printer or class.
  */
@@ -9857,7 +10470,7 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
   if ((attr = ippFindAttribute(job->attrs, "job-k-octets", IPP_TAG_INTEGER)) != NULL)
     attr->values[0].integer += kbytes;
 
-  snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, job->id, job->num_files);
+  cupsdGetJobFilename(job->id, 'd', job->num_files, filename, sizeof(filename));
   if (rename(con->filename, filename))
   {
     cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to rename job document file \"%s\": %s", filename, strerror(errno));
@@ -9867,6 +10480,7 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
   }
 
   cupsdClearString(&con->filename);
+  cupsdShareJobFile(job, job->num_files, con->file_hash);
 
   cupsdLogJob(job, CUPSD_LOG_INFO, "File of type %s/%s queued by \"%s\".",
 	      filetype->super, filetype->type, job->username);
@@ -9912,6 +10526,8 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
 	ippSetString(job->attrs, &job->reasons, 0, "job-hold-until-specified");
     }
 
+    cupsdUpdateJobQueues(job);
+
     job->dirty = 1;
     cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
@@ -9931,6 +10547,8 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
 
       ippSetString(job->attrs, &job->reasons, 0, "job-incoming");
 
+      cupsdUpdateJobQueues(job);
+
       job->dirty = 1;
       cupsdMarkDirty(CUPSD_DIRTY_JOBS);
     }
@@ -10091,6 +10709,89 @@ send_ipp_status(cupsd_client_t *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'send_response()' - Send the IPP response to the client.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+send_response(cupsd_client_t  *con,	/* I - Client connection */
+              ipp_attribute_t *uri)	/* I - Printer or job URI attribute */
+{
+  if (con->response)
+  {
+   /*
+    * Sending data from the scheduler...
+    */
+
+    cupsdLogClient(con, con->response->request.status.status_code >= IPP_STATUS_ERROR_BAD_REQUEST && con->response->request.status.status_code != IPP_STATUS_ERROR_NOT_FOUND ? CUPSD_LOG_ERROR : CUPSD_LOG_DEBUG, "Returning IPP %s for %s (%s) from %s.",  ippErrorString(con->response->request.status.status_code), ippOpString(con->request->request.op.operation_id), uri ? uri->values[0].string.text : "no URI", con->http->hostname);
+
+    httpClearFields(con->http);
+
+#ifdef CUPSD_USE_CHUNKING
+   /*
+    * Because older versions of CUPS (1.1.17 and older) and some IPP
+    * clients do not implement chunking properly, we cannot use
+    * chunking by default.  This may become the default in future
+    * CUPS releases, or we might add a configuration directive for
+    * it.
+    */
+
+    if (con->http->version == HTTP_1_1)
+    {
+      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Transfer-Encoding: chunked");
+      cupsdSetLength(con->http, 0);
+    }
+    else
+#endif /* CUPSD_USE_CHUNKING */
+    {
+      size_t	length;			/* Length of response */
+
+
+      length = ippLength(con->response);
+
+      if (con->file >= 0 && !con->pipe_pid)
+      {
+	struct stat	fileinfo;	/* File information */
+
+	if (!fstat(con->file, &fileinfo))
+	  length += (size_t)fileinfo.st_size;
+      }
+
+      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Content-Length: " CUPS_LLFMT, CUPS_LLCAST length);
+      httpSetLength(con->http, length);
+    }
+
+    if (cupsdSendHeader(con, HTTP_OK, "application/ipp", CUPSD_AUTH_NONE))
+    {
+     /*
+      * Tell the caller the response header was sent successfully...
+      */
+
+      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, (cupsd_selfunc_t)cupsdWriteClient, con);
+
+      return (1);
+    }
+    else
+    {
+     /*
+      * Tell the caller the response header could not be sent...
+      */
+
+      return (0);
+    }
+  }
+  else
+  {
+   /*
+    * Sending data from a subprocess like cups-deviced; tell the caller
+    * everything is A-OK so far...
+    */
+
+    return (1);
+  }
+}
+
+
 /*
  * 'set_default()' - Set the default destination...
  */
@@ -10468,15 +11169,7 @@ set_job_attrs(cupsd_client_t  *con,	/* I - Client connection */
       * Some other value; first free the old value...
       */
 
-      if (job->attrs->prev)
-        job->attrs->prev->next = attr2->next;
-      else
-        job->attrs->attrs = attr2->next;
-
-      if (job->attrs->last == attr2)
-        job->attrs->last = job->attrs->prev;
-
-      ippDeleteAttribute(NULL, attr2);
+      ippDeleteAttribute(job->attrs, attr2);
 
      /*
       * Then copy the attribute...
@@ -10493,15 +11186,7 @@ set_job_attrs(cupsd_client_t  *con,	/* I - Client connection */
       if ((attr2 = ippFindAttribute(job->attrs, attr->name,
                                     IPP_TAG_ZERO)) != NULL)
       {
-        if (job->attrs->prev)
-	  job->attrs->prev->next = attr2->next;
-	else
-	  job->attrs->attrs = attr2->next;
-
-        if (attr2 == job->attrs->last)
-	  job->attrs->last = job->attrs->prev;
-
-        ippDeleteAttribute(NULL, attr2);
+        ippDeleteAttribute(job->attrs, attr2);
 
         event |= CUPSD_EVENT_JOB_CONFIG_CHANGED;
       }
@@ -10540,8 +11225,11 @@ set_job_attrs(cupsd_client_t  *con,	/* I - Client connection */
 		      "Job held by user." : "Job restarted by user.");
 
   if (event & CUPSD_EVENT_JOB_CONFIG_CHANGED)
+  {
+    cupsdDiscardPrerender(job);
     cupsdAddEvent(CUPSD_EVENT_JOB_CONFIG_CHANGED, cupsdFindDest(job->dest), job,
                   "Job options changed by user.");
+  }
 
  /*
   * Start jobs if possible...
@@ -10640,7 +11328,7 @@ set_printer_attrs(cupsd_client_t  *con,	/* I - Client connection */
     printer->config_time = time(NULL);
 
     cupsdSetPrinterAttrs(printer);
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    cupsdMarkPrinterDirty(printer);
 
     cupsdAddEvent(CUPSD_EVENT_PRINTER_CONFIG, printer, NULL,
                   "Printer \"%s\" description or location changed by \"%s\".",
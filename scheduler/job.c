@@ -16,6 +16,8 @@
 #include <grp.h>
 #include <cups/backend.h>
 #include <cups/dir.h>
+#include <sys/mman.h>
+#include <poll.h>
 #ifdef __APPLE__
 #  include <IOKit/pwr_mgt/IOPMLib.h>
 #  ifdef HAVE_IOKIT_PWR_MGT_IOPMLIBPRIVATE_H
@@ -96,6 +98,72 @@
  */
 
 
+/*
+ * Local constants...
+ */
+
+#define CUPSD_JOB_MAX_READS	16	/* Max status reads per update_job */
+#define CUPSD_JOBLOAD_THREADS	8	/* Maximum number of job loading threads */
+#define CUPSD_JOBLOAD_WINDOW	1024	/* Maximum control files read ahead */
+#define CUPSD_JOB_SHARD_SIZE	1000	/* Job IDs per hashed spool directory */
+#define CUPSD_JOB_SLICE_USECS	100000	/* Max time per history cleaning pass */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_compress_s		/**** Document compression request ****/
+{
+  int		id,			/* Job ID */
+		number,			/* Document number */
+		status;			/* 0 on success, errno or -1 on failure */
+  off_t		size,			/* Original size */
+		compsize;		/* Compressed size */
+  char		filename[1024],		/* Document file */
+		tempfile[1056];		/* Compressed document file */
+} cupsd_compress_t;
+
+typedef struct cupsd_docref_s		/**** Shared document in the store ****/
+{
+  unsigned	hash;			/* Hash of document data */
+  off_t		size;			/* Size of document */
+  dev_t		dev;			/* Device of document file */
+  ino_t		ino;			/* Inode of document file */
+  char		filename[1024];		/* Store filename */
+} cupsd_docref_t;
+
+typedef struct cupsd_rendered_s		/**** Cached rendered output ****/
+{
+  char		key[65];		/* Render cache key */
+  off_t		size;			/* Size of output */
+  time_t	used;			/* Last time output was used */
+} cupsd_rendered_t;
+
+typedef struct cupsd_filterusage_s	/**** Resource usage of a program ****/
+{
+  char		name[64];		/* Program name */
+  int		count;			/* Number of runs */
+  double	wall,			/* Total elapsed time in seconds */
+		user,			/* Total user CPU time in seconds */
+		sys;			/* Total system CPU time in seconds */
+  long		maxrss;			/* Largest resident set in kbytes */
+} cupsd_filterusage_t;
+
+typedef struct cupsd_jobload_s		/**** Control file read at startup ****/
+{
+  cupsd_job_t	*job;			/* Job */
+  ipp_t		*attrs;			/* Job attributes or NULL on error */
+  int		done;			/* Has the control file been read? */
+} cupsd_jobload_t;
+
+typedef struct cupsd_jobmap_s		/**** Mapped job control file ****/
+{
+  const ipp_uchar_t	*ptr,		/* Current position in mapping */
+			*end;		/* End of mapping */
+} cupsd_jobmap_t;
+
+
 /*
  * Local globals...
  */
@@ -107,33 +175,133 @@ static mime_filter_t	gziptoany_filter =
 			  0,		/* Cost */
 			  "gziptoany"	/* Filter program to run */
 			};
+static int		journal_records = -1,
+					/* Number of job.journal records, -1 for
+					 * none (write job.cache next time) */
+			num_journal_deleted = 0,
+					/* Number of deleted job IDs */
+			alloc_journal_deleted = 0,
+					/* Allocated deleted job IDs */
+			*journal_deleted = NULL;
+					/* Deleted job IDs not yet journaled */
+static int		spool_shard = -1;
+					/* Last hashed spool directory created */
+static cups_array_t	*compress_queue = NULL,
+					/* Documents waiting to be compressed */
+			*compress_done = NULL;
+					/* Documents that have been compressed */
+static _cups_mutex_t	compress_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for compression arrays */
+static _cups_cond_t	compress_cond = _CUPS_COND_INITIALIZER;
+					/* Condition for new compression requests */
+static int		compress_pipe[2] = { -1, -1 };
+					/* Pipe for finished compression requests */
+static cups_array_t	*doc_hashes = NULL,
+					/* Shared documents by hash and size */
+			*doc_inodes = NULL;
+					/* Shared documents by inode */
+static int		doc_serial = 0;	/* Last store filename serial number */
+static int		purge_serial = 0;
+					/* Last purge filename serial number */
+static off_t		prerender_total = 0;
+					/* Size of all pre-rendered output */
+static cups_array_t	*render_cache = NULL;
+					/* Cached rendered output by key */
+static off_t		render_cache_total = 0;
+					/* Size of cached rendered output */
+static cups_array_t	*filter_usage = NULL;
+					/* Resource usage by program name */
+static cupsd_jobload_t	*job_loads = NULL;
+					/* Control files being read at startup */
+static int		job_loads_count = 0,
+					/* Number of control files */
+			job_loads_next = 0,
+					/* Next control file to read */
+			job_loads_used = 0;
+					/* Next control file to attach */
+static _cups_mutex_t	job_loads_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for control file loading */
+static _cups_cond_t	job_loads_cond = _CUPS_COND_INITIALIZER;
+					/* Condition for control file changes */
+static _cups_thread_t	job_loads_threads[CUPSD_JOBLOAD_THREADS];
+					/* Control file loading threads */
+static int		job_loads_num_threads = 0;
+					/* Number of loading threads */
 
 
 /*
  * Local functions...
  */
 
+static void	add_job_usage(cupsd_job_t *job, int pid,
+		              const char *command);
+static int	add_render_cache(cupsd_job_t *job, off_t size);
+static int	can_prerender(cupsd_job_t *job);
+static int	compact_job(cupsd_job_t *job);
 static int	compare_active_jobs(void *first, void *second, void *data);
-static int	compare_completed_jobs(void *first, void *second, void *data);
+static int	compare_completed_records(void *first, void *second,
+		                          void *data);
+static int	compare_doc_hashes(cupsd_docref_t *a, cupsd_docref_t *b,
+		                   void *data);
+static int	compare_doc_inodes(cupsd_docref_t *a, cupsd_docref_t *b,
+		                   void *data);
+static int	compare_filter_usage(cupsd_filterusage_t *a,
+		                     cupsd_filterusage_t *b, void *data);
 static int	compare_jobs(void *first, void *second, void *data);
+static int	compare_queues(void *first, void *second, void *data);
+static int	compare_records(void *first, void *second, void *data);
+static int	compare_rendered(cupsd_rendered_t *a, cupsd_rendered_t *b,
+		                 void *data);
+static int	compare_timeout_jobs(void *first, void *second, void *data);
+static void	*compress_documents(void *data);
 static void	dump_job_history(cupsd_job_t *job);
 static void	finalize_job(cupsd_job_t *job, int set_job_state);
+static int	find_render_cache(cupsd_job_t *job,
+		                  cupsd_printer_t *printer);
+static void	finish_compression(void *data);
+static void	finish_job_loads(void);
+static void	finish_job_usage(cupsd_job_t *job);
 static void	free_job_history(cupsd_job_t *job);
+static ipp_t	*get_job_load(cupsd_job_t *job);
 static char	*get_options(cupsd_job_t *job, int banner_page, char *copies,
 		             size_t copies_size, char *title,
 			     size_t title_size);
+static char	*get_render_filename(cupsd_job_t *job, const char *ext,
+		                     char *buffer, size_t bufsize);
+static char	*get_render_key(cupsd_job_t *job, cupsd_printer_t *printer,
+		                char *buffer, size_t bufsize);
+static cups_array_t *get_request_dirs(void);
 static size_t	ipp_length(ipp_t *ipp);
-static void	load_job_cache(const char *filename);
+static int	load_doc_store(void);
+static void	load_job_cache(const char *filename, const char *journal);
+static void	*load_job_thread(void *data);
 static void	load_next_job_id(const char *filename);
 static void	load_request_root(void);
+static int	make_request_dir(int id);
+static void	migrate_request_root(void);
+static void	prerender_jobs(void);
+static void	purge_file(const char *filename);
+static void	queue_compression(cupsd_job_t *job);
+static int	read_job_attrs(ipp_t *attrs, cups_file_t *fp);
+static void	read_job_cache(cups_file_t *fp, const char *filename,
+		               int journal);
+static ssize_t	read_mapped_attrs(cupsd_jobmap_t *map, ipp_uchar_t *buffer,
+		                  size_t bytes);
+static void	release_document(struct stat *fileinfo);
 static void	remove_job_files(cupsd_job_t *job);
 static void	remove_job_history(cupsd_job_t *job);
+static int	same_contents(const char *a, const char *b);
+static void	send_prerender_log(cupsd_job_t *job);
 static void	set_time(cupsd_job_t *job, const char *name);
+static int	slice_expired(struct timeval *start);
 static void	start_job(cupsd_job_t *job, cupsd_printer_t *printer);
+static void	start_job_loads(cups_array_t *jobs);
+static void	start_prerender(cupsd_job_t *job, cupsd_printer_t *printer);
 static void	stop_job(cupsd_job_t *job, cupsd_jobaction_t action);
 static void	unload_job(cupsd_job_t *job);
 static void	update_job(cupsd_job_t *job);
 static void	update_job_attrs(cupsd_job_t *job, int do_message);
+static void	write_job_cache(cups_file_t *fp, cupsd_job_t *job);
 
 
 /*
@@ -147,7 +315,7 @@ cupsdAddJob(int        priority,	/* I - Job priority */
   cupsd_job_t	*job;			/* New job record */
 
 
-  if ((job = calloc(sizeof(cupsd_job_t), 1)) == NULL)
+  if ((job = cupsdSlabAlloc(CUPSD_SLAB_JOB)) == NULL)
     return (NULL);
 
   job->id              = NextJobId ++;
@@ -163,6 +331,13 @@ cupsdAddJob(int        priority,	/* I - Job priority */
 
   cupsdSetString(&job->dest, dest);
 
+ /*
+  * Make sure the spool directory for the job's files exists...
+  */
+
+  if (SpoolLayout == CUPSD_SPOOL_HASHED)
+    make_request_dir(job->id);
+
  /*
   * Add the new job to the "all jobs" and "active jobs" lists...
   */
@@ -174,6 +349,205 @@ cupsdAddJob(int        priority,	/* I - Job priority */
 }
 
 
+/*
+ * 'cupsdAdoptJob()' - Continue a job that was printing before an upgrade.
+ *
+ * The value is a "Job" line written by cupsdHandoffJobs().  The filter and
+ * backend processes of the job are still running as children of the
+ * scheduler, so the job only needs its printer, pipes, and state back.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+cupsdAdoptJob(char *value)		/* I - Saved job state */
+{
+  int			i,		/* Looping var */
+			id,		/* Job ID */
+			cost,		/* Filtering cost */
+			pending_cost,	/* Waiting for FilterLimit */
+			current_file,	/* Current file in job */
+			status,		/* Status code from filters */
+			progress,	/* Printing progress */
+			tries,		/* Number of tries */
+			backend,	/* Backend process ID */
+			fds[8],		/* Status, print, back, and side pipes */
+			filters[MAX_FILTERS + 1],
+					/* Filter process IDs */
+			pid,		/* Filter process ID */
+			bufused;	/* Bytes in status buffer */
+  time_t		cancel_time,	/* When to cancel the job */
+			kill_time;	/* When to kill the job */
+  char			*ptr,		/* Pointer into value */
+			*name;		/* Printer name */
+  cupsd_job_t		*job;		/* Job */
+  cupsd_printer_t	*printer;	/* Printer */
+
+
+ /*
+  * Parse the saved state: "id printer cost pending-cost current-file status
+  * progress tries cancel-time kill-time backend fds[8] filters... 0
+  * bufused buffer"
+  */
+
+  id   = (int)strtol(value, &ptr, 10);
+  name = ptr;
+
+  while (_cups_isspace(*name))
+    name ++;
+
+  for (ptr = name; *ptr && !_cups_isspace(*ptr); ptr ++);
+
+  if (*ptr)
+    *ptr++ = '\0';
+
+  cost         = (int)strtol(ptr, &ptr, 10);
+  pending_cost = (int)strtol(ptr, &ptr, 10);
+  current_file = (int)strtol(ptr, &ptr, 10);
+  status       = (int)strtol(ptr, &ptr, 10);
+  progress     = (int)strtol(ptr, &ptr, 10);
+  tries        = (int)strtol(ptr, &ptr, 10);
+  cancel_time  = (time_t)strtol(ptr, &ptr, 10);
+  kill_time    = (time_t)strtol(ptr, &ptr, 10);
+  backend      = (int)strtol(ptr, &ptr, 10);
+
+  for (i = 0; i < 8; i ++)
+    fds[i] = (int)strtol(ptr, &ptr, 10);
+
+  for (i = 0; (pid = (int)strtol(ptr, &ptr, 10)) != 0;)
+    if (i < MAX_FILTERS)
+      filters[i ++] = pid;
+
+  filters[i] = 0;
+
+  bufused = (int)strtol(ptr, &ptr, 10);
+
+  if (*ptr == ' ')
+    ptr ++;
+
+  if (bufused < 0 || bufused > (int)strlen(ptr) / 2 ||
+      bufused >= CUPSD_SB_BUFFER_SIZE)
+    bufused = 0;
+
+ /*
+  * Make sure the job and printer still exist...
+  */
+
+  job     = cupsdFindJob(id);
+  printer = cupsdFindPrinter(name);
+
+  if (!job || !printer || printer->job ||
+      (job->state_value != IPP_JOB_PENDING &&
+       job->state_value != IPP_JOB_PROCESSING) ||
+      !cupsdLoadJob(job))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to continue job %d on printer \"%s\" after the "
+		    "scheduler upgrade.", id, name);
+
+    for (i = 0; filters[i]; i ++)
+      if (filters[i] > 0)
+        cupsdEndProcess(filters[i], 0);
+
+    if (backend > 0)
+      cupsdEndProcess(backend, 0);
+
+    for (i = 0; i < 8; i ++)
+      if (fds[i] >= 0)
+        close(fds[i]);
+
+    return (0);
+  }
+
+ /*
+  * Restore the processes and pipes...
+  */
+
+  memcpy(job->filters, filters, sizeof(job->filters));
+
+  job->backend         = backend;
+  job->status_pipes[0] = fds[0];
+  job->status_pipes[1] = fds[1];
+  job->print_pipes[0]  = fds[2];
+  job->print_pipes[1]  = fds[3];
+  job->back_pipes[0]   = fds[4];
+  job->back_pipes[1]   = fds[5];
+  job->side_pipes[0]   = fds[6];
+  job->side_pipes[1]   = fds[7];
+
+  for (i = 0; i < 8; i ++)
+    if (fds[i] >= 0)
+      fcntl(fds[i], F_SETFD, fcntl(fds[i], F_GETFD) | FD_CLOEXEC);
+
+  if (job->status_pipes[0] >= 0)
+  {
+    job->status_buffer = cupsdStatBufNew(job->status_pipes[0], NULL);
+
+    if (job->status_buffer && bufused > 0)
+    {
+      char	hex[3];			/* Hex-encoded byte */
+
+      for (i = 0, hex[2] = '\0'; i < bufused; i ++, ptr += 2)
+      {
+        hex[0] = ptr[0];
+        hex[1] = ptr[1];
+
+        job->status_buffer->buffer[i] = (char)strtol(hex, NULL, 16);
+
+        if (job->status_buffer->buffer[i] == '\n')
+          job->status_buffer->buflines ++;
+      }
+
+      job->status_buffer->bufused = bufused;
+    }
+  }
+
+  job->status_level = CUPSD_LOG_INFO;
+  job->profile      = cupsdCreateProfile(job->id, 0);
+  job->bprofile     = cupsdCreateProfile(job->id, 1);
+
+ /*
+  * Put the job and printer back in the processing state...
+  */
+
+  job->cost         = cost;
+  job->pending_cost = pending_cost;
+  job->current_file = current_file;
+  job->status       = status;
+  job->progress     = progress;
+  job->tries        = tries;
+  job->cancel_time  = cancel_time;
+  job->kill_time    = kill_time;
+  job->printer      = printer;
+  printer->job      = job;
+
+  FilterLevel += cost;
+
+  job->state_value = IPP_JOB_PROCESSING;
+
+  if (job->state)
+    job->state->values[0].integer = IPP_JOB_PROCESSING;
+
+  ippSetString(job->attrs, &job->reasons, 0, "job-printing");
+
+  if (!cupsArrayFind(PrintingJobs, job))
+    cupsArrayAdd(PrintingJobs, job);
+
+  job->dirty = 1;
+  cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+
+  cupsdUpdateJobQueues(job);
+
+  cupsdSetPrinterState(printer, IPP_PRINTER_PROCESSING, 0);
+
+  if (job->status_buffer)
+    cupsdAddSelect(job->status_buffer->fd, (cupsd_selfunc_t)update_job, NULL,
+                   job);
+
+  cupsdLogJob(job, CUPSD_LOG_INFO, "Continuing job after scheduler upgrade.");
+
+  return (1);
+}
+
+
 /*
  * 'cupsdCancelJobs()' - Cancel all jobs for the given destination/user.
  */
@@ -184,7 +558,22 @@ cupsdCancelJobs(const char *dest,	/* I - Destination to cancel */
 	        int        purge)	/* I - Purge jobs? */
 {
   cupsd_job_t	*job;			/* Current job */
+  cupsd_jobrec_t *rec;			/* Current compacted job */
+
+
+  if (purge)
+  {
+   /*
+    * Expand the compacted jobs we are going to purge...
+    */
 
+    for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+         rec;
+	 rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+      if ((!dest || !strcmp(rec->dest, dest)) &&
+          (!username || !strcmp(rec->username, username)))
+        cupsdExpandJob(rec);
+  }
 
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
@@ -225,15 +614,37 @@ cupsdCheckJobs(void)
   ipp_attribute_t	*attr;		/* Job attribute */
   time_t		curtime;	/* Current time */
   const char		*reasons;	/* job-state-reasons value */
+  cups_array_t		*expired;	/* Jobs with expired deadlines */
+  cupsd_jobq_t		*queue;		/* Pending job queue */
+  cupsd_printer_t	*dest;		/* Queue destination */
+  _cups_array_iter_t	iter;		/* Pending job iterator */
 
 
   curtime = time(NULL);
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: %d active jobs, sleeping=%d, ac-power=%d, reload=%d, curtime=%ld", cupsArrayCount(ActiveJobs), Sleeping, ACPower, NeedReload, (long)curtime);
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: %d active jobs, %d timeouts, sleeping=%d, ac-power=%d, reload=%d, curtime=%ld", cupsArrayCount(ActiveJobs), cupsArrayCount(JobTimeouts), Sleeping, ACPower, NeedReload, (long)curtime);
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+ /*
+  * Collect the jobs whose nearest deadline has passed.  Handling a deadline
+  * usually changes the job's position in JobTimeouts, so copy them to a
+  * separate list first...
+  */
+
+  expired = NULL;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(JobTimeouts);
+       job && job->timeout_time <= curtime;
+       job = (cupsd_job_t *)cupsArrayNext(JobTimeouts))
+  {
+    if (!expired)
+      expired = cupsArrayNew(NULL, NULL);
+
+    cupsArrayAdd(expired, job);
+  }
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(expired);
        job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+       job = (cupsd_job_t *)cupsArrayNext(expired))
   {
     cupsdLogMessage(CUPSD_LOG_DEBUG2,
                     "cupsdCheckJobs: Job %d - dest=\"%s\", printer=%p, "
@@ -243,6 +654,17 @@ cupsdCheckJobs(void)
                     (long)job->hold_until, (long)job->kill_time,
                     job->pending_cost, (long)job->pending_timeout);
 
+    if (!cupsArrayFind(ActiveJobs, job))
+    {
+     /*
+      * Job is no longer active, so its deadlines no longer apply...
+      */
+
+      cupsArrayRemove(JobTimeouts, job);
+      job->timeout_time = 0;
+      continue;
+    }
+
    /*
     * Kill jobs if they are unresponsive...
     */
@@ -253,6 +675,7 @@ cupsdCheckJobs(void)
         cupsdLogJob(job, CUPSD_LOG_ERROR, "Stopping unresponsive job.");
 
       stop_job(job, CUPSD_JOB_FORCE);
+      cupsdUpdateJobQueues(job);
       continue;
     }
 
@@ -311,42 +734,63 @@ cupsdCheckJobs(void)
       else
 	cupsdSetJobState(job, IPP_JOB_PENDING, CUPSD_JOB_DEFAULT, "Job hold expired.");
     }
+  }
 
-   /*
-    * Continue jobs that are waiting on the FilterLimit...
-    */
+  cupsArrayDelete(expired);
 
+ /*
+  * Continue jobs that are waiting on the FilterLimit...
+  */
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(PrintingJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
+  {
     if (job->pending_cost > 0 &&
 	((FilterLevel + job->pending_cost) < FilterLimit || FilterLevel == 0))
       cupsdContinueJob(job);
+  }
+
+ /*
+  * Start pending jobs if the destination is available...
+  */
+
+  if (NeedReload || (Sleeping && !ACPower) || DoingShutdown)
+    return;
+
+  for (queue = (cupsd_jobq_t *)cupsArrayFirst(ReadyQueues);
+       queue;
+       queue = (cupsd_jobq_t *)cupsArrayNext(ReadyQueues))
+  {
+    dest = cupsdFindDest(queue->dest);
 
    /*
-    * Skip jobs that where held-on-create
+    * Starting or aborting a job removes it from the queue, so use an iterator
+    * that survives the removal...
     */
 
-    reasons = ippGetString(job->reasons, 0, NULL);
-    if (reasons && !strcmp(reasons, "job-held-on-create"))
+    for (job = (cupsd_job_t *)_cupsArrayIterFirst(&iter, queue->jobs);
+	 job;
+	 job = (cupsd_job_t *)_cupsArrayIterNext(&iter))
     {
      /*
-      * Check whether the printer is still holding new jobs...
+      * Skip jobs that where held-on-create
       */
 
-      printer = cupsdFindDest(job->dest);
-
-      if (printer->holding_new_jobs)
-        continue;
+      reasons = ippGetString(job->reasons, 0, NULL);
+      if (dest && reasons && !strcmp(reasons, "job-held-on-create"))
+      {
+       /*
+	* Check whether the printer is still holding new jobs...
+	*/
 
-      ippSetString(job->attrs, &job->reasons, 0, "none");
-    }
+	if (dest->holding_new_jobs)
+	  continue;
 
-   /*
-    * Start pending jobs if the destination is available...
-    */
+	ippSetString(job->attrs, &job->reasons, 0, "none");
+      }
 
-    if (job->state_value == IPP_JOB_PENDING && !NeedReload &&
-        (!Sleeping || ACPower) && !DoingShutdown && !job->printer)
-    {
-      printer = cupsdFindDest(job->dest);
+      printer = dest;
       pclass  = NULL;
 
       while (printer && (printer->type & CUPS_PRINTER_CLASS))
@@ -362,7 +806,7 @@ cupsdCheckJobs(void)
         else if (pclass->type & CUPS_PRINTER_REMOTE)
 	  break;
 	else
-	  printer = cupsdFindAvailablePrinter(printer->name);
+	  printer = cupsdFindAvailablePrinter(printer->name, job);
       }
 
       if (!printer && !pclass)
@@ -375,43 +819,80 @@ cupsdCheckJobs(void)
         cupsdSetJobState(job, IPP_JOB_ABORTED, CUPSD_JOB_PURGE,
 	                 "Job aborted because the destination printer/class "
 			 "has gone away.");
+	continue;
       }
-      else if (printer)
+
+     /*
+      * See if the printer is available or remote and not printing a job;
+      * if not, none of the remaining jobs in this queue can start either...
+      */
+
+      if (!printer || printer->job || printer->state != IPP_PRINTER_IDLE)
+        break;
+
+      if (pclass)
       {
        /*
-        * See if the printer is available or remote and not printing a job;
-	* if so, start the job...
+	* Add/update a job-printer-uri-actual attribute for this job
+	* so that we know which printer actually printed the job...
 	*/
 
-        if (pclass)
-	{
-	 /*
-	  * Add/update a job-printer-uri-actual attribute for this job
-	  * so that we know which printer actually printed the job...
-	  */
+	if ((attr = ippFindAttribute(job->attrs, "job-printer-uri-actual", IPP_TAG_URI)) != NULL)
+	  ippSetString(job->attrs, &attr, 0, printer->uri);
+	else
+	  ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri-actual", NULL, printer->uri);
 
-          if ((attr = ippFindAttribute(job->attrs, "job-printer-uri-actual", IPP_TAG_URI)) != NULL)
-            ippSetString(job->attrs, &attr, 0, printer->uri);
-	  else
-	    ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri-actual", NULL, printer->uri);
+	job->dirty = 1;
+	cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+      }
 
-          job->dirty = 1;
-          cupsdMarkDirty(CUPSD_DIRTY_JOBS);
-	}
+     /*
+      * With a render cache, jobs are rendered to a file before they print so
+      * that the output can be reused...
+      */
 
-        if (!printer->job && printer->state == IPP_PRINTER_IDLE)
-        {
-	 /*
-	  * Start the job...
-	  */
+      if (RenderCacheLimit > 0 && !pclass && !printer->raw && !printer->remote)
+      {
+        if (job->prerender == CUPSD_PRERENDER_RUNNING)
+	  break;
+
+        if (job->prerender == CUPSD_PRERENDER_NONE && cupsdLoadJob(job) &&
+	    can_prerender(job) && !find_render_cache(job, printer))
+	{
+	  start_prerender(job, printer);
 
-	  cupsArraySave(ActiveJobs);
-	  start_job(job, printer);
-	  cupsArrayRestore(ActiveJobs);
+	  if (job->prerender == CUPSD_PRERENDER_RUNNING)
+	    break;
 	}
       }
+
+     /*
+      * Start the job...
+      */
+
+      start_job(job, printer);
+    }
+
+   /*
+    * Free the queue once its destination is gone and all of its jobs have
+    * been aborted...
+    */
+
+    if (!dest && !cupsArrayCount(queue->jobs))
+    {
+      cupsArrayRemove(ReadyQueues, queue);
+      cupsArrayDelete(queue->jobs);
+      cupsdClearString(&queue->dest);
+      free(queue);
     }
   }
+
+ /*
+  * Pre-render the next jobs for busy printers...
+  */
+
+  if (PrerenderJobs > 0)
+    prerender_jobs();
 }
 
 
@@ -423,7 +904,11 @@ void
 cupsdCleanJobs(void)
 {
   cupsd_job_t	*job;			/* Current job */
+  cupsd_jobrec_t *rec;			/* Current compacted job */
   time_t	curtime;		/* Current time */
+  time_t	history_time,		/* Job history retain time */
+		file_time;		/* Job file retain time */
+  struct timeval start;			/* Start of this pass */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
@@ -436,8 +921,56 @@ cupsdCleanJobs(void)
   curtime          = time(NULL);
   JobHistoryUpdate = 0;
 
+  gettimeofday(&start, NULL);
+
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCleanJobs: curtime=%d", (int)curtime);
 
+ /*
+  * Compacted jobs are the oldest history, so expire them first...
+  */
+
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+  {
+    history_time = JobHistory < INT_MAX ? rec->completed_time + JobHistory : INT_MAX;
+    file_time    = JobFiles < INT_MAX ? rec->completed_time + JobFiles : INT_MAX;
+
+    if (history_time < JobHistoryUpdate || !JobHistoryUpdate)
+      JobHistoryUpdate = history_time;
+
+    if (rec->num_files > 0 && file_time < JobHistoryUpdate)
+      JobHistoryUpdate = file_time;
+
+    if ((MaxJobs > 0 && (cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs)) >= MaxJobs) ||
+        history_time <= curtime)
+    {
+      if ((job = cupsdExpandJob(rec)) == NULL)
+        break;
+
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Removing from history.");
+      cupsdDeleteJob(job, CUPSD_JOB_PURGE);
+    }
+    else if (file_time <= curtime && rec->num_files > 0)
+    {
+      if ((job = cupsdExpandJob(rec)) == NULL)
+        break;
+
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Removing document files.");
+      remove_job_files(job);
+
+      cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+    }
+    else
+      continue;
+
+    if (slice_expired(&start))
+    {
+      JobHistoryUpdate = curtime;
+      return;
+    }
+  }
+
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
@@ -456,7 +989,7 @@ cupsdCleanJobs(void)
       * Expire old jobs (or job files)...
       */
 
-      if ((MaxJobs > 0 && cupsArrayCount(Jobs) >= MaxJobs) ||
+      if ((MaxJobs > 0 && (cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs)) >= MaxJobs) ||
           (job->history_time && job->history_time <= curtime))
       {
         cupsdLogJob(job, CUPSD_LOG_DEBUG, "Removing from history.");
@@ -469,6 +1002,18 @@ cupsdCleanJobs(void)
 
         cupsdMarkDirty(CUPSD_DIRTY_JOBS);
       }
+      else
+        continue;
+
+      if (slice_expired(&start))
+      {
+       /*
+        * Pick up where we left off on the next pass through the main loop...
+	*/
+
+	JobHistoryUpdate = curtime;
+	break;
+      }
     }
   }
 
@@ -503,18 +1048,23 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   int			banner_page;	/* 1 if banner page, 0 otherwise */
   int			filterfds[2][2] = { { -1, -1 }, { -1, -1 } };
 					/* Pipes used between filters */
+  int			rendering,	/* Pre-rendering the job? */
+			renderfd = -1,	/* Pre-rendered output file */
+			logfd = -1;	/* Pre-rendering messages file */
   int			envc;		/* Number of environment variables */
   struct stat		fileinfo;	/* Job file information */
   int			argc = 0;	/* Number of arguments */
   char			**argv = NULL,	/* Filter command-line arguments */
 			filename[1024],	/* Job filename */
+			renderfile[1024],
+					/* Pre-rendered output filename */
 			command[1024],	/* Full path to command */
 			jobid[255],	/* Job ID string */
 			title[IPP_MAX_NAME],
 					/* Job title string */
 			copies[255],	/* # copies string */
 			*options,	/* Options string */
-			*envp[MAX_ENV + 21],
+			*envp[MAX_ENV + 22],
 					/* Environment variables */
 			charset[255],	/* CHARSET env variable */
 			class_name[255],/* CLASS env variable */
@@ -522,8 +1072,6 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 					/* CLASSIFICATION env variable */
 			content_type[1024],
 					/* CONTENT_TYPE env variable */
-			device_uri[1024],
-					/* DEVICE_URI env variable */
 			final_content_type[1024] = "",
 					/* FINAL_CONTENT_TYPE env variable */
 			lang[255],	/* LANG env variable */
@@ -531,15 +1079,8 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 			apple_language[255],
 					/* APPLE_LANGUAGE env variable */
 #endif /* __APPLE__ */
-			auth_info_required[255],
-					/* AUTH_INFO_REQUIRED env variable */
-			ppd[1024],	/* PPD env variable */
-			printer_info[255],
-					/* PRINTER_INFO env variable */
-			printer_location[255],
-					/* PRINTER_LOCATION env variable */
-			printer_name[255],
-					/* PRINTER env variable */
+			ppd_snapshot[1037] = "",
+					/* PPD_SNAPSHOT=filename env variable */
 			*printer_state_reasons = NULL,
 					/* PRINTER_STATE_REASONS env var */
 			rip_max_cache[255];
@@ -550,6 +1091,20 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
                   "cupsdContinueJob(job=%p(%d)): current_file=%d, num_files=%d",
 	          job, job->id, job->current_file, job->num_files);
 
+ /*
+  * A pending job is pre-rendered by running the same filters with the output
+  * going to a file, and is later printed by sending that file to the port
+  * monitor and backend...
+  */
+
+  rendering = job->prerender == CUPSD_PRERENDER_RUNNING;
+
+  if (job->prerender == CUPSD_PRERENDER_DONE && job->retry_as_raster)
+    cupsdDiscardPrerender(job);
+
+  if (job->prerender == CUPSD_PRERENDER_DONE || rendering)
+    get_render_filename(job, "", renderfile, sizeof(renderfile));
+
  /*
   * Figure out what filters are required to convert from
   * the source to the destination type...
@@ -580,8 +1135,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
     mime_type_t	*dst = job->printer->filetype;
 					/* Destination file type */
 
-    snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
-             job->id, job->current_file + 1);
+    cupsdGetJobFilename(job->id, 'd', job->current_file + 1, filename, sizeof(filename));
     if (stat(filename, &fileinfo))
       fileinfo.st_size = 0;
 
@@ -609,7 +1163,13 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
     filters = mimeFilter2(MimeDatabase, job->filetypes[job->current_file], (size_t)fileinfo.st_size, dst, &(job->cost));
 
-    if (!filters)
+    if (!filters && rendering)
+    {
+      job->cost      = 0;
+      job->prerender = CUPSD_PRERENDER_SKIP;
+      return;
+    }
+    else if (!filters)
     {
       cupsdLogJob(job, CUPSD_LOG_ERROR,
 		  "Unable to convert file %d to printable format.",
@@ -705,21 +1265,68 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
       cupsArrayDelete(filters);
       filters = prefilters;
     }
-  }
 
- /*
-  * Set a minimum cost of 100 for all jobs so that FilterLimit
-  * works with raw queues and other low-cost paths.
-  */
+    if (rendering && !filters)
+    {
+     /*
+      * Nothing to pre-render...
+      */
 
-  if (job->cost < 100)
-    job->cost = 100;
+      job->cost      = 0;
+      job->prerender = CUPSD_PRERENDER_SKIP;
+      return;
+    }
+    else if (job->prerender == CUPSD_PRERENDER_DONE)
+    {
+     /*
+      * The document has already been filtered, just copy it to the port
+      * monitor or backend...
+      */
 
- /*
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Printing pre-rendered output.");
+
+      if (!job->prerender_type)
+      {
+       /*
+        * Output from the render cache is the type of the last filter...
+	*/
+
+        filter              = (mime_filter_t *)cupsArrayLast(filters);
+	job->prerender_type = filter && filter->dst ? filter->dst : job->filetypes[0];
+      }
+
+      cupsArrayDelete(filters);
+      filters = cupsArrayNew(NULL, NULL);
+
+      cupsArrayAdd(filters, &gziptoany_filter);
+    }
+  }
+
+ /*
+  * Set a minimum cost of 100 for all jobs so that FilterLimit
+  * works with raw queues and other low-cost paths.
+  */
+
+  if (job->cost < 100)
+    job->cost = 100;
+
+ /*
   * See if the filter cost is too high...
   */
 
-  if ((FilterLevel + job->cost) > FilterLimit && FilterLevel > 0 &&
+  if (rendering && FilterLimit > 0 && (FilterLevel + job->cost) > FilterLimit)
+  {
+   /*
+    * Pre-rendering only uses spare filter capacity; try again later...
+    */
+
+    cupsArrayDelete(filters);
+
+    job->cost      = 0;
+    job->prerender = CUPSD_PRERENDER_NONE;
+    return;
+  }
+  else if ((FilterLevel + job->cost) > FilterLimit && FilterLevel > 0 &&
       FilterLimit > 0)
   {
    /*
@@ -746,7 +1353,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   * Add decompression/raw filter as needed...
   */
 
-  if ((job->compressions[job->current_file] && (!job->printer->remote || job->num_files == 1)) ||
+  if ((job->compressions[job->current_file] && job->prerender != CUPSD_PRERENDER_DONE && (!job->printer->remote || job->num_files == 1)) ||
       (!job->printer->remote && job->printer->raw && job->num_files > 1))
   {
    /*
@@ -773,7 +1380,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   * Add port monitor, if any...
   */
 
-  if (job->printer->port_monitor)
+  if (job->printer->port_monitor && !rendering)
   {
    /*
     * Add port monitor to the end of the list...
@@ -813,7 +1420,8 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
     abort_message = "Aborting job because it needs too many filters to print.";
     abort_state   = IPP_JOB_ABORTED;
 
-    ippSetString(job->attrs, &job->reasons, 0, "document-unprintable-error");
+    if (!rendering)
+      ippSetString(job->attrs, &job->reasons, 0, "document-unprintable-error");
 
     goto abort_job;
   }
@@ -906,15 +1514,15 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   {
     for (i = 0; i < job->num_files; i ++)
     {
-      snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
-               job->id, i + 1);
+      cupsdGetJobFilename(job->id, 'd', i + 1, filename, sizeof(filename));
       argv[6 + i] = strdup(filename);
     }
   }
+  else if (job->prerender == CUPSD_PRERENDER_DONE)
+    argv[6] = strdup(renderfile);
   else
   {
-    snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
-             job->id, job->current_file + 1);
+    cupsdGetJobFilename(job->id, 'd', job->current_file + 1, filename, sizeof(filename));
     argv[6] = strdup(filename);
   }
 
@@ -974,18 +1582,15 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   else
     strlcpy(charset, "CHARSET=utf-8", sizeof(charset));
 
-  snprintf(content_type, sizeof(content_type), "CONTENT_TYPE=%s/%s",
-           job->filetypes[job->current_file]->super,
-           job->filetypes[job->current_file]->type);
-  snprintf(device_uri, sizeof(device_uri), "DEVICE_URI=%s",
-           job->printer->device_uri);
-  snprintf(ppd, sizeof(ppd), "PPD=%s/ppd/%s.ppd", ServerRoot,
-	   job->printer->name);
-  snprintf(printer_info, sizeof(printer_name), "PRINTER_INFO=%s",
-           job->printer->info ? job->printer->info : "");
-  snprintf(printer_location, sizeof(printer_name), "PRINTER_LOCATION=%s",
-           job->printer->location ? job->printer->location : "");
-  snprintf(printer_name, sizeof(printer_name), "PRINTER=%s", job->printer->name);
+  if (job->prerender == CUPSD_PRERENDER_DONE)
+    snprintf(content_type, sizeof(content_type), "CONTENT_TYPE=%s/%s",
+             job->prerender_type->super, job->prerender_type->type);
+  else
+    snprintf(content_type, sizeof(content_type), "CONTENT_TYPE=%s/%s",
+             job->filetypes[job->current_file]->super,
+             job->filetypes[job->current_file]->type);
+  if (cupsdUpdatePrinterSnapshot(job->printer, filename, sizeof(filename)))
+    snprintf(ppd_snapshot, sizeof(ppd_snapshot), "PPD_SNAPSHOT=%s", filename);
   if (job->printer->num_reasons > 0)
   {
     char	*psrptr;		/* Pointer into PRINTER_STATE_REASONS */
@@ -1014,46 +1619,24 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   }
   snprintf(rip_max_cache, sizeof(rip_max_cache), "RIP_MAX_CACHE=%s", RIPCache);
 
-  if (job->printer->num_auth_info_required == 1)
-    snprintf(auth_info_required, sizeof(auth_info_required),
-             "AUTH_INFO_REQUIRED=%s",
-	     job->printer->auth_info_required[0]);
-  else if (job->printer->num_auth_info_required == 2)
-    snprintf(auth_info_required, sizeof(auth_info_required),
-             "AUTH_INFO_REQUIRED=%s,%s",
-	     job->printer->auth_info_required[0],
-	     job->printer->auth_info_required[1]);
-  else if (job->printer->num_auth_info_required == 3)
-    snprintf(auth_info_required, sizeof(auth_info_required),
-             "AUTH_INFO_REQUIRED=%s,%s,%s",
-	     job->printer->auth_info_required[0],
-	     job->printer->auth_info_required[1],
-	     job->printer->auth_info_required[2]);
-  else if (job->printer->num_auth_info_required == 4)
-    snprintf(auth_info_required, sizeof(auth_info_required),
-             "AUTH_INFO_REQUIRED=%s,%s,%s,%s",
-	     job->printer->auth_info_required[0],
-	     job->printer->auth_info_required[1],
-	     job->printer->auth_info_required[2],
-	     job->printer->auth_info_required[3]);
-  else
-    strlcpy(auth_info_required, "AUTH_INFO_REQUIRED=none",
-	    sizeof(auth_info_required));
-
   envc = cupsdLoadEnv(envp, (int)(sizeof(envp) / sizeof(envp[0])));
 
+ /*
+  * The DEVICE_URI, PPD, PRINTER, PRINTER_INFO, PRINTER_LOCATION, and
+  * AUTH_INFO_REQUIRED strings only depend on the printer and are cached...
+  */
+
+  envc += cupsdLoadPrinterEnv(job->printer, envp + envc, (int)(sizeof(envp) / sizeof(envp[0])) - envc);
+
   envp[envc ++] = charset;
   envp[envc ++] = lang;
 #ifdef __APPLE__
   envp[envc ++] = apple_language;
 #endif /* __APPLE__ */
-  envp[envc ++] = ppd;
+  if (ppd_snapshot[0])
+    envp[envc ++] = ppd_snapshot;
   envp[envc ++] = rip_max_cache;
   envp[envc ++] = content_type;
-  envp[envc ++] = device_uri;
-  envp[envc ++] = printer_info;
-  envp[envc ++] = printer_location;
-  envp[envc ++] = printer_name;
   envp[envc ++] = printer_state_reasons ? printer_state_reasons :
                                           "PRINTER_STATE_REASONS=none";
   envp[envc ++] = banner_page ? "CUPS_FILETYPE=job-sheet" :
@@ -1085,8 +1668,6 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
     envp[envc ++] = class_name;
   }
 
-  envp[envc ++] = auth_info_required;
-
   for (i = 0;
        i < (int)(sizeof(job->auth_env) / sizeof(job->auth_env[0]));
        i ++)
@@ -1110,11 +1691,43 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
       cupsdLogJob(job, CUPSD_LOG_DEBUG, "envp[%d]=\"DEVICE_URI=%s\"", i,
                   job->printer->sanitized_device_uri);
 
-  if (job->printer->remote)
+  if (rendering)
+  {
+   /*
+    * Save the output and messages of the filters...
+    */
+
+    unlink(renderfile);
+
+    if ((renderfd = open(renderfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640)) < 0)
+    {
+      abort_message = "Unable to create pre-rendered output file.";
+      goto abort_job;
+    }
+
+    get_render_filename(job, ".log", filename, sizeof(filename));
+
+    if ((logfd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640)) < 0)
+    {
+      abort_message = "Unable to create pre-rendering log file.";
+      goto abort_job;
+    }
+
+    fchown(renderfd, RunUser, Group);
+    fchown(logfd, RunUser, Group);
+
+    filter = (mime_filter_t *)cupsArrayLast(filters);
+
+    job->prerender_type = filter->dst ? filter->dst : job->filetypes[0];
+  }
+  else if (job->printer->remote)
     job->current_file = job->num_files;
   else
     job->current_file ++;
 
+  if (job->prerender == CUPSD_PRERENDER_DONE)
+    send_prerender_log(job);
+
  /*
   * Now create processes for all of the filters...
   */
@@ -1139,6 +1752,12 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
         goto abort_job;
       }
     }
+    else if (rendering)
+    {
+      filterfds[slot][0] = -1;
+      filterfds[slot][1] = renderfd;
+      renderfd           = -1;
+    }
     else
     {
       if (job->current_file == 1 ||
@@ -1193,10 +1812,15 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
       filterfds[slot][1] = job->print_pipes[1];
     }
 
-    pid = cupsdStartProcess(command, argv, envp, filterfds[!slot][0],
-                            filterfds[slot][1], job->status_pipes[1],
-		            job->back_pipes[0], job->side_pipes[0], 0,
-			    job->profile, job, job->filters + i);
+    if (rendering)
+      pid = cupsdStartProcess(command, argv, envp, filterfds[!slot][0],
+                              filterfds[slot][1], logfd, -1, -1, 0,
+			      job->profile, job, job->filters + i);
+    else
+      pid = cupsdStartProcess(command, argv, envp, filterfds[!slot][0],
+                              filterfds[slot][1], job->status_pipes[1],
+		              job->back_pipes[0], job->side_pipes[0], 0,
+			      job->profile, job, job->filters + i);
 
     cupsdClosePipe(filterfds[!slot]);
 
@@ -1214,6 +1838,9 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
     cupsdLogJob(job, CUPSD_LOG_INFO, "Started filter %s (PID %d)", command,
                 pid);
 
+    add_job_usage(job, pid, command);
+    cupsdAddProcessMetric(0);
+
     if (argv[6])
     {
       free(argv[6]);
@@ -1226,6 +1853,27 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   cupsArrayDelete(filters);
   filters = NULL;
 
+  if (rendering)
+  {
+   /*
+    * The output file is closed with the pipes; the filters will finish in
+    * the background...
+    */
+
+    cupsdClosePipe(filterfds[!slot]);
+    close(logfd);
+
+    for (i = 6; i < argc; i ++)
+      free(argv[i]);
+    free(argv);
+
+    if (printer_state_reasons)
+      free(printer_state_reasons);
+
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Pre-rendering for printer %s.", job->printer->name);
+    return;
+  }
+
  /*
   * Finally, pipe the final output into a backend process if needed...
   */
@@ -1270,6 +1918,9 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
       {
 	cupsdLogJob(job, CUPSD_LOG_INFO, "Started backend %s (PID %d)",
 		    command, pid);
+
+        add_job_usage(job, pid, command);
+        cupsdAddProcessMetric(1);
       }
     }
 
@@ -1346,6 +1997,24 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   if (printer_state_reasons)
     free(printer_state_reasons);
 
+  if (rendering)
+  {
+   /*
+    * Leave the job alone and don't try again...
+    */
+
+    if (renderfd >= 0)
+      close(renderfd);
+    if (logfd >= 0)
+      close(logfd);
+
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Unable to pre-render: %s", abort_message);
+
+    cupsdDiscardPrerender(job);
+    job->prerender = CUPSD_PRERENDER_SKIP;
+    return;
+  }
+
   cupsdClosePipe(job->print_pipes);
   cupsdClosePipe(job->back_pipes);
   cupsdClosePipe(job->side_pipes);
@@ -1374,6 +2043,8 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
   job->printer->job = NULL;
   job->printer      = NULL;
+
+  cupsdUpdateJobQueues(job);
 }
 
 
@@ -1391,6 +2062,8 @@ cupsdDeleteJob(cupsd_job_t       *job,	/* I - Job */
   if (job->printer)
     finalize_job(job, 1);
 
+  cupsdDiscardPrerender(job);
+
   if (action == CUPSD_JOB_PURGE)
     remove_job_history(job);
 
@@ -1415,13 +2088,152 @@ cupsdDeleteJob(cupsd_job_t       *job,	/* I - Job */
   if (job->history)
     free_job_history(job);
 
+  free(job->usage);
+
   unload_job(job);
 
   cupsArrayRemove(Jobs, job);
   cupsArrayRemove(ActiveJobs, job);
   cupsArrayRemove(PrintingJobs, job);
+  cupsArrayRemove(JobTimeouts, job);
+
+  if (job->queue)
+    cupsArrayRemove(job->queue->jobs, job);
+
+ /*
+  * Remember the deletion for the next job.journal update...
+  */
+
+  if (journal_records >= 0)
+  {
+    if (num_journal_deleted >= alloc_journal_deleted)
+    {
+      int	*temp;			/* New deleted job ID array */
+
+      if ((temp = realloc(journal_deleted, (size_t)(alloc_journal_deleted + 32) * sizeof(int))) != NULL)
+      {
+        journal_deleted       = temp;
+        alloc_journal_deleted += 32;
+      }
+    }
+
+    if (num_journal_deleted < alloc_journal_deleted)
+      journal_deleted[num_journal_deleted ++] = job->id;
+    else
+      journal_records = -1;		/* Out of memory, rewrite job.cache */
+  }
+
+  cupsdSlabFree(CUPSD_SLAB_JOB, job);
+}
+
+
+/*
+ * 'cupsdDiscardPrerender()' - Stop pre-rendering a job and remove its output.
+ */
+
+void
+cupsdDiscardPrerender(cupsd_job_t *job)	/* I - Job */
+{
+  int	i;				/* Looping var */
+  char	filename[1024];			/* Pre-rendered output filename */
+
+
+  switch (job->prerender)
+  {
+    case CUPSD_PRERENDER_NONE :
+        cupsdClearString(&job->render_key);
+        return;
+
+    case CUPSD_PRERENDER_RUNNING :
+	for (i = 0; job->filters[i]; i ++)
+	  if (job->filters[i] > 0)
+	  {
+	    cupsdEndProcess(job->filters[i], 1);
+	    job->filters[i] = -job->filters[i];
+	  }
+
+	FilterLevel -= job->cost;
+	job->cost   = 0;
+	job->status = 0;
+        break;
+
+    case CUPSD_PRERENDER_DONE :
+        prerender_total -= job->prerender_size;
+        break;
+
+    case CUPSD_PRERENDER_SKIP :
+        break;
+  }
+
+  if (job->prerender != CUPSD_PRERENDER_SKIP)
+  {
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Discarding pre-rendered output.");
+
+    purge_file(get_render_filename(job, "", filename, sizeof(filename)));
+    purge_file(get_render_filename(job, ".log", filename, sizeof(filename)));
+  }
+
+  job->prerender      = CUPSD_PRERENDER_NONE;
+  job->prerender_type = NULL;
+  job->prerender_size = 0;
+
+  cupsdClearString(&job->render_key);
+}
+
+
+/*
+ * 'cupsdExpandJob()' - Turn a compacted job back into a full job.
+ *
+ * The record is freed.  The new job has no attributes loaded, just like a job
+ * read from job.cache.
+ */
+
+cupsd_job_t *				/* O - Job or NULL on error */
+cupsdExpandJob(cupsd_jobrec_t *rec)	/* I - Compacted job */
+{
+  cupsd_job_t	*job;			/* New job */
+
+
+  if ((job = cupsdSlabAlloc(CUPSD_SLAB_JOB)) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_EMERG,
+		    "[Job %d] Unable to allocate memory for job.", rec->id);
+    return (NULL);
+  }
+
+  job->id              = rec->id;
+  job->priority        = rec->priority;
+  job->state_value     = rec->state_value;
+  job->username        = rec->username;
+  job->dest            = rec->dest;
+  job->name            = rec->name;
+  job->koctets         = rec->koctets;
+  job->dtype           = rec->dtype;
+  job->num_files       = rec->num_files;
+  job->filetypes       = rec->filetypes;
+  job->compressions    = rec->compressions;
+  job->access_time     = time(NULL);
+  job->creation_time   = rec->creation_time;
+  job->completed_time  = rec->completed_time;
+  job->history_time    = JobHistory < INT_MAX ? rec->completed_time + JobHistory : INT_MAX;
+  job->file_time       = JobFiles < INT_MAX ? rec->completed_time + JobFiles : INT_MAX;
+  job->back_pipes[0]   = -1;
+  job->back_pipes[1]   = -1;
+  job->print_pipes[0]  = -1;
+  job->print_pipes[1]  = -1;
+  job->side_pipes[0]   = -1;
+  job->side_pipes[1]   = -1;
+  job->status_pipes[0] = -1;
+  job->status_pipes[1] = -1;
+
+  cupsArrayRemove(CompactJobs, rec);
+  free(rec);
+
+  cupsArrayAdd(Jobs, job);
 
-  free(job);
+  cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Expanded from compact history.");
+
+  return (job);
 }
 
 
@@ -1433,6 +2245,7 @@ void
 cupsdFreeAllJobs(void)
 {
   cupsd_job_t	*job;			/* Current job */
+  cupsd_jobrec_t *rec;			/* Current compacted job */
 
 
   if (!Jobs)
@@ -1441,6 +2254,8 @@ cupsdFreeAllJobs(void)
   cupsdHoldSignals();
 
   cupsdStopAllJobs(CUPSD_JOB_FORCE, 0);
+
+  journal_records = -1;			/* Always write a full job.cache */
   cupsdSaveAllJobs();
 
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
@@ -1448,10 +2263,37 @@ cupsdFreeAllJobs(void)
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
     cupsdDeleteJob(job, CUPSD_JOB_DEFAULT);
 
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+  {
+    cupsArrayRemove(CompactJobs, rec);
+
+    cupsdClearString(&rec->username);
+    cupsdClearString(&rec->dest);
+    cupsdClearString(&rec->name);
+    free(rec->filetypes);
+    free(rec->compressions);
+    free(rec);
+  }
+
   cupsdReleaseSignals();
 }
 
 
+/*
+ * 'cupsdFreeJobRecords()' - Free a list from cupsdGetJobRecords().
+ */
+
+void
+cupsdFreeJobRecords(
+    cups_array_t *records)		/* I - Array of job records */
+{
+  free(cupsArrayUserData(records));
+  cupsArrayDelete(records);
+}
+
+
 /*
  * 'cupsdFindJob()' - Find the specified job.
  */
@@ -1459,34 +2301,163 @@ cupsdFreeAllJobs(void)
 cupsd_job_t *				/* O - Job data */
 cupsdFindJob(int id)			/* I - Job ID */
 {
-  cupsd_job_t	key;			/* Search key */
+  cupsd_job_t	key,			/* Search key */
+		*job;			/* Matching job */
+  cupsd_jobrec_t rkey,			/* Compacted job search key */
+		*rec;			/* Matching compacted job */
 
 
   key.id = id;
 
-  return ((cupsd_job_t *)cupsArrayFind(Jobs, &key));
+  if ((job = (cupsd_job_t *)cupsArrayFind(Jobs, &key)) == NULL)
+  {
+   /*
+    * Callers expect a full job, so expand a compacted one...
+    */
+
+    rkey.id = id;
+
+    if ((rec = (cupsd_jobrec_t *)cupsArrayFind(CompactJobs, &rkey)) != NULL)
+      job = cupsdExpandJob(rec);
+  }
+
+  return (job);
+}
+
+
+/*
+ * 'cupsdFinishPrerender()' - Finish pre-rendering a job.
+ */
+
+void
+cupsdFinishPrerender(cupsd_job_t *job)	/* I - Job */
+{
+  struct stat	fileinfo;		/* Pre-rendered output information */
+  char		filename[1024];		/* Pre-rendered output filename */
+
+
+  FilterLevel -= job->cost;
+  job->cost   = 0;
+
+  get_render_filename(job, "", filename, sizeof(filename));
+
+  if (job->status || stat(filename, &fileinfo) || fileinfo.st_size == 0)
+  {
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Pre-rendering failed.");
+
+    job->status = 0;
+  }
+  else if (!add_render_cache(job, fileinfo.st_size) && PrerenderLimit > 0 &&
+           (prerender_total + fileinfo.st_size) > PrerenderLimit)
+  {
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Pre-rendered output is larger than PrerenderLimit.");
+  }
+  else
+  {
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Pre-rendered " CUPS_LLFMT " bytes.", CUPS_LLCAST fileinfo.st_size);
+
+    job->prerender      = CUPSD_PRERENDER_DONE;
+    job->prerender_size = fileinfo.st_size;
+    prerender_total     += fileinfo.st_size;
+  }
+
+  if (job->prerender != CUPSD_PRERENDER_DONE)
+  {
+   /*
+    * Remove the output and print the job normally...
+    */
+
+    cupsdDiscardPrerender(job);
+    job->prerender = CUPSD_PRERENDER_SKIP;
+  }
+
+  cupsdCheckJobs();
+}
+
+
+/*
+ * 'cupsdGetJobFilename()' - Get the name of a job file in the spool directory.
+ *
+ * The type is 'a' for authentication data, 'c' for the control file, or 'd'
+ * for a document file, which also has a document number.  With the hashed
+ * spool layout, each range of CUPSD_JOB_SHARD_SIZE job IDs has its own
+ * subdirectory.
+ */
+
+char *					/* O - Filename */
+cupsdGetJobFilename(int    id,		/* I - Job ID */
+                    char   type,	/* I - File type */
+		    int    number,	/* I - Document number or 0 */
+		    char   *buffer,	/* I - Filename buffer */
+		    size_t bufsize)	/* I - Size of filename buffer */
+{
+  size_t	length;			/* Length of directory name */
+
+
+  if (SpoolLayout == CUPSD_SPOOL_HASHED)
+    snprintf(buffer, bufsize, "%s/j%03d/", RequestRoot,
+             id / CUPSD_JOB_SHARD_SIZE);
+  else
+    snprintf(buffer, bufsize, "%s/", RequestRoot);
+
+  length = strlen(buffer);
+
+  if (number > 0)
+    snprintf(buffer + length, bufsize - length, "%c%05d-%03d", type, id,
+             number);
+  else
+    snprintf(buffer + length, bufsize - length, "%c%05d", type, id);
+
+  return (buffer);
 }
 
 
 /*
- * 'cupsdGetCompletedJobs()'- Generate a completed jobs list.
+ * 'cupsdGetJobRecords()' - Generate a list of job records.
+ *
+ * When "completed" is non-zero, the list contains the completed jobs for the
+ * printer (or all printers) from newest to oldest.  Otherwise the list
+ * contains all jobs by ID.  Compacted jobs are listed directly; full jobs get
+ * a temporary record that points to the job.  Use cupsdGetRecordJob() to get
+ * a job from a record and cupsdFreeJobRecords() to free the list.
  */
 
-cups_array_t *				/* O - Array of jobs */
-cupsdGetCompletedJobs(
-    cupsd_printer_t *p)			/* I - Printer */
+cups_array_t *				/* O - Array of job records */
+cupsdGetJobRecords(
+    cupsd_printer_t *p,			/* I - Printer or NULL for all */
+    int             completed)		/* I - 1 for completed jobs, 0 for all */
 {
-  cups_array_t	*list;			/* Array of jobs */
+  cups_array_t	*list;			/* Array of job records */
   cupsd_job_t	*job;			/* Current job */
+  cupsd_jobrec_t *rec,			/* Current compacted job */
+		*temps,			/* Records for full jobs */
+		*temp;			/* Current record for a full job */
+
 
+  if ((temps = calloc((size_t)cupsArrayCount(Jobs) + 1, sizeof(cupsd_jobrec_t))) == NULL)
+    return (NULL);
 
-  list = cupsArrayNew(compare_completed_jobs, NULL);
+  list = cupsArrayNew(completed ? compare_completed_records : compare_records, temps);
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs), temp = temps;
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
-    if ((!p || !_cups_strcasecmp(p->name, job->dest)) && job->state_value >= IPP_JOB_STOPPED && job->completed_time)
-      cupsArrayAdd(list, job);
+  {
+    if (completed && (!job->completed_time || job->state_value < IPP_JOB_STOPPED || (p && _cups_strcasecmp(p->name, job->dest))))
+      continue;
+
+    temp->id             = job->id;
+    temp->completed_time = job->completed_time;
+    temp->job            = job;
+
+    cupsArrayAdd(list, temp ++);
+  }
+
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+    if (!completed || !p || !_cups_strcasecmp(p->name, rec->dest))
+      cupsArrayAdd(list, rec);
 
   return (list);
 }
@@ -1515,6 +2486,40 @@ cupsdGetPrinterJobCount(
 }
 
 
+/*
+ * 'cupsdGetRecordJob()' - Get the job for a job record.
+ *
+ * Compacted jobs are copied to the buffer, which only has the job summary and
+ * no attributes.  Use cupsdFindJob() to get the full job when needed.
+ */
+
+cupsd_job_t *				/* O - Job */
+cupsdGetRecordJob(cupsd_jobrec_t *rec,	/* I - Job record */
+                  cupsd_job_t    *buffer)/* I - Buffer for compacted job */
+{
+  if (rec->job)
+    return (rec->job);
+
+  memset(buffer, 0, sizeof(cupsd_job_t));
+
+  buffer->id             = rec->id;
+  buffer->priority       = rec->priority;
+  buffer->state_value    = rec->state_value;
+  buffer->username       = rec->username;
+  buffer->dest           = rec->dest;
+  buffer->name           = rec->name;
+  buffer->koctets        = rec->koctets;
+  buffer->dtype          = rec->dtype;
+  buffer->num_files      = rec->num_files;
+  buffer->filetypes      = rec->filetypes;
+  buffer->compressions   = rec->compressions;
+  buffer->creation_time  = rec->creation_time;
+  buffer->completed_time = rec->completed_time;
+
+  return (buffer);
+}
+
+
 /*
  * 'cupsdGetUserJobCount()' - Get the number of pending, processing,
  *                            or held jobs for a user.
@@ -1539,37 +2544,196 @@ cupsdGetUserJobCount(
 
 
 /*
- * 'cupsdLoadAllJobs()' - Load all jobs from disk.
+ * 'cupsdHandoffJobs()' - Save the printing jobs for a scheduler upgrade.
+ *
+ * Output that is being pre-rendered is thrown away since the new scheduler
+ * purges the pre-rendered files when it loads the jobs.
  */
 
 void
-cupsdLoadAllJobs(void)
+cupsdHandoffJobs(cups_file_t *fp)	/* I - Upgrade state file */
 {
-  char		filename[1024];		/* Full filename of job.cache file */
-  struct stat	fileinfo;		/* Information on job.cache file */
-  cups_dir_t	*dir;			/* RequestRoot dir */
-  cups_dentry_t	*dent;			/* Entry in RequestRoot */
-  int		load_cache = 1;		/* Load the job.cache file? */
+  int		i;			/* Looping var */
+  cupsd_job_t	*job;			/* Current job */
+  int		*fds[4];		/* Pipes to hand off */
 
 
- /*
-  * Create the job arrays as needed...
+  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+    if (job->prerender == CUPSD_PRERENDER_RUNNING)
+      cupsdDiscardPrerender(job);
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(PrintingJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
+  {
+    if (job->state_value != IPP_JOB_PROCESSING || !job->printer)
+      continue;
+
+    cupsFilePrintf(fp, "Job %d %s %d %d %d %d %d %d %ld %ld %d", job->id,
+                   job->printer->name, job->cost, job->pending_cost,
+		   job->current_file, job->status, job->progress, job->tries,
+		   (long)job->cancel_time, (long)job->kill_time, job->backend);
+
+    fds[0] = job->status_pipes;
+    fds[1] = job->print_pipes;
+    fds[2] = job->back_pipes;
+    fds[3] = job->side_pipes;
+
+    for (i = 0; i < 8; i ++)
+    {
+      cupsFilePrintf(fp, " %d", fds[i / 2][i & 1]);
+      cupsdHandoffFD(fds[i / 2][i & 1]);
+    }
+
+    for (i = 0; job->filters[i]; i ++)
+      cupsFilePrintf(fp, " %d", job->filters[i]);
+
+   /*
+    * Unread status messages are hex-encoded since they may contain newlines...
+    */
+
+    if (job->status_buffer && job->status_buffer->bufused > 0)
+    {
+      cupsFilePrintf(fp, " 0 %d ", job->status_buffer->bufused);
+
+      for (i = 0; i < job->status_buffer->bufused; i ++)
+        cupsFilePrintf(fp, "%02x", job->status_buffer->buffer[(job->status_buffer->bufstart + i) % CUPSD_SB_BUFFER_SIZE] & 255);
+
+      cupsFilePuts(fp, "\n");
+    }
+    else
+      cupsFilePuts(fp, " 0 0\n");
+
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Handing off job for scheduler upgrade.");
+  }
+}
+
+
+/*
+ * 'cupsdLoadAllJobs()' - Load all jobs from disk.
+ */
+
+void
+cupsdLoadAllJobs(void)
+{
+  char		filename[1024],		/* Full filename of job.cache file */
+		journal[1024];		/* Full filename of job.journal file */
+  struct stat	fileinfo,		/* Information on job.cache file */
+		journalinfo;		/* Information on job.journal file */
+  cups_array_t	*dirs;			/* RequestRoot directories */
+  const char	*dirname;		/* Current directory */
+  cups_dir_t	*dir;			/* RequestRoot dir */
+  cups_dentry_t	*dent;			/* Entry in RequestRoot */
+  int		load_cache = 1;		/* Load the job.cache file? */
+  cupsd_job_t	*job;			/* Current job */
+  cupsd_docref_t *doc;			/* Shared document */
+
+
+ /*
+  * Create the job arrays as needed...
   */
 
   if (!Jobs)
-    Jobs = cupsArrayNew(compare_jobs, NULL);
+    Jobs = _cupsArrayNewChunked(compare_jobs, NULL, NULL, 0, NULL, NULL);
+
+  if (!CompactJobs)
+    CompactJobs = _cupsArrayNewChunked(compare_records, NULL, NULL, 0, NULL, NULL);
 
   if (!ActiveJobs)
-    ActiveJobs = cupsArrayNew(compare_active_jobs, NULL);
+    ActiveJobs = _cupsArrayNewChunked(compare_active_jobs, NULL, NULL, 0, NULL, NULL);
 
   if (!PrintingJobs)
     PrintingJobs = cupsArrayNew(compare_jobs, NULL);
 
+  if (!JobTimeouts)
+    JobTimeouts = cupsArrayNew(compare_timeout_jobs, NULL);
+
+  if (!ReadyQueues)
+    ReadyQueues = cupsArrayNew(compare_queues, NULL);
+
+ /*
+  * The first save after loading always writes a full job.cache file...
+  */
+
+  journal_records     = -1;
+  num_journal_deleted = 0;
+
+ /*
+  * Move job files to match the current SpoolLayout...
+  */
+
+  spool_shard = -1;
+
+  migrate_request_root();
+
+ /*
+  * Finish removing any files that were purged before a restart...
+  */
+
+  if (cupsdCheckPermissions(RequestRoot, "purge", 0710, RunUser, Group, 1, -1) < 0)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create purge directory \"%s/purge\": %s", RequestRoot, strerror(errno));
+  else
+  {
+    snprintf(filename, sizeof(filename), "%s/purge", RequestRoot);
+
+    if ((dir = cupsDirOpen(filename)) != NULL)
+    {
+      while ((dent = cupsDirRead(dir)) != NULL)
+      {
+	snprintf(journal, sizeof(journal), "%s/purge/%s", RequestRoot, dent->filename);
+	cupsdPurgeFile(journal);
+      }
+
+      cupsDirClose(dir);
+    }
+  }
+
+ /*
+  * Pre-rendered and cached output does not survive a restart...
+  */
+
+  if (cupsdCheckPermissions(RequestRoot, "render", 0710, RunUser, Group, 1, -1) < 0)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create render directory \"%s/render\": %s", RequestRoot, strerror(errno));
+  else
+  {
+    snprintf(filename, sizeof(filename), "%s/render", RequestRoot);
+
+    if ((dir = cupsDirOpen(filename)) != NULL)
+    {
+      while ((dent = cupsDirRead(dir)) != NULL)
+      {
+	snprintf(journal, sizeof(journal), "%s/render/%s", RequestRoot, dent->filename);
+	purge_file(journal);
+      }
+
+      cupsDirClose(dir);
+    }
+  }
+
+  prerender_total    = 0;
+  render_cache_total = 0;
+
+  if (render_cache)
+  {
+    cupsd_rendered_t	*entry;		/* Cached output */
+
+    for (entry = (cupsd_rendered_t *)cupsArrayFirst(render_cache);
+         entry;
+	 entry = (cupsd_rendered_t *)cupsArrayNext(render_cache))
+      free(entry);
+
+    cupsArrayDelete(render_cache);
+    render_cache = NULL;
+  }
+
  /*
   * See whether the job.cache file is older than the RequestRoot directory...
   */
 
   snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
+  snprintf(journal, sizeof(journal), "%s/job.journal", CacheDir);
 
   if (stat(filename, &fileinfo))
   {
@@ -1584,7 +2748,7 @@ cupsdLoadAllJobs(void)
                       "Unable to get file information for \"%s\" - %s",
 		      filename, strerror(errno));
   }
-  else if ((dir = cupsDirOpen(RequestRoot)) == NULL)
+  else if ((dirs = get_request_dirs()) == NULL)
   {
    /*
     * No spool directory...
@@ -1594,20 +2758,41 @@ cupsdLoadAllJobs(void)
   }
   else
   {
-    while ((dent = cupsDirRead(dir)) != NULL)
+   /*
+    * Changes since job.cache was written are appended to job.journal, so use
+    * the newer of the two...
+    */
+
+    if (!stat(journal, &journalinfo) && journalinfo.st_mtime > fileinfo.st_mtime)
+      fileinfo.st_mtime = journalinfo.st_mtime;
+
+    for (dirname = (const char *)cupsArrayFirst(dirs);
+         dirname && load_cache;
+	 dirname = (const char *)cupsArrayNext(dirs))
     {
-      if (strlen(dent->filename) >= 6 && dent->filename[0] == 'c' && dent->fileinfo.st_mtime > fileinfo.st_mtime)
+      if ((dir = cupsDirOpen(dirname)) == NULL)
       {
-       /*
-        * Job history file is newer than job.cache file...
-	*/
-
         load_cache = 0;
 	break;
       }
+
+      while ((dent = cupsDirRead(dir)) != NULL)
+      {
+	if (strlen(dent->filename) >= 6 && dent->filename[0] == 'c' && dent->fileinfo.st_mtime > fileinfo.st_mtime)
+	{
+	 /*
+	  * Job history file is newer than job.cache file...
+	  */
+
+	  load_cache = 0;
+	  break;
+	}
+      }
+
+      cupsDirClose(dir);
     }
 
-    cupsDirClose(dir);
+    cupsArrayDelete(dirs);
   }
 
  /*
@@ -1620,7 +2805,7 @@ cupsdLoadAllJobs(void)
     * Load the job.cache file...
     */
 
-    load_job_cache(filename);
+    load_job_cache(filename, journal);
   }
   else
   {
@@ -1637,8 +2822,41 @@ cupsdLoadAllJobs(void)
   * Clean out old jobs as needed...
   */
 
-  if (MaxJobs > 0 && cupsArrayCount(Jobs) >= MaxJobs)
+  if (MaxJobs > 0 && (cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs)) >= MaxJobs)
     cupsdCleanJobs();
+
+ /*
+  * Compress any preserved documents we haven't gotten to yet...
+  */
+
+  if (DeduplicateJobFiles)
+  {
+   /*
+    * Reload the document store since RequestRoot may have changed...
+    */
+
+    for (doc = (cupsd_docref_t *)cupsArrayFirst(doc_hashes);
+         doc;
+	 doc = (cupsd_docref_t *)cupsArrayNext(doc_hashes))
+      free(doc);
+
+    cupsArrayDelete(doc_hashes);
+    cupsArrayDelete(doc_inodes);
+
+    doc_hashes = NULL;
+    doc_inodes = NULL;
+
+    load_doc_store();
+  }
+
+  if (CompressJobFiles)
+  {
+    for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+	 job;
+	 job = (cupsd_job_t *)cupsArrayNext(Jobs))
+      if (job->state_value >= IPP_JOB_CANCELED && job->num_files > 0)
+	queue_compression(job);
+  }
 }
 
 
@@ -1668,32 +2886,36 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     return (1);
   }
 
-  if ((job->attrs = ippNew()) == NULL)
-  {
-    cupsdLogJob(job, CUPSD_LOG_ERROR, "Ran out of memory for job attributes.");
-    return (0);
-  }
+  cupsdLogJob(job, CUPSD_LOG_DEBUG, "Loading attributes...");
 
  /*
-  * Load job attributes...
+  * Use the control file read by a startup thread, if any, otherwise load job
+  * attributes here...
   */
 
-  cupsdLogJob(job, CUPSD_LOG_DEBUG, "Loading attributes...");
+  if ((job->attrs = get_job_load(job)) == NULL)
+  {
+    if ((job->attrs = ippNew()) == NULL)
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Ran out of memory for job attributes.");
+      return (0);
+    }
 
-  snprintf(jobfile, sizeof(jobfile), "%s/c%05d", RequestRoot, job->id);
-  if ((fp = cupsdOpenConfFile(jobfile)) == NULL)
-    goto error;
+    cupsdGetJobFilename(job->id, 'c', 0, jobfile, sizeof(jobfile));
+    if ((fp = cupsdOpenConfFile(jobfile)) == NULL)
+      goto error;
+
+    if (!read_job_attrs(job->attrs, fp))
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR,
+		  "Unable to read job control file \"%s\".", jobfile);
+      cupsFileClose(fp);
+      goto error;
+    }
 
-  if (ippReadIO(fp, (ipp_iocb_t)cupsFileRead, 1, NULL, job->attrs) != IPP_DATA)
-  {
-    cupsdLogJob(job, CUPSD_LOG_ERROR,
-		"Unable to read job control file \"%s\".", jobfile);
     cupsFileClose(fp);
-    goto error;
   }
 
-  cupsFileClose(fp);
-
  /*
   * Copy attribute data to the job object...
   */
@@ -1906,6 +3128,8 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     job->state_value              = IPP_JOB_PENDING;
   }
 
+  cupsdUpdateJobQueues(job);
+
   if ((attr = ippFindAttribute(job->attrs, "job-k-octets", IPP_TAG_INTEGER)) != NULL)
     job->koctets = attr->values[0].integer;
 
@@ -1917,8 +3141,7 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
 
     for (fileid = 1; fileid < 10000; fileid ++)
     {
-      snprintf(jobfile, sizeof(jobfile), "%s/d%05d-%03d", RequestRoot,
-               job->id, fileid);
+      cupsdGetJobFilename(job->id, 'd', fileid, jobfile, sizeof(jobfile));
 
       if (access(jobfile, 0))
         break;
@@ -1987,7 +3210,7 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
 
   if (job->state_value < IPP_JOB_STOPPED)
   {
-    snprintf(jobfile, sizeof(jobfile), "%s/a%05d", RequestRoot, job->id);
+    cupsdGetJobFilename(job->id, 'a', 0, jobfile, sizeof(jobfile));
 
     for (i = 0;
 	 i < (int)(sizeof(job->auth_env) / sizeof(job->auth_env[0]));
@@ -2070,6 +3293,29 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
 }
 
 
+/*
+ * 'cupsdLogFilterUsage()' - Log the resource usage of each filter and backend.
+ */
+
+void
+cupsdLogFilterUsage(void)
+{
+  cupsd_filterusage_t	*fu;		/* Current program */
+
+
+  for (fu = (cupsd_filterusage_t *)cupsArrayFirst(filter_usage);
+       fu;
+       fu = (cupsd_filterusage_t *)cupsArrayNext(filter_usage))
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: filter-%s-runs=%d", fu->name, fu->count);
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: filter-%s-elapsed-seconds=%.3f", fu->name, fu->wall);
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: filter-%s-user-seconds=%.3f", fu->name, fu->user);
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: filter-%s-system-seconds=%.3f", fu->name, fu->sys);
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: filter-%s-max-rss-kbytes=%ld", fu->name, fu->maxrss);
+  }
+}
+
+
 /*
  * 'cupsdMoveJob()' - Move the specified job to a different destination.
  */
@@ -2116,6 +3362,10 @@ cupsdMoveJob(cupsd_job_t     *job,	/* I - Job */
   cupsdSetString(&job->dest, p->name);
   job->dtype = p->type & (CUPS_PRINTER_CLASS | CUPS_PRINTER_REMOTE);
 
+  cupsdDiscardPrerender(job);
+
+  cupsdUpdateJobQueues(job);
+
   if ((attr = ippFindAttribute(job->attrs, "job-printer-uri",
                                IPP_TAG_URI)) != NULL)
     ippSetString(job->attrs, &attr, 0, p->uri);
@@ -2172,6 +3422,9 @@ cupsdRestartJob(cupsd_job_t *job)	/* I - Job */
 
 /*
  * 'cupsdSaveAllJobs()' - Save a summary of all jobs to disk.
+ *
+ * Changes are normally appended to the job.journal file, which is folded into
+ * a new job.cache file once it holds more records than there are jobs.
  */
 
 void
@@ -2180,12 +3433,85 @@ cupsdSaveAllJobs(void)
   int		i;			/* Looping var */
   cups_file_t	*fp;			/* job.cache file */
   char		filename[1024],		/* job.cache filename */
+		journal[1024],		/* job.journal filename */
 		temp[1024];		/* Temporary string */
-  cupsd_job_t	*job;			/* Current job */
+  cupsd_job_t	*job,			/* Current job */
+		summary;		/* Summary of compacted job */
+  cupsd_jobrec_t *rec;			/* Current compacted job */
   time_t	curtime;		/* Current time */
   struct tm	curdate;		/* Current date */
 
 
+  snprintf(journal, sizeof(journal), "%s/job.journal", CacheDir);
+
+  if (journal_records >= 0 && journal_records < (cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs)))
+  {
+   /*
+    * Append the jobs that have changed to the journal...
+    */
+
+    if ((fp = cupsFileOpen(journal, "a")) == NULL)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open \"%s\": %s", journal,
+                      strerror(errno));
+    }
+    else
+    {
+      if (!journal_records)
+      {
+	if (!getuid() && fchown(cupsFileNumber(fp), getuid(), Group))
+	  cupsdLogMessage(CUPSD_LOG_WARN,
+	                  "Unable to change group for \"%s\": %s", journal,
+			  strerror(errno));
+
+	if (fchmod(cupsFileNumber(fp), ConfigFilePerm))
+	  cupsdLogMessage(CUPSD_LOG_WARN,
+			  "Unable to change permissions for \"%s\": %s",
+			  journal, strerror(errno));
+      }
+
+      for (i = 0; i < num_journal_deleted; i ++)
+        cupsFilePrintf(fp, "Delete %d\n", journal_deleted[i]);
+
+      journal_records     += num_journal_deleted;
+      num_journal_deleted = 0;
+
+      for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+	   job;
+	   job = (cupsd_job_t *)cupsArrayNext(Jobs))
+      {
+        if (!job->journal)
+	  continue;
+
+	job->journal = 0;
+
+	if (job->printer && job->printer->temporary)
+	  continue;
+
+        write_job_cache(fp, job);
+	journal_records ++;
+      }
+
+      cupsFilePrintf(fp, "NextJobId %d\n", NextJobId);
+
+      cupsdSyncFile(fp, journal);
+
+      if (!cupsFileClose(fp))
+      {
+        cupsdLogMessage(CUPSD_LOG_DEBUG, "Updated job.journal, %d records.",
+	                journal_records);
+        return;
+      }
+
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write \"%s\": %s", journal,
+                      strerror(errno));
+    }
+  }
+
+ /*
+  * Write a new job.cache file...
+  */
+
   snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
   if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
     return;
@@ -2212,6 +3538,8 @@ cupsdSaveAllJobs(void)
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
   {
+    job->journal = 0;
+
     if (job->printer && job->printer->temporary)
     {
      /*
@@ -2221,28 +3549,29 @@ cupsdSaveAllJobs(void)
       continue;
     }
 
-    cupsFilePrintf(fp, "<Job %d>\n", job->id);
-    cupsFilePrintf(fp, "State %d\n", job->state_value);
-    cupsFilePrintf(fp, "Created %ld\n", (long)job->creation_time);
-    if (job->completed_time)
-      cupsFilePrintf(fp, "Completed %ld\n", (long)job->completed_time);
-    cupsFilePrintf(fp, "Priority %d\n", job->priority);
-    if (job->hold_until)
-      cupsFilePrintf(fp, "HoldUntil %ld\n", (long)job->hold_until);
-    cupsFilePrintf(fp, "Username %s\n", job->username);
-    if (job->name)
-      cupsFilePutConf(fp, "Name", job->name);
-    cupsFilePrintf(fp, "Destination %s\n", job->dest);
-    cupsFilePrintf(fp, "DestType %d\n", job->dtype);
-    cupsFilePrintf(fp, "KOctets %d\n", job->koctets);
-    cupsFilePrintf(fp, "NumFiles %d\n", job->num_files);
-    for (i = 0; i < job->num_files; i ++)
-      cupsFilePrintf(fp, "File %d %s/%s %d\n", i + 1, job->filetypes[i]->super,
-                     job->filetypes[i]->type, job->compressions[i]);
-    cupsFilePuts(fp, "</Job>\n");
+    write_job_cache(fp, job);
   }
 
-  cupsdCloseCreatedConfFile(fp, filename);
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+    write_job_cache(fp, cupsdGetRecordJob(rec, &summary));
+
+ /*
+  * Remove the old journal before the new job.cache file replaces the old
+  * one - if we crash in between, the control files will be newer than
+  * job.cache and we'll reload from the spool directory...
+  */
+
+  if (unlink(journal) && errno != ENOENT)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to remove \"%s\": %s", journal,
+                    strerror(errno));
+
+  if (!cupsdCloseCreatedConfFile(fp, filename))
+  {
+    journal_records     = 0;
+    num_journal_deleted = 0;
+  }
 }
 
 
@@ -2270,7 +3599,7 @@ cupsdSaveJob(cupsd_job_t *job)		/* I - Job */
     return;
   }
 
-  snprintf(filename, sizeof(filename), "%s/c%05d", RequestRoot, job->id);
+  cupsdGetJobFilename(job->id, 'c', 0, filename, sizeof(filename));
 
   if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm & 0600)) == NULL)
     return;
@@ -2296,7 +3625,8 @@ cupsdSaveJob(cupsd_job_t *job)		/* I - Job */
     strlcat(filename, ".O", sizeof(filename));
     unlink(filename);
 
-    job->dirty = 0;
+    job->dirty   = 0;
+    job->journal = 1;
   }
 }
 
@@ -2478,6 +3808,8 @@ cupsdSetJobHoldUntil(cupsd_job_t *job,	/* I - Job */
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdSetJobHoldUntil: hold_until=%d",
                   (int)job->hold_until);
+
+  cupsdUpdateJobQueues(job);
 }
 
 
@@ -2507,6 +3839,9 @@ cupsdSetJobPriority(
 
   cupsArrayRemove(ActiveJobs, job);
 
+  if (job->queue)
+    cupsArrayRemove(job->queue->jobs, job);
+
   job->priority = priority;
 
   if ((attr = ippFindAttribute(job->attrs, "job-priority",
@@ -2518,6 +3853,9 @@ cupsdSetJobPriority(
 
   cupsArrayAdd(ActiveJobs, job);
 
+  if (job->queue)
+    cupsArrayAdd(job->queue->jobs, job);
+
   job->dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 }
@@ -2570,6 +3908,9 @@ cupsdSetJobState(
   if (oldstate == IPP_JOB_PROCESSING)
     stop_job(job, action);
 
+  if (newstate >= IPP_JOB_CANCELED)
+    cupsdDiscardPrerender(job);
+
  /*
   * Set the new job state...
   */
@@ -2713,7 +4054,7 @@ cupsdSetJobState(
 	* Remove any authentication data...
 	*/
 
-	snprintf(filename, sizeof(filename), "%s/a%05d", RequestRoot, job->id);
+	cupsdGetJobFilename(job->id, 'a', 0, filename, sizeof(filename));
 	if (cupsdRemoveFile(filename) && errno != ENOENT)
 	  cupsdLogMessage(CUPSD_LOG_ERROR,
 			  "Unable to remove authentication cache: %s",
@@ -2733,6 +4074,8 @@ cupsdSetJobState(
 
 	if (!JobHistory || !JobFiles || action == CUPSD_JOB_PURGE)
 	  remove_job_files(job);
+	else
+	  queue_compression(job);
 
 	if (JobHistory && action != CUPSD_JOB_PURGE)
 	{
@@ -2762,6 +4105,13 @@ cupsdSetJobState(
   if (action >= CUPSD_JOB_FORCE && job && job->printer)
     finalize_job(job, 0);
 
+ /*
+  * Update the deadline index...
+  */
+
+  if (job)
+    cupsdUpdateJobQueues(job);
+
  /*
   * Update the server "busy" state...
   */
@@ -2771,34 +4121,128 @@ cupsdSetJobState(
 
 
 /*
- * 'cupsdStopAllJobs()' - Stop all print jobs.
+ * 'cupsdShareJobFile()' - Share a document with identical ones in the store.
+ *
+ * Identical documents are hard-linked to a single file in the "store"
+ * subdirectory of RequestRoot, so the link count of a store file is one more
+ * than the number of documents using it.
  */
 
 void
-cupsdStopAllJobs(
-    cupsd_jobaction_t action,		/* I - Action */
-    int               kill_delay)	/* I - Number of seconds before we kill */
+cupsdShareJobFile(cupsd_job_t *job,	/* I - Job */
+                  int         number,	/* I - Document number */
+		  unsigned    hash)	/* I - Hash of document data */
 {
-  cupsd_job_t	*job;			/* Current job */
+  char			filename[1024],	/* Document filename */
+			tempfile[1040];	/* Temporary link */
+  struct stat		fileinfo;	/* Document information */
+  cupsd_docref_t	key,		/* Search key */
+			*doc;		/* Shared document */
 
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(PrintingJobs);
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
+  if (!DeduplicateJobFiles || !load_doc_store())
+    return;
+
+  cupsdGetJobFilename(job->id, 'd', number, filename, sizeof(filename));
+
+  if (stat(filename, &fileinfo) || fileinfo.st_size == 0)
+    return;
+
+ /*
+  * Look for a shared document with the same contents...
+  */
+
+  key.hash = hash;
+  key.size = fileinfo.st_size;
+
+  for (doc = (cupsd_docref_t *)cupsArrayFind(doc_hashes, &key);
+       doc && !compare_doc_hashes(doc, &key, NULL);
+       doc = (cupsd_docref_t *)cupsArrayNext(doc_hashes))
   {
-    if (job->completed)
+    if (!same_contents(doc->filename, filename))
+      continue;
+
+   /*
+    * Replace the document with a link to the shared copy...
+    */
+
+    snprintf(tempfile, sizeof(tempfile), "%s.link", filename);
+
+    if (link(doc->filename, tempfile))
     {
-      cupsdSetJobState(job, IPP_JOB_COMPLETED, CUPSD_JOB_FORCE, NULL);
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Unable to link document %d to \"%s\": %s", number, doc->filename, strerror(errno));
+      return;
     }
-    else
-    {
-      if (kill_delay)
-        job->kill_time = time(NULL) + kill_delay;
 
-      cupsdSetJobState(job, IPP_JOB_PENDING, action, NULL);
+    if (rename(tempfile, filename))
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to replace document %d with shared copy: %s", number, strerror(errno));
+      unlink(tempfile);
+      return;
     }
+
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Document %d shares \"%s\".", number, doc->filename);
+    return;
   }
-}
+
+ /*
+  * No match, add this document to the store...
+  */
+
+  if ((doc = calloc(1, sizeof(cupsd_docref_t))) == NULL)
+    return;
+
+  doc->hash = hash;
+  doc->size = fileinfo.st_size;
+  doc->dev  = fileinfo.st_dev;
+  doc->ino  = fileinfo.st_ino;
+
+  snprintf(doc->filename, sizeof(doc->filename), "%s/store/%08x-%d", RequestRoot, hash, ++ doc_serial);
+
+  if (link(filename, doc->filename))
+  {
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Unable to add document %d to the store: %s", number, strerror(errno));
+    free(doc);
+    return;
+  }
+
+  cupsArrayAdd(doc_hashes, doc);
+  cupsArrayAdd(doc_inodes, doc);
+}
+
+
+/*
+ * 'cupsdStopAllJobs()' - Stop all print jobs.
+ */
+
+void
+cupsdStopAllJobs(
+    cupsd_jobaction_t action,		/* I - Action */
+    int               kill_delay)	/* I - Number of seconds before we kill */
+{
+  cupsd_job_t	*job;			/* Current job */
+
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(PrintingJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
+  {
+    if (job->completed)
+    {
+      cupsdSetJobState(job, IPP_JOB_COMPLETED, CUPSD_JOB_FORCE, NULL);
+    }
+    else
+    {
+      if (kill_delay)
+      {
+        job->kill_time = time(NULL) + kill_delay;
+        cupsdUpdateJobQueues(job);
+      }
+
+      cupsdSetJobState(job, IPP_JOB_PENDING, action, NULL);
+    }
+  }
+}
 
 
 /*
@@ -2810,21 +4254,37 @@ cupsdUnloadCompletedJobs(void)
 {
   cupsd_job_t	*job;			/* Current job */
   time_t	expire;			/* Expiration time */
+  struct timeval start;			/* Start of this pass */
 
 
   expire = time(NULL) - 60;
 
+  gettimeofday(&start, NULL);
+
+ /*
+  * Jobs that are left over when the time slice runs out are unloaded on the
+  * next call...
+  */
+
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
-    if (job->attrs && job->state_value >= IPP_JOB_STOPPED && !job->printer &&
+    if (job->state_value >= IPP_JOB_STOPPED && !job->printer &&
         job->access_time < expire)
     {
-      if (job->dirty)
-        cupsdSaveJob(job);
+      if (job->attrs)
+      {
+	if (job->dirty)
+	  cupsdSaveJob(job);
+
+	if (!job->dirty)
+	  unload_job(job);
+      }
+      else if (!compact_job(job))
+        continue;
 
-      if (!job->dirty)
-        unload_job(job);
+      if (slice_expired(&start))
+        break;
     }
 }
 
@@ -2837,6 +4297,7 @@ void
 cupsdUpdateJobs(void)
 {
   cupsd_job_t		*job;		/* Current job */
+  cupsd_jobrec_t	*rec;		/* Current compacted job */
   time_t		curtime;	/* Current time */
   ipp_attribute_t	*attr;		/* time-at-completed attribute */
 
@@ -2844,6 +4305,28 @@ cupsdUpdateJobs(void)
   curtime          = time(NULL);
   JobHistoryUpdate = 0;
 
+ /*
+  * Compacted jobs only have their completion time, which is all we need...
+  */
+
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+  {
+    if (JobHistory < INT_MAX && (rec->completed_time + JobHistory) < curtime)
+    {
+      if ((job = cupsdExpandJob(rec)) != NULL)
+        cupsdDeleteJob(job, CUPSD_JOB_PURGE);
+      continue;
+    }
+
+    if (JobHistory < INT_MAX && ((rec->completed_time + JobHistory) < JobHistoryUpdate || !JobHistoryUpdate))
+      JobHistoryUpdate = rec->completed_time + JobHistory;
+
+    if (JobFiles < INT_MAX && rec->num_files > 0 && ((rec->completed_time + JobFiles) < JobHistoryUpdate || !JobHistoryUpdate))
+      JobHistoryUpdate = rec->completed_time + JobFiles;
+  }
+
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
@@ -2890,1374 +4373,3227 @@ cupsdUpdateJobs(void)
 
 
 /*
- * 'compare_active_jobs()' - Compare the job IDs and priorities of two jobs.
+ * 'cupsdUpdateJobQueues()' - Update the deadline index and pending queue for a
+ *                            job after changing its state, destination, or
+ *                            kill, cancel, or hold times.
  */
 
-static int				/* O - Difference */
-compare_active_jobs(void *first,	/* I - First job */
-                    void *second,	/* I - Second job */
-		    void *data)		/* I - App data (not used) */
+void
+cupsdUpdateJobQueues(cupsd_job_t *job)	/* I - Job */
 {
-  int	diff;				/* Difference */
+  time_t	timeout = 0;		/* Nearest deadline */
+  cupsd_jobq_t	key,			/* Search key */
+		*queue;			/* Pending queue */
 
 
-  (void)data;
+  if (!JobTimeouts || !ReadyQueues)
+    return;
 
-  if ((diff = ((cupsd_job_t *)second)->priority -
-              ((cupsd_job_t *)first)->priority) != 0)
-    return (diff);
-  else
-    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
-}
+  if (job->kill_time)
+    timeout = job->kill_time;
 
+  if (job->cancel_time && (!timeout || job->cancel_time < timeout))
+    timeout = job->cancel_time;
 
-/*
- * 'compare_completed_jobs()' - Compare the job IDs and completion times of two jobs.
- */
+ /*
+  * Held jobs are released when hold_until has passed, so wake up one second
+  * after it...
+  */
 
-static int				/* O - Difference */
-compare_completed_jobs(void *first,	/* I - First job */
-                       void *second,	/* I - Second job */
-		       void *data)	/* I - App data (not used) */
-{
-  int	diff;				/* Difference */
+  if (job->state_value == IPP_JOB_HELD && job->hold_until &&
+      (!timeout || (job->hold_until + 1) < timeout))
+    timeout = job->hold_until + 1;
 
+  if (timeout != job->timeout_time)
+  {
+    if (job->timeout_time)
+      cupsArrayRemove(JobTimeouts, job);
 
-  (void)data;
+    job->timeout_time = timeout;
 
-  if ((diff = ((cupsd_job_t *)second)->completed_time -
-              ((cupsd_job_t *)first)->completed_time) != 0)
-    return (diff);
-  else
-    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+    if (timeout)
+      cupsArrayAdd(JobTimeouts, job);
+  }
+
+ /*
+  * Pending jobs that have not been assigned to a printer go in the queue for
+  * their destination...
+  */
+
+  if (job->state_value == IPP_JOB_PENDING && !job->printer && job->dest)
+  {
+    if (job->queue && !_cups_strcasecmp(job->queue->dest, job->dest))
+      return;
+
+    if (job->queue)
+      cupsArrayRemove(job->queue->jobs, job);
+
+    key.dest = job->dest;
+
+    if ((queue = (cupsd_jobq_t *)cupsArrayFind(ReadyQueues, &key)) == NULL)
+    {
+      if ((queue = calloc(1, sizeof(cupsd_jobq_t))) == NULL)
+      {
+        job->queue = NULL;
+        return;
+      }
+
+      cupsdSetString(&queue->dest, job->dest);
+      queue->jobs = cupsArrayNew(compare_active_jobs, NULL);
+
+      cupsArrayAdd(ReadyQueues, queue);
+    }
+
+    cupsArrayAdd(queue->jobs, job);
+    job->queue = queue;
+  }
+  else if (job->queue)
+  {
+    cupsArrayRemove(job->queue->jobs, job);
+    job->queue = NULL;
+  }
 }
 
 
 /*
- * 'compare_jobs()' - Compare the job IDs of two jobs.
+ * 'cupsdUpdateJobUsage()' - Record the resource usage of a finished filter or
+ *                           backend.
  */
 
-static int				/* O - Difference */
-compare_jobs(void *first,		/* I - First job */
-             void *second,		/* I - Second job */
-	     void *data)		/* I - App data (not used) */
+void
+cupsdUpdateJobUsage(
+    cupsd_job_t   *job,			/* I - Job */
+    int           pid,			/* I - Process ID */
+    struct rusage *usage)		/* I - Resource usage or NULL */
 {
-  (void)data;
+  int			i;		/* Looping var */
+  cupsd_jobusage_t	*ju;		/* Usage record for process */
+  cupsd_filterusage_t	key,		/* Search key */
+			*fu;		/* Usage totals for program */
+  struct timeval	curtime;	/* Current time */
 
-  return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+
+  for (i = job->num_usage, ju = job->usage; i > 0; i --, ju ++)
+    if (ju->pid == pid)
+      break;
+
+  if (i <= 0)
+    return;
+
+  gettimeofday(&curtime, NULL);
+
+  ju->wall = (curtime.tv_sec - ju->start.tv_sec) + 0.000001 * (curtime.tv_usec - ju->start.tv_usec);
+
+  if (usage)
+  {
+    ju->user   = usage->ru_utime.tv_sec + 0.000001 * usage->ru_utime.tv_usec;
+    ju->sys    = usage->ru_stime.tv_sec + 0.000001 * usage->ru_stime.tv_usec;
+#ifdef __APPLE__
+    ju->maxrss = usage->ru_maxrss / 1024;	/* Bytes on macOS */
+#else
+    ju->maxrss = usage->ru_maxrss;
+#endif /* __APPLE__ */
+  }
+
+ /*
+  * Add to the totals for the program...
+  */
+
+  if (!filter_usage)
+    filter_usage = cupsArrayNew((cups_array_func_t)compare_filter_usage, NULL);
+
+  strlcpy(key.name, ju->name, sizeof(key.name));
+
+  if ((fu = (cupsd_filterusage_t *)cupsArrayFind(filter_usage, &key)) == NULL)
+  {
+    if ((fu = calloc(1, sizeof(cupsd_filterusage_t))) == NULL)
+      return;
+
+    strlcpy(fu->name, ju->name, sizeof(fu->name));
+    cupsArrayAdd(filter_usage, fu);
+  }
+
+  fu->count ++;
+  fu->wall += ju->wall;
+  fu->user += ju->user;
+  fu->sys  += ju->sys;
+
+  if (ju->maxrss > fu->maxrss)
+    fu->maxrss = ju->maxrss;
 }
 
 
 /*
- * 'dump_job_history()' - Dump any debug messages for a job.
+ * 'add_job_usage()' - Start tracking the resource usage of a job process.
  */
 
 static void
-dump_job_history(cupsd_job_t *job)	/* I - Job */
+add_job_usage(cupsd_job_t *job,		/* I - Job */
+              int         pid,		/* I - Process ID */
+              const char  *command)	/* I - Program that was started */
 {
-  int			i,		/* Looping var */
-			oldsize;	/* Current MaxLogSize */
-  struct tm		date;		/* Date/time value */
-  cupsd_joblog_t	*message;	/* Current message */
-  char			temp[2048],	/* Log message */
-			*ptr,		/* Pointer into log message */
-			start[256],	/* Start time */
-			end[256];	/* End time */
-  cupsd_printer_t	*printer;	/* Printer for job */
-
+  cupsd_jobusage_t	*usage;		/* New usage record */
+  const char		*name;		/* Program name */
 
- /*
-  * See if we have anything to dump...
-  */
 
-  if (!job->history)
+  if ((usage = realloc(job->usage, (size_t)(job->num_usage + 1) * sizeof(cupsd_jobusage_t))) == NULL)
     return;
 
- /*
-  * Disable log rotation temporarily...
-  */
+  job->usage = usage;
+  usage      += job->num_usage ++;
 
-  oldsize    = MaxLogSize;
-  MaxLogSize = 0;
+  if ((name = strrchr(command, '/')) != NULL)
+    name ++;
+  else
+    name = command;
 
- /*
-  * Copy the debug messages to the log...
-  */
+  memset(usage, 0, sizeof(cupsd_jobusage_t));
+  usage->pid = pid;
+  strlcpy(usage->name, name, sizeof(usage->name));
+  gettimeofday(&usage->start, NULL);
+}
 
-  message = (cupsd_joblog_t *)cupsArrayFirst(job->history);
-  localtime_r(&(message->time), &date);
-  strftime(start, sizeof(start), "%X", &date);
 
-  message = (cupsd_joblog_t *)cupsArrayLast(job->history);
-  localtime_r(&(message->time), &date);
-  strftime(end, sizeof(end), "%X", &date);
+/*
+ * 'add_render_cache()' - Add the pre-rendered output of a job to the render
+ *                        cache.
+ *
+ * The cache holds hard links to the output, so it takes no extra space while
+ * the job still has its copy.  The least recently used output is removed to
+ * stay within RenderCacheLimit.
+ */
 
-  snprintf(temp, sizeof(temp),
-           "[Job %d] The following messages were recorded from %s to %s",
-           job->id, start, end);
-  cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+static int				/* O - 1 if cached, 0 otherwise */
+add_render_cache(cupsd_job_t *job,	/* I - Job */
+                 off_t       size)	/* I - Size of output */
+{
+  cupsd_rendered_t	*entry,		/* New cache entry */
+			*current,	/* Current cache entry */
+			*oldest;	/* Least recently used entry */
+  char			filename[1024],	/* Pre-rendered output filename */
+			cachefile[1024];/* Cached output filename */
 
-  for (message = (cupsd_joblog_t *)cupsArrayFirst(job->history);
-       message;
-       message = (cupsd_joblog_t *)cupsArrayNext(job->history))
-    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, message->message);
 
-  snprintf(temp, sizeof(temp), "[Job %d] End of messages", job->id);
-  cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+  if (RenderCacheLimit <= 0 || !job->render_key || size > RenderCacheLimit)
+    return (0);
 
- /*
-  * Log the printer state values...
-  */
+  if (!render_cache)
+    render_cache = cupsArrayNew((cups_array_func_t)compare_rendered, NULL);
 
-  if ((printer = job->printer) == NULL)
-    printer = cupsdFindDest(job->dest);
+  if ((entry = calloc(1, sizeof(cupsd_rendered_t))) == NULL)
+    return (0);
 
-  if (printer)
+  strlcpy(entry->key, job->render_key, sizeof(entry->key));
+  entry->size = size;
+  entry->used = time(NULL);
+
+  if (cupsArrayFind(render_cache, entry))
   {
-    snprintf(temp, sizeof(temp), "[Job %d] printer-state=%d(%s)", job->id,
-             printer->state,
-	     printer->state == IPP_PRINTER_IDLE ? "idle" :
-	         printer->state == IPP_PRINTER_PROCESSING ? "processing" :
-		 "stopped");
-    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+   /*
+    * Another job with the same key was rendered first...
+    */
 
-    snprintf(temp, sizeof(temp), "[Job %d] printer-state-message=\"%s\"",
-             job->id, printer->state_message);
-    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+    free(entry);
+    return (0);
+  }
 
-    snprintf(temp, sizeof(temp), "[Job %d] printer-state-reasons=", job->id);
-    ptr = temp + strlen(temp);
-    if (printer->num_reasons == 0)
-      strlcpy(ptr, "none", sizeof(temp) - (size_t)(ptr - temp));
-    else
-    {
-      for (i = 0;
-           i < printer->num_reasons && ptr < (temp + sizeof(temp) - 2);
-           i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
+  snprintf(cachefile, sizeof(cachefile), "%s/render/%s", RequestRoot, entry->key);
+  if (link(get_render_filename(job, "", filename, sizeof(filename)), cachefile))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to cache rendered output: %s", strerror(errno));
+    free(entry);
+    return (0);
+  }
 
-	strlcpy(ptr, printer->reasons[i], sizeof(temp) - (size_t)(ptr - temp));
-	ptr += strlen(ptr);
-      }
-    }
-    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+  strlcat(cachefile, ".log", sizeof(cachefile));
+  if (link(get_render_filename(job, ".log", filename, sizeof(filename)), cachefile))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to cache rendered output: %s", strerror(errno));
+    cachefile[strlen(cachefile) - 4] = '\0';
+    unlink(cachefile);
+    free(entry);
+    return (0);
   }
 
- /*
-  * Restore log file rotation...
-  */
+  cupsdLogJob(job, CUPSD_LOG_DEBUG, "Cached rendered output as %s.", entry->key);
 
-  MaxLogSize = oldsize;
+  cupsArrayAdd(render_cache, entry);
+  render_cache_total += size;
 
  /*
-  * Free all messages...
+  * Remove the least recently used output until the cache fits again...
   */
 
-  free_job_history(job);
+  while (render_cache_total > RenderCacheLimit)
+  {
+    for (oldest = NULL, current = (cupsd_rendered_t *)cupsArrayFirst(render_cache);
+         current;
+	 current = (cupsd_rendered_t *)cupsArrayNext(render_cache))
+      if (current != entry && (!oldest || current->used < oldest->used))
+        oldest = current;
+
+    if (!oldest)
+      break;
+
+    snprintf(cachefile, sizeof(cachefile), "%s/render/%s", RequestRoot, oldest->key);
+    purge_file(cachefile);
+    strlcat(cachefile, ".log", sizeof(cachefile));
+    purge_file(cachefile);
+
+    render_cache_total -= oldest->size;
+
+    cupsArrayRemove(render_cache, oldest);
+    free(oldest);
+  }
+
+  return (1);
 }
 
 
 /*
- * 'free_job_history()' - Free any log history.
+ * 'can_prerender()' - Determine whether a job's output can be rendered ahead
+ *                     of time.
+ *
+ * Only single-document jobs without banner pages are pre-rendered.
  */
 
-static void
-free_job_history(cupsd_job_t *job)	/* I - Job */
+static int				/* O - 1 if possible, 0 otherwise */
+can_prerender(cupsd_job_t *job)		/* I - Job */
 {
-  char	*message;			/* Current message */
-
-
-  if (!job->history)
-    return;
+  ipp_attribute_t	*attr = job->job_sheets;
+					/* job-sheets attribute */
 
-  for (message = (char *)cupsArrayFirst(job->history);
-       message;
-       message = (char *)cupsArrayNext(job->history))
-    free(message);
 
-  cupsArrayDelete(job->history);
-  job->history = NULL;
+  return (job->num_files == 1 && !job->retry_as_raster &&
+          (!attr || !_cups_strcasecmp(ippGetString(attr, 0, NULL), "none")) &&
+	  (!attr || attr->num_values < 2 ||
+	   !_cups_strcasecmp(ippGetString(attr, 1, NULL), "none")));
 }
 
 
 /*
- * 'finalize_job()' - Cleanup after job filter processes and support data.
+ * 'compact_job()' - Replace an unloaded, completed job with a compact record.
+ *
+ * Only the summary that job.cache keeps is retained; the job is expanded
+ * again by cupsdFindJob() or cupsdExpandJob() when something needs it.
  */
 
-static void
-finalize_job(cupsd_job_t *job,		/* I - Job */
-             int         set_job_state)	/* I - 1 = set the job state */
+static int				/* O - 1 if compacted, 0 otherwise */
+compact_job(cupsd_job_t *job)		/* I - Job */
 {
-  ipp_pstate_t		printer_state;	/* New printer state value */
-  ipp_jstate_t		job_state;	/* New job state value */
-  const char		*message;	/* Message for job state */
-  char			buffer[1024];	/* Buffer for formatted messages */
+  int			i;		/* Looping var */
+  cupsd_jobrec_t	*rec;		/* Compact record */
+  cupsd_subscription_t	*sub;		/* Current subscription */
 
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "finalize_job(job=%p(%d))", job, job->id);
+  if (job->attrs || job->state_value < IPP_JOB_CANCELED || job->printer ||
+      job->queue || job->dirty || job->journal || job->timeout_time ||
+      job->history || job->prerender != CUPSD_PRERENDER_NONE || !job->dest ||
+      !job->username || !CompactJobs)
+    return (0);
 
  /*
-  * Clear the "connecting-to-device" and "cups-waiting-for-job-completed"
-  * reasons, which are only valid when a printer is processing, along with any
-  * remote printing job state...
+  * Subscriptions point to the job...
   */
 
-  cupsdSetPrinterReasons(job->printer, "-connecting-to-device,"
-                                       "cups-waiting-for-job-completed,"
-				       "cups-remote-pending,"
-				       "cups-remote-pending-held,"
-				       "cups-remote-processing,"
-				       "cups-remote-stopped,"
-				       "cups-remote-canceled,"
-				       "cups-remote-aborted,"
-				       "cups-remote-completed");
-
- /*
-  * Similarly, clear the "offline-report" reason for non-USB devices since we
-  * rarely have current information for network devices...
-  */
+  for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
+       sub;
+       sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+    if (sub->job == job)
+      return (0);
 
-  if (strncmp(job->printer->device_uri, "usb:", 4) &&
-      strncmp(job->printer->device_uri, "ippusb:", 7))
-    cupsdSetPrinterReasons(job->printer, "-offline-report");
+  if ((rec = calloc(1, sizeof(cupsd_jobrec_t))) == NULL)
+    return (0);
 
- /*
-  * Free the security profile...
-  */
+  rec->id             = job->id;
+  rec->priority       = job->priority;
+  rec->koctets        = job->koctets;
+  rec->num_files      = job->num_files;
+  rec->state_value    = job->state_value;
+  rec->dtype          = job->dtype;
+  rec->creation_time  = job->creation_time;
+  rec->completed_time = job->completed_time;
+  rec->username       = job->username;
+  rec->dest           = job->dest;
+  rec->name           = job->name;
+  rec->filetypes      = job->filetypes;
+  rec->compressions   = job->compressions;
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Compacting...");
 
-  cupsdDestroyProfile(job->profile);
-  job->profile = NULL;
-  cupsdDestroyProfile(job->bprofile);
-  job->bprofile = NULL;
+  for (i = 0;
+       i < (int)(sizeof(job->auth_env) / sizeof(job->auth_env[0]));
+       i ++)
+    cupsdClearString(job->auth_env + i);
+  cupsdClearString(&job->auth_uid);
+  cupsdClearString(&job->render_key);
+  free(job->usage);
 
- /*
-  * Clear the unresponsive job watchdog timers...
-  */
+  cupsArrayRemove(Jobs, job);
+  cupsArrayAdd(CompactJobs, rec);
 
-  job->cancel_time = 0;
-  job->kill_time   = 0;
+  cupsdSlabFree(CUPSD_SLAB_JOB, job);
 
- /*
-  * Close pipes and status buffer...
-  */
+  return (1);
+}
 
-  cupsdClosePipe(job->print_pipes);
-  cupsdClosePipe(job->back_pipes);
-  cupsdClosePipe(job->side_pipes);
 
-  cupsdRemoveSelect(job->status_pipes[0]);
-  cupsdClosePipe(job->status_pipes);
-  cupsdStatBufDelete(job->status_buffer);
-  job->status_buffer = NULL;
+/*
+ * 'compare_active_jobs()' - Compare the job IDs and priorities of two jobs.
+ */
 
- /*
-  * Log the final impression (page) count...
-  */
+static int				/* O - Difference */
+compare_active_jobs(void *first,	/* I - First job */
+                    void *second,	/* I - Second job */
+		    void *data)		/* I - App data (not used) */
+{
+  int	diff;				/* Difference */
 
-  snprintf(buffer, sizeof(buffer), "total %d", ippGetInteger(job->impressions, 0));
-  cupsdLogPage(job, buffer);
 
- /*
-  * Process the exit status...
-  */
+  (void)data;
 
-  if (job->printer->state == IPP_PRINTER_PROCESSING)
-    printer_state = IPP_PRINTER_IDLE;
+  if ((diff = ((cupsd_job_t *)second)->priority -
+              ((cupsd_job_t *)first)->priority) != 0)
+    return (diff);
   else
-    printer_state = job->printer->state;
+    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+}
 
-  switch (job_state = job->state_value)
-  {
-    case IPP_JOB_PENDING :
-        message = "Job paused.";
-	break;
 
-    case IPP_JOB_HELD :
-        message = "Job held.";
-	break;
+/*
+ * 'compare_completed_records()' - Compare the completion times and job IDs of
+ *                                 two job records.
+ */
 
-    default :
-    case IPP_JOB_PROCESSING :
-    case IPP_JOB_COMPLETED :
-	job_state = IPP_JOB_COMPLETED;
-	message   = "Job completed.";
+static int				/* O - Difference */
+compare_completed_records(void *first,	/* I - First record */
+                          void *second,	/* I - Second record */
+		          void *data)	/* I - App data (not used) */
+{
+  int	diff;				/* Difference */
 
-        if (!job->status)
-	  ippSetString(job->attrs, &job->reasons, 0,
-		       "job-completed-successfully");
-        break;
 
-    case IPP_JOB_STOPPED :
-        message = "Job stopped.";
+  (void)data;
 
-	ippSetString(job->attrs, &job->reasons, 0, "job-stopped");
-	break;
+  if ((diff = ((cupsd_jobrec_t *)second)->completed_time -
+              ((cupsd_jobrec_t *)first)->completed_time) != 0)
+    return (diff);
+  else
+    return (((cupsd_jobrec_t *)first)->id - ((cupsd_jobrec_t *)second)->id);
+}
 
-    case IPP_JOB_CANCELED :
-        message = "Job canceled.";
 
-	ippSetString(job->attrs, &job->reasons, 0, "job-canceled-by-user");
-	break;
+/*
+ * 'compare_doc_hashes()' - Compare the hash and size of two shared documents.
+ */
 
-    case IPP_JOB_ABORTED :
-        message = "Job aborted.";
-	break;
-  }
+static int				/* O - Result of comparison */
+compare_doc_hashes(cupsd_docref_t *a,	/* I - First document */
+                   cupsd_docref_t *b,	/* I - Second document */
+		   void           *data)/* I - Unused */
+{
+  (void)data;
 
-  if (job->status < 0)
-  {
-   /*
-    * Backend had errors...
-    */
+  if (a->hash < b->hash)
+    return (-1);
+  else if (a->hash > b->hash)
+    return (1);
+  else if (a->size < b->size)
+    return (-1);
+  else
+    return (a->size > b->size);
+}
 
-    int exit_code;			/* Exit code from backend */
 
-   /*
-    * Convert the status to an exit code.  Due to the way the W* macros are
-    * implemented on macOS (bug?), we have to store the exit status in a
-    * variable first and then convert...
-    */
+/*
+ * 'compare_doc_inodes()' - Compare the inodes of two shared documents.
+ */
 
-    exit_code = -job->status;
-    if (WIFEXITED(exit_code))
-      exit_code = WEXITSTATUS(exit_code);
-    else
-    {
-      ippSetString(job->attrs, &job->reasons, 0, "cups-backend-crashed");
-      exit_code = job->status;
-    }
+static int				/* O - Result of comparison */
+compare_doc_inodes(cupsd_docref_t *a,	/* I - First document */
+                   cupsd_docref_t *b,	/* I - Second document */
+		   void           *data)/* I - Unused */
+{
+  (void)data;
 
-    cupsdLogJob(job, CUPSD_LOG_INFO, "Backend returned status %d (%s)",
-		exit_code,
-		exit_code == CUPS_BACKEND_FAILED ? "failed" :
-		    exit_code == CUPS_BACKEND_AUTH_REQUIRED ?
-			"authentication required" :
-		    exit_code == CUPS_BACKEND_HOLD ? "hold job" :
-		    exit_code == CUPS_BACKEND_STOP ? "stop printer" :
-		    exit_code == CUPS_BACKEND_CANCEL ? "cancel job" :
-		    exit_code == CUPS_BACKEND_RETRY ? "retry job later" :
-		    exit_code == CUPS_BACKEND_RETRY_CURRENT ? "retry job immediately" :
-		    exit_code < 0 ? "crashed" : "unknown");
+  if (a->dev < b->dev)
+    return (-1);
+  else if (a->dev > b->dev)
+    return (1);
+  else if (a->ino < b->ino)
+    return (-1);
+  else
+    return (a->ino > b->ino);
+}
 
-   /*
-    * Do what needs to be done...
-    */
 
-    switch (exit_code)
-    {
-      default :
-      case CUPS_BACKEND_FAILED :
-         /*
-	  * Backend failure, use the error-policy to determine how to
-	  * act...
-	  */
+/*
+ * 'compare_filter_usage()' - Compare the names of two programs.
+ */
 
-          if (job->dtype & CUPS_PRINTER_CLASS)
-	  {
-	   /*
-	    * Queued on a class - mark the job as pending and we'll retry on
-	    * another printer...
-	    */
+static int				/* O - Result of comparison */
+compare_filter_usage(
+    cupsd_filterusage_t *a,		/* I - First program */
+    cupsd_filterusage_t *b,		/* I - Second program */
+    void                *data)		/* I - Unused */
+{
+  (void)data;
 
-            if (job_state == IPP_JOB_COMPLETED)
-	    {
-	      job_state = IPP_JOB_PENDING;
-	      message   = "Retrying job on another printer.";
+  return (strcmp(a->name, b->name));
+}
 
-	      ippSetString(job->attrs, &job->reasons, 0,
-	                   "resources-are-not-ready");
-	    }
-          }
-	  else if (!strcmp(job->printer->error_policy, "retry-current-job"))
-	  {
-	   /*
-	    * The error policy is "retry-current-job" - mark the job as pending
-	    * and we'll retry on the same printer...
-	    */
 
-            if (job_state == IPP_JOB_COMPLETED)
-	    {
-	      job_state = IPP_JOB_PENDING;
-	      message   = "Retrying job on same printer.";
+/*
+ * 'compare_jobs()' - Compare the job IDs of two jobs.
+ */
 
-	      ippSetString(job->attrs, &job->reasons, 0, "none");
-	    }
-          }
-	  else if ((job->printer->type & CUPS_PRINTER_FAX) ||
-        	   !strcmp(job->printer->error_policy, "retry-job"))
-	  {
-            if (job_state == IPP_JOB_COMPLETED)
-	    {
-	     /*
-	      * The job was queued on a fax or the error policy is "retry-job" -
-	      * hold the job if the number of retries is less than the
-	      * JobRetryLimit, otherwise abort the job.
-	      */
+static int				/* O - Difference */
+compare_jobs(void *first,		/* I - First job */
+             void *second,		/* I - Second job */
+	     void *data)		/* I - App data (not used) */
+{
+  (void)data;
 
-	      job->tries ++;
+  return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+}
 
-	      if (job->tries > JobRetryLimit && JobRetryLimit > 0)
-	      {
-	       /*
-		* Too many tries...
-		*/
 
-		snprintf(buffer, sizeof(buffer),
-			 "Job aborted after %d unsuccessful attempts.",
-			 JobRetryLimit);
-		job_state = IPP_JOB_ABORTED;
-		message   = buffer;
+/*
+ * 'compare_queues()' - Compare the destinations of two pending job queues.
+ */
 
-		ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
-	      }
-	      else
-	      {
-	       /*
-		* Try again in N seconds...
-		*/
+static int				/* O - Result of comparison */
+compare_queues(void *first,		/* I - First queue */
+               void *second,		/* I - Second queue */
+	       void *data)		/* I - App data (not used) */
+{
+  (void)data;
 
-		snprintf(buffer, sizeof(buffer),
-			 "Job held for %d seconds since it could not be sent.",
-			 JobRetryInterval);
+  return (_cups_strcasecmp(((cupsd_jobq_t *)first)->dest,
+                           ((cupsd_jobq_t *)second)->dest));
+}
 
-		job->hold_until = time(NULL) + JobRetryInterval;
-		job_state       = IPP_JOB_HELD;
-		message         = buffer;
 
-		ippSetString(job->attrs, &job->reasons, 0,
-		             "resources-are-not-ready");
-	      }
-            }
-	  }
-	  else if (!strcmp(job->printer->error_policy, "abort-job") &&
-	           job_state == IPP_JOB_COMPLETED)
-	  {
-	    job_state = IPP_JOB_ABORTED;
+/*
+ * 'compare_records()' - Compare the job IDs of two job records.
+ */
 
-	    if (ErrorLog)
-	    {
-	      snprintf(buffer, sizeof(buffer), "Job aborted due to backend errors; please consult the %s file for details.", ErrorLog);
-	      message = buffer;
-            }
-            else
-	      message = "Job aborted due to backend errors.";
+static int				/* O - Difference */
+compare_records(void *first,		/* I - First record */
+                void *second,		/* I - Second record */
+	        void *data)		/* I - App data (not used) */
+{
+  (void)data;
 
-	    ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
-	  }
-	  else if (job->state_value == IPP_JOB_PROCESSING)
-          {
-            job_state     = IPP_JOB_PENDING;
-	    printer_state = IPP_PRINTER_STOPPED;
+  return (((cupsd_jobrec_t *)first)->id - ((cupsd_jobrec_t *)second)->id);
+}
 
-	    if (ErrorLog)
-	    {
-	      snprintf(buffer, sizeof(buffer), "Printer stopped due to backend errors; please consult the %s file for details.", ErrorLog);
-	      message = buffer;
-            }
-            else
-	      message = "Printer stopped due to backend errors.";
 
-	    ippSetString(job->attrs, &job->reasons, 0, "none");
-	  }
-          break;
+/*
+ * 'compare_rendered()' - Compare the keys of two cached outputs.
+ */
 
-      case CUPS_BACKEND_CANCEL :
-         /*
-	  * Cancel the job...
-	  */
+static int				/* O - Result of comparison */
+compare_rendered(cupsd_rendered_t *a,	/* I - First output */
+                 cupsd_rendered_t *b,	/* I - Second output */
+		 void             *data)/* I - Unused */
+{
+  (void)data;
 
-	  if (job_state == IPP_JOB_COMPLETED)
-	  {
-	    job_state = IPP_JOB_CANCELED;
-	    message   = "Job canceled at printer.";
+  return (strcmp(a->key, b->key));
+}
 
-	    ippSetString(job->attrs, &job->reasons, 0, "canceled-at-device");
-	  }
-          break;
 
-      case CUPS_BACKEND_HOLD :
-	  if (job_state == IPP_JOB_COMPLETED)
-	  {
-	   /*
-	    * Hold the job...
-	    */
+/*
+ * 'compare_timeout_jobs()' - Compare the deadlines and IDs of two jobs.
+ */
 
-	    const char *reason = ippGetString(job->reasons, 0, NULL);
+static int				/* O - Difference */
+compare_timeout_jobs(void *first,	/* I - First job */
+                     void *second,	/* I - Second job */
+		     void *data)	/* I - App data (not used) */
+{
+  time_t	diff;			/* Difference */
 
-	    cupsdLogJob(job, CUPSD_LOG_DEBUG, "job-state-reasons=\"%s\"",
-	                reason);
 
-	    if (!reason || strncmp(reason, "account-", 8))
-	    {
-	      cupsdSetJobHoldUntil(job, "indefinite", 1);
+  (void)data;
 
-	      ippSetString(job->attrs, &job->reasons, 0,
-			   "job-hold-until-specified");
+  if ((diff = ((cupsd_job_t *)first)->timeout_time -
+              ((cupsd_job_t *)second)->timeout_time) != 0)
+    return (diff < 0 ? -1 : 1);
+  else
+    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+}
 
-	      if (ErrorLog)
-	      {
-		snprintf(buffer, sizeof(buffer), "Job held indefinitely due to backend errors; please consult the %s file for details.", ErrorLog);
-		message = buffer;
-	      }
-	      else
-		message = "Job held indefinitely due to backend errors.";
-            }
-            else if (!strcmp(reason, "account-info-needed"))
-            {
-	      cupsdSetJobHoldUntil(job, "indefinite", 0);
 
-	      message = "Job held indefinitely - account information is required.";
-            }
-            else if (!strcmp(reason, "account-closed"))
-            {
-	      cupsdSetJobHoldUntil(job, "indefinite", 0);
+/*
+ * 'compress_documents()' - Compress preserved documents in the background.
+ *
+ * Each document is compressed to a temporary file next to it; the main thread
+ * replaces the document if the job still wants it (see finish_compression).
+ */
 
-	      message = "Job held indefinitely - account has been closed.";
-	    }
-            else if (!strcmp(reason, "account-limit-reached"))
-            {
-	      cupsdSetJobHoldUntil(job, "indefinite", 0);
+static void *				/* O - Thread exit status (unused) */
+compress_documents(void *data)		/* I - Unused */
+{
+  cupsd_compress_t	*c;		/* Current request */
+  int			infd,		/* Document file */
+			outfd;		/* Compressed document file */
+  cups_file_t		*out;		/* Compressed document file */
+  struct stat		fileinfo;	/* File information */
+  char			buffer[65536];	/* Copy buffer */
+  ssize_t		bytes = 0;	/* Bytes read */
 
-	      message = "Job held indefinitely - account limit has been reached.";
-	    }
-            else
-            {
-	      cupsdSetJobHoldUntil(job, "indefinite", 0);
 
-	      message = "Job held indefinitely - account authorization failed.";
-	    }
+  (void)data;
 
-	    job_state = IPP_JOB_HELD;
-          }
-          break;
+  _cupsMutexLock(&compress_mutex);
 
-      case CUPS_BACKEND_STOP :
-         /*
-	  * Stop the printer...
-	  */
+  for (;;)
+  {
+   /*
+    * Wait for the next document...
+    */
 
-          if (job_state == IPP_JSTATE_CANCELED || job_state == IPP_JSTATE_ABORTED)
-          {
-            cupsdLogJob(job, CUPSD_LOG_INFO, "Ignored STOP from backend since the job is %s.", job_state == IPP_JSTATE_CANCELED ? "canceled" : "aborted");
-            break;
-	  }
+    while ((c = (cupsd_compress_t *)cupsArrayFirst(compress_queue)) == NULL)
+      _cupsCondWait(&compress_cond, &compress_mutex, 0.0);
 
-	  printer_state = IPP_PRINTER_STOPPED;
+    cupsArrayRemove(compress_queue, c);
 
-	  if (ErrorLog)
-	  {
-	    snprintf(buffer, sizeof(buffer), "Printer stopped due to backend errors; please consult the %s file for details.", ErrorLog);
-	    message = buffer;
-	  }
-	  else
-	    message = "Printer stopped due to backend errors.";
+    _cupsMutexUnlock(&compress_mutex);
 
-	  if (job_state == IPP_JOB_COMPLETED)
-	  {
-	    job_state = IPP_JOB_PENDING;
+   /*
+    * Copy the document to a gzip-compressed temporary file with the same
+    * ownership and permissions...
+    */
 
-	    ippSetString(job->attrs, &job->reasons, 0, "resources-are-not-ready");
-	  }
-          break;
+    c->status = 0;
 
-      case CUPS_BACKEND_AUTH_REQUIRED :
-         /*
-	  * Hold the job for authentication...
-	  */
+    if ((infd = open(c->filename, O_RDONLY)) < 0)
+      c->status = errno;
+    else if (fstat(infd, &fileinfo))
+      c->status = errno;
+    else if ((outfd = open(c->tempfile, O_WRONLY | O_CREAT | O_TRUNC, fileinfo.st_mode & 0777)) < 0)
+      c->status = errno;
+    else if ((out = cupsFileOpenFd(outfd, "w6")) == NULL)
+    {
+      c->status = errno;
+      close(outfd);
+    }
+    else
+    {
+      if (fchown(outfd, fileinfo.st_uid, fileinfo.st_gid))
+        c->status = errno;
 
-	  if (job_state == IPP_JOB_COMPLETED)
-	  {
-	    cupsdSetJobHoldUntil(job, "auth-info-required", 1);
+      while (!c->status && (bytes = read(infd, buffer, sizeof(buffer))) > 0)
+        if (cupsFileWrite(out, buffer, (size_t)bytes) < 0)
+	  c->status = errno;
 
-	    job_state = IPP_JOB_HELD;
-	    message   = "Job held for authentication.";
+      if (!c->status && bytes < 0)
+        c->status = errno;
 
-            if (strncmp(job->reasons->values[0].string.text, "account-", 8))
-	      ippSetString(job->attrs, &job->reasons, 0,
-			   "cups-held-for-authentication");
-          }
-          break;
+      if (!c->status && SyncOnClose && !cupsFileFlush(out))
+        fsync(outfd);
 
-      case CUPS_BACKEND_RETRY :
-	  if (job_state == IPP_JOB_COMPLETED)
-	  {
-	   /*
-	    * Hold the job if the number of retries is less than the
-	    * JobRetryLimit, otherwise abort the job.
-	    */
+      if (cupsFileClose(out) && !c->status)
+        c->status = errno;
 
-	    job->tries ++;
+     /*
+      * Only keep the compressed copy if it is smaller...
+      */
 
-	    if (job->tries > JobRetryLimit && JobRetryLimit > 0)
-	    {
-	     /*
-	      * Too many tries...
-	      */
+      c->size = fileinfo.st_size;
 
-	      snprintf(buffer, sizeof(buffer),
-		       "Job aborted after %d unsuccessful attempts.",
-		       JobRetryLimit);
-	      job_state = IPP_JOB_ABORTED;
-	      message   = buffer;
+      if (!c->status && !stat(c->tempfile, &fileinfo))
+      {
+        c->compsize = fileinfo.st_size;
 
-	      ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
-	    }
-	    else
-	    {
-	     /*
-	      * Try again in N seconds...
-	      */
+        if (c->compsize >= c->size)
+	  c->status = -1;
+      }
 
-	      snprintf(buffer, sizeof(buffer),
-		       "Job held for %d seconds since it could not be sent.",
-		       JobRetryInterval);
+      if (c->status)
+        unlink(c->tempfile);
+    }
 
-	      job->hold_until = time(NULL) + JobRetryInterval;
-	      job_state       = IPP_JOB_HELD;
-	      message         = buffer;
+    if (infd >= 0)
+      close(infd);
 
-	      ippSetString(job->attrs, &job->reasons, 0,
-	                   "resources-are-not-ready");
-	    }
-	  }
-          break;
+   /*
+    * Hand the result to the main thread...
+    */
 
-      case CUPS_BACKEND_RETRY_CURRENT :
-	 /*
-	  * Mark the job as pending and retry on the same printer...
-	  */
+    _cupsMutexLock(&compress_mutex);
 
-	  if (job_state == IPP_JOB_COMPLETED)
-	  {
-	    job_state = IPP_JOB_PENDING;
-	    message   = "Retrying job on same printer.";
+    cupsArrayAdd(compress_done, c);
 
-	    ippSetString(job->attrs, &job->reasons, 0, "none");
-	  }
-          break;
-    }
+    if (write(compress_pipe[1], "", 1) < 0)
+      c->status = errno;
   }
-  else if (job->status > 0)
-  {
-   /*
-    * Filter had errors; stop job...
-    */
 
-    if (job_state == IPP_JOB_COMPLETED)
-    {
-      job_state = IPP_JOB_STOPPED;
+  return (NULL);
+}
 
-      if (ErrorLog)
-      {
-	snprintf(buffer, sizeof(buffer), "Job stopped due to filter errors; please consult the %s file for details.", ErrorLog);
-	message = buffer;
-      }
-      else
-	message = "Job stopped due to filter errors.";
 
-      if (WIFSIGNALED(job->status))
-	ippSetString(job->attrs, &job->reasons, 0, "cups-filter-crashed");
-      else
-	ippSetString(job->attrs, &job->reasons, 0, "job-completed-with-errors");
-    }
-  }
+/*
+ * 'dump_job_history()' - Dump any debug messages for a job.
+ */
+
+static void
+dump_job_history(cupsd_job_t *job)	/* I - Job */
+{
+  int			i,		/* Looping var */
+			oldsize;	/* Current MaxLogSize */
+  struct tm		date;		/* Date/time value */
+  cupsd_jobhistory_t	*history;	/* Job history */
+  cupsd_joblog_t	*message,	/* Current message */
+			*first = NULL,	/* First message */
+			*last = NULL;	/* Last message */
+  char			temp[2048],	/* Log message */
+			*ptr,		/* Pointer into log message */
+			start[256],	/* Start time */
+			end[256];	/* End time */
+  cupsd_printer_t	*printer;	/* Printer for job */
+
 
  /*
-  * Update the printer and job state.
+  * See if we have anything to dump...
   */
 
-  if (set_job_state && job_state != job->state_value)
+  if ((history = job->history) == NULL)
+    return;
+
+  for (i = 0; i < history->count; i ++)
+  {
+    if ((message = history->messages[(history->first + i) % history->size]) != NULL)
+    {
+      if (!first)
+        first = message;
+
+      last = message;
+    }
+  }
+
+  if (!first)
+  {
+    free_job_history(job);
+    return;
+  }
+
+ /*
+  * Disable log rotation temporarily...
+  */
+
+  oldsize    = MaxLogSize;
+  MaxLogSize = 0;
+
+ /*
+  * Copy the debug messages to the log...
+  */
+
+  localtime_r(&(first->time), &date);
+  strftime(start, sizeof(start), "%X", &date);
+
+  localtime_r(&(last->time), &date);
+  strftime(end, sizeof(end), "%X", &date);
+
+  snprintf(temp, sizeof(temp),
+           "[Job %d] The following messages were recorded from %s to %s",
+           job->id, start, end);
+  cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+
+  for (i = 0; i < history->count; i ++)
+    if ((message = history->messages[(history->first + i) % history->size]) != NULL)
+      cupsdWriteErrorLog(CUPSD_LOG_DEBUG, message->message);
+
+  snprintf(temp, sizeof(temp), "[Job %d] End of messages", job->id);
+  cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+
+ /*
+  * Log the printer state values...
+  */
+
+  if ((printer = job->printer) == NULL)
+    printer = cupsdFindDest(job->dest);
+
+  if (printer)
+  {
+    snprintf(temp, sizeof(temp), "[Job %d] printer-state=%d(%s)", job->id,
+             printer->state,
+	     printer->state == IPP_PRINTER_IDLE ? "idle" :
+	         printer->state == IPP_PRINTER_PROCESSING ? "processing" :
+		 "stopped");
+    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+
+    snprintf(temp, sizeof(temp), "[Job %d] printer-state-message=\"%s\"",
+             job->id, printer->state_message);
+    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+
+    snprintf(temp, sizeof(temp), "[Job %d] printer-state-reasons=", job->id);
+    ptr = temp + strlen(temp);
+    if (printer->num_reasons == 0)
+      strlcpy(ptr, "none", sizeof(temp) - (size_t)(ptr - temp));
+    else
+    {
+      for (i = 0;
+           i < printer->num_reasons && ptr < (temp + sizeof(temp) - 2);
+           i ++)
+      {
+        if (i)
+	  *ptr++ = ',';
+
+	strlcpy(ptr, printer->reasons[i], sizeof(temp) - (size_t)(ptr - temp));
+	ptr += strlen(ptr);
+      }
+    }
+    cupsdWriteErrorLog(CUPSD_LOG_DEBUG, temp);
+  }
+
+ /*
+  * Restore log file rotation...
+  */
+
+  MaxLogSize = oldsize;
+
+ /*
+  * Free all messages...
+  */
+
+  free_job_history(job);
+}
+
+
+/*
+ * 'free_job_history()' - Free any log history.
+ */
+
+static void
+free_job_history(cupsd_job_t *job)	/* I - Job */
+{
+  int	i;				/* Looping var */
+
+
+  if (!job->history)
+    return;
+
+  for (i = 0; i < job->history->size; i ++)
+    free(job->history->messages[i]);
+
+  free(job->history);
+  job->history = NULL;
+}
+
+
+/*
+ * 'finalize_job()' - Cleanup after job filter processes and support data.
+ */
+
+static void
+finalize_job(cupsd_job_t *job,		/* I - Job */
+             int         set_job_state)	/* I - 1 = set the job state */
+{
+  ipp_pstate_t		printer_state;	/* New printer state value */
+  ipp_jstate_t		job_state;	/* New job state value */
+  const char		*message;	/* Message for job state */
+  char			buffer[1024];	/* Buffer for formatted messages */
+
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "finalize_job(job=%p(%d))", job, job->id);
+
+  CUPSD_PROBE2(job__finalize, job->id, job->status);
+
+ /*
+  * Clear the "connecting-to-device" and "cups-waiting-for-job-completed"
+  * reasons, which are only valid when a printer is processing, along with any
+  * remote printing job state...
+  */
+
+  cupsdSetPrinterReasons(job->printer, "-connecting-to-device,"
+                                       "cups-waiting-for-job-completed,"
+				       "cups-remote-pending,"
+				       "cups-remote-pending-held,"
+				       "cups-remote-processing,"
+				       "cups-remote-stopped,"
+				       "cups-remote-canceled,"
+				       "cups-remote-aborted,"
+				       "cups-remote-completed");
+
+ /*
+  * Similarly, clear the "offline-report" reason for non-USB devices since we
+  * rarely have current information for network devices...
+  */
+
+  if (strncmp(job->printer->device_uri, "usb:", 4) &&
+      strncmp(job->printer->device_uri, "ippusb:", 7))
+    cupsdSetPrinterReasons(job->printer, "-offline-report");
+
+ /*
+  * Free the security profile...
+  */
+
+  cupsdDestroyProfile(job->profile);
+  job->profile = NULL;
+  cupsdDestroyProfile(job->bprofile);
+  job->bprofile = NULL;
+
+ /*
+  * Log and save the resource usage of the filters and backend...
+  */
+
+  finish_job_usage(job);
+
+ /*
+  * Clear the unresponsive job watchdog timers...
+  */
+
+  job->cancel_time = 0;
+  job->kill_time   = 0;
+
+  cupsdUpdateJobQueues(job);
+
+ /*
+  * Close pipes and status buffer...
+  */
+
+  cupsdClosePipe(job->print_pipes);
+  cupsdClosePipe(job->back_pipes);
+  cupsdClosePipe(job->side_pipes);
+
+  cupsdRemoveSelect(job->status_pipes[0]);
+  cupsdClosePipe(job->status_pipes);
+  cupsdStatBufDelete(job->status_buffer);
+  job->status_buffer = NULL;
+
+ /*
+  * Log the final impression (page) count...
+  */
+
+  snprintf(buffer, sizeof(buffer), "total %d", ippGetInteger(job->impressions, 0));
+  cupsdLogPage(job, buffer);
+
+ /*
+  * Process the exit status...
+  */
+
+  if (job->printer->state == IPP_PRINTER_PROCESSING)
+    printer_state = IPP_PRINTER_IDLE;
+  else
+    printer_state = job->printer->state;
+
+  switch (job_state = job->state_value)
+  {
+    case IPP_JOB_PENDING :
+        message = "Job paused.";
+	break;
+
+    case IPP_JOB_HELD :
+        message = "Job held.";
+	break;
+
+    default :
+    case IPP_JOB_PROCESSING :
+    case IPP_JOB_COMPLETED :
+	job_state = IPP_JOB_COMPLETED;
+	message   = "Job completed.";
+
+        if (!job->status)
+	  ippSetString(job->attrs, &job->reasons, 0,
+		       "job-completed-successfully");
+        break;
+
+    case IPP_JOB_STOPPED :
+        message = "Job stopped.";
+
+	ippSetString(job->attrs, &job->reasons, 0, "job-stopped");
+	break;
+
+    case IPP_JOB_CANCELED :
+        message = "Job canceled.";
+
+	ippSetString(job->attrs, &job->reasons, 0, "job-canceled-by-user");
+	break;
+
+    case IPP_JOB_ABORTED :
+        message = "Job aborted.";
+	break;
+  }
+
+  if (job->status < 0)
+  {
+   /*
+    * Backend had errors...
+    */
+
+    int exit_code;			/* Exit code from backend */
+
+   /*
+    * Convert the status to an exit code.  Due to the way the W* macros are
+    * implemented on macOS (bug?), we have to store the exit status in a
+    * variable first and then convert...
+    */
+
+    exit_code = -job->status;
+    if (WIFEXITED(exit_code))
+      exit_code = WEXITSTATUS(exit_code);
+    else
+    {
+      ippSetString(job->attrs, &job->reasons, 0, "cups-backend-crashed");
+      exit_code = job->status;
+    }
+
+    cupsdLogJob(job, CUPSD_LOG_INFO, "Backend returned status %d (%s)",
+		exit_code,
+		exit_code == CUPS_BACKEND_FAILED ? "failed" :
+		    exit_code == CUPS_BACKEND_AUTH_REQUIRED ?
+			"authentication required" :
+		    exit_code == CUPS_BACKEND_HOLD ? "hold job" :
+		    exit_code == CUPS_BACKEND_STOP ? "stop printer" :
+		    exit_code == CUPS_BACKEND_CANCEL ? "cancel job" :
+		    exit_code == CUPS_BACKEND_RETRY ? "retry job later" :
+		    exit_code == CUPS_BACKEND_RETRY_CURRENT ? "retry job immediately" :
+		    exit_code < 0 ? "crashed" : "unknown");
+
+   /*
+    * Do what needs to be done...
+    */
+
+    switch (exit_code)
+    {
+      default :
+      case CUPS_BACKEND_FAILED :
+         /*
+	  * Backend failure, use the error-policy to determine how to
+	  * act...
+	  */
+
+          if (job->dtype & CUPS_PRINTER_CLASS)
+	  {
+	   /*
+	    * Queued on a class - mark the job as pending and we'll retry on
+	    * another printer...
+	    */
+
+            if (job_state == IPP_JOB_COMPLETED)
+	    {
+	      job_state = IPP_JOB_PENDING;
+	      message   = "Retrying job on another printer.";
+
+	      ippSetString(job->attrs, &job->reasons, 0,
+	                   "resources-are-not-ready");
+	    }
+          }
+	  else if (!strcmp(job->printer->error_policy, "retry-current-job"))
+	  {
+	   /*
+	    * The error policy is "retry-current-job" - mark the job as pending
+	    * and we'll retry on the same printer...
+	    */
+
+            if (job_state == IPP_JOB_COMPLETED)
+	    {
+	      job_state = IPP_JOB_PENDING;
+	      message   = "Retrying job on same printer.";
+
+	      ippSetString(job->attrs, &job->reasons, 0, "none");
+	    }
+          }
+	  else if ((job->printer->type & CUPS_PRINTER_FAX) ||
+        	   !strcmp(job->printer->error_policy, "retry-job"))
+	  {
+            if (job_state == IPP_JOB_COMPLETED)
+	    {
+	     /*
+	      * The job was queued on a fax or the error policy is "retry-job" -
+	      * hold the job if the number of retries is less than the
+	      * JobRetryLimit, otherwise abort the job.
+	      */
+
+	      job->tries ++;
+
+	      if (job->tries > JobRetryLimit && JobRetryLimit > 0)
+	      {
+	       /*
+		* Too many tries...
+		*/
+
+		snprintf(buffer, sizeof(buffer),
+			 "Job aborted after %d unsuccessful attempts.",
+			 JobRetryLimit);
+		job_state = IPP_JOB_ABORTED;
+		message   = buffer;
+
+		ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
+	      }
+	      else
+	      {
+	       /*
+		* Try again in N seconds...
+		*/
+
+		snprintf(buffer, sizeof(buffer),
+			 "Job held for %d seconds since it could not be sent.",
+			 JobRetryInterval);
+
+		job->hold_until = time(NULL) + JobRetryInterval;
+		job_state       = IPP_JOB_HELD;
+		message         = buffer;
+
+		ippSetString(job->attrs, &job->reasons, 0,
+		             "resources-are-not-ready");
+	      }
+            }
+	  }
+	  else if (!strcmp(job->printer->error_policy, "abort-job") &&
+	           job_state == IPP_JOB_COMPLETED)
+	  {
+	    job_state = IPP_JOB_ABORTED;
+
+	    if (ErrorLog)
+	    {
+	      snprintf(buffer, sizeof(buffer), "Job aborted due to backend errors; please consult the %s file for details.", ErrorLog);
+	      message = buffer;
+            }
+            else
+	      message = "Job aborted due to backend errors.";
+
+	    ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
+	  }
+	  else if (job->state_value == IPP_JOB_PROCESSING)
+          {
+            job_state     = IPP_JOB_PENDING;
+	    printer_state = IPP_PRINTER_STOPPED;
+
+	    if (ErrorLog)
+	    {
+	      snprintf(buffer, sizeof(buffer), "Printer stopped due to backend errors; please consult the %s file for details.", ErrorLog);
+	      message = buffer;
+            }
+            else
+	      message = "Printer stopped due to backend errors.";
+
+	    ippSetString(job->attrs, &job->reasons, 0, "none");
+	  }
+          break;
+
+      case CUPS_BACKEND_CANCEL :
+         /*
+	  * Cancel the job...
+	  */
+
+	  if (job_state == IPP_JOB_COMPLETED)
+	  {
+	    job_state = IPP_JOB_CANCELED;
+	    message   = "Job canceled at printer.";
+
+	    ippSetString(job->attrs, &job->reasons, 0, "canceled-at-device");
+	  }
+          break;
+
+      case CUPS_BACKEND_HOLD :
+	  if (job_state == IPP_JOB_COMPLETED)
+	  {
+	   /*
+	    * Hold the job...
+	    */
+
+	    const char *reason = ippGetString(job->reasons, 0, NULL);
+
+	    cupsdLogJob(job, CUPSD_LOG_DEBUG, "job-state-reasons=\"%s\"",
+	                reason);
+
+	    if (!reason || strncmp(reason, "account-", 8))
+	    {
+	      cupsdSetJobHoldUntil(job, "indefinite", 1);
+
+	      ippSetString(job->attrs, &job->reasons, 0,
+			   "job-hold-until-specified");
+
+	      if (ErrorLog)
+	      {
+		snprintf(buffer, sizeof(buffer), "Job held indefinitely due to backend errors; please consult the %s file for details.", ErrorLog);
+		message = buffer;
+	      }
+	      else
+		message = "Job held indefinitely due to backend errors.";
+            }
+            else if (!strcmp(reason, "account-info-needed"))
+            {
+	      cupsdSetJobHoldUntil(job, "indefinite", 0);
+
+	      message = "Job held indefinitely - account information is required.";
+            }
+            else if (!strcmp(reason, "account-closed"))
+            {
+	      cupsdSetJobHoldUntil(job, "indefinite", 0);
+
+	      message = "Job held indefinitely - account has been closed.";
+	    }
+            else if (!strcmp(reason, "account-limit-reached"))
+            {
+	      cupsdSetJobHoldUntil(job, "indefinite", 0);
+
+	      message = "Job held indefinitely - account limit has been reached.";
+	    }
+            else
+            {
+	      cupsdSetJobHoldUntil(job, "indefinite", 0);
+
+	      message = "Job held indefinitely - account authorization failed.";
+	    }
+
+	    job_state = IPP_JOB_HELD;
+          }
+          break;
+
+      case CUPS_BACKEND_STOP :
+         /*
+	  * Stop the printer...
+	  */
+
+          if (job_state == IPP_JSTATE_CANCELED || job_state == IPP_JSTATE_ABORTED)
+          {
+            cupsdLogJob(job, CUPSD_LOG_INFO, "Ignored STOP from backend since the job is %s.", job_state == IPP_JSTATE_CANCELED ? "canceled" : "aborted");
+            break;
+	  }
+
+	  printer_state = IPP_PRINTER_STOPPED;
+
+	  if (ErrorLog)
+	  {
+	    snprintf(buffer, sizeof(buffer), "Printer stopped due to backend errors; please consult the %s file for details.", ErrorLog);
+	    message = buffer;
+	  }
+	  else
+	    message = "Printer stopped due to backend errors.";
+
+	  if (job_state == IPP_JOB_COMPLETED)
+	  {
+	    job_state = IPP_JOB_PENDING;
+
+	    ippSetString(job->attrs, &job->reasons, 0, "resources-are-not-ready");
+	  }
+          break;
+
+      case CUPS_BACKEND_AUTH_REQUIRED :
+         /*
+	  * Hold the job for authentication...
+	  */
+
+	  if (job_state == IPP_JOB_COMPLETED)
+	  {
+	    cupsdSetJobHoldUntil(job, "auth-info-required", 1);
+
+	    job_state = IPP_JOB_HELD;
+	    message   = "Job held for authentication.";
+
+            if (strncmp(job->reasons->values[0].string.text, "account-", 8))
+	      ippSetString(job->attrs, &job->reasons, 0,
+			   "cups-held-for-authentication");
+          }
+          break;
+
+      case CUPS_BACKEND_RETRY :
+	  if (job_state == IPP_JOB_COMPLETED)
+	  {
+	   /*
+	    * Hold the job if the number of retries is less than the
+	    * JobRetryLimit, otherwise abort the job.
+	    */
+
+	    job->tries ++;
+
+	    if (job->tries > JobRetryLimit && JobRetryLimit > 0)
+	    {
+	     /*
+	      * Too many tries...
+	      */
+
+	      snprintf(buffer, sizeof(buffer),
+		       "Job aborted after %d unsuccessful attempts.",
+		       JobRetryLimit);
+	      job_state = IPP_JOB_ABORTED;
+	      message   = buffer;
+
+	      ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
+	    }
+	    else
+	    {
+	     /*
+	      * Try again in N seconds...
+	      */
+
+	      snprintf(buffer, sizeof(buffer),
+		       "Job held for %d seconds since it could not be sent.",
+		       JobRetryInterval);
+
+	      job->hold_until = time(NULL) + JobRetryInterval;
+	      job_state       = IPP_JOB_HELD;
+	      message         = buffer;
+
+	      ippSetString(job->attrs, &job->reasons, 0,
+	                   "resources-are-not-ready");
+	    }
+	  }
+          break;
+
+      case CUPS_BACKEND_RETRY_CURRENT :
+	 /*
+	  * Mark the job as pending and retry on the same printer...
+	  */
+
+	  if (job_state == IPP_JOB_COMPLETED)
+	  {
+	    job_state = IPP_JOB_PENDING;
+	    message   = "Retrying job on same printer.";
+
+	    ippSetString(job->attrs, &job->reasons, 0, "none");
+	  }
+          break;
+    }
+  }
+  else if (job->status > 0)
+  {
+   /*
+    * Filter had errors; stop job...
+    */
+
+    if (job_state == IPP_JOB_COMPLETED)
+    {
+      job_state = IPP_JOB_STOPPED;
+
+      if (ErrorLog)
+      {
+	snprintf(buffer, sizeof(buffer), "Job stopped due to filter errors; please consult the %s file for details.", ErrorLog);
+	message = buffer;
+      }
+      else
+	message = "Job stopped due to filter errors.";
+
+      if (WIFSIGNALED(job->status))
+	ippSetString(job->attrs, &job->reasons, 0, "cups-filter-crashed");
+      else
+	ippSetString(job->attrs, &job->reasons, 0, "job-completed-with-errors");
+    }
+  }
+
+ /*
+  * Measure how fast the printer prints for class scheduling...
+  */
+
+  if (job_state == IPP_JOB_COMPLETED && !job->status)
+    cupsdUpdatePrinterThroughput(job->printer, job);
+
+ /*
+  * Update the printer and job state.
+  */
+
+  if (set_job_state && job_state != job->state_value)
     cupsdSetJobState(job, job_state, CUPSD_JOB_DEFAULT, "%s", message);
 
-  cupsdSetPrinterState(job->printer, printer_state,
-                       printer_state == IPP_PRINTER_STOPPED);
-  update_job_attrs(job, 0);
+  cupsdSetPrinterState(job->printer, printer_state,
+                       printer_state == IPP_PRINTER_STOPPED);
+  update_job_attrs(job, 0);
+
+  if (job->history)
+  {
+    if (job->status &&
+        (job->state_value == IPP_JOB_ABORTED ||
+         job->state_value == IPP_JOB_STOPPED))
+      dump_job_history(job);
+    else
+      free_job_history(job);
+  }
+
+  cupsArrayRemove(PrintingJobs, job);
+
+ /*
+  * Clear informational messages...
+  */
+
+  if (job->status_level > CUPSD_LOG_ERROR)
+    job->printer->state_message[0] = '\0';
+
+ /*
+  * Apply any PPD updates...
+  */
+
+  if (job->num_keywords)
+  {
+    if (cupsdUpdatePrinterPPD(job->printer, job->num_keywords, job->keywords))
+      cupsdSetPrinterAttrs(job->printer);
+
+    cupsFreeOptions(job->num_keywords, job->keywords);
+
+    job->num_keywords = 0;
+    job->keywords     = NULL;
+  }
+
+ /*
+  * Clear the printer <-> job association...
+  */
+
+  job->printer->job = NULL;
+  job->printer      = NULL;
+
+  cupsdUpdateJobQueues(job);
+}
+
+
+/*
+ * 'find_render_cache()' - Use cached rendered output for a job.
+ */
+
+static int				/* O - 1 if found, 0 otherwise */
+find_render_cache(
+    cupsd_job_t     *job,		/* I - Job */
+    cupsd_printer_t *printer)		/* I - Printer */
+{
+  cupsd_rendered_t	key,		/* Search key */
+			*entry;		/* Cache entry */
+  char			filename[1024],	/* Pre-rendered output filename */
+			cachefile[1024];/* Cached output filename */
+
+
+ /*
+  * The key is remembered so the output can be added to the cache once the
+  * job has been rendered...
+  */
+
+  if (!get_render_key(job, printer, key.key, sizeof(key.key)))
+    return (0);
+
+  cupsdSetString(&job->render_key, key.key);
+
+  if ((entry = (cupsd_rendered_t *)cupsArrayFind(render_cache, &key)) == NULL)
+    return (0);
+
+  snprintf(cachefile, sizeof(cachefile), "%s/render/%s", RequestRoot, entry->key);
+  get_render_filename(job, "", filename, sizeof(filename));
+  unlink(filename);
+
+  if (link(cachefile, filename))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to use cached rendered output: %s", strerror(errno));
+    return (0);
+  }
+
+  strlcat(cachefile, ".log", sizeof(cachefile));
+  get_render_filename(job, ".log", filename, sizeof(filename));
+  unlink(filename);
+
+  if (link(cachefile, filename))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to use cached rendered output: %s", strerror(errno));
+    unlink(get_render_filename(job, "", filename, sizeof(filename)));
+    return (0);
+  }
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG, "Using cached rendered output %s.", entry->key);
+
+  entry->used = time(NULL);
+
+  job->prerender      = CUPSD_PRERENDER_DONE;
+  job->prerender_size = entry->size;
+  prerender_total     += entry->size;
+
+  return (1);
+}
+
+
+/*
+ * 'finish_compression()' - Replace documents that have been compressed.
+ */
+
+static void
+finish_compression(void *data)		/* I - Unused */
+{
+  char			buffer[256];	/* Notification buffer */
+  cups_array_t		*done;		/* Finished requests */
+  cupsd_compress_t	*c;		/* Current request */
+  cupsd_job_t		*job;		/* Job */
+  struct stat		fileinfo;	/* Document information */
+
+
+  (void)data;
+
+  if (read(compress_pipe[0], buffer, sizeof(buffer)) < 0)
+    return;
+
+  _cupsMutexLock(&compress_mutex);
+
+  done          = compress_done;
+  compress_done = cupsArrayNew(NULL, NULL);
+
+  _cupsMutexUnlock(&compress_mutex);
+
+  for (c = (cupsd_compress_t *)cupsArrayFirst(done);
+       c;
+       c = (cupsd_compress_t *)cupsArrayNext(done))
+  {
+    job = cupsdFindJob(c->id);
+
+    if (c->status)
+    {
+      if (c->status > 0)
+        cupsdLogMessage(CUPSD_LOG_ERROR, "[Job %d] Unable to compress document %d: %s", c->id, c->number, strerror(c->status));
+    }
+    else if (!job || job->state_value < IPP_JOB_CANCELED ||
+             c->number > job->num_files || job->compressions[c->number - 1])
+    {
+     /*
+      * The job was restarted or its files removed while we were busy...
+      */
+
+      unlink(c->tempfile);
+    }
+    else if (stat(c->filename, &fileinfo) || rename(c->tempfile, c->filename))
+    {
+      cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to replace document %d with compressed copy: %s", c->number, strerror(errno));
+      unlink(c->tempfile);
+    }
+    else
+    {
+      if (fileinfo.st_nlink > 1)
+        release_document(&fileinfo);
+
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Compressed document %d from " CUPS_LLFMT " to " CUPS_LLFMT " bytes.", c->number, CUPS_LLCAST c->size, CUPS_LLCAST c->compsize);
+
+      job->compressions[c->number - 1] = 1;
+      job->journal                     = 1;
+
+      cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+    }
+
+    free(c);
+  }
+
+  cupsArrayDelete(done);
+}
+
+
+/*
+ * 'finish_job_loads()' - Stop the control file loading threads.
+ */
+
+static void
+finish_job_loads(void)
+{
+  int	i;				/* Looping var */
+
+
+  if (!job_loads)
+    return;
+
+ /*
+  * Tell the threads to stop and wait for them...
+  */
+
+  _cupsMutexLock(&job_loads_mutex);
+  job_loads_next = job_loads_count;
+  _cupsCondBroadcast(&job_loads_cond);
+  _cupsMutexUnlock(&job_loads_mutex);
+
+  for (i = 0; i < job_loads_num_threads; i ++)
+    _cupsThreadWait(job_loads_threads[i]);
+
+ /*
+  * Free any control files that were not used...
+  */
+
+  for (i = job_loads_used; i < job_loads_count; i ++)
+    ippDelete(job_loads[i].attrs);
+
+  free(job_loads);
+
+  job_loads             = NULL;
+  job_loads_count       = 0;
+  job_loads_next        = 0;
+  job_loads_used        = 0;
+  job_loads_num_threads = 0;
+}
+
+
+/*
+ * 'finish_job_usage()' - Log and save the resource usage of a job's processes.
+ */
+
+static void
+finish_job_usage(cupsd_job_t *job)	/* I - Job */
+{
+  int			i;		/* Looping var */
+  cupsd_jobusage_t	*usage;		/* Current usage record */
+  ipp_attribute_t	*attr;		/* job-processing-time-breakdown */
+  ipp_t			*col;		/* Usage collection */
+
+
+  if (!job->num_usage)
+    return;
+
+  if (job->attrs)
+  {
+    if ((attr = ippFindAttribute(job->attrs, "job-processing-time-breakdown", IPP_TAG_BEGIN_COLLECTION)) != NULL)
+      ippDeleteAttribute(job->attrs, attr);
+
+    attr = ippAddCollections(job->attrs, IPP_TAG_JOB, "job-processing-time-breakdown", job->num_usage, NULL);
+  }
+  else
+    attr = NULL;
+
+  for (i = 0, usage = job->usage; i < job->num_usage; i ++, usage ++)
+  {
+    cupsdLogJob(job, CUPSD_LOG_INFO, "Usage of %s (PID %d): %.3fs elapsed, %.3fs user, %.3fs system, %ldk max RSS.", usage->name, usage->pid, usage->wall, usage->user, usage->sys, usage->maxrss);
+
+    if (!attr)
+      continue;
+
+    col = ippNew();
+    ippAddString(col, IPP_TAG_ZERO, IPP_TAG_NAME, "program-name", NULL, usage->name);
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "elapsed-time", (int)(usage->wall * 1000.0));
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "user-time", (int)(usage->user * 1000.0));
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "system-time", (int)(usage->sys * 1000.0));
+    ippAddInteger(col, IPP_TAG_ZERO, IPP_TAG_INTEGER, "max-rss", (int)usage->maxrss);
+    ippSetCollection(job->attrs, &attr, i, col);
+    ippDelete(col);
+  }
+
+  free(job->usage);
+  job->usage     = NULL;
+  job->num_usage = 0;
+
+  job->dirty = 1;
+  cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+}
+
+
+/*
+ * 'get_job_load()' - Get the attributes read by a control file loading thread.
+ *
+ * Jobs must be requested in the order passed to start_job_loads().  NULL is
+ * returned if the job is not being loaded or its control file could not be
+ * read, in which case the caller reads it again and reports any errors.
+ */
+
+static ipp_t *				/* O - Job attributes or NULL */
+get_job_load(cupsd_job_t *job)		/* I - Job */
+{
+  ipp_t	*attrs = NULL;			/* Job attributes */
+
+
+  if (!job_loads)
+    return (NULL);
+
+  _cupsMutexLock(&job_loads_mutex);
+
+  if (job_loads_used < job_loads_count && job_loads[job_loads_used].job == job)
+  {
+    while (!job_loads[job_loads_used].done)
+      _cupsCondWait(&job_loads_cond, &job_loads_mutex, 0.0);
+
+    attrs = job_loads[job_loads_used].attrs;
+    job_loads[job_loads_used].attrs = NULL;
+
+    job_loads_used ++;
+
+    _cupsCondBroadcast(&job_loads_cond);
+  }
+
+  _cupsMutexUnlock(&job_loads_mutex);
+
+  return (attrs);
+}
+
+
+/*
+ * 'get_options()' - Get a string containing the job options.
+ */
+
+static char *				/* O - Options string */
+get_options(cupsd_job_t *job,		/* I - Job */
+            int         banner_page,	/* I - Printing a banner page? */
+	    char        *copies,	/* I - Copies buffer */
+	    size_t      copies_size,	/* I - Size of copies buffer */
+	    char        *title,		/* I - Title buffer */
+	    size_t      title_size)	/* I - Size of title buffer */
+{
+  int			i;		/* Looping var */
+  size_t		newlength;	/* New option buffer length */
+  char			*optptr,	/* Pointer to options */
+			*valptr;	/* Pointer in value string */
+  ipp_attribute_t	*attr;		/* Current attribute */
+  _ppd_cache_t		*pc;		/* PPD cache and mapping data */
+  int			num_pwgppds;	/* Number of PWG->PPD options */
+  cups_option_t		*pwgppds,	/* PWG->PPD options */
+			*pwgppd,	/* Current PWG->PPD option */
+			*preset;	/* Current preset option */
+  int			print_color_mode,
+					/* Output mode (if any) */
+			print_quality;	/* Print quality (if any) */
+  const char		*ppd;		/* PPD option choice */
+  int			exact;		/* Did we get an exact match? */
+  static char		*options = NULL;/* Full list of options */
+  static size_t		optlength = 0;	/* Length of option buffer */
+
+
+ /*
+  * Building the options string is harder than it needs to be, but for the
+  * moment we need to pass strings for command-line args and not IPP attribute
+  * pointers... :)
+  *
+  * First build an options array for any PWG->PPD mapped option/choice pairs.
+  */
+
+  pc          = job->printer->pc;
+  num_pwgppds = 0;
+  pwgppds     = NULL;
+
+  if (pc &&
+      !ippFindAttribute(job->attrs, "com.apple.print.DocumentTicket.PMSpoolFormat", IPP_TAG_ZERO) &&
+      !ippFindAttribute(job->attrs, "APPrinterPreset", IPP_TAG_ZERO) &&
+      (ippFindAttribute(job->attrs, "print-color-mode", IPP_TAG_ZERO) || ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ZERO) || ippFindAttribute(job->attrs, "cupsPrintQuality", IPP_TAG_ZERO)))
+  {
+   /*
+    * Map print-color-mode and print-quality to a preset...
+    */
+
+    if ((attr = ippFindAttribute(job->attrs, "print-color-mode",
+				 IPP_TAG_KEYWORD)) != NULL &&
+        !strcmp(attr->values[0].string.text, "monochrome"))
+      print_color_mode = _PWG_PRINT_COLOR_MODE_MONOCHROME;
+    else
+      print_color_mode = _PWG_PRINT_COLOR_MODE_COLOR;
+
+    if ((attr = ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ENUM)) != NULL)
+    {
+      ipp_quality_t pq = (ipp_quality_t)ippGetInteger(attr, 0);
+
+      if (pq >= IPP_QUALITY_DRAFT && pq <= IPP_QUALITY_HIGH)
+        print_quality = attr->values[0].integer - IPP_QUALITY_DRAFT;
+      else
+        print_quality = _PWG_PRINT_QUALITY_NORMAL;
+    }
+    else if ((attr = ippFindAttribute(job->attrs, "cupsPrintQuality", IPP_TAG_NAME)) != NULL)
+    {
+      const char *pq = ippGetString(attr, 0, NULL);
+
+      if (!_cups_strcasecmp(pq, "draft"))
+        print_quality = _PWG_PRINT_QUALITY_DRAFT;
+      else if (!_cups_strcasecmp(pq, "high"))
+        print_quality = _PWG_PRINT_QUALITY_HIGH;
+      else
+        print_quality = _PWG_PRINT_QUALITY_NORMAL;
+
+      if (!ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ENUM))
+      {
+        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping cupsPrintQuality=%s to print-quality=%d", pq, print_quality + IPP_QUALITY_DRAFT);
+        num_pwgppds = cupsAddIntegerOption("print-quality", print_quality + IPP_QUALITY_DRAFT, num_pwgppds, &pwgppds);
+      }
+    }
+    else
+    {
+      print_quality = _PWG_PRINT_QUALITY_NORMAL;
+    }
+
+    if (pc->num_presets[print_color_mode][print_quality] == 0)
+    {
+     /*
+      * Try to find a preset that works so that we maximize the chances of us
+      * getting a good print using IPP attributes.
+      */
+
+      if (pc->num_presets[print_color_mode][_PWG_PRINT_QUALITY_NORMAL] > 0)
+        print_quality = _PWG_PRINT_QUALITY_NORMAL;
+      else if (pc->num_presets[_PWG_PRINT_COLOR_MODE_COLOR][print_quality] > 0)
+        print_color_mode = _PWG_PRINT_COLOR_MODE_COLOR;
+      else
+      {
+        print_quality    = _PWG_PRINT_QUALITY_NORMAL;
+        print_color_mode = _PWG_PRINT_COLOR_MODE_COLOR;
+      }
+    }
+
+    if (pc->num_presets[print_color_mode][print_quality] > 0)
+    {
+     /*
+      * Copy the preset options as long as the corresponding names are not
+      * already defined in the IPP request...
+      */
+
+      for (i = pc->num_presets[print_color_mode][print_quality],
+	       preset = pc->presets[print_color_mode][print_quality];
+	   i > 0;
+	   i --, preset ++)
+      {
+        if (!ippFindAttribute(job->attrs, preset->name, IPP_TAG_ZERO))
+        {
+          cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Adding preset option %s=%s", preset->name, preset->value);
+
+	  num_pwgppds = cupsAddOption(preset->name, preset->value, num_pwgppds, &pwgppds);
+        }
+      }
+    }
+  }
+
+  if (pc)
+  {
+    if ((attr = ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ENUM)) != NULL)
+    {
+      int pq = ippGetInteger(attr, 0);
+      static const char * const pqs[] = { "Draft", "Normal", "High" };
+
+      if (pq >= IPP_QUALITY_DRAFT && pq <= IPP_QUALITY_HIGH)
+      {
+        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping print-quality=%d to cupsPrintQuality=%s", pq, pqs[pq - IPP_QUALITY_DRAFT]);
+
+        num_pwgppds = cupsAddOption("cupsPrintQuality", pqs[pq - IPP_QUALITY_DRAFT], num_pwgppds, &pwgppds);
+      }
+    }
+
+    if (!ippFindAttribute(job->attrs, "InputSlot", IPP_TAG_ZERO) &&
+	!ippFindAttribute(job->attrs, "HPPaperSource", IPP_TAG_ZERO))
+    {
+      if ((ppd = _ppdCacheGetInputSlot(pc, job->attrs, NULL)) != NULL)
+	num_pwgppds = cupsAddOption(pc->source_option, ppd, num_pwgppds,
+				    &pwgppds);
+    }
+    if (!ippFindAttribute(job->attrs, "MediaType", IPP_TAG_ZERO) &&
+	(ppd = _ppdCacheGetMediaType(pc, job->attrs, NULL)) != NULL)
+    {
+      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping media to MediaType=%s", ppd);
+
+      num_pwgppds = cupsAddOption("MediaType", ppd, num_pwgppds, &pwgppds);
+    }
+
+    if (!ippFindAttribute(job->attrs, "PageRegion", IPP_TAG_ZERO) &&
+	!ippFindAttribute(job->attrs, "PageSize", IPP_TAG_ZERO) &&
+	(ppd = _ppdCacheGetPageSize(pc, job->attrs, NULL, &exact)) != NULL)
+    {
+      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping media to Pagesize=%s", ppd);
+
+      num_pwgppds = cupsAddOption("PageSize", ppd, num_pwgppds, &pwgppds);
+
+      if (!ippFindAttribute(job->attrs, "media", IPP_TAG_ZERO))
+      {
+        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Adding media=%s", ppd);
+
+        num_pwgppds = cupsAddOption("media", ppd, num_pwgppds, &pwgppds);
+      }
+    }
+
+    if (!ippFindAttribute(job->attrs, "OutputBin", IPP_TAG_ZERO) &&
+	(attr = ippFindAttribute(job->attrs, "output-bin",
+				 IPP_TAG_ZERO)) != NULL &&
+	(attr->value_tag == IPP_TAG_KEYWORD ||
+	 attr->value_tag == IPP_TAG_NAME) &&
+	(ppd = _ppdCacheGetOutputBin(pc, attr->values[0].string.text)) != NULL)
+    {
+     /*
+      * Map output-bin to OutputBin option...
+      */
+
+      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping output-bin to OutputBin=%s", ppd);
+
+      num_pwgppds = cupsAddOption("OutputBin", ppd, num_pwgppds, &pwgppds);
+    }
+
+    if (pc->sides_option &&
+        !ippFindAttribute(job->attrs, pc->sides_option, IPP_TAG_ZERO) &&
+	(attr = ippFindAttribute(job->attrs, "sides", IPP_TAG_KEYWORD)) != NULL)
+    {
+     /*
+      * Map sides to duplex option...
+      */
+
+      if (!strcmp(attr->values[0].string.text, "one-sided"))
+      {
+        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping sizes to Duplex=%s", pc->sides_1sided);
+
+        num_pwgppds = cupsAddOption(pc->sides_option, pc->sides_1sided, num_pwgppds, &pwgppds);
+      }
+      else if (!strcmp(attr->values[0].string.text, "two-sided-long-edge"))
+      {
+        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping sizes to Duplex=%s", pc->sides_2sided_long);
+
+        num_pwgppds = cupsAddOption(pc->sides_option, pc->sides_2sided_long, num_pwgppds, &pwgppds);
+      }
+      else if (!strcmp(attr->values[0].string.text, "two-sided-short-edge"))
+      {
+        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping sizes to Duplex=%s", pc->sides_2sided_short);
+
+        num_pwgppds = cupsAddOption(pc->sides_option, pc->sides_2sided_short, num_pwgppds, &pwgppds);
+      }
+    }
+
+   /*
+    * Map finishings values...
+    */
+
+    num_pwgppds = _ppdCacheGetFinishingOptions(pc, job->attrs, IPP_FINISHINGS_NONE, num_pwgppds, &pwgppds);
+
+    for (i = num_pwgppds, pwgppd = pwgppds; i > 0; i --, pwgppd ++)
+      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "After mapping finishings %s=%s", pwgppd->name, pwgppd->value);
+  }
+
+ /*
+  * Map page-delivery values...
+  */
+
+  if ((attr = ippFindAttribute(job->attrs, "page-delivery", IPP_TAG_KEYWORD)) != NULL && !ippFindAttribute(job->attrs, "outputorder", IPP_TAG_ZERO))
+  {
+    const char *page_delivery = ippGetString(attr, 0, NULL);
+
+    if (!strncmp(page_delivery, "same-order", 10))
+      num_pwgppds = cupsAddOption("OutputOrder", "Normal", num_pwgppds, &pwgppds);
+    else if (!strncmp(page_delivery, "reverse-order", 13))
+      num_pwgppds = cupsAddOption("OutputOrder", "Reverse", num_pwgppds, &pwgppds);
+  }
+
+ /*
+  * Figure out how much room we need...
+  */
+
+  newlength = ipp_length(job->attrs);
+
+  for (i = num_pwgppds, pwgppd = pwgppds; i > 0; i --, pwgppd ++)
+    newlength += 1 + strlen(pwgppd->name) + 1 + strlen(pwgppd->value);
+
+ /*
+  * Then allocate/reallocate the option buffer as needed...
+  */
+
+  if (newlength == 0)			/* This can never happen, but Clang */
+    newlength = 1;			/* thinks it can... */
+
+  if (newlength > optlength || !options)
+  {
+    if (!options)
+      optptr = malloc(newlength);
+    else
+      optptr = realloc(options, newlength);
+
+    if (!optptr)
+    {
+      cupsdLogJob(job, CUPSD_LOG_CRIT,
+		  "Unable to allocate " CUPS_LLFMT " bytes for option buffer.",
+		  CUPS_LLCAST newlength);
+      return (NULL);
+    }
+
+    options   = optptr;
+    optlength = newlength;
+  }
+
+ /*
+  * Now loop through the attributes and convert them to the textual
+  * representation used by the filters...
+  */
+
+  optptr  = options;
+  *optptr = '\0';
+
+  snprintf(title, title_size, "%s-%d", job->printer->name, job->id);
+  strlcpy(copies, "1", copies_size);
+
+  for (attr = job->attrs->attrs; attr != NULL; attr = attr->next)
+  {
+    if (!strcmp(attr->name, "copies") &&
+	attr->value_tag == IPP_TAG_INTEGER)
+    {
+     /*
+      * Don't use the # copies attribute if we are printing the job sheets...
+      */
+
+      if (!banner_page)
+        snprintf(copies, copies_size, "%d", attr->values[0].integer);
+    }
+    else if (!strcmp(attr->name, "job-name") &&
+	     (attr->value_tag == IPP_TAG_NAME ||
+	      attr->value_tag == IPP_TAG_NAMELANG))
+      strlcpy(title, attr->values[0].string.text, title_size);
+    else if (attr->group_tag == IPP_TAG_JOB)
+    {
+     /*
+      * Filter out other unwanted attributes...
+      */
+
+      if (attr->value_tag == IPP_TAG_NOVALUE ||
+          attr->value_tag == IPP_TAG_MIMETYPE ||
+	  attr->value_tag == IPP_TAG_NAMELANG ||
+	  attr->value_tag == IPP_TAG_TEXTLANG ||
+	  (attr->value_tag == IPP_TAG_URI && strcmp(attr->name, "job-uuid") &&
+	   strcmp(attr->name, "job-authorization-uri")) ||
+	  attr->value_tag == IPP_TAG_URISCHEME ||
+	  attr->value_tag == IPP_TAG_BEGIN_COLLECTION) /* Not yet supported */
+	continue;
+
+      if (!strcmp(attr->name, "job-hold-until") ||
+          !strcmp(attr->name, "job-id") ||
+          !strcmp(attr->name, "job-k-octets") ||
+          !strcmp(attr->name, "job-media-sheets") ||
+          !strcmp(attr->name, "job-media-sheets-completed") ||
+          !strcmp(attr->name, "job-state") ||
+          !strcmp(attr->name, "job-state-reasons"))
+	continue;
+
+      if (!strncmp(attr->name, "job-", 4) &&
+          strcmp(attr->name, "job-account-id") &&
+          strcmp(attr->name, "job-accounting-user-id") &&
+          strcmp(attr->name, "job-authorization-uri") &&
+          strcmp(attr->name, "job-billing") &&
+          strcmp(attr->name, "job-impressions") &&
+          strcmp(attr->name, "job-originating-host-name") &&
+          strcmp(attr->name, "job-password") &&
+          strcmp(attr->name, "job-password-encryption") &&
+          strcmp(attr->name, "job-uuid") &&
+          !(job->printer->type & CUPS_PRINTER_REMOTE))
+	continue;
+
+      if ((!strcmp(attr->name, "job-impressions") ||
+           !strcmp(attr->name, "page-label") ||
+           !strcmp(attr->name, "page-border") ||
+           !strncmp(attr->name, "number-up", 9) ||
+	   !strcmp(attr->name, "page-ranges") ||
+	   !strcmp(attr->name, "page-set") ||
+	   !_cups_strcasecmp(attr->name, "AP_FIRSTPAGE_InputSlot") ||
+	   !_cups_strcasecmp(attr->name, "AP_FIRSTPAGE_ManualFeed") ||
+	   !_cups_strcasecmp(attr->name, "com.apple.print.PrintSettings."
+	                           "PMTotalSidesImaged..n.") ||
+	   !_cups_strcasecmp(attr->name, "com.apple.print.PrintSettings."
+	                           "PMTotalBeginPages..n.")) &&
+	  banner_page)
+        continue;
+
+     /*
+      * Otherwise add them to the list...
+      */
+
+      if (optptr > options)
+	strlcat(optptr, " ", optlength - (size_t)(optptr - options));
+
+      if (attr->value_tag != IPP_TAG_BOOLEAN)
+      {
+	strlcat(optptr, attr->name, optlength - (size_t)(optptr - options));
+	strlcat(optptr, "=", optlength - (size_t)(optptr - options));
+      }
+
+      for (i = 0; i < attr->num_values; i ++)
+      {
+	if (i)
+	  strlcat(optptr, ",", optlength - (size_t)(optptr - options));
+
+	optptr += strlen(optptr);
+
+	switch (attr->value_tag)
+	{
+	  case IPP_TAG_INTEGER :
+	  case IPP_TAG_ENUM :
+	      snprintf(optptr, optlength - (size_t)(optptr - options),
+	               "%d", attr->values[i].integer);
+	      break;
+
+	  case IPP_TAG_BOOLEAN :
+	      if (!attr->values[i].boolean)
+		strlcat(optptr, "no", optlength - (size_t)(optptr - options));
+
+	      strlcat(optptr, attr->name, optlength - (size_t)(optptr - options));
+	      break;
+
+	  case IPP_TAG_RANGE :
+	      if (attr->values[i].range.lower == attr->values[i].range.upper)
+		snprintf(optptr, optlength - (size_t)(optptr - options) - 1,
+	        	 "%d", attr->values[i].range.lower);
+              else
+		snprintf(optptr, optlength - (size_t)(optptr - options) - 1,
+	        	 "%d-%d", attr->values[i].range.lower,
+			 attr->values[i].range.upper);
+	      break;
+
+	  case IPP_TAG_RESOLUTION :
+	      snprintf(optptr, optlength - (size_t)(optptr - options) - 1,
+	               "%dx%d%s", attr->values[i].resolution.xres,
+		       attr->values[i].resolution.yres,
+		       attr->values[i].resolution.units == IPP_RES_PER_INCH ?
+			   "dpi" : "dpcm");
+	      break;
+
+          case IPP_TAG_STRING :
+              {
+                int length = attr->values[i].unknown.length;
+
+		for (valptr = attr->values[i].unknown.data; length > 0; length --)
+		{
+		  if ((*valptr & 255) < 0x20 || *valptr == 0x7f)
+		    break;
+		}
+
+		if (length > 0)
+		{
+		 /*
+		  * Encode this string as hex characters...
+		  */
+
+                  *optptr++ = '<';
+
+		  for (valptr = attr->values[i].unknown.data, length = attr->values[i].unknown.length; length > 0; length --)
+		  {
+		    snprintf(optptr, optlength - (size_t)(optptr - options) - 1, "%02X", *valptr & 255);
+		    optptr += 2;
+		  }
+
+                  *optptr++ = '>';
+		}
+		else
+		{
+		  for (valptr = attr->values[i].unknown.data, length = attr->values[i].unknown.length; length > 0; length --)
+		  {
+		    if (strchr(" \t\n\\\'\"", *valptr))
+		      *optptr++ = '\\';
+		    *optptr++ = *valptr++;
+		  }
+		}
+	      }
+
+	      *optptr = '\0';
+	      break;
+
+	  case IPP_TAG_TEXT :
+	  case IPP_TAG_NAME :
+	  case IPP_TAG_KEYWORD :
+	  case IPP_TAG_CHARSET :
+	  case IPP_TAG_LANGUAGE :
+	  case IPP_TAG_URI :
+	      for (valptr = attr->values[i].string.text; *valptr;)
+	      {
+	        if (strchr(" \t\n\\\'\"", *valptr))
+		  *optptr++ = '\\';
+		*optptr++ = *valptr++;
+	      }
+
+	      *optptr = '\0';
+	      break;
+
+          default :
+	      break; /* anti-compiler-warning-code */
+	}
+      }
+
+      optptr += strlen(optptr);
+    }
+  }
+
+ /*
+  * Finally loop through the PWG->PPD mapped options and add them...
+  */
+
+  for (i = num_pwgppds, pwgppd = pwgppds; i > 0; i --, pwgppd ++)
+  {
+    *optptr++ = ' ';
+    strlcpy(optptr, pwgppd->name, optlength - (size_t)(optptr - options));
+    optptr += strlen(optptr);
+    *optptr++ = '=';
+    strlcpy(optptr, pwgppd->value, optlength - (size_t)(optptr - options));
+    optptr += strlen(optptr);
+  }
+
+  cupsFreeOptions(num_pwgppds, pwgppds);
+
+ /*
+  * Return the options string...
+  */
+
+  return (options);
+}
+
+
+/*
+ * 'get_render_filename()' - Get the name of a job's pre-rendered output.
+ */
+
+static char *				/* O - Filename */
+get_render_filename(cupsd_job_t *job,	/* I - Job */
+                    const char  *ext,	/* I - Filename extension */
+                    char        *buffer,/* I - Filename buffer */
+		    size_t      bufsize)/* I - Size of buffer */
+{
+  snprintf(buffer, bufsize, "%s/render/%d%s", RequestRoot, job->id, ext);
+
+  return (buffer);
+}
+
+
+/*
+ * 'get_render_key()' - Get the render cache key for a job.
+ *
+ * The key is a SHA2-256 hash of the printer name and configuration time, the
+ * job owner, document format, and options, and the document data.  Job
+ * attributes that cupsd sets for every job, like the UUID and timestamps,
+ * are left out so that identical submissions share a key.  The document is
+ * hashed a buffer at a time, together with the hash of everything before it.
+ */
+
+static char *				/* O - Key or NULL on error */
+get_render_key(cupsd_job_t     *job,	/* I - Job */
+               cupsd_printer_t *printer,/* I - Printer */
+               char            *buffer,	/* I - Key buffer */
+	       size_t          bufsize)	/* I - Size of key buffer */
+{
+  ipp_attribute_t	*attr;		/* Current attribute */
+  const char		*name;		/* Attribute name */
+  cups_file_t		*fp;		/* Document file */
+  char			filename[1024],	/* Document filename */
+			*data,		/* Data to hash */
+			*ptr,		/* Pointer into data */
+			*end;		/* End of data */
+  size_t		datasize;	/* Size of data buffer */
+  ssize_t		bytes,		/* Bytes read */
+			hashsize;	/* Size of hash */
+  int			error;		/* Error reading or hashing? */
+  unsigned char		hash[64];	/* Hash of data so far */
+
+
+  if ((datasize = ipp_length(job->attrs) + 2048) < 65536)
+    datasize = 65536;
+
+  if ((data = malloc(datasize)) == NULL)
+    return (NULL);
+
+  snprintf(data, datasize, "%s\n%ld\n%s\n%s/%s\n", printer->name,
+           (long)printer->config_time, job->username,
+	   job->filetypes[0]->super, job->filetypes[0]->type);
+
+  ptr = data + strlen(data);
+  end = data + datasize;
+
+  for (attr = job->attrs->attrs; attr; attr = attr->next)
+  {
+    if (attr->group_tag != IPP_TAG_JOB || (name = attr->name) == NULL)
+      continue;
+
+    if (!strncmp(name, "time-at-", 8) || !strncmp(name, "date-time-at-", 13))
+      continue;
+
+    if (!strncmp(name, "job-", 4) &&
+        strcmp(name, "job-account-id") &&
+        strcmp(name, "job-accounting-user-id") &&
+        strcmp(name, "job-billing") &&
+        strcmp(name, "job-impressions") &&
+        strcmp(name, "job-name") &&
+        strcmp(name, "job-originating-host-name") &&
+        strcmp(name, "job-password") &&
+        strcmp(name, "job-password-encryption"))
+      continue;
+
+    snprintf(ptr, (size_t)(end - ptr), "%s=", name);
+    ptr += strlen(ptr);
+    ptr += ippAttributeString(attr, ptr, (size_t)(end - ptr));
+
+    if (ptr >= (end - 1))
+    {
+      free(data);
+      return (NULL);
+    }
+
+    *ptr++ = '\n';
+  }
+
+  if ((hashsize = cupsHashData("sha2-256", data, (size_t)(ptr - data), hash, sizeof(hash))) < 0)
+  {
+    free(data);
+    return (NULL);
+  }
+
+  cupsdGetJobFilename(job->id, 'd', 1, filename, sizeof(filename));
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  {
+    free(data);
+    return (NULL);
+  }
+
+  while ((bytes = cupsFileRead(fp, data + hashsize, datasize - (size_t)hashsize)) > 0)
+  {
+    memcpy(data, hash, (size_t)hashsize);
+
+    if (cupsHashData("sha2-256", data, (size_t)(hashsize + bytes), hash, sizeof(hash)) < 0)
+      break;
+  }
+
+  error = bytes > 0 || !cupsFileEOF(fp);
+
+  cupsFileClose(fp);
+  free(data);
+
+  if (error)
+    return (NULL);
 
-  if (job->history)
+  return ((char *)cupsHashString(hash, (size_t)hashsize, buffer, bufsize));
+}
+
+
+/*
+ * 'get_request_dirs()' - Get the directories that hold job files.
+ */
+
+static cups_array_t *			/* O - Array of directory names or NULL */
+get_request_dirs(void)
+{
+  cups_array_t	*dirs;			/* Array of directories */
+  cups_dir_t	*dir;			/* RequestRoot directory */
+  cups_dentry_t	*dent;			/* Directory entry */
+  char		dirname[1024];		/* Hashed spool directory name */
+
+
+  if ((dirs = cupsArrayNew3(NULL, NULL, NULL, 0, (cups_acopy_func_t)strdup, (cups_afree_func_t)free)) == NULL)
+    return (NULL);
+
+  if (SpoolLayout != CUPSD_SPOOL_HASHED)
   {
-    if (job->status &&
-        (job->state_value == IPP_JOB_ABORTED ||
-         job->state_value == IPP_JOB_STOPPED))
-      dump_job_history(job);
+    cupsArrayAdd(dirs, RequestRoot);
+    return (dirs);
+  }
+
+  if ((dir = cupsDirOpen(RequestRoot)) == NULL)
+  {
+    cupsArrayDelete(dirs);
+    return (NULL);
+  }
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if (dent->filename[0] == 'j' && isdigit(dent->filename[1] & 255) &&
+        S_ISDIR(dent->fileinfo.st_mode))
+    {
+      snprintf(dirname, sizeof(dirname), "%s/%s", RequestRoot, dent->filename);
+      cupsArrayAdd(dirs, dirname);
+    }
+  }
+
+  cupsDirClose(dir);
+
+  return (dirs);
+}
+
+
+/*
+ * 'ipp_length()' - Compute the size of the buffer needed to hold
+ *		    the textual IPP attributes.
+ */
+
+static size_t				/* O - Size of attribute buffer */
+ipp_length(ipp_t *ipp)			/* I - IPP request */
+{
+  size_t		bytes; 		/* Number of bytes */
+  int			i;		/* Looping var */
+  ipp_attribute_t	*attr;		/* Current attribute */
+
+
+ /*
+  * Loop through all attributes...
+  */
+
+  bytes = 0;
+
+  for (attr = ipp->attrs; attr != NULL; attr = attr->next)
+  {
+   /*
+    * Skip attributes that won't be sent to filters...
+    */
+
+    if (attr->value_tag == IPP_TAG_NOVALUE ||
+	attr->value_tag == IPP_TAG_MIMETYPE ||
+	attr->value_tag == IPP_TAG_NAMELANG ||
+	attr->value_tag == IPP_TAG_TEXTLANG ||
+	attr->value_tag == IPP_TAG_URI ||
+	attr->value_tag == IPP_TAG_URISCHEME)
+      continue;
+
+   /*
+    * Add space for a leading space and commas between each value.
+    * For the first attribute, the leading space isn't used, so the
+    * extra byte can be used as the nul terminator...
+    */
+
+    bytes ++;				/* " " separator */
+    bytes += (size_t)attr->num_values;	/* "," separators */
+
+   /*
+    * Boolean attributes appear as "foo,nofoo,foo,nofoo", while
+    * other attributes appear as "foo=value1,value2,...,valueN".
+    */
+
+    if (attr->value_tag != IPP_TAG_BOOLEAN)
+      bytes += strlen(attr->name);
     else
-      free_job_history(job);
+      bytes += (size_t)attr->num_values * strlen(attr->name);
+
+   /*
+    * Now add the size required for each value in the attribute...
+    */
+
+    switch (attr->value_tag)
+    {
+      case IPP_TAG_INTEGER :
+      case IPP_TAG_ENUM :
+         /*
+	  * Minimum value of a signed integer is -2147483647, or 11 digits.
+	  */
+
+	  bytes += (size_t)attr->num_values * 11;
+	  break;
+
+      case IPP_TAG_BOOLEAN :
+         /*
+	  * Add two bytes for each false ("no") value...
+	  */
+
+          for (i = 0; i < attr->num_values; i ++)
+	    if (!attr->values[i].boolean)
+	      bytes += 2;
+	  break;
+
+      case IPP_TAG_RANGE :
+         /*
+	  * A range is two signed integers separated by a hyphen, or
+	  * 23 characters max.
+	  */
+
+	  bytes += (size_t)attr->num_values * 23;
+	  break;
+
+      case IPP_TAG_RESOLUTION :
+         /*
+	  * A resolution is two signed integers separated by an "x" and
+	  * suffixed by the units, or 26 characters max.
+	  */
+
+	  bytes += (size_t)attr->num_values * 26;
+	  break;
+
+      case IPP_TAG_STRING :
+         /*
+	  * Octet strings can contain characters that need quoting.  We need
+	  * at least 2 * len + 2 characters to cover the quotes and any
+	  * backslashes in the string.
+	  */
+
+          for (i = 0; i < attr->num_values; i ++)
+	    bytes += 2 * (size_t)attr->values[i].unknown.length + 2;
+	  break;
+
+      case IPP_TAG_TEXT :
+      case IPP_TAG_NAME :
+      case IPP_TAG_KEYWORD :
+      case IPP_TAG_CHARSET :
+      case IPP_TAG_LANGUAGE :
+      case IPP_TAG_URI :
+         /*
+	  * Strings can contain characters that need quoting.  We need
+	  * at least 2 * len + 2 characters to cover the quotes and
+	  * any backslashes in the string.
+	  */
+
+          for (i = 0; i < attr->num_values; i ++)
+	    bytes += 2 * strlen(attr->values[i].string.text) + 2;
+	  break;
+
+       default :
+	  break; /* anti-compiler-warning-code */
+    }
   }
 
-  cupsArrayRemove(PrintingJobs, job);
+  return (bytes);
+}
+
+
+/*
+ * 'load_doc_store()' - Load the index of shared documents.
+ *
+ * Store files that are no longer used by any document are removed.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+load_doc_store(void)
+{
+  char			dirname[1024];	/* Store directory */
+  cups_dir_t		*dir;		/* Store directory */
+  cups_dentry_t		*dent;		/* Directory entry */
+  cupsd_docref_t	*doc;		/* Shared document */
+  unsigned		hash;		/* Hash from filename */
+  int			serial;		/* Serial number from filename */
+
+
+  if (doc_hashes)
+    return (1);
+
+  if (cupsdCheckPermissions(RequestRoot, "store", 0710, RunUser, Group, 1, -1) < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create document store \"%s/store\": %s", RequestRoot, strerror(errno));
+    return (0);
+  }
+
+  doc_hashes = cupsArrayNew((cups_array_func_t)compare_doc_hashes, NULL);
+  doc_inodes = cupsArrayNew((cups_array_func_t)compare_doc_inodes, NULL);
+
+  snprintf(dirname, sizeof(dirname), "%s/store", RequestRoot);
+
+  if ((dir = cupsDirOpen(dirname)) == NULL)
+    return (1);
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if (sscanf(dent->filename, "%x-%d", &hash, &serial) != 2)
+      continue;
+
+    if (serial > doc_serial)
+      doc_serial = serial;
+
+    if (dent->fileinfo.st_nlink < 2)
+    {
+      snprintf(dirname, sizeof(dirname), "%s/store/%s", RequestRoot, dent->filename);
+      cupsdPurgeFile(dirname);
+      continue;
+    }
+
+    if ((doc = calloc(1, sizeof(cupsd_docref_t))) == NULL)
+      break;
+
+    doc->hash = hash;
+    doc->size = dent->fileinfo.st_size;
+    doc->dev  = dent->fileinfo.st_dev;
+    doc->ino  = dent->fileinfo.st_ino;
+
+    snprintf(doc->filename, sizeof(doc->filename), "%s/store/%s", RequestRoot, dent->filename);
+
+    cupsArrayAdd(doc_hashes, doc);
+    cupsArrayAdd(doc_inodes, doc);
+  }
+
+  cupsDirClose(dir);
+
+  return (1);
+}
+
+
+/*
+ * 'load_job_cache()' - Load jobs from the job.cache and job.journal files.
+ */
+
+static void
+load_job_cache(const char *filename,	/* I - job.cache filename */
+               const char *journal)	/* I - job.journal filename */
+{
+  cups_file_t	*fp;			/* job.cache file */
+  cupsd_job_t	*job;			/* Current job */
+  char		jobfile[1024];		/* Job filename */
+  cups_array_t	*loads;			/* Jobs to load */
+
+
+ /*
+  * Open the job.cache file...
+  */
+
+  if ((fp = cupsdOpenConfFile(filename)) == NULL)
+  {
+    load_request_root();
+    return;
+  }
+
+ /*
+  * Read entries from the job cache file and create jobs as needed.
+  */
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Loading job cache file \"%s\"...",
+                  filename);
+
+  cupsFileSetBufferSize(fp, 65536);
+  read_job_cache(fp, filename, 0);
+  cupsFileClose(fp);
+
+ /*
+  * Then replay any changes that were made after job.cache was written...
+  */
+
+  if ((fp = cupsFileOpen(journal, "r")) != NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO, "Loading job journal file \"%s\"...",
+		    journal);
+
+    cupsFileSetBufferSize(fp, 65536);
+    read_job_cache(fp, journal, 1);
+    cupsFileClose(fp);
+  }
+
+ /*
+  * Make sure the cache matches the spool directory and load active jobs...
+  */
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+  {
+    cupsdGetJobFilename(job->id, 'c', 0, jobfile, sizeof(jobfile));
+    if (access(jobfile, 0))
+    {
+      strlcat(jobfile, ".N", sizeof(jobfile));
+      if (access(jobfile, 0))
+      {
+	cupsdLogJob(job, CUPSD_LOG_ERROR, "Files have gone away.");
+
+       /*
+	* job.cache file is out-of-date compared to spool directory; load
+	* that instead...
+	*/
 
- /*
-  * Clear informational messages...
-  */
+	for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+	     job;
+	     job = (cupsd_job_t *)cupsArrayNext(Jobs))
+	  cupsdDeleteJob(job, CUPSD_JOB_DEFAULT);
 
-  if (job->status_level > CUPSD_LOG_ERROR)
-    job->printer->state_message[0] = '\0';
+	load_request_root();
+	return;
+      }
+    }
+  }
 
- /*
-  * Apply any PPD updates...
-  */
+  loads = cupsArrayNew(NULL, NULL);
 
-  if (job->num_keywords)
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
   {
-    if (cupsdUpdatePrinterPPD(job->printer, job->num_keywords, job->keywords))
-      cupsdSetPrinterAttrs(job->printer);
+    if (job->state_value <= IPP_JOB_STOPPED ||
+        !job->completed_time || !job->creation_time || !job->name ||
+	!job->koctets)
+      cupsArrayAdd(loads, job);
+  }
 
-    cupsFreeOptions(job->num_keywords, job->keywords);
+  start_job_loads(loads);
 
-    job->num_keywords = 0;
-    job->keywords     = NULL;
+  for (job = (cupsd_job_t *)cupsArrayFirst(loads);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(loads))
+  {
+    if (job->state_value <= IPP_JOB_STOPPED)
+    {
+      if (cupsdLoadJob(job))
+        cupsArrayAdd(ActiveJobs, job);
+    }
+    else
+    {
+      cupsdLoadJob(job);
+      unload_job(job);
+    }
   }
 
- /*
-  * Clear the printer <-> job association...
-  */
-
-  job->printer->job = NULL;
-  job->printer      = NULL;
+  finish_job_loads();
+  cupsArrayDelete(loads);
 }
 
 
 /*
- * 'get_options()' - Get a string containing the job options.
+ * 'load_job_thread()' - Read control files until none are left.
  */
 
-static char *				/* O - Options string */
-get_options(cupsd_job_t *job,		/* I - Job */
-            int         banner_page,	/* I - Printing a banner page? */
-	    char        *copies,	/* I - Copies buffer */
-	    size_t      copies_size,	/* I - Size of copies buffer */
-	    char        *title,		/* I - Title buffer */
-	    size_t      title_size)	/* I - Size of title buffer */
+static void *				/* O - Thread exit status */
+load_job_thread(void *data)		/* I - Thread data (not used) */
 {
-  int			i;		/* Looping var */
-  size_t		newlength;	/* New option buffer length */
-  char			*optptr,	/* Pointer to options */
-			*valptr;	/* Pointer in value string */
-  ipp_attribute_t	*attr;		/* Current attribute */
-  _ppd_cache_t		*pc;		/* PPD cache and mapping data */
-  int			num_pwgppds;	/* Number of PWG->PPD options */
-  cups_option_t		*pwgppds,	/* PWG->PPD options */
-			*pwgppd,	/* Current PWG->PPD option */
-			*preset;	/* Current preset option */
-  int			print_color_mode,
-					/* Output mode (if any) */
-			print_quality;	/* Print quality (if any) */
-  const char		*ppd;		/* PPD option choice */
-  int			exact;		/* Did we get an exact match? */
-  static char		*options = NULL;/* Full list of options */
-  static size_t		optlength = 0;	/* Length of option buffer */
-
+  int		i;			/* Control file to read */
+  char		jobfile[1024];		/* Job filename */
+  cups_file_t	*fp;			/* Job file */
+  ipp_t		*attrs;			/* Job attributes */
 
- /*
-  * Building the options string is harder than it needs to be, but for the
-  * moment we need to pass strings for command-line args and not IPP attribute
-  * pointers... :)
-  *
-  * First build an options array for any PWG->PPD mapped option/choice pairs.
-  */
 
-  pc          = job->printer->pc;
-  num_pwgppds = 0;
-  pwgppds     = NULL;
+  (void)data;
 
-  if (pc &&
-      !ippFindAttribute(job->attrs, "com.apple.print.DocumentTicket.PMSpoolFormat", IPP_TAG_ZERO) &&
-      !ippFindAttribute(job->attrs, "APPrinterPreset", IPP_TAG_ZERO) &&
-      (ippFindAttribute(job->attrs, "print-color-mode", IPP_TAG_ZERO) || ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ZERO) || ippFindAttribute(job->attrs, "cupsPrintQuality", IPP_TAG_ZERO)))
+  for (;;)
   {
    /*
-    * Map print-color-mode and print-quality to a preset...
+    * Get the next control file, staying within the read-ahead window...
     */
 
-    if ((attr = ippFindAttribute(job->attrs, "print-color-mode",
-				 IPP_TAG_KEYWORD)) != NULL &&
-        !strcmp(attr->values[0].string.text, "monochrome"))
-      print_color_mode = _PWG_PRINT_COLOR_MODE_MONOCHROME;
-    else
-      print_color_mode = _PWG_PRINT_COLOR_MODE_COLOR;
+    _cupsMutexLock(&job_loads_mutex);
 
-    if ((attr = ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ENUM)) != NULL)
-    {
-      ipp_quality_t pq = (ipp_quality_t)ippGetInteger(attr, 0);
+    while (job_loads_next < job_loads_count &&
+           job_loads_next >= job_loads_used + CUPSD_JOBLOAD_WINDOW)
+      _cupsCondWait(&job_loads_cond, &job_loads_mutex, 0.0);
 
-      if (pq >= IPP_QUALITY_DRAFT && pq <= IPP_QUALITY_HIGH)
-        print_quality = attr->values[0].integer - IPP_QUALITY_DRAFT;
-      else
-        print_quality = _PWG_PRINT_QUALITY_NORMAL;
-    }
-    else if ((attr = ippFindAttribute(job->attrs, "cupsPrintQuality", IPP_TAG_NAME)) != NULL)
+    if (job_loads_next >= job_loads_count)
     {
-      const char *pq = ippGetString(attr, 0, NULL);
+      _cupsMutexUnlock(&job_loads_mutex);
+      break;
+    }
 
-      if (!_cups_strcasecmp(pq, "draft"))
-        print_quality = _PWG_PRINT_QUALITY_DRAFT;
-      else if (!_cups_strcasecmp(pq, "high"))
-        print_quality = _PWG_PRINT_QUALITY_HIGH;
-      else
-        print_quality = _PWG_PRINT_QUALITY_NORMAL;
+    i = job_loads_next ++;
 
-      if (!ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ENUM))
+    _cupsMutexUnlock(&job_loads_mutex);
+
+   /*
+    * Read it without logging; cupsdLoadJob() reports any errors when it
+    * reads the file again...
+    */
+
+    cupsdGetJobFilename(job_loads[i].job->id, 'c', 0, jobfile, sizeof(jobfile));
+
+    if ((attrs = ippNew()) != NULL && (fp = cupsFileOpen(jobfile, "r")) != NULL)
+    {
+      if (!read_job_attrs(attrs, fp))
       {
-        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping cupsPrintQuality=%s to print-quality=%d", pq, print_quality + IPP_QUALITY_DRAFT);
-        num_pwgppds = cupsAddIntegerOption("print-quality", print_quality + IPP_QUALITY_DRAFT, num_pwgppds, &pwgppds);
+        ippDelete(attrs);
+	attrs = NULL;
       }
+
+      cupsFileClose(fp);
     }
     else
     {
-      print_quality = _PWG_PRINT_QUALITY_NORMAL;
+      ippDelete(attrs);
+      attrs = NULL;
     }
 
-    if (pc->num_presets[print_color_mode][print_quality] == 0)
-    {
-     /*
-      * Try to find a preset that works so that we maximize the chances of us
-      * getting a good print using IPP attributes.
-      */
+    _cupsMutexLock(&job_loads_mutex);
 
-      if (pc->num_presets[print_color_mode][_PWG_PRINT_QUALITY_NORMAL] > 0)
-        print_quality = _PWG_PRINT_QUALITY_NORMAL;
-      else if (pc->num_presets[_PWG_PRINT_COLOR_MODE_COLOR][print_quality] > 0)
-        print_color_mode = _PWG_PRINT_COLOR_MODE_COLOR;
-      else
-      {
-        print_quality    = _PWG_PRINT_QUALITY_NORMAL;
-        print_color_mode = _PWG_PRINT_COLOR_MODE_COLOR;
-      }
-    }
+    job_loads[i].attrs = attrs;
+    job_loads[i].done  = 1;
 
-    if (pc->num_presets[print_color_mode][print_quality] > 0)
-    {
-     /*
-      * Copy the preset options as long as the corresponding names are not
-      * already defined in the IPP request...
-      */
+    _cupsCondBroadcast(&job_loads_cond);
+    _cupsMutexUnlock(&job_loads_mutex);
+  }
 
-      for (i = pc->num_presets[print_color_mode][print_quality],
-	       preset = pc->presets[print_color_mode][print_quality];
-	   i > 0;
-	   i --, preset ++)
-      {
-        if (!ippFindAttribute(job->attrs, preset->name, IPP_TAG_ZERO))
-        {
-          cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Adding preset option %s=%s", preset->name, preset->value);
+  return (NULL);
+}
 
-	  num_pwgppds = cupsAddOption(preset->name, preset->value, num_pwgppds, &pwgppds);
-        }
-      }
-    }
+
+/*
+ * 'load_next_job_id()' - Load the NextJobId value from the job.cache file.
+ */
+
+static void
+load_next_job_id(const char *filename)	/* I - job.cache filename */
+{
+  cups_file_t	*fp;			/* job.cache file */
+  char		line[1024],		/* Line buffer */
+		*value;			/* Value on line */
+  int		linenum;		/* Line number in file */
+  int		next_job_id;		/* NextJobId value from line */
+
+
+ /*
+  * Read the NextJobId directive from the job.cache file and use
+  * the value (if any).
+  */
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  {
+    if (errno != ENOENT)
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+                      "Unable to open job cache file \"%s\": %s",
+                      filename, strerror(errno));
+
+    return;
   }
 
-  if (pc)
+  cupsdLogMessage(CUPSD_LOG_INFO,
+                  "Loading NextJobId from job cache file \"%s\"...", filename);
+
+  linenum = 0;
+
+  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
   {
-    if ((attr = ippFindAttribute(job->attrs, "print-quality", IPP_TAG_ENUM)) != NULL)
+    if (!_cups_strcasecmp(line, "NextJobId"))
     {
-      int pq = ippGetInteger(attr, 0);
-      static const char * const pqs[] = { "Draft", "Normal", "High" };
-
-      if (pq >= IPP_QUALITY_DRAFT && pq <= IPP_QUALITY_HIGH)
+      if (value)
       {
-        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping print-quality=%d to cupsPrintQuality=%s", pq, pqs[pq - IPP_QUALITY_DRAFT]);
+        next_job_id = atoi(value);
 
-        num_pwgppds = cupsAddOption("cupsPrintQuality", pqs[pq - IPP_QUALITY_DRAFT], num_pwgppds, &pwgppds);
+        if (next_job_id > NextJobId)
+	  NextJobId = next_job_id;
       }
+      break;
     }
+  }
 
-    if (!ippFindAttribute(job->attrs, "InputSlot", IPP_TAG_ZERO) &&
-	!ippFindAttribute(job->attrs, "HPPaperSource", IPP_TAG_ZERO))
-    {
-      if ((ppd = _ppdCacheGetInputSlot(pc, job->attrs, NULL)) != NULL)
-	num_pwgppds = cupsAddOption(pc->source_option, ppd, num_pwgppds,
-				    &pwgppds);
-    }
-    if (!ippFindAttribute(job->attrs, "MediaType", IPP_TAG_ZERO) &&
-	(ppd = _ppdCacheGetMediaType(pc, job->attrs, NULL)) != NULL)
-    {
-      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping media to MediaType=%s", ppd);
+  cupsFileClose(fp);
+}
 
-      num_pwgppds = cupsAddOption("MediaType", ppd, num_pwgppds, &pwgppds);
-    }
 
-    if (!ippFindAttribute(job->attrs, "PageRegion", IPP_TAG_ZERO) &&
-	!ippFindAttribute(job->attrs, "PageSize", IPP_TAG_ZERO) &&
-	(ppd = _ppdCacheGetPageSize(pc, job->attrs, NULL, &exact)) != NULL)
-    {
-      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping media to Pagesize=%s", ppd);
+/*
+ * 'load_request_root()' - Load jobs from the RequestRoot directory.
+ */
 
-      num_pwgppds = cupsAddOption("PageSize", ppd, num_pwgppds, &pwgppds);
+static void
+load_request_root(void)
+{
+  cups_array_t		*dirs;		/* Directories */
+  const char		*dirname;	/* Current directory */
+  cups_dir_t		*dir;		/* Directory */
+  cups_dentry_t		*dent = NULL;	/* Directory entry */
+  cupsd_job_t		*job;		/* New job */
+  cups_array_t		*loads;		/* Jobs to load */
 
-      if (!ippFindAttribute(job->attrs, "media", IPP_TAG_ZERO))
-      {
-        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Adding media=%s", ppd);
 
-        num_pwgppds = cupsAddOption("media", ppd, num_pwgppds, &pwgppds);
-      }
-    }
+ /*
+  * Get the requests directories...
+  */
 
-    if (!ippFindAttribute(job->attrs, "OutputBin", IPP_TAG_ZERO) &&
-	(attr = ippFindAttribute(job->attrs, "output-bin",
-				 IPP_TAG_ZERO)) != NULL &&
-	(attr->value_tag == IPP_TAG_KEYWORD ||
-	 attr->value_tag == IPP_TAG_NAME) &&
-	(ppd = _ppdCacheGetOutputBin(pc, attr->values[0].string.text)) != NULL)
-    {
-     /*
-      * Map output-bin to OutputBin option...
-      */
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Scanning %s for jobs...", RequestRoot);
+
+  if ((dirs = get_request_dirs()) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to open spool directory \"%s\": %s",
+                    RequestRoot, strerror(errno));
+    return;
+  }
 
-      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping output-bin to OutputBin=%s", ppd);
+  loads = cupsArrayNew(NULL, NULL);
 
-      num_pwgppds = cupsAddOption("OutputBin", ppd, num_pwgppds, &pwgppds);
+  for (dirname = (const char *)cupsArrayFirst(dirs);
+       dirname;
+       dirname = (const char *)cupsArrayNext(dirs))
+  {
+    if ((dir = cupsDirOpen(dirname)) == NULL)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+		      "Unable to open spool directory \"%s\": %s",
+		      dirname, strerror(errno));
+      continue;
     }
 
-    if (pc->sides_option &&
-        !ippFindAttribute(job->attrs, pc->sides_option, IPP_TAG_ZERO) &&
-	(attr = ippFindAttribute(job->attrs, "sides", IPP_TAG_KEYWORD)) != NULL)
-    {
-     /*
-      * Map sides to duplex option...
-      */
+   /*
+    * Allocate jobs for all the c##### files...
+    */
 
-      if (!strcmp(attr->values[0].string.text, "one-sided"))
+    while ((dent = cupsDirRead(dir)) != NULL)
+      if (strlen(dent->filename) >= 6 && dent->filename[0] == 'c')
       {
-        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping sizes to Duplex=%s", pc->sides_1sided);
+       /*
+	* Allocate memory for the job...
+	*/
 
-        num_pwgppds = cupsAddOption(pc->sides_option, pc->sides_1sided, num_pwgppds, &pwgppds);
-      }
-      else if (!strcmp(attr->values[0].string.text, "two-sided-long-edge"))
-      {
-        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping sizes to Duplex=%s", pc->sides_2sided_long);
+	if ((job = cupsdSlabAlloc(CUPSD_SLAB_JOB)) == NULL)
+	{
+	  cupsdLogMessage(CUPSD_LOG_ERROR, "Ran out of memory for jobs.");
+	  break;
+	}
 
-        num_pwgppds = cupsAddOption(pc->sides_option, pc->sides_2sided_long, num_pwgppds, &pwgppds);
-      }
-      else if (!strcmp(attr->values[0].string.text, "two-sided-short-edge"))
-      {
-        cupsdLogJob(job, CUPSD_LOG_DEBUG2, "Mapping sizes to Duplex=%s", pc->sides_2sided_short);
+       /*
+	* Assign the job ID...
+	*/
 
-        num_pwgppds = cupsAddOption(pc->sides_option, pc->sides_2sided_short, num_pwgppds, &pwgppds);
-      }
-    }
+	job->id              = atoi(dent->filename + 1);
+	job->back_pipes[0]   = -1;
+	job->back_pipes[1]   = -1;
+	job->print_pipes[0]  = -1;
+	job->print_pipes[1]  = -1;
+	job->side_pipes[0]   = -1;
+	job->side_pipes[1]   = -1;
+	job->status_pipes[0] = -1;
+	job->status_pipes[1] = -1;
 
-   /*
-    * Map finishings values...
-    */
+	if (job->id >= NextJobId)
+	  NextJobId = job->id + 1;
 
-    num_pwgppds = _ppdCacheGetFinishingOptions(pc, job->attrs, IPP_FINISHINGS_NONE, num_pwgppds, &pwgppds);
+        cupsArrayAdd(loads, job);
+      }
 
-    for (i = num_pwgppds, pwgppd = pwgppds; i > 0; i --, pwgppd ++)
-      cupsdLogJob(job, CUPSD_LOG_DEBUG2, "After mapping finishings %s=%s", pwgppd->name, pwgppd->value);
+    cupsDirClose(dir);
+
+    if (dent)
+      break;
   }
 
+  cupsArrayDelete(dirs);
+
  /*
-  * Map page-delivery values...
+  * Then load the jobs, reading the control files using multiple threads...
   */
 
-  if ((attr = ippFindAttribute(job->attrs, "page-delivery", IPP_TAG_KEYWORD)) != NULL && !ippFindAttribute(job->attrs, "outputorder", IPP_TAG_ZERO))
+  start_job_loads(loads);
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(loads);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(loads))
   {
-    const char *page_delivery = ippGetString(attr, 0, NULL);
+    if (cupsdLoadJob(job))
+    {
+     /*
+      * Insert the job into the array, sorting by job priority and ID...
+      */
 
-    if (!strncmp(page_delivery, "same-order", 10))
-      num_pwgppds = cupsAddOption("OutputOrder", "Normal", num_pwgppds, &pwgppds);
-    else if (!strncmp(page_delivery, "reverse-order", 13))
-      num_pwgppds = cupsAddOption("OutputOrder", "Reverse", num_pwgppds, &pwgppds);
+      cupsArrayAdd(Jobs, job);
+
+      if (job->state_value <= IPP_JOB_STOPPED)
+	cupsArrayAdd(ActiveJobs, job);
+      else
+	unload_job(job);
+    }
+    else
+      cupsdSlabFree(CUPSD_SLAB_JOB, job);
   }
 
- /*
-  * Figure out how much room we need...
-  */
+  finish_job_loads();
+  cupsArrayDelete(loads);
+}
 
-  newlength = ipp_length(job->attrs);
 
-  for (i = num_pwgppds, pwgppd = pwgppds; i > 0; i --, pwgppd ++)
-    newlength += 1 + strlen(pwgppd->name) + 1 + strlen(pwgppd->value);
+/*
+ * 'make_request_dir()' - Create the hashed spool directory for a job.
+ */
 
- /*
-  * Then allocate/reallocate the option buffer as needed...
-  */
+static int				/* O - 1 on success, 0 on error */
+make_request_dir(int id)		/* I - Job ID */
+{
+  int	shard = id / CUPSD_JOB_SHARD_SIZE;
+					/* Directory number */
+  char	dirname[32];			/* Directory name */
 
-  if (newlength == 0)			/* This can never happen, but Clang */
-    newlength = 1;			/* thinks it can... */
 
-  if (newlength > optlength || !options)
-  {
-    if (!options)
-      optptr = malloc(newlength);
-    else
-      optptr = realloc(options, newlength);
+  if (shard == spool_shard)
+    return (1);
 
-    if (!optptr)
-    {
-      cupsdLogJob(job, CUPSD_LOG_CRIT,
-		  "Unable to allocate " CUPS_LLFMT " bytes for option buffer.",
-		  CUPS_LLCAST newlength);
-      return (NULL);
-    }
+  snprintf(dirname, sizeof(dirname), "j%03d", shard);
 
-    options   = optptr;
-    optlength = newlength;
+  if (cupsdCheckPermissions(RequestRoot, dirname, 0710, RunUser, Group, 1, -1) < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to create spool directory \"%s/%s\": %s",
+		    RequestRoot, dirname, strerror(errno));
+    return (0);
   }
 
- /*
-  * Now loop through the attributes and convert them to the textual
-  * representation used by the filters...
-  */
+  spool_shard = shard;
 
-  optptr  = options;
-  *optptr = '\0';
+  return (1);
+}
 
-  snprintf(title, title_size, "%s-%d", job->printer->name, job->id);
-  strlcpy(copies, "1", copies_size);
 
-  for (attr = job->attrs->attrs; attr != NULL; attr = attr->next)
-  {
-    if (!strcmp(attr->name, "copies") &&
-	attr->value_tag == IPP_TAG_INTEGER)
-    {
-     /*
-      * Don't use the # copies attribute if we are printing the job sheets...
-      */
+/*
+ * 'migrate_request_root()' - Move job files to match the SpoolLayout.
+ */
 
-      if (!banner_page)
-        snprintf(copies, copies_size, "%d", attr->values[0].integer);
-    }
-    else if (!strcmp(attr->name, "job-name") &&
-	     (attr->value_tag == IPP_TAG_NAME ||
-	      attr->value_tag == IPP_TAG_NAMELANG))
-      strlcpy(title, attr->values[0].string.text, title_size);
-    else if (attr->group_tag == IPP_TAG_JOB)
+static void
+migrate_request_root(void)
+{
+  cups_dir_t	*dir,			/* RequestRoot directory */
+		*subdir;		/* Hashed spool directory */
+  cups_dentry_t	*dent,			/* Directory entry */
+		*subdent;		/* Hashed spool directory entry */
+  char		*ptr,			/* Pointer into filename */
+		dirname[1024],		/* Hashed spool directory name */
+		from[1536],		/* Old filename */
+		to[1536];		/* New filename */
+  int		id,			/* Job ID */
+		moved = 0;		/* Number of files moved */
+
+
+  if ((dir = cupsDirOpen(RequestRoot)) == NULL)
+    return;
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if (SpoolLayout == CUPSD_SPOOL_HASHED)
     {
      /*
-      * Filter out other unwanted attributes...
+      * Move a##### c##### and d#####-### files into their subdirectory...
       */
 
-      if (attr->value_tag == IPP_TAG_NOVALUE ||
-          attr->value_tag == IPP_TAG_MIMETYPE ||
-	  attr->value_tag == IPP_TAG_NAMELANG ||
-	  attr->value_tag == IPP_TAG_TEXTLANG ||
-	  (attr->value_tag == IPP_TAG_URI && strcmp(attr->name, "job-uuid") &&
-	   strcmp(attr->name, "job-authorization-uri")) ||
-	  attr->value_tag == IPP_TAG_URISCHEME ||
-	  attr->value_tag == IPP_TAG_BEGIN_COLLECTION) /* Not yet supported */
-	continue;
-
-      if (!strcmp(attr->name, "job-hold-until") ||
-          !strcmp(attr->name, "job-id") ||
-          !strcmp(attr->name, "job-k-octets") ||
-          !strcmp(attr->name, "job-media-sheets") ||
-          !strcmp(attr->name, "job-media-sheets-completed") ||
-          !strcmp(attr->name, "job-state") ||
-          !strcmp(attr->name, "job-state-reasons"))
-	continue;
+      if (!dent->filename[0] || !strchr("acd", dent->filename[0]) ||
+          !isdigit(dent->filename[1] & 255) || S_ISDIR(dent->fileinfo.st_mode))
+        continue;
 
-      if (!strncmp(attr->name, "job-", 4) &&
-          strcmp(attr->name, "job-account-id") &&
-          strcmp(attr->name, "job-accounting-user-id") &&
-          strcmp(attr->name, "job-authorization-uri") &&
-          strcmp(attr->name, "job-billing") &&
-          strcmp(attr->name, "job-impressions") &&
-          strcmp(attr->name, "job-originating-host-name") &&
-          strcmp(attr->name, "job-password") &&
-          strcmp(attr->name, "job-password-encryption") &&
-          strcmp(attr->name, "job-uuid") &&
-          !(job->printer->type & CUPS_PRINTER_REMOTE))
-	continue;
+      id = (int)strtol(dent->filename + 1, &ptr, 10);
+      if (*ptr && *ptr != '-' && *ptr != '.')
+        continue;
 
-      if ((!strcmp(attr->name, "job-impressions") ||
-           !strcmp(attr->name, "page-label") ||
-           !strcmp(attr->name, "page-border") ||
-           !strncmp(attr->name, "number-up", 9) ||
-	   !strcmp(attr->name, "page-ranges") ||
-	   !strcmp(attr->name, "page-set") ||
-	   !_cups_strcasecmp(attr->name, "AP_FIRSTPAGE_InputSlot") ||
-	   !_cups_strcasecmp(attr->name, "AP_FIRSTPAGE_ManualFeed") ||
-	   !_cups_strcasecmp(attr->name, "com.apple.print.PrintSettings."
-	                           "PMTotalSidesImaged..n.") ||
-	   !_cups_strcasecmp(attr->name, "com.apple.print.PrintSettings."
-	                           "PMTotalBeginPages..n.")) &&
-	  banner_page)
+      if (!make_request_dir(id))
         continue;
 
+      snprintf(from, sizeof(from), "%s/%s", RequestRoot, dent->filename);
+      snprintf(to, sizeof(to), "%s/j%03d/%s", RequestRoot, id / CUPSD_JOB_SHARD_SIZE, dent->filename);
+
+      if (rename(from, to))
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to move \"%s\" to \"%s\": %s", from, to, strerror(errno));
+      else
+        moved ++;
+    }
+    else if (dent->filename[0] == 'j' && isdigit(dent->filename[1] & 255) &&
+             S_ISDIR(dent->fileinfo.st_mode))
+    {
      /*
-      * Otherwise add them to the list...
+      * Move the files in a hashed spool directory back to RequestRoot...
       */
 
-      if (optptr > options)
-	strlcat(optptr, " ", optlength - (size_t)(optptr - options));
+      snprintf(dirname, sizeof(dirname), "%s/%s", RequestRoot, dent->filename);
 
-      if (attr->value_tag != IPP_TAG_BOOLEAN)
-      {
-	strlcat(optptr, attr->name, optlength - (size_t)(optptr - options));
-	strlcat(optptr, "=", optlength - (size_t)(optptr - options));
-      }
+      if ((subdir = cupsDirOpen(dirname)) == NULL)
+        continue;
 
-      for (i = 0; i < attr->num_values; i ++)
+      while ((subdent = cupsDirRead(subdir)) != NULL)
       {
-	if (i)
-	  strlcat(optptr, ",", optlength - (size_t)(optptr - options));
-
-	optptr += strlen(optptr);
+	snprintf(from, sizeof(from), "%s/%s", dirname, subdent->filename);
+	snprintf(to, sizeof(to), "%s/%s", RequestRoot, subdent->filename);
 
-	switch (attr->value_tag)
-	{
-	  case IPP_TAG_INTEGER :
-	  case IPP_TAG_ENUM :
-	      snprintf(optptr, optlength - (size_t)(optptr - options),
-	               "%d", attr->values[i].integer);
-	      break;
+	if (rename(from, to))
+	  cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to move \"%s\" to \"%s\": %s", from, to, strerror(errno));
+	else
+	  moved ++;
+      }
 
-	  case IPP_TAG_BOOLEAN :
-	      if (!attr->values[i].boolean)
-		strlcat(optptr, "no", optlength - (size_t)(optptr - options));
+      cupsDirClose(subdir);
 
-	      strlcat(optptr, attr->name, optlength - (size_t)(optptr - options));
-	      break;
+      if (rmdir(dirname))
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to remove \"%s\": %s", dirname, strerror(errno));
+    }
+  }
 
-	  case IPP_TAG_RANGE :
-	      if (attr->values[i].range.lower == attr->values[i].range.upper)
-		snprintf(optptr, optlength - (size_t)(optptr - options) - 1,
-	        	 "%d", attr->values[i].range.lower);
-              else
-		snprintf(optptr, optlength - (size_t)(optptr - options) - 1,
-	        	 "%d-%d", attr->values[i].range.lower,
-			 attr->values[i].range.upper);
-	      break;
+  cupsDirClose(dir);
 
-	  case IPP_TAG_RESOLUTION :
-	      snprintf(optptr, optlength - (size_t)(optptr - options) - 1,
-	               "%dx%d%s", attr->values[i].resolution.xres,
-		       attr->values[i].resolution.yres,
-		       attr->values[i].resolution.units == IPP_RES_PER_INCH ?
-			   "dpi" : "dpcm");
-	      break;
+  if (moved)
+    cupsdLogMessage(CUPSD_LOG_INFO, "Moved %d job files to the %s spool layout.", moved, SpoolLayout == CUPSD_SPOOL_HASHED ? "hashed" : "flat");
+}
 
-          case IPP_TAG_STRING :
-              {
-                int length = attr->values[i].unknown.length;
 
-		for (valptr = attr->values[i].unknown.data; length > 0; length --)
-		{
-		  if ((*valptr & 255) < 0x20 || *valptr == 0x7f)
-		    break;
-		}
+/*
+ * 'prerender_jobs()' - Pre-render the next pending jobs of busy printers.
+ *
+ * At most one job per printer and one job per CPU are pre-rendered at a
+ * time, only with filter capacity that isn't needed for printing, and only
+ * while the output fits in PrerenderLimit.
+ */
 
-		if (length > 0)
-		{
-		 /*
-		  * Encode this string as hex characters...
-		  */
+static void
+prerender_jobs(void)
+{
+  int			count,		/* Number of jobs checked */
+			running;	/* Number of jobs being pre-rendered */
+  cupsd_jobq_t		*queue;		/* Pending job queue */
+  cupsd_printer_t	*printer;	/* Queue destination */
+  cupsd_job_t		*job;		/* Current job */
+  _cups_array_iter_t	iter;		/* Pending job iterator */
+  static long		ncpus = 0;	/* Number of CPUs */
 
-                  *optptr++ = '<';
 
-		  for (valptr = attr->values[i].unknown.data, length = attr->values[i].unknown.length; length > 0; length --)
-		  {
-		    snprintf(optptr, optlength - (size_t)(optptr - options) - 1, "%02X", *valptr & 255);
-		    optptr += 2;
-		  }
+  if (PrerenderLimit > 0 && prerender_total >= PrerenderLimit)
+    return;
 
-                  *optptr++ = '>';
-		}
-		else
-		{
-		  for (valptr = attr->values[i].unknown.data, length = attr->values[i].unknown.length; length > 0; length --)
-		  {
-		    if (strchr(" \t\n\\\'\"", *valptr))
-		      *optptr++ = '\\';
-		    *optptr++ = *valptr++;
-		  }
-		}
-	      }
+  if (!ncpus && (ncpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    ncpus = 1;
 
-	      *optptr = '\0';
-	      break;
+  for (job = (cupsd_job_t *)cupsArrayFirst(PrintingJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
+    if (job->pending_cost > 0)
+      return;
 
-	  case IPP_TAG_TEXT :
-	  case IPP_TAG_NAME :
-	  case IPP_TAG_KEYWORD :
-	  case IPP_TAG_CHARSET :
-	  case IPP_TAG_LANGUAGE :
-	  case IPP_TAG_URI :
-	      for (valptr = attr->values[i].string.text; *valptr;)
-	      {
-	        if (strchr(" \t\n\\\'\"", *valptr))
-		  *optptr++ = '\\';
-		*optptr++ = *valptr++;
-	      }
+  for (running = 0, job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+    if (job->prerender == CUPSD_PRERENDER_RUNNING)
+      running ++;
 
-	      *optptr = '\0';
-	      break;
+  for (queue = (cupsd_jobq_t *)cupsArrayFirst(ReadyQueues);
+       queue && running < ncpus;
+       queue = (cupsd_jobq_t *)cupsArrayNext(ReadyQueues))
+  {
+    if ((printer = cupsdFindDest(queue->dest)) == NULL || !printer->job ||
+        (printer->type & CUPS_PRINTER_CLASS) || printer->raw ||
+	printer->remote)
+      continue;
 
-          default :
-	      break; /* anti-compiler-warning-code */
-	}
+    for (count = 0, job = (cupsd_job_t *)_cupsArrayIterFirst(&iter, queue->jobs);
+         job && count < PrerenderJobs;
+	 count ++, job = (cupsd_job_t *)_cupsArrayIterNext(&iter))
+    {
+      if (job->prerender == CUPSD_PRERENDER_RUNNING)
+        break;
+      else if (job->prerender != CUPSD_PRERENDER_NONE)
+        continue;
+
+      if (!cupsdLoadJob(job))
+        continue;
+
+      if (!can_prerender(job))
+      {
+        job->prerender = CUPSD_PRERENDER_SKIP;
+	continue;
       }
 
-      optptr += strlen(optptr);
+      if (RenderCacheLimit > 0 && find_render_cache(job, printer))
+        continue;
+
+      start_prerender(job, printer);
+
+      if (job->prerender == CUPSD_PRERENDER_RUNNING)
+        running ++;
+      break;
     }
   }
+}
 
- /*
-  * Finally loop through the PWG->PPD mapped options and add them...
-  */
 
-  for (i = num_pwgppds, pwgppd = pwgppds; i > 0; i --, pwgppd ++)
-  {
-    *optptr++ = ' ';
-    strlcpy(optptr, pwgppd->name, optlength - (size_t)(optptr - options));
-    optptr += strlen(optptr);
-    *optptr++ = '=';
-    strlcpy(optptr, pwgppd->value, optlength - (size_t)(optptr - options));
-    optptr += strlen(optptr);
-  }
+/*
+ * 'purge_file()' - Remove a job file in the background.
+ *
+ * The file is first moved to the "purge" subdirectory of RequestRoot so it
+ * is gone from the spool right away, even if cupsd stops before the purge
+ * thread gets to it.
+ */
 
-  cupsFreeOptions(num_pwgppds, pwgppds);
+static void
+purge_file(const char *filename)	/* I - File to remove */
+{
+  char	purgefile[1024];		/* Filename in purge directory */
 
- /*
-  * Return the options string...
-  */
 
-  return (options);
+  snprintf(purgefile, sizeof(purgefile), "%s/purge/%08x-%d", RequestRoot, (unsigned)time(NULL), ++ purge_serial);
+
+  if (rename(filename, purgefile))
+  {
+    if (errno != ENOENT)
+      cupsdUnlinkOrRemoveFile(filename);
+    return;
+  }
+
+  cupsdPurgeFile(purgefile);
 }
 
 
 /*
- * 'ipp_length()' - Compute the size of the buffer needed to hold
- *		    the textual IPP attributes.
+ * 'queue_compression()' - Queue the documents of a completed job for
+ *                         compression.
  */
 
-static size_t				/* O - Size of attribute buffer */
-ipp_length(ipp_t *ipp)			/* I - IPP request */
+static void
+queue_compression(cupsd_job_t *job)	/* I - Job */
 {
-  size_t		bytes; 		/* Number of bytes */
   int			i;		/* Looping var */
-  ipp_attribute_t	*attr;		/* Current attribute */
-
+  cupsd_compress_t	*c;		/* Compression request */
+  _cups_thread_t	thread;		/* Compression thread */
+  static int		serial = 0;	/* Temporary file serial number */
 
- /*
-  * Loop through all attributes...
-  */
 
-  bytes = 0;
+  if (!CompressJobFiles || job->num_files <= 0 || !job->compressions)
+    return;
 
-  for (attr = ipp->attrs; attr != NULL; attr = attr->next)
+  if (compress_pipe[0] < 0)
   {
    /*
-    * Skip attributes that won't be sent to filters...
+    * Start the compression thread...
     */
 
-    if (attr->value_tag == IPP_TAG_NOVALUE ||
-	attr->value_tag == IPP_TAG_MIMETYPE ||
-	attr->value_tag == IPP_TAG_NAMELANG ||
-	attr->value_tag == IPP_TAG_TEXTLANG ||
-	attr->value_tag == IPP_TAG_URI ||
-	attr->value_tag == IPP_TAG_URISCHEME)
-      continue;
+    if (cupsdOpenPipe(compress_pipe))
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create pipe for document compression: %s", strerror(errno));
+      return;
+    }
 
-   /*
-    * Add space for a leading space and commas between each value.
-    * For the first attribute, the leading space isn't used, so the
-    * extra byte can be used as the nul terminator...
-    */
+    compress_queue = cupsArrayNew(NULL, NULL);
+    compress_done  = cupsArrayNew(NULL, NULL);
 
-    bytes ++;				/* " " separator */
-    bytes += (size_t)attr->num_values;	/* "," separators */
+    if ((thread = _cupsThreadCreate((_cups_thread_func_t)compress_documents, NULL)) == 0)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to start document compression thread: %s", strerror(errno));
+      cupsdClosePipe(compress_pipe);
+      return;
+    }
 
-   /*
-    * Boolean attributes appear as "foo,nofoo,foo,nofoo", while
-    * other attributes appear as "foo=value1,value2,...,valueN".
-    */
+    _cupsThreadDetach(thread);
 
-    if (attr->value_tag != IPP_TAG_BOOLEAN)
-      bytes += strlen(attr->name);
-    else
-      bytes += (size_t)attr->num_values * strlen(attr->name);
+    cupsdAddSelect(compress_pipe[0], (cupsd_selfunc_t)finish_compression, NULL, NULL);
+  }
 
-   /*
-    * Now add the size required for each value in the attribute...
-    */
+  _cupsMutexLock(&compress_mutex);
 
-    switch (attr->value_tag)
-    {
-      case IPP_TAG_INTEGER :
-      case IPP_TAG_ENUM :
-         /*
-	  * Minimum value of a signed integer is -2147483647, or 11 digits.
-	  */
+  for (i = 0; i < job->num_files; i ++)
+  {
+    if (job->compressions[i])
+      continue;
 
-	  bytes += (size_t)attr->num_values * 11;
-	  break;
+    if ((c = calloc(1, sizeof(cupsd_compress_t))) == NULL)
+      break;
 
-      case IPP_TAG_BOOLEAN :
-         /*
-	  * Add two bytes for each false ("no") value...
-	  */
+    c->id     = job->id;
+    c->number = i + 1;
 
-          for (i = 0; i < attr->num_values; i ++)
-	    if (!attr->values[i].boolean)
-	      bytes += 2;
-	  break;
+    cupsdGetJobFilename(job->id, 'd', i + 1, c->filename, sizeof(c->filename));
+    snprintf(c->tempfile, sizeof(c->tempfile), "%s.%d.gz", c->filename, ++ serial);
 
-      case IPP_TAG_RANGE :
-         /*
-	  * A range is two signed integers separated by a hyphen, or
-	  * 23 characters max.
-	  */
+    cupsArrayAdd(compress_queue, c);
+  }
 
-	  bytes += (size_t)attr->num_values * 23;
-	  break;
+  _cupsCondBroadcast(&compress_cond);
+  _cupsMutexUnlock(&compress_mutex);
+}
 
-      case IPP_TAG_RESOLUTION :
-         /*
-	  * A resolution is two signed integers separated by an "x" and
-	  * suffixed by the units, or 26 characters max.
-	  */
 
-	  bytes += (size_t)attr->num_values * 26;
-	  break;
+/*
+ * 'read_job_attrs()' - Read the attributes from a job control file.
+ *
+ * Uncompressed control files are mapped into memory and ippReadIO() copies
+ * each value straight out of the mapping.  This avoids the read() calls and
+ * the copy through the cupsFile buffer when a large job history is loaded.
+ */
 
-      case IPP_TAG_STRING :
-         /*
-	  * Octet strings can contain characters that need quoting.  We need
-	  * at least 2 * len + 2 characters to cover the quotes and any
-	  * backslashes in the string.
-	  */
+static int				/* O - 1 on success, 0 on error */
+read_job_attrs(ipp_t       *attrs,	/* I - Job attributes */
+               cups_file_t *fp)		/* I - Control file */
+{
+  int			fd;		/* File descriptor */
+  struct stat		fileinfo;	/* File information */
+  void			*data;		/* Mapped file data */
+  cupsd_jobmap_t	map;		/* Mapping read position */
+  ipp_state_t		state;		/* IPP read state */
 
-          for (i = 0; i < attr->num_values; i ++)
-	    bytes += 2 * (size_t)attr->values[i].unknown.length + 2;
-	  break;
 
-      case IPP_TAG_TEXT :
-      case IPP_TAG_NAME :
-      case IPP_TAG_KEYWORD :
-      case IPP_TAG_CHARSET :
-      case IPP_TAG_LANGUAGE :
-      case IPP_TAG_URI :
-         /*
-	  * Strings can contain characters that need quoting.  We need
-	  * at least 2 * len + 2 characters to cover the quotes and
-	  * any backslashes in the string.
-	  */
+  fd = cupsFileNumber(fp);
 
-          for (i = 0; i < attr->num_values; i ++)
-	    bytes += 2 * strlen(attr->values[i].string.text) + 2;
-	  break;
+ /*
+  * Use larger buffers for files that can't be mapped, since they are read
+  * in one pass...
+  */
 
-       default :
-	  break; /* anti-compiler-warning-code */
-    }
+  cupsFileSetBufferSize(fp, 65536);
+
+  if (fstat(fd, &fileinfo) || !S_ISREG(fileinfo.st_mode) ||
+      fileinfo.st_size < 2 ||
+      (data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd,
+                   0)) == MAP_FAILED)
+    return (ippReadIO(fp, (ipp_iocb_t)cupsFileRead, 1, NULL,
+                      attrs) == IPP_DATA);
+
+  map.ptr = (const ipp_uchar_t *)data;
+  map.end = map.ptr + fileinfo.st_size;
+
+  if (map.ptr[0] == 0x1f && map.ptr[1] == 0x8b)
+  {
+   /*
+    * Compressed control file, let cupsFileRead decompress it...
+    */
+
+    munmap(data, (size_t)fileinfo.st_size);
+
+    return (ippReadIO(fp, (ipp_iocb_t)cupsFileRead, 1, NULL,
+                      attrs) == IPP_DATA);
   }
 
-  return (bytes);
+  state = ippReadIO(&map, (ipp_iocb_t)read_mapped_attrs, 1, NULL, attrs);
+
+  munmap(data, (size_t)fileinfo.st_size);
+
+  return (state == IPP_DATA);
 }
 
 
 /*
- * 'load_job_cache()' - Load jobs from the job.cache file.
+ * 'read_job_cache()' - Read job summaries from a job.cache or job.journal file.
+ *
+ * Records for jobs that have already been read replace the previous summary.
  */
 
 static void
-load_job_cache(const char *filename)	/* I - job.cache filename */
+read_job_cache(cups_file_t *fp,		/* I - File to read */
+               const char  *filename,	/* I - Filename */
+	       int         journal)	/* I - 1 for job.journal, 0 for job.cache */
 {
-  cups_file_t	*fp;			/* job.cache file */
   char		line[1024],		/* Line buffer */
 		*value;			/* Value on line */
   int		linenum;		/* Line number in file */
@@ -4266,23 +7602,6 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
   char		jobfile[1024];		/* Job filename */
 
 
- /*
-  * Open the job.cache file...
-  */
-
-  if ((fp = cupsdOpenConfFile(filename)) == NULL)
-  {
-    load_request_root();
-    return;
-  }
-
- /*
-  * Read entries from the job cache file and create jobs as needed.
-  */
-
-  cupsdLogMessage(CUPSD_LOG_INFO, "Loading job cache file \"%s\"...",
-                  filename);
-
   linenum = 0;
   job     = NULL;
 
@@ -4293,6 +7612,13 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
       if (value)
         NextJobId = atoi(value);
     }
+    else if (!_cups_strcasecmp(line, "Delete") && !job)
+    {
+      cupsd_job_t	*deljob;	/* Deleted job */
+
+      if (value && (deljob = cupsdFindJob(atoi(value))) != NULL)
+        cupsdDeleteJob(deljob, CUPSD_JOB_DEFAULT);
+    }
     else if (!_cups_strcasecmp(line, "<Job"))
     {
       if (job)
@@ -4315,27 +7641,26 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
         continue;
       }
 
-      snprintf(jobfile, sizeof(jobfile), "%s/c%05d", RequestRoot, jobid);
-      if (access(jobfile, 0))
+      if ((job = cupsdFindJob(jobid)) != NULL)
       {
-	snprintf(jobfile, sizeof(jobfile), "%s/c%05d.N", RequestRoot, jobid);
-	if (access(jobfile, 0))
-	{
-	  cupsdLogMessage(CUPSD_LOG_ERROR, "[Job %d] Files have gone away.",
-			  jobid);
+       /*
+        * Replace the previous summary...
+	*/
 
-         /*
-          * job.cache file is out-of-date compared to spool directory; load
-          * that instead...
-          */
+        free(job->filetypes);
+	free(job->compressions);
 
-	  cupsFileClose(fp);
-          load_request_root();
-          return;
-	}
+        job->num_files      = 0;
+	job->filetypes      = NULL;
+	job->compressions   = NULL;
+	job->completed_time = 0;
+	job->hold_until     = 0;
+
+	cupsdLogJob(job, CUPSD_LOG_DEBUG, "Updating from journal...");
+	continue;
       }
 
-      job = calloc(1, sizeof(cupsd_job_t));
+      job = cupsdSlabAlloc(CUPSD_SLAB_JOB);
       if (!job)
       {
         cupsdLogMessage(CUPSD_LOG_EMERG,
@@ -4353,6 +7678,8 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
       job->status_pipes[0] = -1;
       job->status_pipes[1] = -1;
 
+      cupsArrayAdd(Jobs, job);
+
       cupsdLogJob(job, CUPSD_LOG_DEBUG, "Loading from cache...");
     }
     else if (!job)
@@ -4363,19 +7690,6 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
     }
     else if (!_cups_strcasecmp(line, "</Job>"))
     {
-      cupsArrayAdd(Jobs, job);
-
-      if (job->state_value <= IPP_JOB_STOPPED && cupsdLoadJob(job))
-	cupsArrayAdd(ActiveJobs, job);
-      else if (job->state_value > IPP_JOB_STOPPED)
-      {
-        if (!job->completed_time || !job->creation_time || !job->name || !job->koctets)
-	{
-	  cupsdLoadJob(job);
-	  unload_job(job);
-	}
-      }
-
       job = NULL;
     }
     else if (!value)
@@ -4441,8 +7755,7 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
 
       if (job->num_files > 0)
       {
-        snprintf(jobfile, sizeof(jobfile), "%s/d%05d-001", RequestRoot,
-	         job->id);
+        cupsdGetJobFilename(job->id, 'd', 1, jobfile, sizeof(jobfile));
         if (access(jobfile, 0))
 	{
 	  cupsdLogJob(job, CUPSD_LOG_INFO, "Data files have gone away.");
@@ -4498,8 +7811,7 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
 		    "Unknown MIME type %s/%s for file %d.",
 		    super, type, number + 1);
 
-        snprintf(jobfile, sizeof(jobfile), "%s/d%05d-%03d", RequestRoot,
-	         job->id, number + 1);
+        cupsdGetJobFilename(job->id, 'd', number + 1, jobfile, sizeof(jobfile));
         job->filetypes[number] = mimeFileType(MimeDatabase, jobfile, NULL,
 	                                      job->compressions + number);
 
@@ -4520,149 +7832,70 @@ load_job_cache(const char *filename)	/* I - job.cache filename */
   {
     cupsdLogMessage(CUPSD_LOG_ERROR,
 		    "Missing </Job> directive on line %d of %s.", linenum, filename);
-    cupsdDeleteJob(job, CUPSD_JOB_PURGE);
-  }
 
-  cupsFileClose(fp);
+   /*
+    * A partial journal record is what we get if cupsd stopped while appending
+    * to it; the control file still has the details, so keep the job...
+    */
+
+    if (!journal)
+      cupsdDeleteJob(job, CUPSD_JOB_PURGE);
+  }
 }
 
 
 /*
- * 'load_next_job_id()' - Load the NextJobId value from the job.cache file.
+ * 'read_mapped_attrs()' - Copy bytes from a mapped control file for ippReadIO.
  */
 
-static void
-load_next_job_id(const char *filename)	/* I - job.cache filename */
+static ssize_t				/* O - Number of bytes copied */
+read_mapped_attrs(
+    cupsd_jobmap_t *map,		/* I - Mapping read position */
+    ipp_uchar_t    *buffer,		/* I - Buffer */
+    size_t         bytes)		/* I - Number of bytes to copy */
 {
-  cups_file_t	*fp;			/* job.cache file */
-  char		line[1024],		/* Line buffer */
-		*value;			/* Value on line */
-  int		linenum;		/* Line number in file */
-  int		next_job_id;		/* NextJobId value from line */
-
-
- /*
-  * Read the NextJobId directive from the job.cache file and use
-  * the value (if any).
-  */
-
-  if ((fp = cupsFileOpen(filename, "r")) == NULL)
-  {
-    if (errno != ENOENT)
-      cupsdLogMessage(CUPSD_LOG_ERROR,
-                      "Unable to open job cache file \"%s\": %s",
-                      filename, strerror(errno));
-
-    return;
-  }
-
-  cupsdLogMessage(CUPSD_LOG_INFO,
-                  "Loading NextJobId from job cache file \"%s\"...", filename);
-
-  linenum = 0;
-
-  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
-  {
-    if (!_cups_strcasecmp(line, "NextJobId"))
-    {
-      if (value)
-      {
-        next_job_id = atoi(value);
+  if (bytes > (size_t)(map->end - map->ptr))
+    bytes = (size_t)(map->end - map->ptr);
 
-        if (next_job_id > NextJobId)
-	  NextJobId = next_job_id;
-      }
-      break;
-    }
-  }
+  memcpy(buffer, map->ptr, bytes);
+  map->ptr += bytes;
 
-  cupsFileClose(fp);
+  return ((ssize_t)bytes);
 }
 
 
 /*
- * 'load_request_root()' - Load jobs from the RequestRoot directory.
+ * 'release_document()' - Release a shared document after a link is removed.
  */
 
 static void
-load_request_root(void)
+release_document(
+    struct stat *fileinfo)		/* I - Information for removed link */
 {
-  cups_dir_t		*dir;		/* Directory */
-  cups_dentry_t		*dent;		/* Directory entry */
-  cupsd_job_t		*job;		/* New job */
+  cupsd_docref_t	key,		/* Search key */
+			*doc;		/* Shared document */
+  struct stat		docinfo;	/* Store file information */
 
 
- /*
-  * Open the requests directory...
-  */
+  key.dev = fileinfo->st_dev;
+  key.ino = fileinfo->st_ino;
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG, "Scanning %s for jobs...", RequestRoot);
+  if (!load_doc_store() || (doc = (cupsd_docref_t *)cupsArrayFind(doc_inodes, &key)) == NULL)
+    return;
 
-  if ((dir = cupsDirOpen(RequestRoot)) == NULL)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR,
-                    "Unable to open spool directory \"%s\": %s",
-                    RequestRoot, strerror(errno));
+  if (!stat(doc->filename, &docinfo) && docinfo.st_nlink > 1)
     return;
-  }
 
  /*
-  * Read all the c##### files...
+  * Nothing uses the store file anymore...
   */
 
-  while ((dent = cupsDirRead(dir)) != NULL)
-    if (strlen(dent->filename) >= 6 && dent->filename[0] == 'c')
-    {
-     /*
-      * Allocate memory for the job...
-      */
-
-      if ((job = calloc(sizeof(cupsd_job_t), 1)) == NULL)
-      {
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Ran out of memory for jobs.");
-	cupsDirClose(dir);
-	return;
-      }
-
-     /*
-      * Assign the job ID...
-      */
-
-      job->id              = atoi(dent->filename + 1);
-      job->back_pipes[0]   = -1;
-      job->back_pipes[1]   = -1;
-      job->print_pipes[0]  = -1;
-      job->print_pipes[1]  = -1;
-      job->side_pipes[0]   = -1;
-      job->side_pipes[1]   = -1;
-      job->status_pipes[0] = -1;
-      job->status_pipes[1] = -1;
-
-      if (job->id >= NextJobId)
-        NextJobId = job->id + 1;
-
-     /*
-      * Load the job...
-      */
-
-      if (cupsdLoadJob(job))
-      {
-       /*
-        * Insert the job into the array, sorting by job priority and ID...
-        */
-
-	cupsArrayAdd(Jobs, job);
+  purge_file(doc->filename);
 
-	if (job->state_value <= IPP_JOB_STOPPED)
-	  cupsArrayAdd(ActiveJobs, job);
-	else
-	  unload_job(job);
-      }
-      else
-        free(job);
-    }
+  cupsArrayRemove(doc_hashes, doc);
+  cupsArrayRemove(doc_inodes, doc);
 
-  cupsDirClose(dir);
+  free(doc);
 }
 
 
@@ -4673,8 +7906,9 @@ load_request_root(void)
 static void
 remove_job_files(cupsd_job_t *job)	/* I - Job */
 {
-  int	i;				/* Looping var */
-  char	filename[1024];			/* Document filename */
+  int		i;			/* Looping var */
+  char		filename[1024];		/* Document filename */
+  struct stat	fileinfo;		/* Document information */
 
 
   if (job->num_files <= 0)
@@ -4682,9 +7916,19 @@ remove_job_files(cupsd_job_t *job)	/* I - Job */
 
   for (i = 1; i <= job->num_files; i ++)
   {
-    snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
-	     job->id, i);
-    cupsdUnlinkOrRemoveFile(filename);
+    cupsdGetJobFilename(job->id, 'd', i, filename, sizeof(filename));
+
+    if (!stat(filename, &fileinfo) && fileinfo.st_nlink > 1)
+    {
+     /*
+      * Shared documents are only removed securely with the last link...
+      */
+
+      unlink(filename);
+      release_document(&fileinfo);
+    }
+    else
+      purge_file(filename);
   }
 
   free(job->filetypes);
@@ -4694,6 +7938,7 @@ remove_job_files(cupsd_job_t *job)	/* I - Job */
   job->num_files    = 0;
   job->filetypes    = NULL;
   job->compressions = NULL;
+  job->journal      = 1;
 
   LastEvent |= CUPSD_EVENT_PRINTER_STATE_CHANGED;
 }
@@ -4713,14 +7958,107 @@ remove_job_history(cupsd_job_t *job)	/* I - Job */
   * Remove the job info file...
   */
 
-  snprintf(filename, sizeof(filename), "%s/c%05d", RequestRoot,
-	   job->id);
-  cupsdUnlinkOrRemoveFile(filename);
+  cupsdGetJobFilename(job->id, 'c', 0, filename, sizeof(filename));
+  purge_file(filename);
 
   LastEvent |= CUPSD_EVENT_PRINTER_STATE_CHANGED;
 }
 
 
+/*
+ * 'same_contents()' - Compare the contents of two files.
+ */
+
+static int				/* O - 1 if the same, 0 otherwise */
+same_contents(const char *a,		/* I - First file */
+              const char *b)		/* I - Second file */
+{
+  int		afd,			/* First file */
+		bfd;			/* Second file */
+  char		abuffer[32768],		/* First file data */
+		bbuffer[32768];		/* Second file data */
+  ssize_t	abytes,			/* Bytes read from first file */
+		bbytes;			/* Bytes read from second file */
+  int		same = 0;		/* Same contents? */
+
+
+  if ((afd = open(a, O_RDONLY)) < 0)
+    return (0);
+
+  if ((bfd = open(b, O_RDONLY)) < 0)
+  {
+    close(afd);
+    return (0);
+  }
+
+  while ((abytes = read(afd, abuffer, sizeof(abuffer))) >= 0)
+  {
+    if ((bbytes = read(bfd, bbuffer, (size_t)abytes)) != abytes)
+      break;
+
+    if (abytes == 0)
+    {
+      same = read(bfd, bbuffer, 1) == 0;
+      break;
+    }
+
+    if (memcmp(abuffer, bbuffer, (size_t)abytes))
+      break;
+  }
+
+  close(afd);
+  close(bfd);
+
+  return (same);
+}
+
+
+/*
+ * 'send_prerender_log()' - Send the messages of the pre-rendering filters
+ *                          to the job status pipe.
+ *
+ * Debug messages are skipped, and the rest is limited to what the pipe can
+ * hold without blocking.
+ */
+
+static void
+send_prerender_log(cupsd_job_t *job)	/* I - Job */
+{
+  cups_file_t	*fp;			/* Log file */
+  char		filename[1024],		/* Log filename */
+		line[2048];		/* Line from log */
+  size_t	length,			/* Length of line */
+		total = 0;		/* Total bytes sent */
+  int		flags;			/* Pipe flags */
+
+
+  if ((fp = cupsFileOpen(get_render_filename(job, ".log", filename, sizeof(filename)), "r")) == NULL)
+    return;
+
+  flags = fcntl(job->status_pipes[1], F_GETFL);
+  fcntl(job->status_pipes[1], F_SETFL, flags | O_NONBLOCK);
+
+  while (cupsFileGets(fp, line, sizeof(line) - 1))
+  {
+    if (!strncmp(line, "DEBUG", 5))
+      continue;
+
+    length = strlen(line);
+    line[length ++] = '\n';
+
+    if ((total + length) > 16384 ||
+        write(job->status_pipes[1], line, length) < (ssize_t)length)
+      break;
+
+    total += length;
+  }
+
+  fcntl(job->status_pipes[1], F_SETFL, flags);
+
+  cupsFileClose(fp);
+}
+
+
 /*
  * 'set_time()' - Set one of the "time-at-xyz" attributes.
  */
@@ -4778,6 +8116,22 @@ set_time(cupsd_job_t *job,		/* I - Job to update */
 }
 
 
+/*
+ * 'slice_expired()' - Check whether a main loop time slice has run out.
+ */
+
+static int				/* O - 1 if expired, 0 otherwise */
+slice_expired(struct timeval *start)	/* I - Start of time slice */
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  return ((curtime.tv_sec - start->tv_sec) * 1000000 + (curtime.tv_usec - start->tv_usec) >= CUPSD_JOB_SLICE_USECS);
+}
+
+
 /*
  * 'start_job()' - Start a print job.
  */
@@ -4796,6 +8150,16 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "start_job(job=%p(%d), printer=%p(%s))",
                   job, job->id, printer, printer->name);
 
+  CUPSD_PROBE2(job__start, job->id, printer->name);
+
+ /*
+  * Output that is still being pre-rendered is thrown away; the job is
+  * filtered again as it prints...
+  */
+
+  if (job->prerender == CUPSD_PRERENDER_RUNNING)
+    cupsdDiscardPrerender(job);
+
  /*
   * Make sure we have some files around before we try to print...
   */
@@ -4848,6 +8212,8 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
   else
     job->cancel_time = 0;
 
+  cupsdUpdateJobQueues(job);
+
  /*
   * Check for support files...
   */
@@ -4983,6 +8349,83 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
 }
 
 
+/*
+ * 'start_job_loads()' - Start reading control files using multiple threads.
+ *
+ * The attributes are attached by cupsdLoadJob(), which must be called for each
+ * job in order before calling finish_job_loads().
+ */
+
+static void
+start_job_loads(cups_array_t *jobs)	/* I - Jobs to load */
+{
+  int		i;			/* Looping var */
+  cupsd_job_t	*job;			/* Current job */
+
+
+  if (cupsArrayCount(jobs) < 2 ||
+      (job_loads = calloc((size_t)cupsArrayCount(jobs), sizeof(cupsd_jobload_t))) == NULL)
+    return;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(jobs), job_loads_count = 0;
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(jobs), job_loads_count ++)
+    job_loads[job_loads_count].job = job;
+
+  job_loads_next = 0;
+  job_loads_used = 0;
+
+ /*
+  * Use up to one thread per CPU...
+  */
+
+  if ((job_loads_num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    job_loads_num_threads = 1;
+  else if (job_loads_num_threads > CUPSD_JOBLOAD_THREADS)
+    job_loads_num_threads = CUPSD_JOBLOAD_THREADS;
+
+  if (job_loads_num_threads > job_loads_count)
+    job_loads_num_threads = job_loads_count;
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Loading %d job control files using %d thread(s)...", job_loads_count, job_loads_num_threads);
+
+  for (i = 0; i < job_loads_num_threads; i ++)
+    if ((job_loads_threads[i] = _cupsThreadCreate((_cups_thread_func_t)load_job_thread, NULL)) == 0)
+      break;
+
+  if ((job_loads_num_threads = i) == 0)
+  {
+   /*
+    * No threads, let cupsdLoadJob() read the control files...
+    */
+
+    free(job_loads);
+
+    job_loads       = NULL;
+    job_loads_count = 0;
+  }
+}
+
+
+/*
+ * 'start_prerender()' - Start rendering a job's output to a file.
+ */
+
+static void
+start_prerender(cupsd_job_t     *job,	/* I - Job */
+                cupsd_printer_t *printer)/* I - Printer */
+{
+  job->current_file = 0;
+  job->status       = 0;
+  job->prerender    = CUPSD_PRERENDER_RUNNING;
+  job->printer      = printer;
+
+  cupsdContinueJob(job);
+
+  job->printer = NULL;
+}
+
+
 /*
  * 'stop_job()' - Stop a print job.
  */
@@ -5005,6 +8448,8 @@ stop_job(cupsd_job_t       *job,	/* I - Job */
   else if (action >= CUPSD_JOB_FORCE)
     job->kill_time = 0;
 
+  cupsdUpdateJobQueues(job);
+
   for (i = 0; job->filters[i]; i ++)
     if (job->filters[i] > 0)
     {
@@ -5070,7 +8515,12 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 					/* Message text */
 		*ptr;			/* Pointer update... */
   int		loglevel,		/* Log level for message */
-		event = 0;		/* Events? */
+		event = 0,		/* Events? */
+		page_event = 0,		/* Pages printed? */
+		progress_event = 0,	/* Media progress changed? */
+		update_attrs = 0,	/* Update job-printer-state-* */
+		reads = 0;		/* Number of reads from pipe */
+  struct pollfd	pfd;			/* Status pipe poll data */
   cupsd_printer_t *printer = job->printer;
 					/* Printer */
   static const char * const levels[] =	/* Log levels */
@@ -5157,7 +8607,7 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 	else
           ippSetInteger(job->attrs, &job->sheets, 0, impressions);
 
-	cupsdAddEvent(CUPSD_EVENT_JOB_PROGRESS, job->printer, job, "Printed %d page(s).", ippGetInteger(job->sheets, 0));
+	page_event = 1;
       }
 
       job->dirty = 1;
@@ -5199,11 +8649,7 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
           * Reset cancel time after connecting to the device...
           */
 
-          for (i = 0; i < job->printer->num_reasons; i ++)
-            if (!strcmp(job->printer->reasons[i], "connecting-to-device"))
-              break;
-
-          if (i >= job->printer->num_reasons)
+          if (!cupsdPrinterHasReason(job->printer, "connecting-to-device"))
           {
 	    ipp_attribute_t *cancel_after = ippFindAttribute(job->attrs,
 							     "job-cancel-after",
@@ -5216,11 +8662,13 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 	      job->cancel_time = time(NULL) + MaxJobTime;
 	    else
 	      job->cancel_time = 0;
+
+	    cupsdUpdateJobQueues(job);
 	  }
         }
       }
 
-      update_job_attrs(job, 0);
+      update_attrs = 1;
     }
     else if (loglevel == CUPSD_LOG_ATTR)
     {
@@ -5228,121 +8676,123 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
       * Set attribute(s)...
       */
 
-      int		num_attrs;	/* Number of attributes */
-      cups_option_t	*attrs;		/* Attributes */
+      cups_options_t	*attrs;		/* Attributes */
       const char	*attr;		/* Attribute */
 
       cupsdLogJob(job, CUPSD_LOG_DEBUG, "ATTR: %s", message);
 
-      num_attrs = cupsParseOptions(message, 0, &attrs);
+      attrs = cupsOptionsNew();
+      cupsOptionsParse(attrs, message);
 
-      if ((attr = cupsGetOption("auth-info-default", num_attrs,
-                                attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "auth-info-default")) != NULL)
       {
         job->printer->num_options = cupsAddOption("auth-info", attr,
 						  job->printer->num_options,
 						  &(job->printer->options));
 	cupsdSetPrinterAttrs(job->printer);
 
-	cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+	cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("auth-info-required", num_attrs,
-                                attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "auth-info-required")) != NULL)
       {
         cupsdSetAuthInfoRequired(job->printer, attr, NULL);
 	cupsdSetPrinterAttrs(job->printer);
 
-	cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+	cupsdMarkPrinterDirty(job->printer);
+      }
+
+      if ((attr = cupsOptionsGet(attrs, "job-k-octets-processed")) != NULL && job->attrs)
+      {
+        ipp_attribute_t	*koctets;	/* job-k-octets-processed */
+
+        if ((koctets = ippFindAttribute(job->attrs, "job-k-octets-processed", IPP_TAG_INTEGER)) != NULL)
+	  ippSetInteger(job->attrs, &koctets, 0, atoi(attr));
+	else
+	  ippAddInteger(job->attrs, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-k-octets-processed", atoi(attr));
       }
 
-      if ((attr = cupsGetOption("job-media-progress", num_attrs,
-                                attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "job-media-progress")) != NULL)
       {
         int progress = atoi(attr);
 
 
         if (progress >= 0 && progress <= 100)
 	{
-	  job->progress = progress;
-
-	  if (job->sheets)
-	    cupsdAddEvent(CUPSD_EVENT_JOB_PROGRESS, job->printer, job,
-			  "Printing page %d, %d%%",
-			  job->sheets->values[0].integer, job->progress);
+	  job->progress  = progress;
+	  progress_event = 1;
         }
       }
 
-      if ((attr = cupsGetOption("printer-alert", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "printer-alert")) != NULL)
       {
         cupsdSetString(&job->printer->alert, attr);
 	event |= CUPSD_EVENT_PRINTER_STATE;
       }
 
-      if ((attr = cupsGetOption("printer-alert-description", num_attrs,
-                                attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "printer-alert-description")) != NULL)
       {
         cupsdSetString(&job->printer->alert_description, attr);
 	event |= CUPSD_EVENT_PRINTER_STATE;
       }
 
-      if ((attr = cupsGetOption("marker-colors", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-colors")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-colors", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("marker-levels", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-levels")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-levels", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("marker-low-levels", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-low-levels")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-low-levels", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("marker-high-levels", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-high-levels")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-high-levels", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("marker-message", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-message")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-message", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("marker-names", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-names")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-names", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      if ((attr = cupsGetOption("marker-types", num_attrs, attrs)) != NULL)
+      if ((attr = cupsOptionsGet(attrs, "marker-types")) != NULL)
       {
         cupsdSetPrinterAttr(job->printer, "marker-types", (char *)attr);
 	job->printer->marker_time = time(NULL);
 	event |= CUPSD_EVENT_PRINTER_STATE;
-        cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+        cupsdMarkPrinterDirty(job->printer);
       }
 
-      cupsFreeOptions(num_attrs, attrs);
+      cupsOptionsDelete(attrs);
     }
     else if (loglevel == CUPSD_LOG_PPD)
     {
@@ -5407,10 +8857,34 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
       }
     }
 
-    if (!strchr(job->status_buffer->buffer, '\n'))
-      break;
+    if (!job->status_buffer->buflines)
+    {
+     /*
+      * Keep reading while the filters have more messages for us, up to a
+      * limit so that a chatty filter can't starve everything else...
+      */
+
+      pfd.fd     = job->status_buffer->fd;
+      pfd.events = POLLIN;
+
+      if (++ reads >= CUPSD_JOB_MAX_READS || poll(&pfd, 1, 0) <= 0)
+        break;
+    }
   }
 
+ /*
+  * Send one set of updates and events for all of the messages...
+  */
+
+  if (update_attrs)
+    update_job_attrs(job, 0);
+
+  if (page_event && job->sheets)
+    cupsdAddEvent(CUPSD_EVENT_JOB_PROGRESS, job->printer, job, "Printed %d page(s).", ippGetInteger(job->sheets, 0));
+
+  if (progress_event && job->sheets)
+    cupsdAddEvent(CUPSD_EVENT_JOB_PROGRESS, job->printer, job, "Printing page %d, %d%%", ippGetInteger(job->sheets, 0), job->progress);
+
   if (event & CUPSD_EVENT_JOB_PROGRESS)
     cupsdAddEvent(CUPSD_EVENT_JOB_PROGRESS, job->printer, job,
                   "%s", job->printer->state_message);
@@ -5579,3 +9053,36 @@ update_job_attrs(cupsd_job_t *job,	/* I - Job to update */
   job->dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 }
+
+
+/*
+ * 'write_job_cache()' - Write the job.cache summary for a job.
+ */
+
+static void
+write_job_cache(cups_file_t *fp,	/* I - job.cache or job.journal file */
+                cupsd_job_t *job)	/* I - Job */
+{
+  int		i;			/* Looping var */
+
+
+  cupsFilePrintf(fp, "<Job %d>\n", job->id);
+  cupsFilePrintf(fp, "State %d\n", job->state_value);
+  cupsFilePrintf(fp, "Created %ld\n", (long)job->creation_time);
+  if (job->completed_time)
+    cupsFilePrintf(fp, "Completed %ld\n", (long)job->completed_time);
+  cupsFilePrintf(fp, "Priority %d\n", job->priority);
+  if (job->hold_until)
+    cupsFilePrintf(fp, "HoldUntil %ld\n", (long)job->hold_until);
+  cupsFilePrintf(fp, "Username %s\n", job->username);
+  if (job->name)
+    cupsFilePutConf(fp, "Name", job->name);
+  cupsFilePrintf(fp, "Destination %s\n", job->dest);
+  cupsFilePrintf(fp, "DestType %d\n", job->dtype);
+  cupsFilePrintf(fp, "KOctets %d\n", job->koctets);
+  cupsFilePrintf(fp, "NumFiles %d\n", job->num_files);
+  for (i = 0; i < job->num_files; i ++)
+    cupsFilePrintf(fp, "File %d %s/%s %d\n", i + 1, job->filetypes[i]->super,
+                   job->filetypes[i]->type, job->compressions[i]);
+  cupsFilePuts(fp, "</Job>\n");
+}
@@ -18,6 +18,64 @@ typedef enum cupsd_jobaction_e		/**** Actions for state changes ****/
   CUPSD_JOB_PURGE			/* Force the change and purge */
 } cupsd_jobaction_t;
 
+typedef enum cupsd_prerender_e		/**** Pre-rendering states ****/
+{
+  CUPSD_PRERENDER_NONE,			/* Not pre-rendered */
+  CUPSD_PRERENDER_RUNNING,		/* Filters are running */
+  CUPSD_PRERENDER_DONE,			/* Pre-rendered output is ready */
+  CUPSD_PRERENDER_SKIP			/* Cannot be pre-rendered */
+} cupsd_prerender_t;
+
+
+/*
+ * Pending job queue structure...
+ */
+
+typedef struct cupsd_jobq_s		/**** Pending jobs for a destination ****/
+{
+  char			*dest;		/* Destination printer or class */
+  cups_array_t		*jobs;		/* Pending jobs by priority and ID */
+} cupsd_jobq_t;
+
+
+/*
+ * Completed job record structure...
+ */
+
+typedef struct cupsd_jobrec_s		/**** Compact completed job ****/
+{
+  int			id,		/* Job ID */
+			priority,	/* Job priority */
+			koctets,	/* job-k-octets */
+			num_files;	/* Number of files in job */
+  ipp_jstate_t		state_value;	/* job-state */
+  cups_ptype_t		dtype;		/* Destination type */
+  time_t		creation_time,	/* When job was created */
+			completed_time;	/* When job was completed */
+  char			*username,	/* Printing user */
+			*dest,		/* Destination printer or class */
+			*name;		/* Job name/title */
+  mime_type_t		**filetypes;	/* File types */
+  int			*compressions;	/* Compression status of each file */
+  cupsd_job_t		*job;		/* Full job, NULL if compacted */
+} cupsd_jobrec_t;
+
+
+/*
+ * Job process resource usage structure...
+ */
+
+typedef struct cupsd_jobusage_s		/**** Filter/backend resource usage ****/
+{
+  int			pid;		/* Process ID */
+  char			name[64];	/* Program name */
+  struct timeval	start;		/* When the process was started */
+  double		wall,		/* Elapsed time in seconds */
+			user,		/* User CPU time in seconds */
+			sys;		/* System CPU time in seconds */
+  long			maxrss;		/* Maximum resident set in kbytes */
+} cupsd_jobusage_t;
+
 
 /*
  * Job request structure...
@@ -27,7 +85,8 @@ struct cupsd_job_s			/**** Job request ****/
 {
   int			id,		/* Job ID */
 			priority,	/* Job priority */
-			dirty;		/* Do we need to write the "c" file? */
+			dirty,		/* Do we need to write the "c" file? */
+			journal;	/* Do we need a job.cache journal entry? */
   ipp_jstate_t		state_value;	/* Cached job-state */
   int			pending_timeout;/* Non-zero if the job was created and
 					 * waiting on files */
@@ -37,6 +96,7 @@ struct cupsd_job_s			/**** Job request ****/
   int			koctets;	/* job-k-octets */
   cups_ptype_t		dtype;		/* Destination type */
   cupsd_printer_t	*printer;	/* Printer this job is assigned to */
+  cupsd_jobq_t		*queue;		/* Pending queue this job is in */
   int			num_files;	/* Number of files in job */
   mime_type_t		**filetypes;	/* File types */
   int			*compressions;	/* Compression status of each file */
@@ -49,7 +109,8 @@ struct cupsd_job_s			/**** Job request ****/
 			file_time,	/* Job file retain time */
 			history_time,	/* Job history retain time */
 			hold_until,	/* Hold expiration date/time */
-			kill_time;	/* When to send SIGKILL */
+			kill_time,	/* When to send SIGKILL */
+			timeout_time;	/* Nearest deadline (JobTimeouts key) */
   ipp_attribute_t	*state;		/* Job state */
   ipp_attribute_t	*reasons;	/* Job state reasons */
   ipp_attribute_t	*job_sheets;	/* Job sheets (NULL if none) */
@@ -80,10 +141,16 @@ struct cupsd_job_s			/**** Job request ****/
 			*auth_uid;	/* AUTH_UID environment variable */
   void			*profile,	/* Security profile for filters */
 			*bprofile;	/* Security profile for backend */
-  cups_array_t		*history;	/* Debug log history */
+  struct cupsd_jobhistory_s *history;	/* Debug log history */
   int			progress;	/* Printing progress */
   int			num_keywords;	/* Number of PPD keywords */
   cups_option_t		*keywords;	/* PPD keywords */
+  cupsd_prerender_t	prerender;	/* Pre-rendering state */
+  mime_type_t		*prerender_type;/* Type of pre-rendered output */
+  off_t			prerender_size;	/* Size of pre-rendered output */
+  char			*render_key;	/* Render cache key for output */
+  int			num_usage;	/* Number of usage records */
+  cupsd_jobusage_t	*usage;		/* Filter/backend resource usage */
 };
 
 typedef struct cupsd_joblog_s		/**** Job log message ****/
@@ -92,6 +159,14 @@ typedef struct cupsd_joblog_s		/**** Job log message ****/
   char			message[1];	/* Message string */
 } cupsd_joblog_t;
 
+typedef struct cupsd_jobhistory_s	/**** Job log history ****/
+{
+  int			first,		/* Index of oldest message */
+			count,		/* Number of messages */
+			size;		/* Number of message slots */
+  cupsd_joblog_t	*messages[1];	/* Ring buffer of messages */
+} cupsd_jobhistory_t;
+
 
 /*
  * Globals...
@@ -101,6 +176,16 @@ VAR int			JobHistory	VALUE(INT_MAX);
 					/* Preserve job history? */
 VAR int			JobFiles	VALUE(86400);
 					/* Preserve job files? */
+VAR int			CompressJobFiles VALUE(0);
+					/* Compress preserved job files? */
+VAR int			DeduplicateJobFiles VALUE(0);
+					/* Share identical job files? */
+VAR int			PrerenderJobs	VALUE(0),
+					/* Pending jobs to pre-render per printer */
+			PrerenderLimit	VALUE(0),
+					/* Max size of pre-rendered output */
+			RenderCacheLimit VALUE(0);
+					/* Max size of cached rendered output */
 VAR time_t		JobHistoryUpdate VALUE(0);
 					/* Time for next job history update */
 VAR int			MaxJobs		VALUE(0),
@@ -119,10 +204,16 @@ VAR int			JobAutoPurge	VALUE(0);
 					/* Automatically purge jobs */
 VAR cups_array_t	*Jobs		VALUE(NULL),
 					/* List of current jobs */
+			*CompactJobs	VALUE(NULL),
+					/* Compacted completed jobs by ID */
 			*ActiveJobs	VALUE(NULL),
 					/* List of active jobs */
-			*PrintingJobs	VALUE(NULL);
+			*PrintingJobs	VALUE(NULL),
 					/* List of jobs that are printing */
+			*JobTimeouts	VALUE(NULL),
+					/* Active jobs sorted by deadline */
+			*ReadyQueues	VALUE(NULL);
+					/* Pending job queues by destination */
 VAR int			NextJobId	VALUE(1);
 					/* Next job ID to use */
 VAR int			JobKillDelay	VALUE(DEFAULT_TIMEOUT),
@@ -138,6 +229,7 @@ VAR int			JobKillDelay	VALUE(DEFAULT_TIMEOUT),
  */
 
 extern cupsd_job_t	*cupsdAddJob(int priority, const char *dest);
+extern int		cupsdAdoptJob(char *value);
 extern void		cupsdCancelJobs(const char *dest, const char *username,
 			                int purge);
 extern void		cupsdCheckJobs(void);
@@ -145,13 +237,24 @@ extern void		cupsdCleanJobs(void);
 extern void		cupsdContinueJob(cupsd_job_t *job);
 extern void		cupsdDeleteJob(cupsd_job_t *job,
 			               cupsd_jobaction_t action);
+extern void		cupsdDiscardPrerender(cupsd_job_t *job);
+extern cupsd_job_t	*cupsdExpandJob(cupsd_jobrec_t *rec);
 extern cupsd_job_t	*cupsdFindJob(int id);
+extern void		cupsdFinishPrerender(cupsd_job_t *job);
 extern void		cupsdFreeAllJobs(void);
-extern cups_array_t	*cupsdGetCompletedJobs(cupsd_printer_t *p);
+extern void		cupsdFreeJobRecords(cups_array_t *records);
+extern char		*cupsdGetJobFilename(int id, char type, int number,
+			                     char *buffer, size_t bufsize);
+extern cups_array_t	*cupsdGetJobRecords(cupsd_printer_t *p,
+			                    int completed);
 extern int		cupsdGetPrinterJobCount(const char *dest);
+extern cupsd_job_t	*cupsdGetRecordJob(cupsd_jobrec_t *rec,
+			                   cupsd_job_t *buffer);
 extern int		cupsdGetUserJobCount(const char *username);
+extern void		cupsdHandoffJobs(cups_file_t *fp);
 extern void		cupsdLoadAllJobs(void);
 extern int		cupsdLoadJob(cupsd_job_t *job);
+extern void		cupsdLogFilterUsage(void);
 extern void		cupsdMoveJob(cupsd_job_t *job, cupsd_printer_t *p);
 extern void		cupsdReleaseJob(cupsd_job_t *job);
 extern void		cupsdRestartJob(cupsd_job_t *job);
@@ -166,8 +269,13 @@ extern void		cupsdSetJobState(cupsd_job_t *job,
 					 const char *message, ...)
 					__attribute__((__format__(__printf__,
 					                          4, 5)));
+extern void		cupsdShareJobFile(cupsd_job_t *job, int number,
+			                  unsigned hash);
 extern void		cupsdStopAllJobs(cupsd_jobaction_t action,
 			                 int kill_delay);
 extern int		cupsdTimeoutJob(cupsd_job_t *job);
 extern void		cupsdUnloadCompletedJobs(void);
 extern void		cupsdUpdateJobs(void);
+extern void		cupsdUpdateJobQueues(cupsd_job_t *job);
+extern void		cupsdUpdateJobUsage(cupsd_job_t *job, int pid,
+			                    struct rusage *usage);
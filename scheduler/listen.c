@@ -24,6 +24,62 @@
 #endif /* __linux && !IPV6_V6ONLY */
 
 
+/*
+ * 'cupsdAdoptListener()' - Use a listening socket from before a scheduler
+ *                          upgrade.
+ *
+ * Sockets that no longer match a Listen or Port line are closed.
+ */
+
+void
+cupsdAdoptListener(int fd)		/* I - Socket file descriptor */
+{
+  cupsd_listener_t	*lis;		/* Current listening socket */
+  http_addr_t		addr;		/* Address of socket */
+  socklen_t		addrlen;	/* Length of address */
+  char			s[256];		/* String address */
+
+
+  addrlen = sizeof(addr);
+
+  if (getsockname(fd, (struct sockaddr *)&addr, &addrlen))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to get local address for listen socket %d - %s.",
+		    fd, strerror(errno));
+    close(fd);
+    return;
+  }
+
+  for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
+       lis;
+       lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
+    if (lis->fd == -1 && httpAddrEqual(&(lis->address), &addr) &&
+        httpAddrPort(&(lis->address)) == httpAddrPort(&addr))
+      break;
+
+  httpAddrString(&addr, s, sizeof(s));
+
+  if (lis)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Using listen socket %d for %s:%d.", fd,
+                    s, httpAddrPort(&addr));
+
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+
+    lis->fd = fd;
+  }
+  else
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO,
+                    "Closing listen socket for %s:%d that is no longer used.",
+		    s, httpAddrPort(&addr));
+
+    httpAddrClose(&addr, fd);
+  }
+}
+
+
 /*
  * 'cupsdDeleteAllListeners()' - Delete all listeners.
  */
@@ -53,6 +109,28 @@ cupsdDeleteAllListeners(void)
 }
 
 
+/*
+ * 'cupsdHandoffListeners()' - Save the listening sockets for a scheduler
+ *                             upgrade.
+ */
+
+void
+cupsdHandoffListeners(cups_file_t *fp)	/* I - Upgrade state file */
+{
+  cupsd_listener_t	*lis;		/* Current listening socket */
+
+
+  for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
+       lis;
+       lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
+    if (lis->fd != -1)
+    {
+      cupsFilePrintf(fp, "Listener %d\n", lis->fd);
+      cupsdHandoffFD(lis->fd);
+    }
+}
+
+
 /*
  * 'cupsdPauseListening()' - Clear input polling on all listening sockets...
  */
@@ -105,7 +183,16 @@ cupsdResumeListening(void)
   for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
        lis;
        lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
+  {
+   /*
+    * Listening sockets are non-blocking so that cupsdAcceptClient can drain
+    * several pending connections per wakeup...
+    */
+
+    fcntl(lis->fd, F_SETFL, fcntl(lis->fd, F_GETFL) | O_NONBLOCK);
+
     cupsdAddSelect(lis->fd, (cupsd_selfunc_t)cupsdAcceptClient, NULL, lis);
+  }
 
   ListeningPaused = 0;
 }
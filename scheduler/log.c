@@ -96,6 +96,7 @@ static const int log_levels[] =		/* SYSLOG levels... */
  */
 
 static int	format_log_line(const char *message, va_list ap);
+static void	log_slow_request(cupsd_client_t *con);
 
 
 /*
@@ -292,6 +293,43 @@ cupsdCheckLogFile(cups_file_t **lf,	/* IO - Log file */
 }
 
 
+/*
+ * 'cupsdElapsedTime()' - Get the number of seconds between two times.
+ */
+
+double					/* O - Elapsed seconds */
+cupsdElapsedTime(struct timeval *start,	/* I - Start time */
+                 struct timeval *end)	/* I - End time */
+{
+  return ((end->tv_sec - start->tv_sec) + 0.000001 * (end->tv_usec - start->tv_usec));
+}
+
+
+/*
+ * 'cupsdFlushLogs()' - Write any buffered log file data.
+ *
+ * Log lines are buffered and written once per pass through the main loop
+ * rather than once per line.
+ */
+
+void
+cupsdFlushLogs(void)
+{
+  if (AccessFile)
+    cupsFileFlush(AccessFile);
+
+  _cupsMutexLock(&log_mutex);
+
+  if (ErrorFile)
+    cupsFileFlush(ErrorFile);
+
+  _cupsMutexUnlock(&log_mutex);
+
+  if (PageFile)
+    cupsFileFlush(PageFile);
+}
+
+
 /*
  * 'cupsdGetDateTime()' - Returns a pointer to a date/time string.
  */
@@ -301,9 +339,11 @@ cupsdGetDateTime(struct timeval *t,	/* I - Time value or NULL for current */
                  cupsd_time_t   format)	/* I - Format to use */
 {
   struct timeval	curtime;	/* Current time value */
-  struct tm		date;		/* Date/time value */
+  static struct tm	date;		/* Date/time value */
   static struct timeval	last_time = { 0, 0 };
 	    				/* Last time we formatted */
+  static cupsd_time_t	last_format = CUPSD_TIME_STANDARD;
+					/* Last format we used */
   static char		s[1024];	/* Date/time string */
   static const char * const months[12] =/* Months */
 		{
@@ -332,10 +372,9 @@ cupsdGetDateTime(struct timeval *t,	/* I - Time value or NULL for current */
     t = &curtime;
   }
 
-  if (t->tv_sec != last_time.tv_sec ||
-      (LogTimeFormat == CUPSD_TIME_USECS && t->tv_usec != last_time.tv_usec))
+  if (t->tv_sec != last_time.tv_sec || format != last_format ||
+      (format == CUPSD_TIME_USECS && t->tv_usec != last_time.tv_usec))
   {
-    last_time = *t;
 
    /*
     * Get the date and time from the UNIX time value, and then format it
@@ -349,9 +388,16 @@ cupsdGetDateTime(struct timeval *t,	/* I - Time value or NULL for current */
     * before starting the scheduler.
     *
     * (*BSD and Darwin store the timezone offset in the tm structure)
+    *
+    * The broken-down time only changes once per second, so only the
+    * microseconds need to be updated for other times in the same second...
     */
 
-    localtime_r(&(t->tv_sec), &date);
+    if (t->tv_sec != last_time.tv_sec || !s[0])
+      localtime_r(&(t->tv_sec), &date);
+
+    last_time   = *t;
+    last_format = format;
 
     if (format == CUPSD_TIME_STANDARD)
       snprintf(s, sizeof(s), "[%02d/%s/%04d:%02d:%02d:%02d %+03ld%02ld]",
@@ -598,36 +644,46 @@ cupsdLogJob(cupsd_job_t *job,		/* I - Job */
       * Add message to the job history...
       */
 
+      cupsd_jobhistory_t *history;	/* Job history */
       cupsd_joblog_t *temp;		/* Copy of log message */
       size_t         log_len = strlen(log_line);
 					/* Length of log message */
+      int            i;			/* Slot for message */
 
-      if ((temp = malloc(sizeof(cupsd_joblog_t) + log_len)) != NULL)
+      if ((history = job->history) == NULL)
       {
-        temp->time = time(NULL);
-	memcpy(temp->message, log_line, log_len + 1);
+        if ((history = calloc(1, sizeof(cupsd_jobhistory_t) + (size_t)(LogDebugHistory - 1) * sizeof(cupsd_joblog_t *))) == NULL)
+          return (1);
+
+        history->size = LogDebugHistory;
+        job->history  = history;
       }
 
-      if (!job->history)
-	job->history = cupsArrayNew(NULL, NULL);
+     /*
+      * Use the next free slot or replace the oldest message, reusing its
+      * memory...
+      */
 
-      if (job->history && temp)
+      if (history->count < history->size)
       {
-	cupsArrayAdd(job->history, temp);
-
-	if (cupsArrayCount(job->history) > LogDebugHistory)
-	{
-	 /*
-	  * Remove excess messages...
-	  */
+        i = (history->first + history->count) % history->size;
+        history->count ++;
+      }
+      else
+      {
+        i              = history->first;
+        history->first = (history->first + 1) % history->size;
+      }
 
-	  temp = cupsArrayFirst(job->history);
-	  cupsArrayRemove(job->history, temp);
-	  free(temp);
-	}
+      if ((temp = realloc(history->messages[i], sizeof(cupsd_joblog_t) + log_len)) != NULL)
+      {
+        temp->time = time(NULL);
+	memcpy(temp->message, log_line, log_len + 1);
       }
-      else if (temp)
-	free(temp);
+      else
+        free(history->messages[i]);
+
+      history->messages[i] = temp;
 
       return (1);
     }
@@ -1004,7 +1060,6 @@ cupsdLogPage(cupsd_job_t *job,		/* I - Job being printed */
   */
 
   cupsFilePrintf(PageFile, "%s\n", buffer);
-  cupsFileFlush(PageFile);
 
   return (1);
 }
@@ -1018,7 +1073,8 @@ int					/* O - 1 on success, 0 on error */
 cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
                 http_status_t  code)	/* I - Response code */
 {
-  char	temp[2048];			/* Temporary string for URI */
+  char	temp[2048],			/* Temporary string for URI */
+	elapsed[32];			/* Time spent on request, if any */
   static const char * const states[] =	/* HTTP client states... */
 		{
 		  "WAITING",
@@ -1038,6 +1094,13 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
 		};
 
 
+ /*
+  * Log slow requests with a breakdown of where the time went...
+  */
+
+  if (SlowRequestThreshold > 0)
+    log_slow_request(con);
+
  /*
   * Filter requests as needed...
   */
@@ -1148,10 +1211,24 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
     }
   }
 
+ /*
+  * Add the time spent on the request in microseconds as requested...
+  */
+
+  if (AccessLogFormat == CUPSD_ACCESSFORMAT_TIMING)
+  {
+    struct timeval	curtime;	/* Current time */
+
+    gettimeofday(&curtime, NULL);
+    snprintf(elapsed, sizeof(elapsed), " %ld", (long)((curtime.tv_sec - con->start.tv_sec) * 1000000 + curtime.tv_usec - con->start.tv_usec));
+  }
+  else
+    elapsed[0] = '\0';
+
 #ifdef HAVE_SYSTEMD_SD_JOURNAL_H
   if (!strcmp(AccessLog, "syslog"))
   {
-    sd_journal_print(LOG_INFO, "REQUEST %s - %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s", con->http->hostname, con->username[0] != '\0' ? con->username : "-", states[con->operation], _httpEncodeURI(temp, con->uri, sizeof(temp)), con->http->version / 100, con->http->version % 100, code, CUPS_LLCAST con->bytes, con->request ? ippOpString(con->request->request.op.operation_id) : "-", con->response ? ippErrorString(con->response->request.status.status_code) : "-");
+    sd_journal_print(LOG_INFO, "REQUEST %s - %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s%s", con->http->hostname, con->username[0] != '\0' ? con->username : "-", states[con->operation], _httpEncodeURI(temp, con->uri, sizeof(temp)), con->http->version / 100, con->http->version % 100, code, CUPS_LLCAST con->bytes, con->request ? ippOpString(con->request->request.op.operation_id) : "-", con->response ? ippErrorString(con->response->request.status.status_code) : "-", elapsed);
     return (1);
   }
 
@@ -1163,7 +1240,7 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
   if (!strcmp(AccessLog, "syslog"))
   {
     syslog(LOG_INFO,
-           "REQUEST %s - %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s\n",
+           "REQUEST %s - %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s%s\n",
            con->http->hostname, con->username[0] != '\0' ? con->username : "-",
 	   states[con->operation], _httpEncodeURI(temp, con->uri, sizeof(temp)),
 	   con->http->version / 100, con->http->version % 100,
@@ -1171,7 +1248,8 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
 	   con->request ?
 	       ippOpString(con->request->request.op.operation_id) : "-",
 	   con->response ?
-	       ippErrorString(con->response->request.status.status_code) : "-");
+	       ippErrorString(con->response->request.status.status_code) : "-",
+	   elapsed);
 
     return (1);
   }
@@ -1189,7 +1267,7 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
   */
 
   cupsFilePrintf(AccessFile,
-                 "%s - %s %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s\n",
+                 "%s - %s %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s%s\n",
         	 con->http->hostname,
 		 con->username[0] != '\0' ? con->username : "-",
 		 cupsdGetDateTime(&(con->start), LogTimeFormat),
@@ -1201,9 +1279,7 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
 		     ippOpString(con->request->request.op.operation_id) : "-",
 		 con->response ?
 		     ippErrorString(con->response->request.status.status_code) :
-		     "-");
-
-  cupsFileFlush(AccessFile);
+		     "-", elapsed);
 
   return (1);
 }
@@ -1270,7 +1346,14 @@ cupsdWriteErrorLog(int        level,	/* I - Log level */
 
     cupsFilePrintf(ErrorFile, "%c %s %s\n", levels[level],
                    cupsdGetDateTime(NULL, LogTimeFormat), message);
-    cupsFileFlush(ErrorFile);
+
+   /*
+    * Critical messages are written immediately, everything else is flushed
+    * by cupsdFlushLogs()...
+    */
+
+    if (level <= CUPSD_LOG_CRIT)
+      cupsFileFlush(ErrorFile);
   }
 
   _cupsMutexUnlock(&log_mutex);
@@ -1341,3 +1424,47 @@ format_log_line(const char *message,	/* I - Printf-style format string */
 
   return (1);
 }
+
+
+/*
+ * 'log_slow_request()' - Log a request that took longer than
+ *                        SlowRequestThreshold.
+ */
+
+static void
+log_slow_request(cupsd_client_t *con)	/* I - Client connection */
+{
+  struct timeval	curtime;	/* Current time */
+  double		total,		/* Total time */
+			header = 0.0,	/* Time parsing the request header */
+			reading = 0.0,	/* Time reading the IPP request */
+			operation = 0.0,/* Time in the IPP operation */
+			writing;	/* Time sending the response */
+  ipp_attribute_t	*attr;		/* requested-attributes */
+  char			attrs[256];	/* requested-attributes values */
+
+
+  gettimeofday(&curtime, NULL);
+
+  if ((total = cupsdElapsedTime(&con->start, &curtime)) * 1000.0 < SlowRequestThreshold)
+    return;
+
+  if (timerisset(&con->fields_time))
+    header = cupsdElapsedTime(&con->start, &con->fields_time);
+
+  if (timerisset(&con->ipp_end))
+  {
+    reading   = cupsdElapsedTime(&con->fields_time, &con->ipp_start) - con->auth_secs;
+    operation = cupsdElapsedTime(&con->ipp_start, &con->ipp_end) - con->policy_secs;
+    writing   = cupsdElapsedTime(&con->ipp_end, &curtime);
+  }
+  else
+    writing = total - header - con->auth_secs;
+
+  if (con->request && (attr = ippFindAttribute(con->request, "requested-attributes", IPP_TAG_KEYWORD)) != NULL)
+    ippAttributeString(attr, attrs, sizeof(attrs));
+  else
+    strlcpy(attrs, "-", sizeof(attrs));
+
+  cupsdLogClient(con, CUPSD_LOG_WARN, "Slow request \"%s %s\" %s took %.3f seconds (header %.3f, authorization %.3f, read %.3f, policy %.3f, operation %.3f, write %.3f), requested-attributes=%s, " CUPS_LLFMT " response bytes.", httpStateString(con->operation) + 11, con->uri, con->request ? ippOpString(con->request->request.op.operation_id) : "-", total, header, con->auth_secs, reading, con->policy_secs, operation, writing, attrs, CUPS_LLCAST (con->response ? (off_t)ippLength(con->response) : con->bytes));
+}
@@ -14,7 +14,6 @@
 
 #define _MAIN_C_
 #include "cupsd.h"
-#include <sys/resource.h>
 #ifdef __APPLE__
 #  include <xpc/xpc.h>
 #  include <pthread/qos.h>
@@ -62,14 +61,19 @@
  * Local functions...
  */
 
+static int		client_has_request(cupsd_client_t *con);
 static void		parent_handler(int sig);
 static void		process_children(void);
 static void		sigchld_handler(int sig);
 static void		sighup_handler(int sig);
 static void		sigterm_handler(int sig);
+static void		sigusr1_handler(int sig);
+static void		sigusr2_handler(int sig);
 static long		select_timeout(int fds);
 static void		service_checkin(void);
 static void		service_checkout(int shutdown);
+static void		upgrade_checkin(const char *filename);
+static void		upgrade_server(const char *command);
 static void		usage(int status) _CUPS_NORETURN;
 
 
@@ -89,6 +93,12 @@ static int		stop_scheduler = 0;
 					/* Should the scheduler stop? */
 static time_t           local_timeout = 0;
                                         /* Next local printer timeout */
+static int		need_upgrade = 0;
+					/* Should the scheduler be upgraded? */
+static int		need_memory_report = 0;
+					/* Should memory usage be logged? */
+static char		*upgrade_fds = NULL;
+					/* File descriptors to hand off */
 
 
 /*
@@ -101,6 +111,7 @@ main(int  argc,				/* I - Number of command-line args */
 {
   int			i;		/* Looping var */
   char			*opt;		/* Option character */
+  char			filename[1024];	/* Raster page header cache directory */
   int			close_all = 1,	/* Close all file descriptors? */
 			disconnect = 1,	/* Disconnect from controlling terminal? */
 			fg = 0,		/* Run in foreground? */
@@ -108,6 +119,8 @@ main(int  argc,				/* I - Number of command-line args */
 					/* Running as child process? */
 			print_profile = 0;
 					/* Print the sandbox profile to stdout? */
+  const char		*upgrade_file = NULL;
+					/* State from scheduler upgrade */
   int			fds;		/* Number of ready descriptors */
   cupsd_client_t	*con;		/* Current client */
   cupsd_job_t		*job;		/* Current job */
@@ -308,6 +321,17 @@ main(int  argc,				/* I - Number of command-line args */
               close_all     = 0;
               break;
 
+          case 'U' : /* Continue after upgrade (internal use) */
+              i ++;
+	      if (i >= argc)
+	        usage(1);
+
+              upgrade_file = argv[i];
+	      fg           = 1;
+	      disconnect   = 0;
+	      close_all    = 0;
+	      break;
+
 	  default : /* Unknown option */
               _cupsLangPrintf(stderr, _("cupsd: Unknown option \"%c\" - "
 	                                "aborting."), *opt);
@@ -578,14 +602,18 @@ main(int  argc,				/* I - Number of command-line args */
   }
 
  /*
-  * Clean out old temp files and printer cache data.
+  * Clean out old temp files and printer cache data.  The temp files are
+  * still in use by running filters after an upgrade...
   */
 
-  if (!strncmp(TempDir, RequestRoot, strlen(RequestRoot)))
+  if (!strncmp(TempDir, RequestRoot, strlen(RequestRoot)) && !upgrade_file)
     cupsdCleanFiles(TempDir, NULL);
 
   cupsdCleanFiles(CacheDir, "*.ipp");
 
+  snprintf(filename, sizeof(filename), "%s/raster", CacheDir);
+  cupsdCleanFiles(filename, NULL);
+
  /*
   * If we were started on demand by launchd or systemd get the listen sockets
   * file descriptors...
@@ -594,6 +622,14 @@ main(int  argc,				/* I - Number of command-line args */
   service_checkin();
   service_checkout(0);
 
+ /*
+  * After an upgrade, pick up the listening sockets and printing jobs of the
+  * old scheduler...
+  */
+
+  if (upgrade_file)
+    upgrade_checkin(upgrade_file);
+
  /*
   * Startup the server...
   */
@@ -611,6 +647,8 @@ main(int  argc,				/* I - Number of command-line args */
   sigset(SIGHUP, sighup_handler);
   sigset(SIGPIPE, SIG_IGN);
   sigset(SIGTERM, sigterm_handler);
+  sigset(SIGUSR1, sigusr1_handler);
+  sigset(SIGUSR2, sigusr2_handler);
 #elif defined(HAVE_SIGACTION)
   memset(&action, 0, sizeof(action));
 
@@ -634,11 +672,23 @@ main(int  argc,				/* I - Number of command-line args */
   sigaddset(&action.sa_mask, SIGCHLD);
   action.sa_handler = sigterm_handler;
   sigaction(SIGTERM, &action, NULL);
+
+  sigemptyset(&action.sa_mask);
+  sigaddset(&action.sa_mask, SIGUSR1);
+  action.sa_handler = sigusr1_handler;
+  sigaction(SIGUSR1, &action, NULL);
+
+  sigemptyset(&action.sa_mask);
+  sigaddset(&action.sa_mask, SIGUSR2);
+  action.sa_handler = sigusr2_handler;
+  sigaction(SIGUSR2, &action, NULL);
 #else
   signal(SIGCLD, sigchld_handler);	/* No, SIGCLD isn't a typo... */
   signal(SIGHUP, sighup_handler);
   signal(SIGPIPE, SIG_IGN);
   signal(SIGTERM, sigterm_handler);
+  signal(SIGUSR1, sigusr1_handler);
+  signal(SIGUSR2, sigusr2_handler);
 #endif /* HAVE_SIGSET */
 
  /*
@@ -684,7 +734,9 @@ main(int  argc,				/* I - Number of command-line args */
     cupsdAddEvent(CUPSD_EVENT_SERVER_STARTED, NULL, NULL, "Scheduler started on demand.");
   else
 #endif /* HAVE_ONDEMAND */
-  if (fg)
+  if (upgrade_file)
+    cupsdAddEvent(CUPSD_EVENT_SERVER_RESTARTED, NULL, NULL, "Scheduler upgraded.");
+  else if (fg)
     cupsdAddEvent(CUPSD_EVENT_SERVER_STARTED, NULL, NULL, "Scheduler started in foreground.");
   else
     cupsdAddEvent(CUPSD_EVENT_SERVER_STARTED, NULL, NULL, "Scheduler started in background.");
@@ -718,12 +770,84 @@ main(int  argc,				/* I - Number of command-line args */
     if (dead_children)
       process_children();
 
+   /*
+    * Log the memory usage if requested...
+    */
+
+    if (need_memory_report)
+    {
+      need_memory_report = 0;
+      cupsdLogMemoryUsage();
+    }
+
+   /*
+    * Check if we need to upgrade the scheduler...
+    */
+
+    if (need_upgrade)
+    {
+#ifdef HAVE_ONDEMAND
+      if (OnDemand)
+      {
+	cupsdLogMessage(CUPSD_LOG_ERROR, "Upgrading is not supported when running on demand.");
+	need_upgrade = 0;
+      }
+      else
+#endif /* HAVE_ONDEMAND */
+      {
+       /*
+	* Close any idle clients and let the others finish...
+	*/
+
+	for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
+	     con;
+	     con = (cupsd_client_t *)cupsArrayNext(Clients))
+	  if (httpGetState(con->http) == HTTP_WAITING)
+	    cupsdCloseClient(con);
+	  else
+	    con->http->keep_alive = HTTP_KEEPALIVE_OFF;
+
+	cupsdPauseListening();
+
+       /*
+	* Upgrade once all clients are closed or the reload timeout has elapsed;
+	* printing jobs keep going with the new scheduler...
+	*/
+
+	if (cupsArrayCount(Clients) == 0 ||
+	    (time(NULL) - ReloadTime) >= ReloadTimeout)
+	{
+	  upgrade_server(argv[0]);
+
+	  need_upgrade = 0;
+
+	  cupsdResumeListening();
+	}
+      }
+    }
+
    /*
     * Check if we need to load the server configuration file...
     */
 
     if (NeedReload)
     {
+     /*
+      * Only reload everything after a SIGHUP if something other than
+      * cupsd.conf has changed, so that printing jobs keep going...
+      */
+
+      if (NeedReload == RELOAD_SIGNAL)
+      {
+        if (cupsdNeedFullReload())
+	  NeedReload = RELOAD_ALL;
+	else
+	{
+	  cupsdLogMessage(CUPSD_LOG_INFO, "Only cupsd.conf needs to be reloaded.");
+	  NeedReload = RELOAD_CUPSD;
+	}
+      }
+
      /*
       * Close any idle clients...
       */
@@ -800,6 +924,12 @@ main(int  argc,				/* I - Number of command-line args */
       }
     }
 
+   /*
+    * Answer any Get-Notifications requests that have new events...
+    */
+
+    cupsdCheckNotifyWaiters();
+
    /*
     * Check for available input or ready output.  If cupsdDoSelect()
     * returns 0 or -1, something bad happened and we should exit
@@ -812,6 +942,12 @@ main(int  argc,				/* I - Number of command-line args */
     if ((timeout = select_timeout(fds)) > 1 && LastEvent)
       timeout = 1;
 
+   /*
+    * Write any log messages from this pass before waiting...
+    */
+
+    cupsdFlushLogs();
+
 #ifdef HAVE_ONDEMAND
    /*
     * If no other work is scheduled and we're being controlled by launchd,
@@ -912,6 +1048,15 @@ main(int  argc,				/* I - Number of command-line args */
     if (DirtyCleanTime && current_time >= DirtyCleanTime)
       cupsdCleanDirty();
 
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+   /*
+    * Register the next batch of pending DNS-SD printers...
+    */
+
+    if (DNSSDRegisterTime && current_time >= DNSSDRegisterTime)
+      cupsdRegisterPendingPrinters();
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
+
 #ifdef __APPLE__
    /*
     * If we are going to sleep and still have pending jobs, stop them after
@@ -928,10 +1073,11 @@ main(int  argc,				/* I - Number of command-line args */
 
 #ifndef __APPLE__
    /*
-    * Update the network interfaces once a minute...
+    * Update the network interfaces once a minute, or every ten minutes when
+    * interface changes are being monitored...
     */
 
-    if ((current_time - netif_time) >= 60)
+    if ((current_time - netif_time) >= (NetIFMonitorFd >= 0 ? 600 : 60))
     {
       netif_time  = current_time;
       NetIFUpdate = 1;
@@ -1033,7 +1179,7 @@ main(int  argc,				/* I - Number of command-line args */
       * Process pending data in the input buffer...
       */
 
-      if (httpGetReady(con->http))
+      if (client_has_request(con))
       {
         cupsdReadClient(con);
 	continue;
@@ -1051,6 +1197,17 @@ main(int  argc,				/* I - Number of command-line args */
         cupsdCloseClient(con);
         continue;
       }
+
+#ifdef HAVE_SSL
+      if (con->tls_timeout && con->tls_timeout <= current_time)
+      {
+        cupsdLogMessage(CUPSD_LOG_DEBUG, "Closing client %d after TLS handshake timeout.", con->number);
+
+        con->tls_timeout = 0;
+        cupsdCloseClient(con);
+        continue;
+      }
+#endif /* HAVE_SSL */
     }
 
    /*
@@ -1062,6 +1219,10 @@ main(int  argc,				/* I - Number of command-line args */
       size_t		string_count,	/* String count */
 			alloc_bytes,	/* Allocated string bytes */
 			total_bytes;	/* Total string bytes */
+      cupsd_slabtype_t	slab_type;	/* Slab object type */
+      const char	*slab_name;	/* Slab object type name */
+      int		slab_used,	/* Objects in use */
+			slab_free;	/* Objects on free list */
 #ifdef HAVE_MALLINFO
       struct mallinfo	mem;		/* Malloc information */
 
@@ -1080,6 +1241,8 @@ main(int  argc,				/* I - Number of command-line args */
                       cupsArrayCount(Jobs));
       cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: jobs-active=%d",
                       cupsArrayCount(ActiveJobs));
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: jobs-compact=%d",
+                      cupsArrayCount(CompactJobs));
       cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: printers=%d",
                       cupsArrayCount(Printers));
 
@@ -1094,6 +1257,17 @@ main(int  argc,				/* I - Number of command-line args */
                       "Report: stringpool-total-bytes=" CUPS_LLFMT,
 		      CUPS_LLCAST total_bytes);
 
+      for (slab_type = CUPSD_SLAB_CLIENT; slab_type < CUPSD_SLAB_MAX; slab_type ++)
+      {
+        slab_name = cupsdSlabStatistics(slab_type, &slab_used, &slab_free, &alloc_bytes);
+
+        cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: slab-%s-used=%d", slab_name, slab_used);
+        cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: slab-%s-free=%d", slab_name, slab_free);
+        cupsdLogMessage(CUPSD_LOG_DEBUG, "Report: slab-%s-alloc-bytes=" CUPS_LLFMT, slab_name, CUPS_LLCAST alloc_bytes);
+      }
+
+      cupsdLogFilterUsage();
+
       report_time = current_time;
     }
 
@@ -1178,6 +1352,12 @@ main(int  argc,				/* I - Number of command-line args */
 
   cupsdFreeAllJobs();
 
+ /*
+  * Wait for any files that are still being removed...
+  */
+
+  cupsdFinishPurge();
+
  /*
   * Delete all temporary printers...
   */
@@ -1262,6 +1442,18 @@ cupsdFreeStrings(cups_array_t **a)	/* IO - String array */
 }
 
 
+/*
+ * 'cupsdHandoffFD()' - Keep a file descriptor open for the upgraded scheduler.
+ */
+
+void
+cupsdHandoffFD(int fd)			/* I - File descriptor */
+{
+  if (upgrade_fds && fd >= 0 && fd < MaxFDs)
+    upgrade_fds[fd] = 1;
+}
+
+
 /*
  * 'cupsdHoldSignals()' - Hold child and termination signals.
  */
@@ -1366,6 +1558,30 @@ cupsdSetStringf(char       **s,		/* O - New string */
 }
 
 
+/*
+ * 'client_has_request()' - Determine whether a client has a buffered (pipelined)
+ *                          request that can be processed now.
+ *
+ * Data that arrives while the previous response is still being sent is left
+ * in the buffer until the response is done.  A passed document that is still
+ * being copied into the spool also counts as a pending request.
+ */
+
+static int				/* O - 1 if ready, 0 otherwise */
+client_has_request(cupsd_client_t *con)	/* I - Client connection */
+{
+  http_state_t	state = httpGetState(con->http);
+					/* Current HTTP state */
+
+
+  if (con->doc_fd >= 0)
+    return (1);				/* Copying a passed document */
+
+  return (httpGetReady(con->http) > 0 && state != HTTP_STATE_GET_SEND &&
+          state != HTTP_STATE_POST_SEND && state != HTTP_STATE_STATUS);
+}
+
+
 /*
  * 'parent_handler()' - Catch USR1/CHLD signals...
  */
@@ -1395,6 +1611,9 @@ process_children(void)
   int		i;			/* Looping var */
   char		name[1024];		/* Process name */
   const char	*type;			/* Type of program */
+#ifdef HAVE_WAIT3
+  struct rusage	usage;			/* Resource usage of child */
+#endif /* HAVE_WAIT3 */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "process_children()");
@@ -1406,13 +1625,13 @@ process_children(void)
   dead_children = 0;
 
  /*
-  * Collect the exit status of some children...
+  * Collect the exit status and resource usage of some children...
   */
 
-#ifdef HAVE_WAITPID
+#ifdef HAVE_WAIT3
+  while ((pid = wait3(&status, WNOHANG, &usage)) > 0)
+#elif defined(HAVE_WAITPID)
   while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
-#elif defined(HAVE_WAIT3)
-  while ((pid = wait3(&status, WNOHANG, NULL)) > 0)
 #else
   if ((pid = wait(&status)) > 0)
 #endif /* HAVE_WAITPID */
@@ -1462,6 +1681,12 @@ process_children(void)
 	  type         = "Backend";
 	}
 
+#ifdef HAVE_WAIT3
+        cupsdUpdateJobUsage(job, pid, &usage);
+#else
+        cupsdUpdateJobUsage(job, pid, NULL);
+#endif /* HAVE_WAIT3 */
+
 	if (status && status != SIGTERM && status != SIGKILL &&
 	    status != SIGPIPE)
 	{
@@ -1550,6 +1775,19 @@ process_children(void)
 	  if (!job->filters[i] && job->backend <= 0)
 	    cupsArrayRemove(ActiveJobs, job);
 	}
+	else if (job->prerender == CUPSD_PRERENDER_RUNNING)
+	{
+	  for (i = 0; job->filters[i] < 0; i ++);
+
+	  if (!job->filters[i])
+	  {
+	   /*
+	    * All of the pre-rendering filters are done...
+	    */
+
+	    cupsdFinishPrerender(job);
+	  }
+	}
 	else if (job->current_file < job->num_files && job->printer)
 	{
 	  for (i = 0; job->filters[i] < 0; i ++);
@@ -1634,6 +1872,7 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
   time_t		now;		/* Current time */
   cupsd_client_t	*con;		/* Client information */
   cupsd_job_t		*job;		/* Job information */
+  time_t		expire;		/* Next subscription expiration */
   const char		*why;		/* Debugging aid */
 
 
@@ -1648,7 +1887,7 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
   for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
        con;
        con = (cupsd_client_t *)cupsArrayNext(Clients))
-    if (httpGetReady(con->http))
+    if (client_has_request(con))
       return (0);
 
  /*
@@ -1702,12 +1941,45 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
   for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
        con;
        con = (cupsd_client_t *)cupsArrayNext(Clients))
+  {
     if ((httpGetActivity(con->http) + Timeout) < timeout)
     {
       timeout = httpGetActivity(con->http) + Timeout;
       why     = "timeout a client connection";
     }
 
+#ifdef HAVE_SSL
+    if (con->tls_timeout && con->tls_timeout < timeout)
+    {
+      timeout = con->tls_timeout;
+      why     = "timeout a TLS handshake";
+    }
+#endif /* HAVE_SSL */
+  }
+
+ /*
+  * Check for Get-Notifications requests that are done waiting...
+  */
+
+  for (con = (cupsd_client_t *)cupsArrayFirst(NotifyWaiters);
+       con;
+       con = (cupsd_client_t *)cupsArrayNext(NotifyWaiters))
+    if (con->notify_wait < timeout)
+    {
+      timeout = con->notify_wait;
+      why     = "answer a waiting Get-Notifications request";
+    }
+
+ /*
+  * Expire old jobs and job files...
+  */
+
+  if (JobHistoryUpdate && timeout > JobHistoryUpdate)
+  {
+    timeout = JobHistoryUpdate;
+    why     = "clean job history";
+  }
+
  /*
   * Write out changes to configuration and state files...
   */
@@ -1719,36 +1991,60 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
   }
 
  /*
-  * Check for any job activity...
+  * Expire subscriptions...  Leases are sorted by expiration time so we only
+  * need to look at the first one...
   */
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+  if ((expire = cupsdGetSubscriptionExpiration()) != 0 && timeout > expire)
   {
-    if (job->cancel_time && job->cancel_time < timeout)
-    {
-      timeout = job->cancel_time;
-      why     = "cancel stuck jobs";
-    }
+    timeout = expire;
+    why     = "expire subscriptions";
+  }
 
-    if (job->kill_time && job->kill_time < timeout)
-    {
-      timeout = job->kill_time;
-      why     = "kill unresponsive jobs";
-    }
+#if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
+ /*
+  * Register pending DNS-SD printers...
+  */
 
-    if (job->state_value == IPP_JOB_HELD && job->hold_until < timeout)
-    {
-      timeout = job->hold_until;
-      why     = "release held jobs";
-    }
+  if (DNSSDRegisterTime && timeout > DNSSDRegisterTime)
+  {
+    timeout = DNSSDRegisterTime;
+    why     = "register pending DNS-SD printers";
+  }
+#endif /* HAVE_DNSSD || HAVE_AVAHI */
 
-    if (job->state_value == IPP_JOB_PENDING && timeout > (now + 10))
+ /*
+  * Check for any job activity...  JobTimeouts is sorted by deadline so we only
+  * need to look at the first job...
+  */
+
+  if ((job = (cupsd_job_t *)cupsArrayFirst(JobTimeouts)) != NULL &&
+      job->timeout_time < timeout)
+  {
+    timeout = job->timeout_time;
+
+    if (job->kill_time == timeout)
+      why = "kill unresponsive jobs";
+    else if (job->cancel_time == timeout)
+      why = "cancel stuck jobs";
+    else
+      why = "release held jobs";
+  }
+
+  if (timeout > (now + 10))
+  {
+    cupsd_jobq_t	*queue;		/* Pending job queue */
+
+    for (queue = (cupsd_jobq_t *)cupsArrayFirst(ReadyQueues);
+	 queue;
+	 queue = (cupsd_jobq_t *)cupsArrayNext(ReadyQueues))
     {
-      timeout = now + 10;
-      why     = "start pending jobs";
-      break;
+      if (cupsArrayCount(queue->jobs) > 0)
+      {
+	timeout = now + 10;
+	why     = "start pending jobs";
+	break;
+      }
     }
   }
 
@@ -1811,7 +2107,9 @@ sighup_handler(int sig)			/* I - Signal number */
 {
   (void)sig;
 
-  NeedReload = RELOAD_ALL;
+  if (NeedReload != RELOAD_ALL)
+    NeedReload = RELOAD_SIGNAL;
+
   ReloadTime = time(NULL);
 
 #if !defined(HAVE_SIGSET) && !defined(HAVE_SIGACTION)
@@ -2121,6 +2419,197 @@ service_checkout(int shutdown)          /* I - Shutting down? */
 }
 
 
+/*
+ * 'sigusr1_handler()' - Handle user signals that log the memory usage.
+ */
+
+static void
+sigusr1_handler(int sig)		/* I - Signal number */
+{
+  (void)sig;
+
+  need_memory_report = 1;
+
+#if !defined(HAVE_SIGSET) && !defined(HAVE_SIGACTION)
+  signal(SIGUSR1, sigusr1_handler);
+#endif /* !HAVE_SIGSET && !HAVE_SIGACTION */
+}
+
+
+/*
+ * 'sigusr2_handler()' - Handle user signals that upgrade the scheduler.
+ */
+
+static void
+sigusr2_handler(int sig)		/* I - Signal number */
+{
+  (void)sig;
+
+  need_upgrade = 1;
+  ReloadTime   = time(NULL);
+
+#if !defined(HAVE_SIGSET) && !defined(HAVE_SIGACTION)
+  signal(SIGUSR2, sigusr2_handler);
+#endif /* !HAVE_SIGSET && !HAVE_SIGACTION */
+}
+
+
+/*
+ * 'upgrade_checkin()' - Load the state handed off by the old scheduler.
+ */
+
+static void
+upgrade_checkin(const char *filename)	/* I - Upgrade state file */
+{
+  cups_file_t	*fp;			/* Upgrade state file */
+  char		line[2 * CUPSD_SB_BUFFER_SIZE + 1024],
+					/* Line from file */
+		*value;			/* Value on line */
+  int		linenum = 0,		/* Current line number */
+		pid,			/* Process ID */
+		job_id;			/* Job ID */
+
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open upgrade state file \"%s\": %s", filename, strerror(errno));
+    return;
+  }
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Continuing after scheduler upgrade.");
+
+  while (cupsFileGets(fp, line, sizeof(line)))
+  {
+    linenum ++;
+
+    if ((value = strchr(line, ' ')) != NULL)
+      *value++ = '\0';
+
+    if (!value)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Missing value on line %d of %s.", linenum, filename);
+    }
+    else if (!strcmp(line, "Listener"))
+    {
+      cupsdAdoptListener(atoi(value));
+    }
+    else if (!strcmp(line, "Job"))
+    {
+      cupsdAdoptJob(value);
+    }
+    else if (!strcmp(line, "Process"))
+    {
+      pid    = (int)strtol(value, &value, 10);
+      job_id = (int)strtol(value, &value, 10);
+
+      while (*value == ' ')
+        value ++;
+
+      if (pid > 0)
+        cupsdAdoptProcess(pid, job_id, value);
+    }
+    else
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unknown directive %s on line %d of %s.", line, linenum, filename);
+  }
+
+  cupsFileClose(fp);
+  unlink(filename);
+
+ /*
+  * Children may have exited while the new scheduler was starting...
+  */
+
+  dead_children = 1;
+}
+
+
+/*
+ * 'upgrade_server()' - Replace the scheduler with a new copy of the program.
+ *
+ * The listening sockets and the pipes of printing jobs stay open across the
+ * exec, and the filter and backend processes remain children of the
+ * scheduler.  Only returns if the new program could not be run.
+ */
+
+static void
+upgrade_server(const char *command)	/* I - Scheduler program */
+{
+  int		fd;			/* Looping var */
+  cups_file_t	*fp;			/* Upgrade state file */
+  char		filename[1024];		/* Upgrade state filename */
+
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Upgrading scheduler using \"%s\".", command);
+
+  cupsdCloseAllClients();
+
+  if ((upgrade_fds = calloc((size_t)MaxFDs, 1)) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to upgrade scheduler: %s", strerror(errno));
+    return;
+  }
+
+ /*
+  * Save the state that the new scheduler needs to continue...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/cupsd.upgrade", StateDir);
+
+  if ((fp = cupsFileOpen(filename, "w")) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create upgrade state file \"%s\": %s", filename, strerror(errno));
+    free(upgrade_fds);
+    upgrade_fds = NULL;
+    return;
+  }
+
+  fchmod(cupsFileNumber(fp), 0600);
+
+  cupsdHandoffListeners(fp);
+  cupsdHandoffJobs(fp);
+  cupsdHandoffProcesses(fp);
+
+  if (cupsFileClose(fp))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write upgrade state file \"%s\": %s", filename, strerror(errno));
+    unlink(filename);
+    free(upgrade_fds);
+    upgrade_fds = NULL;
+    return;
+  }
+
+  cupsdCleanDirty();
+
+ /*
+  * Close everything else on exec...
+  */
+
+  for (fd = 3; fd < MaxFDs; fd ++)
+  {
+    if (upgrade_fds[fd])
+      fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) & ~FD_CLOEXEC);
+    else
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  execlp(command, command, "-c", ConfigurationFile, "-s", CupsFilesFile, "-U", filename, (char *)0);
+
+ /*
+  * If we get here the upgrade failed, so keep going with this scheduler...
+  */
+
+  cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to run \"%s\": %s", command, strerror(errno));
+
+  for (fd = 3; fd < MaxFDs; fd ++)
+    if (upgrade_fds[fd])
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  unlink(filename);
+  free(upgrade_fds);
+  upgrade_fds = NULL;
+}
+
+
 /*
  * 'usage()' - Show scheduler usage.
  */
@@ -0,0 +1,622 @@
+/*
+ * Metrics for the CUPS scheduler.
+ *
+ * Copyright © 2020 by Apple Inc.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cupsd.h"
+
+
+/*
+ * Local constants...
+ */
+
+#define CUPSD_METRIC_BUCKETS	8	/* Number of latency buckets */
+#define CUPSD_METRIC_FILES	6	/* Number of dirty file types */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_mbuffer_s		/**** Metrics text buffer ****/
+{
+  char		*data;			/* Text */
+  size_t	length,			/* Length of text */
+		size;			/* Size of buffer */
+} cupsd_mbuffer_t;
+
+typedef struct cupsd_opmetric_s		/**** IPP operation metrics ****/
+{
+  ipp_op_t	op;			/* Operation code */
+  unsigned	count,			/* Number of requests */
+		buckets[CUPSD_METRIC_BUCKETS];
+					/* Requests per latency bucket */
+  double	secs;			/* Total processing time */
+} cupsd_opmetric_t;
+
+typedef struct cupsd_destmetric_s	/**** Job counts for a destination ****/
+{
+  const char	*dest;			/* Destination name */
+  int		pending,		/* Pending jobs */
+		held,			/* Held jobs */
+		processing,		/* Processing jobs */
+		stopped;		/* Stopped jobs */
+} cupsd_destmetric_t;
+
+
+/*
+ * Local globals...
+ */
+
+static const double	op_buckets[CUPSD_METRIC_BUCKETS - 1] =
+			{			/* Latency bucket limits */
+			  0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0
+			};
+static cups_array_t	*op_metrics = NULL;
+					/* IPP operation metrics */
+static const char * const file_names[CUPSD_METRIC_FILES] =
+			{			/* Dirty file names */
+			  "printers", "classes", "printcap", "jobs",
+			  "subscriptions", "quotas"
+			};
+static unsigned		file_writes[CUPSD_METRIC_FILES];
+					/* Number of dirty file writes */
+static double		file_secs[CUPSD_METRIC_FILES];
+					/* Time spent writing dirty files */
+static const char * const mem_names[CUPSD_MEM_MAX] =
+			{			/* Memory subsystem names */
+			  "clients", "jobs", "printers", "strings",
+			  "subscriptions"
+			};
+static unsigned		backend_starts = 0,
+					/* Number of backends started */
+			filter_starts = 0;
+					/* Number of filters started */
+
+
+/*
+ * Local functions...
+ */
+
+static int	compare_dest_metrics(cupsd_destmetric_t *a,
+		                     cupsd_destmetric_t *b);
+static int	compare_op_metrics(cupsd_opmetric_t *a, cupsd_opmetric_t *b);
+static int	compare_pointers(void *a, void *b);
+static void	mbuffer_printf(cupsd_mbuffer_t *mb, const char *format, ...)
+		_CUPS_FORMAT(2, 3);
+
+
+/*
+ * 'cupsdAddFileMetric()' - Record the time spent writing a dirty file.
+ */
+
+void
+cupsdAddFileMetric(
+    int            what,		/* I - CUPSD_DIRTY_xxx value */
+    struct timeval *start)		/* I - Start of write */
+{
+  int			i;		/* Looping var */
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  for (i = 0; i < CUPSD_METRIC_FILES; i ++)
+    if (what == (1 << i))
+    {
+      file_writes[i] ++;
+      file_secs[i] += cupsdElapsedTime(start, &curtime);
+      break;
+    }
+}
+
+
+/*
+ * 'cupsdAddIPPMetric()' - Record the processing time of an IPP request.
+ */
+
+void
+cupsdAddIPPMetric(ipp_op_t op,		/* I - Operation code */
+                  double   secs)	/* I - Processing time in seconds */
+{
+  int			i;		/* Looping var */
+  cupsd_opmetric_t	key,		/* Search key */
+			*metric;	/* Operation metrics */
+
+
+  if (!op_metrics)
+    op_metrics = cupsArrayNew((cups_array_func_t)compare_op_metrics, NULL);
+
+  key.op = op;
+
+  if ((metric = (cupsd_opmetric_t *)cupsArrayFind(op_metrics, &key)) == NULL)
+  {
+    if ((metric = calloc(1, sizeof(cupsd_opmetric_t))) == NULL)
+      return;
+
+    metric->op = op;
+    cupsArrayAdd(op_metrics, metric);
+  }
+
+  for (i = 0; i < (CUPSD_METRIC_BUCKETS - 1); i ++)
+    if (secs <= op_buckets[i])
+      break;
+
+  metric->count ++;
+  metric->buckets[i] ++;
+  metric->secs += secs;
+}
+
+
+/*
+ * 'cupsdAddProcessMetric()' - Record the start of a filter or backend.
+ */
+
+void
+cupsdAddProcessMetric(int backend)	/* I - 1 for a backend, 0 for a filter */
+{
+  if (backend)
+    backend_starts ++;
+  else
+    filter_starts ++;
+}
+
+
+/*
+ * 'cupsdGetMemoryUsage()' - Get the estimated memory usage by subsystem.
+ *
+ * Object sizes come from the slab allocator counters and string pool
+ * statistics, while attribute and buffer sizes are summed from the live
+ * objects so that nothing needs to be counted when they change.  The "usage"
+ * array must hold CUPSD_MEM_MAX elements.
+ */
+
+void
+cupsdGetMemoryUsage(
+    cupsd_memusage_t *usage)		/* O - Memory usage by subsystem */
+{
+  cupsd_memtype_t	type;		/* Current subsystem */
+  int			used,		/* Objects in use */
+			num_free;	/* Objects on free list */
+  size_t		bytes;		/* Slab or pool bytes */
+  cupsd_client_t	*con;		/* Current client */
+  cupsd_job_t		*job;		/* Current job */
+  cupsd_jobrec_t	*rec;		/* Current compact job */
+  cupsd_printer_t	*p;		/* Current printer */
+  cupsd_attrcache_t	*cache;		/* Cached printer attributes */
+  cupsd_subscription_t	*sub;		/* Current subscription */
+  cupsd_event_t		*event;		/* Current event */
+  cups_array_t		*shared;	/* Shared event attributes */
+
+
+  memset(usage, 0, CUPSD_MEM_MAX * sizeof(cupsd_memusage_t));
+
+  for (type = CUPSD_MEM_CLIENTS; type < CUPSD_MEM_MAX; type ++)
+    usage[type].name = mem_names[type];
+
+ /*
+  * Clients...
+  */
+
+  cupsdSlabStatistics(CUPSD_SLAB_CLIENT, &used, &num_free, &bytes);
+
+  usage[CUPSD_MEM_CLIENTS].count = cupsArrayCount(Clients);
+  usage[CUPSD_MEM_CLIENTS].bytes = bytes + _httpMemoryUsage(NULL);
+
+  for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
+       con;
+       con = (cupsd_client_t *)cupsArrayNext(Clients))
+    usage[CUPSD_MEM_CLIENTS].bytes += _httpMemoryUsage(con->http) + _ippMemoryUsage(con->request) + _ippMemoryUsage(con->response);
+
+ /*
+  * Jobs, including the compact records of completed jobs...
+  */
+
+  cupsdSlabStatistics(CUPSD_SLAB_JOB, &used, &num_free, &bytes);
+
+  usage[CUPSD_MEM_JOBS].count = cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs);
+  usage[CUPSD_MEM_JOBS].bytes = bytes;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+    usage[CUPSD_MEM_JOBS].bytes += _ippMemoryUsage(job->attrs);
+
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+    usage[CUPSD_MEM_JOBS].bytes += sizeof(cupsd_jobrec_t) + (size_t)rec->num_files * (sizeof(mime_type_t *) + sizeof(int));
+
+ /*
+  * Printers and classes...
+  */
+
+  usage[CUPSD_MEM_PRINTERS].count = cupsArrayCount(Printers);
+  usage[CUPSD_MEM_PRINTERS].bytes = _ippMemoryUsage(CommonData);
+
+  for (p = (cupsd_printer_t *)cupsArrayFirst(Printers);
+       p;
+       p = (cupsd_printer_t *)cupsArrayNext(Printers))
+  {
+    usage[CUPSD_MEM_PRINTERS].bytes += sizeof(cupsd_printer_t) + _ippMemoryUsage(p->attrs) + _ippMemoryUsage(p->ppd_attrs);
+
+    for (cache = (cupsd_attrcache_t *)cupsArrayFirst(p->attr_cache);
+         cache;
+	 cache = (cupsd_attrcache_t *)cupsArrayNext(p->attr_cache))
+      usage[CUPSD_MEM_PRINTERS].bytes += sizeof(cupsd_attrcache_t) + _ippMemoryUsage(cache->attrs);
+  }
+
+ /*
+  * Subscriptions and their cached events, counting shared event attributes
+  * once...
+  */
+
+  cupsdSlabStatistics(CUPSD_SLAB_EVENT, &used, &num_free, &bytes);
+
+  usage[CUPSD_MEM_SUBSCRIPTIONS].count = cupsArrayCount(Subscriptions);
+  usage[CUPSD_MEM_SUBSCRIPTIONS].bytes = bytes;
+
+  shared = cupsArrayNew((cups_array_func_t)compare_pointers, NULL);
+
+  for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
+       sub;
+       sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+  {
+    usage[CUPSD_MEM_SUBSCRIPTIONS].bytes += sizeof(cupsd_subscription_t);
+
+    for (event = (cupsd_event_t *)cupsArrayFirst(sub->events);
+         event;
+	 event = (cupsd_event_t *)cupsArrayNext(sub->events))
+    {
+      usage[CUPSD_MEM_SUBSCRIPTIONS].bytes += _ippMemoryUsage(event->attrs);
+
+      if (event->shared_attrs && !cupsArrayFind(shared, event->shared_attrs))
+      {
+        cupsArrayAdd(shared, event->shared_attrs);
+        usage[CUPSD_MEM_SUBSCRIPTIONS].bytes += _ippMemoryUsage(event->shared_attrs);
+      }
+    }
+  }
+
+  cupsArrayDelete(shared);
+
+ /*
+  * String pool...
+  */
+
+  usage[CUPSD_MEM_STRINGS].count = (int)_cupsStrStatistics(&bytes, NULL);
+  usage[CUPSD_MEM_STRINGS].bytes = bytes;
+}
+
+
+/*
+ * 'cupsdGetMetrics()' - Get the current metrics in Prometheus text format.
+ *
+ * The returned string must be freed using free().
+ */
+
+char *					/* O - Metrics text or NULL on error */
+cupsdGetMetrics(size_t *length)		/* O - Length of text */
+{
+  int			i,		/* Looping var */
+			events,		/* Cached events */
+			max_events;	/* Most events for one subscription */
+  unsigned		total;		/* Cumulative bucket count */
+  cupsd_mbuffer_t	mb;		/* Metrics buffer */
+  cups_array_t		*dests;		/* Job counts by destination */
+  cupsd_destmetric_t	key,		/* Search key */
+			*dest;		/* Job counts for destination */
+  cupsd_job_t		*job;		/* Current job */
+  cupsd_printer_t	*p;		/* Current printer */
+  cupsd_subscription_t	*sub;		/* Current subscription */
+  cupsd_opmetric_t	*metric;	/* Current operation metrics */
+  cupsd_memtype_t	type;		/* Current memory subsystem */
+  cupsd_memusage_t	usage[CUPSD_MEM_MAX];
+					/* Memory usage by subsystem */
+
+
+  memset(&mb, 0, sizeof(mb));
+
+ /*
+  * Count active jobs by destination and state...
+  */
+
+  dests = cupsArrayNew3((cups_array_func_t)compare_dest_metrics, NULL, NULL, 0,
+                        NULL, (cups_afree_func_t)free);
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+  {
+    if (!job->dest)
+      continue;
+
+    key.dest = job->dest;
+
+    if ((dest = (cupsd_destmetric_t *)cupsArrayFind(dests, &key)) == NULL)
+    {
+      if ((dest = calloc(1, sizeof(cupsd_destmetric_t))) == NULL)
+        continue;
+
+      dest->dest = job->dest;
+      cupsArrayAdd(dests, dest);
+    }
+
+    switch (job->state_value)
+    {
+      case IPP_JSTATE_PENDING :
+          dest->pending ++;
+	  break;
+      case IPP_JSTATE_HELD :
+          dest->held ++;
+	  break;
+      case IPP_JSTATE_PROCESSING :
+          dest->processing ++;
+	  break;
+      case IPP_JSTATE_STOPPED :
+          dest->stopped ++;
+	  break;
+      default :
+          break;
+    }
+  }
+
+  mbuffer_printf(&mb, "# HELP cupsd_jobs Active jobs by printer and state.\n"
+                      "# TYPE cupsd_jobs gauge\n");
+
+  for (p = (cupsd_printer_t *)cupsArrayFirst(Printers);
+       p;
+       p = (cupsd_printer_t *)cupsArrayNext(Printers))
+  {
+    key.dest = p->name;
+    dest     = (cupsd_destmetric_t *)cupsArrayFind(dests, &key);
+
+    mbuffer_printf(&mb, "cupsd_jobs{printer=\"%s\",state=\"pending\"} %d\n", p->name, dest ? dest->pending : 0);
+    mbuffer_printf(&mb, "cupsd_jobs{printer=\"%s\",state=\"held\"} %d\n", p->name, dest ? dest->held : 0);
+    mbuffer_printf(&mb, "cupsd_jobs{printer=\"%s\",state=\"processing\"} %d\n", p->name, dest ? dest->processing : 0);
+    mbuffer_printf(&mb, "cupsd_jobs{printer=\"%s\",state=\"stopped\"} %d\n", p->name, dest ? dest->stopped : 0);
+  }
+
+  cupsArrayDelete(dests);
+
+  mbuffer_printf(&mb, "# HELP cupsd_completed_jobs Completed jobs kept in the job history.\n"
+                      "# TYPE cupsd_completed_jobs gauge\n"
+                      "cupsd_completed_jobs %d\n",
+                 cupsArrayCount(Jobs) + cupsArrayCount(CompactJobs) - cupsArrayCount(ActiveJobs));
+
+ /*
+  * IPP operations...
+  */
+
+  mbuffer_printf(&mb, "# HELP cupsd_ipp_request_seconds IPP request processing time by operation.\n"
+                      "# TYPE cupsd_ipp_request_seconds histogram\n");
+
+  for (metric = (cupsd_opmetric_t *)cupsArrayFirst(op_metrics);
+       metric;
+       metric = (cupsd_opmetric_t *)cupsArrayNext(op_metrics))
+  {
+    const char *opname = ippOpString(metric->op);
+					/* Operation name */
+
+    for (i = 0, total = 0; i < (CUPSD_METRIC_BUCKETS - 1); i ++)
+    {
+      total += metric->buckets[i];
+      mbuffer_printf(&mb, "cupsd_ipp_request_seconds_bucket{operation=\"%s\",le=\"%g\"} %u\n", opname, op_buckets[i], total);
+    }
+
+    mbuffer_printf(&mb, "cupsd_ipp_request_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %u\n", opname, metric->count);
+    mbuffer_printf(&mb, "cupsd_ipp_request_seconds_sum{operation=\"%s\"} %.6f\n", opname, metric->secs);
+    mbuffer_printf(&mb, "cupsd_ipp_request_seconds_count{operation=\"%s\"} %u\n", opname, metric->count);
+  }
+
+ /*
+  * Clients, file descriptors, and events...
+  */
+
+  for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions), events = 0, max_events = 0;
+       sub;
+       sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+  {
+    i = cupsArrayCount(sub->events);
+
+    events += i;
+    if (i > max_events)
+      max_events = i;
+  }
+
+  mbuffer_printf(&mb, "# HELP cupsd_clients Open client connections.\n"
+                      "# TYPE cupsd_clients gauge\n"
+                      "cupsd_clients %d\n"
+                      "# HELP cupsd_select_fds File descriptors being monitored.\n"
+                      "# TYPE cupsd_select_fds gauge\n"
+                      "cupsd_select_fds %d\n"
+                      "# HELP cupsd_subscriptions Active subscriptions.\n"
+                      "# TYPE cupsd_subscriptions gauge\n"
+                      "cupsd_subscriptions %d\n"
+                      "# HELP cupsd_subscription_events Events queued for all subscriptions.\n"
+                      "# TYPE cupsd_subscription_events gauge\n"
+                      "cupsd_subscription_events %d\n"
+                      "# HELP cupsd_subscription_events_max Most events queued for one subscription.\n"
+                      "# TYPE cupsd_subscription_events_max gauge\n"
+                      "cupsd_subscription_events_max %d\n",
+                 cupsArrayCount(Clients), cupsdGetSelectCount(),
+                 cupsArrayCount(Subscriptions), events, max_events);
+
+ /*
+  * Filters and backends...
+  */
+
+  mbuffer_printf(&mb, "# HELP cupsd_process_starts_total Job filters and backends started.\n"
+                      "# TYPE cupsd_process_starts_total counter\n"
+                      "cupsd_process_starts_total{type=\"filter\"} %u\n"
+                      "cupsd_process_starts_total{type=\"backend\"} %u\n",
+                 filter_starts, backend_starts);
+
+ /*
+  * Memory usage...
+  */
+
+  cupsdGetMemoryUsage(usage);
+
+  mbuffer_printf(&mb, "# HELP cupsd_memory_objects Objects allocated by subsystem.\n"
+                      "# TYPE cupsd_memory_objects gauge\n");
+
+  for (type = CUPSD_MEM_CLIENTS; type < CUPSD_MEM_MAX; type ++)
+    mbuffer_printf(&mb, "cupsd_memory_objects{subsystem=\"%s\"} %d\n", usage[type].name, usage[type].count);
+
+  mbuffer_printf(&mb, "# HELP cupsd_memory_bytes Estimated memory used by subsystem.\n"
+                      "# TYPE cupsd_memory_bytes gauge\n");
+
+  for (type = CUPSD_MEM_CLIENTS; type < CUPSD_MEM_MAX; type ++)
+    mbuffer_printf(&mb, "cupsd_memory_bytes{subsystem=\"%s\"} " CUPS_LLFMT "\n", usage[type].name, CUPS_LLCAST usage[type].bytes);
+
+ /*
+  * Dirty file writes...
+  */
+
+  mbuffer_printf(&mb, "# HELP cupsd_file_writes_total State and configuration file writes.\n"
+                      "# TYPE cupsd_file_writes_total counter\n");
+
+  for (i = 0; i < CUPSD_METRIC_FILES; i ++)
+    mbuffer_printf(&mb, "cupsd_file_writes_total{file=\"%s\"} %u\n", file_names[i], file_writes[i]);
+
+  mbuffer_printf(&mb, "# HELP cupsd_file_write_seconds_total Time spent writing state and configuration files.\n"
+                      "# TYPE cupsd_file_write_seconds_total counter\n");
+
+  for (i = 0; i < CUPSD_METRIC_FILES; i ++)
+    mbuffer_printf(&mb, "cupsd_file_write_seconds_total{file=\"%s\"} %.6f\n", file_names[i], file_secs[i]);
+
+  if (!mb.data)
+    return (NULL);
+
+  *length = mb.length;
+
+  return (mb.data);
+}
+
+
+/*
+ * 'cupsdLogMemoryUsage()' - Log the estimated memory usage by subsystem.
+ */
+
+void
+cupsdLogMemoryUsage(void)
+{
+  cupsd_memtype_t	type;		/* Current subsystem */
+  cupsd_memusage_t	usage[CUPSD_MEM_MAX];
+					/* Memory usage by subsystem */
+  size_t		total = 0;	/* Total bytes */
+
+
+  cupsdGetMemoryUsage(usage);
+
+  for (type = CUPSD_MEM_CLIENTS; type < CUPSD_MEM_MAX; type ++)
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO, "Memory usage: %s count=%d bytes=" CUPS_LLFMT, usage[type].name, usage[type].count, CUPS_LLCAST usage[type].bytes);
+
+    total += usage[type].bytes;
+  }
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Memory usage: total bytes=" CUPS_LLFMT, CUPS_LLCAST total);
+}
+
+
+/*
+ * 'compare_dest_metrics()' - Compare two destination job counts.
+ */
+
+static int				/* O - Result of comparison */
+compare_dest_metrics(
+    cupsd_destmetric_t *a,		/* I - First destination */
+    cupsd_destmetric_t *b)		/* I - Second destination */
+{
+  return (_cups_strcasecmp(a->dest, b->dest));
+}
+
+
+/*
+ * 'compare_op_metrics()' - Compare two IPP operation metrics.
+ */
+
+static int				/* O - Result of comparison */
+compare_op_metrics(cupsd_opmetric_t *a,	/* I - First operation */
+                   cupsd_opmetric_t *b)	/* I - Second operation */
+{
+  return ((int)a->op - (int)b->op);
+}
+
+
+/*
+ * 'compare_pointers()' - Compare two pointers.
+ */
+
+static int				/* O - Result of comparison */
+compare_pointers(void *a,		/* I - First pointer */
+                 void *b)		/* I - Second pointer */
+{
+  return (a < b ? -1 : a > b);
+}
+
+
+/*
+ * 'mbuffer_printf()' - Append formatted text to a metrics buffer.
+ *
+ * On allocation failure the buffer is freed and later calls do nothing.
+ */
+
+static void
+mbuffer_printf(cupsd_mbuffer_t *mb,	/* I - Metrics buffer */
+               const char      *format,	/* I - Printf-style format string */
+	       ...)			/* I - Additional arguments as needed */
+{
+  va_list	ap;			/* Argument pointer */
+  int		bytes;			/* Formatted length */
+  char		*temp;			/* New buffer */
+
+
+  if (!mb->data)
+  {
+    if (mb->size)
+      return;
+
+    if ((mb->data = malloc(8192)) == NULL)
+    {
+      mb->size = 1;
+      return;
+    }
+
+    mb->size = 8192;
+  }
+
+  for (;;)
+  {
+    va_start(ap, format);
+    bytes = vsnprintf(mb->data + mb->length, mb->size - mb->length, format, ap);
+    va_end(ap);
+
+    if (bytes < 0)
+      return;
+
+    if ((size_t)bytes < (mb->size - mb->length))
+      break;
+
+    if ((temp = realloc(mb->data, 2 * mb->size + (size_t)bytes)) == NULL)
+    {
+      free(mb->data);
+      mb->data = NULL;
+      return;
+    }
+
+    mb->data = temp;
+    mb->size = 2 * mb->size + (size_t)bytes;
+  }
+
+  mb->length += (size_t)bytes;
+}
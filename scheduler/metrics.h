@@ -0,0 +1,46 @@
+/*
+ * Metrics definitions for the CUPS scheduler.
+ *
+ * Copyright © 2020 by Apple Inc.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ */
+
+
+/*
+ * Memory accounting subsystems...
+ */
+
+typedef enum cupsd_memtype_e		/**** Memory accounting subsystems ****/
+{
+  CUPSD_MEM_CLIENTS,			/* Client connections and requests */
+  CUPSD_MEM_JOBS,			/* Jobs and job attributes */
+  CUPSD_MEM_PRINTERS,			/* Printers, classes, and attributes */
+  CUPSD_MEM_STRINGS,			/* Shared string pool */
+  CUPSD_MEM_SUBSCRIPTIONS,		/* Subscriptions and cached events */
+  CUPSD_MEM_MAX				/* Number of subsystems */
+} cupsd_memtype_t;
+
+
+/*
+ * Memory usage for a subsystem...
+ */
+
+typedef struct cupsd_memusage_s		/**** Memory usage ****/
+{
+  const char	*name;			/* Subsystem name */
+  int		count;			/* Number of objects */
+  size_t	bytes;			/* Estimated bytes used */
+} cupsd_memusage_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern void		cupsdAddFileMetric(int what, struct timeval *start);
+extern void		cupsdAddIPPMetric(ipp_op_t op, double secs);
+extern void		cupsdAddProcessMetric(int backend);
+extern void		cupsdGetMemoryUsage(cupsd_memusage_t *usage);
+extern char		*cupsdGetMetrics(size_t *length);
+extern void		cupsdLogMemoryUsage(void);
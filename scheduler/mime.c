@@ -14,6 +14,8 @@
 #include <cups/string-private.h>
 #include <cups/dir.h>
 #include "mime-private.h"
+#include <fcntl.h>
+#include <sys/stat.h>
 
 
 /*
@@ -24,6 +26,14 @@
 #define DEBUG_printf(...)
 
 
+/*
+ * Local constants...
+ */
+
+#define MIME_CACHE_VERSION	1	/* Compiled cache file version */
+#define MIME_CACHE_MAXSIZE	16777216/* Maximum size of a cache file */
+
+
 /*
  * Local types...
  */
@@ -34,6 +44,14 @@ typedef struct _mime_fcache_s		/**** Filter cache structure ****/
 	*path;				/* Full path to filter if available */
 } _mime_fcache_t;
 
+typedef struct _mime_cbuf_s		/**** Compiled cache buffer ****/
+{
+  char	*data,				/* Start of buffer */
+	*ptr,				/* Current position in buffer */
+	*end;				/* End of buffer */
+  int	error;				/* Non-zero on bad data or no memory */
+} _mime_cbuf_t;
+
 
 /*
  * Local functions...
@@ -41,6 +59,23 @@ typedef struct _mime_fcache_s		/**** Filter cache structure ****/
 
 static const char *mime_add_fcache(cups_array_t *filtercache, const char *name,
 		                   const char *filterpath);
+static void	mime_cache_get(_mime_cbuf_t *buf, void *data, size_t len);
+static long long mime_cache_get_int(_mime_cbuf_t *buf);
+static mime_magic_t *mime_cache_get_rules(_mime_cbuf_t *buf,
+			                  mime_magic_t *parent, int depth);
+static const char *mime_cache_get_string(_mime_cbuf_t *buf);
+static mime_t	*mime_cache_load(const char *cachefile, const char *pathname,
+		                 const char *filterpath);
+static void	mime_cache_put(_mime_cbuf_t *buf, const void *data,
+		               size_t len);
+static void	mime_cache_put_int(_mime_cbuf_t *buf, long long value);
+static void	mime_cache_put_rules(_mime_cbuf_t *buf, mime_magic_t *rules);
+static void	mime_cache_put_stamp(_mime_cbuf_t *buf, const char *filename);
+static void	mime_cache_put_stamps(_mime_cbuf_t *buf, const char *pathname,
+		                      const char *filterpath);
+static void	mime_cache_put_string(_mime_cbuf_t *buf, const char *s);
+static void	mime_cache_save(mime_t *mime, const char *cachefile,
+		                _mime_cbuf_t *buf);
 static int	mime_compare_fcache(_mime_fcache_t *a, _mime_fcache_t *b);
 static void	mime_delete_fcache(cups_array_t *filtercache);
 static void	mime_delete_rules(mime_magic_t *rules);
@@ -48,6 +83,8 @@ static void	mime_load_convs(mime_t *mime, const char *filename,
 		                const char *filterpath,
 			        cups_array_t *filtercache);
 static void	mime_load_types(mime_t *mime, const char *filename);
+static const char *mime_next_dir(const char *path, char *dir,
+		                 size_t dirsize);
 
 
 /*
@@ -91,6 +128,7 @@ mimeDelete(mime_t *mime)		/* I - MIME database */
   cupsArrayDelete(mime->types);
   cupsArrayDelete(mime->filters);
   cupsArrayDelete(mime->srcs);
+  cupsArrayDelete(mime->chains);
   free(mime);
 }
 
@@ -121,19 +159,15 @@ mimeDeleteFilter(mime_t        *mime,	/* I - MIME database */
 #endif /* DEBUG */
 
   cupsArrayRemove(mime->filters, filter);
+  cupsArrayRemove(mime->srcs, filter);
   free(filter);
 
  /*
-  * Deleting a filter invalidates the source lookup cache used by
-  * mimeFilter()...
+  * Deleting a filter invalidates the filter chains cached by mimeFilter()...
   */
 
-  if (mime->srcs)
-  {
-    DEBUG_puts("1mimeDeleteFilter: Deleting source lookup cache.");
-    cupsArrayDelete(mime->srcs);
-    mime->srcs = NULL;
-  }
+  cupsArrayDelete(mime->chains);
+  mime->chains = NULL;
 }
 
 
@@ -158,6 +192,12 @@ mimeDeleteType(mime_t      *mime,	/* I - MIME database */
 
   cupsArrayRemove(mime->types, mt);
 
+  cupsArrayDelete(mime->ftypes);
+  mime->ftypes = NULL;
+
+  cupsArrayDelete(mime->chains);
+  mime->chains = NULL;
+
   mime_delete_rules(mt->rules);
   free(mt);
 }
@@ -260,6 +300,96 @@ mimeLoad(const char *pathname,		/* I - Directory to load */
 }
 
 
+/*
+ * 'mimeLoadCached()' - Load types and filters using a compiled cache file.
+ *
+ * This function loads the .types and then the .convs files from each of the
+ * colon-delimited directories in "pathname", in order.  The resulting
+ * database is saved to "cachefile" and subsequent calls load it from there
+ * in a single read, without parsing any rules or looking up any filters,
+ * until one of the .types or .convs files or directories, or one of the
+ * filter directories, changes.
+ *
+ * The cache is only used when "mime" is @code NULL@ or empty.
+ */
+
+mime_t *				/* O - MIME database */
+mimeLoadCached(mime_t     *mime,	/* I - MIME database or @code NULL@ to create a new one */
+               const char *cachefile,	/* I - Cache file or @code NULL@ for none */
+               const char *pathname,	/* I - Directories to load from */
+               const char *filterpath)	/* I - Default filter program directory */
+{
+  mime_t	*cached;		/* Database from cache */
+  _mime_cbuf_t	buf;			/* Cache buffer */
+  const char	*ptr;			/* Pointer into pathname */
+  char		dir[1024];		/* Current directory */
+
+
+  DEBUG_printf(("mimeLoadCached(mime=%p, cachefile=\"%s\", pathname=\"%s\", "
+                "filterpath=\"%s\")", mime, cachefile, pathname, filterpath));
+
+  if (!pathname || !filterpath)
+    return (mime);
+
+  if (!mime && (mime = mimeNew()) == NULL)
+    return (NULL);
+
+  memset(&buf, 0, sizeof(buf));
+
+  if (cachefile && !mime->types && !mime->filters)
+  {
+   /*
+    * Try loading the cache, keeping the error callback of this database...
+    */
+
+    if ((cached = mime_cache_load(cachefile, pathname, filterpath)) != NULL)
+    {
+      DEBUG_printf(("1mimeLoadCached: Loaded \"%s\".", cachefile));
+
+      mime->types   = cached->types;
+      mime->filters = cached->filters;
+      mime->srcs    = cached->srcs;
+      mime->ftypes  = cached->ftypes;
+      mime->chains  = cached->chains;
+
+      free(cached);
+
+      return (mime);
+    }
+
+   /*
+    * Stamp the files before loading them so that changes made while we are
+    * loading invalidate the new cache...
+    */
+
+    mime_cache_put_stamps(&buf, pathname, filterpath);
+  }
+  else
+    cachefile = NULL;
+
+ /*
+  * Load all types and then all filters...
+  */
+
+  for (ptr = mime_next_dir(pathname, dir, sizeof(dir));
+       ptr;
+       ptr = mime_next_dir(ptr, dir, sizeof(dir)))
+    mimeLoadTypes(mime, dir);
+
+  for (ptr = mime_next_dir(pathname, dir, sizeof(dir));
+       ptr;
+       ptr = mime_next_dir(ptr, dir, sizeof(dir)))
+    mimeLoadFilters(mime, dir, filterpath);
+
+  if (cachefile)
+    mime_cache_save(mime, cachefile, &buf);
+
+  free(buf.data);
+
+  return (mime);
+}
+
+
 /*
  * 'mimeLoadFilters()' - Load filter definitions from disk.
  *
@@ -572,6 +702,567 @@ mime_add_fcache(
 }
 
 
+/*
+ * 'mime_cache_get()' - Get bytes from a cache buffer.
+ */
+
+static void
+mime_cache_get(_mime_cbuf_t *buf,	/* I - Cache buffer */
+               void         *data,	/* I - Data */
+               size_t       len)	/* I - Number of bytes */
+{
+  if (buf->error || len > (size_t)(buf->end - buf->ptr))
+  {
+    buf->error = 1;
+    memset(data, 0, len);
+    return;
+  }
+
+  memcpy(data, buf->ptr, len);
+  buf->ptr += len;
+}
+
+
+/*
+ * 'mime_cache_get_int()' - Get an integer from a cache buffer.
+ */
+
+static long long			/* O - Value */
+mime_cache_get_int(_mime_cbuf_t *buf)	/* I - Cache buffer */
+{
+  long long	value;			/* Value */
+
+
+  mime_cache_get(buf, &value, sizeof(value));
+
+  return (value);
+}
+
+
+/*
+ * 'mime_cache_get_rules()' - Get a list of rules from a cache buffer.
+ */
+
+static mime_magic_t *			/* O - First rule */
+mime_cache_get_rules(
+    _mime_cbuf_t *buf,			/* I - Cache buffer */
+    mime_magic_t *parent,		/* I - Parent rule */
+    int          depth)			/* I - Depth of list */
+{
+  long long	count;			/* Number of rules */
+  const char	*pattern;		/* Regular expression */
+  mime_magic_t	*first = NULL,		/* First rule */
+		*prev = NULL,		/* Previous rule */
+		*temp;			/* New rule */
+
+
+  count = mime_cache_get_int(buf);
+
+  if (count < 0 || count > 10000 || depth > 100)
+  {
+    buf->error = 1;
+    return (NULL);
+  }
+
+  while (count > 0 && !buf->error)
+  {
+    if ((temp = calloc(1, sizeof(mime_magic_t))) == NULL)
+    {
+      buf->error = 1;
+      break;
+    }
+
+    if (prev)
+      prev->next = temp;
+    else
+      first = temp;
+
+    temp->prev   = prev;
+    temp->parent = parent;
+    prev         = temp;
+
+    temp->op     = (short)mime_cache_get_int(buf);
+    temp->invert = (short)mime_cache_get_int(buf);
+    temp->offset = (int)mime_cache_get_int(buf);
+    temp->region = (int)mime_cache_get_int(buf);
+    temp->length = (int)mime_cache_get_int(buf);
+
+    if (temp->op == MIME_MAGIC_REGEX)
+    {
+     /*
+      * Compile the regular expression again...
+      */
+
+      if ((pattern = mime_cache_get_string(buf)) == NULL ||
+          regcomp(&(temp->value.rev), pattern, REG_NOSUB | REG_EXTENDED))
+      {
+        temp->op   = MIME_MAGIC_NOP;
+        buf->error = 1;
+	break;
+      }
+
+      temp->pattern = strdup(pattern);
+    }
+    else
+      mime_cache_get(buf, temp->value.matchv, sizeof(temp->value.matchv));
+
+    temp->child = mime_cache_get_rules(buf, temp, depth + 1);
+
+    count --;
+  }
+
+  return (first);
+}
+
+
+/*
+ * 'mime_cache_get_string()' - Get a string from a cache buffer.
+ */
+
+static const char *			/* O - String or @code NULL@ on error */
+mime_cache_get_string(
+    _mime_cbuf_t *buf)			/* I - Cache buffer */
+{
+  long long	len;			/* Length of string */
+  const char	*s;			/* String */
+
+
+  len = mime_cache_get_int(buf);
+
+  if (buf->error || len < 0 || len >= (buf->end - buf->ptr) || buf->ptr[len])
+  {
+    buf->error = 1;
+    return (NULL);
+  }
+
+  s        = buf->ptr;
+  buf->ptr += len + 1;
+
+  return (s);
+}
+
+
+/*
+ * 'mime_cache_load()' - Load a MIME database from a cache file.
+ */
+
+static mime_t *				/* O - MIME database or @code NULL@ */
+mime_cache_load(const char *cachefile,	/* I - Cache file */
+                const char *pathname,	/* I - Directories to load from */
+                const char *filterpath)	/* I - Filter program directories */
+{
+  int		fd;			/* Cache file descriptor */
+  struct stat	fileinfo;		/* File information */
+  _mime_cbuf_t	buf;			/* Cache buffer */
+  ssize_t	bytes;			/* Bytes read */
+  char		magic[8];		/* File identifier */
+  const char	*filename,		/* Stamped filename */
+		*super,			/* Super-type name */
+		*type;			/* Type name */
+  long long	mtime,			/* Stamped modification time */
+		size;			/* Stamped size */
+  mime_t	*mime = NULL;		/* MIME database */
+  mime_type_t	*typeptr,		/* Current type */
+		*src,			/* Source type */
+		*dst;			/* Destination type */
+  mime_filter_t	*filter;		/* Current filter */
+  int		priority,		/* Type priority */
+		cost;			/* Filter cost */
+  const char	*program;		/* Filter program */
+  size_t	maxsize;		/* Maximum file size for filter */
+
+
+ /*
+  * Read the whole file...
+  */
+
+  if ((fd = open(cachefile, O_RDONLY)) < 0)
+    return (NULL);
+
+  if (fstat(fd, &fileinfo) || fileinfo.st_size <= 0 ||
+      fileinfo.st_size > MIME_CACHE_MAXSIZE ||
+      (buf.data = malloc((size_t)fileinfo.st_size)) == NULL)
+  {
+    close(fd);
+    return (NULL);
+  }
+
+  bytes = read(fd, buf.data, (size_t)fileinfo.st_size);
+
+  close(fd);
+
+  if (bytes != (ssize_t)fileinfo.st_size)
+  {
+    free(buf.data);
+    return (NULL);
+  }
+
+  buf.ptr   = buf.data;
+  buf.end   = buf.data + bytes;
+  buf.error = 0;
+
+ /*
+  * Validate the header and the file stamps...
+  */
+
+  mime_cache_get(&buf, magic, sizeof(magic));
+
+  if (memcmp(magic, "CUPSMIME", 8) ||
+      mime_cache_get_int(&buf) != MIME_CACHE_VERSION ||
+      (filename = mime_cache_get_string(&buf)) == NULL ||
+      strcmp(filename, pathname) ||
+      (filename = mime_cache_get_string(&buf)) == NULL ||
+      strcmp(filename, filterpath))
+    goto done;
+
+  while ((filename = mime_cache_get_string(&buf)) != NULL && *filename)
+  {
+    mtime = mime_cache_get_int(&buf);
+    size  = mime_cache_get_int(&buf);
+
+    if (stat(filename, &fileinfo))
+    {
+      fileinfo.st_mtime = 0;
+      fileinfo.st_size  = -1;
+    }
+
+    if (buf.error || (long long)fileinfo.st_mtime != mtime ||
+        (long long)fileinfo.st_size != size)
+    {
+      DEBUG_printf(("3mime_cache_load: \"%s\" has changed.", filename));
+      goto done;
+    }
+  }
+
+  if (!filename)
+    goto done;
+
+ /*
+  * Then the types and filters...
+  */
+
+  if ((mime = mimeNew()) == NULL)
+    goto done;
+
+  while ((super = mime_cache_get_string(&buf)) != NULL && *super)
+  {
+    type     = mime_cache_get_string(&buf);
+    priority = (int)mime_cache_get_int(&buf);
+
+    if (!type || (typeptr = mimeAddType(mime, super, type)) == NULL)
+    {
+      buf.error = 1;
+      break;
+    }
+
+    typeptr->priority = priority;
+    typeptr->rules    = mime_cache_get_rules(&buf, NULL, 0);
+  }
+
+  while (!buf.error && (super = mime_cache_get_string(&buf)) != NULL && *super)
+  {
+    type    = mime_cache_get_string(&buf);
+    src     = type ? mimeType(mime, super, type) : NULL;
+    super   = mime_cache_get_string(&buf);
+    type    = mime_cache_get_string(&buf);
+    dst     = super && type ? mimeType(mime, super, type) : NULL;
+    cost    = (int)mime_cache_get_int(&buf);
+    program = mime_cache_get_string(&buf);
+    maxsize = (size_t)mime_cache_get_int(&buf);
+
+    if (buf.error || !program ||
+        (filter = mimeAddFilter(mime, src, dst, cost, program)) == NULL)
+    {
+      buf.error = 1;
+      break;
+    }
+
+    filter->maxsize = maxsize;
+  }
+
+  if (buf.error || buf.ptr != buf.end)
+  {
+    mimeDelete(mime);
+    mime = NULL;
+  }
+
+  done:
+
+  free(buf.data);
+
+  return (mime);
+}
+
+
+/*
+ * 'mime_cache_put()' - Add bytes to a cache buffer.
+ */
+
+static void
+mime_cache_put(_mime_cbuf_t *buf,	/* I - Cache buffer */
+               const void   *data,	/* I - Data */
+               size_t       len)	/* I - Number of bytes */
+{
+  char		*temp;			/* New buffer */
+  size_t	used,			/* Bytes used */
+		alloc;			/* Bytes allocated */
+
+
+  if (buf->error)
+    return;
+
+  if (len > (size_t)(buf->end - buf->ptr))
+  {
+    used  = (size_t)(buf->ptr - buf->data);
+    alloc = 2 * (size_t)(buf->end - buf->data) + len + 4096;
+
+    if ((temp = realloc(buf->data, alloc)) == NULL)
+    {
+      buf->error = 1;
+      return;
+    }
+
+    buf->data = temp;
+    buf->ptr  = temp + used;
+    buf->end  = temp + alloc;
+  }
+
+  memcpy(buf->ptr, data, len);
+  buf->ptr += len;
+}
+
+
+/*
+ * 'mime_cache_put_int()' - Add an integer to a cache buffer.
+ */
+
+static void
+mime_cache_put_int(_mime_cbuf_t *buf,	/* I - Cache buffer */
+                   long long    value)	/* I - Value */
+{
+  mime_cache_put(buf, &value, sizeof(value));
+}
+
+
+/*
+ * 'mime_cache_put_rules()' - Add a list of rules to a cache buffer.
+ */
+
+static void
+mime_cache_put_rules(
+    _mime_cbuf_t *buf,			/* I - Cache buffer */
+    mime_magic_t *rules)		/* I - First rule */
+{
+  mime_magic_t	*temp;			/* Current rule */
+  long long	count;			/* Number of rules */
+
+
+  for (count = 0, temp = rules; temp; temp = temp->next)
+    count ++;
+
+  mime_cache_put_int(buf, count);
+
+  for (temp = rules; temp; temp = temp->next)
+  {
+    mime_cache_put_int(buf, temp->op);
+    mime_cache_put_int(buf, temp->invert);
+    mime_cache_put_int(buf, temp->offset);
+    mime_cache_put_int(buf, temp->region);
+    mime_cache_put_int(buf, temp->length);
+
+    if (temp->op == MIME_MAGIC_REGEX)
+    {
+      if (!temp->pattern)
+        buf->error = 1;
+
+      mime_cache_put_string(buf, temp->pattern);
+    }
+    else
+      mime_cache_put(buf, temp->value.matchv, sizeof(temp->value.matchv));
+
+    mime_cache_put_rules(buf, temp->child);
+  }
+}
+
+
+/*
+ * 'mime_cache_put_stamp()' - Add the stamp for a file to a cache buffer.
+ */
+
+static void
+mime_cache_put_stamp(
+    _mime_cbuf_t *buf,			/* I - Cache buffer */
+    const char   *filename)		/* I - File or directory */
+{
+  struct stat	fileinfo;		/* File information */
+
+
+  if (stat(filename, &fileinfo))
+  {
+    fileinfo.st_mtime = 0;
+    fileinfo.st_size  = -1;
+  }
+
+  mime_cache_put_string(buf, filename);
+  mime_cache_put_int(buf, (long long)fileinfo.st_mtime);
+  mime_cache_put_int(buf, (long long)fileinfo.st_size);
+}
+
+
+/*
+ * 'mime_cache_put_stamps()' - Add the cache header and file stamps.
+ *
+ * Directory stamps catch files that are added or removed, including filter
+ * programs.
+ */
+
+static void
+mime_cache_put_stamps(
+    _mime_cbuf_t *buf,			/* I - Cache buffer */
+    const char   *pathname,		/* I - Directories to load from */
+    const char   *filterpath)		/* I - Filter program directories */
+{
+  const char	*ptr;			/* Pointer into path */
+  char		dir[1024],		/* Current directory */
+		filename[2048];		/* Current file */
+  cups_dir_t	*cdir;			/* Directory */
+  cups_dentry_t	*dent;			/* Directory entry */
+  size_t	len;			/* Length of filename */
+
+
+  mime_cache_put(buf, "CUPSMIME", 8);
+  mime_cache_put_int(buf, MIME_CACHE_VERSION);
+  mime_cache_put_string(buf, pathname);
+  mime_cache_put_string(buf, filterpath);
+
+  for (ptr = mime_next_dir(pathname, dir, sizeof(dir));
+       ptr;
+       ptr = mime_next_dir(ptr, dir, sizeof(dir)))
+  {
+    mime_cache_put_stamp(buf, dir);
+
+    if ((cdir = cupsDirOpen(dir)) == NULL)
+      continue;
+
+    while ((dent = cupsDirRead(cdir)) != NULL)
+    {
+      if ((len = strlen(dent->filename)) > 6 &&
+          (!strcmp(dent->filename + len - 6, ".types") ||
+           !strcmp(dent->filename + len - 6, ".convs")))
+      {
+        snprintf(filename, sizeof(filename), "%s/%s", dir, dent->filename);
+        mime_cache_put_stamp(buf, filename);
+      }
+    }
+
+    cupsDirClose(cdir);
+  }
+
+  for (ptr = mime_next_dir(filterpath, dir, sizeof(dir));
+       ptr;
+       ptr = mime_next_dir(ptr, dir, sizeof(dir)))
+    mime_cache_put_stamp(buf, dir);
+
+  mime_cache_put_string(buf, "");
+}
+
+
+/*
+ * 'mime_cache_put_string()' - Add a string to a cache buffer.
+ */
+
+static void
+mime_cache_put_string(_mime_cbuf_t *buf,/* I - Cache buffer */
+                      const char   *s)	/* I - String */
+{
+  size_t	len;			/* Length of string */
+
+
+  if (!s)
+    s = "";
+
+  len = strlen(s);
+
+  mime_cache_put_int(buf, (long long)len);
+  mime_cache_put(buf, s, len + 1);
+}
+
+
+/*
+ * 'mime_cache_save()' - Save a MIME database to a cache file.
+ */
+
+static void
+mime_cache_save(mime_t       *mime,	/* I - MIME database */
+                const char   *cachefile,/* I - Cache file */
+                _mime_cbuf_t *buf)	/* I - Cache buffer with stamps */
+{
+  mime_type_t	*type;			/* Current type */
+  mime_filter_t	*filter;		/* Current filter */
+  cups_file_t	*fp;			/* Cache file */
+  char		newfile[1024];		/* Temporary cache file */
+  size_t	len;			/* Length of data */
+
+
+ /*
+  * Add the types and filters...
+  */
+
+  for (type = (mime_type_t *)cupsArrayFirst(mime->types);
+       type;
+       type = (mime_type_t *)cupsArrayNext(mime->types))
+  {
+    mime_cache_put_string(buf, type->super);
+    mime_cache_put_string(buf, type->type);
+    mime_cache_put_int(buf, type->priority);
+    mime_cache_put_rules(buf, type->rules);
+  }
+
+  mime_cache_put_string(buf, "");
+
+  for (filter = (mime_filter_t *)cupsArrayFirst(mime->filters);
+       filter;
+       filter = (mime_filter_t *)cupsArrayNext(mime->filters))
+  {
+    mime_cache_put_string(buf, filter->src->super);
+    mime_cache_put_string(buf, filter->src->type);
+    mime_cache_put_string(buf, filter->dst->super);
+    mime_cache_put_string(buf, filter->dst->type);
+    mime_cache_put_int(buf, filter->cost);
+    mime_cache_put_string(buf, filter->filter);
+    mime_cache_put_int(buf, (long long)filter->maxsize);
+  }
+
+  mime_cache_put_string(buf, "");
+
+  if (buf->error)
+    return;
+
+ /*
+  * Write it to a temporary file and then move it into place...
+  */
+
+  snprintf(newfile, sizeof(newfile), "%s.N", cachefile);
+
+  if ((fp = cupsFileOpen(newfile, "w")) == NULL)
+  {
+    DEBUG_printf(("3mime_cache_save: Unable to create \"%s\": %s", newfile,
+                  strerror(errno)));
+    return;
+  }
+
+  len = (size_t)(buf->ptr - buf->data);
+
+  if (cupsFileWrite(fp, buf->data, len) != (ssize_t)len)
+  {
+    cupsFileClose(fp);
+    unlink(newfile);
+  }
+  else if (cupsFileClose(fp) || rename(newfile, cachefile))
+    unlink(newfile);
+}
+
+
 /*
  * 'mime_compare_fcache()' - Compare two filter cache entries.
  */
@@ -637,7 +1328,10 @@ mime_delete_rules(mime_magic_t *rules)	/* I - Rules to free */
       mime_delete_rules(rules->child);
 
     if (rules->op == MIME_MAGIC_REGEX)
+    {
       regfree(&(rules->value.rev));
+      free(rules->pattern);
+    }
 
     free(rules);
     rules = next;
@@ -933,3 +1627,37 @@ mime_load_types(mime_t     *mime,	/* I - MIME database */
 
   cupsFileClose(fp);
 }
+
+
+/*
+ * 'mime_next_dir()' - Get the next directory from a colon-delimited path.
+ */
+
+static const char *			/* O - Rest of path or @code NULL@ when done */
+mime_next_dir(const char *path,		/* I - Path */
+              char       *dir,		/* I - Directory buffer */
+              size_t     dirsize)	/* I - Size of directory buffer */
+{
+  const char	*next;			/* End of directory */
+  size_t	len;			/* Length of directory */
+
+
+  while (*path == ':')
+    path ++;
+
+  if (!*path)
+    return (NULL);
+
+  if ((next = strchr(path, ':')) != NULL)
+    len = (size_t)(next - path);
+  else
+    len = strlen(path);
+
+  if (len >= dirsize)
+    len = dirsize - 1;
+
+  memcpy(dir, path, len);
+  dir[len] = '\0';
+
+  return (next ? next : path + strlen(path));
+}
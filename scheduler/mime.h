@@ -78,6 +78,7 @@ typedef struct _mime_magic_s		/**** MIME Magic Data ****/
     unsigned	intv;			/* Integer value */
     regex_t	rev;			/* Regular expression value */
   }		value;
+  char		*pattern;		/* Regular expression string */
 } mime_magic_t;
 
 typedef struct _mime_type_s		/**** MIME Type Data ****/
@@ -106,6 +107,8 @@ typedef struct _mime_s			/**** MIME Database ****/
   cups_array_t		*srcs;		/* Filters sorted by source type */
   mime_error_cb_t	error_cb;	/* Error message callback */
   void			*error_ctx;	/* Pointer for callback */
+  cups_array_t		*ftypes;	/* File types sorted by priority */
+  cups_array_t		*chains;	/* Cached filter chains */
 } mime_t;
 
 
@@ -116,6 +119,9 @@ typedef struct _mime_s			/**** MIME Database ****/
 extern void		mimeDelete(mime_t *mime);
 extern mime_t		*mimeNew(void) _CUPS_API_1_5;
 extern mime_t		*mimeLoad(const char *pathname, const char *filterpath);
+extern mime_t		*mimeLoadCached(mime_t *mime, const char *cachefile,
+			                const char *pathname,
+					const char *filterpath);
 extern mime_t		*mimeLoadFilters(mime_t *mime, const char *pathname,
 			                 const char *filterpath);
 extern mime_t		*mimeLoadTypes(mime_t *mime, const char *pathname);
@@ -15,6 +15,27 @@
 #include <cups/http-private.h>
 #include "cupsd.h"
 #include <cups/getifaddrs-internal.h>
+#ifdef __linux
+#  include <linux/netlink.h>
+#  include <linux/rtnetlink.h>
+#endif /* __linux */
+
+
+/*
+ * Local constants...
+ */
+
+#define NETIF_HASH_SIZE	256		/* Size of interface hash tables */
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*netif_addrs = NULL,
+					/* Interfaces by address */
+			*netif_hosts = NULL;
+					/* Interfaces by hostname */
 
 
 /*
@@ -22,7 +43,15 @@
  */
 
 static void	cupsdNetIFFree(void);
+static int	compare_addr(cupsd_netif_t *a, cupsd_netif_t *b);
+static int	compare_host(cupsd_netif_t *a, cupsd_netif_t *b);
 static int	compare_netif(cupsd_netif_t *a, cupsd_netif_t *b);
+static int	hash_addr(cupsd_netif_t *netif);
+static int	hash_host(cupsd_netif_t *netif);
+static int	hash_netif(cupsd_netif_t *netif);
+#ifdef __linux
+static void	read_monitor(void *data);
+#endif /* __linux */
 
 
 /*
@@ -52,6 +81,52 @@ cupsdNetIFFind(const char *name)	/* I - Name of interface */
 }
 
 
+/*
+ * 'cupsdNetIFFindHost()' - Find a network interface by hostname.
+ *
+ * A single trailing "." on the hostname is ignored.
+ */
+
+cupsd_netif_t *				/* O - Network interface data */
+cupsdNetIFFindHost(const char *hostname)/* I - Hostname */
+{
+  cupsd_netif_t	*netif;			/* Matching interface */
+  size_t	hostlen;		/* Length of hostname */
+  union
+  {
+    cupsd_netif_t	netif;		/* Search key */
+    char		buffer[sizeof(cupsd_netif_t) + HTTP_MAX_HOST];
+					/* Storage for hostname */
+  }		key;			/* Search key */
+
+
+ /*
+  * Update the interface list as needed...
+  */
+
+  if (NetIFUpdate)
+    cupsdNetIFUpdate();
+
+  if ((hostlen = strlen(hostname)) >= HTTP_MAX_HOST)
+    return (NULL);
+
+ /*
+  * Look for the hostname as given, then without the trailing "."...
+  */
+
+  memcpy(key.netif.hostname, hostname, hostlen + 1);
+
+  if ((netif = (cupsd_netif_t *)cupsArrayFind(netif_hosts, &key)) == NULL &&
+      hostlen > 1 && hostname[hostlen - 1] == '.')
+  {
+    key.netif.hostname[hostlen - 1] = '\0';
+    netif = (cupsd_netif_t *)cupsArrayFind(netif_hosts, &key);
+  }
+
+  return (netif);
+}
+
+
 /*
  * 'cupsdNetIFFree()' - Free the current network interface list.
  */
@@ -63,9 +138,13 @@ cupsdNetIFFree(void)
 
 
  /*
-  * Loop through the interface list and free all the records...
+  * Clear the indices and then loop through the interface list and free all
+  * the records...
   */
 
+  cupsArrayClear(netif_addrs);
+  cupsArrayClear(netif_hosts);
+
   for (current = (cupsd_netif_t *)cupsArrayFirst(NetIFList);
        current;
        current = (cupsd_netif_t *)cupsArrayNext(NetIFList))
@@ -78,16 +157,24 @@ cupsdNetIFFree(void)
 
 /*
  * 'cupsdNetIFUpdate()' - Update the network interface list as needed...
+ *
+ * When only the addresses have changed (NetIFUpdate == 2), the hostnames of
+ * addresses that are still present are reused rather than looked up again.
  */
 
 void
 cupsdNetIFUpdate(void)
 {
   int			match;		/* Matching address? */
+  int			reuse;		/* Reuse existing hostnames? */
   cupsd_listener_t	*lis;		/* Listen address */
-  cupsd_netif_t		*temp;		/* New interface */
+  cupsd_netif_t		*temp,		/* New interface */
+			*old,		/* Existing interface */
+			key;		/* Search key */
+  cups_array_t		*netifs;	/* New interfaces */
   struct ifaddrs	*addrs,		/* Interface address list */
 			*addr;		/* Current interface address */
+  size_t		addrlen;	/* Length of address */
   char			hostname[1024];	/* Hostname for address */
   size_t		hostlen;	/* Length of hostname */
 
@@ -99,22 +186,24 @@ cupsdNetIFUpdate(void)
   if (!NetIFUpdate)
     return;
 
+  reuse       = NetIFUpdate == 2;
   NetIFUpdate = 0;
 
  /*
-  * Free the old interfaces...
+  * Make sure we have arrays...
   */
 
-  cupsdNetIFFree();
-
- /*
-  * Make sure we have an array...
-  */
-
-  if (!NetIFList)
-    NetIFList = cupsArrayNew((cups_array_func_t)compare_netif, NULL);
-
   if (!NetIFList)
+    NetIFList = cupsArrayNew2((cups_array_func_t)compare_netif, NULL,
+                              (cups_ahash_func_t)hash_netif, NETIF_HASH_SIZE);
+  if (!netif_addrs)
+    netif_addrs = cupsArrayNew2((cups_array_func_t)compare_addr, NULL,
+                                (cups_ahash_func_t)hash_addr, NETIF_HASH_SIZE);
+  if (!netif_hosts)
+    netif_hosts = cupsArrayNew2((cups_array_func_t)compare_host, NULL,
+                                (cups_ahash_func_t)hash_host, NETIF_HASH_SIZE);
+
+  if (!NetIFList || !netif_addrs || !netif_hosts)
     return;
 
  /*
@@ -124,6 +213,13 @@ cupsdNetIFUpdate(void)
   if (getifaddrs(&addrs) < 0)
   {
     cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdNetIFUpdate: Unable to get interface list - %s", strerror(errno));
+    cupsdNetIFFree();
+    return;
+  }
+
+  if ((netifs = cupsArrayNew(NULL, NULL)) == NULL)
+  {
+    freeifaddrs(addrs);
     return;
   }
 
@@ -146,10 +242,24 @@ cupsdNetIFUpdate(void)
     }
 
    /*
-    * Try looking up the hostname for the address as needed...
+    * Try looking up the hostname for the address as needed, reusing the
+    * hostname of an unchanged address...
     */
 
-    if (HostNameLookups)
+#ifdef AF_INET6
+    if (addr->ifa_addr->sa_family == AF_INET6)
+      addrlen = sizeof(struct sockaddr_in6);
+    else
+#endif /* AF_INET6 */
+    addrlen = sizeof(struct sockaddr_in);
+
+    memset(&key, 0, sizeof(key));
+    strlcpy(key.name, addr->ifa_name, sizeof(key.name));
+    memcpy(&(key.address), addr->ifa_addr, addrlen);
+
+    if (reuse && (old = (cupsd_netif_t *)cupsArrayFind(netif_addrs, &key)) != NULL)
+      strlcpy(hostname, old->hostname, sizeof(hostname));
+    else if (HostNameLookups)
       httpAddrLookup((http_addr_t *)(addr->ifa_addr), hostname,
                      sizeof(hostname));
     else
@@ -186,34 +296,11 @@ cupsdNetIFUpdate(void)
     temp->hostlen = hostlen;
     memcpy(temp->hostname, hostname, hostlen + 1);
 
-    if (addr->ifa_addr->sa_family == AF_INET)
-    {
-     /*
-      * Copy IPv4 addresses...
-      */
-
-      memcpy(&(temp->address), addr->ifa_addr, sizeof(struct sockaddr_in));
-      memcpy(&(temp->mask), addr->ifa_netmask, sizeof(struct sockaddr_in));
-
-      if (addr->ifa_dstaddr)
-	memcpy(&(temp->broadcast), addr->ifa_dstaddr,
-	       sizeof(struct sockaddr_in));
-    }
-#ifdef AF_INET6
-    else
-    {
-     /*
-      * Copy IPv6 addresses...
-      */
-
-      memcpy(&(temp->address), addr->ifa_addr, sizeof(struct sockaddr_in6));
-      memcpy(&(temp->mask), addr->ifa_netmask, sizeof(struct sockaddr_in6));
+    memcpy(&(temp->address), addr->ifa_addr, addrlen);
+    memcpy(&(temp->mask), addr->ifa_netmask, addrlen);
 
-      if (addr->ifa_dstaddr)
-	memcpy(&(temp->broadcast), addr->ifa_dstaddr,
-	       sizeof(struct sockaddr_in6));
-    }
-#endif /* AF_INET6 */
+    if (addr->ifa_dstaddr)
+      memcpy(&(temp->broadcast), addr->ifa_dstaddr, addrlen);
 
     if (!(addr->ifa_flags & IFF_POINTOPOINT) &&
         !httpAddrLocalhost(&(temp->address)))
@@ -268,16 +355,132 @@ cupsdNetIFUpdate(void)
     }
 
    /*
-    * Add it to the array...
+    * Add it to the new list...
     */
 
-    cupsArrayAdd(NetIFList, temp);
+    cupsArrayAdd(netifs, temp);
 
     cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdNetIFUpdate: \"%s\" = %s:%d",
                     temp->name, temp->hostname, temp->port);
   }
 
   freeifaddrs(addrs);
+
+ /*
+  * Replace the old interfaces and rebuild the indices...
+  */
+
+  cupsdNetIFFree();
+
+  for (temp = (cupsd_netif_t *)cupsArrayFirst(netifs);
+       temp;
+       temp = (cupsd_netif_t *)cupsArrayNext(netifs))
+  {
+    cupsArrayAdd(NetIFList, temp);
+    cupsArrayAdd(netif_addrs, temp);
+    cupsArrayAdd(netif_hosts, temp);
+  }
+
+  cupsArrayDelete(netifs);
+}
+
+
+/*
+ * 'cupsdStartNetIFMonitor()' - Start monitoring network interface changes.
+ *
+ * On Linux a routing socket reports address and link changes so the list is
+ * only refreshed when something changes; other platforms poll periodically.
+ */
+
+void
+cupsdStartNetIFMonitor(void)
+{
+#ifdef __linux
+  struct sockaddr_nl	nladdr;		/* Netlink address */
+
+
+  if (NetIFMonitorFd >= 0)
+    return;
+
+  if ((NetIFMonitorFd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE)) < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdStartNetIFMonitor: Unable to create netlink socket - %s", strerror(errno));
+    return;
+  }
+
+  memset(&nladdr, 0, sizeof(nladdr));
+  nladdr.nl_family = AF_NETLINK;
+  nladdr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
+  if (bind(NetIFMonitorFd, (struct sockaddr *)&nladdr, sizeof(nladdr)))
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdStartNetIFMonitor: Unable to bind netlink socket - %s", strerror(errno));
+    close(NetIFMonitorFd);
+    NetIFMonitorFd = -1;
+    return;
+  }
+
+  cupsdAddSelect(NetIFMonitorFd, (cupsd_selfunc_t)read_monitor, NULL, NULL);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdStartNetIFMonitor: Monitoring network interface changes.");
+#endif /* __linux */
+}
+
+
+/*
+ * 'cupsdStopNetIFMonitor()' - Stop monitoring network interface changes.
+ */
+
+void
+cupsdStopNetIFMonitor(void)
+{
+  if (NetIFMonitorFd < 0)
+    return;
+
+  cupsdRemoveSelect(NetIFMonitorFd);
+  close(NetIFMonitorFd);
+
+  NetIFMonitorFd = -1;
+}
+
+
+/*
+ * 'compare_addr()' - Compare two network interface addresses.
+ */
+
+static int				/* O - Result of comparison */
+compare_addr(cupsd_netif_t *a,		/* I - First network interface */
+             cupsd_netif_t *b)		/* I - Second network interface */
+{
+  int	result;				/* Result of comparison */
+
+
+  if ((result = a->address.addr.sa_family - b->address.addr.sa_family) != 0)
+    return (result);
+
+#ifdef AF_INET6
+  if (a->address.addr.sa_family == AF_INET6)
+    result = memcmp(&(a->address.ipv6.sin6_addr), &(b->address.ipv6.sin6_addr), sizeof(a->address.ipv6.sin6_addr));
+  else
+#endif /* AF_INET6 */
+  result = memcmp(&(a->address.ipv4.sin_addr), &(b->address.ipv4.sin_addr), sizeof(a->address.ipv4.sin_addr));
+
+  if (result)
+    return (result);
+  else
+    return (strcmp(a->name, b->name));
+}
+
+
+/*
+ * 'compare_host()' - Compare two network interface hostnames.
+ */
+
+static int				/* O - Result of comparison */
+compare_host(cupsd_netif_t *a,		/* I - First network interface */
+             cupsd_netif_t *b)		/* I - Second network interface */
+{
+  return (_cups_strcasecmp(a->hostname, b->hostname));
 }
 
 
@@ -291,3 +494,135 @@ compare_netif(cupsd_netif_t *a,		/* I - First network interface */
 {
   return (strcmp(a->name, b->name));
 }
+
+
+/*
+ * 'hash_addr()' - Generate a lookup hash for the interface address.
+ */
+
+static int				/* O - Hash value */
+hash_addr(cupsd_netif_t *netif)		/* I - Network interface */
+{
+  const unsigned char	*bytes;		/* Address bytes */
+  size_t		length;		/* Number of address bytes */
+  unsigned		hash = 0;	/* Hash value */
+
+
+#ifdef AF_INET6
+  if (netif->address.addr.sa_family == AF_INET6)
+  {
+    bytes  = (const unsigned char *)&(netif->address.ipv6.sin6_addr);
+    length = sizeof(netif->address.ipv6.sin6_addr);
+  }
+  else
+#endif /* AF_INET6 */
+  {
+    bytes  = (const unsigned char *)&(netif->address.ipv4.sin_addr);
+    length = sizeof(netif->address.ipv4.sin_addr);
+  }
+
+  while (length > 0)
+  {
+    hash = 31 * hash + *bytes++;
+    length --;
+  }
+
+  return ((int)(hash % NETIF_HASH_SIZE));
+}
+
+
+/*
+ * 'hash_host()' - Generate a lookup hash for the interface hostname.
+ */
+
+static int				/* O - Hash value */
+hash_host(cupsd_netif_t *netif)		/* I - Network interface */
+{
+  const char	*ptr;			/* Pointer into hostname */
+  unsigned	hash = 0;		/* Hash value */
+
+
+  for (ptr = netif->hostname; *ptr; ptr ++)
+    hash = 31 * hash + (unsigned)_cups_tolower(*ptr);
+
+  return ((int)(hash % NETIF_HASH_SIZE));
+}
+
+
+/*
+ * 'hash_netif()' - Generate a lookup hash for the interface name.
+ */
+
+static int				/* O - Hash value */
+hash_netif(cupsd_netif_t *netif)	/* I - Network interface */
+{
+  const char	*ptr;			/* Pointer into name */
+  unsigned	hash = 0;		/* Hash value */
+
+
+  for (ptr = netif->name; *ptr; ptr ++)
+    hash = 31 * hash + (unsigned char)*ptr;
+
+  return ((int)(hash % NETIF_HASH_SIZE));
+}
+
+
+#ifdef __linux
+/*
+ * 'read_monitor()' - Read network interface change notifications.
+ */
+
+static void
+read_monitor(void *data)		/* I - Unused */
+{
+  char			buffer[8192];	/* Notification buffer */
+  ssize_t		bytes;		/* Bytes read */
+  unsigned		length;		/* Remaining bytes in buffer */
+  struct nlmsghdr	*nlh;		/* Current message */
+
+
+  (void)data;
+
+ /*
+  * Drain all pending notifications, noting any address or link changes...
+  */
+
+  for (;;)
+  {
+    if ((bytes = recv(NetIFMonitorFd, buffer, sizeof(buffer), 0)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      if (errno == ENOBUFS && !NetIFUpdate)
+      {
+       /*
+        * Notifications were dropped, rescan the interfaces...
+	*/
+
+        NetIFUpdate = 2;
+	continue;
+      }
+
+      break;
+    }
+    else if (bytes == 0)
+      break;
+
+    for (nlh = (struct nlmsghdr *)buffer, length = (unsigned)bytes;
+         NLMSG_OK(nlh, length);
+	 nlh = NLMSG_NEXT(nlh, length))
+    {
+      if (nlh->nlmsg_type == RTM_NEWADDR || nlh->nlmsg_type == RTM_DELADDR ||
+          nlh->nlmsg_type == RTM_NEWLINK || nlh->nlmsg_type == RTM_DELLINK)
+      {
+        if (!NetIFUpdate)
+	{
+	  cupsdLogMessage(CUPSD_LOG_DEBUG2, "read_monitor: Network interfaces changed.");
+	  NetIFUpdate = 2;
+	}
+      }
+    }
+  }
+}
+#endif /* __linux */
@@ -30,13 +30,19 @@ typedef struct cupsd_netif_s		/**** Network interface data ****/
  */
 
 VAR int			NetIFUpdate	VALUE(1);
-					/* Network interface list needs updating */
+					/* Network interface list needs updating
+					 * (1 = full, 2 = addresses changed) */
 VAR cups_array_t	*NetIFList	VALUE(NULL);
 					/* Array of network interfaces */
+VAR int			NetIFMonitorFd	VALUE(-1);
+					/* Interface change notification socket */
 
 /*
  * Prototypes...
  */
 
 extern cupsd_netif_t	*cupsdNetIFFind(const char *name);
+extern cupsd_netif_t	*cupsdNetIFFindHost(const char *hostname);
 extern void		cupsdNetIFUpdate(void);
+extern void		cupsdStartNetIFMonitor(void);
+extern void		cupsdStopNetIFMonitor(void);
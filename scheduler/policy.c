@@ -23,6 +23,7 @@ static int	compare_ops(cupsd_location_t *a, cupsd_location_t *b);
 static int	compare_policies(cupsd_policy_t *a, cupsd_policy_t *b);
 static void	free_policy(cupsd_policy_t *p);
 static int	hash_op(cupsd_location_t *op);
+static int	index_op(ipp_op_t op);
 
 
 /*
@@ -90,6 +91,12 @@ cupsdAddPolicyOp(cupsd_policy_t   *p,	/* I - Policy */
     temp->limit = CUPSD_AUTH_LIMIT_IPP;
 
     cupsArrayAdd(p->ops, temp);
+
+   /*
+    * Previously resolved operations may now have a different match...
+    */
+
+    memset(p->op_cached, 0, sizeof(p->op_cached));
   }
 
   return (temp);
@@ -106,6 +113,9 @@ cupsdCheckPolicy(cupsd_policy_t *p,	/* I - Policy */
 	         const char     *owner)	/* I - Owner of object */
 {
   cupsd_location_t	*po;		/* Current policy operation */
+  http_status_t		status;		/* Authorization status */
+  struct timeval	start,		/* Start of check */
+			curtime;	/* End of check */
 
 
  /*
@@ -132,10 +142,18 @@ cupsdCheckPolicy(cupsd_policy_t *p,	/* I - Policy */
   con->best = po;
 
  /*
-  * Return the status of the check...
+  * Return the status of the check, keeping track of the time spent for the
+  * slow request log...
   */
 
-  return (cupsdIsAuthorized(con, owner));
+  gettimeofday(&start, NULL);
+
+  status = cupsdIsAuthorized(con, owner);
+
+  gettimeofday(&curtime, NULL);
+  con->policy_secs += cupsdElapsedTime(&start, &curtime);
+
+  return (status);
 }
 
 
@@ -209,6 +227,7 @@ cupsdFindPolicyOp(cupsd_policy_t *p,	/* I - Policy */
 {
   cupsd_location_t	key,		/* Search key... */
 			*po;		/* Current policy operation */
+  int			i;		/* Lookup table index */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdFindPolicyOp(p=%p, op=%x(%s))",
@@ -225,25 +244,40 @@ cupsdFindPolicyOp(cupsd_policy_t *p,	/* I - Policy */
   * Check the operation against the available policies...
   */
 
-  key.op = op;
-  if ((po = (cupsd_location_t *)cupsArrayFind(p->ops, &key)) != NULL)
+  if ((i = index_op(op)) >= 0 && p->op_cached[i])
   {
     cupsdLogMessage(CUPSD_LOG_DEBUG2,
-		    "cupsdFindPolicyOp: Found exact match...");
-    return (po);
+		    "cupsdFindPolicyOp: Found cached match...");
+    return (p->op_cache[i]);
   }
 
-  key.op = IPP_ANY_OPERATION;
+  key.op = op;
   if ((po = (cupsd_location_t *)cupsArrayFind(p->ops, &key)) != NULL)
   {
     cupsdLogMessage(CUPSD_LOG_DEBUG2,
-		    "cupsdFindPolicyOp: Found wildcard match...");
-    return (po);
+		    "cupsdFindPolicyOp: Found exact match...");
+  }
+  else
+  {
+    key.op = IPP_ANY_OPERATION;
+    if ((po = (cupsd_location_t *)cupsArrayFind(p->ops, &key)) != NULL)
+      cupsdLogMessage(CUPSD_LOG_DEBUG2,
+		      "cupsdFindPolicyOp: Found wildcard match...");
+    else
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdFindPolicyOp: No match found.");
   }
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdFindPolicyOp: No match found.");
+ /*
+  * Remember the result so later requests skip the searches...
+  */
 
-  return (NULL);
+  if (i >= 0)
+  {
+    p->op_cache[i]  = po;
+    p->op_cached[i] = 1;
+  }
+
+  return (po);
 }
 
 
@@ -286,10 +320,15 @@ cupsdGetPrivateAttrs(
 
 #ifdef DEBUG
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdGetPrivateAttrs: %s",
-                  ippOpString(con->request->request.op.operation_id));
+                  con->request ? ippOpString(con->request->request.op.operation_id) : "(no request)");
 #endif /* DEBUG */
 
-  switch (con->request->request.op.operation_id)
+ /*
+  * Clients without an IPP request (HTTP GET of /api/jobs) use the job
+  * access lists...
+  */
+
+  switch (con->request ? con->request->request.op.operation_id : IPP_OP_GET_JOBS)
   {
     case IPP_GET_SUBSCRIPTIONS :
     case IPP_GET_SUBSCRIPTION_ATTRIBUTES :
@@ -494,3 +533,22 @@ hash_op(cupsd_location_t *op)		/* I - Operation */
 {
   return (((op->op >> 6) & 0x40) | (op->op & 0x3f));
 }
+
+
+/*
+ * 'index_op()' - Map an operation code to a lookup table index.
+ *
+ * Standard operations use the first half of the table and CUPS vendor
+ * operations (0x4000 and up) use the second half.
+ */
+
+static int				/* O - Table index or -1 if none */
+index_op(ipp_op_t op)			/* I - IPP operation code */
+{
+  if (op >= 0 && op < 0x100)
+    return ((int)op);
+  else if (op >= 0x4000 && op < 0x4100)
+    return (0x100 + (int)(op - 0x4000));
+  else
+    return (-1);
+}
@@ -8,6 +8,13 @@
  */
 
 
+/*
+ * Constants...
+ */
+
+#define CUPSD_POLICY_CACHE_SIZE	512	/* Operation lookup table size */
+
+
 /*
  * Policy structure...
  */
@@ -20,6 +27,10 @@ typedef struct
 			*sub_access,	/* Private users/groups for subscriptions */
 			*sub_attrs,	/* Private attributes for subscriptions */
 			*ops;		/* Operations */
+  cupsd_location_t	*op_cache[CUPSD_POLICY_CACHE_SIZE];
+					/* Resolved operations by index */
+  unsigned char		op_cached[CUPSD_POLICY_CACHE_SIZE];
+					/* Non-zero if op_cache entry is set */
 } cupsd_policy_t;
 
 typedef struct cupsd_printer_s cupsd_printer_t;
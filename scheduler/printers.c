@@ -33,6 +33,116 @@
 #endif /* __APPLE__ */
 
 
+/*
+ * Local constants...
+ */
+
+#define CUPSD_PPDLOAD_THREADS	8	/* Maximum number of PPD loading threads */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_ppdattrs_s		/**** Shared PPD attributes ****/
+{
+  unsigned char	hash[32];		/* SHA2-256 of PPD file */
+  off_t		size;			/* Size of PPD file */
+  int		refcount;		/* Number of printers using attributes */
+  ipp_t		*attrs;			/* Attributes based on the PPD */
+} cupsd_ppdattrs_t;
+
+typedef struct cupsd_ppdload_s		/**** PPD cache loaded at startup ****/
+{
+  char		name[IPP_MAX_NAME];	/* Printer name */
+  time_t	ppd_mtime;		/* Modification time of PPD file */
+  _ppd_cache_t	*pc;			/* PPD cache and mapping data */
+  ipp_t		*attrs;			/* Attributes based on the PPD */
+} cupsd_ppdload_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cups_array_t	*ppd_attrs_cache = NULL;
+					/* Shared PPD attributes */
+static _cups_mutex_t	ppd_attrs_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for shared PPD attributes */
+static cups_array_t	*ppd_loads = NULL;
+					/* PPD caches loaded at startup */
+static int		ppd_loads_next = 0;
+					/* Next PPD cache to load */
+static _cups_mutex_t	ppd_loads_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for PPD cache loading */
+static const char * const printer_reasons[] =
+		{			/* Registered printer-state-reasons,
+					 * sorted - the index is the bit in
+					 * reason_bits */
+		  "connecting-to-device",
+		  "cover-open-error",
+		  "cover-open-warning",
+		  "cups-insecure-filter-warning",
+		  "cups-missing-filter-warning",
+		  "cups-waiting-for-job-completed",
+		  "developer-empty-error",
+		  "developer-low-warning",
+		  "door-open-error",
+		  "door-open-warning",
+		  "fuser-over-temp-warning",
+		  "fuser-under-temp-warning",
+		  "hold-new-jobs",
+		  "input-tray-missing-error",
+		  "input-tray-missing-warning",
+		  "interlock-open-error",
+		  "marker-supply-empty-error",
+		  "marker-supply-empty-warning",
+		  "marker-supply-low-report",
+		  "marker-supply-low-warning",
+		  "marker-waste-almost-full-report",
+		  "marker-waste-almost-full-warning",
+		  "marker-waste-full-error",
+		  "marker-waste-full-warning",
+		  "media-empty-error",
+		  "media-empty-warning",
+		  "media-jam-error",
+		  "media-jam-warning",
+		  "media-low-report",
+		  "media-low-warning",
+		  "media-needed-error",
+		  "media-needed-warning",
+		  "moving-to-paused",
+		  "offline-report",
+		  "opc-life-over-error",
+		  "opc-near-eol-warning",
+		  "other-error",
+		  "other-report",
+		  "other-warning",
+		  "output-area-almost-full-report",
+		  "output-area-almost-full-warning",
+		  "output-area-full-error",
+		  "output-area-full-warning",
+		  "output-tray-missing-error",
+		  "paused",
+		  "shutdown",
+		  "spool-area-full",
+		  "stopped-partly",
+		  "stopping",
+		  "timed-out",
+		  "toner-empty-error",
+		  "toner-empty-warning",
+		  "toner-low-report",
+		  "toner-low-warning"
+		};
+static int		printers_conf_id = 0;
+					/* NextPrinterId saved in printers.conf
+					 * when using printers.d */
+static char		printers_d_default[IPP_MAX_NAME] = "";
+					/* Default printer saved in printers.d */
+static int		printers_d_loaded = 0;
+					/* Printers loaded from printers.d? */
+
+
 /*
  * Local functions...
  */
@@ -41,11 +151,28 @@ static void	add_printer_defaults(cupsd_printer_t *p);
 static void	add_printer_filter(cupsd_printer_t *p, mime_type_t *type,
 				   const char *filter);
 static void	add_printer_formats(cupsd_printer_t *p);
+static void	add_printer_mime_filter(cupsd_printer_t *p,
+		                        mime_filter_t *filter);
+static int	compare_ppd_attrs(cupsd_ppdattrs_t *a, cupsd_ppdattrs_t *b,
+		                  void *data);
+static int	compare_ppd_loads(cupsd_ppdload_t *a, cupsd_ppdload_t *b,
+		                  void *data);
 static int	compare_printers(void *first, void *second, void *data);
+static cups_file_t *create_printer_conf(const char *filename);
 static void	delete_printer_filters(cupsd_printer_t *p);
-static void	dirty_printer(cupsd_printer_t *p);
+static void	free_ppd_loads(void);
 static void	load_ppd(cupsd_printer_t *p);
+static void	*load_ppd_thread(void *data);
+static void	load_ppds(void);
+static void	load_printers(cups_file_t *fp, const char *filename);
 static ipp_t	*new_media_col(pwg_size_t *size);
+static int	reason_bit(const char *reason);
+static void	release_ppd_attrs(cupsd_printer_t *p);
+static void	remove_printer_confs(const char *dirname);
+static int	same_printcap(const char *tempfile);
+static void	share_ppd_attrs(cupsd_printer_t *p, const char *ppd_name,
+		                off_t ppd_size);
+static void	write_printer(cups_file_t *fp, cupsd_printer_t *printer);
 static void	write_xml_string(cups_file_t *fp, const char *s);
 
 
@@ -125,6 +252,91 @@ cupsdAddPrinter(const char *name)	/* I - Name of printer */
 }
 
 
+/*
+ * 'cupsdAddPrinterReason()' - Add a printer-state-reasons keyword.
+ */
+
+int					/* O - 1 if added, 0 if already set, -1 if full */
+cupsdAddPrinterReason(
+    cupsd_printer_t *p,			/* I - Printer */
+    const char      *reason)		/* I - Reason keyword */
+{
+  int	bit;				/* Bit for reason */
+
+
+  if ((bit = reason_bit(reason)) >= 0)
+  {
+    if (p->reason_bits & (1ULL << bit))
+      return (0);
+  }
+  else if (cupsdPrinterHasReason(p, reason))
+    return (0);
+
+  if (p->num_reasons >= (int)(sizeof(p->reasons) / sizeof(p->reasons[0])))
+    return (-1);
+
+  p->reasons[p->num_reasons ++] = _cupsStrAlloc(reason);
+
+  if (bit >= 0)
+    p->reason_bits |= 1ULL << bit;
+
+  return (1);
+}
+
+
+/*
+ * 'cupsdClearPrinterAttrCache()' - Forget the cached printer attributes and
+ *                                  job environment variables.
+ *
+ * Responses that still use a cached copy keep their own reference to it.
+ */
+
+void
+cupsdClearPrinterAttrCache(
+    cupsd_printer_t *p)			/* I - Printer */
+{
+  int			i;		/* Looping var */
+  cupsd_attrcache_t	*cache;		/* Current cache entry */
+
+
+  for (i = 0; i < p->num_env; i ++)
+    cupsdClearString(p->env + i);
+
+  p->num_env = 0;
+
+  for (cache = (cupsd_attrcache_t *)cupsArrayFirst(p->attr_cache);
+       cache;
+       cache = (cupsd_attrcache_t *)cupsArrayNext(p->attr_cache))
+  {
+    free(cache->requested);
+    ippDelete(cache->attrs);
+    free(cache);
+  }
+
+  cupsArrayDelete(p->attr_cache);
+  p->attr_cache = NULL;
+}
+
+
+/*
+ * 'cupsdClearPrinterReasons()' - Clear all printer-state-reasons keywords.
+ */
+
+void
+cupsdClearPrinterReasons(
+    cupsd_printer_t *p)			/* I - Printer */
+{
+  int	i;				/* Looping var */
+
+
+  for (i = 0; i < p->num_reasons; i ++)
+    _cupsStrFree(p->reasons[i]);
+
+  p->num_reasons = 0;
+  p->reason_bits = 0;
+}
+
+
 /*
  * 'cupsdCreateCommonData()' - Create the common printer data.
  */
@@ -140,6 +352,7 @@ cupsdCreateCommonData(void)
   char			filename[1024],	/* Filename */
 			*notifier;	/* Current notifier */
   cupsd_policy_t	*p;		/* Current policy */
+  cupsd_printer_t	*printer;	/* Current printer */
   int			k_supported;	/* Maximum file size supported */
 #ifdef HAVE_STATVFS
   struct statvfs	spoolinfo;	/* FS info for spool directory */
@@ -251,6 +464,7 @@ cupsdCreateCommonData(void)
 		  IPP_OP_CUPS_AUTHENTICATE_JOB,
 		  IPP_OP_CUPS_GET_PPD,
 		  IPP_OP_CUPS_GET_DOCUMENT,
+		  IPP_OP_CUPS_GET_STATISTICS,
 		  IPP_OP_RESTART_JOB
 		};
   static const char * const charsets[] =/* charset-supported values */
@@ -393,6 +607,11 @@ cupsdCreateCommonData(void)
 
   CommonData = ippNew();
 
+  for (printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
+       printer;
+       printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+    cupsdClearPrinterAttrCache(printer);
+
  /*
   * Get the maximum spool size based on the size of the filesystem used for
   * the RequestRoot directory.  If the host OS doesn't support the statfs call
@@ -723,8 +942,7 @@ cupsdDeletePrinter(
     cupsd_printer_t *p,			/* I - Printer to delete */
     int             update)		/* I - Update printers.conf? */
 {
-  int	i,				/* Looping var */
-	changed = 0;			/* Class changed? */
+  int	changed = 0;			/* Class changed? */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdDeletePrinter(p=%p(%s), update=%d)",
@@ -800,6 +1018,9 @@ cupsdDeletePrinter(
     snprintf(filename, sizeof(filename), "%s/%s.data", CacheDir, p->name);
     unlink(filename);
 
+    snprintf(filename, sizeof(filename), "%s/%s.snapshot", CacheDir, p->name);
+    unlink(filename);
+
    /*
     * Unregister color profiles...
     */
@@ -816,11 +1037,11 @@ cupsdDeletePrinter(
 
   delete_printer_filters(p);
 
-  for (i = 0; i < p->num_reasons; i ++)
-    _cupsStrFree(p->reasons[i]);
+  cupsdClearPrinterReasons(p);
 
   ippDelete(p->attrs);
-  ippDelete(p->ppd_attrs);
+  release_ppd_attrs(p);
+  cupsdClearPrinterAttrCache(p);
 
   mimeDeleteType(MimeDatabase, p->filetype);
   mimeDeleteType(MimeDatabase, p->prefiltertype);
@@ -850,6 +1071,9 @@ cupsdDeletePrinter(
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
   cupsdClearString(&p->pdl);
   cupsdClearString(&p->reg_name);
+
+  if (p->reg_txt)
+    free(p->reg_txt);
 #endif /* HAVE_DNSSD || HAVE_AVAHI */
 
   cupsArrayDelete(p->filetypes);
@@ -881,14 +1105,15 @@ cupsdDeleteTemporaryPrinters(int force) /* I - Force deletion instead of auto? *
 
  /*
   * Allow temporary printers to stick around for 60 seconds after the last job
-  * completes.
+  * completes.  Printers whose PPD is still being generated in the background
+  * are kept since a thread is using them.
   */
 
   unused_time = time(NULL) - 60;
 
   for (p = (cupsd_printer_t *)cupsArrayFirst(Printers); p; p = (cupsd_printer_t *)cupsArrayNext(Printers))
   {
-    if (p->temporary && (force || p->state_time < unused_time))
+    if (p->temporary && !p->local_pending && (force || p->state_time < unused_time))
       cupsdDeletePrinter(p, 0);
   }
 }
@@ -927,485 +1152,242 @@ cupsdFindPrinter(const char *name)	/* I - Name of printer to find */
 
 
 /*
- * 'cupsdLoadAllPrinters()' - Load printers from the printers.conf file.
+ * 'cupsdLoadAllPrinters()' - Load printers from the printers.conf file and
+ *                            printers.d directory.
  */
 
 void
 cupsdLoadAllPrinters(void)
 {
-  int			i;		/* Looping var */
   cups_file_t		*fp;		/* printers.conf file */
-  int			linenum;	/* Current line number */
-  char			line[4096],	/* Line from file */
-			*value,		/* Pointer to value */
-			*valueptr;	/* Pointer into value */
+  cups_dir_t		*dir;		/* printers.d directory */
+  cups_dentry_t		*dent;		/* Directory entry */
+  char			dirname[1024],	/* printers.d directory name */
+			filename[1024],	/* Configuration filename */
+			name[IPP_MAX_NAME],
+					/* Printer name */
+			*ext;		/* Extension of filename */
   cupsd_printer_t	*p;		/* Current printer */
 
 
  /*
-  * Open the printers.conf file...
+  * Open the printers.conf file and printers.d directory...
   */
 
-  snprintf(line, sizeof(line), "%s/printers.conf", ServerRoot);
-  if ((fp = cupsdOpenConfFile(line)) == NULL)
+  snprintf(filename, sizeof(filename), "%s/printers.conf", ServerRoot);
+  snprintf(dirname, sizeof(dirname), "%s/printers.d", ServerRoot);
+
+  printers_conf_id      = 0;
+  printers_d_default[0] = '\0';
+  printers_d_loaded     = 0;
+
+  fp  = cupsdOpenConfFile(filename);
+  dir = cupsDirOpen(dirname);
+
+  if (!fp && !dir)
     return;
 
  /*
-  * Read printer configurations until we hit EOF...
+  * Load the PPD caches in parallel before the printers use them...
   */
 
-  linenum = 0;
-  p       = NULL;
+  load_ppds();
 
-  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  if (fp)
   {
-   /*
-    * Decode the directive...
-    */
+    load_printers(fp, "printers.conf");
+    cupsFileClose(fp);
 
-    if (!_cups_strcasecmp(line, "NextPrinterId"))
-    {
-      if (value && (i = atoi(value)) > 0)
-        NextPrinterId = i;
-      else
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "<Printer") || !_cups_strcasecmp(line, "<DefaultPrinter"))
+    if (PerPrinterConfig)
     {
      /*
-      * <Printer name> or <DefaultPrinter name>
+      * Move any printers in printers.conf to their own files...
       */
 
-      if (p == NULL && value)
-      {
-       /*
-        * Add the printer and a base file type...
-	*/
-
-        cupsdLogMessage(CUPSD_LOG_DEBUG, "Loading printer %s...", value);
+      for (p = (cupsd_printer_t *)cupsArrayFirst(Printers);
+           p;
+	   p = (cupsd_printer_t *)cupsArrayNext(Printers))
+        cupsdMarkPrinterDirty(p);
 
-        p = cupsdAddPrinter(value);
-	p->accepting = 1;
-	p->state     = IPP_PRINTER_IDLE;
+      if (!cupsArrayCount(Printers))
+        printers_conf_id = NextPrinterId;
+    }
+  }
 
-       /*
-        * Set the default printer as needed...
-	*/
+  if (dir)
+  {
+   /*
+    * Load the per-printer files, using the backup file if the current one is
+    * missing.  Printers that were also loaded from printers.conf are skipped
+    * since both copies are the same if cupsd stopped while moving printers
+    * between printers.conf and printers.d...
+    */
 
-        if (!_cups_strcasecmp(line, "<DefaultPrinter"))
-	  DefaultPrinter = p;
-      }
-      else
-        cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "</Printer>") || !_cups_strcasecmp(line, "</DefaultPrinter>"))
+    while ((dent = cupsDirRead(dir)) != NULL)
     {
-      if (p != NULL)
-      {
-       /*
-        * Close out the current printer...
-	*/
-
-        if (!p->printer_id)
-        {
-          p->printer_id = NextPrinterId ++;
-          cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
-	}
+      if (!S_ISREG(dent->fileinfo.st_mode))
+        continue;
 
-        cupsdSetPrinterAttrs(p);
+      strlcpy(name, dent->filename, sizeof(name));
 
-        if (strncmp(p->device_uri, "file:", 5) && p->state != IPP_PRINTER_STOPPED)
-	{
-	 /*
-          * See if the backend exists...
-	  */
+      if ((ext = strstr(name, ".conf")) == NULL ||
+          (strcmp(ext, ".conf") && strcmp(ext, ".conf.O")))
+        continue;
 
-	  snprintf(line, sizeof(line), "%s/backend/%s", ServerBin, p->device_uri);
+      *ext = '\0';
 
-          if ((valueptr = strchr(line + strlen(ServerBin), ':')) != NULL)
-	    *valueptr = '\0';		/* Chop everything but URI scheme */
+      if (!name[0] || cupsdFindDest(name))
+        continue;
 
-          if (access(line, 0))
-	  {
-	   /*
-	    * Backend does not exist, stop printer...
-	    */
+      if (snprintf(filename, sizeof(filename), "%s/%s.conf", dirname, name) >= (int)sizeof(filename) ||
+          (fp = cupsdOpenConfFile(filename)) == NULL)
+        continue;
 
-	    p->state = IPP_PRINTER_STOPPED;
-	    snprintf(p->state_message, sizeof(p->state_message), "Backend %s does not exist!", line);
-	  }
-        }
+      snprintf(filename, sizeof(filename), "printers.d/%s.conf", name);
+      load_printers(fp, filename);
+      cupsFileClose(fp);
 
-        p = NULL;
-      }
-      else
-        cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!p)
-    {
-      cupsdLogMessage(CUPSD_LOG_ERROR,
-                      "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "PrinterId"))
-    {
-      if (value && (i = atoi(value)) > 0)
-        p->printer_id = i;
-      else
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad PrinterId on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "UUID"))
-    {
-      if (value && !strncmp(value, "urn:uuid:", 9))
-        cupsdSetString(&(p->uuid), value);
-      else
-        cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Bad UUID on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "AuthInfoRequired"))
-    {
-      if (!cupsdSetAuthInfoRequired(p, value, NULL))
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-			"Bad AuthInfoRequired on line %d of printers.conf.",
-			linenum);
-    }
-    else if (!_cups_strcasecmp(line, "Info"))
-    {
-      cupsdSetString(&p->info, value ? value : "");
-    }
-    else if (!_cups_strcasecmp(line, "MakeModel"))
-    {
-      if (value)
-	cupsdSetString(&p->make_model, value);
-    }
-    else if (!_cups_strcasecmp(line, "Location"))
-    {
-      cupsdSetString(&p->location, value ? value : "");
-    }
-    else if (!_cups_strcasecmp(line, "GeoLocation"))
-    {
-      cupsdSetString(&p->geo_location, value ? value : "");
-    }
-    else if (!_cups_strcasecmp(line, "Organization"))
-    {
-      cupsdSetString(&p->organization, value ? value : "");
-    }
-    else if (!_cups_strcasecmp(line, "OrganizationalUnit"))
-    {
-      cupsdSetString(&p->organizational_unit, value ? value : "");
+      printers_d_loaded = 1;
     }
-    else if (!_cups_strcasecmp(line, "DeviceURI"))
+
+    cupsDirClose(dir);
+
+    if (PerPrinterConfig)
     {
-      if (value)
-	cupsdSetDeviceURI(p, value);
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
+      if (DefaultPrinter && !(DefaultPrinter->type & CUPS_PRINTER_CLASS))
+        strlcpy(printers_d_default, DefaultPrinter->name,
+                sizeof(printers_d_default));
     }
-    else if (!_cups_strcasecmp(line, "Option") && value)
+    else if (printers_d_loaded)
     {
      /*
-      * Option name value
+      * Move the per-printer files back into printers.conf...
       */
 
-      for (valueptr = value; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+      cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+    }
+  }
 
-      if (!*valueptr)
-        cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-      else
-      {
-        for (; *valueptr && isspace(*valueptr & 255); *valueptr++ = '\0');
+  if (PerPrinterConfig && printers_conf_id != NextPrinterId)
+    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
 
-        p->num_options = cupsAddOption(value, valueptr, p->num_options,
-	                               &(p->options));
-      }
-    }
-    else if (!_cups_strcasecmp(line, "PortMonitor"))
+  free_ppd_loads();
+}
+
+
+/*
+ * 'cupsdLoadPrinterEnv()' - Copy the printer's job environment variables
+ *                           into an array.
+ *
+ * The strings are built the first time a job is started on the printer and
+ * reused until the printer is changed.
+ */
+
+int					/* O - Number of environment variables */
+cupsdLoadPrinterEnv(
+    cupsd_printer_t *p,			/* I - Printer */
+    char            *envp[],		/* I - Environment array */
+    int             envmax)		/* I - Maximum number of elements */
+{
+  int	i;				/* Looping var */
+
+
+  if (p->num_env == 0)
+  {
+    cupsdSetStringf(p->env + 0, "DEVICE_URI=%s", p->device_uri);
+    cupsdSetStringf(p->env + 1, "PPD=%s/ppd/%s.ppd", ServerRoot, p->name);
+    cupsdSetStringf(p->env + 2, "PRINTER_INFO=%s", p->info ? p->info : "");
+    cupsdSetStringf(p->env + 3, "PRINTER_LOCATION=%s",
+                    p->location ? p->location : "");
+    cupsdSetStringf(p->env + 4, "PRINTER=%s", p->name);
+
+    switch (p->num_auth_info_required)
     {
-      if (value && strcmp(value, "none"))
-	cupsdSetString(&p->port_monitor, value);
-      else if (value)
-        cupsdClearString(&p->port_monitor);
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
+      case 1 :
+          cupsdSetStringf(p->env + 5, "AUTH_INFO_REQUIRED=%s",
+	                  p->auth_info_required[0]);
+	  break;
+      case 2 :
+          cupsdSetStringf(p->env + 5, "AUTH_INFO_REQUIRED=%s,%s",
+	                  p->auth_info_required[0], p->auth_info_required[1]);
+	  break;
+      case 3 :
+          cupsdSetStringf(p->env + 5, "AUTH_INFO_REQUIRED=%s,%s,%s",
+	                  p->auth_info_required[0], p->auth_info_required[1],
+			  p->auth_info_required[2]);
+	  break;
+      case 4 :
+          cupsdSetStringf(p->env + 5, "AUTH_INFO_REQUIRED=%s,%s,%s,%s",
+	                  p->auth_info_required[0], p->auth_info_required[1],
+			  p->auth_info_required[2], p->auth_info_required[3]);
+	  break;
+      default :
+          cupsdSetString(p->env + 5, "AUTH_INFO_REQUIRED=none");
+	  break;
     }
-    else if (!_cups_strcasecmp(line, "Reason"))
-    {
-      if (value &&
-          strcmp(value, "connecting-to-device") &&
-          strcmp(value, "cups-insecure-filter-warning") &&
-          strcmp(value, "cups-missing-filter-warning"))
-      {
-        for (i = 0 ; i < p->num_reasons; i ++)
-	  if (!strcmp(value, p->reasons[i]))
-	    break;
-
-        if (i >= p->num_reasons &&
-	    p->num_reasons < (int)(sizeof(p->reasons) / sizeof(p->reasons[0])))
-	{
-	  p->reasons[p->num_reasons] = _cupsStrAlloc(value);
-	  p->num_reasons ++;
-	}
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "State"))
-    {
-     /*
-      * Set the initial queue state...
-      */
-
-      if (value && !_cups_strcasecmp(value, "idle"))
-        p->state = IPP_PRINTER_IDLE;
-      else if (value && !_cups_strcasecmp(value, "stopped"))
-      {
-        p->state = IPP_PRINTER_STOPPED;
-
-        for (i = 0 ; i < p->num_reasons; i ++)
-	  if (!strcmp("paused", p->reasons[i]))
-	    break;
-
-        if (i >= p->num_reasons &&
-	    p->num_reasons < (int)(sizeof(p->reasons) / sizeof(p->reasons[0])))
-	{
-	  p->reasons[p->num_reasons] = _cupsStrAlloc("paused");
-	  p->num_reasons ++;
-	}
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "StateMessage"))
-    {
-     /*
-      * Set the initial queue state message...
-      */
-
-      if (value)
-	strlcpy(p->state_message, value, sizeof(p->state_message));
-    }
-    else if (!_cups_strcasecmp(line, "StateTime"))
-    {
-     /*
-      * Set the state time...
-      */
 
-      if (value)
-        p->state_time = atoi(value);
-    }
-    else if (!_cups_strcasecmp(line, "ConfigTime"))
-    {
-     /*
-      * Set the config time...
-      */
-
-      if (value)
-        p->config_time = atoi(value);
-    }
-    else if (!_cups_strcasecmp(line, "Accepting"))
-    {
-     /*
-      * Set the initial accepting state...
-      */
+    p->num_env = 6;
+  }
 
-      if (value &&
-          (!_cups_strcasecmp(value, "yes") ||
-           !_cups_strcasecmp(value, "on") ||
-           !_cups_strcasecmp(value, "true")))
-        p->accepting = 1;
-      else if (value &&
-               (!_cups_strcasecmp(value, "no") ||
-        	!_cups_strcasecmp(value, "off") ||
-        	!_cups_strcasecmp(value, "false")))
-        p->accepting = 0;
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "Type"))
-    {
-      if (value)
-        p->type = (cups_ptype_t)atoi(value);
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "Shared"))
-    {
-     /*
-      * Set the initial shared state...
-      */
+ /*
+  * Copy pointers to the environment, leaving room for a NULL pointer at the
+  * end...
+  */
 
-      if (value &&
-          (!_cups_strcasecmp(value, "yes") ||
-           !_cups_strcasecmp(value, "on") ||
-           !_cups_strcasecmp(value, "true")))
-        p->shared = 1;
-      else if (value &&
-               (!_cups_strcasecmp(value, "no") ||
-        	!_cups_strcasecmp(value, "off") ||
-        	!_cups_strcasecmp(value, "false")))
-        p->shared = 0;
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "JobSheets"))
-    {
-     /*
-      * Set the initial job sheets...
-      */
+  for (i = 0; i < p->num_env && i < (envmax - 1); i ++)
+    envp[i] = p->env[i];
 
-      if (value)
-      {
-	for (valueptr = value; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+  envp[i] = NULL;
 
-	if (*valueptr)
-          *valueptr++ = '\0';
+  return (i);
+}
 
-	cupsdSetString(&p->job_sheets[0], value);
 
-	while (isspace(*valueptr & 255))
-          valueptr ++;
+/*
+ * 'cupsdMarkPrinterDirty()' - Mark config and state files dirty for the
+ *                             specified printer.
+ */
 
-	if (*valueptr)
-	{
-          for (value = valueptr; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+void
+cupsdMarkPrinterDirty(
+    cupsd_printer_t *p)			/* I - Printer */
+{
+  p->dirty = 1;
 
-	  if (*valueptr)
-            *valueptr = '\0';
+  if (p->type & CUPS_PRINTER_CLASS)
+    cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
+  else
+    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
 
-	  cupsdSetString(&p->job_sheets[1], value);
-	}
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "AllowUser"))
-    {
-      if (value)
-      {
-        p->deny_users = 0;
-        cupsdAddString(&(p->users), value);
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "DenyUser"))
-    {
-      if (value)
-      {
-        p->deny_users = 1;
-        cupsdAddString(&(p->users), value);
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "QuotaPeriod"))
-    {
-      if (value)
-        p->quota_period = atoi(value);
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "PageLimit"))
-    {
-      if (value)
-        p->page_limit = atoi(value);
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "KLimit"))
-    {
-      if (value)
-        p->k_limit = atoi(value);
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "OpPolicy"))
-    {
-      if (value)
-      {
-        cupsd_policy_t *pol;		/* Policy */
+  if (PrintcapFormat == PRINTCAP_PLIST)
+    cupsdMarkDirty(CUPSD_DIRTY_PRINTCAP);
+}
 
 
-        if ((pol = cupsdFindPolicy(value)) != NULL)
-	{
-          cupsdSetString(&p->op_policy, value);
-	  p->op_policy_ptr = pol;
-	}
-	else
-	  cupsdLogMessage(CUPSD_LOG_ERROR,
-	                  "Bad policy \"%s\" on line %d of printers.conf",
-			  value, linenum);
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "ErrorPolicy"))
-    {
-      if (value)
-      {
-	if (strcmp(value, "retry-current-job") &&
-	    strcmp(value, "abort-job") &&
-	    strcmp(value, "retry-job") &&
-	    strcmp(value, "stop-printer"))
-	  cupsdLogMessage(CUPSD_LOG_ALERT, "Invalid ErrorPolicy \"%s\" on line %d or printers.conf.", ErrorPolicy, linenum);
-	else
-	  cupsdSetString(&p->error_policy, value);
-      }
-      else
-	cupsdLogMessage(CUPSD_LOG_ERROR, "Syntax error on line %d of printers.conf.", linenum);
-    }
-    else if (!_cups_strcasecmp(line, "Attribute") && value)
-    {
-      for (valueptr = value; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+/*
+ * 'cupsdPrinterHasReason()' - Return whether a printer-state-reasons keyword
+ *                             is set.
+ *
+ * Registered keywords are checked using the printer's reason bits, other
+ * keywords by searching the reasons array.
+ */
 
-      if (!*valueptr)
-        cupsdLogMessage(CUPSD_LOG_ERROR,
-	                "Syntax error on line %d of printers.conf.", linenum);
-      else
-      {
-        for (; *valueptr && isspace(*valueptr & 255); *valueptr++ = '\0');
+int					/* O - 1 if set, 0 otherwise */
+cupsdPrinterHasReason(
+    cupsd_printer_t *p,			/* I - Printer */
+    const char      *reason)		/* I - Reason keyword */
+{
+  int	i;				/* Looping var */
 
-        if (!p->attrs)
-	  cupsdSetPrinterAttrs(p);
 
-        if (!strcmp(value, "marker-change-time"))
-	  p->marker_time = atoi(valueptr);
-	else
-          cupsdSetPrinterAttr(p, value, valueptr);
-      }
-    }
-    else if (_cups_strcasecmp(line, "Filter") &&
-             _cups_strcasecmp(line, "Prefilter") &&
-             _cups_strcasecmp(line, "Product"))
-    {
-     /*
-      * Something else we don't understand (and that wasn't used in a prior
-      * release of CUPS...
-      */
+  if ((i = reason_bit(reason)) >= 0)
+    return ((p->reason_bits & (1ULL << i)) != 0);
 
-      cupsdLogMessage(CUPSD_LOG_ERROR,
-                      "Unknown configuration directive %s on line %d of "
-		      "printers.conf.", line, linenum);
-    }
-  }
+  for (i = 0; i < p->num_reasons; i ++)
+    if (!strcmp(reason, p->reasons[i]))
+      return (1);
 
-  cupsFileClose(fp);
+  return (0);
 }
 
 
@@ -1418,6 +1400,9 @@ cupsdRenamePrinter(
     cupsd_printer_t *p,			/* I - Printer */
     const char      *name)		/* I - New name */
 {
+  char	filename[1024];			/* printers.d filename */
+
+
  /*
   * Remove the printer from the array(s) first...
   */
@@ -1430,6 +1415,8 @@ cupsdRenamePrinter(
   * Rename the printer type...
   */
 
+  delete_printer_filters(p);
+
   mimeDeleteType(MimeDatabase, p->filetype);
   p->filetype = mimeAddType(MimeDatabase, "printer", name);
 
@@ -1443,8 +1430,16 @@ cupsdRenamePrinter(
   * Rename the printer...
   */
 
+  snprintf(filename, sizeof(filename), "%s/printers.d/%s.conf", ServerRoot,
+           p->name);
+  unlink(filename);
+  strlcat(filename, ".O", sizeof(filename));
+  unlink(filename);
+
   cupsdSetString(&p->name, name);
 
+  p->dirty = 1;
+
  /*
   * Reset printer attributes...
   */
@@ -1463,296 +1458,138 @@ cupsdRenamePrinter(
 
 /*
  * 'cupsdSaveAllPrinters()' - Save all printer definitions to the printers.conf
- *                            file.
+ *                            file or printers.d directory.
  */
 
 void
 cupsdSaveAllPrinters(void)
 {
-  int			i;		/* Looping var */
   cups_file_t		*fp;		/* printers.conf file */
   char			filename[1024],	/* printers.conf filename */
-			temp[1024],	/* Temporary string */
-			value[2048],	/* Value string */
-			*ptr,		/* Pointer into value */
-			*name;		/* Current user/group name */
+			dirname[1024];	/* printers.d directory name */
   cupsd_printer_t	*printer;	/* Current printer class */
-  time_t		curtime;	/* Current time */
-  struct tm		curdate;	/* Current date */
-  cups_option_t		*option;	/* Current option */
-  ipp_attribute_t	*marker;	/* Current marker attribute */
-
 
- /*
-  * Create the printers.conf file...
-  */
 
   snprintf(filename, sizeof(filename), "%s/printers.conf", ServerRoot);
+  snprintf(dirname, sizeof(dirname), "%s/printers.d", ServerRoot);
 
-  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm & 0600)) == NULL)
-    return;
-
-  cupsdLogMessage(CUPSD_LOG_INFO, "Saving printers.conf...");
-
- /*
-  * Write a small header to the file...
-  */
-
-  time(&curtime);
-  localtime_r(&curtime, &curdate);
-  strftime(temp, sizeof(temp) - 1, "%Y-%m-%d %H:%M", &curdate);
-
-  cupsFilePuts(fp, "# Printer configuration file for " CUPS_SVERSION "\n");
-  cupsFilePrintf(fp, "# Written by cupsd on %s\n", temp);
-  cupsFilePuts(fp, "# DO NOT EDIT THIS FILE WHEN CUPSD IS RUNNING\n");
-
-  cupsFilePrintf(fp, "NextPrinterId %d\n", NextPrinterId);
-
- /*
-  * Write each local printer known to the system...
-  */
-
-  for (printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
-       printer;
-       printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+  if (PerPrinterConfig)
   {
    /*
-    * Skip printer classes and temporary queues...
-    */
-
-    if ((printer->type & CUPS_PRINTER_CLASS) || printer->temporary)
-      continue;
-
-   /*
-    * Write printers as needed...
+    * Changing the default printer changes both the old and new default
+    * printer files...
     */
 
-    if (printer == DefaultPrinter)
-      cupsFilePrintf(fp, "<DefaultPrinter %s>\n", printer->name);
-    else
-      cupsFilePrintf(fp, "<Printer %s>\n", printer->name);
-
-    if (printer->printer_id)
-      cupsFilePrintf(fp, "PrinterId %d\n", printer->printer_id);
-
-    cupsFilePrintf(fp, "UUID %s\n", printer->uuid);
-
-    if (printer->num_auth_info_required > 0)
+    if (strcmp(printers_d_default, DefaultPrinter ? DefaultPrinter->name : ""))
     {
-      switch (printer->num_auth_info_required)
-      {
-        case 1 :
-            strlcpy(value, printer->auth_info_required[0], sizeof(value));
-	    break;
-
-        case 2 :
-            snprintf(value, sizeof(value), "%s,%s",
-	             printer->auth_info_required[0],
-		     printer->auth_info_required[1]);
-	    break;
+      if ((printer = cupsdFindDest(printers_d_default)) != NULL)
+        printer->dirty = 1;
 
-        case 3 :
-	default :
-            snprintf(value, sizeof(value), "%s,%s,%s",
-	             printer->auth_info_required[0],
-		     printer->auth_info_required[1],
-		     printer->auth_info_required[2]);
-	    break;
-      }
+      if (DefaultPrinter)
+        DefaultPrinter->dirty = 1;
 
-      cupsFilePutConf(fp, "AuthInfoRequired", value);
+      strlcpy(printers_d_default, DefaultPrinter ? DefaultPrinter->name : "",
+              sizeof(printers_d_default));
     }
 
-    if (printer->info)
-      cupsFilePutConf(fp, "Info", printer->info);
-
-    if (printer->location)
-      cupsFilePutConf(fp, "Location", printer->location);
-
-    if (printer->geo_location)
-      cupsFilePutConf(fp, "GeoLocation", printer->geo_location);
-
-    if (printer->make_model)
-      cupsFilePutConf(fp, "MakeModel", printer->make_model);
-
-    if (printer->organization)
-      cupsFilePutConf(fp, "Organization", printer->organization);
-
-    if (printer->organizational_unit)
-      cupsFilePutConf(fp, "OrganizationalUnit", printer->organizational_unit);
-
-    cupsFilePutConf(fp, "DeviceURI", printer->device_uri);
-
-    if (printer->port_monitor)
-      cupsFilePutConf(fp, "PortMonitor", printer->port_monitor);
+   /*
+    * Write each changed local printer to its own file...
+    */
 
-    if (printer->state == IPP_PRINTER_STOPPED)
+    if (mkdir(dirname, 0755) && errno != EEXIST)
     {
-      cupsFilePuts(fp, "State Stopped\n");
-
-      if (printer->state_message[0])
-        cupsFilePutConf(fp, "StateMessage", printer->state_message);
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create directory \"%s\": %s",
+                      dirname, strerror(errno));
+      return;
     }
-    else
-      cupsFilePuts(fp, "State Idle\n");
-
-    cupsFilePrintf(fp, "StateTime %d\n", (int)printer->state_time);
-    cupsFilePrintf(fp, "ConfigTime %d\n", (int)printer->config_time);
-
-    for (i = 0; i < printer->num_reasons; i ++)
-      if (strcmp(printer->reasons[i], "connecting-to-device") &&
-          strcmp(printer->reasons[i], "cups-insecure-filter-warning") &&
-          strcmp(printer->reasons[i], "cups-missing-filter-warning"))
-        cupsFilePutConf(fp, "Reason", printer->reasons[i]);
 
-    cupsFilePrintf(fp, "Type %d\n", printer->type);
-
-    if (printer->accepting)
-      cupsFilePuts(fp, "Accepting Yes\n");
-    else
-      cupsFilePuts(fp, "Accepting No\n");
-
-    if (printer->shared)
-      cupsFilePuts(fp, "Shared Yes\n");
-    else
-      cupsFilePuts(fp, "Shared No\n");
-
-    snprintf(value, sizeof(value), "%s %s", printer->job_sheets[0],
-             printer->job_sheets[1]);
-    cupsFilePutConf(fp, "JobSheets", value);
+    for (printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
+	 printer;
+	 printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+    {
+      if ((printer->type & CUPS_PRINTER_CLASS) || printer->temporary ||
+          !printer->dirty)
+	continue;
 
-    cupsFilePrintf(fp, "QuotaPeriod %d\n", printer->quota_period);
-    cupsFilePrintf(fp, "PageLimit %d\n", printer->page_limit);
-    cupsFilePrintf(fp, "KLimit %d\n", printer->k_limit);
+      if (snprintf(filename, sizeof(filename), "%s/%s.conf", dirname,
+                   printer->name) >= (int)sizeof(filename) ||
+          (fp = create_printer_conf(filename)) == NULL)
+        continue;
 
-    for (name = (char *)cupsArrayFirst(printer->users);
-         name;
-	 name = (char *)cupsArrayNext(printer->users))
-      cupsFilePutConf(fp, printer->deny_users ? "DenyUser" : "AllowUser", name);
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "Saving printers.d/%s.conf...",
+                      printer->name);
 
-    if (printer->op_policy)
-      cupsFilePutConf(fp, "OpPolicy", printer->op_policy);
-    if (printer->error_policy)
-      cupsFilePutConf(fp, "ErrorPolicy", printer->error_policy);
+      write_printer(fp, printer);
+      cupsdCloseCreatedConfFile(fp, filename);
 
-    for (i = printer->num_options, option = printer->options;
-         i > 0;
-	 i --, option ++)
-    {
-      snprintf(value, sizeof(value), "%s %s", option->name, option->value);
-      cupsFilePutConf(fp, "Option", value);
+      printer->dirty = 0;
     }
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-colors",
-                                   IPP_TAG_NAME)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s ", marker->name);
-
-      for (i = 0, ptr = value + strlen(value);
-           i < marker->num_values && ptr < (value + sizeof(value) - 1);
-	   i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
+    cupsdStampConfFile(dirname);
 
-        strlcpy(ptr, marker->values[i].string.text, (size_t)(value + sizeof(value) - ptr));
-        ptr += strlen(ptr);
-      }
-
-      *ptr = '\0';
-      cupsFilePutConf(fp, "Attribute", value);
-    }
+   /*
+    * Then update printers.conf if the next printer ID has changed...
+    */
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-levels",
-                                   IPP_TAG_INTEGER)) != NULL)
-    {
-      cupsFilePrintf(fp, "Attribute %s %d", marker->name,
-                     marker->values[0].integer);
-      for (i = 1; i < marker->num_values; i ++)
-        cupsFilePrintf(fp, ",%d", marker->values[i].integer);
-      cupsFilePuts(fp, "\n");
-    }
+    if (printers_conf_id == NextPrinterId)
+      return;
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-low-levels",
-                                   IPP_TAG_INTEGER)) != NULL)
-    {
-      cupsFilePrintf(fp, "Attribute %s %d", marker->name,
-                     marker->values[0].integer);
-      for (i = 1; i < marker->num_values; i ++)
-        cupsFilePrintf(fp, ",%d", marker->values[i].integer);
-      cupsFilePuts(fp, "\n");
-    }
+    snprintf(filename, sizeof(filename), "%s/printers.conf", ServerRoot);
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-high-levels",
-                                   IPP_TAG_INTEGER)) != NULL)
-    {
-      cupsFilePrintf(fp, "Attribute %s %d", marker->name,
-                     marker->values[0].integer);
-      for (i = 1; i < marker->num_values; i ++)
-        cupsFilePrintf(fp, ",%d", marker->values[i].integer);
-      cupsFilePuts(fp, "\n");
-    }
+    if ((fp = create_printer_conf(filename)) == NULL)
+      return;
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-message",
-                                   IPP_TAG_TEXT)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s %s", marker->name,
-               marker->values[0].string.text);
+    cupsdLogMessage(CUPSD_LOG_INFO, "Saving printers.conf...");
 
-      cupsFilePutConf(fp, "Attribute", value);
-    }
+    cupsFilePrintf(fp, "NextPrinterId %d\n", NextPrinterId);
+    cupsdCloseCreatedConfFile(fp, filename);
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-names",
-                                   IPP_TAG_NAME)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s ", marker->name);
+    printers_conf_id = NextPrinterId;
+    return;
+  }
 
-      for (i = 0, ptr = value + strlen(value);
-           i < marker->num_values && ptr < (value + sizeof(value) - 1);
-	   i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
+ /*
+  * Create the printers.conf file...
+  */
 
-        strlcpy(ptr, marker->values[i].string.text, (size_t)(value + sizeof(value) - ptr));
-        ptr += strlen(ptr);
-      }
+  if ((fp = create_printer_conf(filename)) == NULL)
+    return;
 
-      *ptr = '\0';
-      cupsFilePutConf(fp, "Attribute", value);
-    }
+  cupsdLogMessage(CUPSD_LOG_INFO, "Saving printers.conf...");
 
-    if ((marker = ippFindAttribute(printer->attrs, "marker-types",
-                                   IPP_TAG_KEYWORD)) != NULL)
-    {
-      snprintf(value, sizeof(value), "%s ", marker->name);
+  cupsFilePrintf(fp, "NextPrinterId %d\n", NextPrinterId);
 
-      for (i = 0, ptr = value + strlen(value);
-           i < marker->num_values && ptr < (value + sizeof(value) - 1);
-	   i ++)
-      {
-        if (i)
-	  *ptr++ = ',';
+ /*
+  * Write each local printer known to the system...
+  */
 
-        strlcpy(ptr, marker->values[i].string.text, (size_t)(value + sizeof(value) - ptr));
-        ptr += strlen(ptr);
-      }
+  for (printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
+       printer;
+       printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+  {
+   /*
+    * Skip printer classes and temporary queues...
+    */
 
-      *ptr = '\0';
-      cupsFilePutConf(fp, "Attribute", value);
-    }
+    if ((printer->type & CUPS_PRINTER_CLASS) || printer->temporary)
+      continue;
 
-    if (printer->marker_time)
-      cupsFilePrintf(fp, "Attribute marker-change-time %ld\n",
-                     (long)printer->marker_time);
+    write_printer(fp, printer);
 
-    if (printer == DefaultPrinter)
-      cupsFilePuts(fp, "</DefaultPrinter>\n");
-    else
-      cupsFilePuts(fp, "</Printer>\n");
+    printer->dirty = 0;
   }
 
   cupsdCloseCreatedConfFile(fp, filename);
+
+ /*
+  * Remove any per-printer files that were merged into printers.conf...
+  */
+
+  if (printers_d_loaded)
+  {
+    remove_printer_confs(dirname);
+    printers_d_loaded = 0;
+  }
 }
 
 
@@ -1769,6 +1606,8 @@ cupsdSetAuthInfoRequired(
   int	i;				/* Looping var */
 
 
+  cupsdClearPrinterAttrCache(p);
+
   p->num_auth_info_required = 0;
 
  /*
@@ -1938,6 +1777,7 @@ cupsdSetDeviceURI(cupsd_printer_t *p,	/* I - Printer */
   */
 
   cupsdSetString(&(p->device_uri), uri);
+  cupsdClearPrinterAttrCache(p);
 
  /*
   * Copy the device URI to a temporary buffer so we can sanitize any auth
@@ -2028,6 +1868,8 @@ cupsdSetPrinterAttr(
     return;
   }
 
+  cupsdClearPrinterAttrCache(p);
+
  /*
   * Count the number of values...
   */
@@ -2263,6 +2105,8 @@ cupsdSetPrinterAttrs(cupsd_printer_t *p)/* I - Printer to setup */
 
   _cupsRWLockWrite(&p->lock);
 
+  cupsdClearPrinterAttrCache(p);
+
  /*
   * Clear out old filters, if any...
   */
@@ -2436,6 +2280,10 @@ cupsdSetPrinterAttrs(cupsd_printer_t *p)/* I - Printer to setup */
 
     load_ppd(p);
 
+    if (ippFindAttribute(p->ppd_attrs, "port-monitor-supported", IPP_TAG_NAME))
+      ippAddString(p->attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "port-monitor",
+                   NULL, p->port_monitor ? p->port_monitor : "none");
+
    /*
     * Add filters for printer...
     */
@@ -2610,6 +2458,7 @@ cupsdSetPrinterReasons(
     const char      *s)			/* I - Reasons strings */
 {
   int		i,			/* Looping var */
+		bit,			/* Bit for registered reason */
 		changed = 0;		/* Did something change? */
   const char	*sptr;			/* Pointer into reasons */
   char		reason[255],		/* Reason string */
@@ -2635,13 +2484,11 @@ cupsdSetPrinterReasons(
 
     sptr = s;
 
-    for (i = 0; i < p->num_reasons; i ++)
-      _cupsStrFree(p->reasons[i]);
+    cupsdClearPrinterReasons(p);
 
-    p->num_reasons = 0;
-    changed        = 1;
+    changed = 1;
 
-    dirty_printer(p);
+    cupsdMarkPrinterDirty(p);
   }
 
   if (!strcmp(s, "none"))
@@ -2675,6 +2522,9 @@ cupsdSetPrinterReasons(
       * Remove reason...
       */
 
+      if ((bit = reason_bit(reason)) >= 0 && !(p->reason_bits & (1ULL << bit)))
+        continue;
+
       for (i = 0; i < p->num_reasons; i ++)
         if (!strcmp(reason, p->reasons[i]))
 	{
@@ -2689,6 +2539,9 @@ cupsdSetPrinterReasons(
 	  if (i < p->num_reasons)
 	    memmove(p->reasons + i, p->reasons + i + 1, (size_t)(p->num_reasons - i) * sizeof(char *));
 
+	  if (bit >= 0)
+	    p->reason_bits &= ~(1ULL << bit);
+
           if (!strcmp(reason, "paused") && p->state == IPP_PRINTER_STOPPED)
 	    cupsdSetPrinterState(p, IPP_PRINTER_IDLE, 1);
 
@@ -2696,33 +2549,26 @@ cupsdSetPrinterReasons(
             p->job->completed = 0;
 
           if (strcmp(reason, "connecting-to-device"))
-	    dirty_printer(p);
+	    cupsdMarkPrinterDirty(p);
 
 	  break;
 	}
     }
-    else if (p->num_reasons < (int)(sizeof(p->reasons) / sizeof(p->reasons[0])))
+    else
     {
      /*
       * Add reason...
       */
 
-      for (i = 0; i < p->num_reasons; i ++)
-        if (!strcmp(reason, p->reasons[i]))
-	  break;
-
-      if (i >= p->num_reasons)
+      if ((i = cupsdAddPrinterReason(p, reason)) < 0)
+      {
+	cupsdLogMessage(CUPSD_LOG_ALERT,
+			"Too many printer-state-reasons values for %s (%d)",
+			p->name, p->num_reasons + 1);
+	return (changed);
+      }
+      else if (i > 0)
       {
-        if (i >= (int)(sizeof(p->reasons) / sizeof(p->reasons[0])))
-	{
-	  cupsdLogMessage(CUPSD_LOG_ALERT,
-	                  "Too many printer-state-reasons values for %s (%d)",
-			  p->name, i + 1);
-          return (changed);
-        }
-
-        p->reasons[i] = _cupsStrAlloc(reason);
-	p->num_reasons ++;
         changed = 1;
 
 	if (!strcmp(reason, "paused") && p->state != IPP_PRINTER_STOPPED)
@@ -2732,7 +2578,7 @@ cupsdSetPrinterReasons(
 	  p->job->completed = 1;
 
 	if (strcmp(reason, "connecting-to-device"))
-	  dirty_printer(p);
+	  cupsdMarkPrinterDirty(p);
       }
     }
   }
@@ -2824,7 +2670,7 @@ cupsdSetPrinterState(
 
   if (update &&
       (old_state == IPP_PRINTER_STOPPED) != (s == IPP_PRINTER_STOPPED))
-    dirty_printer(p);
+    cupsdMarkPrinterDirty(p);
 }
 
 
@@ -3000,6 +2846,65 @@ cupsdUpdatePrinters(void)
   }
 }
 
+/*
+ * 'cupsdUpdatePrinterSnapshot()' - Update the PPD snapshot used by filters.
+ *
+ * The snapshot holds the parsed PPD file so that each filter in a job can
+ * load it without parsing the PPD file again.  It is rewritten whenever the
+ * PPD file changes.
+ */
+
+int					/* O - 1 if the snapshot is usable, 0 otherwise */
+cupsdUpdatePrinterSnapshot(
+    cupsd_printer_t *p,			/* I - Printer */
+    char            *snapfile,		/* I - Snapshot filename buffer */
+    size_t          snapsize)		/* I - Size of snapshot filename buffer */
+{
+  char		ppdfile[1024];		/* PPD filename */
+  struct stat	ppdinfo,		/* PPD file information */
+		snapinfo;		/* Snapshot file information */
+  ppd_file_t	*ppd;			/* PPD file */
+  int		status;			/* Write status */
+
+
+  snprintf(ppdfile, sizeof(ppdfile), "%s/ppd/%s.ppd", ServerRoot, p->name);
+  snprintf(snapfile, snapsize, "%s/%s.snapshot", CacheDir, p->name);
+
+  if (stat(ppdfile, &ppdinfo))
+    return (0);
+
+  if (!stat(snapfile, &snapinfo) && snapinfo.st_mtime >= ppdinfo.st_ctime)
+    return (1);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Saving PPD snapshot for %s...", p->name);
+
+  if ((ppd = _ppdOpenFile(ppdfile, _PPD_LOCALIZATION_ALL)) == NULL)
+    return (0);
+
+  status = _ppdWriteSnapshot(ppd, ppdfile, snapfile);
+
+  ppdClose(ppd);
+
+  if (!status)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to save PPD snapshot \"%s\": %s",
+                    snapfile, strerror(errno));
+    return (0);
+  }
+
+  if (!getuid() && chown(snapfile, getuid(), Group))
+    cupsdLogMessage(CUPSD_LOG_WARN, "Unable to change group for \"%s\": %s",
+		    snapfile, strerror(errno));
+
+  if (chmod(snapfile, ConfigFilePerm))
+    cupsdLogMessage(CUPSD_LOG_WARN,
+                    "Unable to change permissions for \"%s\": %s",
+		    snapfile, strerror(errno));
+
+  return (1);
+}
+
+
 
 /*
  * 'cupsdValidateDest()' - Validate a printer/class destination.
@@ -3162,6 +3067,7 @@ cupsdWritePrintcap(void)
   int			i;		/* Looping var */
   cups_file_t		*fp;		/* Printcap file */
   cupsd_printer_t	*p;		/* Current printer */
+  char			tempfile[1024];	/* Temporary printcap file */
 
 
  /*
@@ -3174,11 +3080,17 @@ cupsdWritePrintcap(void)
   cupsdLogMessage(CUPSD_LOG_INFO, "Generating printcap %s...", Printcap);
 
  /*
-  * Open the printcap file...
+  * Open a temporary printcap file...
   */
 
-  if ((fp = cupsFileOpen(Printcap, "w")) == NULL)
+  snprintf(tempfile, sizeof(tempfile), "%s.N", Printcap);
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create printcap %s: %s",
+                    tempfile, strerror(errno));
     return;
+  }
 
  /*
   * Put a comment header at the top so that users will know where the
@@ -3325,10 +3237,26 @@ cupsdWritePrintcap(void)
   }
 
  /*
-  * Close the file...
+  * Close the file and replace the old printcap if the contents changed...
   */
 
-  cupsFileClose(fp);
+  if (cupsFileClose(fp))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write printcap %s: %s",
+                    tempfile, strerror(errno));
+    unlink(tempfile);
+  }
+  else if (same_printcap(tempfile))
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Printcap %s is unchanged.", Printcap);
+    unlink(tempfile);
+  }
+  else if (rename(tempfile, Printcap))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to rename %s to %s: %s",
+                    tempfile, Printcap, strerror(errno));
+    unlink(tempfile);
+  }
 }
 
 
@@ -3461,7 +3389,8 @@ add_printer_filter(
 		dest[MIME_MAX_SUPER + MIME_MAX_TYPE + 2],
 					/* Destination super/type */
 		program[1024];		/* Program/filter name */
-  int		cost;			/* Cost of filter */
+  int		cost,			/* Cost of filter */
+		wildcard;		/* Wildcard source type? */
   size_t	maxsize = 0;		/* Maximum supported file size */
   mime_type_t	*temptype,		/* MIME type looping var */
 		*desttype;		/* Destination MIME type */
@@ -3552,9 +3481,12 @@ add_printer_filter(
   * Add the filter to the MIME database, supporting wildcards as needed...
   */
 
-  for (temptype = mimeFirstType(MimeDatabase);
+  wildcard = super[0] == '*' || type[0] == '*';
+
+  for (temptype = wildcard ? mimeFirstType(MimeDatabase) :
+                             mimeType(MimeDatabase, super, type);
        temptype;
-       temptype = mimeNextType(MimeDatabase))
+       temptype = wildcard ? mimeNextType(MimeDatabase) : NULL)
     if (((super[0] == '*' && _cups_strcasecmp(temptype->super, "printer")) ||
          !_cups_strcasecmp(temptype->super, super)) &&
         (type[0] == '*' || !_cups_strcasecmp(temptype->type, type)))
@@ -3575,7 +3507,8 @@ add_printer_filter(
 	                  "add_printer_filter: %s: adding filter %s/%s %s/%s "
 	                  "0 -", p->name, desttype->super, desttype->type,
 		          filtertype->super, filtertype->type);
-          mimeAddFilter(MimeDatabase, desttype, filtertype, 0, "-");
+          add_printer_mime_filter(p, mimeAddFilter(MimeDatabase, desttype,
+                                                   filtertype, 0, "-"));
         }
       }
       else
@@ -3590,7 +3523,11 @@ add_printer_filter(
       }
 
       if (filterptr)
+      {
 	filterptr->maxsize = maxsize;
+
+	add_printer_mime_filter(p, filterptr);
+      }
     }
 }
 
@@ -3749,6 +3686,61 @@ add_printer_formats(cupsd_printer_t *p)	/* I - Printer */
 }
 
 
+/*
+ * 'add_printer_mime_filter()' - Remember a MIME filter added for a printer.
+ */
+
+static void
+add_printer_mime_filter(
+    cupsd_printer_t *p,			/* I - Printer */
+    mime_filter_t   *filter)		/* I - MIME filter */
+{
+  if (!filter)
+    return;
+
+  if (!p->filters)
+    p->filters = cupsArrayNew(NULL, NULL);
+
+  if (!cupsArrayFind(p->filters, filter))
+    cupsArrayAdd(p->filters, filter);
+}
+
+
+/*
+ * 'compare_ppd_attrs()' - Compare two shared PPD attribute sets.
+ */
+
+static int				/* O - Result of comparison */
+compare_ppd_attrs(cupsd_ppdattrs_t *a,	/* I - First attributes */
+                  cupsd_ppdattrs_t *b,	/* I - Second attributes */
+		  void             *data)/* I - App data (not used) */
+{
+  (void)data;
+
+  if (a->size < b->size)
+    return (-1);
+  else if (a->size > b->size)
+    return (1);
+  else
+    return (memcmp(a->hash, b->hash, sizeof(a->hash)));
+}
+
+
+/*
+ * 'compare_ppd_loads()' - Compare two PPD caches loaded at startup.
+ */
+
+static int				/* O - Result of comparison */
+compare_ppd_loads(cupsd_ppdload_t *a,	/* I - First PPD cache */
+                  cupsd_ppdload_t *b,	/* I - Second PPD cache */
+		  void            *data)/* I - App data (not used) */
+{
+  (void)data;
+
+  return (strcmp(a->name, b->name));
+}
+
+
 /*
  * 'compare_printers()' - Compare two printers.
  */
@@ -3765,6 +3757,40 @@ compare_printers(void *first,		/* I - First printer */
 }
 
 
+/*
+ * 'create_printer_conf()' - Create a printers.conf or printers.d file and
+ *                           write the header.
+ */
+
+static cups_file_t *			/* O - File or NULL on error */
+create_printer_conf(
+    const char *filename)		/* I - Filename */
+{
+  cups_file_t	*fp;			/* File */
+  char		temp[1024];		/* Temporary string */
+  time_t	curtime;		/* Current time */
+  struct tm	curdate;		/* Current date */
+
+
+  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm & 0600)) == NULL)
+    return (NULL);
+
+ /*
+  * Write a small header to the file...
+  */
+
+  time(&curtime);
+  localtime_r(&curtime, &curdate);
+  strftime(temp, sizeof(temp) - 1, "%Y-%m-%d %H:%M", &curdate);
+
+  cupsFilePuts(fp, "# Printer configuration file for " CUPS_SVERSION "\n");
+  cupsFilePrintf(fp, "# Written by cupsd on %s\n", temp);
+  cupsFilePuts(fp, "# DO NOT EDIT THIS FILE WHEN CUPSD IS RUNNING\n");
+
+  return (fp);
+}
+
+
 /*
  * 'delete_printer_filters()' - Delete all MIME filters for a printer.
  */
@@ -3785,22 +3811,17 @@ delete_printer_filters(
     return;
 
  /*
-  * Remove all filters from the MIME database that have a destination
-  * type == printer...
+  * Remove all filters from the MIME database that were added for the
+  * printer...
   */
 
-  for (filter = mimeFirstFilter(MimeDatabase);
+  for (filter = (mime_filter_t *)cupsArrayFirst(p->filters);
        filter;
-       filter = mimeNextFilter(MimeDatabase))
-    if (filter->dst == p->filetype || filter->dst == p->prefiltertype ||
-        cupsArrayFind(p->dest_types, filter->dst))
-    {
-     /*
-      * Delete the current filter...
-      */
+       filter = (mime_filter_t *)cupsArrayNext(p->filters))
+    mimeDeleteFilter(MimeDatabase, filter);
 
-      mimeDeleteFilter(MimeDatabase, filter);
-    }
+  cupsArrayDelete(p->filters);
+  p->filters = NULL;
 
   for (type = (mime_type_t *)cupsArrayFirst(p->dest_types);
        type;
@@ -3816,21 +3837,27 @@ delete_printer_filters(
 
 
 /*
- * 'dirty_printer()' - Mark config and state files dirty for the specified
- *                     printer.
+ * 'free_ppd_loads()' - Free any PPD caches that were not used by a printer.
  */
 
 static void
-dirty_printer(cupsd_printer_t *p)	/* I - Printer */
+free_ppd_loads(void)
 {
-  if (p->type & CUPS_PRINTER_CLASS)
-    cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
-  else
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+  cupsd_ppdload_t	*load;		/* Current PPD cache */
 
-  if (PrintcapFormat == PRINTCAP_PLIST)
-    cupsdMarkDirty(CUPSD_DIRTY_PRINTCAP);
-}
+
+  for (load = (cupsd_ppdload_t *)cupsArrayFirst(ppd_loads);
+       load;
+       load = (cupsd_ppdload_t *)cupsArrayNext(ppd_loads))
+  {
+    _ppdCacheDestroy(load->pc);
+    ippDelete(load->attrs);
+    free(load);
+  }
+
+  cupsArrayDelete(ppd_loads);
+  ppd_loads = NULL;
+}
 
 
 /*
@@ -3901,27 +3928,73 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
 
   snprintf(ppd_name, sizeof(ppd_name), "%s/ppd/%s.ppd", ServerRoot, p->name);
   if (stat(ppd_name, &ppd_info))
+  {
+    memset(&ppd_info, 0, sizeof(ppd_info));
     ppd_info.st_mtime = 1;
+  }
+
+ /*
+  * Keep the current PPD attributes if the PPD file has not changed since it
+  * was last loaded...
+  */
+
+  if (p->pc && p->ppd_attrs && ppd_info.st_mtime == p->ppd_mtime &&
+      ppd_info.st_size == p->ppd_size && ppd_info.st_ino == p->ppd_ino)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "load_ppd: %s is unchanged.", ppd_name);
+    return;
+  }
 
   snprintf(strings_name, sizeof(strings_name), "%s/%s.strings", CacheDir, p->name);
 
-  ippDelete(p->ppd_attrs);
-  p->ppd_attrs = NULL;
+  release_ppd_attrs(p);
 
   _ppdCacheDestroy(p->pc);
   p->pc = NULL;
 
+  p->ppd_mtime = ppd_info.st_mtime;
+  p->ppd_size  = ppd_info.st_size;
+  p->ppd_ino   = ppd_info.st_ino;
+
   if (cache_info.st_mtime >= ppd_info.st_mtime)
   {
-    cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", cache_name);
+    cupsd_ppdload_t	key,		/* Search key */
+			*load;		/* PPD cache loaded at startup */
+
+
+    strlcpy(key.name, p->name, sizeof(key.name));
 
-    if ((p->pc = _ppdCacheCreateWithFile(cache_name, &p->ppd_attrs)) != NULL &&
-        p->ppd_attrs)
+    if ((load = (cupsd_ppdload_t *)cupsArrayFind(ppd_loads, &key)) != NULL &&
+        load->ppd_mtime == ppd_info.st_mtime)
     {
      /*
-      * Loaded successfully!
+      * Use the cache that load_ppds already read...
       */
 
+      p->pc        = load->pc;
+      p->ppd_attrs = load->attrs;
+      load->pc     = NULL;
+      load->attrs  = NULL;
+    }
+    else
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", cache_name);
+
+      p->pc = _ppdCacheCreateWithFile(cache_name, &p->ppd_attrs);
+    }
+
+    if (p->pc && p->ppd_attrs)
+    {
+     /*
+      * Loaded successfully!  The port monitor is now a configuration
+      * attribute, so drop it from older cache files...
+      */
+
+      if ((attr = ippFindAttribute(p->ppd_attrs, "port-monitor",
+                                   IPP_TAG_NAME)) != NULL)
+        ippDeleteAttribute(p->ppd_attrs, attr);
+
+      share_ppd_attrs(p, ppd_name, ppd_info.st_size);
       return;
     }
   }
@@ -3930,7 +4003,7 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
   * Reload PPD attributes from disk...
   */
 
-  cupsdMarkDirty(CUPSD_DIRTY_PRINTERS);
+  cupsdMarkPrinterDirty(p);
 
   cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Loading %s...", ppd_name);
 
@@ -4779,12 +4852,10 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     }
 
    /*
-    * Show current and available port monitors for this printer...
+    * Show available port monitors for this printer; the current port monitor
+    * is added by cupsdSetPrinterAttrs...
     */
 
-    ippAddString(p->ppd_attrs, IPP_TAG_PRINTER, IPP_TAG_NAME, "port-monitor",
-		 NULL, p->port_monitor ? p->port_monitor : "none");
-
     for (i = 1, ppd_attr = ppdFindAttr(ppd, "cupsPortMonitor", NULL);
 	 ppd_attr;
 	 i ++, ppd_attr = ppdFindNextAttr(ppd, "cupsPortMonitor", NULL));
@@ -5026,6 +5097,8 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
     cupsdLogMessage(CUPSD_LOG_DEBUG, "load_ppd: Saving %s...", cache_name);
 
     _ppdCacheWriteFile(p->pc, cache_name, p->ppd_attrs);
+
+    share_ppd_attrs(p, ppd_name, ppd_info.st_size);
   }
   else
   {
@@ -5040,30 +5113,1078 @@ load_ppd(cupsd_printer_t *p)		/* I - Printer */
 
 
 /*
- * 'new_media_col()' - Create a media-col collection value.
+ * 'load_ppd_thread()' - Load PPD caches until none are left.
  */
 
-static ipp_t *				/* O - Collection value */
-new_media_col(pwg_size_t *size)		/* I - media-size/margin values */
+static void *				/* O - Thread exit status */
+load_ppd_thread(void *data)		/* I - Thread data (not used) */
 {
-  ipp_t	*media_col,			/* Collection value */
-	*media_size;			/* media-size value */
+  cupsd_ppdload_t	*load;		/* Current PPD cache */
+  char			cache_name[1024];/* Cache filename */
 
 
-  media_col = ippNew();
+  (void)data;
 
-  media_size = ippNew();
-  ippAddInteger(media_size, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "x-dimension", size->width);
-  ippAddInteger(media_size, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "y-dimension", size->length);
-  ippAddCollection(media_col, IPP_TAG_PRINTER, "media-size", media_size);
-  ippDelete(media_size);
+  for (;;)
+  {
+    _cupsMutexLock(&ppd_loads_mutex);
+    load = (cupsd_ppdload_t *)cupsArrayIndex(ppd_loads, ppd_loads_next ++);
+    _cupsMutexUnlock(&ppd_loads_mutex);
 
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-bottom-margin", size->bottom);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-left-margin", size->left);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-right-margin", size->right);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-top-margin", size->top);
+    if (!load)
+      break;
 
-  return (media_col);
+    snprintf(cache_name, sizeof(cache_name), "%s/%s.data", CacheDir, load->name);
+    load->pc = _ppdCacheCreateWithFile(cache_name, &load->attrs);
+  }
+
+  return (NULL);
+}
+
+
+/*
+ * 'load_ppds()' - Load up-to-date PPD caches using multiple threads.
+ */
+
+static void
+load_ppds(void)
+{
+  int			i,		/* Looping var */
+			num_threads;	/* Number of threads */
+  _cups_thread_t	threads[CUPSD_PPDLOAD_THREADS];
+					/* Loading threads */
+  cups_dir_t		*dir;		/* PPD directory */
+  cups_dentry_t		*dent;		/* Directory entry */
+  char			filename[1024],	/* PPD directory or cache filename */
+			*ext;		/* Extension in PPD filename */
+  struct stat		cache_info;	/* Cache file info */
+  cupsd_ppdload_t	*load;		/* PPD cache to load */
+
+
+ /*
+  * Find the PPD files that have an up-to-date cache...
+  */
+
+  free_ppd_loads();
+
+  snprintf(filename, sizeof(filename), "%s/ppd", ServerRoot);
+  if ((dir = cupsDirOpen(filename)) == NULL)
+    return;
+
+  ppd_loads = cupsArrayNew((cups_array_func_t)compare_ppd_loads, NULL);
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if ((ext = strrchr(dent->filename, '.')) == NULL || strcmp(ext, ".ppd") ||
+        (size_t)(ext - dent->filename) >= sizeof(load->name))
+      continue;
+
+    *ext = '\0';
+
+    snprintf(filename, sizeof(filename), "%s/%s.data", CacheDir, dent->filename);
+    if (stat(filename, &cache_info) ||
+        cache_info.st_mtime < dent->fileinfo.st_mtime)
+      continue;
+
+    if ((load = calloc(1, sizeof(cupsd_ppdload_t))) == NULL)
+      break;
+
+    strlcpy(load->name, dent->filename, sizeof(load->name));
+    load->ppd_mtime = dent->fileinfo.st_mtime;
+
+    cupsArrayAdd(ppd_loads, load);
+  }
+
+  cupsDirClose(dir);
+
+  if (cupsArrayCount(ppd_loads) == 0)
+  {
+    free_ppd_loads();
+    return;
+  }
+
+ /*
+  * Then load them using up to one thread per CPU...
+  */
+
+  if ((num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    num_threads = 1;
+  else if (num_threads > CUPSD_PPDLOAD_THREADS)
+    num_threads = CUPSD_PPDLOAD_THREADS;
+
+  if (num_threads > cupsArrayCount(ppd_loads))
+    num_threads = cupsArrayCount(ppd_loads);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Loading %d PPD caches using %d thread(s)...", cupsArrayCount(ppd_loads), num_threads);
+
+  ppd_loads_next = 0;
+
+  for (i = 0; i < num_threads; i ++)
+    if ((threads[i] = _cupsThreadCreate((_cups_thread_func_t)load_ppd_thread, NULL)) == 0)
+      break;
+
+  num_threads = i;
+
+  if (num_threads == 0)
+    load_ppd_thread(NULL);
+
+  for (i = 0; i < num_threads; i ++)
+    _cupsThreadWait(threads[i]);
+}
+
+
+/*
+ * 'load_printers()' - Load printers from a printers.conf or printers.d file.
+ */
+
+static void
+load_printers(cups_file_t *fp,		/* I - File to read from */
+              const char  *filename)	/* I - Filename for messages */
+{
+  int			i;		/* Looping var */
+  int			linenum;	/* Current line number */
+  char			line[4096],	/* Line from file */
+			*value,		/* Pointer to value */
+			*valueptr;	/* Pointer into value */
+  cupsd_printer_t	*p;		/* Current printer */
+
+
+ /*
+  * Read printer configurations until we hit EOF...
+  */
+
+  linenum = 0;
+  p       = NULL;
+
+  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  {
+   /*
+    * Decode the directive...
+    */
+
+    if (!_cups_strcasecmp(line, "NextPrinterId"))
+    {
+      if (value && (i = atoi(value)) > 0)
+        NextPrinterId = i;
+      else
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "<Printer") || !_cups_strcasecmp(line, "<DefaultPrinter"))
+    {
+     /*
+      * <Printer name> or <DefaultPrinter name>
+      */
+
+      if (p == NULL && value)
+      {
+       /*
+        * Add the printer and a base file type...
+	*/
+
+        cupsdLogMessage(CUPSD_LOG_DEBUG, "Loading printer %s...", value);
+
+        p = cupsdAddPrinter(value);
+	p->accepting = 1;
+	p->state     = IPP_PRINTER_IDLE;
+
+       /*
+        * Set the default printer as needed...
+	*/
+
+        if (!_cups_strcasecmp(line, "<DefaultPrinter"))
+	  DefaultPrinter = p;
+      }
+      else
+        cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "</Printer>") || !_cups_strcasecmp(line, "</DefaultPrinter>"))
+    {
+      if (p != NULL)
+      {
+       /*
+        * Close out the current printer...
+	*/
+
+        if (!p->printer_id)
+        {
+          p->printer_id = NextPrinterId ++;
+          cupsdMarkPrinterDirty(p);
+	}
+
+        cupsdSetPrinterAttrs(p);
+
+        if (strncmp(p->device_uri, "file:", 5) && p->state != IPP_PRINTER_STOPPED)
+	{
+	 /*
+          * See if the backend exists...
+	  */
+
+	  snprintf(line, sizeof(line), "%s/backend/%s", ServerBin, p->device_uri);
+
+          if ((valueptr = strchr(line + strlen(ServerBin), ':')) != NULL)
+	    *valueptr = '\0';		/* Chop everything but URI scheme */
+
+          if (access(line, 0))
+	  {
+	   /*
+	    * Backend does not exist, stop printer...
+	    */
+
+	    p->state = IPP_PRINTER_STOPPED;
+	    snprintf(p->state_message, sizeof(p->state_message), "Backend %s does not exist!", line);
+	  }
+        }
+
+        p = NULL;
+      }
+      else
+        cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!p)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+                      "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "PrinterId"))
+    {
+      if (value && (i = atoi(value)) > 0)
+        p->printer_id = i;
+      else
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad PrinterId on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "UUID"))
+    {
+      if (value && !strncmp(value, "urn:uuid:", 9))
+        cupsdSetString(&(p->uuid), value);
+      else
+        cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Bad UUID on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "AuthInfoRequired"))
+    {
+      if (!cupsdSetAuthInfoRequired(p, value, NULL))
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+			"Bad AuthInfoRequired on line %d of %s.",
+			linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "Info"))
+    {
+      cupsdSetString(&p->info, value ? value : "");
+    }
+    else if (!_cups_strcasecmp(line, "MakeModel"))
+    {
+      if (value)
+	cupsdSetString(&p->make_model, value);
+    }
+    else if (!_cups_strcasecmp(line, "Location"))
+    {
+      cupsdSetString(&p->location, value ? value : "");
+    }
+    else if (!_cups_strcasecmp(line, "GeoLocation"))
+    {
+      cupsdSetString(&p->geo_location, value ? value : "");
+    }
+    else if (!_cups_strcasecmp(line, "Organization"))
+    {
+      cupsdSetString(&p->organization, value ? value : "");
+    }
+    else if (!_cups_strcasecmp(line, "OrganizationalUnit"))
+    {
+      cupsdSetString(&p->organizational_unit, value ? value : "");
+    }
+    else if (!_cups_strcasecmp(line, "DeviceURI"))
+    {
+      if (value)
+	cupsdSetDeviceURI(p, value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "Option") && value)
+    {
+     /*
+      * Option name value
+      */
+
+      for (valueptr = value; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+
+      if (!*valueptr)
+        cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+      else
+      {
+        for (; *valueptr && isspace(*valueptr & 255); *valueptr++ = '\0');
+
+        p->num_options = cupsAddOption(value, valueptr, p->num_options,
+	                               &(p->options));
+      }
+    }
+    else if (!_cups_strcasecmp(line, "PortMonitor"))
+    {
+      if (value && strcmp(value, "none"))
+	cupsdSetString(&p->port_monitor, value);
+      else if (value)
+        cupsdClearString(&p->port_monitor);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "Reason"))
+    {
+      if (value &&
+          strcmp(value, "connecting-to-device") &&
+          strcmp(value, "cups-insecure-filter-warning") &&
+          strcmp(value, "cups-missing-filter-warning"))
+      {
+        cupsdAddPrinterReason(p, value);
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "State"))
+    {
+     /*
+      * Set the initial queue state...
+      */
+
+      if (value && !_cups_strcasecmp(value, "idle"))
+        p->state = IPP_PRINTER_IDLE;
+      else if (value && !_cups_strcasecmp(value, "stopped"))
+      {
+        p->state = IPP_PRINTER_STOPPED;
+
+        cupsdAddPrinterReason(p, "paused");
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "StateMessage"))
+    {
+     /*
+      * Set the initial queue state message...
+      */
+
+      if (value)
+	strlcpy(p->state_message, value, sizeof(p->state_message));
+    }
+    else if (!_cups_strcasecmp(line, "StateTime"))
+    {
+     /*
+      * Set the state time...
+      */
+
+      if (value)
+        p->state_time = atoi(value);
+    }
+    else if (!_cups_strcasecmp(line, "ConfigTime"))
+    {
+     /*
+      * Set the config time...
+      */
+
+      if (value)
+        p->config_time = atoi(value);
+    }
+    else if (!_cups_strcasecmp(line, "Accepting"))
+    {
+     /*
+      * Set the initial accepting state...
+      */
+
+      if (value &&
+          (!_cups_strcasecmp(value, "yes") ||
+           !_cups_strcasecmp(value, "on") ||
+           !_cups_strcasecmp(value, "true")))
+        p->accepting = 1;
+      else if (value &&
+               (!_cups_strcasecmp(value, "no") ||
+        	!_cups_strcasecmp(value, "off") ||
+        	!_cups_strcasecmp(value, "false")))
+        p->accepting = 0;
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "Type"))
+    {
+      if (value)
+        p->type = (cups_ptype_t)atoi(value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "Shared"))
+    {
+     /*
+      * Set the initial shared state...
+      */
+
+      if (value &&
+          (!_cups_strcasecmp(value, "yes") ||
+           !_cups_strcasecmp(value, "on") ||
+           !_cups_strcasecmp(value, "true")))
+        p->shared = 1;
+      else if (value &&
+               (!_cups_strcasecmp(value, "no") ||
+        	!_cups_strcasecmp(value, "off") ||
+        	!_cups_strcasecmp(value, "false")))
+        p->shared = 0;
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "JobSheets"))
+    {
+     /*
+      * Set the initial job sheets...
+      */
+
+      if (value)
+      {
+	for (valueptr = value; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+
+	if (*valueptr)
+          *valueptr++ = '\0';
+
+	cupsdSetString(&p->job_sheets[0], value);
+
+	while (isspace(*valueptr & 255))
+          valueptr ++;
+
+	if (*valueptr)
+	{
+          for (value = valueptr; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+
+	  if (*valueptr)
+            *valueptr = '\0';
+
+	  cupsdSetString(&p->job_sheets[1], value);
+	}
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "AllowUser"))
+    {
+      if (value)
+      {
+        p->deny_users = 0;
+        cupsdAddString(&(p->users), value);
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "DenyUser"))
+    {
+      if (value)
+      {
+        p->deny_users = 1;
+        cupsdAddString(&(p->users), value);
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "QuotaPeriod"))
+    {
+      if (value)
+        p->quota_period = atoi(value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "PageLimit"))
+    {
+      if (value)
+        p->page_limit = atoi(value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "KLimit"))
+    {
+      if (value)
+        p->k_limit = atoi(value);
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "OpPolicy"))
+    {
+      if (value)
+      {
+        cupsd_policy_t *pol;		/* Policy */
+
+
+        if ((pol = cupsdFindPolicy(value)) != NULL)
+	{
+          cupsdSetString(&p->op_policy, value);
+	  p->op_policy_ptr = pol;
+	}
+	else
+	  cupsdLogMessage(CUPSD_LOG_ERROR,
+	                  "Bad policy \"%s\" on line %d of %s",
+			  value, linenum, filename);
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "ErrorPolicy"))
+    {
+      if (value)
+      {
+	if (strcmp(value, "retry-current-job") &&
+	    strcmp(value, "abort-job") &&
+	    strcmp(value, "retry-job") &&
+	    strcmp(value, "stop-printer"))
+	  cupsdLogMessage(CUPSD_LOG_ALERT, "Invalid ErrorPolicy \"%s\" on line %d or %s.", ErrorPolicy, linenum, filename);
+	else
+	  cupsdSetString(&p->error_policy, value);
+      }
+      else
+	cupsdLogMessage(CUPSD_LOG_ERROR, "Syntax error on line %d of %s.", linenum, filename);
+    }
+    else if (!_cups_strcasecmp(line, "Attribute") && value)
+    {
+      for (valueptr = value; *valueptr && !isspace(*valueptr & 255); valueptr ++);
+
+      if (!*valueptr)
+        cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of %s.", linenum, filename);
+      else
+      {
+        for (; *valueptr && isspace(*valueptr & 255); *valueptr++ = '\0');
+
+        if (!p->attrs)
+	  cupsdSetPrinterAttrs(p);
+
+        if (!strcmp(value, "marker-change-time"))
+	  p->marker_time = atoi(valueptr);
+	else
+          cupsdSetPrinterAttr(p, value, valueptr);
+      }
+    }
+    else if (_cups_strcasecmp(line, "Filter") &&
+             _cups_strcasecmp(line, "Prefilter") &&
+             _cups_strcasecmp(line, "Product"))
+    {
+     /*
+      * Something else we don't understand (and that wasn't used in a prior
+      * release of CUPS...
+      */
+
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+                      "Unknown configuration directive %s on line %d of "
+		      "%s.", line, linenum, filename);
+    }
+  }
+}
+
+
+/*
+ * 'new_media_col()' - Create a media-col collection value.
+ */
+
+static ipp_t *				/* O - Collection value */
+new_media_col(pwg_size_t *size)		/* I - media-size/margin values */
+{
+  ipp_t	*media_col,			/* Collection value */
+	*media_size;			/* media-size value */
+
+
+  media_col = ippNew();
+
+  media_size = ippNew();
+  ippAddInteger(media_size, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "x-dimension", size->width);
+  ippAddInteger(media_size, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "y-dimension", size->length);
+  ippAddCollection(media_col, IPP_TAG_PRINTER, "media-size", media_size);
+  ippDelete(media_size);
+
+  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-bottom-margin", size->bottom);
+  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-left-margin", size->left);
+  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-right-margin", size->right);
+  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "media-top-margin", size->top);
+
+  return (media_col);
+}
+
+
+/*
+ * 'reason_bit()' - Return the bit for a registered printer-state-reasons
+ *                  keyword.
+ */
+
+static int				/* O - Bit number or -1 if not registered */
+reason_bit(const char *reason)		/* I - Reason keyword */
+{
+  int	left,				/* Left side of search */
+	right,				/* Right side of search */
+	current,			/* Current keyword */
+	diff;				/* Result of comparison */
+
+
+  for (left = 0, right = (int)(sizeof(printer_reasons) / sizeof(printer_reasons[0])) - 1; left <= right;)
+  {
+    current = (left + right) / 2;
+
+    if ((diff = strcmp(reason, printer_reasons[current])) == 0)
+      return (current);
+    else if (diff < 0)
+      right = current - 1;
+    else
+      left  = current + 1;
+  }
+
+  return (-1);
+}
+
+
+/*
+ * 'release_ppd_attrs()' - Release the PPD attributes used by a printer.
+ */
+
+static void
+release_ppd_attrs(cupsd_printer_t *p)	/* I - Printer */
+{
+  cupsd_ppdattrs_t	*pattrs;	/* Shared attributes */
+
+
+  if (!p->ppd_attrs)
+    return;
+
+  _cupsMutexLock(&ppd_attrs_mutex);
+
+  for (pattrs = (cupsd_ppdattrs_t *)cupsArrayFirst(ppd_attrs_cache);
+       pattrs;
+       pattrs = (cupsd_ppdattrs_t *)cupsArrayNext(ppd_attrs_cache))
+    if (pattrs->attrs == p->ppd_attrs)
+      break;
+
+  if (!pattrs)
+    ippDelete(p->ppd_attrs);
+  else if (-- pattrs->refcount == 0)
+  {
+    cupsArrayRemove(ppd_attrs_cache, pattrs);
+    ippDelete(pattrs->attrs);
+    free(pattrs);
+  }
+
+  _cupsMutexUnlock(&ppd_attrs_mutex);
+
+  p->ppd_attrs = NULL;
+}
+
+
+/*
+ * 'remove_printer_confs()' - Remove the files in the printers.d directory.
+ */
+
+static void
+remove_printer_confs(
+    const char *dirname)		/* I - printers.d directory */
+{
+  cups_dir_t	*dir;			/* Directory */
+  cups_dentry_t	*dent;			/* Directory entry */
+  char		filename[1024];		/* Filename */
+
+
+  if ((dir = cupsDirOpen(dirname)) == NULL)
+    return;
+
+  while ((dent = cupsDirRead(dir)) != NULL)
+  {
+    if (!S_ISREG(dent->fileinfo.st_mode) || !strstr(dent->filename, ".conf"))
+      continue;
+
+    if (snprintf(filename, sizeof(filename), "%s/%s", dirname, dent->filename) < (int)sizeof(filename))
+      unlink(filename);
+  }
+
+  cupsDirClose(dir);
+
+  cupsdStampConfFile(dirname);
+}
+
+
+/*
+ * 'same_printcap()' - See if a new printcap file matches the current one.
+ */
+
+static int				/* O - 1 if the same, 0 otherwise */
+same_printcap(const char *tempfile)	/* I - New printcap file */
+{
+  int		fd1,			/* Current printcap */
+		fd2;			/* New printcap */
+  struct stat	info1,			/* Current printcap information */
+		info2;			/* New printcap information */
+  ssize_t	bytes1,			/* Bytes read from current printcap */
+		bytes2;			/* Bytes read from new printcap */
+  char		buffer1[8192],		/* Current printcap buffer */
+		buffer2[8192];		/* New printcap buffer */
+  int		same = 0;		/* Same contents? */
+
+
+  if ((fd1 = open(Printcap, O_RDONLY)) < 0)
+    return (0);
+
+  if ((fd2 = open(tempfile, O_RDONLY)) < 0)
+  {
+    close(fd1);
+    return (0);
+  }
+
+  if (!fstat(fd1, &info1) && !fstat(fd2, &info2) && S_ISREG(info1.st_mode) &&
+      info1.st_size == info2.st_size && info1.st_mode == info2.st_mode)
+  {
+    do
+    {
+      bytes1 = read(fd1, buffer1, sizeof(buffer1));
+      bytes2 = read(fd2, buffer2, sizeof(buffer2));
+
+      if (bytes1 != bytes2 || bytes1 < 0 ||
+          memcmp(buffer1, buffer2, (size_t)bytes1))
+        break;
+    }
+    while (bytes1 > 0);
+
+    same = bytes1 == 0 && bytes2 == 0;
+  }
+
+  close(fd1);
+  close(fd2);
+
+  return (same);
+}
+
+
+/*
+ * 'share_ppd_attrs()' - Share PPD attributes with printers using the same PPD.
+ */
+
+static void
+share_ppd_attrs(cupsd_printer_t *p,	/* I - Printer */
+                const char      *ppd_name,/* I - PPD filename */
+                off_t           ppd_size)/* I - Size of PPD file */
+{
+  int			fd;		/* PPD file */
+  char			*buffer;	/* PPD file contents */
+  ssize_t		bytes;		/* Bytes read */
+  off_t			total;		/* Total bytes read */
+  cupsd_ppdattrs_t	key,		/* Search key */
+			*pattrs;	/* Shared attributes */
+
+
+  if (ppd_size <= 0 || (buffer = malloc((size_t)ppd_size)) == NULL)
+    return;
+
+  if ((fd = open(ppd_name, O_RDONLY)) < 0)
+  {
+    free(buffer);
+    return;
+  }
+
+  for (total = 0; total < ppd_size; total += bytes)
+    if ((bytes = read(fd, buffer + total, (size_t)(ppd_size - total))) <= 0)
+      break;
+
+  close(fd);
+
+  memset(&key, 0, sizeof(key));
+  key.size = ppd_size;
+
+  if (total < ppd_size || cupsHashData("sha2-256", buffer, (size_t)ppd_size, key.hash, sizeof(key.hash)) < 0)
+  {
+    free(buffer);
+    return;
+  }
+
+  free(buffer);
+
+  _cupsMutexLock(&ppd_attrs_mutex);
+
+  if (!ppd_attrs_cache)
+    ppd_attrs_cache = cupsArrayNew((cups_array_func_t)compare_ppd_attrs, NULL);
+
+  if ((pattrs = (cupsd_ppdattrs_t *)cupsArrayFind(ppd_attrs_cache, &key)) != NULL)
+  {
+   /*
+    * Use the attributes from another printer with the same PPD...
+    */
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "share_ppd_attrs: %s shares PPD attributes with %d other printer(s).", p->name, pattrs->refcount);
+
+    if (pattrs->attrs != p->ppd_attrs)
+    {
+      ippDelete(p->ppd_attrs);
+      p->ppd_attrs = pattrs->attrs;
+      pattrs->refcount ++;
+    }
+  }
+  else if ((pattrs = calloc(1, sizeof(cupsd_ppdattrs_t))) != NULL)
+  {
+   /*
+    * First printer using this PPD...
+    */
+
+    memcpy(pattrs->hash, key.hash, sizeof(pattrs->hash));
+    pattrs->size     = ppd_size;
+    pattrs->refcount = 1;
+    pattrs->attrs    = p->ppd_attrs;
+
+    cupsArrayAdd(ppd_attrs_cache, pattrs);
+  }
+
+  _cupsMutexUnlock(&ppd_attrs_mutex);
+}
+
+
+/*
+ * 'write_printer()' - Write a printer definition to a printers.conf or
+ *                     printers.d file.
+ */
+
+static void
+write_printer(cups_file_t     *fp,	/* I - File to write to */
+              cupsd_printer_t *printer)	/* I - Printer */
+{
+  int			i;		/* Looping var */
+  char			value[2048],	/* Value string */
+			*ptr,		/* Pointer into value */
+			*name;		/* Current user/group name */
+  cups_option_t		*option;	/* Current option */
+  ipp_attribute_t	*marker;	/* Current marker attribute */
+
+
+  if (printer == DefaultPrinter)
+    cupsFilePrintf(fp, "<DefaultPrinter %s>\n", printer->name);
+  else
+    cupsFilePrintf(fp, "<Printer %s>\n", printer->name);
+
+  if (printer->printer_id)
+    cupsFilePrintf(fp, "PrinterId %d\n", printer->printer_id);
+
+  cupsFilePrintf(fp, "UUID %s\n", printer->uuid);
+
+  if (printer->num_auth_info_required > 0)
+  {
+    switch (printer->num_auth_info_required)
+    {
+      case 1 :
+          strlcpy(value, printer->auth_info_required[0], sizeof(value));
+	  break;
+
+      case 2 :
+          snprintf(value, sizeof(value), "%s,%s",
+		   printer->auth_info_required[0],
+		   printer->auth_info_required[1]);
+	  break;
+
+      case 3 :
+      default :
+          snprintf(value, sizeof(value), "%s,%s,%s",
+		   printer->auth_info_required[0],
+		   printer->auth_info_required[1],
+		   printer->auth_info_required[2]);
+	  break;
+    }
+
+    cupsFilePutConf(fp, "AuthInfoRequired", value);
+  }
+
+  if (printer->info)
+    cupsFilePutConf(fp, "Info", printer->info);
+
+  if (printer->location)
+    cupsFilePutConf(fp, "Location", printer->location);
+
+  if (printer->geo_location)
+    cupsFilePutConf(fp, "GeoLocation", printer->geo_location);
+
+  if (printer->make_model)
+    cupsFilePutConf(fp, "MakeModel", printer->make_model);
+
+  if (printer->organization)
+    cupsFilePutConf(fp, "Organization", printer->organization);
+
+  if (printer->organizational_unit)
+    cupsFilePutConf(fp, "OrganizationalUnit", printer->organizational_unit);
+
+  cupsFilePutConf(fp, "DeviceURI", printer->device_uri);
+
+  if (printer->port_monitor)
+    cupsFilePutConf(fp, "PortMonitor", printer->port_monitor);
+
+  if (printer->state == IPP_PRINTER_STOPPED)
+  {
+    cupsFilePuts(fp, "State Stopped\n");
+
+    if (printer->state_message[0])
+      cupsFilePutConf(fp, "StateMessage", printer->state_message);
+  }
+  else
+    cupsFilePuts(fp, "State Idle\n");
+
+  cupsFilePrintf(fp, "StateTime %d\n", (int)printer->state_time);
+  cupsFilePrintf(fp, "ConfigTime %d\n", (int)printer->config_time);
+
+  for (i = 0; i < printer->num_reasons; i ++)
+    if (strcmp(printer->reasons[i], "connecting-to-device") &&
+        strcmp(printer->reasons[i], "cups-insecure-filter-warning") &&
+        strcmp(printer->reasons[i], "cups-missing-filter-warning"))
+      cupsFilePutConf(fp, "Reason", printer->reasons[i]);
+
+  cupsFilePrintf(fp, "Type %d\n", printer->type);
+
+  if (printer->accepting)
+    cupsFilePuts(fp, "Accepting Yes\n");
+  else
+    cupsFilePuts(fp, "Accepting No\n");
+
+  if (printer->shared)
+    cupsFilePuts(fp, "Shared Yes\n");
+  else
+    cupsFilePuts(fp, "Shared No\n");
+
+  snprintf(value, sizeof(value), "%s %s", printer->job_sheets[0],
+           printer->job_sheets[1]);
+  cupsFilePutConf(fp, "JobSheets", value);
+
+  cupsFilePrintf(fp, "QuotaPeriod %d\n", printer->quota_period);
+  cupsFilePrintf(fp, "PageLimit %d\n", printer->page_limit);
+  cupsFilePrintf(fp, "KLimit %d\n", printer->k_limit);
+
+  for (name = (char *)cupsArrayFirst(printer->users);
+       name;
+       name = (char *)cupsArrayNext(printer->users))
+    cupsFilePutConf(fp, printer->deny_users ? "DenyUser" : "AllowUser", name);
+
+  if (printer->op_policy)
+    cupsFilePutConf(fp, "OpPolicy", printer->op_policy);
+  if (printer->error_policy)
+    cupsFilePutConf(fp, "ErrorPolicy", printer->error_policy);
+
+  for (i = printer->num_options, option = printer->options;
+       i > 0;
+       i --, option ++)
+  {
+    snprintf(value, sizeof(value), "%s %s", option->name, option->value);
+    cupsFilePutConf(fp, "Option", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-colors",
+                                 IPP_TAG_NAME)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s ", marker->name);
+
+    for (i = 0, ptr = value + strlen(value);
+         i < marker->num_values && ptr < (value + sizeof(value) - 1);
+	 i ++)
+    {
+      if (i)
+	*ptr++ = ',';
+
+      strlcpy(ptr, marker->values[i].string.text, (size_t)(value + sizeof(value) - ptr));
+      ptr += strlen(ptr);
+    }
+
+    *ptr = '\0';
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-levels",
+                                 IPP_TAG_INTEGER)) != NULL)
+  {
+    cupsFilePrintf(fp, "Attribute %s %d", marker->name,
+                   marker->values[0].integer);
+    for (i = 1; i < marker->num_values; i ++)
+      cupsFilePrintf(fp, ",%d", marker->values[i].integer);
+    cupsFilePuts(fp, "\n");
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-low-levels",
+                                 IPP_TAG_INTEGER)) != NULL)
+  {
+    cupsFilePrintf(fp, "Attribute %s %d", marker->name,
+                   marker->values[0].integer);
+    for (i = 1; i < marker->num_values; i ++)
+      cupsFilePrintf(fp, ",%d", marker->values[i].integer);
+    cupsFilePuts(fp, "\n");
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-high-levels",
+                                 IPP_TAG_INTEGER)) != NULL)
+  {
+    cupsFilePrintf(fp, "Attribute %s %d", marker->name,
+                   marker->values[0].integer);
+    for (i = 1; i < marker->num_values; i ++)
+      cupsFilePrintf(fp, ",%d", marker->values[i].integer);
+    cupsFilePuts(fp, "\n");
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-message",
+                                 IPP_TAG_TEXT)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s %s", marker->name,
+             marker->values[0].string.text);
+
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-names",
+                                 IPP_TAG_NAME)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s ", marker->name);
+
+    for (i = 0, ptr = value + strlen(value);
+         i < marker->num_values && ptr < (value + sizeof(value) - 1);
+	 i ++)
+    {
+      if (i)
+	*ptr++ = ',';
+
+      strlcpy(ptr, marker->values[i].string.text, (size_t)(value + sizeof(value) - ptr));
+      ptr += strlen(ptr);
+    }
+
+    *ptr = '\0';
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if ((marker = ippFindAttribute(printer->attrs, "marker-types",
+                                 IPP_TAG_KEYWORD)) != NULL)
+  {
+    snprintf(value, sizeof(value), "%s ", marker->name);
+
+    for (i = 0, ptr = value + strlen(value);
+         i < marker->num_values && ptr < (value + sizeof(value) - 1);
+	 i ++)
+    {
+      if (i)
+	*ptr++ = ',';
+
+      strlcpy(ptr, marker->values[i].string.text, (size_t)(value + sizeof(value) - ptr));
+      ptr += strlen(ptr);
+    }
+
+    *ptr = '\0';
+    cupsFilePutConf(fp, "Attribute", value);
+  }
+
+  if (printer->marker_time)
+    cupsFilePrintf(fp, "Attribute marker-change-time %ld\n",
+                   (long)printer->marker_time);
+
+  if (printer == DefaultPrinter)
+    cupsFilePuts(fp, "</DefaultPrinter>\n");
+  else
+    cupsFilePuts(fp, "</Printer>\n");
 }
 
 
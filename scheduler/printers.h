@@ -22,12 +22,25 @@
  * Quota data...
  */
 
+#define CUPSD_QUOTA_BUCKETS	32	/* Number of time buckets per quota */
+
+typedef struct
+{
+  time_t	start;			/* Start of bucket */
+  int		page_count,		/* Pages in bucket */
+		k_count;		/* Kilobytes in bucket */
+} cupsd_qbucket_t;
+
 typedef struct
 {
   char		username[33];		/* User data */
   time_t	next_update;		/* Next update time */
   int		page_count,		/* Count of pages */
 		k_count;		/* Count of kilobytes */
+  int		period,			/* Quota period for buckets */
+		width;			/* Width of each bucket in seconds */
+  cupsd_qbucket_t buckets[CUPSD_QUOTA_BUCKETS];
+					/* Usage over the quota period */
 } cupsd_quota_t;
 
 
@@ -51,6 +64,15 @@ typedef AvahiStringList *cupsd_txt_t;	/* TXT record */
 
 typedef struct cupsd_job_s cupsd_job_t;
 
+#define CUPSD_ATTR_CACHE_MAX	8	/* Cached attribute lists per printer */
+
+typedef struct cupsd_attrcache_s	/**** Cached printer attributes ****/
+{
+  char		*requested;		/* requested-attributes or NULL for all */
+  int		ipp1;			/* Filtered for an IPP/1.x client? */
+  ipp_t		*attrs;			/* Filtered printer attributes */
+} cupsd_attrcache_t;
+
 struct cupsd_printer_s
 {
   _cups_rwlock_t lock;			/* Concurrency lock for background updates */
@@ -71,6 +93,7 @@ struct cupsd_printer_s
   cupsd_policy_t *op_policy_ptr;	/* Pointer to operation policy */
   int		shared;			/* Shared? */
   int		temporary;		/* Temporary queue? */
+  int		local_pending;		/* Waiting for a generated PPD? */
   int		accepting;		/* Accepting jobs? */
   int		holding_new_jobs;	/* Holding new jobs for printing? */
   int		in_implicit_class;	/* In an implicit class? */
@@ -78,6 +101,7 @@ struct cupsd_printer_s
   char		state_message[1024];	/* Printer state message */
   int		num_reasons;		/* Number of printer-state-reasons */
   char		*reasons[64];		/* printer-state-reasons strings */
+  unsigned long long reason_bits;	/* Registered printer-state-reasons set */
   time_t	config_time,		/* Time at this configuration */
 		state_time;		/* Time at this state */
   char		*job_sheets[2];		/* Banners/job sheets */
@@ -90,10 +114,15 @@ struct cupsd_printer_s
   mime_type_t	*filetype,		/* Pseudo-filetype for printer */
 		*prefiltertype;		/* Pseudo-filetype for pre-filters */
   cups_array_t	*filetypes,		/* Supported file types */
-		*dest_types;		/* Destination types for queue */
+		*dest_types,		/* Destination types for queue */
+		*filters;		/* MIME filters for queue */
   cupsd_job_t	*job;			/* Current job in queue */
+  double	ppm;			/* Measured pages per minute */
   ipp_t		*attrs,			/* Attributes supported by this printer */
 		*ppd_attrs;		/* Attributes based on the PPD */
+  cups_array_t	*attr_cache;		/* Filtered copies of attrs/ppd_attrs */
+  int		num_env;		/* Number of cached job environment variables */
+  char		*env[6];		/* Cached job environment variables */
   int		num_printers,		/* Number of printers in class */
 		last_printer;		/* Last printer job was sent to */
   struct cupsd_printer_s **printers;	/* Printers in class */
@@ -112,10 +141,17 @@ struct cupsd_printer_s
 		*alert_description;	/* PSX printer-alert-description value */
   time_t	marker_time;		/* Last time marker attributes were updated */
   _ppd_cache_t	*pc;			/* PPD cache and mapping data */
+  time_t	ppd_mtime;		/* Modification time of loaded PPD */
+  off_t		ppd_size;		/* Size of loaded PPD */
+  ino_t		ppd_ino;		/* Inode of loaded PPD */
+  int		dirty;			/* Needs to be saved to printers.d? */
 
 #if defined(HAVE_DNSSD) || defined(HAVE_AVAHI)
   char		*reg_name,		/* Name used for service registration */
-		*pdl;			/* pdl value for TXT record */
+		*pdl,			/* pdl value for TXT record */
+		*reg_txt;		/* Registered IPP TXT record data */
+  size_t	reg_txtlen;		/* Length of registered TXT record data */
+  int		reg_pending;		/* Waiting to be registered? */
   cupsd_srv_t	ipp_srv;		/* IPP service(s) */
 #  ifdef HAVE_DNSSD
 #    ifdef HAVE_SSL
@@ -153,6 +189,10 @@ VAR cupsd_policy_t	*DefaultPolicyPtr
  */
 
 extern cupsd_printer_t	*cupsdAddPrinter(const char *name);
+extern int		cupsdAddPrinterReason(cupsd_printer_t *p,
+			                      const char *reason);
+extern void		cupsdClearPrinterAttrCache(cupsd_printer_t *p);
+extern void		cupsdClearPrinterReasons(cupsd_printer_t *p);
 extern void		cupsdCreateCommonData(void);
 extern void		cupsdDeleteAllPrinters(void);
 extern int		cupsdDeletePrinter(cupsd_printer_t *p, int update);
@@ -163,9 +203,15 @@ extern cupsd_quota_t	*cupsdFindQuota(cupsd_printer_t *p,
 			                const char *username);
 extern void		cupsdFreeQuotas(cupsd_printer_t *p);
 extern void		cupsdLoadAllPrinters(void);
+extern int		cupsdLoadPrinterEnv(cupsd_printer_t *p, char *envp[], int envmax);
+extern void		cupsdMarkPrinterDirty(cupsd_printer_t *p);
+extern void		cupsdLoadAllQuotas(void);
+extern int		cupsdPrinterHasReason(cupsd_printer_t *p,
+			                      const char *reason);
 extern void		cupsdRenamePrinter(cupsd_printer_t *p,
 			                   const char *name);
 extern void		cupsdSaveAllPrinters(void);
+extern void		cupsdSaveAllQuotas(void);
 extern int		cupsdSetAuthInfoRequired(cupsd_printer_t *p,
 			                         const char *values,
 						 ipp_attribute_t *attr);
@@ -185,6 +231,9 @@ extern int		cupsdUpdatePrinterPPD(cupsd_printer_t *p,
 			                      int num_keywords,
 					      cups_option_t *keywords);
 extern void		cupsdUpdatePrinters(void);
+extern int		cupsdUpdatePrinterSnapshot(cupsd_printer_t *p,
+			                           char *snapfile,
+						   size_t snapsize);
 extern cupsd_quota_t	*cupsdUpdateQuota(cupsd_printer_t *p,
 			                  const char *username, int pages,
 					  int k);
@@ -51,18 +51,43 @@ typedef struct
  */
 
 static cups_array_t	*process_array = NULL;
+#ifdef HAVE_SANDBOX_H
+static char		*profile_key = NULL;
+					/* Configuration for base profiles */
+static char		profile_base[2][1024] = { "", "" };
+					/* Base profiles without/with networking */
+#endif /* HAVE_SANDBOX_H */
 
 
 /*
  * Local functions...
  */
 
+static void	add_process(int pid, int job_id, const char *name);
 static int	compare_procs(cupsd_proc_t *a, cupsd_proc_t *b);
 #ifdef HAVE_SANDBOX_H
+static void	cupsd_profile_key(char *key, size_t keysize);
 static char	*cupsd_requote(char *dst, const char *src, size_t dstsize);
+static int	cupsd_write_profile(char *filename, size_t filesize,
+		                    int allow_networking);
 #endif /* HAVE_SANDBOX_H */
 
 
+/*
+ * 'cupsdAdoptProcess()' - Track a process started before a scheduler upgrade.
+ */
+
+void
+cupsdAdoptProcess(int        pid,	/* I - Process ID */
+                  int        job_id,	/* I - Job ID or 0 for none */
+                  const char *name)	/* I - Name of process */
+{
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdAdoptProcess(pid=%d, job_id=%d, name=\"%s\")", pid, job_id, name);
+
+  add_process(pid, job_id, name);
+}
+
+
 /*
  * 'cupsdCreateProfile()' - Create an execution profile for a subprocess.
  */
@@ -74,15 +99,9 @@ cupsdCreateProfile(int job_id,		/* I - Job ID or 0 for none */
 #ifdef HAVE_SANDBOX_H
   cups_file_t		*fp;		/* File pointer */
   char			profile[1024],	/* File containing the profile */
-			bin[1024],	/* Quoted ServerBin */
-			cache[1024],	/* Quoted CacheDir */
-			domain[1024],	/* Domain socket, if any */
-			request[1024],	/* Quoted RequestRoot */
-			root[1024],	/* Quoted ServerRoot */
-			state[1024],	/* Quoted StateDir */
-			temp[1024];	/* Quoted TempDir */
-  const char		*nodebug;	/* " (with no-log)" for no debug */
-  cupsd_listener_t	*lis;		/* Current listening socket */
+			key[8192],	/* Inputs for the base profiles */
+			request[1024];	/* Quoted RequestRoot */
+  int			i;		/* Looping var */
 
 
   if (!UseSandboxing || Sandboxing == CUPSD_SANDBOXING_OFF)
@@ -96,6 +115,43 @@ cupsdCreateProfile(int job_id,		/* I - Job ID or 0 for none */
     return (NULL);
   }
 
+ /*
+  * Everything but the job file access rules is the same for every job, so
+  * write it once to a base profile that the job profiles import.  The base
+  * profiles are rewritten when the configuration they depend on changes...
+  */
+
+  cupsd_profile_key(key, sizeof(key));
+
+  if (!profile_key || strcmp(key, profile_key))
+  {
+    for (i = 0; i < 2; i ++)
+    {
+      if (profile_base[i][0])
+      {
+        unlink(profile_base[i]);
+        profile_base[i][0] = '\0';
+      }
+    }
+
+    free(profile_key);
+    profile_key = strdup(key);
+  }
+
+  allow_networking = allow_networking ? 1 : 0;
+
+  if (!profile_base[allow_networking][0] && !cupsd_write_profile(profile_base[allow_networking], sizeof(profile_base[0]), allow_networking))
+  {
+   /*
+    * This should never happen, and is fatal when sandboxing is enabled.
+    */
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCreateProfile(job_id=%d, allow_networking=%d) = NULL", job_id, allow_networking);
+    cupsdLogMessage(CUPSD_LOG_EMERG, "Unable to create security profile: %s", strerror(errno));
+    kill(getpid(), SIGTERM);
+    return (NULL);
+  }
+
   if ((fp = cupsTempFile2(profile, sizeof(profile))) == NULL)
   {
    /*
@@ -111,185 +167,10 @@ cupsdCreateProfile(int job_id,		/* I - Job ID or 0 for none */
   fchown(cupsFileNumber(fp), RunUser, Group);
   fchmod(cupsFileNumber(fp), 0640);
 
-  cupsd_requote(bin, ServerBin, sizeof(bin));
-  cupsd_requote(cache, CacheDir, sizeof(cache));
   cupsd_requote(request, RequestRoot, sizeof(request));
-  cupsd_requote(root, ServerRoot, sizeof(root));
-  cupsd_requote(state, StateDir, sizeof(state));
-  cupsd_requote(temp, TempDir, sizeof(temp));
-
-  nodebug = LogLevel < CUPSD_LOG_DEBUG ? " (with no-log)" : "";
 
   cupsFilePuts(fp, "(version 1)\n");
-  if (Sandboxing == CUPSD_SANDBOXING_STRICT)
-    cupsFilePuts(fp, "(deny default)\n");
-  else
-    cupsFilePuts(fp, "(allow default)\n");
-  if (LogLevel >= CUPSD_LOG_DEBUG)
-    cupsFilePuts(fp, "(debug deny)\n");
-  cupsFilePuts(fp, "(import \"system.sb\")\n");
-  cupsFilePuts(fp, "(import \"com.apple.corefoundation.sb\")\n");
-  cupsFilePuts(fp, "(system-network)\n");
-  cupsFilePuts(fp, "(allow mach-per-user-lookup)\n");
-  cupsFilePuts(fp, "(allow ipc-posix-sem)\n");
-  cupsFilePuts(fp, "(allow ipc-posix-shm)\n");
-  cupsFilePuts(fp, "(allow ipc-sysv-shm)\n");
-  cupsFilePuts(fp, "(allow mach-lookup)\n");
-  if (!RunUser)
-    cupsFilePrintf(fp,
-		   "(deny file-write* file-read-data file-read-metadata\n"
-		   "  (regex"
-		   " #\"^/Users$\""
-		   " #\"^/Users/\""
-		   ")%s)\n", nodebug);
-  cupsFilePrintf(fp,
-                 "(deny file-write*\n"
-                 "  (regex"
-		 " #\"^%s$\""		/* ServerRoot */
-		 " #\"^%s/\""		/* ServerRoot/... */
-		 " #\"^/private/etc$\""
-		 " #\"^/private/etc/\""
-		 " #\"^/usr/local/etc$\""
-		 " #\"^/usr/local/etc/\""
-		 " #\"^/Library$\""
-		 " #\"^/Library/\""
-		 " #\"^/System$\""
-		 " #\"^/System/\""
-		 ")%s)\n",
-		 root, root, nodebug);
-  /* Specifically allow applications to stat RequestRoot and some other system folders */
-  cupsFilePrintf(fp,
-                 "(allow file-read-metadata\n"
-                 "  (regex"
-		 " #\"^/$\""		/* / */
-		 " #\"^/usr$\""		/* /usr */
-		 " #\"^/Library$\""	/* /Library */
-		 " #\"^/Library/Printers$\""	/* /Library/Printers */
-		 " #\"^%s$\""		/* RequestRoot */
-		 "))\n",
-		 request);
-  /* Read and write TempDir, CacheDir, and other common folders */
-  cupsFilePuts(fp,
-	       "(allow file-write* file-read-data file-read-metadata\n"
-	       "  (regex"
-	       " #\"^/private/var/db/\""
-	       " #\"^/private/var/folders/\""
-	       " #\"^/private/var/lib/\""
-	       " #\"^/private/var/log/\""
-	       " #\"^/private/var/mysql/\""
-	       " #\"^/private/var/run/\""
-	       " #\"^/private/var/spool/\""
-	       " #\"^/Library/Application Support/\""
-	       " #\"^/Library/Caches/\""
-	       " #\"^/Library/Logs/\""
-	       " #\"^/Library/Preferences/\""
-	       " #\"^/Library/WebServer/\""
-	       " #\"^/Users/Shared/\""
-	       "))\n");
-  cupsFilePrintf(fp,
-		 "(deny file-write*\n"
-		 "       (regex #\"^%s$\")%s)\n",
-		 request, nodebug);
-  cupsFilePrintf(fp,
-		 "(deny file-write* file-read-data file-read-metadata\n"
-		 "       (regex #\"^%s/\")%s)\n",
-		 request, nodebug);
-  cupsFilePrintf(fp,
-                 "(allow file-write* file-read-data file-read-metadata\n"
-                 "  (regex"
-		 " #\"^%s$\""		/* TempDir */
-		 " #\"^%s/\""		/* TempDir/... */
-		 " #\"^%s$\""		/* CacheDir */
-		 " #\"^%s/\""		/* CacheDir/... */
-		 "))\n",
-		 temp, temp, cache, cache);
-  /* Read common folders */
-  cupsFilePrintf(fp,
-                 "(allow file-read-data file-read-metadata\n"
-                 "  (regex"
-                 " #\"^/AppleInternal$\""
-                 " #\"^/AppleInternal/\""
-                 " #\"^/bin$\""		/* /bin */
-                 " #\"^/bin/\""		/* /bin/... */
-                 " #\"^/private$\""
-                 " #\"^/private/etc$\""
-                 " #\"^/private/etc/\""
-                 " #\"^/private/tmp$\""
-                 " #\"^/private/tmp/\""
-                 " #\"^/private/var$\""
-                 " #\"^/private/var/db$\""
-                 " #\"^/private/var/folders$\""
-                 " #\"^/private/var/lib$\""
-                 " #\"^/private/var/log$\""
-                 " #\"^/private/var/mysql$\""
-                 " #\"^/private/var/run$\""
-                 " #\"^/private/var/spool$\""
-                 " #\"^/private/var/tmp$\""
-                 " #\"^/private/var/tmp/\""
-                 " #\"^/usr/bin$\""	/* /usr/bin */
-                 " #\"^/usr/bin/\""	/* /usr/bin/... */
-                 " #\"^/usr/libexec/cups$\""	/* /usr/libexec/cups */
-                 " #\"^/usr/libexec/cups/\""	/* /usr/libexec/cups/... */
-                 " #\"^/usr/libexec/fax$\""	/* /usr/libexec/fax */
-                 " #\"^/usr/libexec/fax/\""	/* /usr/libexec/fax/... */
-                 " #\"^/usr/sbin$\""	/* /usr/sbin */
-                 " #\"^/usr/sbin/\""	/* /usr/sbin/... */
-		 " #\"^/Library$\""	/* /Library */
-		 " #\"^/Library/\""	/* /Library/... */
-		 " #\"^/System$\""	/* /System */
-		 " #\"^/System/\""	/* /System/... */
-		 " #\"^%s/Library$\""	/* RequestRoot/Library */
-		 " #\"^%s/Library/\""	/* RequestRoot/Library/... */
-		 " #\"^%s$\""		/* ServerBin */
-		 " #\"^%s/\""		/* ServerBin/... */
-		 " #\"^%s$\""		/* ServerRoot */
-		 " #\"^%s/\""		/* ServerRoot/... */
-		 " #\"^%s$\""		/* StateDir */
-		 " #\"^%s/\""		/* StateDir/... */
-		 "))\n",
-		 request, request, bin, bin, root, root, state, state);
-  if (Sandboxing == CUPSD_SANDBOXING_RELAXED)
-  {
-    /* Limited write access to /Library/Printers/... */
-    cupsFilePuts(fp,
-		 "(allow file-write*\n"
-		 "  (regex"
-		 " #\"^/Library/Printers/.*/\""
-		 "))\n");
-    cupsFilePrintf(fp,
-		   "(deny file-write*\n"
-		   "  (regex"
-		   " #\"^/Library/Printers/PPDs$\""
-		   " #\"^/Library/Printers/PPDs/\""
-		   " #\"^/Library/Printers/PPD Plugins$\""
-		   " #\"^/Library/Printers/PPD Plugins/\""
-		   ")%s)\n", nodebug);
-  }
-  /* Allow execution of child processes as long as the programs are not in a user directory */
-  cupsFilePuts(fp, "(allow process*)\n");
-  cupsFilePuts(fp, "(deny process-exec (regex #\"^/Users/\"))\n");
-  if (RunUser && getenv("CUPS_TESTROOT"))
-  {
-    /* Allow source directory access in "make test" environment */
-    char	testroot[1024];		/* Root directory of test files */
-
-    cupsd_requote(testroot, getenv("CUPS_TESTROOT"), sizeof(testroot));
-
-    cupsFilePrintf(fp,
-		   "(allow file-write* file-read-data file-read-metadata\n"
-		   "  (regex"
-		   " #\"^%s$\""		/* CUPS_TESTROOT */
-		   " #\"^%s/\""		/* CUPS_TESTROOT/... */
-		   "))\n",
-		   testroot, testroot);
-    cupsFilePrintf(fp,
-		   "(allow process-exec\n"
-		   "  (regex"
-		   " #\"^%s/\""		/* CUPS_TESTROOT/... */
-		   "))\n",
-		   testroot);
-    cupsFilePrintf(fp, "(allow sysctl*)\n");
-  }
+  cupsFilePrintf(fp, "(import \"%s\")\n", profile_base[allow_networking]);
   if (job_id)
   {
     /* Allow job filters to read the current job files... */
@@ -306,52 +187,10 @@ cupsdCreateProfile(int job_id,		/* I - Job ID or 0 for none */
 		 "  (literal \"/usr/sbin/sendmail\")\n"
 		 "  (with no-sandbox))\n");
   }
-  /* Allow access to Bluetooth, USB, and notify_post. */
-  cupsFilePuts(fp, "(allow iokit*)\n");
-  cupsFilePuts(fp, "(allow distributed-notification-post)\n");
-  /* Allow outbound networking to local services */
-  cupsFilePuts(fp, "(allow network-outbound"
-		   "\n       (regex #\"^/private/var/run/\" #\"^/private/tmp/\" #\"^/private/var/tmp/\")");
-  for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
-       lis;
-       lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
-  {
-    if (httpAddrFamily(&(lis->address)) == AF_LOCAL)
-    {
-      httpAddrString(&(lis->address), domain, sizeof(domain));
-      cupsFilePrintf(fp, "\n       (literal \"%s\")", domain);
-    }
-  }
-  if (allow_networking)
-  {
-    /* Allow TCP and UDP networking off the machine... */
-    cupsFilePuts(fp, "\n       (remote tcp))\n");
-    cupsFilePuts(fp, "(allow network-bind)\n"); /* for LPD resvport */
-    cupsFilePuts(fp, "(allow network*\n"
-		     "       (local udp \"*:*\")\n"
-		     "       (remote udp \"*:*\"))\n");
+  cupsFileClose(fp);
 
-    /* Also allow access to device files... */
-    cupsFilePuts(fp, "(allow file-write* file-read-data file-read-metadata file-ioctl\n"
-                     "       (regex #\"^/dev/\"))\n");
-
-    /* And allow kernel extensions to be loaded, e.g., SMB */
-    cupsFilePuts(fp, "(allow system-kext-load)\n");
-  }
-  else
-  {
-    /* Only allow SNMP (UDP) and LPD (TCP) off the machine... */
-    cupsFilePuts(fp, ")\n");
-    cupsFilePuts(fp, "(allow network-outbound\n"
-		     "       (remote udp \"*:161\")\n"
-		     "       (remote tcp \"*:515\"))\n");
-    cupsFilePuts(fp, "(allow network-inbound\n"
-		     "       (local udp \"localhost:*\"))\n");
-  }
-  cupsFileClose(fp);
-
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCreateProfile(job_id=%d,allow_networking=%d) = \"%s\"", job_id, allow_networking, profile);
-  return ((void *)strdup(profile));
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCreateProfile(job_id=%d,allow_networking=%d) = \"%s\"", job_id, allow_networking, profile);
+  return ((void *)strdup(profile));
 
 #else
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCreateProfile(job_id=%d, allow_networking=%d) = NULL", job_id, allow_networking);
@@ -451,6 +290,25 @@ cupsdFinishProcess(int    pid,		/* I - Process ID */
 }
 
 
+/*
+ * 'cupsdHandoffProcesses()' - Save the running processes for a scheduler
+ *                             upgrade.
+ */
+
+void
+cupsdHandoffProcesses(cups_file_t *fp)	/* I - Upgrade state file */
+{
+  cupsd_proc_t	*proc;			/* Current process */
+
+
+  for (proc = (cupsd_proc_t *)cupsArrayFirst(process_array);
+       proc;
+       proc = (cupsd_proc_t *)cupsArrayNext(process_array))
+    cupsFilePrintf(fp, "Process %d %d %s\n", proc->pid, proc->job_id,
+                   proc->name);
+}
+
+
 /*
  * 'cupsdStartProcess()' - Start a process.
  */
@@ -478,7 +336,6 @@ cupsdStartProcess(
 		group_str[16],		/* Group string */
 		nice_str[16];		/* FilterNice string */
   uid_t		user;			/* Command UID */
-  cupsd_proc_t	*proc;			/* New process record */
 #if USE_POSIX_SPAWN
   posix_spawn_file_actions_t actions;	/* Spawn file actions */
   posix_spawnattr_t attrs;		/* Spawn attributes */
@@ -812,23 +669,10 @@ cupsdStartProcess(
   cupsdReleaseSignals();
 #endif /* USE_POSIX_SPAWN */
 
-  if (*pid)
-  {
-    if (!process_array)
-      process_array = cupsArrayNew((cups_array_func_t)compare_procs, NULL);
-
-    if (process_array)
-    {
-      if ((proc = calloc(1, sizeof(cupsd_proc_t) + strlen(command))) != NULL)
-      {
-        proc->pid    = *pid;
-	proc->job_id = job ? job->id : 0;
-	_cups_strcpy(proc->name, command);
+  CUPSD_PROBE3(process__start, *pid, command, job ? job->id : 0);
 
-	cupsArrayAdd(process_array, proc);
-      }
-    }
-  }
+  if (*pid)
+    add_process(*pid, job ? job->id : 0, command);
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
 		  "cupsdStartProcess(command=\"%s\", argv=%p, envp=%p, "
@@ -841,6 +685,35 @@ cupsdStartProcess(
 }
 
 
+/*
+ * 'add_process()' - Add a process to the process array.
+ */
+
+static void
+add_process(int        pid,		/* I - Process ID */
+            int        job_id,		/* I - Job ID or 0 for none */
+            const char *name)		/* I - Name of process */
+{
+  cupsd_proc_t	*proc;			/* New process */
+
+
+  if (!process_array)
+    process_array = cupsArrayNew((cups_array_func_t)compare_procs, NULL);
+
+  if (process_array)
+  {
+    if ((proc = calloc(1, sizeof(cupsd_proc_t) + strlen(name))) != NULL)
+    {
+      proc->pid    = pid;
+      proc->job_id = job_id;
+      _cups_strcpy(proc->name, name);
+
+      cupsArrayAdd(process_array, proc);
+    }
+  }
+}
+
+
 /*
  * 'compare_procs()' - Compare two processes.
  */
@@ -854,6 +727,41 @@ compare_procs(cupsd_proc_t *a,		/* I - First process */
 
 
 #ifdef HAVE_SANDBOX_H
+/*
+ * 'cupsd_profile_key()' - Get the configuration the base profiles depend on.
+ */
+
+static void
+cupsd_profile_key(char   *key,		/* I - Key buffer */
+                  size_t keysize)	/* I - Size of key buffer */
+{
+  char			*keyptr,	/* Pointer into key */
+			*keyend;	/* End of key */
+  const char		*testroot;	/* CUPS_TESTROOT, if any */
+  cupsd_listener_t	*lis;		/* Current listening socket */
+
+
+  testroot = getenv("CUPS_TESTROOT");
+
+  snprintf(key, keysize, "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%d\n%d\n%d", ServerBin, CacheDir, RequestRoot, ServerRoot, StateDir, TempDir, testroot ? testroot : "", LogLevel >= CUPSD_LOG_DEBUG, Sandboxing, (int)RunUser);
+
+  keyptr = key + strlen(key);
+  keyend = key + keysize;
+
+  for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
+       lis && keyptr < (keyend - 2);
+       lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
+  {
+    if (httpAddrFamily(&(lis->address)) == AF_LOCAL)
+    {
+      *keyptr++ = '\n';
+      httpAddrString(&(lis->address), keyptr, (size_t)(keyend - keyptr));
+      keyptr += strlen(keyptr);
+    }
+  }
+}
+
+
 /*
  * 'cupsd_requote()' - Make a regular-expression version of a string.
  */
@@ -888,4 +796,264 @@ cupsd_requote(char       *dst,		/* I - Destination buffer */
 
   return (dst);
 }
+
+
+/*
+ * 'cupsd_write_profile()' - Write a base profile for subprocesses.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+cupsd_write_profile(
+    char   *filename,			/* I - Filename buffer */
+    size_t filesize,			/* I - Size of filename buffer */
+    int    allow_networking)		/* I - Allow networking off machine? */
+{
+  cups_file_t		*fp;		/* File pointer */
+  char			bin[1024],	/* Quoted ServerBin */
+			cache[1024],	/* Quoted CacheDir */
+			domain[1024],	/* Domain socket, if any */
+			request[1024],	/* Quoted RequestRoot */
+			root[1024],	/* Quoted ServerRoot */
+			state[1024],	/* Quoted StateDir */
+			temp[1024];	/* Quoted TempDir */
+  const char		*nodebug;	/* " (with no-log)" for no debug */
+  cupsd_listener_t	*lis;		/* Current listening socket */
+
+
+  if ((fp = cupsTempFile2(filename, (int)filesize)) == NULL)
+  {
+    *filename = '\0';
+    return (0);
+  }
+
+  fchown(cupsFileNumber(fp), RunUser, Group);
+  fchmod(cupsFileNumber(fp), 0640);
+
+  cupsd_requote(bin, ServerBin, sizeof(bin));
+  cupsd_requote(cache, CacheDir, sizeof(cache));
+  cupsd_requote(request, RequestRoot, sizeof(request));
+  cupsd_requote(root, ServerRoot, sizeof(root));
+  cupsd_requote(state, StateDir, sizeof(state));
+  cupsd_requote(temp, TempDir, sizeof(temp));
+
+  nodebug = LogLevel < CUPSD_LOG_DEBUG ? " (with no-log)" : "";
+
+  cupsFilePuts(fp, "(version 1)\n");
+  if (Sandboxing == CUPSD_SANDBOXING_STRICT)
+    cupsFilePuts(fp, "(deny default)\n");
+  else
+    cupsFilePuts(fp, "(allow default)\n");
+  if (LogLevel >= CUPSD_LOG_DEBUG)
+    cupsFilePuts(fp, "(debug deny)\n");
+  cupsFilePuts(fp, "(import \"system.sb\")\n");
+  cupsFilePuts(fp, "(import \"com.apple.corefoundation.sb\")\n");
+  cupsFilePuts(fp, "(system-network)\n");
+  cupsFilePuts(fp, "(allow mach-per-user-lookup)\n");
+  cupsFilePuts(fp, "(allow ipc-posix-sem)\n");
+  cupsFilePuts(fp, "(allow ipc-posix-shm)\n");
+  cupsFilePuts(fp, "(allow ipc-sysv-shm)\n");
+  cupsFilePuts(fp, "(allow mach-lookup)\n");
+  if (!RunUser)
+    cupsFilePrintf(fp,
+		   "(deny file-write* file-read-data file-read-metadata\n"
+		   "  (regex"
+		   " #\"^/Users$\""
+		   " #\"^/Users/\""
+		   ")%s)\n", nodebug);
+  cupsFilePrintf(fp,
+                 "(deny file-write*\n"
+                 "  (regex"
+		 " #\"^%s$\""		/* ServerRoot */
+		 " #\"^%s/\""		/* ServerRoot/... */
+		 " #\"^/private/etc$\""
+		 " #\"^/private/etc/\""
+		 " #\"^/usr/local/etc$\""
+		 " #\"^/usr/local/etc/\""
+		 " #\"^/Library$\""
+		 " #\"^/Library/\""
+		 " #\"^/System$\""
+		 " #\"^/System/\""
+		 ")%s)\n",
+		 root, root, nodebug);
+  /* Specifically allow applications to stat RequestRoot and some other system folders */
+  cupsFilePrintf(fp,
+                 "(allow file-read-metadata\n"
+                 "  (regex"
+		 " #\"^/$\""		/* / */
+		 " #\"^/usr$\""		/* /usr */
+		 " #\"^/Library$\""	/* /Library */
+		 " #\"^/Library/Printers$\""	/* /Library/Printers */
+		 " #\"^%s$\""		/* RequestRoot */
+		 "))\n",
+		 request);
+  /* Read and write TempDir, CacheDir, and other common folders */
+  cupsFilePuts(fp,
+	       "(allow file-write* file-read-data file-read-metadata\n"
+	       "  (regex"
+	       " #\"^/private/var/db/\""
+	       " #\"^/private/var/folders/\""
+	       " #\"^/private/var/lib/\""
+	       " #\"^/private/var/log/\""
+	       " #\"^/private/var/mysql/\""
+	       " #\"^/private/var/run/\""
+	       " #\"^/private/var/spool/\""
+	       " #\"^/Library/Application Support/\""
+	       " #\"^/Library/Caches/\""
+	       " #\"^/Library/Logs/\""
+	       " #\"^/Library/Preferences/\""
+	       " #\"^/Library/WebServer/\""
+	       " #\"^/Users/Shared/\""
+	       "))\n");
+  cupsFilePrintf(fp,
+		 "(deny file-write*\n"
+		 "       (regex #\"^%s$\")%s)\n",
+		 request, nodebug);
+  cupsFilePrintf(fp,
+		 "(deny file-write* file-read-data file-read-metadata\n"
+		 "       (regex #\"^%s/\")%s)\n",
+		 request, nodebug);
+  cupsFilePrintf(fp,
+                 "(allow file-write* file-read-data file-read-metadata\n"
+                 "  (regex"
+		 " #\"^%s$\""		/* TempDir */
+		 " #\"^%s/\""		/* TempDir/... */
+		 " #\"^%s$\""		/* CacheDir */
+		 " #\"^%s/\""		/* CacheDir/... */
+		 "))\n",
+		 temp, temp, cache, cache);
+  /* Read common folders */
+  cupsFilePrintf(fp,
+                 "(allow file-read-data file-read-metadata\n"
+                 "  (regex"
+                 " #\"^/AppleInternal$\""
+                 " #\"^/AppleInternal/\""
+                 " #\"^/bin$\""		/* /bin */
+                 " #\"^/bin/\""		/* /bin/... */
+                 " #\"^/private$\""
+                 " #\"^/private/etc$\""
+                 " #\"^/private/etc/\""
+                 " #\"^/private/tmp$\""
+                 " #\"^/private/tmp/\""
+                 " #\"^/private/var$\""
+                 " #\"^/private/var/db$\""
+                 " #\"^/private/var/folders$\""
+                 " #\"^/private/var/lib$\""
+                 " #\"^/private/var/log$\""
+                 " #\"^/private/var/mysql$\""
+                 " #\"^/private/var/run$\""
+                 " #\"^/private/var/spool$\""
+                 " #\"^/private/var/tmp$\""
+                 " #\"^/private/var/tmp/\""
+                 " #\"^/usr/bin$\""	/* /usr/bin */
+                 " #\"^/usr/bin/\""	/* /usr/bin/... */
+                 " #\"^/usr/libexec/cups$\""	/* /usr/libexec/cups */
+                 " #\"^/usr/libexec/cups/\""	/* /usr/libexec/cups/... */
+                 " #\"^/usr/libexec/fax$\""	/* /usr/libexec/fax */
+                 " #\"^/usr/libexec/fax/\""	/* /usr/libexec/fax/... */
+                 " #\"^/usr/sbin$\""	/* /usr/sbin */
+                 " #\"^/usr/sbin/\""	/* /usr/sbin/... */
+		 " #\"^/Library$\""	/* /Library */
+		 " #\"^/Library/\""	/* /Library/... */
+		 " #\"^/System$\""	/* /System */
+		 " #\"^/System/\""	/* /System/... */
+		 " #\"^%s/Library$\""	/* RequestRoot/Library */
+		 " #\"^%s/Library/\""	/* RequestRoot/Library/... */
+		 " #\"^%s$\""		/* ServerBin */
+		 " #\"^%s/\""		/* ServerBin/... */
+		 " #\"^%s$\""		/* ServerRoot */
+		 " #\"^%s/\""		/* ServerRoot/... */
+		 " #\"^%s$\""		/* StateDir */
+		 " #\"^%s/\""		/* StateDir/... */
+		 "))\n",
+		 request, request, bin, bin, root, root, state, state);
+  if (Sandboxing == CUPSD_SANDBOXING_RELAXED)
+  {
+    /* Limited write access to /Library/Printers/... */
+    cupsFilePuts(fp,
+		 "(allow file-write*\n"
+		 "  (regex"
+		 " #\"^/Library/Printers/.*/\""
+		 "))\n");
+    cupsFilePrintf(fp,
+		   "(deny file-write*\n"
+		   "  (regex"
+		   " #\"^/Library/Printers/PPDs$\""
+		   " #\"^/Library/Printers/PPDs/\""
+		   " #\"^/Library/Printers/PPD Plugins$\""
+		   " #\"^/Library/Printers/PPD Plugins/\""
+		   ")%s)\n", nodebug);
+  }
+  /* Allow execution of child processes as long as the programs are not in a user directory */
+  cupsFilePuts(fp, "(allow process*)\n");
+  cupsFilePuts(fp, "(deny process-exec (regex #\"^/Users/\"))\n");
+  if (RunUser && getenv("CUPS_TESTROOT"))
+  {
+    /* Allow source directory access in "make test" environment */
+    char	testroot[1024];		/* Root directory of test files */
+
+    cupsd_requote(testroot, getenv("CUPS_TESTROOT"), sizeof(testroot));
+
+    cupsFilePrintf(fp,
+		   "(allow file-write* file-read-data file-read-metadata\n"
+		   "  (regex"
+		   " #\"^%s$\""		/* CUPS_TESTROOT */
+		   " #\"^%s/\""		/* CUPS_TESTROOT/... */
+		   "))\n",
+		   testroot, testroot);
+    cupsFilePrintf(fp,
+		   "(allow process-exec\n"
+		   "  (regex"
+		   " #\"^%s/\""		/* CUPS_TESTROOT/... */
+		   "))\n",
+		   testroot);
+    cupsFilePrintf(fp, "(allow sysctl*)\n");
+  }
+  /* Allow access to Bluetooth, USB, and notify_post. */
+  cupsFilePuts(fp, "(allow iokit*)\n");
+  cupsFilePuts(fp, "(allow distributed-notification-post)\n");
+  /* Allow outbound networking to local services */
+  cupsFilePuts(fp, "(allow network-outbound"
+		   "\n       (regex #\"^/private/var/run/\" #\"^/private/tmp/\" #\"^/private/var/tmp/\")");
+  for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
+       lis;
+       lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
+  {
+    if (httpAddrFamily(&(lis->address)) == AF_LOCAL)
+    {
+      httpAddrString(&(lis->address), domain, sizeof(domain));
+      cupsFilePrintf(fp, "\n       (literal \"%s\")", domain);
+    }
+  }
+  if (allow_networking)
+  {
+    /* Allow TCP and UDP networking off the machine... */
+    cupsFilePuts(fp, "\n       (remote tcp))\n");
+    cupsFilePuts(fp, "(allow network-bind)\n"); /* for LPD resvport */
+    cupsFilePuts(fp, "(allow network*\n"
+		     "       (local udp \"*:*\")\n"
+		     "       (remote udp \"*:*\"))\n");
+
+    /* Also allow access to device files... */
+    cupsFilePuts(fp, "(allow file-write* file-read-data file-read-metadata file-ioctl\n"
+                     "       (regex #\"^/dev/\"))\n");
+
+    /* And allow kernel extensions to be loaded, e.g., SMB */
+    cupsFilePuts(fp, "(allow system-kext-load)\n");
+  }
+  else
+  {
+    /* Only allow SNMP (UDP) and LPD (TCP) off the machine... */
+    cupsFilePuts(fp, ")\n");
+    cupsFilePuts(fp, "(allow network-outbound\n"
+		     "       (remote udp \"*:161\")\n"
+		     "       (remote tcp \"*:515\"))\n");
+    cupsFilePuts(fp, "(allow network-inbound\n"
+		     "       (local udp \"localhost:*\"))\n");
+  }
+  cupsFileClose(fp);
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsd_write_profile(allow_networking=%d) = \"%s\"", allow_networking, filename);
+
+  return (1);
+}
 #endif /* HAVE_SANDBOX_H */
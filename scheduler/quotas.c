@@ -19,8 +19,13 @@
  */
 
 static cupsd_quota_t	*add_quota(cupsd_printer_t *p, const char *username);
+static void		add_usage(cupsd_quota_t *q, time_t curtime, int pages,
+			          int k);
 static int		compare_quotas(const cupsd_quota_t *q1,
 			               const cupsd_quota_t *q2);
+static void		expire_usage(cupsd_quota_t *q, time_t curtime);
+static void		reset_quota(cupsd_printer_t *p, cupsd_quota_t *q);
+static void		scan_jobs(cupsd_printer_t *p, cupsd_quota_t *q);
 
 
 /*
@@ -75,8 +80,184 @@ cupsdFreeQuotas(cupsd_printer_t *p)	/* I - Printer */
 }
 
 
+/*
+ * 'cupsdLoadAllQuotas()' - Load quota usage from the quota.cache file.
+ */
+
+void
+cupsdLoadAllQuotas(void)
+{
+  cups_file_t		*fp;		/* quota.cache file */
+  int			linenum;	/* Current line number */
+  char			line[1024],	/* Line from file */
+			*value;		/* Pointer to value */
+  cupsd_printer_t	*p = NULL;	/* Current printer */
+  cupsd_quota_t		*q = NULL;	/* Current quota */
+  int			skip = 0;	/* Skip the current printer? */
+  long			start;		/* Start of usage bucket */
+  int			pages,		/* Pages in bucket */
+			k;		/* Kilobytes in bucket */
+
+
+ /*
+  * Open the quota.cache file...
+  */
+
+  snprintf(line, sizeof(line), "%s/quota.cache", CacheDir);
+  if ((fp = cupsdOpenConfFile(line)) == NULL)
+    return;
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Loading quota cache file \"%s\"...", line);
+
+ /*
+  * Read the usage for each printer and user...
+  */
+
+  linenum = 0;
+
+  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  {
+    if (!_cups_strcasecmp(line, "<Quota") && value)
+    {
+     /*
+      * <Quota printer>
+      */
+
+      p    = cupsdFindDest(value);
+      q    = NULL;
+      skip = !p || (!p->k_limit && !p->page_limit);
+    }
+    else if (!_cups_strcasecmp(line, "</Quota>"))
+    {
+      p    = NULL;
+      q    = NULL;
+      skip = 0;
+    }
+    else if (!p || skip)
+    {
+     /*
+      * Ignore usage for printers that no longer exist or have no quotas...
+      */
+
+      continue;
+    }
+    else if (!_cups_strcasecmp(line, "Period") && value)
+    {
+     /*
+      * Usage collected over a different period has the wrong buckets...
+      */
+
+      skip = atoi(value) != p->quota_period;
+    }
+    else if (!_cups_strcasecmp(line, "User") && value)
+    {
+      if ((q = cupsdFindQuota(p, value)) != NULL)
+        reset_quota(p, q);
+    }
+    else if (!_cups_strcasecmp(line, "Usage") && value && q)
+    {
+      if (sscanf(value, "%ld%d%d", &start, &pages, &k) == 3)
+        add_usage(q, (time_t)start, pages, k);
+      else
+        cupsdLogMessage(CUPSD_LOG_ERROR,
+	                "Syntax error on line %d of quota.cache.", linenum);
+    }
+    else
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+                      "Syntax error on line %d of quota.cache.", linenum);
+  }
+
+  cupsFileClose(fp);
+}
+
+
+/*
+ * 'cupsdSaveAllQuotas()' - Save quota usage to the quota.cache file.
+ */
+
+void
+cupsdSaveAllQuotas(void)
+{
+  int			i;		/* Looping var */
+  cups_file_t		*fp;		/* quota.cache file */
+  char			filename[1024],	/* quota.cache filename */
+			temp[1024];	/* Temporary string */
+  cupsd_printer_t	*p;		/* Current printer */
+  cupsd_quota_t		*q;		/* Current quota */
+  cupsd_qbucket_t	*b;		/* Current bucket */
+  time_t		curtime;	/* Current time */
+  struct tm		curdate;	/* Current date */
+
+
+ /*
+  * Create the quota.cache file...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/quota.cache", CacheDir);
+  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
+    return;
+
+  cupsdLogMessage(CUPSD_LOG_INFO, "Saving quota.cache...");
+
+ /*
+  * Write a small header to the file...
+  */
+
+  time(&curtime);
+  localtime_r(&curtime, &curdate);
+  strftime(temp, sizeof(temp) - 1, "%Y-%m-%d %H:%M", &curdate);
+
+  cupsFilePuts(fp, "# Quota cache file for " CUPS_SVERSION "\n");
+  cupsFilePrintf(fp, "# Written by cupsd on %s\n", temp);
+
+ /*
+  * Write the usage that is still within the quota period...
+  */
+
+  for (p = (cupsd_printer_t *)cupsArrayFirst(Printers);
+       p;
+       p = (cupsd_printer_t *)cupsArrayNext(Printers))
+  {
+    if (p->temporary || !cupsArrayCount(p->quotas))
+      continue;
+
+    cupsFilePrintf(fp, "<Quota %s>\n", p->name);
+    cupsFilePrintf(fp, "Period %d\n", p->quota_period);
+
+    for (q = (cupsd_quota_t *)cupsArrayFirst(p->quotas);
+         q;
+	 q = (cupsd_quota_t *)cupsArrayNext(p->quotas))
+    {
+      if (!q->width || q->period != p->quota_period)
+        continue;
+
+      expire_usage(q, curtime);
+
+      if (!q->page_count && !q->k_count)
+        continue;
+
+      cupsFilePutConf(fp, "User", q->username);
+
+      for (i = 0, b = q->buckets; i < CUPSD_QUOTA_BUCKETS; i ++, b ++)
+        if (b->page_count || b->k_count)
+	  cupsFilePrintf(fp, "Usage %ld %d %d\n", (long)b->start,
+	                 b->page_count, b->k_count);
+    }
+
+    cupsFilePuts(fp, "</Quota>\n");
+  }
+
+  cupsdCloseCreatedConfFile(fp, filename);
+}
+
+
 /*
  * 'cupsdUpdateQuota()' - Update quota data for the specified printer and user.
+ *
+ * Usage is kept in CUPSD_QUOTA_BUCKETS time buckets that span the quota
+ * period, so the totals are updated as pages are logged and old buckets
+ * expire instead of being recomputed from the job history.  The job history
+ * is only scanned the first time a user's quota is needed.
  */
 
 cupsd_quota_t *				/* O - Quota data */
@@ -87,9 +268,6 @@ cupsdUpdateQuota(
     int             k)			/* I - Number of kilobytes */
 {
   cupsd_quota_t		*q;		/* Quota data */
-  cupsd_job_t		*job;		/* Current job */
-  time_t		curtime;	/* Current time */
-  ipp_attribute_t	*attr;		/* Job attribute */
 
 
   if (!p || !username)
@@ -105,24 +283,235 @@ cupsdUpdateQuota(
                   "cupsdUpdateQuota: p=%s username=%s pages=%d k=%d",
                   p->name, username, pages, k);
 
-  curtime = time(NULL);
-
-  if (curtime < q->next_update)
+  if (!q->width || q->period != p->quota_period)
   {
-    q->page_count += pages;
-    q->k_count    += k;
+   /*
+    * New quota record, count the jobs that are still in the quota period...
+    */
+
+    scan_jobs(p, q);
+    cupsdMarkDirty(CUPSD_DIRTY_QUOTAS);
 
     return (q);
   }
 
-  if (p->quota_period)
-    curtime -= p->quota_period;
+  expire_usage(q, time(NULL));
+
+  if (pages || k)
+  {
+    add_usage(q, time(NULL), pages, k);
+    cupsdMarkDirty(CUPSD_DIRTY_QUOTAS);
+  }
+
+  return (q);
+}
+
+
+/*
+ * 'add_quota()' - Add a quota record for this printer and user.
+ */
+
+static cupsd_quota_t *			/* O - Quota data */
+add_quota(cupsd_printer_t *p,		/* I - Printer */
+          const char      *username)	/* I - User */
+{
+  cupsd_quota_t	*q;			/* New quota data */
+  char		*ptr;			/* Pointer into username */
+
+
+  if (!p || !username)
+    return (NULL);
+
+  if (!p->quotas)
+    p->quotas = cupsArrayNew((cups_array_func_t)compare_quotas, NULL);
+
+  if (!p->quotas)
+    return (NULL);
+
+  if ((q = calloc(1, sizeof(cupsd_quota_t))) == NULL)
+    return (NULL);
+
+  strlcpy(q->username, username, sizeof(q->username));
+  if ((ptr = strchr(q->username, '@')) != NULL)
+    *ptr = '\0';			/* Strip @domain/@KDC */
+
+  cupsArrayAdd(p->quotas, q);
+
+  return (q);
+}
+
+
+/*
+ * 'add_usage()' - Add usage to the bucket for the given time.
+ */
+
+static void
+add_usage(cupsd_quota_t *q,		/* I - Quota data */
+          time_t        curtime,	/* I - Time of usage */
+	  int           pages,		/* I - Number of pages */
+	  int           k)		/* I - Number of kilobytes */
+{
+  time_t		start,		/* Start of bucket */
+			expires;	/* Expiration time of bucket */
+  cupsd_qbucket_t	*b;		/* Bucket */
+
+
+  if (q->period > 0)
+    start = curtime - curtime % q->width;
   else
-    curtime = 0;
+    start = 0;
 
+  b = q->buckets + (start / q->width) % CUPSD_QUOTA_BUCKETS;
+
+  if (b->start != start)
+  {
+    if (b->start > start)
+    {
+     /*
+      * The slot has been reused by newer usage, so this usage has already
+      * expired...
+      */
+
+      return;
+    }
+
+   /*
+    * Replace the expired bucket...
+    */
+
+    q->page_count -= b->page_count;
+    q->k_count    -= b->k_count;
+
+    b->start      = start;
+    b->page_count = 0;
+    b->k_count    = 0;
+  }
+
+  b->page_count += pages;
+  b->k_count    += k;
+  q->page_count += pages;
+  q->k_count    += k;
+
+  if (q->period > 0)
+  {
+    expires = b->start + q->width + q->period;
+
+    if (!q->next_update || expires < q->next_update)
+      q->next_update = expires;
+  }
+}
+
+
+/*
+ * 'compare_quotas()' - Compare two quota records...
+ */
+
+static int				/* O - Result of comparison */
+compare_quotas(const cupsd_quota_t *q1,	/* I - First quota record */
+               const cupsd_quota_t *q2)	/* I - Second quota record */
+{
+  return (_cups_strcasecmp(q1->username, q2->username));
+}
+
+
+/*
+ * 'expire_usage()' - Remove usage that is older than the quota period.
+ */
+
+static void
+expire_usage(cupsd_quota_t *q,		/* I - Quota data */
+             time_t        curtime)	/* I - Current time */
+{
+  int			i;		/* Looping var */
+  time_t		expires;	/* Expiration time of bucket */
+  cupsd_qbucket_t	*b;		/* Current bucket */
+
+
+  if (!q->next_update || curtime < q->next_update)
+    return;
+
+  q->next_update = 0;
+
+  for (i = 0, b = q->buckets; i < CUPSD_QUOTA_BUCKETS; i ++, b ++)
+  {
+    if (!b->page_count && !b->k_count)
+      continue;
+
+    expires = b->start + q->width + q->period;
+
+    if (curtime >= expires)
+    {
+      q->page_count -= b->page_count;
+      q->k_count    -= b->k_count;
+
+      b->page_count = 0;
+      b->k_count    = 0;
+    }
+    else if (!q->next_update || expires < q->next_update)
+      q->next_update = expires;
+  }
+}
+
+
+/*
+ * 'reset_quota()' - Clear the usage in a quota record.
+ */
+
+static void
+reset_quota(cupsd_printer_t *p,		/* I - Printer */
+            cupsd_quota_t   *q)		/* I - Quota data */
+{
   q->next_update = 0;
   q->page_count  = 0;
   q->k_count     = 0;
+  q->period      = p->quota_period;
+
+  if (q->period > 0)
+    q->width = (q->period + CUPSD_QUOTA_BUCKETS - 1) / CUPSD_QUOTA_BUCKETS;
+  else
+    q->width = 1;
+
+  memset(q->buckets, 0, sizeof(q->buckets));
+}
+
+
+/*
+ * 'scan_jobs()' - Compute the usage in a quota record from the job history.
+ */
+
+static void
+scan_jobs(cupsd_printer_t *p,		/* I - Printer */
+          cupsd_quota_t   *q)		/* I - Quota data */
+{
+  cupsd_job_t		*job;		/* Current job */
+  cupsd_jobrec_t	*rec;		/* Current compacted job */
+  time_t		curtime,	/* Start of quota period */
+			jobtime;	/* Time of job */
+  int			pages,		/* Pages for job */
+			k;		/* Kilobytes for job */
+  ipp_attribute_t	*attr;		/* Job attribute */
+
+
+  reset_quota(p, q);
+
+  if (p->quota_period)
+    curtime = time(NULL) - p->quota_period;
+  else
+    curtime = 0;
+
+ /*
+  * Expand the compacted jobs that may count towards the quota (or be purged
+  * below); a job that completed before the quota period started was also
+  * processed before it...
+  */
+
+  for (rec = (cupsd_jobrec_t *)cupsArrayFirst(CompactJobs);
+       rec;
+       rec = (cupsd_jobrec_t *)cupsArrayNext(CompactJobs))
+    if (!_cups_strcasecmp(rec->dest, p->name) &&
+        !_cups_strcasecmp(rec->username, q->username) &&
+        (rec->completed_time >= curtime || JobAutoPurge))
+      cupsdExpandJob(rec);
 
   for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
        job;
@@ -163,63 +552,18 @@ cupsdUpdateQuota(
       continue;
     }
 
-    if (q->next_update == 0)
-      q->next_update = attr->values[0].integer + p->quota_period;
+    jobtime = attr->values[0].integer;
+    pages   = 0;
+    k       = 0;
 
     if ((attr = ippFindAttribute(job->attrs, "job-media-sheets-completed",
                                  IPP_TAG_INTEGER)) != NULL)
-      q->page_count += attr->values[0].integer;
+      pages = attr->values[0].integer;
 
     if ((attr = ippFindAttribute(job->attrs, "job-k-octets",
                                  IPP_TAG_INTEGER)) != NULL)
-      q->k_count += attr->values[0].integer;
-  }
-
-  return (q);
-}
-
-
-/*
- * 'add_quota()' - Add a quota record for this printer and user.
- */
-
-static cupsd_quota_t *			/* O - Quota data */
-add_quota(cupsd_printer_t *p,		/* I - Printer */
-          const char      *username)	/* I - User */
-{
-  cupsd_quota_t	*q;			/* New quota data */
-  char		*ptr;			/* Pointer into username */
+      k = attr->values[0].integer;
 
-
-  if (!p || !username)
-    return (NULL);
-
-  if (!p->quotas)
-    p->quotas = cupsArrayNew((cups_array_func_t)compare_quotas, NULL);
-
-  if (!p->quotas)
-    return (NULL);
-
-  if ((q = calloc(1, sizeof(cupsd_quota_t))) == NULL)
-    return (NULL);
-
-  strlcpy(q->username, username, sizeof(q->username));
-  if ((ptr = strchr(q->username, '@')) != NULL)
-    *ptr = '\0';			/* Strip @domain/@KDC */
-
-  cupsArrayAdd(p->quotas, q);
-
-  return (q);
-}
-
-
-/*
- * 'compare_quotas()' - Compare two quota records...
- */
-
-static int				/* O - Result of comparison */
-compare_quotas(const cupsd_quota_t *q1,	/* I - First quota record */
-               const cupsd_quota_t *q2)	/* I - Second quota record */
-{
-  return (_cups_strcasecmp(q1->username, q2->username));
+    add_usage(q, jobtime, pages, k);
+  }
 }
@@ -68,7 +68,9 @@
  *         d. cupsdAddSelect() adds to the array and allocates a
  *            new callback element.
  *         e. cupsdRemoveSelect() removes from the active array and
- *            adds to the inactive array.
+ *            adds to the (unsorted) inactive array, marking the
+ *            element inactive so that pending events are skipped
+ *            without an array lookup.
  *         f. _cupsd_fd_t provides a reference-counted structure for
  *            tracking file descriptors that are monitored.
  *         g. cupsdDoSelect() frees all inactive FDs.
@@ -177,7 +179,8 @@
 typedef struct _cupsd_fd_s
 {
   int			fd,		/* File descriptor */
-			use;		/* Use count */
+			use,		/* Use count */
+			inactive;	/* Removed while in cupsdDoSelect? */
   cupsd_selfunc_t	read_cb,	/* Read callback */
 			write_cb;	/* Write callback */
   void			*data;		/* Data pointer for callbacks */
@@ -333,6 +336,15 @@ cupsdAddSelect(int             fd,	/* I - File descriptor */
     struct epoll_event event;		/* Event data */
 
 
+   /*
+    * Only tell the kernel about new descriptors or changes to the set of
+    * events we are interested in...
+    */
+
+    if (!added && !fdptr->read_cb == !read_cb &&
+        !fdptr->write_cb == !write_cb)
+      goto save_callbacks;
+
     event.events = 0;
 
     if (read_cb)
@@ -379,6 +391,10 @@ cupsdAddSelect(int             fd,	/* I - File descriptor */
   }
 #endif /* HAVE_KQUEUE */
 
+#ifdef HAVE_EPOLL
+  save_callbacks:
+#endif /* HAVE_EPOLL */
+
  /*
   * Save the (new) read and write callbacks...
   */
@@ -425,7 +441,7 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
   {
     fdptr = (_cupsd_fd_t *)event->udata;
 
-    if (cupsArrayFind(cupsd_inactive_fds, fdptr))
+    if (fdptr->inactive)
       continue;
 
     retain_fd(fdptr);
@@ -434,7 +450,7 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
       (*(fdptr->read_cb))(fdptr->data);
 
     if (fdptr->use > 1 && fdptr->write_cb && event->filter == EVFILT_WRITE &&
-        !cupsArrayFind(cupsd_inactive_fds, fdptr))
+        !fdptr->inactive)
       (*(fdptr->write_cb))(fdptr->data);
 
     release_fd(fdptr);
@@ -471,7 +487,7 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
       {
 	fdptr = (_cupsd_fd_t *)event->data.ptr;
 
-	if (cupsArrayFind(cupsd_inactive_fds, fdptr))
+	if (fdptr->inactive)
 	  continue;
 
 	retain_fd(fdptr);
@@ -481,7 +497,7 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
 
 	if (fdptr->use > 1 && fdptr->write_cb &&
             (event->events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) &&
-            !cupsArrayFind(cupsd_inactive_fds, fdptr))
+            !fdptr->inactive)
 	  (*(fdptr->write_cb))(fdptr->data);
 
 	release_fd(fdptr);
@@ -650,10 +666,9 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
   for (fdptr = (_cupsd_fd_t *)cupsArrayFirst(cupsd_inactive_fds);
        fdptr;
        fdptr = (_cupsd_fd_t *)cupsArrayNext(cupsd_inactive_fds))
-  {
-    cupsArrayRemove(cupsd_inactive_fds, fdptr);
     release_fd(fdptr);
-  }
+
+  cupsArrayClear(cupsd_inactive_fds);
 #endif /* HAVE_EPOLL || HAVE_KQUEUE */
 
  /*
@@ -664,6 +679,17 @@ cupsdDoSelect(long timeout)		/* I - Timeout in seconds */
 }
 
 
+/*
+ * 'cupsdGetSelectCount()' - Get the number of file descriptors being monitored.
+ */
+
+int					/* O - Number of file descriptors */
+cupsdGetSelectCount(void)
+{
+  return (cupsArrayCount(cupsd_fds));
+}
+
+
 #ifdef CUPSD_IS_SELECTING
 /*
  * 'cupsdIsSelecting()' - Determine whether we are monitoring a file
@@ -775,7 +801,10 @@ cupsdRemoveSelect(int fd)		/* I - File descriptor */
 
 #if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
   if (cupsd_in_select)
+  {
+    fdptr->inactive = 1;
     cupsArrayAdd(cupsd_inactive_fds, fdptr);
+  }
   else
 #endif /* HAVE_EPOLL || HAVE_KQUEUE */
 
@@ -795,7 +824,7 @@ cupsdStartSelect(void)
   cupsd_fds = cupsArrayNew((cups_array_func_t)compare_fds, NULL);
 
 #if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
-  cupsd_inactive_fds = cupsArrayNew((cups_array_func_t)compare_fds, NULL);
+  cupsd_inactive_fds = cupsArrayNew(NULL, NULL);
 #endif /* HAVE_EPOLL || HAVE_KQUEUE */
 
 #ifdef HAVE_EPOLL
@@ -63,6 +63,7 @@ cupsdStartServer(void)
 
   cupsdStartListening();
   cupsdStartBrowsing();
+  cupsdStartNetIFMonitor();
 
  /*
   * Create a pipe for CGI processes...
@@ -113,6 +114,7 @@ cupsdStopServer(void)
   cupsdCloseAllClients();
   cupsdStopListening();
   cupsdStopBrowsing();
+  cupsdStopNetIFMonitor();
   cupsdStopAllNotifiers();
   cupsdDeleteAllCerts();
 
@@ -0,0 +1,173 @@
+/*
+ * Object allocator for the CUPS scheduler.
+ *
+ * Copyright © 2020 by Apple Inc.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cupsd.h"
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_slabobj_s		/**** Free object ****/
+{
+  struct cupsd_slabobj_s *next;		/* Next free object */
+} cupsd_slabobj_t;
+
+typedef union cupsd_slab_u		/**** Slab header ****/
+{
+  union cupsd_slab_u	*next;		/* Next slab */
+  double		align;		/* Force alignment of objects */
+} cupsd_slab_t;
+
+typedef struct cupsd_slabinfo_s		/**** Allocator for one object type ****/
+{
+  const char		*name;		/* Name of object type */
+  size_t		size;		/* Size of object */
+  cupsd_slab_t		*slabs;		/* Allocated slabs */
+  cupsd_slabobj_t	*free_list;	/* Free objects */
+  int			num_used,	/* Number of objects in use */
+			num_free;	/* Number of objects on free list */
+  size_t		bytes;		/* Bytes allocated for slabs */
+} cupsd_slabinfo_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cupsd_slabinfo_t	slabs[CUPSD_SLAB_MAX] =
+{					/* Allocators for each type */
+  { "client", sizeof(cupsd_client_t), NULL, NULL, 0, 0, 0 },
+  { "event", sizeof(cupsd_event_t), NULL, NULL, 0, 0, 0 },
+  { "job", sizeof(cupsd_job_t), NULL, NULL, 0, 0, 0 },
+  { "statbuf", sizeof(cupsd_statbuf_t), NULL, NULL, 0, 0, 0 }
+};
+
+
+/*
+ * 'cupsdSlabAlloc()' - Allocate a zeroed object.
+ */
+
+void *					/* O - New object or NULL on error */
+cupsdSlabAlloc(cupsd_slabtype_t type)	/* I - Object type */
+{
+  cupsd_slabinfo_t	*info;		/* Allocator for type */
+  cupsd_slabobj_t	*obj;		/* Object */
+
+
+  if (type >= CUPSD_SLAB_MAX)
+    return (NULL);
+
+  info = slabs + type;
+
+  if (!info->free_list)
+  {
+   /*
+    * Allocate a new slab and put its objects on the free list...
+    */
+
+    cupsd_slab_t	*slab;		/* New slab */
+    size_t		size,		/* Aligned object size */
+			count;		/* Objects per slab */
+    char		*ptr;		/* Pointer into slab */
+
+
+    size = (info->size + sizeof(cupsd_slab_t) - 1) & ~(sizeof(cupsd_slab_t) - 1);
+
+    if ((count = CUPSD_SLAB_SIZE / size) < 1)
+      count = 1;
+
+    if ((slab = malloc(sizeof(cupsd_slab_t) + count * size)) == NULL)
+      return (NULL);
+
+    slab->next  = info->slabs;
+    info->slabs = slab;
+    info->bytes += sizeof(cupsd_slab_t) + count * size;
+
+    for (ptr = (char *)(slab + 1) + (count - 1) * size; count > 0; count --, ptr -= size)
+    {
+      obj             = (cupsd_slabobj_t *)ptr;
+      obj->next       = info->free_list;
+      info->free_list = obj;
+      info->num_free ++;
+    }
+  }
+
+ /*
+  * Take the first object from the free list...
+  */
+
+  obj             = info->free_list;
+  info->free_list = obj->next;
+  info->num_free --;
+  info->num_used ++;
+
+  memset(obj, 0, info->size);
+
+  return (obj);
+}
+
+
+/*
+ * 'cupsdSlabFree()' - Return an object to its free list.
+ */
+
+void
+cupsdSlabFree(cupsd_slabtype_t type,	/* I - Object type */
+              void             *obj)	/* I - Object */
+{
+  cupsd_slabinfo_t	*info;		/* Allocator for type */
+
+
+  if (!obj || type >= CUPSD_SLAB_MAX)
+    return;
+
+  info = slabs + type;
+
+  ((cupsd_slabobj_t *)obj)->next = info->free_list;
+  info->free_list                = obj;
+
+  info->num_free ++;
+  info->num_used --;
+}
+
+
+/*
+ * 'cupsdSlabStatistics()' - Return allocation statistics for an object type.
+ */
+
+const char *				/* O - Name of object type or NULL */
+cupsdSlabStatistics(
+    cupsd_slabtype_t type,		/* I - Object type */
+    int              *used,		/* O - Objects in use */
+    int              *avail,		/* O - Objects on free list */
+    size_t           *bytes)		/* O - Bytes allocated */
+{
+  cupsd_slabinfo_t	*info;		/* Allocator for type */
+
+
+  if (type >= CUPSD_SLAB_MAX)
+    return (NULL);
+
+  info = slabs + type;
+
+  if (used)
+    *used = info->num_used;
+
+  if (avail)
+    *avail = info->num_free;
+
+  if (bytes)
+    *bytes = info->bytes;
+
+  return (info->name);
+}
@@ -0,0 +1,38 @@
+/*
+ * Object allocator definitions for the CUPS scheduler.
+ *
+ * Copyright © 2020 by Apple Inc.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+ */
+
+
+/*
+ * Constants...
+ */
+
+#define CUPSD_SLAB_SIZE		65536	/* Target bytes per slab */
+
+
+/*
+ * Types and structures...
+ */
+
+typedef enum cupsd_slabtype_e		/**** Slab object types ****/
+{
+  CUPSD_SLAB_CLIENT,			/* cupsd_client_t */
+  CUPSD_SLAB_EVENT,			/* cupsd_event_t */
+  CUPSD_SLAB_JOB,			/* cupsd_job_t */
+  CUPSD_SLAB_STATBUF,			/* cupsd_statbuf_t */
+  CUPSD_SLAB_MAX			/* Number of slab types */
+} cupsd_slabtype_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern void		*cupsdSlabAlloc(cupsd_slabtype_t type);
+extern void		cupsdSlabFree(cupsd_slabtype_t type, void *obj);
+extern const char	*cupsdSlabStatistics(cupsd_slabtype_t type, int *used,
+			                     int *avail, size_t *bytes);
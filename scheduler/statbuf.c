@@ -13,6 +13,14 @@
 
 #include "cupsd.h"
 #include <stdarg.h>
+#include <sys/uio.h>
+
+
+/*
+ * Local functions...
+ */
+
+static int	statbuf_read(cupsd_statbuf_t *sb);
 
 
 /*
@@ -35,7 +43,7 @@ cupsdStatBufDelete(cupsd_statbuf_t *sb)	/* I - Status buffer */
 
   close(sb->fd);
 
-  free(sb);
+  cupsdSlabFree(CUPSD_SLAB_STATBUF, sb);
 }
 
 
@@ -63,7 +71,7 @@ cupsdStatBufNew(int        fd,		/* I - File descriptor of pipe */
   * Allocate the status buffer...
   */
 
-  if ((sb = calloc(1, sizeof(cupsd_statbuf_t))) != NULL)
+  if ((sb = cupsdSlabAlloc(CUPSD_SLAB_STATBUF)) != NULL)
   {
    /*
     * Assign the file descriptor...
@@ -111,35 +119,26 @@ cupsdStatBufUpdate(
     char            *line,		/* I - Line buffer */
     int             linelen)		/* I - Size of line buffer */
 {
-  int		bytes;			/* Number of bytes read */
+  int		bytes = 1,		/* Number of bytes read */
+		length,			/* Length of line */
+		count;			/* Bytes to copy */
   char		*lineptr,		/* Pointer to end of line in buffer */
-		*message;		/* Pointer to message text */
+		*message,		/* Pointer to message text */
+		buffer[CUPSD_SB_BUFFER_SIZE];
+					/* Line from buffer */
 
 
  /*
   * Check if the buffer already contains a full line...
   */
 
-  if ((lineptr = strchr(sb->buffer, '\n')) == NULL)
+  if (!sb->buflines && sb->bufused < (CUPSD_SB_BUFFER_SIZE - 1))
   {
    /*
     * No, read more data...
     */
 
-    if ((bytes = read(sb->fd, sb->buffer + sb->bufused, (size_t)(CUPSD_SB_BUFFER_SIZE - sb->bufused - 1))) > 0)
-    {
-      sb->bufused += bytes;
-      sb->buffer[sb->bufused] = '\0';
-
-     /*
-      * Guard against a line longer than the max buffer size...
-      */
-
-      if ((lineptr = strchr(sb->buffer, '\n')) == NULL &&
-          sb->bufused == (CUPSD_SB_BUFFER_SIZE - 1))
-	lineptr = sb->buffer + sb->bufused;
-    }
-    else if (bytes < 0 && errno == EINTR)
+    if ((bytes = statbuf_read(sb)) < 0 && errno == EINTR)
     {
      /*
       * Return an empty line if we are interrupted...
@@ -150,28 +149,35 @@ cupsdStatBufUpdate(
 
       return (line);
     }
-    else
-    {
-     /*
-      * End-of-file, so use the whole buffer...
-      */
-
-      lineptr  = sb->buffer + sb->bufused;
-      *lineptr = '\0';
-    }
+  }
 
+  if (sb->buflines)
+  {
    /*
-    * Final check for end-of-file...
+    * Find the end of the first line...
     */
 
-    if (sb->bufused == 0 && bytes == 0)
-      lineptr = NULL;
+    if ((count = CUPSD_SB_BUFFER_SIZE - sb->bufstart) > sb->bufused)
+      count = sb->bufused;
+
+    if ((lineptr = memchr(sb->buffer + sb->bufstart, '\n', (size_t)count)) != NULL)
+      length = (int)(lineptr - sb->buffer) - sb->bufstart;
+    else
+      length = count + (int)((char *)memchr(sb->buffer, '\n', (size_t)(sb->bufused - count)) - sb->buffer);
   }
+  else if (sb->bufused == (CUPSD_SB_BUFFER_SIZE - 1) || (bytes <= 0 && sb->bufused > 0))
+  {
+   /*
+    * Use the whole buffer for a line longer than the max buffer size, or
+    * at end-of-file...
+    */
 
-  if (!lineptr)
+    length = sb->bufused;
+  }
+  else
   {
    /*
-    * End of file...
+    * End of file or partial line...
     */
 
     *loglevel = CUPSD_LOG_NONE;
@@ -181,89 +187,107 @@ cupsdStatBufUpdate(
   }
 
  /*
-  * Terminate the line and process it...
+  * Copy the line out of the ring buffer and consume it along with the
+  * trailing newline, if any...
   */
 
-  *lineptr++ = '\0';
+  if ((count = CUPSD_SB_BUFFER_SIZE - sb->bufstart) > length)
+    count = length;
+
+  memcpy(buffer, sb->buffer + sb->bufstart, (size_t)count);
+  memcpy(buffer + count, sb->buffer, (size_t)(length - count));
+  buffer[length] = '\0';
+
+  if (length < sb->bufused)
+  {
+    length ++;
+    sb->buflines --;
+  }
+
+  sb->bufstart = (sb->bufstart + length) % CUPSD_SB_BUFFER_SIZE;
+  sb->bufused  -= length;
+
+  if (sb->bufused == 0)
+    sb->bufstart = 0;
 
  /*
   * Figure out the logging level...
   */
 
-  if (!strncmp(sb->buffer, "EMERG:", 6))
+  if (!strncmp(buffer, "EMERG:", 6))
   {
     *loglevel = CUPSD_LOG_EMERG;
-    message   = sb->buffer + 6;
+    message   = buffer + 6;
   }
-  else if (!strncmp(sb->buffer, "ALERT:", 6))
+  else if (!strncmp(buffer, "ALERT:", 6))
   {
     *loglevel = CUPSD_LOG_ALERT;
-    message   = sb->buffer + 6;
+    message   = buffer + 6;
   }
-  else if (!strncmp(sb->buffer, "CRIT:", 5))
+  else if (!strncmp(buffer, "CRIT:", 5))
   {
     *loglevel = CUPSD_LOG_CRIT;
-    message   = sb->buffer + 5;
+    message   = buffer + 5;
   }
-  else if (!strncmp(sb->buffer, "ERROR:", 6))
+  else if (!strncmp(buffer, "ERROR:", 6))
   {
     *loglevel = CUPSD_LOG_ERROR;
-    message   = sb->buffer + 6;
+    message   = buffer + 6;
   }
-  else if (!strncmp(sb->buffer, "WARNING:", 8))
+  else if (!strncmp(buffer, "WARNING:", 8))
   {
     *loglevel = CUPSD_LOG_WARN;
-    message   = sb->buffer + 8;
+    message   = buffer + 8;
   }
-  else if (!strncmp(sb->buffer, "NOTICE:", 7))
+  else if (!strncmp(buffer, "NOTICE:", 7))
   {
     *loglevel = CUPSD_LOG_NOTICE;
-    message   = sb->buffer + 7;
+    message   = buffer + 7;
   }
-  else if (!strncmp(sb->buffer, "INFO:", 5))
+  else if (!strncmp(buffer, "INFO:", 5))
   {
     *loglevel = CUPSD_LOG_INFO;
-    message   = sb->buffer + 5;
+    message   = buffer + 5;
   }
-  else if (!strncmp(sb->buffer, "DEBUG:", 6))
+  else if (!strncmp(buffer, "DEBUG:", 6))
   {
     *loglevel = CUPSD_LOG_DEBUG;
-    message   = sb->buffer + 6;
+    message   = buffer + 6;
   }
-  else if (!strncmp(sb->buffer, "DEBUG2:", 7))
+  else if (!strncmp(buffer, "DEBUG2:", 7))
   {
     *loglevel = CUPSD_LOG_DEBUG2;
-    message   = sb->buffer + 7;
+    message   = buffer + 7;
   }
-  else if (!strncmp(sb->buffer, "PAGE:", 5))
+  else if (!strncmp(buffer, "PAGE:", 5))
   {
     *loglevel = CUPSD_LOG_PAGE;
-    message   = sb->buffer + 5;
+    message   = buffer + 5;
   }
-  else if (!strncmp(sb->buffer, "STATE:", 6))
+  else if (!strncmp(buffer, "STATE:", 6))
   {
     *loglevel = CUPSD_LOG_STATE;
-    message   = sb->buffer + 6;
+    message   = buffer + 6;
   }
-  else if (!strncmp(sb->buffer, "JOBSTATE:", 9))
+  else if (!strncmp(buffer, "JOBSTATE:", 9))
   {
     *loglevel = CUPSD_LOG_JOBSTATE;
-    message   = sb->buffer + 9;
+    message   = buffer + 9;
   }
-  else if (!strncmp(sb->buffer, "ATTR:", 5))
+  else if (!strncmp(buffer, "ATTR:", 5))
   {
     *loglevel = CUPSD_LOG_ATTR;
-    message   = sb->buffer + 5;
+    message   = buffer + 5;
   }
-  else if (!strncmp(sb->buffer, "PPD:", 4))
+  else if (!strncmp(buffer, "PPD:", 4))
   {
     *loglevel = CUPSD_LOG_PPD;
-    message   = sb->buffer + 4;
+    message   = buffer + 4;
   }
   else
   {
     *loglevel = CUPSD_LOG_DEBUG;
-    message   = sb->buffer;
+    message   = buffer;
   }
 
  /*
@@ -292,7 +316,7 @@ cupsdStatBufUpdate(
 	cupsdLogMessage(*loglevel, "%s %s", sb->prefix, message);
     }
     else if (*loglevel < CUPSD_LOG_NONE && LogLevel >= CUPSD_LOG_DEBUG)
-      cupsdLogMessage(CUPSD_LOG_DEBUG2, "%s %s", sb->prefix, sb->buffer);
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "%s %s", sb->prefix, buffer);
   }
 
  /*
@@ -301,17 +325,67 @@ cupsdStatBufUpdate(
 
   strlcpy(line, message, (size_t)linelen);
 
+  return (line);
+}
+
+
+/*
+ * 'statbuf_read()' - Read more data into the ring buffer.
+ *
+ * All of the available data (up to the free space) is read with a single
+ * call and the new complete lines are counted, so callers can process every
+ * buffered line before reading again.
+ */
+
+static int				/* O - Bytes read, 0 on EOF, -1 on error */
+statbuf_read(cupsd_statbuf_t *sb)	/* I - Status buffer */
+{
+  int		bytes,			/* Number of bytes read */
+		end,			/* End of data in buffer */
+		count;			/* Free bytes at end of buffer */
+  struct iovec	iov[2];			/* Free space in buffer */
+  char		*ptr,			/* Pointer into new data */
+		*ptrend;		/* End of new data */
+
+
  /*
-  * Copy over the buffer data we've used up...
+  * The free space may wrap around the end of the buffer; keep one byte
+  * free so a maximum-length line still fits in the caller's line buffer...
   */
 
-  if (lineptr < sb->buffer + sb->bufused)
-    _cups_strcpy(sb->buffer, lineptr);
+  end   = (sb->bufstart + sb->bufused) % CUPSD_SB_BUFFER_SIZE;
+  count = CUPSD_SB_BUFFER_SIZE - end;
 
-  sb->bufused -= lineptr - sb->buffer;
+  if (count > (CUPSD_SB_BUFFER_SIZE - 1 - sb->bufused))
+    count = CUPSD_SB_BUFFER_SIZE - 1 - sb->bufused;
 
-  if (sb->bufused < 0)
-    sb->bufused = 0;
+  iov[0].iov_base = sb->buffer + end;
+  iov[0].iov_len  = (size_t)count;
+  iov[1].iov_base = sb->buffer;
+  iov[1].iov_len  = (size_t)(CUPSD_SB_BUFFER_SIZE - 1 - sb->bufused - count);
 
-  return (line);
+  if ((bytes = (int)readv(sb->fd, iov, iov[1].iov_len ? 2 : 1)) <= 0)
+    return (bytes);
+
+  sb->bufused += bytes;
+
+ /*
+  * Count the new lines...
+  */
+
+  if (bytes > count)
+  {
+    for (ptr = sb->buffer + end, ptrend = ptr + count; (ptr = memchr(ptr, '\n', (size_t)(ptrend - ptr))) != NULL; ptr ++)
+      sb->buflines ++;
+
+    for (ptr = sb->buffer, ptrend = ptr + bytes - count; (ptr = memchr(ptr, '\n', (size_t)(ptrend - ptr))) != NULL; ptr ++)
+      sb->buflines ++;
+  }
+  else
+  {
+    for (ptr = sb->buffer + end, ptrend = ptr + bytes; (ptr = memchr(ptr, '\n', (size_t)(ptrend - ptr))) != NULL; ptr ++)
+      sb->buflines ++;
+  }
+
+  return (bytes);
 }
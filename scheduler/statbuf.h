@@ -23,8 +23,10 @@ typedef struct				/**** Status buffer */
 {
   int	fd;				/* File descriptor to read from */
   char	prefix[64];			/* Prefix for log messages */
-  int	bufused;			/* How much is used in buffer */
-  char	buffer[CUPSD_SB_BUFFER_SIZE];	/* Buffer */
+  int	bufstart,			/* Start of unread data in buffer */
+	bufused,			/* How much is used in buffer */
+	buflines;			/* Number of complete lines in buffer */
+  char	buffer[CUPSD_SB_BUFFER_SIZE];	/* Ring buffer */
 } cupsd_statbuf_t;
 
 
@@ -23,14 +23,39 @@
 #endif /* HAVE_DBUS */
 
 
+/*
+ * Local globals...
+ */
+
+static unsigned		sub_mask = CUPSD_EVENT_NONE;
+					/* Events used by any subscription */
+static int		sub_mask_valid = 0;
+					/* Is sub_mask up-to-date? */
+static cups_array_t	*mux_notifiers = NULL;
+					/* Multiplexed notifiers by scheme */
+static cupsd_subscription_t shared_dbus;/* Shared notifier for dbus: subscriptions */
+static int		shared_dbus_sent = 0;
+					/* Current event sent to shared notifier? */
+static cups_array_t	*sub_expires = NULL;
+					/* Leased subscriptions by expiration time */
+
+
 /*
  * Local functions...
  */
 
+static int	cupsd_compare_expires(cupsd_subscription_t *first,
+				      cupsd_subscription_t *second,
+				      void *unused);
+static int	cupsd_compare_notifiers(cupsd_subscription_t *first,
+					cupsd_subscription_t *second,
+					void *unused);
 static int	cupsd_compare_subscriptions(cupsd_subscription_t *first,
 					    cupsd_subscription_t *second,
 					    void *unused);
 static void	cupsd_delete_event(cupsd_event_t *event);
+static cupsd_subscription_t *cupsd_find_notifier(const char *recipient,
+					int create);
 #ifdef HAVE_DBUS
 static void	cupsd_send_dbus(cupsd_eventmask_t event, cupsd_printer_t *dest,
 				cupsd_job_t *job);
@@ -38,7 +63,9 @@ static void	cupsd_send_dbus(cupsd_eventmask_t event, cupsd_printer_t *dest,
 static void	cupsd_send_notification(cupsd_subscription_t *sub,
 					cupsd_event_t *event);
 static void	cupsd_start_notifier(cupsd_subscription_t *sub);
+static void	cupsd_stop_notifier(cupsd_subscription_t *notifier);
 static void	cupsd_update_notifier(void);
+static void	cupsd_wake_waiters(cupsd_subscription_t *sub);
 
 
 /*
@@ -58,6 +85,7 @@ cupsdAddEvent(
   ipp_attribute_t	*attr;		/* Printer/job attribute */
   cupsd_event_t		*temp;		/* New event pointer */
   cupsd_subscription_t	*sub;		/* Current subscription */
+  ipp_t			*shared = NULL;	/* Attributes shared by all events */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
@@ -65,6 +93,8 @@ cupsdAddEvent(
 		  cupsdEventName(event), dest, dest ? dest->name : "",
 		  job, job ? job->id : 0, text);
 
+  CUPSD_PROBE2(event__add, event, job ? job->id : 0);
+
  /*
   * Keep track of events with any OS-supplied notification mechanisms...
   */
@@ -87,11 +117,33 @@ cupsdAddEvent(
     return;
   }
 
+ /*
+  * Skip the subscriptions entirely if none of them wants this event...
+  */
+
+  if (!sub_mask_valid)
+  {
+    for (sub_mask = CUPSD_EVENT_NONE, sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
+         sub;
+	 sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+      sub_mask |= sub->mask;
+
+    sub_mask_valid = 1;
+  }
+
+  if (!(sub_mask & event))
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Discarding unused %s event...", cupsdEventName(event));
+    return;
+  }
+
  /*
   * Then loop through the subscriptions and add the event to the corresponding
   * caches...
   */
 
+  shared_dbus_sent = 0;
+
   for (temp = NULL, sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
        sub;
        sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
@@ -106,11 +158,12 @@ cupsdAddEvent(
       * Need this event, so create a new event record...
       */
 
-      if ((temp = (cupsd_event_t *)calloc(1, sizeof(cupsd_event_t))) == NULL)
+      if ((temp = (cupsd_event_t *)cupsdSlabAlloc(CUPSD_SLAB_EVENT)) == NULL)
       {
 	cupsdLogMessage(CUPSD_LOG_CRIT,
 			"Unable to allocate memory for event - %s",
 			strerror(errno));
+	ippDelete(shared);
 	return;
       }
 
@@ -148,89 +201,101 @@ cupsdAddEvent(
 			  "notify-user-data", sub->user_data,
 			  sub->user_data_len);
 
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-		    "printer-up-time", time(NULL));
-
-      va_start(ap, text);
-      vsnprintf(ftext, sizeof(ftext), text, ap);
-      va_end(ap);
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT,
-		   "notify-text", NULL, ftext);
-
-      if (dest)
+      if (!shared)
       {
        /*
-	* Add printer attributes...
+        * Build the event attributes that are shared by all subscriptions...
 	*/
 
-	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI, "notify-printer-uri", NULL, dest->uri);
+	shared = ippNew();
 
-	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "printer-name", NULL, dest->name);
+	ippAddInteger(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		      "printer-up-time", time(NULL));
 
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "printer-state", (int)dest->state);
+	va_start(ap, text);
+	vsnprintf(ftext, sizeof(ftext), text, ap);
+	va_end(ap);
 
-	if (dest->num_reasons == 0)
-	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", NULL, dest->state == IPP_PRINTER_STOPPED ? "paused" : "none");
-	else
-	  ippAddStrings(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", dest->num_reasons, NULL, (const char * const *)dest->reasons);
+	ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT,
+		     "notify-text", NULL, ftext);
 
-	ippAddBoolean(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, "printer-is-accepting-jobs", (char)dest->accepting);
-      }
+	if (dest)
+	{
+	 /*
+	  * Add printer attributes...
+	  */
 
-      if (job)
-      {
-       /*
-	* Add job attributes...
-	*/
+	  ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI, "notify-printer-uri", NULL, dest->uri);
 
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "notify-job-id", job->id);
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "job-state", (int)job->state_value);
+	  ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "printer-name", NULL, dest->name);
 
-	if ((attr = ippFindAttribute(job->attrs, "job-name", IPP_TAG_NAME)) != NULL)
-	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "job-name", NULL, attr->values[0].string.text);
+	  ippAddInteger(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "printer-state", (int)dest->state);
 
-	switch (job->state_value)
-	{
-	  case IPP_JOB_PENDING :
-	      if (dest && dest->state == IPP_PRINTER_STOPPED)
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "printer-stopped");
-	      else
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "none");
-	      break;
+	  if (dest->num_reasons == 0)
+	    ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", NULL, dest->state == IPP_PRINTER_STOPPED ? "paused" : "none");
+	  else
+	    ippAddStrings(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", dest->num_reasons, NULL, (const char * const *)dest->reasons);
 
-	  case IPP_JOB_HELD :
-	      if (ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_KEYWORD) != NULL ||
-		  ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_NAME) != NULL)
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-hold-until-specified");
-	      else
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-incoming");
-	      break;
+	  ippAddBoolean(shared, IPP_TAG_EVENT_NOTIFICATION, "printer-is-accepting-jobs", (char)dest->accepting);
+	}
 
-	  case IPP_JOB_PROCESSING :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-printing");
-	      break;
+	if (job)
+	{
+	 /*
+	  * Add job attributes...
+	  */
 
-	  case IPP_JOB_STOPPED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-stopped");
-	      break;
+	  ippAddInteger(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "notify-job-id", job->id);
+	  ippAddInteger(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "job-state", (int)job->state_value);
 
-	  case IPP_JOB_CANCELED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-canceled-by-user");
-	      break;
+	  if ((attr = ippFindAttribute(job->attrs, "job-name", IPP_TAG_NAME)) != NULL)
+	    ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "job-name", NULL, attr->values[0].string.text);
 
-	  case IPP_JOB_ABORTED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "aborted-by-system");
-	      break;
+	  switch (job->state_value)
+	  {
+	    case IPP_JOB_PENDING :
+		if (dest && dest->state == IPP_PRINTER_STOPPED)
+		  ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "printer-stopped");
+		else
+		  ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "none");
+		break;
+
+	    case IPP_JOB_HELD :
+		if (ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_KEYWORD) != NULL ||
+		    ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_NAME) != NULL)
+		  ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-hold-until-specified");
+		else
+		  ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-incoming");
+		break;
+
+	    case IPP_JOB_PROCESSING :
+		ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-printing");
+		break;
+
+	    case IPP_JOB_STOPPED :
+		ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-stopped");
+		break;
+
+	    case IPP_JOB_CANCELED :
+		ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-canceled-by-user");
+		break;
+
+	    case IPP_JOB_ABORTED :
+		ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "aborted-by-system");
+		break;
+
+	    case IPP_JOB_COMPLETED :
+		ippAddString(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-completed-successfully");
+		break;
+	  }
 
-	  case IPP_JOB_COMPLETED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-completed-successfully");
-	      break;
+	  ippAddInteger(shared, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "job-impressions-completed", job->sheets ? job->sheets->values[0].integer : 0);
 	}
-
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "job-impressions-completed", job->sheets ? job->sheets->values[0].integer : 0);
       }
 
+      temp->shared_attrs = shared;
+      shared->use ++;
+
      /*
       * Send the notification for this subscription...
       */
@@ -239,6 +304,8 @@ cupsdAddEvent(
     }
   }
 
+  ippDelete(shared);
+
   if (temp)
     cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
   else
@@ -379,6 +446,8 @@ cupsdAddSubscription(
 
   cupsArrayAdd(Subscriptions, temp);
 
+  sub_mask_valid = 0;
+
  /*
   * For RSS subscriptions, run the notifier immediately...
   */
@@ -410,6 +479,9 @@ cupsdDeleteAllSubscriptions(void)
 
   cupsArrayDelete(Subscriptions);
   Subscriptions = NULL;
+
+  cupsArrayDelete(sub_expires);
+  sub_expires = NULL;
 }
 
 
@@ -434,6 +506,38 @@ cupsdDeleteSubscription(
   */
 
   cupsArrayRemove(Subscriptions, sub);
+  cupsArrayRemove(sub_expires, sub);
+
+  sub_mask_valid = 0;
+
+ /*
+  * Stop a shared notifier after its last subscription goes away...
+  */
+
+  if (sub->recipient)
+  {
+    cupsd_subscription_t *notifier,	/* Shared notifier */
+			*temp;		/* Remaining subscription */
+    size_t		schemelen;	/* Length of "scheme:" */
+
+    if ((notifier = cupsd_find_notifier(sub->recipient, 0)) != NULL && notifier->pipe >= 0)
+    {
+      schemelen = strlen(notifier->recipient);
+
+      for (temp = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions); temp; temp = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+	if (temp->recipient && !strncmp(temp->recipient, notifier->recipient, schemelen))
+	  break;
+
+      if (!temp)
+	cupsd_stop_notifier(notifier);
+    }
+  }
+
+ /*
+  * Wake up any Get-Notifications requests for this subscription...
+  */
+
+  cupsd_wake_waiters(sub);
 
  /*
   * Free memory...
@@ -621,14 +725,14 @@ cupsdExpireSubscriptions(
   curtime = time(NULL);
   update  = 0;
 
-  cupsdLogMessage(CUPSD_LOG_INFO, "Expiring subscriptions...");
+  if (!dest && !job)
+  {
+   /*
+    * Leases are sorted by expiration time, so only look at the first ones...
+    */
 
-  for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
-       sub;
-       sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
-    if ((!sub->job && !dest && sub->expire && sub->expire <= curtime) ||
-	(dest && sub->dest == dest) ||
-	(job && sub->job == job))
+    while ((sub = (cupsd_subscription_t *)cupsArrayFirst(sub_expires)) != NULL &&
+           sub->expire <= curtime)
     {
       cupsdLogMessage(CUPSD_LOG_INFO, "Subscription %d has expired...",
 		      sub->id);
@@ -637,6 +741,24 @@ cupsdExpireSubscriptions(
 
       update = 1;
     }
+  }
+  else
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO, "Expiring subscriptions...");
+
+    for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
+	 sub;
+	 sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+      if ((dest && sub->dest == dest) || (job && sub->job == job))
+      {
+	cupsdLogMessage(CUPSD_LOG_INFO, "Subscription %d has expired...",
+			sub->id);
+
+	cupsdDeleteSubscription(sub, 0);
+
+	update = 1;
+      }
+  }
 
   if (update)
     cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
@@ -659,6 +781,24 @@ cupsdFindSubscription(int id)		/* I - Subscription ID */
 }
 
 
+/*
+ * 'cupsdGetSubscriptionExpiration()' - Get the time when the next subscription
+ *                                      lease expires.
+ */
+
+time_t					/* O - Expiration time or 0 for none */
+cupsdGetSubscriptionExpiration(void)
+{
+  cupsd_subscription_t	*sub;		/* First leased subscription */
+
+
+  if ((sub = (cupsd_subscription_t *)cupsArrayFirst(sub_expires)) != NULL)
+    return (sub->expire);
+  else
+    return (0);
+}
+
+
 /*
  * 'cupsdLoadAllSubscriptions()' - Load all subscriptions from the .conf file.
  */
@@ -776,6 +916,8 @@ cupsdLoadAllSubscriptions(void)
 	* See if the name exists...
 	*/
 
+	sub_mask_valid = 0;
+
 	if ((sub->mask |= cupsdEventValue(value)) == CUPSD_EVENT_NONE)
 	{
 	  cupsdLogMessage(CUPSD_LOG_ERROR,
@@ -1009,6 +1151,15 @@ cupsdLoadAllSubscriptions(void)
   }
 
   cupsFileClose(fp);
+
+ /*
+  * Index the leases that were loaded...
+  */
+
+  for (sub = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions);
+       sub;
+       sub = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
+    cupsdSetSubscriptionExpire(sub, sub->expire);
 }
 
 
@@ -1145,6 +1296,35 @@ cupsdSaveAllSubscriptions(void)
 }
 
 
+/*
+ * 'cupsdSetSubscriptionExpire()' - Set the lease expiration time of a
+ *                                  subscription.
+ *
+ * Always use this function to change the expiration time so that the lease
+ * index stays sorted.
+ */
+
+void
+cupsdSetSubscriptionExpire(
+    cupsd_subscription_t *sub,		/* I - Subscription object */
+    time_t               expire)	/* I - Expiration time or 0 for none */
+{
+  if (!sub_expires)
+    sub_expires = cupsArrayNew((cups_array_func_t)cupsd_compare_expires, NULL);
+
+  cupsArrayRemove(sub_expires, sub);
+
+  sub->expire = expire;
+
+ /*
+  * Job subscriptions expire with the job...
+  */
+
+  if (!sub->job && sub->expire)
+    cupsArrayAdd(sub_expires, sub);
+}
+
+
 /*
  * 'cupsdStopAllNotifiers()' - Stop all notifier processes.
  */
@@ -1177,6 +1357,25 @@ cupsdStopAllNotifiers(void)
       sub->pipe = -1;
     }
 
+  for (sub = (cupsd_subscription_t *)cupsArrayFirst(mux_notifiers);
+       sub;
+       sub = (cupsd_subscription_t *)cupsArrayNext(mux_notifiers))
+    if (sub->pipe >= 0)
+    {
+      cupsdEndProcess(sub->pid, 0);
+
+      close(sub->pipe);
+      sub->pipe = -1;
+    }
+
+  if (shared_dbus.recipient && shared_dbus.pipe >= 0)
+  {
+    cupsdEndProcess(shared_dbus.pid, 0);
+
+    close(shared_dbus.pipe);
+    shared_dbus.pipe = -1;
+  }
+
  /*
   * Close the status pipes...
   */
@@ -1197,6 +1396,44 @@ cupsdStopAllNotifiers(void)
 }
 
 
+/*
+ * 'cupsd_compare_expires()' - Compare the expiration times of two
+ *                             subscriptions.
+ */
+
+static int				/* O - Result of comparison */
+cupsd_compare_expires(
+    cupsd_subscription_t *first,	/* I - First subscription object */
+    cupsd_subscription_t *second,	/* I - Second subscription object */
+    void		 *unused)	/* I - Unused user data pointer */
+{
+  (void)unused;
+
+  if (first->expire < second->expire)
+    return (-1);
+  else if (first->expire > second->expire)
+    return (1);
+  else
+    return (first->id - second->id);
+}
+
+
+/*
+ * 'cupsd_compare_notifiers()' - Compare two multiplexed notifiers.
+ */
+
+static int				/* O - Result of comparison */
+cupsd_compare_notifiers(
+    cupsd_subscription_t *first,	/* I - First notifier */
+    cupsd_subscription_t *second,	/* I - Second notifier */
+    void		 *unused)	/* I - Unused user data pointer */
+{
+  (void)unused;
+
+  return (strcmp(first->recipient, second->recipient));
+}
+
+
 /*
  * 'cupsd_compare_subscriptions()' - Compare two subscriptions.
  */
@@ -1228,7 +1465,97 @@ cupsd_delete_event(cupsd_event_t *event)/* I - Event to delete */
   */
 
   ippDelete(event->attrs);
-  free(event);
+  ippDelete(event->shared_attrs);
+  cupsdSlabFree(CUPSD_SLAB_EVENT, event);
+}
+
+
+/*
+ * 'cupsd_find_notifier()' - Find the shared notifier for a recipient URI.
+ *
+ * Returns NULL when subscriptions for the URI scheme use their own notifier
+ * process.  Otherwise all subscriptions for the scheme share a single
+ * notifier that is started with "scheme:" as its recipient and gets the
+ * real recipient in the "notify-recipient-uri" attribute of each event.
+ */
+
+static cupsd_subscription_t *		/* O - Shared notifier or NULL */
+cupsd_find_notifier(
+    const char *recipient,		/* I - notify-recipient-uri */
+    int        create)			/* I - Create the notifier if needed? */
+{
+  char			scheme[256],	/* "scheme:" */
+			*ptr;		/* Pointer into scheme */
+  const char		*list;		/* Pointer into MultiplexNotifiers */
+  size_t		schemelen;	/* Length of scheme name */
+  cupsd_subscription_t	key,		/* Search key */
+			*notifier;	/* Shared notifier */
+
+
+  if (SharedDBusNotifier && !strncmp(recipient, "dbus:", 5))
+  {
+    if (!shared_dbus.recipient)
+    {
+      cupsdSetString(&shared_dbus.recipient, "dbus:");
+      shared_dbus.pipe = -1;
+    }
+
+    return (&shared_dbus);
+  }
+
+  if (!MultiplexNotifiers)
+    return (NULL);
+
+  strlcpy(scheme, recipient, sizeof(scheme) - 1);
+  if ((ptr = strchr(scheme, ':')) == NULL)
+    return (NULL);
+
+  *ptr      = '\0';
+  schemelen = (size_t)(ptr - scheme);
+
+ /*
+  * See if the scheme is listed in MultiplexNotifiers...
+  */
+
+  for (list = MultiplexNotifiers; *list;)
+  {
+    while (*list == ',' || isspace(*list & 255))
+      list ++;
+
+    if (!strncmp(list, scheme, schemelen) && (!list[schemelen] || list[schemelen] == ',' || isspace(list[schemelen] & 255)))
+      break;
+
+    while (*list && *list != ',' && !isspace(*list & 255))
+      list ++;
+  }
+
+  if (!*list)
+    return (NULL);
+
+ /*
+  * Find or create the notifier...
+  */
+
+  *ptr++ = ':';
+  *ptr   = '\0';
+
+  key.recipient = scheme;
+
+  if ((notifier = (cupsd_subscription_t *)cupsArrayFind(mux_notifiers, &key)) != NULL || !create)
+    return (notifier);
+
+  if (!mux_notifiers)
+    mux_notifiers = cupsArrayNew3((cups_array_func_t)cupsd_compare_notifiers, NULL, NULL, 0, NULL, NULL);
+
+  if ((notifier = calloc(1, sizeof(cupsd_subscription_t))) == NULL)
+    return (NULL);
+
+  cupsdSetString(&notifier->recipient, scheme);
+  notifier->pipe = -1;
+
+  cupsArrayAdd(mux_notifiers, notifier);
+
+  return (notifier);
 }
 
 
@@ -1322,6 +1649,8 @@ cupsd_send_notification(
     cupsd_event_t	 *event)	/* I - Event to send */
 {
   ipp_state_t	state;			/* IPP event state */
+  ipp_t		*message;		/* Event notification message */
+  cupsd_subscription_t *notifier = NULL;/* Subscription owning the notifier */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
@@ -1372,28 +1701,56 @@ cupsd_send_notification(
 
   cupsArrayAdd(sub->events, event);
 
+ /*
+  * Wake up any Get-Notifications requests waiting for this event...
+  */
+
+  cupsd_wake_waiters(sub);
+
  /*
   * Deliver the event...
   */
 
-  if (sub->recipient)
+  if (sub->recipient && (notifier = cupsd_find_notifier(sub->recipient, 1)) == NULL)
+    notifier = sub;
+  else if (notifier == &shared_dbus)
+  {
+   /*
+    * All dbus: subscriptions send the same signals, so deliver each event
+    * once to the shared notifier...
+    */
+
+    if (shared_dbus_sent)
+      notifier = NULL;
+
+    shared_dbus_sent = 1;
+  }
+
+  if (sub->recipient && notifier)
   {
     for (;;)
     {
-      if (sub->pipe < 0)
-	cupsd_start_notifier(sub);
+      if (notifier->pipe < 0)
+	cupsd_start_notifier(notifier);
 
-      cupsdLogMessage(CUPSD_LOG_DEBUG2, "sub->pipe=%d", sub->pipe);
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "notifier->pipe=%d", notifier->pipe);
 
-      if (sub->pipe < 0)
+      if (notifier->pipe < 0)
 	break;
 
-      event->attrs->state = IPP_IDLE;
+      message = ippNew();
+      ippCopyAttributes(message, event->attrs, 1, NULL, NULL);
+      ippCopyAttributes(message, event->shared_attrs, 1, NULL, NULL);
+
+      if (notifier != sub)
+        ippAddString(message, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI, "notify-recipient-uri", NULL, sub->recipient);
 
-      while ((state = ippWriteFile(sub->pipe, event->attrs)) != IPP_DATA)
+      while ((state = ippWriteFile(notifier->pipe, message)) != IPP_DATA)
 	if (state == IPP_ERROR)
 	  break;
 
+      ippDelete(message);
+
       if (state == IPP_ERROR)
       {
 	if (errno == EPIPE)
@@ -1406,10 +1763,10 @@ cupsd_send_notification(
 			  "Notifier for subscription %d (%s) went away, "
 			  "retrying!",
 			  sub->id, sub->recipient);
-	  cupsdEndProcess(sub->pid, 0);
+	  cupsdEndProcess(notifier->pid, 0);
 
-	  close(sub->pipe);
-	  sub->pipe = -1;
+	  close(notifier->pipe);
+	  notifier->pipe = -1;
 	  continue;
 	}
 
@@ -1557,6 +1914,27 @@ cupsd_start_notifier(
 }
 
 
+/*
+ * 'cupsd_stop_notifier()' - Stop a shared notifier.
+ *
+ * Closing the pipe lets the notifier deliver any pending events and exit on
+ * its own.
+ */
+
+static void
+cupsd_stop_notifier(
+    cupsd_subscription_t *notifier)	/* I - Shared notifier */
+{
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Stopping shared notifier %s - PID = %d",
+		  notifier->recipient, notifier->pid);
+
+  close(notifier->pipe);
+
+  notifier->pipe = -1;
+  notifier->pid  = 0;
+}
+
+
 /*
  * 'cupsd_update_notifier()' - Read messages from notifiers.
  */
@@ -1574,7 +1952,39 @@ cupsd_update_notifier(void)
     if (loglevel == CUPSD_LOG_INFO)
       cupsdLogMessage(CUPSD_LOG_INFO, "%s", message);
 
-    if (!strchr(NotifierStatusBuffer->buffer, '\n'))
+    if (!NotifierStatusBuffer->buflines)
       break;
   }
 }
+
+
+/*
+ * 'cupsd_wake_waiters()' - Wake up clients waiting for subscription events.
+ */
+
+static void
+cupsd_wake_waiters(
+    cupsd_subscription_t *sub)		/* I - Subscription object */
+{
+  int			i;		/* Looping var */
+  cupsd_client_t	*con;		/* Waiting client */
+  ipp_attribute_t	*ids;		/* notify-subscription-ids */
+
+
+  for (con = (cupsd_client_t *)cupsArrayFirst(NotifyWaiters);
+       con;
+       con = (cupsd_client_t *)cupsArrayNext(NotifyWaiters))
+  {
+    if (con->notify_ready ||
+        (ids = ippFindAttribute(con->request, "notify-subscription-ids",
+                                IPP_TAG_INTEGER)) == NULL)
+      continue;
+
+    for (i = 0; i < ids->num_values; i ++)
+      if (ids->values[i].integer == sub->id)
+      {
+        con->notify_ready = 1;
+	break;
+      }
+  }
+}
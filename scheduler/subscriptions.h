@@ -71,7 +71,8 @@ typedef struct cupsd_event_s		/**** Event structure ****/
 {
   cupsd_eventmask_t	event;		/* Event */
   time_t		time;		/* Time of event */
-  ipp_t			*attrs;		/* Notification message */
+  ipp_t			*attrs,		/* Notification message */
+			*shared_attrs;	/* Attributes shared with other events */
   cupsd_printer_t	*dest;		/* Associated printer, if any */
   cupsd_job_t		*job;		/* Associated job, if any */
 } cupsd_event_t;
@@ -115,8 +116,12 @@ VAR int		MaxSubscriptions VALUE(100),
 					/* Next subscription ID */
 		DefaultLeaseDuration VALUE(86400),
 					/* Default notify-lease-duration */
-		MaxLeaseDuration VALUE(0);
+		MaxLeaseDuration VALUE(0),
 					/* Maximum notify-lease-duration */
+		SharedDBusNotifier VALUE(0);
+					/* Use one notifier for all dbus: subscriptions? */
+VAR char	*MultiplexNotifiers VALUE(NULL);
+					/* Schemes using one notifier for all subscriptions */
 VAR cups_array_t *Subscriptions VALUE(NULL);
 					/* Active subscriptions */
 
@@ -150,6 +155,9 @@ extern cupsd_subscription_t *
 		cupsdFindSubscription(int id);
 extern void	cupsdExpireSubscriptions(cupsd_printer_t *dest,
 		                         cupsd_job_t *job);
+extern time_t	cupsdGetSubscriptionExpiration(void);
 extern void	cupsdLoadAllSubscriptions(void);
 extern void	cupsdSaveAllSubscriptions(void);
+extern void	cupsdSetSubscriptionExpire(cupsd_subscription_t *sub,
+		                           time_t expire);
 extern void	cupsdStopAllNotifiers(void);
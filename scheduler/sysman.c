@@ -42,30 +42,67 @@
 void
 cupsdCleanDirty(void)
 {
+  struct timeval	start;		/* Start of write */
+
+
+  CUPSD_PROBE1(dirty__clean__start, DirtyFiles);
+
+  cupsdStartConfBatch();
+
   if (DirtyFiles & CUPSD_DIRTY_PRINTERS)
+  {
+    gettimeofday(&start, NULL);
     cupsdSaveAllPrinters();
+    cupsdAddFileMetric(CUPSD_DIRTY_PRINTERS, &start);
+  }
 
   if (DirtyFiles & CUPSD_DIRTY_CLASSES)
+  {
+    gettimeofday(&start, NULL);
     cupsdSaveAllClasses();
+    cupsdAddFileMetric(CUPSD_DIRTY_CLASSES, &start);
+  }
 
   if (DirtyFiles & CUPSD_DIRTY_PRINTCAP)
+  {
+    gettimeofday(&start, NULL);
     cupsdWritePrintcap();
+    cupsdAddFileMetric(CUPSD_DIRTY_PRINTCAP, &start);
+  }
 
   if (DirtyFiles & CUPSD_DIRTY_JOBS)
   {
     cupsd_job_t	*job;			/* Current job */
 
-    cupsdSaveAllJobs();
+    gettimeofday(&start, NULL);
 
     for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
          job;
 	 job = (cupsd_job_t *)cupsArrayNext(Jobs))
       if (job->dirty)
         cupsdSaveJob(job);
+
+    cupsdSaveAllJobs();
+    cupsdAddFileMetric(CUPSD_DIRTY_JOBS, &start);
   }
 
   if (DirtyFiles & CUPSD_DIRTY_SUBSCRIPTIONS)
+  {
+    gettimeofday(&start, NULL);
     cupsdSaveAllSubscriptions();
+    cupsdAddFileMetric(CUPSD_DIRTY_SUBSCRIPTIONS, &start);
+  }
+
+  if (DirtyFiles & CUPSD_DIRTY_QUOTAS)
+  {
+    gettimeofday(&start, NULL);
+    cupsdSaveAllQuotas();
+    cupsdAddFileMetric(CUPSD_DIRTY_QUOTAS, &start);
+  }
+
+  cupsdFinishConfBatch();
+
+  CUPSD_PROBE1(dirty__clean__done, DirtyFiles);
 
   DirtyFiles     = CUPSD_DIRTY_NONE;
   DirtyCleanTime = 0;
@@ -81,12 +118,13 @@ cupsdCleanDirty(void)
 void
 cupsdMarkDirty(int what)		/* I - What file(s) are dirty? */
 {
-  cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdMarkDirty(%c%c%c%c%c)",
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdMarkDirty(%c%c%c%c%c%c)",
 		  (what & CUPSD_DIRTY_PRINTERS) ? 'P' : '-',
 		  (what & CUPSD_DIRTY_CLASSES) ? 'C' : '-',
 		  (what & CUPSD_DIRTY_PRINTCAP) ? 'p' : '-',
 		  (what & CUPSD_DIRTY_JOBS) ? 'J' : '-',
-		  (what & CUPSD_DIRTY_SUBSCRIPTIONS) ? 'S' : '-');
+		  (what & CUPSD_DIRTY_SUBSCRIPTIONS) ? 'S' : '-',
+		  (what & CUPSD_DIRTY_QUOTAS) ? 'Q' : '-');
 
   if (what == CUPSD_DIRTY_PRINTCAP && !Printcap)
     return;
@@ -107,7 +145,6 @@ cupsdMarkDirty(int what)		/* I - What file(s) are dirty? */
 void
 cupsdSetBusyState(int working)          /* I - Doing significant work? */
 {
-  int			i;		/* Looping var */
   cupsd_job_t		*job;		/* Current job */
   cupsd_printer_t	*p;		/* Current printer */
   int			newbusy;	/* New busy state */
@@ -139,15 +176,9 @@ cupsdSetBusyState(int working)          /* I - Doing significant work? */
        job;
        job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
   {
-    if ((p = job->printer) != NULL)
-    {
-      for (i = 0; i < p->num_reasons; i ++)
-	if (!strcmp(p->reasons[i], "connecting-to-device"))
-	  break;
-
-      if (!p->num_reasons || i >= p->num_reasons)
-	break;
-    }
+    if ((p = job->printer) != NULL &&
+        !cupsdPrinterHasReason(p, "connecting-to-device"))
+      break;
   }
 
   if (job)
@@ -835,16 +866,10 @@ sysUpdate(void)
            p;
 	   p = (cupsd_printer_t *)cupsArrayNext(Printers))
       {
-        if (p->job)
-        {
-	  for (i = 0; i < p->num_reasons; i ++)
-	    if (!strcmp(p->reasons[i], "connecting-to-device") ||
-	        !strcmp(p->reasons[i], "cups-waiting-for-job-completed"))
-	      break;
-
-	  if (!p->num_reasons || i >= p->num_reasons)
-	    break;
-        }
+        if (p->job &&
+            !cupsdPrinterHasReason(p, "connecting-to-device") &&
+            !cupsdPrinterHasReason(p, "cups-waiting-for-job-completed"))
+	  break;
       }
 
       if (p)
@@ -895,16 +920,10 @@ sysUpdate(void)
 	     p;
 	     p = (cupsd_printer_t *)cupsArrayNext(Printers))
 	{
-	  if (p->job)
-	  {
-	    for (i = 0; i < p->num_reasons; i ++)
-	      if (!strcmp(p->reasons[i], "connecting-to-device") ||
-	          !strcmp(p->reasons[i], "cups-waiting-for-job-completed"))
-		break;
-
-	    if (!p->num_reasons || i >= p->num_reasons)
-	      break;
-	  }
+	  if (p->job &&
+	      !cupsdPrinterHasReason(p, "connecting-to-device") &&
+	      !cupsdPrinterHasReason(p, "cups-waiting-for-job-completed"))
+	    break;
 	}
 
 	if (p)
@@ -955,6 +974,8 @@ sysUpdate(void)
               job->cancel_time = time(NULL) + ippGetInteger(cancel_after, 0);
             else
               job->cancel_time = time(NULL) + MaxJobTime;
+
+            cupsdUpdateJobQueues(job);
           }
         }
       }
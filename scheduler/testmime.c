@@ -25,7 +25,9 @@
 static void	add_ppd_filter(mime_t *mime, mime_type_t *filtertype,
 		               const char *filter);
 static void	add_ppd_filters(mime_t *mime, ppd_file_t *ppd);
+static int	compare_rules(mime_magic_t *a, mime_magic_t *b);
 static void	print_rules(mime_magic_t *rules);
+static int	test_cache(const char *cachefile, const char *filter_path);
 static void	type_dir(mime_t *mime, const char *dirname);
 
 
@@ -61,7 +63,14 @@ main(int  argc,				/* I - Number of command-line args */
   srcinfo.st_size = 0;
 
   for (i = 1; i < argc; i ++)
-    if (!strcmp(argv[i], "-d"))
+    if (!strcmp(argv[i], "-c"))
+    {
+      i ++;
+
+      if (i < argc)
+        return (test_cache(argv[i], filter_path));
+    }
+    else if (!strcmp(argv[i], "-d"))
     {
       i ++;
 
@@ -334,6 +343,36 @@ add_ppd_filters(mime_t     *mime,	/* I - MIME database */
 }
 
 
+/*
+ * 'compare_rules()' - Compare two rule trees...
+ */
+
+static int				/* O - 0 if equal, 1 otherwise */
+compare_rules(mime_magic_t *a,		/* I - First rules */
+              mime_magic_t *b)		/* I - Second rules */
+{
+  for (; a && b; a = a->next, b = b->next)
+  {
+    if (a->op != b->op || a->invert != b->invert || a->offset != b->offset ||
+        a->region != b->region || a->length != b->length)
+      return (1);
+
+    if (a->op == MIME_MAGIC_REGEX)
+    {
+      if (!a->pattern || !b->pattern || strcmp(a->pattern, b->pattern))
+        return (1);
+    }
+    else if (memcmp(a->value.matchv, b->value.matchv, sizeof(a->value.matchv)))
+      return (1);
+
+    if (compare_rules(a->child, b->child))
+      return (1);
+  }
+
+  return (a != b);
+}
+
+
 /*
  * 'print_rules()' - Print the rules for a file type...
  */
@@ -422,6 +461,90 @@ print_rules(mime_magic_t *rules)	/* I - Rules to print */
 }
 
 
+/*
+ * 'test_cache()' - Test that a cached MIME database matches the original.
+ */
+
+static int				/* O - Exit status */
+test_cache(const char *cachefile,	/* I - Cache file */
+           const char *filter_path)	/* I - Filter path */
+{
+  mime_t	*mime,			/* MIME database from files */
+		*cached;		/* MIME database from cache */
+  mime_type_t	*type,			/* Current type */
+		*ctype;			/* Cached type */
+  mime_filter_t	*filter,		/* Current filter */
+		*cfilter;		/* Cached filter */
+  struct stat	cacheinfo;		/* Cache file information */
+  int		status = 0;		/* Exit status */
+
+
+  unlink(cachefile);
+
+  fputs("mimeLoadCached(create): ", stdout);
+  mime = mimeLoadCached(NULL, cachefile, "../conf", filter_path);
+
+  if (!mime || mimeNumTypes(mime) == 0 || stat(cachefile, &cacheinfo))
+  {
+    puts("FAIL");
+    return (1);
+  }
+
+  printf("PASS (%d types, %d filters)\n", mimeNumTypes(mime),
+         mimeNumFilters(mime));
+
+  fputs("mimeLoadCached(cached): ", stdout);
+  cached = mimeLoadCached(NULL, cachefile, "../conf", filter_path);
+
+  if (!cached || mimeNumTypes(cached) != mimeNumTypes(mime) ||
+      mimeNumFilters(cached) != mimeNumFilters(mime))
+  {
+    puts("FAIL (counts differ)");
+    return (1);
+  }
+
+  for (type = mimeFirstType(mime); type; type = mimeNextType(mime))
+  {
+    if ((ctype = mimeType(cached, type->super, type->type)) == NULL ||
+        ctype->priority != type->priority ||
+        compare_rules(type->rules, ctype->rules))
+    {
+      printf("FAIL (%s/%s differs)\n", type->super, type->type);
+      status = 1;
+      break;
+    }
+  }
+
+  for (filter = mimeFirstFilter(mime);
+       filter && !status;
+       filter = mimeNextFilter(mime))
+  {
+    cfilter = mimeFilterLookup(cached,
+                               mimeType(cached, filter->src->super,
+			                filter->src->type),
+			       mimeType(cached, filter->dst->super,
+			                filter->dst->type));
+
+    if (!cfilter || cfilter->cost != filter->cost ||
+        strcmp(cfilter->filter, filter->filter))
+    {
+      printf("FAIL (%s/%s to %s/%s differs)\n", filter->src->super,
+             filter->src->type, filter->dst->super, filter->dst->type);
+      status = 1;
+    }
+  }
+
+  if (!status)
+    puts("PASS");
+
+  mimeDelete(mime);
+  mimeDelete(cached);
+  unlink(cachefile);
+
+  return (status);
+}
+
+
 /*
  * 'type_dir()' - Show the MIME types for a given directory.
  */
@@ -20,53 +20,119 @@
 #include <sys/wait.h>
 
 
+/*
+ * Constants...
+ */
+
+#define SPEED_MAX_OPS	16		/* Maximum number of operations in a mix */
+#define SPEED_SUB_BITS	5		/* Histogram sub-buckets per power of 2 (log2) */
+#define SPEED_BUCKETS	(40 << SPEED_SUB_BITS)
+					/* Number of histogram buckets */
+
+
+/*
+ * Types...
+ */
+
+typedef enum speed_format_e		/**** Report format ****/
+{
+  SPEED_FORMAT_TEXT,			/* Plain text */
+  SPEED_FORMAT_CSV,			/* Comma-separated values */
+  SPEED_FORMAT_JSON			/* JSON object */
+} speed_format_t;
+
+typedef struct speed_stats_s		/**** Statistics for an operation ****/
+{
+  ipp_op_t	op;			/* Operation code */
+  int		count,			/* Number of requests */
+		errors;			/* Number of failed requests */
+  double	total,			/* Total time in seconds */
+		max;			/* Maximum time in seconds */
+  unsigned	buckets[SPEED_BUCKETS];	/* Latency histogram (microseconds) */
+} speed_stats_t;
+
+typedef struct speed_test_s		/**** Test settings ****/
+{
+  const char	*server;		/* Server to use */
+  int		port;			/* Port to use */
+  http_encryption_t encryption;		/* Encryption to use */
+  int		requests;		/* Number of requests per client */
+  const char	*printer,		/* Printer name for jobs */
+		*filename,		/* Print file */
+		*format;		/* Print file format */
+  int		verbose;		/* Verbosity */
+  int		num_schedule;		/* Number of operations in schedule */
+  ipp_op_t	schedule[256];		/* Weighted schedule of operations */
+  int		num_stats;		/* Number of operations tracked */
+  speed_stats_t	*stats;			/* Statistics for each operation */
+} speed_test_t;
+
+
 /*
  * Local functions...
  */
 
-static int	do_test(const char *server, int port,
-		        http_encryption_t encryption, int requests,
-			const char *opstring, int verbose);
+static void	add_sample(speed_stats_t *stats, double reqtime, int error);
+static int	bucket_index(double reqtime);
+static double	bucket_value(int bucket);
+static int	do_test(speed_test_t *test, int client);
+static speed_stats_t *find_stats(speed_test_t *test, ipp_op_t op);
+static double	get_percentile(speed_stats_t *stats, double percentile);
+static int	make_file(char *filename, size_t filesize, long size);
+static void	merge_stats(speed_stats_t *to, speed_stats_t *from);
+static int	parse_mix(speed_test_t *test, const char *mix);
+static void	print_report(speed_test_t *test, speed_format_t format, int clients, double elapsed);
 static void	usage(void) _CUPS_NORETURN;
 
 
 /*
- * 'main()' - Send multiple IPP requests and report on the average response
- *            time.
+ * 'main()' - Send a mix of IPP requests from multiple clients and report the
+ *            throughput and latency of each operation.
  */
 
 int
 main(int  argc,				/* I - Number of command-line arguments */
      char *argv[])			/* I - Command-line arguments */
 {
-  int		i;			/* Looping var */
-  char		*server,		/* Server to use */
-		*ptr;			/* Pointer to port in server */
-  int		port;			/* Port to use */
-  http_encryption_t encryption;		/* Encryption to use */
-  int		requests;		/* Number of requests to send */
+  int		i, j;			/* Looping vars */
+  char		*ptr,			/* Pointer to port in server */
+		*units;			/* Pointer to size units */
   int		children;		/* Number of children to fork */
   int		good_children;		/* Number of children that exited normally */
   int		pid;			/* Child PID */
   int		status;			/* Child status */
-  time_t	start,			/* Start time */
+  int		(*pipes)[2] = NULL;	/* Result pipes for children */
+  struct timeval start,			/* Start time */
 		end;			/* End time */
   double	elapsed;		/* Elapsed time */
-  int		verbose;		/* Verbosity */
-  const char	*opstring;		/* Operation name */
+  const char	*opstring,		/* Operation name */
+		*mix;			/* Operation mix */
+  long		filesize;		/* Size of generated print file */
+  char		tempfile[1024] = "";	/* Generated print file */
+  speed_format_t format;		/* Report format */
+  speed_test_t	test;			/* Test settings */
+  speed_stats_t	*child_stats;		/* Statistics from a child */
 
 
  /*
   * Parse command-line options...
   */
 
-  requests   = 100;
-  children   = 5;
-  server     = (char *)cupsServer();
-  port       = ippPort();
-  encryption = HTTP_ENCRYPT_IF_REQUESTED;
-  verbose    = 0;
-  opstring   = NULL;
+  memset(&test, 0, sizeof(test));
+
+  test.requests   = 100;
+  test.server     = cupsServer();
+  test.port       = ippPort();
+  test.encryption = HTTP_ENCRYPT_IF_REQUESTED;
+  test.printer    = "test";
+  test.filename   = "../examples/testfile.ps";
+  test.format     = "application/postscript";
+
+  children = 5;
+  opstring = NULL;
+  mix      = "Print-Job,CUPS-Get-Default,CUPS-Get-Printers,CUPS-Get-Classes,Get-Jobs";
+  filesize = 0;
+  format   = SPEED_FORMAT_TEXT;
 
   for (i = 1; i < argc; i ++)
     if (argv[i][0] == '-')
@@ -75,7 +141,22 @@ main(int  argc,				/* I - Number of command-line arguments */
         switch (*ptr)
 	{
 	  case 'E' : /* Enable encryption */
-	      encryption = HTTP_ENCRYPT_REQUIRED;
+	      test.encryption = HTTP_ENCRYPT_REQUIRED;
+	      break;
+
+	  case 'O' : /* Report format */
+	      i ++;
+	      if (i >= argc)
+		usage();
+
+	      if (!strcmp(argv[i], "csv"))
+	        format = SPEED_FORMAT_CSV;
+	      else if (!strcmp(argv[i], "json"))
+	        format = SPEED_FORMAT_JSON;
+	      else if (!strcmp(argv[i], "text"))
+	        format = SPEED_FORMAT_TEXT;
+	      else
+	        usage();
 	      break;
 
 	  case 'c' : /* Number of children */
@@ -86,6 +167,22 @@ main(int  argc,				/* I - Number of command-line arguments */
 	      children = atoi(argv[i]);
 	      break;
 
+	  case 'f' : /* Print file */
+	      i ++;
+	      if (i >= argc)
+		usage();
+
+	      test.filename = argv[i];
+	      break;
+
+	  case 'm' : /* Operation mix */
+	      i ++;
+	      if (i >= argc)
+		usage();
+
+	      mix = argv[i];
+	      break;
+
           case 'o' : /* Operation */
 	      i ++;
 	      if (i >= argc)
@@ -94,16 +191,36 @@ main(int  argc,				/* I - Number of command-line arguments */
 	      opstring = argv[i];
 	      break;
 
+	  case 'p' : /* Printer name */
+	      i ++;
+	      if (i >= argc)
+		usage();
+
+	      test.printer = argv[i];
+	      break;
+
           case 'r' : /* Number of requests */
 	      i ++;
 	      if (i >= argc)
 		usage();
 
-	      requests = atoi(argv[i]);
+	      test.requests = atoi(argv[i]);
+	      break;
+
+	  case 's' : /* Size of generated print file */
+	      i ++;
+	      if (i >= argc)
+		usage();
+
+	      filesize = strtol(argv[i], &units, 10);
+	      if (*units == 'k' || *units == 'K')
+	        filesize *= 1024;
+	      else if (*units == 'm' || *units == 'M')
+	        filesize *= 1024 * 1024;
 	      break;
 
           case 'v' : /* Verbose logging */
-              verbose ++;
+              test.verbose ++;
 	      break;
 
           default :
@@ -113,87 +230,153 @@ main(int  argc,				/* I - Number of command-line arguments */
     }
     else
     {
-      server = argv[i];
+      test.server = argv[i];
 
-      if (server[0] != '/' && (ptr = strrchr(server, ':')) != NULL)
+      if (argv[i][0] != '/' && (ptr = strrchr(argv[i], ':')) != NULL)
       {
-        *ptr++ = '\0';
-	port   = atoi(ptr);
+        *ptr++    = '\0';
+	test.port = atoi(ptr);
       }
     }
 
- /*
-  * Then create child processes to act as clients...
-  */
+  if (test.requests < 1)
+    usage();
 
-  if (children > 0)
-  {
-    printf("testspeed: Simulating %d clients with %d requests to %s with "
-           "%sencryption...\n", children, requests, server,
-	   encryption == HTTP_ENCRYPT_IF_REQUESTED ? "no " : "");
-  }
+  if (!parse_mix(&test, opstring ? opstring : mix))
+    return (1);
 
-  start = time(NULL);
+ /*
+  * Generate a print file of the requested size...
+  */
 
-  if (children < 1)
-    return (do_test(server, port, encryption, requests, opstring, verbose));
-  else if (children == 1)
-    good_children = do_test(server, port, encryption, requests, opstring,
-                            verbose) ? 0 : 1;
-  else
+  if (filesize > 0)
   {
-    char	options[255],		/* Command-line options for child */
-		reqstr[255],		/* Requests string for child */
-		serverstr[255];		/* Server:port string for child */
+    if (!make_file(tempfile, sizeof(tempfile), filesize))
+      return (1);
 
+    test.filename = tempfile;
+    test.format   = "text/plain";
+  }
 
-    snprintf(reqstr, sizeof(reqstr), "%d", requests);
+  if (format == SPEED_FORMAT_TEXT)
+    printf("testspeed: Simulating %d clients with %d requests to %s with "
+           "%sencryption...\n", children > 1 ? children : 1, test.requests,
+           test.server, test.encryption == HTTP_ENCRYPT_IF_REQUESTED ? "no " :
+	   "");
 
-    if (port == 631 || server[0] == '/')
-      strlcpy(serverstr, server, sizeof(serverstr));
-    else
-      snprintf(serverstr, sizeof(serverstr), "%s:%d", server, port);
+  gettimeofday(&start, NULL);
 
-    strlcpy(options, "-cr", sizeof(options));
+  if (children <= 1)
+  {
+   /*
+    * Run a single client in this process...
+    */
 
-    if (encryption == HTTP_ENCRYPT_REQUIRED)
-      strlcat(options, "E", sizeof(options));
+    children      = 1;
+    good_children = do_test(&test, 0) ? 0 : 1;
+  }
+  else
+  {
+   /*
+    * Then create child processes to act as clients, each of which sends back
+    * its statistics through a pipe when it is done...
+    */
 
-    if (verbose)
-      strlcat(options, "v", sizeof(options));
+    if ((pipes = calloc((size_t)children, sizeof(int[2]))) == NULL ||
+        (child_stats = calloc((size_t)test.num_stats, sizeof(speed_stats_t))) == NULL)
+    {
+      perror("testspeed: Unable to allocate memory");
+      return (1);
+    }
 
     for (i = 0; i < children; i ++)
     {
       fflush(stdout);
 
+      if (pipe(pipes[i]))
+      {
+        printf("testspeed: Unable to create pipe: %s\n", strerror(errno));
+        break;
+      }
+
       if ((pid = fork()) == 0)
       {
        /*
 	* Child goes here...
 	*/
 
-        if (opstring)
-	  execlp(argv[0], argv[0], options, "0", reqstr, "-o", opstring,
-	         serverstr, (char *)NULL);
-        else
-	  execlp(argv[0], argv[0], options, "0", reqstr, serverstr, (char *)NULL);
+        ssize_t	bytes;			/* Bytes written */
+        size_t	total = (size_t)test.num_stats * sizeof(speed_stats_t);
+					/* Total bytes to write */
+        char	*data = (char *)test.stats;
+					/* Statistics to write */
+
+        close(pipes[i][0]);
 
-	exit(errno);
+        status = do_test(&test, i);
+
+        while (total > 0 && (bytes = write(pipes[i][1], data, total)) > 0)
+        {
+          data  += bytes;
+          total -= (size_t)bytes;
+        }
+
+	exit(status);
       }
       else if (pid < 0)
       {
 	printf("testspeed: Fork failed: %s\n", strerror(errno));
+	close(pipes[i][0]);
+	close(pipes[i][1]);
 	break;
       }
       else
-	printf("testspeed: Started child %d...\n", pid);
+      {
+        close(pipes[i][1]);
+
+        if (test.verbose)
+	  printf("testspeed: Started child %d...\n", pid);
+      }
     }
 
+    children = i;
+
    /*
-    * Wait for children to finish...
+    * Collect the statistics from each child...
     */
 
-    puts("testspeed: Waiting for children to finish...");
+    for (i = 0; i < children; i ++)
+    {
+      ssize_t	bytes;			/* Bytes read */
+      size_t	total = 0,		/* Total bytes read */
+		needed = (size_t)test.num_stats * sizeof(speed_stats_t);
+					/* Bytes needed */
+
+      while (total < needed && (bytes = read(pipes[i][0], (char *)child_stats + total, needed - total)) != 0)
+      {
+        if (bytes < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          break;
+        }
+
+        total += (size_t)bytes;
+      }
+
+      close(pipes[i][0]);
+
+      if (total == needed)
+      {
+        for (j = 0; j < test.num_stats; j ++)
+          merge_stats(test.stats + j, child_stats + j);
+      }
+    }
+
+   /*
+    * Wait for children to finish...
+    */
 
     for (good_children = 0;;)
     {
@@ -201,33 +384,107 @@ main(int  argc,				/* I - Number of command-line arguments */
 
       if (pid < 0 && errno != EINTR)
 	break;
+      else if (pid < 0)
+        continue;
 
-      printf("testspeed: Ended child %d (%d)...\n", pid, status / 256);
+      if (test.verbose)
+        printf("testspeed: Ended child %d (%d)...\n", pid, status / 256);
 
       if (!status)
         good_children ++;
     }
+
+    free(pipes);
+    free(child_stats);
   }
 
+  gettimeofday(&end, NULL);
+
+  elapsed = (end.tv_sec - start.tv_sec) + 0.000001 * (end.tv_usec - start.tv_usec);
+
+  if (tempfile[0])
+    unlink(tempfile);
+
  /*
-  * Compute the total run time...
+  * Report the results...
   */
 
   if (good_children > 0)
-  {
-    end     = time(NULL);
-    elapsed = end - start;
-    i       = good_children * requests;
+    print_report(&test, format, children, elapsed);
 
-    printf("testspeed: %dx%d=%d requests in %.1fs (%.3fs/r, %.1fr/s)\n",
-	   good_children, requests, i, elapsed, elapsed / i, i / elapsed);
-  }
+  free(test.stats);
 
- /*
-  * Exit with no errors...
-  */
+  return (good_children == children ? 0 : 1);
+}
 
-  return (0);
+
+/*
+ * 'add_sample()' - Add a request time to the statistics for an operation.
+ */
+
+static void
+add_sample(speed_stats_t *stats,	/* I - Operation statistics */
+           double        reqtime,	/* I - Request time in seconds */
+           int           error)		/* I - 1 if the request failed */
+{
+  stats->count ++;
+  stats->total += reqtime;
+  stats->buckets[bucket_index(reqtime)] ++;
+
+  if (reqtime > stats->max)
+    stats->max = reqtime;
+
+  if (error)
+    stats->errors ++;
+}
+
+
+/*
+ * 'bucket_index()' - Get the histogram bucket for a request time.
+ *
+ * Times are recorded in microseconds with 2^SPEED_SUB_BITS buckets for each
+ * power of 2, so every bucket is within about 3% of the recorded values.
+ */
+
+static int				/* O - Bucket index */
+bucket_index(double reqtime)		/* I - Request time in seconds */
+{
+  unsigned long long	usecs;		/* Time in microseconds */
+  int			exponent;	/* Power of 2 */
+
+
+  usecs = (unsigned long long)(reqtime * 1000000.0);
+
+  if (usecs < (1 << SPEED_SUB_BITS))
+    return ((int)usecs);
+
+  for (exponent = 0; (usecs >> exponent) >= (2 << SPEED_SUB_BITS); exponent ++);
+
+  if ((exponent + 2) << SPEED_SUB_BITS > SPEED_BUCKETS)
+    return (SPEED_BUCKETS - 1);
+
+  return (((exponent + 1) << SPEED_SUB_BITS) + (int)((usecs >> exponent) - (1 << SPEED_SUB_BITS)));
+}
+
+
+/*
+ * 'bucket_value()' - Get the time in seconds at the middle of a bucket.
+ */
+
+static double				/* O - Time in seconds */
+bucket_value(int bucket)		/* I - Bucket index */
+{
+  int			exponent;	/* Power of 2 */
+  unsigned long long	usecs;		/* Time in microseconds */
+
+
+  if (bucket < (1 << SPEED_SUB_BITS))
+    return (0.000001 * bucket);
+
+  exponent = (bucket >> SPEED_SUB_BITS) - 1;
+  usecs    = (unsigned long long)((bucket & ((1 << SPEED_SUB_BITS) - 1)) + (1 << SPEED_SUB_BITS)) << exponent;
+
+  return (0.000001 * (usecs + ((1ULL << exponent) >> 1)));
 }
 
 
@@ -236,85 +493,89 @@ main(int  argc,				/* I - Number of command-line arguments */
  */
 
 static int				/* O - Exit status */
-do_test(const char        *server,	/* I - Server to use */
-        int               port,		/* I - Port number to use */
-        http_encryption_t encryption,	/* I - Encryption to use */
-	int               requests,	/* I - Number of requests to send */
-	const char        *opstring,	/* I - Operation string */
-	int               verbose)	/* I - Verbose output? */
+do_test(speed_test_t *test,		/* I - Test settings */
+        int          client)		/* I - Client number */
 {
   int		i;			/* Looping var */
   http_t	*http;			/* Connection to server */
-  ipp_t		*request;		/* IPP Request */
+  ipp_t		*request,		/* IPP Request */
+		*response;		/* IPP Response */
+  ipp_attribute_t *attr;		/* Subscription ID */
   struct timeval start,			/* Start time */
 		end;			/* End time */
   double	reqtime,		/* Time for this request */
 		elapsed;		/* Elapsed time */
-  int		op;			/* Current operation */
-  static ipp_op_t ops[5] =		/* Operations to test... */
-		{
-		  IPP_PRINT_JOB,
-		  CUPS_GET_DEFAULT,
-		  CUPS_GET_PRINTERS,
-		  CUPS_GET_CLASSES,
-		  IPP_GET_JOBS
-		};
+  ipp_op_t	op;			/* Current operation */
+  int		error;			/* Did the request fail? */
+  int		sub_id;			/* Subscription ID to cancel */
+  char		uri[1024],		/* Printer URI */
+		resource[1024];		/* Printer resource */
 
 
  /*
   * Connect to the server...
   */
 
-  if ((http = httpConnectEncrypt(server, port, encryption)) == NULL)
+  if ((http = httpConnectEncrypt(test->server, test->port, test->encryption)) == NULL)
   {
     printf("testspeed(%d): unable to connect to server - %s\n", (int)getpid(),
            strerror(errno));
     return (1);
   }
 
+  snprintf(resource, sizeof(resource), "/printers/%s", test->printer);
+  httpAssembleURI(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", 0, resource);
+
  /*
-  * Do multiple requests...
+  * Do multiple requests, starting each client at a different point in the
+  * schedule so that the operations are interleaved...
   */
 
-  for (elapsed = 0.0, i = 0; i < requests; i ++)
+  for (elapsed = 0.0, i = 0; i < test->requests; i ++)
   {
-   /*
-    * Build a request which requires the following attributes:
-    *
-    *    attributes-charset
-    *    attributes-natural-language
-    *
-    * In addition, IPP_GET_JOBS needs a printer-uri attribute.
-    */
-
-    if (opstring)
-      op = ippOpValue(opstring);
-    else
-      op = ops[i % (int)(sizeof(ops) / sizeof(ops[0]))];
-
+    op      = test->schedule[(i + client) % test->num_schedule];
     request = ippNewRequest(op);
+    sub_id  = 0;
 
     gettimeofday(&start, NULL);
 
-    if (verbose)
+    if (test->verbose > 1)
       printf("testspeed(%d): %.6f %s ", (int)getpid(), elapsed,
 	     ippOpString(op));
 
     switch (op)
     {
-      case IPP_GET_JOBS :
+      case IPP_PRINT_JOB :
 	  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
-                       NULL, "ipp://localhost/printers/");
+                       NULL, uri);
+          ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE,
+                       "document-format", NULL, test->format);
+	  response = cupsDoFileRequest(http, request, resource, test->filename);
+          break;
 
-      default :
-	  ippDelete(cupsDoRequest(http, request, "/"));
+      case IPP_CREATE_PRINTER_SUBSCRIPTION :
+	  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+                       NULL, uri);
+          ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
+                       "notify-pull-method", NULL, "ippget");
+          ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
+                       "notify-events", NULL, "job-state-changed");
+          ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
+                        "notify-lease-duration", 60);
+	  response = cupsDoRequest(http, request, "/");
+
+	  if ((attr = ippFindAttribute(response, "notify-subscription-id", IPP_TAG_INTEGER)) != NULL)
+	    sub_id = ippGetInteger(attr, 0);
           break;
 
-      case IPP_PRINT_JOB :
+      case IPP_GET_JOBS :
+      case IPP_GET_PRINTER_ATTRIBUTES :
+      case IPP_GET_SUBSCRIPTIONS :
 	  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
-                       NULL, "ipp://localhost/printers/test");
-	  ippDelete(cupsDoFileRequest(http, request, "/printers/test",
-	                              "../data/testprint.ps"));
+                       NULL, op == IPP_GET_JOBS ? "ipp://localhost/printers/" : uri);
+
+      default :
+	  response = cupsDoRequest(http, request, "/");
           break;
     }
 
@@ -324,11 +585,15 @@ do_test(const char        *server,	/* I - Server to use */
               0.000001 * (end.tv_usec - start.tv_usec);
     elapsed += reqtime;
 
+    ippDelete(response);
+
     switch (cupsLastError())
     {
       case IPP_OK :
       case IPP_NOT_FOUND :
-          if (verbose)
+          error = 0;
+
+          if (test->verbose > 1)
 	  {
 	    printf("succeeded: %s (%.6f)\n", cupsLastErrorString(), reqtime);
 	    fflush(stdout);
@@ -336,25 +601,382 @@ do_test(const char        *server,	/* I - Server to use */
           break;
 
       default :
-          if (!verbose)
-	    printf("testspeed(%d): %s ", (int)getpid(),
-	           ippOpString(ops[i & 3]));
+          error = 1;
+
+          if (test->verbose < 2)
+	    printf("testspeed(%d): %s ", (int)getpid(), ippOpString(op));
 
 	  printf("failed: %s\n", cupsLastErrorString());
-          httpClose(http);
-	  return (1);
+          break;
+    }
+
+    add_sample(find_stats(test, op), reqtime, error);
+
+    if (sub_id > 0)
+    {
+     /*
+      * Cancel the subscription we just created so they don't pile up...
+      */
+
+      request = ippNewRequest(IPP_CANCEL_SUBSCRIPTION);
+      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+                   NULL, uri);
+      ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
+                    "notify-subscription-id", sub_id);
+
+      gettimeofday(&start, NULL);
+      ippDelete(cupsDoRequest(http, request, "/"));
+      gettimeofday(&end, NULL);
+
+      reqtime = (end.tv_sec - start.tv_sec) +
+                0.000001 * (end.tv_usec - start.tv_usec);
+      elapsed += reqtime;
+
+      add_sample(find_stats(test, IPP_CANCEL_SUBSCRIPTION), reqtime, cupsLastError() > IPP_OK_CONFLICT);
     }
   }
 
   httpClose(http);
 
-  printf("testspeed(%d): %d requests in %.1fs (%.3fs/r, %.1fr/s)\n",
-         (int)getpid(), i, elapsed, elapsed / i, i / elapsed);
+  if (test->verbose)
+    printf("testspeed(%d): %d requests in %.1fs (%.3fs/r, %.1fr/s)\n",
+           (int)getpid(), i, elapsed, elapsed / i, i / elapsed);
 
   return (0);
 }
 
 
+/*
+ * 'find_stats()' - Find the statistics for an operation.
+ */
+
+static speed_stats_t *			/* O - Operation statistics */
+find_stats(speed_test_t *test,		/* I - Test settings */
+           ipp_op_t     op)		/* I - Operation code */
+{
+  int	i;				/* Looping var */
+
+
+  for (i = 0; i < test->num_stats; i ++)
+    if (test->stats[i].op == op)
+      return (test->stats + i);
+
+  return (NULL);
+}
+
+
+/*
+ * 'get_percentile()' - Get a latency percentile from the histogram.
+ */
+
+static double				/* O - Time in seconds */
+get_percentile(speed_stats_t *stats,	/* I - Operation statistics */
+               double        percentile)/* I - Percentile (0.0 to 1.0) */
+{
+  int		i;			/* Looping var */
+  unsigned	count,			/* Running count */
+		target;			/* Target count */
+
+
+  if (stats->count == 0)
+    return (0.0);
+
+  if ((target = (unsigned)(percentile * stats->count + 0.5)) < 1)
+    target = 1;
+
+  for (i = 0, count = 0; i < SPEED_BUCKETS; i ++)
+  {
+    count += stats->buckets[i];
+
+    if (count >= target)
+    {
+      double value = bucket_value(i);	/* Time for this bucket */
+
+      return (value < stats->max ? value : stats->max);
+    }
+  }
+
+  return (stats->max);
+}
+
+
+/*
+ * 'make_file()' - Generate a plain text print file of the given size.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+make_file(char   *filename,		/* I - Filename buffer */
+          size_t filesize,		/* I - Size of filename buffer */
+          long   size)			/* I - Size of file in bytes */
+{
+  cups_file_t	*fp;			/* Print file */
+  char		line[128];		/* Line of text */
+  long		bytes;			/* Bytes written */
+  size_t	len;			/* Length of line */
+
+
+  if ((fp = cupsTempFile2(filename, (int)filesize)) == NULL)
+  {
+    printf("testspeed: Unable to create print file: %s\n", strerror(errno));
+    return (0);
+  }
+
+  for (bytes = 0; bytes < size; bytes += (long)len)
+  {
+    snprintf(line, sizeof(line), "%08ld The quick brown fox jumps over the lazy dog. 0123456789 ABCDEFGHIJ\n", bytes);
+
+    if ((len = strlen(line)) > (size_t)(size - bytes))
+    {
+      len = (size_t)(size - bytes);
+      line[len - 1] = '\n';
+    }
+
+    cupsFileWrite(fp, line, len);
+  }
+
+  cupsFileClose(fp);
+
+  return (1);
+}
+
+
+/*
+ * 'merge_stats()' - Merge the statistics for an operation.
+ */
+
+static void
+merge_stats(speed_stats_t *to,		/* I - Destination statistics */
+            speed_stats_t *from)	/* I - Source statistics */
+{
+  int	i;				/* Looping var */
+
+
+  to->count  += from->count;
+  to->errors += from->errors;
+  to->total  += from->total;
+
+  if (from->max > to->max)
+    to->max = from->max;
+
+  for (i = 0; i < SPEED_BUCKETS; i ++)
+    to->buckets[i] += from->buckets[i];
+}
+
+
+/*
+ * 'parse_mix()' - Parse a list of operations with optional weights.
+ *
+ * The mix is a comma-delimited list of "operation[:weight]" values, for
+ * example "Print-Job:1,Get-Jobs:10,CUPS-Get-Printers:10".
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+parse_mix(speed_test_t *test,		/* I - Test settings */
+          const char   *mix)		/* I - Operation mix */
+{
+  int		i,			/* Looping var */
+		best,			/* Next operation in schedule */
+		num_ops = 0,		/* Number of operations in mix */
+		total = 0,		/* Total weight */
+		weights[SPEED_MAX_OPS],	/* Weight of each operation */
+		current[SPEED_MAX_OPS];	/* Current weight of each operation */
+  ipp_op_t	op,			/* Operation code */
+		ops[SPEED_MAX_OPS];	/* Operations in mix */
+  char		name[256],		/* Operation name */
+		*nameptr;		/* Pointer into name */
+  long		weight;			/* Weight of operation */
+
+
+  while (*mix)
+  {
+    for (nameptr = name; *mix && *mix != ',' && *mix != ':'; mix ++)
+      if (nameptr < (name + sizeof(name) - 1))
+        *nameptr++ = *mix;
+
+    *nameptr = '\0';
+    weight   = 1;
+
+    if (*mix == ':')
+    {
+      weight = strtol(mix + 1, &nameptr, 10);
+      mix    = nameptr;
+    }
+
+    if (*mix == ',')
+      mix ++;
+
+    if ((op = ippOpValue(name)) == IPP_OP_CUPS_INVALID)
+    {
+      printf("testspeed: Unknown operation \"%s\".\n", name);
+      return (0);
+    }
+
+    if (weight < 1 || (total + weight) > (long)(sizeof(test->schedule) / sizeof(test->schedule[0])))
+    {
+      printf("testspeed: Bad weight for \"%s\".\n", name);
+      return (0);
+    }
+
+    for (i = 0; i < num_ops; i ++)
+      if (ops[i] == op)
+        break;
+
+    if (i >= num_ops)
+    {
+      if (num_ops >= (SPEED_MAX_OPS - 1))
+      {
+        puts("testspeed: Too many operations.");
+        return (0);
+      }
+
+      ops[num_ops]     = op;
+      weights[num_ops] = 0;
+      current[num_ops] = 0;
+      num_ops ++;
+    }
+
+    weights[i] += (int)weight;
+    total      += (int)weight;
+  }
+
+  if (total == 0)
+  {
+    puts("testspeed: No operations to test.");
+    return (0);
+  }
+
+ /*
+  * Build a smooth weighted round-robin schedule so that each operation is
+  * spread over the schedule rather than sent back-to-back...
+  */
+
+  for (test->num_schedule = 0; test->num_schedule < total; test->num_schedule ++)
+  {
+    for (i = 0, best = 0; i < num_ops; i ++)
+    {
+      current[i] += weights[i];
+
+      if (current[i] > current[best])
+        best = i;
+    }
+
+    current[best] -= total;
+    test->schedule[test->num_schedule] = ops[best];
+  }
+
+ /*
+  * Subscriptions are cancelled right after they are created, so track the
+  * Cancel-Subscription requests as well...
+  */
+
+  for (i = 0; i < num_ops; i ++)
+    if (ops[i] == IPP_CREATE_PRINTER_SUBSCRIPTION)
+      break;
+
+  if (i < num_ops)
+  {
+    for (i = 0; i < num_ops; i ++)
+      if (ops[i] == IPP_CANCEL_SUBSCRIPTION)
+        break;
+
+    if (i >= num_ops)
+      ops[num_ops ++] = IPP_CANCEL_SUBSCRIPTION;
+  }
+
+  if ((test->stats = calloc((size_t)num_ops, sizeof(speed_stats_t))) == NULL)
+  {
+    perror("testspeed: Unable to allocate memory");
+    return (0);
+  }
+
+  test->num_stats = num_ops;
+
+  for (i = 0; i < num_ops; i ++)
+    test->stats[i].op = ops[i];
+
+  return (1);
+}
+
+
+/*
+ * 'print_report()' - Print the throughput and latency report.
+ */
+
+static void
+print_report(speed_test_t   *test,	/* I - Test settings */
+             speed_format_t format,	/* I - Report format */
+             int            clients,	/* I - Number of clients */
+             double         elapsed)	/* I - Elapsed time in seconds */
+{
+  int		i;			/* Looping var */
+  speed_stats_t	total,			/* Statistics for all operations */
+		*stats;			/* Current statistics */
+  const char	*name;			/* Operation name */
+
+
+  memset(&total, 0, sizeof(total));
+
+  for (i = 0; i < test->num_stats; i ++)
+    merge_stats(&total, test->stats + i);
+
+  if (format == SPEED_FORMAT_JSON)
+    printf("{\n  \"clients\": %d,\n  \"requests\": %d,\n  \"errors\": %d,\n"
+           "  \"elapsed\": %.3f,\n  \"throughput\": %.1f,\n"
+           "  \"operations\": [\n", clients, total.count, total.errors,
+           elapsed, elapsed > 0.0 ? total.count / elapsed : 0.0);
+  else if (format == SPEED_FORMAT_CSV)
+    puts("operation,requests,errors,mean-ms,p50-ms,p99-ms,p999-ms,max-ms");
+  else
+    printf("testspeed: %d clients, %d requests in %.1fs (%.3fs/r, %.1fr/s)\n\n"
+           "%-32s %9s %7s %9s %9s %9s %9s %9s\n", clients, total.count,
+           elapsed, total.count ? elapsed / total.count : 0.0,
+           elapsed > 0.0 ? total.count / elapsed : 0.0, "Operation",
+           "Requests", "Errors", "mean ms", "p50 ms", "p99 ms", "p99.9 ms",
+           "max ms");
+
+  for (i = 0; i <= test->num_stats; i ++)
+  {
+    if (i < test->num_stats)
+    {
+      stats = test->stats + i;
+      name  = ippOpString(stats->op);
+    }
+    else
+    {
+      stats = &total;
+      name  = "Total";
+    }
+
+    if (format == SPEED_FORMAT_JSON)
+    {
+      if (i == test->num_stats)
+        break;
+
+      printf("    { \"operation\": \"%s\", \"requests\": %d, \"errors\": %d, "
+             "\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, "
+             "\"max\": %.3f }%s\n", name, stats->count, stats->errors,
+             stats->count ? 1000.0 * stats->total / stats->count : 0.0,
+             1000.0 * get_percentile(stats, 0.5),
+             1000.0 * get_percentile(stats, 0.99),
+             1000.0 * get_percentile(stats, 0.999), 1000.0 * stats->max,
+             i < (test->num_stats - 1) ? "," : "");
+    }
+    else
+      printf(format == SPEED_FORMAT_CSV ?
+                 "%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n" :
+                 "%-32s %9d %7d %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+             name, stats->count, stats->errors,
+             stats->count ? 1000.0 * stats->total / stats->count : 0.0,
+             1000.0 * get_percentile(stats, 0.5),
+             1000.0 * get_percentile(stats, 0.99),
+             1000.0 * get_percentile(stats, 0.999), 1000.0 * stats->max);
+  }
+
+  if (format == SPEED_FORMAT_JSON)
+    puts("  ]\n}");
+}
+
+
 /*
  * 'usage()' - Show program usage...
  */
@@ -362,7 +984,17 @@ do_test(const char        *server,	/* I - Server to use */
 static void
 usage(void)
 {
-  puts("Usage: testspeed [-c children] [-h] [-o operation] [-r requests] [-v] "
-       "[-E] hostname[:port]");
+  puts("Usage: testspeed [options] [hostname[:port]]");
+  puts("Options:");
+  puts("  -c children        Number of concurrent clients (default 5)");
+  puts("  -E                 Require encryption");
+  puts("  -f filename        Print file for Print-Job");
+  puts("  -m op[:weight],... Mix of operations to send");
+  puts("  -o operation       Send only the named operation");
+  puts("  -O text|csv|json   Report format");
+  puts("  -p printer         Printer for jobs and subscriptions (default test)");
+  puts("  -r requests        Number of requests per client (default 100)");
+  puts("  -s size[k|m]       Print a generated text file of the given size");
+  puts("  -v                 Be verbose (twice to show each request)");
   exit(0);
 }
@@ -42,6 +42,7 @@ typedef struct _mime_filebuf_s		/**** File buffer for MIME typing ****/
  * Local functions...
  */
 
+static int	mime_compare_ftypes(mime_type_t *t0, mime_type_t *t1);
 static int	mime_compare_types(mime_type_t *t0, mime_type_t *t1);
 static int	mime_check_rules(const char *filename, _mime_filebuf_t *fb,
 		                 mime_magic_t *rules);
@@ -136,6 +137,14 @@ mimeAddType(mime_t     *mime,		/* I - MIME database */
 
   cupsArrayAdd(mime->types, temp);
 
+ /*
+  * Discard the typing order so that mimeFileType rebuilds it with the new
+  * type...
+  */
+
+  cupsArrayDelete(mime->ftypes);
+  mime->ftypes = NULL;
+
   DEBUG_printf(("1mimeAddType: Returning %p (new).", temp));
   return (temp);
 }
@@ -525,6 +534,7 @@ mimeAddTypeRule(mime_type_t *mt,	/* I - Type to add to */
 	    temp->length = MIME_MAX_BUFFER;
 	    if (regcomp(&(temp->value.rev), value[1], REG_NOSUB | REG_EXTENDED))
 	      return (-1);
+	    temp->pattern = strdup(value[1]);
 	    break;
 	case MIME_MAGIC_STRING :
 	case MIME_MAGIC_ISTRING :
@@ -590,8 +600,7 @@ mimeFileType(mime_t     *mime,		/* I - MIME database */
 {
   _mime_filebuf_t	fb;		/* File buffer */
   const char		*base;		/* Base filename of file */
-  mime_type_t		*type,		/* File type */
-			*best;		/* Best match */
+  mime_type_t		*type;		/* File type */
 
 
   DEBUG_printf(("mimeFileType(mime=%p, pathname=\"%s\", filename=\"%s\", "
@@ -654,17 +663,25 @@ mimeFileType(mime_t     *mime,		/* I - MIME database */
     base = pathname;
 
  /*
-  * Then check it against all known types...
+  * Then check it against all known types, highest priority first so that the
+  * first match is the best match...
   */
 
-  for (type = (mime_type_t *)cupsArrayFirst(mime->types), best = NULL;
+  if (!mime->ftypes)
+  {
+    mime->ftypes = cupsArrayNew((cups_array_func_t)mime_compare_ftypes, NULL);
+
+    for (type = (mime_type_t *)cupsArrayFirst(mime->types);
+         type;
+	 type = (mime_type_t *)cupsArrayNext(mime->types))
+      cupsArrayAdd(mime->ftypes, type);
+  }
+
+  for (type = (mime_type_t *)cupsArrayFirst(mime->ftypes);
        type;
-       type = (mime_type_t *)cupsArrayNext(mime->types))
+       type = (mime_type_t *)cupsArrayNext(mime->ftypes))
     if (mime_check_rules(base, &fb, type->rules))
-    {
-      if (!best || type->priority > best->priority)
-        best = type;
-    }
+      break;
 
  /*
   * Finally, close the file and return a match (if any)...
@@ -678,9 +695,9 @@ mimeFileType(mime_t     *mime,		/* I - MIME database */
 
   cupsFileClose(fb.fp);
 
-  DEBUG_printf(("1mimeFileType: Returning %p(%s/%s).", best,
-                best ? best->super : "???", best ? best->type : "???"));
-  return (best);
+  DEBUG_printf(("1mimeFileType: Returning %p(%s/%s).", type,
+                type ? type->super : "???", type ? type->type : "???"));
+  return (type);
 }
 
 
@@ -723,6 +740,21 @@ mimeType(mime_t     *mime,		/* I - MIME database */
 }
 
 
+/*
+ * 'mime_compare_ftypes()' - Compare two MIME types by priority and name.
+ */
+
+static int				/* O - Result of comparison */
+mime_compare_ftypes(mime_type_t *t0,	/* I - First type */
+                    mime_type_t *t1)	/* I - Second type */
+{
+  if (t0->priority != t1->priority)
+    return (t1->priority - t0->priority);
+  else
+    return (mime_compare_types(t0, t1));
+}
+
+
 /*
  * 'mime_compare_types()' - Compare two MIME super/type names.
  */
@@ -15,12 +15,24 @@
 #include <cups/cups-private.h>
 
 
+/*
+ * Local globals...
+ */
+
+static ipp_t	*printers_response = NULL;
+					/* Cached CUPS-Get-Printers response */
+static ipp_t	*jobs_response = NULL;	/* Cached Get-Jobs response for active jobs */
+
+
 /*
  * Local functions...
  */
 
 static void	check_dest(const char *command, const char *name,
 		           int *num_dests, cups_dest_t **dests);
+static void	flush_cache(void);
+static int	get_printer_job(const char *printer);
+static ipp_t	*get_printers(void);
 static int	match_list(const char *list, const char *name);
 static int	show_accepting(const char *printers, int num_dests,
 		               cups_dest_t *dests);
@@ -86,6 +98,7 @@ main(int  argc,				/* I - Number of command-line arguments */
 	  case 'E' : /* Encrypt */
 #ifdef HAVE_SSL
 	      cupsSetEncryption(HTTP_ENCRYPT_REQUIRED);
+	      flush_cache();
 #else
 	      _cupsLangPrintf(stderr,
 			      _("%s: Sorry, no encryption support."),
@@ -132,6 +145,7 @@ main(int  argc,				/* I - Number of command-line arguments */
 
 		cupsSetUser(argv[i]);
 	      }
+	      flush_cache();
 	      break;
 
 	  case 'W' : /* Show which jobs? */
@@ -307,6 +321,7 @@ main(int  argc,				/* I - Number of command-line arguments */
 
 		cupsSetServer(argv[i]);
 	      }
+	      flush_cache();
 	      break;
 
 	  case 'l' : /* Long status or long job status */
@@ -614,51 +629,118 @@ check_dest(const char  *command,	/* I  - Command name */
 
 
 /*
- * 'match_list()' - Match a name from a list of comma or space-separated names.
+ * 'flush_cache()' - Flush the cached printer and job lists.
+ *
+ * The cached lists are only valid for the current server, user, and
+ * encryption settings.
  */
 
-static int				/* O - 1 on match, 0 on no match */
-match_list(const char *list,		/* I - List of names */
-           const char *name)		/* I - Name to find */
+static void
+flush_cache(void)
 {
-  const char	*nameptr;		/* Pointer into name */
+  ippDelete(printers_response);
+  printers_response = NULL;
 
+  ippDelete(jobs_response);
+  jobs_response = NULL;
+}
 
- /*
-  * An empty list always matches...
-  */
 
-  if (!list || !*list)
-    return (1);
+/*
+ * 'get_printer_job()' - Get the active job for a printer.
+ *
+ * The first call gets the processing jobs for all printers with a single
+ * Get-Jobs request.
+ */
 
-  if (!name)
-    return (0);
+static int				/* O - Job ID or 0 if none */
+get_printer_job(const char *printer)	/* I - Printer name */
+{
+  ipp_t		*request;		/* IPP Request */
+  ipp_attribute_t *attr;		/* Current attribute */
+  int		jobid;			/* Job ID */
+  ipp_jstate_t	jobstate;		/* Job state */
+  const char	*jobdest;		/* Job destination name */
+  static const char *jattrs[] =		/* Attributes we need for jobs... */
+		{
+		  "job-id",
+		  "job-printer-uri",
+		  "job-state"
+		};
 
-  while (*list)
+
+  if (!jobs_response)
   {
    /*
-    * Skip leading whitespace and commas...
+    * Build an IPP_GET_JOBS request, which requires the following
+    * attributes:
+    *
+    *    attributes-charset
+    *    attributes-natural-language
+    *    printer-uri
+    *    requested-attributes
+    *    which-jobs
     */
 
-    while (isspace(*list & 255) || *list == ',')
-      list ++;
+    request = ippNewRequest(IPP_GET_JOBS);
 
-    if (!*list)
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri",
+                 NULL, "ipp://localhost/");
+
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+                  "requested-attributes", sizeof(jattrs) / sizeof(jattrs[0]),
+		  NULL, jattrs);
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                 "requesting-user-name", NULL, cupsUser());
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "which-jobs",
+                 NULL, "processing");
+
+    if ((jobs_response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/")) == NULL)
+      return (0);
+  }
+
+ /*
+  * Find the processing job for this printer...
+  */
+
+  for (attr = jobs_response->attrs; attr; attr = attr->next)
+  {
+    while (attr && attr->group_tag != IPP_TAG_JOB)
+      attr = attr->next;
+
+    if (!attr)
       break;
 
-   /*
-    * Compare names...
-    */
+    jobid    = 0;
+    jobstate = IPP_JOB_PENDING;
+    jobdest  = NULL;
 
-    for (nameptr = name;
-	 *nameptr && *list && tolower(*nameptr & 255) == tolower(*list & 255);
-	 nameptr ++, list ++);
+    while (attr && attr->group_tag == IPP_TAG_JOB)
+    {
+      if (!strcmp(attr->name, "job-id") &&
+          attr->value_tag == IPP_TAG_INTEGER)
+	jobid = attr->values[0].integer;
+      else if (!strcmp(attr->name, "job-state") &&
+               attr->value_tag == IPP_TAG_ENUM)
+	jobstate = (ipp_jstate_t)attr->values[0].integer;
+      else if (!strcmp(attr->name, "job-printer-uri") &&
+               attr->value_tag == IPP_TAG_URI)
+      {
+        if ((jobdest = strrchr(attr->values[0].string.text, '/')) != NULL)
+	  jobdest ++;
+      }
 
-    if (!*nameptr && (!*list || *list == ',' || isspace(*list & 255)))
-      return (1);
+      attr = attr->next;
+    }
 
-    while (*list && !isspace(*list & 255) && *list != ',')
-      list ++;
+    if (jobstate == IPP_JOB_PROCESSING && jobdest &&
+        !_cups_strcasecmp(jobdest, printer))
+      return (jobid);
+
+    if (!attr)
+      break;
   }
 
   return (0);
@@ -666,34 +748,40 @@ match_list(const char *list,		/* I - List of names */
 
 
 /*
- * 'show_accepting()' - Show acceptance status.
+ * 'get_printers()' - Get the list of printers and classes.
+ *
+ * A single CUPS-Get-Printers request with the attributes needed by all of the
+ * show_* functions is sent, and the response is reused for the rest of the
+ * command-line.
  */
 
-static int				/* O - 0 on success, 1 on fail */
-show_accepting(const char  *printers,	/* I - Destinations */
-               int         num_dests,	/* I - Number of user-defined dests */
-	       cups_dest_t *dests)	/* I - User-defined destinations */
+static ipp_t *				/* O - Response or NULL on error */
+get_printers(void)
 {
-  int		i;			/* Looping var */
   ipp_t		*request,		/* IPP Request */
 		*response;		/* IPP Response */
-  ipp_attribute_t *attr;		/* Current attribute */
-  const char	*printer,		/* Printer name */
-		*message;		/* Printer device URI */
-  int		accepting;		/* Accepting requests? */
-  time_t	ptime;			/* Printer state time */
-  char		printer_state_time[255];/* Printer state time */
   static const char *pattrs[] =		/* Attributes we need for printers... */
 		{
+		  "device-uri",
+		  "member-names",
+		  "printer-info",
+		  "printer-is-accepting-jobs",
+		  "printer-location",
+		  "printer-make-and-model",
 		  "printer-name",
+		  "printer-state",
 		  "printer-state-change-time",
 		  "printer-state-message",
-		  "printer-is-accepting-jobs"
+		  "printer-state-reasons",
+		  "printer-type",
+		  "printer-uri-supported",
+		  "requesting-user-name-allowed",
+		  "requesting-user-name-denied"
 		};
 
 
-  if (printers != NULL && !strcmp(printers, "all"))
-    printers = NULL;
+  if (printers_response)
+    return (printers_response);
 
  /*
   * Build a CUPS_GET_PRINTERS request, which requires the following
@@ -727,116 +815,196 @@ show_accepting(const char  *printers,	/* I - Destinations */
 		    _("%s: Error - add '/version=1.1' to server name."),
 		    "lpstat");
     ippDelete(response);
-    return (1);
+    return (NULL);
   }
   else if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
   {
     _cupsLangPrintf(stderr, "lpstat: %s", cupsLastErrorString());
     ippDelete(response);
-    return (1);
+    return (NULL);
   }
 
-  if (response)
+  return (printers_response = response);
+}
+
+
+/*
+ * 'match_list()' - Match a name from a list of comma or space-separated names.
+ */
+
+static int				/* O - 1 on match, 0 on no match */
+match_list(const char *list,		/* I - List of names */
+           const char *name)		/* I - Name to find */
+{
+  const char	*nameptr;		/* Pointer into name */
+
+
+ /*
+  * An empty list always matches...
+  */
+
+  if (!list || !*list)
+    return (1);
+
+  if (!name)
+    return (0);
+
+  while (*list)
   {
    /*
-    * Loop through the printers returned in the list and display
-    * their devices...
+    * Skip leading whitespace and commas...
     */
 
-    for (attr = response->attrs; attr != NULL; attr = attr->next)
-    {
-     /*
-      * Skip leading attributes until we hit a printer...
-      */
+    while (isspace(*list & 255) || *list == ',')
+      list ++;
 
-      while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
-        attr = attr->next;
+    if (!*list)
+      break;
 
-      if (attr == NULL)
-        break;
+   /*
+    * Compare names...
+    */
 
-     /*
-      * Pull the needed attributes from this printer...
-      */
+    for (nameptr = name;
+	 *nameptr && *list && tolower(*nameptr & 255) == tolower(*list & 255);
+	 nameptr ++, list ++);
 
-      printer   = NULL;
-      message   = NULL;
-      accepting = 1;
-      ptime     = 0;
+    if (!*nameptr && (!*list || *list == ',' || isspace(*list & 255)))
+      return (1);
 
-      while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
-      {
-        if (!strcmp(attr->name, "printer-name") &&
-	    attr->value_tag == IPP_TAG_NAME)
-	  printer = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-state-change-time") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  ptime = (time_t)attr->values[0].integer;
-        else if (!strcmp(attr->name, "printer-state-message") &&
-	         attr->value_tag == IPP_TAG_TEXT)
-	  message = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-is-accepting-jobs") &&
-	         attr->value_tag == IPP_TAG_BOOLEAN)
-	  accepting = attr->values[0].boolean;
+    while (*list && !isspace(*list & 255) && *list != ',')
+      list ++;
+  }
 
-        attr = attr->next;
-      }
+  return (0);
+}
 
-     /*
-      * See if we have everything needed...
-      */
 
-      if (printer == NULL)
-      {
-        if (attr == NULL)
-	  break;
-	else
-          continue;
-      }
+/*
+ * 'show_accepting()' - Show acceptance status.
+ */
 
-     /*
-      * Display the printer entry if needed...
-      */
+static int				/* O - 0 on success, 1 on fail */
+show_accepting(const char  *printers,	/* I - Destinations */
+               int         num_dests,	/* I - Number of user-defined dests */
+	       cups_dest_t *dests)	/* I - User-defined destinations */
+{
+  int		i;			/* Looping var */
+  ipp_t		*response;		/* IPP Response */
+  ipp_attribute_t *attr;		/* Current attribute */
+  const char	*printer,		/* Printer name */
+		*message;		/* Printer device URI */
+  int		accepting;		/* Accepting requests? */
+  time_t	ptime;			/* Printer state time */
+  char		printer_state_time[255];/* Printer state time */
+
+
+  if (printers != NULL && !strcmp(printers, "all"))
+    printers = NULL;
+
+ /*
+  * Get the list of printers and classes...
+  */
+
+  if ((response = get_printers()) == NULL)
+    return (1);
+
+ /*
+  * Loop through the printers returned in the list and display
+  * their devices...
+  */
+
+  for (attr = response->attrs; attr != NULL; attr = attr->next)
+  {
+   /*
+    * Skip leading attributes until we hit a printer...
+    */
+
+    while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
+      attr = attr->next;
+
+    if (attr == NULL)
+      break;
 
-      if (match_list(printers, printer))
+   /*
+    * Pull the needed attributes from this printer...
+    */
+
+    printer   = NULL;
+    message   = NULL;
+    accepting = 1;
+    ptime     = 0;
+
+    while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
+    {
+      if (!strcmp(attr->name, "printer-name") &&
+	  attr->value_tag == IPP_TAG_NAME)
+	printer = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-state-change-time") &&
+	       attr->value_tag == IPP_TAG_INTEGER)
+	ptime = (time_t)attr->values[0].integer;
+      else if (!strcmp(attr->name, "printer-state-message") &&
+	       attr->value_tag == IPP_TAG_TEXT)
+	message = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-is-accepting-jobs") &&
+	       attr->value_tag == IPP_TAG_BOOLEAN)
+	accepting = attr->values[0].boolean;
+
+      attr = attr->next;
+    }
+
+   /*
+    * See if we have everything needed...
+    */
+
+    if (printer == NULL)
+    {
+      if (attr == NULL)
+	break;
+      else
+	continue;
+    }
+
+   /*
+    * Display the printer entry if needed...
+    */
+
+    if (match_list(printers, printer))
+    {
+      _cupsStrDate(printer_state_time, sizeof(printer_state_time), ptime);
+
+      if (accepting)
+	_cupsLangPrintf(stdout, _("%s accepting requests since %s"),
+			printer, printer_state_time);
+      else
       {
-        _cupsStrDate(printer_state_time, sizeof(printer_state_time), ptime);
+	_cupsLangPrintf(stdout, _("%s not accepting requests since %s -"),
+			printer, printer_state_time);
+	_cupsLangPrintf(stdout, _("\t%s"),
+			(message == NULL || !*message) ?
+			    "reason unknown" : message);
+      }
 
-        if (accepting)
-	  _cupsLangPrintf(stdout, _("%s accepting requests since %s"),
-			  printer, printer_state_time);
-	else
+      for (i = 0; i < num_dests; i ++)
+	if (!_cups_strcasecmp(dests[i].name, printer) && dests[i].instance)
 	{
-	  _cupsLangPrintf(stdout, _("%s not accepting requests since %s -"),
-			  printer, printer_state_time);
-	  _cupsLangPrintf(stdout, _("\t%s"),
-			  (message == NULL || !*message) ?
-			      "reason unknown" : message);
-        }
-
-        for (i = 0; i < num_dests; i ++)
-	  if (!_cups_strcasecmp(dests[i].name, printer) && dests[i].instance)
+	  if (accepting)
+	    _cupsLangPrintf(stdout, _("%s/%s accepting requests since %s"),
+			    printer, dests[i].instance, printer_state_time);
+	  else
 	  {
-            if (accepting)
-	      _cupsLangPrintf(stdout, _("%s/%s accepting requests since %s"),
-			      printer, dests[i].instance, printer_state_time);
-	    else
-	    {
-	      _cupsLangPrintf(stdout,
-	                      _("%s/%s not accepting requests since %s -"),
-			      printer, dests[i].instance, printer_state_time);
-	      _cupsLangPrintf(stdout, _("\t%s"),
-	        	      (message == NULL || !*message) ?
-			          "reason unknown" : message);
-            }
+	    _cupsLangPrintf(stdout,
+			    _("%s/%s not accepting requests since %s -"),
+			    printer, dests[i].instance, printer_state_time);
+	    _cupsLangPrintf(stdout, _("\t%s"),
+			    (message == NULL || !*message) ?
+				"reason unknown" : message);
 	  }
-      }
-
-      if (attr == NULL)
-        break;
+	}
     }
 
-    ippDelete(response);
+    if (attr == NULL)
+      break;
   }
 
   return (0);
@@ -859,6 +1027,7 @@ show_classes(const char *dests)		/* I - Destinations */
   const char	*printer,		/* Printer class name */
 		*printer_uri;		/* Printer class URI */
   ipp_attribute_t *members;		/* Printer members */
+  cups_ptype_t	ptype;			/* Printer type */
   char		method[HTTP_MAX_URI],	/* Request method */
 		username[HTTP_MAX_URI],	/* Username:password */
 		server[HTTP_MAX_URI],	/* Server name */
@@ -876,181 +1045,152 @@ show_classes(const char *dests)		/* I - Destinations */
     dests = NULL;
 
  /*
-  * Build a CUPS_GET_CLASSES request, which requires the following
-  * attributes:
-  *
-  *    attributes-charset
-  *    attributes-natural-language
-  *    requested-attributes
-  *    requesting-user-name
+  * Get the list of printers and classes...
   */
 
-  request = ippNewRequest(CUPS_GET_CLASSES);
-
-  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                "requested-attributes", sizeof(cattrs) / sizeof(cattrs[0]),
-		NULL, cattrs);
-
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name",
-               NULL, cupsUser());
+  if ((response = get_printers()) == NULL)
+    return (1);
 
  /*
-  * Do the request and get back a response...
+  * Loop through the classes returned in the list and display
+  * their members...
   */
 
-  response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
-
-  if (cupsLastError() == IPP_STATUS_ERROR_BAD_REQUEST ||
-      cupsLastError() == IPP_STATUS_ERROR_VERSION_NOT_SUPPORTED)
-  {
-    _cupsLangPrintf(stderr,
-		    _("%s: Error - add '/version=1.1' to server name."),
-		    "lpstat");
-    ippDelete(response);
-    return (1);
-  }
-  else if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
+  for (attr = response->attrs; attr != NULL; attr = attr->next)
   {
-    _cupsLangPrintf(stderr, "lpstat: %s", cupsLastErrorString());
-    ippDelete(response);
-    return (1);
-  }
+   /*
+    * Skip leading attributes until we hit a job...
+    */
 
-  if (response)
-  {
-    if (response->request.status.status_code > IPP_OK_CONFLICT)
-    {
-      _cupsLangPrintf(stderr, "lpstat: %s", cupsLastErrorString());
-      ippDelete(response);
-      return (1);
-    }
+    while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
+      attr = attr->next;
+
+    if (attr == NULL)
+      break;
 
    /*
-    * Loop through the printers returned in the list and display
-    * their devices...
+    * Pull the needed attributes from this job...
     */
 
-    for (attr = response->attrs; attr != NULL; attr = attr->next)
+    printer     = NULL;
+    printer_uri = NULL;
+    members     = NULL;
+    ptype       = CUPS_PRINTER_LOCAL;
+
+    while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
     {
-     /*
-      * Skip leading attributes until we hit a job...
-      */
+      if (!strcmp(attr->name, "printer-name") &&
+	  attr->value_tag == IPP_TAG_NAME)
+	printer = attr->values[0].string.text;
 
-      while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
-        attr = attr->next;
+      if (!strcmp(attr->name, "printer-type") &&
+	  attr->value_tag == IPP_TAG_ENUM)
+	ptype = (cups_ptype_t)attr->values[0].integer;
 
-      if (attr == NULL)
-        break;
+      if (!strcmp(attr->name, "printer-uri-supported") &&
+	  attr->value_tag == IPP_TAG_URI)
+	printer_uri = attr->values[0].string.text;
 
-     /*
-      * Pull the needed attributes from this job...
-      */
+      if (!strcmp(attr->name, "member-names") &&
+	  attr->value_tag == IPP_TAG_NAME)
+	members = attr;
 
-      printer     = NULL;
-      printer_uri = NULL;
-      members     = NULL;
+      attr = attr->next;
+    }
 
-      while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
-      {
-        if (!strcmp(attr->name, "printer-name") &&
-	    attr->value_tag == IPP_TAG_NAME)
-	  printer = attr->values[0].string.text;
+   /*
+    * Skip printers, which share the list with classes...
+    */
+
+    if (!(ptype & CUPS_PRINTER_CLASS))
+    {
+      if (attr == NULL)
+	break;
+      else
+	continue;
+    }
 
-        if (!strcmp(attr->name, "printer-uri-supported") &&
-	    attr->value_tag == IPP_TAG_URI)
-	  printer_uri = attr->values[0].string.text;
+   /*
+    * If this is a remote class, grab the class info from the
+    * remote server...
+    */
 
-        if (!strcmp(attr->name, "member-names") &&
-	    attr->value_tag == IPP_TAG_NAME)
-	  members = attr;
+    response2 = NULL;
+    if (members == NULL && printer_uri != NULL)
+    {
+      httpSeparateURI(HTTP_URI_CODING_ALL, printer_uri, method, sizeof(method),
+		      username, sizeof(username), server, sizeof(server),
+		      &port, resource, sizeof(resource));
 
-        attr = attr->next;
-      }
+      if (!_cups_strcasecmp(server, cupsServer()))
+	http2 = CUPS_HTTP_DEFAULT;
+      else
+	http2 = httpConnectEncrypt(server, port, cupsEncryption());
 
      /*
-      * If this is a remote class, grab the class info from the
-      * remote server...
+      * Build an IPP_GET_PRINTER_ATTRIBUTES request, which requires the
+      * following attributes:
+      *
+      *    attributes-charset
+      *    attributes-natural-language
+      *    printer-uri
+      *    requested-attributes
       */
 
-      response2 = NULL;
-      if (members == NULL && printer_uri != NULL)
-      {
-        httpSeparateURI(HTTP_URI_CODING_ALL, printer_uri, method, sizeof(method),
-	                username, sizeof(username), server, sizeof(server),
-			&port, resource, sizeof(resource));
-
-        if (!_cups_strcasecmp(server, cupsServer()))
-	  http2 = CUPS_HTTP_DEFAULT;
-	else
-	  http2 = httpConnectEncrypt(server, port, cupsEncryption());
+      request = ippNewRequest(IPP_GET_PRINTER_ATTRIBUTES);
 
-       /*
-	* Build an IPP_GET_PRINTER_ATTRIBUTES request, which requires the
-	* following attributes:
-	*
-	*    attributes-charset
-	*    attributes-natural-language
-	*    printer-uri
-	*    requested-attributes
-	*/
+      ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI,
+		   "printer-uri", NULL, printer_uri);
 
-	request = ippNewRequest(IPP_GET_PRINTER_ATTRIBUTES);
+      ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+		    "requested-attributes",
+		    sizeof(cattrs) / sizeof(cattrs[0]),
+		    NULL, cattrs);
 
-	ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI,
-		     "printer-uri", NULL, printer_uri);
+      if ((response2 = cupsDoRequest(http2, request, "/")) != NULL)
+	members = ippFindAttribute(response2, "member-names", IPP_TAG_NAME);
 
-	ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-		      "requested-attributes",
-		      sizeof(cattrs) / sizeof(cattrs[0]),
-		      NULL, cattrs);
-
-	if ((response2 = cupsDoRequest(http2, request, "/")) != NULL)
-	  members = ippFindAttribute(response2, "member-names", IPP_TAG_NAME);
+      if (http2)
+	httpClose(http2);
+    }
 
-	if (http2)
-	  httpClose(http2);
-      }
+   /*
+    * See if we have everything needed...
+    */
 
-     /*
-      * See if we have everything needed...
-      */
+    if (printer == NULL)
+    {
+      if (response2)
+	ippDelete(response2);
 
-      if (printer == NULL)
-      {
-        if (response2)
-	  ippDelete(response2);
+      if (attr == NULL)
+	break;
+      else
+	continue;
+    }
 
-        if (attr == NULL)
-	  break;
-	else
-          continue;
-      }
+   /*
+    * Display the printer entry if needed...
+    */
 
-     /*
-      * Display the printer entry if needed...
-      */
+    if (match_list(dests, printer))
+    {
+      _cupsLangPrintf(stdout, _("members of class %s:"), printer);
 
-      if (match_list(dests, printer))
+      if (members)
       {
-        _cupsLangPrintf(stdout, _("members of class %s:"), printer);
-
-	if (members)
-	{
-	  for (i = 0; i < members->num_values; i ++)
-	    _cupsLangPrintf(stdout, "\t%s", members->values[i].string.text);
-        }
-	else
-	  _cupsLangPuts(stdout, "\tunknown");
+	for (i = 0; i < members->num_values; i ++)
+	  _cupsLangPrintf(stdout, "\t%s", members->values[i].string.text);
       }
-
-      if (response2)
-	ippDelete(response2);
-
-      if (attr == NULL)
-        break;
+      else
+	_cupsLangPuts(stdout, "\tunknown");
     }
 
-    ippDelete(response);
+    if (response2)
+      ippDelete(response2);
+
+    if (attr == NULL)
+      break;
   }
 
   return (0);
@@ -1115,158 +1255,112 @@ show_devices(const char  *printers,	/* I - Destinations */
 	     cups_dest_t *dests)	/* I - User-defined destinations */
 {
   int		i;			/* Looping var */
-  ipp_t		*request,		/* IPP Request */
-		*response;		/* IPP Response */
+  ipp_t		*response;		/* IPP Response */
   ipp_attribute_t *attr;		/* Current attribute */
   const char	*printer,		/* Printer name */
 		*uri,			/* Printer URI */
 		*device;		/* Printer device URI */
-  static const char *pattrs[] =		/* Attributes we need for printers... */
-		{
-		  "printer-name",
-		  "printer-uri-supported",
-		  "device-uri"
-		};
 
 
   if (printers != NULL && !strcmp(printers, "all"))
     printers = NULL;
 
  /*
-  * Build a CUPS_GET_PRINTERS request, which requires the following
-  * attributes:
-  *
-  *    attributes-charset
-  *    attributes-natural-language
-  *    requested-attributes
-  *    requesting-user-name
+  * Get the list of printers and classes...
   */
 
-  request = ippNewRequest(CUPS_GET_PRINTERS);
-
-  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                "requested-attributes", sizeof(pattrs) / sizeof(pattrs[0]),
-		NULL, pattrs);
-
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name",
-               NULL, cupsUser());
+  if ((response = get_printers()) == NULL)
+    return (1);
 
  /*
-  * Do the request and get back a response...
+  * Loop through the printers returned in the list and display
+  * their devices...
   */
 
-  response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
-
-  if (cupsLastError() == IPP_STATUS_ERROR_BAD_REQUEST ||
-      cupsLastError() == IPP_STATUS_ERROR_VERSION_NOT_SUPPORTED)
-  {
-    _cupsLangPrintf(stderr,
-		    _("%s: Error - add '/version=1.1' to server name."),
-		    "lpstat");
-    ippDelete(response);
-    return (1);
-  }
-  else if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
-  {
-    _cupsLangPrintf(stderr, "lpstat: %s", cupsLastErrorString());
-    ippDelete(response);
-    return (1);
-  }
-
-  if (response)
+  for (attr = response->attrs; attr != NULL; attr = attr->next)
   {
    /*
-    * Loop through the printers returned in the list and display
-    * their devices...
+    * Skip leading attributes until we hit a job...
     */
 
-    for (attr = response->attrs; attr != NULL; attr = attr->next)
-    {
-     /*
-      * Skip leading attributes until we hit a job...
-      */
+    while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
+      attr = attr->next;
 
-      while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
-        attr = attr->next;
+    if (attr == NULL)
+      break;
 
-      if (attr == NULL)
-        break;
+   /*
+    * Pull the needed attributes from this job...
+    */
 
-     /*
-      * Pull the needed attributes from this job...
-      */
+    printer = NULL;
+    device  = NULL;
+    uri     = NULL;
 
-      printer = NULL;
-      device  = NULL;
-      uri     = NULL;
+    while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
+    {
+      if (!strcmp(attr->name, "printer-name") &&
+	  attr->value_tag == IPP_TAG_NAME)
+	printer = attr->values[0].string.text;
 
-      while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
-      {
-        if (!strcmp(attr->name, "printer-name") &&
-	    attr->value_tag == IPP_TAG_NAME)
-	  printer = attr->values[0].string.text;
+      if (!strcmp(attr->name, "printer-uri-supported") &&
+	  attr->value_tag == IPP_TAG_URI)
+	uri = attr->values[0].string.text;
 
-        if (!strcmp(attr->name, "printer-uri-supported") &&
-	    attr->value_tag == IPP_TAG_URI)
-	  uri = attr->values[0].string.text;
+      if (!strcmp(attr->name, "device-uri") &&
+	  attr->value_tag == IPP_TAG_URI)
+	device = attr->values[0].string.text;
 
-        if (!strcmp(attr->name, "device-uri") &&
-	    attr->value_tag == IPP_TAG_URI)
-	  device = attr->values[0].string.text;
+      attr = attr->next;
+    }
 
-        attr = attr->next;
-      }
+   /*
+    * See if we have everything needed...
+    */
 
-     /*
-      * See if we have everything needed...
-      */
+    if (printer == NULL)
+    {
+      if (attr == NULL)
+	break;
+      else
+	continue;
+    }
 
-      if (printer == NULL)
-      {
-        if (attr == NULL)
-	  break;
-	else
-          continue;
-      }
+   /*
+    * Display the printer entry if needed...
+    */
 
-     /*
-      * Display the printer entry if needed...
-      */
+    if (match_list(printers, printer))
+    {
+      if (device == NULL)
+	_cupsLangPrintf(stdout, _("device for %s: %s"),
+			printer, uri);
+      else if (!strncmp(device, "file:", 5))
+	_cupsLangPrintf(stdout, _("device for %s: %s"),
+			printer, device + 5);
+      else
+	_cupsLangPrintf(stdout, _("device for %s: %s"),
+			printer, device);
 
-      if (match_list(printers, printer))
+      for (i = 0; i < num_dests; i ++)
       {
-        if (device == NULL)
-          _cupsLangPrintf(stdout, _("device for %s: %s"),
-	                  printer, uri);
-        else if (!strncmp(device, "file:", 5))
-          _cupsLangPrintf(stdout, _("device for %s: %s"),
-	                  printer, device + 5);
-        else
-          _cupsLangPrintf(stdout, _("device for %s: %s"),
-	                  printer, device);
-
-        for (i = 0; i < num_dests; i ++)
-        {
-	  if (!_cups_strcasecmp(printer, dests[i].name) && dests[i].instance)
-	  {
-            if (device == NULL)
-              _cupsLangPrintf(stdout, _("device for %s/%s: %s"),
-	                      printer, dests[i].instance, uri);
-            else if (!strncmp(device, "file:", 5))
-              _cupsLangPrintf(stdout, _("device for %s/%s: %s"),
-	                      printer, dests[i].instance, device + 5);
-            else
-              _cupsLangPrintf(stdout, _("device for %s/%s: %s"),
-	                      printer, dests[i].instance, device);
-	  }
+	if (!_cups_strcasecmp(printer, dests[i].name) && dests[i].instance)
+	{
+	  if (device == NULL)
+	    _cupsLangPrintf(stdout, _("device for %s/%s: %s"),
+			    printer, dests[i].instance, uri);
+	  else if (!strncmp(device, "file:", 5))
+	    _cupsLangPrintf(stdout, _("device for %s/%s: %s"),
+			    printer, dests[i].instance, device + 5);
+	  else
+	    _cupsLangPrintf(stdout, _("device for %s/%s: %s"),
+			    printer, dests[i].instance, device);
 	}
       }
-
-      if (attr == NULL)
-        break;
     }
 
-    ippDelete(response);
+    if (attr == NULL)
+      break;
   }
 
   return (0);
@@ -1514,11 +1608,8 @@ show_printers(const char  *printers,	/* I - Destinations */
               int         long_status)	/* I - Show long status? */
 {
   int		i, j;			/* Looping vars */
-  ipp_t		*request,		/* IPP Request */
-		*response,		/* IPP Response */
-		*jobs;			/* IPP Get Jobs response */
+  ipp_t		*response;		/* IPP Response */
   ipp_attribute_t *attr,		/* Current attribute */
-		*jobattr,		/* Job ID attribute */
 		*reasons;		/* Job state reasons attribute */
   const char	*printer,		/* Printer name */
 		*message,		/* Printer state message */
@@ -1532,480 +1623,361 @@ show_printers(const char  *printers,	/* I - Destinations */
   cups_ptype_t	ptype;			/* Printer type */
   time_t	ptime;			/* Printer state time */
   int		jobid;			/* Job ID of current job */
-  char		printer_uri[HTTP_MAX_URI],
-					/* Printer URI */
-		printer_state_time[255];/* Printer state time */
+  char		printer_state_time[255];/* Printer state time */
   _cups_globals_t *cg = _cupsGlobals();	/* Global data */
-  static const char *pattrs[] =		/* Attributes we need for printers... */
-		{
-		  "printer-name",
-		  "printer-state",
-		  "printer-state-message",
-		  "printer-state-reasons",
-		  "printer-state-change-time",
-		  "printer-type",
-		  "printer-info",
-                  "printer-location",
-		  "printer-make-and-model",
-		  "printer-uri-supported",
-		  "requesting-user-name-allowed",
-		  "requesting-user-name-denied"
-		};
-  static const char *jattrs[] =		/* Attributes we need for jobs... */
-		{
-		  "job-id",
-		  "job-state"
-		};
 
 
   if (printers != NULL && !strcmp(printers, "all"))
     printers = NULL;
 
  /*
-  * Build a CUPS_GET_PRINTERS request, which requires the following
-  * attributes:
-  *
-  *    attributes-charset
-  *    attributes-natural-language
-  *    requested-attributes
-  *    requesting-user-name
+  * Get the list of printers and classes...
   */
 
-  request = ippNewRequest(CUPS_GET_PRINTERS);
-
-  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                "requested-attributes", sizeof(pattrs) / sizeof(pattrs[0]),
-		NULL, pattrs);
-
-  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name",
-               NULL, cupsUser());
+  if ((response = get_printers()) == NULL)
+    return (1);
 
  /*
-  * Do the request and get back a response...
+  * Loop through the printers returned in the list and display
+  * their status...
   */
 
-  response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
-
-  if (cupsLastError() == IPP_STATUS_ERROR_BAD_REQUEST ||
-      cupsLastError() == IPP_STATUS_ERROR_VERSION_NOT_SUPPORTED)
-  {
-    _cupsLangPrintf(stderr,
-		    _("%s: Error - add '/version=1.1' to server name."),
-		    "lpstat");
-    ippDelete(response);
-    return (1);
-  }
-  else if (cupsLastError() > IPP_STATUS_OK_CONFLICTING)
+  for (attr = response->attrs; attr != NULL; attr = attr->next)
   {
-    _cupsLangPrintf(stderr, "lpstat: %s", cupsLastErrorString());
-    ippDelete(response);
-    return (1);
-  }
+   /*
+    * Skip leading attributes until we hit a job...
+    */
+
+    while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
+      attr = attr->next;
+
+    if (attr == NULL)
+      break;
 
-  if (response)
-  {
    /*
-    * Loop through the printers returned in the list and display
-    * their status...
+    * Pull the needed attributes from this job...
     */
 
-    for (attr = response->attrs; attr != NULL; attr = attr->next)
+    printer     = NULL;
+    ptime       = 0;
+    ptype       = CUPS_PRINTER_LOCAL;
+    pstate      = IPP_PRINTER_IDLE;
+    message     = NULL;
+    description = NULL;
+    location    = NULL;
+    make_model  = NULL;
+    reasons     = NULL;
+    uri         = NULL;
+    jobid       = 0;
+    allowed     = NULL;
+    denied      = NULL;
+
+    while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
     {
-     /*
-      * Skip leading attributes until we hit a job...
-      */
+      if (!strcmp(attr->name, "printer-name") &&
+	  attr->value_tag == IPP_TAG_NAME)
+	printer = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-state") &&
+	       attr->value_tag == IPP_TAG_ENUM)
+	pstate = (ipp_pstate_t)attr->values[0].integer;
+      else if (!strcmp(attr->name, "printer-type") &&
+	       attr->value_tag == IPP_TAG_ENUM)
+	ptype = (cups_ptype_t)attr->values[0].integer;
+      else if (!strcmp(attr->name, "printer-state-message") &&
+	       attr->value_tag == IPP_TAG_TEXT)
+	message = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-state-change-time") &&
+	       attr->value_tag == IPP_TAG_INTEGER)
+	ptime = (time_t)attr->values[0].integer;
+      else if (!strcmp(attr->name, "printer-info") &&
+	       attr->value_tag == IPP_TAG_TEXT)
+	description = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-location") &&
+	       attr->value_tag == IPP_TAG_TEXT)
+	location = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-make-and-model") &&
+	       attr->value_tag == IPP_TAG_TEXT)
+	make_model = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-uri-supported") &&
+	       attr->value_tag == IPP_TAG_URI)
+	uri = attr->values[0].string.text;
+      else if (!strcmp(attr->name, "printer-state-reasons") &&
+	       attr->value_tag == IPP_TAG_KEYWORD)
+	reasons = attr;
+      else if (!strcmp(attr->name, "requesting-user-name-allowed") &&
+	       attr->value_tag == IPP_TAG_NAME)
+	allowed = attr;
+      else if (!strcmp(attr->name, "requesting-user-name-denied") &&
+	       attr->value_tag == IPP_TAG_NAME)
+	denied = attr;
+
+      attr = attr->next;
+    }
 
-      while (attr != NULL && attr->group_tag != IPP_TAG_PRINTER)
-        attr = attr->next;
+   /*
+    * See if we have everything needed...
+    */
 
+    if (printer == NULL)
+    {
       if (attr == NULL)
-        break;
+	break;
+      else
+	continue;
+    }
 
+   /*
+    * Display the printer entry if needed...
+    */
+
+    if (match_list(printers, printer))
+    {
      /*
-      * Pull the needed attributes from this job...
+      * If the printer state is "IPP_PRINTER_PROCESSING", then grab the
+      * current job for the printer.
       */
 
-      printer     = NULL;
-      ptime       = 0;
-      ptype       = CUPS_PRINTER_LOCAL;
-      pstate      = IPP_PRINTER_IDLE;
-      message     = NULL;
-      description = NULL;
-      location    = NULL;
-      make_model  = NULL;
-      reasons     = NULL;
-      uri         = NULL;
-      jobid       = 0;
-      allowed     = NULL;
-      denied      = NULL;
-
-      while (attr != NULL && attr->group_tag == IPP_TAG_PRINTER)
-      {
-        if (!strcmp(attr->name, "printer-name") &&
-	    attr->value_tag == IPP_TAG_NAME)
-	  printer = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-state") &&
-	         attr->value_tag == IPP_TAG_ENUM)
-	  pstate = (ipp_pstate_t)attr->values[0].integer;
-        else if (!strcmp(attr->name, "printer-type") &&
-	         attr->value_tag == IPP_TAG_ENUM)
-	  ptype = (cups_ptype_t)attr->values[0].integer;
-        else if (!strcmp(attr->name, "printer-state-message") &&
-	         attr->value_tag == IPP_TAG_TEXT)
-	  message = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-state-change-time") &&
-	         attr->value_tag == IPP_TAG_INTEGER)
-	  ptime = (time_t)attr->values[0].integer;
-	else if (!strcmp(attr->name, "printer-info") &&
-	         attr->value_tag == IPP_TAG_TEXT)
-	  description = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-location") &&
-	         attr->value_tag == IPP_TAG_TEXT)
-	  location = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-make-and-model") &&
-	         attr->value_tag == IPP_TAG_TEXT)
-	  make_model = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-uri-supported") &&
-	         attr->value_tag == IPP_TAG_URI)
-	  uri = attr->values[0].string.text;
-        else if (!strcmp(attr->name, "printer-state-reasons") &&
-	         attr->value_tag == IPP_TAG_KEYWORD)
-	  reasons = attr;
-        else if (!strcmp(attr->name, "requesting-user-name-allowed") &&
-	         attr->value_tag == IPP_TAG_NAME)
-	  allowed = attr;
-        else if (!strcmp(attr->name, "requesting-user-name-denied") &&
-	         attr->value_tag == IPP_TAG_NAME)
-	  denied = attr;
-
-        attr = attr->next;
-      }
+      if (pstate == IPP_PRINTER_PROCESSING)
+	jobid = get_printer_job(printer);
 
      /*
-      * See if we have everything needed...
+      * Display it...
       */
 
-      if (printer == NULL)
+      _cupsStrDate(printer_state_time, sizeof(printer_state_time), ptime);
+
+      switch (pstate)
       {
-        if (attr == NULL)
-	  break;
+	case IPP_PRINTER_IDLE :
+	    if (ippContainsString(reasons, "hold-new-jobs"))
+	      _cupsLangPrintf(stdout, _("printer %s is holding new jobs.  enabled since %s"), printer, printer_state_time);
+	    else
+	      _cupsLangPrintf(stdout, _("printer %s is idle.  enabled since %s"), printer, printer_state_time);
+	    break;
+	case IPP_PRINTER_PROCESSING :
+	    _cupsLangPrintf(stdout, _("printer %s now printing %s-%d.  enabled since %s"), printer, printer, jobid, printer_state_time);
+	    break;
+	case IPP_PRINTER_STOPPED :
+	    _cupsLangPrintf(stdout, _("printer %s disabled since %s -"), printer, printer_state_time);
+	    break;
+      }
+
+      if ((message && *message) || pstate == IPP_PRINTER_STOPPED)
+      {
+	if (!message || !*message)
+	  _cupsLangPuts(stdout, _("\treason unknown"));
 	else
-          continue;
+	  _cupsLangPrintf(stdout, "\t%s", message);
       }
 
-     /*
-      * Display the printer entry if needed...
-      */
+      if (long_status > 1)
+      {
+	_cupsLangPuts(stdout, _("\tForm mounted:"));
+	_cupsLangPuts(stdout, _("\tContent types: any"));
+	_cupsLangPuts(stdout, _("\tPrinter types: unknown"));
+      }
 
-      if (match_list(printers, printer))
+      if (long_status)
       {
-       /*
-        * If the printer state is "IPP_PRINTER_PROCESSING", then grab the
-	* current job for the printer.
-	*/
+	_cupsLangPrintf(stdout, _("\tDescription: %s"),
+			description ? description : "");
 
-        if (pstate == IPP_PRINTER_PROCESSING)
+	if (reasons)
 	{
-	 /*
-	  * Build an IPP_GET_JOBS request, which requires the following
-	  * attributes:
-	  *
-	  *    attributes-charset
-	  *    attributes-natural-language
-	  *    printer-uri
-	  *    limit
-          *    requested-attributes
-	  */
-
-	  request = ippNewRequest(IPP_GET_JOBS);
-
-	  request->request.op.operation_id = IPP_GET_JOBS;
-	  request->request.op.request_id   = 1;
-
-	  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                	"requested-attributes",
-		        sizeof(jattrs) / sizeof(jattrs[0]), NULL, jattrs);
-
-	  httpAssembleURIf(HTTP_URI_CODING_ALL, printer_uri, sizeof(printer_uri),
-	                   "ipp", NULL, "localhost", 0, "/printers/%s", printer);
-	  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI,
-	               "printer-uri", NULL, printer_uri);
-
-          if ((jobs = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/")) != NULL)
-	  {
-	   /*
-	    * Get the current active job on this queue...
-	    */
-
-            ipp_jstate_t jobstate = IPP_JOB_PENDING;
-	    jobid = 0;
-
-	    for (jobattr = jobs->attrs; jobattr; jobattr = jobattr->next)
-	    {
-	      if (!jobattr->name)
-	      {
-	        if (jobstate == IPP_JOB_PROCESSING)
-		  break;
-	        else
-		  continue;
-              }
-
-	      if (!strcmp(jobattr->name, "job-id") &&
-	          jobattr->value_tag == IPP_TAG_INTEGER)
-		jobid = jobattr->values[0].integer;
-              else if (!strcmp(jobattr->name, "job-state") &&
-	               jobattr->value_tag == IPP_TAG_ENUM)
-		jobstate = (ipp_jstate_t)jobattr->values[0].integer;
-	    }
+	  char	alerts[1024],	/* Alerts string */
+		      *aptr;		/* Pointer into alerts string */
 
-            if (jobstate != IPP_JOB_PROCESSING)
-	      jobid = 0;
+	  for (i = 0, aptr = alerts; i < reasons->num_values; i ++)
+	  {
+	    if (i)
+	      snprintf(aptr, sizeof(alerts) - (size_t)(aptr - alerts), " %s", reasons->values[i].string.text);
+	    else
+	      strlcpy(alerts, reasons->values[i].string.text, sizeof(alerts));
 
-            ippDelete(jobs);
+	    aptr += strlen(aptr);
 	  }
-        }
 
-       /*
-        * Display it...
-	*/
-
-        _cupsStrDate(printer_state_time, sizeof(printer_state_time), ptime);
+	  _cupsLangPrintf(stdout, _("\tAlerts: %s"), alerts);
+	}
+      }
+      if (long_status > 1)
+      {
+	_cupsLangPrintf(stdout, _("\tLocation: %s"),
+			location ? location : "");
 
-        switch (pstate)
+	if (ptype & CUPS_PRINTER_REMOTE)
 	{
-	  case IPP_PRINTER_IDLE :
-	      if (ippContainsString(reasons, "hold-new-jobs"))
-		_cupsLangPrintf(stdout, _("printer %s is holding new jobs.  enabled since %s"), printer, printer_state_time);
-	      else
-		_cupsLangPrintf(stdout, _("printer %s is idle.  enabled since %s"), printer, printer_state_time);
-	      break;
-	  case IPP_PRINTER_PROCESSING :
-	      _cupsLangPrintf(stdout, _("printer %s now printing %s-%d.  enabled since %s"), printer, printer, jobid, printer_state_time);
-	      break;
-	  case IPP_PRINTER_STOPPED :
-	      _cupsLangPrintf(stdout, _("printer %s disabled since %s -"), printer, printer_state_time);
-	      break;
+	  _cupsLangPuts(stdout, _("\tConnection: remote"));
+
+	  if (make_model && !strstr(make_model, "System V Printer") &&
+		   !strstr(make_model, "Raw Printer") && uri)
+	    _cupsLangPrintf(stdout, _("\tInterface: %s.ppd"),
+			    uri);
 	}
+	else
+	{
+	  _cupsLangPuts(stdout, _("\tConnection: direct"));
 
-        if ((message && *message) || pstate == IPP_PRINTER_STOPPED)
+	  if (make_model && !strstr(make_model, "Raw Printer"))
+	    _cupsLangPrintf(stdout,
+			    _("\tInterface: %s/ppd/%s.ppd"),
+			    cg->cups_serverroot, printer);
+	}
+	_cupsLangPuts(stdout, _("\tOn fault: no alert"));
+	_cupsLangPuts(stdout, _("\tAfter fault: continue"));
+	    /* TODO update to use printer-error-policy */
+	if (allowed)
 	{
-	  if (!message || !*message)
-	    _cupsLangPuts(stdout, _("\treason unknown"));
-	  else
-	    _cupsLangPrintf(stdout, "\t%s", message);
+	  _cupsLangPuts(stdout, _("\tUsers allowed:"));
+	  for (j = 0; j < allowed->num_values; j ++)
+	    _cupsLangPrintf(stdout, "\t\t%s",
+			    allowed->values[j].string.text);
 	}
-
-        if (long_status > 1)
+	else if (denied)
 	{
-	  _cupsLangPuts(stdout, _("\tForm mounted:"));
-	  _cupsLangPuts(stdout, _("\tContent types: any"));
-	  _cupsLangPuts(stdout, _("\tPrinter types: unknown"));
+	  _cupsLangPuts(stdout, _("\tUsers denied:"));
+	  for (j = 0; j < denied->num_values; j ++)
+	    _cupsLangPrintf(stdout, "\t\t%s",
+			    denied->values[j].string.text);
 	}
-
-        if (long_status)
+	else
 	{
-	  _cupsLangPrintf(stdout, _("\tDescription: %s"),
-	                  description ? description : "");
+	  _cupsLangPuts(stdout, _("\tUsers allowed:"));
+	  _cupsLangPuts(stdout, _("\t\t(all)"));
+	}
+	_cupsLangPuts(stdout, _("\tForms allowed:"));
+	_cupsLangPuts(stdout, _("\t\t(none)"));
+	_cupsLangPuts(stdout, _("\tBanner required"));
+	_cupsLangPuts(stdout, _("\tCharset sets:"));
+	_cupsLangPuts(stdout, _("\t\t(none)"));
+	_cupsLangPuts(stdout, _("\tDefault pitch:"));
+	_cupsLangPuts(stdout, _("\tDefault page size:"));
+	_cupsLangPuts(stdout, _("\tDefault port settings:"));
+      }
 
-	  if (reasons)
+      for (i = 0; i < num_dests; i ++)
+	if (!_cups_strcasecmp(printer, dests[i].name) && dests[i].instance)
+	{
+	  switch (pstate)
 	  {
-	    char	alerts[1024],	/* Alerts string */
-			*aptr;		/* Pointer into alerts string */
-
-	    for (i = 0, aptr = alerts; i < reasons->num_values; i ++)
-	    {
-	      if (i)
-		snprintf(aptr, sizeof(alerts) - (size_t)(aptr - alerts), " %s", reasons->values[i].string.text);
-	      else
-		strlcpy(alerts, reasons->values[i].string.text, sizeof(alerts));
-
-	      aptr += strlen(aptr);
-	    }
-
-	    _cupsLangPrintf(stdout, _("\tAlerts: %s"), alerts);
+	    case IPP_PRINTER_IDLE :
+		_cupsLangPrintf(stdout,
+				_("printer %s/%s is idle.  "
+				  "enabled since %s"),
+				printer, dests[i].instance,
+				printer_state_time);
+		break;
+	    case IPP_PRINTER_PROCESSING :
+		_cupsLangPrintf(stdout,
+				_("printer %s/%s now printing %s-%d.  "
+				  "enabled since %s"),
+				printer, dests[i].instance, printer, jobid,
+				printer_state_time);
+		break;
+	    case IPP_PRINTER_STOPPED :
+		_cupsLangPrintf(stdout,
+				_("printer %s/%s disabled since %s -"),
+				printer, dests[i].instance,
+				printer_state_time);
+		break;
 	  }
-	}
-        if (long_status > 1)
-	{
-	  _cupsLangPrintf(stdout, _("\tLocation: %s"),
-	                  location ? location : "");
 
-	  if (ptype & CUPS_PRINTER_REMOTE)
+	  if ((message && *message) || pstate == IPP_PRINTER_STOPPED)
 	  {
-	    _cupsLangPuts(stdout, _("\tConnection: remote"));
-
-	    if (make_model && !strstr(make_model, "System V Printer") &&
-	             !strstr(make_model, "Raw Printer") && uri)
-	      _cupsLangPrintf(stdout, _("\tInterface: %s.ppd"),
-	                      uri);
+	    if (!message || !*message)
+	      _cupsLangPuts(stdout, _("\treason unknown"));
+	    else
+	      _cupsLangPrintf(stdout, "\t%s", message);
 	  }
-	  else
-	  {
-	    _cupsLangPuts(stdout, _("\tConnection: direct"));
-
-	    if (make_model && !strstr(make_model, "Raw Printer"))
-	      _cupsLangPrintf(stdout,
-	                      _("\tInterface: %s/ppd/%s.ppd"),
-			      cg->cups_serverroot, printer);
-          }
-	  _cupsLangPuts(stdout, _("\tOn fault: no alert"));
-	  _cupsLangPuts(stdout, _("\tAfter fault: continue"));
-	      /* TODO update to use printer-error-policy */
-          if (allowed)
+
+	  if (long_status > 1)
 	  {
-	    _cupsLangPuts(stdout, _("\tUsers allowed:"));
-	    for (j = 0; j < allowed->num_values; j ++)
-	      _cupsLangPrintf(stdout, "\t\t%s",
-	                      allowed->values[j].string.text);
+	    _cupsLangPuts(stdout, _("\tForm mounted:"));
+	    _cupsLangPuts(stdout, _("\tContent types: any"));
+	    _cupsLangPuts(stdout, _("\tPrinter types: unknown"));
 	  }
-	  else if (denied)
+
+	  if (long_status)
 	  {
-	    _cupsLangPuts(stdout, _("\tUsers denied:"));
-	    for (j = 0; j < denied->num_values; j ++)
-	      _cupsLangPrintf(stdout, "\t\t%s",
-	                      denied->values[j].string.text);
+	    _cupsLangPrintf(stdout, _("\tDescription: %s"),
+			    description ? description : "");
+
+	    if (reasons)
+	    {
+	      char	alerts[1024],	/* Alerts string */
+		      *aptr;		/* Pointer into alerts string */
+
+	      for (i = 0, aptr = alerts; i < reasons->num_values; i ++)
+	      {
+		if (i)
+		  snprintf(aptr, sizeof(alerts) - (size_t)(aptr - alerts), " %s", reasons->values[i].string.text);
+		else
+		  strlcpy(alerts, reasons->values[i].string.text, sizeof(alerts));
+
+		aptr += strlen(aptr);
+	      }
+
+	      _cupsLangPrintf(stdout, _("\tAlerts: %s"), alerts);
+	    }
 	  }
-	  else
+	  if (long_status > 1)
 	  {
-	    _cupsLangPuts(stdout, _("\tUsers allowed:"));
-	    _cupsLangPuts(stdout, _("\t\t(all)"));
-	  }
-	  _cupsLangPuts(stdout, _("\tForms allowed:"));
-	  _cupsLangPuts(stdout, _("\t\t(none)"));
-	  _cupsLangPuts(stdout, _("\tBanner required"));
-	  _cupsLangPuts(stdout, _("\tCharset sets:"));
-	  _cupsLangPuts(stdout, _("\t\t(none)"));
-	  _cupsLangPuts(stdout, _("\tDefault pitch:"));
-	  _cupsLangPuts(stdout, _("\tDefault page size:"));
-	  _cupsLangPuts(stdout, _("\tDefault port settings:"));
-	}
+	    _cupsLangPrintf(stdout, _("\tLocation: %s"),
+			    location ? location : "");
 
-        for (i = 0; i < num_dests; i ++)
-	  if (!_cups_strcasecmp(printer, dests[i].name) && dests[i].instance)
-	  {
-            switch (pstate)
+	    if (ptype & CUPS_PRINTER_REMOTE)
 	    {
-	      case IPP_PRINTER_IDLE :
-		  _cupsLangPrintf(stdout,
-		                  _("printer %s/%s is idle.  "
-				    "enabled since %s"),
-				  printer, dests[i].instance,
-				  printer_state_time);
-		  break;
-	      case IPP_PRINTER_PROCESSING :
-		  _cupsLangPrintf(stdout,
-		                  _("printer %s/%s now printing %s-%d.  "
-				    "enabled since %s"),
-				  printer, dests[i].instance, printer, jobid,
-				  printer_state_time);
-		  break;
-	      case IPP_PRINTER_STOPPED :
-		  _cupsLangPrintf(stdout,
-		                  _("printer %s/%s disabled since %s -"),
-				  printer, dests[i].instance,
-				  printer_state_time);
-		  break;
-	    }
+	      _cupsLangPuts(stdout, _("\tConnection: remote"));
 
-            if ((message && *message) || pstate == IPP_PRINTER_STOPPED)
+	      if (make_model && !strstr(make_model, "System V Printer") &&
+		       !strstr(make_model, "Raw Printer") && uri)
+		_cupsLangPrintf(stdout, _("\tInterface: %s.ppd"), uri);
+	    }
+	    else
 	    {
-	      if (!message || !*message)
-		_cupsLangPuts(stdout, _("\treason unknown"));
-	      else
-		_cupsLangPrintf(stdout, "\t%s", message);
-            }
+	      _cupsLangPuts(stdout, _("\tConnection: direct"));
 
-            if (long_status > 1)
+	      if (make_model && !strstr(make_model, "Raw Printer"))
+		_cupsLangPrintf(stdout,
+				_("\tInterface: %s/ppd/%s.ppd"),
+				cg->cups_serverroot, printer);
+	    }
+	    _cupsLangPuts(stdout, _("\tOn fault: no alert"));
+	    _cupsLangPuts(stdout, _("\tAfter fault: continue"));
+		/* TODO update to use printer-error-policy */
+	    if (allowed)
 	    {
-	      _cupsLangPuts(stdout, _("\tForm mounted:"));
-	      _cupsLangPuts(stdout, _("\tContent types: any"));
-	      _cupsLangPuts(stdout, _("\tPrinter types: unknown"));
+	      _cupsLangPuts(stdout, _("\tUsers allowed:"));
+	      for (j = 0; j < allowed->num_values; j ++)
+		_cupsLangPrintf(stdout, "\t\t%s",
+				allowed->values[j].string.text);
 	    }
-
-            if (long_status)
+	    else if (denied)
 	    {
-	      _cupsLangPrintf(stdout, _("\tDescription: %s"),
-	                      description ? description : "");
-
-	      if (reasons)
-	      {
-		char	alerts[1024],	/* Alerts string */
-			*aptr;		/* Pointer into alerts string */
-
-		for (i = 0, aptr = alerts; i < reasons->num_values; i ++)
-		{
-		  if (i)
-		    snprintf(aptr, sizeof(alerts) - (size_t)(aptr - alerts), " %s", reasons->values[i].string.text);
-		  else
-		    strlcpy(alerts, reasons->values[i].string.text, sizeof(alerts));
-
-		  aptr += strlen(aptr);
-		}
-
-		_cupsLangPrintf(stdout, _("\tAlerts: %s"), alerts);
-	      }
+	      _cupsLangPuts(stdout, _("\tUsers denied:"));
+	      for (j = 0; j < denied->num_values; j ++)
+		_cupsLangPrintf(stdout, "\t\t%s",
+				denied->values[j].string.text);
 	    }
-            if (long_status > 1)
+	    else
 	    {
-	      _cupsLangPrintf(stdout, _("\tLocation: %s"),
-	                      location ? location : "");
-
-	      if (ptype & CUPS_PRINTER_REMOTE)
-	      {
-		_cupsLangPuts(stdout, _("\tConnection: remote"));
-
-		if (make_model && !strstr(make_model, "System V Printer") &&
-	        	 !strstr(make_model, "Raw Printer") && uri)
-		  _cupsLangPrintf(stdout, _("\tInterface: %s.ppd"), uri);
-	      }
-	      else
-	      {
-		_cupsLangPuts(stdout, _("\tConnection: direct"));
-
-		if (make_model && !strstr(make_model, "Raw Printer"))
-		  _cupsLangPrintf(stdout,
-	                	  _("\tInterface: %s/ppd/%s.ppd"),
-				  cg->cups_serverroot, printer);
-              }
-	      _cupsLangPuts(stdout, _("\tOn fault: no alert"));
-	      _cupsLangPuts(stdout, _("\tAfter fault: continue"));
-		  /* TODO update to use printer-error-policy */
-              if (allowed)
-	      {
-		_cupsLangPuts(stdout, _("\tUsers allowed:"));
-		for (j = 0; j < allowed->num_values; j ++)
-		  _cupsLangPrintf(stdout, "\t\t%s",
-	                	  allowed->values[j].string.text);
-	      }
-	      else if (denied)
-	      {
-		_cupsLangPuts(stdout, _("\tUsers denied:"));
-		for (j = 0; j < denied->num_values; j ++)
-		  _cupsLangPrintf(stdout, "\t\t%s",
-	                	  denied->values[j].string.text);
-	      }
-	      else
-	      {
-		_cupsLangPuts(stdout, _("\tUsers allowed:"));
-		_cupsLangPuts(stdout, _("\t\t(all)"));
-	      }
-	      _cupsLangPuts(stdout, _("\tForms allowed:"));
-	      _cupsLangPuts(stdout, _("\t\t(none)"));
-	      _cupsLangPuts(stdout, _("\tBanner required"));
-	      _cupsLangPuts(stdout, _("\tCharset sets:"));
-	      _cupsLangPuts(stdout, _("\t\t(none)"));
-	      _cupsLangPuts(stdout, _("\tDefault pitch:"));
-	      _cupsLangPuts(stdout, _("\tDefault page size:"));
-	      _cupsLangPuts(stdout, _("\tDefault port settings:"));
+	      _cupsLangPuts(stdout, _("\tUsers allowed:"));
+	      _cupsLangPuts(stdout, _("\t\t(all)"));
 	    }
+	    _cupsLangPuts(stdout, _("\tForms allowed:"));
+	    _cupsLangPuts(stdout, _("\t\t(none)"));
+	    _cupsLangPuts(stdout, _("\tBanner required"));
+	    _cupsLangPuts(stdout, _("\tCharset sets:"));
+	    _cupsLangPuts(stdout, _("\t\t(none)"));
+	    _cupsLangPuts(stdout, _("\tDefault pitch:"));
+	    _cupsLangPuts(stdout, _("\tDefault page size:"));
+	    _cupsLangPuts(stdout, _("\tDefault port settings:"));
 	  }
-      }
-
-      if (attr == NULL)
-        break;
+	}
     }
 
-    ippDelete(response);
+    if (attr == NULL)
+      break;
   }
 
   return (0);
@@ -12,7 +12,35 @@
  */
 
 #include "ippevecommon.h"
+#include <cups/thread-private.h>
+#include <sys/time.h>
 #include "dither.h"
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif /* __SSE2__ */
+
+
+/*
+ * Local constants...
+ */
+
+#define PCL_BAND_LINES	256		/* Lines converted per band */
+#define PCL_MAX_THREADS	8		/* Maximum number of conversion threads */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct pcl_worker_s		/* Band conversion worker */
+{
+  cups_page_header2_t	*header;	/* Page header */
+  unsigned		y,		/* First line of band */
+			first,		/* First line for this worker */
+			last;		/* Last line (exclusive) for this worker */
+} pcl_worker_t;
 
 
 /*
@@ -23,19 +51,28 @@ static unsigned		pcl_bottom,	/* Bottom line */
 			pcl_left,	/* Left offset in line */
 			pcl_right,	/* Right offset in line */
 			pcl_top,	/* Top line */
-			pcl_blanks;	/* Number of blank lines to skip */
+			pcl_blanks,	/* Number of blank lines to skip */
+			pcl_threads;	/* Number of conversion threads */
 static unsigned char	pcl_white,	/* White color */
-			*pcl_line,	/* Line buffer */
-			*pcl_comp;	/* Compression buffer */
+			*pcl_lines,	/* Band raster buffer */
+			*pcl_bits,	/* Band dither buffer */
+			*pcl_comp;	/* Band compression buffer */
+static size_t		pcl_bitsize,	/* Bytes per dithered line */
+			pcl_compsize;	/* Bytes per compressed line */
+static int		*pcl_lengths;	/* Compressed line lengths, -1 if blank */
+
 
 /*
  * Local functions...
  */
 
+static void	*pcl_band_thread(pcl_worker_t *worker);
+static unsigned char *pcl_dither_line(unsigned y, const unsigned char *line, unsigned char *bits);
+static int	pcl_encode_line(cups_page_header2_t *header, unsigned y, unsigned char *line, unsigned char *bits, unsigned char *comp);
 static void	pcl_end_page(cups_page_header2_t *header, unsigned page);
 static void	pcl_start_page(cups_page_header2_t *header, unsigned page);
 static int	pcl_to_pcl(const char *filename);
-static void	pcl_write_line(cups_page_header2_t *header, unsigned y, const unsigned char *line);
+static void	pcl_write_band(cups_page_header2_t *header, unsigned y, unsigned count);
 static int	raster_to_pcl(const char *filename);
 
 
@@ -80,6 +117,228 @@ main(int  argc,				/* I - Number of command-line arguments */
 }
 
 
+/*
+ * 'pcl_band_thread()' - Dither and compress part of a band.
+ */
+
+static void *				/* O - Exit status */
+pcl_band_thread(pcl_worker_t *worker)	/* I - Worker */
+{
+  unsigned	i;			/* Line in band */
+  size_t	bpl = worker->header->cupsBytesPerLine;
+					/* Bytes per raster line */
+
+
+  for (i = worker->first; i < worker->last; i ++)
+    pcl_lengths[i] = pcl_encode_line(worker->header, worker->y + i, pcl_lines + i * bpl, pcl_bits + i * pcl_bitsize, pcl_comp + i * pcl_compsize);
+
+  return (NULL);
+}
+
+
+/*
+ * 'pcl_dither_line()' - Dither a line of 8-bit grayscale to B&W.
+ */
+
+static unsigned char *			/* O - End of dithered line */
+pcl_dither_line(
+    unsigned            y,		/* I - Line number */
+    const unsigned char *line,		/* I - Pixels on line */
+    unsigned char       *bits)		/* I - Output buffer */
+{
+  unsigned	x;			/* Column number */
+  unsigned char	bit,			/* Current bit */
+		byte,			/* Current byte */
+		*outptr;		/* Pointer into output buffer */
+  const unsigned char	*ditherline;	/* Pointer into dither table */
+
+
+  ditherline = threshold[y & 63];
+  x          = pcl_left;
+  outptr     = bits;
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+ /*
+  * Threshold 16 pixels at a time, which always yields two whole output
+  * bytes.  The dither row is extended by 16 entries so that unaligned
+  * loads can wrap around the end of the 64-column table...
+  */
+
+  unsigned char	ditherext[80];		/* Extended dither row */
+  unsigned	i;			/* Looping var */
+
+  for (i = 0; i < 80; i ++)
+    ditherext[i] = ditherline[i & 63];
+
+#  ifdef __SSE2__
+  for (; (x + 15) <= pcl_right; x += 16, line += 16)
+  {
+    __m128i	pixels = _mm_loadu_si128((const __m128i *)line),
+		thresh = _mm_loadu_si128((const __m128i *)(ditherext + (x & 63)));
+    unsigned	mask   = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(pixels, thresh), pixels));
+					/* Bit N set if pixel N <= threshold */
+
+   /*
+    * movemask puts the first pixel in the least significant bit, PCL wants it
+    * in the most significant bit...
+    */
+
+    *outptr++ = (unsigned char)(((((mask & 255) * 0x0802U & 0x22110U) | ((mask & 255) * 0x8020U & 0x88440U)) * 0x10101U) >> 16);
+    *outptr++ = (unsigned char)(((((mask >> 8) * 0x0802U & 0x22110U) | ((mask >> 8) * 0x8020U & 0x88440U)) * 0x10101U) >> 16);
+  }
+
+#  else
+  static const unsigned char weights[16] =
+  {					/* Bit values for each pixel */
+    128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1
+  };
+  uint8x16_t	vweights = vld1q_u8(weights);
+
+  for (; (x + 15) <= pcl_right; x += 16, line += 16)
+  {
+    uint8x16_t	v = vandq_u8(vcleq_u8(vld1q_u8(line), vld1q_u8(ditherext + (x & 63))), vweights);
+
+    *outptr++ = vaddv_u8(vget_low_u8(v));
+    *outptr++ = vaddv_u8(vget_high_u8(v));
+  }
+#  endif /* __SSE2__ */
+#endif /* __SSE2__ || __ARM_NEON */
+
+  for (bit = 128, byte = 0; x <= pcl_right; x ++, line ++)
+  {
+    if (*line <= ditherline[x & 63])
+      byte |= bit;
+
+    if (bit == 1)
+    {
+      *outptr++ = byte;
+      byte      = 0;
+      bit       = 128;
+    }
+    else
+      bit >>= 1;
+  }
+
+  if (bit != 128)
+    *outptr++ = byte;
+
+  return (outptr);
+}
+
+
+/*
+ * 'pcl_encode_line()' - Dither and compress a line of raster data.
+ */
+
+static int				/* O - Compressed length or -1 if blank */
+pcl_encode_line(
+    cups_page_header2_t *header,	/* I - Raster information */
+    unsigned            y,		/* I - Line number */
+    unsigned char       *line,		/* I - Pixels on line */
+    unsigned char       *bits,		/* I - Dither buffer */
+    unsigned char       *comp)		/* I - Compression buffer */
+{
+  unsigned char	*outptr,		/* Pointer into output buffer */
+		*outend,		/* End of output buffer */
+		*start,			/* Start of sequence */
+		*compptr;		/* Pointer into compression buffer */
+  unsigned	count;			/* Count of bytes for output */
+
+
+  if (line[0] == pcl_white && !memcmp(line, line + 1, header->cupsBytesPerLine - 1))
+  {
+   /*
+    * Skip blank line...
+    */
+
+    return (-1);
+  }
+
+  if (header->cupsBitsPerPixel == 1)
+  {
+   /*
+    * B&W bitmap data can be used directly...
+    */
+
+    outend = line + (pcl_right + 7) / 8;
+    outptr = line + pcl_left / 8;
+  }
+  else
+  {
+   /*
+    * Dither 8-bit grayscale to B&W...
+    */
+
+    outend = pcl_dither_line(y, line, bits);
+    outptr = bits;
+  }
+
+ /*
+  * Apply compression...
+  */
+
+  compptr = comp;
+
+  while (outptr < outend)
+  {
+    if ((outptr + 1) >= outend)
+    {
+     /*
+      * Single byte on the end...
+      */
+
+      *compptr++ = 0x00;
+      *compptr++ = *outptr++;
+    }
+    else if (outptr[0] == outptr[1])
+    {
+     /*
+      * Repeated sequence...
+      */
+
+      outptr ++;
+      count = 2;
+
+      while (outptr < (outend - 1) &&
+	     outptr[0] == outptr[1] &&
+	     count < 127)
+      {
+	outptr ++;
+	count ++;
+      }
+
+      *compptr++ = (unsigned char)(257 - count);
+      *compptr++ = *outptr++;
+    }
+    else
+    {
+     /*
+      * Non-repeated sequence...
+      */
+
+      start = outptr;
+      outptr ++;
+      count = 1;
+
+      while (outptr < (outend - 1) &&
+	     outptr[0] != outptr[1] &&
+	     count < 127)
+      {
+	outptr ++;
+	count ++;
+      }
+
+      *compptr++ = (unsigned char)(count - 1);
+
+      memcpy(compptr, start, count);
+      compptr += count;
+    }
+  }
+
+  return ((int)(compptr - comp));
+}
+
+
 /*
  * 'pcl_end_page()' - End of PCL page.
  */
@@ -106,8 +365,10 @@ pcl_end_page(
   * Free the output buffers...
   */
 
-  free(pcl_line);
+  free(pcl_lines);
+  free(pcl_bits);
   free(pcl_comp);
+  free(pcl_lengths);
 }
 
 
@@ -237,10 +498,14 @@ pcl_start_page(
   * Allocate the output buffers...
   */
 
-  pcl_white  = header->cupsBitsPerColor == 1 ? 0 : 255;
-  pcl_blanks = 0;
-  pcl_line   = malloc(header->cupsWidth / 8 + 1);
-  pcl_comp   = malloc(2 * header->cupsBytesPerLine + 2);
+  pcl_white    = header->cupsBitsPerColor == 1 ? 0 : 255;
+  pcl_blanks   = 0;
+  pcl_bitsize  = header->cupsWidth / 8 + 1;
+  pcl_compsize = 2 * header->cupsBytesPerLine + 2;
+  pcl_lines    = malloc(PCL_BAND_LINES * header->cupsBytesPerLine);
+  pcl_bits     = malloc(PCL_BAND_LINES * pcl_bitsize);
+  pcl_comp     = malloc(PCL_BAND_LINES * pcl_compsize);
+  pcl_lengths  = malloc(PCL_BAND_LINES * sizeof(int));
 
   fprintf(stderr, "ATTR: job-impressions-completed=%d\n", page);
 }
@@ -296,154 +561,76 @@ pcl_to_pcl(const char *filename)	/* I - File to print or NULL for stdin */
 
 
 /*
- * 'pcl_write_line()' - Write a line of raster data.
+ * 'pcl_write_band()' - Convert and write a band of raster data.
  */
 
 static void
-pcl_write_line(
+pcl_write_band(
     cups_page_header2_t *header,	/* I - Raster information */
-    unsigned            y,		/* I - Line number */
-    const unsigned char *line)		/* I - Pixels on line */
+    unsigned            y,		/* I - First line number */
+    unsigned            count)		/* I - Number of lines in band */
 {
-  unsigned	x;			/* Column number */
-  unsigned char	bit,			/* Current bit */
-		byte,			/* Current byte */
-		*outptr,		/* Pointer into output buffer */
-		*outend,		/* End of output buffer */
-		*start,			/* Start of sequence */
-		*compptr;		/* Pointer into compression buffer */
-  unsigned	count;			/* Count of bytes for output */
-  const unsigned char	*ditherline;	/* Pointer into dither table */
+  unsigned	i,			/* Looping var */
+		num_workers;		/* Number of workers */
+  pcl_worker_t	workers[PCL_MAX_THREADS];
+					/* Workers */
+  _cups_thread_t threads[PCL_MAX_THREADS];
+					/* Worker threads */
 
 
-  if (line[0] == pcl_white && !memcmp(line, line + 1, header->cupsBytesPerLine - 1))
-  {
-   /*
-    * Skip blank line...
-    */
+ /*
+  * Split the band between the threads, converting the first part here...
+  */
 
-    pcl_blanks ++;
-    return;
-  }
+  if ((num_workers = pcl_threads) > count)
+    num_workers = count;
 
-  if (header->cupsBitsPerPixel == 1)
+  for (i = 0; i < num_workers; i ++)
   {
-   /*
-    * B&W bitmap data can be used directly...
-    */
-
-    outend = (unsigned char *)line + (pcl_right + 7) / 8;
-    outptr = (unsigned char *)line + pcl_left / 8;
+    workers[i].header = header;
+    workers[i].y      = y;
+    workers[i].first  = i * count / num_workers;
+    workers[i].last   = (i + 1) * count / num_workers;
   }
-  else
-  {
-   /*
-    * Dither 8-bit grayscale to B&W...
-    */
 
-    y &= 63;
-    ditherline = threshold[y];
+  for (i = 1; i < num_workers; i ++)
+    threads[i] = _cupsThreadCreate((_cups_thread_func_t)pcl_band_thread, workers + i);
 
-    for (x = pcl_left, bit = 128, byte = 0, outptr = pcl_line; x <= pcl_right; x ++, line ++)
-    {
-      if (*line <= ditherline[x & 63])
-	byte |= bit;
+  pcl_band_thread(workers);
 
-      if (bit == 1)
-      {
-	*outptr++ = byte;
-	byte      = 0;
-	bit       = 128;
-      }
-      else
-	bit >>= 1;
-    }
-
-    if (bit != 128)
-      *outptr++ = byte;
-
-    outend = outptr;
-    outptr = pcl_line;
+  for (i = 1; i < num_workers; i ++)
+  {
+    if (threads[i])
+      _cupsThreadWait(threads[i]);
+    else
+      pcl_band_thread(workers + i);
   }
 
  /*
-  * Apply compression...
+  * Output the lines in order...
   */
 
-  compptr = pcl_comp;
-
-  while (outptr < outend)
+  for (i = 0; i < count; i ++)
   {
-    if ((outptr + 1) >= outend)
+    if (pcl_lengths[i] < 0)
     {
-     /*
-      * Single byte on the end...
-      */
-
-      *compptr++ = 0x00;
-      *compptr++ = *outptr++;
+      pcl_blanks ++;
+      continue;
     }
-    else if (outptr[0] == outptr[1])
-    {
-     /*
-      * Repeated sequence...
-      */
-
-      outptr ++;
-      count = 2;
-
-      while (outptr < (outend - 1) &&
-	     outptr[0] == outptr[1] &&
-	     count < 127)
-      {
-	outptr ++;
-	count ++;
-      }
 
-      *compptr++ = (unsigned char)(257 - count);
-      *compptr++ = *outptr++;
-    }
-    else
+    if (pcl_blanks > 0)
     {
      /*
-      * Non-repeated sequence...
+      * Skip blank lines first...
       */
 
-      start = outptr;
-      outptr ++;
-      count = 1;
-
-      while (outptr < (outend - 1) &&
-	     outptr[0] != outptr[1] &&
-	     count < 127)
-      {
-	outptr ++;
-	count ++;
-      }
-
-      *compptr++ = (unsigned char)(count - 1);
-
-      memcpy(compptr, start, count);
-      compptr += count;
+      printf("\033*b%dY", pcl_blanks);
+      pcl_blanks = 0;
     }
-  }
 
- /*
-  * Output the line...
-  */
-
-  if (pcl_blanks > 0)
-  {
-   /*
-    * Skip blank lines first...
-    */
-
-    printf("\033*b%dY", pcl_blanks);
-    pcl_blanks = 0;
+    printf("\033*b%dW", pcl_lengths[i]);
+    fwrite(pcl_comp + i * pcl_compsize, 1, (size_t)pcl_lengths[i], stdout);
   }
-
-  printf("\033*b%dW", (int)(compptr - pcl_comp));
-  fwrite(pcl_comp, 1, (size_t)(compptr - pcl_comp), stdout);
 }
 
 
@@ -458,9 +645,13 @@ raster_to_pcl(const char *filename)	/* I - File to print (NULL for stdin) */
   cups_raster_t		*ras;		/* Raster stream */
   cups_page_header2_t	header;		/* Page header */
   unsigned		page = 0,	/* Current page */
-			y;		/* Current line */
-  unsigned char		*line;		/* Line buffer */
-
+			y,		/* Current line */
+			count,		/* Lines in current band */
+			lines = 0;	/* Total lines converted */
+  long			cpus;		/* Number of processors */
+  struct timeval	start,		/* Start time */
+			end;		/* End time */
+  double		secs;		/* Elapsed seconds */
 
 
  /*
@@ -490,6 +681,15 @@ raster_to_pcl(const char *filename)	/* I - File to print (NULL for stdin) */
     return (1);
   }
 
+  if ((cpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    pcl_threads = 1;
+  else if (cpus > PCL_MAX_THREADS)
+    pcl_threads = PCL_MAX_THREADS;
+  else
+    pcl_threads = (unsigned)cpus;
+
+  gettimeofday(&start, NULL);
+
   fputs("\033E", stdout);
 
   while (cupsRasterReadHeader2(ras, &header))
@@ -507,24 +707,38 @@ raster_to_pcl(const char *filename)	/* I - File to print (NULL for stdin) */
       break;
     }
 
-    line = malloc(header.cupsBytesPerLine);
-
     pcl_start_page(&header, page);
-    for (y = 0; y < header.cupsHeight; y ++)
+    for (y = 0; y < header.cupsHeight; y += count)
     {
-      if (cupsRasterReadPixels(ras, line, header.cupsBytesPerLine))
-        pcl_write_line(&header, y, line);
-      else
+     /*
+      * Read a band of lines and then dither and compress them in parallel...
+      */
+
+      for (count = 0; count < PCL_BAND_LINES && (y + count) < header.cupsHeight; count ++)
+      {
+        if (!cupsRasterReadPixels(ras, pcl_lines + count * header.cupsBytesPerLine, header.cupsBytesPerLine))
+          break;
+      }
+
+      if (count > 0)
+        pcl_write_band(&header, y, count);
+
+      lines += count;
+
+      if (count < PCL_BAND_LINES && (y + count) < header.cupsHeight)
         break;
     }
     pcl_end_page(&header, page);
-
-    free(line);
   }
 
   cupsRasterClose(ras);
 
+  gettimeofday(&end, NULL);
+
+  secs = (double)(end.tv_sec - start.tv_sec) + 0.000001 * (double)(end.tv_usec - start.tv_usec);
+
   fprintf(stderr, "ATTR: job-impressions=%d\n", page);
+  fprintf(stderr, "DEBUG: Converted %u lines on %u pages in %.3f seconds (%.0f lines/second) using %u threads.\n", lines, page, secs, secs > 0.0 ? lines / secs : 0.0, pcl_threads);
 
   return (0);
 }
@@ -41,6 +41,9 @@ extern char **environ;
 #  include <sys/fcntl.h>
 #  include <sys/wait.h>
 #  include <poll.h>
+#  ifdef HAVE_EPOLL
+#    include <sys/epoll.h>
+#  endif /* HAVE_EPOLL */
 #endif /* _WIN32 */
 
 #ifdef HAVE_DNSSD
@@ -80,6 +83,9 @@ extern char **environ;
  * Constants...
  */
 
+#define IPPEVE_CLIENT_TIMEOUT	30	/* Seconds before idle clients are closed */
+#define IPPEVE_MAX_WORKERS	256	/* Maximum number of client worker threads */
+
 enum ippeve_preason_e			/* printer-state-reasons bit values */
 {
   IPPEVE_PREASON_NONE = 0x0000,		/* none */
@@ -207,6 +213,17 @@ typedef struct ippeve_printer_s		/**** Printer data ****/
   ippeve_job_t		*active_job;	/* Current active/pending job */
   int			next_job_id;	/* Next job-id value */
   _cups_rwlock_t	rwlock;		/* Printer lock */
+  _cups_mutex_t		queue_mutex;	/* Lock for client/job queues */
+  _cups_cond_t		client_cond,	/* Clients ready for a worker */
+			job_cond;	/* Jobs ready for processing */
+  cups_array_t		*clients,	/* Open client connections */
+			*ready_clients,	/* Clients waiting for a worker */
+			*pending_jobs;	/* Jobs waiting for processing */
+#ifdef HAVE_EPOLL
+  int			epoll_fd;	/* epoll descriptor for connections */
+#else
+  int			wake_pipe[2];	/* Pipe for waking up run_printer */
+#endif /* HAVE_EPOLL */
 } ippeve_printer_t;
 
 struct ippeve_job_s			/**** Job data ****/
@@ -227,7 +244,12 @@ struct ippeve_job_s			/**** Job data ****/
   int			cancel;		/* Non-zero when job canceled */
   char			*filename;	/* Print file name */
   int			fd;		/* Print file descriptor */
+  int			stream_fd;	/* Pipe with streamed document data, -1 if none */
+  int			stream_error;	/* Non-zero if streamed data was incomplete */
+  char			*data;		/* In-memory document data, if any */
+  size_t		datalen;	/* Length of in-memory document data */
   ippeve_printer_t	*printer;	/* Printer */
+  _cups_rwlock_t	rwlock;		/* Job lock */
 };
 
 typedef struct ippeve_client_s		/**** Client data ****/
@@ -246,6 +268,11 @@ typedef struct ippeve_client_s		/**** Client data ****/
 					/* Authenticated username, if any */
   ippeve_printer_t	*printer;	/* Printer */
   ippeve_job_t		*job;		/* Current job, if any */
+  time_t		activity;	/* Time of last activity */
+  int			busy;		/* Non-zero while owned by a worker */
+#ifdef HAVE_SSL
+  int			first_time;	/* First request on connection? */
+#endif /* HAVE_SSL */
 } ippeve_client_t;
 
 
@@ -255,6 +282,7 @@ typedef struct ippeve_client_s		/**** Client data ****/
 
 static http_status_t	authenticate_request(ippeve_client_t *client);
 static void		clean_jobs(ippeve_printer_t *printer);
+static void		close_client(ippeve_client_t *client);
 static int		compare_jobs(ippeve_job_t *a, ippeve_job_t *b);
 static void		copy_attributes(ipp_t *to, ipp_t *from, cups_array_t *ra, ipp_tag_t group_tag, int quickcopy);
 static void		copy_job_attributes(ippeve_client_t *client, ippeve_job_t *job, cups_array_t *ra);
@@ -279,6 +307,9 @@ static void		dnssd_init(void);
 static int		filter_cb(ippeve_filter_t *filter, ipp_t *dst, ipp_attribute_t *attr);
 static ippeve_job_t	*find_job(ippeve_client_t *client);
 static void		finish_document_data(ippeve_client_t *client, ippeve_job_t *job);
+#ifndef _WIN32
+static void		finish_document_stream(ippeve_client_t *client, ippeve_job_t *job);
+#endif /* !_WIN32 */
 static void		finish_document_uri(ippeve_client_t *client, ippeve_job_t *job);
 static void		html_escape(ippeve_client_t *client, const char *s, size_t slen);
 static void		html_footer(ippeve_client_t *client);
@@ -306,11 +337,15 @@ static int		pam_func(int, const struct pam_message **, struct pam_response **, v
 #endif /* HAVE_LIBPAM */
 static int		parse_options(ippeve_client_t *client, cups_option_t **options);
 static void		process_attr_message(ippeve_job_t *job, char *message);
-static void		*process_client(ippeve_client_t *client);
+static int		process_client(ippeve_client_t *client);
+static void		*process_clients(ippeve_printer_t *printer);
 static int		process_http(ippeve_client_t *client);
 static int		process_ipp(ippeve_client_t *client);
-static void		*process_job(ippeve_job_t *job);
+static void		process_job(ippeve_job_t *job);
+static void		*process_jobs(ippeve_printer_t *printer);
 static void		process_state_message(ippeve_job_t *job, char *message);
+static void		queue_client(ippeve_client_t *client);
+static void		queue_job(ippeve_job_t *job);
 static int		register_printer(ippeve_printer_t *printer, const char *subtypes);
 static int		respond_http(ippeve_client_t *client, http_status_t code, const char *content_coding, const char *type, size_t length);
 static void		respond_ipp(ippeve_client_t *client, ipp_status_t status, const char *message, ...) _CUPS_FORMAT(3, 4);
@@ -323,6 +358,10 @@ static char		*time_string(time_t tv, char *buffer, size_t bufsize);
 static void		usage(int status) _CUPS_NORETURN;
 static int		valid_doc_attributes(ippeve_client_t *client);
 static int		valid_job_attributes(ippeve_client_t *client);
+static void		watch_client(ippeve_client_t *client);
+#ifndef _WIN32
+static void		*write_document_data(ippeve_job_t *job);
+#endif /* !_WIN32 */
 
 
 /*
@@ -338,7 +377,11 @@ static AvahiClient	*DNSSDClient = NULL;
 
 static int		KeepFiles = 0,	/* Keep spooled job files? */
 			MaxVersion = 20,/* Maximum IPP version (20 = 2.0, 11 = 1.1, etc.) */
-			Verbosity = 0;	/* Verbosity level */
+			StreamJobs = 0,	/* Pipe documents to the command as they arrive? */
+			Verbosity = 0,	/* Verbosity level */
+			WorkerThreads = 16;
+					/* Number of client worker threads */
+static size_t		MemorySpool = 0;/* Maximum size of documents spooled in memory */
 static const char	*PAMService = NULL;
 					/* PAM service */
 
@@ -392,6 +435,22 @@ main(int  argc,				/* I - Number of command-line args */
     {
       usage(0);
     }
+    else if (!strcmp(argv[i], "--memory-spool"))
+    {
+      long	size;			/* Size in bytes */
+
+      i ++;
+      if (i >= argc)
+        usage(1);
+
+      if ((size = strtol(argv[i], NULL, 10)) <= 0)
+      {
+        _cupsLangPrintf(stderr, _("%s: Bad memory spool size \"%s\"."), "ippeveprinter", argv[i]);
+        usage(1);
+      }
+
+      MemorySpool = (size_t)size;
+    }
     else if (!strcmp(argv[i], "--no-web-forms"))
     {
       web_forms = 0;
@@ -404,11 +463,29 @@ main(int  argc,				/* I - Number of command-line args */
 
       PAMService = argv[i];
     }
+    else if (!strcmp(argv[i], "--stream"))
+    {
+      StreamJobs = 1;
+    }
     else if (!strcmp(argv[i], "--version"))
     {
       puts(CUPS_SVERSION);
       return (0);
     }
+    else if (!strcmp(argv[i], "--worker-threads"))
+    {
+      i ++;
+      if (i >= argc)
+        usage(1);
+
+      WorkerThreads = atoi(argv[i]);
+
+      if (WorkerThreads < 1 || WorkerThreads > IPPEVE_MAX_WORKERS)
+      {
+        _cupsLangPrintf(stderr, _("%s: Bad number of worker threads \"%s\"."), "ippeveprinter", argv[i]);
+        usage(1);
+      }
+    }
     else if (!strncmp(argv[i], "--", 2))
     {
       _cupsLangPrintf(stderr, _("%s: Unknown option \"%s\"."), argv[0], argv[i]);
@@ -713,6 +790,15 @@ main(int  argc,				/* I - Number of command-line args */
   cupsSetServerCredentials(keypath, printer->hostname, 1);
 #endif /* HAVE_SSL */
 
+#ifndef _WIN32
+ /*
+  * Ignore SIGPIPE so that a print command that exits early does not kill us
+  * while we are writing document data to it...
+  */
+
+  signal(SIGPIPE, SIG_IGN);
+#endif /* !_WIN32 */
+
  /*
   * Run the print service...
   */
@@ -850,6 +936,10 @@ clean_jobs(ippeve_printer_t *printer)	/* I - Printer */
        job = (ippeve_job_t *)cupsArrayNext(printer->jobs))
     if (job->completed && job->completed < cleantime)
     {
+      _cupsMutexLock(&(printer->queue_mutex));
+      cupsArrayRemove(printer->pending_jobs, job);
+      _cupsMutexUnlock(&(printer->queue_mutex));
+
       cupsArrayRemove(printer->jobs, job);
       delete_job(job);
     }
@@ -859,6 +949,25 @@ clean_jobs(ippeve_printer_t *printer)	/* I - Printer */
 }
 
 
+/*
+ * 'close_client()' - Stop watching a client connection and delete it.
+ *
+ * The caller must hold the printer's queue_mutex.
+ */
+
+static void
+close_client(ippeve_client_t *client)	/* I - Client */
+{
+  cupsArrayRemove(client->printer->clients, client);
+
+#ifdef HAVE_EPOLL
+  epoll_ctl(client->printer->epoll_fd, EPOLL_CTL_DEL, httpGetFd(client->http), NULL);
+#endif /* HAVE_EPOLL */
+
+  delete_client(client);
+}
+
+
 /*
  * 'compare_jobs()' - Compare two jobs.
  */
@@ -902,6 +1011,8 @@ copy_job_attributes(
     ippeve_job_t    *job,			/* I - Job */
     cups_array_t  *ra)			/* I - requested-attributes */
 {
+  _cupsRWLockRead(&(job->rwlock));
+
   copy_attributes(client->response, job->attrs, ra, IPP_TAG_JOB, 0);
 
   if (!ra || cupsArrayFind(ra, "date-time-at-completed"))
@@ -1052,6 +1163,8 @@ copy_job_attributes(
     ippAddInteger(client->response, IPP_TAG_JOB,
                   job->processing ? IPP_TAG_INTEGER : IPP_TAG_NOVALUE,
                   "time-at-processing", (int)(job->processing - client->printer->start_time));
+
+  _cupsRWUnlock(&(job->rwlock));
 }
 
 
@@ -1093,6 +1206,41 @@ create_client(ippeve_printer_t *printer,	/* I - Printer */
   if (Verbosity)
     fprintf(stderr, "Accepted connection from %s\n", client->hostname);
 
+  client->activity   = time(NULL);
+#ifdef HAVE_SSL
+  client->first_time = 1;
+#endif /* HAVE_SSL */
+
+ /*
+  * Add the client to the list of connections that run_printer watches...
+  */
+
+  _cupsMutexLock(&(printer->queue_mutex));
+
+#ifdef HAVE_EPOLL
+  {
+    struct epoll_event event;		/* Event to watch for */
+
+    event.events   = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = client;
+
+    if (epoll_ctl(printer->epoll_fd, EPOLL_CTL_ADD, httpGetFd(client->http), &event))
+    {
+      perror("Unable to watch client connection");
+
+      _cupsMutexUnlock(&(printer->queue_mutex));
+
+      delete_client(client);
+
+      return (NULL);
+    }
+  }
+#endif /* HAVE_EPOLL */
+
+  cupsArrayAdd(printer->clients, client);
+
+  _cupsMutexUnlock(&(printer->queue_mutex));
+
   return (client);
 }
 
@@ -1130,6 +1278,7 @@ create_job(ippeve_client_t *client)	/* I - Client */
   if ((job = calloc(1, sizeof(ippeve_job_t))) == NULL)
   {
     perror("Unable to allocate memory for job");
+    _cupsRWUnlock(&(client->printer->rwlock));
     return (NULL);
   }
 
@@ -1137,6 +1286,9 @@ create_job(ippeve_client_t *client)	/* I - Client */
   job->attrs      = ippNew();
   job->state      = IPP_JSTATE_HELD;
   job->fd         = -1;
+  job->stream_fd  = -1;
+
+  _cupsRWInit(&(job->rwlock));
 
  /*
   * Copy all of the job attributes...
@@ -1646,6 +1798,15 @@ create_printer(
   printer->state_time    = printer->start_time;
   printer->jobs          = cupsArrayNew((cups_array_func_t)compare_jobs, NULL);
   printer->next_job_id   = 1;
+  printer->clients       = cupsArrayNew(NULL, NULL);
+  printer->ready_clients = cupsArrayNew(NULL, NULL);
+  printer->pending_jobs  = cupsArrayNew(NULL, NULL);
+#ifdef HAVE_EPOLL
+  printer->epoll_fd      = -1;
+#else
+  printer->wake_pipe[0]  = -1;
+  printer->wake_pipe[1]  = -1;
+#endif /* HAVE_EPOLL */
 
   if (servername)
   {
@@ -1659,6 +1820,27 @@ create_printer(
   }
 
   _cupsRWInit(&(printer->rwlock));
+  _cupsMutexInit(&(printer->queue_mutex));
+  _cupsCondInit(&(printer->client_cond));
+  _cupsCondInit(&(printer->job_cond));
+
+ /*
+  * Create the descriptor used to wait for client activity...
+  */
+
+#ifdef HAVE_EPOLL
+  if ((printer->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+  {
+    perror("Unable to create epoll descriptor");
+    goto bad_printer;
+  }
+#else
+  if (pipe(printer->wake_pipe))
+  {
+    perror("Unable to create wakeup pipe");
+    goto bad_printer;
+  }
+#endif /* HAVE_EPOLL */
 
  /*
   * Create the listener sockets...
@@ -2058,6 +2240,12 @@ delete_job(ippeve_job_t *job)		/* I - Job */
     free(job->filename);
   }
 
+  if (job->stream_fd >= 0)
+    close(job->stream_fd);
+
+  if (job->data)
+    free(job->data);
+
   free(job);
 }
 
@@ -2076,6 +2264,16 @@ delete_printer(ippeve_printer_t *printer)	/* I - Printer */
   if (printer->ipv6 >= 0)
     close(printer->ipv6);
 
+#ifdef HAVE_EPOLL
+  if (printer->epoll_fd >= 0)
+    close(printer->epoll_fd);
+#else
+  if (printer->wake_pipe[0] >= 0)
+    close(printer->wake_pipe[0]);
+  if (printer->wake_pipe[1] >= 0)
+    close(printer->wake_pipe[1]);
+#endif /* HAVE_EPOLL */
+
 #if HAVE_DNSSD
   if (printer->printer_ref)
     DNSServiceRefDeallocate(printer->printer_ref);
@@ -2123,6 +2321,9 @@ delete_printer(ippeve_printer_t *printer)	/* I - Printer */
 
   ippDelete(printer->attrs);
   cupsArrayDelete(printer->jobs);
+  cupsArrayDelete(printer->clients);
+  cupsArrayDelete(printer->ready_clients);
+  cupsArrayDelete(printer->pending_jobs);
 
   free(printer);
 }
@@ -2323,25 +2524,104 @@ finish_document_data(
 			buffer[4096];	/* Copy buffer */
   ssize_t		bytes;		/* Bytes read */
   cups_array_t		*ra;		/* Attributes to send in response */
-  _cups_thread_t        t;              /* Thread */
+  char			*data = NULL;	/* In-memory document data */
+  size_t		datalen = 0;	/* Length of in-memory data */
+
+
+#ifndef _WIN32
+ /*
+  * PDF files need to be seekable, everything else can be piped to the print
+  * command as it arrives or kept in memory when small...
+  */
+
+  if (job->printer->command && strcmp(job->format, "application/pdf"))
+  {
+    if (StreamJobs)
+    {
+      finish_document_stream(client, job);
+      return;
+    }
+
+    if (MemorySpool > 0 && (data = malloc(MemorySpool + 1)) != NULL)
+    {
+     /*
+      * Read up to one byte more than the limit so we know whether the document
+      * fits...
+      */
+
+      while (datalen <= MemorySpool && (bytes = httpRead2(client->http, data + datalen, MemorySpool + 1 - datalen)) > 0)
+        datalen += (size_t)bytes;
+
+      if (bytes < 0)
+      {
+        free(data);
 
+        respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to read print file.");
+
+        goto abort_job;
+      }
+
+      if (datalen <= MemorySpool)
+      {
+        if (Verbosity)
+          fprintf(stderr, "Keeping %u byte job file in memory, format \"%s\".\n", (unsigned)datalen, job->format);
+
+        _cupsRWLockWrite(&(job->rwlock));
+
+        job->data    = data;
+        job->datalen = datalen;
+        job->state   = IPP_JSTATE_PENDING;
+
+        _cupsRWUnlock(&(job->rwlock));
+
+        goto queue_document;
+      }
+    }
+  }
+#endif /* !_WIN32 */
 
  /*
   * Create a file for the request data...
-  *
-  * TODO: Update code to support piping large raster data to the print command.
   */
 
   if ((job->fd = create_job_file(job, filename, sizeof(filename), client->printer->directory, NULL)) < 0)
   {
     respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create print file: %s", strerror(errno));
 
+    free(data);
+
     goto abort_job;
   }
 
   if (Verbosity)
     fprintf(stderr, "Created job file \"%s\", format \"%s\".\n", filename, job->format);
 
+  if (data)
+  {
+   /*
+    * Write the data we already read into memory...
+    */
+
+    bytes = (ssize_t)datalen;
+
+    if (write(job->fd, data, datalen) < bytes)
+    {
+      int error = errno;		/* Write error */
+
+      free(data);
+      close(job->fd);
+      job->fd = -1;
+
+      unlink(filename);
+
+      respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to write print file: %s", strerror(error));
+
+      goto abort_job;
+    }
+
+    free(data);
+  }
+
   while ((bytes = httpRead2(client->http, buffer, sizeof(buffer))) > 0)
   {
     if (write(job->fd, buffer, (size_t)bytes) < bytes)
@@ -2388,25 +2668,21 @@ finish_document_data(
     goto abort_job;
   }
 
+  _cupsRWLockWrite(&(job->rwlock));
+
   job->fd       = -1;
   job->filename = strdup(filename);
   job->state    = IPP_JSTATE_PENDING;
 
+  _cupsRWUnlock(&(job->rwlock));
+
  /*
   * Process the job...
   */
 
-  t = _cupsThreadCreate((_cups_thread_func_t)process_job, job);
+  queue_document:
 
-  if (t)
-  {
-    _cupsThreadDetach(t);
-  }
-  else
-  {
-    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to process job.");
-    goto abort_job;
-  }
+  queue_job(job);
 
  /*
   * Return the job info...
@@ -2445,6 +2721,129 @@ finish_document_data(
 }
 
 
+/*
+ * 'finish_document_stream()' - Pipe a document to the print command as it is
+ *                              received.
+ */
+
+#ifndef _WIN32
+static void
+finish_document_stream(
+    ippeve_client_t *client,		/* I - Client */
+    ippeve_job_t    *job)		/* I - Job */
+{
+  int			fds[2];		/* Document pipe */
+  char			buffer[16384];	/* Copy buffer */
+  ssize_t		bytes,		/* Bytes read */
+			written;	/* Bytes written */
+  char			*bufptr;	/* Pointer into buffer */
+  cups_array_t		*ra;		/* Attributes to send in response */
+
+
+ /*
+  * Create the pipe for the document data; the write end must not be inherited
+  * by the print command or it will never see the end of the data...
+  */
+
+  if (pipe(fds))
+  {
+    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create pipe for print file: %s", strerror(errno));
+
+    job->state     = IPP_JSTATE_ABORTED;
+    job->completed = time(NULL);
+
+    ra = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+    cupsArrayAdd(ra, "job-id");
+    cupsArrayAdd(ra, "job-state");
+    cupsArrayAdd(ra, "job-state-reasons");
+    cupsArrayAdd(ra, "job-uri");
+
+    copy_job_attributes(client, job, ra);
+    cupsArrayDelete(ra);
+    return;
+  }
+
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  if (Verbosity)
+    fprintf(stderr, "Streaming job data to print command, format \"%s\".\n", job->format);
+
+  _cupsRWLockWrite(&(job->rwlock));
+
+  job->stream_fd = fds[0];
+  job->state     = IPP_JSTATE_PENDING;
+
+  _cupsRWUnlock(&(job->rwlock));
+
+  queue_job(job);
+
+ /*
+  * Copy the document to the pipe.  If the print command stops reading, keep
+  * reading the request so that we can still send a response...
+  */
+
+  while ((bytes = httpRead2(client->http, buffer, sizeof(buffer))) > 0)
+  {
+    for (bufptr = buffer; fds[1] >= 0 && bytes > 0; bufptr += written, bytes -= written)
+    {
+      if ((written = write(fds[1], bufptr, (size_t)bytes)) < 0)
+      {
+        if (errno == EINTR)
+        {
+          written = 0;
+          continue;
+	}
+
+        fprintf(stderr, "[Job %d] Unable to write to print command: %s\n", job->id, strerror(errno));
+	close(fds[1]);
+	fds[1] = -1;
+	break;
+      }
+    }
+  }
+
+  if (bytes < 0)
+  {
+   /*
+    * Got an error while reading the print data, so abort this job.
+    */
+
+    _cupsRWLockWrite(&(job->rwlock));
+    job->stream_error = 1;
+    _cupsRWUnlock(&(job->rwlock));
+  }
+
+  if (fds[1] >= 0)
+    close(fds[1]);
+
+  if (bytes < 0)
+  {
+    respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to read print file.");
+
+    ra = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+    cupsArrayAdd(ra, "job-id");
+    cupsArrayAdd(ra, "job-state");
+    cupsArrayAdd(ra, "job-state-reasons");
+    cupsArrayAdd(ra, "job-uri");
+  }
+  else
+  {
+    respond_ipp(client, IPP_STATUS_OK, NULL);
+
+    ra = cupsArrayNew((cups_array_func_t)strcmp, NULL);
+    cupsArrayAdd(ra, "job-id");
+    cupsArrayAdd(ra, "job-state");
+    cupsArrayAdd(ra, "job-state-message");
+    cupsArrayAdd(ra, "job-state-reasons");
+    cupsArrayAdd(ra, "job-uri");
+  }
+
+  copy_job_attributes(client, job, ra);
+  cupsArrayDelete(ra);
+}
+#endif /* !_WIN32 */
+
+
 /*
  * 'finish_uri()' - Finish fetching a document URI and start processing.
  */
@@ -2534,7 +2933,7 @@ finish_document_uri(
   * Get the document format for the job...
   */
 
-  _cupsRWLockWrite(&(client->printer->rwlock));
+  _cupsRWLockWrite(&(job->rwlock));
 
   if ((attr = ippFindAttribute(job->attrs, "document-format", IPP_TAG_MIMETYPE)) != NULL)
     job->format = ippGetString(attr, 0, NULL);
@@ -2547,14 +2946,14 @@ finish_document_uri(
 
   if ((job->fd = create_job_file(job, filename, sizeof(filename), client->printer->directory, NULL)) < 0)
   {
-    _cupsRWUnlock(&(client->printer->rwlock));
+    _cupsRWUnlock(&(job->rwlock));
 
     respond_ipp(client, IPP_STATUS_ERROR_INTERNAL, "Unable to create print file: %s", strerror(errno));
 
     goto abort_job;
   }
 
-  _cupsRWUnlock(&(client->printer->rwlock));
+  _cupsRWUnlock(&(job->rwlock));
 
   if (!strcmp(scheme, "file"))
   {
@@ -2677,19 +3076,19 @@ finish_document_uri(
     goto abort_job;
   }
 
-  _cupsRWLockWrite(&(client->printer->rwlock));
+  _cupsRWLockWrite(&(job->rwlock));
 
   job->fd       = -1;
   job->filename = strdup(filename);
   job->state    = IPP_JSTATE_PENDING;
 
-  _cupsRWUnlock(&(client->printer->rwlock));
+  _cupsRWUnlock(&(job->rwlock));
 
  /*
   * Process the job...
   */
 
-  process_job(job);
+  queue_job(job);
 
  /*
   * Return the job info...
@@ -3104,7 +3503,7 @@ ipp_cancel_job(ippeve_client_t *client)	/* I - Client */
         * Cancel the job...
 	*/
 
-	_cupsRWLockWrite(&(client->printer->rwlock));
+	_cupsRWLockWrite(&(job->rwlock));
 
 	if (job->state == IPP_JSTATE_PROCESSING ||
 	    (job->state == IPP_JSTATE_HELD && job->fd >= 0))
@@ -3115,7 +3514,7 @@ ipp_cancel_job(ippeve_client_t *client)	/* I - Client */
 	  job->completed = time(NULL);
 	}
 
-	_cupsRWUnlock(&(client->printer->rwlock));
+	_cupsRWUnlock(&(job->rwlock));
 
 	respond_ipp(client, IPP_STATUS_OK, NULL);
         break;
@@ -3682,7 +4081,7 @@ ipp_send_document(
     httpFlush(client->http);
     return;
   }
-  else if (job->filename || job->fd >= 0)
+  else if (job->filename || job->fd >= 0 || job->data || job->stream_fd >= 0)
   {
     respond_ipp(client, IPP_STATUS_ERROR_MULTIPLE_JOBS_NOT_SUPPORTED, "Multiple document jobs are not supported.");
     httpFlush(client->http);
@@ -3726,7 +4125,7 @@ ipp_send_document(
   * Then finish getting the document data and process things...
   */
 
-  _cupsRWLockWrite(&(client->printer->rwlock));
+  _cupsRWLockWrite(&(job->rwlock));
 
   copy_attributes(job->attrs, client->request, NULL, IPP_TAG_JOB, 0);
 
@@ -3737,7 +4136,7 @@ ipp_send_document(
   else
     job->format = "application/octet-stream";
 
-  _cupsRWUnlock(&(client->printer->rwlock));
+  _cupsRWUnlock(&(job->rwlock));
 
   finish_document_data(client, job);
 }
@@ -3777,7 +4176,7 @@ ipp_send_uri(ippeve_client_t *client)	/* I - Client */
     httpFlush(client->http);
     return;
   }
-  else if (job->filename || job->fd >= 0)
+  else if (job->filename || job->fd >= 0 || job->data || job->stream_fd >= 0)
   {
     respond_ipp(client, IPP_STATUS_ERROR_MULTIPLE_JOBS_NOT_SUPPORTED, "Multiple document jobs are not supported.");
     httpFlush(client->http);
@@ -3817,7 +4216,7 @@ ipp_send_uri(ippeve_client_t *client)	/* I - Client */
   * Then finish getting the document data and process things...
   */
 
-  _cupsRWLockWrite(&(client->printer->rwlock));
+  _cupsRWLockWrite(&(job->rwlock));
 
   copy_attributes(job->attrs, client->request, NULL, IPP_TAG_JOB, 0);
 
@@ -3828,7 +4227,7 @@ ipp_send_uri(ippeve_client_t *client)	/* I - Client */
   else
     job->format = "application/octet-stream";
 
-  _cupsRWUnlock(&(client->printer->rwlock));
+  _cupsRWUnlock(&(job->rwlock));
 
   finish_document_uri(client, job);
 }
@@ -5554,24 +5953,19 @@ process_attr_message(
 
 
 /*
- * 'process_client()' - Process client requests on a thread.
+ * 'process_client()' - Process the pending requests from a client.
+ *
+ * Requests are processed for as long as data is immediately available on the
+ * connection; the client is then handed back to run_printer to wait for more.
  */
 
-static void *				/* O - Exit status */
+static int				/* O - 1 to keep connection open, 0 to close */
 process_client(ippeve_client_t *client)	/* I - Client */
 {
- /*
-  * Loop until we are out of requests or timeout (30 seconds)...
-  */
-
-#ifdef HAVE_SSL
-  int first_time = 1;			/* First time request? */
-#endif /* HAVE_SSL */
-
-  while (httpWait(client->http, 30000))
+  do
   {
 #ifdef HAVE_SSL
-    if (first_time)
+    if (client->first_time)
     {
      /*
       * See if we need to negotiate a TLS connection...
@@ -5586,25 +5980,67 @@ process_client(ippeve_client_t *client)	/* I - Client */
 	if (httpEncryption(client->http, HTTP_ENCRYPTION_ALWAYS))
 	{
 	  fprintf(stderr, "%s Unable to encrypt connection: %s\n", client->hostname, cupsLastErrorString());
-	  break;
+	  return (0);
         }
 
         fprintf(stderr, "%s Connection now encrypted.\n", client->hostname);
       }
 
-      first_time = 0;
+      client->first_time = 0;
     }
 #endif /* HAVE_SSL */
 
     if (!process_http(client))
-      break;
+      return (0);
   }
+  while (httpWait(client->http, 0));
 
- /*
-  * Close the conection to the client and return...
-  */
+  return (1);
+}
 
-  delete_client(client);
+
+/*
+ * 'process_clients()' - Process ready clients on a worker thread.
+ */
+
+static void *				/* O - Thread exit status */
+process_clients(
+    ippeve_printer_t *printer)		/* I - Printer */
+{
+  ippeve_client_t	*client;	/* Current client */
+
+
+  for (;;)
+  {
+   /*
+    * Wait for run_printer to queue a client with pending data...
+    */
+
+    _cupsMutexLock(&(printer->queue_mutex));
+
+    while ((client = (ippeve_client_t *)cupsArrayFirst(printer->ready_clients)) == NULL)
+      _cupsCondWait(&(printer->client_cond), &(printer->queue_mutex), 0.0);
+
+    cupsArrayRemove(printer->ready_clients, client);
+
+    _cupsMutexUnlock(&(printer->queue_mutex));
+
+   /*
+    * Process requests, then either watch for the next request or close the
+    * connection...
+    */
+
+    if (process_client(client))
+    {
+      watch_client(client);
+    }
+    else
+    {
+      _cupsMutexLock(&(printer->queue_mutex));
+      close_client(client);
+      _cupsMutexUnlock(&(printer->queue_mutex));
+    }
+  }
 
   return (NULL);
 }
@@ -6203,13 +6639,17 @@ process_ipp(ippeve_client_t *client)	/* I - Client */
  * 'process_job()' - Process a print job.
  */
 
-static void *				/* O - Thread exit status */
+static void
 process_job(ippeve_job_t *job)		/* I - Job */
 {
+  _cupsRWLockWrite(&(job->rwlock));
+
   job->state          = IPP_JSTATE_PROCESSING;
   job->printer->state = IPP_PSTATE_PROCESSING;
   job->processing     = time(NULL);
 
+  _cupsRWUnlock(&(job->rwlock));
+
   while (job->printer->state_reasons & IPPEVE_PREASON_MEDIA_EMPTY)
   {
     job->printer->state_reasons |= IPPEVE_PREASON_MEDIA_NEEDED;
@@ -6236,15 +6676,19 @@ process_job(ippeve_job_t *job)		/* I - Job */
     char		val[1280],	/* IPP_NAME=value */
 			*valptr;	/* Pointer into string */
 #ifndef _WIN32
+    int			mystdin = -1;	/* File for stdin */
     int			mystdout = -1;	/* File for stdout */
     int			mypipe[2];	/* Pipe for stderr */
+    int			datapipe[2] = { -1, -1 };
+					/* Pipe for in-memory document data */
+    _cups_thread_t	datathread = 0;	/* Thread writing in-memory data */
     char		line[2048],	/* Line from stderr */
 			*ptr,		/* Pointer into line */
 			*endptr;	/* End of line */
     ssize_t		bytes;		/* Bytes read */
 #endif /* !_WIN32 */
 
-    fprintf(stderr, "[Job %d] Running command \"%s %s\".\n", job->id, job->printer->command, job->filename);
+    fprintf(stderr, "[Job %d] Running command \"%s %s\".\n", job->id, job->printer->command, job->filename ? job->filename : "-");
     gettimeofday(&start, NULL);
 
    /*
@@ -6266,6 +6710,7 @@ process_job(ippeve_job_t *job)		/* I - Job */
     if (myenvc > (int)(sizeof(myenvp) / sizeof(myenvp[0]) - 32))
     {
       fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
+      _cupsRWLockWrite(&(job->rwlock));
       job->state = IPP_JSTATE_ABORTED;
       goto error;
     }
@@ -6364,6 +6809,7 @@ process_job(ippeve_job_t *job)		/* I - Job */
     if (attr)
     {
       fprintf(stderr, "[Job %d] Too many environment variables to process job.\n", job->id);
+      _cupsRWLockWrite(&(job->rwlock));
       job->state = IPP_JSTATE_ABORTED;
       goto error;
     }
@@ -6453,6 +6899,29 @@ process_job(ippeve_job_t *job)		/* I - Job */
     if (mystdout < 0)
       mystdout = open("/dev/null", O_WRONLY);
 
+   /*
+    * Streamed and in-memory documents are read by the command from stdin...
+    */
+
+    if (job->stream_fd >= 0)
+    {
+      mystdin        = job->stream_fd;
+      job->stream_fd = -1;
+    }
+    else if (job->data)
+    {
+      if (pipe(datapipe))
+      {
+        fprintf(stderr, "[Job %d] Unable to create pipe for stdin: %s\n", job->id, strerror(errno));
+        datapipe[0] = datapipe[1] = -1;
+      }
+      else
+      {
+        fcntl(datapipe[1], F_SETFD, FD_CLOEXEC);
+        mystdin = datapipe[0];
+      }
+    }
+
     if (pipe(mypipe))
     {
       fprintf(stderr, "[Job %d] Unable to create pipe for stderr: %s\n", job->id, strerror(errno));
@@ -6465,6 +6934,13 @@ process_job(ippeve_job_t *job)		/* I - Job */
       * Child comes here...
       */
 
+      if (mystdin >= 0)
+      {
+        close(0);
+        dup2(mystdin, 0);
+        close(mystdin);
+      }
+
       close(1);
       dup2(mystdout, 1);
       close(mystdout);
@@ -6490,6 +6966,11 @@ process_job(ippeve_job_t *job)		/* I - Job */
       close(mypipe[0]);
       close(mypipe[1]);
 
+      if (mystdin >= 0)
+        close(mystdin);
+      if (datapipe[1] >= 0)
+        close(datapipe[1]);
+
      /*
       * Free memory used for environment...
       */
@@ -6507,11 +6988,27 @@ process_job(ippeve_job_t *job)		/* I - Job */
 	free(myenvp[-- myenvc]);
 
      /*
-      * Close the output file in the parent process...
+      * Close the output file in the parent process and start sending any
+      * in-memory document data...
       */
 
       close(mystdout);
 
+      if (mystdin >= 0)
+        close(mystdin);
+
+      if (datapipe[1] >= 0)
+      {
+        job->fd = datapipe[1];
+
+        if ((datathread = _cupsThreadCreate((_cups_thread_func_t)write_document_data, job)) == 0)
+        {
+          fprintf(stderr, "[Job %d] Unable to start thread for document data: %s\n", job->id, strerror(errno));
+          close(datapipe[1]);
+          job->fd = -1;
+	}
+      }
+
      /*
       * If the pipe exists, read from it until EOF...
       */
@@ -6603,6 +7100,9 @@ process_job(ippeve_job_t *job)		/* I - Job */
 #  else
       while (wait(&status) < 0);
 #  endif /* HAVE_WAITPID */
+
+      if (datathread)
+        _cupsThreadWait(datathread);
     }
 #endif /* _WIN32 */
 
@@ -6640,17 +7140,67 @@ process_job(ippeve_job_t *job)		/* I - Job */
     sleep((unsigned)(5 + (CUPS_RAND() % 11)));
   }
 
+  _cupsRWLockWrite(&(job->rwlock));
+
   if (job->cancel)
     job->state = IPP_JSTATE_CANCELED;
+  else if (job->stream_error)
+    job->state = IPP_JSTATE_ABORTED;
   else if (job->state == IPP_JSTATE_PROCESSING)
     job->state = IPP_JSTATE_COMPLETED;
 
+  if (job->data)
+  {
+    free(job->data);
+    job->data    = NULL;
+    job->datalen = 0;
+  }
+
   error:
 
   job->completed           = time(NULL);
   job->printer->state      = IPP_PSTATE_IDLE;
   job->printer->active_job = NULL;
 
+  _cupsRWUnlock(&(job->rwlock));
+}
+
+
+/*
+ * 'process_jobs()' - Process queued jobs on the job thread.
+ */
+
+static void *				/* O - Thread exit status */
+process_jobs(ippeve_printer_t *printer)	/* I - Printer */
+{
+  ippeve_job_t	*job;			/* Current job */
+  int		pending;		/* Is the job still pending? */
+
+
+  for (;;)
+  {
+    _cupsMutexLock(&(printer->queue_mutex));
+
+    while ((job = (ippeve_job_t *)cupsArrayFirst(printer->pending_jobs)) == NULL)
+      _cupsCondWait(&(printer->job_cond), &(printer->queue_mutex), 0.0);
+
+    cupsArrayRemove(printer->pending_jobs, job);
+
+   /*
+    * Check the job state while holding queue_mutex so that clean_jobs cannot
+    * free a job that was canceled while it was queued...
+    */
+
+    _cupsRWLockRead(&(job->rwlock));
+    pending = job->state == IPP_JSTATE_PENDING;
+    _cupsRWUnlock(&(job->rwlock));
+
+    _cupsMutexUnlock(&(printer->queue_mutex));
+
+    if (pending)
+      process_job(job);
+  }
+
   return (NULL);
 }
 
@@ -6744,6 +7294,48 @@ process_state_message(
 }
 
 
+/*
+ * 'queue_client()' - Queue a client with pending data for a worker thread.
+ */
+
+static void
+queue_client(ippeve_client_t *client)	/* I - Client */
+{
+  ippeve_printer_t	*printer = client->printer;
+					/* Printer */
+
+
+  _cupsMutexLock(&(printer->queue_mutex));
+
+  client->busy = 1;
+
+  cupsArrayAdd(printer->ready_clients, client);
+  _cupsCondBroadcast(&(printer->client_cond));
+
+  _cupsMutexUnlock(&(printer->queue_mutex));
+}
+
+
+/*
+ * 'queue_job()' - Queue a pending job for the job thread.
+ */
+
+static void
+queue_job(ippeve_job_t *job)		/* I - Job */
+{
+  ippeve_printer_t	*printer = job->printer;
+					/* Printer */
+
+
+  _cupsMutexLock(&(printer->queue_mutex));
+
+  cupsArrayAdd(printer->pending_jobs, job);
+  _cupsCondBroadcast(&(printer->job_cond));
+
+  _cupsMutexUnlock(&(printer->queue_mutex));
+}
+
+
 /*
  * 'register_printer()' - Register a printer object via Bonjour.
  */
@@ -7194,28 +7786,74 @@ respond_unsupported(
 static void
 run_printer(ippeve_printer_t *printer)	/* I - Printer */
 {
-  int		num_fds;		/* Number of file descriptors */
-  struct pollfd	polldata[3];		/* poll() data */
-  int		timeout;		/* Timeout for poll() */
-  ippeve_client_t	*client;		/* New client */
+  int		i,			/* Looping var */
+		num_clients,		/* Number of client connections */
+		timeout;		/* Timeout for poll() */
+  time_t	now,			/* Current time */
+		last_expire = 0;	/* Last check for idle clients */
+  _cups_thread_t t;			/* Job or worker thread */
+  ippeve_client_t	*client;		/* Current client */
+#ifdef HAVE_EPOLL
+  int		num_events;		/* Number of events */
+  struct epoll_event events[64],	/* epoll() events */
+		event;			/* Event to watch for */
+#else
+  int		num_fds,		/* Number of file descriptors */
+		alloc_fds = 0;		/* Allocated file descriptors */
+  struct pollfd	*polldata = NULL,	/* poll() data */
+		*pollptr;		/* Pointer into poll() data */
+  ippeve_client_t **pollclients = NULL;	/* Client for each poll() entry */
+  char		buffer[256];		/* Wakeup data */
+#endif /* HAVE_EPOLL */
 
 
  /*
-  * Setup poll() data for the Bonjour service socket and IPv4/6 listeners...
+  * Start the job thread and a bounded pool of client worker threads...
   */
 
-  polldata[0].fd     = printer->ipv4;
-  polldata[0].events = POLLIN;
+  if ((t = _cupsThreadCreate((_cups_thread_func_t)process_jobs, printer)) == 0)
+  {
+    perror("Unable to create job thread");
+    return;
+  }
 
-  polldata[1].fd     = printer->ipv6;
-  polldata[1].events = POLLIN;
+  _cupsThreadDetach(t);
 
-  num_fds = 2;
+  for (i = 0; i < WorkerThreads; i ++)
+  {
+    if ((t = _cupsThreadCreate((_cups_thread_func_t)process_clients, printer)) == 0)
+    {
+      perror("Unable to create client thread");
 
-#ifdef HAVE_DNSSD
-  polldata[num_fds   ].fd     = DNSServiceRefSockFD(DNSSDMaster);
-  polldata[num_fds ++].events = POLLIN;
-#endif /* HAVE_DNSSD */
+      if (i == 0)
+        return;
+
+      break;
+    }
+
+    _cupsThreadDetach(t);
+  }
+
+  if (Verbosity)
+    fprintf(stderr, "Started %d client worker threads.\n", i);
+
+#ifdef HAVE_EPOLL
+ /*
+  * Watch the IPv4/6 listeners and Bonjour service socket...
+  */
+
+  event.events   = EPOLLIN;
+  event.data.ptr = &(printer->ipv4);
+  epoll_ctl(printer->epoll_fd, EPOLL_CTL_ADD, printer->ipv4, &event);
+
+  event.data.ptr = &(printer->ipv6);
+  epoll_ctl(printer->epoll_fd, EPOLL_CTL_ADD, printer->ipv6, &event);
+
+#  ifdef HAVE_DNSSD
+  event.data.ptr = &DNSSDMaster;
+  epoll_ctl(printer->epoll_fd, EPOLL_CTL_ADD, DNSServiceRefSockFD(DNSSDMaster), &event);
+#  endif /* HAVE_DNSSD */
+#endif /* HAVE_EPOLL */
 
  /*
   * Loop until we are killed or have a hard error...
@@ -7223,11 +7861,101 @@ run_printer(ippeve_printer_t *printer)	/* I - Printer */
 
   for (;;)
   {
+    _cupsMutexLock(&(printer->queue_mutex));
+
+    num_clients = cupsArrayCount(printer->clients);
+
+#ifndef HAVE_EPOLL
+   /*
+    * Setup poll() data for the listeners, wakeup pipe, Bonjour service socket,
+    * and any clients that are waiting for their next request...
+    */
+
+    if (alloc_fds < (num_clients + 4))
+    {
+      alloc_fds = num_clients + 64;
+
+      if ((pollptr = realloc(polldata, (size_t)alloc_fds * sizeof(struct pollfd))) == NULL)
+      {
+        perror("Unable to allocate memory for poll() data");
+        _cupsMutexUnlock(&(printer->queue_mutex));
+        break;
+      }
+
+      polldata = pollptr;
+
+      if ((pollclients = realloc(pollclients, (size_t)alloc_fds * sizeof(ippeve_client_t *))) == NULL)
+      {
+        perror("Unable to allocate memory for poll() data");
+        _cupsMutexUnlock(&(printer->queue_mutex));
+        break;
+      }
+    }
+
+    polldata[0].fd     = printer->ipv4;
+    polldata[0].events = POLLIN;
+
+    polldata[1].fd     = printer->ipv6;
+    polldata[1].events = POLLIN;
+
+    polldata[2].fd     = printer->wake_pipe[0];
+    polldata[2].events = POLLIN;
+
+    num_fds = 3;
+
+#  ifdef HAVE_DNSSD
+    polldata[num_fds   ].fd     = DNSServiceRefSockFD(DNSSDMaster);
+    polldata[num_fds ++].events = POLLIN;
+#  endif /* HAVE_DNSSD */
+
+    for (client = (ippeve_client_t *)cupsArrayFirst(printer->clients); client; client = (ippeve_client_t *)cupsArrayNext(printer->clients))
+    {
+      if (client->busy)
+        continue;
+
+      pollclients[num_fds]       = client;
+      polldata[num_fds   ].fd     = httpGetFd(client->http);
+      polldata[num_fds ++].events = POLLIN;
+    }
+
+    for (i = 0; i < num_fds; i ++)
+      polldata[i].revents = 0;
+#endif /* !HAVE_EPOLL */
+
+    _cupsMutexUnlock(&(printer->queue_mutex));
+
     if (cupsArrayCount(printer->jobs))
       timeout = 10;
+    else if (num_clients > 0)
+      timeout = 1000;
     else
       timeout = -1;
 
+#ifdef HAVE_EPOLL
+    if ((num_events = epoll_wait(printer->epoll_fd, events, (int)(sizeof(events) / sizeof(events[0])), timeout)) < 0)
+    {
+      if (errno != EINTR)
+      {
+        perror("epoll_wait() failed");
+        break;
+      }
+
+      num_events = 0;
+    }
+
+    for (i = 0; i < num_events; i ++)
+    {
+      if (events[i].data.ptr == &(printer->ipv4) || events[i].data.ptr == &(printer->ipv6))
+        create_client(printer, *((int *)events[i].data.ptr));
+#  ifdef HAVE_DNSSD
+      else if (events[i].data.ptr == &DNSSDMaster)
+        DNSServiceProcessResult(DNSSDMaster);
+#  endif /* HAVE_DNSSD */
+      else
+        queue_client((ippeve_client_t *)events[i].data.ptr);
+    }
+
+#else
     if (poll(polldata, (nfds_t)num_fds, timeout) < 0 && errno != EINTR)
     {
       perror("poll() failed");
@@ -7235,45 +7963,54 @@ run_printer(ippeve_printer_t *printer)	/* I - Printer */
     }
 
     if (polldata[0].revents & POLLIN)
+      create_client(printer, printer->ipv4);
+
+    if (polldata[1].revents & POLLIN)
+      create_client(printer, printer->ipv6);
+
+    if (polldata[2].revents & POLLIN)
     {
-      if ((client = create_client(printer, printer->ipv4)) != NULL)
-      {
-        _cups_thread_t t = _cupsThreadCreate((_cups_thread_func_t)process_client, client);
+     /*
+      * A worker finished with a client; drain the pipe so the client gets
+      * added to the next poll()...
+      */
 
-        if (t)
-        {
-          _cupsThreadDetach(t);
-        }
-        else
-	{
-	  perror("Unable to create client thread");
-	  delete_client(client);
-	}
-      }
+      if (read(printer->wake_pipe[0], buffer, sizeof(buffer)) < 0)
+        perror("Unable to read from wakeup pipe");
     }
 
-    if (polldata[1].revents & POLLIN)
+#  ifdef HAVE_DNSSD
+    if (polldata[3].revents & POLLIN)
+      DNSServiceProcessResult(DNSSDMaster);
+
+    i = 4;
+#  else
+    i = 3;
+#  endif /* HAVE_DNSSD */
+
+    for (; i < num_fds; i ++)
+      if (polldata[i].revents)
+        queue_client(pollclients[i]);
+#endif /* HAVE_EPOLL */
+
+   /*
+    * Close connections that have been idle for too long...
+    */
+
+    if ((now = time(NULL)) != last_expire)
     {
-      if ((client = create_client(printer, printer->ipv6)) != NULL)
-      {
-        _cups_thread_t t = _cupsThreadCreate((_cups_thread_func_t)process_client, client);
+      _cupsMutexLock(&(printer->queue_mutex));
 
-        if (t)
-        {
-          _cupsThreadDetach(t);
-        }
-        else
-	{
-	  perror("Unable to create client thread");
-	  delete_client(client);
-	}
+      for (client = (ippeve_client_t *)cupsArrayFirst(printer->clients); client; client = (ippeve_client_t *)cupsArrayNext(printer->clients))
+      {
+        if (!client->busy && client->activity < (now - IPPEVE_CLIENT_TIMEOUT))
+          close_client(client);
       }
-    }
 
-#ifdef HAVE_DNSSD
-    if (polldata[2].revents & POLLIN)
-      DNSServiceProcessResult(DNSSDMaster);
-#endif /* HAVE_DNSSD */
+      _cupsMutexUnlock(&(printer->queue_mutex));
+
+      last_expire = now;
+    }
 
    /*
     * Clean out old jobs...
@@ -7281,6 +8018,11 @@ run_printer(ippeve_printer_t *printer)	/* I - Printer */
 
     clean_jobs(printer);
   }
+
+#ifndef HAVE_EPOLL
+  free(polldata);
+  free(pollclients);
+#endif /* !HAVE_EPOLL */
 }
 
 
@@ -7921,9 +8663,12 @@ usage(int status)			/* O - Exit status */
   _cupsLangPuts(stdout, _("Usage: ippeveprinter [options] \"name\""));
   _cupsLangPuts(stdout, _("Options:"));
   _cupsLangPuts(stdout, _("--help                  Show program help"));
+  _cupsLangPuts(stdout, _("--memory-spool BYTES    Keep documents up to BYTES in memory"));
   _cupsLangPuts(stdout, _("--no-web-forms          Disable web forms for media and supplies"));
   _cupsLangPuts(stdout, _("--pam-service service   Use the named PAM service"));
+  _cupsLangPuts(stdout, _("--stream                Pipe documents to the print command as they arrive"));
   _cupsLangPuts(stdout, _("--version               Show program version"));
+  _cupsLangPuts(stdout, _("--worker-threads N      Set number of client worker threads (default=16)"));
   _cupsLangPuts(stdout, _("-2                      Set 2-sided printing support (default=1-sided)"));
   _cupsLangPuts(stdout, _("-A                      Enable authentication"));
   _cupsLangPuts(stdout, _("-D device-uri           Set the device URI for the printer"));
@@ -8415,3 +9160,78 @@ valid_job_attributes(
 
   return (valid);
 }
+
+
+/*
+ * 'watch_client()' - Hand a client back to run_printer to wait for its next
+ *                    request.
+ */
+
+static void
+watch_client(ippeve_client_t *client)	/* I - Client */
+{
+  ippeve_printer_t	*printer = client->printer;
+					/* Printer */
+
+
+  _cupsMutexLock(&(printer->queue_mutex));
+
+  client->activity = time(NULL);
+  client->busy     = 0;
+
+#ifdef HAVE_EPOLL
+  {
+    struct epoll_event event;		/* Event to watch for */
+
+    event.events   = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = client;
+
+    if (epoll_ctl(printer->epoll_fd, EPOLL_CTL_MOD, httpGetFd(client->http), &event))
+    {
+      perror("Unable to watch client connection");
+      close_client(client);
+    }
+  }
+#else
+  if (write(printer->wake_pipe[1], "", 1) < 0)
+    perror("Unable to write to wakeup pipe");
+#endif /* HAVE_EPOLL */
+
+  _cupsMutexUnlock(&(printer->queue_mutex));
+}
+
+
+#ifndef _WIN32
+/*
+ * 'write_document_data()' - Write in-memory document data to the print command.
+ */
+
+static void *				/* O - Thread exit status */
+write_document_data(ippeve_job_t *job)	/* I - Job */
+{
+  const char	*dataptr = job->data;	/* Pointer into data */
+  size_t	datalen = job->datalen;	/* Bytes remaining */
+  ssize_t	bytes;			/* Bytes written */
+
+
+  while (datalen > 0)
+  {
+    if ((bytes = write(job->fd, dataptr, datalen)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      fprintf(stderr, "[Job %d] Unable to write to print command: %s\n", job->id, strerror(errno));
+      break;
+    }
+
+    dataptr += bytes;
+    datalen -= (size_t)bytes;
+  }
+
+  close(job->fd);
+  job->fd = -1;
+
+  return (NULL);
+}
+#endif /* !_WIN32 */
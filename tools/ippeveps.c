@@ -508,8 +508,7 @@ get_options(cups_option_t **options)	/* O - Options */
     * Mark the PPD with the options...
     */
 
-    ppdMarkDefaults(ppd);
-    cupsMarkOptions(ppd, num_options, *options);
+    _ppdMarkDefaultsAndOptions(ppd, num_options, *options);
   }
 #endif /* !CUPS_LITE */
 
@@ -15,6 +15,7 @@
 
 #define _CUPS_NO_DEPRECATED
 #include <cups/cups-private.h>
+#include <sys/stat.h>
 #ifdef _WIN32
 #  include <process.h>
 #  include <sys/timeb.h>
@@ -115,9 +116,18 @@ typedef struct ippfind_srv_s		/* Service information */
   int		port,			/* Port number */
 		is_local,		/* Is a local service? */
 		is_processed,		/* Did we process the service? */
+		is_queued,		/* Queued for evaluation? */
 		is_resolved;		/* Got the resolve data? */
 } ippfind_srv_t;
 
+typedef struct ippfind_cache_s		/* Cached --ls result */
+{
+  char		*uri,			/* Service URI */
+		*line;			/* Output line */
+  time_t	time;			/* Time of probe */
+  int		ok;			/* Was the service available? */
+} ippfind_cache_t;
+
 
 /*
  * Local globals...
@@ -137,6 +147,22 @@ static int	address_family = AF_UNSPEC;
 static int	bonjour_error = 0;	/* Error browsing/resolving? */
 static double	bonjour_timeout = 1.0;	/* Timeout in seconds */
 static int	ipp_version = 20;	/* IPP version for LIST */
+static int	max_concurrency = 0;	/* Maximum concurrent resolves/evaluations, 0 = default */
+static int	cache_time = 0;		/* Maximum age of cached LIST results, 0 = no cache */
+static cups_array_t *cache = NULL;	/* Cached LIST results */
+static int	cache_changed = 0;	/* Have the cached results changed? */
+static cups_array_t *eval_queue = NULL;	/* Services waiting for evaluation */
+static ippfind_expr_t *eval_expressions = NULL;
+					/* Expressions to evaluate */
+static int	eval_active = 0,	/* Number of services being evaluated */
+		eval_max = 1,		/* Maximum concurrent evaluations */
+		eval_status = IPPFIND_EXIT_FALSE,
+					/* Result of evaluations */
+		eval_workers = 0;	/* Number of evaluation threads */
+static _cups_mutex_t eval_mutex = _CUPS_MUTEX_INITIALIZER;
+					/* Mutex for evaluation queue/cache */
+static _cups_cond_t eval_cond = _CUPS_COND_INITIALIZER;
+					/* Condition for evaluation changes */
 
 
 /*
@@ -161,18 +187,23 @@ static void		client_callback(AvahiClient *client,
 					void *context);
 #endif /* HAVE_AVAHI */
 
+static int		compare_cache(ippfind_cache_t *a, ippfind_cache_t *b);
 static int		compare_services(ippfind_srv_t *a, ippfind_srv_t *b);
 static const char	*dnssd_error_string(int error);
 static int		eval_expr(ippfind_srv_t *service,
 			          ippfind_expr_t *expressions);
+static void		*eval_thread(void *data);
 static int		exec_program(ippfind_srv_t *service, int num_args,
 			             char **args);
 static ippfind_srv_t	*get_service(cups_array_t *services, const char *serviceName, const char *regtype, const char *replyDomain) _CUPS_NONNULL(1,2,3,4);
 static double		get_time(void);
 static int		list_service(ippfind_srv_t *service);
+static void		load_cache(void);
 static ippfind_expr_t	*new_expr(ippfind_op_t op, int invert,
 			          const char *value, const char *regex,
 			          char **args);
+static int		probe_service(ippfind_srv_t *service, char *line, size_t linesize);
+static void		queue_service(ippfind_srv_t *service);
 #ifdef HAVE_DNSSD
 static void DNSSD_API	resolve_callback(DNSServiceRef sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, DNSServiceErrorType errorCode, const char *fullName, const char *hostTarget, uint16_t port, uint16_t txtLen, const unsigned char *txtRecord, void *context) _CUPS_NONNULL(1,5,6,9, 10);
 #elif defined(HAVE_AVAHI)
@@ -193,6 +224,7 @@ static void		resolve_callback(AvahiServiceResolver *res,
 					 AvahiLookupResultFlags flags,
 					 void *context);
 #endif /* HAVE_DNSSD */
+static void		save_cache(void);
 static void		set_service_uri(ippfind_srv_t *service);
 static void		show_usage(void) _CUPS_NORETURN;
 static void		show_version(void) _CUPS_NORETURN;
@@ -207,6 +239,7 @@ main(int  argc,				/* I - Number of command-line args */
      char *argv[])			/* I - Command-line arguments */
 {
   int			i,		/* Looping var */
+			have_exec = 0,	/* Have exec expression */
 			have_output = 0,/* Have output expression */
 			status = IPPFIND_EXIT_FALSE;
 					/* Exit status */
@@ -305,6 +338,30 @@ main(int  argc,				/* I - Number of command-line args */
 
 	  temp = NULL;
         }
+        else if (!strcmp(argv[i], "--cache"))
+        {
+          i ++;
+          if (i >= argc || (cache_time = atoi(argv[i])) <= 0)
+          {
+            _cupsLangPrintf(stderr, _("ippfind: Expected cache time after %s."),
+                            "--cache");
+            show_usage();
+          }
+
+	  temp = NULL;
+        }
+        else if (!strcmp(argv[i], "--concurrency"))
+        {
+          i ++;
+          if (i >= argc || (max_concurrency = atoi(argv[i])) <= 0)
+          {
+            _cupsLangPrintf(stderr, _("ippfind: Expected count after %s."),
+                            "--concurrency");
+            show_usage();
+          }
+
+	  temp = NULL;
+        }
         else if (!strcmp(argv[i], "--domain"))
         {
           i ++;
@@ -347,6 +404,7 @@ main(int  argc,				/* I - Number of command-line args */
             show_usage();
           }
 
+          have_exec   = 1;
           have_output = 1;
         }
         else if (!strcmp(argv[i], "--false"))
@@ -912,6 +970,7 @@ main(int  argc,				/* I - Number of command-line args */
 		  show_usage();
 		}
 
+		have_exec   = 1;
 		have_output = 1;
                 break;
 
@@ -1292,9 +1351,23 @@ main(int  argc,				/* I - Number of command-line args */
   }
 
  /*
-  * Process browse/resolve requests...
+  * Process browse/resolve requests, evaluating the expressions for resolved
+  * services on a pool of threads.  Programs run by --exec could depend on
+  * running one at a time, so only run them concurrently when asked...
   */
 
+  if (max_concurrency > 0)
+    eval_max = max_concurrency;
+  else if (have_exec)
+    eval_max = 1;
+  else
+    eval_max = 50;
+
+  eval_expressions = expressions;
+
+  if (cache_time > 0)
+    load_cache();
+
   if (bonjour_timeout > 1.0)
     endtime = get_time() + bonjour_timeout;
   else
@@ -1367,6 +1440,8 @@ main(int  argc,				/* I - Number of command-line args */
 		resolved = 0,		/* Number of resolved services */
 		processed = 0;		/* Number of processed services */
 
+      _cupsMutexLock(&eval_mutex);
+
       for (service = (ippfind_srv_t *)cupsArrayFirst(services);
            service;
            service = (ippfind_srv_t *)cupsArrayNext(services))
@@ -1380,10 +1455,11 @@ main(int  argc,				/* I - Number of command-line args */
         if (!service->ref && !service->is_resolved)
         {
          /*
-          * Found a service, now resolve it (but limit to 50 active resolves...)
+          * Found a service, now resolve it (but limit the number of active
+          * resolves...)
           */
 
-          if (active < 50)
+          if (active < (max_concurrency > 0 ? max_concurrency : 50))
           {
 #ifdef HAVE_DNSSD
 	    service->ref = dnssd_ref;
@@ -1420,10 +1496,11 @@ main(int  argc,				/* I - Number of command-line args */
 	    active ++;
           }
         }
-        else if (service->is_resolved && !service->is_processed)
+        else if (service->is_resolved && !service->is_queued)
         {
 	 /*
-	  * Resolved, not process this service against the expressions...
+	  * Resolved, now queue this service for evaluation against the
+	  * expressions...
 	  */
 
           if (service->ref)
@@ -1437,15 +1514,14 @@ main(int  argc,				/* I - Number of command-line args */
 	    service->ref = NULL;
 	  }
 
-          if (eval_expr(service, expressions))
-            status = IPPFIND_EXIT_TRUE;
-
-          service->is_processed = 1;
+          queue_service(service);
         }
         else if (service->ref)
           active ++;
       }
 
+      _cupsMutexUnlock(&eval_mutex);
+
      /*
       * If we have processed all services we have discovered, then we are done.
       */
@@ -1455,6 +1531,22 @@ main(int  argc,				/* I - Number of command-line args */
     }
   }
 
+ /*
+  * Wait for any evaluations that are still running...
+  */
+
+  _cupsMutexLock(&eval_mutex);
+
+  while (eval_workers > 0)
+    _cupsCondWait(&eval_cond, &eval_mutex, 0.0);
+
+  status = eval_status;
+
+  _cupsMutexUnlock(&eval_mutex);
+
+  if (cache_changed)
+    save_cache();
+
   if (bonjour_error)
     return (IPPFIND_EXIT_BONJOUR);
   else
@@ -1617,6 +1709,18 @@ client_callback(
 #endif /* HAVE_AVAHI */
 
 
+/*
+ * 'compare_cache()' - Compare two cached results.
+ */
+
+static int				/* O - Result of comparison */
+compare_cache(ippfind_cache_t *a,	/* I - First result */
+              ippfind_cache_t *b)	/* I - Second result */
+{
+  return (strcmp(a->uri, b->uri));
+}
+
+
 /*
  * 'compare_services()' - Compare two devices.
  */
@@ -1863,6 +1967,62 @@ eval_expr(ippfind_srv_t  *service,	/* I - Service */
 }
 
 
+/*
+ * 'eval_thread()' - Evaluate queued services against the expressions.
+ */
+
+static void *				/* O - Thread exit status */
+eval_thread(void *data)			/* I - Thread data (unused) */
+{
+  ippfind_srv_t	*service;		/* Current service */
+  int		result;			/* Result of evaluation */
+
+
+  (void)data;
+
+  for (;;)
+  {
+   /*
+    * Get the next service from the queue, exiting when there are no more...
+    */
+
+    _cupsMutexLock(&eval_mutex);
+
+    if ((service = (ippfind_srv_t *)cupsArrayFirst(eval_queue)) == NULL)
+    {
+      eval_workers --;
+      _cupsCondBroadcast(&eval_cond);
+      _cupsMutexUnlock(&eval_mutex);
+      break;
+    }
+
+    cupsArrayRemove(eval_queue, service);
+    eval_active ++;
+
+    _cupsMutexUnlock(&eval_mutex);
+
+   /*
+    * Evaluate and record the result...
+    */
+
+    result = eval_expr(service, eval_expressions);
+
+    _cupsMutexLock(&eval_mutex);
+
+    if (result)
+      eval_status = IPPFIND_EXIT_TRUE;
+
+    service->is_processed = 1;
+    eval_active --;
+
+    _cupsCondBroadcast(&eval_cond);
+    _cupsMutexUnlock(&eval_mutex);
+  }
+
+  return (NULL);
+}
+
+
 /*
  * 'exec_program()' - Execute a program for a service.
  */
@@ -2085,7 +2245,7 @@ exec_program(ippfind_srv_t *service,	/* I - Service */
     * Wait for it to complete...
     */
 
-    while (wait(&status) != pid)
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
       ;
   }
 #endif /* _WIN32 */
@@ -2211,6 +2371,261 @@ get_time(void)
 
 static int				/* O - 1 if successful, 0 otherwise */
 list_service(ippfind_srv_t *service)	/* I - Service */
+{
+  int			ok;		/* Is the service available? */
+  char			line[2048];	/* Status line */
+  ippfind_cache_t	key,		/* Search key */
+			*entry;		/* Cached result */
+  time_t		curtime = time(NULL);
+					/* Current time */
+
+
+ /*
+  * Use a recent cached result when available...
+  */
+
+  key.uri = service->uri;
+
+  if (cache_time > 0)
+  {
+    _cupsMutexLock(&eval_mutex);
+
+    if ((entry = (ippfind_cache_t *)cupsArrayFind(cache, &key)) != NULL && entry->time > (curtime - cache_time))
+    {
+      strlcpy(line, entry->line, sizeof(line));
+      ok = entry->ok;
+
+      _cupsMutexUnlock(&eval_mutex);
+
+      _cupsLangPuts(stdout, line);
+
+      return (ok);
+    }
+
+    _cupsMutexUnlock(&eval_mutex);
+  }
+
+ /*
+  * Otherwise probe the service and cache the result...
+  */
+
+  ok = probe_service(service, line, sizeof(line));
+
+  if (cache_time > 0)
+  {
+    _cupsMutexLock(&eval_mutex);
+
+    if (!cache)
+      cache = cupsArrayNew((cups_array_func_t)compare_cache, NULL);
+
+    if ((entry = (ippfind_cache_t *)cupsArrayFind(cache, &key)) != NULL)
+    {
+      free(entry->line);
+    }
+    else if ((entry = (ippfind_cache_t *)calloc(1, sizeof(ippfind_cache_t))) != NULL)
+    {
+      entry->uri = strdup(service->uri);
+      cupsArrayAdd(cache, entry);
+    }
+
+    if (entry)
+    {
+      entry->line   = strdup(line);
+      entry->time   = curtime;
+      entry->ok     = ok;
+      cache_changed = 1;
+    }
+
+    _cupsMutexUnlock(&eval_mutex);
+  }
+
+  _cupsLangPuts(stdout, line);
+
+  return (ok);
+}
+
+
+/*
+ * 'load_cache()' - Load cached --ls results.
+ */
+
+static void
+load_cache(void)
+{
+  _cups_globals_t	*cg = _cupsGlobals();
+					/* Global data */
+  char			filename[1024],	/* Cache filename */
+			line[2048],	/* Line from file */
+			*ptr,		/* Pointer into line */
+			*uri;		/* URI from line */
+  cups_file_t		*fp;		/* Cache file */
+  ippfind_cache_t	*entry;		/* Cached result */
+  time_t		curtime = time(NULL),
+					/* Current time */
+			ltime;		/* Time from line */
+  int			ok;		/* Available from line */
+
+
+  if (!cg->home)
+    return;
+
+  snprintf(filename, sizeof(filename), "%s/.cups/ippfind.cache", cg->home);
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL)
+    return;
+
+  cache = cupsArrayNew((cups_array_func_t)compare_cache, NULL);
+
+ /*
+  * Each line is "time ok uri status-line"...
+  */
+
+  while (cupsFileGets(fp, line, sizeof(line)))
+  {
+    ltime = (time_t)strtol(line, &ptr, 10);
+    ok    = (int)strtol(ptr, &ptr, 10);
+
+    while (*ptr == ' ')
+      ptr ++;
+
+    uri = ptr;
+
+    if ((ptr = strchr(ptr, ' ')) == NULL || ltime <= (curtime - cache_time))
+      continue;
+
+    *ptr++ = '\0';
+
+    if ((entry = (ippfind_cache_t *)calloc(1, sizeof(ippfind_cache_t))) == NULL)
+      break;
+
+    entry->uri  = strdup(uri);
+    entry->line = strdup(ptr);
+    entry->time = ltime;
+    entry->ok   = ok;
+
+    cupsArrayAdd(cache, entry);
+  }
+
+  cupsFileClose(fp);
+}
+
+
+/*
+ * 'new_expr()' - Create a new expression.
+ */
+
+static ippfind_expr_t *			/* O - New expression */
+new_expr(ippfind_op_t op,		/* I - Operation */
+         int          invert,		/* I - Invert result? */
+         const char   *value,		/* I - TXT key or port range */
+	 const char   *regex,		/* I - Regular expression */
+	 char         **args)		/* I - Pointer to argument strings */
+{
+  ippfind_expr_t	*temp;		/* New expression */
+
+
+  if ((temp = calloc(1, sizeof(ippfind_expr_t))) == NULL)
+    return (NULL);
+
+  temp->op = op;
+  temp->invert = invert;
+
+  if (op == IPPFIND_OP_TXT_EXISTS || op == IPPFIND_OP_TXT_REGEX || op == IPPFIND_OP_NAME_LITERAL)
+    temp->name = (char *)value;
+  else if (op == IPPFIND_OP_PORT_RANGE)
+  {
+   /*
+    * Pull port number range of the form "number", "-number" (0-number),
+    * "number-" (number-65535), and "number-number".
+    */
+
+    if (*value == '-')
+    {
+      temp->range[1] = atoi(value + 1);
+    }
+    else if (strchr(value, '-'))
+    {
+      if (sscanf(value, "%d-%d", temp->range, temp->range + 1) == 1)
+        temp->range[1] = 65535;
+    }
+    else
+    {
+      temp->range[0] = temp->range[1] = atoi(value);
+    }
+  }
+
+  if (regex)
+  {
+    int err = regcomp(&(temp->re), regex, REG_NOSUB | REG_ICASE | REG_EXTENDED);
+
+    if (err)
+    {
+      char	message[256];		/* Error message */
+
+      regerror(err, &(temp->re), message, sizeof(message));
+      _cupsLangPrintf(stderr, _("ippfind: Bad regular expression: %s"),
+                      message);
+      exit(IPPFIND_EXIT_SYNTAX);
+    }
+  }
+
+  if (args)
+  {
+    int	num_args;			/* Number of arguments */
+
+    for (num_args = 1; args[num_args]; num_args ++)
+      if (!strcmp(args[num_args], ";"))
+        break;
+
+     temp->num_args = num_args;
+     temp->args     = malloc((size_t)num_args * sizeof(char *));
+     memcpy(temp->args, args, (size_t)num_args * sizeof(char *));
+  }
+
+  return (temp);
+}
+
+
+#ifdef HAVE_AVAHI
+/*
+ * 'poll_callback()' - Wait for input on the specified file descriptors.
+ *
+ * Note: This function is needed because avahi_simple_poll_iterate is broken
+ *       and always uses a timeout of 0 (!) milliseconds.
+ *       (Avahi Ticket #364)
+ */
+
+static int				/* O - Number of file descriptors matching */
+poll_callback(
+    struct pollfd *pollfds,		/* I - File descriptors */
+    unsigned int  num_pollfds,		/* I - Number of file descriptors */
+    int           timeout,		/* I - Timeout in milliseconds (unused) */
+    void          *context)		/* I - User data (unused) */
+{
+  int	val;				/* Return value */
+
+
+  (void)timeout;
+  (void)context;
+
+  val = poll(pollfds, num_pollfds, 500);
+
+  if (val > 0)
+    avahi_got_data = 1;
+
+  return (val);
+}
+#endif /* HAVE_AVAHI */
+
+
+/*
+ * 'probe_service()' - Get the current status of a service.
+ */
+
+static int				/* O - 1 if successful, 0 otherwise */
+probe_service(ippfind_srv_t *service,	/* I - Service */
+              char          *line,	/* I - Status line buffer */
+              size_t        linesize)	/* I - Size of status line buffer */
 {
   http_addrlist_t	*addrlist;	/* Address(es) of service */
   char			port[10];	/* Port number of service */
@@ -2220,7 +2635,7 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
   if ((addrlist = httpAddrGetList(service->host, address_family, port)) == NULL)
   {
-    _cupsLangPrintf(stdout, "%s unreachable", service->uri);
+    snprintf(line, linesize, "%s unreachable", service->uri);
     return (0);
   }
 
@@ -2264,7 +2679,7 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
     if (!http)
     {
-      _cupsLangPrintf(stdout, "%s unavailable", service->uri);
+      snprintf(line, linesize, "%s unavailable", service->uri);
       return (0);
     }
 
@@ -2300,7 +2715,7 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
     if (cupsLastError() > IPP_STATUS_OK_EVENTS_COMPLETE)
     {
-      _cupsLangPrintf(stdout, "%s: unavailable", service->uri);
+      snprintf(line, linesize, "%s: unavailable", service->uri);
       return (0);
     }
 
@@ -2336,7 +2751,7 @@ list_service(ippfind_srv_t *service)	/* I - Service */
     ippDelete(response);
     httpClose(http);
 
-    _cupsLangPrintf(stdout, "%s %s %s %s", service->uri, ippEnumString("printer-state", (int)pstate), paccepting ? "accepting-jobs" : "not-accepting-jobs", preasons);
+    snprintf(line, linesize, "%s %s %s %s", service->uri, ippEnumString("printer-state", (int)pstate), paccepting ? "accepting-jobs" : "not-accepting-jobs", preasons);
   }
   else if (!strncmp(service->regtype, "_http._tcp", 10) ||
            !strncmp(service->regtype, "_https._tcp", 11))
@@ -2363,13 +2778,13 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
     if (!http)
     {
-      _cupsLangPrintf(stdout, "%s unavailable", service->uri);
+      snprintf(line, linesize, "%s unavailable", service->uri);
       return (0);
     }
 
     if (httpGet(http, service->resource))
     {
-      _cupsLangPrintf(stdout, "%s unavailable", service->uri);
+      snprintf(line, linesize, "%s unavailable", service->uri);
       return (0);
     }
 
@@ -2384,11 +2799,11 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
     if (status >= HTTP_STATUS_BAD_REQUEST)
     {
-      _cupsLangPrintf(stdout, "%s unavailable", service->uri);
+      snprintf(line, linesize, "%s unavailable", service->uri);
       return (0);
     }
 
-    _cupsLangPrintf(stdout, "%s available", service->uri);
+    snprintf(line, linesize, "%s available", service->uri);
   }
   else if (!strncmp(service->regtype, "_printer._tcp", 13))
   {
@@ -2401,19 +2816,19 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
     if (!httpAddrConnect(addrlist, &sock))
     {
-      _cupsLangPrintf(stdout, "%s unavailable", service->uri);
+      snprintf(line, linesize, "%s unavailable", service->uri);
       httpAddrFreeList(addrlist);
       return (0);
     }
 
-    _cupsLangPrintf(stdout, "%s available", service->uri);
+    snprintf(line, linesize, "%s available", service->uri);
     httpAddrFreeList(addrlist);
 
     httpAddrClose(NULL, sock);
   }
   else
   {
-    _cupsLangPrintf(stdout, "%s unsupported", service->uri);
+    snprintf(line, linesize, "%s unsupported", service->uri);
     httpAddrFreeList(addrlist);
     return (0);
   }
@@ -2423,111 +2838,49 @@ list_service(ippfind_srv_t *service)	/* I - Service */
 
 
 /*
- * 'new_expr()' - Create a new expression.
+ * 'queue_service()' - Queue a service for evaluation.
+ *
+ * The caller must hold the evaluation mutex.
  */
 
-static ippfind_expr_t *			/* O - New expression */
-new_expr(ippfind_op_t op,		/* I - Operation */
-         int          invert,		/* I - Invert result? */
-         const char   *value,		/* I - TXT key or port range */
-	 const char   *regex,		/* I - Regular expression */
-	 char         **args)		/* I - Pointer to argument strings */
+static void
+queue_service(ippfind_srv_t *service)	/* I - Service */
 {
-  ippfind_expr_t	*temp;		/* New expression */
+  _cups_thread_t	thread;		/* Evaluation thread */
 
 
-  if ((temp = calloc(1, sizeof(ippfind_expr_t))) == NULL)
-    return (NULL);
-
-  temp->op = op;
-  temp->invert = invert;
+  if (!eval_queue)
+    eval_queue = cupsArrayNew(NULL, NULL);
 
-  if (op == IPPFIND_OP_TXT_EXISTS || op == IPPFIND_OP_TXT_REGEX || op == IPPFIND_OP_NAME_LITERAL)
-    temp->name = (char *)value;
-  else if (op == IPPFIND_OP_PORT_RANGE)
-  {
-   /*
-    * Pull port number range of the form "number", "-number" (0-number),
-    * "number-" (number-65535), and "number-number".
-    */
+  cupsArrayAdd(eval_queue, service);
+  service->is_queued = 1;
 
-    if (*value == '-')
-    {
-      temp->range[1] = atoi(value + 1);
-    }
-    else if (strchr(value, '-'))
-    {
-      if (sscanf(value, "%d-%d", temp->range, temp->range + 1) == 1)
-        temp->range[1] = 65535;
-    }
-    else
-    {
-      temp->range[0] = temp->range[1] = atoi(value);
-    }
-  }
+  if (eval_workers >= eval_max)
+    return;
 
-  if (regex)
+  if ((thread = _cupsThreadCreate(eval_thread, NULL)) != 0)
   {
-    int err = regcomp(&(temp->re), regex, REG_NOSUB | REG_ICASE | REG_EXTENDED);
-
-    if (err)
-    {
-      char	message[256];		/* Error message */
-
-      regerror(err, &(temp->re), message, sizeof(message));
-      _cupsLangPrintf(stderr, _("ippfind: Bad regular expression: %s"),
-                      message);
-      exit(IPPFIND_EXIT_SYNTAX);
-    }
+    _cupsThreadDetach(thread);
+    eval_workers ++;
   }
-
-  if (args)
+  else if (eval_workers == 0)
   {
-    int	num_args;			/* Number of arguments */
-
-    for (num_args = 1; args[num_args]; num_args ++)
-      if (!strcmp(args[num_args], ";"))
-        break;
-
-     temp->num_args = num_args;
-     temp->args     = malloc((size_t)num_args * sizeof(char *));
-     memcpy(temp->args, args, (size_t)num_args * sizeof(char *));
-  }
-
-  return (temp);
-}
-
-
-#ifdef HAVE_AVAHI
-/*
- * 'poll_callback()' - Wait for input on the specified file descriptors.
- *
- * Note: This function is needed because avahi_simple_poll_iterate is broken
- *       and always uses a timeout of 0 (!) milliseconds.
- *       (Avahi Ticket #364)
- */
-
-static int				/* O - Number of file descriptors matching */
-poll_callback(
-    struct pollfd *pollfds,		/* I - File descriptors */
-    unsigned int  num_pollfds,		/* I - Number of file descriptors */
-    int           timeout,		/* I - Timeout in milliseconds (unused) */
-    void          *context)		/* I - User data (unused) */
-{
-  int	val;				/* Return value */
+   /*
+    * Unable to start a thread, evaluate the service here...
+    */
 
+    cupsArrayRemove(eval_queue, service);
 
-  (void)timeout;
-  (void)context;
+    _cupsMutexUnlock(&eval_mutex);
 
-  val = poll(pollfds, num_pollfds, 500);
+    if (eval_expr(service, eval_expressions))
+      eval_status = IPPFIND_EXIT_TRUE;
 
-  if (val > 0)
-    avahi_got_data = 1;
+    _cupsMutexLock(&eval_mutex);
 
-  return (val);
+    service->is_processed = 1;
+  }
 }
-#endif /* HAVE_AVAHI */
 
 
 /*
@@ -2690,6 +3043,47 @@ resolve_callback(
 #endif /* HAVE_DNSSD */
 
 
+/*
+ * 'save_cache()' - Save cached --ls results.
+ */
+
+static void
+save_cache(void)
+{
+  _cups_globals_t	*cg = _cupsGlobals();
+					/* Global data */
+  char			filename[1024],	/* Cache filename */
+			tempfile[1024];	/* Temporary filename */
+  cups_file_t		*fp;		/* Cache file */
+  ippfind_cache_t	*entry;		/* Cached result */
+  time_t		curtime = time(NULL);
+					/* Current time */
+
+
+  if (!cg->home)
+    return;
+
+  snprintf(filename, sizeof(filename), "%s/.cups", cg->home);
+  if (mkdir(filename, 0700) && errno != EEXIST)
+    return;
+
+  snprintf(filename, sizeof(filename), "%s/.cups/ippfind.cache", cg->home);
+  snprintf(tempfile, sizeof(tempfile), "%s/.cups/ippfind.cache.N", cg->home);
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+    return;
+
+  for (entry = (ippfind_cache_t *)cupsArrayFirst(cache); entry; entry = (ippfind_cache_t *)cupsArrayNext(cache))
+  {
+    if (entry->line && entry->time > (curtime - cache_time))
+      cupsFilePrintf(fp, "%ld %d %s %s\n", (long)entry->time, entry->ok, entry->uri, entry->line);
+  }
+
+  if (cupsFileClose(fp) || rename(tempfile, filename))
+    unlink(tempfile);
+}
+
+
 /*
  * 'set_service_uri()' - Set the URI of the service.
  */
@@ -2767,6 +3161,8 @@ show_usage(void)
   _cupsLangPuts(stderr, _("-6                      Connect using IPv6"));
   _cupsLangPuts(stderr, _("-T seconds              Set the browse timeout in seconds"));
   _cupsLangPuts(stderr, _("-V version              Set default IPP version"));
+  _cupsLangPuts(stderr, _("--cache seconds         Reuse --ls results up to this many seconds old"));
+  _cupsLangPuts(stderr, _("--concurrency count     Set the number of concurrent resolves and evaluations"));
   _cupsLangPuts(stderr, _("--version               Show program version"));
   _cupsLangPuts(stderr, _("Expressions:"));
   _cupsLangPuts(stderr, _("-P number[-number]      Match port to number or range"));
@@ -96,6 +96,28 @@ typedef struct _cups_status_s		/**** Status info ****/
 		repeat_no_match;	/* Repeat the test when it matches */
 } _cups_status_t;
 
+typedef struct _cups_loadop_s		/**** Load statistics for an operation ****/
+{
+  ipp_op_t	op;			/* Operation code */
+  int		errors;			/* Number of failed requests */
+  size_t	num_samples,		/* Number of latency samples */
+		alloc_samples;		/* Allocated latency samples */
+  double	*samples;		/* Latency samples in seconds */
+} _cups_loadop_t;
+
+typedef struct _cups_load_s		/**** Load generation data ****/
+{
+  int		num_threads;		/* Number of concurrent connections */
+  double	rate,			/* Target requests per second (0 = unlimited) */
+		warmup,			/* Warmup time in seconds */
+		duration,		/* Measurement time in seconds */
+		start,			/* Start of measurement */
+		end;			/* End of measurement */
+  int		stop;			/* Stop generating load? */
+  _cups_mutex_t	mutex;			/* Lock for statistics */
+  cups_array_t	*ops;			/* Statistics for each operation */
+} _cups_load_t;
+
 typedef struct _cups_testdata_s		/**** Test Data ****/
 {
   /* Global Options */
@@ -123,6 +145,8 @@ typedef struct _cups_testdata_s		/**** Test Data ****/
 		pass_count,		/* Number of tests that passed */
 		fail_count,		/* Number of tests that failed */
 		skip_count;		/* Number of tests that were skipped */
+  _cups_load_t	*load;			/* Load generation data, if any */
+  double	load_next;		/* Time of next request in load mode */
 
   /* Per-Test State */
   cups_array_t	*errors;		/* Errors array */
@@ -152,6 +176,15 @@ typedef struct _cups_testdata_s		/**** Test Data ****/
   int		version;		/* IPP version number to use */
 } _cups_testdata_t;
 
+typedef struct _cups_loadthread_s	/**** Load generation thread ****/
+{
+  _cups_load_t	*load;			/* Load generation data */
+  const char	*testfile;		/* Test file to use */
+  _ipp_vars_t	vars;			/* Variables */
+  _cups_testdata_t data;		/* Test data */
+  _cups_thread_t thread;		/* Thread */
+} _cups_loadthread_t;
+
 
 /*
  * Globals...
@@ -165,16 +198,24 @@ static int	Cancel = 0;		/* Cancel test? */
  */
 
 static void	add_stringf(cups_array_t *a, const char *s, ...) _CUPS_FORMAT(2, 3);
+static int	compare_latencies(const double *a, const double *b);
+static int	compare_loadops(_cups_loadop_t *a, _cups_loadop_t *b);
 static int      compare_uris(const char *a, const char *b);
+static http_t	*connect_printer(_ipp_vars_t *vars, _cups_testdata_t *data);
 static void	copy_hex_string(char *buffer, unsigned char *data, int datalen, size_t bufsize);
+static int	do_load(const char *testfile, _ipp_vars_t *vars, _cups_testdata_t *data, _cups_load_t *load);
 static int	do_test(_ipp_file_t *f, _ipp_vars_t *vars, _cups_testdata_t *data);
 static int	do_tests(const char *testfile, _ipp_vars_t *vars, _cups_testdata_t *data);
 static int	error_cb(_ipp_file_t *f, _cups_testdata_t *data, const char *error);
 static int      expect_matches(_cups_expect_t *expect, ipp_tag_t value_tag);
 static char	*get_filename(const char *testfile, char *dst, const char *src, size_t dstsize);
 static const char *get_string(ipp_attribute_t *attr, int element, int flags, char *buffer, size_t bufsize);
+static double	get_time(void);
 static void	init_data(_cups_testdata_t *data);
 static char	*iso_date(const ipp_uchar_t *date);
+static void	load_record(_cups_testdata_t *data, ipp_op_t op, double start, ipp_t *response);
+static void	*load_thread(_cups_loadthread_t *lt);
+static void	load_wait(_cups_testdata_t *data);
 static void	pause_message(const char *message);
 static void	print_attr(cups_file_t *outfile, _cups_output_t output, ipp_attribute_t *attr, ipp_tag_t *group);
 static void	print_csv(_cups_testdata_t *data, ipp_t *ipp, ipp_attribute_t *attr, int num_displayed, char **displayed, size_t *widths);
@@ -182,6 +223,8 @@ static void	print_fatal_error(_cups_testdata_t *data, const char *s, ...) _CUPS_
 static void	print_ippserver_attr(_cups_testdata_t *data, ipp_attribute_t *attr, int indent);
 static void	print_ippserver_string(_cups_testdata_t *data, const char *s, size_t len);
 static void	print_line(_cups_testdata_t *data, ipp_t *ipp, ipp_attribute_t *attr, int num_displayed, char **displayed, size_t *widths);
+static void	print_load_report(_cups_testdata_t *data, _cups_load_t *load);
+static void	print_load_stats(_cups_testdata_t *data, const char *name, _cups_loadop_t *lop, double elapsed);
 static void	print_xml_header(_cups_testdata_t *data);
 static void	print_xml_string(cups_file_t *outfile, const char *element, const char *s);
 static void	print_xml_trailer(_cups_testdata_t *data, int success, const char *message);
@@ -217,6 +260,7 @@ main(int  argc,				/* I - Number of command-line args */
 			repeat;		/* Repeat count */
   _cups_testdata_t	data;		/* Test data */
   _ipp_vars_t		vars;		/* Variables */
+  _cups_load_t		load;		/* Load generation settings */
   _cups_globals_t	*cg = _cupsGlobals();
 					/* Global data */
 
@@ -238,6 +282,9 @@ main(int  argc,				/* I - Number of command-line args */
 
   init_data(&data);
 
+  memset(&load, 0, sizeof(load));
+  load.duration = 10.0;
+
   _ippVarsInit(&vars, NULL, (_ipp_ferror_cb_t)error_cb, (_ipp_ftoken_cb_t)token_cb);
 
   _ippVarsSet(&vars, "date-start", iso_date(ippTimeToDate(time(NULL))));
@@ -280,6 +327,36 @@ main(int  argc,				/* I - Number of command-line args */
 
       data.output = _CUPS_OUTPUT_IPPSERVER;
     }
+    else if (!strcmp(argv[i], "--duration"))
+    {
+      i ++;
+
+      if (i >= argc || (load.duration = _cupsStrScand(argv[i], NULL, localeconv())) <= 0.0)
+      {
+	_cupsLangPuts(stderr, _("ipptool: Missing or bad seconds for \"--duration\"."));
+	usage();
+      }
+    }
+    else if (!strcmp(argv[i], "--load"))
+    {
+      i ++;
+
+      if (i >= argc || (load.num_threads = atoi(argv[i])) <= 0)
+      {
+	_cupsLangPuts(stderr, _("ipptool: Missing or bad count for \"--load\"."));
+	usage();
+      }
+    }
+    else if (!strcmp(argv[i], "--rate"))
+    {
+      i ++;
+
+      if (i >= argc || (load.rate = _cupsStrScand(argv[i], NULL, localeconv())) <= 0.0)
+      {
+	_cupsLangPuts(stderr, _("ipptool: Missing or bad rate for \"--rate\"."));
+	usage();
+      }
+    }
     else if (!strcmp(argv[i], "--stop-after-include-error"))
     {
       data.stop_after_include_error = 1;
@@ -289,6 +366,16 @@ main(int  argc,				/* I - Number of command-line args */
       puts(CUPS_SVERSION);
       return (0);
     }
+    else if (!strcmp(argv[i], "--warmup"))
+    {
+      i ++;
+
+      if (i >= argc || (load.warmup = _cupsStrScand(argv[i], NULL, localeconv())) < 0.0)
+      {
+	_cupsLangPuts(stderr, _("ipptool: Missing or bad seconds for \"--warmup\"."));
+	usage();
+      }
+    }
     else if (argv[i][0] == '-')
     {
       for (opt = argv[i] + 1; *opt; opt ++)
@@ -666,7 +753,18 @@ main(int  argc,				/* I - Number of command-line args */
       else
         testfile = argv[i];
 
-      if (!do_tests(testfile, &vars, &data))
+      if (load.num_threads > 0)
+      {
+        if (data.output == _CUPS_OUTPUT_PLIST || data.output == _CUPS_OUTPUT_IPPSERVER || interval || repeat)
+        {
+	  _cupsLangPuts(stderr, _("ipptool: \"--load\" is incompatible with \"--ippserver\", \"-P\", \"-X\", \"-i\", and \"-n\"."));
+	  usage();
+        }
+
+        if (!do_load(testfile, &vars, &data, &load))
+          status = 1;
+      }
+      else if (!do_tests(testfile, &vars, &data))
         status = 1;
     }
   }
@@ -753,6 +851,35 @@ add_stringf(cups_array_t *a,		/* I - Array */
 }
 
 
+/*
+ * 'compare_latencies()' - Compare two latency samples.
+ */
+
+static int				/* O - Result of comparison */
+compare_latencies(const double *a,	/* I - First sample */
+                  const double *b)	/* I - Second sample */
+{
+  if (*a < *b)
+    return (-1);
+  else if (*a > *b)
+    return (1);
+  else
+    return (0);
+}
+
+
+/*
+ * 'compare_loadops()' - Compare the operation codes of two load statistics.
+ */
+
+static int				/* O - Result of comparison */
+compare_loadops(_cups_loadop_t *a,	/* I - First operation */
+                _cups_loadop_t *b)	/* I - Second operation */
+{
+  return ((int)a->op - (int)b->op);
+}
+
+
 /*
  * 'compare_uris()' - Compare two URIs...
  */
@@ -818,6 +945,42 @@ compare_uris(const char *a,             /* I - First URI */
 }
 
 
+/*
+ * 'connect_printer()' - Connect to the printer/server.
+ */
+
+static http_t *				/* O - HTTP connection or `NULL` on error */
+connect_printer(_ipp_vars_t      *vars,	/* I - Variables */
+                _cups_testdata_t *data)	/* I - Test data */
+{
+  http_t		*http;		/* HTTP connection */
+  http_encryption_t	encryption;	/* Encryption mode */
+
+
+  if (!_cups_strcasecmp(vars->scheme, "https") || !_cups_strcasecmp(vars->scheme, "ipps"))
+    encryption = HTTP_ENCRYPTION_ALWAYS;
+  else
+    encryption = data->encryption;
+
+  if ((http = httpConnect2(vars->host, vars->port, NULL, data->family, encryption, 1, 30000, NULL)) == NULL)
+  {
+    print_fatal_error(data, "Unable to connect to \"%s\" on port %d - %s", vars->host, vars->port, cupsLastErrorString());
+    return (NULL);
+  }
+
+#ifdef HAVE_LIBZ
+  httpSetDefaultField(http, HTTP_FIELD_ACCEPT_ENCODING, "deflate, gzip, identity");
+#else
+  httpSetDefaultField(http, HTTP_FIELD_ACCEPT_ENCODING, "identity");
+#endif /* HAVE_LIBZ */
+
+  if (data->timeout > 0.0)
+    httpSetTimeout(http, data->timeout, timeout_cb, NULL);
+
+  return (http);
+}
+
+
 /*
  * 'copy_hex_string()' - Copy an octetString to a C string and encode as hex if
  *                       needed.
@@ -881,6 +1044,143 @@ copy_hex_string(char          *buffer,	/* I - String buffer */
 }
 
 
+/*
+ * 'do_load()' - Run a test file repeatedly over concurrent connections and
+ *               report the throughput and latency of each operation.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+do_load(const char       *testfile,	/* I - Test file to use */
+        _ipp_vars_t      *vars,		/* I - Variables */
+        _cups_testdata_t *data,		/* I - Test data */
+        _cups_load_t     *load)		/* I - Load generation settings */
+{
+  int			i,		/* Looping var */
+			num_started,	/* Number of threads started */
+			status = 1;	/* Return status */
+  _cups_loadthread_t	*threads,	/* Load generation threads */
+			*lt;		/* Current thread */
+  cups_option_t		*var;		/* Current variable */
+  _cups_loadop_t	*lop;		/* Current operation statistics */
+  double		now;		/* Current time */
+
+
+  if ((threads = calloc((size_t)load->num_threads, sizeof(_cups_loadthread_t))) == NULL)
+  {
+    print_fatal_error(data, "Unable to allocate memory for %d connections.", load->num_threads);
+    return (0);
+  }
+
+  _cupsMutexInit(&(load->mutex));
+
+  now         = get_time();
+  load->ops   = cupsArrayNew((cups_array_func_t)compare_loadops, NULL);
+  load->stop  = 0;
+  load->start = now + load->warmup;
+  load->end   = load->start + load->duration;
+
+ /*
+  * Give each thread its own copy of the variables and test data, then start
+  * them.  Requests are spread evenly over the interval when a rate is set...
+  */
+
+  for (num_started = 0, lt = threads; num_started < load->num_threads; num_started ++, lt ++)
+  {
+    lt->load     = load;
+    lt->testfile = testfile;
+
+    memcpy(&(lt->vars), vars, sizeof(_ipp_vars_t));
+
+    lt->vars.uri      = strdup(vars->uri);
+    lt->vars.num_vars = 0;
+    lt->vars.vars     = NULL;
+
+    if (vars->password)
+      lt->vars.password = lt->vars.username + (vars->password - vars->username);
+
+    for (i = vars->num_vars, var = vars->vars; i > 0; i --, var ++)
+      _ippVarsSet(&(lt->vars), var->name, var->value);
+
+    init_data(&(lt->data));
+
+    lt->data.encryption               = data->encryption;
+    lt->data.family                   = data->family;
+    lt->data.output                   = _CUPS_OUTPUT_QUIET;
+    lt->data.stop_after_include_error = data->stop_after_include_error;
+    lt->data.timeout                  = data->timeout;
+    lt->data.validate_headers         = data->validate_headers;
+    lt->data.def_ignore_errors        = data->def_ignore_errors;
+    lt->data.def_transfer             = data->def_transfer;
+    lt->data.def_version              = data->def_version;
+    lt->data.load                     = load;
+
+    if (load->rate > 0.0)
+      lt->data.load_next = now + num_started / load->rate;
+
+    if ((lt->thread = _cupsThreadCreate((_cups_thread_func_t)load_thread, lt)) == 0)
+    {
+      print_fatal_error(data, "Unable to create load thread: %s", strerror(errno));
+      _ippVarsDeinit(&(lt->vars));
+      cupsArrayDelete(lt->data.errors);
+      status = 0;
+      break;
+    }
+  }
+
+ /*
+  * Wait for the warmup and measurement periods to finish...
+  */
+
+  while (!Cancel && status && (now = get_time()) < load->end)
+  {
+    if ((load->end - now) < 0.1)
+      usleep((useconds_t)((load->end - now) * 1000000.0));
+    else
+      usleep(100000);
+  }
+
+  if ((now = get_time()) < load->end)
+    load->end = now;
+
+  load->stop = 1;
+
+ /*
+  * Collect the results from each thread...
+  */
+
+  for (i = 0, lt = threads; i < num_started; i ++, lt ++)
+  {
+    _cupsThreadWait(lt->thread);
+
+    if (!lt->data.pass)
+      status = 0;
+
+    data->test_count += lt->data.test_count;
+    data->pass_count += lt->data.pass_count;
+    data->fail_count += lt->data.fail_count;
+    data->skip_count += lt->data.skip_count;
+
+    _ippVarsDeinit(&(lt->vars));
+    cupsArrayDelete(lt->data.errors);
+  }
+
+  free(threads);
+
+  print_load_report(data, load);
+
+  for (lop = (_cups_loadop_t *)cupsArrayFirst(load->ops); lop; lop = (_cups_loadop_t *)cupsArrayNext(load->ops))
+  {
+    free(lop->samples);
+    free(lop);
+  }
+
+  cupsArrayDelete(load->ops);
+  load->ops = NULL;
+
+  return (status);
+}
+
+
 /*
  * 'do_test()' - Do a single test from the test file.
  */
@@ -895,6 +1195,7 @@ do_test(_ipp_file_t      *f,		/* I - IPP data file */
 		status_ok,		/* Did we get a matching status? */
 		repeat_count = 0,	/* Repeat count */
 		repeat_test;		/* Repeat the test? */
+  double	start = 0.0;		/* Start time of request in load mode */
   _cups_expect_t *expect;		/* Current expected attribute */
   ipp_t		*request,		/* IPP request */
 		*response;		/* IPP response */
@@ -912,7 +1213,7 @@ do_test(_ipp_file_t      *f,		/* I - IPP data file */
   const char	*error;			/* Current error */
 
 
-  if (Cancel)
+  if (Cancel || (data->load && data->load->stop))
     return (0);
 
  /*
@@ -1052,6 +1353,12 @@ do_test(_ipp_file_t      *f,		/* I - IPP data file */
     repeat_test     = 0;
     response        = NULL;
 
+    if (data->load)
+    {
+      load_wait(data);
+      start = get_time();
+    }
+
     if (status != HTTP_STATUS_ERROR)
     {
       while (!response && !Cancel && data->prev_pass)
@@ -1144,6 +1451,9 @@ do_test(_ipp_file_t      *f,		/* I - IPP data file */
       data->prev_pass = 0;
     }
 
+    if (data->load)
+      load_record(data, ippGetOperation(request), start, response);
+
    /*
     * Check results of request...
     */
@@ -1872,32 +2182,12 @@ do_tests(const char       *testfile,	/* I - Test file to use */
          _ipp_vars_t      *vars,	/* I - Variables */
          _cups_testdata_t *data)	/* I - Test data */
 {
-  http_encryption_t encryption;		/* Encryption mode */
-
-
  /*
   * Connect to the printer/server...
   */
 
-  if (!_cups_strcasecmp(vars->scheme, "https") || !_cups_strcasecmp(vars->scheme, "ipps"))
-    encryption = HTTP_ENCRYPTION_ALWAYS;
-  else
-    encryption = data->encryption;
-
-  if ((data->http = httpConnect2(vars->host, vars->port, NULL, data->family, encryption, 1, 30000, NULL)) == NULL)
-  {
-    print_fatal_error(data, "Unable to connect to \"%s\" on port %d - %s", vars->host, vars->port, cupsLastErrorString());
+  if ((data->http = connect_printer(vars, data)) == NULL)
     return (0);
-  }
-
-#ifdef HAVE_LIBZ
-  httpSetDefaultField(data->http, HTTP_FIELD_ACCEPT_ENCODING, "deflate, gzip, identity");
-#else
-  httpSetDefaultField(data->http, HTTP_FIELD_ACCEPT_ENCODING, "identity");
-#endif /* HAVE_LIBZ */
-
-  if (data->timeout > 0.0)
-    httpSetTimeout(data->http, data->timeout, timeout_cb, NULL);
 
  /*
   * Run tests...
@@ -2131,6 +2421,22 @@ get_string(ipp_attribute_t *attr,	/* I - IPP attribute */
 }
 
 
+/*
+ * 'get_time()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+get_time(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  return (curtime.tv_sec + 0.000001 * curtime.tv_usec);
+}
+
+
 /*
  * 'init_data()' - Initialize test data.
  */
@@ -2177,6 +2483,132 @@ iso_date(const ipp_uchar_t *date)	/* I - IPP (RFC 1903) date/time value */
 }
 
 
+/*
+ * 'load_record()' - Record the latency of a request in load mode.
+ */
+
+static void
+load_record(_cups_testdata_t *data,	/* I - Test data */
+            ipp_op_t         op,	/* I - Operation code */
+            double           start,	/* I - Start time of request */
+            ipp_t            *response)	/* I - Response or `NULL` */
+{
+  _cups_load_t		*load = data->load;
+					/* Load generation data */
+  _cups_loadop_t	key,		/* Search key */
+			*lop;		/* Operation statistics */
+  double		latency = get_time() - start,
+					/* Latency of request */
+			*samples;	/* New samples array */
+  size_t		alloc_samples;	/* New size of samples array */
+
+
+ /*
+  * Ignore requests made during the warmup period or after the end...
+  */
+
+  if (start < load->start || start >= load->end)
+    return;
+
+  _cupsMutexLock(&(load->mutex));
+
+  key.op = op;
+
+  if ((lop = (_cups_loadop_t *)cupsArrayFind(load->ops, &key)) == NULL)
+  {
+    if ((lop = calloc(1, sizeof(_cups_loadop_t))) != NULL)
+    {
+      lop->op = op;
+      cupsArrayAdd(load->ops, lop);
+    }
+  }
+
+  if (lop && lop->num_samples >= lop->alloc_samples)
+  {
+    alloc_samples = lop->alloc_samples ? 2 * lop->alloc_samples : 1024;
+
+    if ((samples = realloc(lop->samples, alloc_samples * sizeof(double))) != NULL)
+    {
+      lop->samples       = samples;
+      lop->alloc_samples = alloc_samples;
+    }
+  }
+
+  if (lop && lop->num_samples < lop->alloc_samples)
+  {
+    lop->samples[lop->num_samples ++] = latency;
+
+    if (!response || ippGetStatusCode(response) >= IPP_STATUS_ERROR_BAD_REQUEST)
+      lop->errors ++;
+  }
+
+  _cupsMutexUnlock(&(load->mutex));
+}
+
+
+/*
+ * 'load_thread()' - Run a test file repeatedly on its own connection.
+ */
+
+static void *				/* O - Thread exit status */
+load_thread(_cups_loadthread_t *lt)	/* I - Load generation thread */
+{
+  int	test_count;			/* Test count before each pass */
+
+
+  if (lt->vars.username[0] && lt->vars.password)
+    cupsSetPasswordCB2(_ippVarsPasswordCB, &(lt->vars));
+
+  if ((lt->data.http = connect_printer(&(lt->vars), &(lt->data))) == NULL)
+  {
+    lt->data.pass = 0;
+    return (NULL);
+  }
+
+  while (!Cancel && !lt->load->stop)
+  {
+    test_count = lt->data.test_count;
+
+    _ippFileParse(&(lt->vars), lt->testfile, &(lt->data));
+
+    if (lt->data.test_count == test_count)
+      break;				/* No tests or a fatal error */
+  }
+
+  httpClose(lt->data.http);
+  lt->data.http = NULL;
+
+  return (NULL);
+}
+
+
+/*
+ * 'load_wait()' - Wait until the next request is due in load mode.
+ */
+
+static void
+load_wait(_cups_testdata_t *data)	/* I - Test data */
+{
+  _cups_load_t	*load = data->load;	/* Load generation data */
+  double	interval,		/* Interval between requests */
+		now;			/* Current time */
+
+
+  if (load->rate <= 0.0)
+    return;
+
+  interval = load->num_threads / load->rate;
+  now      = get_time();
+
+  if (data->load_next > now)
+    usleep((useconds_t)((data->load_next - now) * 1000000.0));
+  else if (data->load_next < (now - interval))
+    data->load_next = now;		/* Don't burst to catch up */
+
+  data->load_next += interval;
+}
+
+
 /*
  * 'pause_message()' - Display the message and pause until the user presses a key.
  */
@@ -2782,6 +3214,110 @@ print_line(
 }
 
 
+/*
+ * 'print_load_report()' - Print the throughput and latency for each operation.
+ */
+
+static void
+print_load_report(
+    _cups_testdata_t *data,		/* I - Test data */
+    _cups_load_t     *load)		/* I - Load generation data */
+{
+  _cups_loadop_t	*lop,		/* Current operation statistics */
+			total;		/* Statistics for all operations */
+  double		elapsed = load->end - load->start;
+					/* Measurement time */
+
+
+ /*
+  * Merge the samples from every operation for the total...
+  */
+
+  memset(&total, 0, sizeof(total));
+
+  for (lop = (_cups_loadop_t *)cupsArrayFirst(load->ops); lop; lop = (_cups_loadop_t *)cupsArrayNext(load->ops))
+    total.alloc_samples += lop->num_samples;
+
+  if (total.alloc_samples > 0 && (total.samples = malloc(total.alloc_samples * sizeof(double))) != NULL)
+  {
+    for (lop = (_cups_loadop_t *)cupsArrayFirst(load->ops); lop; lop = (_cups_loadop_t *)cupsArrayNext(load->ops))
+    {
+      memcpy(total.samples + total.num_samples, lop->samples, lop->num_samples * sizeof(double));
+      total.num_samples += lop->num_samples;
+      total.errors      += lop->errors;
+    }
+  }
+
+ /*
+  * Show the report...
+  */
+
+  if (data->output == _CUPS_OUTPUT_CSV)
+  {
+    cupsFilePuts(data->outfile, "operation,requests,errors,requests-per-second,p50-ms,p90-ms,p99-ms,p999-ms,max-ms\n");
+  }
+  else
+  {
+    if (load->rate > 0.0)
+      cupsFilePrintf(data->outfile, "Load: %d connections, %.1f requests/second target, %.1f second warmup, %.1f seconds measured\n", load->num_threads, load->rate, load->warmup, elapsed);
+    else
+      cupsFilePrintf(data->outfile, "Load: %d connections, unlimited rate, %.1f second warmup, %.1f seconds measured\n", load->num_threads, load->warmup, elapsed);
+
+    cupsFilePrintf(data->outfile, "Tests: %d total, %d passed, %d failed, %d skipped\n\n", data->test_count, data->pass_count, data->fail_count, data->skip_count);
+    cupsFilePrintf(data->outfile, "%-32s %9s %7s %10s %9s %9s %9s %9s %9s\n", "Operation", "Requests", "Errors", "Req/sec", "p50 ms", "p90 ms", "p99 ms", "p99.9 ms", "max ms");
+  }
+
+  for (lop = (_cups_loadop_t *)cupsArrayFirst(load->ops); lop; lop = (_cups_loadop_t *)cupsArrayNext(load->ops))
+    print_load_stats(data, ippOpString(lop->op), lop, elapsed);
+
+  print_load_stats(data, "Total", &total, elapsed);
+
+  free(total.samples);
+}
+
+
+/*
+ * 'print_load_stats()' - Print the throughput and latency percentiles for an
+ *                        operation.
+ */
+
+static void
+print_load_stats(
+    _cups_testdata_t *data,		/* I - Test data */
+    const char       *name,		/* I - Operation name */
+    _cups_loadop_t   *lop,		/* I - Operation statistics */
+    double           elapsed)		/* I - Measurement time */
+{
+  int		i;			/* Looping var */
+  double	rate,			/* Requests per second */
+		ms[5];			/* Latency percentiles in milliseconds */
+  static const double percentiles[4] =	/* Percentiles to report */
+  { 0.5, 0.9, 0.99, 0.999 };
+
+
+  qsort(lop->samples, lop->num_samples, sizeof(double), (int (*)(const void *, const void *))compare_latencies);
+
+  for (i = 0; i < 4; i ++)
+  {
+    size_t n = (size_t)(percentiles[i] * lop->num_samples);
+					/* Sample index */
+
+    if (n >= lop->num_samples)
+      n = lop->num_samples - 1;
+
+    ms[i] = lop->num_samples ? 1000.0 * lop->samples[n] : 0.0;
+  }
+
+  ms[4] = lop->num_samples ? 1000.0 * lop->samples[lop->num_samples - 1] : 0.0;
+  rate  = elapsed > 0.0 ? lop->num_samples / elapsed : 0.0;
+
+  if (data->output == _CUPS_OUTPUT_CSV)
+    cupsFilePrintf(data->outfile, "%s,%u,%d,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f\n", name, (unsigned)lop->num_samples, lop->errors, rate, ms[0], ms[1], ms[2], ms[3], ms[4]);
+  else
+    cupsFilePrintf(data->outfile, "%-32s %9u %7d %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, (unsigned)lop->num_samples, lop->errors, rate, ms[0], ms[1], ms[2], ms[3], ms[4]);
+}
+
+
 /*
  * 'print_xml_header()' - Print a standard XML plist header.
  */
@@ -3787,7 +4323,7 @@ token_cb(_ipp_file_t      *f,		/* I - IPP file data */
 	     !_cups_strcasecmp(token, "WITH-SCHEME") ||
 	     !_cups_strcasecmp(token, "WITH-VALUE"))
     {
-      off_t	lastpos;		/* Last file position */
+      size_t	lastpos;		/* Last token position */
       int	lastline;		/* Last line number */
 
       if (data->last_expect)
@@ -3818,7 +4354,7 @@ token_cb(_ipp_file_t      *f,		/* I - IPP file data */
 
       for (;;)
       {
-        lastpos  = cupsFileTell(f->fp);
+        lastpos  = f->tokindex;
         lastline = f->linenum;
         ptr      += strlen(ptr);
 
@@ -3842,7 +4378,7 @@ token_cb(_ipp_file_t      *f,		/* I - IPP file data */
           * Not another value, stop here...
           */
 
-          cupsFileSeek(f->fp, lastpos);
+          f->tokindex = lastpos;
           f->linenum = lastline;
           *ptr = '\0';
           break;
@@ -4305,10 +4841,14 @@ usage(void)
 {
   _cupsLangPuts(stderr, _("Usage: ipptool [options] URI filename [ ... filenameN ]"));
   _cupsLangPuts(stderr, _("Options:"));
+  _cupsLangPuts(stderr, _("--duration seconds      Measure for the given time in load mode (default=10)"));
   _cupsLangPuts(stderr, _("--ippserver filename    Produce ippserver attribute file"));
+  _cupsLangPuts(stderr, _("--load connections      Run the test file concurrently and report latency"));
+  _cupsLangPuts(stderr, _("--rate requests         Limit load mode to the given requests per second"));
   _cupsLangPuts(stderr, _("--stop-after-include-error\n"
                           "                        Stop tests after a failed INCLUDE"));
   _cupsLangPuts(stderr, _("--version               Show version"));
+  _cupsLangPuts(stderr, _("--warmup seconds        Ignore requests for the given time in load mode"));
   _cupsLangPuts(stderr, _("-4                      Connect using IPv4"));
   _cupsLangPuts(stderr, _("-6                      Connect using IPv6"));
   _cupsLangPuts(stderr, _("-C                      Send requests using chunking (default)"));
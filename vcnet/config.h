@@ -359,6 +359,13 @@ typedef unsigned long useconds_t;
 /* #undef HAVE_MALLOC_H */
 
 
+/*
+ * Build the scheduler with static tracing probes (<sys/sdt.h>)?
+ */
+
+/* #undef HAVE_SYS_SDT_H */
+
+
 /*
  * Do we have the POSIX ACL functions?
  */
@@ -397,6 +404,13 @@ typedef unsigned long useconds_t;
 /* #undef HAVE_GNUTLS_PRIORITY_SET_DIRECT */
 
 
+/*
+ * Do we have the gnutls_alpn_set_protocols function?
+ */
+
+/* #undef HAVE_GNUTLS_ALPN_SET_PROTOCOLS */
+
+
 /*
  * What Security framework headers do we have?
  */
@@ -665,6 +679,28 @@ typedef unsigned long useconds_t;
 /* #undef HAVE_REMOVEFILE */
 
 
+/*
+ * Do we have sendfile()?
+ */
+
+/* #undef HAVE_SENDFILE */
+
+
+/*
+ * Do we have fallocate() and splice()?
+ */
+
+/* #undef HAVE_FALLOCATE */
+/* #undef HAVE_SPLICE */
+
+
+/*
+ * Do we have copy_file_range()?
+ */
+
+/* #undef HAVE_COPY_FILE_RANGE */
+
+
 /*
  * Do we have <sandbox.h>?
  */
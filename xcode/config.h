@@ -281,6 +281,13 @@
 /* #undef HAVE_MALLOC_H */
 
 
+/*
+ * Build the scheduler with static tracing probes (<sys/sdt.h>)?
+ */
+
+/* #undef HAVE_SYS_SDT_H */
+
+
 /*
  * Do we have the POSIX ACL functions?
  */
@@ -319,6 +326,13 @@
 /* #undef HAVE_GNUTLS_PRIORITY_SET_DIRECT */
 
 
+/*
+ * Do we have the gnutls_alpn_set_protocols function?
+ */
+
+/* #undef HAVE_GNUTLS_ALPN_SET_PROTOCOLS */
+
+
 /*
  * What Security framework headers do we have?
  */
@@ -598,6 +612,28 @@
 #define HAVE_REMOVEFILE 1
 
 
+/*
+ * Do we have sendfile()?
+ */
+
+/* #undef HAVE_SENDFILE */
+
+
+/*
+ * Do we have fallocate() and splice()?
+ */
+
+/* #undef HAVE_FALLOCATE */
+/* #undef HAVE_SPLICE */
+
+
+/*
+ * Do we have copy_file_range()?
+ */
+
+/* #undef HAVE_COPY_FILE_RANGE */
+
+
 /*
  * Do we have <sandbox.h>?
  */